@@ -0,0 +1,282 @@
+/* 
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bsp/board.h"
+#include "tusb.h"
+
+//--------------------------------------------------------------------+
+// MACRO CONSTANT TYPEDEF PROTYPES
+//--------------------------------------------------------------------+
+
+/* Blink pattern
+ * - 250 ms  : device not mounted
+ * - 1000 ms : device mounted
+ * - 2500 ms : device is suspended
+ */
+enum  {
+  BLINK_NOT_MOUNTED = 250,
+  BLINK_MOUNTED = 1000,
+  BLINK_SUSPENDED = 2500,
+};
+
+// Vendor instances
+enum
+{
+  ITF_SOURCE_SINK = 0,
+  ITF_LOOPBACK
+};
+
+// Vendor requests used by tools/bulk_bench.py
+enum
+{
+  BENCH_REQUEST_INFO  = 1, // bench_info_t
+  BENCH_REQUEST_STATS = 2, // bench_stats_t, reset if wValue is 1
+};
+
+typedef struct TU_ATTR_PACKED
+{
+  uint8_t  version;
+  uint8_t  stream;       // CFG_TUD_VENDOR_STREAM
+  uint8_t  depth;        // buffers queued per direction in streaming mode
+  uint8_t  high_speed;
+  uint16_t ep_size;
+  uint16_t buf_size;     // source/sink buffer in streaming mode, fifo otherwise
+  uint32_t mcu;          // CFG_TUSB_MCU
+}bench_info_t;
+
+typedef struct TU_ATTR_PACKED
+{
+  uint32_t sink_bytes;
+  uint32_t source_bytes;
+  uint32_t loopback_bytes;
+}bench_stats_t;
+
+static uint32_t blink_interval_ms = BLINK_NOT_MOUNTED;
+static bench_stats_t _stats;
+
+#if CFG_TUD_VENDOR_STREAM
+  #define BENCH_BUFSIZE   CFG_EXAMPLE_BULK_BENCH_BUFSIZE
+#else
+  #define BENCH_BUFSIZE   CFG_TUD_VENDOR_TX_BUFSIZE
+#endif
+
+// content is irrelevant, host only counts bytes. Same buffer is queued several times
+CFG_TUSB_MEM_SECTION CFG_TUSB_MEM_ALIGN static uint8_t _source_buf[BENCH_BUFSIZE];
+
+#if CFG_TUD_VENDOR_STREAM
+CFG_TUSB_MEM_SECTION CFG_TUSB_MEM_ALIGN static uint8_t _sink_buf[CFG_TUD_VENDOR_STREAM_DEPTH][BENCH_BUFSIZE];
+
+// a received buffer is sent back then queued again to receive, one packet each since a transfer
+// of host may end anywhere
+CFG_TUSB_MEM_SECTION CFG_TUSB_MEM_ALIGN static uint8_t _loop_buf[CFG_TUD_VENDOR_STREAM_DEPTH][CFG_TUD_VENDOR_EPSIZE];
+#endif
+
+void led_blinking_task(void);
+void bench_task(void);
+
+/*------------- MAIN -------------*/
+int main(void)
+{
+  board_init();
+  tusb_init();
+
+  while (1)
+  {
+    tud_task(); // tinyusb device task
+    led_blinking_task();
+
+    bench_task();
+  }
+
+  return 0;
+}
+
+//--------------------------------------------------------------------+
+// Device callbacks
+//--------------------------------------------------------------------+
+
+// Invoked when device is mounted
+void tud_mount_cb(void)
+{
+  blink_interval_ms = BLINK_MOUNTED;
+
+#if CFG_TUD_VENDOR_STREAM
+  // queued buffers are dropped by bus reset, pipes are started again here
+  for(uint8_t i=0; i<CFG_TUD_VENDOR_STREAM_DEPTH; i++)
+  {
+    tud_vendor_n_stream_read (ITF_SOURCE_SINK, _sink_buf[i], BENCH_BUFSIZE);
+    tud_vendor_n_stream_write(ITF_SOURCE_SINK, _source_buf, BENCH_BUFSIZE);
+    tud_vendor_n_stream_read (ITF_LOOPBACK, _loop_buf[i], CFG_TUD_VENDOR_EPSIZE);
+  }
+#endif
+}
+
+// Invoked when device is unmounted
+void tud_umount_cb(void)
+{
+  blink_interval_ms = BLINK_NOT_MOUNTED;
+}
+
+// Invoked when usb bus is suspended
+// remote_wakeup_en : if host allow us  to perform remote wakeup
+// Within 7ms, device must draw an average of current less than 2.5 mA from bus
+void tud_suspend_cb(bool remote_wakeup_en)
+{
+  (void) remote_wakeup_en;
+  blink_interval_ms = BLINK_SUSPENDED;
+}
+
+// Invoked when usb bus is resumed
+void tud_resume_cb(void)
+{
+  blink_interval_ms = BLINK_MOUNTED;
+}
+
+//--------------------------------------------------------------------+
+// Source, Sink and Loopback
+//--------------------------------------------------------------------+
+#if CFG_TUD_VENDOR_STREAM
+
+void tud_vendor_stream_rx_cb(uint8_t itf, uint8_t* buffer, uint32_t xferred_bytes)
+{
+  if ( itf == ITF_SOURCE_SINK )
+  {
+    _stats.sink_bytes += xferred_bytes;
+    tud_vendor_n_stream_read(itf, buffer, BENCH_BUFSIZE);
+  }else
+  {
+    // queued to receive again once sent
+    if ( xferred_bytes )
+    {
+      tud_vendor_n_stream_write(itf, buffer, xferred_bytes);
+    }else
+    {
+      tud_vendor_n_stream_read(itf, buffer, CFG_TUD_VENDOR_EPSIZE);
+    }
+  }
+}
+
+void tud_vendor_stream_tx_cb(uint8_t itf, uint8_t const* buffer, uint32_t sent_bytes)
+{
+  if ( itf == ITF_SOURCE_SINK )
+  {
+    _stats.source_bytes += sent_bytes;
+    tud_vendor_n_stream_write(itf, buffer, BENCH_BUFSIZE);
+  }else
+  {
+    _stats.loopback_bytes += sent_bytes;
+    tud_vendor_n_stream_read(itf, (void*) (uintptr_t) buffer, CFG_TUD_VENDOR_EPSIZE);
+  }
+}
+
+void bench_task(void)
+{
+  // everything is done in callbacks
+}
+
+#else
+
+void bench_task(void)
+{
+  uint8_t buf[64];
+
+  if ( !tud_mounted() ) return;
+
+  // sink
+  while ( tud_vendor_n_available(ITF_SOURCE_SINK) )
+  {
+    _stats.sink_bytes += tud_vendor_n_read(ITF_SOURCE_SINK, buf, sizeof(buf));
+  }
+
+  // source, tx fifo is kept full
+  uint32_t count = tud_vendor_n_write_available(ITF_SOURCE_SINK);
+  if ( count ) _stats.source_bytes += tud_vendor_n_write(ITF_SOURCE_SINK, _source_buf, count);
+
+  // loopback, limited by room in tx fifo
+  while ( (count = tu_min32(tud_vendor_n_available(ITF_LOOPBACK), tud_vendor_n_write_available(ITF_LOOPBACK))) )
+  {
+    count = tud_vendor_n_read(ITF_LOOPBACK, buf, tu_min32(count, sizeof(buf)));
+    _stats.loopback_bytes += tud_vendor_n_write(ITF_LOOPBACK, buf, count);
+  }
+}
+
+#endif
+
+//--------------------------------------------------------------------+
+// Vendor control requests
+//--------------------------------------------------------------------+
+
+// Invoked when received VENDOR control request
+bool tud_vendor_control_request_cb(uint8_t rhport, tusb_control_request_t const * request)
+{
+  static bench_info_t  info;
+  static bench_stats_t stats;
+
+  switch (request->bRequest)
+  {
+    case BENCH_REQUEST_INFO:
+      info = (bench_info_t)
+      {
+        .version    = 1,
+        .stream     = CFG_TUD_VENDOR_STREAM,
+        .depth      = CFG_TUD_VENDOR_STREAM ? CFG_TUD_VENDOR_STREAM_DEPTH : 1,
+        .high_speed = (CFG_TUSB_RHPORT0_MODE & OPT_MODE_HIGH_SPEED) ? 1 : 0,
+        .ep_size    = CFG_TUD_VENDOR_EPSIZE,
+        .buf_size   = BENCH_BUFSIZE,
+        .mcu        = CFG_TUSB_MCU
+      };
+      return tud_control_xfer(rhport, request, &info, sizeof(info));
+
+    case BENCH_REQUEST_STATS:
+      // snapshot, counters keep running while data stage is sent
+      stats = _stats;
+      if ( request->wValue == 1 ) tu_varclr(&_stats);
+      return tud_control_xfer(rhport, request, &stats, sizeof(stats));
+
+    default:
+      // stall unknown request
+      return false;
+  }
+}
+
+//--------------------------------------------------------------------+
+// BLINKING TASK
+//--------------------------------------------------------------------+
+void led_blinking_task(void)
+{
+  static uint32_t start_ms = 0;
+  static bool led_state = false;
+
+  // Blink every interval ms
+  if ( board_millis() - start_ms < blink_interval_ms) return; // not enough time
+  start_ms += blink_interval_ms;
+
+  board_led_write(led_state);
+  led_state = 1 - led_state; // toggle
+}
@@ -72,6 +72,9 @@
 #define CFG_TUD_ENDPOINT0_SIZE    64
 #endif
 
+// serve string descriptors from const table in usb_descriptors.c
+#define CFG_TUD_DESC_STRING_TABLE 1
+
 //------------- CLASS -------------//
 #define CFG_TUD_CDC              1
 #define CFG_TUD_MSC              1
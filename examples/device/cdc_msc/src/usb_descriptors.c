@@ -120,49 +120,23 @@ uint8_t const * tud_descriptor_configuration_cb(uint8_t index)
 // String Descriptors
 //--------------------------------------------------------------------+
 
-// array of pointer to string descriptors
-char const* string_desc_arr [] =
+// UTF-16 string descriptors generated at compile time
+TUD_STRING_LANGID_DEF    (desc_str_langid      , 0x0409);           // 0: is supported language is English (0x0409)
+TUD_STRING_DESCRIPTOR_DEF(desc_str_manufacturer, "TinyUSB");        // 1: Manufacturer
+TUD_STRING_DESCRIPTOR_DEF(desc_str_product     , "TinyUSB Device"); // 2: Product
+TUD_STRING_DESCRIPTOR_DEF(desc_str_serial      , "123456");         // 3: Serials, should use chip ID
+TUD_STRING_DESCRIPTOR_DEF(desc_str_cdc         , "TinyUSB CDC");    // 4: CDC Interface
+TUD_STRING_DESCRIPTOR_DEF(desc_str_msc         , "TinyUSB MSC");    // 5: MSC Interface
+
+// array of pointer to string descriptors, served by the stack as it is (CFG_TUD_DESC_STRING_TABLE)
+void const* const tud_descriptor_string_arr[] =
 {
-  (const char[]) { 0x09, 0x04 }, // 0: is supported language is English (0x0409)
-  "TinyUSB",                     // 1: Manufacturer
-  "TinyUSB Device",              // 2: Product
-  "123456",                      // 3: Serials, should use chip ID
-  "TinyUSB CDC",                 // 4: CDC Interface
-  "TinyUSB MSC",                 // 5: MSC Interface
+  &desc_str_langid,
+  &desc_str_manufacturer,
+  &desc_str_product,
+  &desc_str_serial,
+  &desc_str_cdc,
+  &desc_str_msc,
 };
 
-static uint16_t _desc_str[32];
-
-// Invoked when received GET STRING DESCRIPTOR request
-// Application return pointer to descriptor, whose contents must exist long enough for transfer to complete
-uint16_t const* tud_descriptor_string_cb(uint8_t index)
-{
-  uint8_t chr_count;
-
-  if ( index == 0)
-  {
-    memcpy(&_desc_str[1], string_desc_arr[0], 2);
-    chr_count = 1;
-  }else
-  {
-    // Convert ASCII string into UTF-16
-
-    if ( !(index < sizeof(string_desc_arr)/sizeof(string_desc_arr[0])) ) return NULL;
-
-    const char* str = string_desc_arr[index];
-
-    // Cap at max char
-    chr_count = strlen(str);
-    if ( chr_count > 31 ) chr_count = 31;
-
-    for(uint8_t i=0; i<chr_count; i++)
-    {
-      _desc_str[1+i] = str[i];
-    }
-  }
-
-  // first byte is length (including header), second byte is string type
-  _desc_str[0] = (TUSB_DESC_STRING << 8 ) | (2*chr_count + 2);
-
-  return _desc_str;
-}
+uint8_t const tud_descriptor_string_count = TU_ARRAY_SIZE(tud_descriptor_string_arr);
@@ -0,0 +1,179 @@
+/* 
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bsp/board.h"
+#include "tusb.h"
+#include "msc_bench.h"
+
+//--------------------------------------------------------------------+
+// MACRO CONSTANT TYPEDEF PROTYPES
+//--------------------------------------------------------------------+
+
+/* Blink pattern
+ * - 250 ms  : device not mounted
+ * - 1000 ms : device mounted
+ * - 2500 ms : device is suspended
+ */
+enum  {
+  BLINK_NOT_MOUNTED = 250,
+  BLINK_MOUNTED = 1000,
+  BLINK_SUSPENDED = 2500,
+};
+
+// Statistics are reported every interval while there is MSC traffic
+enum { REPORT_INTERVAL_MS = 1000 };
+
+static uint32_t blink_interval_ms = BLINK_NOT_MOUNTED;
+
+void led_blinking_task(void);
+void report_task(void);
+
+/*------------- MAIN -------------*/
+int main(void)
+{
+  board_init();
+  tusb_init();
+
+  while (1)
+  {
+    tud_task(); // tinyusb device task
+    led_blinking_task();
+
+    report_task();
+  }
+
+  return 0;
+}
+
+//--------------------------------------------------------------------+
+// Device callbacks
+//--------------------------------------------------------------------+
+
+// Invoked when device is mounted
+void tud_mount_cb(void)
+{
+  blink_interval_ms = BLINK_MOUNTED;
+}
+
+// Invoked when device is unmounted
+void tud_umount_cb(void)
+{
+  blink_interval_ms = BLINK_NOT_MOUNTED;
+}
+
+// Invoked when usb bus is suspended
+// remote_wakeup_en : if host allow us  to perform remote wakeup
+// Within 7ms, device must draw an average of current less than 2.5 mA from bus
+void tud_suspend_cb(bool remote_wakeup_en)
+{
+  (void) remote_wakeup_en;
+  blink_interval_ms = BLINK_SUSPENDED;
+}
+
+// Invoked when usb bus is resumed
+void tud_resume_cb(void)
+{
+  blink_interval_ms = BLINK_MOUNTED;
+}
+
+//--------------------------------------------------------------------+
+// Report over CDC
+//--------------------------------------------------------------------+
+
+static void report_write(char const* str)
+{
+  if ( tud_cdc_connected() )
+  {
+    tud_cdc_write_str(str);
+    tud_cdc_write_flush();
+  }
+}
+
+// One line per direction, parsed by tools/msc_bench.py
+//   BENCH,<R|W>,<commands>,<KB/s>,<average us per command>,<max ms per command>
+static void report_stat(char dir, bench_stat_t const* stat, uint32_t elapsed_ms)
+{
+  char line[80];
+
+  uint32_t const kbps      = (uint32_t) (((uint64_t) stat->byte_count * 1000) / (1024UL * elapsed_ms));
+  uint32_t const us_per_cmd = stat->cmd_count ? (elapsed_ms * 1000) / stat->cmd_count : 0;
+
+  snprintf(line, sizeof(line), "BENCH,%c,%lu,%lu,%lu,%lu\r\n", dir, (unsigned long) stat->cmd_count,
+           (unsigned long) kbps, (unsigned long) us_per_cmd, (unsigned long) stat->max_ms);
+  report_write(line);
+}
+
+void report_task(void)
+{
+  static uint32_t start_ms = 0;
+
+  uint32_t const elapsed_ms = board_millis() - start_ms;
+  if ( elapsed_ms < REPORT_INTERVAL_MS ) return; // not enough time
+  start_ms += elapsed_ms;
+
+  bench_stat_t rd, wr;
+  bench_stat_take(&rd, &wr);
+
+  if ( rd.cmd_count ) report_stat('R', &rd, elapsed_ms);
+  if ( wr.cmd_count ) report_stat('W', &wr, elapsed_ms);
+}
+
+// Invoked when cdc when line state changed e.g connected/disconnected
+void tud_cdc_line_state_cb(uint8_t itf, bool dtr, bool rts)
+{
+  (void) itf;
+
+  // connected
+  if ( dtr && rts )
+  {
+    char line[128];
+
+    // print configuration under test when connected
+    snprintf(line, sizeof(line), "\r\nTinyUSB MSC Bench\r\nCONFIG,%u,%u,%u,%u,%u\r\n",
+             (unsigned) CFG_TUD_MSC_BUFSIZE, (unsigned) CFG_TUD_MSC_DOUBLE_BUFFER, (unsigned) CFG_TUD_MSC_READ_AHEAD,
+             (unsigned) CFG_EXAMPLE_MSC_BENCH_RAMDISK_KB, (unsigned) CFG_EXAMPLE_MSC_BENCH_NULLDISK_MB);
+    report_write(line);
+  }
+}
+
+//--------------------------------------------------------------------+
+// BLINKING TASK
+//--------------------------------------------------------------------+
+void led_blinking_task(void)
+{
+  static uint32_t start_ms = 0;
+  static bool led_state = false;
+
+  // Blink every interval ms
+  if ( board_millis() - start_ms < blink_interval_ms) return; // not enough time
+  start_ms += blink_interval_ms;
+
+  board_led_write(led_state);
+  led_state = 1 - led_state; // toggle
+}
@@ -0,0 +1,202 @@
+/* 
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <string.h>
+
+#include "bsp/board.h"
+#include "tusb.h"
+#include "msc_bench.h"
+
+#if CFG_TUD_MSC
+
+// LUN 0 is a RAM disk, LUN 1 discards writes and reads as zeros so that only USB and stack are measured.
+// Neither is formatted, benchmark accesses them as raw block devices.
+enum
+{
+  LUN_RAMDISK = 0,
+  LUN_NULLDISK,
+  LUN_COUNT
+};
+
+enum
+{
+  DISK_BLOCK_SIZE    = 512,
+  RAMDISK_BLOCK_NUM  = (CFG_EXAMPLE_MSC_BENCH_RAMDISK_KB*1024UL) / DISK_BLOCK_SIZE,
+  NULLDISK_BLOCK_NUM = (CFG_EXAMPLE_MSC_BENCH_NULLDISK_MB*1024UL*1024UL) / DISK_BLOCK_SIZE,
+};
+
+static uint8_t ramdisk[RAMDISK_BLOCK_NUM][DISK_BLOCK_SIZE];
+
+static bench_stat_t _stat_rd, _stat_wr;
+
+// a command spans multiple read/write callbacks until its complete callback
+static bool     _cmd_active;
+static uint32_t _cmd_start_ms;
+
+//--------------------------------------------------------------------+
+// Statistics
+//--------------------------------------------------------------------+
+
+static void stat_data(bench_stat_t* stat, uint32_t nbytes)
+{
+  if ( !_cmd_active )
+  {
+    _cmd_active   = true;
+    _cmd_start_ms = board_millis();
+  }
+
+  stat->byte_count += nbytes;
+}
+
+static void stat_complete(bench_stat_t* stat)
+{
+  if ( !_cmd_active ) return;
+  _cmd_active = false;
+
+  uint32_t const duration = board_millis() - _cmd_start_ms;
+
+  stat->cmd_count++;
+  if ( duration > stat->max_ms ) stat->max_ms = duration;
+}
+
+void bench_stat_take(bench_stat_t* rd, bench_stat_t* wr)
+{
+  // callbacks run in the same (tud_task) context, no need for critical section
+  *rd = _stat_rd;
+  *wr = _stat_wr;
+
+  memset(&_stat_rd, 0, sizeof(_stat_rd));
+  memset(&_stat_wr, 0, sizeof(_stat_wr));
+}
+
+//--------------------------------------------------------------------+
+// MSC callbacks
+//--------------------------------------------------------------------+
+
+// Invoked when received GET_MAX_LUN request
+uint8_t tud_msc_get_maxlun_cb(void)
+{
+  return LUN_COUNT;
+}
+
+// Invoked when received SCSI_CMD_INQUIRY
+// Application fill vendor id, product id and revision with string up to 8, 16, 4 characters respectively
+void tud_msc_inquiry_cb(uint8_t lun, uint8_t vendor_id[8], uint8_t product_id[16], uint8_t product_rev[4])
+{
+  // product id tells LUNs apart on host
+  const char vid[] = "TinyUSB";
+  const char* pid  = (lun == LUN_RAMDISK) ? "Bench RAM Disk" : "Bench Null Disk";
+  const char rev[] = "1.0";
+
+  memcpy(vendor_id  , vid, strlen(vid));
+  memcpy(product_id , pid, strlen(pid));
+  memcpy(product_rev, rev, strlen(rev));
+}
+
+// Invoked when received Test Unit Ready command.
+// return true allowing host to read/write this LUN e.g SD card inserted
+bool tud_msc_test_unit_ready_cb(uint8_t lun)
+{
+  (void) lun;
+
+  return true; // both disks are always ready
+}
+
+// Invoked when received SCSI_CMD_READ_CAPACITY_10 and SCSI_CMD_READ_FORMAT_CAPACITY to determine the disk size
+// Application update block count and block size
+void tud_msc_capacity_cb(uint8_t lun, uint32_t* block_count, uint16_t* block_size)
+{
+  *block_count = (lun == LUN_RAMDISK) ? RAMDISK_BLOCK_NUM : NULLDISK_BLOCK_NUM;
+  *block_size  = DISK_BLOCK_SIZE;
+}
+
+// Callback invoked when received READ10 command.
+// Copy disk's data to buffer (up to bufsize) and return number of copied bytes.
+int32_t tud_msc_read10_cb(uint8_t lun, uint32_t lba, uint32_t offset, void* buffer, uint32_t bufsize)
+{
+  if ( lun == LUN_RAMDISK )
+  {
+    if ( (lba*DISK_BLOCK_SIZE + offset + bufsize) > sizeof(ramdisk) ) return -1;
+    memcpy(buffer, ramdisk[lba] + offset, bufsize);
+  }else
+  {
+    memset(buffer, 0, bufsize);
+  }
+
+  stat_data(&_stat_rd, bufsize);
+
+  return bufsize;
+}
+
+// Callback invoked when received WRITE10 command.
+// Process data in buffer to disk's storage and return number of written bytes
+int32_t tud_msc_write10_cb(uint8_t lun, uint32_t lba, uint32_t offset, uint8_t* buffer, uint32_t bufsize)
+{
+  if ( lun == LUN_RAMDISK )
+  {
+    if ( (lba*DISK_BLOCK_SIZE + offset + bufsize) > sizeof(ramdisk) ) return -1;
+    memcpy(ramdisk[lba] + offset, buffer, bufsize);
+  }
+
+  stat_data(&_stat_wr, bufsize);
+
+  return bufsize;
+}
+
+// Invoked when READ10 command is complete
+void tud_msc_read10_complete_cb(uint8_t lun)
+{
+  (void) lun;
+  stat_complete(&_stat_rd);
+}
+
+// Invoked when WRITE10 command is complete
+void tud_msc_write10_complete_cb(uint8_t lun)
+{
+  (void) lun;
+  stat_complete(&_stat_wr);
+}
+
+// Callback invoked when received an SCSI command not in built-in list below
+// - READ_CAPACITY10, READ_FORMAT_CAPACITY, INQUIRY, MODE_SENSE6, REQUEST_SENSE
+// - READ10 and WRITE10 has their own callbacks
+int32_t tud_msc_scsi_cb (uint8_t lun, uint8_t const scsi_cmd[16], void* buffer, uint16_t bufsize)
+{
+  (void) buffer;
+  (void) bufsize;
+
+  switch (scsi_cmd[0])
+  {
+    case SCSI_CMD_PREVENT_ALLOW_MEDIUM_REMOVAL:
+      return 0;
+
+    default:
+      // Set Sense = Invalid Command Operation
+      tud_msc_set_sense(lun, SCSI_SENSE_ILLEGAL_REQUEST, 0x20, 0x00);
+      return -1;
+  }
+}
+
+#endif
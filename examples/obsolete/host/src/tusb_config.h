@@ -45,7 +45,7 @@
 #define CFG_TUH_HUB               1
 #define CFG_TUH_HID_KEYBOARD      1
 #define CFG_TUH_HID_MOUSE         1
-#define CFG_TUSB_HOST_HID_GENERIC       0 // (not yet supported)
+#define CFG_TUSB_HOST_HID_GENERIC       0 // any HID device decoded from its report descriptor
 #define CFG_TUH_MSC               1
 #define CFG_TUH_CDC               1
 
@@ -16,10 +16,20 @@ SRC_C += \
 	src/device/usbd.c \
 	src/device/usbd_control.c \
 	src/class/msc/msc_device.c \
+	src/class/msc/uas_device.c \
+	src/class/msc/msc_uf2.c \
 	src/class/cdc/cdc_device.c \
+	src/class/dfu/dfu_device.c \
 	src/class/dfu/dfu_rt_device.c \
 	src/class/hid/hid_device.c \
+	src/class/audio/audio_device.c \
+	src/class/audio/audio_convert.c \
 	src/class/midi/midi_device.c \
+	src/class/video/video_device.c \
+	src/class/net/ncm_device.c \
+	src/class/net/rndis_device.c \
+	src/class/bth/bth_device.c \
+	src/class/printer/printer_device.c \
 	src/class/usbtmc/usbtmc_device.c \
 	src/class/vendor/vendor_device.c \
 	src/portable/$(VENDOR)/$(CHIP_FAMILY)/dcd_$(CHIP_FAMILY).c
@@ -107,6 +117,10 @@ size: $(BUILD)/$(BOARD)-firmware.elf
 	@$(SIZE) $<
 	-@echo ''
 
+# RAM and flash of each TinyUSB module with tusb_config.h of example, SYMBOLS=1 also lists RAM variables
+size-report: $(BUILD)/$(BOARD)-firmware.elf
+	@$(PYTHON) $(TOP)/tools/size_report.py $(if $(SYMBOLS),--symbols) --label $(BOARD) $<.map
+
 clean:
 	rm -rf $(BUILD)
 	
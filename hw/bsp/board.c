@@ -56,3 +56,115 @@ TU_ATTR_USED int _read (int fhdl, char *buf, size_t count)
   (void) fhdl;
   return board_uart_read((uint8_t*) buf, count);
 }
+
+//--------------------------------------------------------------------+
+// Timer
+//--------------------------------------------------------------------+
+#if defined(__ARM_ARCH_PROFILE) && (__ARM_ARCH_PROFILE == 'M')
+
+// Core registers common to all Cortex-M, to not depend on CMSIS header of the MCU
+#define SYST_CSR    (*((volatile uint32_t*) 0xE000E010UL))
+#define SYST_RVR    (*((volatile uint32_t*) 0xE000E014UL))
+#define SYST_CVR    (*((volatile uint32_t*) 0xE000E018UL))
+#define SCB_ICSR    (*((volatile uint32_t*) 0xE000ED04UL))
+
+#define SYST_CSR_ENABLE     (1UL << 0)
+#define SCB_ICSR_PENDSTSET  (1UL << 26)
+
+#if CFG_TUSB_OS == OPT_OS_NONE
+  #define BOARD_TICK()     board_millis()   // SysTick interrupt counts milliseconds
+  #define BOARD_TICK_US    1000UL
+#elif CFG_TUSB_OS == OPT_OS_FREERTOS
+  #define BOARD_TICK()     ((uint32_t) xTaskGetTickCount())
+  #define BOARD_TICK_US    (1000000UL / configTICK_RATE_HZ)
+#endif
+
+#ifdef BOARD_TICK
+// Tick count and SysTick cycles elapsed since, a wrap whose interrupt is still pending counts as a tick
+static bool systick_read(uint32_t* tick, uint32_t* elapsed)
+{
+  if ( !(SYST_CSR & SYST_CSR_ENABLE) ) return false;
+
+  uint32_t val;
+  bool pending;
+  do
+  {
+    *tick   = BOARD_TICK();
+    val     = SYST_CVR;
+    pending = (SCB_ICSR & SCB_ICSR_PENDSTSET) != 0;
+
+    // wrapped around before or after reading: value of reloaded counter goes with next tick
+    if ( pending ) val = SYST_CVR;
+  } while ( *tick != BOARD_TICK() );
+
+  if ( pending ) (*tick)++;
+  *elapsed = SYST_RVR - val;
+  return true;
+}
+#endif
+
+TU_ATTR_WEAK uint32_t board_micros(void)
+{
+#ifdef BOARD_TICK
+  uint32_t tick, elapsed;
+  if ( systick_read(&tick, &elapsed) )
+  {
+    uint32_t const cycles_per_us = (SYST_RVR + 1) / BOARD_TICK_US;
+    return tick*BOARD_TICK_US + (cycles_per_us ? elapsed / cycles_per_us : 0);
+  }
+#endif
+
+  return board_millis()*1000;
+}
+
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__) || defined(__ARM_ARCH_8M_MAIN__)
+
+#define DEMCR       (*((volatile uint32_t*) 0xE000EDFCUL))
+#define DWT_CTRL    (*((volatile uint32_t*) 0xE0001000UL))
+#define DWT_CYCCNT  (*((volatile uint32_t*) 0xE0001004UL))
+#define DWT_LAR     (*((volatile uint32_t*) 0xE0001FB0UL))
+
+#define DEMCR_TRCENA        (1UL << 24)
+#define DWT_CTRL_CYCCNTENA  (1UL << 0)
+
+// Counter is enabled on first use, it also runs without debugger
+TU_ATTR_WEAK uint32_t board_cycles(void)
+{
+  if ( !(DWT_CTRL & DWT_CTRL_CYCCNTENA) )
+  {
+    DEMCR   |= DEMCR_TRCENA;
+    DWT_LAR  = 0xC5ACCE55UL; // unlock, Cortex-M7
+    DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+  }
+
+  return DWT_CYCCNT;
+}
+
+#else
+
+// No DWT cycle counter on ARMv6-M/ARMv8-M baseline, SysTick is clocked by CPU on all supported boards
+TU_ATTR_WEAK uint32_t board_cycles(void)
+{
+#ifdef BOARD_TICK
+  uint32_t tick, elapsed;
+  if ( systick_read(&tick, &elapsed) ) return tick*(SYST_RVR + 1) + elapsed;
+#endif
+
+  return 0;
+}
+
+#endif
+
+#else
+
+TU_ATTR_WEAK uint32_t board_micros(void)
+{
+  return board_millis()*1000;
+}
+
+TU_ATTR_WEAK uint32_t board_cycles(void)
+{
+  return 0;
+}
+
+#endif
@@ -78,10 +78,29 @@ int board_uart_write(void const * buf, int len);
   {
     return os_time_ticks_to_ms32( os_time_get() );
   }
+#elif CFG_TUSB_OS == OPT_OS_ZEPHYR
+  static inline uint32_t board_millis(void)
+  {
+    return k_uptime_get_32();
+  }
+#elif CFG_TUSB_OS == OPT_OS_CMSIS_RTOS2
+  static inline uint32_t board_millis(void)
+  {
+    return (uint32_t) ( ( ((uint64_t) osKernelGetTickCount()) * 1000) / osKernelGetTickFreq() );
+  }
 #else
   #error "Need to implement board_millis() for this OS"
 #endif
 
+// Free running microsecond counter, wraps around like board_millis()*1000. Default (board.c) adds elapsed
+// part of current SysTick period to the tick count on Cortex-M (no OS and FreeRTOS), otherwise it has
+// millisecond resolution. Board with a better timer overrides it.
+uint32_t board_micros(void);
+
+// Free running count of CPU cycles for short intervals: DWT cycle counter on Cortex-M3/M4/M7/M33, SysTick
+// derived on Cortex-M0/M0+, 0 if none. Overridable by board
+uint32_t board_cycles(void);
+
 //--------------------------------------------------------------------+
 // Helper functions
 //--------------------------------------------------------------------+
@@ -103,3 +103,18 @@ uint32_t board_millis(void)
 
     return (((uint64_t)tp.tv_sec) * 1000 + tp.tv_nsec / 1000000);
 }
+
+// Get current microseconds
+uint32_t board_micros(void)
+{
+  struct timespec tp;
+
+  while (g_rtc_enabled == false);
+
+  if (clock_gettime(CLOCK_MONOTONIC, &tp))
+  {
+    return 0;
+  }
+
+  return (uint32_t) (((uint64_t)tp.tv_sec) * 1000000 + tp.tv_nsec / 1000);
+}
@@ -121,6 +121,10 @@ static void SystemClock_Config(void)
 
 void board_init(void)
 {
+  // Copy fast code (.ramfunc) to ITCM, before any USB interrupt
+  extern uint32_t _siitcm, _sitcm, _eitcm;
+  for(uint32_t *src = &_siitcm, *dst = &_sitcm; dst < &_eitcm; ) *dst++ = *src++;
+
   #if CFG_TUSB_OS  == OPT_OS_NONE
     // 1ms tick timer
     SysTick_Config(SystemCoreClock / 1000);
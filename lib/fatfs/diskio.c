@@ -38,6 +38,31 @@
 // TODO change it to portable init
 static DSTATUS disk_state[CFG_TUSB_HOST_DEVICE_MAX];
 
+// Sector cache for FAT and directory access, which FatFs does one sector at a time. A miss reads the
+// following sectors of the line in the same command (read-ahead). Single sector writes are held in cache
+// until CTRL_SYNC or eviction, consecutive dirty sectors of a line are then written in one command.
+#ifndef CFG_TUH_MSC_DISKIO_CACHE_LINES
+#define CFG_TUH_MSC_DISKIO_CACHE_LINES    2
+#endif
+
+#ifndef CFG_TUH_MSC_DISKIO_CACHE_SECTORS
+#define CFG_TUH_MSC_DISKIO_CACHE_SECTORS  4
+#endif
+
+TU_VERIFY_STATIC(CFG_TUH_MSC_DISKIO_CACHE_SECTORS <= 8, "sector bitmap is 8-bit");
+
+typedef struct
+{
+  uint8_t pdrv;
+  uint8_t valid; // bitmap of cached sectors, zero if line is free
+  uint8_t dirty; // bitmap of sectors not written to disk yet
+  uint8_t age;
+  DWORD   lba;   // first sector of line
+}disk_cache_line_t;
+
+static disk_cache_line_t disk_cache[CFG_TUH_MSC_DISKIO_CACHE_LINES];
+CFG_TUSB_MEM_SECTION TU_ATTR_ALIGNED(4) static uint8_t disk_cache_buf[CFG_TUH_MSC_DISKIO_CACHE_LINES][CFG_TUH_MSC_DISKIO_CACHE_SECTORS*_MAX_SS];
+
 //--------------------------------------------------------------------+
 // INTERNAL OBJECT & FUNCTION DECLARATION
 //--------------------------------------------------------------------+
@@ -59,9 +84,101 @@ static DRESULT wait_for_io_complete(uint8_t usb_addr)
   return RES_OK;
 }
 
+static DRESULT disk_xfer(BYTE pdrv, bool is_read, BYTE* buff, DWORD sector, uint16_t count)
+{
+  uint8_t usb_addr = pdrv+1;
+
+  tusb_error_t const err = is_read ? tuh_msc_read10 (usb_addr, 0, buff, sector, count) :
+                                     tuh_msc_write10(usb_addr, 0, buff, sector, count);
+  if ( TUSB_ERROR_NONE != err ) return RES_ERROR;
+
+  return wait_for_io_complete(usb_addr);
+}
+
+static inline uint8_t sector_mask(uint8_t first, uint8_t count)
+{
+  return (uint8_t) (((1u << count) - 1) << first);
+}
+
+// Cache is only used when device block matches FatFs sector
+static bool cache_usable(BYTE pdrv, uint32_t* p_last_lba)
+{
+  uint32_t block_size;
+  return (TUSB_ERROR_NONE == tuh_msc_get_capacity(pdrv+1, p_last_lba, &block_size)) && (block_size == _MAX_SS);
+}
+
+static disk_cache_line_t* cache_find(BYTE pdrv, DWORD sector)
+{
+  for(uint8_t i=0; i<CFG_TUH_MSC_DISKIO_CACHE_LINES; i++)
+  {
+    disk_cache_line_t* line = &disk_cache[i];
+    if ( line->valid && line->pdrv == pdrv && (sector - line->lba) < CFG_TUH_MSC_DISKIO_CACHE_SECTORS ) return line;
+  }
+  return NULL;
+}
+
+static inline uint8_t* cache_sector(disk_cache_line_t const* line, DWORD sector)
+{
+  return disk_cache_buf[line - disk_cache] + (sector - line->lba)*_MAX_SS;
+}
+
+static void cache_touch(disk_cache_line_t* line)
+{
+  for(uint8_t i=0; i<CFG_TUH_MSC_DISKIO_CACHE_LINES; i++)
+  {
+    if ( disk_cache[i].age < UINT8_MAX ) disk_cache[i].age++;
+  }
+  line->age = 0;
+}
+
+static DRESULT cache_flush_line(disk_cache_line_t* line)
+{
+  uint8_t i = 0;
+  while ( line->dirty )
+  {
+    if ( !(line->dirty & TU_BIT(i)) )
+    {
+      i++;
+      continue;
+    }
+
+    // run of consecutive dirty sectors
+    uint8_t n = 1;
+    while ( (i+n < CFG_TUH_MSC_DISKIO_CACHE_SECTORS) && (line->dirty & TU_BIT(i+n)) ) n++;
+
+    DRESULT const res = disk_xfer(line->pdrv, false, disk_cache_buf[line - disk_cache] + i*_MAX_SS, line->lba + i, n);
+    if ( RES_OK != res ) return res;
+
+    line->dirty &= (uint8_t) ~sector_mask(i, n);
+    i = (uint8_t) (i + n);
+  }
+
+  return RES_OK;
+}
+
+// Free line or least recently used one, which is written back if dirty
+static disk_cache_line_t* cache_alloc(BYTE pdrv, DWORD sector)
+{
+  disk_cache_line_t* victim = &disk_cache[0];
+  for(uint8_t i=0; i<CFG_TUH_MSC_DISKIO_CACHE_LINES && victim->valid; i++)
+  {
+    if ( !disk_cache[i].valid || disk_cache[i].age > victim->age ) victim = &disk_cache[i];
+  }
+
+  if ( RES_OK != cache_flush_line(victim) ) return NULL;
+
+  victim->pdrv  = pdrv;
+  victim->lba   = sector;
+  victim->valid = 0;
+  victim->dirty = 0;
+
+  return victim;
+}
+
 void diskio_init(void)
 {
   memset(disk_state, STA_NOINIT, CFG_TUSB_HOST_DEVICE_MAX);
+  memset(disk_cache, 0, sizeof(disk_cache));
 }
 
 //pdrv Specifies the physical drive number.
@@ -74,6 +191,12 @@ DSTATUS disk_initialize ( BYTE pdrv )
 void disk_deinitialize ( BYTE pdrv )
 {
   disk_state[pdrv] |= STA_NOINIT; // set NOINIT bit
+
+  // device is gone, drop its cached sectors
+  for(uint8_t i=0; i<CFG_TUH_MSC_DISKIO_CACHE_LINES; i++)
+  {
+    if ( disk_cache[i].pdrv == pdrv ) disk_cache[i].valid = disk_cache[i].dirty = 0;
+  }
 }
 
 DSTATUS disk_status (BYTE pdrv)
@@ -92,21 +215,92 @@ DSTATUS disk_status (BYTE pdrv)
 //    must not be split into single sector transactions to the device, or you may not get good read performance.
 DRESULT disk_read (BYTE pdrv, BYTE*buff, DWORD sector, BYTE count)
 {
-  uint8_t usb_addr = pdrv+1;
+  uint32_t last_lba;
+
+  if ( count == 1 && cache_usable(pdrv, &last_lba) )
+  {
+    disk_cache_line_t* line = cache_find(pdrv, sector);
+
+    if ( !line )
+    {
+      // read-ahead the rest of line
+      line = cache_alloc(pdrv, sector);
+      if ( !line ) return RES_ERROR;
+
+      uint8_t const n = (uint8_t) tu_min32(CFG_TUH_MSC_DISKIO_CACHE_SECTORS, last_lba - sector + 1);
+      if ( RES_OK != disk_xfer(pdrv, true, cache_sector(line, sector), sector, n) ) return RES_ERROR;
+      line->valid = sector_mask(0, n);
+    }
+    else if ( !(line->valid & TU_BIT(sector - line->lba)) )
+    {
+      if ( RES_OK != disk_xfer(pdrv, true, cache_sector(line, sector), sector, 1) ) return RES_ERROR;
+      line->valid |= TU_BIT(sector - line->lba);
+    }
+
+    memcpy(buff, cache_sector(line, sector), _MAX_SS);
+    cache_touch(line);
+
+    return RES_OK;
+  }
+
+  if ( RES_OK != disk_xfer(pdrv, true, buff, sector, count) ) return RES_ERROR;
+
+  // sectors written to cache only are newer than disk
+  for(uint8_t i=0; i<CFG_TUH_MSC_DISKIO_CACHE_LINES; i++)
+  {
+    disk_cache_line_t const* line = &disk_cache[i];
+    if ( !line->dirty || line->pdrv != pdrv ) continue;
 
-	if ( TUSB_ERROR_NONE != tuh_msc_read10(usb_addr, 0, buff, sector, count) )		return RES_ERROR;
+    for(uint8_t s=0; s<CFG_TUH_MSC_DISKIO_CACHE_SECTORS; s++)
+    {
+      DWORD const lba = line->lba + s;
+      if ( (line->dirty & TU_BIT(s)) && (lba - sector) < count ) memcpy(buff + (lba - sector)*_MAX_SS, cache_sector(line, lba), _MAX_SS);
+    }
+  }
 
-	return wait_for_io_complete(usb_addr);
+  return RES_OK;
 }
 
 
 DRESULT disk_write (BYTE pdrv, const BYTE* buff, DWORD sector, BYTE count)
 {
-  uint8_t usb_addr = pdrv+1;
+  uint32_t last_lba;
+
+  if ( count == 1 && cache_usable(pdrv, &last_lba) )
+  {
+    // write-behind
+    disk_cache_line_t* line = cache_find(pdrv, sector);
+    if ( !line ) line = cache_alloc(pdrv, sector);
+    if ( !line ) return RES_ERROR;
+
+    memcpy(cache_sector(line, sector), buff, _MAX_SS);
+    line->valid |= TU_BIT(sector - line->lba);
+    line->dirty |= TU_BIT(sector - line->lba);
+    cache_touch(line);
+
+    return RES_OK;
+  }
+
+  if ( RES_OK != disk_xfer(pdrv, false, (BYTE*) buff, sector, count) ) return RES_ERROR;
 
-	if ( TUSB_ERROR_NONE != tuh_msc_write10(usb_addr, 0, buff, sector, count) )		return RES_ERROR;
+  // keep cached sectors in sync, they are now clean
+  for(uint8_t i=0; i<CFG_TUH_MSC_DISKIO_CACHE_LINES; i++)
+  {
+    disk_cache_line_t* line = &disk_cache[i];
+    if ( !line->valid || line->pdrv != pdrv ) continue;
 
-	return wait_for_io_complete(usb_addr);
+    for(uint8_t s=0; s<CFG_TUH_MSC_DISKIO_CACHE_SECTORS; s++)
+    {
+      DWORD const lba = line->lba + s;
+      if ( (line->valid & TU_BIT(s)) && (lba - sector) < count )
+      {
+        memcpy(cache_sector(line, lba), buff + (lba - sector)*_MAX_SS, _MAX_SS);
+        line->dirty &= (uint8_t) ~TU_BIT(s);
+      }
+    }
+  }
+
+  return RES_OK;
 }
 
 /* [IN] Drive number */
@@ -114,9 +308,16 @@ DRESULT disk_write (BYTE pdrv, const BYTE* buff, DWORD sector, BYTE count)
 /* [I/O] Parameter and data buffer */
 DRESULT disk_ioctl (BYTE pdrv, BYTE cmd, void* buff)
 {
-  (void) buff; (void) pdrv; // compiler warnings
+  (void) buff; // compiler warnings
 
   if (cmd != CTRL_SYNC) return RES_ERROR;
+
+  // write back cached sectors
+  for(uint8_t i=0; i<CFG_TUH_MSC_DISKIO_CACHE_LINES; i++)
+  {
+    if ( disk_cache[i].pdrv == pdrv && RES_OK != cache_flush_line(&disk_cache[i]) ) return RES_ERROR;
+  }
+
   return RES_OK;
 }
 
@@ -26,7 +26,7 @@
 
 /** \ingroup group_class
  *  \defgroup ClassDriver_Audio Audio
- *            Currently only MIDI subclass is supported
+ *            MIDI subclass and Audio Class 2.0 streaming are supported
  *  @{ */
 
 #ifndef _TUSB_AUDIO_H__
@@ -41,7 +41,8 @@
 /// Audio Interface Subclass Codes
 typedef enum
 {
-  AUDIO_SUBCLASS_CONTROL = 0x01  , ///< Audio Control
+  AUDIO_SUBCLASS_UNDEFINED = 0x00, ///< Audio Function (Interface Association)
+  AUDIO_SUBCLASS_CONTROL         , ///< Audio Control
   AUDIO_SUBCLASS_STREAMING       , ///< Audio Streaming
   AUDIO_SUBCLASS_MIDI_STREAMING  , ///< MIDI Streaming
 } audio_subclass_type_t;
@@ -89,6 +90,110 @@ typedef enum
   AUDIO_CS_INTERFACE_SAMPLE_RATE_CONVERTER = 0x0D,
 } audio_cs_interface_subtype_t;
 
+/// Audio Class-Specific AS Interface Descriptor Subtypes
+typedef enum
+{
+  AUDIO_CS_AS_INTERFACE_AS_GENERAL         = 0x01,
+  AUDIO_CS_AS_INTERFACE_FORMAT_TYPE        = 0x02,
+  AUDIO_CS_AS_INTERFACE_ENCODER            = 0x03,
+  AUDIO_CS_AS_INTERFACE_DECODER            = 0x04,
+} audio_cs_as_interface_subtype_t;
+
+/// Audio Class-Specific Endpoint Descriptor Subtypes
+typedef enum
+{
+  AUDIO_CS_EP_SUBTYPE_GENERAL              = 0x01,
+} audio_cs_ep_subtype_t;
+
+/// Audio Format Type Codes
+typedef enum
+{
+  AUDIO_FORMAT_TYPE_I                      = 0x01,
+  AUDIO_FORMAT_TYPE_II                     = 0x02,
+  AUDIO_FORMAT_TYPE_III                    = 0x03,
+} audio_format_type_t;
+
+/// Audio Data Format Type I bitmap (bmFormats)
+typedef enum
+{
+  AUDIO_DATA_FORMAT_TYPE_I_PCM             = TU_BIT(0),
+  AUDIO_DATA_FORMAT_TYPE_I_PCM8            = TU_BIT(1),
+  AUDIO_DATA_FORMAT_TYPE_I_IEEE_FLOAT      = TU_BIT(2),
+} audio_data_format_type_I_t;
+
+/// Audio Terminal Types
+typedef enum
+{
+  AUDIO_TERM_TYPE_USB_STREAMING            = 0x0101,
+  AUDIO_TERM_TYPE_IN_GENERIC_MIC           = 0x0201,
+  AUDIO_TERM_TYPE_OUT_GENERIC_SPEAKER      = 0x0301,
+  AUDIO_TERM_TYPE_OUT_HEADPHONES           = 0x0302,
+} audio_terminal_type_t;
+
+/// Audio Class 2.0 Clock Source bmAttributes
+typedef enum
+{
+  AUDIO_CLOCK_SOURCE_ATT_EXT_CLK           = 0x00,
+  AUDIO_CLOCK_SOURCE_ATT_INT_FIX_CLK       = 0x01,
+  AUDIO_CLOCK_SOURCE_ATT_INT_VAR_CLK       = 0x02,
+  AUDIO_CLOCK_SOURCE_ATT_INT_PRO_CLK       = 0x03,
+  AUDIO_CLOCK_SOURCE_ATT_CLK_SYC_SOF       = 0x04,
+} audio_clock_source_attribute_t;
+
+/// Audio Class 2.0 Control capability, 2 bits per control in bmControls
+typedef enum
+{
+  AUDIO_CTRL_NONE                          = 0x00, ///< Not present
+  AUDIO_CTRL_R                             = 0x01, ///< Host read only
+  AUDIO_CTRL_RW                            = 0x03, ///< Host read & write
+} audio_control_t;
+
+/// Audio Class 2.0 Class-Specific Request Codes
+typedef enum
+{
+  AUDIO_CS_REQ_CUR                         = 0x01,
+  AUDIO_CS_REQ_RANGE                       = 0x02,
+  AUDIO_CS_REQ_MEM                         = 0x03,
+} audio_cs_req_t;
+
+/// Audio Class 2.0 Clock Source Control Selectors
+typedef enum
+{
+  AUDIO_CS_CTRL_SAM_FREQ                   = 0x01,
+  AUDIO_CS_CTRL_CLK_VALID                  = 0x02,
+} audio_clock_src_control_selector_t;
+
+/// Audio Class 2.0 Feature Unit Control Selectors
+typedef enum
+{
+  AUDIO_FU_CTRL_MUTE                       = 0x01,
+  AUDIO_FU_CTRL_VOLUME                     = 0x02,
+} audio_feature_unit_control_selector_t;
+
+/// Audio Class 1.0 Request Codes
+typedef enum
+{
+  AUDIO10_REQ_SET_CUR                      = 0x01,
+  AUDIO10_REQ_GET_CUR                      = 0x81,
+  AUDIO10_REQ_GET_MIN                      = 0x82,
+  AUDIO10_REQ_GET_MAX                      = 0x83,
+  AUDIO10_REQ_GET_RES                      = 0x84,
+} audio10_req_t;
+
+/// Audio Class 1.0 Endpoint Control Selectors
+typedef enum
+{
+  AUDIO10_EP_CTRL_SAMPLING_FREQ            = 0x01,
+  AUDIO10_EP_CTRL_PITCH                    = 0x02,
+} audio10_ep_control_selector_t;
+
+/// Audio Class 1.0 Class-Specific Isochronous Endpoint bmAttributes
+typedef enum
+{
+  AUDIO10_EP_ATT_SAMPLING_FREQ             = TU_BIT(0),
+  AUDIO10_EP_ATT_PITCH                     = TU_BIT(1),
+} audio10_ep_attribute_t;
+
 /** @} */
 
 #ifdef __cplusplus
@@ -0,0 +1,309 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#include <string.h>
+#include "audio_convert.h"
+
+//--------------------------------------------------------------------+
+// MACRO CONSTANT TYPEDEF
+//--------------------------------------------------------------------+
+
+// Word at a time conversion of little endian USB data, buffers may be unaligned
+#define AUDIO_CONVERT_WORD   (TU_BYTE_ORDER == TU_LITTLE_ENDIAN)
+
+#if defined(__GNUC__) && defined(__ARM_FEATURE_DSP) && __ARM_FEATURE_DSP
+  #define AUDIO_CONVERT_DSP  1
+#else
+  #define AUDIO_CONVERT_DSP  0
+#endif
+
+static inline uint32_t load32(void const* p)
+{
+  uint32_t value;
+  memcpy(&value, p, 4);
+  return value;
+}
+
+static inline void store32(void* p, uint32_t value)
+{
+  memcpy(p, &value, 4);
+}
+
+static inline int16_t sat16(int32_t value)
+{
+  return (int16_t) ((value > INT16_MAX) ? INT16_MAX : (value < INT16_MIN) ? INT16_MIN : value);
+}
+
+static inline int32_t sat32(int64_t value)
+{
+  return (int32_t) ((value > INT32_MAX) ? INT32_MAX : (value < INT32_MIN) ? INT32_MIN : value);
+}
+
+#if AUDIO_CONVERT_DSP
+
+// (a * bottom/top halfword of b) >> 16, saturate to 16 bit, pack two halfwords
+static inline int32_t dsp_smulwb(int32_t a, uint32_t b)
+{
+  int32_t r;
+  __asm ("smulwb %0, %1, %2" : "=r" (r) : "r" (a), "r" (b));
+  return r;
+}
+
+static inline int32_t dsp_smulwt(int32_t a, uint32_t b)
+{
+  int32_t r;
+  __asm ("smulwt %0, %1, %2" : "=r" (r) : "r" (a), "r" (b));
+  return r;
+}
+
+static inline int32_t dsp_ssat16(int32_t a)
+{
+  int32_t r;
+  __asm ("ssat %0, #16, %1" : "=r" (r) : "r" (a));
+  return r;
+}
+
+static inline uint32_t dsp_pkhbt(int32_t bottom, int32_t top)
+{
+  uint32_t r;
+  __asm ("pkhbt %0, %1, %2, lsl #16" : "=r" (r) : "r" (bottom), "r" (top));
+  return r;
+}
+
+#endif
+
+//--------------------------------------------------------------------+
+// Sample format
+//--------------------------------------------------------------------+
+void tu_audio_unpack_s24(int32_t* dst, uint8_t const* src, uint32_t count)
+{
+#if AUDIO_CONVERT_WORD
+  // 4 samples in 3 words
+  for ( ; count >= 4; count -= 4, src += 12, dst += 4 )
+  {
+    uint32_t const w0 = load32(src);
+    uint32_t const w1 = load32(src + 4);
+    uint32_t const w2 = load32(src + 8);
+
+    dst[0] = (int32_t) (w0 << 8);
+    dst[1] = (int32_t) ((w1 << 16) | ((w0 >> 16) & 0xFF00UL));
+    dst[2] = (int32_t) ((w2 << 24) | ((w1 >> 8) & 0xFFFF00UL));
+    dst[3] = (int32_t) (w2 & 0xFFFFFF00UL);
+  }
+#endif
+
+  for ( ; count; count--, src += 3 )
+  {
+    *dst++ = (int32_t) (((uint32_t) src[2] << 24) | ((uint32_t) src[1] << 16) | ((uint32_t) src[0] << 8));
+  }
+}
+
+void tu_audio_pack_s24(uint8_t* dst, int32_t const* src, uint32_t count)
+{
+#if AUDIO_CONVERT_WORD
+  for ( ; count >= 4; count -= 4, src += 4, dst += 12 )
+  {
+    uint32_t const s0 = (uint32_t) src[0];
+    uint32_t const s1 = (uint32_t) src[1];
+    uint32_t const s2 = (uint32_t) src[2];
+    uint32_t const s3 = (uint32_t) src[3];
+
+    store32(dst    , (s0 >> 8)  | ((s1 & 0xFF00UL) << 16));
+    store32(dst + 4, (s1 >> 16) | ((s2 & 0xFFFF00UL) << 8));
+    store32(dst + 8, (s2 >> 24) | (s3 & 0xFFFFFF00UL));
+  }
+#endif
+
+  for ( ; count; count--, dst += 3 )
+  {
+    uint32_t const s = (uint32_t) (*src++);
+    dst[0] = (uint8_t) (s >> 8);
+    dst[1] = (uint8_t) (s >> 16);
+    dst[2] = (uint8_t) (s >> 24);
+  }
+}
+
+void tu_audio_s16_to_s32(int32_t* dst, int16_t const* src, uint32_t count)
+{
+#if AUDIO_CONVERT_WORD
+  for ( ; count >= 2; count -= 2, src += 2, dst += 2 )
+  {
+    uint32_t const w = load32(src);
+    dst[0] = (int32_t) (w << 16);
+    dst[1] = (int32_t) (w & 0xFFFF0000UL);
+  }
+#endif
+
+  for ( ; count; count-- ) *dst++ = (int32_t) ((uint32_t) (uint16_t) (*src++) << 16);
+}
+
+void tu_audio_s32_to_s16(int16_t* dst, int32_t const* src, uint32_t count)
+{
+#if AUDIO_CONVERT_WORD
+  for ( ; count >= 2; count -= 2, src += 2, dst += 2 )
+  {
+    store32(dst, ((uint32_t) src[0] >> 16) | ((uint32_t) src[1] & 0xFFFF0000UL));
+  }
+#endif
+
+  for ( ; count; count-- ) *dst++ = (int16_t) ((*src++) >> 16);
+}
+
+//--------------------------------------------------------------------+
+// Channel layout
+//--------------------------------------------------------------------+
+void tu_audio_deinterleave_s16(int16_t* const* dst, int16_t const* src, uint8_t channels, uint32_t frames)
+{
+  uint32_t i = 0;
+
+#if AUDIO_CONVERT_WORD
+  // Stereo: 2 frames of L|R words give one L and one R word
+  if ( channels == 2 )
+  {
+    for ( ; i + 2 <= frames; i += 2, src += 4 )
+    {
+      uint32_t const w0 = load32(src);
+      uint32_t const w1 = load32(src + 2);
+      store32(dst[0] + i, (w0 & 0xFFFFUL) | (w1 << 16));
+      store32(dst[1] + i, (w0 >> 16) | (w1 & 0xFFFF0000UL));
+    }
+  }
+#endif
+
+  for ( ; i < frames; i++ )
+  {
+    for ( uint8_t ch = 0; ch < channels; ch++ ) dst[ch][i] = *src++;
+  }
+}
+
+void tu_audio_interleave_s16(int16_t* dst, int16_t const* const* src, uint8_t channels, uint32_t frames)
+{
+  uint32_t i = 0;
+
+#if AUDIO_CONVERT_WORD
+  if ( channels == 2 )
+  {
+    for ( ; i + 2 <= frames; i += 2, dst += 4 )
+    {
+      uint32_t const l = load32(src[0] + i);
+      uint32_t const r = load32(src[1] + i);
+      store32(dst    , (l & 0xFFFFUL) | (r << 16));
+      store32(dst + 2, (l >> 16) | (r & 0xFFFF0000UL));
+    }
+  }
+#endif
+
+  for ( ; i < frames; i++ )
+  {
+    for ( uint8_t ch = 0; ch < channels; ch++ ) *dst++ = src[ch][i];
+  }
+}
+
+void tu_audio_deinterleave_s32(int32_t* const* dst, int32_t const* src, uint8_t channels, uint32_t frames)
+{
+  if ( channels == 2 )
+  {
+    int32_t* left  = dst[0];
+    int32_t* right = dst[1];
+    for ( uint32_t i = 0; i < frames; i++, src += 2 )
+    {
+      left[i]  = src[0];
+      right[i] = src[1];
+    }
+    return;
+  }
+
+  for ( uint32_t i = 0; i < frames; i++ )
+  {
+    for ( uint8_t ch = 0; ch < channels; ch++ ) dst[ch][i] = *src++;
+  }
+}
+
+void tu_audio_interleave_s32(int32_t* dst, int32_t const* const* src, uint8_t channels, uint32_t frames)
+{
+  if ( channels == 2 )
+  {
+    int32_t const* left  = src[0];
+    int32_t const* right = src[1];
+    for ( uint32_t i = 0; i < frames; i++, dst += 2 )
+    {
+      dst[0] = left[i];
+      dst[1] = right[i];
+    }
+    return;
+  }
+
+  for ( uint32_t i = 0; i < frames; i++ )
+  {
+    for ( uint8_t ch = 0; ch < channels; ch++ ) *dst++ = src[ch][i];
+  }
+}
+
+//--------------------------------------------------------------------+
+// Gain & volume
+//--------------------------------------------------------------------+
+void tu_audio_gain_s16(int16_t* buf, uint32_t count, int32_t gain)
+{
+#if AUDIO_CONVERT_DSP
+  // 2 samples per word: 2 multiplies, 2 saturations and a pack
+  for ( ; count >= 2; count -= 2, buf += 2 )
+  {
+    uint32_t const w = load32(buf);
+    store32(buf, dsp_pkhbt(dsp_ssat16(dsp_smulwb(gain, w)), dsp_ssat16(dsp_smulwt(gain, w))));
+  }
+#endif
+
+  for ( ; count; count--, buf++ )
+  {
+    *buf = sat16((int32_t) (((int64_t) gain * (*buf)) >> 16));
+  }
+}
+
+void tu_audio_gain_s32(int32_t* buf, uint32_t count, int32_t gain)
+{
+  for ( ; count; count--, buf++ )
+  {
+    *buf = sat32(((int64_t) gain * (*buf)) >> 16);
+  }
+}
+
+int32_t tu_audio_volume_to_gain(int16_t volume)
+{
+  if ( volume == INT16_MIN ) return 0;
+
+  // log2 of gain in 16.16: volume/256 dB * log2(10)/20
+  int32_t const log2_gain = ((int32_t) volume * 43541) / 1024;
+  int32_t const exp  = log2_gain >> 16;
+  uint32_t const frac = (uint32_t) log2_gain & 0xFFFFu;
+
+  // 2^frac ~ 1 + frac*(0.6565 + 0.3435*frac) in 16.16
+  uint32_t const mantissa = 0x10000u + ((frac * (43024u + ((frac * 22512u) >> 16))) >> 16);
+
+  if ( exp >= 15 ) return INT32_MAX;
+  if ( exp <= -18 ) return 0;
+
+  return (int32_t) ((exp >= 0) ? (mantissa << exp) : (mantissa >> (-exp)));
+}
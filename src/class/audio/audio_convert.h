@@ -0,0 +1,76 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#ifndef _TUSB_AUDIO_CONVERT_H_
+#define _TUSB_AUDIO_CONVERT_H_
+
+#include "common/tusb_common.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/** \addtogroup ClassDriver_Audio
+ *  @{
+ *  \defgroup   Audio_Convert Sample Conversion
+ *  Conversion between USB audio payloads and application (DSP/I2S) layouts.
+ *  Counts are in samples (of one channel) unless noted. Cortex-M4/M7 use DSP instructions
+ *  when buffers are word aligned, other MCUs and unaligned buffers use portable C.
+ *  @{ */
+
+// Unity gain of tu_audio_gain_*() in 16.16 fixed point
+#define TU_AUDIO_GAIN_UNITY    0x10000L
+
+// 3-byte little endian USB samples to/from left-justified 32-bit samples
+void tu_audio_unpack_s24(int32_t* dst, uint8_t const* src, uint32_t count);
+void tu_audio_pack_s24  (uint8_t* dst, int32_t const* src, uint32_t count);
+
+// 16-bit to/from left-justified 32-bit samples, 32 to 16 bit truncates
+void tu_audio_s16_to_s32(int32_t* dst, int16_t const* src, uint32_t count);
+void tu_audio_s32_to_s16(int16_t* dst, int32_t const* src, uint32_t count);
+
+// Split interleaved audio frames into one buffer of 'frames' samples per channel and back
+void tu_audio_deinterleave_s16(int16_t* const* dst, int16_t const* src, uint8_t channels, uint32_t frames);
+void tu_audio_interleave_s16  (int16_t* dst, int16_t const* const* src, uint8_t channels, uint32_t frames);
+void tu_audio_deinterleave_s32(int32_t* const* dst, int32_t const* src, uint8_t channels, uint32_t frames);
+void tu_audio_interleave_s32  (int32_t* dst, int32_t const* const* src, uint8_t channels, uint32_t frames);
+
+// Scale samples in place by gain in 16.16 fixed point, result is saturated
+void tu_audio_gain_s16(int16_t* buf, uint32_t count, int32_t gain);
+void tu_audio_gain_s32(int32_t* buf, uint32_t count, int32_t gain);
+
+// Feature unit volume (1/256 dB, 0x8000 is silence) to gain of tu_audio_gain_*(),
+// accurate to about 0.02 dB and limited to +90 dB
+int32_t tu_audio_volume_to_gain(int16_t volume);
+
+/** @} */
+/** @} */
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif /* _TUSB_AUDIO_CONVERT_H_ */
@@ -0,0 +1,709 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#include "tusb_option.h"
+
+#if (TUSB_OPT_DEVICE_ENABLED && CFG_TUD_AUDIO)
+
+#include "audio_device.h"
+#include "device/usbd_pvt.h"
+
+//--------------------------------------------------------------------+
+// MACRO CONSTANT TYPEDEF
+//--------------------------------------------------------------------+
+
+// Explicit feedback is samples per frame in 10.14 format on 3 bytes at full speed,
+// samples per microframe in 16.16 format on 4 bytes at high speed
+#define AUDIOD_FRAMES_PER_SEC(_rhport)  (TUD_OPT_RHPORT_HIGH_SPEED(_rhport) ? 8000 : 1000)
+#define AUDIOD_FB_LEN(_rhport)          (TUD_OPT_RHPORT_HIGH_SPEED(_rhport) ? 4 : 3)
+
+// Feedback regulation on RX FIFO level: 1/1024 sample per (micro)frame for each audio frame
+// off half full, limited to 1/8 sample
+#define AUDIOD_FB_GAIN            (1L << 6)
+#define AUDIOD_FB_MAX_CORRECTION  (1L << 13)
+
+// Endpoint usage type of explicit feedback
+#define AUDIOD_EP_USAGE_FEEDBACK  1
+
+typedef struct
+{
+  uint8_t  itf_num;
+  uint8_t  alt;             // 0 is the zero bandwidth setting i.e not streaming
+  uint8_t  ep_data;         // 0 if function has no streaming interface of this direction
+  uint8_t  ep_fb;           // OUT only: explicit feedback of asynchronous mode
+
+  uint16_t ep_size;
+  uint16_t frame_size;      // bytes of one sample of all channels
+  uint16_t packets_per_sec;
+} audiod_stream_t;
+
+typedef struct
+{
+  uint8_t rhport;
+  uint8_t itf_num;          // audio control interface
+  uint8_t clock_id;
+
+  // Streaming interfaces with all their alternate settings, parsed again by SET_INTERFACE
+  uint8_t const* as_desc;
+  uint16_t as_len;
+
+  audiod_stream_t rx;
+  audiod_stream_t tx;
+
+  uint32_t sample_rate;
+  uint32_t fb_nominal;      // sample rate per (micro)frame in 16.16
+  uint32_t fb_app;          // set by application, 0 for regulation on RX FIFO level
+  uint32_t tx_acc;          // remainder of frames per packet computation
+
+  tud_audio_stats_t stats;
+
+  bool sof_on;              // SOF requested while a stream is active
+
+  /*------------- From this point, data is not cleared by bus reset -------------*/
+  tu_fifo_t rx_ff;
+  tu_fifo_t tx_ff;
+
+#if CFG_TUD_AUDIO_EP_OUT_SIZE
+  uint8_t rx_ff_buf[CFG_TUD_AUDIO_RX_FIFO_SIZE];
+  CFG_TUSB_MEM_ALIGN uint8_t epout_buf[CFG_TUD_AUDIO_EP_OUT_SIZE];
+  CFG_TUSB_MEM_ALIGN uint8_t fb_buf[4];
+#endif
+
+#if CFG_TUD_AUDIO_EP_IN_SIZE
+  uint8_t tx_ff_buf[CFG_TUD_AUDIO_TX_FIFO_SIZE];
+  CFG_TUSB_MEM_ALIGN uint8_t epin_buf[CFG_TUD_AUDIO_EP_IN_SIZE];
+#endif
+
+  CFG_TUSB_MEM_ALIGN uint8_t ctrl_buf[CFG_TUD_AUDIO_CTRL_BUFSIZE];
+} audiod_interface_t;
+
+#define ITF_MEM_RESET_SIZE   offsetof(audiod_interface_t, rx_ff)
+
+TU_VERIFY_STATIC(CFG_TUD_AUDIO_CTRL_BUFSIZE >= 14, "Control buffer must hold RANGE of a sample rate");
+
+//--------------------------------------------------------------------+
+// INTERNAL OBJECT & FUNCTION DECLARATION
+//--------------------------------------------------------------------+
+CFG_TUSB_MEM_SECTION static audiod_interface_t _audiod_itf;
+
+static void set_sample_rate(audiod_interface_t* p_audio, uint32_t sample_rate)
+{
+  uint32_t const fb_nominal = (uint32_t) ((((uint64_t) sample_rate) << 16) / AUDIOD_FRAMES_PER_SEC(p_audio->rhport));
+
+  // also used by endpoint isr
+  dcd_int_disable(p_audio->rhport);
+  p_audio->sample_rate = sample_rate;
+  p_audio->fb_nominal  = fb_nominal;
+  p_audio->tx_acc      = 0;
+  dcd_int_enable(p_audio->rhport);
+}
+
+static audiod_stream_t* get_stream(audiod_interface_t* p_audio, uint8_t itf_num)
+{
+  if ( p_audio->rx.ep_data && p_audio->rx.itf_num == itf_num ) return &p_audio->rx;
+  if ( p_audio->tx.ep_data && p_audio->tx.itf_num == itf_num ) return &p_audio->tx;
+  return NULL;
+}
+
+static inline bool is_as_desc_type(uint8_t desc_type)
+{
+  return (desc_type == TUSB_DESC_CS_INTERFACE) || (desc_type == TUSB_DESC_ENDPOINT) || (desc_type == TUSB_DESC_CS_ENDPOINT);
+}
+
+//------------- OUT streaming -------------//
+#if CFG_TUD_AUDIO_EP_OUT_SIZE
+
+static void rx_packet(audiod_interface_t* p_audio, uint32_t xferred_bytes)
+{
+  // Drop whole packet rather than part of an audio frame
+  if ( tu_fifo_remaining(&p_audio->rx_ff) < xferred_bytes )
+  {
+    p_audio->stats.rx_overrun++;
+  }
+  else
+  {
+    tu_fifo_write_n(&p_audio->rx_ff, p_audio->epout_buf, (tu_fifo_idx_t) xferred_bytes);
+  }
+}
+
+static void fb_send(audiod_interface_t* p_audio)
+{
+  uint32_t fb = p_audio->fb_app;
+
+  if ( !fb )
+  {
+    // Ask host for more samples when RX FIFO is below half full, less when above
+    int32_t const half  = (int32_t) (tu_fifo_depth(&p_audio->rx_ff) / 2 / p_audio->rx.frame_size);
+    int32_t const level = (int32_t) (tu_fifo_count(&p_audio->rx_ff) / p_audio->rx.frame_size);
+
+    int32_t correction = (half - level) * AUDIOD_FB_GAIN;
+    if ( correction >  AUDIOD_FB_MAX_CORRECTION ) correction =  AUDIOD_FB_MAX_CORRECTION;
+    if ( correction < -AUDIOD_FB_MAX_CORRECTION ) correction = -AUDIOD_FB_MAX_CORRECTION;
+
+    fb = (uint32_t) ((int32_t) p_audio->fb_nominal + correction);
+  }
+
+  if ( !TUD_OPT_RHPORT_HIGH_SPEED(p_audio->rhport) ) fb >>= 2; // 16.16 to 10.14
+
+  p_audio->fb_buf[0] = (uint8_t) fb;
+  p_audio->fb_buf[1] = (uint8_t) (fb >> 8);
+  p_audio->fb_buf[2] = (uint8_t) (fb >> 16);
+  p_audio->fb_buf[3] = (uint8_t) (fb >> 24);
+
+  usbd_edpt_xfer(p_audio->rhport, p_audio->rx.ep_fb, p_audio->fb_buf, AUDIOD_FB_LEN(p_audio->rhport));
+}
+
+static void rx_start(audiod_interface_t* p_audio)
+{
+  uint8_t const rhport = p_audio->rhport;
+
+  if ( !usbd_edpt_busy(rhport, p_audio->rx.ep_data) )
+  {
+    usbd_edpt_xfer(rhport, p_audio->rx.ep_data, p_audio->epout_buf, p_audio->rx.ep_size);
+  }
+
+  if ( p_audio->rx.ep_fb && !usbd_edpt_busy(rhport, p_audio->rx.ep_fb) ) fb_send(p_audio);
+}
+
+#endif
+
+//------------- IN streaming -------------//
+#if CFG_TUD_AUDIO_EP_IN_SIZE
+
+static void tx_send(audiod_interface_t* p_audio)
+{
+  audiod_stream_t const* tx = &p_audio->tx;
+
+  // Spread sample rate over packets e.g at 44.1 kHz full speed, nine packets of 44 frames then one of 45
+  p_audio->tx_acc += p_audio->sample_rate;
+  uint32_t const frames = p_audio->tx_acc / tx->packets_per_sec;
+  p_audio->tx_acc -= frames*tx->packets_per_sec;
+
+  uint16_t const len = (uint16_t) tu_min32(frames*tx->frame_size, (uint32_t) (tx->ep_size - tx->ep_size % tx->frame_size));
+
+  // Send whole frames only, and pad with silence if application is late
+  tu_fifo_idx_t avail = tu_fifo_count(&p_audio->tx_ff);
+  avail = (tu_fifo_idx_t) (avail - avail % tx->frame_size);
+
+  uint16_t const count = tu_fifo_read_n(&p_audio->tx_ff, p_audio->epin_buf, tu_min16(len, avail));
+  if ( count < len )
+  {
+    memset(p_audio->epin_buf + count, 0, len - count);
+    p_audio->stats.tx_underrun++;
+  }
+
+  usbd_edpt_xfer(p_audio->rhport, tx->ep_data, p_audio->epin_buf, len);
+}
+
+#endif
+
+// Open endpoints of an alternate setting and get its audio format
+static bool stream_open(audiod_interface_t* p_audio, audiod_stream_t* stream, uint8_t const* p_desc, uint16_t bufsize)
+{
+  uint8_t const* desc_end = p_audio->as_desc + p_audio->as_len;
+  uint8_t nchannels = 0;
+  uint8_t subslot   = 0;
+  uint8_t interval  = 0;
+
+  stream->ep_fb   = 0;
+  stream->ep_size = 0;
+
+  p_desc = tu_desc_next(p_desc);
+  while ( p_desc < desc_end && TUSB_DESC_INTERFACE != tu_desc_type(p_desc) )
+  {
+    if ( TUSB_DESC_CS_INTERFACE == tu_desc_type(p_desc) )
+    {
+      // bNrChannels of AS General, bSubslotSize of Type I Format
+      if ( AUDIO_CS_AS_INTERFACE_AS_GENERAL == p_desc[2] ) nchannels = p_desc[10];
+      if ( AUDIO_CS_AS_INTERFACE_FORMAT_TYPE == p_desc[2] && AUDIO_FORMAT_TYPE_I == p_desc[3] ) subslot = p_desc[4];
+    }
+    else if ( TUSB_DESC_ENDPOINT == tu_desc_type(p_desc) )
+    {
+      tusb_desc_endpoint_t const* desc_ep = (tusb_desc_endpoint_t const*) p_desc;
+      TU_ASSERT( dcd_edpt_open(p_audio->rhport, desc_ep) );
+
+      if ( AUDIOD_EP_USAGE_FEEDBACK == desc_ep->bmAttributes.usage )
+      {
+        stream->ep_fb = desc_ep->bEndpointAddress;
+      }
+      else
+      {
+        // high bandwidth endpoint has additional transactions per microframe
+        stream->ep_data = desc_ep->bEndpointAddress;
+        stream->ep_size = (uint16_t) (desc_ep->wMaxPacketSize.size * (1 + desc_ep->wMaxPacketSize.hs_period_mult));
+        interval        = desc_ep->bInterval;
+      }
+    }
+
+    p_desc = tu_desc_next(p_desc);
+  }
+
+  TU_ASSERT(nchannels && subslot && stream->ep_size);
+  TU_ASSERT(stream->ep_size <= bufsize);
+  TU_ASSERT(interval >= 1 && interval <= 4);
+
+  stream->frame_size      = (uint16_t) (nchannels*subslot);
+  stream->packets_per_sec = (uint16_t) (AUDIOD_FRAMES_PER_SEC(p_audio->rhport) >> (interval-1));
+
+  TU_ASSERT(stream->ep_size >= stream->frame_size);
+
+  return true;
+}
+
+static bool set_interface(audiod_interface_t* p_audio, audiod_stream_t* stream, uint8_t alt)
+{
+  // Stop streaming, endpoint isr won't re-arm. Transfer already queued is left to complete.
+  stream->alt = 0;
+  if ( alt == 0 ) return true;
+
+  uint8_t const* p_desc   = p_audio->as_desc;
+  uint8_t const* desc_end = p_audio->as_desc + p_audio->as_len;
+
+  while ( p_desc < desc_end )
+  {
+    tusb_desc_interface_t const* desc_itf = (tusb_desc_interface_t const*) p_desc;
+    if ( TUSB_DESC_INTERFACE == tu_desc_type(p_desc) &&
+         desc_itf->bInterfaceNumber == stream->itf_num && desc_itf->bAlternateSetting == alt ) break;
+
+    p_desc = tu_desc_next(p_desc);
+  }
+  TU_VERIFY(p_desc < desc_end);
+
+  uint16_t const bufsize = (stream == &p_audio->rx) ? CFG_TUD_AUDIO_EP_OUT_SIZE : CFG_TUD_AUDIO_EP_IN_SIZE;
+  TU_ASSERT( stream_open(p_audio, stream, p_desc, bufsize) );
+
+  tu_fifo_clear( (stream == &p_audio->rx) ? &p_audio->rx_ff : &p_audio->tx_ff );
+  p_audio->tx_acc = 0;
+  stream->alt     = alt;
+
+  return true;
+}
+
+// Streaming is paced by SOF, which is only needed while a stream is active
+static void sof_update(audiod_interface_t* p_audio)
+{
+  bool const active = p_audio->rx.alt || p_audio->tx.alt;
+  if ( p_audio->sof_on == active ) return;
+
+  p_audio->sof_on = active;
+  usbd_sof_enable(p_audio->rhport, active);
+}
+
+static bool clock_request(uint8_t rhport, audiod_interface_t* p_audio, tusb_control_request_t const * request)
+{
+  uint8_t const ctrl_sel = tu_u16_high(request->wValue);
+  uint8_t* buf = p_audio->ctrl_buf;
+
+  if ( request->bmRequestType_bit.direction == TUSB_DIR_OUT )
+  {
+    // SET CUR of sample rate, applied by audiod_control_complete()
+    TU_VERIFY(AUDIO_CS_CTRL_SAM_FREQ == ctrl_sel && AUDIO_CS_REQ_CUR == request->bRequest && request->wLength == 4);
+    return tud_control_xfer(rhport, request, buf, 4);
+  }
+
+  switch ( ctrl_sel )
+  {
+    case AUDIO_CS_CTRL_SAM_FREQ:
+      if ( AUDIO_CS_REQ_CUR == request->bRequest )
+      {
+        uint32_t const rate = p_audio->sample_rate;
+        buf[0] = (uint8_t) rate; buf[1] = (uint8_t) (rate >> 8); buf[2] = (uint8_t) (rate >> 16); buf[3] = (uint8_t) (rate >> 24);
+        return tud_control_xfer(rhport, request, buf, 4);
+      }
+      else if ( AUDIO_CS_REQ_RANGE == request->bRequest )
+      {
+        uint32_t const* rates = &p_audio->sample_rate;
+        uint8_t count = 1;
+        if ( tud_audio_get_sample_rates_cb ) count = tud_audio_get_sample_rates_cb(&rates);
+
+        // wNumSubRanges then MIN, MAX, RES of each sub range
+        count = (uint8_t) tu_min16(count, (CFG_TUD_AUDIO_CTRL_BUFSIZE - 2) / 12);
+        buf[0] = count;
+        buf[1] = 0;
+
+        uint8_t* p = buf + 2;
+        for(uint8_t i=0; i<count; i++)
+        {
+          uint32_t const rate = rates[i];
+          for(uint8_t j=0; j<8; j++) *p++ = (uint8_t) (rate >> (8*(j & 3)));
+          for(uint8_t j=0; j<4; j++) *p++ = 0;
+        }
+
+        return tud_control_xfer(rhport, request, buf, (uint16_t) (p - buf));
+      }
+    break;
+
+    case AUDIO_CS_CTRL_CLK_VALID:
+      TU_VERIFY(AUDIO_CS_REQ_CUR == request->bRequest);
+      buf[0] = 1;
+      return tud_control_xfer(rhport, request, buf, 1);
+
+    default: break;
+  }
+
+  return false;
+}
+
+//--------------------------------------------------------------------+
+// APPLICATION API
+//--------------------------------------------------------------------+
+bool tud_audio_mounted(void)
+{
+  return _audiod_itf.as_desc != NULL;
+}
+
+uint32_t tud_audio_get_sample_rate(void)
+{
+  return _audiod_itf.sample_rate;
+}
+
+bool tud_audio_rx_active(void)
+{
+  return _audiod_itf.rx.alt != 0;
+}
+
+bool tud_audio_tx_active(void)
+{
+  return _audiod_itf.tx.alt != 0;
+}
+
+uint32_t tud_audio_available(void)
+{
+  return tu_fifo_count(&_audiod_itf.rx_ff);
+}
+
+uint32_t tud_audio_read(void* buffer, uint32_t bufsize)
+{
+  audiod_interface_t* p_audio = &_audiod_itf;
+  uint16_t const frame_size = p_audio->rx.frame_size ? p_audio->rx.frame_size : 1;
+
+  bufsize = tu_min32(bufsize, TU_FIFO_COUNT_MAX);
+  bufsize -= bufsize % frame_size;
+
+  uint32_t const count = tu_fifo_read_n(&p_audio->rx_ff, buffer, (tu_fifo_idx_t) bufsize);
+  if ( count < bufsize && p_audio->rx.alt ) p_audio->stats.rx_underrun++;
+
+  return count;
+}
+
+uint32_t tud_audio_write_available(void)
+{
+  return tu_fifo_remaining(&_audiod_itf.tx_ff);
+}
+
+uint32_t tud_audio_write(void const* buffer, uint32_t bufsize)
+{
+  audiod_interface_t* p_audio = &_audiod_itf;
+  uint16_t const frame_size = p_audio->tx.frame_size ? p_audio->tx.frame_size : 1;
+
+  uint32_t count = tu_min32(bufsize, tu_fifo_remaining(&p_audio->tx_ff));
+  count -= count % frame_size;
+  if ( count < bufsize ) p_audio->stats.tx_overrun++;
+
+  return tu_fifo_write_n(&p_audio->tx_ff, buffer, (tu_fifo_idx_t) count);
+}
+
+void tud_audio_fb_set(uint32_t fb_16_16)
+{
+  _audiod_itf.fb_app = fb_16_16;
+}
+
+void tud_audio_get_stats(tud_audio_stats_t* stats)
+{
+  (*stats) = _audiod_itf.stats;
+}
+
+void tud_audio_clear_stats(void)
+{
+  tu_varclr(&_audiod_itf.stats);
+}
+
+//--------------------------------------------------------------------+
+// USBD Driver API
+//--------------------------------------------------------------------+
+void audiod_init(void)
+{
+  audiod_interface_t* p_audio = &_audiod_itf;
+  tu_memclr(p_audio, sizeof(audiod_interface_t));
+
+#if CFG_TUD_AUDIO_EP_OUT_SIZE
+  tu_fifo_config(&p_audio->rx_ff, p_audio->rx_ff_buf, CFG_TUD_AUDIO_RX_FIFO_SIZE, 1, false);
+#endif
+
+#if CFG_TUD_AUDIO_EP_IN_SIZE
+  tu_fifo_config(&p_audio->tx_ff, p_audio->tx_ff_buf, CFG_TUD_AUDIO_TX_FIFO_SIZE, 1, false);
+#endif
+
+  p_audio->sample_rate = CFG_TUD_AUDIO_SAMPLE_RATE;
+}
+
+void audiod_reset(uint8_t rhport)
+{
+  (void) rhport;
+  audiod_interface_t* p_audio = &_audiod_itf;
+
+  tu_memclr(p_audio, ITF_MEM_RESET_SIZE);
+  tu_fifo_clear(&p_audio->rx_ff);
+  tu_fifo_clear(&p_audio->tx_ff);
+
+  p_audio->sample_rate = CFG_TUD_AUDIO_SAMPLE_RATE;
+}
+
+bool audiod_open(uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t *p_length, uint8_t *p_inst)
+{
+  (void) p_inst;
+
+  // Audio Class 2.0 function only, other audio control interfaces are left to MIDI driver
+  TU_VERIFY(AUDIO_SUBCLASS_CONTROL == itf_desc->bInterfaceSubClass &&
+            AUDIO_PROTOCOL_V2      == itf_desc->bInterfaceProtocol);
+
+  audiod_interface_t* p_audio = &_audiod_itf;
+  TU_VERIFY(p_audio->as_desc == NULL);
+
+  p_audio->rhport  = rhport;
+  p_audio->itf_num = itf_desc->bInterfaceNumber;
+
+  uint8_t const * p_desc = tu_desc_next( (uint8_t const *) itf_desc );
+  (*p_length) = sizeof(tusb_desc_interface_t);
+
+  // Class-specific AC descriptors are covered by wTotalLength of header
+  TU_ASSERT(TUSB_DESC_CS_INTERFACE == tu_desc_type(p_desc) && AUDIO_CS_INTERFACE_HEADER == p_desc[2]);
+  uint8_t const * ac_end = p_desc + tu_u16(p_desc[7], p_desc[6]);
+
+  p_audio->clock_id = 0;
+  while ( p_desc < ac_end )
+  {
+    if ( AUDIO_CS_INTERFACE_CLOCK_SOURCE == p_desc[2] && !p_audio->clock_id ) p_audio->clock_id = p_desc[3];
+
+    (*p_length) = (uint16_t) ((*p_length) + tu_desc_len(p_desc));
+    p_desc = tu_desc_next(p_desc);
+  }
+
+  // Optional interrupt endpoint, opened but nothing is ever reported
+  if ( itf_desc->bNumEndpoints )
+  {
+    TU_ASSERT(TUSB_DESC_ENDPOINT == tu_desc_type(p_desc));
+    TU_ASSERT( dcd_edpt_open(rhport, (tusb_desc_endpoint_t const *) p_desc) );
+
+    (*p_length) = (uint16_t) ((*p_length) + tu_desc_len(p_desc));
+    p_desc = tu_desc_next(p_desc);
+  }
+
+  // Streaming interfaces following, endpoints are opened when host selects an alternate setting
+  uint8_t const * as_desc = p_desc;
+  uint16_t as_len = 0;
+
+  while ( TUSB_DESC_INTERFACE == tu_desc_type(p_desc) )
+  {
+    tusb_desc_interface_t const* desc_as = (tusb_desc_interface_t const*) p_desc;
+    if ( !(TUSB_CLASS_AUDIO == desc_as->bInterfaceClass && AUDIO_SUBCLASS_STREAMING == desc_as->bInterfaceSubClass) ) break;
+
+    do
+    {
+      // data endpoint tells the direction of streaming interface
+      if ( TUSB_DESC_ENDPOINT == tu_desc_type(p_desc) )
+      {
+        tusb_desc_endpoint_t const* desc_ep = (tusb_desc_endpoint_t const*) p_desc;
+
+        if ( AUDIOD_EP_USAGE_FEEDBACK != desc_ep->bmAttributes.usage )
+        {
+          audiod_stream_t* stream = (tu_edpt_dir(desc_ep->bEndpointAddress) == TUSB_DIR_OUT) ? &p_audio->rx : &p_audio->tx;
+          TU_ASSERT( (stream == &p_audio->rx) ? (CFG_TUD_AUDIO_EP_OUT_SIZE > 0) : (CFG_TUD_AUDIO_EP_IN_SIZE > 0) );
+
+          stream->itf_num = desc_as->bInterfaceNumber;
+          stream->ep_data = desc_ep->bEndpointAddress;
+        }
+      }
+
+      as_len = (uint16_t) (as_len + tu_desc_len(p_desc));
+      p_desc = tu_desc_next(p_desc);
+    } while ( is_as_desc_type(tu_desc_type(p_desc)) );
+  }
+
+  TU_ASSERT(p_audio->rx.ep_data || p_audio->tx.ep_data);
+
+  p_audio->as_desc = as_desc;
+  p_audio->as_len  = as_len;
+  (*p_length) = (uint16_t) ((*p_length) + as_len);
+
+  set_sample_rate(p_audio, p_audio->sample_rate);
+
+  return true;
+}
+
+// Handle (Get/Set) Interface of streaming interfaces and class requests of clock source and units
+// return false to stall control endpoint (e.g unsupported request)
+bool audiod_control_request(uint8_t rhport, tusb_control_request_t const * request)
+{
+  audiod_interface_t* p_audio = &_audiod_itf;
+
+  TU_VERIFY(request->bmRequestType_bit.recipient == TUSB_REQ_RCPT_INTERFACE);
+  uint8_t const itf = tu_u16_low(request->wIndex);
+
+  if ( request->bmRequestType_bit.type == TUSB_REQ_TYPE_STANDARD )
+  {
+    audiod_stream_t* stream = get_stream(p_audio, itf);
+    TU_VERIFY(stream);
+
+    switch ( request->bRequest )
+    {
+      case TUSB_REQ_GET_INTERFACE:
+        tud_control_xfer(rhport, request, &stream->alt, 1);
+      break;
+
+      case TUSB_REQ_SET_INTERFACE:
+      {
+        uint8_t const alt = (uint8_t) request->wValue;
+        bool const ok = set_interface(p_audio, stream, alt);
+        sof_update(p_audio);
+        TU_VERIFY(ok);
+
+        tud_control_status(rhport, request);
+
+        if ( tud_audio_set_itf_cb ) tud_audio_set_itf_cb(itf, alt);
+
+        // OUT is armed right away, IN starts with next SOF
+        #if CFG_TUD_AUDIO_EP_OUT_SIZE
+        if ( alt && stream == &p_audio->rx ) rx_start(p_audio);
+        #endif
+      }
+      break;
+
+      default: return false;
+    }
+
+    return true;
+  }
+
+  //------------- Class Specific Request -------------//
+  TU_VERIFY(TUSB_REQ_TYPE_CLASS == request->bmRequestType_bit.type);
+  TU_VERIFY(itf == p_audio->itf_num);
+
+  uint8_t const entity = tu_u16_high(request->wIndex);
+  if ( entity && entity == p_audio->clock_id ) return clock_request(rhport, p_audio, request);
+
+  // Other entities e.g feature unit are handled by application
+  if ( request->bmRequestType_bit.direction == TUSB_DIR_IN )
+  {
+    TU_VERIFY(tud_audio_get_req_entity_cb);
+    uint16_t const len = tud_audio_get_req_entity_cb(request, p_audio->ctrl_buf, tu_min16(request->wLength, CFG_TUD_AUDIO_CTRL_BUFSIZE));
+    TU_VERIFY(len);
+    return tud_control_xfer(rhport, request, p_audio->ctrl_buf, len);
+  }
+  else
+  {
+    TU_VERIFY(tud_audio_set_req_entity_cb && request->wLength <= CFG_TUD_AUDIO_CTRL_BUFSIZE);
+    return tud_control_xfer(rhport, request, p_audio->ctrl_buf, request->wLength);
+  }
+}
+
+// Invoked when class request DATA stage is finished.
+// return false to stall control endpoint (e.g Host send rejected data)
+bool audiod_control_complete(uint8_t rhport, tusb_control_request_t const * request)
+{
+  (void) rhport;
+  audiod_interface_t* p_audio = &_audiod_itf;
+
+  if ( !(TUSB_REQ_TYPE_CLASS == request->bmRequestType_bit.type && TUSB_DIR_OUT == request->bmRequestType_bit.direction) ) return true;
+
+  uint8_t const entity = tu_u16_high(request->wIndex);
+  if ( entity && entity == p_audio->clock_id )
+  {
+    uint8_t const* buf = p_audio->ctrl_buf;
+    uint32_t const rate = tu_u32(buf[3], buf[2], buf[1], buf[0]);
+
+    if ( tud_audio_set_sample_rate_cb ) TU_VERIFY( tud_audio_set_sample_rate_cb(rate) );
+    set_sample_rate(p_audio, rate);
+
+    return true;
+  }
+
+  return tud_audio_set_req_entity_cb(request, p_audio->ctrl_buf, request->wLength);
+}
+
+// Streaming endpoints are all handled by audiod_xfer_isr_cb()
+bool audiod_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes)
+{
+  (void) rhport;
+  (void) ep_addr;
+  (void) result;
+  (void) xferred_bytes;
+
+  return true;
+}
+
+// Re-arm isochronous endpoints in interrupt context so that no (micro)frame is missed
+bool audiod_xfer_isr_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes)
+{
+  (void) rhport;
+  (void) result;
+  (void) xferred_bytes;
+
+  audiod_interface_t* p_audio = &_audiod_itf;
+
+#if CFG_TUD_AUDIO_EP_OUT_SIZE
+  if ( ep_addr == p_audio->rx.ep_data )
+  {
+    if ( XFER_RESULT_SUCCESS == result && xferred_bytes ) rx_packet(p_audio, xferred_bytes);
+
+    if ( p_audio->rx.alt ) usbd_edpt_xfer(rhport, ep_addr, p_audio->epout_buf, p_audio->rx.ep_size);
+    return true;
+  }
+
+  if ( ep_addr == p_audio->rx.ep_fb )
+  {
+    if ( p_audio->rx.alt ) fb_send(p_audio);
+    return true;
+  }
+#endif
+
+#if CFG_TUD_AUDIO_EP_IN_SIZE
+  if ( ep_addr == p_audio->tx.ep_data )
+  {
+    if ( p_audio->tx.alt ) tx_send(p_audio);
+    return true;
+  }
+#endif
+
+  return false;
+}
+
+// Start (or restart after a missed transfer) IN and feedback streaming aligned to SOF
+void audiod_sof(uint8_t rhport)
+{
+  (void) rhport;
+  audiod_interface_t* p_audio = &_audiod_itf;
+
+#if CFG_TUD_AUDIO_EP_OUT_SIZE
+  if ( p_audio->rx.alt ) rx_start(p_audio);
+#endif
+
+#if CFG_TUD_AUDIO_EP_IN_SIZE
+  if ( p_audio->tx.alt && !usbd_edpt_busy(rhport, p_audio->tx.ep_data) ) tx_send(p_audio);
+#endif
+}
+
+#endif
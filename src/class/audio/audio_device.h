@@ -0,0 +1,159 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#ifndef _TUSB_AUDIO_DEVICE_H_
+#define _TUSB_AUDIO_DEVICE_H_
+
+#include "common/tusb_common.h"
+#include "common/tusb_fifo.h"
+#include "device/usbd.h"
+#include "audio.h"
+#include "audio_convert.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+//--------------------------------------------------------------------+
+// Class Driver Default Configure & Validation
+//--------------------------------------------------------------------+
+
+// Endpoint buffer size of OUT (speaker) and IN (microphone) streaming, must be at least the
+// largest wMaxPacketSize (including additional transactions of high bandwidth endpoint) of the
+// alternate settings. 0 disables the direction.
+#ifndef CFG_TUD_AUDIO_EP_OUT_SIZE
+  #define CFG_TUD_AUDIO_EP_OUT_SIZE   0
+#endif
+
+#ifndef CFG_TUD_AUDIO_EP_IN_SIZE
+  #define CFG_TUD_AUDIO_EP_IN_SIZE    0
+#endif
+
+// Sample FIFO in bytes between endpoints and application. Explicit feedback of OUT streaming
+// regulates host rate to keep RX FIFO half full, larger FIFO gives more jitter tolerance.
+#ifndef CFG_TUD_AUDIO_RX_FIFO_SIZE
+  #define CFG_TUD_AUDIO_RX_FIFO_SIZE  (4*CFG_TUD_AUDIO_EP_OUT_SIZE)
+#endif
+
+#ifndef CFG_TUD_AUDIO_TX_FIFO_SIZE
+  #define CFG_TUD_AUDIO_TX_FIFO_SIZE  (4*CFG_TUD_AUDIO_EP_IN_SIZE)
+#endif
+
+// Sample rate of clock source until host changes it
+#ifndef CFG_TUD_AUDIO_SAMPLE_RATE
+  #define CFG_TUD_AUDIO_SAMPLE_RATE   48000
+#endif
+
+// Buffer for class-specific control requests e.g RANGE of several sample rates
+#ifndef CFG_TUD_AUDIO_CTRL_BUFSIZE
+  #define CFG_TUD_AUDIO_CTRL_BUFSIZE  64
+#endif
+
+TU_VERIFY_STATIC(CFG_TUD_AUDIO_EP_OUT_SIZE || CFG_TUD_AUDIO_EP_IN_SIZE, "At least one streaming direction must be enabled");
+TU_VERIFY_STATIC(CFG_TUD_AUDIO_RX_FIFO_SIZE <= TU_FIFO_DEPTH_MAX && CFG_TUD_AUDIO_TX_FIFO_SIZE <= TU_FIFO_DEPTH_MAX, "FIFO is too large");
+
+/** \addtogroup ClassDriver_Audio
+ *  @{
+ *  \defgroup   Audio_Device Device
+ *  @{ */
+
+typedef struct
+{
+  uint32_t rx_overrun;  ///< OUT packets dropped since RX FIFO is full
+  uint32_t rx_underrun; ///< tud_audio_read() calls getting less than requested while streaming
+  uint32_t tx_overrun;  ///< tud_audio_write() calls not fitting into TX FIFO
+  uint32_t tx_underrun; ///< IN packets padded with silence since TX FIFO is short
+} tud_audio_stats_t;
+
+//--------------------------------------------------------------------+
+// Application API
+//--------------------------------------------------------------------+
+bool     tud_audio_mounted       (void);
+
+// Current sample rate of the clock source
+uint32_t tud_audio_get_sample_rate(void);
+
+// Host selected an alternate setting with bandwidth for OUT/IN streaming
+bool     tud_audio_rx_active     (void);
+bool     tud_audio_tx_active     (void);
+
+// Bytes of audio frames received, read up to bufsize (rounded down to whole frames)
+uint32_t tud_audio_available     (void);
+uint32_t tud_audio_read          (void* buffer, uint32_t bufsize);
+
+// Queue audio frames for IN streaming, return number of bytes written (whole frames)
+uint32_t tud_audio_write_available(void);
+uint32_t tud_audio_write         (void const* buffer, uint32_t bufsize);
+
+// Override explicit feedback value in samples per (micro)frame as 16.16 fixed point, e.g from
+// application measuring its codec clock against SOF. 0 reverts to regulation on RX FIFO level.
+void     tud_audio_fb_set        (uint32_t fb_16_16);
+
+void     tud_audio_get_stats     (tud_audio_stats_t* stats);
+void     tud_audio_clear_stats   (void);
+
+//--------------------------------------------------------------------+
+// Application Callback API (weak is optional)
+//--------------------------------------------------------------------+
+
+// Invoked when host selects an alternate setting of a streaming interface (0 stops streaming).
+// IN streaming starts at next SOF, TX FIFO can be pre-filled here.
+TU_ATTR_WEAK void tud_audio_set_itf_cb(uint8_t itf, uint8_t alt);
+
+// Invoked when host changes sample rate, return false to reject it
+TU_ATTR_WEAK bool tud_audio_set_sample_rate_cb(uint32_t sample_rate);
+
+// Invoked to report supported sample rates (RANGE request), return number of rates.
+// Without it, only current sample rate is reported.
+TU_ATTR_WEAK uint8_t tud_audio_get_sample_rates_cb(uint32_t const** p_rates);
+
+// Invoked with GET request of an entity other than clock source e.g feature unit volume/mute.
+// Return number of bytes copied to buffer, 0 to stall.
+TU_ATTR_WEAK uint16_t tud_audio_get_req_entity_cb(tusb_control_request_t const* request, uint8_t* buffer, uint16_t bufsize);
+
+// Invoked with data of SET request of an entity other than clock source, return false to stall
+TU_ATTR_WEAK bool tud_audio_set_req_entity_cb(tusb_control_request_t const* request, uint8_t const* buffer, uint16_t length);
+
+/** @} */
+/** @} */
+
+//--------------------------------------------------------------------+
+// Internal Class Driver API
+//--------------------------------------------------------------------+
+void audiod_init(void);
+void audiod_reset(uint8_t rhport);
+bool audiod_open(uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t *p_length, uint8_t *p_inst);
+bool audiod_control_request(uint8_t rhport, tusb_control_request_t const * request);
+bool audiod_control_complete(uint8_t rhport, tusb_control_request_t const * request);
+bool audiod_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes);
+bool audiod_xfer_isr_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes);
+void audiod_sof(uint8_t rhport);
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif /* _TUSB_AUDIO_DEVICE_H_ */
@@ -0,0 +1,843 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#include "tusb_option.h"
+
+#if (TUSB_OPT_HOST_ENABLED && CFG_TUH_AUDIO)
+
+//--------------------------------------------------------------------+
+// INCLUDE
+//--------------------------------------------------------------------+
+#include "common/tusb_common.h"
+#include "host/usbh_hcd.h"
+#include "audio_host.h"
+
+//--------------------------------------------------------------------+
+// MACRO CONSTANT TYPEDEF
+//--------------------------------------------------------------------+
+
+enum
+{
+  AUDIOH_XFER_SLOTS = 2, // transfers queued per data endpoint, as many as HCD takes
+  AUDIOH_TERM_MAX   = 8, // UAC2 terminals whose clock source is looked up
+};
+
+enum
+{
+  STREAM_IDLE = 0,
+  STREAM_SET_ITF,   // SET_INTERFACE of selected alternate setting in progress
+  STREAM_SET_RATE,  // SET_CUR of sampling frequency in progress
+  STREAM_RUNNING
+};
+
+// Endpoint info of an alternate setting, not exposed to application
+typedef struct
+{
+  tusb_desc_endpoint_t ep;    // data endpoint
+  tusb_desc_endpoint_t ep_fb; // feedback endpoint, bLength is 0 if none
+  uint8_t clock_id;           // UAC2 clock source of terminal linked to interface, 0 if unknown
+  bool    rate_ctrl;          // UAC1 endpoint has sampling frequency control
+}audioh_alt_ep_t;
+
+typedef struct
+{
+  tuh_audio_stream_info_t info;
+  audioh_alt_ep_t alt_ep[CFG_TUH_AUDIO_ALT_MAX];
+
+  uint8_t  state;
+  uint8_t  alt_idx;      // selected alternate setting in info.alt[]
+  uint8_t  sample_bytes; // channels x subframe
+  uint32_t rate;
+
+  uint16_t ep_size;      // expected length of IN packets, limit of OUT packets
+  uint32_t nominal;      // samples per service interval, 16.16 fixed point
+  uint32_t feedback;     // same from feedback endpoint, 0 until a sane value is received
+  uint32_t accum;        // fraction of sample carried to next packet, 16.16
+
+  // transfers complete in queue order, head is the oldest queued slot
+  uint8_t  xfer_head;
+  uint8_t  xfer_count;
+}audioh_stream_t;
+
+typedef struct
+{
+  uint8_t rhport;
+  uint8_t dev_addr;
+  uint8_t itf_num;      // audio control interface
+  uint8_t protocol;     // AUDIO_PROTOCOL_V1 or AUDIO_PROTOCOL_V2
+
+  bool    mounted;
+  bool    ctrl_busy;    // request of ctrl_stream is in progress on control pipe
+  uint8_t ctrl_stream;
+
+  uint8_t stream_count;
+  audioh_stream_t stream[CFG_TUH_AUDIO_STREAM_MAX];
+
+  /*------------- From this point, data is not cleared by close -------------*/
+  tu_fifo_t ff[CFG_TUH_AUDIO_STREAM_MAX];
+  uint8_t   ff_buf[CFG_TUH_AUDIO_STREAM_MAX][CFG_TUH_AUDIO_FIFO_SIZE];
+}audioh_interface_t;
+
+#define ITF_MEM_RESET_SIZE   offsetof(audioh_interface_t, ff)
+
+TU_VERIFY_STATIC( CFG_TUH_AUDIO_STREAM_MAX >= 1 && CFG_TUH_AUDIO_ALT_MAX >= 1, "CFG_TUH_AUDIO_STREAM_MAX and CFG_TUH_AUDIO_ALT_MAX must be at least 1");
+TU_VERIFY_STATIC( CFG_TUH_AUDIO_RATE_MAX >= 2, "CFG_TUH_AUDIO_RATE_MAX must be at least 2 to hold a rate range");
+TU_VERIFY_STATIC( CFG_TUH_AUDIO_XFER_PACKETS >= 1 && CFG_TUH_AUDIO_EP_SZ >= 4, "CFG_TUH_AUDIO_XFER_PACKETS and CFG_TUH_AUDIO_EP_SZ are too small");
+TU_VERIFY_STATIC( CFG_TUH_ISO_EP >= 1, "CFG_TUH_ISO_EP must be at least 1 for audio streams");
+
+//--------------------------------------------------------------------+
+// INTERNAL OBJECT & FUNCTION DECLARATION
+//--------------------------------------------------------------------+
+static audioh_interface_t _audioh_itf[CFG_TUH_AUDIO];
+
+CFG_TUSB_MEM_SECTION TU_ATTR_ALIGNED(4) static uint8_t _audioh_ep_buf[CFG_TUH_AUDIO][CFG_TUH_AUDIO_STREAM_MAX][AUDIOH_XFER_SLOTS][CFG_TUH_AUDIO_XFER_PACKETS*CFG_TUH_AUDIO_EP_SZ];
+CFG_TUSB_MEM_SECTION TU_ATTR_ALIGNED(4) static uint8_t _audioh_fb_buf[CFG_TUH_AUDIO][CFG_TUH_AUDIO_STREAM_MAX][4];
+CFG_TUSB_MEM_SECTION TU_ATTR_ALIGNED(4) static uint8_t _audioh_ctrl_buf[CFG_TUH_AUDIO][4];
+
+// packet lengths of queued transfers, updated by HCD on completion
+static uint16_t _audioh_packet_len[CFG_TUH_AUDIO][CFG_TUH_AUDIO_STREAM_MAX][AUDIOH_XFER_SLOTS][CFG_TUH_AUDIO_XFER_PACKETS];
+static uint16_t _audioh_fb_len[CFG_TUH_AUDIO][CFG_TUH_AUDIO_STREAM_MAX];
+
+static inline uint8_t get_inst(audioh_interface_t const* p_audio)
+{
+  return (uint8_t) (p_audio - _audioh_itf);
+}
+
+static inline audioh_alt_ep_t const* get_alt_ep(audioh_stream_t const* st)
+{
+  return &st->alt_ep[st->alt_idx];
+}
+
+// Running stream of data or feedback endpoint
+static audioh_interface_t* get_instance(uint8_t dev_addr, uint8_t ep_addr, uint8_t* p_stream)
+{
+  for(uint8_t inst=0; inst<CFG_TUH_AUDIO; inst++)
+  {
+    audioh_interface_t* p_audio = &_audioh_itf[inst];
+    if ( p_audio->dev_addr != dev_addr ) continue;
+
+    for(uint8_t s=0; s<p_audio->stream_count; s++)
+    {
+      audioh_stream_t const* st = &p_audio->stream[s];
+      if ( STREAM_RUNNING != st->state ) continue;
+
+      audioh_alt_ep_t const* alt_ep = get_alt_ep(st);
+      if ( ep_addr == alt_ep->ep.bEndpointAddress || (alt_ep->ep_fb.bLength && ep_addr == alt_ep->ep_fb.bEndpointAddress) )
+      {
+        *p_stream = s;
+        return p_audio;
+      }
+    }
+  }
+
+  return NULL;
+}
+
+// Service interval is 2^(bInterval-1) frames (full speed) or micro frames (high speed)
+static inline uint8_t interval_shift(tusb_desc_endpoint_t const* ep)
+{
+  return (uint8_t) (tu_min8(tu_max8(ep->bInterval, 1), 16) - 1);
+}
+
+static uint32_t intervals_per_second(audioh_interface_t const* p_audio, tusb_desc_endpoint_t const* ep)
+{
+  uint32_t const frames = (TUSB_SPEED_HIGH == _usbh_devices[p_audio->dev_addr].speed) ? 8000 : 1000;
+  return tu_max32(frames >> interval_shift(ep), 1);
+}
+
+static inline uint32_t u24_read(uint8_t const* p)
+{
+  return tu_u32(0, p[2], p[1], p[0]);
+}
+
+//--------------------------------------------------------------------+
+// ALTERNATE SETTING
+//--------------------------------------------------------------------+
+
+static bool rate_supported(tuh_audio_alt_t const* alt, uint32_t rate)
+{
+  if ( alt->rate_count )
+  {
+    for(uint8_t i=0; i<alt->rate_count; i++)
+    {
+      if ( alt->rates[i] == rate ) return true;
+    }
+    return false;
+  }
+
+  // UAC2 range is owned by clock source, device rejects the request if unsupported
+  if ( 0 == alt->rates[1] ) return true;
+
+  return (alt->rates[0] <= rate) && (rate <= alt->rates[1]);
+}
+
+// Alternate setting of smallest bandwidth fitting the format, CFG_TUH_AUDIO_ALT_MAX if none
+static uint8_t alt_select(audioh_interface_t const* p_audio, audioh_stream_t const* st, uint32_t rate, uint8_t channels, uint8_t bytes_per_sample)
+{
+  uint8_t best = CFG_TUH_AUDIO_ALT_MAX;
+
+  for(uint8_t i=0; i<st->info.alt_count; i++)
+  {
+    tuh_audio_alt_t const* alt = &st->info.alt[i];
+    if ( alt->channels != channels || alt->subframe != bytes_per_sample || !rate_supported(alt, rate) ) continue;
+
+    // one extra sample for rate adaption of asynchronous/adaptive endpoints
+    uint32_t const ips  = intervals_per_second(p_audio, &st->alt_ep[i].ep);
+    uint32_t const need = ((rate + ips - 1) / ips + 1) * channels * bytes_per_sample;
+    if ( alt->ep_size < need || need > CFG_TUH_AUDIO_EP_SZ ) continue;
+
+    // IN packets are received at ep_size offsets, whole packet must fit
+    if ( (TUSB_DIR_IN == st->info.dir) && (alt->ep_size > CFG_TUH_AUDIO_EP_SZ) ) continue;
+
+    if ( best == CFG_TUH_AUDIO_ALT_MAX || alt->ep_size < st->info.alt[best].ep_size ) best = i;
+  }
+
+  return best;
+}
+
+//--------------------------------------------------------------------+
+// STREAMING
+//--------------------------------------------------------------------+
+
+// Fill and queue next transfer slot. OUT packets carry the samples due in their service interval as of
+// device feedback (nominal rate until received), padded with silence if FIFO runs short
+static bool xfer_queue(audioh_interface_t* p_audio, uint8_t stream)
+{
+  audioh_stream_t* st = &p_audio->stream[stream];
+  TU_VERIFY( st->xfer_count < AUDIOH_XFER_SLOTS );
+
+  uint8_t const inst = get_inst(p_audio);
+  uint8_t const slot = (uint8_t) ((st->xfer_head + st->xfer_count) % AUDIOH_XFER_SLOTS);
+  uint8_t*  buf = _audioh_ep_buf[inst][stream][slot];
+  uint16_t* len = _audioh_packet_len[inst][stream][slot];
+
+  if ( TUSB_DIR_IN == st->info.dir )
+  {
+    for(uint16_t i=0; i<CFG_TUH_AUDIO_XFER_PACKETS; i++) len[i] = st->ep_size;
+  }
+  else
+  {
+    uint32_t const per_interval = st->feedback ? st->feedback : st->nominal;
+    uint32_t const max_bytes    = (uint32_t) (st->ep_size - (st->ep_size % st->sample_bytes));
+    uint8_t* p = buf;
+
+    for(uint16_t i=0; i<CFG_TUH_AUDIO_XFER_PACKETS; i++)
+    {
+      st->accum += per_interval;
+      uint16_t const bytes = (uint16_t) tu_min32((st->accum >> 16) * st->sample_bytes, max_bytes);
+      st->accum &= 0xffff;
+
+      uint16_t const count = (uint16_t) tu_fifo_read_n(&p_audio->ff[stream], p, bytes);
+      if ( count < bytes ) memset(p + count, 0, bytes - count);
+
+      len[i] = bytes;
+      p += bytes;
+    }
+  }
+
+  TU_VERIFY( hcd_edpt_iso_xfer(p_audio->rhport, p_audio->dev_addr, get_alt_ep(st)->ep.bEndpointAddress, buf, len, CFG_TUH_AUDIO_XFER_PACKETS) );
+  st->xfer_count++;
+
+  return true;
+}
+
+// Move received packets of completed slot into FIFO, a packet not fitting is dropped as a whole
+static void rx_store(audioh_interface_t* p_audio, uint8_t stream, uint8_t slot)
+{
+  audioh_stream_t const* st = &p_audio->stream[stream];
+  uint8_t const inst = get_inst(p_audio);
+  uint8_t const* buf = _audioh_ep_buf[inst][stream][slot];
+  uint16_t const* len = _audioh_packet_len[inst][stream][slot];
+  tu_fifo_t* ff = &p_audio->ff[stream];
+
+  for(uint16_t i=0; i<CFG_TUH_AUDIO_XFER_PACKETS; i++)
+  {
+    if ( len[i] && tu_fifo_remaining(ff) >= len[i] ) tu_fifo_write_n(ff, buf + i*st->ep_size, len[i]);
+  }
+}
+
+// Feedback endpoint is polled with one packet transfers
+static void fb_queue(audioh_interface_t* p_audio, uint8_t stream)
+{
+  audioh_stream_t const* st = &p_audio->stream[stream];
+  tusb_desc_endpoint_t const* ep_fb = &get_alt_ep(st)->ep_fb;
+  uint8_t const inst = get_inst(p_audio);
+
+  _audioh_fb_len[inst][stream] = (uint16_t) tu_min16(ep_fb->wMaxPacketSize.size, 4);
+  (void) hcd_edpt_iso_xfer(p_audio->rhport, p_audio->dev_addr, ep_fb->bEndpointAddress, _audioh_fb_buf[inst][stream], &_audioh_fb_len[inst][stream], 1);
+}
+
+// Samples per (micro)frame: 10.14 in 3 bytes (full speed) or 16.16 in 4 bytes (high speed)
+static void fb_update(audioh_interface_t* p_audio, uint8_t stream, uint32_t xferred_bytes)
+{
+  audioh_stream_t* st = &p_audio->stream[stream];
+  uint8_t const* fb = _audioh_fb_buf[get_inst(p_audio)][stream];
+
+  uint32_t value;
+  if      ( 3 == xferred_bytes ) value = u24_read(fb) << 2;
+  else if ( 4 == xferred_bytes ) value = tu_u32(fb[3], fb[2], fb[1], fb[0]);
+  else return;
+
+  value <<= interval_shift(&get_alt_ep(st)->ep);
+
+  // ignore garbage e.g 0 before device clock is locked
+  uint32_t const margin = st->nominal / 8;
+  if ( (value > st->nominal - margin) && (value < st->nominal + margin) ) st->feedback = value;
+}
+
+static void stream_close_edpt(audioh_interface_t* p_audio, audioh_stream_t const* st)
+{
+  audioh_alt_ep_t const* alt_ep = get_alt_ep(st);
+
+  usbh_edpt_prio(p_audio->dev_addr, alt_ep->ep.bEndpointAddress, false);
+  (void) usbh_iso_edpt_close(p_audio->dev_addr, alt_ep->ep.bEndpointAddress);
+  if ( alt_ep->ep_fb.bLength ) (void) usbh_iso_edpt_close(p_audio->dev_addr, alt_ep->ep_fb.bEndpointAddress);
+}
+
+// Open endpoints of selected alternate setting and queue both transfers
+static bool stream_run(audioh_interface_t* p_audio, uint8_t stream)
+{
+  audioh_stream_t* st = &p_audio->stream[stream];
+  audioh_alt_ep_t const* alt_ep = get_alt_ep(st);
+
+  // periodic bandwidth may be exhausted
+  TU_VERIFY( usbh_iso_edpt_open(p_audio->dev_addr, &alt_ep->ep) );
+  if ( alt_ep->ep_fb.bLength && !usbh_iso_edpt_open(p_audio->dev_addr, &alt_ep->ep_fb) )
+  {
+    (void) usbh_iso_edpt_close(p_audio->dev_addr, alt_ep->ep.bEndpointAddress);
+    return false;
+  }
+
+  // completions are processed ahead of other endpoints, a late refill is an audible gap
+  usbh_edpt_prio(p_audio->dev_addr, alt_ep->ep.bEndpointAddress, true);
+
+  uint32_t const ips = intervals_per_second(p_audio, &alt_ep->ep);
+  st->nominal    = ((st->rate / ips) << 16) + (((st->rate % ips) << 16) / ips);
+  st->feedback   = 0;
+  st->accum      = 0;
+  st->ep_size    = tu_min16(st->info.alt[st->alt_idx].ep_size, CFG_TUH_AUDIO_EP_SZ);
+  st->xfer_head  = 0;
+  st->xfer_count = 0;
+  st->state      = STREAM_RUNNING;
+
+  while ( st->xfer_count < AUDIOH_XFER_SLOTS && xfer_queue(p_audio, stream) ) {}
+
+  if ( 0 == st->xfer_count )
+  {
+    st->state = STREAM_IDLE;
+    stream_close_edpt(p_audio, st);
+    return false;
+  }
+
+  if ( alt_ep->ep_fb.bLength ) fb_queue(p_audio, stream);
+
+  return true;
+}
+
+//--------------------------------------------------------------------+
+// CONTROL REQUEST
+//--------------------------------------------------------------------+
+
+// Alternate setting 0 is selected again, result does not matter
+static void stream_stop_complete(uint8_t dev_addr, tusb_control_request_t const * request, xfer_result_t result)
+{
+  (void) dev_addr; (void) request; (void) result;
+}
+
+static void stream_fail(audioh_interface_t* p_audio, uint8_t stream)
+{
+  audioh_stream_t* st = &p_audio->stream[stream];
+  st->state = STREAM_IDLE;
+
+  (void) tuh_interface_set(p_audio->dev_addr, st->info.itf_num, 0, stream_stop_complete);
+
+  if ( tuh_audio_stream_started_cb ) tuh_audio_stream_started_cb(get_inst(p_audio), stream, false);
+}
+
+static void stream_control_complete(uint8_t dev_addr, tusb_control_request_t const * request, xfer_result_t result);
+
+// SET_CUR of sampling frequency: UAC1 endpoint control (3 bytes), UAC2 clock source control (4 bytes)
+static bool rate_set(audioh_interface_t* p_audio, uint8_t stream)
+{
+  audioh_stream_t const* st = &p_audio->stream[stream];
+  audioh_alt_ep_t const* alt_ep = get_alt_ep(st);
+  uint8_t* buf = _audioh_ctrl_buf[get_inst(p_audio)];
+
+  buf[0] = (uint8_t) (st->rate      );
+  buf[1] = (uint8_t) (st->rate >>  8);
+  buf[2] = (uint8_t) (st->rate >> 16);
+  buf[3] = (uint8_t) (st->rate >> 24);
+
+  tusb_control_request_t request = {
+        .bmRequestType_bit = { .recipient = TUSB_REQ_RCPT_ENDPOINT, .type = TUSB_REQ_TYPE_CLASS, .direction = TUSB_DIR_OUT },
+        .bRequest = AUDIO10_REQ_SET_CUR,
+        .wValue   = (uint16_t) (AUDIO10_EP_CTRL_SAMPLING_FREQ << 8),
+        .wIndex   = alt_ep->ep.bEndpointAddress,
+        .wLength  = 3
+  };
+
+  if ( AUDIO_PROTOCOL_V2 == p_audio->protocol )
+  {
+    request.bmRequestType_bit.recipient = TUSB_REQ_RCPT_INTERFACE;
+    request.bRequest = AUDIO_CS_REQ_CUR;
+    request.wValue   = (uint16_t) (AUDIO_CS_CTRL_SAM_FREQ << 8);
+    request.wIndex   = tu_u16(alt_ep->clock_id, p_audio->itf_num);
+    request.wLength  = 4;
+  }
+
+  return tuh_control_xfer(p_audio->dev_addr, &request, buf, stream_control_complete);
+}
+
+// Start sequence: SET_INTERFACE -> SET_CUR sampling frequency (if device has the control) -> streaming
+static void stream_control_complete(uint8_t dev_addr, tusb_control_request_t const * request, xfer_result_t result)
+{
+  (void) request;
+
+  audioh_interface_t* p_audio = NULL;
+  for(uint8_t inst=0; inst<CFG_TUH_AUDIO; inst++)
+  {
+    if ( _audioh_itf[inst].dev_addr == dev_addr && _audioh_itf[inst].ctrl_busy ) p_audio = &_audioh_itf[inst];
+  }
+  TU_VERIFY(p_audio, );
+
+  p_audio->ctrl_busy = false;
+  uint8_t const stream = p_audio->ctrl_stream;
+  audioh_stream_t* st = &p_audio->stream[stream];
+
+  // stopped meanwhile, alternate setting may have been selected already
+  if ( STREAM_IDLE == st->state )
+  {
+    (void) tuh_interface_set(dev_addr, st->info.itf_num, 0, stream_stop_complete);
+    return;
+  }
+
+  if ( XFER_RESULT_SUCCESS != result )
+  {
+    stream_fail(p_audio, stream);
+    return;
+  }
+
+  audioh_alt_ep_t const* alt_ep = get_alt_ep(st);
+  bool const rate_ctrl = (AUDIO_PROTOCOL_V2 == p_audio->protocol) ? (alt_ep->clock_id != 0) : alt_ep->rate_ctrl;
+
+  if ( STREAM_SET_ITF == st->state && rate_ctrl )
+  {
+    st->state = STREAM_SET_RATE;
+    p_audio->ctrl_busy = true;
+    if ( rate_set(p_audio, stream) ) return;
+
+    p_audio->ctrl_busy = false;
+    stream_fail(p_audio, stream);
+    return;
+  }
+
+  if ( !stream_run(p_audio, stream) )
+  {
+    stream_fail(p_audio, stream);
+    return;
+  }
+
+  if ( tuh_audio_stream_started_cb ) tuh_audio_stream_started_cb(get_inst(p_audio), stream, true);
+}
+
+//--------------------------------------------------------------------+
+// APPLICATION API
+//--------------------------------------------------------------------+
+bool tuh_audio_n_mounted(uint8_t inst)
+{
+  TU_VERIFY(inst < CFG_TUH_AUDIO);
+  return _audioh_itf[inst].mounted && tuh_device_is_configured(_audioh_itf[inst].dev_addr);
+}
+
+uint8_t tuh_audio_n_dev_addr(uint8_t inst)
+{
+  return _audioh_itf[inst].dev_addr;
+}
+
+uint8_t tuh_audio_n_stream_count(uint8_t inst)
+{
+  TU_VERIFY( tuh_audio_n_mounted(inst), 0 );
+  return _audioh_itf[inst].stream_count;
+}
+
+tuh_audio_stream_info_t const* tuh_audio_n_stream_info(uint8_t inst, uint8_t stream)
+{
+  TU_VERIFY( stream < tuh_audio_n_stream_count(inst), NULL );
+  return &_audioh_itf[inst].stream[stream].info;
+}
+
+bool tuh_audio_n_stream_start(uint8_t inst, uint8_t stream, uint32_t rate, uint8_t channels, uint8_t bytes_per_sample)
+{
+  TU_VERIFY( stream < tuh_audio_n_stream_count(inst) );
+  audioh_interface_t* p_audio = &_audioh_itf[inst];
+  audioh_stream_t* st = &p_audio->stream[stream];
+
+  TU_VERIFY( STREAM_IDLE == st->state && !p_audio->ctrl_busy && rate && channels && bytes_per_sample );
+
+  uint8_t const idx = alt_select(p_audio, st, rate, channels, bytes_per_sample);
+  TU_VERIFY( idx < CFG_TUH_AUDIO_ALT_MAX );
+
+  st->alt_idx      = idx;
+  st->rate         = rate;
+  st->sample_bytes = (uint8_t) (channels * bytes_per_sample);
+  st->state        = STREAM_SET_ITF;
+  tu_fifo_clear(&p_audio->ff[stream]);
+
+  p_audio->ctrl_busy   = true;
+  p_audio->ctrl_stream = stream;
+
+  if ( !tuh_interface_set(p_audio->dev_addr, st->info.itf_num, st->info.alt[idx].alt, stream_control_complete) )
+  {
+    p_audio->ctrl_busy = false;
+    st->state = STREAM_IDLE;
+    return false;
+  }
+
+  return true;
+}
+
+bool tuh_audio_n_stream_stop(uint8_t inst, uint8_t stream)
+{
+  TU_VERIFY( stream < tuh_audio_n_stream_count(inst) );
+  audioh_interface_t* p_audio = &_audioh_itf[inst];
+  audioh_stream_t* st = &p_audio->stream[stream];
+
+  TU_VERIFY( STREAM_IDLE != st->state );
+
+  // alternate setting 0 is selected once pending request of start sequence completes
+  bool const running = (STREAM_RUNNING == st->state);
+  st->state = STREAM_IDLE;
+
+  if ( running )
+  {
+    // queued transfers are dropped by HCD
+    stream_close_edpt(p_audio, st);
+
+    // best effort, device keeps its bandwidth if control pipe is busy
+    (void) tuh_interface_set(p_audio->dev_addr, st->info.itf_num, 0, stream_stop_complete);
+  }
+
+  tu_fifo_clear(&p_audio->ff[stream]);
+
+  return true;
+}
+
+bool tuh_audio_n_streaming(uint8_t inst, uint8_t stream)
+{
+  TU_VERIFY( stream < tuh_audio_n_stream_count(inst) );
+  return STREAM_RUNNING == _audioh_itf[inst].stream[stream].state;
+}
+
+uint32_t tuh_audio_n_write_available(uint8_t inst, uint8_t stream)
+{
+  TU_VERIFY( stream < tuh_audio_n_stream_count(inst), 0 );
+  audioh_interface_t* p_audio = &_audioh_itf[inst];
+  audioh_stream_t const* st = &p_audio->stream[stream];
+
+  // sample size is known once stream is started
+  TU_VERIFY( TUSB_DIR_OUT == st->info.dir && STREAM_IDLE != st->state, 0 );
+
+  // whole samples only, FIFO never holds a partial one
+  uint32_t const remaining = tu_fifo_remaining(&p_audio->ff[stream]);
+  return remaining - (remaining % st->sample_bytes);
+}
+
+uint32_t tuh_audio_n_write(uint8_t inst, uint8_t stream, void const* buffer, uint32_t bufsize)
+{
+  uint32_t count = tu_min32(bufsize, tuh_audio_n_write_available(inst, stream));
+  TU_VERIFY(count, 0);
+
+  audioh_stream_t const* st = &_audioh_itf[inst].stream[stream];
+  count -= count % st->sample_bytes;
+
+  return tu_fifo_write_n(&_audioh_itf[inst].ff[stream], buffer, (tu_fifo_idx_t) count);
+}
+
+uint32_t tuh_audio_n_available(uint8_t inst, uint8_t stream)
+{
+  TU_VERIFY( stream < tuh_audio_n_stream_count(inst), 0 );
+  TU_VERIFY( TUSB_DIR_IN == _audioh_itf[inst].stream[stream].info.dir, 0 );
+
+  return tu_fifo_count(&_audioh_itf[inst].ff[stream]);
+}
+
+uint32_t tuh_audio_n_read(uint8_t inst, uint8_t stream, void* buffer, uint32_t bufsize)
+{
+  uint32_t const count = tu_min32(bufsize, tuh_audio_n_available(inst, stream));
+  TU_VERIFY(count, 0);
+
+  return tu_fifo_read_n(&_audioh_itf[inst].ff[stream], buffer, (tu_fifo_idx_t) count);
+}
+
+//--------------------------------------------------------------------+
+// USBH-CLASS API
+//--------------------------------------------------------------------+
+void audioh_init(void)
+{
+  tu_memclr(_audioh_itf, sizeof(_audioh_itf));
+
+  for(uint8_t inst=0; inst<CFG_TUH_AUDIO; inst++)
+  {
+    for(uint8_t s=0; s<CFG_TUH_AUDIO_STREAM_MAX; s++)
+    {
+      tu_fifo_config(&_audioh_itf[inst].ff[s], _audioh_itf[inst].ff_buf[s], CFG_TUH_AUDIO_FIFO_SIZE, 1, false);
+    }
+  }
+}
+
+bool audioh_open(uint8_t rhport, uint8_t dev_addr, tusb_desc_interface_t const *itf_desc, uint16_t *p_length)
+{
+  // streaming interfaces are claimed along with their control interface
+  TU_VERIFY( AUDIO_SUBCLASS_CONTROL == itf_desc->bInterfaceSubClass &&
+             (AUDIO_PROTOCOL_V1 == itf_desc->bInterfaceProtocol || AUDIO_PROTOCOL_V2 == itf_desc->bInterfaceProtocol) );
+
+  // Find available interface
+  uint8_t inst;
+  for(inst=0; inst<CFG_TUH_AUDIO; inst++)
+  {
+    if ( _audioh_itf[inst].dev_addr == 0 ) break;
+  }
+  TU_VERIFY(inst < CFG_TUH_AUDIO);
+
+  audioh_interface_t* p_audio = &_audioh_itf[inst];
+  tu_memclr(p_audio, ITF_MEM_RESET_SIZE);
+
+  bool const v2 = (AUDIO_PROTOCOL_V2 == itf_desc->bInterfaceProtocol);
+  uint8_t const* desc_end = usbh_config_desc_end();
+  uint8_t const* p_desc = tu_desc_next(itf_desc);
+
+  // UAC2 terminal id -> clock source id, from class specific descriptors of control interface.
+  // Its interrupt endpoint (if any) is not used
+  uint8_t term[AUDIOH_TERM_MAX][2];
+  uint8_t term_count = 0;
+
+  while ( p_desc < desc_end && TUSB_DESC_INTERFACE != tu_desc_type(p_desc) && TUSB_DESC_INTERFACE_ASSOCIATION != tu_desc_type(p_desc) )
+  {
+    if ( v2 && TUSB_DESC_CS_INTERFACE == tu_desc_type(p_desc) && term_count < AUDIOH_TERM_MAX )
+    {
+      // bCSourceID is at offset 7 of input terminal, 8 of output terminal
+      if ( AUDIO_CS_INTERFACE_INPUT_TERMINAL == p_desc[2] || AUDIO_CS_INTERFACE_OUTPUT_TERMINAL == p_desc[2] )
+      {
+        term[term_count][0] = p_desc[3];
+        term[term_count][1] = p_desc[(AUDIO_CS_INTERFACE_INPUT_TERMINAL == p_desc[2]) ? 7 : 8];
+        term_count++;
+      }
+    }
+
+    p_desc = tu_desc_next(p_desc);
+  }
+
+  // Streaming interfaces following control interface, up to MIDI streaming or another function.
+  // Alternate settings of PCM format with an isochronous endpoint are recorded
+  audioh_stream_t* st = NULL;
+  tuh_audio_alt_t* alt = NULL;
+  audioh_alt_ep_t* alt_ep = NULL;
+
+  while ( p_desc < desc_end && TUSB_DESC_INTERFACE_ASSOCIATION != tu_desc_type(p_desc) )
+  {
+    uint8_t const desc_type = tu_desc_type(p_desc);
+
+    if ( TUSB_DESC_INTERFACE == desc_type )
+    {
+      tusb_desc_interface_t const* desc_itf = (tusb_desc_interface_t const*) p_desc;
+      if ( TUSB_CLASS_AUDIO != desc_itf->bInterfaceClass || AUDIO_SUBCLASS_STREAMING != desc_itf->bInterfaceSubClass ) break;
+
+      alt    = NULL;
+      alt_ep = NULL;
+
+      if ( 0 == desc_itf->bAlternateSetting )
+      {
+        st = (p_audio->stream_count < CFG_TUH_AUDIO_STREAM_MAX) ? &p_audio->stream[p_audio->stream_count++] : NULL;
+        if ( st ) st->info.itf_num = desc_itf->bInterfaceNumber;
+      }
+      else if ( st && st->info.itf_num == desc_itf->bInterfaceNumber && st->info.alt_count < CFG_TUH_AUDIO_ALT_MAX )
+      {
+        // recorded once its data endpoint is found
+        alt    = &st->info.alt[st->info.alt_count];
+        alt_ep = &st->alt_ep[st->info.alt_count];
+        tu_memclr(alt, sizeof(tuh_audio_alt_t));
+        tu_memclr(alt_ep, sizeof(audioh_alt_ep_t));
+        alt->alt = desc_itf->bAlternateSetting;
+      }
+    }
+    else if ( alt && TUSB_DESC_CS_INTERFACE == desc_type )
+    {
+      if ( AUDIO_CS_AS_INTERFACE_AS_GENERAL == p_desc[2] && v2 )
+      {
+        // bTerminalLink, bFormatType, bNrChannels
+        for(uint8_t i=0; i<term_count; i++)
+        {
+          if ( term[i][0] == p_desc[3] ) alt_ep->clock_id = term[i][1];
+        }
+        if ( AUDIO_FORMAT_TYPE_I == p_desc[5] ) alt->channels = p_desc[10];
+      }
+      else if ( AUDIO_CS_AS_INTERFACE_FORMAT_TYPE == p_desc[2] && AUDIO_FORMAT_TYPE_I == p_desc[3] )
+      {
+        if ( v2 )
+        {
+          alt->subframe = p_desc[4];
+          alt->bits     = p_desc[5];
+        }
+        else
+        {
+          // bNrChannels, bSubframeSize, bBitResolution, bSamFreqType followed by 3-byte rates (or min, max if 0)
+          alt->channels = p_desc[4];
+          alt->subframe = p_desc[5];
+          alt->bits     = p_desc[6];
+
+          uint8_t const nrates = p_desc[7];
+          if ( 0 == nrates )
+          {
+            alt->rates[0] = u24_read(p_desc + 8);
+            alt->rates[1] = u24_read(p_desc + 11);
+          }
+          else
+          {
+            alt->rate_count = tu_min8(nrates, CFG_TUH_AUDIO_RATE_MAX);
+            for(uint8_t i=0; i<alt->rate_count; i++) alt->rates[i] = u24_read(p_desc + 8 + 3*i);
+          }
+        }
+      }
+    }
+    else if ( alt && TUSB_DESC_ENDPOINT == desc_type )
+    {
+      tusb_desc_endpoint_t const* desc_ep = (tusb_desc_endpoint_t const*) p_desc;
+
+      if ( TUSB_XFER_ISOCHRONOUS == desc_ep->bmAttributes.xfer )
+      {
+        if ( 0 == alt_ep->ep.bLength )
+        {
+          if ( alt->channels && alt->subframe )
+          {
+            memcpy(&alt_ep->ep, desc_ep, sizeof(tusb_desc_endpoint_t));
+            alt->ep_size     = (uint16_t) (desc_ep->wMaxPacketSize.size * (desc_ep->wMaxPacketSize.hs_period_mult + 1u));
+            alt->ep_interval = desc_ep->bInterval;
+            st->info.dir     = tu_edpt_dir(desc_ep->bEndpointAddress);
+            st->info.alt_count++;
+          }
+        }
+        else if ( tu_edpt_dir(desc_ep->bEndpointAddress) != tu_edpt_dir(alt_ep->ep.bEndpointAddress) )
+        {
+          memcpy(&alt_ep->ep_fb, desc_ep, sizeof(tusb_desc_endpoint_t));
+          alt->feedback = true;
+        }
+      }
+    }
+    else if ( alt_ep && TUSB_DESC_CS_ENDPOINT == desc_type && !v2 && AUDIO_CS_EP_SUBTYPE_GENERAL == p_desc[2] )
+    {
+      alt_ep->rate_ctrl = (p_desc[3] & AUDIO10_EP_ATT_SAMPLING_FREQ) ? true : false;
+    }
+
+    p_desc = tu_desc_next(p_desc);
+  }
+
+  *p_length = (uint16_t) (p_desc - (uint8_t const*) itf_desc);
+
+  // audio function without streaming interface e.g MIDI only, control interface is left unclaimed
+  TU_VERIFY(p_audio->stream_count);
+
+  p_audio->rhport   = rhport;
+  p_audio->dev_addr = dev_addr;
+  p_audio->itf_num  = itf_desc->bInterfaceNumber;
+  p_audio->protocol = itf_desc->bInterfaceProtocol;
+
+  return true;
+}
+
+bool audioh_set_config(uint8_t dev_addr, uint8_t itf_num)
+{
+  for(uint8_t inst=0; inst<CFG_TUH_AUDIO; inst++)
+  {
+    audioh_interface_t* p_audio = &_audioh_itf[inst];
+
+    if ( p_audio->dev_addr == dev_addr && p_audio->itf_num == itf_num )
+    {
+      p_audio->mounted = true;
+      if ( tuh_audio_mounted_cb ) tuh_audio_mounted_cb(inst);
+    }
+  }
+
+  // no class request, next interface is configured right away
+  return false;
+}
+
+void audioh_xfer_cb(uint8_t dev_addr, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes)
+{
+  // may be stale if stream is stopped after transfer completed
+  uint8_t stream;
+  audioh_interface_t* p_audio = get_instance(dev_addr, ep_addr, &stream);
+  TU_VERIFY(p_audio, );
+
+  audioh_stream_t* st = &p_audio->stream[stream];
+  uint8_t const inst = get_inst(p_audio);
+
+  if ( ep_addr != get_alt_ep(st)->ep.bEndpointAddress )
+  {
+    if ( XFER_RESULT_SUCCESS == event ) fb_update(p_audio, stream, xferred_bytes);
+    fb_queue(p_audio, stream);
+    return;
+  }
+
+  TU_VERIFY(st->xfer_count, );
+
+  uint8_t const slot = st->xfer_head;
+  st->xfer_head = (uint8_t) ((slot + 1) % AUDIOH_XFER_SLOTS);
+  st->xfer_count--;
+
+  // failed transfer has lost packets (length 0), stream goes on
+  if ( TUSB_DIR_IN == st->info.dir )
+  {
+    rx_store(p_audio, stream, slot);
+    (void) xfer_queue(p_audio, stream);
+
+    if ( tuh_audio_rx_cb ) tuh_audio_rx_cb(inst, stream);
+  }
+  else
+  {
+    (void) xfer_queue(p_audio, stream);
+
+    if ( tuh_audio_tx_cb ) tuh_audio_tx_cb(inst, stream);
+  }
+}
+
+void audioh_close(uint8_t dev_addr)
+{
+  for(uint8_t inst=0; inst<CFG_TUH_AUDIO; inst++)
+  {
+    audioh_interface_t* p_audio = &_audioh_itf[inst];
+
+    if ( p_audio->dev_addr == dev_addr )
+    {
+      // endpoints are closed by usbh
+      if ( p_audio->mounted && tuh_audio_unmounted_cb ) tuh_audio_unmounted_cb(inst);
+
+      tu_memclr(p_audio, ITF_MEM_RESET_SIZE);
+      for(uint8_t s=0; s<CFG_TUH_AUDIO_STREAM_MAX; s++) tu_fifo_clear(&p_audio->ff[s]);
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,138 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+/** \ingroup group_class
+ *  \defgroup ClassDriver_Audio_Host Audio Host
+ *  @{ */
+
+#ifndef _TUSB_AUDIO_HOST_H_
+#define _TUSB_AUDIO_HOST_H_
+
+#include "common/tusb_common.h"
+#include "host/usbh.h"
+#include "audio.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+//--------------------------------------------------------------------+
+// Class Driver Configuration
+//--------------------------------------------------------------------+
+// CFG_TUH_AUDIO is the number of audio functions (UAC1 or UAC2) across all devices. Each claims its control
+// interface and the streaming interfaces following it, up to CFG_TUH_AUDIO_STREAM_MAX of them are usable.
+// A started stream keeps two transfers of CFG_TUH_AUDIO_XFER_PACKETS packets queued on its isochronous
+// endpoint, samples go through a FIFO of CFG_TUH_AUDIO_FIFO_SIZE bytes (tusb_option.h).
+
+// Alternate setting of a streaming interface (PCM format type I)
+typedef struct
+{
+  uint8_t  alt;          // bAlternateSetting
+  uint8_t  channels;
+  uint8_t  subframe;     // bytes per sample
+  uint8_t  bits;         // valid bits per sample
+  uint16_t ep_size;      // bytes per service interval, including additional high speed transactions
+  uint8_t  ep_interval;  // bInterval
+  bool     feedback;     // asynchronous OUT endpoint with explicit feedback endpoint
+
+  // Discrete rates (Hz) in rates[0..rate_count-1]. If rate_count is 0, rates[0] and rates[1] are the
+  // continuous range (UAC1) or are 0 as rates are reported by clock source (UAC2) and any rate can be tried
+  uint8_t  rate_count;
+  uint32_t rates[CFG_TUH_AUDIO_RATE_MAX];
+} tuh_audio_alt_t;
+
+typedef struct
+{
+  uint8_t itf_num;
+  uint8_t dir;           // TUSB_DIR_OUT to device e.g speaker, TUSB_DIR_IN from device e.g microphone
+  uint8_t alt_count;
+  tuh_audio_alt_t alt[CFG_TUH_AUDIO_ALT_MAX];
+} tuh_audio_stream_info_t;
+
+//--------------------------------------------------------------------+
+// Application API
+// inst is instance index in order functions are mounted, stream is index of streaming interface within
+// the function. Must be called in the same context as tuh_task()
+//--------------------------------------------------------------------+
+bool     tuh_audio_n_mounted     (uint8_t inst);
+uint8_t  tuh_audio_n_dev_addr    (uint8_t inst);
+uint8_t  tuh_audio_n_stream_count(uint8_t inst);
+
+// Descriptor info of a streaming interface, NULL if stream does not exist
+tuh_audio_stream_info_t const* tuh_audio_n_stream_info(uint8_t inst, uint8_t stream);
+
+// Select the alternate setting of smallest bandwidth carrying channels x bytes_per_sample samples at rate,
+// set the sampling rate and start streaming. Completion is reported by tuh_audio_stream_started_cb().
+// Return false if no alternate setting fits or control pipe is busy. OUT stream sends silence while FIFO is empty
+bool     tuh_audio_n_stream_start(uint8_t inst, uint8_t stream, uint32_t rate, uint8_t channels, uint8_t bytes_per_sample);
+
+// Stop streaming and select alternate setting 0 (zero bandwidth), samples left in FIFO are dropped
+bool     tuh_audio_n_stream_stop (uint8_t inst, uint8_t stream);
+
+bool     tuh_audio_n_streaming   (uint8_t inst, uint8_t stream);
+
+// Queue samples of OUT stream (interleaved channels), return bytes copied. Whole samples are sent as
+// rate feedback of device dictates
+uint32_t tuh_audio_n_write          (uint8_t inst, uint8_t stream, void const* buffer, uint32_t bufsize);
+uint32_t tuh_audio_n_write_available(uint8_t inst, uint8_t stream);
+
+// Read samples received on IN stream, return bytes copied. Samples are dropped while FIFO is full
+uint32_t tuh_audio_n_read     (uint8_t inst, uint8_t stream, void* buffer, uint32_t bufsize);
+uint32_t tuh_audio_n_available(uint8_t inst, uint8_t stream);
+
+//--------------------------------------------------------------------+
+// Application Callback API (weak is optional)
+//--------------------------------------------------------------------+
+
+// Invoked when function is mounted and unmounted, streams are stopped on unmount
+TU_ATTR_WEAK void tuh_audio_mounted_cb(uint8_t inst);
+TU_ATTR_WEAK void tuh_audio_unmounted_cb(uint8_t inst);
+
+// Invoked when tuh_audio_n_stream_start() completes, stream is stopped if failed e.g rate is not supported
+TU_ATTR_WEAK void tuh_audio_stream_started_cb(uint8_t inst, uint8_t stream, bool success);
+
+// Invoked in tuh_task() when a transfer of IN stream is received into FIFO
+TU_ATTR_WEAK void tuh_audio_rx_cb(uint8_t inst, uint8_t stream);
+
+// Invoked in tuh_task() when a transfer of OUT stream is filled from FIFO, i.e room is available
+TU_ATTR_WEAK void tuh_audio_tx_cb(uint8_t inst, uint8_t stream);
+
+//--------------------------------------------------------------------+
+// Internal Class Driver API
+//--------------------------------------------------------------------+
+void audioh_init(void);
+bool audioh_open(uint8_t rhport, uint8_t dev_addr, tusb_desc_interface_t const *itf_desc, uint16_t *p_length);
+bool audioh_set_config(uint8_t dev_addr, uint8_t itf_num);
+void audioh_xfer_cb(uint8_t dev_addr, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes);
+void audioh_close(uint8_t dev_addr);
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif /* _TUSB_AUDIO_HOST_H_ */
+
+/** @} */
@@ -0,0 +1,345 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#include "tusb_option.h"
+
+#if (TUSB_OPT_DEVICE_ENABLED && CFG_TUD_BTH)
+
+#include "bth_device.h"
+#include "device/usbd_pvt.h"
+
+//--------------------------------------------------------------------+
+// MACRO CONSTANT TYPEDEF
+//--------------------------------------------------------------------+
+#if CFG_TUD_BTH_QUEUE_DEPTH > 1 && (!defined(CFG_TUD_EDPT_XFER_QUEUE) || CFG_TUD_EDPT_XFER_QUEUE < CFG_TUD_BTH_QUEUE_DEPTH - 1)
+  #error "CFG_TUD_BTH requires CFG_TUD_EDPT_XFER_QUEUE >= CFG_TUD_BTH_QUEUE_DEPTH - 1"
+#endif
+
+#if CFG_TUD_SPLIT_CORE
+  #error "CFG_TUD_BTH queues application buffers on endpoints, it is not supported by CFG_TUD_SPLIT_CORE"
+#endif
+
+// Application buffers queued on an endpoint, completed in order
+typedef struct
+{
+  uint8_t* buf[CFG_TUD_BTH_QUEUE_DEPTH];
+  uint8_t  rd_idx;
+  uint8_t  count;
+}btd_queue_t;
+
+typedef struct
+{
+  uint8_t rhport;
+  uint8_t itf_num;
+
+  uint8_t ep_event;
+  uint8_t ep_acl_in;
+  uint8_t ep_acl_out;
+
+  // isochronous endpoints of current alternate setting of voice interface, if any
+  uint8_t ep_sco_in;
+  uint8_t ep_sco_out;
+  uint8_t sco_alt;
+
+  btd_queue_t event_q;
+  btd_queue_t acl_in_q;
+  btd_queue_t acl_out_q;
+  btd_queue_t sco_in_q;
+  btd_queue_t sco_out_q;
+}btd_interface_t;
+
+CFG_TUSB_MEM_SECTION static btd_interface_t _btd_itf;
+
+// HCI command received in control transfer DATA stage
+CFG_TUSB_MEM_SECTION CFG_TUSB_MEM_ALIGN static uint8_t _btd_cmd[CFG_TUD_BTH_CMD_BUFSIZE];
+
+//--------------------------------------------------------------------+
+// Queue
+//--------------------------------------------------------------------+
+static bool queue_xfer(uint8_t ep_addr, btd_queue_t* queue, uint8_t* buffer, uint16_t bufsize)
+{
+  TU_VERIFY( ep_addr && queue->count < CFG_TUD_BTH_QUEUE_DEPTH );
+
+  // extra transfers are queued by usbd and started in isr right after the current one
+  queue->buf[(queue->rd_idx + queue->count) % CFG_TUD_BTH_QUEUE_DEPTH] = buffer;
+  TU_VERIFY( usbd_edpt_xfer(_btd_itf.rhport, ep_addr, buffer, bufsize) );
+  queue->count++;
+
+  return true;
+}
+
+// Buffer of the oldest transfer, which is the one just completed
+static uint8_t* queue_complete(btd_queue_t* queue)
+{
+  TU_VERIFY( queue->count, NULL );
+
+  uint8_t* buffer = queue->buf[queue->rd_idx];
+  queue->rd_idx = (uint8_t) ((queue->rd_idx + 1) % CFG_TUD_BTH_QUEUE_DEPTH);
+  queue->count--;
+
+  return buffer;
+}
+
+//--------------------------------------------------------------------+
+// Application API
+//--------------------------------------------------------------------+
+bool tud_bth_mounted(void)
+{
+  return _btd_itf.ep_acl_in != 0;
+}
+
+// Host reassembles events and ACL packets from their HCI header, they need no ZLP
+bool tud_bth_event_send(void const* event, uint16_t len)
+{
+  return queue_xfer(_btd_itf.ep_event, &_btd_itf.event_q, (uint8_t*) event, len);
+}
+
+bool tud_bth_acl_send(void const* acl, uint16_t len)
+{
+  return queue_xfer(_btd_itf.ep_acl_in, &_btd_itf.acl_in_q, (uint8_t*) acl, len);
+}
+
+bool tud_bth_acl_receive(void* buf, uint16_t bufsize)
+{
+  return queue_xfer(_btd_itf.ep_acl_out, &_btd_itf.acl_out_q, (uint8_t*) buf, bufsize);
+}
+
+bool tud_bth_sco_send(void const* sco, uint16_t len)
+{
+  return queue_xfer(_btd_itf.ep_sco_in, &_btd_itf.sco_in_q, (uint8_t*) sco, len);
+}
+
+bool tud_bth_sco_receive(void* buf, uint16_t bufsize)
+{
+  return queue_xfer(_btd_itf.ep_sco_out, &_btd_itf.sco_out_q, (uint8_t*) buf, bufsize);
+}
+
+uint8_t tud_bth_sco_alt(void)
+{
+  return _btd_itf.sco_alt;
+}
+
+uint8_t tud_bth_acl_send_pending(void)
+{
+  return _btd_itf.acl_in_q.count;
+}
+
+uint8_t tud_bth_acl_receive_pending(void)
+{
+  return _btd_itf.acl_out_q.count;
+}
+
+//--------------------------------------------------------------------+
+// USBD Driver API
+//--------------------------------------------------------------------+
+void btd_init(void)
+{
+  tu_memclr(&_btd_itf, sizeof(_btd_itf));
+}
+
+void btd_reset(uint8_t rhport)
+{
+  // interface in use by the other roothub port is untouched
+  if ( _btd_itf.ep_acl_in && _btd_itf.rhport != rhport ) return;
+
+  btd_init();
+}
+
+bool btd_open(uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t *p_length, uint8_t *p_inst)
+{
+  (void) p_inst; // single instance
+
+  // Wireless controller, RF controller, Bluetooth programming interface (RNDIS shares the class)
+  TU_VERIFY(TUD_BT_APP_SUBCLASS == itf_desc->bInterfaceSubClass && TUD_BT_PROTOCOL_PRIMARY_CONTROLLER == itf_desc->bInterfaceProtocol);
+
+  btd_interface_t* p_bt = &_btd_itf;
+  TU_ASSERT(p_bt->ep_acl_in == 0);
+
+  // HCI interface: event interrupt IN, ACL bulk IN and OUT
+  TU_ASSERT(3 == itf_desc->bNumEndpoints);
+
+  p_bt->rhport  = rhport;
+  p_bt->itf_num = itf_desc->bInterfaceNumber;
+
+  uint8_t const * p_desc = tu_desc_next( itf_desc );
+  (*p_length) = sizeof(tusb_desc_interface_t);
+
+  for(uint8_t i=0; i<3; i++)
+  {
+    tusb_desc_endpoint_t const * desc_ep = (tusb_desc_endpoint_t const *) p_desc;
+    TU_ASSERT( TUSB_DESC_ENDPOINT == desc_ep->bDescriptorType );
+    TU_ASSERT( dcd_edpt_open(rhport, desc_ep) );
+
+    uint8_t const ep_addr = desc_ep->bEndpointAddress;
+    if ( TUSB_XFER_INTERRUPT == desc_ep->bmAttributes.xfer )
+    {
+      p_bt->ep_event = ep_addr;
+    }
+    else if ( TUSB_DIR_IN == tu_edpt_dir(ep_addr) )
+    {
+      p_bt->ep_acl_in = ep_addr;
+    }else
+    {
+      p_bt->ep_acl_out = ep_addr;
+    }
+
+    (*p_length) += tu_desc_len(p_desc);
+    p_desc = tu_desc_next(p_desc);
+  }
+
+  TU_ASSERT( p_bt->ep_event && p_bt->ep_acl_in && p_bt->ep_acl_out );
+
+#if CFG_TUD_BTH_ISO_ALT_COUNT
+  //------------- Voice Interface -------------//
+  // All alternate settings are claimed, usbd switches their endpoints on SET_INTERFACE and invokes btd_set_alt().
+  // Zero bandwidth alternate 0 is expected without endpoint.
+  for(uint8_t alt=0; alt <= CFG_TUD_BTH_ISO_ALT_COUNT; alt++)
+  {
+    tusb_desc_interface_t const* desc_alt = (tusb_desc_interface_t const*) p_desc;
+    TU_ASSERT( TUSB_DESC_INTERFACE == desc_alt->bDescriptorType &&
+               desc_alt->bInterfaceNumber == p_bt->itf_num + 1 && desc_alt->bAlternateSetting == alt );
+
+    (*p_length) += tu_desc_len(p_desc);
+    p_desc = tu_desc_next(p_desc);
+
+    for(uint8_t i=0; i<desc_alt->bNumEndpoints; i++)
+    {
+      TU_ASSERT( TUSB_DESC_ENDPOINT == tu_desc_type(p_desc) );
+      (*p_length) += tu_desc_len(p_desc);
+      p_desc = tu_desc_next(p_desc);
+    }
+  }
+#endif
+
+  return true;
+}
+
+bool btd_set_alt(uint8_t rhport, tusb_desc_interface_t const * desc_itf, uint16_t desc_len)
+{
+  (void) rhport;
+
+  btd_interface_t* p_bt = &_btd_itf;
+
+  if ( desc_itf->bInterfaceNumber == p_bt->itf_num )
+  {
+    // HCI interface has only alternate 0: endpoints are reopened, queued buffers are dropped
+    tu_varclr(&p_bt->event_q);
+    tu_varclr(&p_bt->acl_in_q);
+    tu_varclr(&p_bt->acl_out_q);
+    return true;
+  }
+
+  p_bt->ep_sco_in  = 0;
+  p_bt->ep_sco_out = 0;
+  tu_varclr(&p_bt->sco_in_q);
+  tu_varclr(&p_bt->sco_out_q);
+
+  uint8_t const * p_desc   = (uint8_t const*) desc_itf;
+  uint8_t const * desc_end = p_desc + desc_len;
+
+  for( ; p_desc < desc_end; p_desc = tu_desc_next(p_desc) )
+  {
+    if ( TUSB_DESC_ENDPOINT == tu_desc_type(p_desc) )
+    {
+      uint8_t const ep_addr = ((tusb_desc_endpoint_t const*) p_desc)->bEndpointAddress;
+
+      if ( TUSB_DIR_IN == tu_edpt_dir(ep_addr) )
+      {
+        p_bt->ep_sco_in = ep_addr;
+      }else
+      {
+        p_bt->ep_sco_out = ep_addr;
+      }
+    }
+  }
+
+  p_bt->sco_alt = desc_itf->bAlternateSetting;
+  if ( tud_bth_sco_alt_cb ) tud_bth_sco_alt_cb(p_bt->sco_alt);
+
+  return true;
+}
+
+// HCI command is a class request to device (bmRequestType 0x20) with interface number in wIndex.
+// Some hosts address it to the interface instead (0x21).
+bool btd_control_request(uint8_t rhport, tusb_control_request_t const * request)
+{
+  TU_VERIFY(TUSB_REQ_TYPE_CLASS == request->bmRequestType_bit.type);
+  TU_VERIFY(TUSB_DIR_OUT == request->bmRequestType_bit.direction);
+  TU_VERIFY(tu_u16_low(request->wIndex) == _btd_itf.itf_num);
+
+  // processed in btd_control_complete()
+  TU_VERIFY(0 < request->wLength && request->wLength <= sizeof(_btd_cmd));
+  return tud_control_xfer(rhport, request, _btd_cmd, request->wLength);
+}
+
+// Invoked when class request DATA stage is finished.
+bool btd_control_complete(uint8_t rhport, tusb_control_request_t const * request)
+{
+  (void) rhport;
+
+  tud_bth_hci_cmd_cb(_btd_cmd, request->wLength);
+
+  return true;
+}
+
+bool btd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes)
+{
+  (void) rhport;
+  (void) result;
+
+  btd_interface_t* p_bt = &_btd_itf;
+
+  // next queued buffer is already being transferred, application can queue another one in callback
+  if ( ep_addr == p_bt->ep_acl_out )
+  {
+    uint8_t* buffer = queue_complete(&p_bt->acl_out_q);
+    if ( buffer && tud_bth_acl_received_cb ) tud_bth_acl_received_cb(buffer, xferred_bytes);
+  }
+  else if ( ep_addr == p_bt->ep_acl_in )
+  {
+    uint8_t const* buffer = queue_complete(&p_bt->acl_in_q);
+    if ( buffer && tud_bth_acl_sent_cb ) tud_bth_acl_sent_cb(buffer, xferred_bytes);
+  }
+  else if ( ep_addr == p_bt->ep_event )
+  {
+    uint8_t const* buffer = queue_complete(&p_bt->event_q);
+    if ( buffer && tud_bth_event_sent_cb ) tud_bth_event_sent_cb(buffer, xferred_bytes);
+  }
+  else if ( ep_addr == p_bt->ep_sco_out )
+  {
+    uint8_t* buffer = queue_complete(&p_bt->sco_out_q);
+    if ( buffer && tud_bth_sco_received_cb ) tud_bth_sco_received_cb(buffer, xferred_bytes);
+  }
+  else if ( ep_addr == p_bt->ep_sco_in )
+  {
+    uint8_t const* buffer = queue_complete(&p_bt->sco_in_q);
+    if ( buffer && tud_bth_sco_sent_cb ) tud_bth_sco_sent_cb(buffer, xferred_bytes);
+  }
+
+  return true;
+}
+
+#endif
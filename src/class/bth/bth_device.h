@@ -0,0 +1,137 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2020 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#ifndef _TUSB_BTH_DEVICE_H_
+#define _TUSB_BTH_DEVICE_H_
+
+#include "common/tusb_common.h"
+#include "device/usbd.h"
+
+//--------------------------------------------------------------------+
+// Class Driver Configuration
+//--------------------------------------------------------------------+
+
+// Buffer receiving HCI command from control endpoint, larger commands are stalled.
+// Default fits the largest command: 3 bytes header + 255 bytes parameters
+#ifndef CFG_TUD_BTH_CMD_BUFSIZE
+#define CFG_TUD_BTH_CMD_BUFSIZE     258
+#endif
+
+// Number of application buffers can be queued on each of event, ACL and SCO endpoints. Transfers beyond
+// the first one are queued by usbd and started right after the previous one in isr, hence this requires
+// CFG_TUD_EDPT_XFER_QUEUE >= CFG_TUD_BTH_QUEUE_DEPTH - 1
+#ifndef CFG_TUD_BTH_QUEUE_DEPTH
+#define CFG_TUD_BTH_QUEUE_DEPTH     2
+#endif
+
+// Number of alternate settings of voice (SCO) interface following HCI interface, not counting the zero
+// bandwidth alternate 0. Voice interface is not part of the function if 0 e.g Bluetooth LE only controller
+#ifndef CFG_TUD_BTH_ISO_ALT_COUNT
+#define CFG_TUD_BTH_ISO_ALT_COUNT   0
+#endif
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/** \addtogroup ClassDriver_BTH Bluetooth HCI
+ *  @{ */
+
+//--------------------------------------------------------------------+
+// Application API
+// Buffers are passed to the endpoints without copy: they must stay valid (and be DMA-capable) until
+// their callback is invoked. Return false if the queue is full or interface is not ready.
+// Must be called in the same context as tud_task() e.g from callbacks.
+//--------------------------------------------------------------------+
+
+// Check if HCI interface is configured by host
+bool    tud_bth_mounted(void);
+
+// Queue an HCI event packet on interrupt endpoint
+bool    tud_bth_event_send(void const* event, uint16_t len);
+
+// Queue an ACL packet to host on bulk endpoint
+bool    tud_bth_acl_send(void const* acl, uint16_t len);
+
+// Queue a buffer to receive ACL data from host. bufsize should be multiple of the bulk endpoint size,
+// a short packet completes the transfer. Host may send packets back to back, they are delimited by
+// their HCI header.
+bool    tud_bth_acl_receive(void* buf, uint16_t bufsize);
+
+// Queue SCO data on isochronous endpoints of the current alternate setting of voice interface
+bool    tud_bth_sco_send(void const* sco, uint16_t len);
+bool    tud_bth_sco_receive(void* buf, uint16_t bufsize);
+
+// Alternate setting of voice interface selected by host, 0 is no SCO bandwidth
+uint8_t tud_bth_sco_alt(void);
+
+// Number of queued buffers not yet completed
+uint8_t tud_bth_acl_send_pending(void);
+uint8_t tud_bth_acl_receive_pending(void);
+
+//--------------------------------------------------------------------+
+// Application Callbacks (WEAK is optional)
+//--------------------------------------------------------------------+
+
+// Invoked when received an HCI command. Buffer is reused by next command, which host sends only when
+// allowed by HCI flow control (Num_HCI_Command_Packets of the events).
+void tud_bth_hci_cmd_cb(void* hci_cmd, uint16_t cmd_len);
+
+// Invoked when a buffer queued by tud_bth_event_send() is sent
+TU_ATTR_WEAK void tud_bth_event_sent_cb(uint8_t const* event, uint32_t sent_bytes);
+
+// Invoked when a buffer queued by tud_bth_acl_send() is sent
+TU_ATTR_WEAK void tud_bth_acl_sent_cb(uint8_t const* acl, uint32_t sent_bytes);
+
+// Invoked when a buffer queued by tud_bth_acl_receive() is filled or ended by a short packet
+TU_ATTR_WEAK void tud_bth_acl_received_cb(uint8_t* buf, uint32_t xferred_bytes);
+
+// Invoked when host selects an alternate setting of voice interface. Queued SCO buffers of the
+// previous one are dropped without callback.
+TU_ATTR_WEAK void tud_bth_sco_alt_cb(uint8_t alt);
+
+// Invoked when a SCO buffer is sent or received
+TU_ATTR_WEAK void tud_bth_sco_sent_cb(uint8_t const* sco, uint32_t sent_bytes);
+TU_ATTR_WEAK void tud_bth_sco_received_cb(uint8_t* buf, uint32_t xferred_bytes);
+
+/** @} */
+
+//--------------------------------------------------------------------+
+// Internal Class Driver API
+//--------------------------------------------------------------------+
+void btd_init            (void);
+void btd_reset           (uint8_t rhport);
+bool btd_open            (uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t *p_length, uint8_t *p_inst);
+bool btd_control_request (uint8_t rhport, tusb_control_request_t const * request);
+bool btd_control_complete(uint8_t rhport, tusb_control_request_t const * request);
+bool btd_xfer_cb         (uint8_t rhport, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes);
+bool btd_set_alt         (uint8_t rhport, tusb_desc_interface_t const * desc_itf, uint16_t desc_len);
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif /* _TUSB_BTH_DEVICE_H_ */
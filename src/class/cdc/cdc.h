@@ -69,7 +69,8 @@ typedef enum
   CDC_COMM_SUBCLASS_DEVICE_MANAGEMENT                 , ///< Device Management  [USBWMC1.1]
   CDC_COMM_SUBCLASS_MOBILE_DIRECT_LINE_MODEL          , ///< Mobile Direct Line Model  [USBWMC1.1]
   CDC_COMM_SUBCLASS_OBEX                              , ///< OBEX  [USBWMC1.1]
-  CDC_COMM_SUBCLASS_ETHERNET_EMULATION_MODEL            ///< Ethernet Emulation Model  [USBEEM1.0]
+  CDC_COMM_SUBCLASS_ETHERNET_EMULATION_MODEL          , ///< Ethernet Emulation Model  [USBEEM1.0]
+  CDC_COMM_SUBCLASS_NETWORK_CONTROL_MODEL               ///< Network Control Model  [USBNCM1.0]
 } cdc_comm_sublcass_type_t;
 
 /// Communication Interface Protocol Codes
@@ -114,7 +115,8 @@ typedef enum
   CDC_FUNC_DESC_COMMAND_SET                                      = 0x16 , ///< Command Set Functional Descriptor
   CDC_FUNC_DESC_COMMAND_SET_DETAIL                               = 0x17 , ///< Command Set Detail Functional Descriptor
   CDC_FUNC_DESC_TELEPHONE_CONTROL_MODEL                          = 0x18 , ///< Telephone Control Model Functional Descriptor
-  CDC_FUNC_DESC_OBEX_SERVICE_IDENTIFIER                          = 0x19   ///< OBEX Service Identifier Functional Descriptor
+  CDC_FUNC_DESC_OBEX_SERVICE_IDENTIFIER                          = 0x19 , ///< OBEX Service Identifier Functional Descriptor
+  CDC_FUNC_DESC_NCM                                              = 0x1A   ///< NCM Functional Descriptor
 }cdc_func_desc_type_t;
 
 //--------------------------------------------------------------------+
@@ -211,6 +213,27 @@ typedef enum
   MDLM_SEMANTIC_MODEL_NOTIFICATION = 0x40,
 }cdc_notification_request_t;
 
+/// UART State bitmap of SERIAL_STATE notification. DCD and DSR are line levels, others are irregular
+/// events which host considers cleared once notified
+enum
+{
+  CDC_SERIAL_STATE_DCD     = TU_BIT(0), ///< bRxCarrier
+  CDC_SERIAL_STATE_DSR     = TU_BIT(1), ///< bTxCarrier
+  CDC_SERIAL_STATE_BREAK   = TU_BIT(2),
+  CDC_SERIAL_STATE_RING    = TU_BIT(3),
+  CDC_SERIAL_STATE_FRAMING = TU_BIT(4),
+  CDC_SERIAL_STATE_PARITY  = TU_BIT(5),
+  CDC_SERIAL_STATE_OVERRUN = TU_BIT(6),
+};
+
+typedef struct TU_ATTR_PACKED
+{
+  tusb_control_request_t header; ///< bmRequestType 0xA1, bRequest SERIAL_STATE, wIndex interface, wLength 2
+  uint16_t serial_state;
+} cdc_notify_serial_state_t;
+
+TU_VERIFY_STATIC(sizeof(cdc_notify_serial_state_t) == 10, "size is not correct");
+
 //--------------------------------------------------------------------+
 // Class Specific Functional Descriptor (Communication Interface)
 //--------------------------------------------------------------------+
@@ -34,8 +34,14 @@
 //--------------------------------------------------------------------+
 // MACRO CONSTANT TYPEDEF
 //--------------------------------------------------------------------+
+#define EPOUT_BUF_COUNT   (CFG_TUD_EPOUT_DOUBLE_BUFFER ? 2 : 1)
+
+// IN transfer buffer is borrowed from usbd pool instead of reserved per interface
+#define EPIN_BUF_POOL     (CFG_TUD_EP_POOL_COUNT && !CFG_TUD_FIFO_ZERO_COPY)
+
 typedef struct
 {
+  uint8_t rhport;
   uint8_t itf_num;
   uint8_t ep_notif;
   uint8_t ep_in;
@@ -44,6 +50,37 @@ typedef struct
   // Bit 0:  DTR (Data Terminal Ready), Bit 1: RTS (Request to Send)
   uint8_t line_state;
 
+  // index of epout[] buffer used by next OUT transfer
+  uint8_t epout_idx;
+
+  // IN transfer in progress is application buffer from tud_cdc_n_write_direct()
+  bool tx_direct;
+
+  // frames elapsed since tx fifo holds unsent data, see CFG_TUD_CDC_TX_FLUSH_FRAMES
+  uint8_t tx_frames;
+  bool    tx_sof; // SOF requested meanwhile, for the whole mount in split mode
+
+#if CFG_TUD_CDC_TX_MPSC
+  // flush from writer task is deferred to tud_task()
+  volatile bool tx_defer;
+#endif
+
+  // UART state: DCD/DSR levels with events not yet notified, levels of last notification
+  uint16_t serial_state;
+  uint16_t serial_state_sent;
+
+#if CFG_TUD_SPLIT_CORE
+  // requested by application core: rx fifo has room, tx fifo or serial state is to be sent
+  volatile bool split_rx;
+  volatile bool split_tx;
+  volatile bool split_notif;
+#endif
+
+#if EPIN_BUF_POOL
+  // borrowed from usbd pool by flush, returned when IN transfer is complete
+  uint8_t* epin_buf;
+#endif
+
   /*------------- From this point, data is not cleared by bus reset -------------*/
   char    wanted_char;
   cdc_line_coding_t line_coding;
@@ -52,49 +89,93 @@ typedef struct
   tu_fifo_t rx_ff;
   tu_fifo_t tx_ff;
 
-  uint8_t rx_ff_buf[CFG_TUD_CDC_RX_BUFSIZE];
-  uint8_t tx_ff_buf[CFG_TUD_CDC_TX_BUFSIZE];
-
 #if CFG_FIFO_MUTEX
   osal_mutex_def_t rx_ff_mutex;
+#if !CFG_TUD_CDC_TX_MPSC
   osal_mutex_def_t tx_ff_mutex;
 #endif
+#endif
+}cdcd_interface_t;
 
-  // Endpoint Transfer buffer
-  CFG_TUSB_MEM_ALIGN uint8_t epout_buf[CFG_TUD_CDC_EPSIZE];
-  CFG_TUSB_MEM_ALIGN uint8_t epin_buf[CFG_TUD_CDC_EPSIZE];
+// Endpoint Transfer buffer
+typedef struct
+{
+  CFG_TUSB_MEM_DMA_ALIGN uint8_t epout[EPOUT_BUF_COUNT][CFG_TUD_CDC_XFER_BUFSIZE];
+#if !CFG_TUD_FIFO_ZERO_COPY && !EPIN_BUF_POOL
+  CFG_TUSB_MEM_DMA_ALIGN uint8_t epin[CFG_TUD_CDC_XFER_BUFSIZE];
+#endif
+  CFG_TUSB_MEM_DMA_ALIGN cdc_notify_serial_state_t notif;
+}cdcd_epbuf_t;
 
-}cdcd_interface_t;
+// FIFO storage
+typedef struct
+{
+  uint8_t rx[CFG_TUD_CDC_RX_BUFSIZE];
+  uint8_t tx[CFG_TUD_CDC_TX_BUFSIZE];
+}cdcd_ffbuf_t;
 
 #define ITF_MEM_RESET_SIZE   offsetof(cdcd_interface_t, wanted_char)
 
+TU_VERIFY_STATIC((CFG_TUD_CDC_XFER_BUFSIZE % CFG_TUD_CDC_EPSIZE) == 0, "CFG_TUD_CDC_XFER_BUFSIZE must be multiple of CFG_TUD_CDC_EPSIZE");
+TU_VERIFY_STATIC(CFG_TUD_CDC_XFER_BUFSIZE <= UINT16_MAX, "CFG_TUD_CDC_XFER_BUFSIZE is too large");
+TU_VERIFY_STATIC(CFG_TUD_CDC_TX_FLUSH_FRAMES <= UINT8_MAX, "CFG_TUD_CDC_TX_FLUSH_FRAMES is too large");
+
+// tx fifo is sent without application flushing it
+#define TX_AUTO_FLUSH   (CFG_TUD_CDC_TX_AUTO_FLUSH || CFG_TUD_CDC_TX_FLUSH_FRAMES)
+
+// tx fifo is written without stack being told, SOF is kept enabled while mounted to check it
+#define TX_SOF_MOUNTED  (CFG_TUD_SPLIT_CORE || CFG_TUD_CDC_TX_MPSC)
+
 //--------------------------------------------------------------------+
 // INTERNAL OBJECT & FUNCTION DECLARATION
 //--------------------------------------------------------------------+
-CFG_TUSB_MEM_SECTION static cdcd_interface_t _cdcd_itf[CFG_TUD_CDC];
+CFG_TUSB_MEM_STATE_SECTION static cdcd_interface_t _cdcd_itf[CFG_TUD_CDC];
+CFG_TUSB_MEM_DMA_SECTION static cdcd_epbuf_t _cdcd_epbuf[CFG_TUD_CDC];
+
+#if CFG_TUD_FIFO_ZERO_COPY
+// tx fifo is transmitted in place
+CFG_TUSB_MEM_DMA_SECTION CFG_TUSB_MEM_DMA_ALIGN static cdcd_ffbuf_t _cdcd_ffbuf[CFG_TUD_CDC];
+#else
+CFG_TUSB_MEM_FIFO_SECTION static cdcd_ffbuf_t _cdcd_ffbuf[CFG_TUD_CDC];
+#endif
 
-static void _prep_out_transaction (uint8_t itf)
+// pending is number of received bytes not yet copied into rx fifo
+static void _prep_out_transaction (uint8_t itf, uint32_t pending)
 {
   cdcd_interface_t* p_cdc = &_cdcd_itf[itf];
 
   // skip if previous transfer not complete
-  if ( usbd_edpt_busy(TUD_OPT_RHPORT, p_cdc->ep_out) ) return;
+  if ( usbd_edpt_busy(p_cdc->rhport, p_cdc->ep_out) ) return;
 
   // Prepare for incoming data but only allow what we can store in the ring buffer.
-  uint16_t max_read = tu_fifo_remaining(&p_cdc->rx_ff);
-  if ( max_read >= CFG_TUD_CDC_EPSIZE )
+  // Transfer is made of whole packets, from one up to CFG_TUD_CDC_XFER_BUFSIZE.
+  uint32_t max_read = tu_fifo_remaining(&p_cdc->rx_ff);
+  max_read = (max_read > pending) ? tu_min32(max_read - pending, CFG_TUD_CDC_XFER_BUFSIZE) : 0;
+  max_read -= max_read % CFG_TUD_CDC_EPSIZE;
+
+  if ( max_read && usbd_edpt_xfer(p_cdc->rhport, p_cdc->ep_out, _cdcd_epbuf[itf].epout[p_cdc->epout_idx], max_read) )
   {
-    usbd_edpt_xfer(TUD_OPT_RHPORT, p_cdc->ep_out, p_cdc->epout_buf, CFG_TUD_CDC_EPSIZE);
+    p_cdc->epout_idx = (p_cdc->epout_idx + 1) % EPOUT_BUF_COUNT;
   }
 }
 
+// Application made room in rx fifo
+static void _rx_freed (uint8_t itf)
+{
+#if CFG_TUD_SPLIT_CORE
+  usbd_split_request(&_cdcd_itf[itf].split_rx);
+#else
+  _prep_out_transaction(itf, 0);
+#endif
+}
+
 //--------------------------------------------------------------------+
 // APPLICATION API
 //--------------------------------------------------------------------+
 bool tud_cdc_n_connected(uint8_t itf)
 {
   // DTR (bit 0) active  is considered as connected
-  return tud_ready() && tu_bit_test(_cdcd_itf[itf].line_state, 0);
+  return tud_n_ready(_cdcd_itf[itf].rhport) && tu_bit_test(_cdcd_itf[itf].line_state, 0);
 }
 
 uint8_t tud_cdc_n_get_line_state (uint8_t itf)
@@ -123,8 +204,8 @@ uint32_t tud_cdc_n_available(uint8_t itf)
 
 uint32_t tud_cdc_n_read(uint8_t itf, void* buffer, uint32_t bufsize)
 {
-  uint32_t num_read = tu_fifo_read_n(&_cdcd_itf[itf].rx_ff, buffer, bufsize);
-  _prep_out_transaction(itf);
+  uint32_t num_read = tu_fifo_read_n(&_cdcd_itf[itf].rx_ff, buffer, (tu_fifo_idx_t) tu_min32(bufsize, TU_FIFO_COUNT_MAX));
+  _rx_freed(itf);
   return num_read;
 }
 
@@ -135,18 +216,34 @@ bool tud_cdc_n_peek(uint8_t itf, int pos, uint8_t* chr)
 
 void tud_cdc_n_read_flush (uint8_t itf)
 {
-  tu_fifo_clear(&_cdcd_itf[itf].rx_ff);
-  _prep_out_transaction(itf);
+  // discarded on consumer side only, received data may be written meanwhile
+  tu_fifo_t* ff = &_cdcd_itf[itf].rx_ff;
+  tu_fifo_advance_read_pointer(ff, tu_fifo_count(ff));
+  _rx_freed(itf);
 }
 
 //--------------------------------------------------------------------+
 // WRITE API
 //--------------------------------------------------------------------+
+#if CFG_TUD_CDC_TX_FLUSH_FRAMES
+// SOF is only needed to flush lingering data
+static void _tx_sof_request (cdcd_interface_t* p_cdc, bool en)
+{
+  if ( p_cdc->tx_sof == en ) return;
+  p_cdc->tx_sof = en;
+  usbd_sof_enable(p_cdc->rhport, en);
+}
+#endif
+
 uint32_t tud_cdc_n_write(uint8_t itf, void const* buffer, uint32_t bufsize)
 {
-  uint16_t ret = tu_fifo_write_n(&_cdcd_itf[itf].tx_ff, buffer, bufsize);
+#if CFG_TUD_CDC_TX_MPSC
+  uint32_t ret = tu_fifo_write_n_mpsc(&_cdcd_itf[itf].tx_ff, buffer, (tu_fifo_idx_t) tu_min32(bufsize, TU_FIFO_COUNT_MAX));
+#else
+  uint32_t ret = tu_fifo_write_n(&_cdcd_itf[itf].tx_ff, buffer, (tu_fifo_idx_t) tu_min32(bufsize, TU_FIFO_COUNT_MAX));
+#endif
 
-#if 0 // TODO issue with circuitpython's REPL
+#if TX_AUTO_FLUSH
   // flush if queue more than endpoint size
   if ( tu_fifo_count(&_cdcd_itf[itf].tx_ff) >= CFG_TUD_CDC_EPSIZE )
   {
@@ -154,19 +251,95 @@ uint32_t tud_cdc_n_write(uint8_t itf, void const* buffer, uint32_t bufsize)
   }
 #endif
 
+#if CFG_TUD_CDC_TX_FLUSH_FRAMES && !TX_SOF_MOUNTED
+  // remaining data is flushed by cdcd_sof()
+  cdcd_interface_t* p_cdc = &_cdcd_itf[itf];
+  if ( p_cdc->ep_in && !tu_fifo_empty(&p_cdc->tx_ff) ) _tx_sof_request(p_cdc, true);
+#endif
+
   return ret;
 }
 
-bool tud_cdc_n_write_flush (uint8_t itf)
+// Start IN transfer with tx fifo content, in tud_task() context for split mode
+static bool _tx_flush (uint8_t itf)
 {
   cdcd_interface_t* p_cdc = &_cdcd_itf[itf];
-  TU_VERIFY( !usbd_edpt_busy(TUD_OPT_RHPORT, p_cdc->ep_in) ); // skip if previous transfer not complete
+  TU_VERIFY( !usbd_edpt_busy(p_cdc->rhport, p_cdc->ep_in) ); // skip if previous transfer not complete
+
+#if CFG_TUD_FIFO_ZERO_COPY
+  // transmit in place, data is removed from fifo when transfer is complete
+  uint8_t* buf;
+  uint16_t count = (uint16_t) tu_min32(tu_fifo_get_linear_read_info(&p_cdc->tx_ff, (void**) &buf), CFG_TUD_CDC_XFER_BUFSIZE);
+#elif EPIN_BUF_POOL
+  if ( tu_fifo_empty(&p_cdc->tx_ff) ) return true;
+
+  // kept until transfer is complete, retried by next flush if pool is exhausted
+  if ( !p_cdc->epin_buf ) p_cdc->epin_buf = usbd_ep_buf_alloc();
+  TU_VERIFY( p_cdc->epin_buf );
+
+  uint8_t* buf = p_cdc->epin_buf;
+  uint16_t count = (uint16_t) tu_fifo_read_n(&p_cdc->tx_ff, buf, tu_min16(CFG_TUD_CDC_XFER_BUFSIZE, CFG_TUD_EP_POOL_BUFSIZE));
+#else
+  uint8_t* buf = _cdcd_epbuf[itf].epin;
+  uint16_t count = (uint16_t) tu_fifo_read_n(&p_cdc->tx_ff, buf, CFG_TUD_CDC_XFER_BUFSIZE);
+#endif
 
-  uint16_t count = tu_fifo_read_n(&_cdcd_itf[itf].tx_ff, p_cdc->epin_buf, CFG_TUD_CDC_EPSIZE);
   if ( count )
   {
     TU_VERIFY( tud_cdc_n_connected(itf) ); // fifo is empty if not connected
-    TU_ASSERT( usbd_edpt_xfer(TUD_OPT_RHPORT, p_cdc->ep_in, p_cdc->epin_buf, count) );
+    TU_ASSERT( usbd_edpt_xfer(p_cdc->rhport, p_cdc->ep_in, buf, count) );
+  }
+
+  return true;
+}
+
+#if CFG_TUD_CDC_TX_MPSC
+static void _tx_flush_deferred (void* param)
+{
+  uint8_t const itf = (uint8_t) (uintptr_t) param;
+
+  // cleared before the flush so that a later request is not lost
+  _cdcd_itf[itf].tx_defer = false;
+  _tx_flush(itf);
+}
+#endif
+
+bool tud_cdc_n_write_flush (uint8_t itf)
+{
+#if CFG_TUD_SPLIT_CORE
+  // sent by stack core
+  usbd_split_request(&_cdcd_itf[itf].split_tx);
+  return true;
+#elif CFG_TUD_CDC_TX_MPSC
+  // any task may flush, IN transfer is started by tud_task() with at most one request queued
+  if ( !__atomic_exchange_n(&_cdcd_itf[itf].tx_defer, true, __ATOMIC_ACQ_REL) )
+  {
+    usbd_defer_func(_tx_flush_deferred, (void*) (uintptr_t) itf, false);
+  }
+  return true;
+#else
+  return _tx_flush(itf);
+#endif
+}
+
+bool tud_cdc_n_write_direct (uint8_t itf, void const* buffer, uint32_t bufsize)
+{
+  cdcd_interface_t* p_cdc = &_cdcd_itf[itf];
+
+  // endpoint is only driven by stack core in split mode, fifo emptiness is racy with many writers
+  TU_VERIFY( !CFG_TUD_SPLIT_CORE && !CFG_TUD_CDC_TX_MPSC );
+
+  // fifo must be empty to keep data in order
+  TU_VERIFY( bufsize && tu_fifo_empty(&p_cdc->tx_ff) );
+  TU_VERIFY( tud_cdc_n_connected(itf) );
+  TU_VERIFY( !usbd_edpt_busy(p_cdc->rhport, p_cdc->ep_in) );
+
+  // mark before submitting since transfer can complete right away
+  p_cdc->tx_direct = true;
+  if ( !usbd_edpt_xfer(p_cdc->rhport, p_cdc->ep_in, (uint8_t*) buffer, bufsize) )
+  {
+    p_cdc->tx_direct = false;
+    return false;
   }
 
   return true;
@@ -177,6 +350,55 @@ uint32_t tud_cdc_n_write_available (uint8_t itf)
   return tu_fifo_remaining(&_cdcd_itf[itf].tx_ff);
 }
 
+//--------------------------------------------------------------------+
+// SERIAL STATE API
+//--------------------------------------------------------------------+
+#define SERIAL_STATE_LINES   (CDC_SERIAL_STATE_DCD | CDC_SERIAL_STATE_DSR)
+
+// Send pending serial state, in tud_task() context for split mode
+static bool _notify_serial_state (uint8_t itf)
+{
+  cdcd_interface_t* p_cdc = &_cdcd_itf[itf];
+  TU_VERIFY( p_cdc->ep_notif && tud_n_ready(p_cdc->rhport) );
+  TU_VERIFY( !usbd_edpt_busy(p_cdc->rhport, p_cdc->ep_notif) ); // sent when previous one is complete
+
+  // levels unchanged and no event
+  uint16_t const state = p_cdc->serial_state;
+  if ( state == p_cdc->serial_state_sent ) return true;
+
+  cdc_notify_serial_state_t* notif = &_cdcd_epbuf[itf].notif;
+  notif->header.bmRequestType = 0xA1; // class, interface, device to host
+  notif->header.bRequest      = SERIAL_STATE;
+  notif->header.wValue        = 0;
+  notif->header.wIndex        = tu_htole16(p_cdc->itf_num);
+  notif->header.wLength       = tu_htole16(2);
+  notif->serial_state         = tu_htole16(state);
+
+  TU_ASSERT( usbd_edpt_xfer(p_cdc->rhport, p_cdc->ep_notif, (uint8_t*) notif, sizeof(cdc_notify_serial_state_t)) );
+
+  // events are reported once
+  p_cdc->serial_state      = state & SERIAL_STATE_LINES;
+  p_cdc->serial_state_sent = state & SERIAL_STATE_LINES;
+
+  return true;
+}
+
+bool tud_cdc_n_set_serial_state (uint8_t itf, uint16_t state)
+{
+  cdcd_interface_t* p_cdc = &_cdcd_itf[itf];
+  TU_VERIFY( p_cdc->ep_notif );
+
+  // new levels, events are merged with those not yet notified
+  p_cdc->serial_state = (uint16_t) ((state & SERIAL_STATE_LINES) | ((p_cdc->serial_state | state) & ~SERIAL_STATE_LINES));
+
+#if CFG_TUD_SPLIT_CORE
+  usbd_split_request(&p_cdc->split_notif);
+  return true;
+#else
+  return _notify_serial_state(itf);
+#endif
+}
+
 
 //--------------------------------------------------------------------+
 // USBD Driver API
@@ -198,35 +420,74 @@ void cdcd_init(void)
     p_cdc->line_coding.data_bits = 8;
 
     // config fifo
-    tu_fifo_config(&p_cdc->rx_ff, p_cdc->rx_ff_buf, CFG_TUD_CDC_RX_BUFSIZE, 1, false);
-    tu_fifo_config(&p_cdc->tx_ff, p_cdc->tx_ff_buf, CFG_TUD_CDC_TX_BUFSIZE, 1, false);
+    tu_fifo_config(&p_cdc->rx_ff, _cdcd_ffbuf[i].rx, CFG_TUD_CDC_RX_BUFSIZE, 1, false);
+    tu_fifo_config(&p_cdc->tx_ff, _cdcd_ffbuf[i].tx, CFG_TUD_CDC_TX_BUFSIZE, 1, false);
 
-#if CFG_FIFO_MUTEX
+#if CFG_TUD_CDC_TX_MPSC
+    tu_fifo_config_mpsc(&p_cdc->tx_ff);
+#endif
+
+#if CFG_FIFO_MUTEX && !CFG_TUD_SPLIT_CORE
+    // application core cannot take a mutex of stack core's RTOS, fifo is lock-free in split mode
     tu_fifo_config_mutex(&p_cdc->rx_ff, osal_mutex_create(&p_cdc->rx_ff_mutex));
+  #if !CFG_TUD_CDC_TX_MPSC
     tu_fifo_config_mutex(&p_cdc->tx_ff, osal_mutex_create(&p_cdc->tx_ff_mutex));
+  #endif
 #endif
   }
 }
 
 void cdcd_reset(uint8_t rhport)
 {
-  (void) rhport;
-
   for(uint8_t i=0; i<CFG_TUD_CDC; i++)
   {
+    // interface in use by the other roothub port is untouched
+    if ( _cdcd_itf[i].ep_in && _cdcd_itf[i].rhport != rhport ) continue;
+
+#if EPIN_BUF_POOL
+    // transfer is aborted by reset
+    if ( _cdcd_itf[i].epin_buf ) usbd_ep_buf_free(_cdcd_itf[i].epin_buf);
+#endif
+
     tu_memclr(&_cdcd_itf[i], ITF_MEM_RESET_SIZE);
     tu_fifo_clear(&_cdcd_itf[i].rx_ff);
     tu_fifo_clear(&_cdcd_itf[i].tx_ff);
   }
 }
 
-bool cdcd_open(uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t *p_length)
+// Same configuration selected again after bus reset: line coding and fifo content are kept
+void cdcd_reopen(uint8_t rhport, uint8_t inst)
+{
+  (void) rhport;
+  cdcd_interface_t* p_cdc = &_cdcd_itf[inst];
+
+  // transfers were aborted by reset
+#if EPIN_BUF_POOL
+  if ( p_cdc->epin_buf )
+  {
+    usbd_ep_buf_free(p_cdc->epin_buf);
+    p_cdc->epin_buf = NULL;
+  }
+#endif
+  p_cdc->tx_direct  = false;
+  p_cdc->tx_frames  = 0;
+  p_cdc->line_state = 0;
+
+  _prep_out_transaction(inst, 0);
+
+  // host lost the levels notified before reset
+  p_cdc->serial_state     &= SERIAL_STATE_LINES;
+  p_cdc->serial_state_sent = 0;
+  _notify_serial_state(inst);
+}
+
+bool cdcd_open(uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t *p_length, uint8_t *p_inst)
 {
-  // Only support ACM subclass
-  TU_ASSERT ( CDC_COMM_SUBCLASS_ABSTRACT_CONTROL_MODEL == itf_desc->bInterfaceSubClass);
+  // Only support ACM subclass, other CDC subclass (e.g NCM) is left to its driver
+  TU_VERIFY ( CDC_COMM_SUBCLASS_ABSTRACT_CONTROL_MODEL == itf_desc->bInterfaceSubClass);
 
   // Only support AT commands, no protocol and vendor specific commands.
-  TU_ASSERT(tu_within(CDC_COMM_PROTOCOL_NONE, itf_desc->bInterfaceProtocol, CDC_COMM_PROTOCOL_ATCOMMAND_CDMA) ||
+  TU_VERIFY(tu_within(CDC_COMM_PROTOCOL_NONE, itf_desc->bInterfaceProtocol, CDC_COMM_PROTOCOL_ATCOMMAND_CDMA) ||
             itf_desc->bInterfaceProtocol == 0xff);
 
   // Find available interface
@@ -242,7 +503,10 @@ bool cdcd_open(uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t
   }
   TU_ASSERT(p_cdc);
 
+  (*p_inst) = cdc_id;
+
   //------------- Control Interface -------------//
+  p_cdc->rhport  = rhport;
   p_cdc->itf_num = itf_desc->bInterfaceNumber;
 
   uint8_t const * p_desc = tu_desc_next( itf_desc );
@@ -279,8 +543,13 @@ bool cdcd_open(uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t
     (*p_length) += sizeof(tusb_desc_interface_t) + 2*sizeof(tusb_desc_endpoint_t);
   }
 
+#if CFG_TUD_CDC_TX_FLUSH_FRAMES && TX_SOF_MOUNTED
+  // data written by application core or writer tasks is not seen until flushed, tx fifo is checked every frame
+  if ( p_cdc->ep_in ) _tx_sof_request(p_cdc, true);
+#endif
+
   // Prepare for incoming data
-  _prep_out_transaction(cdc_id);
+  _prep_out_transaction(cdc_id, 0);
 
   return true;
 }
@@ -289,13 +558,11 @@ bool cdcd_open(uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t
 // return false to stall control endpoint (e.g Host send non-sense DATA)
 bool cdcd_control_complete(uint8_t rhport, tusb_control_request_t const * request)
 {
-  (void) rhport;
-
   //------------- Class Specific Request -------------//
   TU_VERIFY (request->bmRequestType_bit.type == TUSB_REQ_TYPE_CLASS);
 
-  // TODO Support multiple interfaces
-  uint8_t const itf = 0;
+  uint8_t const itf = usbd_itf_inst(rhport, (uint8_t) request->wIndex);
+  TU_VERIFY(itf < CFG_TUD_CDC);
   cdcd_interface_t* p_cdc = &_cdcd_itf[itf];
 
   // Invoke callback
@@ -314,8 +581,8 @@ bool cdcd_control_request(uint8_t rhport, tusb_control_request_t const * request
   //------------- Class Specific Request -------------//
   TU_ASSERT(request->bmRequestType_bit.type == TUSB_REQ_TYPE_CLASS);
 
-  // TODO Support multiple interfaces
-  uint8_t const itf = 0;
+  uint8_t const itf = usbd_itf_inst(rhport, (uint8_t) request->wIndex);
+  TU_VERIFY(itf < CFG_TUD_CDC);
   cdcd_interface_t* p_cdc = &_cdcd_itf[itf];
 
   switch ( request->bRequest )
@@ -350,24 +617,33 @@ bool cdcd_control_request(uint8_t rhport, tusb_control_request_t const * request
 
 bool cdcd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes)
 {
-  (void) rhport;
   (void) result;
 
-  // TODO Support multiple interfaces
-  uint8_t const itf = 0;
+  uint8_t const itf = usbd_edpt_inst(rhport, ep_addr);
+  TU_ASSUME(itf < CFG_TUD_CDC);
   cdcd_interface_t* p_cdc = &_cdcd_itf[itf];
 
   // Received new data
   if ( ep_addr == p_cdc->ep_out )
   {
-    for(uint32_t i=0; i<xferred_bytes; i++)
+    // buffer of completed transfer, which is the one armed before epout_idx
+    uint8_t const* rx_buf = _cdcd_epbuf[itf].epout[(p_cdc->epout_idx + EPOUT_BUF_COUNT - 1) % EPOUT_BUF_COUNT];
+
+    // arm the other buffer first so that host can keep sending while this one is copied
+    if ( EPOUT_BUF_COUNT > 1 ) _prep_out_transaction(itf, xferred_bytes);
+
+    tu_fifo_write_n(&p_cdc->rx_ff, rx_buf, (tu_fifo_idx_t) xferred_bytes);
+
+    // Check for wanted char and invoke callback for each occurrence
+    if ( tud_cdc_rx_wanted_cb && ( ((signed char) p_cdc->wanted_char) != -1 ) )
     {
-      tu_fifo_write(&p_cdc->rx_ff, &p_cdc->epout_buf[i]);
+      uint8_t const* p_chr = rx_buf;
+      uint8_t const* const p_end = rx_buf + xferred_bytes;
 
-      // Check for wanted char and invoke callback if needed
-      if ( tud_cdc_rx_wanted_cb && ( ((signed char) p_cdc->wanted_char) != -1 ) && ( p_cdc->wanted_char == p_cdc->epout_buf[i] ) )
+      while ( NULL != (p_chr = memchr(p_chr, (uint8_t) p_cdc->wanted_char, (size_t) (p_end - p_chr))) )
       {
         tud_cdc_rx_wanted_cb(itf, p_cdc->wanted_char);
+        p_chr++;
       }
     }
 
@@ -375,20 +651,106 @@ bool cdcd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_
     if (tud_cdc_rx_cb && tu_fifo_count(&p_cdc->rx_ff) ) tud_cdc_rx_cb(itf);
 
     // prepare for OUT transaction
-    _prep_out_transaction(itf);
+    _prep_out_transaction(itf, 0);
   }
 
-  // Data sent to host, we could continue to fetch data tx fifo to send.
-  // But it will cause incorrect baudrate set in line coding.
-  // Though maybe the baudrate is not really important !!!
-//  if ( ep_addr == p_cdc->ep_in )
-//  {
-//
-//  }
+  if ( ep_addr == p_cdc->ep_in )
+  {
+    if ( p_cdc->tx_direct )
+    {
+      // Application buffer is sent, tx fifo is untouched
+      p_cdc->tx_direct = false;
+      if ( tud_cdc_write_direct_cb ) tud_cdc_write_direct_cb(itf, xferred_bytes);
+    }
+#if CFG_TUD_FIFO_ZERO_COPY
+    else
+    {
+      // Data sent to host, release its space in tx fifo
+      tu_fifo_advance_read_pointer(&p_cdc->tx_ff, (uint16_t) xferred_bytes);
+    }
+#elif EPIN_BUF_POOL
+    else if ( p_cdc->epin_buf )
+    {
+      // Data sent to host, return buffer so that other interfaces can use it
+      usbd_ep_buf_free(p_cdc->epin_buf);
+      p_cdc->epin_buf = NULL;
+    }
+#endif
+
+#if TX_AUTO_FLUSH
+    // Data sent to host, continue with remaining data in tx fifo so that the bulk IN
+    // endpoint stays busy without waiting for application to flush again
+    if ( tu_fifo_count(&p_cdc->tx_ff) )
+    {
+      _tx_flush(itf);
+    }
+    else if ( xferred_bytes && (0 == (xferred_bytes % CFG_TUD_CDC_EPSIZE)) )
+    {
+      // Last packet is a full one, send zero-length packet so that host completes its read
+      usbd_edpt_xfer(rhport, p_cdc->ep_in, NULL, 0);
+    }
+#else
+    // Data sent to host, we could continue to fetch data tx fifo to send.
+    // But it will cause incorrect baudrate set in line coding.
+    // Though maybe the baudrate is not really important !!!
+#endif
+  }
 
-  // nothing to do with notif endpoint for now
+  // changes made while notification was in flight
+  if ( ep_addr == p_cdc->ep_notif )
+  {
+    _notify_serial_state(itf);
+  }
 
   return true;
 }
 
+#if CFG_TUD_CDC_TX_FLUSH_FRAMES
+// Flush data lingering in tx fifo less than a packet, so that latency is bounded
+void cdcd_sof(uint8_t rhport)
+{
+  for(uint8_t itf=0; itf<CFG_TUD_CDC; itf++)
+  {
+    cdcd_interface_t* p_cdc = &_cdcd_itf[itf];
+    if ( !p_cdc->ep_in || p_cdc->rhport != rhport ) continue;
+
+    if ( tu_fifo_empty(&p_cdc->tx_ff) )
+    {
+      p_cdc->tx_frames = 0;
+#if !TX_SOF_MOUNTED
+      _tx_sof_request(p_cdc, false);
+#endif
+    }
+    else if ( ++p_cdc->tx_frames >= CFG_TUD_CDC_TX_FLUSH_FRAMES )
+    {
+      // retried next frame if endpoint is still busy
+      if ( _tx_flush(itf) ) p_cdc->tx_frames = 0;
+    }
+  }
+}
+#endif
+
+#if CFG_TUD_SPLIT_CORE
+void cdcd_doorbell(uint8_t rhport)
+{
+  (void) rhport; // requests are per interface
+
+  for(uint8_t itf=0; itf<CFG_TUD_CDC; itf++)
+  {
+    cdcd_interface_t* p_cdc = &_cdcd_itf[itf];
+
+    // taken even if not mounted, later requests would not ring otherwise
+    bool const rx    = usbd_split_take(&p_cdc->split_rx);
+    bool const tx    = usbd_split_take(&p_cdc->split_tx);
+    bool const notif = usbd_split_take(&p_cdc->split_notif);
+
+    if ( !p_cdc->ep_in ) continue;
+
+    if ( rx ) _prep_out_transaction(itf, 0);
+    if ( tx ) _tx_flush(itf);
+    if ( notif ) _notify_serial_state(itf);
+  }
+}
+#endif
+
 #endif
@@ -38,6 +38,36 @@
 #define CFG_TUD_CDC_EPSIZE 64
 #endif
 
+// Maximum size of one endpoint transfer, must be multiple of CFG_TUD_CDC_EPSIZE. Larger value
+// lets DCD with multiple-packet transfer support move many packets per tud_task() round trip.
+#ifndef CFG_TUD_CDC_XFER_BUFSIZE
+#define CFG_TUD_CDC_XFER_BUFSIZE CFG_TUD_CDC_EPSIZE
+#endif
+
+// Start transmitting as soon as tx fifo holds a full packet, without waiting for
+// tud_cdc_write_flush(). Remaining data is chained from IN completion and data ending with a
+// full packet is terminated by a zero-length packet.
+#ifndef CFG_TUD_CDC_TX_AUTO_FLUSH
+#define CFG_TUD_CDC_TX_AUTO_FLUSH 0
+#endif
+
+// Transmit tx fifo once it holds a full packet or at latest after this number of SOF frames
+// (1 ms full speed, 125 us high speed) without tud_cdc_write_flush(). 0 is disabled.
+#ifndef CFG_TUD_CDC_TX_FLUSH_FRAMES
+#define CFG_TUD_CDC_TX_FLUSH_FRAMES 0
+#endif
+
+// tud_cdc_n_write() from many RTOS tasks/ISRs without tx fifo mutex (see CFG_TUSB_FIFO_MPSC): writers
+// never block each other nor wait for USB task. Flush is then done in tud_task(); use with
+// CFG_TUD_CDC_TX_AUTO_FLUSH or CFG_TUD_CDC_TX_FLUSH_FRAMES so that logs are sent without flushing.
+#ifndef CFG_TUD_CDC_TX_MPSC
+#define CFG_TUD_CDC_TX_MPSC 0
+#endif
+
+#if CFG_TUD_CDC_TX_MPSC && !CFG_TUSB_FIFO_MPSC
+  #error "CFG_TUD_CDC_TX_MPSC requires CFG_TUSB_FIFO_MPSC"
+#endif
+
 #ifdef __cplusplus
  extern "C" {
 #endif
@@ -66,8 +96,19 @@ uint32_t tud_cdc_n_write           (uint8_t itf, void const* buffer, uint32_t bu
 bool     tud_cdc_n_write_flush     (uint8_t itf);
 uint32_t tud_cdc_n_write_available (uint8_t itf);
 static inline uint32_t tud_cdc_n_write_char (uint8_t itf, char ch);
+
+// Send application buffer directly to endpoint without copying via tx fifo. Only accepted when
+// tx fifo is empty and no transfer is in progress. Buffer must stay valid (and be DMA-capable)
+// until tud_cdc_write_direct_cb() is invoked. Not available with CFG_TUD_SPLIT_CORE or CFG_TUD_CDC_TX_MPSC.
+bool     tud_cdc_n_write_direct    (uint8_t itf, void const* buffer, uint32_t bufsize);
 static inline uint32_t tud_cdc_n_write_str  (uint8_t itf, char const* str);
 
+// Report UART state (CDC_SERIAL_STATE_*) with SERIAL_STATE notification. DCD and DSR levels are kept
+// until changed, other bits are events reported once. Changes made while a notification is in flight
+// are merged into one sent when it completes, hence at most one per polling interval of notification
+// endpoint. Return false if interface has no notification endpoint
+bool     tud_cdc_n_set_serial_state(uint8_t itf, uint16_t state);
+
 //--------------------------------------------------------------------+
 // Application API (Interface0)
 //--------------------------------------------------------------------+
@@ -87,6 +128,8 @@ static inline uint32_t tud_cdc_write           (void const* buffer, uint32_t buf
 static inline uint32_t tud_cdc_write_str       (char const* str);
 static inline bool     tud_cdc_write_flush     (void);
 static inline uint32_t tud_cdc_write_available (void);
+static inline bool     tud_cdc_write_direct    (void const* buffer, uint32_t bufsize);
+static inline bool     tud_cdc_set_serial_state(uint16_t state);
 
 //--------------------------------------------------------------------+
 // Application Callback API (weak is optional)
@@ -104,6 +147,9 @@ TU_ATTR_WEAK void tud_cdc_line_state_cb(uint8_t itf, bool dtr, bool rts);
 // Invoked when line coding is change via SET_LINE_CODING
 TU_ATTR_WEAK void tud_cdc_line_coding_cb(uint8_t itf, cdc_line_coding_t const* p_line_coding);
 
+// Invoked when buffer of tud_cdc_n_write_direct() is sent
+TU_ATTR_WEAK void tud_cdc_write_direct_cb(uint8_t itf, uint32_t sent_bytes);
+
 //--------------------------------------------------------------------+
 // Inline Functions
 //--------------------------------------------------------------------+
@@ -193,6 +239,16 @@ static inline uint32_t tud_cdc_write_available(void)
   return tud_cdc_n_write_available(0);
 }
 
+static inline bool tud_cdc_write_direct(void const* buffer, uint32_t bufsize)
+{
+  return tud_cdc_n_write_direct(0, buffer, bufsize);
+}
+
+static inline bool tud_cdc_set_serial_state(uint16_t state)
+{
+  return tud_cdc_n_set_serial_state(0, state);
+}
+
 /** @} */
 /** @} */
 
@@ -201,10 +257,13 @@ static inline uint32_t tud_cdc_write_available(void)
 //--------------------------------------------------------------------+
 void cdcd_init             (void);
 void cdcd_reset            (uint8_t rhport);
-bool cdcd_open             (uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t *p_length);
+bool cdcd_open             (uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t *p_length, uint8_t *p_inst);
 bool cdcd_control_request  (uint8_t rhport, tusb_control_request_t const * request);
 bool cdcd_control_complete (uint8_t rhport, tusb_control_request_t const * request);
 bool cdcd_xfer_cb          (uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes);
+void cdcd_sof              (uint8_t rhport);
+void cdcd_doorbell         (uint8_t rhport);
+void cdcd_reopen           (uint8_t rhport, uint8_t inst);
 
 #ifdef __cplusplus
  }
@@ -29,12 +29,14 @@
 #if (TUSB_OPT_HOST_ENABLED && CFG_TUH_CDC)
 
 #include "common/tusb_common.h"
+#include "host/usbh_hcd.h"
 #include "cdc_host.h"
 
 //--------------------------------------------------------------------+
 // MACRO CONSTANT TYPEDEF
 //--------------------------------------------------------------------+
 typedef struct {
+  uint8_t dev_addr;
   uint8_t itf_num;
   uint8_t itf_protocol;
 
@@ -44,24 +46,57 @@ typedef struct {
 
   cdc_acm_capability_t acm_capability;
 
+#if CFG_TUH_CDC_STREAM
+  uint8_t rhport;
+
+  // two transfers per direction, completed in submitted order
+  uint8_t rx_idx;   // oldest armed RX buffer
+  uint8_t rx_armed;
+  uint8_t tx_idx;   // oldest TX buffer in flight
+  uint8_t tx_busy;
+
+  tu_fifo_t rx_ff;
+  tu_fifo_t tx_ff;
+
+  uint8_t rx_ff_buf[CFG_TUH_CDC_RX_BUFSIZE];
+  uint8_t tx_ff_buf[CFG_TUH_CDC_TX_BUFSIZE];
+
+  TU_ATTR_ALIGNED(4) uint8_t epin_buf [2][CFG_TUH_CDC_EP_BUFSIZE];
+  TU_ATTR_ALIGNED(4) uint8_t epout_buf[2][CFG_TUH_CDC_EP_BUFSIZE];
+#endif
 } cdch_data_t;
 
+#if CFG_TUH_CDC_STREAM
+TU_VERIFY_STATIC(CFG_TUH_CDC_RX_BUFSIZE >= CFG_TUH_CDC_EP_BUFSIZE, "RX FIFO must hold a full transfer");
+#endif
+
 //--------------------------------------------------------------------+
 // INTERNAL OBJECT & FUNCTION DECLARATION
 //--------------------------------------------------------------------+
-static cdch_data_t cdch_data[CFG_TUSB_HOST_DEVICE_MAX];
+CFG_TUSB_MEM_SECTION static cdch_data_t cdch_data[CFG_TUH_CDC_ITF_MAX];
+
+// first CDC interface of device
+static cdch_data_t* get_itf(uint8_t dev_addr)
+{
+  for(uint8_t i=0; i<CFG_TUH_CDC_ITF_MAX; i++)
+  {
+    if ( cdch_data[i].dev_addr == dev_addr ) return &cdch_data[i];
+  }
+
+  return NULL;
+}
 
 bool tuh_cdc_mounted(uint8_t dev_addr)
 {
-  cdch_data_t* cdc = &cdch_data[dev_addr-1];
-  return cdc->ep_in && cdc->ep_out;
+  cdch_data_t const* cdc = get_itf(dev_addr);
+  return cdc && cdc->ep_in && cdc->ep_out;
 }
 
 bool tuh_cdc_is_busy(uint8_t dev_addr, cdc_pipeid_t pipeid)
 {
   if ( !tuh_cdc_mounted(dev_addr) ) return false;
 
-  cdch_data_t const * p_cdc = &cdch_data[dev_addr-1];
+  cdch_data_t const * p_cdc = get_itf(dev_addr);
 
   switch (pipeid)
   {
@@ -86,16 +121,16 @@ bool tuh_cdc_serial_is_mounted(uint8_t dev_addr)
 {
   // TODO consider all AT Command as serial candidate
   return tuh_cdc_mounted(dev_addr)                                         &&
-      (CDC_COMM_PROTOCOL_ATCOMMAND <= cdch_data[dev_addr-1].itf_protocol) &&
-      (cdch_data[dev_addr-1].itf_protocol <= CDC_COMM_PROTOCOL_ATCOMMAND_CDMA);
+      (CDC_COMM_PROTOCOL_ATCOMMAND <= get_itf(dev_addr)->itf_protocol) &&
+      (get_itf(dev_addr)->itf_protocol <= CDC_COMM_PROTOCOL_ATCOMMAND_CDMA);
 }
 
 bool tuh_cdc_send(uint8_t dev_addr, void const * p_data, uint32_t length, bool is_notify)
 {
-  TU_VERIFY( tuh_cdc_mounted(dev_addr) );
+  TU_VERIFY( tuh_cdc_mounted(dev_addr) && !CFG_TUH_CDC_STREAM );
   TU_VERIFY( p_data != NULL && length, TUSB_ERROR_INVALID_PARA);
 
-  uint8_t const ep_out = cdch_data[dev_addr-1].ep_out;
+  uint8_t const ep_out = get_itf(dev_addr)->ep_out;
   if ( hcd_edpt_busy(dev_addr, ep_out) ) return false;
 
   return hcd_pipe_xfer(dev_addr, ep_out, (void *) p_data, length, is_notify);
@@ -103,21 +138,179 @@ bool tuh_cdc_send(uint8_t dev_addr, void const * p_data, uint32_t length, bool i
 
 bool tuh_cdc_receive(uint8_t dev_addr, void * p_buffer, uint32_t length, bool is_notify)
 {
-  TU_VERIFY( tuh_cdc_mounted(dev_addr) );
+  TU_VERIFY( tuh_cdc_mounted(dev_addr) && !CFG_TUH_CDC_STREAM );
   TU_VERIFY( p_buffer != NULL && length, TUSB_ERROR_INVALID_PARA);
 
-  uint8_t const ep_in = cdch_data[dev_addr-1].ep_in;
+  uint8_t const ep_in = get_itf(dev_addr)->ep_in;
   if ( hcd_edpt_busy(dev_addr, ep_in) ) return false;
 
   return hcd_pipe_xfer(dev_addr, ep_in, p_buffer, length, is_notify);
 }
 
+//--------------------------------------------------------------------+
+// STREAMING API
+//--------------------------------------------------------------------+
+bool tuh_cdc_n_mounted(uint8_t inst)
+{
+  TU_VERIFY(inst < CFG_TUH_CDC_ITF_MAX);
+  cdch_data_t const* p_cdc = &cdch_data[inst];
+  return p_cdc->ep_in && p_cdc->ep_out && tuh_device_is_configured(p_cdc->dev_addr);
+}
+
+uint8_t tuh_cdc_n_dev_addr(uint8_t inst)
+{
+  return cdch_data[inst].dev_addr;
+}
+
+uint8_t tuh_cdc_n_itf_num(uint8_t inst)
+{
+  return cdch_data[inst].itf_num;
+}
+
+#if CFG_TUH_CDC_STREAM
+
+static cdch_data_t* get_instance(uint8_t dev_addr, uint8_t ep_addr)
+{
+  for(uint8_t i=0; i<CFG_TUH_CDC_ITF_MAX; i++)
+  {
+    cdch_data_t* p_cdc = &cdch_data[i];
+    if ( (p_cdc->dev_addr == dev_addr) && ep_addr &&
+         (ep_addr == p_cdc->ep_in || ep_addr == p_cdc->ep_out || ep_addr == p_cdc->ep_notif) ) return p_cdc;
+  }
+
+  return NULL;
+}
+
+// HCD appends the transfer behind pending ones, completion isr must not modify the list meanwhile
+static bool stream_xfer(cdch_data_t* p_cdc, uint8_t ep_addr, uint8_t* buffer, uint32_t len)
+{
+  hcd_int_disable(p_cdc->rhport);
+  bool const ret = hcd_pipe_xfer(p_cdc->dev_addr, ep_addr, buffer, len, true);
+  hcd_int_enable(p_cdc->rhport);
+
+  return ret;
+}
+
+// Keep both RX buffers armed while FIFO can take their data, device is NAKed otherwise
+static void stream_rx_arm(cdch_data_t* p_cdc)
+{
+  while ( p_cdc->rx_armed < 2 &&
+          tu_fifo_remaining(&p_cdc->rx_ff) >= (p_cdc->rx_armed+1u)*CFG_TUH_CDC_EP_BUFSIZE )
+  {
+    uint8_t const idx = (p_cdc->rx_idx + p_cdc->rx_armed) & 1;
+    if ( !stream_xfer(p_cdc, p_cdc->ep_in, p_cdc->epin_buf[idx], CFG_TUH_CDC_EP_BUFSIZE) ) return;
+    p_cdc->rx_armed++;
+  }
+}
+
+// Send FIFO data into any free TX buffer
+static void stream_tx_flush(cdch_data_t* p_cdc)
+{
+  while ( p_cdc->tx_busy < 2 && !tu_fifo_empty(&p_cdc->tx_ff) )
+  {
+    uint8_t const idx = (p_cdc->tx_idx + p_cdc->tx_busy) & 1;
+    uint16_t const count = (uint16_t) tu_fifo_read_n(&p_cdc->tx_ff, p_cdc->epout_buf[idx], CFG_TUH_CDC_EP_BUFSIZE);
+
+    TU_VERIFY( stream_xfer(p_cdc, p_cdc->ep_out, p_cdc->epout_buf[idx], count), );
+    p_cdc->tx_busy++;
+  }
+}
+
+uint32_t tuh_cdc_n_available(uint8_t inst)
+{
+  return tu_fifo_count(&cdch_data[inst].rx_ff);
+}
+
+uint32_t tuh_cdc_n_read(uint8_t inst, void* buffer, uint32_t bufsize)
+{
+  TU_VERIFY( tuh_cdc_n_mounted(inst), 0 );
+  cdch_data_t* p_cdc = &cdch_data[inst];
+
+  uint32_t const count = tu_fifo_read_n(&p_cdc->rx_ff, buffer, (tu_fifo_idx_t) tu_min32(bufsize, UINT16_MAX));
+  stream_rx_arm(p_cdc);
+
+  return count;
+}
+
+void tuh_cdc_n_read_flush(uint8_t inst)
+{
+  tu_fifo_clear(&cdch_data[inst].rx_ff);
+  if ( tuh_cdc_n_mounted(inst) ) stream_rx_arm(&cdch_data[inst]);
+}
+
+uint32_t tuh_cdc_n_write(uint8_t inst, void const* buffer, uint32_t bufsize)
+{
+  TU_VERIFY( tuh_cdc_n_mounted(inst), 0 );
+  cdch_data_t* p_cdc = &cdch_data[inst];
+
+  uint32_t const count = tu_fifo_write_n(&p_cdc->tx_ff, buffer, (tu_fifo_idx_t) tu_min32(bufsize, UINT16_MAX));
+  stream_tx_flush(p_cdc);
+
+  return count;
+}
+
+uint32_t tuh_cdc_n_write_available(uint8_t inst)
+{
+  return tu_fifo_remaining(&cdch_data[inst].tx_ff);
+}
+
+bool tuh_cdc_n_write_flush(uint8_t inst)
+{
+  TU_VERIFY( tuh_cdc_n_mounted(inst) );
+  stream_tx_flush(&cdch_data[inst]);
+  return tu_fifo_empty(&cdch_data[inst].tx_ff);
+}
+
+static void stream_xfer_cb(cdch_data_t* p_cdc, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes)
+{
+  uint8_t const inst = (uint8_t) (p_cdc - cdch_data);
+
+  if ( ep_addr == p_cdc->ep_in )
+  {
+    TU_VERIFY( p_cdc->rx_armed, );
+
+    // completed buffer is the oldest one, the other is still armed and receiving
+    if ( XFER_RESULT_SUCCESS == event )
+    {
+      tu_fifo_write_n(&p_cdc->rx_ff, p_cdc->epin_buf[p_cdc->rx_idx], (tu_fifo_idx_t) xferred_bytes);
+    }
+    p_cdc->rx_idx ^= 1;
+    p_cdc->rx_armed--;
+
+    // pipe is halted after an error
+    if ( XFER_RESULT_SUCCESS == event ) stream_rx_arm(p_cdc);
+
+    if ( xferred_bytes && tuh_cdc_rx_cb ) tuh_cdc_rx_cb(inst);
+  }
+  else if ( ep_addr == p_cdc->ep_out )
+  {
+    TU_VERIFY( p_cdc->tx_busy, );
+
+    p_cdc->tx_idx ^= 1;
+    p_cdc->tx_busy--;
+
+    if ( XFER_RESULT_SUCCESS == event ) stream_tx_flush(p_cdc);
+
+    if ( tu_fifo_empty(&p_cdc->tx_ff) && !p_cdc->tx_busy && tuh_cdc_tx_complete_cb ) tuh_cdc_tx_complete_cb(inst);
+  }
+}
+
+static void stream_open(cdch_data_t* p_cdc, uint8_t rhport)
+{
+  p_cdc->rhport = rhport;
+  tu_fifo_config(&p_cdc->rx_ff, p_cdc->rx_ff_buf, CFG_TUH_CDC_RX_BUFSIZE, 1, false);
+  tu_fifo_config(&p_cdc->tx_ff, p_cdc->tx_ff_buf, CFG_TUH_CDC_TX_BUFSIZE, 1, false);
+  stream_rx_arm(p_cdc);
+}
+
+#endif
+
 //--------------------------------------------------------------------+
 // USBH-CLASS DRIVER API
 //--------------------------------------------------------------------+
 void cdch_init(void)
 {
-  tu_memclr(cdch_data, sizeof(cdch_data_t)*CFG_TUSB_HOST_DEVICE_MAX);
+  tu_memclr(cdch_data, sizeof(cdch_data));
 }
 
 bool cdch_open(uint8_t rhport, uint8_t dev_addr, tusb_desc_interface_t const *itf_desc, uint16_t *p_length)
@@ -130,11 +323,22 @@ bool cdch_open(uint8_t rhport, uint8_t dev_addr, tusb_desc_interface_t const *it
             0xff == itf_desc->bInterfaceProtocol);
 
   uint8_t const * p_desc;
-  cdch_data_t * p_cdc;
+  cdch_data_t * p_cdc = NULL;
+
+  // Find available interface
+  for(uint8_t i=0; i<CFG_TUH_CDC_ITF_MAX; i++)
+  {
+    if ( cdch_data[i].dev_addr == 0 )
+    {
+      p_cdc = &cdch_data[i];
+      break;
+    }
+  }
+  TU_ASSERT(p_cdc);
 
   p_desc = tu_desc_next(itf_desc);
-  p_cdc  = &cdch_data[dev_addr-1];
 
+  p_cdc->dev_addr  = dev_addr;
   p_cdc->itf_num   = itf_desc->bInterfaceNumber;
   p_cdc->itf_protocol = itf_desc->bInterfaceProtocol; // TODO 0xff is consider as rndis candidate, other is virtual Com
 
@@ -195,31 +399,72 @@ bool cdch_open(uint8_t rhport, uint8_t dev_addr, tusb_desc_interface_t const *it
     }
   }
 
+  return true;
+}
+
+static void cdch_set_line_state_complete(uint8_t dev_addr, tusb_control_request_t const * request, xfer_result_t result)
+{
+  uint8_t const itf_num = (uint8_t) request->wIndex;
+
+#if CFG_TUH_CDC_STREAM
+  cdch_data_t* p_cdc = NULL;
+  for(uint8_t i=0; i<CFG_TUH_CDC_ITF_MAX; i++)
+  {
+    if ( cdch_data[i].dev_addr == dev_addr && cdch_data[i].itf_num == itf_num ) p_cdc = &cdch_data[i];
+  }
+
+  // data pipes are only streamed once DTR is set
+  if ( p_cdc && (XFER_RESULT_SUCCESS == result) && p_cdc->ep_in && p_cdc->ep_out )
+  {
+    stream_open(p_cdc, _usbh_devices[dev_addr].rhport);
+  }
+#else
+  (void) result;
+#endif
+
+  usbh_driver_set_config_complete(dev_addr, itf_num);
+}
+
+bool cdch_set_config(uint8_t dev_addr, uint8_t itf_num)
+{
   // FIXME move to seperate API : connect
-  tusb_control_request_t request =
+  tusb_control_request_t const request =
   {
     .bmRequestType_bit = { .recipient = TUSB_REQ_RCPT_INTERFACE, .type = TUSB_REQ_TYPE_CLASS, .direction = TUSB_DIR_OUT },
     .bRequest = CDC_REQUEST_SET_CONTROL_LINE_STATE,
     .wValue = 0x03, // dtr on, cst on
-    .wIndex = p_cdc->itf_num,
+    .wIndex = itf_num,
     .wLength = 0
   };
 
-  TU_ASSERT( usbh_control_xfer(dev_addr, &request, NULL) );
-
-  return true;
+  return tuh_control_xfer(dev_addr, &request, NULL, cdch_set_line_state_complete);
 }
 
-void cdch_isr(uint8_t dev_addr, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes)
+void cdch_xfer_cb(uint8_t dev_addr, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes)
 {
+#if CFG_TUH_CDC_STREAM
+  cdch_data_t* p_cdc = get_instance(dev_addr, ep_addr);
+  TU_VERIFY(p_cdc, );
+
+  // data pipes are owned by driver
+  if ( ep_addr != p_cdc->ep_notif )
+  {
+    stream_xfer_cb(p_cdc, ep_addr, event, xferred_bytes);
+    return;
+  }
+#else
   (void) ep_addr;
+#endif
+
   tuh_cdc_xfer_isr( dev_addr, event, 0, xferred_bytes );
 }
 
 void cdch_close(uint8_t dev_addr)
 {
-  cdch_data_t * p_cdc = &cdch_data[dev_addr-1];
-  tu_memclr(p_cdc, sizeof(cdch_data_t));
+  for(uint8_t i=0; i<CFG_TUH_CDC_ITF_MAX; i++)
+  {
+    if ( cdch_data[i].dev_addr == dev_addr ) tu_memclr(&cdch_data[i], sizeof(cdch_data_t));
+  }
 }
 
 #endif
@@ -88,10 +88,38 @@ bool tuh_cdc_send(uint8_t dev_addr, void const * p_data, uint32_t length, bool i
  */
 bool tuh_cdc_receive(uint8_t dev_addr, void * p_buffer, uint32_t length, bool is_notify);
 
+//--------------------------------------------------------------------+
+// CDC Streaming API (CFG_TUH_CDC_STREAM)
+//--------------------------------------------------------------------+
+// Interfaces are numbered across all devices, up to CFG_TUH_CDC_ITF_MAX. Driver keeps two bulk IN
+// transfers armed and drains them into RX FIFO, device is NAKed only when FIFO is full. Data written
+// to TX FIFO is sent right away with up to two bulk OUT transfers in flight.
+// Must be called in the same context as tuh_task().
+bool     tuh_cdc_n_mounted         (uint8_t inst);
+uint8_t  tuh_cdc_n_dev_addr        (uint8_t inst);
+uint8_t  tuh_cdc_n_itf_num         (uint8_t inst);
+
+uint32_t tuh_cdc_n_available       (uint8_t inst);
+uint32_t tuh_cdc_n_read            (uint8_t inst, void* buffer, uint32_t bufsize);
+void     tuh_cdc_n_read_flush      (uint8_t inst);
+
+// Return number of bytes accepted by TX FIFO
+uint32_t tuh_cdc_n_write           (uint8_t inst, void const* buffer, uint32_t bufsize);
+uint32_t tuh_cdc_n_write_available (uint8_t inst);
+
+// Start sending FIFO data if a transfer buffer is free, return true if FIFO is empty
+bool     tuh_cdc_n_write_flush     (uint8_t inst);
+
 //--------------------------------------------------------------------+
 // CDC APPLICATION CALLBACKS
 //--------------------------------------------------------------------+
 
+// Invoked in tuh_task() when data is received into RX FIFO
+TU_ATTR_WEAK void tuh_cdc_rx_cb(uint8_t inst);
+
+// Invoked in tuh_task() when TX FIFO is drained and all data is sent
+TU_ATTR_WEAK void tuh_cdc_tx_complete_cb(uint8_t inst);
+
 /** \brief      Callback function that is invoked when an transferring event occurred
  * \param[in]		dev_addr	Address of device
  * \param[in]   event an value from \ref xfer_result_t
@@ -113,7 +141,8 @@ void tuh_cdc_xfer_isr(uint8_t dev_addr, xfer_result_t event, cdc_pipeid_t pipe_i
 //--------------------------------------------------------------------+
 void cdch_init(void);
 bool cdch_open(uint8_t rhport, uint8_t dev_addr, tusb_desc_interface_t const *itf_desc, uint16_t *p_length);
-void cdch_isr(uint8_t dev_addr, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes);
+bool cdch_set_config(uint8_t dev_addr, uint8_t itf_num);
+void cdch_xfer_cb(uint8_t dev_addr, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes);
 void cdch_close(uint8_t dev_addr);
 
 #ifdef __cplusplus
@@ -0,0 +1,430 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#include "tusb_option.h"
+
+#if (TUSB_OPT_DEVICE_ENABLED && CFG_TUD_DFU)
+
+#include "dfu_device.h"
+#include "device/usbd_pvt.h"
+
+//--------------------------------------------------------------------+
+// MACRO CONSTANT TYPEDEF
+//--------------------------------------------------------------------+
+typedef struct
+{
+  uint16_t num;
+  uint16_t len;
+} dfud_block_t;
+
+typedef struct
+{
+  uint8_t itf_num;
+  uint8_t alt_count;
+  uint8_t alt;
+  uint8_t attrs;
+
+  uint8_t state;
+  uint8_t status;
+  uint8_t done_status; // reported by tud_dfu_finish_flashing()
+
+  // DNLOAD blocks received but not programmed yet, the first one is being programmed when busy
+  uint8_t rd_idx;
+  uint8_t count;
+  bool    busy;
+
+  bool    manifesting;
+  bool    manifested;
+
+  dfud_block_t block[CFG_TUD_DFU_XFER_BUFCOUNT];
+
+  dfu_status_response_t status_rsp;
+} dfud_interface_t;
+
+static dfud_interface_t _dfud_itf;
+
+CFG_TUSB_MEM_SECTION CFG_TUSB_MEM_ALIGN static uint8_t _dfud_buf[CFG_TUD_DFU_XFER_BUFCOUNT][CFG_TUD_DFU_XFER_BUFSIZE];
+
+// buffer index of n-th queued block, the one after last is free if count < CFG_TUD_DFU_XFER_BUFCOUNT
+static inline uint8_t blk_idx(dfud_interface_t const* p_dfu, uint8_t n)
+{
+  return (uint8_t) ((p_dfu->rd_idx + n) % CFG_TUD_DFU_XFER_BUFCOUNT);
+}
+
+//--------------------------------------------------------------------+
+// Helper
+//--------------------------------------------------------------------+
+
+// Pass next block to application, or start manifestation once all blocks are programmed
+static void process_next(dfud_interface_t* p_dfu)
+{
+  if ( p_dfu->busy || p_dfu->manifesting ) return;
+
+  if ( p_dfu->count )
+  {
+    dfud_block_t const* blk = &p_dfu->block[p_dfu->rd_idx];
+
+    p_dfu->busy = true;
+    tud_dfu_download_cb(p_dfu->alt, blk->num, _dfud_buf[p_dfu->rd_idx], blk->len);
+  }
+  else if ( (p_dfu->state == DFU_STATE_DFU_MANIFEST_SYNC || p_dfu->state == DFU_STATE_DFU_MANIFEST) && !p_dfu->manifested )
+  {
+    if ( tud_dfu_manifest_cb )
+    {
+      p_dfu->manifesting = true;
+      tud_dfu_manifest_cb(p_dfu->alt);
+    }else
+    {
+      p_dfu->manifested = true;
+    }
+  }
+}
+
+// tud_dfu_finish_flashing() continued in usbd task
+static void flashing_done(void* param)
+{
+  dfud_interface_t* p_dfu = (dfud_interface_t*) param;
+
+  if ( p_dfu->manifesting )
+  {
+    p_dfu->manifesting = false;
+    p_dfu->manifested  = true;
+  }
+  else if ( p_dfu->busy )
+  {
+    p_dfu->busy   = false;
+    p_dfu->rd_idx = blk_idx(p_dfu, 1);
+    p_dfu->count--;
+  }
+  else
+  {
+    return; // bus reset meanwhile
+  }
+
+  if ( p_dfu->done_status != DFU_STATUS_OK )
+  {
+    // remaining blocks are useless, host sees error on next GETSTATUS
+    p_dfu->count  = 0;
+    p_dfu->status = p_dfu->done_status;
+    p_dfu->state  = DFU_STATE_DFU_ERROR;
+    return;
+  }
+
+  process_next(p_dfu);
+}
+
+// Drop blocks not passed to application yet, the one being programmed still completes
+static void drop_blocks(dfud_interface_t* p_dfu)
+{
+  p_dfu->count = p_dfu->busy ? 1 : 0;
+  if ( tud_dfu_abort_cb ) tud_dfu_abort_cb(p_dfu->alt);
+}
+
+// Request not allowed in current state: stall it and enter dfuERROR
+static bool request_error(dfud_interface_t* p_dfu)
+{
+  p_dfu->state  = DFU_STATE_DFU_ERROR;
+  p_dfu->status = DFU_STATUS_ERR_STALLEDPKT;
+  return false;
+}
+
+static inline uint32_t poll_timeout(dfud_interface_t const* p_dfu)
+{
+  return tud_dfu_get_timeout_cb ? tud_dfu_get_timeout_cb(p_dfu->alt, p_dfu->state) : CFG_TUD_DFU_POLL_TIMEOUT;
+}
+
+// GETSTATUS reports the state device enters right after the request
+static void update_status(dfud_interface_t* p_dfu)
+{
+  uint32_t timeout = 0;
+
+  switch ( p_dfu->state )
+  {
+    case DFU_STATE_DFU_DNLOAD_SYNC:
+    case DFU_STATE_DFU_DNBUSY:
+      // host only has to wait when no buffer is free for next block
+      if ( p_dfu->count < CFG_TUD_DFU_XFER_BUFCOUNT )
+      {
+        p_dfu->state = DFU_STATE_DFU_DNLOAD_IDLE;
+      }else
+      {
+        p_dfu->state = DFU_STATE_DFU_DNBUSY;
+        timeout = poll_timeout(p_dfu);
+      }
+    break;
+
+    case DFU_STATE_DFU_MANIFEST_SYNC:
+    case DFU_STATE_DFU_MANIFEST:
+      if ( p_dfu->manifested )
+      {
+        p_dfu->state = (p_dfu->attrs & DFU_ATTR_MANIFESTATION_TOLERANT) ? DFU_STATE_DFU_IDLE : DFU_STATE_DFU_MANIFEST_WAIT_RESET;
+      }else
+      {
+        p_dfu->state = DFU_STATE_DFU_MANIFEST;
+        timeout = poll_timeout(p_dfu);
+      }
+    break;
+
+    default: break;
+  }
+
+  p_dfu->status_rsp.bStatus          = p_dfu->status;
+  p_dfu->status_rsp.bwPollTimeout[0] = U32_B4_U8(timeout);
+  p_dfu->status_rsp.bwPollTimeout[1] = U32_B3_U8(timeout);
+  p_dfu->status_rsp.bwPollTimeout[2] = U32_B2_U8(timeout);
+  p_dfu->status_rsp.bState           = p_dfu->state;
+  p_dfu->status_rsp.iString          = 0;
+}
+
+//--------------------------------------------------------------------+
+// APPLICATION API
+//--------------------------------------------------------------------+
+bool tud_dfu_finish_flashing(uint8_t status, bool in_isr)
+{
+  dfud_interface_t* p_dfu = &_dfud_itf;
+
+  TU_VERIFY(p_dfu->busy || p_dfu->manifesting);
+
+  p_dfu->done_status = status;
+  usbd_defer_func(flashing_done, p_dfu, in_isr);
+
+  return true;
+}
+
+//--------------------------------------------------------------------+
+// USBD Driver API
+//--------------------------------------------------------------------+
+void dfud_init(void)
+{
+  tu_varclr(&_dfud_itf);
+}
+
+void dfud_reset(uint8_t rhport)
+{
+  (void) rhport;
+  tu_varclr(&_dfud_itf);
+}
+
+bool dfud_open(uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t *p_length, uint8_t *p_inst)
+{
+  (void) rhport;
+  (void) p_inst;
+
+  // Ensure this is DFU mode, runtime interface is handled by dfu_rt_device
+  TU_VERIFY(itf_desc->bInterfaceSubClass == TUD_DFU_APP_SUBCLASS);
+  TU_VERIFY(itf_desc->bInterfaceProtocol == DFU_PROTOCOL_DFU);
+
+  dfud_interface_t* p_dfu = &_dfud_itf;
+  uint8_t const * p_desc = (uint8_t const *) itf_desc;
+
+  (*p_length) = 0;
+  p_dfu->alt_count = 0;
+
+  // Alternate settings (e.g one per memory region) followed by functional descriptor
+  while ( (TUSB_DESC_INTERFACE == tu_desc_type(p_desc)) &&
+          (((tusb_desc_interface_t const*) p_desc)->bInterfaceNumber == itf_desc->bInterfaceNumber) )
+  {
+    p_dfu->alt_count++;
+    (*p_length) = (uint16_t) ((*p_length) + tu_desc_len(p_desc));
+    p_desc = tu_desc_next(p_desc);
+  }
+
+  TU_ASSERT(DFU_DESC_FUNCTIONAL == tu_desc_type(p_desc));
+  dfu_desc_functional_t const* desc_func = (dfu_desc_functional_t const*) p_desc;
+
+  // Blocks must fit into our buffer
+  TU_ASSERT(desc_func->wTransferSize <= CFG_TUD_DFU_XFER_BUFSIZE);
+  (*p_length) = (uint16_t) ((*p_length) + tu_desc_len(p_desc));
+
+  p_dfu->itf_num = itf_desc->bInterfaceNumber;
+  p_dfu->attrs   = desc_func->bmAttributes;
+  p_dfu->alt     = 0;
+  p_dfu->state   = DFU_STATE_DFU_IDLE;
+  p_dfu->status  = DFU_STATUS_OK;
+
+  return true;
+}
+
+// Handle class control request and (Get/Set) Interface
+// return false to stall control endpoint (e.g unsupported request)
+bool dfud_control_request(uint8_t rhport, tusb_control_request_t const * request)
+{
+  dfud_interface_t* p_dfu = &_dfud_itf;
+
+  TU_VERIFY(request->bmRequestType_bit.recipient == TUSB_REQ_RCPT_INTERFACE);
+
+  if ( request->bmRequestType_bit.type == TUSB_REQ_TYPE_STANDARD )
+  {
+    switch ( request->bRequest )
+    {
+      case TUSB_REQ_GET_INTERFACE:
+        tud_control_xfer(rhport, request, &p_dfu->alt, 1);
+      break;
+
+      case TUSB_REQ_SET_INTERFACE:
+      {
+        uint8_t const alt = (uint8_t) request->wValue;
+        TU_VERIFY(alt < p_dfu->alt_count);
+
+        drop_blocks(p_dfu);
+        p_dfu->alt    = alt;
+        p_dfu->state  = DFU_STATE_DFU_IDLE;
+        p_dfu->status = DFU_STATUS_OK;
+
+        tud_control_status(rhport, request);
+      }
+      break;
+
+      default: return false;
+    }
+
+    return true;
+  }
+
+  //------------- Class Specific Request -------------//
+  TU_VERIFY(request->bmRequestType_bit.type == TUSB_REQ_TYPE_CLASS);
+
+  uint8_t const state = p_dfu->state;
+
+  switch ( request->bRequest )
+  {
+    case DFU_REQUEST_DNLOAD:
+      if ( request->wLength )
+      {
+        bool const can_dnload = (state == DFU_STATE_DFU_DNLOAD_IDLE) ||
+                                ((state == DFU_STATE_DFU_IDLE) && (p_dfu->attrs & DFU_ATTR_CAN_DOWNLOAD));
+
+        if ( !can_dnload || (request->wLength > CFG_TUD_DFU_XFER_BUFSIZE) ||
+             (p_dfu->count == CFG_TUD_DFU_XFER_BUFCOUNT) )
+        {
+          return request_error(p_dfu);
+        }
+
+        // received into first free buffer, queued in dfud_control_complete()
+        tud_control_xfer(rhport, request, _dfud_buf[blk_idx(p_dfu, p_dfu->count)], request->wLength);
+      }
+      else
+      {
+        // end of download, manifestation follows programming of the queued blocks
+        if ( state != DFU_STATE_DFU_DNLOAD_IDLE ) return request_error(p_dfu);
+
+        p_dfu->state      = DFU_STATE_DFU_MANIFEST_SYNC;
+        p_dfu->manifested = false;
+        tud_control_status(rhport, request);
+
+        process_next(p_dfu);
+      }
+    break;
+
+    case DFU_REQUEST_UPLOAD:
+    {
+      bool const can_upload = (state == DFU_STATE_DFU_UPLOAD_IDLE) ||
+                              ((state == DFU_STATE_DFU_IDLE) && (p_dfu->attrs & DFU_ATTR_CAN_UPLOAD));
+
+      if ( !can_upload || !tud_dfu_upload_cb || (p_dfu->count == CFG_TUD_DFU_XFER_BUFCOUNT) )
+      {
+        return request_error(p_dfu);
+      }
+
+      uint8_t* buf = _dfud_buf[blk_idx(p_dfu, p_dfu->count)];
+      uint16_t const max_len = tu_min16(request->wLength, CFG_TUD_DFU_XFER_BUFSIZE);
+      uint16_t const len = tu_min16(tud_dfu_upload_cb(p_dfu->alt, request->wValue, buf, max_len), max_len);
+
+      // short block ends the upload
+      p_dfu->state = (len < request->wLength) ? DFU_STATE_DFU_IDLE : DFU_STATE_DFU_UPLOAD_IDLE;
+      tud_control_xfer(rhport, request, buf, len);
+    }
+    break;
+
+    case DFU_REQUEST_GETSTATUS:
+      update_status(p_dfu);
+      tud_control_xfer(rhport, request, &p_dfu->status_rsp, sizeof(dfu_status_response_t));
+    break;
+
+    case DFU_REQUEST_CLRSTATUS:
+      if ( state != DFU_STATE_DFU_ERROR ) return request_error(p_dfu);
+
+      drop_blocks(p_dfu);
+      p_dfu->state  = DFU_STATE_DFU_IDLE;
+      p_dfu->status = DFU_STATUS_OK;
+      tud_control_status(rhport, request);
+    break;
+
+    case DFU_REQUEST_GETSTATE:
+      tud_control_xfer(rhport, request, &p_dfu->state, 1);
+    break;
+
+    case DFU_REQUEST_ABORT:
+      if ( (state != DFU_STATE_DFU_IDLE)          && (state != DFU_STATE_DFU_DNLOAD_SYNC) &&
+           (state != DFU_STATE_DFU_DNLOAD_IDLE)   && (state != DFU_STATE_DFU_MANIFEST_SYNC) &&
+           (state != DFU_STATE_DFU_UPLOAD_IDLE) )
+      {
+        return request_error(p_dfu);
+      }
+
+      drop_blocks(p_dfu);
+      p_dfu->state = DFU_STATE_DFU_IDLE;
+      tud_control_status(rhport, request);
+    break;
+
+    default: return request_error(p_dfu); // DETACH is not valid in DFU mode
+  }
+
+  return true;
+}
+
+// Invoked when class request DATA stage is finished.
+bool dfud_control_complete(uint8_t rhport, tusb_control_request_t const * request)
+{
+  (void) rhport;
+
+  dfud_interface_t* p_dfu = &_dfud_itf;
+
+  if ( (request->bmRequestType_bit.type == TUSB_REQ_TYPE_CLASS) && (request->bRequest == DFU_REQUEST_DNLOAD) )
+  {
+    dfud_block_t* blk = &p_dfu->block[blk_idx(p_dfu, p_dfu->count)];
+
+    blk->num = request->wValue;
+    blk->len = request->wLength;
+    p_dfu->count++;
+    p_dfu->state = DFU_STATE_DFU_DNLOAD_SYNC;
+
+    process_next(p_dfu);
+  }
+
+  return true;
+}
+
+bool dfud_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes)
+{
+  (void) rhport;
+  (void) ep_addr;
+  (void) result;
+  (void) xferred_bytes;
+  return true;
+}
+
+#endif
@@ -0,0 +1,109 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#ifndef _TUSB_DFU_DEVICE_H_
+#define _TUSB_DFU_DEVICE_H_
+
+#include "common/tusb_common.h"
+#include "device/usbd.h"
+#include "dfu.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+//--------------------------------------------------------------------+
+// Class Driver Default Configure & Validation
+//--------------------------------------------------------------------+
+
+// Size of each DNLOAD/UPLOAD block buffer, must be at least wTransferSize of the functional
+// descriptor. Blocks larger than endpoint 0 size are received as multi-packet control transfers,
+// CFG_TUD_CONTROL_ZERO_COPY avoids copying them packet by packet.
+#ifndef CFG_TUD_DFU_XFER_BUFSIZE
+  #define CFG_TUD_DFU_XFER_BUFSIZE    512
+#endif
+
+// Number of DNLOAD block buffers. With more than one, next block is received while the
+// previous ones are being programmed (host sees dfuDNLOAD-IDLE right away).
+#ifndef CFG_TUD_DFU_XFER_BUFCOUNT
+  #define CFG_TUD_DFU_XFER_BUFCOUNT   2
+#endif
+
+// bwPollTimeout in ms reported while busy, if tud_dfu_get_timeout_cb() is not implemented
+#ifndef CFG_TUD_DFU_POLL_TIMEOUT
+  #define CFG_TUD_DFU_POLL_TIMEOUT    1
+#endif
+
+TU_VERIFY_STATIC(CFG_TUD_DFU_XFER_BUFCOUNT > 0 && CFG_TUD_DFU_XFER_BUFCOUNT < 256, "Buffer count is not correct");
+
+//--------------------------------------------------------------------+
+// Application API
+//--------------------------------------------------------------------+
+
+// Report result of tud_dfu_download_cb() or tud_dfu_manifest_cb(), can be called from ISR
+// e.g flash controller's done interrupt. Status is DFU_STATUS_OK or one of DFU_STATUS_ERR_*.
+bool tud_dfu_finish_flashing(uint8_t status, bool in_isr);
+
+//--------------------------------------------------------------------+
+// Application Callback API (weak is optional)
+//--------------------------------------------------------------------+
+
+// Invoked with each DNLOAD block in order of reception, data stays valid until
+// tud_dfu_finish_flashing() is called. Start programming (and erasing) here, preferably in
+// background, the host keeps sending following blocks meanwhile. Block number is passed as is,
+// so that DfuSe commands in block 0 can be handled by application.
+void tud_dfu_download_cb(uint8_t alt, uint16_t block_num, uint8_t const* data, uint16_t length);
+
+// Invoked when download is complete (zero-length DNLOAD) and all blocks are programmed.
+// Application must call tud_dfu_finish_flashing() when manifestation is done.
+TU_ATTR_WEAK void tud_dfu_manifest_cb(uint8_t alt);
+
+// Invoked on UPLOAD request, return number of bytes copied to data (up to length).
+// Returning less than length ends the upload.
+TU_ATTR_WEAK uint16_t tud_dfu_upload_cb(uint8_t alt, uint16_t block_num, uint8_t* data, uint16_t length);
+
+// Invoked when host is asked to wait in dfuDNBUSY or dfuMANIFEST state, return expected time
+// in ms until next block can be accepted, or manifestation is done, e.g from real flash timing.
+TU_ATTR_WEAK uint32_t tud_dfu_get_timeout_cb(uint8_t alt, uint8_t state);
+
+// Invoked on ABORT and CLRSTATUS, blocks not passed to tud_dfu_download_cb() yet are dropped
+TU_ATTR_WEAK void tud_dfu_abort_cb(uint8_t alt);
+
+//--------------------------------------------------------------------+
+// Internal Class Driver API
+//--------------------------------------------------------------------+
+void dfud_init(void);
+void dfud_reset(uint8_t rhport);
+bool dfud_open(uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t *p_length, uint8_t *p_inst);
+bool dfud_control_request(uint8_t rhport, tusb_control_request_t const * request);
+bool dfud_control_complete(uint8_t rhport, tusb_control_request_t const * request);
+bool dfud_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes);
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif /* _TUSB_DFU_DEVICE_H_ */
@@ -38,79 +38,202 @@
 //--------------------------------------------------------------------+
 // MACRO CONSTANT TYPEDEF
 //--------------------------------------------------------------------+
+
+// SOF frames per idle rate unit (4 ms)
+#define HID_IDLE_FRAMES_PER_UNIT(_rhport)  (TUD_OPT_RHPORT_HIGH_SPEED(_rhport) ? 32 : 4)
+
+// Queued report: 16-bit length followed by report (with its ID if any) as sent on the wire
+#define HID_REPORT_ITEM_SIZE    (2 + CFG_TUD_HID_BUFSIZE)
+
 typedef struct
 {
+  uint8_t rhport;
   uint8_t itf_num;
   uint8_t ep_in;
   uint8_t ep_out;        // optional Out endpoint
   uint8_t boot_protocol; // Boot mouse or keyboard
   bool    boot_mode;     // default = false (Report)
-  uint8_t idle_rate;     // up to application to handle idle rate
+  uint8_t idle_rate;     // up to application to handle idle rate unless CFG_TUD_HID_IDLE_REPEAT
   uint16_t report_desc_len;
 
   CFG_TUSB_MEM_ALIGN uint8_t epin_buf[CFG_TUD_HID_BUFSIZE];
   CFG_TUSB_MEM_ALIGN uint8_t epout_buf[CFG_TUD_HID_BUFSIZE];
 
+#if CFG_TUD_HID_REPORT_QUEUE
+  // reports waiting for IN endpoint, sent from its completion
+  tu_fifo_t report_ff;
+  uint8_t report_ff_buf[CFG_TUD_HID_REPORT_QUEUE][HID_REPORT_ITEM_SIZE];
+
+#if CFG_FIFO_MUTEX
+  osal_mutex_def_t report_ff_mutex;
+#endif
+#endif
+
+#if CFG_TUD_HID_IDLE_REPEAT
+  // last report sent, repeated when idle period elapses
+  uint16_t idle_frames;
+  uint16_t last_len;
+  uint8_t  last_report[CFG_TUD_HID_BUFSIZE];
+  bool     sof_on; // SOF requested while idle rate is not 0
+#endif
+
   tusb_hid_descriptor_hid_t const * hid_descriptor;
 } hidd_interface_t;
 
 CFG_TUSB_MEM_SECTION static hidd_interface_t _hidd_itf[CFG_TUD_HID];
 
 /*------------- Helpers -------------*/
-static inline hidd_interface_t* get_interface_by_itfnum(uint8_t itf_num)
+static inline hidd_interface_t* get_interface_by_itfnum(uint8_t rhport, uint8_t itf_num)
 {
-  for (uint8_t i=0; i < CFG_TUD_HID; i++ )
+  uint8_t const itf = usbd_itf_inst(rhport, itf_num);
+  return (itf < CFG_TUD_HID) ? &_hidd_itf[itf] : NULL;
+}
+
+static inline uint8_t get_index(hidd_interface_t const* p_hid)
+{
+  return (uint8_t) (p_hid - _hidd_itf);
+}
+
+// Copy report as sent on the wire, return its length
+static uint16_t report_pack(uint8_t* buf, uint8_t report_id, void const* report, uint16_t len)
+{
+  if (report_id)
+  {
+    len = tu_min16(len, CFG_TUD_HID_BUFSIZE-1);
+
+    buf[0] = report_id;
+    memcpy(buf+1, report, len);
+    len++;
+  }else
   {
-    if ( itf_num == _hidd_itf[i].itf_num ) return &_hidd_itf[i];
+    // If report id = 0, skip ID field
+    len = tu_min16(len, CFG_TUD_HID_BUFSIZE);
+    memcpy(buf, report, len);
   }
 
-  return NULL;
+  return len;
+}
+
+// Send report in epin_buf, remember it for idle repeat
+static bool report_send(hidd_interface_t* p_hid, uint16_t len)
+{
+  TU_VERIFY( usbd_edpt_xfer(p_hid->rhport, p_hid->ep_in, p_hid->epin_buf, len) );
+
+#if CFG_TUD_HID_IDLE_REPEAT
+  memcpy(p_hid->last_report, p_hid->epin_buf, len);
+  p_hid->last_len    = len;
+  p_hid->idle_frames = 0;
+#endif
+
+  return true;
+}
+
+static void report_queue_init(hidd_interface_t* p_hid)
+{
+#if CFG_TUD_HID_REPORT_QUEUE
+  tu_fifo_config(&p_hid->report_ff, p_hid->report_ff_buf, CFG_TUD_HID_REPORT_QUEUE, HID_REPORT_ITEM_SIZE, false);
+
+#if CFG_FIFO_MUTEX
+  tu_fifo_config_mutex(&p_hid->report_ff, osal_mutex_create(&p_hid->report_ff_mutex));
+#endif
+#else
+  (void) p_hid;
+#endif
+}
+
+// Send next queued report if any
+static bool report_queue_send(hidd_interface_t* p_hid)
+{
+#if CFG_TUD_HID_REPORT_QUEUE
+  uint8_t item[HID_REPORT_ITEM_SIZE];
+  TU_VERIFY( tu_fifo_read(&p_hid->report_ff, item) );
+
+  uint16_t len;
+  memcpy(&len, item, 2);
+
+  memcpy(p_hid->epin_buf, item+2, len);
+  return report_send(p_hid, len);
+#else
+  (void) p_hid;
+  return false;
+#endif
+}
+
+// Per-interface callbacks take precedence over the ones of single interface
+static uint16_t invoke_get_report(hidd_interface_t const* p_hid, uint8_t report_id, hid_report_type_t report_type, uint8_t* buffer, uint16_t reqlen)
+{
+  if ( tud_hid_n_get_report_cb ) return tud_hid_n_get_report_cb(get_index(p_hid), report_id, report_type, buffer, reqlen);
+  return tud_hid_get_report_cb ? tud_hid_get_report_cb(report_id, report_type, buffer, reqlen) : 0;
+}
+
+static void invoke_set_report(hidd_interface_t const* p_hid, uint8_t report_id, hid_report_type_t report_type, uint8_t const* buffer, uint16_t bufsize)
+{
+  if ( tud_hid_n_set_report_cb )
+  {
+    tud_hid_n_set_report_cb(get_index(p_hid), report_id, report_type, buffer, bufsize);
+  }
+  else if ( tud_hid_set_report_cb )
+  {
+    tud_hid_set_report_cb(report_id, report_type, buffer, bufsize);
+  }
 }
 
 //--------------------------------------------------------------------+
 // APPLICATION API
 //--------------------------------------------------------------------+
-bool tud_hid_ready(void)
+bool tud_hid_n_ready(uint8_t itf)
 {
-  uint8_t itf = 0;
-  uint8_t const ep_in = _hidd_itf[itf].ep_in;
-  return tud_ready() && (ep_in != 0) && usbd_edpt_ready(TUD_OPT_RHPORT, ep_in);
+  TU_VERIFY(itf < CFG_TUD_HID);
+
+  hidd_interface_t * p_hid = &_hidd_itf[itf];
+  TU_VERIFY( tud_n_ready(p_hid->rhport) && (p_hid->ep_in != 0) );
+
+#if CFG_TUD_HID_REPORT_QUEUE
+  // report is accepted while there is room in queue
+  if ( !tu_fifo_full(&p_hid->report_ff) ) return true;
+#endif
+
+  return usbd_edpt_ready(p_hid->rhport, p_hid->ep_in);
 }
 
-bool tud_hid_report(uint8_t report_id, void const* report, uint8_t len)
+bool tud_hid_n_report(uint8_t itf, uint8_t report_id, void const* report, uint16_t len)
 {
-  TU_VERIFY( tud_hid_ready() );
+  TU_VERIFY( tud_hid_n_ready(itf) );
 
-  uint8_t itf = 0;
   hidd_interface_t * p_hid = &_hidd_itf[itf];
 
-  if (report_id)
+#if CFG_TUD_HID_REPORT_QUEUE
+  // queue behind reports not sent yet to keep their order
+  if ( !usbd_edpt_ready(p_hid->rhport, p_hid->ep_in) || !tu_fifo_empty(&p_hid->report_ff) )
   {
-    len = tu_min8(len, CFG_TUD_HID_BUFSIZE-1);
+    uint8_t item[HID_REPORT_ITEM_SIZE];
+    len = report_pack(item+2, report_id, report, len);
+    memcpy(item, &len, 2);
 
-    p_hid->epin_buf[0] = report_id;
-    memcpy(p_hid->epin_buf+1, report, len);
-    len++;
-  }else
-  {
-    // If report id = 0, skip ID field
-    len = tu_min8(len, CFG_TUD_HID_BUFSIZE);
-    memcpy(p_hid->epin_buf, report, len);
+    TU_VERIFY( tu_fifo_write(&p_hid->report_ff, item) );
+
+    // endpoint may have completed meanwhile with nothing to send
+    if ( usbd_edpt_ready(p_hid->rhport, p_hid->ep_in) ) report_queue_send(p_hid);
+
+    return true;
   }
+#endif
+
+  len = report_pack(p_hid->epin_buf, report_id, report, len);
 
-  return usbd_edpt_xfer(TUD_OPT_RHPORT, p_hid->ep_in, p_hid->epin_buf, len);
+  return report_send(p_hid, len);
 }
 
-bool tud_hid_boot_mode(void)
+bool tud_hid_n_boot_mode(uint8_t itf)
 {
-  uint8_t itf = 0;
+  TU_VERIFY(itf < CFG_TUD_HID);
   return _hidd_itf[itf].boot_mode;
 }
 
 //--------------------------------------------------------------------+
 // KEYBOARD API
 //--------------------------------------------------------------------+
-bool tud_hid_keyboard_report(uint8_t report_id, uint8_t modifier, uint8_t keycode[6])
+bool tud_hid_n_keyboard_report(uint8_t itf, uint8_t report_id, uint8_t modifier, uint8_t keycode[6])
 {
   hid_keyboard_report_t report;
 
@@ -124,13 +247,13 @@ bool tud_hid_keyboard_report(uint8_t report_id, uint8_t modifier, uint8_t keycod
     tu_memclr(report.keycode, 6);
   }
 
-  return tud_hid_report(report_id, &report, sizeof(report));
+  return tud_hid_n_report(itf, report_id, &report, sizeof(report));
 }
 
 //--------------------------------------------------------------------+
 // MOUSE APPLICATION API
 //--------------------------------------------------------------------+
-bool tud_hid_mouse_report(uint8_t report_id, uint8_t buttons, int8_t x, int8_t y, int8_t vertical, int8_t horizontal)
+bool tud_hid_n_mouse_report(uint8_t itf, uint8_t report_id, uint8_t buttons, int8_t x, int8_t y, int8_t vertical, int8_t horizontal)
 {
   hid_mouse_report_t report =
   {
@@ -141,7 +264,7 @@ bool tud_hid_mouse_report(uint8_t report_id, uint8_t buttons, int8_t x, int8_t y
     .pan     = horizontal
   };
 
-  return tud_hid_report(report_id, &report, sizeof(report));
+  return tud_hid_n_report(itf, report_id, &report, sizeof(report));
 }
 
 //--------------------------------------------------------------------+
@@ -149,22 +272,39 @@ bool tud_hid_mouse_report(uint8_t report_id, uint8_t buttons, int8_t x, int8_t y
 //--------------------------------------------------------------------+
 void hidd_init(void)
 {
-  hidd_reset(TUD_OPT_RHPORT);
+  tu_memclr(_hidd_itf, sizeof(_hidd_itf));
+
+  for (uint8_t i=0; i < CFG_TUD_HID; i++ ) report_queue_init(&_hidd_itf[i]);
 }
 
 void hidd_reset(uint8_t rhport)
 {
-  (void) rhport;
-  tu_memclr(_hidd_itf, sizeof(_hidd_itf));
+  for (uint8_t i=0; i < CFG_TUD_HID; i++ )
+  {
+    // interface in use by the other roothub port is untouched
+    if ( _hidd_itf[i].ep_in && _hidd_itf[i].rhport != rhport ) continue;
+
+    tu_memclr(&_hidd_itf[i], sizeof(hidd_interface_t));
+    report_queue_init(&_hidd_itf[i]);
+  }
 }
 
-bool hidd_open(uint8_t rhport, tusb_desc_interface_t const * desc_itf, uint16_t *p_len)
+bool hidd_open(uint8_t rhport, tusb_desc_interface_t const * desc_itf, uint16_t *p_len, uint8_t *p_inst)
 {
   uint8_t const *p_desc = (uint8_t const *) desc_itf;
 
-  // TODO support multiple HID interface
-  uint8_t const itf = 0;
-  hidd_interface_t * p_hid = &_hidd_itf[itf];
+  // Find available interface, its instance is the itf of tud_hid_n_*() API
+  hidd_interface_t * p_hid = NULL;
+  for(uint8_t i=0; i<CFG_TUD_HID; i++)
+  {
+    if ( _hidd_itf[i].ep_in == 0 )
+    {
+      p_hid = &_hidd_itf[i];
+      (*p_inst) = i;
+      break;
+    }
+  }
+  TU_ASSERT(p_hid);
 
   //------------- HID descriptor -------------//
   p_desc = tu_desc_next(p_desc);
@@ -178,6 +318,7 @@ bool hidd_open(uint8_t rhport, tusb_desc_interface_t const * desc_itf, uint16_t
   if ( desc_itf->bInterfaceSubClass == HID_SUBCLASS_BOOT ) p_hid->boot_protocol = desc_itf->bInterfaceProtocol;
 
   p_hid->boot_mode = false; // default mode is REPORT
+  p_hid->rhport    = rhport;
   p_hid->itf_num   = desc_itf->bInterfaceNumber;
   memcpy(&p_hid->report_desc_len, &(p_hid->hid_descriptor->wReportLength), 2);
 
@@ -197,7 +338,7 @@ bool hidd_control_request(uint8_t rhport, tusb_control_request_t const * p_reque
   {
     return false;
   }
-  hidd_interface_t* p_hid = get_interface_by_itfnum( (uint8_t) p_request->wIndex );
+  hidd_interface_t* p_hid = get_interface_by_itfnum(rhport, (uint8_t) p_request->wIndex );
   TU_ASSERT(p_hid);
 
   if (p_request->bmRequestType_bit.type == TUSB_REQ_TYPE_STANDARD)
@@ -214,7 +355,10 @@ bool hidd_control_request(uint8_t rhport, tusb_control_request_t const * p_reque
     }
     else if (p_request->bRequest == TUSB_REQ_GET_DESCRIPTOR && desc_type == HID_DESC_TYPE_REPORT)
     {
-      uint8_t const * desc_report = tud_hid_descriptor_report_cb();
+      uint8_t const * desc_report = tud_hid_n_descriptor_report_cb ? tud_hid_n_descriptor_report_cb(get_index(p_hid)) :
+                                    tud_hid_descriptor_report_cb   ? tud_hid_descriptor_report_cb() : NULL;
+      TU_VERIFY(desc_report);
+
       tud_control_xfer(rhport, p_request, (void*) desc_report, p_hid->report_desc_len);
     }
     else
@@ -233,7 +377,7 @@ bool hidd_control_request(uint8_t rhport, tusb_control_request_t const * p_reque
         uint8_t const report_type = tu_u16_high(p_request->wValue);
         uint8_t const report_id   = tu_u16_low(p_request->wValue);
 
-        uint16_t xferlen  = tud_hid_get_report_cb(report_id, (hid_report_type_t) report_type, p_hid->epin_buf, p_request->wLength);
+        uint16_t xferlen  = invoke_get_report(p_hid, report_id, (hid_report_type_t) report_type, p_hid->epin_buf, p_request->wLength);
         TU_ASSERT( xferlen > 0 );
 
         tud_control_xfer(rhport, p_request, p_hid->epin_buf, xferlen);
@@ -247,6 +391,14 @@ bool hidd_control_request(uint8_t rhport, tusb_control_request_t const * p_reque
 
       case HID_REQ_CONTROL_SET_IDLE:
         p_hid->idle_rate = tu_u16_high(p_request->wValue);
+#if CFG_TUD_HID_IDLE_REPEAT
+        p_hid->idle_frames = 0;
+        if ( p_hid->sof_on != (p_hid->idle_rate != 0) )
+        {
+          p_hid->sof_on = (p_hid->idle_rate != 0);
+          usbd_sof_enable(rhport, p_hid->sof_on);
+        }
+#endif
         if ( tud_hid_set_idle_cb )
         {
           // stall request if callback return false
@@ -290,8 +442,7 @@ bool hidd_control_request(uint8_t rhport, tusb_control_request_t const * p_reque
 // return false to stall control endpoint (e.g Host send non-sense DATA)
 bool hidd_control_complete(uint8_t rhport, tusb_control_request_t const * p_request)
 {
-  (void) rhport;
-  hidd_interface_t* p_hid = get_interface_by_itfnum( (uint8_t) p_request->wIndex );
+  hidd_interface_t* p_hid = get_interface_by_itfnum(rhport, (uint8_t) p_request->wIndex );
   TU_ASSERT(p_hid);
 
   if (p_request->bmRequestType_bit.type == TUSB_REQ_TYPE_CLASS &&
@@ -301,7 +452,7 @@ bool hidd_control_complete(uint8_t rhport, tusb_control_request_t const * p_requ
     uint8_t const report_type = tu_u16_high(p_request->wValue);
     uint8_t const report_id   = tu_u16_low(p_request->wValue);
 
-    tud_hid_set_report_cb(report_id, (hid_report_type_t) report_type, p_hid->epout_buf, p_request->wLength);
+    invoke_set_report(p_hid, report_id, (hid_report_type_t) report_type, p_hid->epout_buf, p_request->wLength);
   }
 
   return true;
@@ -311,17 +462,48 @@ bool hidd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_
 {
   (void) result;
 
-  // TODO support multiple HID interface
-  uint8_t const itf = 0;
+  uint8_t const itf = usbd_edpt_inst(rhport, ep_addr);
+  TU_ASSERT(itf < CFG_TUD_HID);
   hidd_interface_t * p_hid = &_hidd_itf[itf];
 
   if (ep_addr == p_hid->ep_out)
   {
-    tud_hid_set_report_cb(0, HID_REPORT_TYPE_INVALID, p_hid->epout_buf, xferred_bytes);
+    invoke_set_report(p_hid, 0, HID_REPORT_TYPE_INVALID, p_hid->epout_buf, (uint16_t) xferred_bytes);
     TU_ASSERT(usbd_edpt_xfer(rhport, p_hid->ep_out, p_hid->epout_buf, sizeof(p_hid->epout_buf)));
   }
+  else if (ep_addr == p_hid->ep_in)
+  {
+    // submit next report right away, one report per polling interval
+    report_queue_send(p_hid);
+  }
 
   return true;
 }
 
+#if CFG_TUD_HID_IDLE_REPEAT
+void hidd_sof(uint8_t rhport)
+{
+  for(uint8_t itf=0; itf<CFG_TUD_HID; itf++)
+  {
+    hidd_interface_t* p_hid = &_hidd_itf[itf];
+
+    // idle rate 0 is indefinite: report only on changes
+    if ( !p_hid->ep_in || p_hid->rhport != rhport || !p_hid->idle_rate || !p_hid->last_len ) continue;
+
+    if ( ++p_hid->idle_frames >= p_hid->idle_rate*HID_IDLE_FRAMES_PER_UNIT(rhport) )
+    {
+      // retried next frame if endpoint is still busy or a new report is queued
+      if ( !usbd_edpt_ready(rhport, p_hid->ep_in) ) continue;
+
+#if CFG_TUD_HID_REPORT_QUEUE
+      if ( !tu_fifo_empty(&p_hid->report_ff) ) continue;
+#endif
+
+      memcpy(p_hid->epin_buf, p_hid->last_report, p_hid->last_len);
+      report_send(p_hid, p_hid->last_len);
+    }
+  }
+}
+#endif
+
 #endif
@@ -39,30 +39,54 @@
 // Class Driver Default Configure & Validation
 //--------------------------------------------------------------------+
 
+// Largest report including its ID. High speed high-bandwidth interrupt endpoint can move
+// up to 3x1024 bytes per microframe, see TUD_HID_EP_SIZE_HIGH_BANDWIDTH()
 #ifndef CFG_TUD_HID_BUFSIZE
 #define CFG_TUD_HID_BUFSIZE     16
 #endif
 
+// Number of IN reports queued per interface while endpoint is busy, 0 to disable. Queued reports are
+// sent from IN completion, tud_hid_report() then only fails when queue is full.
+#ifndef CFG_TUD_HID_REPORT_QUEUE
+#define CFG_TUD_HID_REPORT_QUEUE  0
+#endif
+
+// Stack handles the idle rate set by host: last IN report is sent again from SOF once idle period
+// elapses without a new report. Application then only sends reports on changes.
+#ifndef CFG_TUD_HID_IDLE_REPEAT
+#define CFG_TUD_HID_IDLE_REPEAT   0
+#endif
+
 //--------------------------------------------------------------------+
-// Application API
+// Application API (Multiple Interfaces)
+// CFG_TUD_HID > 1, each interface has its own interrupt endpoint
 //--------------------------------------------------------------------+
 
-// Check if the interface is ready to use
-bool tud_hid_ready(void);
+// Check if the interface is ready to use i.e a report can be sent (or queued)
+bool tud_hid_n_ready(uint8_t itf);
 
 // Check if current mode is Boot (true) or Report (false)
-bool tud_hid_boot_mode(void);
+bool tud_hid_n_boot_mode(uint8_t itf);
 
 // Send report to host
-bool tud_hid_report(uint8_t report_id, void const* report, uint8_t len);
+bool tud_hid_n_report(uint8_t itf, uint8_t report_id, void const* report, uint16_t len);
 
 // KEYBOARD: convenient helper to send keyboard report if application
 // use template layout report as defined by hid_keyboard_report_t
-bool tud_hid_keyboard_report(uint8_t report_id, uint8_t modifier, uint8_t keycode[6]);
+bool tud_hid_n_keyboard_report(uint8_t itf, uint8_t report_id, uint8_t modifier, uint8_t keycode[6]);
 
 // MOUSE: convenient helper to send mouse report if application
 // use template layout report as defined by hid_mouse_report_t
-bool tud_hid_mouse_report(uint8_t report_id, uint8_t buttons, int8_t x, int8_t y, int8_t vertical, int8_t horizontal);
+bool tud_hid_n_mouse_report(uint8_t itf, uint8_t report_id, uint8_t buttons, int8_t x, int8_t y, int8_t vertical, int8_t horizontal);
+
+//--------------------------------------------------------------------+
+// Application API (Interface0)
+//--------------------------------------------------------------------+
+static inline bool tud_hid_ready(void);
+static inline bool tud_hid_boot_mode(void);
+static inline bool tud_hid_report(uint8_t report_id, void const* report, uint16_t len);
+static inline bool tud_hid_keyboard_report(uint8_t report_id, uint8_t modifier, uint8_t keycode[6]);
+static inline bool tud_hid_mouse_report(uint8_t report_id, uint8_t buttons, int8_t x, int8_t y, int8_t vertical, int8_t horizontal);
 
 //--------------------------------------------------------------------+
 // Callbacks (Weak is optional)
@@ -70,16 +94,21 @@ bool tud_hid_mouse_report(uint8_t report_id, uint8_t buttons, int8_t x, int8_t y
 
 // Invoked when received GET HID REPORT DESCRIPTOR request
 // Application return pointer to descriptor, whose contents must exist long enough for transfer to complete
-uint8_t const * tud_hid_descriptor_report_cb(void);
+TU_ATTR_WEAK uint8_t const * tud_hid_descriptor_report_cb(void);
 
 // Invoked when received GET_REPORT control request
 // Application must fill buffer report's content and return its length.
 // Return zero will cause the stack to STALL request
-uint16_t tud_hid_get_report_cb(uint8_t report_id, hid_report_type_t report_type, uint8_t* buffer, uint16_t reqlen);
+TU_ATTR_WEAK uint16_t tud_hid_get_report_cb(uint8_t report_id, hid_report_type_t report_type, uint8_t* buffer, uint16_t reqlen);
 
 // Invoked when received SET_REPORT control request or
 // received data on OUT endpoint ( Report ID = 0, Type = 0 )
-void tud_hid_set_report_cb(uint8_t report_id, hid_report_type_t report_type, uint8_t const* buffer, uint16_t bufsize);
+TU_ATTR_WEAK void tud_hid_set_report_cb(uint8_t report_id, hid_report_type_t report_type, uint8_t const* buffer, uint16_t bufsize);
+
+// Multiple interfaces: same as above with interface index, invoked instead of them if implemented
+TU_ATTR_WEAK uint8_t const * tud_hid_n_descriptor_report_cb(uint8_t itf);
+TU_ATTR_WEAK uint16_t tud_hid_n_get_report_cb(uint8_t itf, uint8_t report_id, hid_report_type_t report_type, uint8_t* buffer, uint16_t reqlen);
+TU_ATTR_WEAK void tud_hid_n_set_report_cb(uint8_t itf, uint8_t report_id, hid_report_type_t report_type, uint8_t const* buffer, uint16_t bufsize);
 
 // Invoked when received SET_PROTOCOL request ( mode switch Boot <-> Report )
 TU_ATTR_WEAK void tud_hid_boot_mode_cb(uint8_t boot_mode);
@@ -87,8 +116,37 @@ TU_ATTR_WEAK void tud_hid_boot_mode_cb(uint8_t boot_mode);
 // Invoked when received SET_IDLE request. return false will stall the request
 // - Idle Rate = 0 : only send report if there is changes, i.e skip duplication
 // - Idle Rate > 0 : skip duplication, but send at least 1 report every idle rate (in unit of 4 ms).
+// With CFG_TUD_HID_IDLE_REPEAT the stack resends the last report itself.
 TU_ATTR_WEAK bool tud_hid_set_idle_cb(uint8_t idle_rate);
 
+//--------------------------------------------------------------------+
+// Inline Functions
+//--------------------------------------------------------------------+
+static inline bool tud_hid_ready(void)
+{
+  return tud_hid_n_ready(0);
+}
+
+static inline bool tud_hid_boot_mode(void)
+{
+  return tud_hid_n_boot_mode(0);
+}
+
+static inline bool tud_hid_report(uint8_t report_id, void const* report, uint16_t len)
+{
+  return tud_hid_n_report(0, report_id, report, len);
+}
+
+static inline bool tud_hid_keyboard_report(uint8_t report_id, uint8_t modifier, uint8_t keycode[6])
+{
+  return tud_hid_n_keyboard_report(0, report_id, modifier, keycode);
+}
+
+static inline bool tud_hid_mouse_report(uint8_t report_id, uint8_t buttons, int8_t x, int8_t y, int8_t vertical, int8_t horizontal)
+{
+  return tud_hid_n_mouse_report(0, report_id, buttons, x, y, vertical, horizontal);
+}
+
 /* --------------------------------------------------------------------+
  * HID Report Descriptor Template
  *
@@ -297,15 +355,111 @@ TU_ATTR_WEAK bool tud_hid_set_idle_cb(uint8_t idle_rate);
       HID_OUTPUT      ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE  ),\
     HID_COLLECTION_END \
 
+/* --------------------------------------------------------------------+
+ * HID Report Layout
+ *
+ * Declare report fields once, get both descriptor items and bit-exact
+ * setters whose offsets are computed at compile time. Layout is a macro
+ * taking FIELD, PAD and report name, fields are packed in order:
+ *
+ *   FIELD(_r, name, bits, count, flags, (descriptor items))
+ *   PAD  (_r, name, bits)
+ *
+ *      #define GAMEPAD_LAYOUT(FIELD, PAD, _r) \
+ *        FIELD(_r, buttons, 1, 12, HID_DATA | HID_VARIABLE | HID_ABSOLUTE,        \
+ *              ( HID_USAGE_PAGE(HID_USAGE_PAGE_BUTTON), HID_USAGE_MIN(1),         \
+ *                HID_USAGE_MAX(12), HID_LOGICAL_MIN(0), HID_LOGICAL_MAX(1) ))     \
+ *        PAD  (_r, pad, 4)                                                        \
+ *        FIELD(_r, axis, 16, 2, HID_DATA | HID_VARIABLE | HID_ABSOLUTE,           \
+ *              ( HID_USAGE_PAGE(HID_USAGE_PAGE_DESKTOP), HID_USAGE(HID_USAGE_DESKTOP_X), \
+ *                HID_USAGE(HID_USAGE_DESKTOP_Y), HID_LOGICAL_MIN_N(-32767, 2),   \
+ *                HID_LOGICAL_MAX_N(32767, 2) ))
+ *
+ *      TUD_HID_REPORT_LAYOUT(gamepad, GAMEPAD_LAYOUT)
+ *
+ *      uint8_t const report_desc[] =
+ *      {
+ *        HID_USAGE_PAGE(HID_USAGE_PAGE_DESKTOP), HID_USAGE(HID_USAGE_DESKTOP_GAMEPAD),
+ *        HID_COLLECTION(HID_COLLECTION_APPLICATION),
+ *          TUD_HID_REPORT_LAYOUT_DESC(gamepad, GAMEPAD_LAYOUT)
+ *        HID_COLLECTION_END
+ *      };
+ *
+ *      uint8_t report[gamepad_size] = { 0 };
+ *      gamepad_set_buttons(report, 3, 1); // button 4 pressed
+ *      gamepad_set_axis(report, 1, -100); // Y
+ *      tud_hid_report(0, report, gamepad_size);
+ *
+ * Each field gets enum <report>_<name>_pos (first bit) and a setter
+ * <report>_set_<name>(report, index, value). Report must end on a byte
+ * boundary and fit into CFG_TUD_HID_BUFSIZE.
+ *--------------------------------------------------------------------*/
+
+// Write bits (up to 32) of value at bit position of report, LSB first as in HID reports
+static inline void tud_hid_field_set(uint8_t report[], uint16_t bitpos, uint8_t bits, uint32_t value)
+{
+  uint8_t* p = report + bitpos/8;
+  uint8_t const shift = (uint8_t) (bitpos % 8);
+
+  uint64_t const mask = (((1ULL << bits) - 1) << shift);
+  uint64_t const data = (((uint64_t) value) << shift) & mask;
+
+  for(uint8_t i = 0; i < (shift + bits + 7)/8; i++)
+  {
+    p[i] = (uint8_t) ((p[i] & ~(mask >> 8*i)) | (data >> 8*i));
+  }
+}
+
+// Enum of field positions, setters then descriptor items
+#define TUD_HID_REPORT_LAYOUT(_r, _layout) \
+  enum { _r##_begin_ = -1, _layout(_TUD_HID_LAYOUT_POS, _TUD_HID_LAYOUT_PAD_POS, _r) _r##_bits }; \
+  enum { _r##_size = _r##_bits / 8 }; \
+  TU_VERIFY_STATIC( (_r##_bits % 8) == 0, #_r " report must end on byte boundary"); \
+  TU_VERIFY_STATIC( _r##_size <= CFG_TUD_HID_BUFSIZE, #_r " report does not fit CFG_TUD_HID_BUFSIZE"); \
+  _layout(_TUD_HID_LAYOUT_SETTER, _TUD_HID_LAYOUT_NONE, _r)
+
+#define TUD_HID_REPORT_LAYOUT_DESC(_r, _layout) \
+  _layout(_TUD_HID_LAYOUT_DESC, _TUD_HID_LAYOUT_PAD_DESC, _r)
+
+// Internal: next enumerator after <name>_last is the position of next field
+#define _TUD_HID_LAYOUT_POS(_r, _name, _bits, _count, _flags, _items) \
+  _r##_##_name##_pos, _r##_##_name##_last = _r##_##_name##_pos + (_bits)*(_count) - 1,
+
+#define _TUD_HID_LAYOUT_PAD_POS(_r, _name, _bits) \
+  _TUD_HID_LAYOUT_POS(_r, _name, _bits, 1, , )
+
+#define _TUD_HID_LAYOUT_SETTER(_r, _name, _bits, _count, _flags, _items) \
+  TU_VERIFY_STATIC( (_bits) <= 32, #_name " field is larger than 32 bits"); \
+  static inline void _r##_set_##_name(uint8_t report[], uint8_t idx, int32_t value) \
+  { \
+    tud_hid_field_set(report, (uint16_t) (_r##_##_name##_pos + idx*(_bits)), _bits, (uint32_t) value); \
+  }
+
+#define _TUD_HID_LAYOUT_NONE(...)
+
+#define _TUD_HID_LAYOUT_ITEMS(...)  __VA_ARGS__
+
+#define _TUD_HID_LAYOUT_DESC(_r, _name, _bits, _count, _flags, _items) \
+  _TUD_HID_LAYOUT_ITEMS _items ,\
+  HID_REPORT_COUNT ( _count ) ,\
+  HID_REPORT_SIZE  ( _bits  ) ,\
+  HID_INPUT        ( _flags ) ,
+
+#define _TUD_HID_LAYOUT_PAD_DESC(_r, _name, _bits) \
+  HID_REPORT_COUNT ( 1            ) ,\
+  HID_REPORT_SIZE  ( _bits        ) ,\
+  HID_INPUT        ( HID_CONSTANT ) ,
+
 //--------------------------------------------------------------------+
 // Internal Class Driver API
 //--------------------------------------------------------------------+
 void hidd_init             (void);
 void hidd_reset            (uint8_t rhport);
-bool hidd_open             (uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t *p_length);
+bool hidd_open             (uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t *p_length, uint8_t *p_inst);
 bool hidd_control_request  (uint8_t rhport, tusb_control_request_t const * request);
 bool hidd_control_complete (uint8_t rhport, tusb_control_request_t const * request);
 bool hidd_xfer_cb          (uint8_t rhport, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes);
+void hidd_sof              (uint8_t rhport);
 
 #ifdef __cplusplus
  }
@@ -38,14 +38,15 @@
 //--------------------------------------------------------------------+
 // HID Interface common functions
 //--------------------------------------------------------------------+
-static inline bool hidh_interface_open(uint8_t dev_addr, uint8_t interface_number, tusb_desc_endpoint_t const *p_endpoint_desc, hidh_interface_info_t *p_hid)
+static inline bool hidh_interface_open(uint8_t rhport, uint8_t dev_addr, uint8_t interface_number, tusb_desc_endpoint_t const *p_endpoint_desc, hidh_interface_info_t *p_hid)
 {
-  p_hid->pipe_hdl         = hcd_edpt_open(dev_addr, p_endpoint_desc, TUSB_CLASS_HID);
+  TU_ASSERT( hcd_edpt_open(rhport, dev_addr, p_endpoint_desc) );
+  usbh_edpt_prio(dev_addr, p_endpoint_desc->bEndpointAddress, true); // user input
+
+  p_hid->ep_in            = p_endpoint_desc->bEndpointAddress;
   p_hid->report_size      = p_endpoint_desc->wMaxPacketSize.size; // TODO get size from report descriptor
   p_hid->interface_number = interface_number;
 
-  TU_ASSERT (pipehandle_is_valid(p_hid->pipe_hdl));
-
   return true;
 }
 
@@ -61,9 +62,9 @@ tusb_error_t hidh_interface_get_report(uint8_t dev_addr, void * report, hidh_int
   // TODO change to use is configured function
   TU_ASSERT (TUSB_DEVICE_STATE_CONFIGURED == tuh_device_get_state(dev_addr), TUSB_ERROR_DEVICE_NOT_READY);
   TU_VERIFY (report, TUSB_ERROR_INVALID_PARA);
-  TU_ASSERT (!hcd_edpt_busy(p_hid->pipe_hdl), TUSB_ERROR_INTERFACE_IS_BUSY);
+  TU_ASSERT (!hcd_edpt_busy(dev_addr, p_hid->ep_in), TUSB_ERROR_INTERFACE_IS_BUSY);
 
-  TU_ASSERT_ERR( hcd_pipe_xfer(p_hid->pipe_hdl, report, p_hid->report_size, true) ) ;
+  TU_ASSERT (hcd_pipe_xfer(dev_addr, p_hid->ep_in, report, p_hid->report_size, true), TUSB_ERROR_FAILED);
 
   return TUSB_ERROR_NONE;
 }
@@ -90,7 +91,7 @@ static hidh_interface_info_t keyboardh_data[CFG_TUSB_HOST_DEVICE_MAX]; // does n
 //------------- KEYBOARD PUBLIC API (parameter validation required) -------------//
 bool  tuh_hid_keyboard_is_mounted(uint8_t dev_addr)
 {
-  return tuh_device_is_configured(dev_addr) && pipehandle_is_valid(keyboardh_data[dev_addr-1].pipe_hdl);
+  return tuh_device_is_configured(dev_addr) && (keyboardh_data[dev_addr-1].ep_in != 0);
 }
 
 tusb_error_t tuh_hid_keyboard_get_report(uint8_t dev_addr, void* p_report)
@@ -101,7 +102,7 @@ tusb_error_t tuh_hid_keyboard_get_report(uint8_t dev_addr, void* p_report)
 bool tuh_hid_keyboard_is_busy(uint8_t dev_addr)
 {
   return  tuh_hid_keyboard_is_mounted(dev_addr) &&
-          hcd_edpt_busy( keyboardh_data[dev_addr-1].pipe_hdl );
+          hcd_edpt_busy(dev_addr, keyboardh_data[dev_addr-1].ep_in);
 }
 
 #endif
@@ -116,13 +117,13 @@ static hidh_interface_info_t mouseh_data[CFG_TUSB_HOST_DEVICE_MAX]; // does not
 //------------- Public API -------------//
 bool tuh_hid_mouse_is_mounted(uint8_t dev_addr)
 {
-  return tuh_device_is_configured(dev_addr) && pipehandle_is_valid(mouseh_data[dev_addr-1].pipe_hdl);
+  return tuh_device_is_configured(dev_addr) && (mouseh_data[dev_addr-1].ep_in != 0);
 }
 
 bool tuh_hid_mouse_is_busy(uint8_t dev_addr)
 {
   return  tuh_hid_mouse_is_mounted(dev_addr) &&
-          hcd_edpt_busy( mouseh_data[dev_addr-1].pipe_hdl );
+          hcd_edpt_busy(dev_addr, mouseh_data[dev_addr-1].ep_in);
 }
 
 tusb_error_t tuh_hid_mouse_get_report(uint8_t dev_addr, void * report)
@@ -137,9 +138,439 @@ tusb_error_t tuh_hid_mouse_get_report(uint8_t dev_addr, void * report)
 //--------------------------------------------------------------------+
 #if CFG_TUSB_HOST_HID_GENERIC
 
-//STATIC_ struct {
-//  hidh_interface_info_t
-//} generic_data[CFG_TUSB_HOST_DEVICE_MAX];
+// Input reports with distinct ID tracked while parsing
+#define HID_PARSER_REPORT_MAX   8
+#define HID_PARSER_USAGE_MAX    16
+
+// Queued report: 16-bit length followed by report
+#define HIDH_REPORT_ITEM_SIZE   (2 + CFG_TUH_HID_EP_BUFSIZE)
+
+typedef struct
+{
+  uint8_t  dev_addr;
+  uint8_t  itf_num;
+  uint8_t  ep_in;
+  uint16_t report_size;
+
+  uint16_t report_desc_len;
+  bool     mounted; // report descriptor is parsed, reports are polled
+
+  uint8_t field_count;
+  tuh_hid_field_t fields[CFG_TUH_HID_GENERIC_FIELDS];
+
+  // filled from transfer complete (ISR), drained by application
+  tu_fifo_t report_ff;
+  uint8_t report_ff_buf[CFG_TUH_HID_REPORT_QUEUE][HIDH_REPORT_ITEM_SIZE];
+
+  CFG_TUSB_MEM_ALIGN uint8_t epin_buf[CFG_TUH_HID_EP_BUFSIZE];
+} hidh_generic_info_t;
+
+// Generic interfaces of all devices, index is the instance of tuh_hid_n_*() API
+CFG_TUSB_MEM_SECTION static hidh_generic_info_t _hidh_itf[CFG_TUH_HID_ITF_MAX];
+
+// Report descriptor is only needed while parsing at open
+CFG_TUSB_MEM_SECTION TU_ATTR_ALIGNED(4) static uint8_t _report_desc[CFG_TUH_HID_REPORT_DESC_SIZE];
+
+//------------- Parser -------------//
+typedef struct
+{
+  uint16_t usage_page;
+  int32_t  logical_min;
+  int32_t  logical_max;
+  uint32_t logical_max_raw; // unsigned interpretation, see hid_parser_add()
+  uint8_t  report_size;
+  uint8_t  report_count;
+  uint8_t  report_id;
+} hid_parser_global_t;
+
+typedef struct
+{
+  hid_parser_global_t global;
+  hid_parser_global_t global_stack; // single level PUSH/POP
+
+  // local items, cleared by each main item
+  uint8_t  usage_count;
+  uint16_t usages[HID_PARSER_USAGE_MAX];
+  uint16_t usage_min;
+  uint16_t usage_max;
+  bool     has_usage_range;
+
+  // next bit offset of each Input report
+  uint8_t  report_count;
+  uint8_t  report_ids[HID_PARSER_REPORT_MAX];
+  uint16_t report_bits[HID_PARSER_REPORT_MAX];
+} hid_parser_t;
+
+// Offset of next field in the report of current ID, Report ID byte counts as first 8 bits
+static uint16_t* hid_parser_offset(hid_parser_t* p)
+{
+  for(uint8_t i=0; i<p->report_count; i++)
+  {
+    if ( p->report_ids[i] == p->global.report_id ) return &p->report_bits[i];
+  }
+
+  TU_VERIFY(p->report_count < HID_PARSER_REPORT_MAX, NULL);
+
+  uint8_t const i = p->report_count++;
+  p->report_ids[i]  = p->global.report_id;
+  p->report_bits[i] = p->global.report_id ? 8 : 0;
+
+  return &p->report_bits[i];
+}
+
+static bool hid_parser_field(hidh_generic_info_t* p_gen, hid_parser_t const* p, uint16_t usage, uint16_t bit_offset, uint8_t count, uint8_t flags)
+{
+  TU_VERIFY(p_gen->field_count < CFG_TUH_HID_GENERIC_FIELDS);
+
+  tuh_hid_field_t* field = &p_gen->fields[p_gen->field_count++];
+
+  field->usage_page  = p->global.usage_page;
+  field->usage       = usage;
+  field->bit_offset  = bit_offset;
+  field->bit_size    = p->global.report_size;
+  field->count       = count;
+  field->report_id   = p->global.report_id;
+  field->flags       = flags;
+  field->logical_min = p->global.logical_min;
+
+  // Logical Max 0xFF with non-negative Min is meant as 255 by most devices rather than -1
+  field->logical_max = p->global.logical_max;
+  if ( (p->global.logical_min >= 0) && (p->global.logical_max < p->global.logical_min) )
+  {
+    field->logical_max = (int32_t) p->global.logical_max_raw;
+  }
+
+  return true;
+}
+
+// Input main item: one field per element of Variable item, one field for whole Array item
+static bool hid_parser_input(hidh_generic_info_t* p_gen, hid_parser_t* p, uint8_t flags)
+{
+  uint16_t* offset = hid_parser_offset(p);
+  TU_VERIFY(offset);
+
+  uint16_t const bits = (uint16_t) (p->global.report_size * p->global.report_count);
+
+  if ( !(flags & HID_CONSTANT) && p->global.report_count && (p->global.report_size <= 32) )
+  {
+    if ( flags & HID_VARIABLE )
+    {
+      for(uint8_t i=0; i<p->global.report_count; i++)
+      {
+        uint16_t usage;
+        if ( p->has_usage_range )
+        {
+          usage = (uint16_t) (p->usage_min + i);
+          if ( usage > p->usage_max ) usage = p->usage_max;
+        }
+        else if ( p->usage_count )
+        {
+          // last usage applies to remaining elements
+          usage = p->usages[ tu_min8(i, (uint8_t) (p->usage_count-1)) ];
+        }
+        else
+        {
+          usage = 0;
+        }
+
+        TU_VERIFY( hid_parser_field(p_gen, p, usage, (uint16_t) (*offset + i*p->global.report_size), 1, flags) );
+      }
+    }
+    else
+    {
+      uint16_t const usage = p->has_usage_range ? p->usage_min : (p->usage_count ? p->usages[0] : 0);
+      TU_VERIFY( hid_parser_field(p_gen, p, usage, *offset, p->global.report_count, flags) );
+    }
+  }
+
+  *offset = (uint16_t) (*offset + bits);
+
+  return true;
+}
+
+static bool hid_parse_report_desc(hidh_generic_info_t* p_gen, uint8_t const* desc, uint16_t desc_len)
+{
+  hid_parser_t parser;
+  hid_parser_t* p = &parser;
+  tu_memclr(p, sizeof(hid_parser_t));
+
+  p_gen->field_count = 0;
+
+  uint8_t const* desc_end = desc + desc_len;
+
+  while ( desc < desc_end )
+  {
+    uint8_t const prefix = *desc++;
+
+    // Long item is not defined by HID 1.11, skip it
+    if ( prefix == 0xFE )
+    {
+      TU_VERIFY(desc < desc_end);
+      desc += 2 + desc[0];
+      continue;
+    }
+
+    uint8_t const size = ((prefix & 0x03) == 3) ? 4 : (prefix & 0x03);
+    uint8_t const type = (prefix >> 2) & 0x03;
+    uint8_t const tag  = (prefix >> 4);
+
+    TU_VERIFY(desc + size <= desc_end);
+
+    uint32_t data = 0;
+    for(uint8_t i=0; i<size; i++) data |= ((uint32_t) desc[i]) << (8*i);
+
+    // signed value sign-extended from item size
+    int32_t sdata = (int32_t) data;
+    if ( size == 1 ) sdata = (int8_t) data;
+    if ( size == 2 ) sdata = (int16_t) data;
+
+    desc += size;
+
+    switch ( type )
+    {
+      case RI_TYPE_MAIN:
+        // Output and Feature reports are not parsed, their layout is not needed to read Input
+        if ( tag == 8 ) TU_VERIFY( hid_parser_input(p_gen, p, (uint8_t) data) );
+
+        p->usage_count     = 0;
+        p->has_usage_range = false;
+      break;
+
+      case RI_TYPE_GLOBAL:
+        switch ( tag )
+        {
+          case 0: p->global.usage_page   = (uint16_t) data;                          break;
+          case 1: p->global.logical_min  = sdata;                                    break;
+          case 2: p->global.logical_max  = sdata; p->global.logical_max_raw = data;  break;
+          case 7: p->global.report_size  = (uint8_t) data;                           break;
+          case 8: p->global.report_id    = (uint8_t) data;                           break;
+          case 9: p->global.report_count = (uint8_t) data;                           break;
+          case 10: p->global_stack       = p->global;                                break;
+          case 11: p->global             = p->global_stack;                          break;
+          default: break;
+        }
+      break;
+
+      case RI_TYPE_LOCAL:
+        // 4-byte usage carries its page in upper 16 bits
+        if ( (size == 4) && (tag <= 2) ) p->global.usage_page = (uint16_t) (data >> 16);
+
+        switch ( tag )
+        {
+          case 0:
+            if ( p->usage_count < HID_PARSER_USAGE_MAX ) p->usages[p->usage_count++] = (uint16_t) data;
+          break;
+
+          case 1: p->usage_min = (uint16_t) data; p->has_usage_range = true; break;
+          case 2: p->usage_max = (uint16_t) data;                            break;
+          default: break;
+        }
+      break;
+
+      default: break;
+    }
+  }
+
+  return true;
+}
+
+static inline hidh_generic_info_t* get_instance(uint8_t dev_addr, uint8_t ep_addr)
+{
+  for(uint8_t i=0; i<CFG_TUH_HID_ITF_MAX; i++)
+  {
+    hidh_generic_info_t* p_gen = &_hidh_itf[i];
+    if ( p_gen->ep_in && (p_gen->dev_addr == dev_addr) && (p_gen->ep_in == ep_addr) ) return p_gen;
+  }
+
+  return NULL;
+}
+
+static inline bool report_xfer(hidh_generic_info_t* p_gen)
+{
+  return hcd_pipe_xfer(p_gen->dev_addr, p_gen->ep_in, p_gen->epin_buf, p_gen->report_size, true);
+}
+
+//------------- Public API -------------//
+bool tuh_hid_n_mounted(uint8_t inst)
+{
+  TU_VERIFY(inst < CFG_TUH_HID_ITF_MAX);
+  return _hidh_itf[inst].mounted && tuh_device_is_configured(_hidh_itf[inst].dev_addr);
+}
+
+uint8_t tuh_hid_n_dev_addr(uint8_t inst)
+{
+  return _hidh_itf[inst].dev_addr;
+}
+
+uint8_t tuh_hid_n_itf_num(uint8_t inst)
+{
+  return _hidh_itf[inst].itf_num;
+}
+
+uint8_t tuh_hid_n_available(uint8_t inst)
+{
+  return (uint8_t) tu_fifo_count(&_hidh_itf[inst].report_ff);
+}
+
+uint16_t tuh_hid_n_read(uint8_t inst, void* buffer, uint16_t bufsize)
+{
+  TU_VERIFY(inst < CFG_TUH_HID_ITF_MAX, 0);
+
+  uint8_t item[HIDH_REPORT_ITEM_SIZE];
+  TU_VERIFY( tu_fifo_read(&_hidh_itf[inst].report_ff, item), 0 );
+
+  uint16_t len;
+  memcpy(&len, item, 2);
+  len = tu_min16(len, bufsize);
+
+  memcpy(buffer, item+2, len);
+  return len;
+}
+
+tuh_hid_field_t const* tuh_hid_n_fields(uint8_t inst, uint8_t* count)
+{
+  hidh_generic_info_t const* p_gen = &_hidh_itf[inst];
+
+  *count = p_gen->field_count;
+  return p_gen->fields;
+}
+
+tuh_hid_field_t const* tuh_hid_n_find_field(uint8_t inst, uint16_t usage_page, uint16_t usage)
+{
+  hidh_generic_info_t const* p_gen = &_hidh_itf[inst];
+
+  for(uint8_t i=0; i<p_gen->field_count; i++)
+  {
+    tuh_hid_field_t const* field = &p_gen->fields[i];
+    if ( (field->usage_page == usage_page) && (field->usage == usage) ) return field;
+  }
+
+  return NULL;
+}
+
+int32_t tuh_hid_field_value(tuh_hid_field_t const* field, uint8_t const* report, uint8_t idx)
+{
+  uint16_t const bitpos = (uint16_t) (field->bit_offset + idx*field->bit_size);
+  uint8_t const* p = report + bitpos/8;
+  uint8_t const shift = (uint8_t) (bitpos % 8);
+
+  uint64_t data = 0;
+  for(uint8_t i=0; i < (shift + field->bit_size + 7)/8; i++) data |= ((uint64_t) p[i]) << (8*i);
+
+  uint32_t value = (uint32_t) (data >> shift);
+  if ( field->bit_size < 32 )
+  {
+    value &= (1UL << field->bit_size) - 1;
+
+    // sign extend when logical range is signed
+    if ( (field->logical_min < 0) && (value & (1UL << (field->bit_size-1))) ) value |= ~((1UL << field->bit_size) - 1);
+  }
+
+  return (int32_t) value;
+}
+
+static bool hidh_generic_open(uint8_t rhport, uint8_t dev_addr, tusb_desc_interface_t const *p_interface_desc,
+                              tusb_hid_descriptor_hid_t const *p_desc_hid, tusb_desc_endpoint_t const * p_endpoint_desc)
+{
+  // Find available interface
+  uint8_t inst;
+  for(inst=0; inst<CFG_TUH_HID_ITF_MAX; inst++)
+  {
+    if ( _hidh_itf[inst].ep_in == 0 ) break;
+  }
+  TU_VERIFY(inst < CFG_TUH_HID_ITF_MAX);
+
+  hidh_generic_info_t* p_gen = &_hidh_itf[inst];
+
+  uint16_t const desc_len = p_desc_hid->wReportLength;
+  TU_VERIFY(desc_len && (desc_len <= CFG_TUH_HID_REPORT_DESC_SIZE));
+  TU_VERIFY(p_endpoint_desc->wMaxPacketSize.size <= CFG_TUH_HID_EP_BUFSIZE);
+
+  TU_ASSERT( hcd_edpt_open(rhport, dev_addr, p_endpoint_desc) );
+  usbh_edpt_prio(dev_addr, p_endpoint_desc->bEndpointAddress, true); // user input
+
+  p_gen->dev_addr        = dev_addr;
+  p_gen->itf_num         = p_interface_desc->bInterfaceNumber;
+  p_gen->ep_in           = p_endpoint_desc->bEndpointAddress;
+  p_gen->report_size     = p_endpoint_desc->wMaxPacketSize.size;
+  p_gen->report_desc_len = desc_len;
+
+  // single producer (ISR) and single consumer (application) need no mutex
+  tu_fifo_config(&p_gen->report_ff, p_gen->report_ff_buf, CFG_TUH_HID_REPORT_QUEUE, HIDH_REPORT_ITEM_SIZE, false);
+
+  return true;
+}
+
+static void hidh_report_desc_complete(uint8_t dev_addr, tusb_control_request_t const * request, xfer_result_t result)
+{
+  uint8_t const itf_num = (uint8_t) request->wIndex;
+
+  for(uint8_t inst=0; inst<CFG_TUH_HID_ITF_MAX; inst++)
+  {
+    hidh_generic_info_t* p_gen = &_hidh_itf[inst];
+    if ( !p_gen->ep_in || (p_gen->dev_addr != dev_addr) || (p_gen->itf_num != itf_num) ) continue;
+
+    // compiled once into field table, reports are then extracted without walking the descriptor.
+    // Instance is released if it cannot be parsed, its endpoint is never polled
+    if ( (XFER_RESULT_SUCCESS != result) || !hid_parse_report_desc(p_gen, _report_desc, p_gen->report_desc_len) )
+    {
+      tu_memclr(p_gen, sizeof(hidh_generic_info_t));
+      break;
+    }
+
+    p_gen->mounted = true;
+    if ( tuh_hid_n_mounted_cb ) tuh_hid_n_mounted_cb(inst);
+
+    // keep polling interrupt endpoint, reports are queued as they arrive
+    (void) report_xfer(p_gen);
+    break;
+  }
+
+  usbh_driver_set_config_complete(dev_addr, itf_num);
+}
+
+//------------- Get Report Descriptor -------------//
+static bool hidh_generic_set_config(uint8_t dev_addr, uint8_t itf_num)
+{
+  for(uint8_t inst=0; inst<CFG_TUH_HID_ITF_MAX; inst++)
+  {
+    hidh_generic_info_t const* p_gen = &_hidh_itf[inst];
+    if ( !p_gen->ep_in || (p_gen->dev_addr != dev_addr) || (p_gen->itf_num != itf_num) ) continue;
+
+    tusb_control_request_t const request = {
+          .bmRequestType_bit = { .recipient = TUSB_REQ_RCPT_INTERFACE, .type = TUSB_REQ_TYPE_STANDARD, .direction = TUSB_DIR_IN },
+          .bRequest = TUSB_REQ_GET_DESCRIPTOR,
+          .wValue = HID_DESC_TYPE_REPORT << 8,
+          .wIndex = itf_num,
+          .wLength = p_gen->report_desc_len
+    };
+
+    return tuh_control_xfer(dev_addr, &request, _report_desc, hidh_report_desc_complete);
+  }
+
+  return false;
+}
+
+static void hidh_generic_isr(hidh_generic_info_t* p_gen, xfer_result_t event, uint32_t xferred_bytes)
+{
+  if ( XFER_RESULT_SUCCESS == event )
+  {
+    uint8_t item[HIDH_REPORT_ITEM_SIZE];
+    uint16_t const len = (uint16_t) tu_min32(xferred_bytes, p_gen->report_size);
+
+    memcpy(item, &len, 2);
+    memcpy(item+2, p_gen->epin_buf, len);
+
+    // report is dropped if application does not keep up
+    tu_fifo_write(&p_gen->report_ff, item);
+  }
+
+  uint8_t const inst = (uint8_t) (p_gen - _hidh_itf);
+  if ( tuh_hid_n_isr ) tuh_hid_n_isr(inst, event);
+
+  // stalled endpoint is not polled anymore
+  if ( XFER_RESULT_STALLED != event ) report_xfer(p_gen);
+}
 
 #endif
 
@@ -157,114 +588,148 @@ void hidh_init(void)
 #endif
 
 #if CFG_TUSB_HOST_HID_GENERIC
-  hidh_generic_init();
+  tu_memclr(_hidh_itf, sizeof(_hidh_itf));
 #endif
 }
 
-#if 0
-CFG_TUSB_MEM_SECTION uint8_t report_descriptor[256];
-#endif
-
-bool hidh_open_subtask(uint8_t dev_addr, tusb_desc_interface_t const *p_interface_desc, uint16_t *p_length)
+bool hidh_open_subtask(uint8_t rhport, uint8_t dev_addr, tusb_desc_interface_t const *p_interface_desc, uint16_t *p_length)
 {
   uint8_t const *p_desc = (uint8_t const *) p_interface_desc;
 
   //------------- HID descriptor -------------//
   p_desc += p_desc[DESC_OFFSET_LEN];
   tusb_hid_descriptor_hid_t const *p_desc_hid = (tusb_hid_descriptor_hid_t const *) p_desc;
-  TU_ASSERT(HID_DESC_TYPE_HID == p_desc_hid->bDescriptorType, TUSB_ERROR_INVALID_PARA);
+  TU_ASSERT(HID_DESC_TYPE_HID == p_desc_hid->bDescriptorType);
 
-  //------------- Endpoint Descriptor -------------//
-  p_desc += p_desc[DESC_OFFSET_LEN];
-  tusb_desc_endpoint_t const * p_endpoint_desc = (tusb_desc_endpoint_t const *) p_desc;
-  TU_ASSERT(TUSB_DESC_ENDPOINT == p_endpoint_desc->bDescriptorType, TUSB_ERROR_INVALID_PARA);
+  // interface is skipped by usbh even if not opened e.g all generic instances are in use
+  *p_length = (uint16_t) (sizeof(tusb_desc_interface_t) + sizeof(tusb_hid_descriptor_hid_t) + p_interface_desc->bNumEndpoints*sizeof(tusb_desc_endpoint_t));
 
-  //------------- SET IDLE (0) request -------------//
-  tusb_control_request_t request = {
-        .bmRequestType_bit = { .recipient = TUSB_REQ_RCPT_INTERFACE, .type = TUSB_REQ_TYPE_CLASS, .direction = TUSB_DIR_OUT },
-        .bRequest = HID_REQ_CONTROL_SET_IDLE,
-        .wValue = 0, // idle_rate = 0
-        .wIndex = p_interface_desc->bInterfaceNumber,
-        .wLength = 0
-  };
-  TU_ASSERT( usbh_control_xfer( dev_addr, &request, NULL ) );
-
-#if 0
-  //------------- Get Report Descriptor TODO HID parser -------------//
-  if ( p_desc_hid->bNumDescriptors )
+  //------------- Endpoint Descriptor -------------//
+  // Interrupt IN, optional Interrupt OUT is not used
+  tusb_desc_endpoint_t const * p_endpoint_desc = NULL;
+  for(uint8_t i=0; i<p_interface_desc->bNumEndpoints; i++)
   {
-    STASK_INVOKE(
-        usbh_control_xfer_subtask( dev_addr, bm_request_type(TUSB_DIR_IN, TUSB_REQ_TYPE_STANDARD, TUSB_REQ_RCPT_INTERFACE),
-                                   TUSB_REQ_GET_DESCRIPTOR, (p_desc_hid->bReportType << 8), 0,
-                                   p_desc_hid->wReportLength, report_descriptor ),
-        error
-    );
-    (void) error; // if error in getting report descriptor --> treating like there is none
+    p_desc += p_desc[DESC_OFFSET_LEN];
+    TU_ASSERT(TUSB_DESC_ENDPOINT == p_desc[DESC_OFFSET_TYPE]);
+
+    if ( TUSB_DIR_IN == tu_edpt_dir(((tusb_desc_endpoint_t const *) p_desc)->bEndpointAddress) )
+    {
+      p_endpoint_desc = (tusb_desc_endpoint_t const *) p_desc;
+      break;
+    }
   }
-#endif
+  TU_ASSERT(p_endpoint_desc);
+
+  bool opened = false;
 
   if ( HID_SUBCLASS_BOOT == p_interface_desc->bInterfaceSubClass )
   {
     #if CFG_TUH_HID_KEYBOARD
-    if ( HID_PROTOCOL_KEYBOARD == p_interface_desc->bInterfaceProtocol)
+    if ( (HID_PROTOCOL_KEYBOARD == p_interface_desc->bInterfaceProtocol) && !keyboardh_data[dev_addr-1].ep_in )
     {
-      TU_ASSERT( hidh_interface_open(dev_addr, p_interface_desc->bInterfaceNumber, p_endpoint_desc, &keyboardh_data[dev_addr-1]) );
-      tuh_hid_keyboard_mounted_cb(dev_addr);
-    } else
+      TU_ASSERT( hidh_interface_open(rhport, dev_addr, p_interface_desc->bInterfaceNumber, p_endpoint_desc, &keyboardh_data[dev_addr-1]) );
+      opened = true;
+    }
     #endif
 
     #if CFG_TUH_HID_MOUSE
-    if ( HID_PROTOCOL_MOUSE == p_interface_desc->bInterfaceProtocol)
+    if ( (HID_PROTOCOL_MOUSE == p_interface_desc->bInterfaceProtocol) && !mouseh_data[dev_addr-1].ep_in )
     {
-      TU_ASSERT ( hidh_interface_open(dev_addr, p_interface_desc->bInterfaceNumber, p_endpoint_desc, &mouseh_data[dev_addr-1]) );
-      tuh_hid_mouse_mounted_cb(dev_addr);
-    } else
+      TU_ASSERT ( hidh_interface_open(rhport, dev_addr, p_interface_desc->bInterfaceNumber, p_endpoint_desc, &mouseh_data[dev_addr-1]) );
+      opened = true;
+    }
     #endif
+  }
 
-    {
-      // Not supported protocol
-      return false;
-    }
-  }else
+  #if CFG_TUSB_HOST_HID_GENERIC
+  // any other interface is handled by report descriptor
+  if ( !opened ) opened = hidh_generic_open(rhport, dev_addr, p_interface_desc, p_desc_hid, p_endpoint_desc);
+  #endif
+
+  // Not supported subclass or protocol
+  return opened;
+}
+
+// Boot interface is mounted, generic one fetches its report descriptor first
+static void hidh_set_idle_complete(uint8_t dev_addr, tusb_control_request_t const * request, xfer_result_t result)
+{
+  // STALL is a valid response of SET IDLE from device not supporting it
+  (void) result;
+  uint8_t const itf_num = (uint8_t) request->wIndex;
+
+  #if CFG_TUH_HID_KEYBOARD
+  if ( keyboardh_data[dev_addr-1].ep_in && (keyboardh_data[dev_addr-1].interface_number == itf_num) )
   {
-    // Not supported subclass
-    return false;
+    tuh_hid_keyboard_mounted_cb(dev_addr);
+    usbh_driver_set_config_complete(dev_addr, itf_num);
+    return;
   }
+  #endif
 
-  *p_length = sizeof(tusb_desc_interface_t) + sizeof(tusb_hid_descriptor_hid_t) + sizeof(tusb_desc_endpoint_t);
+  #if CFG_TUH_HID_MOUSE
+  if ( mouseh_data[dev_addr-1].ep_in && (mouseh_data[dev_addr-1].interface_number == itf_num) )
+  {
+    tuh_hid_mouse_mounted_cb(dev_addr);
+    usbh_driver_set_config_complete(dev_addr, itf_num);
+    return;
+  }
+  #endif
 
-  return true;
+  #if CFG_TUSB_HOST_HID_GENERIC
+  if ( hidh_generic_set_config(dev_addr, itf_num) ) return;
+  #endif
+
+  usbh_driver_set_config_complete(dev_addr, itf_num);
 }
 
-void hidh_isr(pipe_handle_t pipe_hdl, xfer_result_t event, uint32_t xferred_bytes)
+bool hidh_set_config(uint8_t dev_addr, uint8_t itf_num)
 {
-  (void) xferred_bytes; // TODO may need to use this para later
+  //------------- SET IDLE (0) request -------------//
+  tusb_control_request_t const request = {
+        .bmRequestType_bit = { .recipient = TUSB_REQ_RCPT_INTERFACE, .type = TUSB_REQ_TYPE_CLASS, .direction = TUSB_DIR_OUT },
+        .bRequest = HID_REQ_CONTROL_SET_IDLE,
+        .wValue = 0, // idle_rate = 0
+        .wIndex = itf_num,
+        .wLength = 0
+  };
+
+  return tuh_control_xfer(dev_addr, &request, NULL, hidh_set_idle_complete);
+}
+
+void hidh_xfer_cb(uint8_t dev_addr, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes)
+{
+  (void) xferred_bytes; // only used by generic interface
 
 #if CFG_TUH_HID_KEYBOARD
-  if ( pipehandle_is_equal(pipe_hdl, keyboardh_data[pipe_hdl.dev_addr-1].pipe_hdl) )
+  if ( ep_addr == keyboardh_data[dev_addr-1].ep_in )
   {
-    tuh_hid_keyboard_isr(pipe_hdl.dev_addr, event);
+    tuh_hid_keyboard_isr(dev_addr, event);
     return;
   }
 #endif
 
 #if CFG_TUH_HID_MOUSE
-  if ( pipehandle_is_equal(pipe_hdl, mouseh_data[pipe_hdl.dev_addr-1].pipe_hdl) )
+  if ( ep_addr == mouseh_data[dev_addr-1].ep_in )
   {
-    tuh_hid_mouse_isr(pipe_hdl.dev_addr, event);
+    tuh_hid_mouse_isr(dev_addr, event);
     return;
   }
 #endif
 
 #if CFG_TUSB_HOST_HID_GENERIC
-
+  hidh_generic_info_t* p_gen = get_instance(dev_addr, ep_addr);
+  if ( p_gen )
+  {
+    hidh_generic_isr(p_gen, event, xferred_bytes);
+    return;
+  }
 #endif
 }
 
 void hidh_close(uint8_t dev_addr)
 {
 #if CFG_TUH_HID_KEYBOARD
-  if ( pipehandle_is_valid( keyboardh_data[dev_addr-1].pipe_hdl ) )
+  if ( keyboardh_data[dev_addr-1].ep_in )
   {
     hidh_interface_close(&keyboardh_data[dev_addr-1]);
     tuh_hid_keyboard_unmounted_cb(dev_addr);
@@ -272,7 +737,7 @@ void hidh_close(uint8_t dev_addr)
 #endif
 
 #if CFG_TUH_HID_MOUSE
-  if( pipehandle_is_valid( mouseh_data[dev_addr-1].pipe_hdl ) )
+  if ( mouseh_data[dev_addr-1].ep_in )
   {
     hidh_interface_close(&mouseh_data[dev_addr-1]);
     tuh_hid_mouse_unmounted_cb( dev_addr );
@@ -280,7 +745,15 @@ void hidh_close(uint8_t dev_addr)
 #endif
 
 #if CFG_TUSB_HOST_HID_GENERIC
-  hidh_generic_close(dev_addr);
+  for(uint8_t inst=0; inst<CFG_TUH_HID_ITF_MAX; inst++)
+  {
+    hidh_generic_info_t* p_gen = &_hidh_itf[inst];
+    if ( !p_gen->ep_in || (p_gen->dev_addr != dev_addr) ) continue;
+
+    bool const mounted = p_gen->mounted;
+    tu_memclr(p_gen, sizeof(hidh_generic_info_t));
+    if ( mounted && tuh_hid_n_unmounted_cb ) tuh_hid_n_unmounted_cb(inst);
+  }
 #endif
 }
 
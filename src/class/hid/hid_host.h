@@ -38,6 +38,30 @@
  extern "C" {
 #endif
 
+//--------------------------------------------------------------------+
+// Class Driver Configuration
+//--------------------------------------------------------------------+
+
+// Max fields compiled from report descriptor of a generic HID device
+#ifndef CFG_TUH_HID_GENERIC_FIELDS
+#define CFG_TUH_HID_GENERIC_FIELDS    32
+#endif
+
+// Largest report descriptor of a generic HID device, only used during enumeration
+#ifndef CFG_TUH_HID_REPORT_DESC_SIZE
+#define CFG_TUH_HID_REPORT_DESC_SIZE  256
+#endif
+
+// Interrupt IN buffer of each generic interface, larger endpoint is not opened
+#ifndef CFG_TUH_HID_EP_BUFSIZE
+#define CFG_TUH_HID_EP_BUFSIZE        64
+#endif
+
+// Reports buffered per generic interface until read by application
+#ifndef CFG_TUH_HID_REPORT_QUEUE
+#define CFG_TUH_HID_REPORT_QUEUE      4
+#endif
+
 //--------------------------------------------------------------------+
 // KEYBOARD Application API
 //--------------------------------------------------------------------+
@@ -173,21 +197,60 @@ void tuh_hid_mouse_unmounted_cb(uint8_t dev_addr);
 //--------------------------------------------------------------------+
 // GENERIC Application API
 //--------------------------------------------------------------------+
-/** \addtogroup ClassDriver_HID_Generic Generic (not supported yet)
+/** \addtogroup ClassDriver_HID_Generic Generic
  *  @{ */
 
 /** \defgroup Generic_Host Host
- *  The interface API includes status checking function, data transferring function and callback functions
+ *  Any HID interface not claimed by boot Keyboard or Mouse, up to CFG_TUH_HID_ITF_MAX across all
+ *  devices (e.g behind a hub). Each interface is identified by its instance: its report descriptor is
+ *  compiled into a table of Input fields at mount, then its interrupt endpoint is polled continuously
+ *  and reports are queued until read with \ref tuh_hid_n_read and decoded with \ref tuh_hid_field_value
  *  @{ */
 
-bool          tuh_hid_generic_is_mounted(uint8_t dev_addr);
-tusb_error_t  tuh_hid_generic_get_report(uint8_t dev_addr, void* p_report, bool int_on_complete);
-tusb_error_t  tuh_hid_generic_set_report(uint8_t dev_addr, void* p_report, bool int_on_complete);
-tusb_interface_status_t tuh_hid_generic_get_status(uint8_t dev_addr);
-tusb_interface_status_t tuh_hid_generic_set_status(uint8_t dev_addr);
+/// Input field compiled from report descriptor. Variable item gets a field per element,
+/// Array item a single field of count indexes (e.g keycodes).
+typedef struct
+{
+  uint16_t usage_page;
+  uint16_t usage;       ///< usage of element, first usage of an Array
+  uint16_t bit_offset;  ///< from start of report, including Report ID byte if any
+  uint8_t  bit_size;
+  uint8_t  count;       ///< 1 for Variable, Report Count for Array
+  uint8_t  report_id;   ///< 0 if device does not use Report ID
+  uint8_t  flags;       ///< Input item data e.g HID_VARIABLE, HID_RELATIVE
+  int32_t  logical_min;
+  int32_t  logical_max;
+} tuh_hid_field_t;
 
-//------------- Application Callback -------------//
-void tuh_hid_generic_isr(uint8_t dev_addr, xfer_result_t event);
+// Check if instance is in use by a configured device
+bool     tuh_hid_n_mounted(uint8_t inst);
+
+// Device address and interface number of instance
+uint8_t  tuh_hid_n_dev_addr(uint8_t inst);
+uint8_t  tuh_hid_n_itf_num(uint8_t inst);
+
+// Number of reports queued
+uint8_t  tuh_hid_n_available(uint8_t inst);
+
+// Read oldest queued report, return its length or 0 if none
+uint16_t tuh_hid_n_read(uint8_t inst, void* buffer, uint16_t bufsize);
+
+// Field table of instance, valid while mounted
+tuh_hid_field_t const* tuh_hid_n_fields(uint8_t inst, uint8_t* count);
+
+// First field with usage, NULL if not found. Intended to be looked up once in mounted callback
+tuh_hid_field_t const* tuh_hid_n_find_field(uint8_t inst, uint16_t usage_page, uint16_t usage);
+
+// Value of element idx (0 for Variable field) in report, sign-extended if logical minimum is negative.
+// Caller checks report[0] against field's report_id when device uses Report ID.
+int32_t  tuh_hid_field_value(tuh_hid_field_t const* field, uint8_t const* report, uint8_t idx);
+
+//------------- Application Callback (Weak is optional) -------------//
+TU_ATTR_WEAK void tuh_hid_n_mounted_cb(uint8_t inst);
+TU_ATTR_WEAK void tuh_hid_n_unmounted_cb(uint8_t inst);
+
+// Invoked from tuh_task() once a report is queued (or transfer failed), polling continues unless stalled
+TU_ATTR_WEAK void tuh_hid_n_isr(uint8_t inst, xfer_result_t event);
 
 /** @} */ // Generic_Host
 /** @} */ // ClassDriver_HID_Generic
@@ -196,14 +259,15 @@ void tuh_hid_generic_isr(uint8_t dev_addr, xfer_result_t event);
 // Internal Class Driver API
 //--------------------------------------------------------------------+
 typedef struct {
-  pipe_handle_t pipe_hdl;
+  uint8_t ep_in;
   uint16_t report_size;
   uint8_t interface_number;
 }hidh_interface_info_t;
 
 void hidh_init(void);
-bool hidh_open_subtask(uint8_t dev_addr, tusb_desc_interface_t const *p_interface_desc, uint16_t *p_length);
-void hidh_isr(pipe_handle_t pipe_hdl, xfer_result_t event, uint32_t xferred_bytes);
+bool hidh_open_subtask(uint8_t rhport, uint8_t dev_addr, tusb_desc_interface_t const *p_interface_desc, uint16_t *p_length);
+bool hidh_set_config(uint8_t dev_addr, uint8_t itf_num);
+void hidh_xfer_cb(uint8_t dev_addr, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes);
 void hidh_close(uint8_t dev_addr);
 
 #ifdef __cplusplus
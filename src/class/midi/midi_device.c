@@ -38,21 +38,37 @@
 //--------------------------------------------------------------------+
 // MACRO CONSTANT TYPEDEF
 //--------------------------------------------------------------------+
+#if CFG_TUD_MIDI_SCHED_QUEUE
 typedef struct
 {
+  uint16_t frame;
+  uint8_t  packet[4];
+} midid_sched_t;
+#endif
+
+typedef struct
+{
+  uint8_t rhport;
   uint8_t itf_num;
   uint8_t ep_in;
   uint8_t ep_out;
 
+#if CFG_TUD_MIDI_SCHED_QUEUE
+  // Packets waiting for their frame, sorted by frame. SOF is requested while not empty
+  midid_sched_t sched[CFG_TUD_MIDI_SCHED_QUEUE];
+  uint8_t sched_count;
+  bool    sched_sof;
+#endif
+
   /*------------- From this point, data is not cleared by bus reset -------------*/
-  // FIFO
-  tu_fifo_t rx_ff;
+  // FIFO, one rx_ff per cable. Its items are whole event packets with CFG_TUD_MIDI_RX_PACKET
+  tu_fifo_t rx_ff[CFG_TUD_MIDI_CABLES];
   tu_fifo_t tx_ff;
-  uint8_t rx_ff_buf[CFG_TUD_MIDI_RX_BUFSIZE];
+  uint8_t rx_ff_buf[CFG_TUD_MIDI_CABLES][CFG_TUD_MIDI_RX_BUFSIZE];
   uint8_t tx_ff_buf[CFG_TUD_MIDI_TX_BUFSIZE];
 
   #if CFG_FIFO_MUTEX
-  osal_mutex_def_t rx_ff_mutex;
+  osal_mutex_def_t rx_ff_mutex[CFG_TUD_MIDI_CABLES];
   osal_mutex_def_t tx_ff_mutex;
   #endif
 
@@ -70,6 +86,22 @@ typedef struct
 
 #define ITF_MEM_RESET_SIZE   offsetof(midid_interface_t, rx_ff)
 
+TU_VERIFY_STATIC( CFG_TUD_MIDI_CABLES >= 1 && CFG_TUD_MIDI_CABLES <= 16, "CFG_TUD_MIDI_CABLES must be 1 to 16");
+
+#if CFG_TUD_MIDI_RX_PACKET
+TU_VERIFY_STATIC( (CFG_TUD_MIDI_RX_BUFSIZE % 4) == 0, "CFG_TUD_MIDI_RX_BUFSIZE must be multiple of 4");
+#define MIDI_RX_ITEM_SIZE    4
+#else
+#define MIDI_RX_ITEM_SIZE    1
+#endif
+
+// Number of MIDI bytes in an event packet, indexed by Code Index Number (CIN). Reserved CIN 0 and 1
+// are passed as 3 bytes. Channel voice CIN equals status high nibble, also used by write fast path.
+static uint8_t const _midi_cin_len[16] =
+{
+  3, 3, 2, 3, 3, 1, 2, 3, 3, 3, 3, 3, 2, 2, 3, 1
+};
+
 //--------------------------------------------------------------------+
 // INTERNAL OBJECT & FUNCTION DECLARATION
 //--------------------------------------------------------------------+
@@ -84,44 +116,126 @@ bool tud_midi_n_mounted (uint8_t itf)
 //--------------------------------------------------------------------+
 // READ API
 //--------------------------------------------------------------------+
-uint32_t tud_midi_n_available(uint8_t itf, uint8_t jack_id)
+// RX FIFO of a cable, NULL if cable has none
+static tu_fifo_t* rx_fifo(uint8_t itf, uint8_t jack_id)
 {
+#if CFG_TUD_MIDI_CABLES == 1
   (void) jack_id;
-  return tu_fifo_count(&_midid_itf[itf].rx_ff);
+  return &_midid_itf[itf].rx_ff[0];
+#else
+  return (jack_id < CFG_TUD_MIDI_CABLES) ? &_midid_itf[itf].rx_ff[jack_id] : NULL;
+#endif
+}
+
+uint32_t tud_midi_n_available(uint8_t itf, uint8_t jack_id)
+{
+  tu_fifo_t* ff = rx_fifo(itf, jack_id);
+  TU_VERIFY(ff, 0);
+
+  return MIDI_RX_ITEM_SIZE*tu_fifo_count(ff);
 }
 
 uint32_t tud_midi_n_read(uint8_t itf, uint8_t jack_id, void* buffer, uint32_t bufsize)
 {
-  (void) jack_id;
-  return tu_fifo_read_n(&_midid_itf[itf].rx_ff, buffer, bufsize);
+  tu_fifo_t* ff = rx_fifo(itf, jack_id);
+  TU_VERIFY(ff, 0);
+
+  tu_fifo_idx_t const count = (tu_fifo_idx_t) tu_min32(bufsize/MIDI_RX_ITEM_SIZE, TU_FIFO_COUNT_MAX);
+  return MIDI_RX_ITEM_SIZE*tu_fifo_read_n(ff, buffer, count);
+}
+
+#if CFG_TUD_MIDI_RX_PACKET
+bool tud_midi_n_packet_read(uint8_t itf, uint8_t packet[4])
+{
+  for(uint8_t cable=0; cable<CFG_TUD_MIDI_CABLES; cable++)
+  {
+    if ( tu_fifo_read(&_midid_itf[itf].rx_ff[cable], packet) ) return true;
+  }
+
+  return false;
 }
+#endif
 
 void tud_midi_n_read_flush (uint8_t itf, uint8_t jack_id)
 {
-  (void) jack_id;
-  tu_fifo_clear(&_midid_itf[itf].rx_ff);
+  tu_fifo_t* ff = rx_fifo(itf, jack_id);
+  if (ff) tu_fifo_clear(ff);
 }
 
-void midi_rx_done_cb(midid_interface_t* midi, uint8_t const* buffer, uint32_t bufsize) {
-  if (bufsize % 4 != 0) {
+// SysEx start/continue (CIN 4), end with 1, 2 or 3 bytes (CIN 5 with F7, 6, 7)
+static inline bool is_sysex_packet(uint8_t const packet[4])
+{
+  uint8_t const cin = packet[0] & 0x0f;
+  return (cin == 0x4) || (cin == 0x6) || (cin == 0x7) || (cin == 0x5 && packet[1] == 0xf7);
+}
+
+// Hand over a run of consecutive data of the same cable and kind
+static void rx_run_flush(midid_interface_t* midi, uint8_t cable, bool sysex, uint8_t const* data, uint32_t count)
+{
+#if CFG_TUD_MIDI_SYSEX_STREAM
+  if (sysex)
+  {
+    tud_midi_sysex_cb((uint8_t) (midi - _midid_itf), cable, data, count);
     return;
   }
+#else
+  (void) sysex;
+#endif
 
-  for(uint32_t i=0; i<bufsize; i += 4) {
-    uint8_t header = buffer[i];
-    // uint8_t cable_number = (header & 0xf0) >> 4;
-    uint8_t code_index = header & 0x0f;
-    // We always copy over the first byte.
-    uint8_t count = 1;
-    // Ignore subsequent bytes based on the code.
-    if (code_index != 0x5 && code_index != 0xf) {
-      count = 2;
-      if (code_index != 0x2 && code_index != 0x6 && code_index != 0xc && code_index != 0xd) {
-        count = 3;
-      }
+  tu_fifo_write_n(&midi->rx_ff[cable], data, (tu_fifo_idx_t) (count/MIDI_RX_ITEM_SIZE));
+}
+
+// Compact received data in place into runs of the same cable and kind (stream or SysEx): MIDI
+// bytes, or whole packets with CFG_TUD_MIDI_RX_PACKET (SysEx is always bytes). Each run is then
+// queued at once. Compacted data never overtakes the packet being read since it starts at or
+// before the packet and is not longer.
+static void midi_rx_done_cb(midid_interface_t* midi, uint8_t* buffer, uint32_t bufsize)
+{
+  if (bufsize % 4 != 0) return;
+
+  uint32_t count     = 0;
+  uint8_t  run_cable = 0;
+  bool     run_sysex = false;
+
+  for(uint32_t i=0; i<bufsize; i += 4)
+  {
+    uint8_t const* packet = &buffer[i];
+
+#if CFG_TUD_MIDI_CABLES == 1
+    uint8_t const cable = 0;
+#else
+    uint8_t const cable = packet[0] >> 4;
+    if ( cable >= CFG_TUD_MIDI_CABLES ) continue;
+#endif
+
+#if CFG_TUD_MIDI_SYSEX_STREAM
+    bool const sysex = tud_midi_sysex_cb && is_sysex_packet(packet);
+#else
+    bool const sysex = false;
+#endif
+
+    if ( count && (cable != run_cable || sysex != run_sysex) )
+    {
+      rx_run_flush(midi, run_cable, run_sysex, buffer, count);
+      count = 0;
+    }
+    run_cable = cable;
+    run_sysex = sysex;
+
+    if ( CFG_TUD_MIDI_RX_PACKET && !sysex )
+    {
+      for(uint8_t k=0; k<4; k++) buffer[count+k] = packet[k];
+      count += 4;
+    }else
+    {
+      // header may be overwritten by the copy
+      uint8_t const len = _midi_cin_len[packet[0] & 0x0f];
+      for(uint8_t k=0; k<3; k++) buffer[count+k] = packet[1+k];
+      count += len;
     }
-    tu_fifo_write_n(&midi->rx_ff, &buffer[i + 1], count);
   }
+
+  if ( count ) rx_run_flush(midi, run_cable, run_sysex, buffer, count);
 }
 
 
@@ -134,16 +248,85 @@ static bool maybe_transmit(midid_interface_t* midi, uint8_t itf_index)
   (void) itf_index;
 
   // skip if previous transfer not complete
-  TU_VERIFY( !usbd_edpt_busy(TUD_OPT_RHPORT, midi->ep_in) );
+  TU_VERIFY( !usbd_edpt_busy(midi->rhport, midi->ep_in) );
 
   uint16_t count = tu_fifo_read_n(&midi->tx_ff, midi->epin_buf, CFG_TUD_MIDI_EPSIZE);
   if (count > 0)
   {
-    TU_ASSERT( usbd_edpt_xfer(TUD_OPT_RHPORT, midi->ep_in, midi->epin_buf, count) );
+    TU_ASSERT( usbd_edpt_xfer(midi->rhport, midi->ep_in, midi->epin_buf, count) );
   }
   return true;
 }
 
+// Fast path: pack leading complete channel voice and real-time messages into event packets and
+// queue them by batch. Stop at anything else (SysEx, system common, running status, incomplete
+// message) which is left to the byte state machine. Return number of bytes consumed.
+static uint32_t write_complete_messages(midid_interface_t* midi, uint8_t jack_id, uint8_t const* buffer, uint32_t bufsize, bool* full)
+{
+  uint8_t  packets[CFG_TUD_MIDI_EPSIZE];
+  uint8_t  msg_len[CFG_TUD_MIDI_EPSIZE/4];
+  uint32_t consumed = 0;
+
+  *full = false;
+
+  while ( consumed < bufsize )
+  {
+    uint8_t  count = 0;
+    uint32_t pos   = consumed;
+
+    while ( (count < CFG_TUD_MIDI_EPSIZE/4) && (pos < bufsize) )
+    {
+      uint8_t const status = buffer[pos];
+      uint8_t const msg    = status >> 4;
+      uint8_t* packet      = &packets[4*count];
+      uint8_t len;
+
+      if ( (msg >= 0x8) && (msg <= 0xE) )
+      {
+        len = (uint8_t) (_midi_cin_len[msg] - 1);
+        if ( pos + 1 + len > bufsize ) break;
+
+        packet[0] = (uint8_t) (jack_id << 4 | msg);
+        packet[1] = status;
+        packet[2] = buffer[pos+1];
+        packet[3] = (len == 2) ? buffer[pos+2] : 0;
+      }
+      else if ( status >= 0xf8 )
+      {
+        // same packing as state machine does for single byte system message
+        len = 0;
+
+        packet[0] = 0x5;
+        packet[1] = status;
+        packet[2] = 0;
+        packet[3] = 0;
+      }
+      else
+      {
+        break;
+      }
+
+      msg_len[count++] = (uint8_t) (1 + len);
+      pos += 1 + len;
+    }
+
+    if ( count == 0 ) break;
+
+    uint16_t const written = tu_fifo_write_n(&midi->tx_ff, packets, (tu_fifo_idx_t) (4*count));
+    TU_ASSERT( (written % 4) == 0, consumed );
+
+    for(uint8_t i=0; i < written/4; i++) consumed += msg_len[i];
+
+    if ( written < 4*count )
+    {
+      *full = true;
+      break;
+    }
+  }
+
+  return consumed;
+}
+
 uint32_t tud_midi_n_write(uint8_t itf, uint8_t jack_id, uint8_t const* buffer, uint32_t bufsize)
 {
   midid_interface_t* midi = &_midid_itf[itf];
@@ -153,6 +336,13 @@ uint32_t tud_midi_n_write(uint8_t itf, uint8_t jack_id, uint8_t const* buffer, u
 
   uint32_t i = 0;
   while (i < bufsize) {
+    // no message in progress: try batch packing first
+    if (midi->message_buffer_length == 0 && midi->message_buffer[0] != 0x4) {
+      bool full;
+      i += write_complete_messages(midi, jack_id, buffer + i, bufsize - i, &full);
+      if (full || i == bufsize) break;
+    }
+
     uint8_t data = buffer[i];
     if (midi->message_buffer_length == 0) {
         uint8_t msg = data >> 4;
@@ -218,6 +408,97 @@ uint32_t tud_midi_n_write(uint8_t itf, uint8_t jack_id, uint8_t const* buffer, u
   return i;
 }
 
+bool tud_midi_n_packet_write(uint8_t itf, uint8_t const packet[4])
+{
+  midid_interface_t* midi = &_midid_itf[itf];
+  TU_VERIFY(midi->itf_num);
+
+  // tx_ff is overwritable, never let a packet replace queued ones. Packets are queued whole, so
+  // a partial byte stream message held in message_buffer is not split.
+  TU_VERIFY(tu_fifo_remaining(&midi->tx_ff) >= 4);
+  tu_fifo_write_n(&midi->tx_ff, packet, 4);
+
+  maybe_transmit(midi, itf);
+
+  return true;
+}
+
+#if CFG_TUD_MIDI_SCHED_QUEUE
+// Frame a is not later than frame b, 11-bit frame numbers wrap around
+static inline bool frame_not_after(uint16_t a, uint16_t b)
+{
+  return ((b - a) & 0x7ffu) < 0x400u;
+}
+
+static void sched_sof_request(midid_interface_t* midi, bool en)
+{
+  if ( midi->sched_sof == en ) return;
+  midi->sched_sof = en;
+  usbd_sof_enable(midi->rhport, en);
+}
+
+bool tud_midi_n_packet_write_at(uint8_t itf, uint8_t const packet[4], uint16_t frame)
+{
+  midid_interface_t* midi = &_midid_itf[itf];
+  TU_VERIFY(midi->itf_num && midi->sched_count < CFG_TUD_MIDI_SCHED_QUEUE);
+
+  frame &= 0x7ffu;
+
+  // after all packets scheduled for the same or an earlier frame
+  uint8_t pos = midi->sched_count;
+  while ( pos > 0 && !frame_not_after(midi->sched[pos-1].frame, frame) )
+  {
+    midi->sched[pos] = midi->sched[pos-1];
+    pos--;
+  }
+
+  midi->sched[pos].frame = frame;
+  memcpy(midi->sched[pos].packet, packet, 4);
+  midi->sched_count++;
+
+  sched_sof_request(midi, true);
+
+  return true;
+}
+
+void tud_midi_n_sched_flush(uint8_t itf)
+{
+  midid_interface_t* midi = &_midid_itf[itf];
+  midi->sched_count = 0;
+  if ( midi->itf_num ) sched_sof_request(midi, false);
+}
+
+// Release packets due in current frame to tx_ff. Still due ones are retried on next SOF
+// if tx_ff is full.
+void midid_sof(uint8_t rhport)
+{
+  uint16_t const frame = (uint16_t) (tud_n_frame_number(rhport) & 0x7ffu);
+
+  for(uint8_t itf=0; itf<CFG_TUD_MIDI; itf++)
+  {
+    midid_interface_t* midi = &_midid_itf[itf];
+    if ( !midi->sched_count || midi->rhport != rhport ) continue;
+
+    uint8_t n = 0;
+    while ( n < midi->sched_count && frame_not_after(midi->sched[n].frame, frame) &&
+            tu_fifo_remaining(&midi->tx_ff) >= 4 )
+    {
+      tu_fifo_write_n(&midi->tx_ff, midi->sched[n].packet, 4);
+      n++;
+    }
+
+    if ( n )
+    {
+      midi->sched_count = (uint8_t) (midi->sched_count - n);
+      memmove(midi->sched, &midi->sched[n], midi->sched_count*sizeof(midid_sched_t));
+      maybe_transmit(midi, itf);
+    }
+
+    if ( !midi->sched_count ) sched_sof_request(midi, false);
+  }
+}
+#endif
+
 //--------------------------------------------------------------------+
 // USBD Driver API
 //--------------------------------------------------------------------+
@@ -230,11 +511,18 @@ void midid_init(void)
     midid_interface_t* midi = &_midid_itf[i];
 
     // config fifo
-    tu_fifo_config(&midi->rx_ff, midi->rx_ff_buf, CFG_TUD_MIDI_RX_BUFSIZE, 1, true);
+    for(uint8_t cable=0; cable<CFG_TUD_MIDI_CABLES; cable++)
+    {
+      tu_fifo_config(&midi->rx_ff[cable], midi->rx_ff_buf[cable], CFG_TUD_MIDI_RX_BUFSIZE/MIDI_RX_ITEM_SIZE, MIDI_RX_ITEM_SIZE, true);
+
+      #if CFG_FIFO_MUTEX
+      tu_fifo_config_mutex(&midi->rx_ff[cable], osal_mutex_create(&midi->rx_ff_mutex[cable]));
+      #endif
+    }
+
     tu_fifo_config(&midi->tx_ff, midi->tx_ff_buf, CFG_TUD_MIDI_TX_BUFSIZE, 1, true);
 
     #if CFG_FIFO_MUTEX
-    tu_fifo_config_mutex(&midi->rx_ff, osal_mutex_create(&midi->rx_ff_mutex));
     tu_fifo_config_mutex(&midi->tx_ff, osal_mutex_create(&midi->tx_ff_mutex));
     #endif
   }
@@ -242,19 +530,34 @@ void midid_init(void)
 
 void midid_reset(uint8_t rhport)
 {
-  (void) rhport;
-
   for(uint8_t i=0; i<CFG_TUD_MIDI; i++)
   {
     midid_interface_t* midi = &_midid_itf[i];
+
+    // interface in use by the other roothub port is untouched
+    if ( midi->ep_in && midi->rhport != rhport ) continue;
+
     tu_memclr(midi, ITF_MEM_RESET_SIZE);
-    tu_fifo_clear(&midi->rx_ff);
+    for(uint8_t cable=0; cable<CFG_TUD_MIDI_CABLES; cable++) tu_fifo_clear(&midi->rx_ff[cable]);
     tu_fifo_clear(&midi->tx_ff);
   }
 }
 
-bool midid_open(uint8_t rhport, tusb_desc_interface_t const * p_interface_desc, uint16_t *p_length)
+bool midid_open(uint8_t rhport, tusb_desc_interface_t const * p_interface_desc, uint16_t *p_length, uint8_t *p_inst)
 {
+  // Find available interface, audio control interface belongs to the streaming one following it
+  midid_interface_t * p_midi = NULL;
+  for(uint8_t i=0; i<CFG_TUD_MIDI; i++)
+  {
+    if ( _midid_itf[i].ep_in == 0 && _midid_itf[i].ep_out == 0 )
+    {
+      p_midi = &_midid_itf[i];
+      (*p_inst) = i;
+      break;
+    }
+  }
+  TU_VERIFY(p_midi);
+
   // For now handle the audio control interface as well.
   if ( AUDIO_SUBCLASS_CONTROL == p_interface_desc->bInterfaceSubClass) {
     uint8_t const * p_desc = tu_desc_next ( (uint8_t const *) p_interface_desc );
@@ -269,17 +572,7 @@ bool midid_open(uint8_t rhport, tusb_desc_interface_t const * p_interface_desc,
   TU_VERIFY(AUDIO_SUBCLASS_MIDI_STREAMING == p_interface_desc->bInterfaceSubClass &&
             AUDIO_PROTOCOL_V1 == p_interface_desc->bInterfaceProtocol );
 
-  // Find available interface
-  midid_interface_t * p_midi = NULL;
-  for(uint8_t i=0; i<CFG_TUD_MIDI; i++)
-  {
-    if ( _midid_itf[i].ep_in == 0 && _midid_itf[i].ep_out == 0 )
-    {
-      p_midi = &_midid_itf[i];
-      break;
-    }
-  }
-
+  p_midi->rhport   = rhport;
   p_midi->itf_num  = p_interface_desc->bInterfaceNumber;
 
   uint8_t const * p_desc = tu_desc_next( (uint8_t const *) p_interface_desc );
@@ -333,8 +626,9 @@ bool midid_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32
 {
   (void) result;
 
-  // TODO Support multiple interfaces
-  uint8_t const itf = 0;
+  uint8_t const itf = usbd_edpt_inst(rhport, ep_addr);
+  TU_ASSERT(itf < CFG_TUD_MIDI);
+
   midid_interface_t* p_midi = &_midid_itf[itf];
 
   // receive new data
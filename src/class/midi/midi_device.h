@@ -40,6 +40,29 @@
 #define CFG_TUD_MIDI_EPSIZE 64
 #endif
 
+// Keep received USB-MIDI event packets as is (cable number included) for tud_midi_n_packet_read()
+// instead of unpacking them into a MIDI byte stream. tud_midi_n_read() then returns raw packets.
+#ifndef CFG_TUD_MIDI_RX_PACKET
+#define CFG_TUD_MIDI_RX_PACKET 0
+#endif
+
+// Number of virtual cables with their own RX FIFO of CFG_TUD_MIDI_RX_BUFSIZE, selected by jack_id of
+// the read API. Packets of higher cables are dropped. With 1, all cables share the same FIFO.
+#ifndef CFG_TUD_MIDI_CABLES
+#define CFG_TUD_MIDI_CABLES 1
+#endif
+
+// Deliver SysEx bytes through tud_midi_sysex_cb() as they arrive instead of queuing them in RX FIFO
+#ifndef CFG_TUD_MIDI_SYSEX_STREAM
+#define CFG_TUD_MIDI_SYSEX_STREAM 0
+#endif
+
+// Number of event packets per interface that can be scheduled for a USB frame with
+// tud_midi_n_packet_write_at(), 0 to disable
+#ifndef CFG_TUD_MIDI_SCHED_QUEUE
+#define CFG_TUD_MIDI_SCHED_QUEUE 0
+#endif
+
 #ifdef __cplusplus
  extern "C" {
 #endif
@@ -59,6 +82,25 @@ uint32_t tud_midi_n_read       (uint8_t itf, uint8_t jack_id, void* buffer, uint
 void     tud_midi_n_read_flush (uint8_t itf, uint8_t jack_id);
 uint32_t tud_midi_n_write      (uint8_t itf, uint8_t jack_id, uint8_t const* buffer, uint32_t bufsize);
 
+// Send a 4-byte USB-MIDI event packet as is, return false if there is no room for it
+bool     tud_midi_n_packet_write(uint8_t itf, uint8_t const packet[4]);
+
+#if CFG_TUD_MIDI_RX_PACKET
+// Read a 4-byte USB-MIDI event packet as received, return false if none available.
+// With several cables, packet is taken from the lowest cable having one.
+bool     tud_midi_n_packet_read (uint8_t itf, uint8_t packet[4]);
+#endif
+
+#if CFG_TUD_MIDI_SCHED_QUEUE
+// Queue a 4-byte USB-MIDI event packet to be sent on SOF of 11-bit frame (see tud_frame_number()),
+// up to 1023 frames ahead. A frame already passed is sent on next SOF. Packets of the same frame
+// keep their order. Return false if schedule is full. Must be called in the same context as tud_task()
+bool     tud_midi_n_packet_write_at(uint8_t itf, uint8_t const packet[4], uint16_t frame);
+
+// Drop scheduled packets not yet sent e.g when sequencer stops
+void     tud_midi_n_sched_flush (uint8_t itf);
+#endif
+
 static inline
 uint32_t tud_midi_n_write24    (uint8_t itf, uint8_t jack_id, uint8_t b1, uint8_t b2, uint8_t b3);
 
@@ -71,12 +113,27 @@ static inline uint32_t tud_midi_read       (void* buffer, uint32_t bufsize);
 static inline void     tud_midi_read_flush (void);
 static inline uint32_t tud_midi_write      (uint8_t jack_id, uint8_t const* buffer, uint32_t bufsize);
 static inline uint32_t tudi_midi_write24   (uint8_t jack_id, uint8_t b1, uint8_t b2, uint8_t b3);
+static inline bool     tud_midi_packet_write(uint8_t const packet[4]);
+
+#if CFG_TUD_MIDI_RX_PACKET
+static inline bool     tud_midi_packet_read (uint8_t packet[4]);
+#endif
+
+#if CFG_TUD_MIDI_SCHED_QUEUE
+static inline bool     tud_midi_packet_write_at(uint8_t const packet[4], uint16_t frame);
+#endif
 
 //--------------------------------------------------------------------+
 // Application Callback API (weak is optional)
 //--------------------------------------------------------------------+
 TU_ATTR_WEAK void tud_midi_rx_cb(uint8_t itf);
 
+#if CFG_TUD_MIDI_SYSEX_STREAM
+// Invoked with a chunk of SysEx bytes of a cable, F0 and F7 included when chunk starts/ends a message.
+// Called in USB task context for each run of SysEx packets in a received transfer.
+TU_ATTR_WEAK void tud_midi_sysex_cb(uint8_t itf, uint8_t jack_id, uint8_t const* buffer, uint32_t bufsize);
+#endif
+
 //--------------------------------------------------------------------+
 // Inline Functions
 //--------------------------------------------------------------------+
@@ -118,15 +175,35 @@ static inline uint32_t tudi_midi_write24 (uint8_t jack_id, uint8_t b1, uint8_t b
   return tud_midi_write(jack_id, msg, 3);
 }
 
+static inline bool tud_midi_packet_write (uint8_t const packet[4])
+{
+  return tud_midi_n_packet_write(0, packet);
+}
+
+#if CFG_TUD_MIDI_RX_PACKET
+static inline bool tud_midi_packet_read (uint8_t packet[4])
+{
+  return tud_midi_n_packet_read(0, packet);
+}
+#endif
+
+#if CFG_TUD_MIDI_SCHED_QUEUE
+static inline bool tud_midi_packet_write_at (uint8_t const packet[4], uint16_t frame)
+{
+  return tud_midi_n_packet_write_at(0, packet, frame);
+}
+#endif
+
 //--------------------------------------------------------------------+
 // Internal Class Driver API
 //--------------------------------------------------------------------+
 void midid_init             (void);
 void midid_reset            (uint8_t rhport);
-bool midid_open             (uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t *p_length);
+bool midid_open             (uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t *p_length, uint8_t *p_inst);
 bool midid_control_request  (uint8_t rhport, tusb_control_request_t const * request);
 bool midid_control_complete (uint8_t rhport, tusb_control_request_t const * request);
 bool midid_xfer_cb          (uint8_t rhport, uint8_t edpt_addr, xfer_result_t result, uint32_t xferred_bytes);
+void midid_sof              (uint8_t rhport);
 
 #ifdef __cplusplus
  }
@@ -0,0 +1,414 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#include "tusb_option.h"
+
+#if (TUSB_OPT_HOST_ENABLED && CFG_TUH_MIDI)
+
+//--------------------------------------------------------------------+
+// INCLUDE
+//--------------------------------------------------------------------+
+#include "common/tusb_common.h"
+#include "host/usbh_hcd.h"
+#include "class/audio/audio.h"
+#include "midi_host.h"
+
+//--------------------------------------------------------------------+
+// MACRO CONSTANT TYPEDEF
+//--------------------------------------------------------------------+
+
+enum
+{
+  MIDIH_PACKET_SIZE = 4,
+  MIDIH_EP_PACKETS  = CFG_TUH_MIDI_EP_BUFSIZE / MIDIH_PACKET_SIZE, // event packets per transfer
+};
+
+typedef struct
+{
+  uint8_t rhport;
+  uint8_t dev_addr;
+  uint8_t itf_num;
+
+  uint8_t ep_in;
+  uint8_t ep_out;
+
+  bool    mounted;
+
+  // receive buffers are armed and completed in ring order, head is the oldest armed one
+  uint8_t rx_head;
+  uint8_t rx_armed;
+  bool    rx_halted;  // pipe failed, buffers are not armed again
+
+  bool    tx_busy;
+  bool    tx_halted;
+
+  /*------------- From this point, data is not cleared by close -------------*/
+  // FIFO of event packets, one rx_ff per cable
+  tu_fifo_t rx_ff[CFG_TUH_MIDI_CABLES];
+  tu_fifo_t tx_ff;
+
+  uint8_t rx_ff_buf[CFG_TUH_MIDI_CABLES][CFG_TUH_MIDI_RX_BUFSIZE];
+  uint8_t tx_ff_buf[CFG_TUH_MIDI_TX_BUFSIZE];
+}midih_interface_t;
+
+#define ITF_MEM_RESET_SIZE   offsetof(midih_interface_t, rx_ff)
+
+TU_VERIFY_STATIC( CFG_TUH_MIDI_CABLES >= 1 && CFG_TUH_MIDI_CABLES <= 16, "CFG_TUH_MIDI_CABLES must be 1 to 16");
+TU_VERIFY_STATIC( CFG_TUH_MIDI_RX_BUFS >= 1 && CFG_TUH_MIDI_RX_BUFS <= 8, "CFG_TUH_MIDI_RX_BUFS must be 1 to 8");
+TU_VERIFY_STATIC( (CFG_TUH_MIDI_EP_BUFSIZE % 64) == 0, "CFG_TUH_MIDI_EP_BUFSIZE must be multiple of 64");
+TU_VERIFY_STATIC( (CFG_TUH_MIDI_RX_BUFSIZE % 4) == 0 && CFG_TUH_MIDI_RX_BUFSIZE >= CFG_TUH_MIDI_EP_BUFSIZE,
+                  "CFG_TUH_MIDI_RX_BUFSIZE must be multiple of 4 and hold a transfer");
+TU_VERIFY_STATIC( (CFG_TUH_MIDI_TX_BUFSIZE % 4) == 0, "CFG_TUH_MIDI_TX_BUFSIZE must be multiple of 4");
+
+//--------------------------------------------------------------------+
+// INTERNAL OBJECT & FUNCTION DECLARATION
+//--------------------------------------------------------------------+
+static midih_interface_t _midih_itf[CFG_TUH_MIDI];
+
+CFG_TUSB_MEM_SECTION TU_ATTR_ALIGNED(4) static uint8_t _midih_rx_buf[CFG_TUH_MIDI][CFG_TUH_MIDI_RX_BUFS][CFG_TUH_MIDI_EP_BUFSIZE];
+CFG_TUSB_MEM_SECTION TU_ATTR_ALIGNED(4) static uint8_t _midih_tx_buf[CFG_TUH_MIDI][CFG_TUH_MIDI_EP_BUFSIZE];
+
+static inline uint8_t get_inst(midih_interface_t const* p_midi)
+{
+  return (uint8_t) (p_midi - _midih_itf);
+}
+
+static inline midih_interface_t* get_instance(uint8_t dev_addr, uint8_t ep_addr)
+{
+  for(uint8_t i=0; i<CFG_TUH_MIDI; i++)
+  {
+    midih_interface_t* p_midi = &_midih_itf[i];
+    if ( p_midi->dev_addr == dev_addr && ep_addr && (ep_addr == p_midi->ep_in || ep_addr == p_midi->ep_out) ) return p_midi;
+  }
+
+  return NULL;
+}
+
+// RX FIFO of a cable, NULL if cable has none
+static inline tu_fifo_t* get_rx_ff(midih_interface_t* p_midi, uint8_t cable)
+{
+#if CFG_TUH_MIDI_CABLES == 1
+  (void) cable;
+  return &p_midi->rx_ff[0];
+#else
+  return (cable < CFG_TUH_MIDI_CABLES) ? &p_midi->rx_ff[cable] : NULL;
+#endif
+}
+
+static bool pipe_xfer(midih_interface_t* p_midi, uint8_t ep_addr, uint8_t* buffer, uint16_t total_bytes)
+{
+  // HCD appends the transfer behind pending ones, completion isr must not modify the list meanwhile
+  hcd_int_disable(p_midi->rhport);
+  bool const ret = hcd_pipe_xfer(p_midi->dev_addr, ep_addr, buffer, total_bytes, true);
+  hcd_int_enable(p_midi->rhport);
+
+  return ret;
+}
+
+//--------------------------------------------------------------------+
+// RECEIVE
+//--------------------------------------------------------------------+
+
+// Arm free buffers as long as every cable FIFO can take all packets of the armed ones,
+// otherwise device is NAKed until application reads
+static void rx_arm(midih_interface_t* p_midi)
+{
+  while ( p_midi->mounted && p_midi->ep_in && !p_midi->rx_halted && (p_midi->rx_armed < CFG_TUH_MIDI_RX_BUFS) )
+  {
+    uint32_t const need = (uint32_t) (p_midi->rx_armed + 1) * MIDIH_EP_PACKETS;
+    for(uint8_t cable=0; cable<CFG_TUH_MIDI_CABLES; cable++)
+    {
+      if ( tu_fifo_remaining(&p_midi->rx_ff[cable]) < need ) return;
+    }
+
+    uint8_t const idx = (uint8_t) ((p_midi->rx_head + p_midi->rx_armed) % CFG_TUH_MIDI_RX_BUFS);
+    TU_VERIFY( pipe_xfer(p_midi, p_midi->ep_in, _midih_rx_buf[get_inst(p_midi)][idx], CFG_TUH_MIDI_EP_BUFSIZE), );
+    p_midi->rx_armed++;
+  }
+}
+
+// Sort event packets of the completed head buffer into cable FIFOs, its buffer is armed again right away
+static void rx_complete(midih_interface_t* p_midi, xfer_result_t event, uint32_t xferred_bytes)
+{
+  TU_VERIFY(p_midi->rx_armed, );
+
+  uint8_t const inst = get_inst(p_midi);
+  uint8_t const idx  = p_midi->rx_head;
+
+  p_midi->rx_head = (uint8_t) ((idx + 1) % CFG_TUH_MIDI_RX_BUFS);
+  p_midi->rx_armed--;
+
+  if ( XFER_RESULT_SUCCESS != event )
+  {
+    p_midi->rx_halted = true;
+    return;
+  }
+
+  bool received = false;
+  uint8_t const* buf = _midih_rx_buf[inst][idx];
+
+  for(uint32_t pos = 0; pos + MIDIH_PACKET_SIZE <= xferred_bytes; pos += MIDIH_PACKET_SIZE)
+  {
+    uint8_t const* packet = buf + pos;
+
+    // some devices pad the transfer with zeroed packets
+    if ( 0 == (packet[0] | packet[1] | packet[2] | packet[3]) ) continue;
+
+    tu_fifo_t* ff = get_rx_ff(p_midi, packet[0] >> 4);
+    if ( !ff ) continue;
+
+    tu_fifo_write(ff, packet);
+    received = true;
+  }
+
+  rx_arm(p_midi);
+
+  if ( received && tuh_midi_rx_cb ) tuh_midi_rx_cb(inst);
+}
+
+//--------------------------------------------------------------------+
+// TRANSMIT
+//--------------------------------------------------------------------+
+
+// Send everything queued so far in one transfer
+static void tx_flush(midih_interface_t* p_midi)
+{
+  if ( p_midi->tx_busy || p_midi->tx_halted ) return;
+
+  uint8_t* buf = _midih_tx_buf[get_inst(p_midi)];
+  uint16_t const count = tu_fifo_read_n(&p_midi->tx_ff, buf, MIDIH_EP_PACKETS);
+  if ( 0 == count ) return;
+
+  p_midi->tx_busy = true;
+  if ( !pipe_xfer(p_midi, p_midi->ep_out, buf, (uint16_t) (count*MIDIH_PACKET_SIZE)) ) p_midi->tx_busy = false;
+}
+
+static void tx_complete(midih_interface_t* p_midi, xfer_result_t event)
+{
+  p_midi->tx_busy = false;
+
+  if ( XFER_RESULT_SUCCESS != event )
+  {
+    p_midi->tx_halted = true;
+    tu_fifo_clear(&p_midi->tx_ff);
+    return;
+  }
+
+  tx_flush(p_midi);
+}
+
+//--------------------------------------------------------------------+
+// APPLICATION API
+//--------------------------------------------------------------------+
+bool tuh_midi_n_mounted(uint8_t inst)
+{
+  TU_VERIFY(inst < CFG_TUH_MIDI);
+  return _midih_itf[inst].mounted && tuh_device_is_configured(_midih_itf[inst].dev_addr);
+}
+
+uint8_t tuh_midi_n_dev_addr(uint8_t inst)
+{
+  return _midih_itf[inst].dev_addr;
+}
+
+uint32_t tuh_midi_n_available(uint8_t inst, uint8_t cable)
+{
+  TU_VERIFY(inst < CFG_TUH_MIDI, 0);
+
+  tu_fifo_t* ff = get_rx_ff(&_midih_itf[inst], cable);
+  return ff ? tu_fifo_count(ff) : 0;
+}
+
+bool tuh_midi_n_cable_packet_read(uint8_t inst, uint8_t cable, uint8_t packet[4])
+{
+  TU_VERIFY(inst < CFG_TUH_MIDI);
+  midih_interface_t* p_midi = &_midih_itf[inst];
+
+  tu_fifo_t* ff = get_rx_ff(p_midi, cable);
+  TU_VERIFY( ff && tu_fifo_read(ff, packet) );
+
+  // room may be enough for another transfer now
+  rx_arm(p_midi);
+
+  return true;
+}
+
+bool tuh_midi_n_packet_read(uint8_t inst, uint8_t packet[4])
+{
+  TU_VERIFY(inst < CFG_TUH_MIDI);
+
+  for(uint8_t cable=0; cable<CFG_TUH_MIDI_CABLES; cable++)
+  {
+    if ( tuh_midi_n_cable_packet_read(inst, cable, packet) ) return true;
+  }
+
+  return false;
+}
+
+bool tuh_midi_n_packet_write(uint8_t inst, uint8_t const packet[4])
+{
+  TU_VERIFY( tuh_midi_n_mounted(inst) );
+  midih_interface_t* p_midi = &_midih_itf[inst];
+  TU_VERIFY( p_midi->ep_out && !p_midi->tx_halted );
+
+  TU_VERIFY( tu_fifo_write(&p_midi->tx_ff, packet) );
+  tx_flush(p_midi);
+
+  return true;
+}
+
+uint32_t tuh_midi_n_write_available(uint8_t inst)
+{
+  TU_VERIFY( tuh_midi_n_mounted(inst), 0 );
+  return tu_fifo_remaining(&_midih_itf[inst].tx_ff);
+}
+
+//--------------------------------------------------------------------+
+// USBH-CLASS API
+//--------------------------------------------------------------------+
+void midih_init(void)
+{
+  tu_memclr(_midih_itf, sizeof(_midih_itf));
+
+  for(uint8_t inst=0; inst<CFG_TUH_MIDI; inst++)
+  {
+    midih_interface_t* p_midi = &_midih_itf[inst];
+
+    for(uint8_t cable=0; cable<CFG_TUH_MIDI_CABLES; cable++)
+    {
+      tu_fifo_config(&p_midi->rx_ff[cable], p_midi->rx_ff_buf[cable], CFG_TUH_MIDI_RX_BUFSIZE/MIDIH_PACKET_SIZE, MIDIH_PACKET_SIZE, false);
+    }
+    tu_fifo_config(&p_midi->tx_ff, p_midi->tx_ff_buf, CFG_TUH_MIDI_TX_BUFSIZE/MIDIH_PACKET_SIZE, MIDIH_PACKET_SIZE, false);
+  }
+}
+
+bool midih_open(uint8_t rhport, uint8_t dev_addr, tusb_desc_interface_t const *itf_desc, uint16_t *p_length)
+{
+  // audio control interface is left unclaimed
+  TU_VERIFY( AUDIO_SUBCLASS_MIDI_STREAMING == itf_desc->bInterfaceSubClass &&
+             AUDIO_PROTOCOL_V1 == itf_desc->bInterfaceProtocol );
+
+  tusb_desc_endpoint_t const* ep_data[2] = { NULL, NULL };
+
+  // class specific jack descriptors and bulk endpoints, each followed by its class specific one
+  uint8_t const* p_desc = tu_desc_next(itf_desc);
+  uint8_t ep_count = 0;
+  while ( ep_count < itf_desc->bNumEndpoints )
+  {
+    TU_VERIFY( TUSB_DESC_INTERFACE != tu_desc_type(p_desc) );
+
+    if ( TUSB_DESC_ENDPOINT == tu_desc_type(p_desc) )
+    {
+      tusb_desc_endpoint_t const* desc_ep = (tusb_desc_endpoint_t const*) p_desc;
+      if ( TUSB_XFER_BULK == desc_ep->bmAttributes.xfer ) ep_data[tu_edpt_dir(desc_ep->bEndpointAddress)] = desc_ep;
+      ep_count++;
+    }
+
+    p_desc = tu_desc_next(p_desc);
+  }
+
+  // class specific descriptor of the last endpoint is skipped by usbh
+  *p_length = (uint16_t) (p_desc - (uint8_t const*) itf_desc);
+
+  TU_VERIFY( ep_data[TUSB_DIR_IN] || ep_data[TUSB_DIR_OUT] );
+
+  // Find available interface
+  uint8_t inst;
+  for(inst=0; inst<CFG_TUH_MIDI; inst++)
+  {
+    if ( _midih_itf[inst].dev_addr == 0 ) break;
+  }
+  TU_VERIFY(inst < CFG_TUH_MIDI);
+
+  midih_interface_t* p_midi = &_midih_itf[inst];
+  tu_memclr(p_midi, ITF_MEM_RESET_SIZE);
+
+  if ( ep_data[TUSB_DIR_IN]  ) TU_ASSERT( hcd_edpt_open(rhport, dev_addr, ep_data[TUSB_DIR_IN]) );
+  if ( ep_data[TUSB_DIR_OUT] ) TU_ASSERT( hcd_edpt_open(rhport, dev_addr, ep_data[TUSB_DIR_OUT]) );
+
+  p_midi->rhport   = rhport;
+  p_midi->dev_addr = dev_addr;
+  p_midi->itf_num  = itf_desc->bInterfaceNumber;
+  p_midi->ep_in    = ep_data[TUSB_DIR_IN ] ? ep_data[TUSB_DIR_IN ]->bEndpointAddress : 0;
+  p_midi->ep_out   = ep_data[TUSB_DIR_OUT] ? ep_data[TUSB_DIR_OUT]->bEndpointAddress : 0;
+
+  return true;
+}
+
+bool midih_set_config(uint8_t dev_addr, uint8_t itf_num)
+{
+  for(uint8_t inst=0; inst<CFG_TUH_MIDI; inst++)
+  {
+    midih_interface_t* p_midi = &_midih_itf[inst];
+
+    if ( p_midi->dev_addr == dev_addr && p_midi->itf_num == itf_num )
+    {
+      p_midi->mounted = true;
+      rx_arm(p_midi);
+
+      if ( tuh_midi_mounted_cb ) tuh_midi_mounted_cb(inst);
+    }
+  }
+
+  // no class request, next interface is configured right away
+  return false;
+}
+
+void midih_xfer_cb(uint8_t dev_addr, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes)
+{
+  // may be stale if device is removed after transfer completed
+  midih_interface_t* p_midi = get_instance(dev_addr, ep_addr);
+  TU_VERIFY(p_midi, );
+
+  if ( ep_addr == p_midi->ep_in )
+  {
+    rx_complete(p_midi, event, xferred_bytes);
+  }
+  else
+  {
+    tx_complete(p_midi, event);
+  }
+}
+
+void midih_close(uint8_t dev_addr)
+{
+  for(uint8_t inst=0; inst<CFG_TUH_MIDI; inst++)
+  {
+    midih_interface_t* p_midi = &_midih_itf[inst];
+
+    if ( p_midi->dev_addr == dev_addr )
+    {
+      // pipes are closed by usbh
+      if ( p_midi->mounted && tuh_midi_unmounted_cb ) tuh_midi_unmounted_cb(inst);
+
+      tu_memclr(p_midi, ITF_MEM_RESET_SIZE);
+      for(uint8_t cable=0; cable<CFG_TUH_MIDI_CABLES; cable++) tu_fifo_clear(&p_midi->rx_ff[cable]);
+      tu_fifo_clear(&p_midi->tx_ff);
+    }
+  }
+}
+
+#endif
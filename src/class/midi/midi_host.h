@@ -0,0 +1,98 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+/** \ingroup group_class
+ *  \defgroup ClassDriver_MIDI_Host MIDI Host
+ *  @{ */
+
+#ifndef _TUSB_MIDI_HOST_H_
+#define _TUSB_MIDI_HOST_H_
+
+#include "common/tusb_common.h"
+#include "host/usbh.h"
+#include "midi.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+//--------------------------------------------------------------------+
+// Class Driver Configuration
+//--------------------------------------------------------------------+
+// CFG_TUH_MIDI is the number of MIDI streaming interfaces across all devices. Each keeps CFG_TUH_MIDI_RX_BUFS
+// bulk IN transfers armed while its RX FIFOs have room, received event packets are sorted by cable number
+// into CFG_TUH_MIDI_CABLES FIFOs (tusb_option.h).
+
+//--------------------------------------------------------------------+
+// Application API
+// inst is instance index in order interfaces are mounted. Must be called in the same context as tuh_task()
+//--------------------------------------------------------------------+
+bool     tuh_midi_n_mounted   (uint8_t inst);
+uint8_t  tuh_midi_n_dev_addr  (uint8_t inst);
+
+// Number of 4-byte event packets received on cable. With CFG_TUH_MIDI_CABLES = 1 all cables share FIFO 0
+uint32_t tuh_midi_n_available (uint8_t inst, uint8_t cable);
+
+// Read an event packet of cable as received (cable number included), return false if none available
+bool     tuh_midi_n_cable_packet_read(uint8_t inst, uint8_t cable, uint8_t packet[4]);
+
+// Read an event packet from the lowest cable having one
+bool     tuh_midi_n_packet_read (uint8_t inst, uint8_t packet[4]);
+
+// Queue an event packet, cable number in its high nibble. Transfer is started at once if OUT pipe is idle,
+// otherwise packets queued meanwhile are sent together when it completes. Return false if TX FIFO is full
+bool     tuh_midi_n_packet_write(uint8_t inst, uint8_t const packet[4]);
+
+// Number of event packets that can still be queued
+uint32_t tuh_midi_n_write_available(uint8_t inst);
+
+//--------------------------------------------------------------------+
+// Application Callback API (weak is optional)
+//--------------------------------------------------------------------+
+
+// Invoked when interface is mounted and unmounted, queued packets are dropped on unmount
+TU_ATTR_WEAK void tuh_midi_mounted_cb(uint8_t inst);
+TU_ATTR_WEAK void tuh_midi_unmounted_cb(uint8_t inst);
+
+// Invoked in tuh_task() as soon as a bulk IN transfer with event packets completes
+TU_ATTR_WEAK void tuh_midi_rx_cb(uint8_t inst);
+
+//--------------------------------------------------------------------+
+// Internal Class Driver API
+//--------------------------------------------------------------------+
+void midih_init(void);
+bool midih_open(uint8_t rhport, uint8_t dev_addr, tusb_desc_interface_t const *p_interface_desc, uint16_t *p_length);
+bool midih_set_config(uint8_t dev_addr, uint8_t itf_num);
+void midih_xfer_cb(uint8_t dev_addr, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes);
+void midih_close(uint8_t dev_addr);
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif /* _TUSB_MIDI_HOST_H_ */
+
+/** @} */
@@ -65,7 +65,8 @@ typedef enum
 {
   MSC_PROTOCOL_CBI              = 0 ,  ///< Control/Bulk/Interrupt protocol (with command completion interrupt)
   MSC_PROTOCOL_CBI_NO_INTERRUPT = 1 ,  ///< Control/Bulk/Interrupt protocol (without command completion interrupt)
-  MSC_PROTOCOL_BOT              = 0x50 ///< Bulk-Only Transport
+  MSC_PROTOCOL_BOT              = 0x50, ///< Bulk-Only Transport
+  MSC_PROTOCOL_UAS              = 0x62  ///< USB Attached SCSI
 }msc_protocol_type_t;
 
 /// MassStorage Class-Specific Control Request
@@ -128,8 +129,31 @@ typedef enum
   SCSI_CMD_READ_FORMAT_CAPACITY         = 0x23, ///< The command allows the Host to request a list of the possible format capacities for an installed writable media. This command also has the capability to report the writable capacity for a media when it is installed
   SCSI_CMD_READ_10                      = 0x28, ///< The READ (10) command requests that the device server read the specified logical block(s) and transfer them to the data-in buffer.
   SCSI_CMD_WRITE_10                     = 0x2A, ///< The WRITE (10) command requests thatthe device server transfer the specified logical block(s) from the data-out buffer and write them.
+  SCSI_CMD_READ_12                      = 0xA8, ///< Same as READ (10) with 32-bit transfer length
+  SCSI_CMD_WRITE_12                     = 0xAA, ///< Same as WRITE (10) with 32-bit transfer length
+  SCSI_CMD_READ_16                      = 0x88, ///< Same as READ (10) with 64-bit LBA and 32-bit transfer length
+  SCSI_CMD_WRITE_16                     = 0x8A, ///< Same as WRITE (10) with 64-bit LBA and 32-bit transfer length
+  SCSI_CMD_SERVICE_ACTION_IN_16         = 0x9E, ///< Command whose operation is determined by its service action e.g READ CAPACITY (16)
+  SCSI_CMD_SYNCHRONIZE_CACHE_10         = 0x35, ///< Request that cached logical blocks are written to the medium
+  SCSI_CMD_UNMAP                        = 0x42, ///< Request that logical blocks are unmapped i.e data is discarded (TRIM)
+  SCSI_CMD_MODE_SELECT_10               = 0x55, ///< Same as MODE SELECT (6) with 16-bit parameter list length
+  SCSI_CMD_REPORT_LUNS                  = 0xA0, ///< Request the list of logical unit numbers of the target device
 }scsi_cmd_type_t;
 
+/// SCSI Service Action of \ref SCSI_CMD_SERVICE_ACTION_IN_16
+enum
+{
+  SCSI_SERVICE_ACTION_READ_CAPACITY_16 = 0x10, ///< Read Capacity with 64-bit LBA, required for media with more than 2^32 blocks
+};
+
+/// SCSI Vital Product Data page code of INQUIRY with EVPD bit set
+enum
+{
+  SCSI_VPD_SUPPORTED_PAGES           = 0x00,
+  SCSI_VPD_BLOCK_LIMITS              = 0xB0,
+  SCSI_VPD_LOGICAL_BLOCK_PROVISIONING= 0xB2
+};
+
 /// SCSI Sense Key
 typedef enum
 {
@@ -382,6 +406,261 @@ typedef struct TU_ATTR_PACKED
 TU_VERIFY_STATIC(sizeof(scsi_read10_t) == 10, "size is not correct");
 TU_VERIFY_STATIC(sizeof(scsi_write10_t) == 10, "size is not correct");
 
+/// SCSI Read 12 Command
+typedef struct TU_ATTR_PACKED
+{
+  uint8_t  cmd_code    ; ///< SCSI OpCode
+  uint8_t  reserved    ;
+  uint32_t lba         ; ///< The first Logical Block Address (LBA) accessed by this command
+  uint32_t block_count ; ///< Number of Blocks used by this command
+  uint8_t  reserved2   ;
+  uint8_t  control     ;
+} scsi_read12_t, scsi_write12_t;
+
+TU_VERIFY_STATIC(sizeof(scsi_read12_t) == 12, "size is not correct");
+
+/// SCSI Read 16 Command
+typedef struct TU_ATTR_PACKED
+{
+  uint8_t  cmd_code    ; ///< SCSI OpCode
+  uint8_t  reserved    ;
+  uint64_t lba         ; ///< The first Logical Block Address (LBA) accessed by this command
+  uint32_t block_count ; ///< Number of Blocks used by this command
+  uint8_t  reserved2   ;
+  uint8_t  control     ;
+} scsi_read16_t, scsi_write16_t;
+
+TU_VERIFY_STATIC(sizeof(scsi_read16_t) == 16, "size is not correct");
+
+/// SCSI Read Capacity 16 Command
+typedef struct TU_ATTR_PACKED
+{
+  uint8_t  cmd_code                 ; ///< SCSI OpCode for \ref SCSI_CMD_SERVICE_ACTION_IN_16
+  uint8_t  service_action           ; ///< \ref SCSI_SERVICE_ACTION_READ_CAPACITY_16 in lower 5 bits
+  uint64_t lba                      ; ///< Obsolete
+  uint32_t alloc_length             ; ///< Maximum response length accepted by host
+  uint8_t  partial_medium_indicator ;
+  uint8_t  control                  ;
+} scsi_read_capacity16_t;
+
+TU_VERIFY_STATIC(sizeof(scsi_read_capacity16_t) == 16, "size is not correct");
+
+/// SCSI Read Capacity 16 Response Data
+typedef struct TU_ATTR_PACKED
+{
+  uint64_t last_lba   ; ///< The last Logical Block Address of the device
+  uint32_t block_size ; ///< Block size in bytes
+  uint8_t  protection ;
+  uint8_t  lbppb_exponent; ///< Logical blocks per physical block exponent
+  uint8_t  lbp_lowest_aligned[2]; ///< Bit 7: LBPME (thin provisioning e.g UNMAP supported), Bit 6: LBPRZ, then lowest aligned LBA
+  uint8_t  reserved[16];
+} scsi_read_capacity16_resp_t;
+
+TU_VERIFY_STATIC(sizeof(scsi_read_capacity16_resp_t) == 32, "size is not correct");
+
+/// SCSI Synchronize Cache 10 Command
+typedef struct TU_ATTR_PACKED
+{
+  uint8_t  cmd_code    ; ///< SCSI OpCode for \ref SCSI_CMD_SYNCHRONIZE_CACHE_10
+  uint8_t  immed       ;
+  uint32_t lba         ; ///< First block to synchronize
+  uint8_t  group_num   ;
+  uint16_t block_count ; ///< Number of blocks, zero means up to last block of medium
+  uint8_t  control     ;
+} scsi_sync_cache10_t;
+
+TU_VERIFY_STATIC(sizeof(scsi_sync_cache10_t) == 10, "size is not correct");
+
+/// SCSI Unmap Command
+typedef struct TU_ATTR_PACKED
+{
+  uint8_t  cmd_code    ; ///< SCSI OpCode for \ref SCSI_CMD_UNMAP
+  uint8_t  anchor      ;
+  uint32_t reserved2   ;
+  uint8_t  group_num   ;
+  uint16_t param_len   ; ///< Length of parameter list in Data-Out
+  uint8_t  control     ;
+} scsi_unmap_t;
+
+TU_VERIFY_STATIC(sizeof(scsi_unmap_t) == 10, "size is not correct");
+
+/// SCSI Unmap Block Descriptor, follows 8-byte header of Unmap parameter list
+typedef struct TU_ATTR_PACKED
+{
+  uint64_t lba         ;
+  uint32_t block_count ;
+  uint32_t reserved    ;
+} scsi_unmap_block_desc_t;
+
+TU_VERIFY_STATIC(sizeof(scsi_unmap_block_desc_t) == 16, "size is not correct");
+
+/// SCSI Block Limits VPD page, multi-byte fields are big endian
+typedef struct TU_ATTR_PACKED
+{
+  uint8_t  peripheral_device_type ;
+  uint8_t  page_code              ; ///< \ref SCSI_VPD_BLOCK_LIMITS
+  uint16_t page_length            ;
+  uint8_t  wsnz                   ;
+  uint8_t  max_compare_write_len  ;
+  uint16_t opt_xfer_granularity   ;
+  uint32_t max_xfer_len           ;
+  uint32_t opt_xfer_len           ;
+  uint32_t max_prefetch_len       ;
+  uint32_t max_unmap_lba_count    ;
+  uint32_t max_unmap_desc_count   ;
+  uint32_t opt_unmap_granularity  ;
+  uint32_t unmap_granularity_align;
+  uint64_t max_write_same_len     ;
+  uint8_t  reserved[20]           ;
+} scsi_vpd_block_limits_t;
+
+TU_VERIFY_STATIC(sizeof(scsi_vpd_block_limits_t) == 64, "size is not correct");
+
+/// SCSI Logical Block Provisioning VPD page
+typedef struct TU_ATTR_PACKED
+{
+  uint8_t  peripheral_device_type ;
+  uint8_t  page_code              ; ///< \ref SCSI_VPD_LOGICAL_BLOCK_PROVISIONING
+  uint16_t page_length            ;
+  uint8_t  threshold_exponent     ;
+  uint8_t  lbp_flags              ; ///< Bit 7: LBPU (UNMAP supported), Bit 6: LBPWS, Bit 5: LBPWS10, Bit 2: LBPRZ
+  uint8_t  provisioning_type      ;
+  uint8_t  reserved               ;
+} scsi_vpd_lbp_t;
+
+TU_VERIFY_STATIC(sizeof(scsi_vpd_lbp_t) == 8, "size is not correct");
+
+//--------------------------------------------------------------------+
+// USB Attached SCSI (UAS)
+//--------------------------------------------------------------------+
+
+/// UAS Pipe Usage Descriptor type, follows each endpoint descriptor of UAS interface
+enum
+{
+  UAS_DESC_PIPE_USAGE = 0x24
+};
+
+/// UAS Pipe ID of Pipe Usage Descriptor
+enum
+{
+  UAS_PIPE_COMMAND  = 1,
+  UAS_PIPE_STATUS   = 2,
+  UAS_PIPE_DATA_IN  = 3,
+  UAS_PIPE_DATA_OUT = 4
+};
+
+/// UAS Information Unit ID
+typedef enum
+{
+  UAS_IU_COMMAND    = 0x01,
+  UAS_IU_SENSE      = 0x03,
+  UAS_IU_RESPONSE   = 0x04,
+  UAS_IU_TASK_MGMT  = 0x05,
+  UAS_IU_READ_READY = 0x06,
+  UAS_IU_WRITE_READY= 0x07
+}uas_iu_id_t;
+
+/// UAS Task Management Function
+typedef enum
+{
+  UAS_TMF_ABORT_TASK         = 0x01,
+  UAS_TMF_ABORT_TASK_SET     = 0x02,
+  UAS_TMF_CLEAR_TASK_SET     = 0x04,
+  UAS_TMF_LOGICAL_UNIT_RESET = 0x08,
+  UAS_TMF_IT_NEXUS_RESET     = 0x10,
+  UAS_TMF_CLEAR_ACA          = 0x40,
+  UAS_TMF_QUERY_TASK         = 0x80,
+  UAS_TMF_QUERY_TASK_SET     = 0x81,
+  UAS_TMF_QUERY_ASYNC_EVENT  = 0x82
+}uas_tmf_t;
+
+/// UAS Response Code of Response IU
+typedef enum
+{
+  UAS_RC_TMF_COMPLETE       = 0x00,
+  UAS_RC_INVALID_IU         = 0x02,
+  UAS_RC_TMF_NOT_SUPPORTED  = 0x04,
+  UAS_RC_TMF_FAILED         = 0x05,
+  UAS_RC_TMF_SUCCEEDED      = 0x08,
+  UAS_RC_INCORRECT_LUN      = 0x09,
+  UAS_RC_OVERLAPPED_TAG     = 0x0A
+}uas_response_code_t;
+
+/// SCSI Status of Sense IU
+enum
+{
+  UAS_STATUS_GOOD            = 0x00,
+  UAS_STATUS_CHECK_CONDITION = 0x02,
+  UAS_STATUS_TASK_SET_FULL   = 0x28
+};
+
+/// UAS Command IU, multi-byte fields are big endian
+typedef struct TU_ATTR_PACKED
+{
+  uint8_t  iu_id        ; ///< \ref UAS_IU_COMMAND
+  uint8_t  reserved1    ;
+  uint16_t tag          ; ///< Tag of the command, echoed back in all IUs of the command
+  uint8_t  prio_attr    ; ///< Bit 2:0 task attribute, bit 6:3 command priority
+  uint8_t  reserved5    ;
+  uint8_t  add_cdb_len  ; ///< Bit 7:2 additional CDB length in dwords
+  uint8_t  reserved7    ;
+  uint8_t  lun[8]       ; ///< SAM Logical Unit Number
+  uint8_t  cdb[16]      ; ///< SCSI command block
+}uas_cmd_iu_t;
+
+TU_VERIFY_STATIC(sizeof(uas_cmd_iu_t) == 32, "size is not correct");
+
+/// UAS Task Management IU
+typedef struct TU_ATTR_PACKED
+{
+  uint8_t  iu_id        ; ///< \ref UAS_IU_TASK_MGMT
+  uint8_t  reserved1    ;
+  uint16_t tag          ;
+  uint8_t  function     ; ///< Values from \ref uas_tmf_t
+  uint8_t  reserved5    ;
+  uint16_t task_tag     ; ///< Tag of the task being managed e.g by ABORT TASK
+  uint8_t  lun[8]       ;
+}uas_task_mgmt_iu_t;
+
+TU_VERIFY_STATIC(sizeof(uas_task_mgmt_iu_t) == 16, "size is not correct");
+
+/// UAS Sense IU with fixed format sense data
+typedef struct TU_ATTR_PACKED
+{
+  uint8_t  iu_id        ; ///< \ref UAS_IU_SENSE
+  uint8_t  reserved1    ;
+  uint16_t tag          ;
+  uint16_t status_qualifier;
+  uint8_t  status       ; ///< SCSI status e.g \ref UAS_STATUS_GOOD
+  uint8_t  reserved7[7] ;
+  uint16_t sense_len    ; ///< Length of sense data, zero if status is good
+  uint8_t  sense[18]    ;
+}uas_sense_iu_t;
+
+TU_VERIFY_STATIC(sizeof(uas_sense_iu_t) == 34, "size is not correct");
+
+/// UAS Response IU
+typedef struct TU_ATTR_PACKED
+{
+  uint8_t  iu_id        ; ///< \ref UAS_IU_RESPONSE
+  uint8_t  reserved1    ;
+  uint16_t tag          ;
+  uint8_t  add_info[3]  ;
+  uint8_t  response_code; ///< Values from \ref uas_response_code_t
+}uas_response_iu_t;
+
+TU_VERIFY_STATIC(sizeof(uas_response_iu_t) == 8, "size is not correct");
+
+/// UAS Read Ready and Write Ready IU, sent on status pipe before data phase of high/full speed
+typedef struct TU_ATTR_PACKED
+{
+  uint8_t  iu_id        ; ///< \ref UAS_IU_READ_READY or \ref UAS_IU_WRITE_READY
+  uint8_t  reserved1    ;
+  uint16_t tag          ;
+}uas_ready_iu_t;
+
+TU_VERIFY_STATIC(sizeof(uas_ready_iu_t) == 4, "size is not correct");
+
 #ifdef __cplusplus
  }
 #endif
@@ -42,59 +42,203 @@ enum
   MSC_STAGE_STATUS
 };
 
+// Read ahead of the next sequential READ10 into class buffer, started after CSW
+enum
+{
+  MSC_RA_IDLE = 0,
+  MSC_RA_PENDING, // tud_msc_read10_cb() returned TUD_MSC_RET_ASYNC
+  MSC_RA_READY
+};
+
+// READ10/WRITE10 data buffers: next one is read from storage while previous one is on the wire,
+// or written to storage while next one is received
+#define MSC_BUF_COUNT   (CFG_TUD_MSC_DOUBLE_BUFFER ? 2 : 1)
+
 typedef struct
 {
   // TODO optimize alignment
   CFG_TUSB_MEM_ALIGN msc_cbw_t cbw;
   CFG_TUSB_MEM_ALIGN msc_csw_t csw;
 
+  // next CBW is received here while CSW is sent, copied to cbw when processed
+  CFG_TUSB_MEM_ALIGN msc_cbw_t cbw_rx;
+
+  uint8_t  rhport;
   uint8_t  itf_num;
   uint8_t  ep_in;
   uint8_t  ep_out;
 
   // Bulk Only Transfer (BOT) Protocol
   uint8_t  stage;
+  bool     cbw_armed;   // bulk OUT is armed for next CBW
+  bool     cbw_pending; // next CBW completed before CSW, processed once CSW completes
   uint32_t total_len;
   uint32_t xferred_len; // numbered of bytes transferred so far in the Data Stage
 
+  // READ10: bytes read from storage, WRITE10: bytes received from host, so far
+  uint32_t queued_len;
+
+  // ring of data buffers, head is on the wire (READ10) or to be written to storage (WRITE10)
+  uint8_t  buf_head;
+  uint8_t  buf_tail;    // next buffer to read from storage or receive into
+  bool     wr_retry;    // WRITE10 deferred for application not consuming whole buffer
+  bool     async_io;    // callback returned TUD_MSC_RET_ASYNC, waiting for tud_msc_async_io_done()
+  bool     rd_mapped;   // READ10 transfer in progress is medium mapped by tud_msc_read10_map_cb()
+  int32_t  async_result;
+#if CFG_TUD_SPLIT_CORE
+  volatile bool split_io_done; // tud_msc_async_io_done() called by application core
+#endif
+  uint16_t buf_len[MSC_BUF_COUNT];
+
+  // READ10 read ahead, lba is the first block following the last READ10 of lun
+  tud_msc_lba_t ra_lba;
+  uint8_t  ra_lun;
+  uint8_t  ra_state;
+  bool     ra_seq;      // last READ10 continued the one before it
+  bool     ra_hold;     // CBW received while reading ahead, processed once it is done
+  uint16_t ra_blksz;
+  uint16_t ra_len;
+
   // Sense Response Data
   uint8_t sense_key;
   uint8_t add_sense_code;
   uint8_t add_sense_qualifier;
 }mscd_interface_t;
 
-CFG_TUSB_MEM_SECTION CFG_TUSB_MEM_ALIGN static mscd_interface_t _mscd_itf;
-CFG_TUSB_MEM_SECTION CFG_TUSB_MEM_ALIGN static uint8_t _mscd_buf[CFG_TUD_MSC_BUFSIZE];
+// Each interface has its own buffers and state, a slow medium only blocks its own interface
+CFG_TUSB_MEM_SECTION CFG_TUSB_MEM_ALIGN static mscd_interface_t _mscd_itf[CFG_TUD_MSC];
+CFG_TUSB_MEM_SECTION CFG_TUSB_MEM_ALIGN static uint8_t _mscd_buf[CFG_TUD_MSC][MSC_BUF_COUNT][CFG_TUD_MSC_BUFSIZE];
+
+#if CFG_TUD_MSC_CACHE_SEGMENTS
+
+#define CACHE_BLOCK_SIZE    CFG_TUD_MSC_CACHE_BLOCK_SIZE
+#define CACHE_SEG_BLOCKS    CFG_TUD_MSC_CACHE_SEGMENT_BLOCKS
+
+// Cached segment of CACHE_SEG_BLOCKS consecutive blocks, with one bit per block in bitmaps
+typedef struct
+{
+  tud_msc_lba_t lba;    // first block, aligned to CACHE_SEG_BLOCKS
+  uint32_t last_use;    // for LRU eviction
+  uint32_t valid;
+  uint32_t dirty;
+  uint8_t  lun;
+  bool     used;
+}msc_cache_seg_t;
+
+static msc_cache_seg_t _cache_seg[CFG_TUD_MSC_CACHE_SEGMENTS];
+static uint32_t _cache_tick;
+CFG_TUSB_MEM_ALIGN static uint8_t _cache_buf[CFG_TUD_MSC_CACHE_SEGMENTS][CACHE_SEG_BLOCKS*CACHE_BLOCK_SIZE];
+
+#endif
 
 //--------------------------------------------------------------------+
 // INTERNAL OBJECT & FUNCTION DECLARATION
 //--------------------------------------------------------------------+
 static void proc_read10_cmd(uint8_t rhport, mscd_interface_t* p_msc);
 static void proc_write10_cmd(uint8_t rhport, mscd_interface_t* p_msc);
+static void proc_read10_xfer(uint8_t rhport, mscd_interface_t* p_msc, uint32_t xferred_bytes);
+static void proc_write10_xfer(uint8_t rhport, mscd_interface_t* p_msc, uint8_t ep_addr, uint32_t xferred_bytes);
+static void proc_async_io_done(void* param);
+static void proc_stage_status(uint8_t rhport, mscd_interface_t* p_msc);
+static bool read_ahead_prepare(mscd_interface_t* p_msc);
+static void read_ahead_start(uint8_t rhport, mscd_interface_t* p_msc);
+static void read_ahead_done(uint8_t rhport, mscd_interface_t* p_msc, int32_t nbytes);
+static void read_ahead_claim(mscd_interface_t* p_msc);
+
+// Big Endian field of SCSI command, copied bytewise to prevent mis-aligned access
+static uint64_t scsi_get_be(uint8_t const* p, uint8_t len)
+{
+  uint64_t value = 0;
+  while ( len-- ) value = (value << 8) | (*p++);
+  return value;
+}
+
+static void scsi_put_be(uint8_t* p, uint64_t value, uint8_t len)
+{
+  while ( len-- )
+  {
+    p[len] = (uint8_t) value;
+    value >>= 8;
+  }
+}
+
+// READ & WRITE of 10, 12, 16 variants share the same data path
+static inline bool is_read_cmd(uint8_t cmd)
+{
+  return (cmd == SCSI_CMD_READ_10) || (cmd == SCSI_CMD_READ_12) || (cmd == SCSI_CMD_READ_16);
+}
+
+static inline bool is_write_cmd(uint8_t cmd)
+{
+  return (cmd == SCSI_CMD_WRITE_10) || (cmd == SCSI_CMD_WRITE_12) || (cmd == SCSI_CMD_WRITE_16);
+}
+
+static uint64_t rdwr10_get_lba(uint8_t const command[])
+{
+  switch ( command[0] )
+  {
+    case SCSI_CMD_READ_16:
+    case SCSI_CMD_WRITE_16:
+      return scsi_get_be(command + offsetof(scsi_read16_t, lba), 8);
 
-static inline uint32_t rdwr10_get_lba(uint8_t const command[])
+    case SCSI_CMD_READ_12:
+    case SCSI_CMD_WRITE_12:
+      return scsi_get_be(command + offsetof(scsi_read12_t, lba), 4);
+
+    default:
+      return scsi_get_be(command + offsetof(scsi_read10_t, lba), 4);
+  }
+}
+
+static uint32_t rdwr10_get_blockcount(uint8_t const command[])
 {
-  // read10 & write10 has the same format
-  scsi_write10_t* p_rdwr10 = (scsi_write10_t*) command;
+  switch ( command[0] )
+  {
+    case SCSI_CMD_READ_16:
+    case SCSI_CMD_WRITE_16:
+      return (uint32_t) scsi_get_be(command + offsetof(scsi_read16_t, block_count), 4);
+
+    case SCSI_CMD_READ_12:
+    case SCSI_CMD_WRITE_12:
+      return (uint32_t) scsi_get_be(command + offsetof(scsi_read12_t, block_count), 4);
+
+    default:
+      return (uint32_t) scsi_get_be(command + offsetof(scsi_read10_t, block_count), 2);
+  }
+}
 
-  // copy first to prevent mis-aligned access
-  uint32_t lba;
-  memcpy(&lba, &p_rdwr10->lba, 4);
+// Check if accessed blocks are addressable with tud_msc_lba_t
+static inline bool rdwr10_lba_valid(uint8_t const command[])
+{
+#if CFG_TUD_MSC_LBA64
+  (void) command;
+  return true;
+#else
+  return (rdwr10_get_lba(command) + rdwr10_get_blockcount(command)) <= ((uint64_t) UINT32_MAX + 1);
+#endif
+}
 
-  // lba is in Big Endian format
-  return tu_ntohl(lba);
+// return 0 if block count is invalid
+static inline uint32_t rdwr10_get_blocksize(msc_cbw_t const* p_cbw)
+{
+  uint32_t const block_count = rdwr10_get_blockcount(p_cbw->command);
+  return block_count ? p_cbw->total_bytes / block_count : 0;
 }
 
-static inline uint16_t rdwr10_get_blockcount(uint8_t const command[])
+// With multiple interfaces, each one has a single LUN: interface n is LUN n in callbacks
+static inline uint8_t itf_lun(mscd_interface_t const* p_msc)
 {
-  // read10 & write10 has the same format
-  scsi_write10_t* p_rdwr10 = (scsi_write10_t*) command;
+  return (uint8_t) ((p_msc - _mscd_itf) + p_msc->cbw.lun);
+}
 
-  // copy first to prevent mis-aligned access
-  uint16_t block_count;
-  memcpy(&block_count, &p_rdwr10->block_count, 2);
+static inline mscd_interface_t* lun_itf(uint8_t lun)
+{
+  return &_mscd_itf[(lun < CFG_TUD_MSC) ? lun : 0];
+}
 
-  return tu_ntohs(block_count);
+static inline uint8_t* itf_buf(mscd_interface_t const* p_msc, uint8_t idx)
+{
+  return _mscd_buf[p_msc - _mscd_itf][idx];
 }
 
 //--------------------------------------------------------------------+
@@ -102,45 +246,367 @@ static inline uint16_t rdwr10_get_blockcount(uint8_t const command[])
 //--------------------------------------------------------------------+
 bool tud_msc_set_sense(uint8_t lun, uint8_t sense_key, uint8_t add_sense_code, uint8_t add_sense_qualifier)
 {
+  mscd_interface_t* p_msc = lun_itf(lun);
+
+  p_msc->sense_key           = sense_key;
+  p_msc->add_sense_code      = add_sense_code;
+  p_msc->add_sense_qualifier = add_sense_qualifier;
+
+  return true;
+}
+
+bool tud_msc_async_io_done(uint8_t lun, int32_t nbytes, bool in_isr)
+{
+  mscd_interface_t* p_msc = lun_itf(lun);
+
+  // command block may be overwritten by next CBW while reading ahead
+  uint8_t const cur_lun = (MSC_RA_PENDING == p_msc->ra_state) ? p_msc->ra_lun : itf_lun(p_msc);
+
+  TU_VERIFY(p_msc->async_io && (lun == cur_lun));
+  TU_VERIFY(TUD_MSC_RET_ASYNC != nbytes);
+
+  // continue in usbd task
+  p_msc->async_result = nbytes;
+#if CFG_TUD_SPLIT_CORE
+  (void) in_isr;
+  usbd_split_request(&p_msc->split_io_done);
+#else
+  usbd_defer_func(proc_async_io_done, p_msc, in_isr);
+#endif
+
+  return true;
+}
+
+#if CFG_TUD_SPLIT_CORE
+void mscd_doorbell(uint8_t rhport)
+{
+  (void) rhport; // requests are per interface
+
+  for(uint8_t i=0; i<CFG_TUD_MSC; i++)
+  {
+    if ( usbd_split_take(&_mscd_itf[i].split_io_done) ) proc_async_io_done(&_mscd_itf[i]);
+  }
+}
+#endif
+
+//--------------------------------------------------------------------+
+// Block Cache
+//--------------------------------------------------------------------+
+#if CFG_TUD_MSC_CACHE_SEGMENTS
+
+// Bitmap of count blocks starting from first
+static inline uint32_t cache_mask(uint8_t first, uint8_t count)
+{
+  return ((count >= 32) ? UINT32_MAX : (TU_BIT(count) - 1)) << first;
+}
+
+static inline uint8_t* cache_block(msc_cache_seg_t const* seg, uint8_t idx)
+{
+  return _cache_buf[seg - _cache_seg] + idx*CACHE_BLOCK_SIZE;
+}
+
+// Read invalid blocks in [first, last] from medium.
+// Return number of consecutive valid blocks from first, negative if error.
+static int32_t cache_fill(msc_cache_seg_t* seg, uint8_t first, uint8_t last)
+{
+  uint8_t i = first;
+
+  while ( i <= last )
+  {
+    if ( tu_bit_test(seg->valid, i) )
+    {
+      i++;
+      continue;
+    }
+
+    // read whole run of invalid blocks at once
+    uint8_t end = i;
+    while ( (end <= last) && !tu_bit_test(seg->valid, end) ) end++;
+
+    int32_t const nbytes = tud_msc_read10_cb(seg->lun, seg->lba + i, 0, cache_block(seg, i), (end - i)*CACHE_BLOCK_SIZE);
+    if ( nbytes < 0 ) return -1; // also TUD_MSC_RET_ASYNC
+
+    uint8_t const count = (uint8_t) tu_min32((uint32_t) nbytes / CACHE_BLOCK_SIZE, end - i);
+    seg->valid |= cache_mask(i, count);
+
+    // partial read or not ready
+    if ( count < end - i ) return i + count - first;
+
+    i = end;
+  }
+
+  return last - first + 1;
+}
+
+// Write dirty blocks to medium as one write from first to last dirty block.
+// Return 1 if segment is clean, 0 if medium is not ready (partially written), negative if error
+static int32_t cache_flush_seg(msc_cache_seg_t* seg)
+{
+  if ( !seg->dirty ) return 1;
+
+  uint8_t first = 0;
+  uint8_t last  = CACHE_SEG_BLOCKS - 1;
+  while ( !tu_bit_test(seg->dirty, first) ) first++;
+  while ( !tu_bit_test(seg->dirty, last ) ) last--;
+
+  // clean blocks in between are written as well, read them first if needed
+  int32_t const filled = cache_fill(seg, first, last);
+  if ( filled < 0 ) return -1;
+  if ( filled < last - first + 1 ) return 0;
+
+  uint8_t const count = last - first + 1;
+  int32_t const nbytes = tud_msc_write10_cb(seg->lun, seg->lba + first, 0, cache_block(seg, first), count*CACHE_BLOCK_SIZE);
+  if ( nbytes < 0 ) return -1;
+
+  seg->dirty &= ~cache_mask(first, (uint8_t) tu_min32((uint32_t) nbytes / CACHE_BLOCK_SIZE, count));
+
+  return seg->dirty ? 0 : 1;
+}
+
+// Get segment holding block, evict least recently used one on miss.
+// Return 1 if found, 0 if evicted dirty segment is not written yet, negative if error
+static int32_t cache_get(uint8_t lun, tud_msc_lba_t block, msc_cache_seg_t** p_seg)
+{
+  tud_msc_lba_t const seg_lba = block - (block % CACHE_SEG_BLOCKS);
+  msc_cache_seg_t* victim = &_cache_seg[0];
+
+  for(uint8_t i=0; i<CFG_TUD_MSC_CACHE_SEGMENTS; i++)
+  {
+    msc_cache_seg_t* seg = &_cache_seg[i];
+
+    if ( seg->used && (seg->lun == lun) && (seg->lba == seg_lba) )
+    {
+      victim = seg;
+      break;
+    }
+
+    if ( !seg->used ) victim = seg;
+    else if ( victim->used && (seg->last_use < victim->last_use) ) victim = seg;
+  }
+
+  if ( !(victim->used && (victim->lun == lun) && (victim->lba == seg_lba)) )
+  {
+    int32_t const result = cache_flush_seg(victim);
+    if ( result <= 0 ) return result;
+
+    victim->used  = true;
+    victim->lun   = lun;
+    victim->lba   = seg_lba;
+    victim->valid = 0;
+  }
+
+  victim->last_use = ++_cache_tick;
+  *p_seg = victim;
+
+  return 1;
+}
+
+// Requests are served up to end of segment, remaining bytes are requested again by caller
+static int32_t cache_read(uint8_t lun, tud_msc_lba_t lba, uint32_t offset, void* buffer, uint32_t bufsize)
+{
+  tud_msc_lba_t const block = lba + offset / CACHE_BLOCK_SIZE;
+  uint32_t const boff = offset % CACHE_BLOCK_SIZE;
+  uint8_t  const idx  = (uint8_t) (block % CACHE_SEG_BLOCKS);
+
+  uint32_t len = tu_min32(bufsize, (CACHE_SEG_BLOCKS - idx)*CACHE_BLOCK_SIZE - boff);
+  uint8_t const last = (uint8_t) (idx + (boff + len - 1) / CACHE_BLOCK_SIZE);
+
+  msc_cache_seg_t* seg;
+  int32_t result = cache_get(lun, block, &seg);
+  if ( result <= 0 ) return result;
+
+  result = cache_fill(seg, idx, last);
+  if ( result <= 0 ) return result;
+
+  // partial read from medium
+  if ( result < last - idx + 1 ) len = tu_min32(len, (uint32_t) result*CACHE_BLOCK_SIZE - boff);
+
+  tu_memcpy(buffer, cache_block(seg, idx) + boff, len);
+
+  return (int32_t) len;
+}
+
+static int32_t cache_write(uint8_t lun, tud_msc_lba_t lba, uint32_t offset, uint8_t* buffer, uint32_t bufsize)
+{
+  tud_msc_lba_t const block = lba + offset / CACHE_BLOCK_SIZE;
+  uint32_t const boff = offset % CACHE_BLOCK_SIZE;
+  uint8_t  const idx  = (uint8_t) (block % CACHE_SEG_BLOCKS);
+
+  uint32_t const len = tu_min32(bufsize, (CACHE_SEG_BLOCKS - idx)*CACHE_BLOCK_SIZE - boff);
+  uint8_t const last = (uint8_t) (idx + (boff + len - 1) / CACHE_BLOCK_SIZE);
+
+  msc_cache_seg_t* seg;
+  int32_t result = cache_get(lun, block, &seg);
+  if ( result <= 0 ) return result;
+
+  // partially written blocks are read first
+  if ( boff ) result = cache_fill(seg, idx, idx);
+  if ( (result > 0) && ((boff + len) % CACHE_BLOCK_SIZE) ) result = cache_fill(seg, last, last);
+  if ( result <= 0 ) return result;
+
+  tu_memcpy(cache_block(seg, idx) + boff, buffer, len);
+
+  seg->valid |= cache_mask(idx, last - idx + 1);
+  seg->dirty |= cache_mask(idx, last - idx + 1);
+
+#if !CFG_TUD_MSC_CACHE_WRITE_BACK
+  // write-through: blocks not written while medium is busy are written with next flush
+  if ( cache_flush_seg(seg) < 0 ) return -1;
+#endif
+
+  return (int32_t) len;
+}
+
+// Drop cached blocks whose data is discarded by UNMAP
+static void cache_discard(uint8_t lun, uint64_t lba, uint32_t block_count)
+{
+  for(uint8_t i=0; i<CFG_TUD_MSC_CACHE_SEGMENTS; i++)
+  {
+    msc_cache_seg_t* seg = &_cache_seg[i];
+    if ( !(seg->used && seg->lun == lun) ) continue;
+
+    for(uint8_t b=0; b<CACHE_SEG_BLOCKS; b++)
+    {
+      uint64_t const block = seg->lba + b;
+      if ( (block >= lba) && (block - lba < block_count) )
+      {
+        seg->valid &= ~TU_BIT(b);
+        seg->dirty &= ~TU_BIT(b);
+      }
+    }
+  }
+}
+
+#endif
+
+int32_t tud_msc_cache_flush(uint8_t lun)
+{
+  int32_t ret = 1;
+
+#if CFG_TUD_MSC_CACHE_SEGMENTS
+  for(uint8_t i=0; i<CFG_TUD_MSC_CACHE_SEGMENTS; i++)
+  {
+    msc_cache_seg_t* seg = &_cache_seg[i];
+    if ( !(seg->used && seg->lun == lun) ) continue;
+
+    int32_t const result = cache_flush_seg(seg);
+    if ( result < 0 ) return -1;
+
+    // medium is busy, other segments are still written
+    if ( result == 0 ) ret = 0;
+  }
+#else
   (void) lun;
+#endif
+
+  return ret;
+}
+
+// Flush cache for a SCSI command, set sense and return false if it is not fully written. Medium not ready
+// is reported to host which retries the command later, instead of blocking the stack until it is.
+static bool cache_flush_scsi(uint8_t lun)
+{
+  int32_t const result = tud_msc_cache_flush(lun);
+
+  if ( result < 0 )
+  {
+    tud_msc_set_sense(lun, SCSI_SENSE_MEDIUM_ERROR, 0x0C, 0x00); // Write Error
+  }
+  else if ( result == 0 )
+  {
+    tud_msc_set_sense(lun, SCSI_SENSE_NOT_READY, 0x04, 0x01); // Becoming Ready
+  }
+
+  return result > 0;
+}
+
+//--------------------------------------------------------------------+
+// SCSI helpers shared with UAS driver
+//--------------------------------------------------------------------+
+int32_t mscd_read10(uint8_t lun, tud_msc_lba_t lba, uint32_t offset, void* buffer, uint32_t bufsize)
+{
+#if CFG_TUD_MSC_CACHE_SEGMENTS
+  return cache_read(lun, lba, offset, buffer, bufsize);
+#else
+  return tud_msc_read10_cb(lun, lba, offset, buffer, bufsize);
+#endif
+}
+
+int32_t mscd_write10(uint8_t lun, tud_msc_lba_t lba, uint32_t offset, uint8_t* buffer, uint32_t bufsize)
+{
+#if CFG_TUD_MSC_CACHE_SEGMENTS
+  return cache_write(lun, lba, offset, buffer, bufsize);
+#else
+  return tud_msc_write10_cb(lun, lba, offset, buffer, bufsize);
+#endif
+}
+
+bool mscd_rdwr_decode(uint8_t const command[16], bool* is_write, uint64_t* lba, uint32_t* block_count)
+{
+  TU_VERIFY( is_read_cmd(command[0]) || is_write_cmd(command[0]) );
 
-  _mscd_itf.sense_key           = sense_key;
-  _mscd_itf.add_sense_code      = add_sense_code;
-  _mscd_itf.add_sense_qualifier = add_sense_qualifier;
+  *is_write    = is_write_cmd(command[0]);
+  *lba         = rdwr10_get_lba(command);
+  *block_count = rdwr10_get_blockcount(command);
 
   return true;
 }
 
+bool mscd_rdwr_lba_valid(uint8_t const command[16])
+{
+  return rdwr10_lba_valid(command);
+}
+
+uint8_t mscd_get_sense_key(uint8_t lun)
+{
+  return lun_itf(lun)->sense_key;
+}
+
 //--------------------------------------------------------------------+
 // USBD Driver API
 //--------------------------------------------------------------------+
 void mscd_init(void)
 {
-  tu_memclr(&_mscd_itf, sizeof(mscd_interface_t));
+  tu_memclr(_mscd_itf, sizeof(_mscd_itf));
 }
 
 void mscd_reset(uint8_t rhport)
 {
   (void) rhport;
-  tu_memclr(&_mscd_itf, sizeof(mscd_interface_t));
+  tu_memclr(_mscd_itf, sizeof(_mscd_itf));
 }
 
-bool mscd_open(uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t *p_len)
+bool mscd_open(uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t *p_len, uint8_t *p_inst)
 {
-  // only support SCSI's BOT protocol
-  TU_ASSERT(MSC_SUBCLASS_SCSI == itf_desc->bInterfaceSubClass &&
+  // only support SCSI's BOT protocol, UAS is handled by other driver
+  TU_VERIFY(MSC_SUBCLASS_SCSI == itf_desc->bInterfaceSubClass &&
             MSC_PROTOCOL_BOT  == itf_desc->bInterfaceProtocol);
 
-  mscd_interface_t * p_msc = &_mscd_itf;
+  // Find available interface
+  mscd_interface_t * p_msc = NULL;
+  uint8_t msc_id;
+  for(msc_id=0; msc_id<CFG_TUD_MSC; msc_id++)
+  {
+    if ( _mscd_itf[msc_id].ep_in == 0 )
+    {
+      p_msc = &_mscd_itf[msc_id];
+      break;
+    }
+  }
+  TU_ASSERT(p_msc);
+
+  (*p_inst) = msc_id;
 
   // Open endpoint pair
   TU_ASSERT( usbd_open_edpt_pair(rhport, tu_desc_next(itf_desc), 2, TUSB_XFER_BULK, &p_msc->ep_out, &p_msc->ep_in) );
 
+  p_msc->rhport  = rhport;
   p_msc->itf_num = itf_desc->bInterfaceNumber;
   (*p_len) = sizeof(tusb_desc_interface_t) + 2*sizeof(tusb_desc_endpoint_t);
 
   // Prepare for Command Block Wrapper
-  TU_ASSERT( usbd_edpt_xfer(rhport, p_msc->ep_out, (uint8_t*) &p_msc->cbw, sizeof(msc_cbw_t)) );
+  TU_ASSERT( usbd_edpt_xfer(rhport, p_msc->ep_out, (uint8_t*) &p_msc->cbw_rx, sizeof(msc_cbw_t)) );
+  p_msc->cbw_armed = true;
 
   return true;
 }
@@ -160,8 +626,9 @@ bool mscd_control_request(uint8_t rhport, tusb_control_request_t const * p_reque
 
     case MSC_REQ_GET_MAX_LUN:
     {
+      // multiple interfaces have one LUN each
       uint8_t maxlun = 1;
-      if (tud_msc_get_maxlun_cb) maxlun = tud_msc_get_maxlun_cb();
+      if ( (CFG_TUD_MSC == 1) && tud_msc_get_maxlun_cb ) maxlun = tud_msc_get_maxlun_cb();
       TU_VERIFY(maxlun);
 
       // MAX LUN is minus 1 by specs
@@ -188,6 +655,78 @@ bool mscd_control_complete(uint8_t rhport, tusb_control_request_t const * reques
   return true;
 }
 
+// Supported pages, Block Limits and (with UNMAP) Logical Block Provisioning VPD pages
+static int32_t proc_inquiry_vpd(uint8_t lun, uint8_t const scsi_cmd[16], uint8_t* buffer, uint32_t bufsize)
+{
+  uint32_t const alloc_len = tu_u16(scsi_cmd[3], scsi_cmd[4]);
+  int32_t resplen;
+
+  switch ( scsi_cmd[2] )
+  {
+    case SCSI_VPD_SUPPORTED_PAGES:
+    {
+      uint8_t page[7] = { 0, SCSI_VPD_SUPPORTED_PAGES, 0, 2, SCSI_VPD_SUPPORTED_PAGES, SCSI_VPD_BLOCK_LIMITS, SCSI_VPD_LOGICAL_BLOCK_PROVISIONING };
+      if ( tud_msc_unmap_cb ) page[3]++;
+
+      resplen = 4 + page[3];
+      memcpy(buffer, page, resplen);
+    }
+    break;
+
+    case SCSI_VPD_BLOCK_LIMITS:
+    {
+      scsi_vpd_block_limits_t block_limits;
+      tu_varclr(&block_limits);
+
+      block_limits.page_code   = SCSI_VPD_BLOCK_LIMITS;
+      block_limits.page_length = tu_htons(sizeof(scsi_vpd_block_limits_t) - 4);
+
+      if ( tud_msc_unmap_cb )
+      {
+        // parameter list must fit in class buffer
+        block_limits.max_unmap_lba_count  = tu_htonl(UINT32_MAX);
+        block_limits.max_unmap_desc_count = tu_htonl((CFG_TUD_MSC_BUFSIZE - 8) / sizeof(scsi_unmap_block_desc_t));
+      #if CFG_TUD_MSC_CACHE_SEGMENTS
+        block_limits.opt_unmap_granularity = tu_htonl(CFG_TUD_MSC_CACHE_SEGMENT_BLOCKS);
+      #endif
+      }
+
+      resplen = sizeof(block_limits);
+      memcpy(buffer, &block_limits, resplen);
+    }
+    break;
+
+    case SCSI_VPD_LOGICAL_BLOCK_PROVISIONING:
+      if ( tud_msc_unmap_cb )
+      {
+        scsi_vpd_lbp_t lbp;
+        tu_varclr(&lbp);
+
+        lbp.page_code   = SCSI_VPD_LOGICAL_BLOCK_PROVISIONING;
+        lbp.page_length = tu_htons(sizeof(scsi_vpd_lbp_t) - 4);
+        lbp.lbp_flags   = 0x80; // LBPU
+
+        resplen = sizeof(lbp);
+        memcpy(buffer, &lbp, resplen);
+      }else
+      {
+        resplen = -1;
+      }
+    break;
+
+    default: resplen = -1; break;
+  }
+
+  if ( resplen < 0 )
+  {
+    // Invalid Field in CDB
+    tud_msc_set_sense(lun, SCSI_SENSE_ILLEGAL_REQUEST, 0x24, 0x00);
+    return -1;
+  }
+
+  return (int32_t) tu_min32((uint32_t) resplen, tu_min32(alloc_len, bufsize));
+}
+
 // return response's length (copied to buffer). Negative if it is not an built-in command or indicate Failed status (CSW)
 // In case of a failed status, sense key must be set for reason of failure
 int32_t proc_builtin_scsi(uint8_t lun, uint8_t const scsi_cmd[16], uint8_t* buffer, uint32_t bufsize)
@@ -205,13 +744,20 @@ int32_t proc_builtin_scsi(uint8_t lun, uint8_t const scsi_cmd[16], uint8_t* buff
         resplen = - 1;
 
         // If sense key is not set by callback, default to Logical Unit Not Ready, Cause Not Reportable
-        if ( _mscd_itf.sense_key == 0 ) tud_msc_set_sense(lun, SCSI_SENSE_NOT_READY, 0x04, 0x00);
+        if ( lun_itf(lun)->sense_key == 0 ) tud_msc_set_sense(lun, SCSI_SENSE_NOT_READY, 0x04, 0x00);
       }
     break;
 
     case SCSI_CMD_START_STOP_UNIT:
       resplen = 0;
 
+      // cached data is written before power condition or medium changes
+      if ( !cache_flush_scsi(lun) )
+      {
+        resplen = -1;
+        break;
+      }
+
       if (tud_msc_start_stop_cb)
       {
         scsi_start_stop_unit_t const * start_stop = (scsi_start_stop_unit_t const *) scsi_cmd;
@@ -221,14 +767,45 @@ int32_t proc_builtin_scsi(uint8_t lun, uint8_t const scsi_cmd[16], uint8_t* buff
           resplen = - 1;
 
           // If sense key is not set by callback, default to Logical Unit Not Ready, Cause Not Reportable
-          if ( _mscd_itf.sense_key == 0 ) tud_msc_set_sense(lun, SCSI_SENSE_NOT_READY, 0x04, 0x00);
+          if ( lun_itf(lun)->sense_key == 0 ) tud_msc_set_sense(lun, SCSI_SENSE_NOT_READY, 0x04, 0x00);
         }
       }
     break;
 
+    case SCSI_CMD_SYNCHRONIZE_CACHE_10:
+    {
+      // without cache and callback, it is left to application
+      if ( !CFG_TUD_MSC_CACHE_SEGMENTS && !tud_msc_sync_cache_cb )
+      {
+        resplen = -1;
+        break;
+      }
+
+      resplen = 0;
+
+      tud_msc_lba_t const lba = (tud_msc_lba_t) scsi_get_be(scsi_cmd + offsetof(scsi_sync_cache10_t, lba), 4);
+      uint32_t const block_count = (uint32_t) scsi_get_be(scsi_cmd + offsetof(scsi_sync_cache10_t, block_count), 2);
+
+      if ( !cache_flush_scsi(lun) )
+      {
+        resplen = -1;
+      }
+      else if ( tud_msc_sync_cache_cb && !tud_msc_sync_cache_cb(lun, lba, block_count) )
+      {
+        resplen = -1;
+        if ( lun_itf(lun)->sense_key == 0 ) tud_msc_set_sense(lun, SCSI_SENSE_MEDIUM_ERROR, 0x0C, 0x00); // Write Error
+      }
+    }
+    break;
+
+    case SCSI_CMD_UNMAP:
+      // Unmap without parameter list has nothing to do, otherwise handled by proc_builtin_scsi_out()
+      resplen = tud_msc_unmap_cb ? 0 : -1;
+    break;
+
     case SCSI_CMD_READ_CAPACITY_10:
     {
-      uint32_t block_count;
+      tud_msc_lba_t block_count;
       uint32_t block_size;
       uint16_t block_size_u16;
 
@@ -242,12 +819,13 @@ int32_t proc_builtin_scsi(uint8_t lun, uint8_t const scsi_cmd[16], uint8_t* buff
         resplen = -1;
 
         // If sense key is not set by callback, default to Logical Unit Not Ready, Cause Not Reportable
-        if ( _mscd_itf.sense_key == 0 ) tud_msc_set_sense(lun, SCSI_SENSE_NOT_READY, 0x04, 0x00);
+        if ( lun_itf(lun)->sense_key == 0 ) tud_msc_set_sense(lun, SCSI_SENSE_NOT_READY, 0x04, 0x00);
       }else
       {
         scsi_read_capacity10_resp_t read_capa10;
 
-        read_capa10.last_lba = tu_htonl(block_count-1);
+        // host should use READ CAPACITY (16) if last lba does not fit
+        read_capa10.last_lba = tu_htonl((uint32_t) tu_min64(block_count-1, UINT32_MAX));
         read_capa10.block_size = tu_htonl(block_size);
 
         resplen = sizeof(read_capa10);
@@ -256,17 +834,61 @@ int32_t proc_builtin_scsi(uint8_t lun, uint8_t const scsi_cmd[16], uint8_t* buff
     }
     break;
 
-    case SCSI_CMD_READ_FORMAT_CAPACITY:
+    case SCSI_CMD_SERVICE_ACTION_IN_16:
     {
-      scsi_read_format_capacity_data_t read_fmt_capa =
+      scsi_read_capacity16_t const * p_capa16 = (scsi_read_capacity16_t const *) scsi_cmd;
+
+      // other service actions are left to application
+      if ( SCSI_SERVICE_ACTION_READ_CAPACITY_16 != (p_capa16->service_action & 0x1F) )
       {
-          .list_length     = 8,
-          .block_num       = 0,
+        resplen = -1;
+        break;
+      }
+
+      tud_msc_lba_t block_count;
+      uint16_t block_size;
+
+      tud_msc_capacity_cb(lun, &block_count, &block_size);
+
+      // Invalid block size/count from callback, possibly unit is not ready
+      // stall this request, set sense key to NOT READY
+      if (block_count == 0 || block_size == 0)
+      {
+        resplen = -1;
+
+        // If sense key is not set by callback, default to Logical Unit Not Ready, Cause Not Reportable
+        if ( lun_itf(lun)->sense_key == 0 ) tud_msc_set_sense(lun, SCSI_SENSE_NOT_READY, 0x04, 0x00);
+      }else
+      {
+        scsi_read_capacity16_resp_t read_capa16;
+        tu_varclr(&read_capa16);
+
+        scsi_put_be((uint8_t*) &read_capa16.last_lba  , block_count-1, 8);
+        scsi_put_be((uint8_t*) &read_capa16.block_size, block_size   , 4);
+
+        // LBPME: blocks can be unmapped
+        if ( tud_msc_unmap_cb ) read_capa16.lbp_lowest_aligned[0] = 0x80;
+
+        // response is truncated to allocation length
+        uint32_t const alloc_len = (uint32_t) scsi_get_be(scsi_cmd + offsetof(scsi_read_capacity16_t, alloc_length), 4);
+
+        resplen = (int32_t) tu_min32(sizeof(read_capa16), alloc_len);
+        memcpy(buffer, &read_capa16, resplen);
+      }
+    }
+    break;
+
+    case SCSI_CMD_READ_FORMAT_CAPACITY:
+    {
+      scsi_read_format_capacity_data_t read_fmt_capa =
+      {
+          .list_length     = 8,
+          .block_num       = 0,
           .descriptor_type = 2, // formatted media
           .block_size_u16  = 0
       };
 
-      uint32_t block_count;
+      tud_msc_lba_t block_count;
       uint16_t block_size;
 
       tud_msc_capacity_cb(lun, &block_count, &block_size);
@@ -278,10 +900,10 @@ int32_t proc_builtin_scsi(uint8_t lun, uint8_t const scsi_cmd[16], uint8_t* buff
         resplen = -1;
 
         // If sense key is not set by callback, default to Logical Unit Not Ready, Cause Not Reportable
-        if ( _mscd_itf.sense_key == 0 ) tud_msc_set_sense(lun, SCSI_SENSE_NOT_READY, 0x04, 0x00);
+        if ( lun_itf(lun)->sense_key == 0 ) tud_msc_set_sense(lun, SCSI_SENSE_NOT_READY, 0x04, 0x00);
       }else
       {
-        read_fmt_capa.block_num = tu_htonl(block_count);
+        read_fmt_capa.block_num = tu_htonl((uint32_t) tu_min64(block_count, UINT32_MAX));
         read_fmt_capa.block_size_u16 = tu_htons(block_size);
 
         resplen = sizeof(read_fmt_capa);
@@ -292,6 +914,13 @@ int32_t proc_builtin_scsi(uint8_t lun, uint8_t const scsi_cmd[16], uint8_t* buff
 
     case SCSI_CMD_INQUIRY:
     {
+      // Vital Product Data page
+      if ( scsi_cmd[1] & 0x01 )
+      {
+        resplen = proc_inquiry_vpd(lun, scsi_cmd, buffer, bufsize);
+        break;
+      }
+
       scsi_inquiry_resp_t inquiry_rsp =
       {
           .is_removable         = 1,
@@ -299,6 +928,9 @@ int32_t proc_builtin_scsi(uint8_t lun, uint8_t const scsi_cmd[16], uint8_t* buff
           .response_data_format = 2,
       };
 
+      // hosts only look for provisioning (VPD, READ CAPACITY 16) of SPC-3 device
+      if ( tud_msc_unmap_cb ) inquiry_rsp.version = 5;
+
       // vendor_id, product_id, product_rev is space padded string
       memset(inquiry_rsp.vendor_id  , ' ', sizeof(inquiry_rsp.vendor_id));
       memset(inquiry_rsp.product_id , ' ', sizeof(inquiry_rsp.product_id));
@@ -343,9 +975,11 @@ int32_t proc_builtin_scsi(uint8_t lun, uint8_t const scsi_cmd[16], uint8_t* buff
 
       sense_rsp.add_sense_len = sizeof(scsi_sense_fixed_resp_t) - 8;
 
-      sense_rsp.sense_key           = _mscd_itf.sense_key;
-      sense_rsp.add_sense_code      = _mscd_itf.add_sense_code;
-      sense_rsp.add_sense_qualifier = _mscd_itf.add_sense_qualifier;
+      mscd_interface_t const* p_msc = lun_itf(lun);
+
+      sense_rsp.sense_key           = p_msc->sense_key;
+      sense_rsp.add_sense_code      = p_msc->add_sense_code;
+      sense_rsp.add_sense_qualifier = p_msc->add_sense_qualifier;
 
       resplen = sizeof(sense_rsp);
       memcpy(buffer, &sense_rsp, resplen);
@@ -361,9 +995,77 @@ int32_t proc_builtin_scsi(uint8_t lun, uint8_t const scsi_cmd[16], uint8_t* buff
   return resplen;
 }
 
+// Process parameter data of built-in Data-Out command. Return zero if success, negative if it is not
+// a built-in command or indicate Failed status (sense key is set for the latter)
+int32_t proc_builtin_scsi_out(uint8_t lun, uint8_t const scsi_cmd[16], uint8_t const* buffer, uint32_t bufsize)
+{
+  switch ( scsi_cmd[0] )
+  {
+    case SCSI_CMD_UNMAP:
+    {
+      if ( !tud_msc_unmap_cb ) return -1;
+      if ( bufsize == 0 ) return 0;
+
+      if ( bufsize < 8 )
+      {
+        // Parameter List Length Error
+        tud_msc_set_sense(lun, SCSI_SENSE_ILLEGAL_REQUEST, 0x1A, 0x00);
+        return -1;
+      }
+
+      // block descriptors after 8-byte header, truncated to received data
+      uint32_t const desc_len = tu_min32(tu_u16(buffer[2], buffer[3]), bufsize - 8);
+      uint8_t const* desc_end = buffer + 8 + desc_len - (desc_len % sizeof(scsi_unmap_block_desc_t));
+
+      tud_msc_lba_t capacity;
+      uint16_t block_size;
+      tud_msc_capacity_cb(lun, &capacity, &block_size);
+
+      // validate all ranges before discarding any
+      for(uint8_t const* p_desc = buffer + 8; p_desc < desc_end; p_desc += sizeof(scsi_unmap_block_desc_t))
+      {
+        uint64_t const lba   = scsi_get_be(p_desc + offsetof(scsi_unmap_block_desc_t, lba), 8);
+        uint32_t const count = (uint32_t) scsi_get_be(p_desc + offsetof(scsi_unmap_block_desc_t, block_count), 4);
+
+        if ( (lba > capacity) || (count > capacity - lba) )
+        {
+          // Logical Block Address Out Of Range
+          tud_msc_set_sense(lun, SCSI_SENSE_ILLEGAL_REQUEST, 0x21, 0x00);
+          return -1;
+        }
+      }
+
+      for(uint8_t const* p_desc = buffer + 8; p_desc < desc_end; p_desc += sizeof(scsi_unmap_block_desc_t))
+      {
+        uint64_t const lba   = scsi_get_be(p_desc + offsetof(scsi_unmap_block_desc_t, lba), 8);
+        uint32_t const count = (uint32_t) scsi_get_be(p_desc + offsetof(scsi_unmap_block_desc_t, block_count), 4);
+
+        if ( count == 0 ) continue;
+
+      #if CFG_TUD_MSC_CACHE_SEGMENTS
+        cache_discard(lun, lba, count);
+      #endif
+
+        if ( !tud_msc_unmap_cb(lun, (tud_msc_lba_t) lba, count) )
+        {
+          if ( lun_itf(lun)->sense_key == 0 ) tud_msc_set_sense(lun, SCSI_SENSE_MEDIUM_ERROR, 0x0C, 0x00); // Write Error
+          return -1;
+        }
+      }
+
+      return 0;
+    }
+
+    default: return -1;
+  }
+}
+
 bool mscd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes)
 {
-  mscd_interface_t* p_msc = &_mscd_itf;
+  uint8_t const itf = usbd_edpt_inst(rhport, ep_addr);
+  TU_ASSUME(itf < CFG_TUD_MSC);
+
+  mscd_interface_t* p_msc = &_mscd_itf[itf];
   msc_cbw_t const * p_cbw = &p_msc->cbw;
   msc_csw_t       * p_csw = &p_msc->csw;
 
@@ -374,8 +1076,20 @@ bool mscd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t event, uint32_t
       // Complete IN while waiting for CMD is usually Status of previous SCSI op, ignore it
       if(ep_addr != p_msc->ep_out) return true;
 
-      TU_ASSERT( event == XFER_RESULT_SUCCESS &&
-                 xferred_bytes == sizeof(msc_cbw_t) && p_cbw->signature == MSC_CBW_SIGNATURE );
+      TU_ASSERT( event == XFER_RESULT_SUCCESS && xferred_bytes == sizeof(msc_cbw_t) );
+
+      // also when event is simulated again for a held CBW, receive buffer is only re-armed with CSW
+      p_msc->cbw_armed = false;
+      memcpy(&p_msc->cbw, &p_msc->cbw_rx, sizeof(msc_cbw_t));
+
+      TU_ASSERT( p_cbw->signature == MSC_CBW_SIGNATURE );
+
+      // class buffer is being read ahead, resumed by read_ahead_done()
+      if ( MSC_RA_PENDING == p_msc->ra_state )
+      {
+        p_msc->ra_hold = true;
+        return true;
+      }
 
       p_csw->signature    = MSC_CSW_SIGNATURE;
       p_csw->tag          = p_cbw->tag;
@@ -385,12 +1099,32 @@ bool mscd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t event, uint32_t
       p_msc->stage = MSC_STAGE_DATA;
       p_msc->total_len = p_cbw->total_bytes;
       p_msc->xferred_len = 0;
+      p_msc->queued_len  = 0;
+      p_msc->buf_head    = 0;
+      p_msc->buf_tail    = 0;
+      p_msc->wr_retry    = false;
+      p_msc->async_io    = false;
+      p_msc->rd_mapped   = false;
+      tu_varclr(&p_msc->buf_len);
+      read_ahead_claim(p_msc);
+
+      if ( (is_read_cmd(p_cbw->command[0]) || is_write_cmd(p_cbw->command[0])) && !rdwr10_lba_valid(p_cbw->command) )
+      {
+        // Logical Block Address Out Of Range
+        p_msc->total_len = 0;
+        p_csw->status = MSC_CSW_STATUS_FAILED;
+        p_csw->data_residue = p_cbw->total_bytes;
+        p_msc->stage = MSC_STAGE_STATUS;
+
+        tud_msc_set_sense(itf_lun(p_msc), SCSI_SENSE_ILLEGAL_REQUEST, 0x21, 0x00);
 
-      if (SCSI_CMD_READ_10 == p_cbw->command[0])
+        if ( p_cbw->total_bytes ) usbd_edpt_stall(rhport, tu_bit_test(p_cbw->dir, 7) ? p_msc->ep_in : p_msc->ep_out);
+      }
+      else if ( is_read_cmd(p_cbw->command[0]) )
       {
         proc_read10_cmd(rhport, p_msc);
       }
-      else if (SCSI_CMD_WRITE_10 == p_cbw->command[0])
+      else if ( is_write_cmd(p_cbw->command[0]) )
       {
         proc_write10_cmd(rhport, p_msc);
       }
@@ -402,18 +1136,18 @@ bool mscd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t event, uint32_t
         if ( (p_cbw->total_bytes > 0 ) && !tu_bit_test(p_cbw->dir, 7) )
         {
           // queue transfer
-          TU_ASSERT( usbd_edpt_xfer(rhport, p_msc->ep_out, _mscd_buf, p_msc->total_len) );
+          TU_ASSERT( usbd_edpt_xfer(rhport, p_msc->ep_out, itf_buf(p_msc, 0), p_msc->total_len) );
         }else
         {
           int32_t resplen;
 
           // First process if it is a built-in commands
-          resplen = proc_builtin_scsi(p_cbw->lun, p_cbw->command, _mscd_buf, sizeof(_mscd_buf));
+          resplen = proc_builtin_scsi(itf_lun(p_msc), p_cbw->command, itf_buf(p_msc, 0), CFG_TUD_MSC_BUFSIZE);
 
           // Not built-in, invoke user callback
           if ( (resplen < 0) && (p_msc->sense_key == 0) )
           {
-            resplen = tud_msc_scsi_cb(p_cbw->lun, p_cbw->command, _mscd_buf, p_msc->total_len);
+            resplen = tud_msc_scsi_cb(itf_lun(p_msc), p_cbw->command, itf_buf(p_msc, 0), p_msc->total_len);
           }
 
           if ( resplen < 0 )
@@ -423,7 +1157,7 @@ bool mscd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t event, uint32_t
             p_msc->stage = MSC_STAGE_STATUS;
 
             // failed but senskey is not set: default to Illegal Request
-            if ( p_msc->sense_key == 0 ) tud_msc_set_sense(p_cbw->lun, SCSI_SENSE_ILLEGAL_REQUEST, 0x20, 0x00);
+            if ( p_msc->sense_key == 0 ) tud_msc_set_sense(itf_lun(p_msc), SCSI_SENSE_ILLEGAL_REQUEST, 0x20, 0x00);
 
             // Stall bulk In if needed
             if (p_cbw->total_bytes) usbd_edpt_stall(rhport, p_msc->ep_in);
@@ -436,7 +1170,7 @@ bool mscd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t event, uint32_t
             if (p_msc->total_len)
             {
               TU_ASSERT( p_cbw->total_bytes >= p_msc->total_len ); // cannot return more than host expect
-              TU_ASSERT( usbd_edpt_xfer(rhport, p_msc->ep_in, _mscd_buf, p_msc->total_len) );
+              TU_ASSERT( usbd_edpt_xfer(rhport, p_msc->ep_in, itf_buf(p_msc, 0), p_msc->total_len) );
             }else
             {
               p_msc->stage = MSC_STAGE_STATUS;
@@ -447,85 +1181,49 @@ bool mscd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t event, uint32_t
     break;
 
     case MSC_STAGE_DATA:
-      // OUT transfer, invoke callback if needed
-      if ( !tu_bit_test(p_cbw->dir, 7) )
+      if ( is_read_cmd(p_cbw->command[0]) )
+      {
+        proc_read10_xfer(rhport, p_msc, xferred_bytes);
+      }
+      else if ( is_write_cmd(p_cbw->command[0]) )
+      {
+        proc_write10_xfer(rhport, p_msc, ep_addr, xferred_bytes);
+      }
+      else
       {
-        if ( SCSI_CMD_WRITE_10 != p_cbw->command[0] )
+        // OUT transfer, invoke callback
+        if ( !tu_bit_test(p_cbw->dir, 7) )
         {
-          int32_t cb_result = tud_msc_scsi_cb(p_cbw->lun, p_cbw->command, _mscd_buf, p_msc->total_len);
+          // First process if it is a built-in commands
+          int32_t cb_result = proc_builtin_scsi_out(itf_lun(p_msc), p_cbw->command, itf_buf(p_msc, 0), p_msc->total_len);
 
-          if ( cb_result < 0 )
-          {
-            p_csw->status = MSC_CSW_STATUS_FAILED;
-            tud_msc_set_sense(p_cbw->lun, SCSI_SENSE_ILLEGAL_REQUEST, 0x20, 0x00); // Sense = Invalid Command Operation
-          }else
+          // Not built-in, invoke user callback
+          if ( (cb_result < 0) && (p_msc->sense_key == 0) )
           {
-            p_csw->status = MSC_CSW_STATUS_PASSED;
+            cb_result = tud_msc_scsi_cb(itf_lun(p_msc), p_cbw->command, itf_buf(p_msc, 0), p_msc->total_len);
           }
-        }
-        else
-        {
-          uint16_t const block_sz = p_cbw->total_bytes / rdwr10_get_blockcount(p_cbw->command);
 
-          // Adjust lba with transferred bytes
-          uint32_t const lba = rdwr10_get_lba(p_cbw->command) + (p_msc->xferred_len / block_sz);
-
-          // Application can consume smaller bytes
-          int32_t nbytes = tud_msc_write10_cb(p_cbw->lun, lba, p_msc->xferred_len % block_sz, _mscd_buf, xferred_bytes);
-
-          if ( nbytes < 0 )
+          if ( cb_result < 0 )
           {
-            // negative means error -> skip to status phase, status in CSW set to failed
-            p_csw->data_residue = p_cbw->total_bytes - p_msc->xferred_len;
-            p_csw->status       = MSC_CSW_STATUS_FAILED;
-            p_msc->stage        = MSC_STAGE_STATUS;
+            p_csw->status = MSC_CSW_STATUS_FAILED;
 
-            tud_msc_set_sense(p_cbw->lun, SCSI_SENSE_ILLEGAL_REQUEST, 0x20, 0x00); // Sense = Invalid Command Operation
-            break;
+            // failed but senskey is not set: default to Invalid Command Operation
+            if ( p_msc->sense_key == 0 ) tud_msc_set_sense(itf_lun(p_msc), SCSI_SENSE_ILLEGAL_REQUEST, 0x20, 0x00);
           }else
           {
-            // Application consume less than what we got (including zero)
-            if ( nbytes < (int32_t) xferred_bytes )
-            {
-              if ( nbytes > 0 )
-              {
-                p_msc->xferred_len += nbytes;
-                memmove(_mscd_buf, _mscd_buf+nbytes, xferred_bytes-nbytes);
-              }
-
-              // simulate an transfer complete with adjusted parameters --> this driver callback will fired again
-              dcd_event_xfer_complete(rhport, p_msc->ep_out, xferred_bytes-nbytes, XFER_RESULT_SUCCESS, false);
-
-              return true; // skip the rest
-            }
-            else
-            {
-              // Application consume all bytes in our buffer. Nothing to do, process with normal flow
-            }
+            p_csw->status = MSC_CSW_STATUS_PASSED;
           }
         }
-      }
 
-      // Accumulate data so far
-      p_msc->xferred_len += xferred_bytes;
+        // Accumulate data so far
+        p_msc->xferred_len += xferred_bytes;
 
-      if ( p_msc->xferred_len >= p_msc->total_len )
-      {
-        // Data Stage is complete
-        p_msc->stage = MSC_STAGE_STATUS;
-      }
-      else
-      {
-        // READ10 & WRITE10 Can be executed with large bulk of data e.g write 8K bytes (several flash write)
-        // We break it into multiple smaller command whose data size is up to CFG_TUD_MSC_BUFSIZE
-        if (SCSI_CMD_READ_10 == p_cbw->command[0])
+        if ( p_msc->xferred_len >= p_msc->total_len )
         {
-          proc_read10_cmd(rhport, p_msc);
+          // Data Stage is complete
+          p_msc->stage = MSC_STAGE_STATUS;
         }
-        else if (SCSI_CMD_WRITE_10 == p_cbw->command[0])
-        {
-          proc_write10_cmd(rhport, p_msc);
-        }else
+        else
         {
           // No other command take more than one transfer yet -> unlikely error
           TU_BREAKPOINT();
@@ -534,20 +1232,53 @@ bool mscd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t event, uint32_t
     break;
 
     case MSC_STAGE_STATUS:
+      // next CBW may be reported first, CSW is already on the wire
+      if ( (ep_addr == p_msc->ep_out) && p_msc->cbw_armed && (xferred_bytes == sizeof(msc_cbw_t)) )
+      {
+        p_msc->cbw_pending = true;
+        return true;
+      }
+
       // Wait for the command status wrapper complete event
       if( (ep_addr == p_msc->ep_in) && (xferred_bytes == sizeof(msc_csw_t)) )
       {
         // Move to default CMD stage
         p_msc->stage = MSC_STAGE_CMD;
 
-        // Queue for the next CBW
-        TU_ASSERT( usbd_edpt_xfer(rhport, p_msc->ep_out, (uint8_t*) &p_msc->cbw, sizeof(msc_cbw_t)) );
+        // decide before command block is overwritten by next CBW
+        bool const read_ahead = read_ahead_prepare(p_msc);
+
+        // Queue for the next CBW if it could not be armed with CSW
+        if ( !p_msc->cbw_armed )
+        {
+          TU_ASSERT( usbd_edpt_xfer(rhport, p_msc->ep_out, (uint8_t*) &p_msc->cbw_rx, sizeof(msc_cbw_t)) );
+          p_msc->cbw_armed = true;
+        }
+
+        if ( read_ahead ) read_ahead_start(rhport, p_msc);
+
+        if ( p_msc->cbw_pending )
+        {
+          // simulate CBW complete event again to process it
+          p_msc->cbw_pending = false;
+          dcd_event_xfer_complete(rhport, p_msc->ep_out, sizeof(msc_cbw_t), XFER_RESULT_SUCCESS, false);
+        }
       }
     break;
 
     default : break;
   }
 
+  proc_stage_status(rhport, p_msc);
+
+  return true;
+}
+
+// Send CSW once Data Stage is complete
+static void proc_stage_status(uint8_t rhport, mscd_interface_t* p_msc)
+{
+  msc_cbw_t const * p_cbw = &p_msc->cbw;
+
   if ( p_msc->stage == MSC_STAGE_STATUS )
   {
     // Either endpoints is stalled, need to wait until it is cleared by host
@@ -561,94 +1292,481 @@ bool mscd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t event, uint32_t
     else
     {
       // Send SCSI Status
-      TU_ASSERT(usbd_edpt_xfer(rhport, p_msc->ep_in , (uint8_t*) &p_msc->csw, sizeof(msc_csw_t)));
+      TU_ASSERT(usbd_edpt_xfer(rhport, p_msc->ep_in , (uint8_t*) &p_msc->csw, sizeof(msc_csw_t)), );
 
-      // Invoke complete callback if defined
-      switch(p_cbw->command[0])
+      // Receive next CBW meanwhile, host does not wait then for CSW completion to reach tud_task
+      if ( !p_msc->cbw_armed && !usbd_edpt_busy(rhport, p_msc->ep_out) )
       {
-        case SCSI_CMD_READ_10:
-          if ( tud_msc_read10_complete_cb ) tud_msc_read10_complete_cb(p_cbw->lun);
-        break;
-
-        case SCSI_CMD_WRITE_10:
-          if ( tud_msc_write10_complete_cb ) tud_msc_write10_complete_cb(p_cbw->lun);
-        break;
+        p_msc->cbw_armed = usbd_edpt_xfer(rhport, p_msc->ep_out, (uint8_t*) &p_msc->cbw_rx, sizeof(msc_cbw_t));
+      }
 
-        default:
-          if ( tud_msc_scsi_complete_cb ) tud_msc_scsi_complete_cb(p_cbw->lun, p_cbw->command);
-        break;
+      // Invoke complete callback if defined
+      if ( is_read_cmd(p_cbw->command[0]) )
+      {
+        if ( tud_msc_read10_complete_cb ) tud_msc_read10_complete_cb(itf_lun(p_msc));
+      }
+      else if ( is_write_cmd(p_cbw->command[0]) )
+      {
+        if ( tud_msc_write10_complete_cb ) tud_msc_write10_complete_cb(itf_lun(p_msc));
+      }
+      else
+      {
+        if ( tud_msc_scsi_complete_cb ) tud_msc_scsi_complete_cb(itf_lun(p_msc), p_cbw->command);
       }
     }
   }
-
-  return true;
 }
 
 /*------------------------------------------------------------------*/
 /* SCSI Command Process
  *------------------------------------------------------------------*/
-static void proc_read10_cmd(uint8_t rhport, mscd_interface_t* p_msc)
+
+// Account chunk read from storage into tail buffer
+static void read10_fetched(mscd_interface_t* p_msc, int32_t nbytes)
 {
+  if ( nbytes <= 0 ) return;
+
   msc_cbw_t const * p_cbw = &p_msc->cbw;
-  msc_csw_t       * p_csw = &p_msc->csw;
+  uint8_t const idx = p_msc->buf_tail;
 
-  uint16_t const block_cnt = rdwr10_get_blockcount(p_cbw->command);
-  TU_ASSERT(block_cnt, ); // prevent div by zero
+  // remaining bytes capped at class buffer
+  uint32_t const bufsize = tu_min32(CFG_TUD_MSC_BUFSIZE, p_cbw->total_bytes - p_msc->queued_len);
 
-  uint16_t const block_sz = p_cbw->total_bytes / block_cnt;
-  TU_ASSERT(block_sz, ); // prevent div by zero
+  p_msc->buf_len[idx] = (uint16_t) tu_min32((uint32_t) nbytes, bufsize);
+  p_msc->queued_len  += p_msc->buf_len[idx];
+  p_msc->buf_tail     = (idx + 1) % MSC_BUF_COUNT;
+}
+
+// Read next chunk from storage into tail buffer, return callback's result
+static int32_t read10_fetch(mscd_interface_t* p_msc)
+{
+  // previous read is still in progress
+  if ( p_msc->async_io ) return TUD_MSC_RET_ASYNC;
+
+  msc_cbw_t const * p_cbw = &p_msc->cbw;
+
+  uint32_t const block_sz = rdwr10_get_blocksize(p_cbw);
+  TU_ASSERT(block_sz, -1); // prevent div by zero
 
-  // Adjust lba with transferred bytes
-  uint32_t const lba = rdwr10_get_lba(p_cbw->command) + (p_msc->xferred_len / block_sz);
+  // Adjust lba with bytes read so far
+  tud_msc_lba_t const lba = (tud_msc_lba_t) (rdwr10_get_lba(p_cbw->command) + (p_msc->queued_len / block_sz));
 
   // remaining bytes capped at class buffer
-  int32_t nbytes = (int32_t) tu_min32(sizeof(_mscd_buf), p_cbw->total_bytes-p_msc->xferred_len);
+  uint32_t const bufsize = tu_min32(CFG_TUD_MSC_BUFSIZE, p_cbw->total_bytes - p_msc->queued_len);
 
   // Application can consume smaller bytes
-  nbytes = tud_msc_read10_cb(p_cbw->lun, lba, p_msc->xferred_len % block_sz, _mscd_buf, (uint32_t) nbytes);
+  int32_t const nbytes = mscd_read10(itf_lun(p_msc), lba, p_msc->queued_len % block_sz, itf_buf(p_msc, p_msc->buf_tail), bufsize);
 
-  if ( nbytes < 0 )
+  if ( TUD_MSC_RET_ASYNC == nbytes )
   {
-    // negative means error -> pipe is stalled & status in CSW set to failed
-    p_csw->data_residue = p_cbw->total_bytes - p_msc->xferred_len;
-    p_csw->status       = MSC_CSW_STATUS_FAILED;
+    p_msc->async_io = true;
+  }else
+  {
+    read10_fetched(p_msc, nbytes);
+  }
 
-    tud_msc_set_sense(p_cbw->lun, SCSI_SENSE_ILLEGAL_REQUEST, 0x20, 0x00); // Sense = Invalid Command Operation
-    usbd_edpt_stall(rhport, p_msc->ep_in);
+  return nbytes;
+}
+
+// Read ahead into free buffers while head is on the wire. Error and not ready are not
+// handled here, callback is invoked again with the same parameters once head is sent.
+static void read10_prefetch(mscd_interface_t* p_msc)
+{
+  while ( (0 == p_msc->buf_len[p_msc->buf_tail]) && (p_msc->queued_len < p_msc->cbw.total_bytes) )
+  {
+    if ( read10_fetch(p_msc) <= 0 ) break;
   }
-  else if ( nbytes == 0 )
+}
+
+// Transfer medium in place if application maps it, return false to read via class buffer
+static bool read10_map(uint8_t rhport, mscd_interface_t* p_msc)
+{
+  msc_cbw_t const * p_cbw = &p_msc->cbw;
+
+  // asynchronous read is in progress into class buffer, or medium is stale with write-back cache
+  if ( !tud_msc_read10_map_cb || p_msc->async_io || (CFG_TUD_MSC_CACHE_SEGMENTS && CFG_TUD_MSC_CACHE_WRITE_BACK) ) return false;
+
+  uint32_t const block_sz = rdwr10_get_blocksize(p_cbw);
+  TU_VERIFY(block_sz); // prevent div by zero
+
+  tud_msc_lba_t const lba = (tud_msc_lba_t) (rdwr10_get_lba(p_cbw->command) + (p_msc->queued_len / block_sz));
+
+  // Not limited by class buffer, application can map less
+  uint32_t const remaining = p_cbw->total_bytes - p_msc->queued_len;
+  uint32_t len = remaining;
+
+  void const* addr = tud_msc_read10_map_cb(itf_lun(p_msc), lba, p_msc->queued_len % block_sz, &len);
+  TU_VERIFY(addr && len);
+
+  len = tu_min32(len, remaining);
+  TU_ASSERT( usbd_edpt_xfer(rhport, p_msc->ep_in, (uint8_t*) (uintptr_t) addr, len) );
+
+  p_msc->queued_len += len;
+  p_msc->rd_mapped   = true;
+
+  return true;
+}
+
+static void read10_failed(uint8_t rhport, mscd_interface_t* p_msc)
+{
+  msc_cbw_t const * p_cbw = &p_msc->cbw;
+  msc_csw_t       * p_csw = &p_msc->csw;
+
+  // negative means error -> pipe is stalled & status in CSW set to failed
+  p_csw->data_residue = p_cbw->total_bytes - p_msc->xferred_len;
+  p_csw->status       = MSC_CSW_STATUS_FAILED;
+
+  tud_msc_set_sense(itf_lun(p_msc), SCSI_SENSE_ILLEGAL_REQUEST, 0x20, 0x00); // Sense = Invalid Command Operation
+  usbd_edpt_stall(rhport, p_msc->ep_in);
+}
+
+// Read ahead after the CSW of a READ10 that continued the previous one, so that first chunk of
+// the next sequential READ10 is already in class buffer when its CBW arrives
+static bool read_ahead_prepare(mscd_interface_t* p_msc)
+{
+  msc_cbw_t const * p_cbw = &p_msc->cbw;
+
+  TU_VERIFY(CFG_TUD_MSC_READ_AHEAD && p_msc->ra_seq);
+  TU_VERIFY(is_read_cmd(p_cbw->command[0]) && (MSC_CSW_STATUS_PASSED == p_msc->csw.status));
+
+  uint32_t const block_sz = rdwr10_get_blocksize(p_cbw);
+  TU_VERIFY(block_sz && (block_sz <= CFG_TUD_MSC_BUFSIZE));
+
+  p_msc->ra_blksz = (uint16_t) block_sz;
+
+  return true;
+}
+
+static void read_ahead_start(uint8_t rhport, mscd_interface_t* p_msc)
+{
+  tud_msc_lba_t block_count = 0;
+  uint16_t block_size = 0;
+  tud_msc_capacity_cb(p_msc->ra_lun, &block_count, &block_size);
+
+  // last READ10 ended at the end of medium
+  if ( p_msc->ra_lba >= block_count ) return;
+
+  // whole blocks up to class buffer
+  uint32_t const blocks = (uint32_t) tu_min64(block_count - p_msc->ra_lba, CFG_TUD_MSC_BUFSIZE / p_msc->ra_blksz);
+
+  p_msc->ra_len   = (uint16_t) (blocks * p_msc->ra_blksz);
+  p_msc->ra_state = MSC_RA_PENDING;
+
+  int32_t const nbytes = mscd_read10(p_msc->ra_lun, p_msc->ra_lba, 0, itf_buf(p_msc, 0), p_msc->ra_len);
+
+  if ( TUD_MSC_RET_ASYNC == nbytes )
   {
-    // zero means not ready -> simulate an transfer complete so that this driver callback will fired again
-    dcd_event_xfer_complete(rhport, p_msc->ep_in, 0, XFER_RESULT_SUCCESS, false);
+    // resumed by tud_msc_async_io_done()
+    p_msc->async_io = true;
+  }else
+  {
+    read_ahead_done(rhport, p_msc, nbytes);
+  }
+}
+
+static void read_ahead_done(uint8_t rhport, mscd_interface_t* p_msc, int32_t nbytes)
+{
+  // error and not ready are left to the READ10 itself
+  if ( nbytes > 0 )
+  {
+    p_msc->ra_len   = (uint16_t) tu_min32((uint32_t) nbytes, p_msc->ra_len);
+    p_msc->ra_state = MSC_RA_READY;
+  }else
+  {
+    p_msc->ra_state = MSC_RA_IDLE;
+  }
+
+  if ( p_msc->ra_hold )
+  {
+    // simulate CBW complete event again to process it
+    p_msc->ra_hold = false;
+    dcd_event_xfer_complete(rhport, p_msc->ep_out, sizeof(msc_cbw_t), XFER_RESULT_SUCCESS, false);
+  }
+}
+
+// Take over data read ahead if READ10 starts where it is read from, class buffer is reused otherwise
+static void read_ahead_claim(mscd_interface_t* p_msc)
+{
+  msc_cbw_t const * p_cbw = &p_msc->cbw;
+
+  bool const ready = (MSC_RA_READY == p_msc->ra_state);
+  p_msc->ra_state = MSC_RA_IDLE;
+
+  if ( !is_read_cmd(p_cbw->command[0]) ) return;
+
+  // block 0 never continues a previous READ10
+  tud_msc_lba_t const lba = (tud_msc_lba_t) rdwr10_get_lba(p_cbw->command);
+  p_msc->ra_seq = lba && (itf_lun(p_msc) == p_msc->ra_lun) && (lba == p_msc->ra_lba);
+
+  if ( ready && p_msc->ra_seq && (rdwr10_get_blocksize(p_cbw) == p_msc->ra_blksz) )
+  {
+    p_msc->buf_len[0]  = (uint16_t) tu_min32(p_msc->ra_len, p_cbw->total_bytes);
+    p_msc->queued_len  = p_msc->buf_len[0];
+    p_msc->buf_tail    = 1 % MSC_BUF_COUNT;
+  }
+
+  p_msc->ra_lun = itf_lun(p_msc);
+  p_msc->ra_lba = (tud_msc_lba_t) (lba + rdwr10_get_blockcount(p_cbw->command));
+}
+
+static void proc_read10_cmd(uint8_t rhport, mscd_interface_t* p_msc)
+{
+  // head buffer is empty when nothing is read ahead
+  if ( 0 == p_msc->buf_len[p_msc->buf_head] )
+  {
+    if ( read10_map(rhport, p_msc) ) return;
+
+    int32_t const nbytes = read10_fetch(p_msc);
+
+    if ( TUD_MSC_RET_ASYNC == nbytes )
+    {
+      // resumed by tud_msc_async_io_done()
+      return;
+    }
+    else if ( nbytes < 0 )
+    {
+      read10_failed(rhport, p_msc);
+      return;
+    }
+    else if ( nbytes == 0 )
+    {
+      // zero means not ready -> simulate an transfer complete so that this driver callback will fired again
+      dcd_event_xfer_complete(rhport, p_msc->ep_in, 0, XFER_RESULT_SUCCESS, false);
+      return;
+    }
+  }
+
+  TU_ASSERT( usbd_edpt_xfer(rhport, p_msc->ep_in, itf_buf(p_msc, p_msc->buf_head), p_msc->buf_len[p_msc->buf_head]), );
+
+  read10_prefetch(p_msc);
+}
+
+static void proc_read10_xfer(uint8_t rhport, mscd_interface_t* p_msc, uint32_t xferred_bytes)
+{
+  // zero length is the simulated completion of not ready, data is never sent with zero length
+  if ( xferred_bytes )
+  {
+    if ( p_msc->rd_mapped )
+    {
+      // class buffers are untouched by mapped transfer
+      p_msc->rd_mapped = false;
+    }else
+    {
+      p_msc->buf_len[p_msc->buf_head] = 0;
+      p_msc->buf_head = (p_msc->buf_head + 1) % MSC_BUF_COUNT;
+    }
+
+    p_msc->xferred_len += xferred_bytes;
+  }
+
+  if ( p_msc->xferred_len >= p_msc->total_len )
+  {
+    // Data Stage is complete
+    p_msc->stage = MSC_STAGE_STATUS;
   }
   else
   {
-    TU_ASSERT( usbd_edpt_xfer(rhport, p_msc->ep_in, _mscd_buf, nbytes), );
+    // READ10 Can be executed with large bulk of data e.g read 8K bytes (several flash read)
+    // We break it into multiple smaller transfer whose data size is up to CFG_TUD_MSC_BUFSIZE
+    proc_read10_cmd(rhport, p_msc);
   }
 }
 
+// Receive next chunk into tail buffer if it is free
+static void write10_prep(uint8_t rhport, mscd_interface_t* p_msc)
+{
+  msc_cbw_t const * p_cbw = &p_msc->cbw;
+  uint8_t const idx = p_msc->buf_tail;
+
+  if ( p_msc->buf_len[idx] || (p_msc->queued_len >= p_cbw->total_bytes) || usbd_edpt_busy(rhport, p_msc->ep_out) ) return;
+
+  // remaining bytes capped at class buffer
+  uint32_t const nbytes = tu_min32(CFG_TUD_MSC_BUFSIZE, p_cbw->total_bytes - p_msc->queued_len);
+
+  // Write10 callback will be called later when usb transfer complete
+  TU_ASSERT( usbd_edpt_xfer(rhport, p_msc->ep_out, itf_buf(p_msc, idx), nbytes), );
+}
+
 static void proc_write10_cmd(uint8_t rhport, mscd_interface_t* p_msc)
 {
   msc_cbw_t const * p_cbw = &p_msc->cbw;
   bool writable = true;
   if (tud_msc_is_writable_cb) {
-    writable = tud_msc_is_writable_cb(p_cbw->lun);
+    writable = tud_msc_is_writable_cb(itf_lun(p_msc));
   }
   if (!writable) {
     msc_csw_t* p_csw = &p_msc->csw;
     p_csw->data_residue = p_cbw->total_bytes;
     p_csw->status       = MSC_CSW_STATUS_FAILED;
 
-    tud_msc_set_sense(p_cbw->lun, SCSI_SENSE_DATA_PROTECT, 0x27, 0x00); // Sense = Write protected
+    tud_msc_set_sense(itf_lun(p_msc), SCSI_SENSE_DATA_PROTECT, 0x27, 0x00); // Sense = Write protected
     usbd_edpt_stall(rhport, p_msc->ep_out);
     return;
   }
 
-  // remaining bytes capped at class buffer
-  int32_t nbytes = (int32_t) tu_min32(sizeof(_mscd_buf), p_cbw->total_bytes-p_msc->xferred_len);
+  write10_prep(rhport, p_msc);
+}
 
-  // Write10 callback will be called later when usb transfer complete
-  TU_ASSERT( usbd_edpt_xfer(rhport, p_msc->ep_out, _mscd_buf, nbytes), );
+// Handle write callback's result for head buffer.
+// Return true if head buffer is consumed completely and next one can be written.
+static bool write10_written(uint8_t rhport, mscd_interface_t* p_msc, int32_t nbytes)
+{
+  msc_cbw_t const * p_cbw = &p_msc->cbw;
+  msc_csw_t       * p_csw = &p_msc->csw;
+
+  uint8_t* buf = itf_buf(p_msc, p_msc->buf_head);
+  uint16_t const buf_len = p_msc->buf_len[p_msc->buf_head];
+
+  if ( nbytes < 0 )
+  {
+    // negative means error -> skip to status phase, status in CSW set to failed
+    p_csw->data_residue = p_cbw->total_bytes - p_msc->xferred_len;
+    p_csw->status       = MSC_CSW_STATUS_FAILED;
+    p_msc->stage        = MSC_STAGE_STATUS;
+
+    tud_msc_set_sense(itf_lun(p_msc), SCSI_SENSE_ILLEGAL_REQUEST, 0x20, 0x00); // Sense = Invalid Command Operation
+
+    // host still has data to send (possibly into buffer already queued)
+    if ( p_msc->queued_len < p_cbw->total_bytes ) usbd_edpt_stall(rhport, p_msc->ep_out);
+    return false;
+  }
+
+  if ( nbytes < (int32_t) buf_len )
+  {
+    // Application consume less than what we got (including zero)
+    if ( nbytes > 0 )
+    {
+      p_msc->xferred_len += (uint32_t) nbytes;
+      memmove(buf, buf+nbytes, buf_len - (uint32_t) nbytes);
+      p_msc->buf_len[p_msc->buf_head] = (uint16_t) (buf_len - nbytes);
+    }
+
+    // simulate an transfer complete --> this driver callback will fired again
+    p_msc->wr_retry = true;
+    dcd_event_xfer_complete(rhport, p_msc->ep_in, 0, XFER_RESULT_SUCCESS, false);
+    return false;
+  }
+
+  // Application consume all bytes in this buffer
+  p_msc->xferred_len += buf_len;
+  p_msc->buf_len[p_msc->buf_head] = 0;
+  p_msc->buf_head = (p_msc->buf_head + 1) % MSC_BUF_COUNT;
+
+  // WRITE10 Can be executed with large bulk of data e.g write 8K bytes (several flash write)
+  // We break it into multiple smaller transfer whose data size is up to CFG_TUD_MSC_BUFSIZE
+  write10_prep(rhport, p_msc);
+
+  return true;
+}
+
+// Write received buffers to storage
+static void write10_commit(uint8_t rhport, mscd_interface_t* p_msc)
+{
+  msc_cbw_t const * p_cbw = &p_msc->cbw;
+
+  uint32_t const block_sz = rdwr10_get_blocksize(p_cbw);
+  TU_ASSERT(block_sz, ); // prevent div by zero
+
+  while ( p_msc->buf_len[p_msc->buf_head] )
+  {
+    // Adjust lba with transferred bytes
+    tud_msc_lba_t const lba = (tud_msc_lba_t) (rdwr10_get_lba(p_cbw->command) + (p_msc->xferred_len / block_sz));
+
+    // Application can consume smaller bytes
+    int32_t const nbytes = mscd_write10(itf_lun(p_msc), lba, p_msc->xferred_len % block_sz,
+                                              itf_buf(p_msc, p_msc->buf_head), p_msc->buf_len[p_msc->buf_head]);
+
+    if ( TUD_MSC_RET_ASYNC == nbytes )
+    {
+      // resumed by tud_msc_async_io_done()
+      p_msc->async_io = true;
+      return;
+    }
+
+    if ( !write10_written(rhport, p_msc, nbytes) ) return;
+  }
+
+  if ( p_msc->xferred_len >= p_msc->total_len )
+  {
+    // Data Stage is complete
+    p_msc->stage = MSC_STAGE_STATUS;
+  }
+}
+
+static void proc_write10_xfer(uint8_t rhport, mscd_interface_t* p_msc, uint8_t ep_addr, uint32_t xferred_bytes)
+{
+  if ( ep_addr == p_msc->ep_out )
+  {
+    // data received into tail buffer
+    uint8_t const idx = p_msc->buf_tail;
+
+    p_msc->buf_len[idx] = (uint16_t) xferred_bytes;
+    p_msc->queued_len  += xferred_bytes;
+    p_msc->buf_tail     = (idx + 1) % MSC_BUF_COUNT;
+
+    // head is written to storage by pending retry or asynchronous write
+    if ( p_msc->wr_retry || p_msc->async_io )
+    {
+      write10_prep(rhport, p_msc);
+      return;
+    }
+  }
+  else
+  {
+    // simulated completion on IN endpoint (no data in WRITE10) to retry write callback
+    p_msc->wr_retry = false;
+  }
+
+  // receive next chunk while writing head to storage
+  write10_prep(rhport, p_msc);
+  write10_commit(rhport, p_msc);
+}
+
+// Asynchronous read/write result from tud_msc_async_io_done(), processed in usbd task
+static void proc_async_io_done(void* param)
+{
+  mscd_interface_t* p_msc = (mscd_interface_t*) param;
+  uint8_t const rhport = p_msc->rhport;
+  int32_t const nbytes = p_msc->async_result;
+
+  // interface is reset meanwhile
+  if ( !p_msc->async_io ) return;
+
+  if ( MSC_RA_PENDING == p_msc->ra_state )
+  {
+    p_msc->async_io = false;
+    read_ahead_done(rhport, p_msc, nbytes);
+    return;
+  }
+
+  if ( MSC_STAGE_DATA != p_msc->stage ) return;
+  p_msc->async_io = false;
+
+  if ( is_read_cmd(p_msc->cbw.command[0]) )
+  {
+    read10_fetched(p_msc, nbytes);
+
+    if ( usbd_edpt_busy(rhport, p_msc->ep_in) )
+    {
+      // read ahead while head is on the wire
+      read10_prefetch(p_msc);
+    }
+    else if ( nbytes < 0 )
+    {
+      read10_failed(rhport, p_msc);
+    }
+    else
+    {
+      // send head or retry if not ready
+      proc_read10_cmd(rhport, p_msc);
+    }
+  }
+  else
+  {
+    if ( write10_written(rhport, p_msc, nbytes) ) write10_commit(rhport, p_msc);
+  }
+
+  proc_stage_status(rhport, p_msc);
 }
 
 #endif
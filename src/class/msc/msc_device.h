@@ -44,19 +44,87 @@ TU_VERIFY_STATIC(CFG_TUD_MSC_BUFSIZE < UINT16_MAX, "Size is not correct");
   #error CFG_TUD_MSC_BUFSIZE must be defined, value of a block size should work well, the more the better
 #endif
 
+// Use two CFG_TUD_MSC_BUFSIZE buffers for READ10/WRITE10 so that storage is accessed while
+// USB transfers the other buffer. tud_msc_read10_cb() is then invoked ahead for the next chunk
+// and tud_msc_write10_cb() is invoked while the next chunk is being received.
+#ifndef CFG_TUD_MSC_DOUBLE_BUFFER
+  #define CFG_TUD_MSC_DOUBLE_BUFFER   0
+#endif
+
+// Read ahead the next chunk after a READ10 that continued the previous one (sequential read e.g
+// large file copy), so that data stage of the following READ10 starts without storage latency.
+// tud_msc_read10_cb() is then also invoked between commands and may return TUD_MSC_RET_ASYNC.
+#ifndef CFG_TUD_MSC_READ_AHEAD
+  #define CFG_TUD_MSC_READ_AHEAD      0
+#endif
+
+// Use 64-bit LBA and block count in callbacks, required for media larger than 2 TiB with 512-byte
+// block. Otherwise READ(16)/WRITE(16) beyond 32-bit LBA is rejected.
+#ifndef CFG_TUD_MSC_LBA64
+  #define CFG_TUD_MSC_LBA64           0
+#endif
+
+#if CFG_TUD_MSC_LBA64
+typedef uint64_t tud_msc_lba_t;
+#else
+typedef uint32_t tud_msc_lba_t;
+#endif
+
+// Number of segments of block cache between READ10/WRITE10 and tud_msc_read10_cb()/tud_msc_write10_cb(),
+// 0 to disable. Repeated reads e.g FAT and directory sectors are served from cache.
+#ifndef CFG_TUD_MSC_CACHE_SEGMENTS
+  #define CFG_TUD_MSC_CACHE_SEGMENTS        0
+#endif
+
+// Blocks per cache segment, segments are aligned to it. Set to erase size of the medium so that
+// dirty blocks of a segment are written with one tud_msc_write10_cb() that never crosses an erase unit.
+#ifndef CFG_TUD_MSC_CACHE_SEGMENT_BLOCKS
+  #define CFG_TUD_MSC_CACHE_SEGMENT_BLOCKS  8
+#endif
+
+// Block size of medium using the cache
+#ifndef CFG_TUD_MSC_CACHE_BLOCK_SIZE
+  #define CFG_TUD_MSC_CACHE_BLOCK_SIZE      512
+#endif
+
+// Write-back: written blocks are kept in cache until segment is evicted, or flushed by
+// SYNCHRONIZE CACHE, START STOP UNIT or tud_msc_cache_flush(). Otherwise, write-through.
+#ifndef CFG_TUD_MSC_CACHE_WRITE_BACK
+  #define CFG_TUD_MSC_CACHE_WRITE_BACK      0
+#endif
+
+#if CFG_TUD_MSC_CACHE_SEGMENTS
+TU_VERIFY_STATIC(CFG_TUD_MSC_CACHE_SEGMENT_BLOCKS > 0 && CFG_TUD_MSC_CACHE_SEGMENT_BLOCKS <= 32, "Segment blocks is not correct");
+#endif
+
 /** \addtogroup ClassDriver_MSC
  *  @{
  * \defgroup MSC_Device Device
  *  @{ */
 
+// Return value of tud_msc_read10_cb() and tud_msc_write10_cb() when I/O is started in background
+// e.g by DMA, application must then report its result with tud_msc_async_io_done()
+#define TUD_MSC_RET_ASYNC   (-16)
+
 bool tud_msc_set_sense(uint8_t lun, uint8_t sense_key, uint8_t add_sense_code, uint8_t add_sense_qualifier);
 
+// Complete read/write whose callback returned TUD_MSC_RET_ASYNC, can be called from ISR.
+// nbytes has the same meaning as the callback's return value. With CFG_TUD_SPLIT_CORE callbacks
+// run on stack core and this is called from application core once it has done the I/O.
+bool tud_msc_async_io_done(uint8_t lun, int32_t nbytes, bool in_isr);
+
+// Write dirty blocks of cache to medium. Return 1 if all are written, 0 if medium is not ready for all of them
+// (tud_msc_write10_cb() returned 0, call again later) or negative if tud_msc_write10_cb() failed.
+// With cache enabled, callbacks are invoked synchronously: TUD_MSC_RET_ASYNC is treated as error and
+// CFG_TUD_MSC_CACHE_BLOCK_SIZE must match block size of all LUNs.
+int32_t tud_msc_cache_flush(uint8_t lun);
+
 //--------------------------------------------------------------------+
 // Application Callbacks (WEAK is optional)
 //--------------------------------------------------------------------+
 
 /**
- * Invoked when received \ref SCSI_CMD_READ_10 command
+ * Invoked when received \ref SCSI_CMD_READ_10 command, also for \ref SCSI_CMD_READ_12 and \ref SCSI_CMD_READ_16
  * \param[in]   lun         Logical unit number
  * \param[in]   lba         Logical Block Address to be read
  * \param[in]   offset      Byte offset from LBA
@@ -71,11 +139,14 @@ bool tud_msc_set_sense(uint8_t lun, uint8_t sense_key, uint8_t add_sense_code, u
  *
  * \retval      negative    Indicate error e.g reading disk I/O. tinyusb will \b STALL the corresponding
  *                          endpoint and return failed status in command status wrapper phase.
+ *
+ * \retval      TUD_MSC_RET_ASYNC  Reading continues in background, \a \b buffer must be filled and
+ *                          tud_msc_async_io_done() called once it is complete.
  */
-int32_t tud_msc_read10_cb (uint8_t lun, uint32_t lba, uint32_t offset, void* buffer, uint32_t bufsize);
+int32_t tud_msc_read10_cb (uint8_t lun, tud_msc_lba_t lba, uint32_t offset, void* buffer, uint32_t bufsize);
 
 /**
- * Invoked when received \ref SCSI_CMD_WRITE_10 command
+ * Invoked when received \ref SCSI_CMD_WRITE_10 command, also for \ref SCSI_CMD_WRITE_12 and \ref SCSI_CMD_WRITE_16
  * \param[in]   lun         Logical unit number
  * \param[in]   lba         Logical Block Address to be write
  * \param[in]   offset      Byte offset from LBA
@@ -90,8 +161,11 @@ int32_t tud_msc_read10_cb (uint8_t lun, uint32_t lba, uint32_t offset, void* buf
  *
  * \retval      negative    Indicate error writing disk I/O. Tinyusb will \b STALL the corresponding
  *                          endpoint and return failed status in command status wrapper phase.
+ *
+ * \retval      TUD_MSC_RET_ASYNC  Writing continues in background, \a \b buffer must be kept intact until
+ *                          tud_msc_async_io_done() is called.
  */
-int32_t tud_msc_write10_cb (uint8_t lun, uint32_t lba, uint32_t offset, uint8_t* buffer, uint32_t bufsize);
+int32_t tud_msc_write10_cb (uint8_t lun, tud_msc_lba_t lba, uint32_t offset, uint8_t* buffer, uint32_t bufsize);
 
 // Invoked when received SCSI_CMD_INQUIRY
 // Application fill vendor id, product id and revision with string up to 8, 16, 4 characters respectively
@@ -101,14 +175,15 @@ void tud_msc_inquiry_cb(uint8_t lun, uint8_t vendor_id[8], uint8_t product_id[16
 // return true allowing host to read/write this LUN e.g SD card inserted
 bool tud_msc_test_unit_ready_cb(uint8_t lun);
 
-// Invoked when received SCSI_CMD_READ_CAPACITY_10 and SCSI_CMD_READ_FORMAT_CAPACITY to determine the disk size
+// Invoked when received SCSI_CMD_READ_CAPACITY_10, READ_CAPACITY_16 and SCSI_CMD_READ_FORMAT_CAPACITY to determine the disk size
 // Application update block count and block size
-void tud_msc_capacity_cb(uint8_t lun, uint32_t* block_count, uint16_t* block_size);
+void tud_msc_capacity_cb(uint8_t lun, tud_msc_lba_t* block_count, uint16_t* block_size);
 
 /**
  * Invoked when received an SCSI command not in built-in list below.
- * - READ_CAPACITY10, READ_FORMAT_CAPACITY, INQUIRY, TEST_UNIT_READY, START_STOP_UNIT, MODE_SENSE6, REQUEST_SENSE
- * - READ10 and WRITE10 has their own callbacks
+ * - READ_CAPACITY10, READ_CAPACITY16, READ_FORMAT_CAPACITY, INQUIRY, TEST_UNIT_READY, START_STOP_UNIT, MODE_SENSE6, REQUEST_SENSE
+ * - SYNCHRONIZE_CACHE10 with cache or tud_msc_sync_cache_cb(), UNMAP with tud_msc_unmap_cb()
+ * - READ10 and WRITE10 (and their 12, 16 variants) has their own callbacks
  *
  * \param[in]   lun         Logical unit number
  * \param[in]   scsi_cmd    SCSI command contents which application must examine to response accordingly
@@ -125,7 +200,9 @@ int32_t tud_msc_scsi_cb (uint8_t lun, uint8_t const scsi_cmd[16], void* buffer,
 
 /*------------- Optional callbacks -------------*/
 
-// Invoked when received GET_MAX_LUN request, required for multiple LUNs implementation
+// Invoked when received GET_MAX_LUN request, required for multiple LUNs implementation.
+// Not used with multiple interfaces (CFG_TUD_MSC > 1): each has a single LUN, interface n is LUN n
+// in callbacks and is served independently e.g slow SD card does not hold back internal flash.
 TU_ATTR_WEAK uint8_t tud_msc_get_maxlun_cb(void);
 
 // Invoked when received Start Stop Unit command
@@ -133,6 +210,21 @@ TU_ATTR_WEAK uint8_t tud_msc_get_maxlun_cb(void);
 // - Start = 1 : active mode, if load_eject = 1 : load disk storage
 TU_ATTR_WEAK bool tud_msc_start_stop_cb(uint8_t lun, uint8_t power_condition, bool start, bool load_eject);
 
+// Invoked when received READ10 (and its 12, 16 variants) for medium mapped into memory e.g RAM disk or
+// XIP flash. Return address of data at lba + offset, bufsize is requested bytes that application can
+// reduce to what is contiguous. Data is transferred directly from there, the memory must be accessible by
+// the DCD (e.g DMA capable region) and is not limited by CFG_TUD_MSC_BUFSIZE.
+// Return NULL to read it via tud_msc_read10_cb() instead. Not used with write-back cache.
+TU_ATTR_WEAK void const* tud_msc_read10_map_cb(uint8_t lun, tud_msc_lba_t lba, uint32_t offset, uint32_t* bufsize);
+
+// Invoked when received SYNCHRONIZE CACHE (10), after stack cache is flushed. Application writes its own
+// cached data of blocks to medium, block_count zero means up to last block. Return false if writing failed.
+TU_ATTR_WEAK bool tud_msc_sync_cache_cb(uint8_t lun, tud_msc_lba_t lba, uint32_t block_count);
+
+// Invoked for each block range of UNMAP: data of blocks is discarded e.g flash pages of deleted files
+// need no garbage collection. Defining it reports thin provisioning to host. Return false if failed.
+TU_ATTR_WEAK bool tud_msc_unmap_cb(uint8_t lun, tud_msc_lba_t lba, uint32_t block_count);
+
 // Invoked when Read10 command is complete
 TU_ATTR_WEAK void tud_msc_read10_complete_cb(uint8_t lun);
 
@@ -153,10 +245,20 @@ TU_ATTR_WEAK bool tud_msc_is_writable_cb(uint8_t lun);
 //--------------------------------------------------------------------+
 void mscd_init             (void);
 void mscd_reset            (uint8_t rhport);
-bool mscd_open             (uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t *p_length);
+bool mscd_open             (uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t *p_length, uint8_t *p_inst);
 bool mscd_control_request  (uint8_t rhport, tusb_control_request_t const * p_request);
 bool mscd_control_complete (uint8_t rhport, tusb_control_request_t const * p_request);
 bool mscd_xfer_cb          (uint8_t rhport, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes);
+void mscd_doorbell         (uint8_t rhport);
+
+// SCSI layer shared with UAS driver
+int32_t proc_builtin_scsi  (uint8_t lun, uint8_t const scsi_cmd[16], uint8_t* buffer, uint32_t bufsize);
+int32_t proc_builtin_scsi_out(uint8_t lun, uint8_t const scsi_cmd[16], uint8_t const* buffer, uint32_t bufsize);
+int32_t mscd_read10        (uint8_t lun, tud_msc_lba_t lba, uint32_t offset, void* buffer, uint32_t bufsize);
+int32_t mscd_write10       (uint8_t lun, tud_msc_lba_t lba, uint32_t offset, uint8_t* buffer, uint32_t bufsize);
+bool mscd_rdwr_decode      (uint8_t const command[16], bool* is_write, uint64_t* lba, uint32_t* block_count);
+bool mscd_rdwr_lba_valid   (uint8_t const command[16]);
+uint8_t mscd_get_sense_key (uint8_t lun);
 
 #ifdef __cplusplus
  }
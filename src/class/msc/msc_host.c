@@ -39,12 +39,12 @@
 //--------------------------------------------------------------------+
 CFG_TUSB_MEM_SECTION static msch_interface_t msch_data[CFG_TUSB_HOST_DEVICE_MAX];
 
-//------------- Initalization Data -------------//
-static osal_semaphore_def_t msch_sem_def;
-static osal_semaphore_t msch_sem_hdl;
+// buffer used to read scsi information when mounted, largest response data currently is block limits VPD
+CFG_TUSB_MEM_SECTION TU_ATTR_ALIGNED(4) static uint8_t msch_buffer[sizeof(scsi_vpd_block_limits_t)];
 
-// buffer used to read scsi information when mounted, largest response data currently is inquiry
-CFG_TUSB_MEM_SECTION TU_ATTR_ALIGNED(4) static uint8_t msch_buffer[sizeof(scsi_inquiry_resp_t)];
+enum { SCSI_XFER_TIMEOUT = 2000 };
+
+TU_VERIFY_STATIC( CFG_TUH_MSC_QUEUE && !(CFG_TUH_MSC_QUEUE & (CFG_TUH_MSC_QUEUE-1)), "CFG_TUH_MSC_QUEUE must be power of 2");
 
 //--------------------------------------------------------------------+
 // INTERNAL OBJECT & FUNCTION DECLARATION
@@ -62,26 +62,53 @@ bool tuh_msc_is_mounted(uint8_t dev_addr)
 bool tuh_msc_is_busy(uint8_t dev_addr)
 {
   return  msch_data[dev_addr-1].is_initialized &&
-          hcd_edpt_busy(dev_addr, msch_data[dev_addr-1].ep_in);
+          (msch_data[dev_addr-1].q_count || hcd_edpt_busy(dev_addr, msch_data[dev_addr-1].ep_in));
+}
+
+uint8_t tuh_msc_get_lun_count(uint8_t dev_addr)
+{
+  return msch_data[dev_addr-1].is_initialized ? msch_data[dev_addr-1].lun_count : 0;
+}
+
+uint8_t const* tuh_msc_get_lun_vendor_name(uint8_t dev_addr, uint8_t lun)
+{
+  return (lun < tuh_msc_get_lun_count(dev_addr)) ? msch_data[dev_addr-1].lun[lun].vendor_id : NULL;
+}
+
+uint8_t const* tuh_msc_get_lun_product_name(uint8_t dev_addr, uint8_t lun)
+{
+  return (lun < tuh_msc_get_lun_count(dev_addr)) ? msch_data[dev_addr-1].lun[lun].product_id : NULL;
+}
+
+tusb_error_t tuh_msc_get_lun_capacity(uint8_t dev_addr, uint8_t lun, uint64_t* p_last_lba, uint32_t* p_block_size)
+{
+  if ( !msch_data[dev_addr-1].is_initialized )   return TUSB_ERROR_MSCH_DEVICE_NOT_MOUNTED;
+  TU_ASSERT(p_last_lba != NULL && p_block_size != NULL, TUSB_ERROR_INVALID_PARA);
+  TU_ASSERT(lun < msch_data[dev_addr-1].lun_count, TUSB_ERROR_INVALID_PARA);
+
+  (*p_last_lba)   = msch_data[dev_addr-1].lun[lun].last_lba;
+  (*p_block_size) = msch_data[dev_addr-1].lun[lun].block_size;
+
+  return TUSB_ERROR_NONE;
 }
 
 uint8_t const* tuh_msc_get_vendor_name(uint8_t dev_addr)
 {
-  return msch_data[dev_addr-1].is_initialized ? msch_data[dev_addr-1].vendor_id : NULL;
+  return tuh_msc_get_lun_vendor_name(dev_addr, 0);
 }
 
 uint8_t const* tuh_msc_get_product_name(uint8_t dev_addr)
 {
-  return msch_data[dev_addr-1].is_initialized ? msch_data[dev_addr-1].product_id : NULL;
+  return tuh_msc_get_lun_product_name(dev_addr, 0);
 }
 
 tusb_error_t tuh_msc_get_capacity(uint8_t dev_addr, uint32_t* p_last_lba, uint32_t* p_block_size)
 {
-  if ( !msch_data[dev_addr-1].is_initialized )   return TUSB_ERROR_MSCH_DEVICE_NOT_MOUNTED;
-  TU_ASSERT(p_last_lba != NULL && p_block_size != NULL, TUSB_ERROR_INVALID_PARA);
+  TU_ASSERT(p_last_lba != NULL, TUSB_ERROR_INVALID_PARA);
 
-  (*p_last_lba)   = msch_data[dev_addr-1].last_lba;
-  (*p_block_size) = (uint32_t) msch_data[dev_addr-1].block_size;
+  uint64_t last_lba;
+  TU_ASSERT_ERR( tuh_msc_get_lun_capacity(dev_addr, 0, &last_lba, p_block_size) );
+  (*p_last_lba) = (uint32_t) tu_min64(last_lba, UINT32_MAX);
 
   return TUSB_ERROR_NONE;
 }
@@ -96,26 +123,48 @@ static inline void msc_cbw_add_signature(msc_cbw_t *p_cbw, uint8_t lun)
   p_cbw->lun        = lun;
 }
 
-static tusb_error_t msch_command_xfer(uint8_t dev_addr, msch_interface_t * p_msch, void* p_buffer)
+static void scsi_put_be(uint8_t* p, uint64_t value, uint8_t len)
+{
+  while ( len-- )
+  {
+    p[len] = (uint8_t) value;
+    value >>= 8;
+  }
+}
+
+static uint64_t scsi_get_be(uint8_t const* p, uint8_t len)
+{
+  uint64_t value = 0;
+  while ( len-- ) value = (value << 8) | (*p++);
+  return value;
+}
+
+// CBW, data and CSW stages are all submitted at once, only CSW interrupts on completion
+static tusb_error_t msch_bot_xfer(uint8_t dev_addr, msch_interface_t * p_msch, msc_cbw_t* p_cbw, msc_csw_t* p_csw, void* p_buffer)
 {
   if ( NULL != p_buffer)
   { // there is data phase
-    if (p_msch->cbw.dir & TUSB_DIR_IN_MASK)
+    if (p_cbw->dir & TUSB_DIR_IN_MASK)
     {
-      TU_ASSERT( hcd_pipe_xfer(dev_addr, p_msch->ep_out, (uint8_t*) &p_msch->cbw, sizeof(msc_cbw_t), false), TUSB_ERROR_FAILED );
-      TU_ASSERT( hcd_pipe_queue_xfer(dev_addr, p_msch->ep_in , p_buffer, p_msch->cbw.total_bytes), TUSB_ERROR_FAILED );
+      TU_ASSERT( hcd_pipe_xfer(dev_addr, p_msch->ep_out, (uint8_t*) p_cbw, sizeof(msc_cbw_t), false), TUSB_ERROR_FAILED );
+      TU_ASSERT( hcd_pipe_queue_xfer(dev_addr, p_msch->ep_in , p_buffer, p_cbw->total_bytes), TUSB_ERROR_FAILED );
     }else
     {
-      TU_ASSERT( hcd_pipe_queue_xfer(dev_addr, p_msch->ep_out, (uint8_t*) &p_msch->cbw, sizeof(msc_cbw_t)), TUSB_ERROR_FAILED );
-      TU_ASSERT( hcd_pipe_xfer(dev_addr, p_msch->ep_out , p_buffer, p_msch->cbw.total_bytes, false), TUSB_ERROR_FAILED );
+      TU_ASSERT( hcd_pipe_queue_xfer(dev_addr, p_msch->ep_out, (uint8_t*) p_cbw, sizeof(msc_cbw_t)), TUSB_ERROR_FAILED );
+      TU_ASSERT( hcd_pipe_xfer(dev_addr, p_msch->ep_out , p_buffer, p_cbw->total_bytes, false), TUSB_ERROR_FAILED );
     }
   }
 
-  TU_ASSERT( hcd_pipe_xfer(dev_addr, p_msch->ep_in , (uint8_t*) &p_msch->csw, sizeof(msc_csw_t), true), TUSB_ERROR_FAILED);
+  TU_ASSERT( hcd_pipe_xfer(dev_addr, p_msch->ep_in , (uint8_t*) p_csw, sizeof(msc_csw_t), true), TUSB_ERROR_FAILED);
 
   return TUSB_ERROR_NONE;
 }
 
+static tusb_error_t msch_command_xfer(uint8_t dev_addr, msch_interface_t * p_msch, void* p_buffer)
+{
+  return msch_bot_xfer(dev_addr, p_msch, &p_msch->cbw, &p_msch->csw, p_buffer);
+}
+
 tusb_error_t tusbh_msc_inquiry(uint8_t dev_addr, uint8_t lun, uint8_t *p_data)
 {
   msch_interface_t* p_msch = &msch_data[dev_addr-1];
@@ -140,6 +189,58 @@ tusb_error_t tusbh_msc_inquiry(uint8_t dev_addr, uint8_t lun, uint8_t *p_data)
   return TUSB_ERROR_NONE;
 }
 
+// Inquiry of a Vital Product Data page
+static tusb_error_t msch_inquiry_vpd(uint8_t dev_addr, uint8_t lun, uint8_t page_code, uint8_t *p_data, uint8_t len)
+{
+  msch_interface_t* p_msch = &msch_data[dev_addr-1];
+
+  //------------- Command Block Wrapper -------------//
+  msc_cbw_add_signature(&p_msch->cbw, lun);
+  p_msch->cbw.total_bytes = len;
+  p_msch->cbw.dir        = TUSB_DIR_IN_MASK;
+  p_msch->cbw.cmd_len    = sizeof(scsi_inquiry_t);
+
+  //------------- SCSI command -------------//
+  scsi_inquiry_t cmd_inquiry =
+  {
+      .cmd_code     = SCSI_CMD_INQUIRY,
+      .reserved1    = 1, // EVPD
+      .page_code    = page_code,
+      .alloc_length = len
+  };
+
+  memcpy(p_msch->cbw.command, &cmd_inquiry, p_msch->cbw.cmd_len);
+
+  TU_ASSERT_ERR ( msch_command_xfer(dev_addr, p_msch, p_data) );
+
+  return TUSB_ERROR_NONE;
+}
+
+static tusb_error_t msch_read_capacity16(uint8_t dev_addr, uint8_t lun, uint8_t *p_data)
+{
+  msch_interface_t* p_msch = &msch_data[dev_addr-1];
+
+  //------------- Command Block Wrapper -------------//
+  msc_cbw_add_signature(&p_msch->cbw, lun);
+  p_msch->cbw.total_bytes = sizeof(scsi_read_capacity16_resp_t);
+  p_msch->cbw.dir        = TUSB_DIR_IN_MASK;
+  p_msch->cbw.cmd_len    = sizeof(scsi_read_capacity16_t);
+
+  //------------- SCSI command -------------//
+  scsi_read_capacity16_t cmd_read_capacity16 =
+  {
+      .cmd_code       = SCSI_CMD_SERVICE_ACTION_IN_16,
+      .service_action = SCSI_SERVICE_ACTION_READ_CAPACITY_16,
+      .alloc_length   = tu_htonl(sizeof(scsi_read_capacity16_resp_t))
+  };
+
+  memcpy(p_msch->cbw.command, &cmd_read_capacity16, p_msch->cbw.cmd_len);
+
+  TU_ASSERT_ERR ( msch_command_xfer(dev_addr, p_msch, p_data) );
+
+  return TUSB_ERROR_NONE;
+}
+
 tusb_error_t tusbh_msc_read_capacity10(uint8_t dev_addr, uint8_t lun, uint8_t *p_data)
 {
   msch_interface_t* p_msch = &msch_data[dev_addr-1];
@@ -167,11 +268,10 @@ tusb_error_t tusbh_msc_read_capacity10(uint8_t dev_addr, uint8_t lun, uint8_t *p
 
 tusb_error_t tuh_msc_request_sense(uint8_t dev_addr, uint8_t lun, uint8_t *p_data)
 {
-  (void) lun; // TODO [MSCH] multiple lun support
-
   msch_interface_t* p_msch = &msch_data[dev_addr-1];
 
   //------------- Command Block Wrapper -------------//
+  msc_cbw_add_signature(&p_msch->cbw, lun);
   p_msch->cbw.total_bytes = 18;
   p_msch->cbw.dir        = TUSB_DIR_IN_MASK;
   p_msch->cbw.cmd_len    = sizeof(scsi_request_sense_t);
@@ -220,11 +320,13 @@ tusb_error_t tuh_msc_test_unit_ready(uint8_t dev_addr, uint8_t lun,  msc_csw_t *
 tusb_error_t  tuh_msc_read10(uint8_t dev_addr, uint8_t lun, void * p_buffer, uint32_t lba, uint16_t block_count)
 {
   msch_interface_t* p_msch = &msch_data[dev_addr-1];
+  if ( p_msch->q_count ) return TUSB_ERROR_INTERFACE_IS_BUSY;
+  TU_ASSERT(lun < p_msch->lun_count, TUSB_ERROR_INVALID_PARA);
 
   //------------- Command Block Wrapper -------------//
   msc_cbw_add_signature(&p_msch->cbw, lun);
 
-  p_msch->cbw.total_bytes = p_msch->block_size*block_count; // Number of bytes
+  p_msch->cbw.total_bytes = p_msch->lun[lun].block_size*block_count; // Number of bytes
   p_msch->cbw.dir        = TUSB_DIR_IN_MASK;
   p_msch->cbw.cmd_len    = sizeof(scsi_read10_t);
 
@@ -246,11 +348,13 @@ tusb_error_t  tuh_msc_read10(uint8_t dev_addr, uint8_t lun, void * p_buffer, uin
 tusb_error_t tuh_msc_write10(uint8_t dev_addr, uint8_t lun, void const * p_buffer, uint32_t lba, uint16_t block_count)
 {
   msch_interface_t* p_msch = &msch_data[dev_addr-1];
+  if ( p_msch->q_count ) return TUSB_ERROR_INTERFACE_IS_BUSY;
+  TU_ASSERT(lun < p_msch->lun_count, TUSB_ERROR_INVALID_PARA);
 
   //------------- Command Block Wrapper -------------//
   msc_cbw_add_signature(&p_msch->cbw, lun);
 
-  p_msch->cbw.total_bytes = p_msch->block_size*block_count; // Number of bytes
+  p_msch->cbw.total_bytes = p_msch->lun[lun].block_size*block_count; // Number of bytes
   p_msch->cbw.dir        = TUSB_DIR_OUT;
   p_msch->cbw.cmd_len    = sizeof(scsi_write10_t);
 
@@ -269,13 +373,374 @@ tusb_error_t tuh_msc_write10(uint8_t dev_addr, uint8_t lun, void const * p_buffe
   return TUSB_ERROR_NONE;
 }
 
+//--------------------------------------------------------------------+
+// PUBLIC API: QUEUED COMMAND
+//--------------------------------------------------------------------+
+static inline msch_cmd_t* queue_cmd(msch_interface_t* p_msc, uint8_t offset)
+{
+  return &p_msc->queue[(p_msc->q_rd + offset) & (CFG_TUH_MSC_QUEUE-1)];
+}
+
+// CBW for the next part of a queued request, which is split at max transfer length of the unit.
+// READ/WRITE 10 is used unless lba or block count does not fit
+static void msch_cmd_next_cbw(msch_interface_t* p_msc, msch_cmd_t* cmd)
+{
+  msch_lun_t const* p_lun = &p_msc->lun[cmd->cbw.lun];
+  bool const is_read = (cmd->cbw.dir & TUSB_DIR_IN_MASK) != 0;
+
+  cmd->part_count = tu_min32(cmd->block_count, p_lun->max_xfer_blocks);
+
+  cmd->cbw.tag         = ++p_msc->q_tag;
+  cmd->cbw.total_bytes = cmd->part_count*p_lun->block_size;
+  tu_memclr(cmd->cbw.command, sizeof(cmd->cbw.command));
+
+  if ( (cmd->part_count <= UINT16_MAX) && ((cmd->lba + cmd->part_count - 1) <= UINT32_MAX) )
+  {
+    cmd->cbw.command[0] = is_read ? SCSI_CMD_READ_10 : SCSI_CMD_WRITE_10;
+    cmd->cbw.cmd_len    = sizeof(scsi_read10_t);
+    scsi_put_be(cmd->cbw.command + offsetof(scsi_read10_t, lba)        , cmd->lba       , 4);
+    scsi_put_be(cmd->cbw.command + offsetof(scsi_read10_t, block_count), cmd->part_count, 2);
+  }else
+  {
+    cmd->cbw.command[0] = is_read ? SCSI_CMD_READ_16 : SCSI_CMD_WRITE_16;
+    cmd->cbw.cmd_len    = sizeof(scsi_read16_t);
+    scsi_put_be(cmd->cbw.command + offsetof(scsi_read16_t, lba)        , cmd->lba       , 8);
+    scsi_put_be(cmd->cbw.command + offsetof(scsi_read16_t, block_count), cmd->part_count, 4);
+  }
+}
+
+static bool msch_queue_rw(uint8_t dev_addr, uint8_t lun, void* p_buffer, uint64_t lba, uint32_t block_count, bool is_read, tuh_msc_complete_cb_t complete_cb)
+{
+  msch_interface_t* p_msc = &msch_data[dev_addr-1];
+
+  TU_VERIFY( p_msc->is_initialized && p_buffer && block_count && (lun < p_msc->lun_count) );
+  TU_VERIFY( p_msc->lun[lun].block_size && (lba + block_count - 1 <= p_msc->lun[lun].last_lba) );
+  TU_VERIFY( p_msc->q_count < CFG_TUH_MSC_QUEUE );
+
+  // a non-queued command is in progress
+  TU_VERIFY( p_msc->q_count || !hcd_edpt_busy(dev_addr, p_msc->ep_in) );
+
+  msch_cmd_t* cmd = queue_cmd(p_msc, p_msc->q_count);
+  tu_memclr(cmd, sizeof(msch_cmd_t));
+
+  cmd->cbw.signature = MSC_CBW_SIGNATURE;
+  cmd->cbw.lun       = lun;
+  cmd->cbw.dir       = is_read ? TUSB_DIR_IN_MASK : TUSB_DIR_OUT;
+
+  cmd->buffer      = (uint8_t*) p_buffer;
+  cmd->lba         = lba;
+  cmd->block_count = block_count;
+  cmd->complete_cb = complete_cb;
+
+  msch_cmd_next_cbw(p_msc, cmd);
+
+  // start now if no command is in progress, otherwise isr starts it when CSW of the previous one is received
+  hcd_int_disable(p_msc->rhport);
+
+  bool ret = true;
+  if ( p_msc->q_done == p_msc->q_count )
+  {
+    ret = (TUSB_ERROR_NONE == msch_bot_xfer(dev_addr, p_msc, &cmd->cbw, &cmd->csw, cmd->buffer));
+  }
+  if ( ret ) p_msc->q_count++;
+
+  hcd_int_enable(p_msc->rhport);
+
+  return ret;
+}
+
+bool tuh_msc_read_queue(uint8_t dev_addr, uint8_t lun, void * p_buffer, uint64_t lba, uint32_t block_count, tuh_msc_complete_cb_t complete_cb)
+{
+  return msch_queue_rw(dev_addr, lun, p_buffer, lba, block_count, true, complete_cb);
+}
+
+bool tuh_msc_write_queue(uint8_t dev_addr, uint8_t lun, void const * p_buffer, uint64_t lba, uint32_t block_count, tuh_msc_complete_cb_t complete_cb)
+{
+  return msch_queue_rw(dev_addr, lun, (void*) p_buffer, lba, block_count, false, complete_cb);
+}
+
+uint8_t tuh_msc_queue_count(uint8_t dev_addr)
+{
+  return msch_data[dev_addr-1].q_count;
+}
+
+// Called in isr with a command in progress
+static void msch_queue_xfer_isr(uint8_t dev_addr, msch_interface_t* p_msc, uint8_t ep_addr, xfer_result_t event)
+{
+  // only CSW interrupts on success (some HCDs also report CBW/data stage), errors are reported by any stage
+  if ( XFER_RESULT_SUCCESS == event && ep_addr != p_msc->ep_in ) return;
+
+  msch_cmd_t* cmd = queue_cmd(p_msc, p_msc->q_done);
+  if ( XFER_RESULT_SUCCESS == event && (cmd->csw.signature != MSC_CSW_SIGNATURE || cmd->csw.tag != cmd->cbw.tag) )
+  {
+    event = XFER_RESULT_FAILED;
+  }
+
+  // remaining part of a split request
+  if ( XFER_RESULT_SUCCESS == event && MSC_CSW_STATUS_PASSED == cmd->csw.status &&
+       0 == cmd->csw.data_residue && cmd->block_count > cmd->part_count )
+  {
+    cmd->buffer      += cmd->part_count*p_msc->lun[cmd->cbw.lun].block_size;
+    cmd->lba         += cmd->part_count;
+    cmd->block_count -= cmd->part_count;
+    msch_cmd_next_cbw(p_msc, cmd);
+
+    if ( TUSB_ERROR_NONE == msch_bot_xfer(dev_addr, p_msc, &cmd->cbw, &cmd->csw, cmd->buffer) ) return;
+    event = XFER_RESULT_FAILED;
+  }
+
+  cmd->result = event;
+  p_msc->q_done++;
+
+  // pipeline the next command right away
+  if ( XFER_RESULT_SUCCESS == event && p_msc->q_done < p_msc->q_count )
+  {
+    msch_cmd_t* next = queue_cmd(p_msc, p_msc->q_done);
+    if ( TUSB_ERROR_NONE != msch_bot_xfer(dev_addr, p_msc, &next->cbw, &next->csw, next->buffer) ) event = XFER_RESULT_FAILED;
+  }
+
+  // endpoint is halted or out of resource: abort the rest
+  if ( XFER_RESULT_SUCCESS != event )
+  {
+    while ( p_msc->q_done < p_msc->q_count )
+    {
+      queue_cmd(p_msc, p_msc->q_done)->result = XFER_RESULT_FAILED;
+      p_msc->q_done++;
+    }
+  }
+}
+
+// Invoke callback of commands completed up to the pending event, called in tuh_task
+static void msch_queue_complete(uint8_t dev_addr, msch_interface_t* p_msc)
+{
+  hcd_int_disable(p_msc->rhport);
+  uint8_t done = p_msc->q_done;
+  p_msc->q_notify = false;
+  hcd_int_enable(p_msc->rhport);
+
+  while ( done-- )
+  {
+    // slot is released after callback, which may queue another command
+    msch_cmd_t const* cmd = queue_cmd(p_msc, 0);
+    if ( cmd->complete_cb ) cmd->complete_cb(dev_addr, &cmd->cbw, &cmd->csw, cmd->result);
+
+    hcd_int_disable(p_msc->rhport);
+    p_msc->q_rd = (uint8_t) ((p_msc->q_rd + 1) & (CFG_TUH_MSC_QUEUE-1));
+    p_msc->q_count--;
+    p_msc->q_done--;
+    hcd_int_enable(p_msc->rhport);
+  }
+}
+
 //--------------------------------------------------------------------+
 // CLASS-USBH API (don't require to verify parameters)
 //--------------------------------------------------------------------+
 void msch_init(void)
 {
   tu_memclr(msch_data, sizeof(msch_interface_t)*CFG_TUSB_HOST_DEVICE_MAX);
-  msch_sem_hdl = osal_semaphore_create(&msch_sem_def);
+}
+
+// SCSI commands issued by set_config, in order for each lun
+enum
+{
+  MSCH_OPEN_IDLE = 0,
+  MSCH_OPEN_INQUIRY,
+  MSCH_OPEN_READ_CAPACITY10,
+  MSCH_OPEN_READ_CAPACITY16,
+  MSCH_OPEN_REQUEST_SENSE,
+  MSCH_OPEN_BLOCK_LIMITS,
+};
+
+static bool msch_open_command(uint8_t dev_addr, msch_interface_t* p_msc, uint8_t stage)
+{
+  uint8_t const lun = p_msc->open_lun;
+  tusb_error_t err;
+
+  p_msc->open_stage   = stage;
+  p_msc->open_stalled = false;
+
+  switch ( stage )
+  {
+    case MSCH_OPEN_INQUIRY        : err = tusbh_msc_inquiry(dev_addr, lun, msch_buffer);         break;
+    case MSCH_OPEN_READ_CAPACITY10: err = tusbh_msc_read_capacity10(dev_addr, lun, msch_buffer); break;
+    case MSCH_OPEN_READ_CAPACITY16: err = msch_read_capacity16(dev_addr, lun, msch_buffer);      break;
+    case MSCH_OPEN_REQUEST_SENSE  : err = tuh_msc_request_sense(dev_addr, lun, msch_buffer);     break;
+    case MSCH_OPEN_BLOCK_LIMITS   : err = msch_inquiry_vpd(dev_addr, lun, SCSI_VPD_BLOCK_LIMITS, msch_buffer, sizeof(scsi_vpd_block_limits_t)); break;
+    default: return false;
+  }
+
+  return TUSB_ERROR_NONE == err;
+}
+
+// All luns are initialized or one of their commands cannot complete
+static void msch_open_done(uint8_t dev_addr, msch_interface_t* p_msc, bool success)
+{
+  p_msc->open_stage = MSCH_OPEN_IDLE;
+  hcd_edpt_timeout(p_msc->rhport, dev_addr, p_msc->ep_in, 0);
+
+  if ( success )
+  {
+    p_msc->is_initialized = true;
+    tuh_msc_mounted_cb(dev_addr);
+  }
+
+  usbh_driver_set_config_complete(dev_addr, p_msc->itf_numr);
+}
+
+static bool msch_open_next_lun(uint8_t dev_addr, msch_interface_t* p_msc)
+{
+  p_msc->open_lun++;
+  if ( p_msc->open_lun < p_msc->lun_count ) return msch_open_command(dev_addr, p_msc, MSCH_OPEN_INQUIRY);
+
+  msch_open_done(dev_addr, p_msc, true);
+  return true;
+}
+
+// Limit command transfer length to CFG_TUH_MSC_MAX_XFER_SIZE and Maximum Transfer Length of Block Limits VPD.
+// Only queried from SPC-3 or later units, older ones (many USB sticks) may not handle VPD properly
+static bool msch_open_block_limits(uint8_t dev_addr, msch_interface_t* p_msc)
+{
+  msch_lun_t* p_lun = &p_msc->lun[p_msc->open_lun];
+  if ( !p_lun->block_size ) return msch_open_next_lun(dev_addr, p_msc);
+
+  p_lun->max_xfer_blocks = tu_max32(CFG_TUH_MSC_MAX_XFER_SIZE / p_lun->block_size, 1);
+
+  if ( p_msc->open_version < 5 ) return msch_open_next_lun(dev_addr, p_msc);
+  return msch_open_command(dev_addr, p_msc, MSCH_OPEN_BLOCK_LIMITS);
+}
+
+// CSW of command in progress is received, issue the next one
+static bool msch_open_stage_complete(uint8_t dev_addr, msch_interface_t* p_msc)
+{
+  msch_lun_t* p_lun = &p_msc->lun[p_msc->open_lun];
+  bool const passed = (MSC_CSW_STATUS_PASSED == p_msc->csw.status);
+
+  switch ( p_msc->open_stage )
+  {
+    case MSCH_OPEN_INQUIRY:
+      memcpy(p_lun->vendor_id , ((scsi_inquiry_resp_t*) msch_buffer)->vendor_id , 8);
+      memcpy(p_lun->product_id, ((scsi_inquiry_resp_t*) msch_buffer)->product_id, 16);
+      p_msc->open_version = ((scsi_inquiry_resp_t*) msch_buffer)->version;
+
+      //------------- SCSI Read Capacity 10 (16) -------------//
+      p_lun->block_size   = 0;
+      p_lun->last_lba     = 0;
+      p_msc->open_attempt = 0;
+      return msch_open_command(dev_addr, p_msc, MSCH_OPEN_READ_CAPACITY10);
+
+    case MSCH_OPEN_READ_CAPACITY10:
+      if ( !passed ) return msch_open_command(dev_addr, p_msc, MSCH_OPEN_REQUEST_SENSE);
+
+      p_lun->last_lba   = tu_ntohl( ((scsi_read_capacity10_resp_t*)msch_buffer)->last_lba );
+      p_lun->block_size = tu_ntohl( ((scsi_read_capacity10_resp_t*)msch_buffer)->block_size );
+
+      // media larger than 2 TiB (with 512-byte block) reports max lba
+      if ( p_lun->last_lba == UINT32_MAX ) return msch_open_command(dev_addr, p_msc, MSCH_OPEN_READ_CAPACITY16);
+
+      return msch_open_block_limits(dev_addr, p_msc);
+
+    case MSCH_OPEN_READ_CAPACITY16:
+      if ( passed )
+      {
+        p_lun->last_lba   = scsi_get_be(msch_buffer + offsetof(scsi_read_capacity16_resp_t, last_lba), 8);
+        p_lun->block_size = (uint32_t) scsi_get_be(msch_buffer + offsetof(scsi_read_capacity16_resp_t, block_size), 4);
+      }
+
+      return msch_open_block_limits(dev_addr, p_msc);
+
+    // NOTE: my toshiba thumb-drive stall the first Read Capacity and require the sequence
+    // Read Capacity --> Stalled --> Clear Stall --> Request Sense --> Read Capacity (2) to work.
+    // Unit still failing after that (e.g empty slot of card reader) is mounted with zero block size
+    case MSCH_OPEN_REQUEST_SENSE:
+      if ( ++p_msc->open_attempt < 2 ) return msch_open_command(dev_addr, p_msc, MSCH_OPEN_READ_CAPACITY10);
+      return msch_open_next_lun(dev_addr, p_msc);
+
+    case MSCH_OPEN_BLOCK_LIMITS:
+    {
+      scsi_vpd_block_limits_t const* block_limits = (scsi_vpd_block_limits_t const*) msch_buffer;
+      if ( passed && SCSI_VPD_BLOCK_LIMITS == block_limits->page_code )
+      {
+        uint32_t const max_xfer_len = tu_ntohl(block_limits->max_xfer_len); // zero means no limit
+        if ( max_xfer_len ) p_lun->max_xfer_blocks = tu_min32(p_lun->max_xfer_blocks, max_xfer_len);
+      }
+
+      return msch_open_next_lun(dev_addr, p_msc);
+    }
+
+    default: return false;
+  }
+}
+
+// Stalled data stage is cleared so that CSW can be received
+static void msch_open_clear_stall_complete(uint8_t dev_addr, tusb_control_request_t const * request, xfer_result_t result)
+{
+  (void) request;
+  msch_interface_t* p_msc = &msch_data[dev_addr-1];
+
+  // skip if device is removed meanwhile
+  if ( p_msc->open_stage == MSCH_OPEN_IDLE ) return;
+
+  if ( XFER_RESULT_SUCCESS == result )
+  {
+    hcd_edpt_clear_stall(dev_addr, p_msc->ep_in);
+  }else
+  {
+    msch_open_done(dev_addr, p_msc, false);
+  }
+}
+
+// Completion of ep_in during set_config: CSW, stalled data stage or failure
+static void msch_open_xfer_cb(uint8_t dev_addr, msch_interface_t* p_msc, xfer_result_t event)
+{
+  if ( p_msc->open_stage == MSCH_OPEN_IDLE ) return;
+
+  bool is_ok = true;
+
+  if ( XFER_RESULT_STALLED == event && !p_msc->open_stalled )
+  {
+    // clear stall TODO abstract clear stall function
+    tusb_control_request_t const request =
+    {
+      .bmRequestType_bit = { .recipient = TUSB_REQ_RCPT_ENDPOINT, .type = TUSB_REQ_TYPE_STANDARD, .direction = TUSB_DIR_OUT },
+      .bRequest = TUSB_REQ_CLEAR_FEATURE,
+      .wValue = 0,
+      .wIndex = p_msc->ep_in,
+      .wLength = 0
+    };
+
+    p_msc->open_stalled = true;
+    is_ok = tuh_control_xfer(dev_addr, &request, NULL, msch_open_clear_stall_complete);
+  }
+  else if ( XFER_RESULT_SUCCESS == event )
+  {
+    // report as failed command even if CSW is lost
+    if ( p_msc->open_stalled ) p_msc->csw.status = MSC_CSW_STATUS_FAILED;
+    is_ok = msch_open_stage_complete(dev_addr, p_msc);
+  }
+  else
+  {
+    // CSW is failed or timed out
+    is_ok = false;
+  }
+
+  if ( !is_ok ) msch_open_done(dev_addr, p_msc, false);
+}
+
+static void msch_get_max_lun_complete(uint8_t dev_addr, tusb_control_request_t const * request, xfer_result_t result)
+{
+  (void) request;
+  msch_interface_t* p_msc = &msch_data[dev_addr-1];
+
+  // STALL means single lun device, control endpoint recovers with next SETUP
+  p_msc->max_lun   = (XFER_RESULT_SUCCESS == result) ? msch_buffer[0] : 0;
+  p_msc->lun_count = (uint8_t) tu_min16(p_msc->max_lun + 1, CFG_TUH_MSC_MAXLUN);
+
+  // lost CSW fails initialization instead of waiting forever
+  hcd_edpt_timeout(p_msc->rhport, dev_addr, p_msc->ep_in, SCSI_XFER_TIMEOUT);
+
+  //------------- SCSI Inquiry -------------//
+  p_msc->open_lun = 0;
+  if ( !msch_open_command(dev_addr, p_msc, MSCH_OPEN_INQUIRY) ) msch_open_done(dev_addr, p_msc, false);
 }
 
 bool msch_open(uint8_t rhport, uint8_t dev_addr, tusb_desc_interface_t const *itf_desc, uint16_t *p_length)
@@ -306,103 +771,74 @@ bool msch_open(uint8_t rhport, uint8_t dev_addr, tusb_desc_interface_t const *it
     ep_desc = (tusb_desc_endpoint_t const *) tu_desc_next(ep_desc);
   }
 
+  p_msc->rhport   = rhport;
   p_msc->itf_numr = itf_desc->bInterfaceNumber;
   (*p_length) += sizeof(tusb_desc_interface_t) + 2*sizeof(tusb_desc_endpoint_t);
 
+  return true;
+}
+
+bool msch_set_config(uint8_t dev_addr, uint8_t itf_num)
+{
   //------------- Get Max Lun -------------//
-  tusb_control_request_t request = {
+  tusb_control_request_t const request = {
         .bmRequestType_bit = { .recipient = TUSB_REQ_RCPT_INTERFACE, .type = TUSB_REQ_TYPE_CLASS, .direction = TUSB_DIR_IN },
         .bRequest = MSC_REQ_GET_MAX_LUN,
         .wValue = 0,
-        .wIndex = p_msc->itf_numr,
+        .wIndex = itf_num,
         .wLength = 1
   };
-  // TODO STALL means zero
-  TU_ASSERT( usbh_control_xfer( dev_addr, &request, msch_buffer ) );
-  p_msc->max_lun = msch_buffer[0];
-
-#if 0
-  //------------- Reset -------------//
-  request = (tusb_control_request_t) {
-        .bmRequestType_bit = { .recipient = TUSB_REQ_RCPT_INTERFACE, .type = TUSB_REQ_TYPE_CLASS, .direction = TUSB_DIR_OUT },
-        .bRequest = MSC_REQ_RESET,
-        .wValue = 0,
-        .wIndex = p_msc->itf_numr,
-        .wLength = 0
-  };
-  TU_ASSERT( usbh_control_xfer( dev_addr, &request, NULL ) );
-#endif
-
-  enum { SCSI_XFER_TIMEOUT = 2000 };
-  //------------- SCSI Inquiry -------------//
-  tusbh_msc_inquiry(dev_addr, 0, msch_buffer);
-  TU_ASSERT( osal_semaphore_wait(msch_sem_hdl, SCSI_XFER_TIMEOUT) );
 
-  memcpy(p_msc->vendor_id , ((scsi_inquiry_resp_t*) msch_buffer)->vendor_id , 8);
-  memcpy(p_msc->product_id, ((scsi_inquiry_resp_t*) msch_buffer)->product_id, 16);
+  msch_buffer[0] = 0;
+  TU_VERIFY( tuh_control_xfer(dev_addr, &request, msch_buffer, msch_get_max_lun_complete) );
 
-  //------------- SCSI Read Capacity 10 -------------//
-  tusbh_msc_read_capacity10(dev_addr, 0, msch_buffer);
-  TU_ASSERT( osal_semaphore_wait(msch_sem_hdl, SCSI_XFER_TIMEOUT));
-
-  // NOTE: my toshiba thumb-drive stall the first Read Capacity and require the sequence
-  // Read Capacity --> Stalled --> Clear Stall --> Request Sense --> Read Capacity (2) to work
-  if ( hcd_edpt_stalled(dev_addr, p_msc->ep_in) )
-  {
-    // clear stall TODO abstract clear stall function
-    request = (tusb_control_request_t) {
-      .bmRequestType_bit = { .recipient = TUSB_REQ_RCPT_ENDPOINT, .type = TUSB_REQ_TYPE_STANDARD, .direction = TUSB_DIR_OUT },
-          .bRequest = TUSB_REQ_CLEAR_FEATURE,
-          .wValue = 0,
-          .wIndex = p_msc->ep_in,
-          .wLength = 0
-    };
-
-    TU_ASSERT(usbh_control_xfer( dev_addr, &request, NULL ));
-
-    hcd_edpt_clear_stall(dev_addr, p_msc->ep_in);
-    TU_ASSERT( osal_semaphore_wait(msch_sem_hdl, SCSI_XFER_TIMEOUT) ); // wait for SCSI status
+  msch_data[dev_addr-1].open_stage = MSCH_OPEN_INQUIRY; // set_config in progress
 
-    //------------- SCSI Request Sense -------------//
-    (void) tuh_msc_request_sense(dev_addr, 0, msch_buffer);
-    TU_ASSERT(osal_semaphore_wait(msch_sem_hdl, SCSI_XFER_TIMEOUT));
-
-    //------------- Re-read SCSI Read Capactity -------------//
-    tusbh_msc_read_capacity10(dev_addr, 0, msch_buffer);
-    TU_ASSERT(osal_semaphore_wait(msch_sem_hdl, SCSI_XFER_TIMEOUT));
-  }
+  return true;
+}
 
-  p_msc->last_lba   = tu_ntohl( ((scsi_read_capacity10_resp_t*)msch_buffer)->last_lba );
-  p_msc->block_size = (uint16_t) tu_ntohl( ((scsi_read_capacity10_resp_t*)msch_buffer)->block_size );
+// Commands issued by set_config complete in tuh_task(), queued ones may complete in isr
+bool msch_xfer_isr_cb(uint8_t dev_addr, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes)
+{
+  (void) xferred_bytes;
 
-  p_msc->is_initialized = true;
+  msch_interface_t* p_msc = &msch_data[dev_addr-1];
+  if ( !p_msc->is_initialized || p_msc->q_done >= p_msc->q_count ) return false;
 
-  tuh_msc_mounted_cb(dev_addr);
+  // queued commands: one pending event is enough for tuh_task to invoke all completed callbacks
+  uint8_t const done = p_msc->q_done;
+  msch_queue_xfer_isr(dev_addr, p_msc, ep_addr, event);
+  if ( done == p_msc->q_done || p_msc->q_notify ) return true;
 
-  return true;
+  p_msc->q_notify = true;
+  return false;
 }
 
-void msch_isr(uint8_t dev_addr, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes)
+void msch_xfer_cb(uint8_t dev_addr, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes)
 {
   msch_interface_t* p_msc = &msch_data[dev_addr-1];
-  if ( ep_addr == p_msc->ep_in )
+
+  if ( !p_msc->is_initialized )
   {
-    if (p_msc->is_initialized)
-    {
-      tuh_msc_isr(dev_addr, event, xferred_bytes);
-    }else
-    { // still initializing under open subtask
-      osal_semaphore_post(msch_sem_hdl, true);
-    }
+    if ( ep_addr == p_msc->ep_in ) msch_open_xfer_cb(dev_addr, p_msc, event);
+    return;
+  }
+
+  if ( p_msc->q_notify )
+  {
+    msch_queue_complete(dev_addr, p_msc);
+  }else if ( ep_addr == p_msc->ep_in )
+  {
+    tuh_msc_isr(dev_addr, event, xferred_bytes);
   }
 }
 
 void msch_close(uint8_t dev_addr)
 {
+  bool const mounted = msch_data[dev_addr-1].is_initialized;
   tu_memclr(&msch_data[dev_addr-1], sizeof(msch_interface_t));
-  osal_semaphore_reset(msch_sem_hdl);
 
-  tuh_msc_unmounted_cb(dev_addr); // invoke Application Callback
+  if ( mounted ) tuh_msc_unmounted_cb(dev_addr); // invoke Application Callback
 }
 
 //--------------------------------------------------------------------+
@@ -85,10 +85,41 @@ uint8_t const* tuh_msc_get_product_name(uint8_t dev_addr);
  * \retval      pointer to product's name or NULL if specified device does not support MassStorage
  * \note        MassStorage's capacity can be computed by last LBA x block size (in bytes). During enumeration, the stack has already
  *              retrieved (via SCSI READ CAPACITY 10) and store this information internally. There is no need for application
- *              to re-send SCSI READ CAPACITY 10 command
+ *              to re-send SCSI READ CAPACITY 10 command. Last LBA is capped at 32-bit, see \ref tuh_msc_get_lun_capacity
  */
 tusb_error_t tuh_msc_get_capacity(uint8_t dev_addr, uint32_t* p_last_lba, uint32_t* p_block_size);
 
+/** \brief      Get number of Logical Units of MassStorage device
+ * \param[in]   dev_addr device address
+ * \return      number of LUNs (up to \ref CFG_TUH_MSC_MAXLUN), or zero if device is not mounted
+ * \note        Retrieved by GET MAX LUN during enumeration
+ */
+uint8_t tuh_msc_get_lun_count(uint8_t dev_addr);
+
+/** \brief      Get SCSI vendor's name of a Logical Unit, see \ref tuh_msc_get_vendor_name
+ * \param[in]   dev_addr device address
+ * \param[in]   lun      Logical Unit
+ * \return      pointer to vendor's name or NULL if lun is not valid or device is not mounted
+ */
+uint8_t const* tuh_msc_get_lun_vendor_name(uint8_t dev_addr, uint8_t lun);
+
+/** \brief      Get SCSI product's name of a Logical Unit, see \ref tuh_msc_get_product_name
+ * \param[in]   dev_addr device address
+ * \param[in]   lun      Logical Unit
+ * \return      pointer to product's name or NULL if lun is not valid or device is not mounted
+ */
+uint8_t const* tuh_msc_get_lun_product_name(uint8_t dev_addr, uint8_t lun);
+
+/** \brief      Get SCSI Capacity of a Logical Unit, see \ref tuh_msc_get_capacity
+ * \param[in]   dev_addr device address
+ * \param[in]   lun      Logical Unit
+ * \param[out]  p_last_lba Last Logical Block Address of the unit
+ * \param[out]  p_block_size Block Size of the unit in bytes
+ * \note        Unit not ready during enumeration (e.g empty slot of card reader) is reported with zero block size.
+ *              READ CAPACITY 16 is used for units with more than 2^32 blocks
+ */
+tusb_error_t tuh_msc_get_lun_capacity(uint8_t dev_addr, uint8_t lun, uint64_t* p_last_lba, uint32_t* p_block_size);
+
 /** \brief 			Perform SCSI READ 10 command to read data from MassStorage device
  * \param[in]		dev_addr	device address
  * \param[in]		lun       Targeted Logical Unit
@@ -140,6 +171,51 @@ tusb_error_t tuh_msc_request_sense(uint8_t dev_addr, uint8_t lun, uint8_t *p_dat
  */
 tusb_error_t tuh_msc_test_unit_ready(uint8_t dev_addr, uint8_t lun, msc_csw_t * p_csw); // TODO to be refractor
 
+//------------- Queued Commands -------------//
+/** \brief      Callback function invoked when a queued command completes
+ * \param[in]   dev_addr  device address
+ * \param[in]   cbw       Command Block Wrapper of the last command sent for the request
+ * \param[in]   csw       Command Status Wrapper received from device, only valid if result is XFER_RESULT_SUCCESS
+ * \param[in]   result    USB transport result. Command status is reported by csw->status
+ * \note        Invoked within tuh_task(), the next queued command is already in progress
+ */
+typedef void (*tuh_msc_complete_cb_t)(uint8_t dev_addr, msc_cbw_t const* cbw, msc_csw_t const* csw, xfer_result_t result);
+
+/** \brief      Queue a read request, up to \ref CFG_TUH_MSC_QUEUE requests can be queued per device
+ * \param[in]   dev_addr    device address
+ * \param[in]   lun         Targeted Logical Unit
+ * \param[out]  p_buffer    Buffer used to store data read from device. Must be accessible by USB controller and
+ *                          remains in use until complete_cb is invoked
+ * \param[in]   lba         Starting Logical Block Address to be read
+ * \param[in]   block_count Number of Block to be read
+ * \param[in]   complete_cb Callback invoked when request completes, can be NULL
+ * \retval      true if request is queued
+ * \retval      false if device is not mounted, queue is full or a non-queued command is in progress
+ * \note        Request is sent as READ 10, or READ 16 if lba or block count does not fit, and is split into several commands
+ *              of at most \ref CFG_TUH_MSC_MAX_XFER_SIZE bytes (or the unit's Maximum Transfer Length).
+ * \note        Requests are executed in submitted order across all logical units. CBW of the next command is sent as soon
+ *              as the CSW of the previous one is received. A failed request aborts all requests queued after it, application
+ *              should recover the device (e.g clear stall) before queuing more. Must not be mixed with tuh_msc_read10()/tuh_msc_write10()
+ */
+bool tuh_msc_read_queue(uint8_t dev_addr, uint8_t lun, void * p_buffer, uint64_t lba, uint32_t block_count, tuh_msc_complete_cb_t complete_cb);
+
+/** \brief      Queue a write request (WRITE 10 or WRITE 16), see \ref tuh_msc_read_queue
+ * \param[in]   dev_addr    device address
+ * \param[in]   lun         Targeted Logical Unit
+ * \param[in]   p_buffer    Buffer containing data. Must be accessible by USB controller and remains in use until complete_cb is invoked
+ * \param[in]   lba         Starting Logical Block Address to be written
+ * \param[in]   block_count Number of Block to be written
+ * \param[in]   complete_cb Callback invoked when command completes, can be NULL
+ * \retval      true if command is queued
+ * \retval      false if device is not mounted, queue is full or a non-queued command is in progress
+ */
+bool tuh_msc_write_queue(uint8_t dev_addr, uint8_t lun, void const * p_buffer, uint64_t lba, uint32_t block_count, tuh_msc_complete_cb_t complete_cb);
+
+/** \brief      Number of queued commands whose callback is not invoked yet
+ * \param[in]   dev_addr device address
+ */
+uint8_t tuh_msc_queue_count(uint8_t dev_addr);
+
 //tusb_error_t  tusbh_msc_scsi_send(uint8_t dev_addr, uint8_t lun, bool is_direction_in,
 //                                  uint8_t const * p_command, uint8_t cmd_len,
 //                                  uint8_t * p_response, uint32_t resp_len);
@@ -173,27 +249,67 @@ void tuh_msc_isr(uint8_t dev_addr, xfer_result_t event, uint32_t xferred_bytes);
 //--------------------------------------------------------------------+
 // Internal Class Driver API
 //--------------------------------------------------------------------+
+
+// Request submitted by tuh_msc_read_queue()/tuh_msc_write_queue(), buffer/lba/block_count are of the part in progress
+typedef struct
+{
+  msc_cbw_t cbw;
+  msc_csw_t csw;
+  uint8_t* buffer;
+  uint64_t lba;
+  uint32_t block_count; // remaining including current part
+  uint32_t part_count;  // blocks of current command
+  tuh_msc_complete_cb_t complete_cb;
+  xfer_result_t result;
+}msch_cmd_t;
+
+// Inquiry and capacity retrieved when mounted
 typedef struct
 {
+  uint32_t block_size; // zero if unit is not ready
+  uint64_t last_lba;   // last logical block address
+  uint32_t max_xfer_blocks; // per command of a queued request
+  uint8_t vendor_id[8];
+  uint8_t product_id[16];
+}msch_lun_t;
+
+typedef struct
+{
+  uint8_t rhport;
   uint8_t itf_numr;
   uint8_t  ep_in;
   uint8_t  ep_out;
 
   uint8_t  max_lun;
-  uint16_t block_size;
-  uint32_t last_lba; // last logical block address
+  uint8_t  lun_count; // up to CFG_TUH_MSC_MAXLUN
+  msch_lun_t lun[CFG_TUH_MSC_MAXLUN];
 
   volatile bool is_initialized;
-  uint8_t vendor_id[8];
-  uint8_t product_id[16];
+
+  // SCSI command of lun being initialized by set_config, before is_initialized
+  uint8_t open_stage;
+  uint8_t open_lun;
+  uint8_t open_attempt;
+  uint8_t open_version;
+  bool    open_stalled; // data stage is stalled, CSW is received once endpoint is cleared
 
   msc_cbw_t cbw;
   msc_csw_t csw;
+
+  // queued commands from q_rd: q_done of them are completed (in isr) waiting for callback, the next one is in progress
+  msch_cmd_t queue[CFG_TUH_MSC_QUEUE];
+  uint32_t q_tag;
+  uint8_t q_rd;
+  uint8_t q_count;
+  volatile uint8_t q_done;
+  volatile bool q_notify; // completion event is pending for tuh_task
 }msch_interface_t;
 
 void msch_init(void);
 bool msch_open(uint8_t rhport, uint8_t dev_addr, tusb_desc_interface_t const *itf_desc, uint16_t *p_length);
-void msch_isr(uint8_t dev_addr, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes);
+bool msch_set_config(uint8_t dev_addr, uint8_t itf_num);
+void msch_xfer_cb(uint8_t dev_addr, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes);
+bool msch_xfer_isr_cb(uint8_t dev_addr, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes);
 void msch_close(uint8_t dev_addr);
 
 #ifdef __cplusplus
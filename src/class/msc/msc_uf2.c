@@ -0,0 +1,415 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#include "tusb_option.h"
+
+#if (TUSB_OPT_DEVICE_ENABLED && CFG_TUD_MSC && CFG_TUD_MSC_UF2)
+
+#include "common/tusb_common.h"
+#include "msc_uf2.h"
+
+//--------------------------------------------------------------------+
+// MACRO CONSTANT TYPEDEF
+//--------------------------------------------------------------------+
+
+#define UF2_MAGIC_START0        0x0A324655UL // "UF2\n"
+#define UF2_MAGIC_START1        0x9E5D5157UL
+#define UF2_MAGIC_END           0x0AB16F30UL
+
+#define UF2_FLAG_NOT_MAIN_FLASH 0x00000001UL
+#define UF2_FLAG_FAMILY_ID      0x00002000UL
+
+#define UF2_PAYLOAD_SIZE        256 // of CURRENT.UF2 blocks
+
+typedef struct TU_ATTR_PACKED
+{
+  uint32_t magic_start0;
+  uint32_t magic_start1;
+  uint32_t flags;
+  uint32_t target_addr;
+  uint32_t payload_size;
+  uint32_t block_no;
+  uint32_t num_blocks;
+  uint32_t family_id; // or file size
+  uint8_t  data[476];
+  uint32_t magic_end;
+} uf2_block_t;
+
+TU_VERIFY_STATIC(sizeof(uf2_block_t) == 512, "size is not correct");
+
+// Volume layout: boot sector, 2 FATs, root directory then data area with 1 sector per cluster
+enum
+{
+  SECTOR_SIZE      = 512,
+  FAT_SECTORS      = (CFG_TUD_MSC_UF2_BLOCK_COUNT + 255) / 256, // 16-bit entry for every sector
+  ROOT_ENTRIES     = 64,
+  ROOT_SECTORS     = ROOT_ENTRIES * 32 / SECTOR_SIZE,
+  FAT0_START       = 1,
+  ROOT_START       = FAT0_START + 2*FAT_SECTORS,
+  DATA_START       = ROOT_START + ROOT_SECTORS,
+  CLUSTER_COUNT    = CFG_TUD_MSC_UF2_BLOCK_COUNT - DATA_START,
+};
+
+#define CURRENT_UF2_SIZE   (2*CFG_TUD_MSC_UF2_FLASH_SIZE)
+
+TU_VERIFY_STATIC(CLUSTER_COUNT >= 4085, "Too few clusters for FAT16");
+TU_VERIFY_STATIC(CURRENT_UF2_SIZE/SECTOR_SIZE + 2 < CLUSTER_COUNT/2, "Volume is too small for CURRENT.UF2");
+
+static char const _info_txt[] = CFG_TUD_MSC_UF2_INFO;
+TU_VERIFY_STATIC(sizeof(_info_txt) - 1 <= SECTOR_SIZE, "INFO_UF2.TXT must fit in a sector");
+
+#ifdef CFG_TUD_MSC_UF2_INDEX_URL
+static char const _index_htm[] =
+  "<!doctype html>\n<html><body><script>\nlocation.replace(\"" CFG_TUD_MSC_UF2_INDEX_URL "\");\n</script></body></html>\n";
+TU_VERIFY_STATIC(sizeof(_index_htm) - 1 <= SECTOR_SIZE, "INDEX.HTM must fit in a sector");
+#endif
+
+// Files in root directory, with consecutive clusters in this order from cluster 2
+typedef struct
+{
+  char const name[11];
+  char const* content; // NULL for CURRENT.UF2
+  uint32_t size;
+} uf2_file_t;
+
+static uf2_file_t const _files[] =
+{
+  { "INFO_UF2TXT", _info_txt, sizeof(_info_txt) - 1 },
+#ifdef CFG_TUD_MSC_UF2_INDEX_URL
+  { "INDEX   HTM", _index_htm, sizeof(_index_htm) - 1 },
+#endif
+#if CFG_TUD_MSC_UF2_FLASH_SIZE
+  { "CURRENT UF2", NULL, CURRENT_UF2_SIZE },
+#endif
+};
+
+enum { FILE_COUNT = TU_ARRAY_SIZE(_files) };
+
+// Written UF2 file being tracked, and flash write continuing in background
+typedef struct
+{
+  uint32_t num_blocks;
+  uint32_t written;
+  uint8_t  block_map[(CFG_TUD_MSC_UF2_MAX_BLOCKS + 7) / 8];
+
+  bool     async;
+  uint8_t  async_lun;
+  uint32_t async_nbytes; // write10 return value once done
+  uint32_t async_block_no;
+  uint32_t async_num_blocks;
+} uf2_state_t;
+
+static uf2_state_t _uf2;
+
+//--------------------------------------------------------------------+
+// Virtual FAT
+//--------------------------------------------------------------------+
+
+static inline void put_u16(uint8_t* p, uint16_t value)
+{
+  p[0] = tu_u16_low(value);
+  p[1] = tu_u16_high(value);
+}
+
+static inline void put_u32(uint8_t* p, uint32_t value)
+{
+  put_u16(p, (uint16_t) value);
+  put_u16(p+2, (uint16_t) (value >> 16));
+}
+
+static inline uint32_t file_clusters(uf2_file_t const* file)
+{
+  return (file->size + SECTOR_SIZE - 1) / SECTOR_SIZE;
+}
+
+// File having cluster, NULL if it is free. first is set to its first cluster
+static uf2_file_t const* cluster_file(uint32_t cluster, uint32_t* first)
+{
+  uint32_t start = 2;
+  for(uint8_t i=0; i<FILE_COUNT; i++)
+  {
+    uint32_t const count = file_clusters(&_files[i]);
+    if ( cluster >= start && cluster < start + count )
+    {
+      *first = start;
+      return &_files[i];
+    }
+    start += count;
+  }
+  return NULL;
+}
+
+static uint16_t fat_entry(uint32_t cluster)
+{
+  if ( cluster == 0 ) return 0xFFF8; // media descriptor
+  if ( cluster == 1 ) return 0xFFFF;
+
+  uint32_t first;
+  uf2_file_t const* file = cluster_file(cluster, &first);
+  if ( !file ) return 0;
+
+  // chain to next cluster, end of chain for the last one
+  return (cluster + 1 < first + file_clusters(file)) ? (uint16_t) (cluster + 1) : 0xFFFF;
+}
+
+static void boot_sector(uint8_t* buf)
+{
+  static uint8_t const jump_oem[11] = { 0xEB, 0x3C, 0x90, 'U', 'F', '2', ' ', 'U', 'F', '2', ' ' };
+  memcpy(buf, jump_oem, sizeof(jump_oem));
+
+  put_u16(buf+11, SECTOR_SIZE);
+  buf[13] = 1;                          // sectors per cluster
+  put_u16(buf+14, 1);                   // reserved sectors
+  buf[16] = 2;                          // number of FATs
+  put_u16(buf+17, ROOT_ENTRIES);
+  put_u16(buf+19, CFG_TUD_MSC_UF2_BLOCK_COUNT);
+  buf[21] = 0xF8;                       // fixed disk
+  put_u16(buf+22, FAT_SECTORS);
+  put_u16(buf+24, 1);                   // sectors per track
+  put_u16(buf+26, 1);                   // heads
+  buf[36] = 0x80;                       // drive number
+  buf[38] = 0x29;                       // extended boot signature
+  put_u32(buf+39, 0x00420042);          // volume serial number
+
+  memset(buf+43, ' ', 11);
+  memcpy(buf+43, CFG_TUD_MSC_UF2_VOLUME_LABEL, tu_min32(sizeof(CFG_TUD_MSC_UF2_VOLUME_LABEL) - 1, 11));
+  memcpy(buf+54, "FAT16   ", 8);
+
+  buf[510] = 0x55;
+  buf[511] = 0xAA;
+}
+
+static void dir_entry(uint8_t* entry, char const name[11], uint8_t attr, uint16_t cluster, uint32_t size)
+{
+  uint16_t const date = (uint16_t) (((2019 - 1980) << 9) | (1 << 5) | 1);
+
+  memcpy(entry, name, 11);
+  entry[11] = attr;
+  put_u16(entry+16, date); // created
+  put_u16(entry+18, date); // accessed
+  put_u16(entry+24, date); // modified
+  put_u16(entry+26, cluster);
+  put_u32(entry+28, size);
+}
+
+static void root_sector(uint8_t* buf)
+{
+  char label[11];
+  memset(label, ' ', sizeof(label));
+  memcpy(label, CFG_TUD_MSC_UF2_VOLUME_LABEL, tu_min32(sizeof(CFG_TUD_MSC_UF2_VOLUME_LABEL) - 1, 11));
+  dir_entry(buf, label, 0x08, 0, 0);
+
+  uint16_t cluster = 2;
+  for(uint8_t i=0; i<FILE_COUNT; i++)
+  {
+    dir_entry(buf + 32*(i+1), _files[i].name, 0x01, cluster, _files[i].size); // read-only
+    cluster = (uint16_t) (cluster + file_clusters(&_files[i]));
+  }
+}
+
+#if CFG_TUD_MSC_UF2_FLASH_SIZE
+// Block of CURRENT.UF2 with UF2_PAYLOAD_SIZE bytes of flash
+static void current_uf2_block(uint32_t block_no, uint8_t* buf)
+{
+  uf2_block_t* block = (uf2_block_t*) buf;
+
+  block->magic_start0 = UF2_MAGIC_START0;
+  block->magic_start1 = UF2_MAGIC_START1;
+  block->flags        = CFG_TUD_MSC_UF2_FAMILY_ID ? UF2_FLAG_FAMILY_ID : 0;
+  block->target_addr  = CFG_TUD_MSC_UF2_FLASH_BASE + block_no*UF2_PAYLOAD_SIZE;
+  block->payload_size = UF2_PAYLOAD_SIZE;
+  block->block_no     = block_no;
+  block->num_blocks   = CFG_TUD_MSC_UF2_FLASH_SIZE / UF2_PAYLOAD_SIZE;
+  block->family_id    = CFG_TUD_MSC_UF2_FAMILY_ID;
+  block->magic_end    = UF2_MAGIC_END;
+
+  if ( tud_msc_uf2_flash_read_cb ) tud_msc_uf2_flash_read_cb(block->target_addr, block->data, UF2_PAYLOAD_SIZE);
+}
+#endif
+
+static void sector_read(uint32_t lba, uint8_t* buf)
+{
+  memset(buf, 0, SECTOR_SIZE);
+
+  if ( lba == 0 )
+  {
+    boot_sector(buf);
+  }
+  else if ( lba < ROOT_START )
+  {
+    // both FATs are the same
+    uint32_t const first = ((lba - FAT0_START) % FAT_SECTORS) * (SECTOR_SIZE/2);
+    for(uint32_t i=0; i<SECTOR_SIZE/2; i++) put_u16(buf + 2*i, fat_entry(first + i));
+  }
+  else if ( lba < DATA_START )
+  {
+    if ( lba == ROOT_START ) root_sector(buf);
+  }
+  else
+  {
+    uint32_t const cluster = lba - DATA_START + 2;
+    uint32_t first;
+    uf2_file_t const* file = cluster_file(cluster, &first);
+    if ( !file ) return;
+
+    if ( file->content )
+    {
+      memcpy(buf, file->content, file->size);
+    }
+#if CFG_TUD_MSC_UF2_FLASH_SIZE
+    else
+    {
+      current_uf2_block(cluster - first, buf);
+    }
+#endif
+  }
+}
+
+//--------------------------------------------------------------------+
+// UF2 write
+//--------------------------------------------------------------------+
+
+static bool block_valid(uf2_block_t const* block)
+{
+  TU_VERIFY(block->magic_start0 == UF2_MAGIC_START0 && block->magic_start1 == UF2_MAGIC_START1 &&
+            block->magic_end == UF2_MAGIC_END);
+  TU_VERIFY(!(block->flags & UF2_FLAG_NOT_MAIN_FLASH));
+  TU_VERIFY(block->payload_size <= sizeof(block->data) && block->block_no < block->num_blocks);
+
+#if CFG_TUD_MSC_UF2_FAMILY_ID
+  TU_VERIFY(!(block->flags & UF2_FLAG_FAMILY_ID) || block->family_id == CFG_TUD_MSC_UF2_FAMILY_ID);
+#endif
+
+#if CFG_TUD_MSC_UF2_FLASH_SIZE
+  TU_VERIFY(block->target_addr >= CFG_TUD_MSC_UF2_FLASH_BASE &&
+            block->target_addr - CFG_TUD_MSC_UF2_FLASH_BASE + block->payload_size <= CFG_TUD_MSC_UF2_FLASH_SIZE);
+#endif
+
+  return true;
+}
+
+// Record a programmed block, complete callback once all blocks of the file are there
+static void block_written(uint32_t block_no, uint32_t num_blocks)
+{
+  if ( num_blocks > CFG_TUD_MSC_UF2_MAX_BLOCKS ) return;
+
+  // a new file
+  if ( num_blocks != _uf2.num_blocks )
+  {
+    tu_memclr(_uf2.block_map, sizeof(_uf2.block_map));
+    _uf2.num_blocks = num_blocks;
+    _uf2.written    = 0;
+  }
+
+  uint8_t* map = &_uf2.block_map[block_no / 8];
+  uint8_t const mask = (uint8_t) TU_BIT(block_no % 8);
+  if ( *map & mask ) return;
+
+  *map |= mask;
+  _uf2.written++;
+
+  if ( _uf2.written == num_blocks )
+  {
+    // same file may be copied again
+    tu_memclr(_uf2.block_map, sizeof(_uf2.block_map));
+    _uf2.written = 0;
+
+    if ( tud_msc_uf2_complete_cb ) tud_msc_uf2_complete_cb(num_blocks);
+  }
+}
+
+//--------------------------------------------------------------------+
+// Application API
+//--------------------------------------------------------------------+
+
+void tud_msc_uf2_capacity(tud_msc_lba_t* block_count, uint16_t* block_size)
+{
+  *block_count = CFG_TUD_MSC_UF2_BLOCK_COUNT;
+  *block_size  = SECTOR_SIZE;
+}
+
+int32_t tud_msc_uf2_read10(tud_msc_lba_t lba, uint32_t offset, void* buffer, uint32_t bufsize)
+{
+  TU_ASSERT((offset % SECTOR_SIZE) == 0 && (bufsize % SECTOR_SIZE) == 0, -1);
+
+  uint32_t sector = (uint32_t) lba + offset / SECTOR_SIZE;
+  uint8_t* buf = (uint8_t*) buffer;
+
+  for(uint32_t i=0; i < bufsize; i += SECTOR_SIZE)
+  {
+    TU_ASSERT(sector < CFG_TUD_MSC_UF2_BLOCK_COUNT, -1);
+    sector_read(sector++, buf + i);
+  }
+
+  return (int32_t) bufsize;
+}
+
+int32_t tud_msc_uf2_write10(uint8_t lun, tud_msc_lba_t lba, uint32_t offset, uint8_t* buffer, uint32_t bufsize)
+{
+  (void) lba;
+
+  TU_ASSERT((offset % SECTOR_SIZE) == 0 && (bufsize % SECTOR_SIZE) == 0, -1);
+  TU_VERIFY(!_uf2.async, 0);
+
+  // FAT and directory updates of host are ignored, UF2 blocks are recognized wherever they are written
+  for(uint32_t i=0; i < bufsize; i += SECTOR_SIZE)
+  {
+    uf2_block_t const* block = (uf2_block_t const*) (buffer + i);
+    if ( !block_valid(block) ) continue;
+
+    int32_t const ret = tud_msc_uf2_flash_write_cb(block->target_addr, block->data, block->payload_size);
+
+    if ( ret == TUD_MSC_RET_ASYNC )
+    {
+      _uf2.async            = true;
+      _uf2.async_lun        = lun;
+      _uf2.async_nbytes     = i + SECTOR_SIZE;
+      _uf2.async_block_no   = block->block_no;
+      _uf2.async_num_blocks = block->num_blocks;
+      return TUD_MSC_RET_ASYNC;
+    }
+
+    // busy: sectors before this one are done, invoked again for the rest
+    if ( ret == 0 ) return (int32_t) i;
+    if ( ret < 0 ) return ret;
+
+    block_written(block->block_no, block->num_blocks);
+  }
+
+  return (int32_t) bufsize;
+}
+
+bool tud_msc_uf2_flash_write_done(bool success, bool in_isr)
+{
+  TU_VERIFY(_uf2.async);
+  _uf2.async = false;
+
+  if ( success ) block_written(_uf2.async_block_no, _uf2.async_num_blocks);
+
+  return tud_msc_async_io_done(_uf2.async_lun, success ? (int32_t) _uf2.async_nbytes : -1, in_isr);
+}
+
+#endif
@@ -0,0 +1,134 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#ifndef _TUSB_MSC_UF2_H_
+#define _TUSB_MSC_UF2_H_
+
+#include "common/tusb_common.h"
+#include "msc_device.h"
+
+//--------------------------------------------------------------------+
+// Configuration
+//--------------------------------------------------------------------+
+
+#if !CFG_TUD_MSC
+  #error CFG_TUD_MSC_UF2 requires CFG_TUD_MSC, it is a backend of tud_msc_read10_cb()/tud_msc_write10_cb()
+#endif
+
+// Each UF2 block is a 512-byte sector, whole sectors are passed to the backend
+TU_VERIFY_STATIC(CFG_TUD_MSC_BUFSIZE >= 512 && (CFG_TUD_MSC_BUFSIZE % 512) == 0, "CFG_TUD_MSC_BUFSIZE must be multiple of 512");
+
+// Size of the FAT16 volume in 512-byte sectors, one sector per cluster. Host may write UF2 files of
+// about half of it (FAT and directory updates are ignored).
+#ifndef CFG_TUD_MSC_UF2_BLOCK_COUNT
+  #define CFG_TUD_MSC_UF2_BLOCK_COUNT   16384
+#endif
+
+// Flash accepted from UF2 blocks and shown as CURRENT.UF2 (with tud_msc_uf2_flash_read_cb), size 0 for any
+// address and no CURRENT.UF2
+#ifndef CFG_TUD_MSC_UF2_FLASH_BASE
+  #define CFG_TUD_MSC_UF2_FLASH_BASE    0
+#endif
+
+#ifndef CFG_TUD_MSC_UF2_FLASH_SIZE
+  #define CFG_TUD_MSC_UF2_FLASH_SIZE    0
+#endif
+
+// Accepted familyID of blocks having one, 0 to accept any
+#ifndef CFG_TUD_MSC_UF2_FAMILY_ID
+  #define CFG_TUD_MSC_UF2_FAMILY_ID     0
+#endif
+
+// Number of blocks of a UF2 file tracked to invoke tud_msc_uf2_complete_cb(), 1 bit of RAM each
+#ifndef CFG_TUD_MSC_UF2_MAX_BLOCKS
+  #define CFG_TUD_MSC_UF2_MAX_BLOCKS    1024
+#endif
+
+// Volume label, up to 11 characters
+#ifndef CFG_TUD_MSC_UF2_VOLUME_LABEL
+  #define CFG_TUD_MSC_UF2_VOLUME_LABEL  "UF2BOOT"
+#endif
+
+// Content of INFO_UF2.TXT, up to 512 bytes
+#ifndef CFG_TUD_MSC_UF2_INFO
+  #define CFG_TUD_MSC_UF2_INFO          "TinyUSB UF2 Bootloader\r\nModel: TinyUSB\r\nBoard-ID: TinyUSB\r\n"
+#endif
+
+// INDEX.HTM redirecting to this URL, no such file if not defined
+// #define CFG_TUD_MSC_UF2_INDEX_URL    "https://example.com/board"
+
+TU_VERIFY_STATIC(CFG_TUD_MSC_UF2_BLOCK_COUNT >= 8192 && CFG_TUD_MSC_UF2_BLOCK_COUNT <= 65535, "Volume must be FAT16 without 32-bit sector count");
+TU_VERIFY_STATIC((CFG_TUD_MSC_UF2_FLASH_SIZE % 256) == 0, "Flash size must be multiple of UF2 payload of 256 bytes");
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/** \addtogroup ClassDriver_MSC
+ *  @{
+ * \defgroup MSC_UF2 UF2 Virtual Disk
+ *  @{ */
+
+// Virtual FAT16 disk for drag and drop of UF2 files (https://github.com/microsoft/uf2). Boot sector, FAT and
+// directory sectors are generated when read, no image is kept in RAM. Written sectors holding a UF2 block are
+// programmed at their target address from the MSC buffer without copy, others are ignored. With
+// CFG_TUD_MSC_DOUBLE_BUFFER, next sectors are received while tud_msc_uf2_flash_write_cb() programs flash.
+
+//--------------------------------------------------------------------+
+// Application API, invoked from tud_msc_* callbacks of the LUN with UF2 disk
+//--------------------------------------------------------------------+
+
+void    tud_msc_uf2_capacity(tud_msc_lba_t* block_count, uint16_t* block_size);
+int32_t tud_msc_uf2_read10  (tud_msc_lba_t lba, uint32_t offset, void* buffer, uint32_t bufsize);
+int32_t tud_msc_uf2_write10 (uint8_t lun, tud_msc_lba_t lba, uint32_t offset, uint8_t* buffer, uint32_t bufsize);
+
+// Complete flash write whose callback returned TUD_MSC_RET_ASYNC, can be called from ISR
+bool    tud_msc_uf2_flash_write_done(bool success, bool in_isr);
+
+//--------------------------------------------------------------------+
+// Application Callbacks (WEAK is optional)
+//--------------------------------------------------------------------+
+
+// Program payload of a UF2 block, erasing flash as needed. Return len if done, 0 if busy (invoked again later),
+// negative on error or TUD_MSC_RET_ASYNC if it continues in background, then data must be kept intact until
+// tud_msc_uf2_flash_write_done() is called.
+int32_t tud_msc_uf2_flash_write_cb(uint32_t addr, uint8_t const* data, uint32_t len);
+
+// Read flash for CURRENT.UF2, required when CFG_TUD_MSC_UF2_FLASH_SIZE is not zero
+TU_ATTR_WEAK void tud_msc_uf2_flash_read_cb(uint32_t addr, uint8_t* data, uint32_t len);
+
+// Invoked once all blocks of a UF2 file are programmed e.g to reset into new firmware. Called from
+// tud_msc_uf2_write10() or tud_msc_uf2_flash_write_done() for the last block
+TU_ATTR_WEAK void tud_msc_uf2_complete_cb(uint32_t block_count);
+
+/** @} */
+/** @} */
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif /* _TUSB_MSC_UF2_H_ */
@@ -0,0 +1,818 @@
+/* 
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+
+#include "tusb_option.h"
+
+#if (TUSB_OPT_DEVICE_ENABLED && CFG_TUD_UAS)
+
+#include "common/tusb_common.h"
+#include "uas_device.h"
+#include "device/usbd_pvt.h"
+
+//--------------------------------------------------------------------+
+// MACRO CONSTANT TYPEDEF
+//--------------------------------------------------------------------+
+
+// Task life cycle, each IU received on command pipe takes one task until its last IU is sent
+enum
+{
+  UAS_TASK_FREE = 0,
+  UAS_TASK_RESPONSE,  // Response IU to be sent e.g task management
+  UAS_TASK_QUEUED,    // command waiting for execution
+  UAS_TASK_READY,     // Read/Write Ready IU to be sent, data phase follows
+  UAS_TASK_DATA,      // data phase in progress
+  UAS_TASK_STATUS     // Sense IU to be sent
+};
+
+enum { UAS_TASK_NONE = 0xFF };
+
+typedef struct
+{
+  uint8_t  state;
+  uint8_t  lun;
+  uint8_t  seq;       // arrival order
+  uint8_t  status;    // SCSI status of Sense IU, or response code of Response IU
+  uint16_t tag;       // big endian as received
+  uint8_t  cdb[16];
+  uint8_t  sense[18];
+}uasd_task_t;
+
+typedef struct
+{
+  CFG_TUSB_MEM_ALIGN uas_cmd_iu_t cmd_iu;
+
+  CFG_TUSB_MEM_ALIGN union
+  {
+    uas_sense_iu_t    sense;
+    uas_response_iu_t response;
+    uas_ready_iu_t    ready;
+  }stat_iu;
+
+  uint8_t  rhport;
+  uint8_t  itf_num;
+  uint8_t  ep_cmd;
+  uint8_t  ep_stat;
+  uint8_t  ep_in;
+  uint8_t  ep_out;
+
+  bool     cmd_armed;   // command pipe is waiting for next IU
+  bool     retry_pending;
+  uint8_t  stat_task;   // task whose IU is on status pipe
+  uint8_t  data_task;   // task owning data pipes
+  uint8_t  seq;
+  uint16_t cur_tag;
+
+  // data phase of data_task
+  bool     is_rdwr;
+  bool     is_write;
+  bool     failed;      // data-in is terminated by short packet, Sense IU follows
+  uint64_t lba;
+  uint32_t block_size;
+  uint32_t total_len;
+  uint32_t xferred_len;
+  uint16_t buf_len;     // READ: bytes in buffer, WRITE: bytes received
+  uint16_t buf_off;     // WRITE: bytes of buffer written to storage
+
+  uasd_task_t task[CFG_TUD_UAS_QUEUE_DEPTH];
+}uasd_interface_t;
+
+CFG_TUSB_MEM_SECTION CFG_TUSB_MEM_ALIGN static uasd_interface_t _uasd_itf;
+CFG_TUSB_MEM_SECTION CFG_TUSB_MEM_ALIGN static uint8_t _uasd_buf[CFG_TUD_MSC_BUFSIZE];
+
+//--------------------------------------------------------------------+
+// INTERNAL OBJECT & FUNCTION DECLARATION
+//--------------------------------------------------------------------+
+static void uas_process(uint8_t rhport, uasd_interface_t* p_uas);
+static void uas_retry(void* param);
+
+static inline uint8_t get_max_lun(void)
+{
+  return tud_msc_get_maxlun_cb ? tud_msc_get_maxlun_cb() : 1;
+}
+
+// Parameter list length of data-out commands other than WRITE, zero if command has no data-out
+static uint32_t data_out_len(uint8_t const cdb[16])
+{
+  switch ( cdb[0] )
+  {
+    case SCSI_CMD_MODE_SELECT_6 : return cdb[4];
+    case SCSI_CMD_MODE_SELECT_10: return tu_u16(cdb[7], cdb[8]);
+    case SCSI_CMD_UNMAP         : return tu_u16(cdb[7], cdb[8]);
+    default: return 0;
+  }
+}
+
+//--------------------------------------------------------------------+
+// APPLICATION API
+//--------------------------------------------------------------------+
+uint16_t tud_uas_tag(void)
+{
+  return _uasd_itf.cur_tag;
+}
+
+//--------------------------------------------------------------------+
+// USBD Driver API
+//--------------------------------------------------------------------+
+static void uas_clear(uasd_interface_t* p_uas)
+{
+  tu_memclr(p_uas, sizeof(uasd_interface_t));
+  p_uas->stat_task = UAS_TASK_NONE;
+  p_uas->data_task = UAS_TASK_NONE;
+}
+
+void uasd_init(void)
+{
+  uas_clear(&_uasd_itf);
+}
+
+void uasd_reset(uint8_t rhport)
+{
+  (void) rhport;
+  uas_clear(&_uasd_itf);
+}
+
+bool uasd_open(uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t *p_len, uint8_t *p_inst)
+{
+  (void) p_inst;
+
+  // BOT is handled by MSC driver
+  TU_VERIFY(MSC_SUBCLASS_SCSI == itf_desc->bInterfaceSubClass &&
+            MSC_PROTOCOL_UAS  == itf_desc->bInterfaceProtocol);
+  TU_ASSERT(4 == itf_desc->bNumEndpoints);
+
+  uasd_interface_t * p_uas = &_uasd_itf;
+  TU_ASSERT(p_uas->ep_cmd == 0);
+
+  p_uas->rhport  = rhport;
+  p_uas->itf_num = itf_desc->bInterfaceNumber;
+
+  uint8_t const * p_desc = tu_desc_next(itf_desc);
+  (*p_len) = sizeof(tusb_desc_interface_t);
+
+  // Each endpoint is followed by Pipe Usage descriptor telling its role
+  for(uint8_t i=0; i<4; i++)
+  {
+    tusb_desc_endpoint_t const * desc_ep = (tusb_desc_endpoint_t const *) p_desc;
+    TU_ASSERT(TUSB_DESC_ENDPOINT == desc_ep->bDescriptorType && TUSB_XFER_BULK == desc_ep->bmAttributes.xfer);
+    TU_ASSERT(dcd_edpt_open(rhport, desc_ep));
+
+    p_desc = tu_desc_next(p_desc);
+    TU_ASSERT(UAS_DESC_PIPE_USAGE == tu_desc_type(p_desc));
+
+    switch ( p_desc[2] )
+    {
+      case UAS_PIPE_COMMAND : p_uas->ep_cmd  = desc_ep->bEndpointAddress; break;
+      case UAS_PIPE_STATUS  : p_uas->ep_stat = desc_ep->bEndpointAddress; break;
+      case UAS_PIPE_DATA_IN : p_uas->ep_in   = desc_ep->bEndpointAddress; break;
+      case UAS_PIPE_DATA_OUT: p_uas->ep_out  = desc_ep->bEndpointAddress; break;
+      default: TU_ASSERT(false);
+    }
+
+    (*p_len) = (uint16_t) (*p_len + sizeof(tusb_desc_endpoint_t) + tu_desc_len(p_desc));
+    p_desc = tu_desc_next(p_desc);
+  }
+
+  TU_ASSERT(p_uas->ep_cmd && p_uas->ep_stat && p_uas->ep_in && p_uas->ep_out);
+
+  // Prepare for first IU
+  uas_process(rhport, p_uas);
+
+  return true;
+}
+
+// UAS has no class request, Bulk-Only Mass Storage Reset and Get Max LUN are BOT only
+bool uasd_control_request(uint8_t rhport, tusb_control_request_t const * p_request)
+{
+  (void) rhport;
+  (void) p_request;
+  return false;
+}
+
+bool uasd_control_complete(uint8_t rhport, tusb_control_request_t const * request)
+{
+  (void) rhport;
+  (void) request;
+  return true;
+}
+
+//--------------------------------------------------------------------+
+// Task
+//--------------------------------------------------------------------+
+
+// Oldest task in given state, skipping ones in mask
+static uint8_t task_oldest(uasd_interface_t* p_uas, uint8_t state, uint32_t skip_mask)
+{
+  uint8_t idx = UAS_TASK_NONE;
+  uint8_t max_age = 0;
+
+  for(uint8_t i=0; i<CFG_TUD_UAS_QUEUE_DEPTH; i++)
+  {
+    uint8_t const age = (uint8_t) (p_uas->seq - p_uas->task[i].seq);
+
+    if ( (p_uas->task[i].state == state) && !tu_bit_test(skip_mask, i) &&
+         (idx == UAS_TASK_NONE || age > max_age) )
+    {
+      idx     = i;
+      max_age = age;
+    }
+  }
+
+  return idx;
+}
+
+static uint8_t task_find(uasd_interface_t* p_uas, uint16_t tag)
+{
+  for(uint8_t i=0; i<CFG_TUD_UAS_QUEUE_DEPTH; i++)
+  {
+    uasd_task_t const * task = &p_uas->task[i];
+    if ( (task->state >= UAS_TASK_QUEUED) && (task->tag == tag) ) return i;
+  }
+
+  return UAS_TASK_NONE;
+}
+
+// Task can be dropped if it is neither on the wire nor executing
+static inline bool task_abortable(uasd_interface_t* p_uas, uint8_t idx)
+{
+  uint8_t const state = p_uas->task[idx].state;
+  return (idx != p_uas->stat_task) && (state == UAS_TASK_QUEUED || state == UAS_TASK_STATUS);
+}
+
+// Command is done, Sense IU follows
+static void task_complete(uasd_interface_t* p_uas, uint8_t idx, bool failed)
+{
+  uasd_task_t* task = &p_uas->task[idx];
+
+  task->state  = UAS_TASK_STATUS;
+  task->status = UAS_STATUS_GOOD;
+
+  if ( failed )
+  {
+    // auto sense: fetch and clear sense data set while executing
+    uint8_t const req_sense[16] = { SCSI_CMD_REQUEST_SENSE, 0, 0, 0, sizeof(task->sense) };
+
+    if ( mscd_get_sense_key(task->lun) == 0 ) tud_msc_set_sense(task->lun, SCSI_SENSE_ILLEGAL_REQUEST, 0x20, 0x00);
+    proc_builtin_scsi(task->lun, req_sense, task->sense, sizeof(task->sense));
+
+    task->status = UAS_STATUS_CHECK_CONDITION;
+  }
+
+  if ( idx == p_uas->data_task ) p_uas->data_task = UAS_TASK_NONE;
+
+  // Invoke complete callback if defined
+  p_uas->cur_tag = tu_ntohs(task->tag);
+
+  if ( p_uas->is_rdwr && !p_uas->is_write )
+  {
+    if ( tud_msc_read10_complete_cb ) tud_msc_read10_complete_cb(task->lun);
+  }
+  else if ( p_uas->is_rdwr )
+  {
+    if ( tud_msc_write10_complete_cb ) tud_msc_write10_complete_cb(task->lun);
+  }
+  else
+  {
+    if ( tud_msc_scsi_complete_cb ) tud_msc_scsi_complete_cb(task->lun, task->cdb);
+  }
+}
+
+static void task_fail(uasd_interface_t* p_uas, uint8_t idx, uint8_t sense_key, uint8_t asc, uint8_t ascq)
+{
+  tud_msc_set_sense(p_uas->task[idx].lun, sense_key, asc, ascq);
+  task_complete(p_uas, idx, true);
+}
+
+// Read next chunk from storage into buffer, return callback's result
+static int32_t read_fetch(uasd_interface_t* p_uas, uasd_task_t const* task)
+{
+  uint32_t const bufsize = tu_min32(CFG_TUD_MSC_BUFSIZE, p_uas->total_len - p_uas->xferred_len);
+  tud_msc_lba_t const lba = (tud_msc_lba_t) (p_uas->lba + p_uas->xferred_len / p_uas->block_size);
+
+  int32_t const nbytes = mscd_read10(task->lun, lba, p_uas->xferred_len % p_uas->block_size, _uasd_buf, bufsize);
+
+  if ( nbytes > 0 ) p_uas->buf_len = (uint16_t) tu_min32((uint32_t) nbytes, bufsize);
+
+  return nbytes;
+}
+
+// Prepare READ/WRITE, return false if storage is not ready for it
+static bool rdwr_start(uasd_interface_t* p_uas, uint8_t idx)
+{
+  uasd_task_t* task = &p_uas->task[idx];
+
+  uint64_t lba;
+  uint32_t block_count;
+  bool is_write;
+  (void) mscd_rdwr_decode(task->cdb, &is_write, &lba, &block_count);
+
+  // Unlike BOT, transfer length is not in transport header but computed from block size
+  tud_msc_lba_t capacity;
+  uint16_t block_size;
+  tud_msc_capacity_cb(task->lun, &capacity, &block_size);
+
+  p_uas->is_rdwr     = true;
+  p_uas->is_write    = is_write;
+  p_uas->lba         = lba;
+  p_uas->block_size  = block_size;
+  p_uas->total_len   = block_count * block_size;
+  p_uas->xferred_len = 0;
+  p_uas->buf_len     = 0;
+  p_uas->buf_off     = 0;
+
+  if ( capacity == 0 || block_size == 0 )
+  {
+    if ( mscd_get_sense_key(task->lun) == 0 ) tud_msc_set_sense(task->lun, SCSI_SENSE_NOT_READY, 0x04, 0x00);
+    task_complete(p_uas, idx, true);
+  }
+  else if ( !mscd_rdwr_lba_valid(task->cdb) || (lba + block_count > (uint64_t) capacity) )
+  {
+    // Logical Block Address Out Of Range
+    task_fail(p_uas, idx, SCSI_SENSE_ILLEGAL_REQUEST, 0x21, 0x00);
+  }
+  else if ( ((uint64_t) block_count * block_size) > UINT32_MAX )
+  {
+    // Invalid Field in CDB
+    task_fail(p_uas, idx, SCSI_SENSE_ILLEGAL_REQUEST, 0x24, 0x00);
+  }
+  else if ( block_count == 0 )
+  {
+    task_complete(p_uas, idx, false);
+  }
+  else if ( !is_write )
+  {
+    int32_t const nbytes = read_fetch(p_uas, task);
+
+    // not ready: other queued commands are given a chance to run
+    if ( nbytes == 0 ) return false;
+
+    if ( nbytes < 0 )
+    {
+      task_fail(p_uas, idx, SCSI_SENSE_ILLEGAL_REQUEST, 0x20, 0x00);
+    }else
+    {
+      task->state = UAS_TASK_READY;
+    }
+  }
+  else
+  {
+    task->state = UAS_TASK_READY;
+  }
+
+  return true;
+}
+
+static void scsi_start(uasd_interface_t* p_uas, uint8_t idx)
+{
+  uasd_task_t* task = &p_uas->task[idx];
+
+  p_uas->is_rdwr     = false;
+  p_uas->is_write    = false;
+  p_uas->xferred_len = 0;
+  p_uas->total_len   = data_out_len(task->cdb);
+
+  int32_t resplen;
+
+  if ( p_uas->total_len )
+  {
+    // data is passed to tud_msc_scsi_cb() once received
+    p_uas->is_write = true;
+    resplen = (p_uas->total_len <= CFG_TUD_MSC_BUFSIZE) ? (int32_t) p_uas->total_len : -1;
+  }
+  else if ( task->cdb[0] == SCSI_CMD_REPORT_LUNS )
+  {
+    // LUN list: 8-byte header followed by single level LUN entries, truncated to buffer
+    uint8_t const maxlun = get_max_lun();
+    uint32_t const list_len = 8u*maxlun;
+    uint32_t const len = tu_min32(8 + list_len, CFG_TUD_MSC_BUFSIZE);
+
+    tu_memclr(_uasd_buf, len);
+    _uasd_buf[2] = (uint8_t) (list_len >> 8);
+    _uasd_buf[3] = (uint8_t) list_len;
+    for(uint8_t i=0; (i < maxlun) && (8 + 8u*i + 1 < len); i++) _uasd_buf[8 + 8*i + 1] = i;
+
+    uint32_t const alloc_len = tu_u32(task->cdb[6], task->cdb[7], task->cdb[8], task->cdb[9]);
+    resplen = (int32_t) tu_min32(len, alloc_len);
+  }
+  else
+  {
+    // First process if it is a built-in commands
+    resplen = proc_builtin_scsi(task->lun, task->cdb, _uasd_buf, CFG_TUD_MSC_BUFSIZE);
+
+    // Not built-in, invoke user callback
+    if ( (resplen < 0) && (mscd_get_sense_key(task->lun) == 0) )
+    {
+      resplen = tud_msc_scsi_cb(task->lun, task->cdb, _uasd_buf, CFG_TUD_MSC_BUFSIZE);
+    }
+
+    p_uas->total_len = (resplen > 0) ? (uint32_t) resplen : 0;
+  }
+
+  if ( resplen < 0 )
+  {
+    task_complete(p_uas, idx, true);
+  }
+  else if ( resplen == 0 )
+  {
+    task_complete(p_uas, idx, false);
+  }
+  else
+  {
+    task->state = UAS_TASK_READY;
+  }
+}
+
+// Execute queued command, return false if it is not ready to be executed
+static bool task_start(uasd_interface_t* p_uas, uint8_t idx)
+{
+  uasd_task_t* task = &p_uas->task[idx];
+
+  p_uas->data_task = idx;
+  p_uas->cur_tag   = tu_ntohs(task->tag);
+  p_uas->failed    = false;
+
+  // sense data is returned per command
+  tud_msc_set_sense(task->lun, 0, 0, 0);
+
+  uint64_t lba;
+  uint32_t block_count;
+  bool is_write;
+
+  if ( mscd_rdwr_decode(task->cdb, &is_write, &lba, &block_count) )
+  {
+    if ( !rdwr_start(p_uas, idx) )
+    {
+      p_uas->data_task = UAS_TASK_NONE;
+      return false;
+    }
+  }else
+  {
+    scsi_start(p_uas, idx);
+  }
+
+  return true;
+}
+
+// Read/Write Ready IU is sent, host is now handling data pipe
+static void data_start(uint8_t rhport, uasd_interface_t* p_uas)
+{
+  if ( !p_uas->is_write )
+  {
+    uint32_t const len = p_uas->is_rdwr ? p_uas->buf_len : p_uas->total_len;
+    TU_ASSERT( usbd_edpt_xfer(rhport, p_uas->ep_in, _uasd_buf, len), );
+  }else
+  {
+    uint32_t const len = tu_min32(CFG_TUD_MSC_BUFSIZE, p_uas->total_len - p_uas->xferred_len);
+    TU_ASSERT( usbd_edpt_xfer(rhport, p_uas->ep_out, _uasd_buf, len), );
+  }
+}
+
+static void data_in_xfer(uint8_t rhport, uasd_interface_t* p_uas, uint32_t xferred_bytes)
+{
+  uint8_t const idx = p_uas->data_task;
+  uasd_task_t const* task = &p_uas->task[idx];
+
+  // short packet terminating failed data-in is sent
+  if ( p_uas->failed )
+  {
+    task_complete(p_uas, idx, true);
+    return;
+  }
+
+  p_uas->xferred_len += xferred_bytes;
+
+  if ( !p_uas->is_rdwr || (p_uas->xferred_len >= p_uas->total_len) )
+  {
+    task_complete(p_uas, idx, false);
+    return;
+  }
+
+  // READ is broken into multiple transfers of up to CFG_TUD_MSC_BUFSIZE
+  p_uas->cur_tag = tu_ntohs(task->tag);
+  int32_t const nbytes = read_fetch(p_uas, task);
+
+  if ( nbytes > 0 )
+  {
+    TU_ASSERT( usbd_edpt_xfer(rhport, p_uas->ep_in, _uasd_buf, p_uas->buf_len), );
+  }
+  else if ( nbytes == 0 )
+  {
+    // zero means not ready -> simulate an transfer complete so that this driver callback will fired again
+    dcd_event_xfer_complete(rhport, p_uas->ep_in, 0, XFER_RESULT_SUCCESS, false);
+  }
+  else
+  {
+    // end data-in with zero length packet, host reports residue
+    tud_msc_set_sense(task->lun, SCSI_SENSE_ILLEGAL_REQUEST, 0x20, 0x00);
+    p_uas->failed = true;
+    TU_ASSERT( usbd_edpt_xfer(rhport, p_uas->ep_in, NULL, 0), );
+  }
+}
+
+static void data_out_xfer(uint8_t rhport, uasd_interface_t* p_uas, uint32_t xferred_bytes)
+{
+  uint8_t const idx = p_uas->data_task;
+  uasd_task_t const* task = &p_uas->task[idx];
+
+  p_uas->cur_tag = tu_ntohs(task->tag);
+
+  if ( !p_uas->is_rdwr )
+  {
+    int32_t cb_result = proc_builtin_scsi_out(task->lun, task->cdb, _uasd_buf, xferred_bytes);
+
+    if ( (cb_result < 0) && (mscd_get_sense_key(task->lun) == 0) )
+    {
+      cb_result = tud_msc_scsi_cb(task->lun, task->cdb, _uasd_buf, (uint16_t) xferred_bytes);
+    }
+
+    task_complete(p_uas, idx, cb_result < 0);
+    return;
+  }
+
+  // zero length is the simulated completion of partial or not ready write
+  if ( xferred_bytes ) p_uas->buf_len = (uint16_t) xferred_bytes;
+
+  tud_msc_lba_t const lba = (tud_msc_lba_t) (p_uas->lba + p_uas->xferred_len / p_uas->block_size);
+  uint32_t const offset = p_uas->xferred_len % p_uas->block_size;
+
+  int32_t const nbytes = mscd_write10(task->lun, lba, offset, _uasd_buf + p_uas->buf_off, p_uas->buf_len - p_uas->buf_off);
+
+  if ( nbytes < 0 )
+  {
+    // host cancels the rest of data-out when Sense IU arrives
+    task_fail(p_uas, idx, SCSI_SENSE_ILLEGAL_REQUEST, 0x20, 0x00);
+    return;
+  }
+
+  uint16_t const written = (uint16_t) tu_min32((uint32_t) nbytes, p_uas->buf_len - p_uas->buf_off);
+  p_uas->buf_off     += written;
+  p_uas->xferred_len += written;
+
+  if ( p_uas->buf_off < p_uas->buf_len )
+  {
+    // Application consumed less than receiving, invoke callback again with the rest
+    dcd_event_xfer_complete(rhport, p_uas->ep_out, 0, XFER_RESULT_SUCCESS, false);
+  }
+  else if ( p_uas->xferred_len >= p_uas->total_len )
+  {
+    task_complete(p_uas, idx, false);
+  }
+  else
+  {
+    p_uas->buf_len = p_uas->buf_off = 0;
+    data_start(rhport, p_uas);
+  }
+}
+
+//--------------------------------------------------------------------+
+// Information Unit
+//--------------------------------------------------------------------+
+static void response_queue(uasd_task_t* task, uint16_t tag, uint8_t response_code)
+{
+  task->state  = UAS_TASK_RESPONSE;
+  task->tag    = tag;
+  task->status = response_code;
+}
+
+static uint8_t proc_task_mgmt(uasd_interface_t* p_uas, uas_task_mgmt_iu_t const* tm)
+{
+  uint8_t const lun = tm->lun[1];
+
+  switch ( tm->function )
+  {
+    case UAS_TMF_ABORT_TASK:
+    {
+      uint8_t const idx = task_find(p_uas, tm->task_tag);
+      if ( idx == UAS_TASK_NONE ) return UAS_RC_TMF_COMPLETE;
+
+      // command already in data phase cannot be recalled
+      TU_VERIFY(task_abortable(p_uas, idx), UAS_RC_TMF_FAILED);
+      p_uas->task[idx].state = UAS_TASK_FREE;
+
+      return UAS_RC_TMF_COMPLETE;
+    }
+
+    case UAS_TMF_ABORT_TASK_SET:
+    case UAS_TMF_CLEAR_TASK_SET:
+    case UAS_TMF_LOGICAL_UNIT_RESET:
+    case UAS_TMF_IT_NEXUS_RESET:
+      for(uint8_t i=0; i<CFG_TUD_UAS_QUEUE_DEPTH; i++)
+      {
+        bool const lun_match = (tm->function == UAS_TMF_IT_NEXUS_RESET) || (p_uas->task[i].lun == lun);
+        if ( lun_match && task_abortable(p_uas, i) ) p_uas->task[i].state = UAS_TASK_FREE;
+      }
+
+      return UAS_RC_TMF_COMPLETE;
+
+    case UAS_TMF_QUERY_TASK:
+      return (task_find(p_uas, tm->task_tag) == UAS_TASK_NONE) ? UAS_RC_TMF_COMPLETE : UAS_RC_TMF_SUCCEEDED;
+
+    default: return UAS_RC_TMF_NOT_SUPPORTED;
+  }
+}
+
+// Queue IU received on command pipe into a free task
+static void proc_cmd_iu(uasd_interface_t* p_uas, uint32_t xferred_bytes)
+{
+  uint8_t const idx = task_oldest(p_uas, UAS_TASK_FREE, 0);
+  TU_ASSERT(idx != UAS_TASK_NONE, );
+
+  uasd_task_t* task = &p_uas->task[idx];
+  uas_cmd_iu_t const* cmd = &p_uas->cmd_iu;
+
+  task->seq = p_uas->seq++;
+
+  if ( (cmd->iu_id == UAS_IU_COMMAND) && (xferred_bytes >= sizeof(uas_cmd_iu_t)) )
+  {
+    if ( task_find(p_uas, cmd->tag) != UAS_TASK_NONE )
+    {
+      response_queue(task, cmd->tag, UAS_RC_OVERLAPPED_TAG);
+    }
+    else if ( cmd->lun[1] >= get_max_lun() )
+    {
+      response_queue(task, cmd->tag, UAS_RC_INCORRECT_LUN);
+    }
+    else
+    {
+      task->state = UAS_TASK_QUEUED;
+      task->tag   = cmd->tag;
+      task->lun   = cmd->lun[1];
+      memcpy(task->cdb, cmd->cdb, sizeof(task->cdb));
+    }
+  }
+  else if ( (cmd->iu_id == UAS_IU_TASK_MGMT) && (xferred_bytes >= sizeof(uas_task_mgmt_iu_t)) )
+  {
+    uas_task_mgmt_iu_t const* tm = (uas_task_mgmt_iu_t const*) cmd;
+    response_queue(task, tm->tag, proc_task_mgmt(p_uas, tm));
+  }
+  else
+  {
+    response_queue(task, cmd->tag, UAS_RC_INVALID_IU);
+  }
+}
+
+// Send pending IU of task on status pipe
+static void send_stat_iu(uint8_t rhport, uasd_interface_t* p_uas, uint8_t idx)
+{
+  uasd_task_t const* task = &p_uas->task[idx];
+  uint16_t len;
+
+  tu_varclr(&p_uas->stat_iu);
+
+  switch ( task->state )
+  {
+    case UAS_TASK_RESPONSE:
+      p_uas->stat_iu.response.iu_id         = UAS_IU_RESPONSE;
+      p_uas->stat_iu.response.tag           = task->tag;
+      p_uas->stat_iu.response.response_code = task->status;
+      len = sizeof(uas_response_iu_t);
+    break;
+
+    case UAS_TASK_READY:
+      p_uas->stat_iu.ready.iu_id = p_uas->is_write ? UAS_IU_WRITE_READY : UAS_IU_READ_READY;
+      p_uas->stat_iu.ready.tag   = task->tag;
+      len = sizeof(uas_ready_iu_t);
+    break;
+
+    default:
+      p_uas->stat_iu.sense.iu_id  = UAS_IU_SENSE;
+      p_uas->stat_iu.sense.tag    = task->tag;
+      p_uas->stat_iu.sense.status = task->status;
+      len = sizeof(uas_sense_iu_t) - sizeof(task->sense);
+
+      if ( task->status != UAS_STATUS_GOOD )
+      {
+        p_uas->stat_iu.sense.sense_len = tu_htons(sizeof(task->sense));
+        memcpy(p_uas->stat_iu.sense.sense, task->sense, sizeof(task->sense));
+        len += sizeof(task->sense);
+      }
+    break;
+  }
+
+  p_uas->stat_task = idx;
+  TU_ASSERT( usbd_edpt_xfer(rhport, p_uas->ep_stat, (uint8_t*) &p_uas->stat_iu, len), );
+}
+
+// Move tasks forward: execute queued commands, send pending IU and accept more commands
+static void uas_process(uint8_t rhport, uasd_interface_t* p_uas)
+{
+  // Execute queued commands in order until one needs data pipes
+  uint32_t skip_mask = 0;
+  uint8_t idx;
+
+  while ( (p_uas->data_task == UAS_TASK_NONE) &&
+          (UAS_TASK_NONE != (idx = task_oldest(p_uas, UAS_TASK_QUEUED, skip_mask))) )
+  {
+    if ( !task_start(p_uas, idx) ) skip_mask |= TU_BIT(idx);
+  }
+
+  // storage is not ready for remaining commands, try again later
+  if ( skip_mask && (p_uas->data_task == UAS_TASK_NONE) && !p_uas->retry_pending )
+  {
+    p_uas->retry_pending = true;
+    usbd_defer_func(uas_retry, NULL, false);
+  }
+
+  // One IU at a time on status pipe: task management responses go first
+  if ( p_uas->stat_task == UAS_TASK_NONE )
+  {
+    idx = task_oldest(p_uas, UAS_TASK_RESPONSE, 0);
+
+    if ( (idx == UAS_TASK_NONE) && (p_uas->data_task != UAS_TASK_NONE) &&
+         (p_uas->task[p_uas->data_task].state == UAS_TASK_READY) )
+    {
+      idx = p_uas->data_task;
+    }
+
+    if ( idx == UAS_TASK_NONE ) idx = task_oldest(p_uas, UAS_TASK_STATUS, 0);
+
+    if ( idx != UAS_TASK_NONE ) send_stat_iu(rhport, p_uas, idx);
+  }
+
+  // Accept next IU as long as there is a free task for it
+  if ( !p_uas->cmd_armed && (UAS_TASK_NONE != task_oldest(p_uas, UAS_TASK_FREE, 0)) )
+  {
+    TU_ASSERT( usbd_edpt_xfer(rhport, p_uas->ep_cmd, (uint8_t*) &p_uas->cmd_iu, sizeof(uas_cmd_iu_t)), );
+    p_uas->cmd_armed = true;
+  }
+}
+
+static void uas_retry(void* param)
+{
+  (void) param;
+  uasd_interface_t* p_uas = &_uasd_itf;
+  p_uas->retry_pending = false;
+
+  // interface could be closed by bus reset meanwhile
+  if ( p_uas->ep_cmd ) uas_process(p_uas->rhport, p_uas);
+}
+
+bool uasd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes)
+{
+  uasd_interface_t* p_uas = &_uasd_itf;
+
+  TU_ASSERT(event == XFER_RESULT_SUCCESS);
+
+  if ( ep_addr == p_uas->ep_cmd )
+  {
+    p_uas->cmd_armed = false;
+    proc_cmd_iu(p_uas, xferred_bytes);
+  }
+  else if ( ep_addr == p_uas->ep_stat )
+  {
+    uint8_t const idx = p_uas->stat_task;
+    p_uas->stat_task = UAS_TASK_NONE;
+
+    TU_ASSERT(idx != UAS_TASK_NONE);
+
+    if ( p_uas->task[idx].state == UAS_TASK_READY )
+    {
+      p_uas->task[idx].state = UAS_TASK_DATA;
+      data_start(rhport, p_uas);
+    }else
+    {
+      // Sense or Response IU is the last one of the task
+      p_uas->task[idx].state = UAS_TASK_FREE;
+    }
+  }
+  else if ( p_uas->data_task != UAS_TASK_NONE )
+  {
+    if ( ep_addr == p_uas->ep_in )
+    {
+      data_in_xfer(rhport, p_uas, xferred_bytes);
+    }
+    else if ( ep_addr == p_uas->ep_out )
+    {
+      data_out_xfer(rhport, p_uas, xferred_bytes);
+    }
+  }
+
+  uas_process(rhport, p_uas);
+
+  return true;
+}
+
+#endif
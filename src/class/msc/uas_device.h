@@ -0,0 +1,87 @@
+/* 
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+
+#ifndef _TUSB_UAS_DEVICE_H_
+#define _TUSB_UAS_DEVICE_H_
+
+#include "common/tusb_common.h"
+#include "device/usbd.h"
+#include "msc_device.h"
+
+//--------------------------------------------------------------------+
+// Class Driver Configuration
+//--------------------------------------------------------------------+
+
+#if !CFG_TUD_MSC
+  #error CFG_TUD_UAS requires CFG_TUD_MSC, SCSI commands and callbacks are shared with MSC driver
+#endif
+
+// Number of commands host can queue, further commands are NAKed until one is complete
+#ifndef CFG_TUD_UAS_QUEUE_DEPTH
+  #define CFG_TUD_UAS_QUEUE_DEPTH   4
+#endif
+
+TU_VERIFY_STATIC(CFG_TUD_UAS_QUEUE_DEPTH > 0 && CFG_TUD_UAS_QUEUE_DEPTH <= 32, "Queue depth is not correct");
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/** \addtogroup ClassDriver_MSC
+ *  @{
+ * \defgroup UAS_Device UAS Device
+ *  @{ */
+
+// USB Attached SCSI commands are served by the same tud_msc_* callbacks as Bulk Only Transport, with differences:
+// - Queued commands are executed in order, except READ whose tud_msc_read10_cb() returns zero for its first
+//   chunk is skipped and retried after the other queued commands. Data phases are never interleaved.
+// - Sense data is returned with status, REQUEST SENSE is not issued by host.
+// - tud_msc_scsi_cb() bufsize is CFG_TUD_MSC_BUFSIZE, response must be limited to command's allocation length.
+//   Data-out commands other than WRITE are limited to MODE SELECT (6), (10) and UNMAP.
+// - TUD_MSC_RET_ASYNC and tud_msc_read10_map_cb() are not supported.
+
+// Tag of the command whose tud_msc_* callback is being invoked, e.g to reorder or log medium accesses
+uint16_t tud_uas_tag(void);
+
+/** @} */
+/** @} */
+
+//--------------------------------------------------------------------+
+// Internal Class Driver API
+//--------------------------------------------------------------------+
+void uasd_init             (void);
+void uasd_reset            (uint8_t rhport);
+bool uasd_open             (uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t *p_length, uint8_t *p_inst);
+bool uasd_control_request  (uint8_t rhport, tusb_control_request_t const * p_request);
+bool uasd_control_complete (uint8_t rhport, tusb_control_request_t const * p_request);
+bool uasd_xfer_cb          (uint8_t rhport, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes);
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif /* _TUSB_UAS_DEVICE_H_ */
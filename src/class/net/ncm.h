@@ -0,0 +1,136 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+/** \ingroup group_class
+ *  \defgroup ClassDriver_NCM Network Control Model (NCM)
+ *  Currently only 16-bit NTB format is supported
+ *  @{ */
+
+#ifndef _TUSB_NCM_H_
+#define _TUSB_NCM_H_
+
+#include "common/tusb_common.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+// Data Interface protocol code of NCM Network Transfer Block
+#define NCM_DATA_PROTOCOL_NETWORK_TRANSFER_BLOCK  0x01
+
+// NTB signatures
+#define NCM_NTH16_SIGNATURE   0x484D434Eu // "NCMH"
+#define NCM_NDP16_SIGNATURE   0x304D434Eu // "NCM0" no CRC
+
+//--------------------------------------------------------------------+
+// Requests
+//--------------------------------------------------------------------+
+
+/// NCM specific requests, other than ones in \ref cdc_management_request_t
+typedef enum
+{
+  NCM_REQUEST_GET_NTB_PARAMETERS    = 0x80,
+  NCM_REQUEST_GET_NET_ADDRESS       = 0x81,
+  NCM_REQUEST_SET_NET_ADDRESS       = 0x82,
+  NCM_REQUEST_GET_NTB_FORMAT        = 0x83,
+  NCM_REQUEST_SET_NTB_FORMAT        = 0x84,
+  NCM_REQUEST_GET_NTB_INPUT_SIZE    = 0x85,
+  NCM_REQUEST_SET_NTB_INPUT_SIZE    = 0x86,
+  NCM_REQUEST_GET_MAX_DATAGRAM_SIZE = 0x87,
+  NCM_REQUEST_SET_MAX_DATAGRAM_SIZE = 0x88,
+  NCM_REQUEST_GET_CRC_MODE          = 0x89,
+  NCM_REQUEST_SET_CRC_MODE          = 0x8A,
+}ncm_request_t;
+
+//--------------------------------------------------------------------+
+// Structures
+//--------------------------------------------------------------------+
+
+/// NCM Functional Descriptor
+typedef struct TU_ATTR_PACKED
+{
+  uint8_t  bLength               ; ///< Size of this descriptor in bytes.
+  uint8_t  bDescriptorType       ; ///< Descriptor Type, must be Class-Specific
+  uint8_t  bDescriptorSubType    ; ///< Descriptor SubType \ref CDC_FUNC_DESC_NCM
+  uint16_t bcdNcmVersion         ; ///< NCM release number in Binary-Coded Decimal
+  uint8_t  bmNetworkCapabilities ; ///< Supported optional requests
+}ncm_desc_func_t;
+
+/// Response of GET_NTB_PARAMETERS request
+typedef struct TU_ATTR_PACKED
+{
+  uint16_t wLength;
+  uint16_t bmNtbFormatsSupported;
+  uint32_t dwNtbInMaxSize;
+  uint16_t wNdpInDivisor;
+  uint16_t wNdpInPayloadRemainder;
+  uint16_t wNdpInAlignment;
+  uint16_t wReserved;
+  uint32_t dwNtbOutMaxSize;
+  uint16_t wNdpOutDivisor;
+  uint16_t wNdpOutPayloadRemainder;
+  uint16_t wNdpOutAlignment;
+  uint16_t wNtbOutMaxDatagrams;
+}ncm_ntb_parameters_t;
+
+TU_VERIFY_STATIC(sizeof(ncm_ntb_parameters_t) == 28, "size is not correct");
+
+/// NTB Header, 16-bit format
+typedef struct TU_ATTR_PACKED
+{
+  uint32_t dwSignature;
+  uint16_t wHeaderLength;
+  uint16_t wSequence;
+  uint16_t wBlockLength;
+  uint16_t wNdpIndex;
+}ncm_nth16_t;
+
+TU_VERIFY_STATIC(sizeof(ncm_nth16_t) == 12, "size is not correct");
+
+/// Datagram pointer entry of NDP16
+typedef struct TU_ATTR_PACKED
+{
+  uint16_t wDatagramIndex;
+  uint16_t wDatagramLength;
+}ncm_ndp16_datagram_t;
+
+/// NTB Datagram Pointer Table, 16-bit format. Followed by datagram entries terminated by zeroed one
+typedef struct TU_ATTR_PACKED
+{
+  uint32_t dwSignature;
+  uint16_t wLength;
+  uint16_t wNextNdpIndex;
+}ncm_ndp16_t;
+
+TU_VERIFY_STATIC(sizeof(ncm_ndp16_t) == 8, "size is not correct");
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif /* _TUSB_NCM_H_ */
+
+/** @} */
@@ -0,0 +1,573 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#include "tusb_option.h"
+
+#if (TUSB_OPT_DEVICE_ENABLED && CFG_TUD_NCM)
+
+#include "ncm_device.h"
+#include "device/usbd_pvt.h"
+
+//--------------------------------------------------------------------+
+// MACRO CONSTANT TYPEDEF
+//--------------------------------------------------------------------+
+
+// Alignment of NDP and datagrams in NTB of both directions
+#define NTB_ALIGN           4
+
+// NTB sent to host has its NDP right after NTH, followed by datagrams
+#define NDP_IN_OFFSET       sizeof(ncm_nth16_t)
+#define NDP_IN_LEN          (sizeof(ncm_ndp16_t) + (CFG_TUD_NCM_IN_MAX_DATAGRAMS+1)*sizeof(ncm_ndp16_datagram_t))
+#define DATAGRAM_IN_OFFSET  (NDP_IN_OFFSET + NDP_IN_LEN)
+
+TU_VERIFY_STATIC((DATAGRAM_IN_OFFSET % NTB_ALIGN) == 0, "datagram offset must be aligned");
+TU_VERIFY_STATIC(CFG_TUD_NCM_IN_NTB_MAX_SIZE <= UINT16_MAX && CFG_TUD_NCM_OUT_NTB_MAX_SIZE <= UINT16_MAX, "16-bit NTB is at most 64KB");
+
+// Notification sent after data interface is activated
+enum
+{
+  NOTIF_NONE = 0,
+  NOTIF_SPEED_CHANGE,
+  NOTIF_CONNECTION,
+};
+
+typedef struct TU_ATTR_PACKED
+{
+  tusb_control_request_t header;
+  uint32_t downlink;
+  uint32_t uplink;
+}ncm_notify_t;
+
+typedef struct
+{
+  uint8_t rhport;
+  uint8_t itf_num;      // Communication interface, data interface is the next one
+  uint8_t ep_notif;
+  uint8_t ep_in;
+  uint8_t ep_out;
+  uint16_t ep_in_size;
+
+  uint32_t ntb_in_max;  // max NTB size sent to host, changed by SET_NTB_INPUT_SIZE
+  uint32_t ntb_input[2];// data stage of SET_NTB_INPUT_SIZE, dwNtbInMaxSize and optional wNtbInMaxDatagrams
+  uint16_t ntb_format;  // always 16-bit NTB
+
+  uint8_t itf_data_alt; // alternate setting of data interface, 1 is active
+
+  /*------------- From this point, data is cleared when data interface is (de)activated -------------*/
+  uint8_t notif_state;
+
+  // Receive NTB, its datagrams are delivered one by one
+  uint16_t rx_len;      // 0 if no NTB is received
+  uint16_t rx_ndp;      // offset of current NDP
+  uint16_t rx_dg;       // index of current datagram in NDP
+  bool rx_held;         // datagram is accepted but not yet released by application
+  bool rx_in_cb;
+  bool rx_renew;        // released within tud_network_recv_cb()
+
+  // Two transmit NTBs, one is filled while the other is on the wire
+  uint8_t  tx_fill;
+  uint8_t  tx_count[2];
+  uint16_t tx_len[2];
+  uint16_t tx_seq;
+}ncmd_interface_t;
+
+#define LINK_RESET_OFFSET   offsetof(ncmd_interface_t, notif_state)
+
+//--------------------------------------------------------------------+
+// INTERNAL OBJECT & FUNCTION DECLARATION
+//--------------------------------------------------------------------+
+CFG_TUSB_MEM_SECTION static ncmd_interface_t _ncmd_itf;
+
+CFG_TUSB_MEM_SECTION CFG_TUSB_MEM_ALIGN static uint8_t _ncmd_rx_ntb[CFG_TUD_NCM_OUT_NTB_MAX_SIZE];
+CFG_TUSB_MEM_SECTION CFG_TUSB_MEM_ALIGN static uint8_t _ncmd_tx_ntb[2][CFG_TUD_NCM_IN_NTB_MAX_SIZE];
+CFG_TUSB_MEM_SECTION CFG_TUSB_MEM_ALIGN static ncm_notify_t _ncmd_notif;
+
+CFG_TUSB_MEM_SECTION CFG_TUSB_MEM_ALIGN static ncm_ntb_parameters_t _ntb_parameters =
+{
+  .wLength                 = sizeof(ncm_ntb_parameters_t),
+  .bmNtbFormatsSupported   = 0x01, // 16-bit NTB only
+  .dwNtbInMaxSize          = CFG_TUD_NCM_IN_NTB_MAX_SIZE,
+  .wNdpInDivisor           = NTB_ALIGN,
+  .wNdpInPayloadRemainder  = 0,
+  .wNdpInAlignment         = NTB_ALIGN,
+  .wReserved               = 0,
+  .dwNtbOutMaxSize         = CFG_TUD_NCM_OUT_NTB_MAX_SIZE,
+  .wNdpOutDivisor          = NTB_ALIGN,
+  .wNdpOutPayloadRemainder = 0,
+  .wNdpOutAlignment        = NTB_ALIGN,
+  .wNtbOutMaxDatagrams     = 0     // no limit
+};
+
+static void _prep_out_transaction(ncmd_interface_t* p_ncm)
+{
+  // receive next NTB only when current one is consumed
+  if ( !p_ncm->itf_data_alt || p_ncm->rx_len || usbd_edpt_busy(p_ncm->rhport, p_ncm->ep_out) ) return;
+
+  usbd_edpt_xfer(p_ncm->rhport, p_ncm->ep_out, _ncmd_rx_ntb, CFG_TUD_NCM_OUT_NTB_MAX_SIZE);
+}
+
+static void _send_notification(ncmd_interface_t* p_ncm, uint8_t notif_state)
+{
+  _ncmd_notif.header.bmRequestType = 0xA1; // Class, Interface, IN
+  _ncmd_notif.header.wIndex        = p_ncm->itf_num;
+
+  if ( NOTIF_SPEED_CHANGE == notif_state )
+  {
+    uint32_t const bitrate = (p_ncm->ep_in_size >= 512) ? 480000000UL : 12000000UL;
+
+    _ncmd_notif.header.bRequest = CONNECTION_SPEED_CHANGE;
+    _ncmd_notif.header.wValue   = 0;
+    _ncmd_notif.header.wLength  = 8;
+    _ncmd_notif.downlink        = bitrate;
+    _ncmd_notif.uplink          = bitrate;
+  }else
+  {
+    _ncmd_notif.header.bRequest = NETWORK_CONNECTION;
+    _ncmd_notif.header.wValue   = 1; // connected
+    _ncmd_notif.header.wLength  = 0;
+  }
+
+  p_ncm->notif_state = notif_state;
+  usbd_edpt_xfer(p_ncm->rhport, p_ncm->ep_notif, (uint8_t*) &_ncmd_notif, (uint32_t) (sizeof(tusb_control_request_t) + _ncmd_notif.header.wLength));
+}
+
+//--------------------------------------------------------------------+
+// Receive
+//--------------------------------------------------------------------+
+
+// Check NTH of received NTB
+static bool _rx_ntb_valid(uint32_t len)
+{
+  ncm_nth16_t const* nth = (ncm_nth16_t const*) _ncmd_rx_ntb;
+
+  TU_VERIFY( len >= sizeof(ncm_nth16_t) + sizeof(ncm_ndp16_t) );
+  TU_VERIFY( (NCM_NTH16_SIGNATURE == nth->dwSignature) && (sizeof(ncm_nth16_t) == nth->wHeaderLength) );
+  TU_VERIFY( nth->wBlockLength <= len );
+  TU_VERIFY( nth->wNdpIndex >= sizeof(ncm_nth16_t) );
+
+  return true;
+}
+
+// Get current datagram, moving to next NDP if current one is exhausted.
+// Return false when there is no more (valid) datagram in NTB.
+static bool _rx_get_datagram(ncmd_interface_t* p_ncm, uint16_t* p_idx, uint16_t* p_len)
+{
+  while ( p_ncm->rx_ndp )
+  {
+    uint32_t const ndp_idx = p_ncm->rx_ndp;
+    TU_VERIFY( ndp_idx + sizeof(ncm_ndp16_t) <= p_ncm->rx_len );
+
+    ncm_ndp16_t const* ndp = (ncm_ndp16_t const*) (_ncmd_rx_ntb + ndp_idx);
+    TU_VERIFY( (NCM_NDP16_SIGNATURE == ndp->dwSignature) && (ndp->wLength >= sizeof(ncm_ndp16_t)) );
+    TU_VERIFY( ndp_idx + ndp->wLength <= p_ncm->rx_len );
+
+    uint16_t const dg_count = (uint16_t) ((ndp->wLength - sizeof(ncm_ndp16_t)) / sizeof(ncm_ndp16_datagram_t));
+
+    if ( p_ncm->rx_dg < dg_count )
+    {
+      ncm_ndp16_datagram_t const* dg = ((ncm_ndp16_datagram_t const*) (ndp + 1)) + p_ncm->rx_dg;
+
+      // zeroed entry terminates the table
+      if ( dg->wDatagramIndex && dg->wDatagramLength )
+      {
+        TU_VERIFY( (uint32_t) dg->wDatagramIndex + dg->wDatagramLength <= p_ncm->rx_len );
+
+        (*p_idx) = dg->wDatagramIndex;
+        (*p_len) = dg->wDatagramLength;
+        return true;
+      }
+    }
+
+    // next NDP must be further in NTB, this also guards against looped chain
+    p_ncm->rx_ndp = (ndp->wNextNdpIndex > ndp_idx) ? ndp->wNextNdpIndex : 0;
+    p_ncm->rx_dg  = 0;
+  }
+
+  return false;
+}
+
+// Deliver datagrams until application holds one or NTB is consumed
+static void _rx_deliver(ncmd_interface_t* p_ncm)
+{
+  while ( p_ncm->rx_len && !p_ncm->rx_held )
+  {
+    uint16_t idx, len;
+
+    if ( !_rx_get_datagram(p_ncm, &idx, &len) )
+    {
+      // NTB is consumed, receive next one
+      p_ncm->rx_len = 0;
+      _prep_out_transaction(p_ncm);
+      return;
+    }
+
+    p_ncm->rx_in_cb = true;
+    p_ncm->rx_renew = false;
+    bool const accepted = tud_network_recv_cb(_ncmd_rx_ntb + idx, len);
+    p_ncm->rx_in_cb = false;
+
+    // not accepted, offered again on next tud_network_recv_renew()
+    if ( !accepted ) return;
+
+    if ( p_ncm->rx_renew )
+    {
+      // already released within callback e.g copied
+      p_ncm->rx_dg++;
+    }else
+    {
+      p_ncm->rx_held = true;
+    }
+  }
+}
+
+//--------------------------------------------------------------------+
+// Transmit
+//--------------------------------------------------------------------+
+
+// Offset of next datagram in NTB being filled
+static inline uint16_t _tx_datagram_offset(ncmd_interface_t const* p_ncm)
+{
+  uint8_t const fill = p_ncm->tx_fill;
+  return p_ncm->tx_count[fill] ? (uint16_t) tu_align_n(p_ncm->tx_len[fill] + NTB_ALIGN - 1, NTB_ALIGN) : DATAGRAM_IN_OFFSET;
+}
+
+// Send NTB being filled if IN endpoint is idle, datagrams queued meanwhile are aggregated
+static void _tx_start(ncmd_interface_t* p_ncm)
+{
+  uint8_t const fill = p_ncm->tx_fill;
+  uint8_t const count = p_ncm->tx_count[fill];
+
+  if ( !count || usbd_edpt_busy(p_ncm->rhport, p_ncm->ep_in) ) return;
+
+  uint8_t* ntb = _ncmd_tx_ntb[fill];
+  uint16_t len = p_ncm->tx_len[fill];
+
+  // NTB of exact multiple of packet size would need a zero-length packet, pad one byte instead.
+  // Space for it is reserved by tud_network_can_xmit().
+  if ( 0 == (len % p_ncm->ep_in_size) ) ntb[len++] = 0;
+
+  ncm_nth16_t* nth = (ncm_nth16_t*) ntb;
+  nth->dwSignature   = NCM_NTH16_SIGNATURE;
+  nth->wHeaderLength = sizeof(ncm_nth16_t);
+  nth->wSequence     = p_ncm->tx_seq++;
+  nth->wBlockLength  = len;
+  nth->wNdpIndex     = NDP_IN_OFFSET;
+
+  ncm_ndp16_t* ndp = (ncm_ndp16_t*) (ntb + NDP_IN_OFFSET);
+  ndp->dwSignature   = NCM_NDP16_SIGNATURE;
+  ndp->wLength       = (uint16_t) (sizeof(ncm_ndp16_t) + (count+1)*sizeof(ncm_ndp16_datagram_t));
+  ndp->wNextNdpIndex = 0;
+
+  // terminate datagram table
+  ncm_ndp16_datagram_t* dg = (ncm_ndp16_datagram_t*) (ndp + 1);
+  dg[count].wDatagramIndex  = 0;
+  dg[count].wDatagramLength = 0;
+
+  if ( usbd_edpt_xfer(p_ncm->rhport, p_ncm->ep_in, ntb, len) )
+  {
+    // fill the other NTB from now on
+    p_ncm->tx_fill = 1 - fill;
+    p_ncm->tx_count[1 - fill] = 0;
+    p_ncm->tx_len[1 - fill]   = 0;
+  }
+}
+
+//--------------------------------------------------------------------+
+// APPLICATION API
+//--------------------------------------------------------------------+
+bool tud_network_link_up(void)
+{
+  return 1 == _ncmd_itf.itf_data_alt;
+}
+
+void tud_network_recv_renew(void)
+{
+  ncmd_interface_t* p_ncm = &_ncmd_itf;
+
+  if ( p_ncm->rx_in_cb )
+  {
+    p_ncm->rx_renew = true;
+    return;
+  }
+
+  if ( p_ncm->rx_held )
+  {
+    p_ncm->rx_held = false;
+    p_ncm->rx_dg++;
+  }
+
+  _rx_deliver(p_ncm);
+}
+
+bool tud_network_can_xmit(uint16_t size)
+{
+  ncmd_interface_t const* p_ncm = &_ncmd_itf;
+
+  TU_VERIFY( p_ncm->itf_data_alt );
+  TU_VERIFY( p_ncm->tx_count[p_ncm->tx_fill] < CFG_TUD_NCM_IN_MAX_DATAGRAMS );
+
+  // one more byte is reserved for padding, see _tx_start()
+  return (uint32_t) _tx_datagram_offset(p_ncm) + size + 1 <= p_ncm->ntb_in_max;
+}
+
+void tud_network_xmit(void* ref, uint16_t arg)
+{
+  ncmd_interface_t* p_ncm = &_ncmd_itf;
+  uint8_t const fill = p_ncm->tx_fill;
+
+  TU_VERIFY( p_ncm->itf_data_alt && (p_ncm->tx_count[fill] < CFG_TUD_NCM_IN_MAX_DATAGRAMS), );
+
+  uint16_t const offset = _tx_datagram_offset(p_ncm);
+  uint16_t const len    = tud_network_xmit_cb(_ncmd_tx_ntb[fill] + offset, ref, arg);
+
+  // application must check with tud_network_can_xmit() first
+  TU_ASSERT( (uint32_t) offset + len + 1 <= p_ncm->ntb_in_max, );
+
+  ncm_ndp16_datagram_t* dg = (ncm_ndp16_datagram_t*) (_ncmd_tx_ntb[fill] + NDP_IN_OFFSET + sizeof(ncm_ndp16_t));
+  dg[p_ncm->tx_count[fill]].wDatagramIndex  = offset;
+  dg[p_ncm->tx_count[fill]].wDatagramLength = len;
+
+  p_ncm->tx_count[fill]++;
+  p_ncm->tx_len[fill] = (uint16_t) (offset + len);
+
+  _tx_start(p_ncm);
+}
+
+//--------------------------------------------------------------------+
+// USBD Driver API
+//--------------------------------------------------------------------+
+void ncmd_init(void)
+{
+  tu_varclr(&_ncmd_itf);
+  _ncmd_itf.ntb_in_max = CFG_TUD_NCM_IN_NTB_MAX_SIZE;
+}
+
+void ncmd_reset(uint8_t rhport)
+{
+  // interface in use by the other roothub port is untouched
+  if ( _ncmd_itf.ep_in && _ncmd_itf.rhport != rhport ) return;
+
+  ncmd_init();
+}
+
+bool ncmd_open(uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t *p_length, uint8_t *p_inst)
+{
+  (void) p_inst; // single instance
+
+  // reject other CDC subclass, handled by other driver
+  TU_VERIFY(CDC_COMM_SUBCLASS_NETWORK_CONTROL_MODEL == itf_desc->bInterfaceSubClass);
+
+  ncmd_interface_t* p_ncm = &_ncmd_itf;
+  TU_ASSERT(p_ncm->ep_in == 0);
+
+  //------------- Control Interface -------------//
+  p_ncm->rhport  = rhport;
+  p_ncm->itf_num = itf_desc->bInterfaceNumber;
+
+  uint8_t const * p_desc = tu_desc_next( itf_desc );
+  (*p_length) = sizeof(tusb_desc_interface_t);
+
+  // Communication Functional Descriptors
+  while ( TUSB_DESC_CS_INTERFACE == tu_desc_type(p_desc) )
+  {
+    (*p_length) += tu_desc_len(p_desc);
+    p_desc = tu_desc_next(p_desc);
+  }
+
+  // Notification endpoint
+  TU_ASSERT( TUSB_DESC_ENDPOINT == tu_desc_type(p_desc) );
+  TU_ASSERT( dcd_edpt_open(rhport, (tusb_desc_endpoint_t const *) p_desc) );
+  p_ncm->ep_notif = ((tusb_desc_endpoint_t const *) p_desc)->bEndpointAddress;
+
+  (*p_length) += tu_desc_len(p_desc);
+  p_desc = tu_desc_next(p_desc);
+
+  //------------- Data Interface -------------//
+  // Default alternate without endpoint
+  TU_ASSERT( (TUSB_DESC_INTERFACE == tu_desc_type(p_desc)) &&
+             (TUSB_CLASS_CDC_DATA == ((tusb_desc_interface_t const *) p_desc)->bInterfaceClass) );
+  (*p_length) += tu_desc_len(p_desc);
+  p_desc = tu_desc_next(p_desc);
+
+  // Alternate 1 with bulk endpoint pair
+  TU_ASSERT( (TUSB_DESC_INTERFACE == tu_desc_type(p_desc)) &&
+             (2 == ((tusb_desc_interface_t const *) p_desc)->bNumEndpoints) );
+  (*p_length) += tu_desc_len(p_desc);
+  p_desc = tu_desc_next(p_desc);
+
+  TU_ASSERT( usbd_open_edpt_pair(rhport, p_desc, 2, TUSB_XFER_BULK, &p_ncm->ep_out, &p_ncm->ep_in) );
+
+  tusb_desc_endpoint_t const* desc_ep = (tusb_desc_endpoint_t const*) p_desc;
+  if ( desc_ep->bEndpointAddress != p_ncm->ep_in ) desc_ep = (tusb_desc_endpoint_t const*) tu_desc_next(desc_ep);
+  p_ncm->ep_in_size = desc_ep->wMaxPacketSize.size;
+
+  (*p_length) += 2*sizeof(tusb_desc_endpoint_t);
+
+  return true;
+}
+
+// Invoked when class request DATA stage is finished.
+bool ncmd_control_complete(uint8_t rhport, tusb_control_request_t const * request)
+{
+  (void) rhport;
+
+  ncmd_interface_t* p_ncm = &_ncmd_itf;
+
+  if ( (TUSB_REQ_TYPE_CLASS == request->bmRequestType_bit.type) && (NCM_REQUEST_SET_NTB_INPUT_SIZE == request->bRequest) )
+  {
+    // NTB must still fit into our buffer
+    p_ncm->ntb_in_max = tu_min32(p_ncm->ntb_input[0], CFG_TUD_NCM_IN_NTB_MAX_SIZE);
+  }
+
+  return true;
+}
+
+// Handle class control request and (Get/Set) Interface of data interface
+// return false to stall control endpoint (e.g unsupported request)
+bool ncmd_control_request(uint8_t rhport, tusb_control_request_t const * request)
+{
+  ncmd_interface_t* p_ncm = &_ncmd_itf;
+
+  TU_VERIFY(TUSB_REQ_RCPT_INTERFACE == request->bmRequestType_bit.recipient);
+  uint8_t const itf = tu_u16_low(request->wIndex);
+
+  if ( TUSB_REQ_TYPE_STANDARD == request->bmRequestType_bit.type )
+  {
+    // only data interface has alternate setting
+    TU_VERIFY(itf == p_ncm->itf_num + 1);
+
+    switch ( request->bRequest )
+    {
+      case TUSB_REQ_GET_INTERFACE:
+        tud_control_xfer(rhport, request, &p_ncm->itf_data_alt, 1);
+      break;
+
+      case TUSB_REQ_SET_INTERFACE:
+      {
+        uint8_t const alt = (uint8_t) request->wValue;
+        TU_VERIFY(alt < 2);
+
+        // drop any pending datagram of previous setting
+        tu_memclr(((uint8_t*) p_ncm) + LINK_RESET_OFFSET, sizeof(ncmd_interface_t) - LINK_RESET_OFFSET);
+        p_ncm->itf_data_alt = alt;
+
+        tud_control_status(rhport, request);
+
+        if ( alt )
+        {
+          _prep_out_transaction(p_ncm);
+
+          // host expects speed before connection notification
+          _send_notification(p_ncm, NOTIF_SPEED_CHANGE);
+        }
+
+        if ( tud_network_link_state_cb ) tud_network_link_state_cb(alt == 1);
+      }
+      break;
+
+      default: return false;
+    }
+
+    return true;
+  }
+
+  //------------- Class Specific Request -------------//
+  TU_VERIFY(TUSB_REQ_TYPE_CLASS == request->bmRequestType_bit.type);
+  TU_VERIFY(itf == p_ncm->itf_num);
+
+  switch ( request->bRequest )
+  {
+    case NCM_REQUEST_GET_NTB_PARAMETERS:
+      tud_control_xfer(rhport, request, &_ntb_parameters, sizeof(_ntb_parameters));
+    break;
+
+    case NCM_REQUEST_GET_NTB_FORMAT:
+      tud_control_xfer(rhport, request, &p_ncm->ntb_format, sizeof(p_ncm->ntb_format));
+    break;
+
+    case NCM_REQUEST_SET_NTB_FORMAT:
+      // only 16-bit NTB is supported
+      TU_VERIFY(0 == request->wValue);
+      tud_control_status(rhport, request);
+    break;
+
+    case NCM_REQUEST_GET_NTB_INPUT_SIZE:
+      tud_control_xfer(rhport, request, &p_ncm->ntb_in_max, 4);
+    break;
+
+    case NCM_REQUEST_SET_NTB_INPUT_SIZE:
+      // applied in ncmd_control_complete()
+      tud_control_xfer(rhport, request, p_ncm->ntb_input, sizeof(p_ncm->ntb_input));
+    break;
+
+    case CDC_REQUEST_SET_ETHERNET_PACKET_FILTER:
+      // all packets are delivered to application anyway
+      tud_control_status(rhport, request);
+    break;
+
+    default: return false; // stall unsupported request
+  }
+
+  return true;
+}
+
+bool ncmd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes)
+{
+  (void) rhport;
+
+  ncmd_interface_t* p_ncm = &_ncmd_itf;
+
+  if ( ep_addr == p_ncm->ep_out )
+  {
+    // drop NTB of failed transfer, inactive link (completed after deactivation) or malformed header
+    if ( p_ncm->itf_data_alt && (XFER_RESULT_SUCCESS == result) && _rx_ntb_valid(xferred_bytes) )
+    {
+      ncm_nth16_t const* nth = (ncm_nth16_t const*) _ncmd_rx_ntb;
+
+      p_ncm->rx_len = nth->wBlockLength ? nth->wBlockLength : (uint16_t) xferred_bytes;
+      p_ncm->rx_ndp = nth->wNdpIndex;
+      p_ncm->rx_dg  = 0;
+
+      _rx_deliver(p_ncm);
+    }else
+    {
+      _prep_out_transaction(p_ncm);
+    }
+  }
+  else if ( ep_addr == p_ncm->ep_in )
+  {
+    // NTB is sent, datagrams queued meanwhile are sent together
+    _tx_start(p_ncm);
+  }
+  else if ( ep_addr == p_ncm->ep_notif )
+  {
+    if ( NOTIF_SPEED_CHANGE == p_ncm->notif_state ) _send_notification(p_ncm, NOTIF_CONNECTION);
+  }
+
+  return true;
+}
+
+#endif
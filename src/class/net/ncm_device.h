@@ -0,0 +1,113 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#ifndef _TUSB_NCM_DEVICE_H_
+#define _TUSB_NCM_DEVICE_H_
+
+#include "common/tusb_common.h"
+#include "device/usbd.h"
+#include "class/cdc/cdc.h"
+#include "ncm.h"
+
+//--------------------------------------------------------------------+
+// Class Driver Configuration
+//--------------------------------------------------------------------+
+
+// Size of NTB buffer for data sent to host, two of them are used to aggregate
+// datagrams into one while the other is on the wire
+#ifndef CFG_TUD_NCM_IN_NTB_MAX_SIZE
+#define CFG_TUD_NCM_IN_NTB_MAX_SIZE   2048
+#endif
+
+// Size of NTB buffer for data received from host
+#ifndef CFG_TUD_NCM_OUT_NTB_MAX_SIZE
+#define CFG_TUD_NCM_OUT_NTB_MAX_SIZE  2048
+#endif
+
+// Maximum number of datagrams aggregated into one NTB sent to host
+#ifndef CFG_TUD_NCM_IN_MAX_DATAGRAMS
+#define CFG_TUD_NCM_IN_MAX_DATAGRAMS  8
+#endif
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/** \addtogroup ClassDriver_NCM
+ *  @{
+ *  \defgroup   NCM_Device Device
+ *  @{ */
+
+//--------------------------------------------------------------------+
+// Application API
+//--------------------------------------------------------------------+
+
+// Check if host has activated the data interface
+bool tud_network_link_up(void);
+
+// Release datagram passed to tud_network_recv_cb(), next received datagram (if any) is then delivered
+void tud_network_recv_renew(void);
+
+// Check if a datagram of size bytes can be queued by tud_network_xmit() now
+bool tud_network_can_xmit(uint16_t size);
+
+// Queue a datagram, its content is copied by tud_network_xmit_cb(). Must be preceded by successful
+// tud_network_can_xmit(). Datagrams queued while previous NTB is on the wire are sent together.
+void tud_network_xmit(void* ref, uint16_t arg);
+
+//--------------------------------------------------------------------+
+// Application Callbacks (WEAK is optional)
+//--------------------------------------------------------------------+
+
+// Invoked when received a datagram. src points into receive NTB and stays valid until
+// tud_network_recv_renew() is called, e.g can be wrapped by lwIP PBUF_REF without copying.
+// Return false if it cannot be accepted now, it is then offered again on tud_network_recv_renew().
+bool tud_network_recv_cb(uint8_t const* src, uint16_t size);
+
+// Invoked by tud_network_xmit() to copy datagram into NTB e.g pbuf_copy_partial(), return its size
+uint16_t tud_network_xmit_cb(uint8_t* dst, void* ref, uint16_t arg);
+
+// Invoked when host (de)activates the data interface, all pending datagrams are dropped
+TU_ATTR_WEAK void tud_network_link_state_cb(bool up);
+
+/** @} */
+/** @} */
+
+//--------------------------------------------------------------------+
+// Internal Class Driver API
+//--------------------------------------------------------------------+
+void ncmd_init(void);
+void ncmd_reset(uint8_t rhport);
+bool ncmd_open(uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t *p_length, uint8_t *p_inst);
+bool ncmd_control_request(uint8_t rhport, tusb_control_request_t const * request);
+bool ncmd_control_complete(uint8_t rhport, tusb_control_request_t const * request);
+bool ncmd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes);
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif /* _TUSB_NCM_DEVICE_H_ */
@@ -0,0 +1,959 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#include "tusb_option.h"
+
+#if (TUSB_OPT_HOST_ENABLED && CFG_TUH_NET)
+
+//--------------------------------------------------------------------+
+// INCLUDE
+//--------------------------------------------------------------------+
+#include "common/tusb_common.h"
+#include "host/usbh_hcd.h"
+#include "class/cdc/cdc.h"
+#include "class/cdc/cdc_rndis.h"
+#include "ncm.h"
+#include "net_host.h"
+
+//--------------------------------------------------------------------+
+// MACRO CONSTANT TYPEDEF
+//--------------------------------------------------------------------+
+
+enum
+{
+  NETH_CTRL_BUFSIZE  = 128, // RNDIS responses and requests, MAC string descriptor
+  NETH_NOTIF_BUFSIZE = 16,  // CONNECTION_SPEED_CHANGE is the longest notification
+  NETH_RNDIS_HDR_LEN = sizeof(rndis_msg_packet_t),
+};
+
+// Initialization of an interface, named after the request in progress. Requests are issued
+// asynchronously from completion of the previous one since the control pipe is shared.
+enum
+{
+  NETH_STAGE_NONE = 0,
+  NETH_STAGE_NTB_PARAMS,     // NCM GET_NTB_PARAMETERS
+  NETH_STAGE_NTB_INPUT_SIZE, // NCM SET_NTB_INPUT_SIZE
+  NETH_STAGE_MAC_STRING,     // ECM/NCM iMACAddress string descriptor
+  NETH_STAGE_RNDIS_INIT,     // RNDIS INITIALIZE
+  NETH_STAGE_RNDIS_QUERY_MAC,// RNDIS QUERY OID_802_3_PERMANENT_ADDRESS
+  NETH_STAGE_PACKET_FILTER,  // SET_ETHERNET_PACKET_FILTER or RNDIS SET OID_GEN_CURRENT_PACKET_FILTER
+  NETH_STAGE_SET_ALT,        // ECM/NCM data interface with endpoints
+  NETH_STAGE_READY,
+  NETH_STAGE_FAILED,
+};
+
+typedef struct
+{
+  uint8_t rhport;
+  uint8_t dev_addr;
+  uint8_t itf_num;
+  uint8_t data_itf_num;
+  uint8_t data_alt;
+  uint8_t protocol;
+  uint8_t mac_str_idx;
+
+  uint8_t  ep_notif;
+  uint8_t  ep_in;
+  uint8_t  ep_out;
+  uint16_t ep_out_size;
+
+  uint8_t stage;
+  bool    ctrl_busy;  // control transfer of this interface in progress
+  bool    rndis_wait; // RNDIS message sent, waiting for its response
+  uint8_t rndis_resp; // RNDIS responses announced but not fetched yet
+  uint32_t rndis_req_id;
+
+  bool    link_up;
+  uint8_t mac[6];
+
+  // transmit: frame is placed after tx_hdr_len bytes of RNDIS/NCM header
+  bool     tx_busy;
+  uint16_t tx_hdr_len;
+  uint16_t tx_max;
+  uint16_t ntb_seq;
+  uint8_t  ndp_out_offset;
+
+  // receive buffers are armed and completed in ring order, head is the oldest completed one
+  uint8_t  rx_head;
+  uint8_t  rx_ready;
+  uint8_t  rx_armed;
+  bool     rx_held;   // frame handed to application is not renewed yet
+  bool     rx_halted; // pipe failed, buffers are not armed again
+  uint16_t rx_pos;    // next frame (ECM/RNDIS) or next NDP16 entry (NCM) of head buffer
+  uint16_t rx_ndp;    // current NDP16 of head buffer
+  uint16_t rx_len[CFG_TUH_NET_RX_BUFS];
+}neth_interface_t;
+
+TU_VERIFY_STATIC(CFG_TUH_NET_RX_BUFS <= 8, "too many receive buffers");
+
+//--------------------------------------------------------------------+
+// INTERNAL OBJECT & FUNCTION DECLARATION
+//--------------------------------------------------------------------+
+static neth_interface_t _neth_itf[CFG_TUH_NET];
+
+CFG_TUSB_MEM_SECTION TU_ATTR_ALIGNED(4) static uint8_t _neth_ctrl_buf [CFG_TUH_NET][NETH_CTRL_BUFSIZE];
+CFG_TUSB_MEM_SECTION TU_ATTR_ALIGNED(4) static uint8_t _neth_notif_buf[CFG_TUH_NET][NETH_NOTIF_BUFSIZE];
+CFG_TUSB_MEM_SECTION TU_ATTR_ALIGNED(4) static uint8_t _neth_tx_buf   [CFG_TUH_NET][CFG_TUH_NET_TX_BUFSIZE];
+CFG_TUSB_MEM_SECTION TU_ATTR_ALIGNED(4) static uint8_t _neth_rx_buf   [CFG_TUH_NET][CFG_TUH_NET_RX_BUFS][CFG_TUH_NET_RX_BUFSIZE];
+
+static void neth_control_complete(uint8_t dev_addr, tusb_control_request_t const * request, xfer_result_t result);
+
+static inline uint8_t get_inst(neth_interface_t const* p_net)
+{
+  return (uint8_t) (p_net - _neth_itf);
+}
+
+static inline neth_interface_t* get_instance(uint8_t dev_addr, uint8_t ep_addr)
+{
+  for(uint8_t i=0; i<CFG_TUH_NET; i++)
+  {
+    neth_interface_t* p_net = &_neth_itf[i];
+    if ( p_net->dev_addr == dev_addr && ep_addr &&
+         (ep_addr == p_net->ep_notif || ep_addr == p_net->ep_in || ep_addr == p_net->ep_out) ) return p_net;
+  }
+
+  return NULL;
+}
+
+// Frames and headers are little endian but not necessarily aligned
+static inline uint16_t get_le16(uint8_t const* p)
+{
+  return (uint16_t) (p[0] | (p[1] << 8));
+}
+
+static inline uint32_t get_le32(uint8_t const* p)
+{
+  return ((uint32_t) get_le16(p+2) << 16) | get_le16(p);
+}
+
+static inline void put_le16(uint8_t* p, uint16_t value)
+{
+  p[0] = (uint8_t) value;
+  p[1] = (uint8_t) (value >> 8);
+}
+
+static inline void put_le32(uint8_t* p, uint32_t value)
+{
+  put_le16(p  , (uint16_t) value);
+  put_le16(p+2, (uint16_t) (value >> 16));
+}
+
+static bool pipe_xfer(neth_interface_t* p_net, uint8_t ep_addr, uint8_t* buffer, uint16_t total_bytes)
+{
+  // HCD appends the transfer behind pending ones, completion isr must not modify the list meanwhile
+  hcd_int_disable(p_net->rhport);
+  bool const ret = hcd_pipe_xfer(p_net->dev_addr, ep_addr, buffer, total_bytes, true);
+  hcd_int_enable(p_net->rhport);
+
+  return ret;
+}
+
+static void set_link(neth_interface_t* p_net, bool up)
+{
+  if ( p_net->link_up == up ) return;
+
+  p_net->link_up = up;
+  if ( tuh_network_link_cb ) tuh_network_link_cb(get_inst(p_net), up);
+}
+
+//--------------------------------------------------------------------+
+// RECEIVE
+//--------------------------------------------------------------------+
+
+// Arm all buffers which are neither completed nor armed
+static void rx_arm(neth_interface_t* p_net)
+{
+  while ( !p_net->rx_halted && (p_net->rx_ready + p_net->rx_armed < CFG_TUH_NET_RX_BUFS) )
+  {
+    uint8_t const idx = (uint8_t) ((p_net->rx_head + p_net->rx_ready + p_net->rx_armed) % CFG_TUH_NET_RX_BUFS);
+    TU_VERIFY( pipe_xfer(p_net, p_net->ep_in, _neth_rx_buf[get_inst(p_net)][idx], CFG_TUH_NET_RX_BUFSIZE), );
+    p_net->rx_armed++;
+  }
+}
+
+static bool ncm_ndp_open(neth_interface_t* p_net, uint8_t const* buf, uint16_t len, uint16_t ndp)
+{
+  // NDPs are chained forward only, which also guards against a loop
+  TU_VERIFY( ndp > p_net->rx_ndp && ndp >= sizeof(ncm_nth16_t) );
+  TU_VERIFY( ndp + sizeof(ncm_ndp16_t) <= len && get_le32(buf + ndp) == NCM_NDP16_SIGNATURE );
+
+  p_net->rx_ndp = ndp;
+  p_net->rx_pos = (uint16_t) (ndp + sizeof(ncm_ndp16_t));
+
+  return true;
+}
+
+static bool ncm_next_frame(neth_interface_t* p_net, uint8_t const* buf, uint16_t len, uint8_t const** frame, uint16_t* size)
+{
+  // first NDP is pointed by NTB header
+  if ( 0 == p_net->rx_ndp )
+  {
+    TU_VERIFY( len >= sizeof(ncm_nth16_t) && get_le32(buf) == NCM_NTH16_SIGNATURE );
+    TU_VERIFY( ncm_ndp_open(p_net, buf, len, get_le16(buf + offsetof(ncm_nth16_t, wNdpIndex))) );
+  }
+
+  while (1)
+  {
+    TU_VERIFY( p_net->rx_pos + sizeof(ncm_ndp16_datagram_t) <= len );
+
+    uint16_t const index = get_le16(buf + p_net->rx_pos);
+    uint16_t const dlen  = get_le16(buf + p_net->rx_pos + 2);
+
+    if ( index == 0 || dlen == 0 )
+    {
+      // end of this table, continue with next NDP if any
+      uint16_t const next = get_le16(buf + p_net->rx_ndp + offsetof(ncm_ndp16_t, wNextNdpIndex));
+      TU_VERIFY( next && ncm_ndp_open(p_net, buf, len, next) );
+      continue;
+    }
+
+    p_net->rx_pos = (uint16_t) (p_net->rx_pos + sizeof(ncm_ndp16_datagram_t));
+
+    if ( index + dlen <= len )
+    {
+      *frame = buf + index;
+      *size  = dlen;
+      return true;
+    }
+  }
+}
+
+static bool rndis_next_frame(neth_interface_t* p_net, uint8_t const* buf, uint16_t len, uint8_t const** frame, uint16_t* size)
+{
+  // device may concatenate several packet messages in one transfer
+  while ( p_net->rx_pos + NETH_RNDIS_HDR_LEN <= len )
+  {
+    uint8_t const* msg = buf + p_net->rx_pos;
+    uint32_t const msg_len = get_le32(msg + offsetof(rndis_msg_packet_t, length));
+    uint32_t const offset  = get_le32(msg + offsetof(rndis_msg_packet_t, data_offset));
+    uint32_t const dlen    = get_le32(msg + offsetof(rndis_msg_packet_t, data_length));
+
+    TU_VERIFY( get_le32(msg) == RNDIS_MSG_PACKET );
+    TU_VERIFY( msg_len >= NETH_RNDIS_HDR_LEN && msg_len <= (uint32_t) (len - p_net->rx_pos) );
+
+    p_net->rx_pos = (uint16_t) (p_net->rx_pos + msg_len);
+
+    // data offset is counted from data_offset field
+    if ( dlen && (offsetof(rndis_msg_packet_t, data_offset) + offset + dlen <= msg_len) )
+    {
+      *frame = msg + offsetof(rndis_msg_packet_t, data_offset) + offset;
+      *size  = (uint16_t) dlen;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static bool rx_next_frame(neth_interface_t* p_net, uint8_t const* buf, uint16_t len, uint8_t const** frame, uint16_t* size)
+{
+  switch ( p_net->protocol )
+  {
+    case NETH_PROTOCOL_NCM  : return ncm_next_frame(p_net, buf, len, frame, size);
+    case NETH_PROTOCOL_RNDIS: return rndis_next_frame(p_net, buf, len, frame, size);
+
+    default:
+      // transfer is the frame
+      TU_VERIFY(p_net->rx_pos < len);
+      p_net->rx_pos = len;
+
+      *frame = buf;
+      *size  = len;
+      return true;
+  }
+}
+
+// Deliver frames of completed buffers until application holds one
+static void rx_process(neth_interface_t* p_net)
+{
+  uint8_t const inst = get_inst(p_net);
+
+  while ( p_net->rx_ready && !p_net->rx_held )
+  {
+    uint8_t const idx = p_net->rx_head;
+    uint8_t const* frame;
+    uint16_t size;
+
+    if ( rx_next_frame(p_net, _neth_rx_buf[inst][idx], p_net->rx_len[idx], &frame, &size) )
+    {
+      // buffer is kept until frame is renewed, other buffers are still receiving meanwhile
+      if ( !tuh_network_recv_cb(inst, frame, size) ) p_net->rx_held = true;
+    }else
+    {
+      // buffer is fully delivered or malformed, give it back to the pipe
+      p_net->rx_head = (uint8_t) ((idx + 1) % CFG_TUH_NET_RX_BUFS);
+      p_net->rx_ready--;
+      p_net->rx_pos = 0;
+      p_net->rx_ndp = 0;
+
+      rx_arm(p_net);
+    }
+  }
+}
+
+static void rx_complete(neth_interface_t* p_net, xfer_result_t event, uint32_t xferred_bytes)
+{
+  TU_VERIFY(p_net->rx_armed, );
+
+  uint8_t const idx = (uint8_t) ((p_net->rx_head + p_net->rx_ready) % CFG_TUH_NET_RX_BUFS);
+
+  p_net->rx_armed--;
+  p_net->rx_ready++;
+
+  if ( XFER_RESULT_SUCCESS == event )
+  {
+    p_net->rx_len[idx] = (uint16_t) xferred_bytes;
+  }else
+  {
+    p_net->rx_len[idx] = 0;
+    p_net->rx_halted   = true;
+  }
+
+  rx_process(p_net);
+}
+
+//--------------------------------------------------------------------+
+// CONTROL
+//--------------------------------------------------------------------+
+
+static bool rndis_send(neth_interface_t* p_net, uint8_t* msg, uint16_t len, tusb_control_request_t* request)
+{
+  put_le32(msg + 4, len);
+  put_le32(msg + 8, ++p_net->rndis_req_id);
+
+  request->bmRequestType = 0x21; // class, interface, OUT
+  request->bRequest      = CDC_REQUEST_SEND_ENCAPSULATED_COMMAND;
+  request->wLength       = len;
+
+  return true;
+}
+
+// Build request of current stage, or of RNDIS response retrieval
+static bool ctrl_request(neth_interface_t* p_net, tusb_control_request_t* request, uint8_t* buf)
+{
+  request->bmRequestType = 0xA1; // class, interface, IN
+  request->wValue        = 0;
+  request->wIndex        = p_net->itf_num;
+  request->wLength       = 0;
+
+  if ( p_net->rndis_resp )
+  {
+    p_net->rndis_resp--;
+    tu_memclr(buf, NETH_CTRL_BUFSIZE);
+
+    request->bRequest = CDC_REQUEST_GET_ENCAPSULATED_RESPONSE;
+    request->wLength  = NETH_CTRL_BUFSIZE;
+    return true;
+  }
+
+  // RNDIS message sent, next step is triggered by its response
+  TU_VERIFY( !p_net->rndis_wait && p_net->stage < NETH_STAGE_READY );
+
+  tu_memclr(buf, NETH_CTRL_BUFSIZE);
+
+  switch ( p_net->stage )
+  {
+    case NETH_STAGE_NTB_PARAMS:
+      request->bRequest = NCM_REQUEST_GET_NTB_PARAMETERS;
+      request->wLength  = sizeof(ncm_ntb_parameters_t);
+    break;
+
+    case NETH_STAGE_NTB_INPUT_SIZE:
+      // NTB must fit receive buffer
+      request->bmRequestType = 0x21;
+      request->bRequest      = NCM_REQUEST_SET_NTB_INPUT_SIZE;
+      request->wLength       = 4;
+      put_le32(buf, CFG_TUH_NET_RX_BUFSIZE);
+    break;
+
+    case NETH_STAGE_MAC_STRING:
+      request->bmRequestType = 0x80; // standard, device, IN
+      request->bRequest      = TUSB_REQ_GET_DESCRIPTOR;
+      request->wValue        = (uint16_t) ((TUSB_DESC_STRING << 8) | p_net->mac_str_idx);
+      request->wIndex        = 0x0409;
+      request->wLength       = 2 + 2*12;
+    break;
+
+    case NETH_STAGE_RNDIS_INIT:
+      put_le32(buf, RNDIS_MSG_INITIALIZE);
+      put_le32(buf + offsetof(rndis_msg_initialize_t, major_version), 1);
+      put_le32(buf + offsetof(rndis_msg_initialize_t, max_xfer_size), CFG_TUH_NET_RX_BUFSIZE);
+      return rndis_send(p_net, buf, sizeof(rndis_msg_initialize_t), request);
+
+    case NETH_STAGE_RNDIS_QUERY_MAC:
+      put_le32(buf, RNDIS_MSG_QUERY);
+      put_le32(buf + offsetof(rndis_msg_query_t, oid), RNDIS_OID_802_3_PERMANENT_ADDRESS);
+      return rndis_send(p_net, buf, sizeof(rndis_msg_query_t), request);
+
+    case NETH_STAGE_PACKET_FILTER:
+      if ( NETH_PROTOCOL_RNDIS == p_net->protocol )
+      {
+        // input buffer follows the message, its offset is counted from request_id
+        put_le32(buf, RNDIS_MSG_SET);
+        put_le32(buf + offsetof(rndis_msg_set_t, oid)          , RNDIS_OID_GEN_CURRENT_PACKET_FILTER);
+        put_le32(buf + offsetof(rndis_msg_set_t, buffer_length), 4);
+        put_le32(buf + offsetof(rndis_msg_set_t, buffer_offset), sizeof(rndis_msg_set_t) - offsetof(rndis_msg_set_t, request_id));
+        put_le32(buf + sizeof(rndis_msg_set_t), RNDIS_PACKET_TYPE_DIRECTED | RNDIS_PACKET_TYPE_ALL_MULTICAST | RNDIS_PACKET_TYPE_BROADCAST);
+        return rndis_send(p_net, buf, sizeof(rndis_msg_set_t) + 4, request);
+      }
+
+      // directed, broadcast and all multicast
+      request->bmRequestType = 0x21;
+      request->bRequest      = CDC_REQUEST_SET_ETHERNET_PACKET_FILTER;
+      request->wValue        = 0x000E;
+    break;
+
+    case NETH_STAGE_SET_ALT:
+      request->bmRequestType = 0x01; // standard, interface, OUT
+      request->bRequest      = TUSB_REQ_SET_INTERFACE;
+      request->wValue        = p_net->data_alt;
+      request->wIndex        = p_net->data_itf_num;
+    break;
+
+    default: return false;
+  }
+
+  return true;
+}
+
+// Start next control request of the interface if the shared control pipe is free
+static void ctrl_start(neth_interface_t* p_net)
+{
+  if ( p_net->ctrl_busy || p_net->stage == NETH_STAGE_FAILED ) return;
+
+  uint8_t* buf = _neth_ctrl_buf[get_inst(p_net)];
+  tusb_control_request_t request;
+  uint8_t const resp = p_net->rndis_resp;
+
+  if ( !ctrl_request(p_net, &request, buf) ) return;
+
+  // pipe busy with another interface or application, retried when it completes
+  if ( tuh_control_xfer(p_net->dev_addr, &request, buf, neth_control_complete) )
+  {
+    p_net->ctrl_busy = true;
+  }else
+  {
+    p_net->rndis_resp = resp;
+  }
+}
+
+static void neth_ready(neth_interface_t* p_net)
+{
+  p_net->stage = NETH_STAGE_READY;
+
+  rx_arm(p_net);
+
+  if ( tuh_network_mounted_cb ) tuh_network_mounted_cb(get_inst(p_net));
+
+  // RNDIS has no connection notification before a status indication
+  if ( NETH_PROTOCOL_RNDIS == p_net->protocol ) set_link(p_net, true);
+}
+
+static void rndis_response(neth_interface_t* p_net, uint8_t const* msg)
+{
+  uint32_t const type    = get_le32(msg);
+  uint32_t const msg_len = get_le32(msg + 4);
+  uint32_t const status  = get_le32(msg + 12);
+
+  TU_VERIFY( msg_len <= NETH_CTRL_BUFSIZE, );
+
+  if ( RNDIS_MSG_INDICATE_STATUS == type )
+  {
+    // status follows type and length
+    uint32_t const indication = get_le32(msg + 8);
+    if ( RNDIS_STATUS_MEDIA_CONNECT    == indication ) set_link(p_net, true);
+    if ( RNDIS_STATUS_MEDIA_DISCONNECT == indication ) set_link(p_net, false);
+    return;
+  }
+
+  // response of message has request id of it
+  TU_VERIFY( p_net->rndis_wait && (type & 0x80000000UL) && get_le32(msg + 8) == p_net->rndis_req_id, );
+  p_net->rndis_wait = false;
+
+  if ( RNDIS_STATUS_SUCCESS != status )
+  {
+    p_net->stage = NETH_STAGE_FAILED;
+    return;
+  }
+
+  switch ( p_net->stage )
+  {
+    case NETH_STAGE_RNDIS_INIT:
+    {
+      TU_VERIFY( RNDIS_MSG_INITIALIZE_CMPLT == type, );
+
+      // we send one packet message per transfer
+      uint32_t const max_xfer = get_le32(msg + offsetof(rndis_msg_initialize_cmplt_t, max_xfer_size));
+      p_net->tx_max = (uint16_t) tu_min32(max_xfer, CFG_TUH_NET_TX_BUFSIZE);
+      p_net->stage  = NETH_STAGE_RNDIS_QUERY_MAC;
+    }
+    break;
+
+    case NETH_STAGE_RNDIS_QUERY_MAC:
+    {
+      TU_VERIFY( RNDIS_MSG_QUERY_CMPLT == type, );
+
+      uint32_t const len    = get_le32(msg + offsetof(rndis_msg_query_cmplt_t, buffer_length));
+      uint32_t const offset = get_le32(msg + offsetof(rndis_msg_query_cmplt_t, buffer_offset));
+
+      if ( len < 6 || (offsetof(rndis_msg_query_cmplt_t, request_id) + offset + 6 > msg_len) )
+      {
+        p_net->stage = NETH_STAGE_FAILED;
+        return;
+      }
+
+      memcpy(p_net->mac, msg + offsetof(rndis_msg_query_cmplt_t, request_id) + offset, 6);
+      p_net->stage = NETH_STAGE_PACKET_FILTER;
+    }
+    break;
+
+    case NETH_STAGE_PACKET_FILTER:
+      TU_VERIFY( RNDIS_MSG_SET_CMPLT == type, );
+      neth_ready(p_net);
+    break;
+
+    default: break;
+  }
+}
+
+static bool parse_mac_string(uint8_t mac[6], uint8_t const* desc)
+{
+  // 12 hex digits in UTF-16LE
+  TU_VERIFY( desc[0] >= 2 + 2*12 && desc[1] == TUSB_DESC_STRING );
+
+  for(uint8_t i=0; i<12; i++)
+  {
+    uint8_t const c = (uint8_t) (desc[2 + 2*i] | 0x20); // lower case
+    uint8_t nibble;
+
+    if ( '0' <= c && c <= '9' )
+    {
+      nibble = (uint8_t) (c - '0');
+    }else if ( 'a' <= c && c <= 'f' )
+    {
+      nibble = (uint8_t) (c - 'a' + 10);
+    }else
+    {
+      return false;
+    }
+
+    mac[i/2] = (uint8_t) ((mac[i/2] << 4) | nibble);
+  }
+
+  return true;
+}
+
+static void ncm_ntb_parameters(neth_interface_t* p_net, ncm_ntb_parameters_t const* param)
+{
+  uint16_t divisor   = param->wNdpOutDivisor ? param->wNdpOutDivisor : 4;
+  uint16_t remainder = (uint16_t) (param->wNdpOutPayloadRemainder % divisor);
+  uint16_t align     = tu_min16(tu_max16(param->wNdpOutAlignment, 4), 64);
+
+  // NTB sent to device: header, NDP16 with one datagram and terminating entry, then the datagram
+  uint16_t const ndp = (uint16_t) ((sizeof(ncm_nth16_t) + align - 1) / align * align);
+  uint16_t const ndp_end = (uint16_t) (ndp + sizeof(ncm_ndp16_t) + 2*sizeof(ncm_ndp16_datagram_t));
+
+  uint16_t offset = remainder;
+  while ( offset < ndp_end ) offset = (uint16_t) (offset + divisor);
+
+  p_net->ndp_out_offset = (uint8_t) ndp;
+  p_net->tx_hdr_len     = offset;
+  p_net->tx_max         = (uint16_t) tu_min32(param->dwNtbOutMaxSize, CFG_TUH_NET_TX_BUFSIZE);
+}
+
+static void ctrl_stage_complete(neth_interface_t* p_net, tusb_control_request_t const * request, xfer_result_t result)
+{
+  uint8_t const* buf = _neth_ctrl_buf[get_inst(p_net)];
+
+  if ( CDC_REQUEST_GET_ENCAPSULATED_RESPONSE == request->bRequest && 0xA1 == request->bmRequestType )
+  {
+    if ( XFER_RESULT_SUCCESS == result ) rndis_response(p_net, buf);
+    return;
+  }
+
+  if ( NETH_PROTOCOL_RNDIS == p_net->protocol )
+  {
+    // message sent, response is announced by notification
+    if ( XFER_RESULT_SUCCESS == result )
+    {
+      p_net->rndis_wait = true;
+    }else
+    {
+      p_net->stage = NETH_STAGE_FAILED;
+    }
+    return;
+  }
+
+  // packet filter is optional for some devices
+  if ( XFER_RESULT_SUCCESS != result && NETH_STAGE_PACKET_FILTER != p_net->stage )
+  {
+    p_net->stage = NETH_STAGE_FAILED;
+    return;
+  }
+
+  switch ( p_net->stage )
+  {
+    case NETH_STAGE_NTB_PARAMS:
+      ncm_ntb_parameters(p_net, (ncm_ntb_parameters_t const*) buf);
+      p_net->stage = NETH_STAGE_NTB_INPUT_SIZE;
+    break;
+
+    case NETH_STAGE_NTB_INPUT_SIZE:
+      p_net->stage = p_net->mac_str_idx ? NETH_STAGE_MAC_STRING : NETH_STAGE_PACKET_FILTER;
+    break;
+
+    case NETH_STAGE_MAC_STRING:
+      if ( !parse_mac_string(p_net->mac, buf) ) tu_memclr(p_net->mac, sizeof(p_net->mac));
+      p_net->stage = NETH_STAGE_PACKET_FILTER;
+    break;
+
+    case NETH_STAGE_PACKET_FILTER:
+      p_net->stage = NETH_STAGE_SET_ALT;
+    break;
+
+    case NETH_STAGE_SET_ALT:
+      neth_ready(p_net);
+    break;
+
+    default: break;
+  }
+}
+
+static void neth_control_complete(uint8_t dev_addr, tusb_control_request_t const * request, xfer_result_t result)
+{
+  // only one control transfer of a device is in progress
+  for(uint8_t i=0; i<CFG_TUH_NET; i++)
+  {
+    neth_interface_t* p_net = &_neth_itf[i];
+    if ( p_net->dev_addr == dev_addr && p_net->ctrl_busy )
+    {
+      p_net->ctrl_busy = false;
+      ctrl_stage_complete(p_net, request, result);
+      break;
+    }
+  }
+
+  // pipe is free, continue interfaces of this device waiting for it
+  for(uint8_t i=0; i<CFG_TUH_NET; i++)
+  {
+    if ( _neth_itf[i].dev_addr == dev_addr ) ctrl_start(&_neth_itf[i]);
+  }
+}
+
+static void notif_complete(neth_interface_t* p_net, xfer_result_t event)
+{
+  // interrupt pipe is not polled anymore after an error
+  TU_VERIFY( XFER_RESULT_SUCCESS == event, );
+
+  uint8_t const* buf = _neth_notif_buf[get_inst(p_net)];
+
+  if ( NETH_PROTOCOL_RNDIS == p_net->protocol )
+  {
+    // RNDIS notification is RESPONSE_AVAILABLE only
+    p_net->rndis_resp++;
+    ctrl_start(p_net);
+  }
+  else if ( NETWORK_CONNECTION == buf[1] )
+  {
+    set_link(p_net, get_le16(buf + 2) != 0);
+  }
+
+  pipe_xfer(p_net, p_net->ep_notif, _neth_notif_buf[get_inst(p_net)], NETH_NOTIF_BUFSIZE);
+}
+
+//--------------------------------------------------------------------+
+// APPLICATION API
+//--------------------------------------------------------------------+
+bool tuh_network_n_mounted(uint8_t inst)
+{
+  TU_VERIFY(inst < CFG_TUH_NET);
+  return _neth_itf[inst].stage == NETH_STAGE_READY && tuh_device_is_configured(_neth_itf[inst].dev_addr);
+}
+
+uint8_t tuh_network_n_dev_addr(uint8_t inst)
+{
+  return _neth_itf[inst].dev_addr;
+}
+
+uint8_t tuh_network_n_protocol(uint8_t inst)
+{
+  return _neth_itf[inst].protocol;
+}
+
+bool tuh_network_n_link_up(uint8_t inst)
+{
+  return tuh_network_n_mounted(inst) && _neth_itf[inst].link_up;
+}
+
+uint8_t const* tuh_network_n_mac_addr(uint8_t inst)
+{
+  return _neth_itf[inst].mac;
+}
+
+void tuh_network_n_recv_renew(uint8_t inst)
+{
+  TU_VERIFY(inst < CFG_TUH_NET, );
+  neth_interface_t* p_net = &_neth_itf[inst];
+
+  p_net->rx_held = false;
+  rx_process(p_net);
+}
+
+bool tuh_network_n_can_xmit(uint8_t inst, uint16_t size)
+{
+  TU_VERIFY( tuh_network_n_link_up(inst) );
+  neth_interface_t const* p_net = &_neth_itf[inst];
+
+  // one byte is reserved to pad a transfer of multiple packet size
+  return !p_net->tx_busy && (p_net->tx_hdr_len + size < p_net->tx_max);
+}
+
+bool tuh_network_n_xmit(uint8_t inst, void* ref, uint16_t arg)
+{
+  TU_VERIFY( tuh_network_n_link_up(inst) );
+  neth_interface_t* p_net = &_neth_itf[inst];
+  TU_VERIFY( !p_net->tx_busy );
+
+  uint8_t* buf = _neth_tx_buf[inst];
+  uint16_t const hdr_len = p_net->tx_hdr_len;
+
+  tu_memclr(buf, hdr_len);
+
+  uint16_t const size = tuh_network_xmit_cb(inst, buf + hdr_len, ref, arg);
+  TU_VERIFY( size && (hdr_len + size < p_net->tx_max) );
+
+  uint16_t total = (uint16_t) (hdr_len + size);
+
+  if ( NETH_PROTOCOL_NCM == p_net->protocol )
+  {
+    uint8_t* ndp = buf + p_net->ndp_out_offset;
+
+    put_le32(buf, NCM_NTH16_SIGNATURE);
+    put_le16(buf + offsetof(ncm_nth16_t, wHeaderLength), sizeof(ncm_nth16_t));
+    put_le16(buf + offsetof(ncm_nth16_t, wSequence)    , p_net->ntb_seq++);
+    put_le16(buf + offsetof(ncm_nth16_t, wBlockLength) , total);
+    put_le16(buf + offsetof(ncm_nth16_t, wNdpIndex)    , p_net->ndp_out_offset);
+
+    // single datagram followed by zeroed terminating entry
+    put_le32(ndp, NCM_NDP16_SIGNATURE);
+    put_le16(ndp + offsetof(ncm_ndp16_t, wLength), sizeof(ncm_ndp16_t) + 2*sizeof(ncm_ndp16_datagram_t));
+    put_le16(ndp + sizeof(ncm_ndp16_t)    , hdr_len);
+    put_le16(ndp + sizeof(ncm_ndp16_t) + 2, size);
+  }
+  else if ( NETH_PROTOCOL_RNDIS == p_net->protocol )
+  {
+    put_le32(buf, RNDIS_MSG_PACKET);
+    put_le32(buf + offsetof(rndis_msg_packet_t, length)     , total);
+    put_le32(buf + offsetof(rndis_msg_packet_t, data_offset), NETH_RNDIS_HDR_LEN - offsetof(rndis_msg_packet_t, data_offset));
+    put_le32(buf + offsetof(rndis_msg_packet_t, data_length), size);
+  }
+
+  // short packet terminates the transfer, a padding byte is sent instead of a zero length packet
+  if ( 0 == (total % p_net->ep_out_size) ) buf[total++] = 0;
+
+  p_net->tx_busy = true;
+  if ( !pipe_xfer(p_net, p_net->ep_out, buf, total) )
+  {
+    p_net->tx_busy = false;
+    return false;
+  }
+
+  return true;
+}
+
+//--------------------------------------------------------------------+
+// USBH-CLASS API
+//--------------------------------------------------------------------+
+void neth_init(void)
+{
+  tu_memclr(_neth_itf, sizeof(_neth_itf));
+}
+
+static uint8_t neth_protocol(tusb_desc_interface_t const *itf_desc)
+{
+  if ( TUSB_CLASS_CDC == itf_desc->bInterfaceClass )
+  {
+    if ( CDC_COMM_SUBCLASS_ETHERNET_NETWORKING_CONTROL_MODEL == itf_desc->bInterfaceSubClass ) return NETH_PROTOCOL_ECM;
+    if ( CDC_COMM_SUBCLASS_NETWORK_CONTROL_MODEL == itf_desc->bInterfaceSubClass ) return NETH_PROTOCOL_NCM;
+
+    // RNDIS as presented to Windows: ACM with vendor specific protocol
+    if ( CDC_COMM_SUBCLASS_ABSTRACT_CONTROL_MODEL == itf_desc->bInterfaceSubClass &&
+         0xff == itf_desc->bInterfaceProtocol ) return NETH_PROTOCOL_RNDIS;
+  }
+
+  // Wireless controller, RF controller, RNDIS
+  if ( TUSB_CLASS_WIRELESS_CONTROLLER == itf_desc->bInterfaceClass &&
+       0x01 == itf_desc->bInterfaceSubClass && 0x03 == itf_desc->bInterfaceProtocol ) return NETH_PROTOCOL_RNDIS;
+
+  return 0;
+}
+
+bool neth_open(uint8_t rhport, uint8_t dev_addr, tusb_desc_interface_t const *itf_desc, uint16_t *p_length)
+{
+  uint8_t const protocol = neth_protocol(itf_desc);
+  TU_VERIFY(protocol);
+
+  tusb_desc_endpoint_t const* ep_notif = NULL;
+  tusb_desc_endpoint_t const* ep_data[2] = { NULL, NULL };
+  uint8_t mac_str_idx = 0;
+
+  // communication interface: functional descriptors and notification endpoint up to data interface
+  uint8_t const* p_desc = tu_desc_next(itf_desc);
+  while ( TUSB_DESC_INTERFACE != tu_desc_type(p_desc) )
+  {
+    if ( TUSB_DESC_CS_INTERFACE == tu_desc_type(p_desc) && CDC_FUNC_DESC_ETHERNET_NETWORKING == p_desc[2] )
+    {
+      mac_str_idx = p_desc[3];
+    }
+    else if ( TUSB_DESC_ENDPOINT == tu_desc_type(p_desc) )
+    {
+      tusb_desc_endpoint_t const* desc_ep = (tusb_desc_endpoint_t const*) p_desc;
+      if ( TUSB_XFER_INTERRUPT == desc_ep->bmAttributes.xfer && TUSB_DIR_IN == tu_edpt_dir(desc_ep->bEndpointAddress) ) ep_notif = desc_ep;
+    }
+
+    p_desc = tu_desc_next(p_desc);
+  }
+
+  // data interface: ECM/NCM have alternate 0 without endpoints followed by the one with bulk endpoints
+  tusb_desc_interface_t const* data_itf = (tusb_desc_interface_t const*) p_desc;
+  TU_VERIFY( TUSB_CLASS_CDC_DATA == data_itf->bInterfaceClass );
+
+  uint8_t data_alt = 0;
+  while ( !ep_data[0] || !ep_data[1] )
+  {
+    tusb_desc_interface_t const* desc_itf = (tusb_desc_interface_t const*) p_desc;
+    TU_VERIFY( TUSB_DESC_INTERFACE == tu_desc_type(p_desc) && desc_itf->bInterfaceNumber == data_itf->bInterfaceNumber );
+
+    data_alt = desc_itf->bAlternateSetting;
+    p_desc = tu_desc_next(p_desc);
+
+    uint8_t ep_count = 0;
+    while ( ep_count < desc_itf->bNumEndpoints )
+    {
+      if ( TUSB_DESC_ENDPOINT == tu_desc_type(p_desc) )
+      {
+        tusb_desc_endpoint_t const* desc_ep = (tusb_desc_endpoint_t const*) p_desc;
+        if ( TUSB_XFER_BULK == desc_ep->bmAttributes.xfer ) ep_data[tu_edpt_dir(desc_ep->bEndpointAddress)] = desc_ep;
+        ep_count++;
+      }
+      p_desc = tu_desc_next(p_desc);
+    }
+  }
+
+  *p_length = (uint16_t) (p_desc - (uint8_t const*) itf_desc);
+
+  // RNDIS messages are answered through notification
+  TU_VERIFY( ep_notif || NETH_PROTOCOL_RNDIS != protocol );
+
+  // Find available interface
+  uint8_t inst;
+  for(inst=0; inst<CFG_TUH_NET; inst++)
+  {
+    if ( _neth_itf[inst].dev_addr == 0 ) break;
+  }
+  TU_VERIFY(inst < CFG_TUH_NET);
+
+  neth_interface_t* p_net = &_neth_itf[inst];
+  tu_memclr(p_net, sizeof(neth_interface_t));
+
+  TU_ASSERT( hcd_edpt_open(rhport, dev_addr, ep_data[TUSB_DIR_IN]) );
+  TU_ASSERT( hcd_edpt_open(rhport, dev_addr, ep_data[TUSB_DIR_OUT]) );
+  if ( ep_notif ) TU_ASSERT( hcd_edpt_open(rhport, dev_addr, ep_notif) );
+
+  p_net->rhport       = rhport;
+  p_net->dev_addr     = dev_addr;
+  p_net->itf_num      = itf_desc->bInterfaceNumber;
+  p_net->data_itf_num = data_itf->bInterfaceNumber;
+  p_net->data_alt     = data_alt;
+  p_net->protocol     = protocol;
+  p_net->mac_str_idx  = mac_str_idx;
+  p_net->ep_notif     = ep_notif ? ep_notif->bEndpointAddress : 0;
+  p_net->ep_in        = ep_data[TUSB_DIR_IN]->bEndpointAddress;
+  p_net->ep_out       = ep_data[TUSB_DIR_OUT]->bEndpointAddress;
+  p_net->ep_out_size  = ep_data[TUSB_DIR_OUT]->wMaxPacketSize.size;
+  p_net->tx_max       = CFG_TUH_NET_TX_BUFSIZE;
+
+  switch (protocol)
+  {
+    case NETH_PROTOCOL_NCM:
+      p_net->stage = NETH_STAGE_NTB_PARAMS;
+    break;
+
+    case NETH_PROTOCOL_RNDIS:
+      p_net->tx_hdr_len = NETH_RNDIS_HDR_LEN;
+      p_net->stage      = NETH_STAGE_RNDIS_INIT;
+    break;
+
+    default:
+      p_net->stage = mac_str_idx ? NETH_STAGE_MAC_STRING : NETH_STAGE_PACKET_FILTER;
+    break;
+  }
+
+  if ( p_net->ep_notif ) pipe_xfer(p_net, p_net->ep_notif, _neth_notif_buf[inst], NETH_NOTIF_BUFSIZE);
+
+  // device is configured and its control pipe is idle here, initialization runs asynchronously
+  ctrl_start(p_net);
+
+  return true;
+}
+
+void neth_xfer_cb(uint8_t dev_addr, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes)
+{
+  // may be stale if device is removed after transfer completed
+  neth_interface_t* p_net = get_instance(dev_addr, ep_addr);
+  TU_VERIFY(p_net, );
+
+  if ( ep_addr == p_net->ep_notif )
+  {
+    notif_complete(p_net, event);
+  }
+  else if ( ep_addr == p_net->ep_in )
+  {
+    rx_complete(p_net, event, xferred_bytes);
+  }
+  else
+  {
+    p_net->tx_busy = false;
+    if ( tuh_network_xmit_done_cb ) tuh_network_xmit_done_cb(get_inst(p_net));
+  }
+}
+
+void neth_close(uint8_t dev_addr)
+{
+  for(uint8_t inst=0; inst<CFG_TUH_NET; inst++)
+  {
+    neth_interface_t* p_net = &_neth_itf[inst];
+
+    if ( p_net->dev_addr == dev_addr )
+    {
+      // held frame becomes invalid, pipes are closed by usbh
+      if ( NETH_STAGE_READY == p_net->stage && tuh_network_unmounted_cb ) tuh_network_unmounted_cb(inst);
+      tu_memclr(p_net, sizeof(neth_interface_t));
+    }
+  }
+}
+
+#endif
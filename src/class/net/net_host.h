@@ -0,0 +1,113 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+/** \ingroup group_class
+ *  \defgroup ClassDriver_NetHost Network Host (RNDIS, CDC-ECM, CDC-NCM)
+ *  @{ */
+
+#ifndef _TUSB_NET_HOST_H_
+#define _TUSB_NET_HOST_H_
+
+#include "common/tusb_common.h"
+#include "host/usbh.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+//--------------------------------------------------------------------+
+// Class Driver Configuration
+//--------------------------------------------------------------------+
+// CFG_TUH_NET is the number of network interfaces across all devices. Each has CFG_TUH_NET_RX_BUFS
+// bulk IN transfers of CFG_TUH_NET_RX_BUFSIZE armed so that the pipe keeps receiving while
+// application is still holding a frame (tusb_option.h).
+
+typedef enum
+{
+  NETH_PROTOCOL_ECM = 1,
+  NETH_PROTOCOL_NCM,
+  NETH_PROTOCOL_RNDIS,
+}neth_protocol_t;
+
+//--------------------------------------------------------------------+
+// Application API
+// inst is instance index in order interfaces are mounted. Must be called in the same context as tuh_task()
+//--------------------------------------------------------------------+
+bool    tuh_network_n_mounted   (uint8_t inst);
+uint8_t tuh_network_n_dev_addr  (uint8_t inst);
+uint8_t tuh_network_n_protocol  (uint8_t inst);
+
+// Whether device reports its link up, frames are only transferred when it is
+bool    tuh_network_n_link_up   (uint8_t inst);
+
+// MAC address of the device (iMACAddress of ECM/NCM, permanent address of RNDIS)
+uint8_t const* tuh_network_n_mac_addr(uint8_t inst);
+
+// Release frame held by application after tuh_network_recv_cb() returned false, next frames are delivered
+void    tuh_network_n_recv_renew(uint8_t inst);
+
+// Whether a frame of size bytes can be sent now
+bool    tuh_network_n_can_xmit  (uint8_t inst, uint16_t size);
+
+// Send a frame, tuh_network_xmit_cb() is invoked to copy it into the transfer buffer
+bool    tuh_network_n_xmit      (uint8_t inst, void* ref, uint16_t arg);
+
+//--------------------------------------------------------------------+
+// Application Callback API (weak is optional)
+//--------------------------------------------------------------------+
+
+// Invoked when interface is mounted (MAC address is known) and unmounted
+TU_ATTR_WEAK void tuh_network_mounted_cb(uint8_t inst);
+TU_ATTR_WEAK void tuh_network_unmounted_cb(uint8_t inst);
+
+// Invoked when link status of device changes
+TU_ATTR_WEAK void tuh_network_link_cb(uint8_t inst, bool up);
+
+// Invoked with an ethernet frame pointing into the receive buffer. Return true if frame is consumed
+// (copied), or false to keep the buffer e.g referenced by a PBUF_REF pbuf until tuh_network_n_recv_renew().
+bool tuh_network_recv_cb(uint8_t inst, uint8_t const* src, uint16_t size);
+
+// Invoked by tuh_network_n_xmit() to copy the frame into dst, return its size
+uint16_t tuh_network_xmit_cb(uint8_t inst, uint8_t* dst, void* ref, uint16_t arg);
+
+// Invoked when a frame is sent, another one can be submitted
+TU_ATTR_WEAK void tuh_network_xmit_done_cb(uint8_t inst);
+
+//--------------------------------------------------------------------+
+// Internal Class Driver API
+//--------------------------------------------------------------------+
+void neth_init(void);
+bool neth_open(uint8_t rhport, uint8_t dev_addr, tusb_desc_interface_t const *p_interface_desc, uint16_t *p_length);
+void neth_xfer_cb(uint8_t dev_addr, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes);
+void neth_close(uint8_t dev_addr);
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif /* _TUSB_NET_HOST_H_ */
+
+/** @} */
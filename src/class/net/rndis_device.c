@@ -0,0 +1,664 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#include "tusb_option.h"
+
+#if (TUSB_OPT_DEVICE_ENABLED && CFG_TUD_RNDIS)
+
+#include "rndis_device.h"
+#include "device/usbd_pvt.h"
+
+//--------------------------------------------------------------------+
+// MACRO CONSTANT TYPEDEF
+//--------------------------------------------------------------------+
+
+// Packet messages of both directions start 4-byte aligned (alignment factor 2^2),
+// with their payload right after the header which is a multiple of 4 as well
+#define RNDIS_ALIGN_FACTOR  2
+#define RNDIS_ALIGN         (1u << RNDIS_ALIGN_FACTOR)
+
+#define PACKET_HDR_LEN      sizeof(rndis_msg_packet_t)
+#define PACKET_DATA_OFFSET  (PACKET_HDR_LEN - offsetof(rndis_msg_packet_t, data_offset))
+
+#define ETH_MTU             1500
+#define ETH_FRAME_MAX       (ETH_MTU + 14)
+
+TU_VERIFY_STATIC((PACKET_HDR_LEN % RNDIS_ALIGN) == 0, "packet payload must be aligned");
+TU_VERIFY_STATIC(CFG_TUD_RNDIS_IN_BUFSIZE >= PACKET_HDR_LEN + ETH_FRAME_MAX + 1, "IN buffer must hold a full frame");
+TU_VERIFY_STATIC(CFG_TUD_RNDIS_OUT_BUFSIZE >= PACKET_HDR_LEN + ETH_FRAME_MAX, "OUT buffer must hold a full frame");
+TU_VERIFY_STATIC(CFG_TUD_RNDIS_IN_BUFSIZE <= UINT16_MAX && CFG_TUD_RNDIS_OUT_BUFSIZE <= UINT16_MAX, "buffer is indexed by uint16_t");
+TU_VERIFY_STATIC((CFG_TUD_RNDIS_CTRL_BUFSIZE % 4) == 0, "CFG_TUD_RNDIS_CTRL_BUFSIZE must be multiple of 4");
+
+typedef struct
+{
+  uint8_t rhport;
+  uint8_t itf_num;      // Communication interface, data interface is the next one
+  uint8_t ep_notif;
+  uint8_t ep_in;
+  uint8_t ep_out;
+  uint16_t ep_in_size;
+
+  uint32_t host_max_xfer; // max transfer size host accepts, from INITIALIZE
+  uint32_t packet_filter; // data path is started when non-zero
+  uint16_t resp_len;      // encapsulated response waiting for GET_ENCAPSULATED_RESPONSE
+
+  /*------------- From this point, data is cleared when data path is started or stopped -------------*/
+
+  // Receive transfer, its packets are delivered one by one
+  uint16_t rx_len;      // 0 if no transfer is received
+  uint16_t rx_msg;      // offset of current packet message
+  bool rx_held;         // datagram is accepted but not yet released by application
+  bool rx_in_cb;
+  bool rx_renew;        // released within tud_network_recv_cb()
+
+  // Two transmit buffers, one is filled while the other is on the wire
+  uint8_t  tx_fill;
+  uint8_t  tx_count[2];
+  uint16_t tx_len[2];
+}rndisd_interface_t;
+
+#define LINK_RESET_OFFSET   offsetof(rndisd_interface_t, rx_len)
+
+//--------------------------------------------------------------------+
+// INTERNAL OBJECT & FUNCTION DECLARATION
+//--------------------------------------------------------------------+
+CFG_TUSB_MEM_SECTION static rndisd_interface_t _rndisd_itf;
+
+CFG_TUSB_MEM_SECTION CFG_TUSB_MEM_ALIGN static uint8_t _rndisd_rx[CFG_TUD_RNDIS_OUT_BUFSIZE];
+CFG_TUSB_MEM_SECTION CFG_TUSB_MEM_ALIGN static uint8_t _rndisd_tx[2][CFG_TUD_RNDIS_IN_BUFSIZE];
+
+// command from host and response to it
+CFG_TUSB_MEM_SECTION CFG_TUSB_MEM_ALIGN static uint32_t _rndisd_cmd [CFG_TUD_RNDIS_CTRL_BUFSIZE/4];
+CFG_TUSB_MEM_SECTION CFG_TUSB_MEM_ALIGN static uint32_t _rndisd_resp[CFG_TUD_RNDIS_CTRL_BUFSIZE/4];
+
+// RESPONSE_AVAILABLE notification
+CFG_TUSB_MEM_SECTION CFG_TUSB_MEM_ALIGN static uint32_t _rndisd_notif[2] = { 0x00000001UL, 0 };
+
+static uint32_t const _oid_supported[] =
+{
+  RNDIS_OID_GEN_SUPPORTED_LIST,
+  RNDIS_OID_GEN_HARDWARE_STATUS,
+  RNDIS_OID_GEN_MEDIA_SUPPORTED,
+  RNDIS_OID_GEN_MEDIA_IN_USE,
+  RNDIS_OID_GEN_MAXIMUM_FRAME_SIZE,
+  RNDIS_OID_GEN_LINK_SPEED,
+  RNDIS_OID_GEN_TRANSMIT_BUFFER_SPACE,
+  RNDIS_OID_GEN_RECEIVE_BUFFER_SPACE,
+  RNDIS_OID_GEN_TRANSMIT_BLOCK_SIZE,
+  RNDIS_OID_GEN_RECEIVE_BLOCK_SIZE,
+  RNDIS_OID_GEN_VENDOR_ID,
+  RNDIS_OID_GEN_VENDOR_DESCRIPTION,
+  RNDIS_OID_GEN_CURRENT_PACKET_FILTER,
+  RNDIS_OID_GEN_MAXIMUM_TOTAL_SIZE,
+  RNDIS_OID_GEN_MAC_OPTIONS,
+  RNDIS_OID_GEN_MEDIA_CONNECT_STATUS,
+  RNDIS_OID_GEN_MAXIMUM_SEND_PACKETS,
+  RNDIS_OID_GEN_PHYSICAL_MEDIUM,
+  RNDIS_OID_802_3_PERMANENT_ADDRESS,
+  RNDIS_OID_802_3_CURRENT_ADDRESS,
+  RNDIS_OID_802_3_MULTICAST_LIST,
+  RNDIS_OID_802_3_MAXIMUM_LIST_SIZE,
+};
+
+static char const _vendor_desc[] = "TinyUSB RNDIS";
+
+TU_VERIFY_STATIC(sizeof(rndis_msg_query_cmplt_t) + sizeof(_oid_supported) <= CFG_TUD_RNDIS_CTRL_BUFSIZE, "response buffer is too small");
+
+static void _prep_out_transaction(rndisd_interface_t* p_rndis)
+{
+  // receive next transfer only when current one is consumed
+  if ( !p_rndis->packet_filter || p_rndis->rx_len || usbd_edpt_busy(p_rndis->rhport, p_rndis->ep_out) ) return;
+
+  usbd_edpt_xfer(p_rndis->rhport, p_rndis->ep_out, _rndisd_rx, CFG_TUD_RNDIS_OUT_BUFSIZE);
+}
+
+//--------------------------------------------------------------------+
+// Receive
+//--------------------------------------------------------------------+
+
+// Get datagram of current packet message, skipping messages without payload.
+// Return false when there is no more (valid) message in transfer.
+static bool _rx_get_datagram(rndisd_interface_t* p_rndis, uint16_t* p_idx, uint16_t* p_len)
+{
+  while ( (uint32_t) p_rndis->rx_msg + PACKET_HDR_LEN <= p_rndis->rx_len )
+  {
+    uint32_t const msg_idx = p_rndis->rx_msg;
+    TU_VERIFY( 0 == (msg_idx % RNDIS_ALIGN) );
+
+    rndis_msg_packet_t const* msg = (rndis_msg_packet_t const*) (_rndisd_rx + msg_idx);
+    TU_VERIFY( (msg->length >= PACKET_HDR_LEN) && (msg->length <= p_rndis->rx_len - msg_idx) );
+
+    uint32_t const data_idx = offsetof(rndis_msg_packet_t, data_offset) + msg->data_offset;
+
+    if ( (RNDIS_MSG_PACKET == msg->type) && msg->data_length &&
+         (msg->data_offset <= msg->length) && (data_idx <= msg->length) && (msg->data_length <= msg->length - data_idx) )
+    {
+      (*p_idx) = (uint16_t) (msg_idx + data_idx);
+      (*p_len) = (uint16_t) msg->data_length;
+      return true;
+    }
+
+    p_rndis->rx_msg = (uint16_t) (msg_idx + msg->length);
+  }
+
+  return false;
+}
+
+// Move to next packet message once current datagram is released
+static inline void _rx_next(rndisd_interface_t* p_rndis)
+{
+  rndis_msg_packet_t const* msg = (rndis_msg_packet_t const*) (_rndisd_rx + p_rndis->rx_msg);
+  p_rndis->rx_msg = (uint16_t) (p_rndis->rx_msg + msg->length);
+}
+
+// Deliver datagrams until application holds one or transfer is consumed
+static void _rx_deliver(rndisd_interface_t* p_rndis)
+{
+  while ( p_rndis->rx_len && !p_rndis->rx_held )
+  {
+    uint16_t idx, len;
+
+    if ( !_rx_get_datagram(p_rndis, &idx, &len) )
+    {
+      // transfer is consumed, receive next one
+      p_rndis->rx_len = 0;
+      _prep_out_transaction(p_rndis);
+      return;
+    }
+
+    p_rndis->rx_in_cb = true;
+    p_rndis->rx_renew = false;
+    bool const accepted = tud_network_recv_cb(_rndisd_rx + idx, len);
+    p_rndis->rx_in_cb = false;
+
+    // not accepted, offered again on next tud_network_recv_renew()
+    if ( !accepted ) return;
+
+    if ( p_rndis->rx_renew )
+    {
+      // already released within callback e.g copied
+      _rx_next(p_rndis);
+    }else
+    {
+      p_rndis->rx_held = true;
+    }
+  }
+}
+
+//--------------------------------------------------------------------+
+// Transmit
+//--------------------------------------------------------------------+
+
+// Largest transfer host accepts, one byte is reserved for padding, see _tx_start()
+static inline uint32_t _tx_max(rndisd_interface_t const* p_rndis)
+{
+  return tu_min32(p_rndis->host_max_xfer, CFG_TUD_RNDIS_IN_BUFSIZE) - 1;
+}
+
+// Send buffer being filled if IN endpoint is idle, datagrams queued meanwhile are concatenated
+static void _tx_start(rndisd_interface_t* p_rndis)
+{
+  uint8_t const fill = p_rndis->tx_fill;
+
+  if ( !p_rndis->tx_count[fill] || usbd_edpt_busy(p_rndis->rhport, p_rndis->ep_in) ) return;
+
+  uint8_t* buf = _rndisd_tx[fill];
+  uint16_t len = p_rndis->tx_len[fill];
+
+  // Transfer of exact multiple of packet size would need a zero-length packet, host accepts one
+  // byte of padding instead
+  if ( 0 == (len % p_rndis->ep_in_size) ) buf[len++] = 0;
+
+  if ( usbd_edpt_xfer(p_rndis->rhport, p_rndis->ep_in, buf, len) )
+  {
+    // fill the other buffer from now on
+    p_rndis->tx_fill = 1 - fill;
+    p_rndis->tx_count[1 - fill] = 0;
+    p_rndis->tx_len[1 - fill]   = 0;
+  }
+}
+
+//--------------------------------------------------------------------+
+// Control messages
+//--------------------------------------------------------------------+
+
+// Start or stop data path, pending datagrams of both directions are dropped
+static void _set_packet_filter(rndisd_interface_t* p_rndis, uint32_t filter)
+{
+  bool const up = (filter != 0);
+  bool const was_up = (p_rndis->packet_filter != 0);
+
+  p_rndis->packet_filter = filter;
+  if ( up == was_up ) return;
+
+  tu_memclr(((uint8_t*) p_rndis) + LINK_RESET_OFFSET, sizeof(rndisd_interface_t) - LINK_RESET_OFFSET);
+  if ( up ) _prep_out_transaction(p_rndis);
+
+  if ( tud_network_link_state_cb ) tud_network_link_state_cb(up);
+}
+
+// Write OID value into buf, return its length or -1 if not supported
+static int32_t _query_oid(rndisd_interface_t const* p_rndis, uint32_t oid, uint8_t* buf)
+{
+  uint32_t value;
+
+  switch ( oid )
+  {
+    case RNDIS_OID_GEN_SUPPORTED_LIST:
+      memcpy(buf, _oid_supported, sizeof(_oid_supported));
+    return (int32_t) sizeof(_oid_supported);
+
+    case RNDIS_OID_GEN_VENDOR_DESCRIPTION:
+      memcpy(buf, _vendor_desc, sizeof(_vendor_desc));
+    return (int32_t) sizeof(_vendor_desc);
+
+    case RNDIS_OID_802_3_PERMANENT_ADDRESS:
+    case RNDIS_OID_802_3_CURRENT_ADDRESS:
+      memcpy(buf, tud_network_mac_address, 6);
+    return 6;
+
+    case RNDIS_OID_802_3_MULTICAST_LIST:       return 0; // all multicast is passed anyway
+
+    case RNDIS_OID_GEN_HARDWARE_STATUS:        value = 0; break; // ready
+    case RNDIS_OID_GEN_MEDIA_SUPPORTED:
+    case RNDIS_OID_GEN_MEDIA_IN_USE:           value = 0; break; // 802.3
+    case RNDIS_OID_GEN_PHYSICAL_MEDIUM:        value = 0; break; // unspecified
+    case RNDIS_OID_GEN_MEDIA_CONNECT_STATUS:   value = 0; break; // connected
+    case RNDIS_OID_GEN_MAC_OPTIONS:            value = 0; break;
+    case RNDIS_OID_GEN_MAXIMUM_FRAME_SIZE:     value = ETH_MTU; break;
+    case RNDIS_OID_GEN_TRANSMIT_BLOCK_SIZE:
+    case RNDIS_OID_GEN_RECEIVE_BLOCK_SIZE:     value = ETH_FRAME_MAX; break;
+    case RNDIS_OID_GEN_MAXIMUM_TOTAL_SIZE:     value = ETH_FRAME_MAX + PACKET_HDR_LEN; break;
+    case RNDIS_OID_GEN_TRANSMIT_BUFFER_SPACE:  value = CFG_TUD_RNDIS_OUT_BUFSIZE; break;
+    case RNDIS_OID_GEN_RECEIVE_BUFFER_SPACE:   value = CFG_TUD_RNDIS_IN_BUFSIZE; break;
+    case RNDIS_OID_GEN_VENDOR_ID:              value = 0x00FFFFFFUL; break; // no IEEE OUI
+    case RNDIS_OID_GEN_CURRENT_PACKET_FILTER:  value = p_rndis->packet_filter; break;
+    case RNDIS_OID_GEN_MAXIMUM_SEND_PACKETS:   value = CFG_TUD_RNDIS_OUT_MAX_PACKETS; break;
+    case RNDIS_OID_802_3_MAXIMUM_LIST_SIZE:    value = 1; break;
+
+    // in units of 100 bps
+    case RNDIS_OID_GEN_LINK_SPEED:             value = (p_rndis->ep_in_size >= 512) ? 4800000UL : 120000UL; break;
+
+    default: return -1;
+  }
+
+  memcpy(buf, &value, 4);
+  return 4;
+}
+
+// Build response of message received with SEND_ENCAPSULATED_COMMAND, return its length or 0 if none
+static uint16_t _process_message(rndisd_interface_t* p_rndis, uint16_t cmd_len)
+{
+  uint32_t const* cmd  = _rndisd_cmd;
+  uint32_t*       resp = _rndisd_resp;
+
+  TU_VERIFY( cmd_len >= 8 && cmd[1] <= cmd_len, 0 );
+
+  switch ( cmd[0] )
+  {
+    case RNDIS_MSG_INITIALIZE:
+    {
+      rndis_msg_initialize_t const* msg = (rndis_msg_initialize_t const*) cmd;
+      rndis_msg_initialize_cmplt_t* cmplt = (rndis_msg_initialize_cmplt_t*) resp;
+      TU_VERIFY( cmd_len >= sizeof(rndis_msg_initialize_t), 0 );
+
+      // fresh start, also after host driver was reloaded without bus reset
+      _set_packet_filter(p_rndis, 0);
+
+      // a transfer must hold at least one full frame (and padding byte), our buffer size otherwise
+      p_rndis->host_max_xfer = (msg->max_xfer_size >= PACKET_HDR_LEN + ETH_FRAME_MAX + 1) ? msg->max_xfer_size : CFG_TUD_RNDIS_IN_BUFSIZE;
+
+      tu_memclr(cmplt, sizeof(rndis_msg_initialize_cmplt_t));
+      cmplt->type                    = RNDIS_MSG_INITIALIZE_CMPLT;
+      cmplt->length                  = sizeof(rndis_msg_initialize_cmplt_t);
+      cmplt->request_id              = msg->request_id;
+      cmplt->status                  = RNDIS_STATUS_SUCCESS;
+      cmplt->major_version           = 1;
+      cmplt->minor_version           = 0;
+      cmplt->device_flags            = 0x10; // connectionless
+      cmplt->medium                  = 0;    // 802.3
+      cmplt->max_packet_per_xfer     = CFG_TUD_RNDIS_OUT_MAX_PACKETS;
+      cmplt->max_xfer_size           = CFG_TUD_RNDIS_OUT_BUFSIZE;
+      cmplt->packet_alignment_factor = RNDIS_ALIGN_FACTOR;
+
+      return sizeof(rndis_msg_initialize_cmplt_t);
+    }
+
+    case RNDIS_MSG_QUERY:
+    {
+      rndis_msg_query_t const* msg = (rndis_msg_query_t const*) cmd;
+      rndis_msg_query_cmplt_t* cmplt = (rndis_msg_query_cmplt_t*) resp;
+      TU_VERIFY( cmd_len >= sizeof(rndis_msg_query_t), 0 );
+
+      int32_t const len = _query_oid(p_rndis, msg->oid, cmplt->oid_buffer);
+
+      cmplt->type          = RNDIS_MSG_QUERY_CMPLT;
+      cmplt->request_id    = msg->request_id;
+      cmplt->status        = (len < 0) ? RNDIS_STATUS_NOT_SUPPORTED : RNDIS_STATUS_SUCCESS;
+      cmplt->buffer_length = (len > 0) ? (uint32_t) len : 0;
+      cmplt->buffer_offset = (len > 0) ? (sizeof(rndis_msg_query_cmplt_t) - offsetof(rndis_msg_query_cmplt_t, request_id)) : 0;
+      cmplt->length        = sizeof(rndis_msg_query_cmplt_t) + cmplt->buffer_length;
+
+      return (uint16_t) cmplt->length;
+    }
+
+    case RNDIS_MSG_SET:
+    {
+      rndis_msg_set_t const* msg = (rndis_msg_set_t const*) cmd;
+      rndis_msg_set_cmplt_t* cmplt = (rndis_msg_set_cmplt_t*) resp;
+      TU_VERIFY( cmd_len >= sizeof(rndis_msg_set_t), 0 );
+
+      // input buffer offset is counted from request_id
+      uint32_t const buf_idx = offsetof(rndis_msg_set_t, request_id) + msg->buffer_offset;
+      bool const valid = (msg->buffer_offset <= cmd_len) && (buf_idx <= cmd_len) && (msg->buffer_length <= cmd_len - buf_idx);
+
+      uint32_t status = RNDIS_STATUS_SUCCESS;
+
+      if ( !valid )
+      {
+        status = RNDIS_STATUS_INVALID_DATA;
+      }
+      else if ( RNDIS_OID_GEN_CURRENT_PACKET_FILTER == msg->oid )
+      {
+        uint32_t filter;
+        TU_VERIFY( msg->buffer_length >= 4, 0 );
+        memcpy(&filter, ((uint8_t const*) cmd) + buf_idx, 4);
+        _set_packet_filter(p_rndis, filter);
+      }
+      // other settings e.g lookahead, multicast list and protocol options do not matter
+
+      cmplt->type       = RNDIS_MSG_SET_CMPLT;
+      cmplt->length     = sizeof(rndis_msg_set_cmplt_t);
+      cmplt->request_id = msg->request_id;
+      cmplt->status     = status;
+
+      return sizeof(rndis_msg_set_cmplt_t);
+    }
+
+    case RNDIS_MSG_RESET:
+    {
+      rndis_msg_reset_cmplt_t* cmplt = (rndis_msg_reset_cmplt_t*) resp;
+
+      // host sets packet filter again
+      _set_packet_filter(p_rndis, 0);
+
+      cmplt->type             = RNDIS_MSG_RESET_CMPLT;
+      cmplt->length           = sizeof(rndis_msg_reset_cmplt_t);
+      cmplt->status           = RNDIS_STATUS_SUCCESS;
+      cmplt->addressing_reset = 1;
+
+      return sizeof(rndis_msg_reset_cmplt_t);
+    }
+
+    case RNDIS_MSG_KEEP_ALIVE:
+    {
+      rndis_msg_keep_alive_t const* msg = (rndis_msg_keep_alive_t const*) cmd;
+      rndis_msg_keep_alive_cmplt_t* cmplt = (rndis_msg_keep_alive_cmplt_t*) resp;
+      TU_VERIFY( cmd_len >= sizeof(rndis_msg_keep_alive_t), 0 );
+
+      cmplt->type       = RNDIS_MSG_KEEP_ALIVE_CMPLT;
+      cmplt->length     = sizeof(rndis_msg_keep_alive_cmplt_t);
+      cmplt->request_id = msg->request_id;
+      cmplt->status     = RNDIS_STATUS_SUCCESS;
+
+      return sizeof(rndis_msg_keep_alive_cmplt_t);
+    }
+
+    case RNDIS_MSG_HALT:
+      // no response
+      _set_packet_filter(p_rndis, 0);
+    return 0;
+
+    default: return 0; // unknown message is ignored
+  }
+}
+
+//--------------------------------------------------------------------+
+// APPLICATION API
+//--------------------------------------------------------------------+
+bool tud_network_link_up(void)
+{
+  return 0 != _rndisd_itf.packet_filter;
+}
+
+void tud_network_recv_renew(void)
+{
+  rndisd_interface_t* p_rndis = &_rndisd_itf;
+
+  if ( p_rndis->rx_in_cb )
+  {
+    p_rndis->rx_renew = true;
+    return;
+  }
+
+  if ( p_rndis->rx_held )
+  {
+    p_rndis->rx_held = false;
+    _rx_next(p_rndis);
+  }
+
+  _rx_deliver(p_rndis);
+}
+
+bool tud_network_can_xmit(uint16_t size)
+{
+  rndisd_interface_t const* p_rndis = &_rndisd_itf;
+  uint8_t const fill = p_rndis->tx_fill;
+
+  TU_VERIFY( p_rndis->packet_filter );
+  TU_VERIFY( p_rndis->tx_count[fill] < CFG_TUD_RNDIS_IN_MAX_PACKETS );
+
+  // messages are padded to alignment, hence tx_len is always aligned
+  return (uint32_t) p_rndis->tx_len[fill] + tu_align_n(PACKET_HDR_LEN + size + RNDIS_ALIGN - 1, RNDIS_ALIGN) <= _tx_max(p_rndis);
+}
+
+void tud_network_xmit(void* ref, uint16_t arg)
+{
+  rndisd_interface_t* p_rndis = &_rndisd_itf;
+  uint8_t const fill = p_rndis->tx_fill;
+
+  TU_VERIFY( p_rndis->packet_filter && (p_rndis->tx_count[fill] < CFG_TUD_RNDIS_IN_MAX_PACKETS), );
+
+  uint16_t const offset = p_rndis->tx_len[fill];
+  uint8_t* msg_buf = _rndisd_tx[fill] + offset;
+  uint16_t const len = tud_network_xmit_cb(msg_buf + PACKET_HDR_LEN, ref, arg);
+
+  uint32_t const msg_len = tu_align_n(PACKET_HDR_LEN + len + RNDIS_ALIGN - 1, RNDIS_ALIGN);
+
+  // application must check with tud_network_can_xmit() first
+  TU_ASSERT( offset + msg_len <= _tx_max(p_rndis), );
+
+  rndis_msg_packet_t* msg = (rndis_msg_packet_t*) msg_buf;
+  tu_memclr(msg, PACKET_HDR_LEN);
+  msg->type        = RNDIS_MSG_PACKET;
+  msg->length      = msg_len;
+  msg->data_offset = PACKET_DATA_OFFSET;
+  msg->data_length = len;
+
+  // padding does not leak stale data
+  for(uint32_t i = PACKET_HDR_LEN + len; i < msg_len; i++) msg_buf[i] = 0;
+
+  p_rndis->tx_count[fill]++;
+  p_rndis->tx_len[fill] = (uint16_t) (offset + msg_len);
+
+  _tx_start(p_rndis);
+}
+
+//--------------------------------------------------------------------+
+// USBD Driver API
+//--------------------------------------------------------------------+
+void rndisd_init(void)
+{
+  tu_varclr(&_rndisd_itf);
+  _rndisd_itf.host_max_xfer = CFG_TUD_RNDIS_IN_BUFSIZE;
+}
+
+void rndisd_reset(uint8_t rhport)
+{
+  // interface in use by the other roothub port is untouched
+  if ( _rndisd_itf.ep_in && _rndisd_itf.rhport != rhport ) return;
+
+  rndisd_init();
+}
+
+bool rndisd_open(uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t *p_length, uint8_t *p_inst)
+{
+  (void) p_inst; // single instance
+
+  // Wireless controller, RF controller, RNDIS bound by Windows to its built-in driver
+  TU_VERIFY(0x01 == itf_desc->bInterfaceSubClass && 0x03 == itf_desc->bInterfaceProtocol);
+
+  rndisd_interface_t* p_rndis = &_rndisd_itf;
+  TU_ASSERT(p_rndis->ep_in == 0);
+
+  //------------- Control Interface -------------//
+  p_rndis->rhport  = rhport;
+  p_rndis->itf_num = itf_desc->bInterfaceNumber;
+
+  uint8_t const * p_desc = tu_desc_next( itf_desc );
+  (*p_length) = sizeof(tusb_desc_interface_t);
+
+  // Communication Functional Descriptors
+  while ( TUSB_DESC_CS_INTERFACE == tu_desc_type(p_desc) )
+  {
+    (*p_length) += tu_desc_len(p_desc);
+    p_desc = tu_desc_next(p_desc);
+  }
+
+  // Notification endpoint
+  TU_ASSERT( TUSB_DESC_ENDPOINT == tu_desc_type(p_desc) );
+  TU_ASSERT( dcd_edpt_open(rhport, (tusb_desc_endpoint_t const *) p_desc) );
+  p_rndis->ep_notif = ((tusb_desc_endpoint_t const *) p_desc)->bEndpointAddress;
+
+  (*p_length) += tu_desc_len(p_desc);
+  p_desc = tu_desc_next(p_desc);
+
+  //------------- Data Interface -------------//
+  TU_ASSERT( (TUSB_DESC_INTERFACE == tu_desc_type(p_desc)) &&
+             (TUSB_CLASS_CDC_DATA == ((tusb_desc_interface_t const *) p_desc)->bInterfaceClass) );
+  (*p_length) += tu_desc_len(p_desc);
+  p_desc = tu_desc_next(p_desc);
+
+  TU_ASSERT( usbd_open_edpt_pair(rhport, p_desc, 2, TUSB_XFER_BULK, &p_rndis->ep_out, &p_rndis->ep_in) );
+
+  tusb_desc_endpoint_t const* desc_ep = (tusb_desc_endpoint_t const*) p_desc;
+  if ( desc_ep->bEndpointAddress != p_rndis->ep_in ) desc_ep = (tusb_desc_endpoint_t const*) tu_desc_next(desc_ep);
+  p_rndis->ep_in_size = desc_ep->wMaxPacketSize.size;
+
+  (*p_length) += 2*sizeof(tusb_desc_endpoint_t);
+
+  return true;
+}
+
+// Invoked when class request DATA stage is finished.
+bool rndisd_control_complete(uint8_t rhport, tusb_control_request_t const * request)
+{
+  rndisd_interface_t* p_rndis = &_rndisd_itf;
+
+  if ( (TUSB_REQ_TYPE_CLASS == request->bmRequestType_bit.type) && (CDC_REQUEST_SEND_ENCAPSULATED_COMMAND == request->bRequest) )
+  {
+    p_rndis->resp_len = _process_message(p_rndis, request->wLength);
+
+    // host fetches response with GET_ENCAPSULATED_RESPONSE once notified
+    if ( p_rndis->resp_len && !usbd_edpt_busy(rhport, p_rndis->ep_notif) )
+    {
+      usbd_edpt_xfer(rhport, p_rndis->ep_notif, (uint8_t*) _rndisd_notif, sizeof(_rndisd_notif));
+    }
+  }
+
+  return true;
+}
+
+// Handle class control request
+// return false to stall control endpoint (e.g unsupported request)
+bool rndisd_control_request(uint8_t rhport, tusb_control_request_t const * request)
+{
+  rndisd_interface_t* p_rndis = &_rndisd_itf;
+
+  TU_VERIFY(TUSB_REQ_TYPE_CLASS == request->bmRequestType_bit.type);
+  TU_VERIFY(TUSB_REQ_RCPT_INTERFACE == request->bmRequestType_bit.recipient);
+  TU_VERIFY(tu_u16_low(request->wIndex) == p_rndis->itf_num);
+
+  switch ( request->bRequest )
+  {
+    case CDC_REQUEST_SEND_ENCAPSULATED_COMMAND:
+      // processed in rndisd_control_complete()
+      TU_VERIFY(request->wLength <= sizeof(_rndisd_cmd));
+      tud_control_xfer(rhport, request, _rndisd_cmd, request->wLength);
+    break;
+
+    case CDC_REQUEST_GET_ENCAPSULATED_RESPONSE:
+    {
+      uint16_t len = p_rndis->resp_len;
+      p_rndis->resp_len = 0;
+
+      // single zero byte if there is no response
+      if ( !len )
+      {
+        ((uint8_t*) _rndisd_resp)[0] = 0;
+        len = 1;
+      }
+
+      tud_control_xfer(rhport, request, _rndisd_resp, len);
+    }
+    break;
+
+    default: return false; // stall unsupported request
+  }
+
+  return true;
+}
+
+bool rndisd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes)
+{
+  (void) rhport;
+
+  rndisd_interface_t* p_rndis = &_rndisd_itf;
+
+  if ( ep_addr == p_rndis->ep_out )
+  {
+    // drop transfer which failed or completed after data path was stopped
+    if ( p_rndis->packet_filter && (XFER_RESULT_SUCCESS == result) && (xferred_bytes >= PACKET_HDR_LEN) )
+    {
+      p_rndis->rx_len = (uint16_t) xferred_bytes;
+      p_rndis->rx_msg = 0;
+
+      _rx_deliver(p_rndis);
+    }else
+    {
+      _prep_out_transaction(p_rndis);
+    }
+  }
+  else if ( ep_addr == p_rndis->ep_in )
+  {
+    // transfer is sent, datagrams queued meanwhile are sent together
+    _tx_start(p_rndis);
+  }
+
+  return true;
+}
+
+#endif
@@ -0,0 +1,70 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#ifndef _TUSB_PRINTER_H_
+#define _TUSB_PRINTER_H_
+
+#include "common/tusb_common.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+//--------------------------------------------------------------------+
+// Common Definitions
+//--------------------------------------------------------------------+
+
+#define PRINTER_SUBCLASS  0x01
+
+// Printer Protocol
+typedef enum
+{
+  PRINTER_PROTOCOL_UNIDIRECTIONAL = 1, // bulk OUT only
+  PRINTER_PROTOCOL_BIDIRECTIONAL  = 2, // bulk OUT and IN
+  PRINTER_PROTOCOL_IEEE1284_4     = 3,
+} printer_protocol_type_t;
+
+// Printer Requests
+typedef enum
+{
+  PRINTER_REQUEST_GET_DEVICE_ID   = 0,
+  PRINTER_REQUEST_GET_PORT_STATUS = 1,
+  PRINTER_REQUEST_SOFT_RESET      = 2,
+} printer_request_t;
+
+// Port status returned by GET_PORT_STATUS, same bits as a parallel port
+enum
+{
+  PRINTER_PORT_STATUS_NOT_ERROR   = TU_BIT(3),
+  PRINTER_PORT_STATUS_SELECTED    = TU_BIT(4),
+  PRINTER_PORT_STATUS_PAPER_EMPTY = TU_BIT(5),
+};
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif /* _TUSB_PRINTER_H_ */
@@ -0,0 +1,244 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#include "tusb_option.h"
+
+#if (TUSB_OPT_DEVICE_ENABLED && CFG_TUD_PRINTER)
+
+#include "printer_device.h"
+#include "device/usbd_pvt.h"
+
+//--------------------------------------------------------------------+
+// MACRO CONSTANT TYPEDEF
+//--------------------------------------------------------------------+
+#if CFG_TUD_PRINTER_STREAM_DEPTH > 1 && (!defined(CFG_TUD_EDPT_XFER_QUEUE) || CFG_TUD_EDPT_XFER_QUEUE < CFG_TUD_PRINTER_STREAM_DEPTH - 1)
+  #error "CFG_TUD_PRINTER requires CFG_TUD_EDPT_XFER_QUEUE >= CFG_TUD_PRINTER_STREAM_DEPTH - 1"
+#endif
+
+#if CFG_TUD_SPLIT_CORE
+  #error "CFG_TUD_PRINTER queues application buffers on endpoints, it is not supported by CFG_TUD_SPLIT_CORE"
+#endif
+
+// Application buffers queued on an endpoint, completed in order
+typedef struct
+{
+  uint8_t* buf[CFG_TUD_PRINTER_STREAM_DEPTH];
+  uint8_t  rd_idx;
+  uint8_t  count;
+}printerd_stream_t;
+
+typedef struct
+{
+  uint8_t rhport;
+  uint8_t itf_num;
+  uint8_t ep_out;
+  uint8_t ep_in; // bidirectional interface only
+
+  printerd_stream_t rx_stream;
+  printerd_stream_t tx_stream;
+
+  /*------------- From this point, data is not cleared by bus reset -------------*/
+  uint8_t port_status;
+}printerd_interface_t;
+
+#define ITF_MEM_RESET_SIZE   offsetof(printerd_interface_t, port_status)
+
+CFG_TUSB_MEM_SECTION static printerd_interface_t _printerd_itf;
+
+// Response to GET_DEVICE_ID and GET_PORT_STATUS
+CFG_TUSB_MEM_SECTION CFG_TUSB_MEM_ALIGN static uint8_t _printerd_ctrl_buf[CFG_TUD_PRINTER_ID_BUFSIZE];
+
+//--------------------------------------------------------------------+
+// Stream API
+//--------------------------------------------------------------------+
+static bool stream_xfer(uint8_t ep_addr, printerd_stream_t* stream, uint8_t* buffer, uint32_t bufsize)
+{
+  TU_VERIFY( ep_addr && stream->count < CFG_TUD_PRINTER_STREAM_DEPTH );
+
+  // extra transfers are queued by usbd and started in isr right after the current one
+  stream->buf[(stream->rd_idx + stream->count) % CFG_TUD_PRINTER_STREAM_DEPTH] = buffer;
+  TU_VERIFY( usbd_edpt_xfer(_printerd_itf.rhport, ep_addr, buffer, bufsize) );
+  stream->count++;
+
+  return true;
+}
+
+// Buffer of the oldest transfer, which is the one just completed
+static uint8_t* stream_complete(printerd_stream_t* stream)
+{
+  TU_VERIFY( stream->count, NULL );
+
+  uint8_t* buffer = stream->buf[stream->rd_idx];
+  stream->rd_idx = (uint8_t) ((stream->rd_idx + 1) % CFG_TUD_PRINTER_STREAM_DEPTH);
+  stream->count--;
+
+  return buffer;
+}
+
+//--------------------------------------------------------------------+
+// Application API
+//--------------------------------------------------------------------+
+bool tud_printer_mounted(void)
+{
+  return _printerd_itf.ep_out != 0;
+}
+
+bool tud_printer_stream_read(void* buffer, uint32_t bufsize)
+{
+  return stream_xfer(_printerd_itf.ep_out, &_printerd_itf.rx_stream, (uint8_t*) buffer, bufsize);
+}
+
+bool tud_printer_stream_write(void const* buffer, uint32_t bufsize)
+{
+  return stream_xfer(_printerd_itf.ep_in, &_printerd_itf.tx_stream, (uint8_t*) buffer, bufsize);
+}
+
+uint8_t tud_printer_stream_read_pending(void)
+{
+  return _printerd_itf.rx_stream.count;
+}
+
+uint8_t tud_printer_stream_write_pending(void)
+{
+  return _printerd_itf.tx_stream.count;
+}
+
+void tud_printer_port_status_set(uint8_t status)
+{
+  _printerd_itf.port_status = status;
+}
+
+//--------------------------------------------------------------------+
+// USBD Driver API
+//--------------------------------------------------------------------+
+void printerd_init(void)
+{
+  tu_memclr(&_printerd_itf, sizeof(_printerd_itf));
+  _printerd_itf.port_status = PRINTER_PORT_STATUS_NOT_ERROR | PRINTER_PORT_STATUS_SELECTED;
+}
+
+void printerd_reset(uint8_t rhport)
+{
+  // interface in use by the other roothub port is untouched
+  if ( _printerd_itf.ep_out && _printerd_itf.rhport != rhport ) return;
+
+  tu_memclr(&_printerd_itf, ITF_MEM_RESET_SIZE);
+}
+
+bool printerd_open(uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t *p_length, uint8_t *p_inst)
+{
+  (void) p_inst; // single instance
+
+  TU_VERIFY(PRINTER_SUBCLASS == itf_desc->bInterfaceSubClass);
+  TU_VERIFY(PRINTER_PROTOCOL_UNIDIRECTIONAL == itf_desc->bInterfaceProtocol ||
+            PRINTER_PROTOCOL_BIDIRECTIONAL  == itf_desc->bInterfaceProtocol);
+
+  printerd_interface_t* p_printer = &_printerd_itf;
+  TU_ASSERT(p_printer->ep_out == 0);
+
+  // unidirectional (protocol 1) has one endpoint, bidirectional (protocol 2) one per direction
+  uint8_t const ep_count = itf_desc->bNumEndpoints;
+  TU_ASSERT(ep_count == itf_desc->bInterfaceProtocol);
+
+  // Bulk OUT, followed by bulk IN on bidirectional interface
+  TU_ASSERT(usbd_open_edpt_pair(rhport, tu_desc_next(itf_desc), ep_count, TUSB_XFER_BULK, &p_printer->ep_out, &p_printer->ep_in));
+  TU_ASSERT(p_printer->ep_out);
+
+  p_printer->rhport  = rhport;
+  p_printer->itf_num = itf_desc->bInterfaceNumber;
+  (*p_length) = (uint16_t) (sizeof(tusb_desc_interface_t) + ep_count*sizeof(tusb_desc_endpoint_t));
+
+  return true;
+}
+
+bool printerd_control_request(uint8_t rhport, tusb_control_request_t const * request)
+{
+  printerd_interface_t* p_printer = &_printerd_itf;
+
+  TU_VERIFY(TUSB_REQ_TYPE_CLASS == request->bmRequestType_bit.type);
+
+  switch ( request->bRequest )
+  {
+    case PRINTER_REQUEST_GET_DEVICE_ID:
+    {
+      // interface number in high byte, alternate setting in low byte
+      TU_VERIFY(tu_u16_high(request->wIndex) == p_printer->itf_num);
+      TU_VERIFY(tud_printer_device_id_cb);
+
+      char const* device_id = tud_printer_device_id_cb();
+      TU_VERIFY(device_id);
+
+      // length field is big endian and includes itself
+      uint16_t const id_len = (uint16_t) tu_min32((uint32_t) strlen(device_id), sizeof(_printerd_ctrl_buf) - 2);
+      uint16_t const len    = (uint16_t) (id_len + 2);
+
+      _printerd_ctrl_buf[0] = tu_u16_high(len);
+      _printerd_ctrl_buf[1] = tu_u16_low(len);
+      memcpy(_printerd_ctrl_buf + 2, device_id, id_len);
+
+      return tud_control_xfer(rhport, request, _printerd_ctrl_buf, len);
+    }
+
+    case PRINTER_REQUEST_GET_PORT_STATUS:
+      TU_VERIFY(tu_u16_low(request->wIndex) == p_printer->itf_num);
+
+      _printerd_ctrl_buf[0] = p_printer->port_status;
+      return tud_control_xfer(rhport, request, _printerd_ctrl_buf, 1);
+
+    case PRINTER_REQUEST_SOFT_RESET:
+      TU_VERIFY(tu_u16_low(request->wIndex) == p_printer->itf_num);
+
+      // endpoints are not stalled by this driver, there is nothing else to clear
+      if ( tud_printer_soft_reset_cb ) tud_printer_soft_reset_cb();
+      return tud_control_status(rhport, request);
+
+    default: return false; // stall unsupported request
+  }
+}
+
+bool printerd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes)
+{
+  (void) rhport;
+  (void) result;
+
+  printerd_interface_t* p_printer = &_printerd_itf;
+
+  // next queued buffer is already being transferred, application can queue another one in callback
+  if ( ep_addr == p_printer->ep_out )
+  {
+    uint8_t* buffer = stream_complete(&p_printer->rx_stream);
+    if ( buffer ) tud_printer_stream_rx_cb(buffer, xferred_bytes);
+  }
+  else if ( ep_addr == p_printer->ep_in )
+  {
+    uint8_t const* buffer = stream_complete(&p_printer->tx_stream);
+    if ( buffer && tud_printer_stream_tx_cb ) tud_printer_stream_tx_cb(buffer, xferred_bytes);
+  }
+
+  return true;
+}
+
+#endif
@@ -0,0 +1,111 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2021 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#ifndef _TUSB_PRINTER_DEVICE_H_
+#define _TUSB_PRINTER_DEVICE_H_
+
+#include "common/tusb_common.h"
+#include "device/usbd.h"
+#include "printer.h"
+
+//--------------------------------------------------------------------+
+// Class Driver Configuration
+//--------------------------------------------------------------------+
+
+// Number of application buffers can be queued per direction. Print data goes straight into them, host is
+// NAKed while none is queued. Requires CFG_TUD_EDPT_XFER_QUEUE >= CFG_TUD_PRINTER_STREAM_DEPTH - 1
+// so that the pipe never idles.
+#ifndef CFG_TUD_PRINTER_STREAM_DEPTH
+#define CFG_TUD_PRINTER_STREAM_DEPTH  2
+#endif
+
+// Buffer of GET_DEVICE_ID response: 2 bytes length + IEEE 1284 device ID string
+#ifndef CFG_TUD_PRINTER_ID_BUFSIZE
+#define CFG_TUD_PRINTER_ID_BUFSIZE    256
+#endif
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/** \addtogroup ClassDriver_Printer Printer
+ *  @{ */
+
+//--------------------------------------------------------------------+
+// Application API
+//--------------------------------------------------------------------+
+
+// Check if printer interface is configured by host
+bool    tud_printer_mounted(void);
+
+// Queue a buffer to receive up to bufsize bytes of print data, which should be multiple of bulk endpoint
+// size since a short packet completes the transfer. Queue a buffer to send (bidirectional interface only).
+// Buffers must stay valid (and be DMA-capable) until their callback is invoked. Return false if the
+// queue is full. Must be called in the same context as tud_task() e.g from callbacks.
+bool    tud_printer_stream_read (void* buffer, uint32_t bufsize);
+bool    tud_printer_stream_write(void const* buffer, uint32_t bufsize);
+
+// Number of queued buffers not yet completed
+uint8_t tud_printer_stream_read_pending (void);
+uint8_t tud_printer_stream_write_pending(void);
+
+// Set port status answered to GET_PORT_STATUS, default is PRINTER_PORT_STATUS_NOT_ERROR | PRINTER_PORT_STATUS_SELECTED
+void    tud_printer_port_status_set(uint8_t status);
+
+//--------------------------------------------------------------------+
+// Application Callbacks (WEAK is optional)
+//--------------------------------------------------------------------+
+
+// Invoked when a buffer queued by tud_printer_stream_read() is filled or ended by a short packet.
+// Buffer is owned by application again, e.g rasterized then queued back.
+void tud_printer_stream_rx_cb(uint8_t* buffer, uint32_t xferred_bytes);
+
+// Invoked when a buffer queued by tud_printer_stream_write() is sent
+TU_ATTR_WEAK void tud_printer_stream_tx_cb(uint8_t const* buffer, uint32_t sent_bytes);
+
+// Invoked when received GET_DEVICE_ID, return IEEE 1284 device ID string without its length field
+// e.g "MFG:TinyUSB;MDL:Label Printer;CMD:ZPL;CLS:PRINTER;". GET_DEVICE_ID is stalled without it.
+TU_ATTR_WEAK char const* tud_printer_device_id_cb(void);
+
+// Invoked when received SOFT_RESET, e.g to abort current job. Queued buffers are kept.
+TU_ATTR_WEAK void tud_printer_soft_reset_cb(void);
+
+/** @} */
+
+//--------------------------------------------------------------------+
+// Internal Class Driver API
+//--------------------------------------------------------------------+
+void printerd_init            (void);
+void printerd_reset           (uint8_t rhport);
+bool printerd_open            (uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t *p_length, uint8_t *p_inst);
+bool printerd_control_request (uint8_t rhport, tusb_control_request_t const * request);
+bool printerd_xfer_cb         (uint8_t rhport, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes);
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif /* _TUSB_PRINTER_DEVICE_H_ */
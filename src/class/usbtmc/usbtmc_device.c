@@ -133,8 +133,9 @@ typedef struct
   // IN buffer is only used for first packet, not the remainder
   // in order to deal with prepending header
   uint8_t ep_bulk_in_buf[USBTMCD_MAX_PACKET_SIZE];
-  // OUT buffer receives one packet at a time
-  uint8_t ep_bulk_out_buf[USBTMCD_MAX_PACKET_SIZE];
+  // OUT buffer receives one packet at a time, alternating between two with double buffering
+  uint8_t ep_bulk_out_buf[CFG_TUD_USBTMC_RX_DOUBLE_BUF ? 2 : 1][USBTMCD_MAX_PACKET_SIZE];
+  uint8_t ep_bulk_out_idx; // buffer armed (or to be armed) on bulk-out
   uint32_t transfer_size_remaining; // also used for requested length for bulk IN.
   uint32_t transfer_size_sent;      // To keep track of data bytes that have been queued in FIFO (not header bytes)
 
@@ -143,6 +144,20 @@ typedef struct
 
   uint8_t const * devInBuffer; // pointer to application-layer used for transmissions
 
+  // contiguous bulk-OUT delivery, see tud_usbtmc_msg_data_buffer()
+  uint8_t * rx_buf;
+  uint32_t rx_buf_len;  // bytes of current transfer in rx_buf, data and padding
+  uint32_t rx_part;     // length of transfer armed on rx_buf
+
+#if (CFG_TUD_USBTMC_ENABLE_488)
+  // interrupt-IN notifications, also accessed by endpoint isr
+  usbtmc_read_stb_interrupt_488_t notif_q[CFG_TUD_USBTMC_NOTIF_QUEUE];
+  usbtmc_read_stb_interrupt_488_t notif_buf; // on the wire
+  uint8_t notif_rd;
+  uint8_t notif_count;
+  volatile bool notif_busy;
+#endif
+
   usbtmc_capabilities_specific_t const * capabilities;
 } usbtmc_interface_state_t;
 
@@ -159,6 +174,7 @@ TU_VERIFY_STATIC(
 
 static bool handle_devMsgOutStart(uint8_t rhport, void *data, size_t len);
 static bool handle_devMsgOut(uint8_t rhport, void *data, size_t len, size_t packetLen);
+static bool handle_devMsgOutBuf(uint8_t rhport, void const *data, size_t len, bool shortPacket);
 
 static uint8_t termChar;
 static uint8_t termCharRequested = false;
@@ -188,6 +204,69 @@ bool atomicChangeState(usbtmcd_state_enum expectedState, usbtmcd_state_enum newS
   return ret;
 }
 
+#if (CFG_TUD_USBTMC_ENABLE_488)
+// Arm next queued notification if endpoint is idle, in isr or with interrupt disabled
+static void notif_xmit(void)
+{
+  if(usbtmc_state.notif_busy || !usbtmc_state.notif_count) return;
+
+  usbtmc_state.notif_buf = usbtmc_state.notif_q[usbtmc_state.notif_rd];
+  if(usbd_edpt_xfer(usbtmc_state.rhport, usbtmc_state.ep_int_in, (uint8_t*)&usbtmc_state.notif_buf, sizeof(usbtmc_state.notif_buf)))
+  {
+    usbtmc_state.notif_busy = true;
+    usbtmc_state.notif_rd = (uint8_t)((usbtmc_state.notif_rd + 1u) % CFG_TUD_USBTMC_NOTIF_QUEUE);
+    usbtmc_state.notif_count--;
+  }
+}
+
+static bool notif_queue(uint8_t bTag, uint8_t statusByte)
+{
+  TU_VERIFY(usbtmc_state.ep_int_in != 0u);
+
+  bool ret = true;
+  dcd_int_disable(usbtmc_state.rhport);
+
+  uint8_t i;
+  for(i = 0; i < usbtmc_state.notif_count; i++)
+  {
+    usbtmc_read_stb_interrupt_488_t* n = &usbtmc_state.notif_q[(usbtmc_state.notif_rd + i) % CFG_TUD_USBTMC_NOTIF_QUEUE];
+    // coalesce SRQ, host reads the latest status byte anyway
+    if(bTag == 1u && n->bNotify1.bTag == 1u)
+    {
+      n->StatusByte = statusByte;
+      break;
+    }
+  }
+
+  if(i == usbtmc_state.notif_count)
+  {
+    if(usbtmc_state.notif_count < CFG_TUD_USBTMC_NOTIF_QUEUE)
+    {
+      usbtmc_read_stb_interrupt_488_t* n = &usbtmc_state.notif_q[(usbtmc_state.notif_rd + usbtmc_state.notif_count) % CFG_TUD_USBTMC_NOTIF_QUEUE];
+      n->bNotify1.one = 1u;
+      n->bNotify1.bTag = bTag & 0x7Fu;
+      n->StatusByte = statusByte;
+      usbtmc_state.notif_count++;
+    }
+    else
+    {
+      ret = false;
+    }
+  }
+
+  notif_xmit();
+  dcd_int_enable(usbtmc_state.rhport);
+
+  return ret;
+}
+
+bool tud_usbtmc_srq_notify(uint8_t status_byte)
+{
+  TU_VERIFY(usbtmc_state.state != STATE_CLOSED);
+  return notif_queue(1u, status_byte);
+}
+#endif
+
 // called from app
 // We keep a reference to the buffer, so it MUST not change until the app is
 // notified that the transfer is complete.
@@ -230,7 +309,7 @@ bool tud_usbtmc_transmit_dev_msg_data(
                             len : (txBufLen - headerLen);
   const size_t packetLen = headerLen + dataLen;
 
-  memcpy((uint8_t*)(usbtmc_state.ep_bulk_in_buf) + headerLen, data, dataLen);
+  tu_memcpy((uint8_t*)(usbtmc_state.ep_bulk_in_buf) + headerLen, data, dataLen);
   usbtmc_state.transfer_size_remaining = len - dataLen;
   usbtmc_state.transfer_size_sent = dataLen;
   usbtmc_state.devInBuffer = (uint8_t*)data + (dataLen);
@@ -260,9 +339,10 @@ void usbtmcd_init_cb(void)
     usbtmcLock = osal_mutex_create(&usbtmcLockBuffer);
 }
 
-bool usbtmcd_open_cb(uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t *p_length)
+bool usbtmcd_open_cb(uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t *p_length, uint8_t *p_inst)
 {
   (void)rhport;
+  (void)p_inst;
   TU_ASSERT(usbtmc_state.state == STATE_CLOSED);
   uint8_t const * p_desc;
   uint8_t found_endpoints = 0;
@@ -357,11 +437,19 @@ bool tud_usbtmc_start_bus_read()
     break;
   // When receiving, let it remain receiving
   case STATE_RCV:
+    // rest of message is armed by handle_devMsgOutBuf()
+    if(usbtmc_state.rx_buf) return true;
+#if CFG_TUD_USBTMC_RX_DOUBLE_BUF
+    // next packet is already armed by handle_devMsgOut()
+    return true;
+#else
     break;
+#endif
   default:
     TU_VERIFY(false);
   }
-  TU_VERIFY(usbd_edpt_xfer(usbtmc_state.rhport, usbtmc_state.ep_bulk_out, usbtmc_state.ep_bulk_out_buf, 64));
+  TU_VERIFY(usbd_edpt_xfer(usbtmc_state.rhport, usbtmc_state.ep_bulk_out,
+      usbtmc_state.ep_bulk_out_buf[usbtmc_state.ep_bulk_out_idx], USBTMCD_MAX_PACKET_SIZE));
   return true;
 }
 
@@ -387,16 +475,72 @@ static bool handle_devMsgOutStart(uint8_t rhport, void *data, size_t len)
   // must be a header, should have been confirmed before calling here.
   usbtmc_msg_request_dev_dep_out *msg = (usbtmc_msg_request_dev_dep_out*)data;
   usbtmc_state.transfer_size_remaining = msg->TransferSize;
+  usbtmc_state.rx_buf = NULL;
   TU_VERIFY(tud_usbtmc_msgBulkOut_start_cb(msg));
 
-  TU_VERIFY(handle_devMsgOut(rhport, (uint8_t*)data + sizeof(*msg), len - sizeof(*msg), len));
+  if(usbtmc_state.rx_buf)
+  {
+    TU_VERIFY(handle_devMsgOutBuf(rhport, (uint8_t*)data + sizeof(*msg), len - sizeof(*msg), len < USBTMCD_MAX_PACKET_SIZE));
+  }
+  else
+  {
+    TU_VERIFY(handle_devMsgOut(rhport, (uint8_t*)data + sizeof(*msg), len - sizeof(*msg), len));
+  }
   usbtmc_state.lastBulkOutTag = msg->header.bTag;
   return true;
 }
 
+bool tud_usbtmc_msg_data_buffer(void * buf, size_t bufsize)
+{
+  // only from tud_usbtmc_msgBulkOut_start_cb()
+  TU_VERIFY(usbtmc_state.state == STATE_RCV && usbtmc_state.transfer_size_sent == 0u && !usbtmc_state.rx_buf);
+
+  // message data is followed by alignment bytes up to a multiple of 4
+  TU_VERIFY(buf && (bufsize & ~(size_t)3u) >= usbtmc_state.transfer_size_remaining);
+
+  usbtmc_state.rx_buf = (uint8_t*) buf;
+  usbtmc_state.rx_buf_len = 0u;
+  return true;
+}
+
+// Contiguous delivery: data of header packet is copied (data != NULL), the rest of the message is then
+// received in place with transfers of whole packets, up to the largest one of the controller
+static bool handle_devMsgOutBuf(uint8_t rhport, void const *data, size_t len, bool shortPacket)
+{
+  // return true upon failure, as we can assume error is being handled elsewhere.
+  TU_VERIFY(usbtmc_state.state == STATE_RCV, true);
+
+  // fits buffer as checked by tud_usbtmc_msg_data_buffer()
+  uint32_t const xferLen = (usbtmc_state.transfer_size_remaining + 3u) & ~3u;
+
+  uint32_t const partLen = tu_min32((uint32_t) len, xferLen - usbtmc_state.rx_buf_len);
+  if(data) tu_memcpy(usbtmc_state.rx_buf + usbtmc_state.rx_buf_len, data, partLen);
+  usbtmc_state.rx_buf_len += partLen;
+
+  if(!shortPacket && usbtmc_state.rx_buf_len < xferLen)
+  {
+    dcd_caps_t caps;
+    usbd_dcd_caps(rhport, &caps);
+
+    uint32_t const partMax = tu_max32(caps.max_xfer_bytes - (caps.max_xfer_bytes % USBTMCD_MAX_PACKET_SIZE), USBTMCD_MAX_PACKET_SIZE);
+    usbtmc_state.rx_part = tu_min32(xferLen - usbtmc_state.rx_buf_len, partMax);
+    TU_VERIFY(usbd_edpt_xfer(rhport, usbtmc_state.ep_bulk_out, usbtmc_state.rx_buf + usbtmc_state.rx_buf_len, usbtmc_state.rx_part));
+    return true;
+  }
+
+  uint8_t * buf = usbtmc_state.rx_buf;
+  uint32_t const dataLen = tu_min32(usbtmc_state.rx_buf_len, usbtmc_state.transfer_size_remaining);
+
+  usbtmc_state.rx_buf = NULL;
+  usbtmc_state.transfer_size_remaining -= dataLen;
+  usbtmc_state.transfer_size_sent += dataLen;
+
+  TU_VERIFY(atomicChangeState(STATE_RCV, STATE_NAK));
+  return tud_usbtmc_msg_data_cb(buf, dataLen, true);
+}
+
 static bool handle_devMsgOut(uint8_t rhport, void *data, size_t len, size_t packetLen)
 {
-  (void)rhport;
   // return true upon failure, as we can assume error is being handled elsewhere.
   TU_VERIFY(usbtmc_state.state == STATE_RCV,true);
 
@@ -410,6 +554,18 @@ static bool handle_devMsgOut(uint8_t rhport, void *data, size_t len, size_t pack
     TU_VERIFY(atomicChangeState(STATE_RCV, STATE_NAK));
   }
 
+#if CFG_TUD_USBTMC_RX_DOUBLE_BUF
+  // data stays valid in the current buffer, the next packet goes into the other one
+  usbtmc_state.ep_bulk_out_idx ^= 1u;
+  if(!atEnd)
+  {
+    TU_VERIFY(usbd_edpt_xfer(rhport, usbtmc_state.ep_bulk_out,
+        usbtmc_state.ep_bulk_out_buf[usbtmc_state.ep_bulk_out_idx], USBTMCD_MAX_PACKET_SIZE));
+  }
+#else
+  (void)rhport;
+#endif
+
   len = tu_min32(len, usbtmc_state.transfer_size_remaining);
 
   usbtmc_state.transfer_size_remaining -= len;
@@ -446,8 +602,46 @@ static bool handle_devMsgIn(void *data, size_t len)
   return true;
 }
 
+size_t tud_usbtmc_find_char(void const * data, size_t len, uint8_t c)
+{
+  uint8_t const * p = (uint8_t const *) data;
+  size_t i = 0;
+
+  // up to word boundary
+  for(; i < len && ((uintptr_t)(p + i) & 3u); i++)
+  {
+    if(p[i] == c) return i;
+  }
+
+  // a zero byte of word XOR pattern is a match
+  uint32_t const pattern = 0x01010101u * c;
+  for(; i + 4u <= len; i += 4u)
+  {
+    uint32_t word;
+    memcpy(&word, p + i, 4);
+    word ^= pattern;
+    if((word - 0x01010101u) & ~word & 0x80808080u) break;
+  }
+
+  for(; i < len; i++)
+  {
+    if(p[i] == c) return i;
+  }
+  return len;
+}
+
+size_t tud_usbtmc_termchar_length(void const * data, size_t len)
+{
+  TU_VERIFY(termCharRequested && len, 0);
+
+  size_t const pos = tud_usbtmc_find_char(data, len, termChar);
+  return (pos < len) ? (pos + 1u) : 0u;
+}
+
 bool usbtmcd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes)
 {
+  // interrupt endpoint is completed by usbtmcd_xfer_isr_cb()
+  TU_VERIFY(ep_addr != usbtmc_state.ep_int_in);
   TU_VERIFY(result == XFER_RESULT_SUCCESS);
   //uart_tx_str_sync("TMC XFER CB\r\n");
   if(usbtmc_state.state == STATE_CLEARING) {
@@ -462,7 +656,7 @@ bool usbtmcd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint
     {
     case STATE_IDLE:
       TU_VERIFY(xferred_bytes >= sizeof(usbtmc_msg_generic_t));
-      msg = (usbtmc_msg_generic_t*)(usbtmc_state.ep_bulk_out_buf);
+      msg = (usbtmc_msg_generic_t*)(usbtmc_state.ep_bulk_out_buf[usbtmc_state.ep_bulk_out_idx]);
       uint8_t invInvTag = (uint8_t)~(msg->header.bTagInverse);
       TU_VERIFY(msg->header.bTag == invInvTag);
       TU_VERIFY(msg->header.bTag != 0x00);
@@ -498,7 +692,15 @@ bool usbtmcd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint
       return true;
 
     case STATE_RCV:
-      if(!handle_devMsgOut(rhport, usbtmc_state.ep_bulk_out_buf, xferred_bytes, xferred_bytes))
+      if(usbtmc_state.rx_buf)
+      {
+        if(!handle_devMsgOutBuf(rhport, NULL, xferred_bytes, xferred_bytes < usbtmc_state.rx_part))
+        {
+          usbd_edpt_stall(rhport, usbtmc_state.ep_bulk_out);
+          TU_VERIFY(false);
+        }
+      }
+      else if(!handle_devMsgOut(rhport, usbtmc_state.ep_bulk_out_buf[usbtmc_state.ep_bulk_out_idx], xferred_bytes, xferred_bytes))
       {
         usbd_edpt_stall(rhport, usbtmc_state.ep_bulk_out);
         TU_VERIFY(false);
@@ -527,6 +729,24 @@ bool usbtmcd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint
       break;
 
     case STATE_TX_INITIATED:
+#if CFG_TUD_USBTMC_TX_LARGE_XFER
+      if(usbtmc_state.transfer_size_remaining > 0u)
+      {
+        // Whole remainder in one transfer, a ZLP follows in the next round if it
+        // ends on a packet boundary.
+        uint32_t packetLen = usbtmc_state.transfer_size_remaining;
+        // FIXME! This removes const below!
+        TU_VERIFY( usbd_edpt_xfer(rhport, usbtmc_state.ep_bulk_in, (void*)usbtmc_state.devInBuffer, packetLen));
+        usbtmc_state.devInBuffer += packetLen;
+        usbtmc_state.transfer_size_remaining = 0;
+        usbtmc_state.transfer_size_sent += packetLen;
+        if((packetLen % USBTMCD_MAX_PACKET_SIZE) != 0)
+        {
+          usbtmc_state.state = STATE_TX_SHORTED;
+        }
+        return true;
+      }
+#endif
       if(usbtmc_state.transfer_size_remaining >=sizeof(usbtmc_state.ep_bulk_in_buf))
     {
         // FIXME! This removes const below!
@@ -539,8 +759,8 @@ bool usbtmcd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint
     else // last packet
     {
       size_t packetLen = usbtmc_state.transfer_size_remaining;
-      memcpy(usbtmc_state.ep_bulk_in_buf, usbtmc_state.devInBuffer, usbtmc_state.transfer_size_remaining);
-        usbtmc_state.transfer_size_sent += sizeof(usbtmc_state.transfer_size_remaining);
+      tu_memcpy(usbtmc_state.ep_bulk_in_buf, usbtmc_state.devInBuffer, usbtmc_state.transfer_size_remaining);
+        usbtmc_state.transfer_size_sent += packetLen;
       usbtmc_state.transfer_size_remaining = 0;
       usbtmc_state.devInBuffer = NULL;
       TU_VERIFY( usbd_edpt_xfer(rhport, usbtmc_state.ep_bulk_in, usbtmc_state.ep_bulk_in_buf,(uint16_t)packetLen));
@@ -564,13 +784,27 @@ bool usbtmcd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint
       return false;
     }
   }
-  else if (ep_addr == usbtmc_state.ep_int_in) {
-    // Good?
-    return true;
-  }
   return false;
 }
 
+// Interrupt endpoint is serviced here so that notifications are neither delayed by
+// bulk processing in tud_task() nor dropped while one is on the wire.
+bool usbtmcd_xfer_isr_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes)
+{
+  (void)rhport;
+  (void)result;
+  (void)xferred_bytes;
+
+  TU_VERIFY(ep_addr != 0u && ep_addr == usbtmc_state.ep_int_in);
+
+#if (CFG_TUD_USBTMC_ENABLE_488)
+  usbtmc_state.notif_busy = false;
+  notif_xmit();
+#endif
+
+  return true;
+}
+
 bool usbtmcd_control_request_cb(uint8_t rhport, tusb_control_request_t const * request) {
 
   uint8_t tmcStatusCode = USBTMC_STATUS_FAILED;
@@ -638,6 +872,7 @@ bool usbtmcd_control_request_cb(uint8_t rhport, tusb_control_request_t const * r
       // Check if we've queued a short packet
       criticalEnter();
       usbtmc_state.state = STATE_ABORTING_BULK_OUT;
+      usbtmc_state.rx_buf = NULL;
       criticalLeave();
       TU_VERIFY(tud_usbtmc_initiate_abort_bulk_out_cb(&(rsp.USBTMC_status)));
       usbd_edpt_stall(rhport, usbtmc_state.ep_bulk_out);
@@ -742,6 +977,7 @@ bool usbtmcd_control_request_cb(uint8_t rhport, tusb_control_request_t const * r
       // control endpoint response shown in Table 31, and clear all input buffers and output buffers.
       usbd_edpt_stall(rhport, usbtmc_state.ep_bulk_out);
       usbtmc_state.transfer_size_remaining = 0;
+      usbtmc_state.rx_buf = NULL;
       criticalEnter();
       usbtmc_state.state = STATE_CLEARING;
       criticalLeave();
@@ -816,15 +1052,11 @@ bool usbtmcd_control_request_cb(uint8_t rhport, tusb_control_request_t const * r
         rsp.USBTMC_status = USBTMC_STATUS_SUCCESS;
         rsp.statusByte = 0x00; // Use interrupt endpoint, instead.
 
-        usbtmc_read_stb_interrupt_488_t intMsg =
+        uint8_t const stb = tud_usbtmc_get_stb_cb(&(rsp.USBTMC_status));
+        if(!notif_queue((uint8_t)bTag, stb))
         {
-          .bNotify1 = {
-              .one = 1,
-              .bTag = bTag & 0x7Fu,
-          },
-          .StatusByte = tud_usbtmc_get_stb_cb(&(rsp.USBTMC_status))
-        };
-        usbd_edpt_xfer(rhport, usbtmc_state.ep_int_in, (void*)&intMsg, sizeof(intMsg));
+          rsp.USBTMC_status = USB488_STATUS_INTERRUPT_IN_BUSY;
+        }
       }
       else
       {
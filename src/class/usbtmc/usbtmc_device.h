@@ -41,6 +41,26 @@
 #define CFG_TUD_USBTMC_ENABLE_488 (1)
 #endif
 
+// Send the remainder of a bulk-IN message (after the header packet) directly from
+// the application buffer as one transfer instead of one packet per callback.
+// An in-flight remainder can't be cut short by INITIATE_ABORT_BULK_IN, disabled by default.
+#if !defined(CFG_TUD_USBTMC_TX_LARGE_XFER)
+#define CFG_TUD_USBTMC_TX_LARGE_XFER (0)
+#endif
+
+// Receive bulk-OUT messages into two packet buffers: the next packet is armed before
+// tud_usbtmc_msg_data_cb() runs on the previous one, so mid-message the app can't
+// NAK the host by delaying tud_usbtmc_start_bus_read().
+#if !defined(CFG_TUD_USBTMC_RX_DOUBLE_BUF)
+#define CFG_TUD_USBTMC_RX_DOUBLE_BUF (0)
+#endif
+
+// USB488 interrupt-IN notifications (READ_STATUS_BYTE responses, SRQ) queued while one is
+// on the wire. Next one is armed from the endpoint completion in interrupt context.
+#if !defined(CFG_TUD_USBTMC_NOTIF_QUEUE)
+#define CFG_TUD_USBTMC_NOTIF_QUEUE (4)
+#endif
+
 // USB spec says that full-speed must be 8,16,32, or 64.
 // However, this driver implementation requires it to be >=32
 #define USBTMCD_MAX_PACKET_SIZE (64u)
@@ -105,12 +125,33 @@ bool tud_usbtmc_transmit_dev_msg_data(
 
 bool tud_usbtmc_start_bus_read(void);
 
+// Contiguous bulk-OUT delivery, to be called from tud_usbtmc_msgBulkOut_start_cb(): the rest of the
+// message is received straight into buf (DMA-capable, room for TransferSize rounded up to 4 bytes) and
+// tud_usbtmc_msg_data_cb() is invoked once with the whole message data. The stack arms the transfers,
+// tud_usbtmc_start_bus_read() is only needed after that callback. Returns false if buf is too small,
+// message is then delivered packet by packet.
+bool tud_usbtmc_msg_data_buffer(void * buf, size_t bufsize);
+
+// Offset of first byte equal to c in data, len if not found. Compares a 32-bit word at a time.
+size_t tud_usbtmc_find_char(void const * data, size_t len, uint8_t c);
+
+// Length of data up to and including TermChar of current bulk-IN request, to be sent with
+// usingTermChar. 0 if not found or TermChar is not requested.
+size_t tud_usbtmc_termchar_length(void const * data, size_t len);
+
+#if (CFG_TUD_USBTMC_ENABLE_488)
+// Request service (SRQ) with status_byte on interrupt endpoint. An SRQ still queued is updated
+// with the new status byte instead of adding another. Returns false if queue is full.
+bool tud_usbtmc_srq_notify(uint8_t status_byte);
+#endif
+
 
 /* "callbacks" from USB device core */
 
-bool usbtmcd_open_cb(uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t *p_length);
+bool usbtmcd_open_cb(uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t *p_length, uint8_t *p_inst);
 void usbtmcd_reset_cb(uint8_t rhport);
 bool usbtmcd_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes);
+bool usbtmcd_xfer_isr_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes);
 bool usbtmcd_control_request_cb(uint8_t rhport, tusb_control_request_t const * request);
 bool usbtmcd_control_complete_cb(uint8_t rhport, tusb_control_request_t const * request);
 void usbtmcd_init_cb(void);
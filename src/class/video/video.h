@@ -0,0 +1,173 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+/** \ingroup group_class
+ *  \defgroup ClassDriver_Video Video
+ *            USB Video Class 1.1/1.5 camera with MJPEG and uncompressed frame payloads
+ *  @{ */
+
+#ifndef _TUSB_VIDEO_H__
+#define _TUSB_VIDEO_H__
+
+#include "common/tusb_common.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/// Video Interface Subclass Codes
+typedef enum
+{
+  VIDEO_SUBCLASS_UNDEFINED            = 0x00,
+  VIDEO_SUBCLASS_CONTROL                    , ///< Video Control
+  VIDEO_SUBCLASS_STREAMING                  , ///< Video Streaming
+  VIDEO_SUBCLASS_INTERFACE_COLLECTION       , ///< Video Function (Interface Association)
+} video_subclass_type_t;
+
+/// Video Interface Protocol Codes
+typedef enum
+{
+  VIDEO_ITF_PROTOCOL_UNDEFINED        = 0x00,
+  VIDEO_ITF_PROTOCOL_15               = 0x01, ///< Version 1.5
+} video_interface_protocol_code_t;
+
+/// Video Control Class-Specific Interface Descriptor Subtypes
+typedef enum
+{
+  VIDEO_CS_ITF_VC_UNDEFINED           = 0x00,
+  VIDEO_CS_ITF_VC_HEADER              = 0x01,
+  VIDEO_CS_ITF_VC_INPUT_TERMINAL      = 0x02,
+  VIDEO_CS_ITF_VC_OUTPUT_TERMINAL     = 0x03,
+  VIDEO_CS_ITF_VC_SELECTOR_UNIT       = 0x04,
+  VIDEO_CS_ITF_VC_PROCESSING_UNIT     = 0x05,
+  VIDEO_CS_ITF_VC_EXTENSION_UNIT      = 0x06,
+  VIDEO_CS_ITF_VC_ENCODING_UNIT       = 0x07,
+} video_cs_vc_interface_subtype_t;
+
+/// Video Streaming Class-Specific Interface Descriptor Subtypes
+typedef enum
+{
+  VIDEO_CS_ITF_VS_UNDEFINED           = 0x00,
+  VIDEO_CS_ITF_VS_INPUT_HEADER        = 0x01,
+  VIDEO_CS_ITF_VS_OUTPUT_HEADER       = 0x02,
+  VIDEO_CS_ITF_VS_STILL_IMAGE_FRAME   = 0x03,
+  VIDEO_CS_ITF_VS_FORMAT_UNCOMPRESSED = 0x04,
+  VIDEO_CS_ITF_VS_FRAME_UNCOMPRESSED  = 0x05,
+  VIDEO_CS_ITF_VS_FORMAT_MJPEG        = 0x06,
+  VIDEO_CS_ITF_VS_FRAME_MJPEG         = 0x07,
+  VIDEO_CS_ITF_VS_COLORFORMAT         = 0x0D,
+} video_cs_vs_interface_subtype_t;
+
+/// Video Terminal Types
+typedef enum
+{
+  VIDEO_TT_STREAMING                  = 0x0101,
+  VIDEO_ITT_CAMERA                    = 0x0201,
+} video_terminal_type_t;
+
+/// Video Class-Specific Request Codes
+typedef enum
+{
+  VIDEO_REQUEST_UNDEFINED             = 0x00,
+  VIDEO_REQUEST_SET_CUR               = 0x01,
+  VIDEO_REQUEST_GET_CUR               = 0x81,
+  VIDEO_REQUEST_GET_MIN               = 0x82,
+  VIDEO_REQUEST_GET_MAX               = 0x83,
+  VIDEO_REQUEST_GET_RES               = 0x84,
+  VIDEO_REQUEST_GET_LEN               = 0x85,
+  VIDEO_REQUEST_GET_INFO              = 0x86,
+  VIDEO_REQUEST_GET_DEF               = 0x87,
+} video_request_code_t;
+
+/// Video Control Interface Control Selectors
+typedef enum
+{
+  VIDEO_VC_CTL_UNDEFINED              = 0x00,
+  VIDEO_VC_CTL_VIDEO_POWER_MODE       = 0x01,
+  VIDEO_VC_CTL_REQUEST_ERROR_CODE     = 0x02,
+} video_interface_control_selector_t;
+
+/// Video Streaming Interface Control Selectors
+typedef enum
+{
+  VIDEO_VS_CTL_UNDEFINED              = 0x00,
+  VIDEO_VS_CTL_PROBE                  = 0x01,
+  VIDEO_VS_CTL_COMMIT                 = 0x02,
+} video_vs_control_selector_t;
+
+/// Payload Header bmHeaderInfo bits
+typedef enum
+{
+  VIDEO_HEADER_FID                    = TU_BIT(0), ///< Frame ID, toggles at each frame start
+  VIDEO_HEADER_EOF                    = TU_BIT(1), ///< End of frame
+  VIDEO_HEADER_PTS                    = TU_BIT(2),
+  VIDEO_HEADER_SCR                    = TU_BIT(3),
+  VIDEO_HEADER_RES                    = TU_BIT(4),
+  VIDEO_HEADER_STI                    = TU_BIT(5), ///< Still image
+  VIDEO_HEADER_ERR                    = TU_BIT(6),
+  VIDEO_HEADER_EOH                    = TU_BIT(7), ///< End of header
+} video_payload_header_info_t;
+
+/// Video Probe and Commit Controls, host sends 26 (UVC 1.0), 34 (UVC 1.1) or 48 (UVC 1.5) bytes
+typedef struct TU_ATTR_PACKED
+{
+  uint16_t bmHint;
+  uint8_t  bFormatIndex;
+  uint8_t  bFrameIndex;
+  uint32_t dwFrameInterval;           ///< in 100 ns unit
+  uint16_t wKeyFrameRate;
+  uint16_t wPFrameRate;
+  uint16_t wCompQuality;
+  uint16_t wCompWindowSize;
+  uint16_t wDelay;
+  uint32_t dwMaxVideoFrameSize;
+  uint32_t dwMaxPayloadTransferSize;
+
+  // UVC 1.1
+  uint32_t dwClockFrequency;
+  uint8_t  bmFramingInfo;
+  uint8_t  bPreferedVersion;
+  uint8_t  bMinVersion;
+  uint8_t  bMaxVersion;
+
+  // UVC 1.5
+  uint8_t  bUsage;
+  uint8_t  bBitDepthLuma;
+  uint8_t  bmSettings;
+  uint8_t  bMaxNumberOfRefFramesPlus1;
+  uint16_t bmRateControlModes;
+  uint16_t bmLayoutPerStream[4];
+} video_probe_commit_control_t;
+
+TU_VERIFY_STATIC( sizeof(video_probe_commit_control_t) == 48, "size is not correct");
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif
+
+/** @} */
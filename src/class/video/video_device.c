@@ -0,0 +1,698 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#include "tusb_option.h"
+
+#if (TUSB_OPT_DEVICE_ENABLED && CFG_TUD_VIDEO)
+
+#include "video_device.h"
+#include "device/usbd_pvt.h"
+
+//--------------------------------------------------------------------+
+// MACRO CONSTANT TYPEDEF
+//--------------------------------------------------------------------+
+
+// Payload header is bHeaderLength and bmHeaderInfo only, no presentation time or clock reference
+#define VIDEOD_HEADER_LEN   2
+
+typedef struct
+{
+  uint8_t  rhport;
+  uint8_t  itf_num;         // video control interface
+  uint8_t  probe_len;       // probe/commit control length of UVC version
+  uint32_t clock_freq;      // dwClockFrequency of VC header
+
+  // Streaming interface with all its alternate settings, parsed again by probe and SET_INTERFACE
+  uint8_t const* vs_desc;
+  uint16_t vs_len;
+  uint8_t  vs_itf_num;
+  uint8_t  alt;
+  uint8_t  ep_in;
+  bool     iso;
+  uint16_t ep_size;         // bulk: max packet size, iso: bytes per (micro)frame of selected alternate
+  uint32_t max_payload;     // dwMaxPayloadTransferSize, iso: largest ep_size of alternates
+
+  volatile bool streaming;
+
+  video_probe_commit_control_t probe;
+  video_probe_commit_control_t commit;
+
+  // Frame being sent, NULL if none
+  uint8_t const* volatile frame;
+  uint32_t frame_len;
+  uint32_t frame_offset;
+  uint32_t payload_left;    // bulk: rest of current payload, sent straight from frame buffer
+  bool     zlp;             // bulk: current payload is terminated by a zero-length packet
+  uint8_t  fid;
+
+  /*------------- From this point, data is not cleared by bus reset -------------*/
+  CFG_TUSB_MEM_ALIGN uint8_t ep_buf[CFG_TUD_VIDEO_EP_BUFSIZE];
+  CFG_TUSB_MEM_ALIGN uint8_t ctrl_buf[CFG_TUD_VIDEO_CTRL_BUFSIZE];
+} videod_interface_t;
+
+#define ITF_MEM_RESET_SIZE   offsetof(videod_interface_t, ep_buf)
+
+TU_VERIFY_STATIC(CFG_TUD_VIDEO_EP_BUFSIZE > VIDEOD_HEADER_LEN, "Endpoint buffer is too small");
+
+//--------------------------------------------------------------------+
+// INTERNAL OBJECT & FUNCTION DECLARATION
+//--------------------------------------------------------------------+
+CFG_TUSB_MEM_SECTION static videod_interface_t _videod_itf;
+
+static inline uint32_t desc_u32(uint8_t const* p)
+{
+  return tu_u32(p[3], p[2], p[1], p[0]);
+}
+
+static inline bool is_format_desc(uint8_t const* p_desc)
+{
+  return TUSB_DESC_CS_INTERFACE == tu_desc_type(p_desc) &&
+         (VIDEO_CS_ITF_VS_FORMAT_UNCOMPRESSED == p_desc[2] || VIDEO_CS_ITF_VS_FORMAT_MJPEG == p_desc[2]);
+}
+
+static inline bool is_frame_desc(uint8_t const* p_desc)
+{
+  return TUSB_DESC_CS_INTERFACE == tu_desc_type(p_desc) &&
+         (VIDEO_CS_ITF_VS_FRAME_UNCOMPRESSED == p_desc[2] || VIDEO_CS_ITF_VS_FRAME_MJPEG == p_desc[2]);
+}
+
+static inline bool is_vs_desc_type(uint8_t desc_type)
+{
+  return (desc_type == TUSB_DESC_CS_INTERFACE) || (desc_type == TUSB_DESC_ENDPOINT) || (desc_type == TUSB_DESC_CS_ENDPOINT);
+}
+
+// Format descriptor of bFormatIndex, NULL if not found
+static uint8_t const* find_format(videod_interface_t const* p_video, uint8_t fmt_idx)
+{
+  uint8_t const* p_desc   = p_video->vs_desc;
+  uint8_t const* desc_end = p_video->vs_desc + p_video->vs_len;
+
+  for( ; p_desc < desc_end; p_desc = tu_desc_next(p_desc) )
+  {
+    if ( is_format_desc(p_desc) && p_desc[3] == fmt_idx ) return p_desc;
+  }
+
+  return NULL;
+}
+
+// Frame descriptor of bFrameIndex following format, 0 for default frame of format
+static uint8_t const* find_frame(videod_interface_t const* p_video, uint8_t const* fmt_desc, uint8_t frm_idx)
+{
+  uint8_t const* desc_end = p_video->vs_desc + p_video->vs_len;
+
+  if ( frm_idx == 0 )
+  {
+    // bDefaultFrameIndex
+    frm_idx = (VIDEO_CS_ITF_VS_FORMAT_MJPEG == fmt_desc[2]) ? fmt_desc[6] : fmt_desc[22];
+  }
+
+  for(uint8_t const* p_desc = tu_desc_next(fmt_desc); p_desc < desc_end && is_frame_desc(p_desc); p_desc = tu_desc_next(p_desc))
+  {
+    if ( p_desc[3] == frm_idx ) return p_desc;
+  }
+
+  return NULL;
+}
+
+// Frame interval is one of discrete intervals, or within continuous range of frame descriptor
+static bool frame_has_interval(uint8_t const* frm_desc, uint32_t interval)
+{
+  uint8_t const count = frm_desc[25];
+  uint8_t const* p_interval = frm_desc + 26;
+
+  if ( count == 0 )
+  {
+    uint32_t const min  = desc_u32(p_interval);
+    uint32_t const max  = desc_u32(p_interval + 4);
+    uint32_t const step = desc_u32(p_interval + 8);
+
+    return (min <= interval) && (interval <= max) && step && ((interval - min) % step == 0);
+  }
+
+  for(uint8_t i=0; i<count; i++)
+  {
+    if ( desc_u32(p_interval + 4*i) == interval ) return true;
+  }
+
+  return false;
+}
+
+// Fix probe/commit control to a supported format, frame and interval, then fill in what device decides
+static bool probe_negotiate(videod_interface_t const* p_video, video_probe_commit_control_t* ctl)
+{
+  uint8_t const* fmt_desc = find_format(p_video, ctl->bFormatIndex);
+  if ( !fmt_desc ) fmt_desc = find_format(p_video, 1);
+  TU_VERIFY(fmt_desc);
+
+  uint8_t const* frm_desc = find_frame(p_video, fmt_desc, ctl->bFrameIndex);
+  if ( !frm_desc ) frm_desc = find_frame(p_video, fmt_desc, 0);
+  TU_VERIFY(frm_desc);
+
+  ctl->bFormatIndex = fmt_desc[3];
+  ctl->bFrameIndex  = frm_desc[3];
+
+  // dwDefaultFrameInterval if host's one is not supported
+  if ( !frame_has_interval(frm_desc, ctl->dwFrameInterval) ) ctl->dwFrameInterval = desc_u32(frm_desc + 21);
+
+  // dwMaxVideoFrameBufferSize
+  ctl->dwMaxVideoFrameSize = desc_u32(frm_desc + 17);
+
+  if ( p_video->iso )
+  {
+    ctl->dwMaxPayloadTransferSize = p_video->max_payload;
+  }
+  else
+  {
+    ctl->dwMaxPayloadTransferSize = CFG_TUD_VIDEO_BULK_PAYLOAD_SIZE ? CFG_TUD_VIDEO_BULK_PAYLOAD_SIZE :
+                                                                      (ctl->dwMaxVideoFrameSize + VIDEOD_HEADER_LEN);
+  }
+
+  ctl->dwClockFrequency = p_video->clock_freq;
+  ctl->bmFramingInfo    = VIDEO_HEADER_FID | VIDEO_HEADER_EOF;
+
+  return true;
+}
+
+static void probe_default(videod_interface_t const* p_video, video_probe_commit_control_t* ctl)
+{
+  tu_varclr(ctl);
+  ctl->bFormatIndex = 1;
+  probe_negotiate(p_video, ctl);
+}
+
+// Start or stop streaming, frame being sent is dropped
+static void stream_set(videod_interface_t* p_video, bool streaming)
+{
+  bool const changed = (p_video->streaming != streaming);
+
+  // also used by endpoint isr
+  dcd_int_disable(p_video->rhport);
+  uint8_t const* frame = p_video->frame;
+  p_video->frame     = NULL;
+  p_video->streaming = streaming;
+  dcd_int_enable(p_video->rhport);
+
+  if ( frame && tud_video_frame_xfer_complete_cb ) tud_video_frame_xfer_complete_cb();
+  if ( changed && tud_video_streaming_cb ) tud_video_streaming_cb(streaming);
+}
+
+//------------- Payload transmission -------------//
+
+// Send next packet of frame, return false if whole frame is sent.
+// Each payload starts with a packet of header and beginning of its data copied to endpoint buffer.
+// Rest of a bulk payload is sent from frame buffer as is, isochronous payload is a single packet.
+static bool frame_xmit(videod_interface_t* p_video)
+{
+  uint8_t const rhport = p_video->rhport;
+
+  if ( p_video->payload_left )
+  {
+#if CFG_TUD_VIDEO_BULK_ZERO_COPY
+    uint32_t const len = p_video->payload_left;
+    usbd_edpt_xfer(rhport, p_video->ep_in, (uint8_t*) (uintptr_t) (p_video->frame + p_video->frame_offset), len);
+#else
+    uint16_t const len = (uint16_t) tu_min32(p_video->payload_left, CFG_TUD_VIDEO_EP_BUFSIZE - (CFG_TUD_VIDEO_EP_BUFSIZE % p_video->ep_size));
+    tu_memcpy(p_video->ep_buf, p_video->frame + p_video->frame_offset, len);
+    usbd_edpt_xfer(rhport, p_video->ep_in, p_video->ep_buf, len);
+#endif
+
+    p_video->payload_left -= len;
+    p_video->frame_offset += len;
+    return true;
+  }
+
+  if ( p_video->zlp )
+  {
+    p_video->zlp = false;
+    usbd_edpt_xfer(rhport, p_video->ep_in, NULL, 0);
+    return true;
+  }
+
+  if ( p_video->frame_offset >= p_video->frame_len ) return false;
+
+  uint32_t const remaining = p_video->frame_len - p_video->frame_offset;
+  uint32_t data_len;
+  uint16_t first_len;
+
+  if ( p_video->iso )
+  {
+    data_len  = tu_min32(remaining, p_video->ep_size - VIDEOD_HEADER_LEN);
+    first_len = (uint16_t) data_len;
+  }
+  else
+  {
+    uint16_t const mps = p_video->ep_size;
+    data_len  = tu_min32(remaining, p_video->max_payload - VIDEOD_HEADER_LEN);
+    first_len = (uint16_t) tu_min32(data_len, mps - VIDEOD_HEADER_LEN);
+
+    // Host finds end of payload by short packet or dwMaxPayloadTransferSize, otherwise ZLP is needed
+    uint32_t const payload_len = VIDEOD_HEADER_LEN + data_len;
+    p_video->zlp          = (payload_len % mps == 0) && (payload_len < p_video->max_payload);
+    p_video->payload_left = data_len - first_len;
+  }
+
+  uint8_t* buf = p_video->ep_buf;
+  buf[0] = VIDEOD_HEADER_LEN;
+  buf[1] = (uint8_t) (VIDEO_HEADER_EOH | p_video->fid | ((data_len == remaining) ? VIDEO_HEADER_EOF : 0));
+  tu_memcpy(buf + VIDEOD_HEADER_LEN, p_video->frame + p_video->frame_offset, first_len);
+  p_video->frame_offset += first_len;
+
+  usbd_edpt_xfer(rhport, p_video->ep_in, buf, VIDEOD_HEADER_LEN + first_len);
+
+  return true;
+}
+
+static void frame_done(videod_interface_t* p_video)
+{
+  p_video->frame = NULL;
+  p_video->fid  ^= VIDEO_HEADER_FID;
+
+  if ( tud_video_frame_xfer_complete_cb ) tud_video_frame_xfer_complete_cb();
+}
+
+// Deferred to usbd task by tud_video_frame_xfer(), serialized with videod_xfer_cb()
+static void frame_start(void* param)
+{
+  videod_interface_t* p_video = (videod_interface_t*) param;
+
+  // Endpoint may still be busy with transfer of a stopped stream, its completion starts the frame
+  dcd_int_disable(p_video->rhport);
+  if ( p_video->frame && !p_video->frame_offset && !usbd_edpt_busy(p_video->rhport, p_video->ep_in) ) frame_xmit(p_video);
+  dcd_int_enable(p_video->rhport);
+}
+
+//------------- Control requests -------------//
+
+static bool set_interface(videod_interface_t* p_video, uint8_t alt)
+{
+  if ( alt == 0 )
+  {
+    p_video->alt = 0;
+    stream_set(p_video, false);
+    return true;
+  }
+
+  // Bulk streaming has alternate 0 only
+  TU_VERIFY(p_video->iso);
+
+  uint8_t const* p_desc   = p_video->vs_desc;
+  uint8_t const* desc_end = p_video->vs_desc + p_video->vs_len;
+  uint8_t cur_alt = 0;
+
+  for( ; p_desc < desc_end; p_desc = tu_desc_next(p_desc) )
+  {
+    if ( TUSB_DESC_INTERFACE == tu_desc_type(p_desc) )
+    {
+      cur_alt = ((tusb_desc_interface_t const*) p_desc)->bAlternateSetting;
+    }
+    else if ( TUSB_DESC_ENDPOINT == tu_desc_type(p_desc) && cur_alt == alt )
+    {
+      break;
+    }
+  }
+  TU_VERIFY(p_desc < desc_end);
+
+  tusb_desc_endpoint_t const* desc_ep = (tusb_desc_endpoint_t const*) p_desc;
+  TU_ASSERT( dcd_edpt_open(p_video->rhport, desc_ep) );
+
+  // high bandwidth endpoint has additional transactions per microframe
+  p_video->ep_size = (uint16_t) (desc_ep->wMaxPacketSize.size * (1 + desc_ep->wMaxPacketSize.hs_period_mult));
+  p_video->alt     = alt;
+
+  stream_set(p_video, true);
+
+  return true;
+}
+
+// Probe and commit controls of streaming interface
+static bool vs_request(uint8_t rhport, videod_interface_t* p_video, tusb_control_request_t const * request)
+{
+  uint8_t const ctrl_sel = tu_u16_high(request->wValue);
+  TU_VERIFY(VIDEO_VS_CTL_PROBE == ctrl_sel || VIDEO_VS_CTL_COMMIT == ctrl_sel);
+
+  video_probe_commit_control_t* ctl = (VIDEO_VS_CTL_PROBE == ctrl_sel) ? &p_video->probe : &p_video->commit;
+  uint8_t* buf = p_video->ctrl_buf;
+
+  switch ( request->bRequest )
+  {
+    case VIDEO_REQUEST_SET_CUR:
+      // Host may send less than the whole structure, applied by videod_control_complete()
+      TU_VERIFY(request->wLength <= sizeof(video_probe_commit_control_t));
+      memcpy(buf, ctl, sizeof(video_probe_commit_control_t));
+      return tud_control_xfer(rhport, request, buf, request->wLength);
+
+    case VIDEO_REQUEST_GET_CUR:
+      memcpy(buf, ctl, p_video->probe_len);
+      return tud_control_xfer(rhport, request, buf, p_video->probe_len);
+
+    case VIDEO_REQUEST_GET_MIN:
+    case VIDEO_REQUEST_GET_MAX:
+    case VIDEO_REQUEST_GET_DEF:
+    {
+      video_probe_commit_control_t def;
+      probe_default(p_video, &def);
+      memcpy(buf, &def, p_video->probe_len);
+      return tud_control_xfer(rhport, request, buf, p_video->probe_len);
+    }
+
+    case VIDEO_REQUEST_GET_LEN:
+      buf[0] = p_video->probe_len;
+      buf[1] = 0;
+      return tud_control_xfer(rhport, request, buf, 2);
+
+    case VIDEO_REQUEST_GET_INFO:
+      buf[0] = 0x03; // supports GET and SET
+      return tud_control_xfer(rhport, request, buf, 1);
+
+    default: return false;
+  }
+}
+
+static bool vs_request_complete(videod_interface_t* p_video, tusb_control_request_t const * request)
+{
+  bool const commit = (VIDEO_VS_CTL_COMMIT == tu_u16_high(request->wValue));
+  video_probe_commit_control_t* ctl = commit ? &p_video->commit : &p_video->probe;
+
+  memcpy(ctl, p_video->ctrl_buf, sizeof(video_probe_commit_control_t));
+  TU_VERIFY( probe_negotiate(p_video, ctl) );
+
+  if ( commit )
+  {
+    // Bulk (re)starts streaming with new format dropping frame being sent, isochronous starts
+    // when host selects an alternate setting
+    if ( !p_video->iso )
+    {
+      stream_set(p_video, false);
+      p_video->max_payload = ctl->dwMaxPayloadTransferSize;
+    }
+
+    if ( tud_video_commit_cb ) tud_video_commit_cb(ctl->bFormatIndex, ctl->bFrameIndex, ctl->dwFrameInterval);
+    if ( !p_video->iso ) stream_set(p_video, true);
+  }
+
+  return true;
+}
+
+//--------------------------------------------------------------------+
+// APPLICATION API
+//--------------------------------------------------------------------+
+bool tud_video_mounted(void)
+{
+  return _videod_itf.vs_desc != NULL;
+}
+
+bool tud_video_streaming(void)
+{
+  return _videod_itf.streaming;
+}
+
+void tud_video_get_commit(uint8_t* format_index, uint8_t* frame_index, uint32_t* frame_interval)
+{
+  video_probe_commit_control_t const* ctl = &_videod_itf.commit;
+
+  if ( format_index   ) (*format_index)   = ctl->bFormatIndex;
+  if ( frame_index    ) (*frame_index)    = ctl->bFrameIndex;
+  if ( frame_interval ) (*frame_interval) = ctl->dwFrameInterval;
+}
+
+bool tud_video_frame_xfer(void const* buffer, uint32_t bufsize)
+{
+  videod_interface_t* p_video = &_videod_itf;
+
+  TU_VERIFY(p_video->streaming && !p_video->frame && bufsize);
+  TU_VERIFY(bufsize <= p_video->commit.dwMaxVideoFrameSize);
+
+  p_video->frame_len    = bufsize;
+  p_video->frame_offset = 0;
+  p_video->payload_left = 0;
+  p_video->zlp          = false;
+  p_video->frame        = (uint8_t const*) buffer;
+
+  usbd_defer_func(frame_start, p_video, false);
+
+  return true;
+}
+
+bool tud_video_frame_busy(void)
+{
+  return _videod_itf.frame != NULL;
+}
+
+//--------------------------------------------------------------------+
+// USBD Driver API
+//--------------------------------------------------------------------+
+void videod_init(void)
+{
+  tu_memclr(&_videod_itf, sizeof(videod_interface_t));
+}
+
+void videod_reset(uint8_t rhport)
+{
+  (void) rhport;
+  tu_memclr(&_videod_itf, ITF_MEM_RESET_SIZE);
+}
+
+bool videod_open(uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t *p_length, uint8_t *p_inst)
+{
+  (void) p_inst;
+
+  TU_VERIFY(VIDEO_SUBCLASS_CONTROL == itf_desc->bInterfaceSubClass);
+
+  videod_interface_t* p_video = &_videod_itf;
+  TU_VERIFY(p_video->vs_desc == NULL);
+
+  p_video->rhport  = rhport;
+  p_video->itf_num = itf_desc->bInterfaceNumber;
+
+  uint8_t const * p_desc = tu_desc_next( (uint8_t const *) itf_desc );
+  (*p_length) = sizeof(tusb_desc_interface_t);
+
+  // Class-specific VC descriptors are covered by wTotalLength of header
+  TU_ASSERT(TUSB_DESC_CS_INTERFACE == tu_desc_type(p_desc) && VIDEO_CS_ITF_VC_HEADER == p_desc[2]);
+
+  uint16_t const bcd_uvc = tu_u16(p_desc[4], p_desc[3]);
+  p_video->probe_len  = (bcd_uvc >= 0x0150) ? 48 : (bcd_uvc >= 0x0110) ? 34 : 26;
+  p_video->clock_freq = desc_u32(p_desc + 7);
+
+  uint8_t const * vc_end = p_desc + tu_u16(p_desc[6], p_desc[5]);
+  while ( p_desc < vc_end )
+  {
+    (*p_length) = (uint16_t) ((*p_length) + tu_desc_len(p_desc));
+    p_desc = tu_desc_next(p_desc);
+  }
+
+  // Optional status interrupt endpoint, opened but nothing is ever reported
+  while ( TUSB_DESC_ENDPOINT == tu_desc_type(p_desc) || TUSB_DESC_CS_ENDPOINT == tu_desc_type(p_desc) )
+  {
+    if ( TUSB_DESC_ENDPOINT == tu_desc_type(p_desc) ) TU_ASSERT( dcd_edpt_open(rhport, (tusb_desc_endpoint_t const *) p_desc) );
+
+    (*p_length) = (uint16_t) ((*p_length) + tu_desc_len(p_desc));
+    p_desc = tu_desc_next(p_desc);
+  }
+
+  // A single streaming interface following. Bulk endpoint is in alternate 0 and opened now,
+  // isochronous ones are opened when host selects an alternate setting.
+  TU_ASSERT(TUSB_DESC_INTERFACE == tu_desc_type(p_desc));
+  tusb_desc_interface_t const* desc_vs = (tusb_desc_interface_t const*) p_desc;
+  TU_ASSERT(TUSB_CLASS_VIDEO == desc_vs->bInterfaceClass && VIDEO_SUBCLASS_STREAMING == desc_vs->bInterfaceSubClass);
+
+  uint8_t const * vs_desc = p_desc;
+  uint16_t vs_len  = 0;
+  uint8_t  cur_alt = 0;
+
+  p_video->vs_itf_num  = desc_vs->bInterfaceNumber;
+  p_video->max_payload = 0;
+
+  do
+  {
+    if ( TUSB_DESC_INTERFACE == tu_desc_type(p_desc) )
+    {
+      desc_vs = (tusb_desc_interface_t const*) p_desc;
+      if ( desc_vs->bInterfaceNumber != p_video->vs_itf_num ) break;
+
+      cur_alt = desc_vs->bAlternateSetting;
+    }
+    else if ( TUSB_DESC_ENDPOINT == tu_desc_type(p_desc) )
+    {
+      tusb_desc_endpoint_t const* desc_ep = (tusb_desc_endpoint_t const*) p_desc;
+      uint16_t const size = (uint16_t) (desc_ep->wMaxPacketSize.size * (1 + desc_ep->wMaxPacketSize.hs_period_mult));
+
+      // video capture only
+      TU_ASSERT(TUSB_DIR_IN == tu_edpt_dir(desc_ep->bEndpointAddress));
+      TU_ASSERT(size > VIDEOD_HEADER_LEN && size <= CFG_TUD_VIDEO_EP_BUFSIZE);
+
+      p_video->ep_in = desc_ep->bEndpointAddress;
+      p_video->iso   = (TUSB_XFER_ISOCHRONOUS == desc_ep->bmAttributes.xfer);
+
+      if ( p_video->iso )
+      {
+        p_video->max_payload = tu_max32(p_video->max_payload, size);
+      }
+      else
+      {
+        TU_ASSERT(TUSB_XFER_BULK == desc_ep->bmAttributes.xfer && cur_alt == 0);
+        TU_ASSERT( dcd_edpt_open(rhport, desc_ep) );
+        p_video->ep_size = size;
+      }
+    }
+
+    vs_len = (uint16_t) (vs_len + tu_desc_len(p_desc));
+    p_desc = tu_desc_next(p_desc);
+  } while ( TUSB_DESC_INTERFACE == tu_desc_type(p_desc) || is_vs_desc_type(tu_desc_type(p_desc)) );
+
+  TU_ASSERT(p_video->ep_in);
+
+  p_video->vs_desc = vs_desc;
+  p_video->vs_len  = vs_len;
+  (*p_length) = (uint16_t) ((*p_length) + vs_len);
+
+  probe_default(p_video, &p_video->probe);
+  p_video->commit = p_video->probe;
+
+  return true;
+}
+
+// Handle (Get/Set) Interface of streaming interface, probe/commit and control interface requests
+// return false to stall control endpoint (e.g unsupported request)
+bool videod_control_request(uint8_t rhport, tusb_control_request_t const * request)
+{
+  videod_interface_t* p_video = &_videod_itf;
+
+  if ( request->bmRequestType_bit.recipient == TUSB_REQ_RCPT_ENDPOINT )
+  {
+    TU_VERIFY(TUSB_REQ_TYPE_STANDARD == request->bmRequestType_bit.type);
+
+    // Host stops bulk streaming by clearing halt of its endpoint
+    if ( TUSB_REQ_CLEAR_FEATURE == request->bRequest && TUSB_REQ_FEATURE_EDPT_HALT == request->wValue &&
+         !p_video->iso && tu_u16_low(request->wIndex) == p_video->ep_in )
+    {
+      stream_set(p_video, false);
+    }
+
+    return true;
+  }
+
+  TU_VERIFY(request->bmRequestType_bit.recipient == TUSB_REQ_RCPT_INTERFACE);
+  uint8_t const itf = tu_u16_low(request->wIndex);
+
+  if ( request->bmRequestType_bit.type == TUSB_REQ_TYPE_STANDARD )
+  {
+    TU_VERIFY(itf == p_video->vs_itf_num);
+
+    switch ( request->bRequest )
+    {
+      case TUSB_REQ_GET_INTERFACE:
+        tud_control_xfer(rhport, request, &p_video->alt, 1);
+      break;
+
+      case TUSB_REQ_SET_INTERFACE:
+        TU_VERIFY( set_interface(p_video, (uint8_t) request->wValue) );
+        tud_control_status(rhport, request);
+      break;
+
+      default: return false;
+    }
+
+    return true;
+  }
+
+  //------------- Class Specific Request -------------//
+  TU_VERIFY(TUSB_REQ_TYPE_CLASS == request->bmRequestType_bit.type);
+
+  if ( itf == p_video->vs_itf_num ) return vs_request(rhport, p_video, request);
+
+  TU_VERIFY(itf == p_video->itf_num);
+
+  // Control interface and its entities e.g camera terminal controls are handled by application
+  if ( request->bmRequestType_bit.direction == TUSB_DIR_IN )
+  {
+    // No error of previous request to report
+    if ( !tud_video_get_req_entity_cb && tu_u16_high(request->wIndex) == 0 &&
+         VIDEO_VC_CTL_REQUEST_ERROR_CODE == tu_u16_high(request->wValue) && VIDEO_REQUEST_GET_CUR == request->bRequest )
+    {
+      p_video->ctrl_buf[0] = 0;
+      return tud_control_xfer(rhport, request, p_video->ctrl_buf, 1);
+    }
+
+    TU_VERIFY(tud_video_get_req_entity_cb);
+    uint16_t const len = tud_video_get_req_entity_cb(request, p_video->ctrl_buf, tu_min16(request->wLength, CFG_TUD_VIDEO_CTRL_BUFSIZE));
+    TU_VERIFY(len);
+    return tud_control_xfer(rhport, request, p_video->ctrl_buf, len);
+  }
+  else
+  {
+    TU_VERIFY(tud_video_set_req_entity_cb && request->wLength <= CFG_TUD_VIDEO_CTRL_BUFSIZE);
+    return tud_control_xfer(rhport, request, p_video->ctrl_buf, request->wLength);
+  }
+}
+
+// Invoked when class request DATA stage is finished.
+// return false to stall control endpoint (e.g Host send rejected data)
+bool videod_control_complete(uint8_t rhport, tusb_control_request_t const * request)
+{
+  (void) rhport;
+  videod_interface_t* p_video = &_videod_itf;
+
+  if ( !(TUSB_REQ_TYPE_CLASS == request->bmRequestType_bit.type && TUSB_DIR_OUT == request->bmRequestType_bit.direction) ) return true;
+
+  if ( tu_u16_low(request->wIndex) == p_video->vs_itf_num ) return vs_request_complete(p_video, request);
+
+  return tud_video_set_req_entity_cb(request, p_video->ctrl_buf, request->wLength);
+}
+
+// Bulk payloads are continued here, isochronous ones by videod_xfer_isr_cb() except frame completion
+bool videod_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes)
+{
+  (void) rhport;
+  (void) result;
+  (void) xferred_bytes;
+
+  videod_interface_t* p_video = &_videod_itf;
+
+  if ( ep_addr == p_video->ep_in && p_video->frame && !frame_xmit(p_video) ) frame_done(p_video);
+
+  return true;
+}
+
+// Queue next isochronous packet in interrupt context so that no (micro)frame is missed
+bool videod_xfer_isr_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes)
+{
+  (void) rhport;
+  (void) result;
+  (void) xferred_bytes;
+
+  videod_interface_t* p_video = &_videod_itf;
+
+  TU_VERIFY(p_video->iso && ep_addr == p_video->ep_in);
+
+  if ( !p_video->frame ) return true;
+  if ( p_video->frame_offset >= p_video->frame_len ) return false; // frame done, reported by videod_xfer_cb()
+
+  frame_xmit(p_video);
+  return true;
+}
+
+#endif
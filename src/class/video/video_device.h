@@ -0,0 +1,133 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#ifndef _TUSB_VIDEO_DEVICE_H_
+#define _TUSB_VIDEO_DEVICE_H_
+
+#include "common/tusb_common.h"
+#include "device/usbd.h"
+#include "video.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+//--------------------------------------------------------------------+
+// Class Driver Default Configure & Validation
+//--------------------------------------------------------------------+
+
+// Endpoint buffer holding one packet with payload header. Must be at least wMaxPacketSize of
+// bulk endpoint, or the largest wMaxPacketSize (including additional transactions of high
+// bandwidth endpoint) of isochronous alternate settings.
+#ifndef CFG_TUD_VIDEO_EP_BUFSIZE
+  #define CFG_TUD_VIDEO_EP_BUFSIZE        (TUD_OPT_HIGH_SPEED ? 512 : 64)
+#endif
+
+// Bulk only: bytes of each payload including its header, 0 sends each frame as one payload
+#ifndef CFG_TUD_VIDEO_BULK_PAYLOAD_SIZE
+  #define CFG_TUD_VIDEO_BULK_PAYLOAD_SIZE 0
+#endif
+
+// Bulk only: rest of each payload after its first packet is sent straight from frame buffer.
+// Set to 0 if controller needs aligned buffer (e.g samd, lpc_ip3511) or cannot reach frame memory,
+// packets are then copied through endpoint buffer.
+#ifndef CFG_TUD_VIDEO_BULK_ZERO_COPY
+  #define CFG_TUD_VIDEO_BULK_ZERO_COPY    1
+#endif
+
+// Buffer for class-specific control requests, must hold UVC 1.5 probe/commit control
+#ifndef CFG_TUD_VIDEO_CTRL_BUFSIZE
+  #define CFG_TUD_VIDEO_CTRL_BUFSIZE      48
+#endif
+
+TU_VERIFY_STATIC(CFG_TUD_VIDEO_CTRL_BUFSIZE >= sizeof(video_probe_commit_control_t), "Control buffer must hold probe/commit control");
+TU_VERIFY_STATIC(CFG_TUD_VIDEO_BULK_PAYLOAD_SIZE == 0 || CFG_TUD_VIDEO_BULK_PAYLOAD_SIZE > 2, "Payload must be larger than its header");
+
+/** \addtogroup ClassDriver_Video
+ *  @{
+ *  \defgroup   Video_Device Device
+ *  @{ */
+
+//--------------------------------------------------------------------+
+// Application API
+//--------------------------------------------------------------------+
+bool tud_video_mounted   (void);
+
+// Host committed a format and started streaming (isochronous alternate setting selected, or
+// commit of bulk streaming)
+bool tud_video_streaming (void);
+
+// Format, frame and interval (100 ns unit) committed by host
+void tud_video_get_commit(uint8_t* format_index, uint8_t* frame_index, uint32_t* frame_interval);
+
+// Send a video frame without copying it as a whole: it is split into payloads each with its own
+// header, only one packet at a time goes through endpoint buffer. Buffer must stay valid until
+// tud_video_frame_xfer_complete_cb(). Return false if not streaming or previous frame is still
+// being sent.
+bool tud_video_frame_xfer(void const* buffer, uint32_t bufsize);
+
+// Frame submitted by tud_video_frame_xfer() is still being sent
+bool tud_video_frame_busy(void);
+
+//--------------------------------------------------------------------+
+// Application Callback API (weak is optional)
+//--------------------------------------------------------------------+
+
+// Invoked when host commits format/frame/interval to stream
+TU_ATTR_WEAK void tud_video_commit_cb(uint8_t format_index, uint8_t frame_index, uint32_t frame_interval);
+
+// Invoked when host starts or stops streaming
+TU_ATTR_WEAK void tud_video_streaming_cb(bool streaming);
+
+// Invoked when frame buffer is released: whole frame is sent, or dropped since streaming stopped
+TU_ATTR_WEAK void tud_video_frame_xfer_complete_cb(void);
+
+// Invoked with GET request of video control interface or its entities (camera terminal,
+// processing unit ...). Return number of bytes copied to buffer, 0 to stall.
+TU_ATTR_WEAK uint16_t tud_video_get_req_entity_cb(tusb_control_request_t const* request, uint8_t* buffer, uint16_t bufsize);
+
+// Invoked with data of SET request of video control interface or its entities, return false to stall
+TU_ATTR_WEAK bool tud_video_set_req_entity_cb(tusb_control_request_t const* request, uint8_t const* buffer, uint16_t length);
+
+/** @} */
+/** @} */
+
+//--------------------------------------------------------------------+
+// Internal Class Driver API
+//--------------------------------------------------------------------+
+void videod_init(void);
+void videod_reset(uint8_t rhport);
+bool videod_open(uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t *p_length, uint8_t *p_inst);
+bool videod_control_request(uint8_t rhport, tusb_control_request_t const * request);
+bool videod_control_complete(uint8_t rhport, tusb_control_request_t const * request);
+bool videod_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes);
+bool videod_xfer_isr_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes);
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif /* _TUSB_VIDEO_DEVICE_H_ */
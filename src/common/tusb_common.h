@@ -75,6 +75,7 @@
 #include "tusb_error.h" // TODO remove
 #include "tusb_timeout.h"
 #include "tusb_types.h"
+#include "tusb_trace.h"
 
 //--------------------------------------------------------------------+
 // Inline Functions
@@ -82,6 +83,19 @@
 #define tu_memclr(buffer, size)  memset((buffer), 0, (size))
 #define tu_varclr(_var)          tu_memclr(_var, sizeof(*(_var)))
 
+// Optional copy by DMA of application, return false to let cpu copy instead (e.g channel busy).
+// Must only return once copy is complete, may block (e.g on a semaphore) only when not called from ISR
+TU_ATTR_WEAK bool tusb_memcpy_dma_cb(void* dst, void const* src, size_t n);
+
+// memcpy of large FIFO and class buffers, by DMA from CFG_TUSB_MEMCPY_DMA_THRESHOLD bytes
+static inline void tu_memcpy(void* dst, void const* src, size_t n)
+{
+#if CFG_TUSB_MEMCPY_DMA_THRESHOLD
+  if ( (n >= CFG_TUSB_MEMCPY_DMA_THRESHOLD) && tusb_memcpy_dma_cb && tusb_memcpy_dma_cb(dst, src, n) ) return;
+#endif
+  memcpy(dst, src, n);
+}
+
 static inline uint32_t tu_u32(uint8_t b1, uint8_t b2, uint8_t b3, uint8_t b4)
 {
   return ( ((uint32_t) b1) << 24) + ( ((uint32_t) b2) << 16) + ( ((uint32_t) b3) << 8) + b4;
@@ -99,6 +113,7 @@ static inline uint8_t tu_u16_low (uint16_t u16) { return (uint8_t) (u16 & 0x00ff
 static inline uint8_t  tu_min8  (uint8_t  x, uint8_t y ) { return (x < y) ? x : y; }
 static inline uint16_t tu_min16 (uint16_t x, uint16_t y) { return (x < y) ? x : y; }
 static inline uint32_t tu_min32 (uint32_t x, uint32_t y) { return (x < y) ? x : y; }
+static inline uint64_t tu_min64 (uint64_t x, uint64_t y) { return (x < y) ? x : y; }
 
 // Max
 static inline uint8_t  tu_max8  (uint8_t  x, uint8_t y ) { return (x > y) ? x : y; }
@@ -219,10 +234,47 @@ void tu_print_mem(void const *buf, uint8_t size, uint16_t count);
   #define tu_printf     printf
 #endif
 
+#if CFG_TUSB_DEBUG_BINARY
+
+// Binary log record: format is kept as pointer, arguments as raw words. Hence up to 4 arguments of
+// at most 32 bits, %s must point to a static string. Memory dump keeps its first bytes only.
+typedef struct
+{
+  char const* fmt;      // NULL for memory dump, argc bytes of items of size are in argv
+  uint32_t    seq;      // record index + 1 once written
+  uint8_t     argc;
+  uint8_t     size;
+  uintptr_t   argv[4];
+}tu_log_entry_t;
+
+void tu_log_bin(char const* fmt, uint8_t argc, uintptr_t a0, uintptr_t a1, uintptr_t a2, uintptr_t a3);
+void tu_log_bin_mem(void const *buf, uint8_t size, uint16_t count);
+
+// Pop oldest record, return false if none. Records can be decoded on host with firmware's ELF
+bool tu_log_bin_read(tu_log_entry_t* entry);
+
+// Format oldest record with tu_printf() e.g in idle time, return false if none
+bool tu_log_bin_print(void);
+
+#define _TU_LOGB_SEL(_f, _1, _2, _3, _4, _N, ...)  _N
+#define _TU_LOGB_0(_f)                  tu_log_bin(_f, 0, 0, 0, 0, 0)
+#define _TU_LOGB_1(_f, _a)              tu_log_bin(_f, 1, (uintptr_t) (_a), 0, 0, 0)
+#define _TU_LOGB_2(_f, _a, _b)          tu_log_bin(_f, 2, (uintptr_t) (_a), (uintptr_t) (_b), 0, 0)
+#define _TU_LOGB_3(_f, _a, _b, _c)      tu_log_bin(_f, 3, (uintptr_t) (_a), (uintptr_t) (_b), (uintptr_t) (_c), 0)
+#define _TU_LOGB_4(_f, _a, _b, _c, _d)  tu_log_bin(_f, 4, (uintptr_t) (_a), (uintptr_t) (_b), (uintptr_t) (_c), (uintptr_t) (_d))
+
+// Log with debug level 1
+#define TU_LOG1(...)    _TU_LOGB_SEL(__VA_ARGS__, _TU_LOGB_4, _TU_LOGB_3, _TU_LOGB_2, _TU_LOGB_1, _TU_LOGB_0, )(__VA_ARGS__)
+#define TU_LOG1_MEM     tu_log_bin_mem
+
+#else
+
 // Log with debug level 1
 #define TU_LOG1         tu_printf
 #define TU_LOG1_MEM     tu_print_mem
 
+#endif
+
 // Log with debug level 2
 #if CFG_TUSB_DEBUG > 1
   #define TU_LOG2       TU_LOG1
@@ -79,6 +79,12 @@
   #define TU_BSWAP16(u16) (__builtin_bswap16(u16))
   #define TU_BSWAP32(u32) (__builtin_bswap32(u32))
 
+  // Full memory barrier for both compiler and CPU, used by lock-free structures
+  #define TU_MEM_BARRIER() __sync_synchronize()
+
+  // Code path that cannot be reached, compiler drops branches leading to it
+  #define TU_UNREACHABLE() __builtin_unreachable()
+
 #elif defined(__TI_COMPILER_VERSION__)
   #define TU_ATTR_ALIGNED(Bytes)        __attribute__ ((aligned(Bytes)))
   #define TU_ATTR_SECTION(sec_name)     __attribute__ ((section(#sec_name)))
@@ -99,10 +105,18 @@
   #define TU_BSWAP16(u16) (__builtin_bswap16(u16))
   #define TU_BSWAP32(u32) (__builtin_bswap32(u32))
 
+  // Full memory barrier for both compiler and CPU, used by lock-free structures
+  #define TU_MEM_BARRIER() __sync_synchronize()
+
+  #define TU_UNREACHABLE() do {} while (0)
+
 #else
   #error "Compiler attribute porting is required"
 #endif
 
+// Function running from fast memory configured by CFG_TUSB_MEM_FAST_FUNC
+#define TU_ATTR_FAST_FUNC   CFG_TUSB_MEM_FAST_FUNC
+
 #if (TU_BYTE_ORDER == TU_LITTLE_ENDIAN)
 
   #define tu_htons(u16)  (TU_BSWAP16(u16))
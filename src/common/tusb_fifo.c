@@ -32,7 +32,7 @@
 // implement mutex lock and unlock
 #if CFG_FIFO_MUTEX
 
-static void tu_fifo_lock(tu_fifo_t *f)
+static TU_ATTR_FAST_FUNC void tu_fifo_lock(tu_fifo_t *f)
 {
   if (f->mutex)
   {
@@ -40,7 +40,7 @@ static void tu_fifo_lock(tu_fifo_t *f)
   }
 }
 
-static void tu_fifo_unlock(tu_fifo_t *f)
+static TU_ATTR_FAST_FUNC void tu_fifo_unlock(tu_fifo_t *f)
 {
   if (f->mutex)
   {
@@ -55,50 +55,194 @@ static void tu_fifo_unlock(tu_fifo_t *f)
 
 #endif
 
-bool tu_fifo_config(tu_fifo_t *f, void* buffer, uint16_t depth, uint16_t item_size, bool overwritable)
+// Other side runs on another core with CFG_TUD_SPLIT_CORE: index of the other side read by count check
+// must be complete before items are accessed, barrier before index update covers the other way
+#if CFG_TUD_SPLIT_CORE
+#define _ff_acquire()   TU_MEM_BARRIER()
+#else
+#define _ff_acquire()
+#endif
+
+bool tu_fifo_config(tu_fifo_t *f, void* buffer, tu_fifo_idx_t depth, uint16_t item_size, bool overwritable)
 {
+  // mirrored index must fit into tu_fifo_idx_t
+  TU_ASSERT(depth > 0 && depth <= TU_FIFO_DEPTH_MAX);
+
   tu_fifo_lock(f);
 
   f->buffer = (uint8_t*) buffer;
   f->depth  = depth;
   f->item_size = item_size;
+  f->idx_mask = TU_FIFO_IS_POW2(depth) ? (tu_fifo_idx_t) (2*depth - 1) : 0;
   f->overwritable = overwritable;
 
-  f->rd_idx = f->wr_idx = f->count = 0;
+  f->rd_idx = f->wr_idx = 0;
+
+#if CFG_TUSB_FIFO_MPSC
+  f->mpsc = false;
+  f->mpsc_state = 0;
+#endif
+
+#if CFG_TUSB_FIFO_STATS
+  memset(&f->stats, 0, sizeof(tu_fifo_stats_t));
+#endif
 
   tu_fifo_unlock(f);
 
   return true;
 }
 
-// retrieve data from fifo
-static void _tu_ff_pull(tu_fifo_t* f, void * buffer)
+static inline tu_fifo_idx_t _ff_min(tu_fifo_idx_t x, tu_fifo_idx_t y)
+{
+  return (x < y) ? x : y;
+}
+
+// Advance a mirrored index by offset ( <= depth ), wrapping around at 2*depth
+static inline tu_fifo_idx_t _ff_advance(tu_fifo_t* f, tu_fifo_idx_t idx, tu_fifo_idx_t offset)
+{
+  if ( f->idx_mask ) return (tu_fifo_idx_t) (idx + offset) & f->idx_mask;
+
+  uint32_t next = (uint32_t) idx + offset;
+  if ( next >= 2u*f->depth ) next -= 2u*f->depth;
+
+  return (tu_fifo_idx_t) next;
+}
+
+// Buffer position of a mirrored index
+static inline tu_fifo_idx_t _ff_pos(tu_fifo_t* f, tu_fifo_idx_t idx)
+{
+  if ( f->idx_mask ) return idx & (f->idx_mask >> 1);
+
+  return (idx >= f->depth) ? (tu_fifo_idx_t) (idx - f->depth) : idx;
+}
+
+//--------------------------------------------------------------------+
+// Statistics, only touched by producer
+//--------------------------------------------------------------------+
+#if CFG_TUSB_FIFO_STATS
+
+// n items are about to be added to fifo currently holding count items
+static inline void _ff_stats_push(tu_fifo_t* f, tu_fifo_idx_t count, tu_fifo_idx_t n)
+{
+  uint32_t const total = (uint32_t) count + n;
+
+  if ( total > f->depth )
+  {
+    f->stats.overwritten += total - f->depth;
+    f->stats.max_count = f->depth;
+  }
+  else if ( total > f->stats.max_count )
+  {
+    f->stats.max_count = (tu_fifo_idx_t) total;
+  }
+}
+
+static inline void _ff_stats_reject(tu_fifo_t* f, uint32_t n)
+{
+  f->stats.rejected += n;
+}
+
+void tu_fifo_clear_stats(tu_fifo_t* f)
+{
+  tu_fifo_lock(f);
+  memset(&f->stats, 0, sizeof(tu_fifo_stats_t));
+  tu_fifo_unlock(f);
+}
+
+#else
+
+#define _ff_stats_push(_f, _count, _n)
+#define _ff_stats_reject(_f, _n)
+
+#endif
+
+// copy n items starting at mirrored index idx out of fifo, contiguous region is copied at once
+static TU_ATTR_FAST_FUNC void _ff_copy_from(tu_fifo_t* f, void * buffer, tu_fifo_idx_t idx, tu_fifo_idx_t n)
+{
+  uint8_t* buf8 = (uint8_t*) buffer;
+  tu_fifo_idx_t const pos = _ff_pos(f, idx);
+
+  // number of items from pos to the end of buffer
+  tu_fifo_idx_t const lin_count = f->depth - pos;
+
+  _ff_acquire();
+
+  if ( n <= lin_count )
+  {
+    tu_memcpy(buf8, f->buffer + (pos * f->item_size), n*f->item_size);
+  }
+  else
+  {
+    // wrap around: copy the linear part then the rest from the buffer start
+    tu_memcpy(buf8, f->buffer + (pos * f->item_size), lin_count*f->item_size);
+    tu_memcpy(buf8 + lin_count*f->item_size, f->buffer, (n - lin_count)*f->item_size);
+  }
+}
+
+// retrieve n items from fifo
+static TU_ATTR_FAST_FUNC void _tu_ff_pull_n(tu_fifo_t* f, void * buffer, tu_fifo_idx_t n)
 {
-  memcpy(buffer,
-         f->buffer + (f->rd_idx * f->item_size),
-         f->item_size);
+  tu_fifo_idx_t const rd_idx = f->rd_idx;
+
+  _ff_copy_from(f, buffer, rd_idx, n);
 
-  f->rd_idx = (f->rd_idx + 1) % f->depth;
-  f->count--;
+  // data must be copied out before producer sees the free space
+  TU_MEM_BARRIER();
+  f->rd_idx = _ff_advance(f, rd_idx, n);
 }
 
-// send data to fifo
-static void _tu_ff_push(tu_fifo_t* f, void const * data)
+// copy n items into fifo starting at mirrored index idx, contiguous region is copied at once
+static TU_ATTR_FAST_FUNC void _ff_copy_to(tu_fifo_t* f, tu_fifo_idx_t idx, void const * data, tu_fifo_idx_t n)
 {
-  memcpy( f->buffer + (f->wr_idx * f->item_size),
-          data,
-          f->item_size);
+  uint8_t const* buf8 = (uint8_t const*) data;
+  tu_fifo_idx_t const pos = _ff_pos(f, idx);
+
+  // number of items from pos to the end of buffer
+  tu_fifo_idx_t const lin_count = f->depth - pos;
 
-  f->wr_idx = (f->wr_idx + 1) % f->depth;
+  _ff_acquire();
 
-  if (tu_fifo_full(f))
+  if ( n <= lin_count )
   {
-    f->rd_idx = f->wr_idx; // keep the full state (rd == wr && len = size)
+    tu_memcpy(f->buffer + (pos * f->item_size), buf8, n*f->item_size);
   }
   else
   {
-    f->count++;
+    // wrap around: copy the linear part then the rest to the buffer start
+    tu_memcpy(f->buffer + (pos * f->item_size), buf8, lin_count*f->item_size);
+    tu_memcpy(f->buffer, buf8 + lin_count*f->item_size, (n - lin_count)*f->item_size);
+  }
+}
+
+// send n items to fifo
+static TU_ATTR_FAST_FUNC void _tu_ff_push_n(tu_fifo_t* f, void const * data, tu_fifo_idx_t n)
+{
+  uint8_t const* buf8 = (uint8_t const*) data;
+  tu_fifo_idx_t const count  = tu_fifo_count(f);
+
+  _ff_stats_push(f, count, n);
+
+  // only the last depth items can remain in an overwritable fifo
+  if ( n > f->depth )
+  {
+    buf8 += (n - f->depth)*f->item_size;
+    n = f->depth;
+  }
+
+  tu_fifo_idx_t const wr_idx = f->wr_idx;
+  _ff_copy_to(f, wr_idx, buf8, n);
+
+  tu_fifo_idx_t const new_wr = _ff_advance(f, wr_idx, n);
+
+  if ( (uint32_t) count + n > f->depth )
+  {
+    // overwritten: keep the full state (wr - rd == depth)
+    f->rd_idx = _ff_advance(f, new_wr, f->depth);
   }
+
+  // data must be in buffer before consumer sees the new item(s)
+  TU_MEM_BARRIER();
+  f->wr_idx = new_wr;
 }
 
 /******************************************************************************/
@@ -117,13 +261,13 @@ static void _tu_ff_push(tu_fifo_t* f, void const * data)
     @returns TRUE if the queue is not empty
 */
 /******************************************************************************/
-bool tu_fifo_read(tu_fifo_t* f, void * buffer)
+TU_ATTR_FAST_FUNC bool tu_fifo_read(tu_fifo_t* f, void * buffer)
 {
   if( tu_fifo_empty(f) ) return false;
 
   tu_fifo_lock(f);
 
-  _tu_ff_pull(f, buffer);
+  _tu_ff_pull_n(f, buffer, 1);
 
   tu_fifo_unlock(f);
 
@@ -146,29 +290,20 @@ bool tu_fifo_read(tu_fifo_t* f, void * buffer)
     @returns number of items read from the FIFO
 */
 /******************************************************************************/
-uint16_t tu_fifo_read_n (tu_fifo_t* f, void * buffer, uint16_t count)
+TU_ATTR_FAST_FUNC tu_fifo_idx_t tu_fifo_read_n (tu_fifo_t* f, void * buffer, tu_fifo_idx_t count)
 {
   if( tu_fifo_empty(f) ) return 0;
 
   tu_fifo_lock(f);
 
   /* Limit up to fifo's count */
-  if ( count > f->count ) count = f->count;
+  count = _ff_min(count, tu_fifo_count(f));
 
-  uint8_t* buf8 = (uint8_t*) buffer;
-  uint16_t len = 0;
-
-  while (len < count)
-  {
-    _tu_ff_pull(f, buf8);
-
-    len++;
-    buf8 += f->item_size;
-  }
+  _tu_ff_pull_n(f, buffer, count);
 
   tu_fifo_unlock(f);
 
-  return len;
+  return count;
 }
 
 /******************************************************************************/
@@ -185,19 +320,340 @@ uint16_t tu_fifo_read_n (tu_fifo_t* f, void * buffer, uint16_t count)
     @returns TRUE if the queue is not empty
 */
 /******************************************************************************/
-bool tu_fifo_peek_at(tu_fifo_t* f, uint16_t pos, void * p_buffer)
+TU_ATTR_FAST_FUNC bool tu_fifo_peek_at(tu_fifo_t* f, tu_fifo_idx_t pos, void * p_buffer)
 {
-  if ( pos >= f->count ) return false;
+  if ( pos >= tu_fifo_count(f) ) return false;
 
   // rd_idx is pos=0
-  uint16_t index = (f->rd_idx + pos) % f->depth;
-  memcpy(p_buffer,
-         f->buffer + (index * f->item_size),
-         f->item_size);
+  _ff_copy_from(f, p_buffer, _ff_advance(f, f->rd_idx, pos), 1);
 
   return true;
 }
 
+/******************************************************************************/
+/*!
+    @brief Reads n items without removing them from the FIFO
+
+    @param[in]  f
+                Pointer to the FIFO buffer to manipulate
+    @param[in]  p_buffer
+                Pointer to the place holder for data read from the buffer
+    @param[in]  count
+                Number of element that buffer can afford
+
+    @returns number of items read from the FIFO
+*/
+/******************************************************************************/
+TU_ATTR_FAST_FUNC tu_fifo_idx_t tu_fifo_peek_n(tu_fifo_t* f, void * p_buffer, tu_fifo_idx_t count)
+{
+  tu_fifo_lock(f);
+
+  count = _ff_min(count, tu_fifo_count(f));
+  if ( count ) _ff_copy_from(f, p_buffer, f->rd_idx, count);
+
+  tu_fifo_unlock(f);
+
+  return count;
+}
+
+/******************************************************************************/
+/*!
+    @brief Search for a byte value in a FIFO whose item size is 1, similar to
+    memchr() but handling the wrap around of the buffer.
+
+    @param[in]  f
+                Pointer to the FIFO buffer to manipulate
+    @param[in]  value
+                Byte value to search for
+    @param[in]  pos
+                Position to start searching from, 0 is the oldest item
+    @param[out] p_found
+                Position of the first matched item
+
+    @returns TRUE if value is found
+*/
+/******************************************************************************/
+bool tu_fifo_find(tu_fifo_t* f, uint8_t value, tu_fifo_idx_t pos, tu_fifo_idx_t* p_found)
+{
+  TU_ASSERT(f->item_size == 1);
+
+  tu_fifo_lock(f);
+
+  tu_fifo_idx_t const count = tu_fifo_count(f);
+  bool found = false;
+
+  if ( pos < count )
+  {
+    tu_fifo_idx_t const start   = _ff_pos(f, _ff_advance(f, f->rd_idx, pos));
+    tu_fifo_idx_t const n       = count - pos;
+    tu_fifo_idx_t const lin_len = _ff_min(n, f->depth - start);
+
+    // linear part then the wrapped part from the buffer start
+    uint8_t const* p = (uint8_t const*) memchr(f->buffer + start, value, lin_len);
+
+    if ( p )
+    {
+      (*p_found) = pos + (tu_fifo_idx_t) (p - (f->buffer + start));
+      found = true;
+    }
+    else if ( n > lin_len )
+    {
+      p = (uint8_t const*) memchr(f->buffer, value, n - lin_len);
+      if ( p )
+      {
+        (*p_found) = pos + lin_len + (tu_fifo_idx_t) (p - f->buffer);
+        found = true;
+      }
+    }
+  }
+
+  tu_fifo_unlock(f);
+
+  return found;
+}
+
+// Access hardware register of 2 or 4 byte width
+static inline void _hw_reg_write(void volatile * reg, uint8_t reg_width, uint32_t value)
+{
+  if ( reg_width == 4 ) *((uint32_t volatile *) reg) = value;
+  else                  *((uint16_t volatile *) reg) = (uint16_t) value;
+}
+
+static inline uint32_t _hw_reg_read(void volatile * reg, uint8_t reg_width)
+{
+  return (reg_width == 4) ? *((uint32_t volatile *) reg) : *((uint16_t volatile *) reg);
+}
+
+/******************************************************************************/
+/*!
+    @brief Move n bytes out of a FIFO (item size 1) into a fixed address hardware
+    register, one word per access. Contiguous part of the ring is read word by
+    word, only the word straddling the buffer end is assembled byte by byte.
+
+    @param[in]  f
+                Pointer to the FIFO buffer to manipulate
+    @param[in]  reg
+                Address of the hardware FIFO register
+    @param[in]  reg_width
+                Width of the register in bytes: 2 or 4
+    @param[in]  count
+                Number of bytes to move
+
+    @returns number of bytes removed from the FIFO
+*/
+/******************************************************************************/
+TU_ATTR_FAST_FUNC tu_fifo_idx_t tu_fifo_read_n_to_hw(tu_fifo_t* f, void volatile * reg, uint8_t reg_width, tu_fifo_idx_t count)
+{
+  TU_ASSERT(f->item_size == 1 && (reg_width == 2 || reg_width == 4), 0);
+
+  tu_fifo_lock(f);
+
+  count = _ff_min(count, tu_fifo_count(f));
+
+  tu_fifo_idx_t const rd_idx = f->rd_idx;
+  tu_fifo_idx_t pos = _ff_pos(f, rd_idx);
+  tu_fifo_idx_t remaining = count;
+
+  while ( remaining )
+  {
+    tu_fifo_idx_t const lin_len = f->depth - pos;
+    uint8_t const nbytes = (uint8_t) _ff_min(reg_width, remaining);
+    uint32_t value = 0;
+
+    if ( lin_len >= nbytes )
+    {
+      // little endian word from the linear part (possibly unaligned)
+      memcpy(&value, f->buffer + pos, nbytes);
+      pos = (lin_len == nbytes) ? 0 : (pos + nbytes);
+    }
+    else
+    {
+      // word straddles the end of buffer
+      for(uint8_t i=0; i<nbytes; i++)
+      {
+        value |= ((uint32_t) f->buffer[pos]) << (8*i);
+        pos = (pos + 1 == f->depth) ? 0 : (pos + 1);
+      }
+    }
+
+    _hw_reg_write(reg, reg_width, value);
+    remaining -= nbytes;
+  }
+
+  TU_MEM_BARRIER();
+  f->rd_idx = _ff_advance(f, rd_idx, count);
+
+  tu_fifo_unlock(f);
+
+  return count;
+}
+
+/******************************************************************************/
+/*!
+    @brief Move n bytes from a fixed address hardware register into a FIFO
+    (item size 1, not overwritable), one word per access.
+
+    @param[in]  f
+                Pointer to the FIFO buffer to manipulate
+    @param[in]  reg
+                Address of the hardware FIFO register
+    @param[in]  reg_width
+                Width of the register in bytes: 2 or 4
+    @param[in]  count
+                Number of bytes to move, the register is always read entirely
+                for the last partial word.
+
+    @returns number of bytes written to the FIFO. Caller must ensure there is
+             enough room since bytes which do not fit are still read from
+             the register and discarded.
+*/
+/******************************************************************************/
+TU_ATTR_FAST_FUNC tu_fifo_idx_t tu_fifo_write_n_from_hw(tu_fifo_t* f, void volatile * reg, uint8_t reg_width, tu_fifo_idx_t count)
+{
+  TU_ASSERT(f->item_size == 1 && (reg_width == 2 || reg_width == 4), 0);
+
+  tu_fifo_lock(f);
+
+  tu_fifo_idx_t const ff_count = tu_fifo_count(f);
+  tu_fifo_idx_t const room   = _ff_min(count, f->depth - ff_count);
+  tu_fifo_idx_t const wr_idx = f->wr_idx;
+
+  _ff_stats_push(f, ff_count, room);
+  _ff_stats_reject(f, count - room);
+  tu_fifo_idx_t pos     = _ff_pos(f, wr_idx);
+  tu_fifo_idx_t written = 0;
+
+  while ( count )
+  {
+    uint8_t const nbytes = (uint8_t) _ff_min(reg_width, count);
+    uint32_t const value = _hw_reg_read(reg, reg_width);
+
+    // number of bytes of this word still fit into fifo
+    uint8_t const nstore = (uint8_t) _ff_min(nbytes, room - written);
+    tu_fifo_idx_t const lin_len = f->depth - pos;
+
+    if ( lin_len >= nstore )
+    {
+      memcpy(f->buffer + pos, &value, nstore);
+      pos = (lin_len == nstore) ? 0 : (pos + nstore);
+    }
+    else
+    {
+      for(uint8_t i=0; i<nstore; i++)
+      {
+        f->buffer[pos] = (uint8_t) (value >> (8*i));
+        pos = (pos + 1 == f->depth) ? 0 : (pos + 1);
+      }
+    }
+
+    written += nstore;
+    count   -= nbytes;
+  }
+
+  TU_MEM_BARRIER();
+  f->wr_idx = _ff_advance(f, wr_idx, written);
+
+  tu_fifo_unlock(f);
+
+  return written;
+}
+
+/******************************************************************************/
+/*!
+    @brief Get the largest contiguous block of readable items starting at the
+    read pointer, without removing them from the FIFO. Items should be removed
+    with tu_fifo_advance_read_pointer() once consumed e.g DMA is complete.
+
+    @param[in]  f
+                Pointer to the FIFO buffer to manipulate
+    @param[out] pp_data
+                Pointer to the first readable item within FIFO buffer
+
+    @returns number of contiguous readable items
+*/
+/******************************************************************************/
+TU_ATTR_FAST_FUNC tu_fifo_idx_t tu_fifo_get_linear_read_info(tu_fifo_t* f, void** pp_data)
+{
+  tu_fifo_idx_t const count = tu_fifo_count(f);
+  tu_fifo_idx_t const pos   = _ff_pos(f, f->rd_idx);
+
+  (*pp_data) = f->buffer + (pos * f->item_size);
+
+  return _ff_min(count, f->depth - pos);
+}
+
+/******************************************************************************/
+/*!
+    @brief Get the largest contiguous block of free space starting at the
+    write pointer. Written items should be committed with
+    tu_fifo_advance_write_pointer() e.g when DMA is complete.
+
+    @param[in]  f
+                Pointer to the FIFO buffer to manipulate
+    @param[out] pp_data
+                Pointer to the first free item within FIFO buffer
+
+    @returns number of contiguous free items
+*/
+/******************************************************************************/
+TU_ATTR_FAST_FUNC tu_fifo_idx_t tu_fifo_get_linear_write_info(tu_fifo_t* f, void** pp_data)
+{
+  tu_fifo_idx_t const remaining = tu_fifo_remaining(f);
+  tu_fifo_idx_t const pos       = _ff_pos(f, f->wr_idx);
+
+  (*pp_data) = f->buffer + (pos * f->item_size);
+
+  return _ff_min(remaining, f->depth - pos);
+}
+
+/******************************************************************************/
+/*!
+    @brief Remove n items which were consumed in place from the FIFO. Can
+    also be used to discard the oldest items without copying them out.
+
+    @param[in]  f
+                Pointer to the FIFO buffer to manipulate
+    @param[in]  n
+                Number of items, limited to the FIFO's count
+*/
+/******************************************************************************/
+TU_ATTR_FAST_FUNC void tu_fifo_advance_read_pointer(tu_fifo_t* f, tu_fifo_idx_t n)
+{
+  tu_fifo_lock(f);
+
+  n = _ff_min(n, tu_fifo_count(f));
+
+  TU_MEM_BARRIER();
+  f->rd_idx = _ff_advance(f, f->rd_idx, n);
+
+  tu_fifo_unlock(f);
+}
+
+/******************************************************************************/
+/*!
+    @brief Commit n items which were written in place into the FIFO
+
+    @param[in]  f
+                Pointer to the FIFO buffer to manipulate
+    @param[in]  n
+                Number of items, limited to the FIFO's remaining space
+*/
+/******************************************************************************/
+TU_ATTR_FAST_FUNC void tu_fifo_advance_write_pointer(tu_fifo_t* f, tu_fifo_idx_t n)
+{
+  tu_fifo_lock(f);
+
+  tu_fifo_idx_t const count = tu_fifo_count(f);
+
+  n = _ff_min(n, f->depth - count);
+  _ff_stats_push(f, count, n);
+
+  TU_MEM_BARRIER();
+  f->wr_idx = _ff_advance(f, f->wr_idx, n);
+
+  tu_fifo_unlock(f);
+}
+
 /******************************************************************************/
 /*!
     @brief Write one element into the RX buffer.
@@ -215,13 +671,17 @@ bool tu_fifo_peek_at(tu_fifo_t* f, uint16_t pos, void * p_buffer)
              FIFO will always return TRUE)
 */
 /******************************************************************************/
-bool tu_fifo_write (tu_fifo_t* f, const void * data)
+TU_ATTR_FAST_FUNC bool tu_fifo_write (tu_fifo_t* f, const void * data)
 {
-  if ( tu_fifo_full(f) && !f->overwritable ) return false;
+  if ( tu_fifo_full(f) && !f->overwritable )
+  {
+    _ff_stats_reject(f, 1);
+    return false;
+  }
 
   tu_fifo_lock(f);
 
-  _tu_ff_push(f, data);
+  _tu_ff_push_n(f, data, 1);
 
   tu_fifo_unlock(f);
 
@@ -234,6 +694,10 @@ bool tu_fifo_write (tu_fifo_t* f, const void * data)
     the write pointer and increment the write index. If the write index
     exceeds the max buffer size, then it will roll over to zero.
 
+    Overwritable FIFO drops as many oldest items as needed with a single
+    update of the read index, and only copies the last depth items when
+    count is larger than the FIFO.
+
     @param[in]  f
                 Pointer to the FIFO buffer to manipulate
     @param[in]  data
@@ -243,27 +707,265 @@ bool tu_fifo_write (tu_fifo_t* f, const void * data)
     @return Number of written elements
 */
 /******************************************************************************/
-uint16_t tu_fifo_write_n (tu_fifo_t* f, const void * data, uint16_t count)
+TU_ATTR_FAST_FUNC tu_fifo_idx_t tu_fifo_write_n (tu_fifo_t* f, const void * data, tu_fifo_idx_t count)
 {
   if ( count == 0 ) return 0;
 
   tu_fifo_lock(f);
 
   // Not overwritable limit up to full
-  if (!f->overwritable) count = tu_min16(count, tu_fifo_remaining(f));
+  if (!f->overwritable)
+  {
+    tu_fifo_idx_t const remaining = tu_fifo_remaining(f);
+    if ( count > remaining )
+    {
+      _ff_stats_reject(f, count - remaining);
+      count = remaining;
+    }
+  }
 
-  uint8_t const* buf8 = (uint8_t const*) data;
-  uint16_t len = 0;
+  if ( count ) _tu_ff_push_n(f, data, count);
+
+  tu_fifo_unlock(f);
+
+  return count;
+}
+
+//--------------------------------------------------------------------+
+// Multiple producers
+//--------------------------------------------------------------------+
+#if CFG_TUSB_FIFO_MPSC
+
+#define MPSC_IDX_MASK     0x0000FFFFu
+#define MPSC_WRITER_ONE   0x00010000u
+
+void tu_fifo_config_mpsc(tu_fifo_t* f)
+{
+  TU_ASSERT(!f->overwritable, );
 
-  while (len < count)
+  f->mpsc_state = f->wr_idx;
+  f->mpsc = true;
+}
+
+TU_ATTR_FAST_FUNC tu_fifo_idx_t tu_fifo_write_n_mpsc(tu_fifo_t* f, void const * data, tu_fifo_idx_t count)
+{
+  if ( count == 0 ) return 0;
+
+  // Reserve: move reserve index and count this writer in with one compare-and-swap. Reserved items
+  // are after published wr_idx, hence free space is checked against reserve index.
+  uint32_t state = __atomic_load_n(&f->mpsc_state, __ATOMIC_ACQUIRE);
+  uint32_t next;
+  tu_fifo_idx_t idx;
+  tu_fifo_idx_t n;
+
+  do
+  {
+    idx = (tu_fifo_idx_t) (state & MPSC_IDX_MASK);
+
+    tu_fifo_idx_t const rd_idx = f->rd_idx;
+    tu_fifo_idx_t const used = f->idx_mask ? (tu_fifo_idx_t) ((idx - rd_idx) & f->idx_mask) :
+                               (idx >= rd_idx) ? (tu_fifo_idx_t) (idx - rd_idx) : (tu_fifo_idx_t) (2*f->depth - (rd_idx - idx));
+
+    n = _ff_min(count, f->depth - used);
+    if ( n == 0 ) break;
+
+    next = ((state & ~MPSC_IDX_MASK) + MPSC_WRITER_ONE) | _ff_advance(f, idx, n);
+  } while ( !__atomic_compare_exchange_n(&f->mpsc_state, &state, next, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) );
+
+#if CFG_TUSB_FIFO_STATS
+  if ( n < count ) __atomic_fetch_add(&f->stats.rejected, count - n, __ATOMIC_RELAXED);
+#endif
+
+  if ( n == 0 ) return 0;
+
+  _ff_copy_to(f, idx, data, n);
+
+  // Leave: the last writer in progress publishes all reserved items. Publishing before being counted
+  // out makes wr_idx only move forward: another writer can only publish once this one has left.
+  state = __atomic_load_n(&f->mpsc_state, __ATOMIC_ACQUIRE);
+  do
   {
-    _tu_ff_push(f, buf8);
+    if ( (state & ~MPSC_IDX_MASK) == MPSC_WRITER_ONE )
+    {
+      __atomic_store_n(&f->wr_idx, (tu_fifo_idx_t) (state & MPSC_IDX_MASK), __ATOMIC_RELEASE);
+    }
+  } while ( !__atomic_compare_exchange_n(&f->mpsc_state, &state, state - MPSC_WRITER_ONE, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) );
+
+  return n;
+}
 
-    len++;
-    buf8 += f->item_size;
+#endif
+
+//--------------------------------------------------------------------+
+// Message FIFO
+//--------------------------------------------------------------------+
+
+// length field of record filling the tail of buffer, which is skipped by reader
+#define MSG_PAD_LEN   0xFFFFu
+
+static inline tu_fifo_idx_t _ff_msg_size(uint16_t len)
+{
+  return (tu_fifo_idx_t) (TU_FIFO_MSG_HDR_SIZE + tu_align_n(len + 3u, 4));
+}
+
+static inline void _ff_msg_set_len(uint8_t* hdr, uint16_t len)
+{
+  hdr[0] = tu_u16_low(len);
+  hdr[1] = tu_u16_high(len);
+  hdr[2] = hdr[3] = 0;
+}
+
+static inline uint16_t _ff_msg_get_len(uint8_t const* hdr)
+{
+  return tu_u16(hdr[1], hdr[0]);
+}
+
+/******************************************************************************/
+/*!
+    @brief Configure a message fifo, depth in bytes must be multiple of 4 so
+    that records and the tail skipped before wrapping around stay aligned.
+*/
+/******************************************************************************/
+bool tu_fifo_msg_config(tu_fifo_t* f, void* buffer, tu_fifo_idx_t depth)
+{
+  TU_ASSERT( (depth % 4) == 0 && depth >= 2*TU_FIFO_MSG_HDR_SIZE );
+  return tu_fifo_config(f, buffer, depth, 1, false);
+}
+
+/******************************************************************************/
+/*!
+    @brief Check if a message of len bytes can be written now, either right
+    at write pointer or at the beginning of buffer after skipping the tail.
+*/
+/******************************************************************************/
+TU_ATTR_FAST_FUNC bool tu_fifo_msg_writable(tu_fifo_t* f, uint16_t len)
+{
+  TU_VERIFY( len < MSG_PAD_LEN - TU_FIFO_MSG_HDR_SIZE );
+
+  uint32_t const size      = _ff_msg_size(len);
+  tu_fifo_idx_t const remaining = tu_fifo_remaining(f);
+  tu_fifo_idx_t const tail      = (tu_fifo_idx_t) (f->depth - _ff_pos(f, f->wr_idx));
+
+  if ( tail >= size ) return remaining >= size;
+
+  // tail is skipped: whole tail must be free and message fits before read pointer
+  return (remaining >= tail) && ((uint32_t) (remaining - tail) >= size);
+}
+
+/******************************************************************************/
+/*!
+    @brief Reserve contiguous space for a message of up to len bytes. Tail of
+    buffer is padded if message does not fit there.
+
+    @returns pointer to payload, NULL if there is not enough space
+*/
+/******************************************************************************/
+TU_ATTR_FAST_FUNC void* tu_fifo_msg_reserve(tu_fifo_t* f, uint16_t len)
+{
+  TU_VERIFY( tu_fifo_msg_writable(f, len), NULL );
+
+  uint8_t* hdr;
+  tu_fifo_idx_t const linear = tu_fifo_get_linear_write_info(f, (void**) &hdr);
+
+  if ( linear < _ff_msg_size(len) )
+  {
+    _ff_msg_set_len(hdr, MSG_PAD_LEN);
+    tu_fifo_advance_write_pointer(f, linear);
+    tu_fifo_get_linear_write_info(f, (void**) &hdr);
   }
 
-  tu_fifo_unlock(f);
+  return hdr + TU_FIFO_MSG_HDR_SIZE;
+}
+
+/******************************************************************************/
+/*!
+    @brief Commit message written in place after tu_fifo_msg_reserve(), len
+    must not exceed the reserved length.
+*/
+/******************************************************************************/
+TU_ATTR_FAST_FUNC void tu_fifo_msg_commit(tu_fifo_t* f, uint16_t len)
+{
+  uint8_t* hdr;
+  tu_fifo_get_linear_write_info(f, (void**) &hdr);
+
+  _ff_msg_set_len(hdr, len);
+  tu_fifo_advance_write_pointer(f, _ff_msg_size(len));
+}
+
+/******************************************************************************/
+/*!
+    @brief Write a whole message, nothing is written if it does not fit
+*/
+/******************************************************************************/
+TU_ATTR_FAST_FUNC bool tu_fifo_msg_write(tu_fifo_t* f, void const * p_data, uint16_t len)
+{
+  uint8_t* payload = (uint8_t*) tu_fifo_msg_reserve(f, len);
+  TU_VERIFY( payload );
+
+  memcpy(payload, p_data, len);
+  tu_fifo_msg_commit(f, len);
+
+  return true;
+}
+
+/******************************************************************************/
+/*!
+    @brief Get oldest message in place without removing it
+
+    @param[out] p_len
+                Length of message
+
+    @returns pointer to payload, NULL if fifo is empty
+*/
+/******************************************************************************/
+TU_ATTR_FAST_FUNC void* tu_fifo_msg_peek(tu_fifo_t* f, uint16_t* p_len)
+{
+  uint8_t* hdr;
+  tu_fifo_idx_t linear = tu_fifo_get_linear_read_info(f, (void**) &hdr);
+  _ff_acquire();
+
+  // padded tail is skipped, writer has committed all of it
+  if ( linear && MSG_PAD_LEN == _ff_msg_get_len(hdr) )
+  {
+    tu_fifo_advance_read_pointer(f, linear);
+    linear = tu_fifo_get_linear_read_info(f, (void**) &hdr);
+    _ff_acquire();
+  }
+
+  TU_VERIFY( linear >= TU_FIFO_MSG_HDR_SIZE, NULL );
+
+  (*p_len) = _ff_msg_get_len(hdr);
+  return hdr + TU_FIFO_MSG_HDR_SIZE;
+}
+
+/******************************************************************************/
+/*!
+    @brief Remove oldest message e.g once consumed in place
+*/
+/******************************************************************************/
+TU_ATTR_FAST_FUNC void tu_fifo_msg_release(tu_fifo_t* f)
+{
+  uint16_t len;
+  if ( tu_fifo_msg_peek(f, &len) ) tu_fifo_advance_read_pointer(f, _ff_msg_size(len));
+}
+
+/******************************************************************************/
+/*!
+    @brief Read and remove oldest message. Bytes not fitting into buffer are
+    discarded with the rest of the message.
+
+    @returns number of bytes copied, 0 if fifo is empty
+*/
+/******************************************************************************/
+TU_ATTR_FAST_FUNC uint16_t tu_fifo_msg_read(tu_fifo_t* f, void * p_buffer, uint16_t bufsize)
+{
+  uint16_t len;
+  uint8_t const* payload = (uint8_t const*) tu_fifo_msg_peek(f, &len);
+  TU_VERIFY( payload, 0 );
+
+  len = tu_min16(len, bufsize);
+  memcpy(p_buffer, payload, len);
+  tu_fifo_msg_release(f);
 
   return len;
 }
@@ -278,9 +980,18 @@ uint16_t tu_fifo_write_n (tu_fifo_t* f, const void * data, uint16_t count)
 /******************************************************************************/
 bool tu_fifo_clear(tu_fifo_t *f)
 {
+#if CFG_TUSB_FIFO_MPSC
+  if ( f->mpsc )
+  {
+    // writers in progress keep their reservation, consumer drops what is published
+    f->rd_idx = f->wr_idx;
+    return true;
+  }
+#endif
+
   tu_fifo_lock(f);
 
-  f->rd_idx = f->wr_idx = f->count = 0;
+  f->rd_idx = f->wr_idx = 0;
 
   tu_fifo_unlock(f);
 
@@ -37,6 +37,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "tusb_option.h"
 
 #ifdef __cplusplus
  extern "C" {
@@ -46,38 +47,106 @@
 #define tu_fifo_mutex_t  osal_mutex_t
 #endif
 
+// Use 32-bit depth & indices e.g for high speed streaming FIFO larger than 32K items.
+// Default is 16-bit to save RAM and keep index update atomic on all MCUs.
+#ifndef CFG_TUSB_FIFO_WIDE_INDEX
+#define CFG_TUSB_FIFO_WIDE_INDEX  0
+#endif
+
+#if CFG_TUSB_FIFO_WIDE_INDEX
+typedef uint32_t tu_fifo_idx_t;
+#define TU_FIFO_DEPTH_MAX   0x40000000UL
+#else
+typedef uint16_t tu_fifo_idx_t;
+#define TU_FIFO_DEPTH_MAX   0x8000U
+#endif
+
+// Maximum number of items can be passed to a single read/write call
+#define TU_FIFO_COUNT_MAX   ((tu_fifo_idx_t) -1)
+
+// Collect usage statistics (high-water mark, rejected & overwritten items) per FIFO,
+// useful for sizing class buffers and event queue.
+#ifndef CFG_TUSB_FIFO_STATS
+#define CFG_TUSB_FIFO_STATS  0
+#endif
+
+// Lock-free writes from multiple producers with tu_fifo_write_n_mpsc(), e.g many RTOS tasks and ISRs
+// logging to the same fifo. Uses compare-and-swap of GCC/Clang __atomic builtins, which is native on
+// ARMv7-M/ARMv8-M mainline but a libatomic call on ARMv6-M (Cortex-M0/M0+). Needs 16-bit indices.
+#ifndef CFG_TUSB_FIFO_MPSC
+#define CFG_TUSB_FIFO_MPSC  0
+#endif
+
+#if CFG_TUSB_FIFO_MPSC && CFG_TUSB_FIFO_WIDE_INDEX
+  #error "CFG_TUSB_FIFO_MPSC packs an index and writer count in 32-bit word, not supported with CFG_TUSB_FIFO_WIDE_INDEX"
+#endif
+
+#if CFG_TUSB_FIFO_STATS
+typedef struct
+{
+  tu_fifo_idx_t max_count   ; ///< highest number of items seen in FIFO
+  uint32_t      rejected    ; ///< items dropped since non-overwritable FIFO is full
+  uint32_t      overwritten ; ///< oldest items replaced in overwritable FIFO
+} tu_fifo_stats_t;
+#endif
+
 
 /** \struct tu_fifo_t
  * \brief Simple Circular FIFO
+ *
+ * Read and write indices run from 0 to 2*depth-1 so that full and empty can be
+ * told apart without a shared counter. wr_idx is only written by the producer and
+ * rd_idx only by the consumer, therefore a non-overwritable FIFO with a single
+ * producer and a single consumer (e.g ISR -> task) needs neither mutex nor
+ * interrupt masking. Overwritable FIFO moves rd_idx when writing, and multiple
+ * producers/consumers must be serialized with a mutex (see tu_fifo_config_mutex).
+ *
+ * When depth is a power of two, indices are wrapped with a mask instead of
+ * compare & subtract.
  */
 typedef struct
 {
-           uint8_t* buffer    ; ///< buffer pointer
-           uint16_t depth     ; ///< max items
-           uint16_t item_size ; ///< size of each item
-           bool overwritable  ;
+           uint8_t*      buffer    ; ///< buffer pointer
+           tu_fifo_idx_t depth     ; ///< max items
+           uint16_t      item_size ; ///< size of each item
+           tu_fifo_idx_t idx_mask  ; ///< 2*depth-1 if depth is power of two, 0 otherwise
+           bool          overwritable;
 
-  volatile uint16_t count     ; ///< number of items in queue
-  volatile uint16_t wr_idx    ; ///< write pointer
-  volatile uint16_t rd_idx    ; ///< read pointer
+  volatile tu_fifo_idx_t wr_idx    ; ///< write pointer, owned by producer
+  volatile tu_fifo_idx_t rd_idx    ; ///< read pointer, owned by consumer
 
 #if CFG_FIFO_MUTEX
   tu_fifo_mutex_t mutex;
 #endif
 
+#if CFG_TUSB_FIFO_MPSC
+           bool          mpsc;              ///< written with tu_fifo_write_n_mpsc() only
+  volatile uint32_t      mpsc_state;        ///< reserve index (bit 15:0) | writers in progress (bit 31:16)
+#endif
+
+#if CFG_TUSB_FIFO_STATS
+  tu_fifo_stats_t stats;            ///< updated by producer only
+#endif
+
 } tu_fifo_t;
 
+#define TU_FIFO_IS_POW2(_depth)  ( ((_depth) & ((_depth) - 1)) == 0 )
+
+#define TU_FIFO_INIT(_buffer, _depth, _type, _overwritable)                 \
+  {                                                                         \
+      .buffer       = _buffer,                                              \
+      .depth        = _depth,                                               \
+      .item_size    = sizeof(_type),                                        \
+      .idx_mask     = TU_FIFO_IS_POW2(_depth) ? (tu_fifo_idx_t) (2*(_depth)-1) : 0, \
+      .overwritable = _overwritable,                                        \
+  }
+
 #define TU_FIFO_DEF(_name, _depth, _type, _overwritable) \
   uint8_t _name##_buf[_depth*sizeof(_type)]; \
-  tu_fifo_t _name = {                        \
-      .buffer       = _name##_buf,           \
-      .depth        = _depth,                \
-      .item_size    = sizeof(_type),         \
-      .overwritable = _overwritable,         \
-  }
+  tu_fifo_t _name = TU_FIFO_INIT(_name##_buf, _depth, _type, _overwritable)
 
 bool tu_fifo_clear(tu_fifo_t *f);
-bool tu_fifo_config(tu_fifo_t *f, void* buffer, uint16_t depth, uint16_t item_size, bool overwritable);
+bool tu_fifo_config(tu_fifo_t *f, void* buffer, tu_fifo_idx_t depth, uint16_t item_size, bool overwritable);
 
 #if CFG_FIFO_MUTEX
 static inline void tu_fifo_config_mutex(tu_fifo_t *f, tu_fifo_mutex_t mutex_hdl)
@@ -87,43 +156,104 @@ static inline void tu_fifo_config_mutex(tu_fifo_t *f, tu_fifo_mutex_t mutex_hdl)
 #endif
 
 bool     tu_fifo_write   (tu_fifo_t* f, void const * p_data);
-uint16_t tu_fifo_write_n (tu_fifo_t* f, void const * p_data, uint16_t count);
+tu_fifo_idx_t tu_fifo_write_n (tu_fifo_t* f, void const * p_data, tu_fifo_idx_t count);
+
+#if CFG_TUSB_FIFO_MPSC
+// Multiple producers, single consumer on a non-overwritable fifo without mutex. Each writer reserves
+// space by moving a shared reserve index, copies its items then leaves: items become visible to the
+// consumer once all writers in progress have left, writers never wait for each other. Once configured,
+// fifo must only be written with tu_fifo_write_n_mpsc() and tu_fifo_clear() only drops committed items.
+void          tu_fifo_config_mpsc  (tu_fifo_t* f);
+tu_fifo_idx_t tu_fifo_write_n_mpsc (tu_fifo_t* f, void const * p_data, tu_fifo_idx_t count);
+#endif
 
 bool     tu_fifo_read    (tu_fifo_t* f, void * p_buffer);
-uint16_t tu_fifo_read_n  (tu_fifo_t* f, void * p_buffer, uint16_t count);
+tu_fifo_idx_t tu_fifo_read_n  (tu_fifo_t* f, void * p_buffer, tu_fifo_idx_t count);
+
+bool          tu_fifo_peek_at (tu_fifo_t* f, tu_fifo_idx_t pos, void * p_buffer);
+tu_fifo_idx_t tu_fifo_peek_n  (tu_fifo_t* f, void * p_buffer, tu_fifo_idx_t count);
+
+// Search byte value in fifo of 1-byte item, starting from pos (0 is oldest item)
+bool          tu_fifo_find    (tu_fifo_t* f, uint8_t value, tu_fifo_idx_t pos, tu_fifo_idx_t* p_found);
+
+// Copy between a byte fifo and a fixed address (non-incrementing) 32-bit or 16-bit hardware
+// FIFO register e.g packet FIFO of USB controller. Last partial word is zero-padded on write
+// and its extra bytes are discarded on read.
+tu_fifo_idx_t tu_fifo_read_n_to_hw   (tu_fifo_t* f, void volatile * reg, uint8_t reg_width, tu_fifo_idx_t count);
+tu_fifo_idx_t tu_fifo_write_n_from_hw(tu_fifo_t* f, void volatile * reg, uint8_t reg_width, tu_fifo_idx_t count);
+
+// Zero-copy access e.g for DMA: get the largest contiguous span of readable items
+// (or free space) in place, then commit consumed (or filled) items by advancing the pointer.
+// tu_fifo_advance_read_pointer() also discards n oldest items in one index update.
+tu_fifo_idx_t tu_fifo_get_linear_read_info  (tu_fifo_t* f, void** pp_data);
+tu_fifo_idx_t tu_fifo_get_linear_write_info (tu_fifo_t* f, void** pp_data);
+void     tu_fifo_advance_read_pointer  (tu_fifo_t* f, tu_fifo_idx_t n);
+void     tu_fifo_advance_write_pointer (tu_fifo_t* f, tu_fifo_idx_t n);
+
+// Message FIFO: variable length records in a non-overwritable fifo of 1-byte items, so that packet
+// boundaries are kept. Each record is a 4-byte length header followed by its payload, padded to 4 bytes.
+// Payload never wraps around (tail of buffer is skipped instead) and is 4-byte aligned if buffer is,
+// it can therefore be filled or consumed in place. Messages up to depth/2 - 4 bytes always fit once
+// fifo is drained. Only tu_fifo_msg_* should be used to access it besides count/empty/clear.
+#define TU_FIFO_MSG_HDR_SIZE  4
 
-bool     tu_fifo_peek_at (tu_fifo_t* f, uint16_t pos, void * p_buffer);
+bool     tu_fifo_msg_config   (tu_fifo_t* f, void* buffer, tu_fifo_idx_t depth);
+bool     tu_fifo_msg_writable (tu_fifo_t* f, uint16_t len);
+bool     tu_fifo_msg_write    (tu_fifo_t* f, void const * p_data, uint16_t len);
+uint16_t tu_fifo_msg_read     (tu_fifo_t* f, void * p_buffer, uint16_t bufsize);
+
+// Zero-copy: reserve contiguous space of len bytes then commit the actual length (<= len) of message.
+// Peek returns oldest message in place (NULL if empty), which is removed by release.
+void*    tu_fifo_msg_reserve  (tu_fifo_t* f, uint16_t len);
+void     tu_fifo_msg_commit   (tu_fifo_t* f, uint16_t len);
+void*    tu_fifo_msg_peek     (tu_fifo_t* f, uint16_t* p_len);
+void     tu_fifo_msg_release  (tu_fifo_t* f);
 
 static inline bool tu_fifo_peek(tu_fifo_t* f, void * p_buffer)
 {
   return tu_fifo_peek_at(f, 0, p_buffer);
 }
 
+static inline tu_fifo_idx_t tu_fifo_count(tu_fifo_t* f)
+{
+  // snapshot indices since they can be changed by the other side
+  tu_fifo_idx_t const wr_idx = f->wr_idx;
+  tu_fifo_idx_t const rd_idx = f->rd_idx;
+
+  if ( f->idx_mask ) return (tu_fifo_idx_t) (wr_idx - rd_idx) & f->idx_mask;
+
+  return (wr_idx >= rd_idx) ? (tu_fifo_idx_t) (wr_idx - rd_idx) : (tu_fifo_idx_t) (2*f->depth - (rd_idx - wr_idx));
+}
+
 static inline bool tu_fifo_empty(tu_fifo_t* f)
 {
-  return (f->count == 0);
+  return (f->wr_idx == f->rd_idx);
 }
 
 static inline bool tu_fifo_full(tu_fifo_t* f)
 {
-  return (f->count == f->depth);
+  return (tu_fifo_count(f) == f->depth);
 }
 
-static inline uint16_t tu_fifo_count(tu_fifo_t* f)
+static inline tu_fifo_idx_t tu_fifo_remaining(tu_fifo_t* f)
 {
-  return f->count;
+  return f->depth - tu_fifo_count(f);
 }
 
-static inline uint16_t tu_fifo_remaining(tu_fifo_t* f)
+static inline tu_fifo_idx_t tu_fifo_depth(tu_fifo_t* f)
 {
-  return f->depth - f->count;
+  return f->depth;
 }
 
-static inline uint16_t tu_fifo_depth(tu_fifo_t* f)
+#if CFG_TUSB_FIFO_STATS
+static inline tu_fifo_stats_t const* tu_fifo_get_stats(tu_fifo_t* f)
 {
-  return f->depth;
+  return &f->stats;
 }
 
+void tu_fifo_clear_stats(tu_fifo_t* f);
+#endif
+
 #ifdef __cplusplus
  }
 #endif
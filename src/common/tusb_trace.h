@@ -0,0 +1,93 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#ifndef _TUSB_TRACE_H_
+#define _TUSB_TRACE_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Trace points of device stack
+typedef enum
+{
+  TU_TRACE_ISR_ENTER = 0,    // arg: 0
+  TU_TRACE_ISR_EXIT,         // arg: 0
+  TU_TRACE_EVENT_QUEUE,      // arg: event_id, dcd_event_handler()
+  TU_TRACE_EVENT_TASK,       // arg: event_id, dequeued by tud_task
+  TU_TRACE_XFER_CB_ENTER,    // arg: ep_addr, class driver xfer_cb()
+  TU_TRACE_XFER_CB_EXIT,     // arg: ep_addr
+  TU_TRACE_XFER_SUBMIT,      // arg: ep_addr, usbd_edpt_xfer()
+}tu_trace_id_t;
+
+#if CFG_TUSB_TRACE
+
+// Timestamp of records, default to DWT cycle counter on Cortex-M3 and up
+// (application must enable it with DEMCR.TRCENA and DWT_CTRL.CYCCNTENA)
+#ifndef CFG_TUSB_TRACE_TIMESTAMP
+  #if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__) || defined(__ARM_ARCH_8M_MAIN__)
+    #define CFG_TUSB_TRACE_TIMESTAMP()  (*(volatile uint32_t const*) 0xE0001004UL)
+  #else
+    #define CFG_TUSB_TRACE_TIMESTAMP()  0
+  #endif
+#endif
+
+// Backend receiving the records. Default is a RAM ring (tusb.c). It can be redirected e.g to SEGGER
+// SystemView with SEGGER_SYSVIEW_RecordU32x3(ev_base + _id, _rhport, _arg), or SEGGER RTT.
+#ifndef CFG_TUSB_TRACE_HOOK
+  #define CFG_TUSB_TRACE_HOOK(_id, _rhport, _arg)  tu_trace_record(_id, _rhport, _arg)
+#endif
+
+typedef struct
+{
+  uint32_t timestamp;
+  uint8_t  id;     // tu_trace_id_t
+  uint8_t  rhport;
+  uint8_t  arg;
+  uint8_t  reserved;
+}tu_trace_entry_t;
+
+void tu_trace_record(uint8_t id, uint8_t rhport, uint8_t arg);
+
+// Ring of the latest CFG_TUSB_TRACE_BUFSIZE records, count is number of records written so far:
+// next one goes to count % CFG_TUSB_TRACE_BUFSIZE
+tu_trace_entry_t const* tu_trace_buffer(uint32_t* count);
+
+#define TU_TRACE(_id, _rhport, _arg)   CFG_TUSB_TRACE_HOOK(_id, _rhport, _arg)
+
+#else
+
+#define TU_TRACE(_id, _rhport, _arg)   do {} while (0)
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TUSB_TRACE_H_ */
@@ -209,6 +209,7 @@ typedef enum
   TUSB_DEVICE_STATE_UNPLUG = 0  ,
   TUSB_DEVICE_STATE_CONFIGURED  ,
   TUSB_DEVICE_STATE_SUSPENDED   ,
+  TUSB_DEVICE_STATE_ADDRESSED   , // host only: being enumerated
 }tusb_device_state_t;
 
 typedef enum
@@ -216,8 +217,16 @@ typedef enum
   XFER_RESULT_SUCCESS,
   XFER_RESULT_FAILED,
   XFER_RESULT_STALLED,
+  XFER_RESULT_TIMEOUT, // host only
 }xfer_result_t;
 
+// One buffer segment of a scatter-gather transfer
+typedef struct
+{
+  uint8_t* buffer;
+  uint32_t len;
+}xfer_seg_t;
+
 enum // TODO remove
 {
   DESC_OFFSET_LEN  = 0,
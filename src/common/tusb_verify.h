@@ -63,6 +63,11 @@
  *
  *   #define TU_ASSERT(cond)                  if(cond) {_MESS_FAILED(); TU_BREAKPOINT(), return false;}
  *   #define TU_ASSERT(cond,ret)              if(cond) {_MESS_FAILED(); TU_BREAKPOINT(), return ret;}
+ *
+ *   ASSUME: ASSERT of an invariant of the stack itself, e.g instance of an
+ *           endpoint routed by usbd to its driver. Condition must not have
+ *           side effects. With CFG_TUSB_ASSERT_RELEASE it is not checked,
+ *           only hints the compiler, whereas ASSERT is reduced to VERIFY.
  *  
  *------------------------------------------------------------------*/
 
@@ -74,7 +79,11 @@
 // TU_VERIFY Helper
 //--------------------------------------------------------------------+
 
-#if CFG_TUSB_DEBUG
+#if CFG_TUSB_DEBUG && CFG_TUSB_DEBUG_BINARY
+  // __func__ is a static string, recorded as pointer (tusb_common.h)
+  #define _MESS_ERR(_err)   TU_LOG1("%s %d: failed, error = %s\n", __func__, __LINE__, tusb_strerr[_err])
+  #define _MESS_FAILED()    TU_LOG1("%s %d: assert failed\n", __func__, __LINE__)
+#elif CFG_TUSB_DEBUG
   #include <stdio.h>
   #define _MESS_ERR(_err)   printf("%s %d: failed, error = %s\n", __func__, __LINE__, tusb_strerr[_err])
   #define _MESS_FAILED()    printf("%s %d: assert failed\n", __func__, __LINE__)
@@ -139,11 +148,33 @@
  * - 1 arg : return false if failed
  * - 2 arg : return error if failed
  *------------------------------------------------------------------*/
-#define ASSERT_1ARGS(_cond)            TU_VERIFY_DEFINE(_cond, _MESS_FAILED(); TU_BREAKPOINT(), false)
-#define ASSERT_2ARGS(_cond, _ret)      TU_VERIFY_DEFINE(_cond, _MESS_FAILED(); TU_BREAKPOINT(), _ret)
+#if CFG_TUSB_ASSERT_RELEASE
+  #define ASSERT_1ARGS(_cond)          TU_VERIFY_DEFINE(_cond, , false)
+  #define ASSERT_2ARGS(_cond, _ret)    TU_VERIFY_DEFINE(_cond, , _ret)
+#else
+  #define ASSERT_1ARGS(_cond)          TU_VERIFY_DEFINE(_cond, _MESS_FAILED(); TU_BREAKPOINT(), false)
+  #define ASSERT_2ARGS(_cond, _ret)    TU_VERIFY_DEFINE(_cond, _MESS_FAILED(); TU_BREAKPOINT(), _ret)
+#endif
 
 #define TU_ASSERT(...)             GET_3RD_ARG(__VA_ARGS__, ASSERT_2ARGS, ASSERT_1ARGS,UNUSED)(__VA_ARGS__)
 
+/*------------------------------------------------------------------*/
+/* ASSUME
+ * TU_ASSERT of an invariant, compiled to a hint in release build
+ * - 1 arg : return false if failed
+ * - 2 arg : return error if failed
+ *------------------------------------------------------------------*/
+#if CFG_TUSB_ASSERT_RELEASE
+  #define ASSUME_DEFINE(_cond)         do { if ( !(_cond) ) TU_UNREACHABLE(); } while(0)
+  #define ASSUME_1ARGS(_cond)          ASSUME_DEFINE(_cond)
+  #define ASSUME_2ARGS(_cond, _ret)    ASSUME_DEFINE(_cond)
+#else
+  #define ASSUME_1ARGS(_cond)          ASSERT_1ARGS(_cond)
+  #define ASSUME_2ARGS(_cond, _ret)    ASSERT_2ARGS(_cond, _ret)
+#endif
+
+#define TU_ASSUME(...)             GET_3RD_ARG(__VA_ARGS__, ASSUME_2ARGS, ASSUME_1ARGS,UNUSED)(__VA_ARGS__)
+
 // TODO remove TU_ASSERT_ERR() later
 
 /*------------- Generator for TU_VERIFY_ERR and TU_VERIFY_ERR_HDLR -------------*/
@@ -163,8 +194,13 @@
 /* ASSERT Error
  * basically TU_VERIFY Error with TU_BREAKPOINT() as handler
  *------------------------------------------------------------------*/
-#define ASERT_ERR_1ARGS(_error)         TU_VERIFY_ERR_DEF2(_error, TU_BREAKPOINT())
-#define ASERT_ERR_2ARGS(_error, _ret)   TU_VERIFY_ERR_DEF3(_error, TU_BREAKPOINT(), _ret)
+#if CFG_TUSB_ASSERT_RELEASE
+  #define ASERT_ERR_1ARGS(_error)       do { uint32_t _err = (uint32_t)(_error); if ( 0 != _err ) return _err; } while(0)
+  #define ASERT_ERR_2ARGS(_error, _ret) do { if ( 0 != (uint32_t)(_error) ) return _ret; } while(0)
+#else
+  #define ASERT_ERR_1ARGS(_error)       TU_VERIFY_ERR_DEF2(_error, TU_BREAKPOINT())
+  #define ASERT_ERR_2ARGS(_error, _ret) TU_VERIFY_ERR_DEF3(_error, TU_BREAKPOINT(), _ret)
+#endif
 
 #define TU_ASSERT_ERR(...)         GET_3RD_ARG(__VA_ARGS__, ASERT_ERR_2ARGS, ASERT_ERR_1ARGS,UNUSED)(__VA_ARGS__)
 
@@ -43,15 +43,22 @@ typedef enum
   DCD_EVENT_BUS_RESET,
   DCD_EVENT_UNPLUGGED,
   DCD_EVENT_SOF,
-  DCD_EVENT_SUSPEND, // TODO LPM Sleep L1 support
+  DCD_EVENT_SUSPEND,
   DCD_EVENT_RESUME,
 
+  // Link Power Management (CFG_TUD_LPM): link entered L1 sleep, and back to L0
+  DCD_EVENT_LPM_SLEEP,
+  DCD_EVENT_LPM_RESUME,
+
   DCD_EVENT_SETUP_RECEIVED,
   DCD_EVENT_XFER_COMPLETE,
 
   // Not an DCD event, just a convenient way to defer ISR function
   USBD_EVENT_FUNC_CALL,
 
+  // Not an DCD event, coalesced transfer completions are pending (CFG_TUD_TASK_EVENT_COALESCE)
+  USBD_EVENT_XFER_PENDING,
+
   DCD_EVENT_COUNT
 } dcd_eventid_t;
 
@@ -71,6 +78,12 @@ typedef struct TU_ATTR_ALIGNED(4)
       uint32_t len;
     }xfer_complete;
 
+    // DCD_EVENT_LPM_SLEEP: fields of the LPM token
+    struct {
+      uint8_t besl;          // best effort service latency (HIRD) allowed by host for resume, 0-15
+      uint8_t remote_wakeup; // bRemoteWake, device may wake host up from L1
+    }lpm_sleep;
+
     // USBD_EVENT_FUNC_CALL
     struct {
       void (*func) (void*);
@@ -79,7 +92,23 @@ typedef struct TU_ATTR_ALIGNED(4)
   };
 } dcd_event_t;
 
-//TU_VERIFY_STATIC(sizeof(dcd_event_t) <= 12, "size is not correct");
+// 2-byte header, union is 4-byte aligned: 12 bytes on 32-bit MCUs. Only func_call pointers grow on 64-bit hosts
+TU_VERIFY_STATIC(sizeof(void*) != 4 || sizeof(dcd_event_t) <= 12, "size is not correct");
+
+// Controller capabilities, class drivers may size their transfers and queues from them
+typedef struct
+{
+  uint32_t max_xfer_bytes;    // largest total_bytes of a single non-iso dcd_edpt_xfer()
+  uint8_t  speed;             // highest tusb_speed_t of the port
+
+  uint8_t  multi_packet  : 1; // transfer of several packets runs without cpu per packet
+  uint8_t  dma           : 1; // data is moved by DMA, not copied by cpu
+  uint8_t  double_buffer : 1; // (some) endpoints take the next packet while cpu handles the previous
+  uint8_t  iso           : 1; // isochronous endpoints
+  uint8_t  xfer_append   : 1; // dcd_edpt_xfer_append() is implemented, filled by usbd
+  uint8_t  xfer_sg       : 1; // dcd_edpt_xfer_sg() is implemented, filled by usbd
+  uint8_t                : 2;
+} dcd_caps_t;
 
 /*------------------------------------------------------------------*/
 /* Device API
@@ -103,18 +132,48 @@ void dcd_set_address(uint8_t rhport, uint8_t dev_addr);
 // Receive Set Configure request
 void dcd_set_config (uint8_t rhport, uint8_t config_num);
 
-// Wake up host
+// Wake up host, from L1 sleep too (CFG_TUD_LPM) where resume signalling is only ~50 us
 void dcd_remote_wakeup(uint8_t rhport);
 
+// Get controller capabilities (optional), caps is pre-filled with the lowest common denominator:
+// one full speed packet of CFG_TUD_ENDPOINT0_SIZE per transfer
+TU_ATTR_WEAK void dcd_get_caps(uint8_t rhport, dcd_caps_t* caps);
+
+// Get 11-bit number of the current frame (optional), usbd counts SOF events when not implemented
+TU_ATTR_WEAK uint32_t dcd_frame_number(uint8_t rhport);
+
+// Enable/Disable SOF interrupt (optional), it is disabled after dcd_init(). Without it, SOF interrupt
+// (if any) is always enabled and usbd drops SOF events not needed.
+TU_ATTR_WEAK void dcd_sof_enable(uint8_t rhport, bool en);
+
 //--------------------------------------------------------------------+
 // Endpoint API
 //--------------------------------------------------------------------+
 
-// Configure endpoint's registers according to descriptor
+// Configure endpoint's registers according to descriptor.
+// Isochronous endpoint moves up to size x (1 + hs_period_mult) bytes per (micro)frame. A transfer
+// on it is one service interval: no handshake and no retry, a missed or corrupted frame completes
+// with XFER_RESULT_FAILED and the bytes actually moved. Return false if port has no iso support.
 bool dcd_edpt_open        (uint8_t rhport, tusb_desc_endpoint_t const * p_endpoint_desc);
 
 // Submit a transfer, When complete dcd_event_xfer_complete() is invoked to notify the stack
-bool dcd_edpt_xfer        (uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint16_t total_bytes);
+bool dcd_edpt_xfer        (uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint32_t total_bytes);
+
+// Submit segments as a single transfer (optional). Return false if controller cannot chain
+// these segments, usbd will then fall back to its bounce buffer.
+TU_ATTR_WEAK bool dcd_edpt_xfer_sg(uint8_t rhport, uint8_t ep_addr, xfer_seg_t const * segs, uint8_t count);
+
+// Submit a transfer on a busy endpoint behind the ones in progress (optional), so that controller
+// moves on without waiting for the isr. Completion is reported for each transfer in order.
+TU_ATTR_WEAK bool dcd_edpt_xfer_append(uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint32_t total_bytes);
+
+// Close endpoint (optional) when its alternate setting is left, transfer in progress is dropped without
+// completion. Without it endpoint stays configured until opened again with the next alternate setting.
+TU_ATTR_WEAK void dcd_edpt_close(uint8_t rhport, uint8_t ep_addr);
+
+// Append a zero-length packet to every IN transfer ending with a full packet on opened endpoint (optional),
+// until it is opened again. Return false if not supported, usbd then sends it.
+TU_ATTR_WEAK bool dcd_edpt_auto_zlp(uint8_t rhport, uint8_t ep_addr);
 
 // Stall endpoint
 void dcd_edpt_stall       (uint8_t rhport, uint8_t ep_addr);
@@ -138,6 +197,13 @@ extern void dcd_event_setup_received(uint8_t rhport, uint8_t const * setup, bool
 // helper to send transfer complete event
 extern void dcd_event_xfer_complete (uint8_t rhport, uint8_t ep_addr, uint32_t xferred_bytes, uint8_t result, bool in_isr);
 
+// helper to send L1 sleep event once LPM token is acknowledged, exit is DCD_EVENT_LPM_RESUME bus signal
+extern void dcd_event_lpm_sleep (uint8_t rhport, uint8_t besl, bool remote_wakeup, bool in_isr);
+
+// Called once at the end of an interrupt handler of DCD, RTOS switches to the usbd task woken by its events.
+// tud_isr() does it for dcd_isr(), only ports implementing the interrupt vector themselves need to
+extern void dcd_event_isr_exit(uint8_t rhport);
+
 #ifdef __cplusplus
  }
 #endif
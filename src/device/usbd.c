@@ -37,9 +37,89 @@
 #define CFG_TUD_TASK_QUEUE_SZ   16
 #endif
 
+// Size of high priority event queue for bus events, SETUP and control endpoint transfers,
+// which tud_task always drains before data events. 0 to use a single queue for all events.
+#ifndef CFG_TUD_TASK_PRIO_QUEUE_SZ
+#define CFG_TUD_TASK_PRIO_QUEUE_SZ  0
+#endif
+
+// Size of ring for usbd_defer_func() calls, which tud_task drains first. Deferred calls then
+// never compete with transfer events for queue slots. 0 to queue them as events.
+#ifndef CFG_TUD_TASK_DEFER_QUEUE_SZ
+#define CFG_TUD_TASK_DEFER_QUEUE_SZ  0
+#endif
+
+// Coalesce repeated events before they reach the queue: duplicated SUSPEND/RESUME are dropped
+// and transfer completions are kept per endpoint with a single pending event for all of them,
+// so that a small event queue does not overflow during bursts.
+#ifndef CFG_TUD_TASK_EVENT_COALESCE
+#define CFG_TUD_TASK_EVENT_COALESCE  0
+#endif
+
+// Number of transfers can be queued per endpoint while it is busy, 0 to disable.
+// Queued transfer is submitted to DCD as soon as the previous one completes (in ISR)
+// without waiting for tud_task to process the completion.
+#ifndef CFG_TUD_EDPT_XFER_QUEUE
+#define CFG_TUD_EDPT_XFER_QUEUE  0
+#endif
+
+// Size of bounce buffer used by usbd_edpt_xfer_sg() when DCD cannot chain the segments itself.
+// Only one such transfer can be in progress at a time. 0 to disable the fallback.
+#ifndef CFG_TUD_EDPT_XFER_SG_BUFSIZE
+#define CFG_TUD_EDPT_XFER_SG_BUFSIZE  0
+#endif
+
+// Timestamp passed to tud_sof_isr_cb(), default to DWT cycle counter on Cortex-M3 and up
+// (application must enable it with DEMCR.TRCENA and DWT_CTRL.CYCCNTENA)
+#ifndef CFG_TUD_SOF_TIMESTAMP
+  #if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__) || defined(__ARM_ARCH_8M_MAIN__)
+    #define CFG_TUD_SOF_TIMESTAMP()  (*(volatile uint32_t const*) 0xE0001004UL)
+  #else
+    #define CFG_TUD_SOF_TIMESTAMP()  0
+  #endif
+#endif
+
+// Time source of tud_task_budget(), in unit of its max_time e.g a microsecond timer. Default cycle counter
+// (if any) counts cpu cycles, time budget is ignored if it is 0
+#ifndef CFG_TUD_TASK_TIMESTAMP
+  #define CFG_TUD_TASK_TIMESTAMP()  CFG_TUD_SOF_TIMESTAMP()
+#endif
+
+// Time source of transfer statistics (CFG_TUD_STATS)
+#ifndef CFG_TUD_STATS_TIMESTAMP
+  #define CFG_TUD_STATS_TIMESTAMP()  CFG_TUD_SOF_TIMESTAMP()
+#endif
+
+// Time source of enumeration profile (CFG_TUD_ENUM_PROFILE). Enumeration takes up to a few 100 ms,
+// counter must not wrap meanwhile e.g board_millis() or a cycle counter below 10 GHz
+#ifndef CFG_TUD_PROFILE_TIMESTAMP
+  #define CFG_TUD_PROFILE_TIMESTAMP()  CFG_TUD_STATS_TIMESTAMP()
+#endif
+
 //--------------------------------------------------------------------+
 // Device Data
 //--------------------------------------------------------------------+
+
+#if CFG_TUD_EDPT_XFER_QUEUE
+typedef struct
+{
+  uint8_t* buffer;
+  uint32_t total_bytes;
+}usbd_xfer_t;
+
+typedef struct
+{
+  usbd_xfer_t xfer[CFG_TUD_EDPT_XFER_QUEUE];
+  uint8_t rd_idx;
+  uint8_t count;
+
+  // number of queued transfers submitted in ISR, whose previous completion
+  // is not yet processed by tud_task
+  uint8_t chained;
+}usbd_xfer_queue_t;
+#endif
+
+
 typedef struct {
   struct TU_ATTR_PACKED
   {
@@ -50,21 +130,237 @@ typedef struct {
     uint8_t remote_wakeup_en      : 1; // enable/disable by host
     uint8_t remote_wakeup_support : 1; // configuration descriptor's attribute
     uint8_t self_powered          : 1; // configuration descriptor's attribute
+
+    volatile uint8_t lpm_sleep    : 1; // link in L1
+    uint8_t lpm_remote_wakeup     : 1; // bRemoteWake of LPM token
   };
 
   uint8_t itf2drv[16];     // map interface number to driver (0xff is invalid)
   uint8_t ep2drv[8][2];    // map endpoint to driver ( 0xff is invalid )
 
+  uint8_t itf2inst[16];    // map interface number to driver's instance (0xff is invalid)
+  uint8_t ep2inst[8][2];   // map endpoint to driver's instance (0xff is invalid)
+
+  uint16_t itf_alt_support; // bitmap of interfaces having alternate settings, handled by their driver
+  uint8_t  itf_alt[16];     // current alternate setting, when driver has set_alt
+  uint8_t  cfg_num;         // current configuration, its descriptor is parsed again by SET_INTERFACE
+
+  volatile bool sof_pending; // SOF event is queued but not yet processed
+  volatile uint16_t sof_count; // SOF events signalled by DCD, frame number when DCD can't read it
+
   struct TU_ATTR_PACKED
   {
     volatile bool busy    : 1;
     volatile bool stalled : 1;
+    volatile bool zlp     : 1; // ZLP ending the IN transfer is in progress, its completion is held
 
     // TODO merge ep2drv here, 4-bit should be sufficient
   }ep_status[8][2];
+
+  // IN endpoints whose transfers are ended by ZLP sent by usbd (usbd_edpt_zlp)
+  uint16_t zlp_mps[8]; // packet size, 0 if not enabled or sent by controller
+  uint32_t zlp_len[8]; // length of the transfer ended by ZLP in progress
+
+#if CFG_TUD_EDPT_XFER_QUEUE
+  usbd_xfer_queue_t xfer_q[8][2]; // endpoint 0 is not queued
+#endif
+
+#if CFG_TUD_DESC_ASYNC
+  tusb_control_request_t desc_request; // GET_DESCRIPTOR waiting for tud_descriptor_reply()
+  volatile bool desc_pending;
+  void const* volatile desc_reply;
+#endif
 }usbd_device_t;
 
-static usbd_device_t _usbd_dev;
+static usbd_device_t _usbd_dev[TUD_OPT_RHPORT_COUNT];
+
+#if CFG_TUD_FAST_RESET
+// Configuration kept over bus reset, its drivers are not reset until host selects another one
+typedef struct
+{
+  uint8_t  cfg_num; // 0 if none is kept
+  uint16_t itf_alt_support;
+
+  uint8_t itf2drv[16];
+  uint8_t ep2drv[8][2];
+  uint8_t itf2inst[16];
+  uint8_t ep2inst[8][2];
+}usbd_kept_config_t;
+
+static usbd_kept_config_t _usbd_kept[TUD_OPT_RHPORT_COUNT];
+#endif
+
+#if CFG_TUD_STATS
+typedef struct
+{
+  tud_stats_t stats;
+
+  uint32_t xfer_len;   // requested bytes of transfer in progress
+  uint32_t xfer_start; // timestamp of its submission
+  uint32_t isr_time;   // timestamp of its completion in ISR
+}usbd_stats_t;
+
+// Updated in ISR for submission and completion, tud_task for callback
+static usbd_stats_t _usbd_stats[TUD_OPT_RHPORT_COUNT][8][2];
+
+static inline usbd_stats_t* get_stats(uint8_t rhport, uint8_t ep_addr)
+{
+  return &_usbd_stats[USBD_RHPORT_IDX(rhport)][tu_edpt_number(ep_addr)][tu_edpt_dir(ep_addr)];
+}
+
+static void stats_xfer_submit(uint8_t rhport, uint8_t ep_addr, uint32_t total_bytes)
+{
+  usbd_stats_t* st = get_stats(rhport, ep_addr);
+  st->xfer_len   = total_bytes;
+  st->xfer_start = CFG_TUD_STATS_TIMESTAMP();
+}
+
+static TU_ATTR_FAST_FUNC void stats_xfer_complete_isr(dcd_event_t const * event)
+{
+  usbd_stats_t* st = get_stats(event->rhport, event->xfer_complete.ep_addr);
+  uint32_t const now = CFG_TUD_STATS_TIMESTAMP();
+  uint32_t const elapsed = now - st->xfer_start;
+
+  st->isr_time = now;
+
+  st->stats.xfer_count++;
+  st->stats.bytes += event->xfer_complete.len;
+  if ( event->xfer_complete.len < st->xfer_len ) st->stats.short_count++;
+
+  if ( event->xfer_complete.result == XFER_RESULT_FAILED  ) st->stats.error_count++;
+  if ( event->xfer_complete.result == XFER_RESULT_STALLED ) st->stats.stall_count++;
+
+  st->stats.xfer_time_sum += elapsed;
+  if ( elapsed > st->stats.xfer_time_max ) st->stats.xfer_time_max = elapsed;
+}
+
+static void stats_xfer_callback(uint8_t rhport, uint8_t ep_addr)
+{
+  usbd_stats_t* st = get_stats(rhport, ep_addr);
+  uint32_t const elapsed = CFG_TUD_STATS_TIMESTAMP() - st->isr_time;
+
+  st->stats.cb_count++;
+  st->stats.cb_time_sum += elapsed;
+  if ( elapsed > st->stats.cb_time_max ) st->stats.cb_time_max = elapsed;
+}
+#else
+  #define stats_xfer_submit(_rhport, _ep_addr, _len)  do {} while (0)
+  #define stats_xfer_complete_isr(_event)             do {} while (0)
+  #define stats_xfer_callback(_rhport, _ep_addr)      do {} while (0)
+#endif
+
+#if CFG_TUD_ENUM_PROFILE
+typedef struct
+{
+  tud_enum_profile_t enum_profile;
+  tud_req_profile_t  req[TUD_REQ_PROFILE_COUNT];
+
+  uint8_t  req_idx;    // of control transfer in progress
+  uint32_t start;      // timestamp of handling in progress
+}usbd_profile_t;
+
+// Milestones of bus reset and SETUP are taken in ISR, others in tud_task
+static usbd_profile_t _usbd_profile[TUD_OPT_RHPORT_COUNT];
+
+static void profile_bus_reset_isr(uint8_t rhport)
+{
+  tud_enum_profile_t* ep = &_usbd_profile[USBD_RHPORT_IDX(rhport)].enum_profile;
+  ep->bus_reset = CFG_TUD_PROFILE_TIMESTAMP();
+  ep->reached   = TUD_ENUM_BUS_RESET;
+}
+
+static void profile_milestone(uint8_t rhport, uint8_t milestone)
+{
+  tud_enum_profile_t* ep = &_usbd_profile[USBD_RHPORT_IDX(rhport)].enum_profile;
+  if ( ep->reached & milestone ) return;
+
+  uint32_t const elapsed = CFG_TUD_PROFILE_TIMESTAMP() - ep->bus_reset;
+
+  switch (milestone)
+  {
+    case TUD_ENUM_FIRST_SETUP: ep->first_setup = elapsed; break;
+    case TUD_ENUM_SET_ADDRESS: ep->set_address = elapsed; break;
+    case TUD_ENUM_SET_CONFIG : ep->set_config  = elapsed; break;
+    default: return;
+  }
+
+  ep->reached |= milestone;
+}
+
+static void profile_setup_begin(uint8_t rhport, tusb_control_request_t const * request)
+{
+  usbd_profile_t* pf = &_usbd_profile[USBD_RHPORT_IDX(rhport)];
+
+  switch ( request->bmRequestType_bit.type )
+  {
+    case TUSB_REQ_TYPE_STANDARD:
+      pf->req_idx = (request->bRequest <= TUSB_REQ_SYNCH_FRAME) ? request->bRequest : TUD_REQ_PROFILE_COUNT;
+    break;
+
+    case TUSB_REQ_TYPE_CLASS : pf->req_idx = TUD_REQ_PROFILE_CLASS ; break;
+    case TUSB_REQ_TYPE_VENDOR: pf->req_idx = TUD_REQ_PROFILE_VENDOR; break;
+    default                  : pf->req_idx = TUD_REQ_PROFILE_COUNT ; break;
+  }
+
+  pf->start = CFG_TUD_PROFILE_TIMESTAMP();
+}
+
+static void profile_setup_end(uint8_t rhport)
+{
+  usbd_profile_t* pf = &_usbd_profile[USBD_RHPORT_IDX(rhport)];
+  if ( pf->req_idx >= TUD_REQ_PROFILE_COUNT ) return;
+
+  uint32_t const elapsed = CFG_TUD_PROFILE_TIMESTAMP() - pf->start;
+  tud_req_profile_t* req = &pf->req[pf->req_idx];
+
+  req->count++;
+  req->setup_sum += elapsed;
+  if ( elapsed > req->setup_max ) req->setup_max = elapsed;
+}
+
+static void profile_xfer_begin(uint8_t rhport)
+{
+  _usbd_profile[USBD_RHPORT_IDX(rhport)].start = CFG_TUD_PROFILE_TIMESTAMP();
+}
+
+static void profile_xfer_end(uint8_t rhport)
+{
+  usbd_profile_t* pf = &_usbd_profile[USBD_RHPORT_IDX(rhport)];
+  if ( pf->req_idx >= TUD_REQ_PROFILE_COUNT ) return;
+
+  uint32_t const elapsed = CFG_TUD_PROFILE_TIMESTAMP() - pf->start;
+  tud_req_profile_t* req = &pf->req[pf->req_idx];
+
+  req->xfer_sum += elapsed;
+  if ( elapsed > req->xfer_max ) req->xfer_max = elapsed;
+}
+#else
+  #define profile_bus_reset_isr(_rhport)              do {} while (0)
+  #define profile_milestone(_rhport, _milestone)      do {} while (0)
+  #define profile_setup_begin(_rhport, _request)      do {} while (0)
+  #define profile_setup_end(_rhport)                  do {} while (0)
+  #define profile_xfer_begin(_rhport)                 do {} while (0)
+  #define profile_xfer_end(_rhport)                   do {} while (0)
+#endif
+
+static inline usbd_device_t* get_device(uint8_t rhport)
+{
+  return &_usbd_dev[USBD_RHPORT_IDX(rhport)];
+}
+
+#if CFG_TUD_EDPT_XFER_SG_BUFSIZE
+// Scatter-gather transfer using the bounce buffer
+typedef struct
+{
+  xfer_seg_t const * segs; // NULL if bounce buffer is free
+  uint8_t count;
+  uint8_t rhport;
+  uint8_t ep_addr;
+}usbd_sg_bounce_t;
+
+static usbd_sg_bounce_t _usbd_sg;
+CFG_TUSB_MEM_SECTION CFG_TUSB_MEM_ALIGN static uint8_t _usbd_sg_buf[CFG_TUD_EDPT_XFER_SG_BUFSIZE];
+#endif
 
 // Invalid driver ID in itf2drv[] ep2drv[][] mapping
 enum { DRVID_INVALID = 0xFFu };
@@ -72,21 +368,10 @@ enum { DRVID_INVALID = 0xFFu };
 //--------------------------------------------------------------------+
 // Class Driver
 //--------------------------------------------------------------------+
-typedef struct {
-  uint8_t class_code;
-
-  void (* init             ) (void);
-  void (* reset            ) (uint8_t rhport);
-  bool (* open             ) (uint8_t rhport, tusb_desc_interface_t const * desc_intf, uint16_t* p_length);
-  bool (* control_request  ) (uint8_t rhport, tusb_control_request_t const * request);
-  bool (* control_complete ) (uint8_t rhport, tusb_control_request_t const * request);
-  bool (* xfer_cb          ) (uint8_t rhport, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes);
-  void (* sof              ) (uint8_t rhport);
-} usbd_class_driver_t;
-
 static usbd_class_driver_t const usbd_class_drivers[] =
 {
   #if CFG_TUD_CDC
+  [TUD_DRIVER_CDC] =
   {
       .class_code       = TUSB_CLASS_CDC,
       .init             = cdcd_init,
@@ -95,11 +380,23 @@ static usbd_class_driver_t const usbd_class_drivers[] =
       .control_request  = cdcd_control_request,
       .control_complete = cdcd_control_complete,
       .xfer_cb          = cdcd_xfer_cb,
-      .sof              = NULL
+    #if CFG_TUD_CDC_TX_FLUSH_FRAMES
+      .sof              = cdcd_sof,
+    #else
+      .sof              = NULL,
+    #endif
+      .xfer_isr_cb      = NULL,
+    #if CFG_TUD_SPLIT_CORE
+      .doorbell         = cdcd_doorbell,
+    #endif
+    #if CFG_TUD_FAST_RESET
+      .reopen           = cdcd_reopen,
+    #endif
   },
   #endif
 
   #if CFG_TUD_MSC
+  [TUD_DRIVER_MSC] =
   {
       .class_code       = TUSB_CLASS_MSC,
       .init             = mscd_init,
@@ -108,11 +405,31 @@ static usbd_class_driver_t const usbd_class_drivers[] =
       .control_request  = mscd_control_request,
       .control_complete = mscd_control_complete,
       .xfer_cb          = mscd_xfer_cb,
-      .sof              = NULL
+      .sof              = NULL,
+      .xfer_isr_cb      = NULL,
+    #if CFG_TUD_SPLIT_CORE
+      .doorbell         = mscd_doorbell,
+    #endif
+  },
+  #endif
+
+  #if CFG_TUD_UAS
+  [TUD_DRIVER_UAS] =
+  {
+      .class_code       = TUSB_CLASS_MSC,
+      .init             = uasd_init,
+      .reset            = uasd_reset,
+      .open             = uasd_open,
+      .control_request  = uasd_control_request,
+      .control_complete = uasd_control_complete,
+      .xfer_cb          = uasd_xfer_cb,
+      .sof              = NULL,
+      .xfer_isr_cb      = NULL
   },
   #endif
 
   #if CFG_TUD_HID
+  [TUD_DRIVER_HID] =
   {
       .class_code       = TUSB_CLASS_HID,
       .init             = hidd_init,
@@ -121,11 +438,33 @@ static usbd_class_driver_t const usbd_class_drivers[] =
       .control_request  = hidd_control_request,
       .control_complete = hidd_control_complete,
       .xfer_cb          = hidd_xfer_cb,
-      .sof              = NULL
+    #if CFG_TUD_HID_IDLE_REPEAT
+      .sof              = hidd_sof,
+    #else
+      .sof              = NULL,
+    #endif
+      .xfer_isr_cb      = NULL
+  },
+  #endif
+
+  // must be before MIDI which takes any audio control interface
+  #if CFG_TUD_AUDIO
+  [TUD_DRIVER_AUDIO] =
+  {
+      .class_code       = TUSB_CLASS_AUDIO,
+      .init             = audiod_init,
+      .reset            = audiod_reset,
+      .open             = audiod_open,
+      .control_request  = audiod_control_request,
+      .control_complete = audiod_control_complete,
+      .xfer_cb          = audiod_xfer_cb,
+      .sof              = audiod_sof,
+      .xfer_isr_cb      = audiod_xfer_isr_cb
   },
   #endif
 
   #if CFG_TUD_MIDI
+  [TUD_DRIVER_MIDI] =
   {
       .class_code       = TUSB_CLASS_AUDIO,
       .init             = midid_init,
@@ -134,11 +473,32 @@ static usbd_class_driver_t const usbd_class_drivers[] =
       .control_request  = midid_control_request,
       .control_complete = midid_control_complete,
       .xfer_cb          = midid_xfer_cb,
-      .sof              = NULL
+    #if CFG_TUD_MIDI_SCHED_QUEUE
+      .sof              = midid_sof,
+    #else
+      .sof              = NULL,
+    #endif
+      .xfer_isr_cb      = NULL
+  },
+  #endif
+
+  #if CFG_TUD_VIDEO
+  [TUD_DRIVER_VIDEO] =
+  {
+      .class_code       = TUSB_CLASS_VIDEO,
+      .init             = videod_init,
+      .reset            = videod_reset,
+      .open             = videod_open,
+      .control_request  = videod_control_request,
+      .control_complete = videod_control_complete,
+      .xfer_cb          = videod_xfer_cb,
+      .sof              = NULL,
+      .xfer_isr_cb      = videod_xfer_isr_cb
   },
   #endif
 
   #if CFG_TUD_VENDOR
+  [TUD_DRIVER_VENDOR] =
   {
       .class_code       = TUSB_CLASS_VENDOR_SPECIFIC,
       .init             = vendord_init,
@@ -147,7 +507,11 @@ static usbd_class_driver_t const usbd_class_drivers[] =
       .control_request  = tud_vendor_control_request_cb,
       .control_complete = tud_vendor_control_complete_cb,
       .xfer_cb          = vendord_xfer_cb,
-      .sof              = NULL
+      .sof              = NULL,
+      .xfer_isr_cb      = NULL,
+    #if CFG_TUD_SPLIT_CORE
+      .doorbell         = vendord_doorbell,
+    #endif
   },
   #endif
 
@@ -155,6 +519,7 @@ static usbd_class_driver_t const usbd_class_drivers[] =
   // Presently USBTMC is the only defined class with the APP_SPECIFIC class code.
   // We maybe need to add subclass codes here, or a callback to ask if a driver can
   // handle a particular interface.
+  [TUD_DRIVER_USBTMC] =
   {
       .class_code       = TUD_USBTMC_APP_CLASS,
     //.subclass_code    = TUD_USBTMC_APP_SUBCLASS
@@ -164,11 +529,13 @@ static usbd_class_driver_t const usbd_class_drivers[] =
       .control_request  = usbtmcd_control_request_cb,
       .control_complete = usbtmcd_control_complete_cb,
       .xfer_cb          = usbtmcd_xfer_cb,
-      .sof              = NULL
+      .sof              = NULL,
+      .xfer_isr_cb      = usbtmcd_xfer_isr_cb
   },
   #endif
 
   #if CFG_TUD_DFU_RT
+  [TUD_DRIVER_DFU_RT] =
   {
       .class_code       = TUD_DFU_APP_CLASS,
     //.subclass_code    = TUD_DFU_APP_SUBCLASS
@@ -178,12 +545,115 @@ static usbd_class_driver_t const usbd_class_drivers[] =
       .control_request  = dfu_rtd_control_request,
       .control_complete = dfu_rtd_control_complete,
       .xfer_cb          = dfu_rtd_xfer_cb,
-      .sof              = NULL
+      .sof              = NULL,
+      .xfer_isr_cb      = NULL
+  },
+  #endif
+
+  #if CFG_TUD_DFU
+  [TUD_DRIVER_DFU] =
+  {
+      .class_code       = TUD_DFU_APP_CLASS,
+      .init             = dfud_init,
+      .reset            = dfud_reset,
+      .open             = dfud_open,
+      .control_request  = dfud_control_request,
+      .control_complete = dfud_control_complete,
+      .xfer_cb          = dfud_xfer_cb,
+      .sof              = NULL,
+      .xfer_isr_cb      = NULL
+  },
+  #endif
+
+  #if CFG_TUD_NCM
+  [TUD_DRIVER_NCM] =
+  {
+      .class_code       = TUSB_CLASS_CDC,
+      .init             = ncmd_init,
+      .reset            = ncmd_reset,
+      .open             = ncmd_open,
+      .control_request  = ncmd_control_request,
+      .control_complete = ncmd_control_complete,
+      .xfer_cb          = ncmd_xfer_cb,
+      .sof              = NULL,
+      .xfer_isr_cb      = NULL
+  },
+  #endif
+
+  #if CFG_TUD_RNDIS
+  [TUD_DRIVER_RNDIS] =
+  {
+      .class_code       = TUSB_CLASS_WIRELESS_CONTROLLER,
+      .init             = rndisd_init,
+      .reset            = rndisd_reset,
+      .open             = rndisd_open,
+      .control_request  = rndisd_control_request,
+      .control_complete = rndisd_control_complete,
+      .xfer_cb          = rndisd_xfer_cb,
+      .sof              = NULL,
+      .xfer_isr_cb      = NULL
+  },
+  #endif
+
+  #if CFG_TUD_BTH
+  [TUD_DRIVER_BTH] =
+  {
+      .class_code       = TUD_BT_APP_CLASS,
+      .init             = btd_init,
+      .reset            = btd_reset,
+      .open             = btd_open,
+      .control_request  = btd_control_request,
+      .control_complete = btd_control_complete,
+      .xfer_cb          = btd_xfer_cb,
+      .sof              = NULL,
+      .xfer_isr_cb      = NULL,
+      .set_alt          = btd_set_alt
+  },
+  #endif
+
+  #if CFG_TUD_PRINTER
+  [TUD_DRIVER_PRINTER] =
+  {
+      .class_code       = TUSB_CLASS_PRINTER,
+      .init             = printerd_init,
+      .reset            = printerd_reset,
+      .open             = printerd_open,
+      .control_request  = printerd_control_request,
+      .control_complete = NULL,
+      .xfer_cb          = printerd_xfer_cb,
+      .sof              = NULL,
+      .xfer_isr_cb      = NULL
   },
   #endif
 };
 
 enum { USBD_CLASS_DRIVER_COUNT = TU_ARRAY_SIZE(usbd_class_drivers) };
+TU_VERIFY_STATIC((int) USBD_CLASS_DRIVER_COUNT == (int) TUD_DRIVER_COUNT, "driver table does not match TUD_DRIVER_*");
+
+// Additional class drivers supplied by application via usbd_app_driver_get_cb()
+static usbd_class_driver_t const * _app_driver = NULL;
+static uint8_t _app_driver_count = 0;
+
+// Drivers needing SOF now, see usbd_sof_enable(). SOF is only queued to usbd task while non zero
+static uint8_t _usbd_sof_users[TUD_OPT_RHPORT_COUNT];
+
+// Application drivers handling SOF don't request it, they get it all the time
+static bool _usbd_sof_app = false;
+
+// SOF interrupt is kept enabled for tud_sof_isr_cb() and for frame counting without dcd_frame_number()
+static inline bool sof_always(void)
+{
+  return _usbd_sof_app || tud_sof_isr_cb || !dcd_frame_number;
+}
+
+// Driver ID: application drivers first, followed by built-in ones
+#define TOTAL_DRIVER_COUNT    (_app_driver_count + USBD_CLASS_DRIVER_COUNT)
+
+static inline usbd_class_driver_t const * get_driver(uint8_t drvid)
+{
+  if ( drvid < _app_driver_count ) return &_app_driver[drvid];
+  return &usbd_class_drivers[drvid - _app_driver_count];
+}
 
 //--------------------------------------------------------------------+
 // DCD Event
@@ -194,17 +664,81 @@ enum { USBD_CLASS_DRIVER_COUNT = TU_ARRAY_SIZE(usbd_class_drivers) };
 OSAL_QUEUE_DEF(OPT_MODE_DEVICE, _usbd_qdef, CFG_TUD_TASK_QUEUE_SZ, dcd_event_t);
 static osal_queue_t _usbd_q;
 
+#if CFG_TUD_TASK_EVENT_COALESCE
+typedef struct
+{
+  uint32_t len;
+  uint8_t  result;
+}usbd_xfer_pending_t;
+
+typedef struct
+{
+  volatile uint16_t xfer_bitmap;   // bit (epnum*2 + dir) set if completion is stored in xfer[][]
+  volatile bool     xfer_event;    // USBD_EVENT_XFER_PENDING is in queue
+  volatile bool     suspend;       // SUSPEND is in queue
+  volatile bool     resume;        // RESUME is in queue
+
+  usbd_xfer_pending_t xfer[8][2];
+}usbd_coalesce_t;
+
+static usbd_coalesce_t _usbd_coalesce[TUD_OPT_RHPORT_COUNT];
+#endif
+
+#if CFG_TUD_TASK_PRIO_QUEUE_SZ
+// Priority events are written by dcd isr (or with usb interrupt disabled) and read by
+// tud_task only, the lock-free fifo needs no mutex. A dummy event is also posted to
+// _usbd_q when an RTOS is used to wake up tud_task blocked on it.
+static dcd_event_t _usbd_prio_buf[TUD_OPT_RHPORT_COUNT][CFG_TUD_TASK_PRIO_QUEUE_SZ];
+static tu_fifo_t   _usbd_prio_ff[TUD_OPT_RHPORT_COUNT];
+#endif
+
+#if CFG_TUD_TASK_DEFER_QUEUE_SZ
+typedef struct
+{
+  osal_task_func_t func;
+  void* param;
+}usbd_defer_t;
+
+// Written by dcd isr (or with usb interrupt disabled) and read by tud_task only
+static usbd_defer_t _usbd_defer_buf[CFG_TUD_TASK_DEFER_QUEUE_SZ];
+static tu_fifo_t    _usbd_defer_ff;
+#endif
+
+#if CFG_TUD_EP_POOL_COUNT
+TU_VERIFY_STATIC(CFG_TUD_EP_POOL_BUFSIZE % 4 == 0, "CFG_TUD_EP_POOL_BUFSIZE must be multiple of 4");
+TU_VERIFY_STATIC(CFG_TUD_EP_POOL_COUNT <= UINT8_MAX, "pool buffer is indexed by uint8_t");
+
+// Free buffers are a stack of indices, alloc and free are O(1)
+CFG_TUSB_MEM_DMA_SECTION CFG_TUSB_MEM_DMA_ALIGN static uint8_t _usbd_pool_buf[CFG_TUD_EP_POOL_COUNT][CFG_TUD_EP_POOL_BUFSIZE];
+static uint8_t _usbd_pool_free[CFG_TUD_EP_POOL_COUNT];
+static uint8_t _usbd_pool_free_count;
+
+#if CFG_FIFO_MUTEX
+static osal_mutex_def_t _usbd_pool_mutex_def;
+static osal_mutex_t     _usbd_pool_mutex;
+#endif
+#endif
+
 //--------------------------------------------------------------------+
 // Prototypes
 //--------------------------------------------------------------------+
-static void mark_interface_endpoint(uint8_t ep2drv[8][2], uint8_t const* p_desc, uint16_t desc_len, uint8_t driver_id);
+static void mark_interface_endpoint(usbd_device_t* p_dev, uint8_t const* p_desc, uint16_t desc_len, uint8_t driver_id, uint8_t inst);
+static bool open_mapped_config(uint8_t rhport, tusb_desc_configuration_t const * desc_cfg, tud_config_map_t const* map);
+static bool edpt_xfer_complete(uint8_t rhport, uint8_t ep_addr);
+static void edpt_xfer_sg_complete(uint8_t rhport, uint8_t ep_addr, uint32_t xferred_bytes);
+static void process_xfer_complete(uint8_t rhport, uint8_t ep_addr, uint8_t result, uint32_t xferred_bytes);
+static void process_xfer_pending(uint8_t rhport);
 static bool process_control_request(uint8_t rhport, tusb_control_request_t const * p_request);
 static bool process_set_config(uint8_t rhport, uint8_t cfg_num);
+static bool process_set_interface(uint8_t rhport, uint8_t itf, uint8_t alt);
+#if CFG_TUD_FAST_RESET
+static bool reopen_config(uint8_t rhport, tusb_desc_configuration_t const * desc_cfg);
+#endif
 static bool process_get_descriptor(uint8_t rhport, tusb_control_request_t const * p_request);
 
 void usbd_control_reset (uint8_t rhport);
 bool usbd_control_xfer_cb (uint8_t rhport, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes);
-void usbd_control_set_complete_callback( bool (*fp) (uint8_t, tusb_control_request_t const * ) );
+void usbd_control_set_complete_callback(uint8_t rhport, bool (*fp) (uint8_t, tusb_control_request_t const * ) );
 
 
 //--------------------------------------------------------------------+
@@ -219,9 +753,12 @@ static char const* const _usbd_event_str[DCD_EVENT_COUNT] =
   "SOF"            ,
   "SUSPEND"        ,
   "RESUME"         ,
+  "LPM_SLEEP"      ,
+  "LPM_RESUME"     ,
   "SETUP_RECEIVED" ,
   "XFER_COMPLETE"  ,
-  "FUNC_CALL"
+  "FUNC_CALL"      ,
+  "XFER_PENDING"
 };
 
 // must be same driver order as usbd_class_drivers[]
@@ -233,20 +770,52 @@ static char const* const _usbd_driver_str[USBD_CLASS_DRIVER_COUNT] =
   #if CFG_TUD_MSC
     "MSC",
   #endif
+  #if CFG_TUD_UAS
+    "UAS",
+  #endif
   #if CFG_TUD_HID
     "HID",
   #endif
+  #if CFG_TUD_AUDIO
+    "Audio",
+  #endif
   #if CFG_TUD_MIDI
     "MIDI",
   #endif
+  #if CFG_TUD_VIDEO
+    "Video",
+  #endif
   #if CFG_TUD_VENDOR
     "Vendor",
   #endif
   #if CFG_TUD_USBTMC
-    "USBTMC"
+    "USBTMC",
+  #endif
+  #if CFG_TUD_DFU_RT
+    "DFU-RT",
+  #endif
+  #if CFG_TUD_DFU
+    "DFU",
+  #endif
+  #if CFG_TUD_NCM
+    "NCM",
+  #endif
+  #if CFG_TUD_RNDIS
+    "RNDIS",
+  #endif
+  #if CFG_TUD_BTH
+    "BTH",
+  #endif
+  #if CFG_TUD_PRINTER
+    "Printer",
   #endif
 };
 
+static char const* get_driver_name(uint8_t drvid)
+{
+  return (drvid < _app_driver_count) ? "App" : _usbd_driver_str[drvid - _app_driver_count];
+}
+
 static char const* const _tusb_std_request_str[] =
 {
   "Get Status"        ,
@@ -269,24 +838,39 @@ static char const* const _tusb_std_request_str[] =
 //--------------------------------------------------------------------+
 // Application API
 //--------------------------------------------------------------------+
-bool tud_mounted(void)
+bool tud_n_mounted(uint8_t rhport)
+{
+  return get_device(rhport)->configured;
+}
+
+bool tud_n_suspended(uint8_t rhport)
 {
-  return _usbd_dev.configured;
+  return get_device(rhport)->suspended;
 }
 
-bool tud_suspended(void)
+uint32_t tud_n_frame_number(uint8_t rhport)
 {
-  return _usbd_dev.suspended;
+  if ( dcd_frame_number ) return dcd_frame_number(rhport);
+  return get_device(rhport)->sof_count & 0x7ffu;
 }
 
-bool tud_remote_wakeup(void)
+bool tud_n_remote_wakeup(uint8_t rhport)
 {
-  // only wake up host if this feature is supported and enabled and we are suspended
-  TU_VERIFY (_usbd_dev.suspended && _usbd_dev.remote_wakeup_support && _usbd_dev.remote_wakeup_en );
-  dcd_remote_wakeup(TUD_OPT_RHPORT);
+  usbd_device_t const* p_dev = get_device(rhport);
+
+  // only wake up host if this feature is supported and enabled and we are suspended,
+  // L1 remote wakeup is allowed by the LPM token itself
+  TU_VERIFY ( (p_dev->suspended && p_dev->remote_wakeup_support && p_dev->remote_wakeup_en) ||
+              (p_dev->lpm_sleep && p_dev->lpm_remote_wakeup) );
+  dcd_remote_wakeup(rhport);
   return true;
 }
 
+bool tud_n_lpm_sleeping(uint8_t rhport)
+{
+  return get_device(rhport)->lpm_sleep;
+}
+
 //--------------------------------------------------------------------+
 // USBD Task
 //--------------------------------------------------------------------+
@@ -300,154 +884,558 @@ bool tud_init (void)
   _usbd_q = osal_queue_create(&_usbd_qdef);
   TU_ASSERT(_usbd_q != NULL);
 
+#if CFG_TUD_TASK_PRIO_QUEUE_SZ
+  for (uint8_t i = 0; i < TUD_OPT_RHPORT_COUNT; i++)
+  {
+    tu_fifo_config(&_usbd_prio_ff[i], _usbd_prio_buf[i], CFG_TUD_TASK_PRIO_QUEUE_SZ, sizeof(dcd_event_t), false);
+  }
+#endif
+
+#if CFG_TUD_TASK_DEFER_QUEUE_SZ
+  tu_fifo_config(&_usbd_defer_ff, _usbd_defer_buf, CFG_TUD_TASK_DEFER_QUEUE_SZ, sizeof(usbd_defer_t), false);
+#endif
+
+#if CFG_TUD_EP_POOL_COUNT
+  for (uint8_t i = 0; i < CFG_TUD_EP_POOL_COUNT; i++) _usbd_pool_free[i] = i;
+  _usbd_pool_free_count = CFG_TUD_EP_POOL_COUNT;
+
+  #if CFG_FIFO_MUTEX
+  _usbd_pool_mutex = osal_mutex_create(&_usbd_pool_mutex_def);
+  TU_ASSERT(_usbd_pool_mutex != NULL);
+  #endif
+#endif
+
+  // Get application class drivers, driver ID must fit in itf2drv[] ep2drv[][]
+  if ( usbd_app_driver_get_cb )
+  {
+    _app_driver = usbd_app_driver_get_cb(&_app_driver_count);
+    if ( _app_driver == NULL ) _app_driver_count = 0;
+    TU_ASSERT(TOTAL_DRIVER_COUNT < DRVID_INVALID);
+  }
+
   // Init class drivers
-  for (uint8_t i = 0; i < USBD_CLASS_DRIVER_COUNT; i++)
+  for (uint8_t i = 0; i < TOTAL_DRIVER_COUNT; i++)
   {
-    TU_LOG2("%s init\r\n", _usbd_driver_str[i]);
-    usbd_class_drivers[i].init();
+    TU_LOG2("%s init\r\n", get_driver_name(i));
+    if ( get_driver(i)->init ) get_driver(i)->init();
+    if ( i < _app_driver_count && get_driver(i)->sof ) _usbd_sof_app = true;
   }
 
-  // Init device controller driver
-  dcd_init(TUD_OPT_RHPORT);
-  dcd_int_enable(TUD_OPT_RHPORT);
+  // Init device controller driver of all device roothub ports
+  for (uint8_t rhport = 0; rhport < 2; rhport++)
+  {
+    if ( !TUD_OPT_RHPORT_IS_DEVICE(rhport) ) continue;
+
+    dcd_init(rhport);
+    if ( dcd_sof_enable && sof_always() ) dcd_sof_enable(rhport, true);
+    dcd_int_enable(rhport);
+  }
 
   return true;
 }
 
-static void usbd_reset(uint8_t rhport)
+// Device state only, class drivers are untouched
+static void device_reset(uint8_t rhport)
 {
-  tu_varclr(&_usbd_dev);
+  usbd_device_t* p_dev = get_device(rhport);
+
+  tu_varclr(p_dev);
+#if CFG_TUD_TASK_EVENT_COALESCE
+  // stored completions are stale, pending event (if any) will find nothing
+  dcd_int_disable(rhport);
+  _usbd_coalesce[USBD_RHPORT_IDX(rhport)].xfer_bitmap = 0;
+  dcd_int_enable(rhport);
+#endif
+
+  memset(p_dev->itf2drv , DRVID_INVALID, sizeof(p_dev->itf2drv )); // invalid mapping
+  memset(p_dev->ep2drv  , DRVID_INVALID, sizeof(p_dev->ep2drv  )); // invalid mapping
+  memset(p_dev->itf2inst, USBD_INST_INVALID, sizeof(p_dev->itf2inst)); // invalid mapping
+  memset(p_dev->ep2inst , USBD_INST_INVALID, sizeof(p_dev->ep2inst )); // invalid mapping
 
-  memset(_usbd_dev.itf2drv, DRVID_INVALID, sizeof(_usbd_dev.itf2drv)); // invalid mapping
-  memset(_usbd_dev.ep2drv , DRVID_INVALID, sizeof(_usbd_dev.ep2drv )); // invalid mapping
+#if CFG_TUD_EDPT_XFER_SG_BUFSIZE
+  if ( _usbd_sg.rhport == rhport ) tu_varclr(&_usbd_sg);
+#endif
 
   usbd_control_reset(rhport);
+}
 
-  for (uint8_t i = 0; i < USBD_CLASS_DRIVER_COUNT; i++)
+static void drivers_reset(uint8_t rhport)
+{
+  // drivers drop their SOF requests as well
+  uint8_t* sof_users = &_usbd_sof_users[USBD_RHPORT_IDX(rhport)];
+  if ( *sof_users )
   {
-    if ( usbd_class_drivers[i].reset ) usbd_class_drivers[i].reset( rhport );
+    dcd_int_disable(rhport);
+    *sof_users = 0;
+    if ( dcd_sof_enable && !sof_always() ) dcd_sof_enable(rhport, false);
+    dcd_int_enable(rhport);
   }
-}
 
-/* USB Device Driver task
- * This top level thread manages all device controller event and delegates events to class-specific drivers.
- * This should be called periodically within the mainloop or rtos thread.
- *
-   @code
-    int main(void)
-    {
-      application_init();
-      tusb_init();
+  for (uint8_t i = 0; i < TOTAL_DRIVER_COUNT; i++)
+  {
+    if ( get_driver(i)->reset ) get_driver(i)->reset( rhport );
+  }
+}
 
-      while(1) // the mainloop
-      {
-        application_code();
-        tud_task(); // tinyusb device task
-      }
-    }
-    @endcode
- */
-void tud_task (void)
+static void usbd_reset(uint8_t rhport)
 {
-  // Skip if stack is not initialized
-  if ( !tusb_inited() ) return;
+  device_reset(rhport);
+#if CFG_TUD_FAST_RESET
+  _usbd_kept[USBD_RHPORT_IDX(rhport)].cfg_num = 0;
+#endif
+  drivers_reset(rhport);
+}
 
-  // Loop until there is no more events in the queue
-  while (1)
+#if CFG_TUD_FAST_RESET
+static bool config_reopenable(usbd_device_t const* p_dev)
+{
+  for (uint8_t itf = 0; itf < TU_ARRAY_SIZE(p_dev->itf2drv); itf++)
   {
-    dcd_event_t event;
-
-    if ( !osal_queue_receive(_usbd_q, &event) ) return;
+    uint8_t const drv_id = p_dev->itf2drv[itf];
+    if ( drv_id != DRVID_INVALID && !get_driver(drv_id)->reopen ) return false;
+  }
+  return true;
+}
+#endif
 
-    TU_LOG2("USBD: event %s\r\n", event.event_id < DCD_EVENT_COUNT ? _usbd_event_str[event.event_id] : "CORRUPTED");
+// Host issues several resets while enumerating and after suspend. Configuration is kept over all
+// of them until host selects one
+static void usbd_bus_reset(uint8_t rhport)
+{
+#if CFG_TUD_FAST_RESET
+  usbd_device_t const* p_dev = get_device(rhport);
+  usbd_kept_config_t* kept = &_usbd_kept[USBD_RHPORT_IDX(rhport)];
 
-    switch ( event.event_id )
-    {
-      case DCD_EVENT_BUS_RESET:
-        usbd_reset(event.rhport);
-      break;
+  if ( p_dev->configured && config_reopenable(p_dev) )
+  {
+    kept->cfg_num         = p_dev->cfg_num;
+    kept->itf_alt_support = p_dev->itf_alt_support;
+    memcpy(kept->itf2drv , p_dev->itf2drv , sizeof(kept->itf2drv ));
+    memcpy(kept->ep2drv  , p_dev->ep2drv  , sizeof(kept->ep2drv  ));
+    memcpy(kept->itf2inst, p_dev->itf2inst, sizeof(kept->itf2inst));
+    memcpy(kept->ep2inst , p_dev->ep2inst , sizeof(kept->ep2inst ));
+  }
 
-      case DCD_EVENT_UNPLUGGED:
-        usbd_reset(event.rhport);
+  if ( kept->cfg_num )
+  {
+    device_reset(rhport);
+    return;
+  }
+#endif
 
-        // invoke callback
-        if (tud_umount_cb) tud_umount_cb();
-      break;
+  usbd_reset(rhport);
+}
 
-      case DCD_EVENT_SETUP_RECEIVED:
-        TU_LOG2("  ");
-        TU_LOG1_MEM(&event.setup_received, 1, 8);
+#if TUSB_OPT_DUAL_ROLE
+bool usbd_role_start(uint8_t rhport)
+{
+  dcd_init(rhport);
+  if ( dcd_sof_enable && sof_always() ) dcd_sof_enable(rhport, true);
+  dcd_int_enable(rhport);
+  return true;
+}
+
+void usbd_role_stop(uint8_t rhport)
+{
+  bool const was_mounted = get_device(rhport)->configured;
 
-        // Mark as connected after receiving 1st setup packet.
-        // But it is easier to set it every time instead of wasting time to check then set
-        _usbd_dev.connected = 1;
+  // same as unplugged, interrupt is shared with host controller driver
+  usbd_reset(rhport);
+  dcd_int_disable(rhport);
 
-        // Process control request
-        if ( !process_control_request(event.rhport, &event.setup_received) )
-        {
-          TU_LOG1("  Stall EP0\r\n");
-          // Failed -> stall both control endpoint IN and OUT
-          dcd_edpt_stall(event.rhport, 0);
-          dcd_edpt_stall(event.rhport, 0 | TUSB_DIR_IN_MASK);
-        }
-      break;
+  // events of the controller are stale, dual-role port is the only device port
+  dcd_event_t event;
+  while ( osal_queue_receive(_usbd_q, &event, OSAL_TIMEOUT_NOTIMEOUT) ) {}
+#if CFG_TUD_TASK_PRIO_QUEUE_SZ
+  for (uint8_t i = 0; i < TUD_OPT_RHPORT_COUNT; i++)
+  {
+    tu_fifo_clear(&_usbd_prio_ff[i]);
+  }
+#endif
+#if CFG_TUD_TASK_DEFER_QUEUE_SZ
+  tu_fifo_clear(&_usbd_defer_ff);
+#endif
+
+  // invoke callback
+  if (was_mounted && tud_umount_cb) tud_umount_cb();
+}
+#endif
+
+/* USB Device Driver task
+ * This top level thread manages all device controller event and delegates events to class-specific drivers.
+ * This should be called periodically within the mainloop or rtos thread.
+ *
+   @code
+    int main(void)
+    {
+      application_init();
+      tusb_init();
 
-      case DCD_EVENT_XFER_COMPLETE:
+      while(1) // the mainloop
       {
-        // Invoke the class callback associated with the endpoint address
-        uint8_t const ep_addr = event.xfer_complete.ep_addr;
-        uint8_t const epnum   = tu_edpt_number(ep_addr);
-        uint8_t const ep_dir  = tu_edpt_dir(ep_addr);
+        application_code();
+        tud_task(); // tinyusb device task
+      }
+    }
+    @endcode
+ */
+TU_ATTR_FAST_FUNC void tud_task (void)
+{
+  tud_task_ext(OSAL_TIMEOUT_WAIT_FOREVER);
+}
 
-        TU_LOG2("  Endpoint: 0x%02X, Bytes: %ld\r\n", ep_addr, event.xfer_complete.len);
+static inline bool task_runnable(void)
+{
+  // Skip if stack is not initialized
+  if ( !tusb_inited() ) return false;
 
-        _usbd_dev.ep_status[epnum][ep_dir].busy = false;
+#if TUSB_OPT_DUAL_ROLE
+  // initialized once device role is selected
+  if ( !tusb_role_inited(OPT_MODE_DEVICE) ) return false;
+#endif
 
-        if ( 0 == epnum )
-        {
-          TU_LOG1("  EP Addr = 0x%02X, len = %ld\r\n", ep_addr, event.xfer_complete.len);
-          usbd_control_xfer_cb(event.rhport, ep_addr, event.xfer_complete.result, event.xfer_complete.len);
-        }
-        else
-        {
-          uint8_t const drv_id = _usbd_dev.ep2drv[epnum][ep_dir];
-          TU_ASSERT(drv_id < USBD_CLASS_DRIVER_COUNT,);
+  return true;
+}
+
+// Process one event (or deferred call), waiting at most wait_ms for it. Return false if none
+static TU_ATTR_FAST_FUNC bool task_process_event(uint32_t wait_ms)
+{
+  dcd_event_t event;
+
+#if CFG_TUD_TASK_DEFER_QUEUE_SZ
+  // deferred calls first
+  usbd_defer_t call;
+  if ( tu_fifo_read(&_usbd_defer_ff, &call) )
+  {
+    call.func(call.param);
+    return true;
+  }
+#endif
+
+#if CFG_TUD_TASK_PRIO_QUEUE_SZ
+  // bus, setup & control events first
+  if ( !tu_fifo_read(&_usbd_prio_ff[0], &event) )
+  #if TUD_OPT_RHPORT_COUNT > 1
+  if ( !tu_fifo_read(&_usbd_prio_ff[1], &event) )
+  #endif
+#endif
+  if ( !osal_queue_receive(_usbd_q, &event, wait_ms) ) return false;
+
+  TU_TRACE(TU_TRACE_EVENT_TASK, event.rhport, event.event_id);
+  TU_LOG2("USBD: event %s\r\n", event.event_id < DCD_EVENT_COUNT ? _usbd_event_str[event.event_id] : "CORRUPTED");
+
+  switch ( event.event_id )
+  {
+    case DCD_EVENT_BUS_RESET:
+      usbd_bus_reset(event.rhport);
+    break;
+
+    case DCD_EVENT_UNPLUGGED:
+      usbd_reset(event.rhport);
+
+      // invoke callback
+      if (tud_umount_cb) tud_umount_cb();
+    break;
+
+    case DCD_EVENT_SETUP_RECEIVED:
+      TU_LOG2("  ");
+      TU_LOG1_MEM(&event.setup_received, 1, 8);
+
+      // Mark as connected after receiving 1st setup packet.
+      // But it is easier to set it every time instead of wasting time to check then set
+      get_device(event.rhport)->connected = 1;
+
+    #if CFG_TUD_DESC_ASYNC
+      // host gave up previous request, if any
+      get_device(event.rhport)->desc_pending = false;
+    #endif
 
-          TU_LOG2("  %s xfer callback\r\n", _usbd_driver_str[drv_id]);
-          usbd_class_drivers[drv_id].xfer_cb(event.rhport, ep_addr, event.xfer_complete.result, event.xfer_complete.len);
+      // Process control request
+      profile_setup_begin(event.rhport, &event.setup_received);
+      if ( !process_control_request(event.rhport, &event.setup_received) )
+      {
+        TU_LOG1("  Stall EP0\r\n");
+        // Failed -> stall both control endpoint IN and OUT
+        dcd_edpt_stall(event.rhport, 0);
+        dcd_edpt_stall(event.rhport, 0 | TUSB_DIR_IN_MASK);
+      }
+      profile_setup_end(event.rhport);
+    break;
+
+    case DCD_EVENT_XFER_COMPLETE:
+      process_xfer_complete(event.rhport, event.xfer_complete.ep_addr, event.xfer_complete.result, event.xfer_complete.len);
+    break;
+
+    case USBD_EVENT_XFER_PENDING:
+      process_xfer_pending(event.rhport);
+    break;
+
+    case DCD_EVENT_SUSPEND:
+#if CFG_TUD_TASK_EVENT_COALESCE
+      _usbd_coalesce[USBD_RHPORT_IDX(event.rhport)].suspend = false;
+#endif
+      if (tud_suspend_cb) tud_suspend_cb(get_device(event.rhport)->remote_wakeup_en);
+    break;
+
+    case DCD_EVENT_RESUME:
+#if CFG_TUD_TASK_EVENT_COALESCE
+      _usbd_coalesce[USBD_RHPORT_IDX(event.rhport)].resume = false;
+#endif
+      if (tud_resume_cb) tud_resume_cb();
+    break;
+
+    case DCD_EVENT_LPM_SLEEP:
+      if (tud_lpm_sleep_cb) tud_lpm_sleep_cb(event.lpm_sleep.besl, event.lpm_sleep.remote_wakeup);
+    break;
+
+    case DCD_EVENT_LPM_RESUME:
+      if (tud_lpm_resume_cb) tud_lpm_resume_cb();
+    break;
+
+    case DCD_EVENT_SOF:
+      // SOFs arriving meanwhile are merged into this one
+      get_device(event.rhport)->sof_pending = false;
+
+      for ( uint8_t i = 0; i < TOTAL_DRIVER_COUNT; i++ )
+      {
+        if ( get_driver(i)->sof )
+        {
+          get_driver(i)->sof(event.rhport);
         }
       }
-      break;
+    break;
+
+    case USBD_EVENT_FUNC_CALL:
+      if ( event.func_call.func ) event.func_call.func(event.func_call.param);
+    break;
+
+    default:
+      TU_BREAKPOINT();
+    break;
+  }
+
+  return true;
+}
+
+TU_ATTR_FAST_FUNC void tud_task_ext (uint32_t timeout_ms)
+{
+  if ( !task_runnable() ) return;
+
+  // Loop until there is no more events in the queue, only the first one is waited for
+  for ( uint32_t wait_ms = timeout_ms; task_process_event(wait_ms); wait_ms = OSAL_TIMEOUT_NOTIMEOUT ) {}
+}
+
+bool tud_task_budget (uint32_t max_events, uint32_t max_time)
+{
+  if ( !task_runnable() ) return false;
+
+  uint32_t const start = CFG_TUD_TASK_TIMESTAMP();
+
+  // at least one event is processed per call so that queue is always drained eventually
+  for ( uint32_t count = 0; (max_events == 0) || (count < max_events); count++ )
+  {
+    if ( count && max_time && (CFG_TUD_TASK_TIMESTAMP() - start) >= max_time ) return true;
+    if ( !task_process_event(OSAL_TIMEOUT_NOTIMEOUT) ) return false;
+  }
+
+  return true;
+}
+
+// Invoke the class callback associated with the endpoint address
+static TU_ATTR_FAST_FUNC void process_xfer_complete(uint8_t rhport, uint8_t ep_addr, uint8_t result, uint32_t xferred_bytes)
+{
+  uint8_t const epnum   = tu_edpt_number(ep_addr);
+  uint8_t const ep_dir  = tu_edpt_dir(ep_addr);
+
+  usbd_device_t* p_dev = get_device(rhport);
+
+  TU_LOG2("  Endpoint: 0x%02X, Bytes: %ld\r\n", ep_addr, xferred_bytes);
+
+  if ( edpt_xfer_complete(rhport, ep_addr) ) p_dev->ep_status[epnum][ep_dir].busy = false;
+
+  if ( 0 == epnum )
+  {
+    TU_LOG1("  EP Addr = 0x%02X, len = %ld\r\n", ep_addr, xferred_bytes);
+    profile_xfer_begin(rhport);
+    usbd_control_xfer_cb(rhport, ep_addr, (xfer_result_t) result, xferred_bytes);
+    profile_xfer_end(rhport);
+  }
+  else
+  {
+    uint8_t const drv_id = p_dev->ep2drv[epnum][ep_dir];
+    // stale completion e.g queued before a bus reset which is already processed
+    if ( drv_id >= TOTAL_DRIVER_COUNT ) return;
+
+    edpt_xfer_sg_complete(rhport, ep_addr, xferred_bytes);
+    stats_xfer_callback(rhport, ep_addr);
+
+    TU_LOG2("  %s xfer callback\r\n", get_driver_name(drv_id));
+    TU_TRACE(TU_TRACE_XFER_CB_ENTER, rhport, ep_addr);
+    get_driver(drv_id)->xfer_cb(rhport, ep_addr, (xfer_result_t) result, xferred_bytes);
+    TU_TRACE(TU_TRACE_XFER_CB_EXIT, rhport, ep_addr);
+  }
+}
+
+// Process all coalesced transfer completions
+static TU_ATTR_FAST_FUNC void process_xfer_pending(uint8_t rhport)
+{
+#if CFG_TUD_TASK_EVENT_COALESCE
+  usbd_coalesce_t* coalesce = &_usbd_coalesce[USBD_RHPORT_IDX(rhport)];
+
+  // completions stored from now on will post another pending event
+  dcd_int_disable(rhport);
+  uint16_t const bitmap = coalesce->xfer_bitmap;
+  coalesce->xfer_event = false;
+  dcd_int_enable(rhport);
 
-      case DCD_EVENT_SUSPEND:
-        if (tud_suspend_cb) tud_suspend_cb(_usbd_dev.remote_wakeup_en);
-      break;
+  for(uint8_t i=0; i<16; i++)
+  {
+    if ( !(bitmap & TU_BIT(i)) ) continue;
+
+    uint8_t const epnum = i >> 1;
+    uint8_t const dir   = i & 1;
+
+    // release the slot before invoking callback which may re-arm the endpoint
+    dcd_int_disable(rhport);
+    usbd_xfer_pending_t const xfer = coalesce->xfer[epnum][dir];
+    coalesce->xfer_bitmap &= (uint16_t) ~TU_BIT(i);
+    dcd_int_enable(rhport);
+
+    process_xfer_complete(rhport, tu_edpt_addr(epnum, dir), xfer.result, xfer.len);
+  }
+#else
+  (void) rhport;
+#endif
+}
+
+//--------------------------------------------------------------------+
+// WinUSB: MS OS 2.0 descriptors generated from configuration
+//--------------------------------------------------------------------+
+#if CFG_TUD_WINUSB
+
+TU_VERIFY_STATIC(CFG_TUD_WINUSB <= 0xFF, "CFG_TUD_WINUSB selects up to 8 interfaces");
+
+// descriptor set index of the vendor request
+#define MS_OS_20_DESCRIPTOR_INDEX  7
+
+enum
+{
+  WINUSB_ITF_MAX = ((CFG_TUD_WINUSB)      & 1) + (((CFG_TUD_WINUSB) >> 1) & 1) + (((CFG_TUD_WINUSB) >> 2) & 1) +
+                   (((CFG_TUD_WINUSB) >> 3) & 1) + (((CFG_TUD_WINUSB) >> 4) & 1) + (((CFG_TUD_WINUSB) >> 5) & 1) +
+                   (((CFG_TUD_WINUSB) >> 6) & 1) + (((CFG_TUD_WINUSB) >> 7) & 1)
+};
 
-      case DCD_EVENT_RESUME:
-        if (tud_resume_cb) tud_resume_cb();
-      break;
+static uint8_t _winusb_desc_set[TUD_WINUSB_DESC_SET_LEN(1, WINUSB_ITF_MAX)];
 
-      case DCD_EVENT_SOF:
-        for ( uint8_t i = 0; i < USBD_CLASS_DRIVER_COUNT; i++ )
+// wMSOSDescriptorSetTotalLength is filled once set is built
+static uint8_t _winusb_desc_bos[] =
+{
+  TUD_BOS_DESCRIPTOR(TUD_BOS_DESC_LEN + TUD_BOS_MICROSOFT_OS_DESC_LEN, 1),
+  TUD_BOS_MS_OS_20_DESCRIPTOR(0, CFG_TUD_WINUSB_VENDOR_CODE)
+};
+
+// wLength and wDescriptorType common to all MS OS 2.0 descriptors
+static uint8_t* ms_os_20_header(uint8_t* p, uint16_t length, microsoft_os_20_type_t type)
+{
+  p[0] = tu_u16_low(length);
+  p[1] = tu_u16_high(length);
+  p[2] = (uint8_t) type;
+  p[3] = 0;
+  return p + 4;
+}
+
+// Build descriptor set from first configuration, return its length or 0 if none of the selected
+// interfaces exists or configuration is not available right away (TUD_DESC_PENDING)
+static uint16_t winusb_desc_set_build(void)
+{
+  tusb_desc_configuration_t const * desc_cfg = (tusb_desc_configuration_t const *) tud_descriptor_configuration_cb(0);
+#if CFG_TUD_DESC_ASYNC
+  TU_VERIFY(desc_cfg != TUD_DESC_PENDING, 0);
+#endif
+  TU_VERIFY(desc_cfg, 0);
+
+  uint8_t const * p_desc   = (uint8_t const *) desc_cfg;
+  uint8_t const * desc_end = p_desc + desc_cfg->wTotalLength;
+
+  // Windows only reads function subsets of a composite device
+  bool const composite = desc_cfg->bNumInterfaces > 1;
+
+  uint8_t* p = _winusb_desc_set + (composite ? 10 + 8 : 10);
+  uint8_t vendor_idx = 0;
+  uint8_t count = 0;
+
+  while( p_desc < desc_end && count < (composite ? WINUSB_ITF_MAX : 1) )
+  {
+    tusb_desc_interface_t const * desc_itf = (tusb_desc_interface_t const *) p_desc;
+
+    if ( TUSB_DESC_INTERFACE == tu_desc_type(p_desc) && 0 == desc_itf->bAlternateSetting &&
+         TUSB_CLASS_VENDOR_SPECIFIC == desc_itf->bInterfaceClass )
+    {
+      if ( tu_bit_test(CFG_TUD_WINUSB, vendor_idx) )
+      {
+        if ( composite )
         {
-          if ( usbd_class_drivers[i].sof )
-          {
-            usbd_class_drivers[i].sof(event.rhport);
-          }
+          p = ms_os_20_header(p, 8, MS_OS_20_SUBSET_HEADER_FUNCTION);
+          *p++ = desc_itf->bInterfaceNumber;
+          *p++ = 0;
+          *p++ = 8 + 20;
+          *p++ = 0;
         }
-      break;
 
-      case USBD_EVENT_FUNC_CALL:
-        if ( event.func_call.func ) event.func_call.func(event.func_call.param);
-      break;
+        // compatible ID "WINUSB", no sub-compatible ID
+        p = ms_os_20_header(p, 20, MS_OS_20_FEATURE_COMPATBLE_ID);
+        memcpy(p, "WINUSB\0\0", 8);
+        memset(p + 8, 0, 8);
+        p += 16;
 
-      default:
-        TU_BREAKPOINT();
-      break;
+        count++;
+      }
+      vendor_idx++;
     }
+
+    p_desc = tu_desc_next(p_desc);
+  }
+
+  TU_VERIFY(count, 0);
+
+  uint16_t const total_len = (uint16_t) (p - _winusb_desc_set);
+
+  // set header for Windows 8.1 and later
+  p = ms_os_20_header(_winusb_desc_set, 10, MS_OS_20_SET_HEADER_DESCRIPTOR);
+  *p++ = 0x00; *p++ = 0x00; *p++ = 0x03; *p++ = 0x06;
+  *p++ = tu_u16_low(total_len);
+  *p++ = tu_u16_high(total_len);
+
+  if ( composite )
+  {
+    uint16_t const subset_len = (uint16_t) (total_len - 10);
+
+    // configuration subset is of configuration index (not bConfigurationValue) as Windows uses it
+    p = ms_os_20_header(p, 8, MS_OS_20_SUBSET_HEADER_CONFIGURATION);
+    *p++ = 0;
+    *p++ = 0;
+    *p++ = tu_u16_low(subset_len);
+    *p++ = tu_u16_high(subset_len);
   }
+
+  return total_len;
+}
+
+// BOS with MS OS 2.0 capability of generated set
+static uint8_t const * winusb_bos_build(void)
+{
+  uint16_t const set_len = winusb_desc_set_build();
+  TU_VERIFY(set_len, NULL);
+
+  uint8_t* p_len = _winusb_desc_bos + TUD_BOS_DESC_LEN + 24;
+  p_len[0] = tu_u16_low(set_len);
+  p_len[1] = tu_u16_high(set_len);
+
+  return _winusb_desc_bos;
 }
 
+#endif
+
 //--------------------------------------------------------------------+
 // Control Request Parser & Handling
 //--------------------------------------------------------------------+
@@ -456,16 +1444,29 @@ void tud_task (void)
 // return false will cause its caller to stall control endpoint
 static bool process_control_request(uint8_t rhport, tusb_control_request_t const * p_request)
 {
-  usbd_control_set_complete_callback(NULL);
+  usbd_device_t* p_dev = get_device(rhport);
+
+  usbd_control_set_complete_callback(rhport, NULL);
 
   TU_ASSERT(p_request->bmRequestType_bit.type < TUSB_REQ_TYPE_INVALID);
 
   // Vendor request
   if ( p_request->bmRequestType_bit.type == TUSB_REQ_TYPE_VENDOR )
   {
+  #if CFG_TUD_WINUSB
+    if ( TUSB_REQ_RCPT_DEVICE == p_request->bmRequestType_bit.recipient &&
+         TUSB_DIR_IN == p_request->bmRequestType_bit.direction &&
+         CFG_TUD_WINUSB_VENDOR_CODE == p_request->bRequest && MS_OS_20_DESCRIPTOR_INDEX == p_request->wIndex )
+    {
+      uint16_t const len = winusb_desc_set_build();
+      TU_VERIFY(len);
+      return tud_control_xfer(rhport, p_request, _winusb_desc_set, len);
+    }
+  #endif
+
     TU_VERIFY(tud_vendor_control_request_cb);
 
-    if (tud_vendor_control_complete_cb) usbd_control_set_complete_callback(tud_vendor_control_complete_cb);
+    if (tud_vendor_control_complete_cb) usbd_control_set_complete_callback(rhport, tud_vendor_control_complete_cb);
     return tud_vendor_control_request_cb(rhport, p_request);
   }
 
@@ -480,6 +1481,21 @@ static bool process_control_request(uint8_t rhport, tusb_control_request_t const
   {
     //------------- Device Requests e.g in enumeration -------------//
     case TUSB_REQ_RCPT_DEVICE:
+      if ( TUSB_REQ_TYPE_CLASS == p_request->bmRequestType_bit.type )
+      {
+        // forward to class driver of interface in wIndex e.g Bluetooth HCI command
+        uint8_t const itf = tu_u16_low(p_request->wIndex);
+        TU_VERIFY(itf < TU_ARRAY_SIZE(p_dev->itf2drv));
+
+        uint8_t const drvid = p_dev->itf2drv[itf];
+        TU_VERIFY(drvid < TOTAL_DRIVER_COUNT);
+
+        usbd_control_set_complete_callback(rhport, get_driver(drvid)->control_complete);
+        TU_LOG2("  %s control request\r\n", get_driver_name(drvid));
+        return get_driver(drvid)->control_request != NULL &&
+               get_driver(drvid)->control_request(rhport, p_request);
+      }
+
       if ( TUSB_REQ_TYPE_STANDARD != p_request->bmRequestType_bit.type )
       {
         // Non standard request is not supported
@@ -493,12 +1509,13 @@ static bool process_control_request(uint8_t rhport, tusb_control_request_t const
           // Depending on mcu, status phase could be sent either before or after changing device address
           // Therefore DCD must include zero-length status response
           dcd_set_address(rhport, (uint8_t) p_request->wValue);
+          profile_milestone(rhport, TUD_ENUM_SET_ADDRESS);
           return true; // skip status
         break;
 
         case TUSB_REQ_GET_CONFIGURATION:
         {
-          uint8_t cfgnum = _usbd_dev.configured ? 1 : 0;
+          uint8_t cfgnum = p_dev->cfg_num;
           tud_control_xfer(rhport, p_request, &cfgnum, 1);
         }
         break;
@@ -508,10 +1525,13 @@ static bool process_control_request(uint8_t rhport, tusb_control_request_t const
           uint8_t const cfg_num = (uint8_t) p_request->wValue;
 
           dcd_set_config(rhport, cfg_num);
-          _usbd_dev.configured = cfg_num ? 1 : 0;
+          p_dev->configured = cfg_num ? 1 : 0;
+
+          p_dev->cfg_num    = cfg_num;
 
           if ( cfg_num ) TU_ASSERT( process_set_config(rhport, cfg_num) );
           tud_control_status(rhport, p_request);
+          if ( cfg_num ) profile_milestone(rhport, TUD_ENUM_SET_CONFIG);
         }
         break;
 
@@ -524,7 +1544,7 @@ static bool process_control_request(uint8_t rhport, tusb_control_request_t const
           TU_VERIFY(TUSB_REQ_FEATURE_REMOTE_WAKEUP == p_request->wValue);
 
           // Host may enable remote wake up before suspending especially HID device
-          _usbd_dev.remote_wakeup_en = true;
+          p_dev->remote_wakeup_en = true;
           tud_control_status(rhport, p_request);
         break;
 
@@ -533,7 +1553,7 @@ static bool process_control_request(uint8_t rhport, tusb_control_request_t const
           TU_VERIFY(TUSB_REQ_FEATURE_REMOTE_WAKEUP == p_request->wValue);
 
           // Host may disable remote wake up after resuming
-          _usbd_dev.remote_wakeup_en = false;
+          p_dev->remote_wakeup_en = false;
           tud_control_status(rhport, p_request);
         break;
 
@@ -542,7 +1562,7 @@ static bool process_control_request(uint8_t rhport, tusb_control_request_t const
           // Device status bit mask
           // - Bit 0: Self Powered
           // - Bit 1: Remote Wakeup enabled
-          uint16_t status = (_usbd_dev.self_powered ? 1 : 0) | (_usbd_dev.remote_wakeup_en ? 2 : 0);
+          uint16_t status = (p_dev->self_powered ? 1 : 0) | (p_dev->remote_wakeup_en ? 2 : 0);
           tud_control_xfer(rhport, p_request, &status, 2);
         }
         break;
@@ -556,51 +1576,70 @@ static bool process_control_request(uint8_t rhport, tusb_control_request_t const
     case TUSB_REQ_RCPT_INTERFACE:
     {
       uint8_t const itf = tu_u16_low(p_request->wIndex);
-      TU_VERIFY(itf < TU_ARRAY_SIZE(_usbd_dev.itf2drv));
+      TU_VERIFY(itf < TU_ARRAY_SIZE(p_dev->itf2drv));
 
-      uint8_t const drvid = _usbd_dev.itf2drv[itf];
-      TU_VERIFY(drvid < USBD_CLASS_DRIVER_COUNT);
+      uint8_t const drvid = p_dev->itf2drv[itf];
+      TU_VERIFY(drvid < TOTAL_DRIVER_COUNT);
 
       if (p_request->bmRequestType_bit.type == TUSB_REQ_TYPE_STANDARD)
       {
         switch ( p_request->bRequest )
         {
           case TUSB_REQ_GET_INTERFACE:
-          {
-            // TODO not support alternate interface yet
-            uint8_t alternate = 0;
-            tud_control_xfer(rhport, p_request, &alternate, 1);
-          }
-          break;
-
           case TUSB_REQ_SET_INTERFACE:
-          {
-            uint8_t const alternate = (uint8_t) p_request->wValue;
+            if ( get_driver(drvid)->set_alt )
+            {
+              // endpoints are switched by usbd, driver only starts transfers of the new alternate
+              if ( TUSB_REQ_GET_INTERFACE == p_request->bRequest )
+              {
+                tud_control_xfer(rhport, p_request, &p_dev->itf_alt[itf], 1);
+              }else
+              {
+                TU_VERIFY( process_set_interface(rhport, itf, (uint8_t) p_request->wValue) );
+                tud_control_status(rhport, p_request);
+              }
+            }
+            else if ( tu_bit_test(p_dev->itf_alt_support, itf) )
+            {
+              // driver having alternate settings manages them itself
+              usbd_control_set_complete_callback(rhport, get_driver(drvid)->control_complete);
+              TU_LOG2("  %s control request\r\n", get_driver_name(drvid));
+              TU_VERIFY(get_driver(drvid)->control_request != NULL &&
+                        get_driver(drvid)->control_request(rhport, p_request));
+            }
+            else if ( TUSB_REQ_GET_INTERFACE == p_request->bRequest )
+            {
+              // only default alternate setting
+              uint8_t alternate = 0;
+              tud_control_xfer(rhport, p_request, &alternate, 1);
+            }
+            else
+            {
+              uint8_t const alternate = (uint8_t) p_request->wValue;
 
-            // TODO not support alternate interface yet
-            TU_ASSERT(alternate == 0);
-            tud_control_status(rhport, p_request);
-          }
+              TU_ASSERT(alternate == 0);
+              tud_control_status(rhport, p_request);
+            }
           break;
 
           default:
             // forward to class driver: "STD request to Interface"
             // GET HID REPORT DESCRIPTOR falls into this case
             // stall control endpoint if driver return false
-            usbd_control_set_complete_callback(usbd_class_drivers[drvid].control_complete);
-            TU_LOG2("  %s control request\r\n", _usbd_driver_str[drvid]);
-            TU_VERIFY(usbd_class_drivers[drvid].control_request != NULL &&
-                      usbd_class_drivers[drvid].control_request(rhport, p_request));
+            usbd_control_set_complete_callback(rhport, get_driver(drvid)->control_complete);
+            TU_LOG2("  %s control request\r\n", get_driver_name(drvid));
+            TU_VERIFY(get_driver(drvid)->control_request != NULL &&
+                      get_driver(drvid)->control_request(rhport, p_request));
           break;
         }
       }else
       {
         // forward to class driver: "non-STD request to Interface"
         // stall control endpoint if driver return false
-        usbd_control_set_complete_callback(usbd_class_drivers[drvid].control_complete);
-        TU_LOG2("  %s control request\r\n", _usbd_driver_str[drvid]);
-        TU_VERIFY(usbd_class_drivers[drvid].control_request != NULL &&
-                  usbd_class_drivers[drvid].control_request(rhport, p_request));
+        usbd_control_set_complete_callback(rhport, get_driver(drvid)->control_complete);
+        TU_LOG2("  %s control request\r\n", get_driver_name(drvid));
+        TU_VERIFY(get_driver(drvid)->control_request != NULL &&
+                  get_driver(drvid)->control_request(rhport, p_request));
       }
     }
     break;
@@ -612,17 +1651,17 @@ static bool process_control_request(uint8_t rhport, tusb_control_request_t const
       uint8_t const ep_num  = tu_edpt_number(ep_addr);
       uint8_t const ep_dir  = tu_edpt_dir(ep_addr);
 
-      TU_ASSERT(ep_num < TU_ARRAY_SIZE(_usbd_dev.ep2drv) );
+      TU_ASSERT(ep_num < TU_ARRAY_SIZE(p_dev->ep2drv) );
 
-      uint8_t const drv_id = _usbd_dev.ep2drv[ep_num][ep_dir];
-      TU_ASSERT(drv_id < USBD_CLASS_DRIVER_COUNT);
+      uint8_t const drv_id = p_dev->ep2drv[ep_num][ep_dir];
+      TU_ASSERT(drv_id < TOTAL_DRIVER_COUNT);
 
       bool ret = false;
 
       if ( TUSB_REQ_TYPE_STANDARD != p_request->bmRequestType_bit.type )
       {
         // complete callback is also capable of stalling/acking the request
-        usbd_control_set_complete_callback(usbd_class_drivers[drv_id].control_complete);
+        usbd_control_set_complete_callback(rhport, get_driver(drv_id)->control_complete);
       }
 
       // Then handle if it is standard request
@@ -666,9 +1705,9 @@ static bool process_control_request(uint8_t rhport, tusb_control_request_t const
       // For std-type requests:    non-std request codes are already discarded.
       //                           must not call tud_control_status(), and return value will have no effect
       // class driver is invoked last, so that EP already has EP stall cleared (in event of clear feature EP halt)
-      TU_LOG2("  %s control request\r\n", _usbd_driver_str[drv_id]);
-      if ( usbd_class_drivers[drv_id].control_request &&
-           usbd_class_drivers[drv_id].control_request(rhport, p_request))
+      TU_LOG2("  %s control request\r\n", get_driver_name(drv_id));
+      if ( get_driver(drv_id)->control_request &&
+           get_driver(drv_id)->control_request(rhport, p_request))
       {
         ret = true;
       }
@@ -687,12 +1726,37 @@ static bool process_control_request(uint8_t rhport, tusb_control_request_t const
 // This function parse configuration descriptor & open drivers accordingly
 static bool process_set_config(uint8_t rhport, uint8_t cfg_num)
 {
+  usbd_device_t* p_dev = get_device(rhport);
+
   tusb_desc_configuration_t const * desc_cfg = (tusb_desc_configuration_t const *) tud_descriptor_configuration_cb(cfg_num-1); // index is cfg_num-1
+#if CFG_TUD_DESC_ASYNC
+  TU_VERIFY(desc_cfg != TUD_DESC_PENDING); // must be answered right away: stall
+#endif
   TU_ASSERT(desc_cfg != NULL && desc_cfg->bDescriptorType == TUSB_DESC_CONFIGURATION);
 
   // Parse configuration descriptor
-  _usbd_dev.remote_wakeup_support = (desc_cfg->bmAttributes & TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP) ? 1 : 0;
-  _usbd_dev.self_powered = (desc_cfg->bmAttributes & TUSB_DESC_CONFIG_ATT_SELF_POWERED) ? 1 : 0;
+  p_dev->remote_wakeup_support = (desc_cfg->bmAttributes & TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP) ? 1 : 0;
+  p_dev->self_powered = (desc_cfg->bmAttributes & TUSB_DESC_CONFIG_ATT_SELF_POWERED) ? 1 : 0;
+
+  tu_memclr(p_dev->itf_alt, sizeof(p_dev->itf_alt));
+
+#if CFG_TUD_FAST_RESET
+  usbd_kept_config_t* kept = &_usbd_kept[USBD_RHPORT_IDX(rhport)];
+  if ( kept->cfg_num )
+  {
+    if ( kept->cfg_num == cfg_num ) return reopen_config(rhport, desc_cfg);
+
+    // another configuration, state kept by drivers is dropped
+    kept->cfg_num = 0;
+    drivers_reset(rhport);
+  }
+#endif
+
+  if ( tud_descriptor_configuration_map_cb )
+  {
+    tud_config_map_t const* map = tud_descriptor_configuration_map_cb(cfg_num-1);
+    if ( map ) return open_mapped_config(rhport, desc_cfg, map);
+  }
 
   // Parse interface descriptor
   uint8_t const * p_desc   = ((uint8_t const*) desc_cfg) + sizeof(tusb_desc_configuration_t);
@@ -710,24 +1774,31 @@ static bool process_set_config(uint8_t rhport, uint8_t cfg_num)
 
       tusb_desc_interface_t* desc_itf = (tusb_desc_interface_t*) p_desc;
 
-      // Check if class is supported
-      uint8_t drv_id;
-      for (drv_id = 0; drv_id < USBD_CLASS_DRIVER_COUNT; drv_id++)
+      // Interface number must not be used already
+      TU_ASSERT( desc_itf->bInterfaceNumber < TU_ARRAY_SIZE(p_dev->itf2drv) );
+      TU_ASSERT( DRVID_INVALID == p_dev->itf2drv[desc_itf->bInterfaceNumber] );
+
+      // Several drivers can share a class code (e.g CDC ACM and NCM), the first one
+      // accepting the interface gets it. Driver must reject before opening any endpoint.
+      // single instance driver does not need to set its instance
+      uint16_t itf_len;
+      uint8_t  inst;
+      uint8_t  drv_id;
+      for (drv_id = 0; drv_id < TOTAL_DRIVER_COUNT; drv_id++)
       {
-        if ( usbd_class_drivers[drv_id].class_code == desc_itf->bInterfaceClass ) break;
-      }
-      TU_ASSERT( drv_id < USBD_CLASS_DRIVER_COUNT );
+        if ( get_driver(drv_id)->class_code != desc_itf->bInterfaceClass ) continue;
 
-      // Interface number must not be used already TODO alternate interface
-      TU_ASSERT( DRVID_INVALID == _usbd_dev.itf2drv[desc_itf->bInterfaceNumber] );
-      _usbd_dev.itf2drv[desc_itf->bInterfaceNumber] = drv_id;
-
-      uint16_t itf_len=0;
-      TU_LOG2("  %s open\r\n", _usbd_driver_str[drv_id]);
-      TU_ASSERT( usbd_class_drivers[drv_id].open(rhport, desc_itf, &itf_len) );
+        itf_len = 0;
+        inst    = 0;
+        TU_LOG2("  %s open\r\n", get_driver_name(drv_id));
+        if ( get_driver(drv_id)->open(rhport, desc_itf, &itf_len, &inst) ) break;
+      }
+      TU_ASSERT( drv_id < TOTAL_DRIVER_COUNT );
       TU_ASSERT( itf_len >= sizeof(tusb_desc_interface_t) );
 
-      mark_interface_endpoint(_usbd_dev.ep2drv, p_desc, itf_len, drv_id);
+      // All interfaces and endpoints claimed by the driver (e.g CDC data interface)
+      // are routed directly to it and its instance from now on
+      mark_interface_endpoint(p_dev, p_desc, itf_len, drv_id, inst);
 
       p_desc += itf_len; // next interface
     }
@@ -739,157 +1810,741 @@ static bool process_set_config(uint8_t rhport, uint8_t cfg_num)
   return true;
 }
 
-// Helper marking endpoint of interface belongs to class driver
-static void mark_interface_endpoint(uint8_t ep2drv[8][2], uint8_t const* p_desc, uint16_t desc_len, uint8_t driver_id)
+// Configuration built with TUD_CONFIG_MAP(): driver of each function is known and opened directly,
+// interfaces and endpoints are routed by the map instead of parsing the descriptors claimed by driver
+static bool open_mapped_config(uint8_t rhport, tusb_desc_configuration_t const * desc_cfg, tud_config_map_t const* map)
 {
-  uint16_t len = 0;
-
-  while( len < desc_len )
-  {
-    if ( TUSB_DESC_ENDPOINT == tu_desc_type(p_desc) )
-    {
-      uint8_t const ep_addr = ((tusb_desc_endpoint_t const*) p_desc)->bEndpointAddress;
+  usbd_device_t* p_dev = get_device(rhport);
 
-      ep2drv[tu_edpt_number(ep_addr)][tu_edpt_dir(ep_addr)] = driver_id;
-    }
+  TU_VERIFY_STATIC(sizeof(map->itf2func) == sizeof(p_dev->itf2drv) && sizeof(map->ep2func) == sizeof(p_dev->ep2drv), "map size");
 
-    len   = (uint16_t)(len + tu_desc_len(p_desc));
-    p_desc = tu_desc_next(p_desc);
-  }
-}
+  uint8_t func_inst[TU_ARRAY_SIZE(map->func2drv)];
+  tu_memclr(func_inst, sizeof(func_inst));
 
-// return descriptor's buffer and update desc_len
-static bool process_get_descriptor(uint8_t rhport, tusb_control_request_t const * p_request)
-{
-  tusb_desc_type_t const desc_type = (tusb_desc_type_t) tu_u16_high(p_request->wValue);
-  uint8_t const desc_index = tu_u16_low( p_request->wValue );
+  uint8_t const * p_desc   = ((uint8_t const*) desc_cfg) + sizeof(tusb_desc_configuration_t);
+  uint8_t const * desc_end = ((uint8_t const*) desc_cfg) + desc_cfg->wTotalLength;
 
-  switch(desc_type)
+  while( p_desc < desc_end )
   {
-    case TUSB_DESC_DEVICE:
-      return tud_control_xfer(rhport, p_request, (void*) tud_descriptor_device_cb(), sizeof(tusb_desc_device_t));
-    break;
-
-    case TUSB_DESC_BOS:
+    if ( TUSB_DESC_INTERFACE_ASSOCIATION == tu_desc_type(p_desc) )
     {
-      // requested by host if USB > 2.0 ( i.e 2.1 or 3.x )
-      if (!tud_descriptor_bos_cb) return false;
+      p_desc = tu_desc_next(p_desc); // ignore Interface Association
+    }else
+    {
+      TU_ASSERT( TUSB_DESC_INTERFACE == tu_desc_type(p_desc) );
 
-      tusb_desc_bos_t const* desc_bos = (tusb_desc_bos_t const*) tud_descriptor_bos_cb();
-      uint16_t total_len;
-      memcpy(&total_len, &desc_bos->wTotalLength, 2); // possibly mis-aligned memory
+      tusb_desc_interface_t const* desc_itf = (tusb_desc_interface_t const*) p_desc;
+      TU_ASSERT( desc_itf->bInterfaceNumber < TU_ARRAY_SIZE(map->itf2func) );
 
-      return tud_control_xfer(rhport, p_request, (void*) desc_bos, total_len);
-    }
-    break;
+      uint8_t const func = map->itf2func[desc_itf->bInterfaceNumber];
+      TU_ASSERT( func && map->func2drv[func-1] < USBD_CLASS_DRIVER_COUNT );
 
-    case TUSB_DESC_CONFIGURATION:
-    {
-      tusb_desc_configuration_t const* desc_config = (tusb_desc_configuration_t const*) tud_descriptor_configuration_cb(desc_index);
-      TU_ASSERT(desc_config);
+      uint8_t const drv_id = (uint8_t) (_app_driver_count + map->func2drv[func-1]);
+      uint16_t itf_len = 0;
+      uint8_t  inst    = 0;
 
-      uint16_t total_len;
-      memcpy(&total_len, &desc_config->wTotalLength, 2); // possibly mis-aligned memory
+      TU_LOG2("  %s open\r\n", get_driver_name(drv_id));
+      TU_ASSERT( get_driver(drv_id)->open(rhport, desc_itf, &itf_len, &inst) );
+      TU_ASSERT( itf_len >= sizeof(tusb_desc_interface_t) );
 
-      return tud_control_xfer(rhport, p_request, (void*) desc_config, total_len);
+      func_inst[func-1] = inst;
+      p_desc += itf_len; // next function
+    }
+  }
+
+  for (uint8_t itf = 0; itf < TU_ARRAY_SIZE(map->itf2func); itf++)
+  {
+    uint8_t const func = map->itf2func[itf];
+    if ( func )
+    {
+      p_dev->itf2drv [itf] = (uint8_t) (_app_driver_count + map->func2drv[func-1]);
+      p_dev->itf2inst[itf] = func_inst[func-1];
+    }
+  }
+
+  for (uint8_t epnum = 0; epnum < TU_ARRAY_SIZE(map->ep2func); epnum++)
+  {
+    for (uint8_t dir = 0; dir < 2; dir++)
+    {
+      uint8_t const func = map->ep2func[epnum][dir];
+      if ( func )
+      {
+        p_dev->ep2drv [epnum][dir] = (uint8_t) (_app_driver_count + map->func2drv[func-1]);
+        p_dev->ep2inst[epnum][dir] = func_inst[func-1];
+      }
+    }
+  }
+
+  // invoke callback
+  if (tud_mount_cb) tud_mount_cb();
+
+  return true;
+}
+
+#if CFG_TUD_FAST_RESET
+// Same configuration as before bus reset: mapping is restored and endpoints of default alternates
+// reopened, then each driver instance restarts its transfers
+static bool reopen_config(uint8_t rhport, tusb_desc_configuration_t const * desc_cfg)
+{
+  usbd_device_t* p_dev = get_device(rhport);
+  usbd_kept_config_t* kept = &_usbd_kept[USBD_RHPORT_IDX(rhport)];
+
+  kept->cfg_num          = 0;
+  p_dev->itf_alt_support = kept->itf_alt_support;
+  memcpy(p_dev->itf2drv , kept->itf2drv , sizeof(p_dev->itf2drv ));
+  memcpy(p_dev->ep2drv  , kept->ep2drv  , sizeof(p_dev->ep2drv  ));
+  memcpy(p_dev->itf2inst, kept->itf2inst, sizeof(p_dev->itf2inst));
+  memcpy(p_dev->ep2inst , kept->ep2inst , sizeof(p_dev->ep2inst ));
+
+  uint8_t const * p_desc   = ((uint8_t const*) desc_cfg) + sizeof(tusb_desc_configuration_t);
+  uint8_t const * desc_end = ((uint8_t const*) desc_cfg) + desc_cfg->wTotalLength;
+  bool default_alt = false;
+
+  while( p_desc < desc_end )
+  {
+    if ( TUSB_DESC_INTERFACE == tu_desc_type(p_desc) )
+    {
+      default_alt = (0 == ((tusb_desc_interface_t const*) p_desc)->bAlternateSetting);
+    }
+    else if ( default_alt && TUSB_DESC_ENDPOINT == tu_desc_type(p_desc) )
+    {
+      TU_ASSERT( dcd_edpt_open(rhport, (tusb_desc_endpoint_t const*) p_desc) );
+    }
+
+    p_desc = tu_desc_next(p_desc);
+  }
+
+  for (uint8_t itf = 0; itf < TU_ARRAY_SIZE(p_dev->itf2drv); itf++)
+  {
+    uint8_t const drv_id = p_dev->itf2drv[itf];
+    uint8_t const inst   = p_dev->itf2inst[itf];
+    if ( drv_id == DRVID_INVALID ) continue;
+
+    // instance claiming several interfaces is reopened by its first one
+    bool first = true;
+    for (uint8_t i = 0; i < itf; i++)
+    {
+      if ( p_dev->itf2drv[i] == drv_id && p_dev->itf2inst[i] == inst ) first = false;
+    }
+
+    if ( first )
+    {
+      TU_LOG2("  %s reopen\r\n", get_driver_name(drv_id));
+      get_driver(drv_id)->reopen(rhport, inst);
+    }
+  }
+
+  // invoke callback
+  if (tud_mount_cb) tud_mount_cb();
+
+  return true;
+}
+#endif
+
+// Helper marking interfaces and endpoints belong to class driver's instance
+static void mark_interface_endpoint(usbd_device_t* p_dev, uint8_t const* p_desc, uint16_t desc_len, uint8_t driver_id, uint8_t inst)
+{
+  uint16_t len = 0;
+
+  while( len < desc_len )
+  {
+    if ( TUSB_DESC_INTERFACE == tu_desc_type(p_desc) )
+    {
+      uint8_t const itf_num = ((tusb_desc_interface_t const*) p_desc)->bInterfaceNumber;
+
+      if ( itf_num < TU_ARRAY_SIZE(p_dev->itf2drv) )
+      {
+        p_dev->itf2drv [itf_num] = driver_id;
+        p_dev->itf2inst[itf_num] = inst;
+
+        if ( ((tusb_desc_interface_t const*) p_desc)->bAlternateSetting ) p_dev->itf_alt_support |= TU_BIT(itf_num);
+      }
+    }
+    else if ( TUSB_DESC_ENDPOINT == tu_desc_type(p_desc) )
+    {
+      uint8_t const ep_addr = ((tusb_desc_endpoint_t const*) p_desc)->bEndpointAddress;
+
+      p_dev->ep2drv [tu_edpt_number(ep_addr)][tu_edpt_dir(ep_addr)] = driver_id;
+      p_dev->ep2inst[tu_edpt_number(ep_addr)][tu_edpt_dir(ep_addr)] = inst;
+    }
+
+    len   = (uint16_t)(len + tu_desc_len(p_desc));
+    p_desc = tu_desc_next(p_desc);
+  }
+}
+
+// Find alternate setting of interface in current configuration, length spans up to next interface
+static tusb_desc_interface_t const* find_interface_alt(usbd_device_t const* p_dev, uint8_t itf, uint8_t alt, uint16_t* p_len)
+{
+  tusb_desc_configuration_t const * desc_cfg = (tusb_desc_configuration_t const *) tud_descriptor_configuration_cb(p_dev->cfg_num-1);
+#if CFG_TUD_DESC_ASYNC
+  TU_VERIFY(desc_cfg != TUD_DESC_PENDING, NULL);
+#endif
+  TU_VERIFY(desc_cfg != NULL, NULL);
+
+  uint8_t const * p_desc   = ((uint8_t const*) desc_cfg) + sizeof(tusb_desc_configuration_t);
+  uint8_t const * desc_end = ((uint8_t const*) desc_cfg) + desc_cfg->wTotalLength;
+  uint8_t const * desc_itf = NULL;
+
+  while( p_desc < desc_end )
+  {
+    uint8_t const type = tu_desc_type(p_desc);
+
+    if ( desc_itf )
+    {
+      if ( TUSB_DESC_INTERFACE == type || TUSB_DESC_INTERFACE_ASSOCIATION == type ) break;
+    }
+    else if ( TUSB_DESC_INTERFACE == type &&
+              itf == ((tusb_desc_interface_t const*) p_desc)->bInterfaceNumber &&
+              alt == ((tusb_desc_interface_t const*) p_desc)->bAlternateSetting )
+    {
+      desc_itf = p_desc;
+    }
+
+    p_desc = tu_desc_next(p_desc);
+  }
+
+  TU_VERIFY(desc_itf != NULL, NULL);
+  (*p_len) = (uint16_t) (p_desc - desc_itf);
+
+  return (tusb_desc_interface_t const*) desc_itf;
+}
+
+// Close endpoint of the alternate setting being left, queued transfers are discarded
+static void edpt_close(uint8_t rhport, uint8_t ep_addr)
+{
+  usbd_device_t* p_dev = get_device(rhport);
+  uint8_t const epnum = tu_edpt_number(ep_addr);
+  uint8_t const dir   = tu_edpt_dir(ep_addr);
+
+  dcd_int_disable(rhport);
+
+  if ( dcd_edpt_close ) dcd_edpt_close(rhport, ep_addr);
+
+#if CFG_TUD_EDPT_XFER_QUEUE
+  tu_varclr(&p_dev->xfer_q[epnum][dir]);
+#endif
+  p_dev->ep_status[epnum][dir].busy    = false;
+  p_dev->ep_status[epnum][dir].stalled = false;
+  p_dev->ep_status[epnum][dir].zlp     = false;
+  if ( dir == TUSB_DIR_IN ) p_dev->zlp_mps[epnum] = 0;
+
+  dcd_int_enable(rhport);
+}
+
+// Switch interface to another alternate setting for its driver having set_alt. Endpoints of the
+// current one are closed first so that controller's bandwidth and memory are free for the new ones.
+static bool process_set_interface(uint8_t rhport, uint8_t itf, uint8_t alt)
+{
+  usbd_device_t* p_dev = get_device(rhport);
+
+  uint16_t new_len;
+  tusb_desc_interface_t const* desc_new = find_interface_alt(p_dev, itf, alt, &new_len);
+  TU_VERIFY(desc_new != NULL); // unknown alternate setting: stall
+
+  uint16_t cur_len;
+  uint8_t const* p_desc = (uint8_t const*) find_interface_alt(p_dev, itf, p_dev->itf_alt[itf], &cur_len);
+  uint8_t const* desc_end = p_desc + (p_desc ? cur_len : 0);
+
+  for( ; p_desc < desc_end; p_desc = tu_desc_next(p_desc) )
+  {
+    if ( TUSB_DESC_ENDPOINT == tu_desc_type(p_desc) )
+    {
+      edpt_close(rhport, ((tusb_desc_endpoint_t const*) p_desc)->bEndpointAddress);
+    }
+  }
+
+  // already routed to the driver by process_set_config(), as all alternates are claimed by its open()
+  p_desc   = (uint8_t const*) desc_new;
+  desc_end = p_desc + new_len;
+
+  for( ; p_desc < desc_end; p_desc = tu_desc_next(p_desc) )
+  {
+    if ( TUSB_DESC_ENDPOINT == tu_desc_type(p_desc) )
+    {
+      TU_ASSERT( dcd_edpt_open(rhport, (tusb_desc_endpoint_t const*) p_desc) );
+    }
+  }
+
+  p_dev->itf_alt[itf] = alt;
+
+  uint8_t const drv_id = p_dev->itf2drv[itf];
+  TU_LOG2("  %s set alternate %u\r\n", get_driver_name(drv_id), alt);
+
+  return get_driver(drv_id)->set_alt(rhport, desc_new, new_len);
+}
+
+// Descriptor requested by host from application, NULL if not supported
+static void const* get_descriptor(tusb_control_request_t const * p_request)
+{
+  tusb_desc_type_t const desc_type = (tusb_desc_type_t) tu_u16_high(p_request->wValue);
+  uint8_t const desc_index = tu_u16_low( p_request->wValue );
+
+  switch(desc_type)
+  {
+    case TUSB_DESC_DEVICE:
+      return tud_descriptor_device_cb();
+
+    case TUSB_DESC_BOS:
+      // requested by host if USB > 2.0 ( i.e 2.1 or 3.x )
+    #if CFG_TUD_WINUSB
+      if ( !tud_descriptor_bos_cb ) return winusb_bos_build();
+    #endif
+      return tud_descriptor_bos_cb ? tud_descriptor_bos_cb() : NULL;
+
+    case TUSB_DESC_CONFIGURATION:
+    {
+      void const* desc_config = tud_descriptor_configuration_cb(desc_index);
+      TU_ASSERT(desc_config, NULL);
+      return desc_config;
     }
-    break;
 
     case TUSB_DESC_STRING:
+    {
       // String Descriptor always uses the desc set from user
       if ( desc_index == 0xEE )
       {
         // The 0xEE index string is a Microsoft OS Descriptors.
         // https://docs.microsoft.com/en-us/windows-hardware/drivers/usbcon/microsoft-defined-usb-descriptors
-        return false;
-      }else
-      {
-        uint8_t const* desc_str = (uint8_t const*) tud_descriptor_string_cb(desc_index);
-        TU_ASSERT(desc_str);
-
-        // first byte of descriptor is its size
-        return tud_control_xfer(rhport, p_request, (void*) desc_str, desc_str[0]);
+        return NULL;
       }
-    break;
+
+    #if CFG_TUD_DESC_STRING_TABLE
+      TU_VERIFY(desc_index < tud_descriptor_string_count, NULL);
+      void const* desc_str = tud_descriptor_string_arr[desc_index];
+    #else
+      void const* desc_str = tud_descriptor_string_cb(desc_index);
+    #endif
+      TU_ASSERT(desc_str, NULL);
+      return desc_str;
+    }
 
     case TUSB_DESC_DEVICE_QUALIFIER:
       // TODO If not highspeed capable stall this request otherwise
       // return the descriptor that could work in highspeed
-      return false;
+      return NULL;
+
+    default: return NULL;
+  }
+}
+
+// Transfer descriptor with length of its type
+static bool xfer_descriptor(uint8_t rhport, tusb_control_request_t const * p_request, void const* desc)
+{
+  uint8_t const* p_desc = (uint8_t const*) desc;
+  uint16_t len;
+
+  switch ( tu_u16_high(p_request->wValue) )
+  {
+    case TUSB_DESC_DEVICE:
+      len = sizeof(tusb_desc_device_t);
+    break;
+
+    case TUSB_DESC_BOS:
+    case TUSB_DESC_CONFIGURATION:
+      // wTotalLength is at the same offset, possibly mis-aligned memory
+      len = tu_u16(p_desc[3], p_desc[2]);
     break;
 
-    default: return false;
+    default:
+      // first byte of descriptor is its size e.g string
+      len = p_desc[0];
+    break;
+  }
+
+  return tud_control_xfer(rhport, p_request, (void*) (uintptr_t) desc, len);
+}
+
+static bool process_get_descriptor(uint8_t rhport, tusb_control_request_t const * p_request)
+{
+  void const* desc = get_descriptor(p_request);
+
+#if CFG_TUD_DESC_ASYNC
+  if ( desc == TUD_DESC_PENDING )
+  {
+    // data stage is NAKed until tud_descriptor_reply()
+    usbd_device_t* p_dev = get_device(rhport);
+    p_dev->desc_request = *p_request;
+    p_dev->desc_pending = true;
+    return true;
   }
+#endif
+
+  TU_VERIFY(desc);
+  return xfer_descriptor(rhport, p_request, desc);
+}
+
+#if CFG_TUD_DESC_ASYNC
+static void desc_reply_task(void* param)
+{
+  uint8_t const rhport = (uint8_t) (uintptr_t) param;
+  usbd_device_t* p_dev = get_device(rhport);
+
+  // dropped by another setup or bus reset meanwhile
+  if ( !p_dev->desc_pending ) return;
+  p_dev->desc_pending = false;
+
+  void const* desc = p_dev->desc_reply;
+  if ( !desc || !xfer_descriptor(rhport, &p_dev->desc_request, desc) )
+  {
+    TU_LOG1("  Stall EP0\r\n");
+    dcd_edpt_stall(rhport, 0);
+    dcd_edpt_stall(rhport, 0 | TUSB_DIR_IN_MASK);
+  }
+}
+
+bool tud_descriptor_reply(uint8_t rhport, void const* desc, bool in_isr)
+{
+  usbd_device_t* p_dev = get_device(rhport);
+  TU_VERIFY(p_dev->desc_pending);
+
+  // transferred by tud_task, same as other control requests
+  p_dev->desc_reply = desc;
+  usbd_defer_func(desc_reply_task, (void*) (uintptr_t) rhport, in_isr);
 
   return true;
 }
+#endif
 
 //--------------------------------------------------------------------+
 // DCD Event Handler
 //--------------------------------------------------------------------+
-void dcd_event_handler(dcd_event_t const * event, bool in_isr)
+
+// IN transfer of exact multiple of packet size is ended by ZLP before its completion is reported
+// (usbd_edpt_zlp). Return false if completion is held meanwhile, it is then reported with the
+// length of the transfer once ZLP is sent.
+static TU_ATTR_FAST_FUNC bool edpt_zlp_isr(dcd_event_t* event)
+{
+  uint8_t const ep_addr = event->xfer_complete.ep_addr;
+  uint8_t const epnum   = tu_edpt_number(ep_addr);
+  usbd_device_t* p_dev  = get_device(event->rhport);
+
+  if ( tu_edpt_dir(ep_addr) != TUSB_DIR_IN || !p_dev->zlp_mps[epnum] ) return true;
+
+  if ( p_dev->ep_status[epnum][TUSB_DIR_IN].zlp )
+  {
+    p_dev->ep_status[epnum][TUSB_DIR_IN].zlp = false;
+    event->xfer_complete.len = p_dev->zlp_len[epnum];
+    return true;
+  }
+
+  uint32_t const len = event->xfer_complete.len;
+  if ( event->xfer_complete.result != XFER_RESULT_SUCCESS || !len || (len % p_dev->zlp_mps[epnum]) ) return true;
+
+  // reported right away if ZLP can't be started, host then completes its read with next transfer
+  TU_VERIFY( dcd_edpt_xfer(event->rhport, ep_addr, NULL, 0) );
+
+  p_dev->ep_status[epnum][TUSB_DIR_IN].zlp = true;
+  p_dev->zlp_len[epnum] = len;
+
+  return false;
+}
+
+// Transfer complete in ISR context: start next queued transfer and invoke driver's
+// isr callback if any. Return true if event should be forwarded to tud_task.
+static TU_ATTR_FAST_FUNC bool edpt_xfer_complete_isr(dcd_event_t const * event)
+{
+  uint8_t const ep_addr = event->xfer_complete.ep_addr;
+  uint8_t const epnum   = tu_edpt_number(ep_addr);
+  uint8_t const dir     = tu_edpt_dir(ep_addr);
+  usbd_device_t* p_dev  = get_device(event->rhport);
+
+  if ( epnum == 0 ) return true;
+
+  bool next_started = false;
+
+#if CFG_TUD_EDPT_XFER_QUEUE
+  // keep the pipe running: submit next queued transfer right away
+  usbd_xfer_queue_t* xq = &p_dev->xfer_q[epnum][dir];
+
+  if ( xq->count && event->xfer_complete.result == XFER_RESULT_SUCCESS )
+  {
+    usbd_xfer_t const* xfer = &xq->xfer[xq->rd_idx];
+
+    stats_xfer_submit(event->rhport, ep_addr, xfer->total_bytes);
+    if ( dcd_edpt_xfer(event->rhport, ep_addr, xfer->buffer, xfer->total_bytes) )
+    {
+      xq->rd_idx = (uint8_t) ((xq->rd_idx + 1) % CFG_TUD_EDPT_XFER_QUEUE);
+      xq->count--;
+      next_started = true;
+    }
+  }
+#endif
+
+  uint8_t const drv_id = p_dev->ep2drv[epnum][dir];
+
+  if ( drv_id < TOTAL_DRIVER_COUNT && get_driver(drv_id)->xfer_isr_cb )
+  {
+    // endpoint is ready so that isr callback can re-arm it
+    if ( !next_started ) p_dev->ep_status[epnum][dir].busy = false;
+
+    if ( get_driver(drv_id)->xfer_isr_cb(event->rhport, ep_addr, (xfer_result_t) event->xfer_complete.result, event->xfer_complete.len) )
+    {
+      return false; // fully handled in isr
+    }
+
+    // deferred to tud_task, which will clear busy later
+    p_dev->ep_status[epnum][dir].busy = true;
+  }
+
+#if CFG_TUD_EDPT_XFER_QUEUE
+  if ( next_started ) xq->chained++;
+#endif
+
+  return true;
+}
+
+// Queue bus/control event, into priority queue if enabled
+static TU_ATTR_FAST_FUNC void queue_prio_event(dcd_event_t const * event, bool in_isr)
+{
+#if CFG_TUD_TASK_PRIO_QUEUE_SZ
+  // task context producer is serialized against isr with usb interrupt disabled
+  if ( !in_isr ) dcd_int_disable(event->rhport);
+  bool const success = tu_fifo_write(&_usbd_prio_ff[USBD_RHPORT_IDX(event->rhport)], event);
+  if ( !in_isr ) dcd_int_enable(event->rhport);
+
+  TU_ASSERT(success,);
+
+  #if CFG_TUSB_OS != OPT_OS_NONE
+  // wake up tud_task blocked on data queue, it may fail if task is already busy draining it
+  dcd_event_t const wakeup = { .rhport = event->rhport, .event_id = USBD_EVENT_FUNC_CALL };
+  osal_queue_send(_usbd_q, &wakeup, in_isr);
+  #endif
+#else
+  osal_queue_send(_usbd_q, event, in_isr);
+#endif
+}
+
+#if CFG_TUD_TASK_DEFER_QUEUE_SZ
+// Queue function call into defer ring
+static TU_ATTR_FAST_FUNC void queue_defer_call(dcd_event_t const * event, bool in_isr)
+{
+  TU_VERIFY(event->func_call.func,);
+  usbd_defer_t const call = { .func = event->func_call.func, .param = event->func_call.param };
+
+  // task context producer is serialized against isr with usb interrupt disabled,
+  // with 2 device ports isr of one port can also preempt the other one.
+  bool const need_lock = !in_isr || (TUD_OPT_RHPORT_COUNT > 1);
+
+  if ( need_lock )
+  {
+    dcd_int_disable(TUD_OPT_RHPORT);
+  #if TUD_OPT_RHPORT_COUNT > 1
+    dcd_int_disable(1);
+  #endif
+  }
+
+  bool const success = tu_fifo_write(&_usbd_defer_ff, &call);
+
+  if ( need_lock )
+  {
+    dcd_int_enable(TUD_OPT_RHPORT);
+  #if TUD_OPT_RHPORT_COUNT > 1
+    dcd_int_enable(1);
+  #endif
+  }
+
+  TU_ASSERT(success,);
+
+  #if CFG_TUSB_OS != OPT_OS_NONE
+  // wake up tud_task blocked on data queue, it may fail if task is already busy draining it
+  dcd_event_t const wakeup = { .rhport = event->rhport, .event_id = USBD_EVENT_FUNC_CALL };
+  osal_queue_send(_usbd_q, &wakeup, in_isr);
+  #endif
+}
+#endif
+
+// Queue data transfer completion, coalesced per endpoint if enabled
+static TU_ATTR_FAST_FUNC void queue_xfer_event(dcd_event_t const * event, bool in_isr)
 {
+#if CFG_TUD_TASK_EVENT_COALESCE
+  uint8_t const epnum = tu_edpt_number(event->xfer_complete.ep_addr);
+  uint8_t const dir   = tu_edpt_dir(event->xfer_complete.ep_addr);
+  uint16_t const bit  = (uint16_t) TU_BIT(epnum*2 + dir);
+  usbd_coalesce_t* coalesce = &_usbd_coalesce[USBD_RHPORT_IDX(event->rhport)];
+
+  bool queue_full_event = false;
+  bool queue_pending    = false;
+
+  if ( !in_isr ) dcd_int_disable(event->rhport);
+
+  if ( coalesce->xfer_bitmap & bit )
+  {
+    // previous completion of this endpoint is not processed yet (e.g queued transfer),
+    // queue it as normal event which is processed after the pending one.
+    queue_full_event = true;
+  }
+  else
+  {
+    coalesce->xfer[epnum][dir].len    = event->xfer_complete.len;
+    coalesce->xfer[epnum][dir].result = event->xfer_complete.result;
+    coalesce->xfer_bitmap |= bit;
+  }
+
+  // also when queueing full event: pending event could not be queued before (queue was full),
+  // it must be ahead so that stored completion is processed first
+  if ( !coalesce->xfer_event )
+  {
+    coalesce->xfer_event = true;
+    queue_pending = true;
+  }
+
+  if ( !in_isr ) dcd_int_enable(event->rhport);
+
+  if ( queue_pending )
+  {
+    dcd_event_t const pending = { .rhport = event->rhport, .event_id = USBD_EVENT_XFER_PENDING };
+
+    // retry with next completion if queue is full
+    if ( !osal_queue_send(_usbd_q, &pending, in_isr) ) coalesce->xfer_event = false;
+  }
+
+  if ( queue_full_event )
+  {
+    osal_queue_send(_usbd_q, event, in_isr);
+  }
+#else
+  osal_queue_send(_usbd_q, event, in_isr);
+#endif
+}
+
+TU_ATTR_FAST_FUNC void dcd_event_isr_exit(uint8_t rhport)
+{
+  (void) rhport;
+  TU_TRACE(TU_TRACE_ISR_EXIT, rhport, 0);
+  osal_isr_yield();
+}
+
+TU_ATTR_FAST_FUNC void dcd_event_handler(dcd_event_t const * event, bool in_isr)
+{
+  usbd_device_t* p_dev = get_device(event->rhport);
+#if CFG_TUD_TASK_EVENT_COALESCE
+  usbd_coalesce_t* coalesce = &_usbd_coalesce[USBD_RHPORT_IDX(event->rhport)];
+#endif
+
+  TU_TRACE(TU_TRACE_EVENT_QUEUE, event->rhport, event->event_id);
+
   switch (event->event_id)
   {
     case DCD_EVENT_BUS_RESET:
-      osal_queue_send(_usbd_q, event, in_isr);
+      profile_bus_reset_isr(event->rhport);
+      queue_prio_event(event, in_isr);
     break;
 
     case DCD_EVENT_UNPLUGGED:
-      _usbd_dev.connected = 0;
-      _usbd_dev.configured = 0;
-      _usbd_dev.suspended = 0;
-      osal_queue_send(_usbd_q, event, in_isr);
+      p_dev->connected = 0;
+      p_dev->configured = 0;
+      p_dev->suspended = 0;
+      p_dev->lpm_sleep = 0;
+      queue_prio_event(event, in_isr);
     break;
 
     case DCD_EVENT_SOF:
-      // nothing to do now
+      p_dev->sof_count++;
+
+      // latch timestamp before anything else so that it is as close as possible to SOF
+      if ( tud_sof_isr_cb )
+      {
+        uint32_t const timestamp = CFG_TUD_SOF_TIMESTAMP();
+        tud_sof_isr_cb(event->rhport, tud_n_frame_number(event->rhport), timestamp);
+      }
+
+      // queue at most one SOF event, i.e drivers are notified of at least one elapsed frame
+      if ( (_usbd_sof_app || _usbd_sof_users[USBD_RHPORT_IDX(event->rhport)]) && !p_dev->sof_pending )
+      {
+        p_dev->sof_pending = true;
+        if ( !osal_queue_send(_usbd_q, event, in_isr) ) p_dev->sof_pending = false;
+      }
     break;
 
     case DCD_EVENT_SUSPEND:
       // NOTE: When plugging/unplugging device, the D+/D- state are unstable and can accidentally meet the
       // SUSPEND condition ( Idle for 3ms ). Some MCUs such as SAMD doesn't distinguish suspend vs disconnect as well.
       // We will skip handling SUSPEND/RESUME event if not currently connected
-      if ( _usbd_dev.connected )
+      if ( p_dev->connected )
       {
-        _usbd_dev.suspended = 1;
-        osal_queue_send(_usbd_q, event, in_isr);
+        p_dev->suspended = 1;
+#if CFG_TUD_TASK_EVENT_COALESCE
+        if ( coalesce->suspend ) break;
+        coalesce->suspend = true;
+#endif
+        queue_prio_event(event, in_isr);
       }
     break;
 
     case DCD_EVENT_RESUME:
-      if ( _usbd_dev.connected )
+      if ( p_dev->connected )
+      {
+        p_dev->suspended = 0;
+#if CFG_TUD_TASK_EVENT_COALESCE
+        if ( coalesce->resume ) break;
+        coalesce->resume = true;
+#endif
+        queue_prio_event(event, in_isr);
+      }
+    break;
+
+    // L1 is only entered once per host access burst, not coalesced
+    case DCD_EVENT_LPM_SLEEP:
+      if ( p_dev->connected )
+      {
+        p_dev->lpm_sleep         = 1;
+        p_dev->lpm_remote_wakeup = event->lpm_sleep.remote_wakeup ? 1 : 0;
+        queue_prio_event(event, in_isr);
+      }
+    break;
+
+    case DCD_EVENT_LPM_RESUME:
+      if ( p_dev->lpm_sleep )
       {
-        _usbd_dev.suspended = 0;
-        osal_queue_send(_usbd_q, event, in_isr);
+        p_dev->lpm_sleep = 0;
+        queue_prio_event(event, in_isr);
       }
     break;
 
     case DCD_EVENT_SETUP_RECEIVED:
-      osal_queue_send(_usbd_q, event, in_isr);
+      profile_milestone(event->rhport, TUD_ENUM_FIRST_SETUP);
+      queue_prio_event(event, in_isr);
     break;
 
     case DCD_EVENT_XFER_COMPLETE:
-      osal_queue_send(_usbd_q, event, in_isr);
+      if ( 0 == tu_edpt_number(event->xfer_complete.ep_addr) )
+      {
+        // control endpoint must stay in order with SETUP
+        queue_prio_event(event, in_isr);
+      }
+      else
+      {
+        dcd_event_t xfer_event = *event;
+        if ( !edpt_zlp_isr(&xfer_event) ) break;
+
+        // accounted before next queued transfer is submitted
+        stats_xfer_complete_isr(&xfer_event);
+        if ( edpt_xfer_complete_isr(&xfer_event) ) queue_xfer_event(&xfer_event, in_isr);
+      }
       TU_ASSERT(event->xfer_complete.result == XFER_RESULT_SUCCESS,);
     break;
 
     // Not an DCD event, just a convenient way to defer ISR function should we need to
     case USBD_EVENT_FUNC_CALL:
+#if CFG_TUD_TASK_DEFER_QUEUE_SZ
+      queue_defer_call(event, in_isr);
+#else
       osal_queue_send(_usbd_q, event, in_isr);
+#endif
     break;
 
     default: break;
   }
 }
 
-void dcd_event_bus_signal (uint8_t rhport, dcd_eventid_t eid, bool in_isr)
+TU_ATTR_FAST_FUNC void dcd_event_bus_signal (uint8_t rhport, dcd_eventid_t eid, bool in_isr)
 {
   dcd_event_t event = { .rhport = rhport, .event_id = eid, };
   dcd_event_handler(&event, in_isr);
 }
 
-void dcd_event_setup_received(uint8_t rhport, uint8_t const * setup, bool in_isr)
+TU_ATTR_FAST_FUNC void dcd_event_setup_received(uint8_t rhport, uint8_t const * setup, bool in_isr)
 {
   dcd_event_t event = { .rhport = rhport, .event_id = DCD_EVENT_SETUP_RECEIVED };
   memcpy(&event.setup_received, setup, 8);
@@ -897,7 +2552,17 @@ void dcd_event_setup_received(uint8_t rhport, uint8_t const * setup, bool in_isr
   dcd_event_handler(&event, in_isr);
 }
 
-void dcd_event_xfer_complete (uint8_t rhport, uint8_t ep_addr, uint32_t xferred_bytes, uint8_t result, bool in_isr)
+TU_ATTR_FAST_FUNC void dcd_event_lpm_sleep (uint8_t rhport, uint8_t besl, bool remote_wakeup, bool in_isr)
+{
+  dcd_event_t event = { .rhport = rhport, .event_id = DCD_EVENT_LPM_SLEEP };
+
+  event.lpm_sleep.besl          = besl;
+  event.lpm_sleep.remote_wakeup = remote_wakeup ? 1 : 0;
+
+  dcd_event_handler(&event, in_isr);
+}
+
+TU_ATTR_FAST_FUNC void dcd_event_xfer_complete (uint8_t rhport, uint8_t ep_addr, uint32_t xferred_bytes, uint8_t result, bool in_isr)
 {
   dcd_event_t event = { .rhport = rhport, .event_id = DCD_EVENT_XFER_COMPLETE };
 
@@ -912,6 +2577,29 @@ void dcd_event_xfer_complete (uint8_t rhport, uint8_t ep_addr, uint32_t xferred_
 // Helper
 //--------------------------------------------------------------------+
 
+uint8_t usbd_itf_inst(uint8_t rhport, uint8_t itf_num)
+{
+  usbd_device_t* p_dev = get_device(rhport);
+  return (itf_num < TU_ARRAY_SIZE(p_dev->itf2inst)) ? p_dev->itf2inst[itf_num] : USBD_INST_INVALID;
+}
+
+uint8_t usbd_edpt_inst(uint8_t rhport, uint8_t ep_addr)
+{
+  return get_device(rhport)->ep2inst[tu_edpt_number(ep_addr)][tu_edpt_dir(ep_addr)];
+}
+
+void usbd_dcd_caps(uint8_t rhport, dcd_caps_t* caps)
+{
+  tu_memclr(caps, sizeof(dcd_caps_t));
+  caps->max_xfer_bytes = CFG_TUD_ENDPOINT0_SIZE;
+  caps->speed          = TUSB_SPEED_FULL;
+
+  if ( dcd_get_caps ) dcd_get_caps(rhport, caps);
+
+  caps->xfer_append = (dcd_edpt_xfer_append != NULL);
+  caps->xfer_sg     = (dcd_edpt_xfer_sg != NULL);
+}
+
 // Parse consecutive endpoint descriptors (IN & OUT)
 bool usbd_open_edpt_pair(uint8_t rhport, uint8_t const* p_desc, uint8_t ep_count, uint8_t xfer_type, uint8_t* ep_out, uint8_t* ep_in)
 {
@@ -936,6 +2624,59 @@ bool usbd_open_edpt_pair(uint8_t rhport, uint8_t const* p_desc, uint8_t ep_count
   return true;
 }
 
+bool tud_task_wakeup (bool in_isr)
+{
+  // empty function call is a no-op for tud_task
+  dcd_event_t const event = { .rhport = TUD_OPT_RHPORT, .event_id = USBD_EVENT_FUNC_CALL };
+  return osal_queue_send(_usbd_q, &event, in_isr);
+}
+
+#if CFG_TUD_SPLIT_CORE
+static volatile bool _split_pending;
+
+static void split_doorbell(void* param)
+{
+  (void) param;
+
+  // doorbell rung from now on queues another pass
+  _split_pending = false;
+
+  for (uint8_t i = 0; i < TOTAL_DRIVER_COUNT; i++)
+  {
+    if ( get_driver(i)->doorbell ) get_driver(i)->doorbell(TUD_OPT_RHPORT);
+  }
+}
+
+void tud_split_doorbell_isr (void)
+{
+  if ( _split_pending ) return;
+
+  _split_pending = true;
+  usbd_defer_func(split_doorbell, NULL, true);
+}
+#endif
+
+void usbd_sof_enable(uint8_t rhport, bool en)
+{
+  uint8_t* users = &_usbd_sof_users[USBD_RHPORT_IDX(rhport)];
+
+  // isr must not queue SOF with count half way updated
+  dcd_int_disable(rhport);
+
+  if ( en )
+  {
+    (*users)++;
+    if ( 1 == *users && dcd_sof_enable && !sof_always() ) dcd_sof_enable(rhport, true);
+  }
+  else if ( *users )
+  {
+    (*users)--;
+    if ( 0 == *users && dcd_sof_enable && !sof_always() ) dcd_sof_enable(rhport, false);
+  }
+
+  dcd_int_enable(rhport);
+}
+
 // Helper to defer an isr function
 void usbd_defer_func(osal_task_func_t func, void* param, bool in_isr)
 {
@@ -951,59 +2692,368 @@ void usbd_defer_func(osal_task_func_t func, void* param, bool in_isr)
   dcd_event_handler(&event, in_isr);
 }
 
+#if CFG_TUD_EP_POOL_COUNT
+uint8_t* usbd_ep_buf_alloc(void)
+{
+  uint8_t* buf = NULL;
+
+#if CFG_FIFO_MUTEX
+  osal_mutex_lock(_usbd_pool_mutex, OSAL_TIMEOUT_WAIT_FOREVER);
+#endif
+
+  if ( _usbd_pool_free_count )
+  {
+    _usbd_pool_free_count--;
+    buf = _usbd_pool_buf[_usbd_pool_free[_usbd_pool_free_count]];
+  }
+
+#if CFG_FIFO_MUTEX
+  osal_mutex_unlock(_usbd_pool_mutex);
+#endif
+
+  return buf;
+}
+
+void usbd_ep_buf_free(uint8_t* buf)
+{
+  uint32_t const offset = (uint32_t) (buf - _usbd_pool_buf[0]);
+  TU_ASSERT( (offset % CFG_TUD_EP_POOL_BUFSIZE) == 0 && (offset / CFG_TUD_EP_POOL_BUFSIZE) < CFG_TUD_EP_POOL_COUNT, );
+
+#if CFG_FIFO_MUTEX
+  osal_mutex_lock(_usbd_pool_mutex, OSAL_TIMEOUT_WAIT_FOREVER);
+#endif
+
+  _usbd_pool_free[_usbd_pool_free_count++] = (uint8_t) (offset / CFG_TUD_EP_POOL_BUFSIZE);
+
+#if CFG_FIFO_MUTEX
+  osal_mutex_unlock(_usbd_pool_mutex);
+#endif
+}
+#endif
+
 //--------------------------------------------------------------------+
 // USBD Endpoint API
 //--------------------------------------------------------------------+
 
-bool usbd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint16_t total_bytes)
+// Called by tud_task when processing a transfer complete event.
+// Return true if endpoint becomes idle, false if another transfer is already on going.
+static bool edpt_xfer_complete(uint8_t rhport, uint8_t ep_addr)
 {
+#if CFG_TUD_EDPT_XFER_QUEUE
   uint8_t const epnum = tu_edpt_number(ep_addr);
   uint8_t const dir   = tu_edpt_dir(ep_addr);
+  usbd_xfer_queue_t* xq = &get_device(rhport)->xfer_q[epnum][dir];
+  bool idle = true;
+
+  if ( epnum == 0 ) return true;
+
+  dcd_int_disable(rhport);
 
+  if ( xq->chained )
+  {
+    // next transfer is submitted by isr already
+    xq->chained--;
+    idle = false;
+  }
+  else if ( xq->count )
+  {
+    // queued after isr had seen this completion
+    usbd_xfer_t const* xfer = &xq->xfer[xq->rd_idx];
+
+    stats_xfer_submit(rhport, ep_addr, xfer->total_bytes);
+    if ( dcd_edpt_xfer(rhport, ep_addr, xfer->buffer, xfer->total_bytes) )
+    {
+      xq->rd_idx = (uint8_t) ((xq->rd_idx + 1) % CFG_TUD_EDPT_XFER_QUEUE);
+      xq->count--;
+      idle = false;
+    }
+  }
+
+  dcd_int_enable(rhport);
+
+  return idle;
+#else
+  (void) rhport;
+  (void) ep_addr;
+  return true;
+#endif
+}
+
+TU_ATTR_FAST_FUNC bool usbd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint32_t total_bytes)
+{
+  usbd_device_t* p_dev = get_device(rhport);
+  uint8_t const epnum = tu_edpt_number(ep_addr);
+  uint8_t const dir   = tu_edpt_dir(ep_addr);
+
+  TU_TRACE(TU_TRACE_XFER_SUBMIT, rhport, ep_addr);
+
+#if CFG_TUD_EDPT_XFER_QUEUE
+  if ( epnum && p_dev->ep_status[epnum][dir].busy && !p_dev->ep_status[epnum][dir].stalled )
+  {
+    usbd_xfer_queue_t* xq = &p_dev->xfer_q[epnum][dir];
+    bool ret = false;
+
+    dcd_int_disable(rhport);
+
+    // re-check since completion could be processed meanwhile
+    if ( !p_dev->ep_status[epnum][dir].busy )
+    {
+      stats_xfer_submit(rhport, ep_addr, total_bytes);
+      ret = dcd_edpt_xfer(rhport, ep_addr, buffer, total_bytes);
+      if ( ret ) p_dev->ep_status[epnum][dir].busy = true;
+    }
+    else if ( !xq->count && !(dir == TUSB_DIR_IN && p_dev->zlp_mps[epnum]) &&
+              dcd_edpt_xfer_append && dcd_edpt_xfer_append(rhport, ep_addr, buffer, total_bytes) )
+    {
+      // linked by controller, its completion is handled as if started by isr
+      xq->chained++;
+      ret = true;
+    }
+    else if ( xq->count < CFG_TUD_EDPT_XFER_QUEUE )
+    {
+      usbd_xfer_t* xfer = &xq->xfer[(xq->rd_idx + xq->count) % CFG_TUD_EDPT_XFER_QUEUE];
+      xfer->buffer      = buffer;
+      xfer->total_bytes = total_bytes;
+      xq->count++;
+      ret = true;
+    }
+
+    dcd_int_enable(rhport);
+
+    return ret;
+  }
+#endif
+
+  // recorded before submitting since transfer can complete right away
+  stats_xfer_submit(rhport, ep_addr, total_bytes);
   TU_VERIFY( dcd_edpt_xfer(rhport, ep_addr, buffer, total_bytes) );
-  _usbd_dev.ep_status[epnum][dir].busy = true;
+  p_dev->ep_status[epnum][dir].busy = true;
 
   return true;
 }
 
-bool usbd_edpt_busy(uint8_t rhport, uint8_t ep_addr)
+// Release bounce buffer if used by this endpoint, received data is scattered into segments
+static void edpt_xfer_sg_complete(uint8_t rhport, uint8_t ep_addr, uint32_t xferred_bytes)
 {
+#if CFG_TUD_EDPT_XFER_SG_BUFSIZE
+  if ( !(_usbd_sg.segs && _usbd_sg.rhport == rhport && _usbd_sg.ep_addr == ep_addr) ) return;
+
+  if ( tu_edpt_dir(ep_addr) == TUSB_DIR_OUT )
+  {
+    uint8_t const* src = _usbd_sg_buf;
+    for(uint8_t i=0; i<_usbd_sg.count && xferred_bytes; i++)
+    {
+      uint32_t const n = tu_min32(_usbd_sg.segs[i].len, xferred_bytes);
+      tu_memcpy(_usbd_sg.segs[i].buffer, src, n);
+      src           += n;
+      xferred_bytes -= n;
+    }
+  }
+
+  tu_varclr(&_usbd_sg);
+#else
   (void) rhport;
+  (void) ep_addr;
+  (void) xferred_bytes;
+#endif
+}
+
+bool usbd_edpt_xfer_sg(uint8_t rhport, uint8_t ep_addr, xfer_seg_t const * segs, uint8_t count)
+{
+  TU_ASSERT(segs && count);
+
+  // nothing to chain
+  if ( count == 1 ) return usbd_edpt_xfer(rhport, ep_addr, segs[0].buffer, segs[0].len);
 
+  usbd_device_t* p_dev = get_device(rhport);
   uint8_t const epnum = tu_edpt_number(ep_addr);
   uint8_t const dir   = tu_edpt_dir(ep_addr);
 
-  return _usbd_dev.ep_status[epnum][dir].busy;
+  TU_ASSERT(epnum); // control endpoint is managed by usbd_control
+  TU_VERIFY(!p_dev->ep_status[epnum][dir].busy);
+
+#if CFG_TUD_STATS
+  uint32_t sg_bytes = 0;
+  for(uint8_t i=0; i<count; i++) sg_bytes += segs[i].len;
+  stats_xfer_submit(rhport, ep_addr, sg_bytes);
+#endif
+
+  if ( dcd_edpt_xfer_sg && dcd_edpt_xfer_sg(rhport, ep_addr, segs, count) )
+  {
+    p_dev->ep_status[epnum][dir].busy = true;
+    return true;
+  }
+
+#if CFG_TUD_EDPT_XFER_SG_BUFSIZE
+  TU_VERIFY(_usbd_sg.segs == NULL); // bounce buffer is in use
+
+  uint32_t total_bytes = 0;
+  for(uint8_t i=0; i<count; i++) total_bytes += segs[i].len;
+  TU_ASSERT(total_bytes <= CFG_TUD_EDPT_XFER_SG_BUFSIZE);
+
+  if ( dir == TUSB_DIR_IN )
+  {
+    uint8_t* dst = _usbd_sg_buf;
+    for(uint8_t i=0; i<count; i++)
+    {
+      tu_memcpy(dst, segs[i].buffer, segs[i].len);
+      dst += segs[i].len;
+    }
+  }
+
+  _usbd_sg.segs    = segs;
+  _usbd_sg.count   = count;
+  _usbd_sg.rhport  = rhport;
+  _usbd_sg.ep_addr = ep_addr;
+
+  if ( !usbd_edpt_xfer(rhport, ep_addr, _usbd_sg_buf, total_bytes) )
+  {
+    tu_varclr(&_usbd_sg);
+    return false;
+  }
+
+  return true;
+#else
+  return false;
+#endif
+}
+
+void usbd_edpt_zlp(uint8_t rhport, tusb_desc_endpoint_t const * desc_ep)
+{
+  usbd_device_t* p_dev  = get_device(rhport);
+  uint8_t const ep_addr = desc_ep->bEndpointAddress;
+  uint8_t const epnum   = tu_edpt_number(ep_addr);
+
+  TU_ASSERT(epnum && tu_edpt_dir(ep_addr) == TUSB_DIR_IN && desc_ep->bmAttributes.xfer != TUSB_XFER_ISOCHRONOUS, );
+
+  if ( dcd_edpt_auto_zlp && dcd_edpt_auto_zlp(rhport, ep_addr) ) return;
+
+  p_dev->zlp_mps[epnum] = desc_ep->wMaxPacketSize.size;
+}
+
+bool usbd_edpt_busy(uint8_t rhport, uint8_t ep_addr)
+{
+  usbd_device_t* p_dev = get_device(rhport);
+  uint8_t const epnum = tu_edpt_number(ep_addr);
+  uint8_t const dir   = tu_edpt_dir(ep_addr);
+
+  return p_dev->ep_status[epnum][dir].busy;
 }
 
 void usbd_edpt_stall(uint8_t rhport, uint8_t ep_addr)
 {
+  usbd_device_t* p_dev = get_device(rhport);
   uint8_t const epnum = tu_edpt_number(ep_addr);
   uint8_t const dir   = tu_edpt_dir(ep_addr);
 
   dcd_edpt_stall(rhport, ep_addr);
-  _usbd_dev.ep_status[epnum][dir].stalled = true;
-  _usbd_dev.ep_status[epnum][dir].busy = true;
+  p_dev->ep_status[epnum][dir].stalled = true;
+  p_dev->ep_status[epnum][dir].busy = true;
+
+#if CFG_TUD_STATS
+  if ( epnum ) get_stats(rhport, ep_addr)->stats.stall_count++;
+#endif
 }
 
 void usbd_edpt_clear_stall(uint8_t rhport, uint8_t ep_addr)
 {
+  usbd_device_t* p_dev = get_device(rhport);
   uint8_t const epnum = tu_edpt_number(ep_addr);
   uint8_t const dir   = tu_edpt_dir(ep_addr);
 
   dcd_edpt_clear_stall(rhport, ep_addr);
-  _usbd_dev.ep_status[epnum][dir].stalled = false;
-  _usbd_dev.ep_status[epnum][dir].busy = false;
+  p_dev->ep_status[epnum][dir].stalled = false;
+  p_dev->ep_status[epnum][dir].busy = false;
+  p_dev->ep_status[epnum][dir].zlp = false;
+
+#if CFG_TUD_EDPT_XFER_QUEUE
+  // transfers queued before stall are dropped
+  tu_varclr(&get_device(rhport)->xfer_q[epnum][dir]);
+#endif
 }
 
 bool usbd_edpt_stalled(uint8_t rhport, uint8_t ep_addr)
 {
-  (void) rhport;
-
+  usbd_device_t* p_dev = get_device(rhport);
   uint8_t const epnum = tu_edpt_number(ep_addr);
   uint8_t const dir   = tu_edpt_dir(ep_addr);
 
-  return _usbd_dev.ep_status[epnum][dir].stalled;
+  return p_dev->ep_status[epnum][dir].stalled;
+}
+
+#if CFG_TUD_STATS
+bool tud_stats_get(uint8_t rhport, uint8_t ep_addr, tud_stats_t* stats)
+{
+  uint8_t const epnum = tu_edpt_number(ep_addr);
+  TU_VERIFY(USBD_RHPORT_IDX(rhport) < TUD_OPT_RHPORT_COUNT && epnum < 8);
+
+  // consistent copy, counters are updated in ISR
+  dcd_int_disable(rhport);
+  (*stats) = get_stats(rhport, ep_addr)->stats;
+  dcd_int_enable(rhport);
+
+  return true;
 }
 
+void tud_stats_reset(uint8_t rhport)
+{
+  TU_VERIFY(USBD_RHPORT_IDX(rhport) < TUD_OPT_RHPORT_COUNT,);
+
+  dcd_int_disable(rhport);
+  for(uint8_t epnum=0; epnum<8; epnum++)
+  {
+    tu_varclr(&_usbd_stats[USBD_RHPORT_IDX(rhport)][epnum][0].stats);
+    tu_varclr(&_usbd_stats[USBD_RHPORT_IDX(rhport)][epnum][1].stats);
+  }
+  dcd_int_enable(rhport);
+}
+#endif
+
+#if CFG_TUD_ENUM_PROFILE
+bool tud_enum_profile_get(uint8_t rhport, tud_enum_profile_t* profile)
+{
+  TU_VERIFY(USBD_RHPORT_IDX(rhport) < TUD_OPT_RHPORT_COUNT);
+
+  // consistent copy, bus reset and first SETUP are taken in ISR
+  dcd_int_disable(rhport);
+  (*profile) = _usbd_profile[USBD_RHPORT_IDX(rhport)].enum_profile;
+  dcd_int_enable(rhport);
+
+  return true;
+}
+
+bool tud_req_profile_get(uint8_t rhport, uint8_t index, tud_req_profile_t* profile)
+{
+  TU_VERIFY(USBD_RHPORT_IDX(rhport) < TUD_OPT_RHPORT_COUNT && index < TUD_REQ_PROFILE_COUNT);
+  (*profile) = _usbd_profile[USBD_RHPORT_IDX(rhport)].req[index];
+  return true;
+}
+
+void tud_req_profile_reset(uint8_t rhport)
+{
+  TU_VERIFY(USBD_RHPORT_IDX(rhport) < TUD_OPT_RHPORT_COUNT,);
+  tu_varclr(&_usbd_profile[USBD_RHPORT_IDX(rhport)].req);
+}
+
+void tud_profile_print(uint8_t rhport)
+{
+  tud_enum_profile_t ep;
+  TU_VERIFY(tud_enum_profile_get(rhport, &ep),);
+
+  // milestones not reached are printed as 0
+  TU_LOG1("USBD profile: reset -> setup %lu, address %lu, ", (ep.reached & TUD_ENUM_FIRST_SETUP) ? ep.first_setup : 0UL,
+          (ep.reached & TUD_ENUM_SET_ADDRESS) ? ep.set_address : 0UL);
+  TU_LOG1("config %lu\r\n", (ep.reached & TUD_ENUM_SET_CONFIG) ? ep.set_config : 0UL);
+
+  for(uint8_t i=0; i<TUD_REQ_PROFILE_COUNT; i++)
+  {
+    tud_req_profile_t const* req = &_usbd_profile[USBD_RHPORT_IDX(rhport)].req[i];
+    if ( !req->count ) continue;
+
+    TU_LOG1("  bRequest %u: count %lu, setup avg %lu, ", i, req->count, req->setup_sum / req->count);
+    TU_LOG1("max %lu, xfer avg %lu, max %lu\r\n", req->setup_max, req->xfer_sum / req->count, req->xfer_max);
+  }
+}
+#endif
+
 #endif
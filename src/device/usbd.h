@@ -47,23 +47,156 @@ bool tud_init (void);
 // Task function should be called in main/rtos loop
 void tud_task (void);
 
-// Interrupt handler, name alias to DCD
-#define tud_isr   dcd_isr
+// Process all pending events, waiting at most timeout_ms for the first one (RTOS only,
+// OS None never waits). Return so that caller can do its periodic work in the same task.
+void tud_task_ext (uint32_t timeout_ms);
+
+// Process at most max_events events and for at most max_time (unit of CFG_TUD_TASK_TIMESTAMP(), cpu cycles
+// by default) without waiting, 0 is unlimited. At least one pending event is processed. Return true if
+// budget is exhausted i.e events may remain, caller should then invoke it again soon.
+bool tud_task_budget (uint32_t max_events, uint32_t max_time);
+
+// Wake up tud_task_ext() waiting for events e.g when application has data to flush
+bool tud_task_wakeup (bool in_isr);
+
+#if CFG_TUD_SPLIT_CORE
+// Split mode: called by the IPC interrupt handler of stack core when application core rang the doorbell,
+// class drivers then start transfers for data queued or room freed by application core in tud_task()
+void tud_split_doorbell_isr (void);
+#endif
+
+// Interrupt handler, name alias to DCD. Dual-role port dispatches only in device role
+#if TUSB_OPT_DUAL_ROLE
+#define tud_isr(_rhport)   do { if ( tusb_role_get() == OPT_MODE_DEVICE ) { TU_TRACE(TU_TRACE_ISR_ENTER, _rhport, 0); dcd_isr(_rhport); TU_TRACE(TU_TRACE_ISR_EXIT, _rhport, 0); } osal_isr_yield(); } while(0)
+#else
+#define tud_isr(_rhport)   do { TU_TRACE(TU_TRACE_ISR_ENTER, _rhport, 0); dcd_isr(_rhport); TU_TRACE(TU_TRACE_ISR_EXIT, _rhport, 0); osal_isr_yield(); } while(0)
+#endif
 
 // Check if device is connected and configured
-bool tud_mounted(void);
+bool tud_n_mounted(uint8_t rhport);
+
+static inline bool tud_mounted(void)
+{
+  return tud_n_mounted(TUD_OPT_RHPORT);
+}
 
 // Check if device is suspended
-bool tud_suspended(void);
+bool tud_n_suspended(uint8_t rhport);
+
+static inline bool tud_suspended(void)
+{
+  return tud_n_suspended(TUD_OPT_RHPORT);
+}
 
 // Check if device is ready to transfer
+static inline bool tud_n_ready(uint8_t rhport)
+{
+  return tud_n_mounted(rhport) && !tud_n_suspended(rhport);
+}
+
 static inline bool tud_ready(void)
 {
-  return tud_mounted() && !tud_suspended();
+  return tud_n_ready(TUD_OPT_RHPORT);
+}
+
+// Get 11-bit number of the current USB frame
+uint32_t tud_n_frame_number(uint8_t rhport);
+
+static inline uint32_t tud_frame_number(void)
+{
+  return tud_n_frame_number(TUD_OPT_RHPORT);
 }
 
-// Remote wake up host, only if suspended and enabled by host
-bool tud_remote_wakeup(void);
+// Remote wake up host, only if suspended and enabled by host, or in L1 sleep allowing it
+bool tud_n_remote_wakeup(uint8_t rhport);
+
+// Check if link is in L1 sleep (CFG_TUD_LPM)
+bool tud_n_lpm_sleeping(uint8_t rhport);
+
+static inline bool tud_lpm_sleeping(void)
+{
+  return tud_n_lpm_sleeping(TUD_OPT_RHPORT);
+}
+
+#if CFG_TUD_STATS
+// Statistics of non-control endpoint, kept across bus reset. Time is in CFG_TUD_STATS_TIMESTAMP() unit,
+// average is sum divided by its count.
+typedef struct
+{
+  uint32_t xfer_count;     // transfers completed
+  uint32_t short_count;    // completed with fewer bytes than requested
+  uint32_t error_count;    // completed with failure
+  uint32_t stall_count;    // stalled by device or completed as stalled
+  uint64_t bytes;          // bytes transferred
+
+  uint32_t xfer_time_max;  // from submission to DCD until completion in ISR
+  uint64_t xfer_time_sum;  // of xfer_count transfers
+
+  uint32_t cb_count;       // completions delivered to class driver by tud_task
+  uint32_t cb_time_max;    // from completion in ISR until class driver callback
+  uint64_t cb_time_sum;    // of cb_count callbacks
+}tud_stats_t;
+
+// Get statistics of endpoint, return false if endpoint address is invalid
+bool tud_stats_get(uint8_t rhport, uint8_t ep_addr, tud_stats_t* stats);
+
+// Clear statistics of all endpoints
+void tud_stats_reset(uint8_t rhport);
+#endif
+
+#if CFG_TUD_ENUM_PROFILE
+// Enumeration milestones reached since last bus reset
+enum
+{
+  TUD_ENUM_BUS_RESET   = TU_BIT(0),
+  TUD_ENUM_FIRST_SETUP = TU_BIT(1),
+  TUD_ENUM_SET_ADDRESS = TU_BIT(2),
+  TUD_ENUM_SET_CONFIG  = TU_BIT(3),
+};
+
+// Time is in CFG_TUD_PROFILE_TIMESTAMP() unit, milestones are relative to bus reset
+typedef struct
+{
+  uint32_t bus_reset;      // timestamp of bus reset in ISR
+  uint32_t first_setup;    // first SETUP received in ISR
+  uint32_t set_address;    // SET_ADDRESS handled
+  uint32_t set_config;     // SET_CONFIGURATION handled, class drivers opened
+  uint8_t  reached;        // TUD_ENUM_* bits
+}tud_enum_profile_t;
+
+// Control requests are profiled by standard bRequest, class and vendor requests are counted together
+enum
+{
+  TUD_REQ_PROFILE_CLASS = TUSB_REQ_SYNCH_FRAME + 1,
+  TUD_REQ_PROFILE_VENDOR,
+  TUD_REQ_PROFILE_COUNT
+};
+
+typedef struct
+{
+  uint32_t count;
+  uint32_t setup_max;      // SETUP handling, descriptor and class driver callbacks included
+  uint32_t setup_sum;
+  uint32_t xfer_max;       // data and status stage completions
+  uint32_t xfer_sum;
+}tud_req_profile_t;
+
+bool tud_enum_profile_get(uint8_t rhport, tud_enum_profile_t* profile);
+
+// index is bRequest of standard request or TUD_REQ_PROFILE_CLASS/VENDOR
+bool tud_req_profile_get(uint8_t rhport, uint8_t index, tud_req_profile_t* profile);
+
+// Clear request profiles, enumeration milestones are cleared by bus reset
+void tud_req_profile_reset(uint8_t rhport);
+
+// Print milestones and request profiles with TU_LOG1()
+void tud_profile_print(uint8_t rhport);
+#endif
+
+static inline bool tud_remote_wakeup(void)
+{
+  return tud_n_remote_wakeup(TUD_OPT_RHPORT);
+}
 
 // Carry out Data and Status stage of control transfer
 // - If len = 0, it is equivalent to sending status only
@@ -73,12 +206,86 @@ bool tud_control_xfer(uint8_t rhport, tusb_control_request_t const * request, vo
 // Send STATUS (zero length) packet
 bool tud_control_status(uint8_t rhport, tusb_control_request_t const * request);
 
+#if CFG_TUD_DESC_ASYNC
+// Returned by descriptor callbacks when descriptor is not available yet, e.g being read from external flash.
+// GET_DESCRIPTOR request is then answered by tud_descriptor_reply()
+#define TUD_DESC_PENDING   ((void*) 1)
+
+// Answer GET_DESCRIPTOR request whose callback returned TUD_DESC_PENDING, with descriptor that must exist long
+// enough for transfer to complete or NULL to stall it. Can be called from isr, return false if none is pending.
+// Pending request is dropped when host sends another one (e.g after its timeout) or resets the bus.
+bool tud_descriptor_reply(uint8_t rhport, void const* desc, bool in_isr);
+#endif
+
+//--------------------------------------------------------------------+
+// Configuration Map
+//--------------------------------------------------------------------+
+
+// Built-in class drivers, in order of usbd's driver table. Application drivers are not part of it
+enum
+{
+#if CFG_TUD_CDC
+  TUD_DRIVER_CDC,
+#endif
+#if CFG_TUD_MSC
+  TUD_DRIVER_MSC,
+#endif
+#if CFG_TUD_UAS
+  TUD_DRIVER_UAS,
+#endif
+#if CFG_TUD_HID
+  TUD_DRIVER_HID,
+#endif
+#if CFG_TUD_AUDIO
+  TUD_DRIVER_AUDIO,
+#endif
+#if CFG_TUD_MIDI
+  TUD_DRIVER_MIDI,
+#endif
+#if CFG_TUD_VIDEO
+  TUD_DRIVER_VIDEO,
+#endif
+#if CFG_TUD_VENDOR
+  TUD_DRIVER_VENDOR,
+#endif
+#if CFG_TUD_USBTMC
+  TUD_DRIVER_USBTMC,
+#endif
+#if CFG_TUD_DFU_RT
+  TUD_DRIVER_DFU_RT,
+#endif
+#if CFG_TUD_DFU
+  TUD_DRIVER_DFU,
+#endif
+#if CFG_TUD_NCM
+  TUD_DRIVER_NCM,
+#endif
+#if CFG_TUD_RNDIS
+  TUD_DRIVER_RNDIS,
+#endif
+#if CFG_TUD_BTH
+  TUD_DRIVER_BTH,
+#endif
+#if CFG_TUD_PRINTER
+  TUD_DRIVER_PRINTER,
+#endif
+  TUD_DRIVER_COUNT
+};
+
+// Functions of a configuration and their interfaces/endpoints, generated by TUD_CONFIG_MAP()
+typedef struct
+{
+  uint8_t itf2func[16];   // function of interface number, starting at 1 (0 if not used)
+  uint8_t ep2func[8][2];  // function of endpoint number and direction, starting at 1 (0 if not used)
+  uint8_t func2drv[16];   // built-in driver of function, indexed by function - 1
+}tud_config_map_t;
+
 //--------------------------------------------------------------------+
 // Application Callbacks (WEAK is optional)
 //--------------------------------------------------------------------+
 
 // Invoked when received GET DEVICE DESCRIPTOR request
-// Application return pointer to descriptor
+// Application return pointer to descriptor (or TUD_DESC_PENDING with CFG_TUD_DESC_ASYNC, same for others)
 uint8_t const * tud_descriptor_device_cb(void);
 
 // Invoked when received GET BOS DESCRIPTOR request
@@ -86,12 +293,26 @@ uint8_t const * tud_descriptor_device_cb(void);
 TU_ATTR_WEAK uint8_t const * tud_descriptor_bos_cb(void);
 
 // Invoked when received GET CONFIGURATION DESCRIPTOR request
-// Application return pointer to descriptor, whose contents must exist long enough for transfer to complete
+// Application return pointer to descriptor, whose contents must exist long enough for transfer to complete.
+// Also invoked to parse the descriptor for SET CONFIGURATION and SET INTERFACE requests, which are stalled
+// if it returns TUD_DESC_PENDING: descriptor must then be returned right away
 uint8_t const * tud_descriptor_configuration_cb(uint8_t index);
 
+// Invoked when received SET CONFIGURATION request
+// Application return map of the configuration generated by TUD_CONFIG_MAP(), or NULL to parse its descriptor.
+// Drivers are then opened directly and their interfaces/endpoints routed without descriptor parsing.
+TU_ATTR_WEAK tud_config_map_t const* tud_descriptor_configuration_map_cb(uint8_t index);
+
+#if CFG_TUD_DESC_STRING_TABLE
+// Table of string descriptors indexed by string index, defined by application.
+// Stack transfers entry as it is (e.g from flash) without invoking any callback.
+extern void const* const tud_descriptor_string_arr[];
+extern uint8_t const tud_descriptor_string_count;
+#else
 // Invoked when received GET STRING DESCRIPTOR request
 // Application return pointer to descriptor, whose contents must exist long enough for transfer to complete
 uint16_t const* tud_descriptor_string_cb(uint8_t index);
+#endif
 
 // Invoked when device is mounted (configured)
 TU_ATTR_WEAK void tud_mount_cb(void);
@@ -106,11 +327,51 @@ TU_ATTR_WEAK void tud_suspend_cb(bool remote_wakeup_en);
 // Invoked when usb bus is resumed
 TU_ATTR_WEAK void tud_resume_cb(void);
 
+// Invoked when host puts the link in L1 sleep (CFG_TUD_LPM). Resume must be possible within besl,
+// the latency of USB 2.0 LPM ECN table X-X1 (0: 125 us, 1: 150 us ... 15: 10 ms)
+TU_ATTR_WEAK void tud_lpm_sleep_cb(uint8_t besl, bool remote_wakeup_en);
+
+// Invoked when link is back from L1 sleep
+TU_ATTR_WEAK void tud_lpm_resume_cb(void);
+
+// Invoked in ISR context on every SOF (each microframe for high speed) with current frame number
+// and CFG_TUD_SOF_TIMESTAMP() e.g cycle counter latched on the interrupt, for rate feedback,
+// isochronous scheduling or clock drift measurement. Must be short, only run by DCDs signalling SOF.
+TU_ATTR_WEAK void tud_sof_isr_cb(uint8_t rhport, uint32_t frame_number, uint32_t timestamp);
+
+#if CFG_TUD_SPLIT_CORE
+// Invoked on application core to raise the IPC interrupt of stack core e.g TXEV of LPC43xx M4 to M0,
+// mailbox of LPC55S69. Stack core handler calls tud_split_doorbell_isr(). Requests are coalesced,
+// it is not invoked again until stack core has taken the previous one
+void tud_split_doorbell_cb(void);
+#endif
+
 // Invoked when received control request with VENDOR TYPE
 TU_ATTR_WEAK bool tud_vendor_control_request_cb(uint8_t rhport, tusb_control_request_t const * request);
 TU_ATTR_WEAK bool tud_vendor_control_complete_cb(uint8_t rhport, tusb_control_request_t const * request);
 
 
+//--------------------------------------------------------------------+
+// String Descriptor Templates
+//--------------------------------------------------------------------+
+
+// Define a const string descriptor named _name from ASCII/UTF-8 literal _str. UTF-16 string is
+// generated by compiler with u"" literal, there is no runtime conversion and no RAM usage.
+#define TUD_STRING_DESCRIPTOR_DEF(_name, _str) \
+  static struct TU_ATTR_PACKED { \
+    uint8_t  bLength; \
+    uint8_t  bDescriptorType; \
+    uint16_t unicode_string[sizeof(u"" _str)/2 - 1]; \
+  } const _name = { sizeof(u"" _str), TUSB_DESC_STRING, u"" _str }
+
+// Define a const string descriptor 0 named _name with one supported language ID e.g 0x0409 for English
+#define TUD_STRING_LANGID_DEF(_name, _langid) \
+  static struct TU_ATTR_PACKED { \
+    uint8_t  bLength; \
+    uint8_t  bDescriptorType; \
+    uint16_t wLANGID[1]; \
+  } const _name = { 4, TUSB_DESC_STRING, { _langid } }
+
 //--------------------------------------------------------------------+
 // Binary Device Object Store (BOS) Descriptor Templates
 //--------------------------------------------------------------------+
@@ -125,6 +386,15 @@ TU_ATTR_WEAK bool tud_vendor_control_complete_cb(uint8_t rhport, tusb_control_re
 #define TUD_BOS_PLATFORM_DESCRIPTOR(...) \
   4+TU_ARGS_NUM(__VA_ARGS__), TUSB_DESC_DEVICE_CAPABILITY, DEVICE_CAPABILITY_PLATFORM, 0x00, __VA_ARGS__
 
+//------------- USB 2.0 Extension -------------//
+#define TUD_BOS_USB20_EXT_DESC_LEN      7
+
+// LPM with BESL, baseline and deep BESL (0-15) recommended by device. bcdUSB of device descriptor
+// must be 0x0201 for host to read BOS and use LPM
+#define TUD_BOS_USB20_EXT_DESCRIPTOR(_besl_baseline, _besl_deep) \
+  7, TUSB_DESC_DEVICE_CAPABILITY, DEVICE_CAPABILITY_USB20_EXTENSION, \
+  U32_TO_U8S_LE(TU_BIT(1) | TU_BIT(2) | TU_BIT(3) | TU_BIT(4) | ((_besl_baseline) << 8) | ((_besl_deep) << 12))
+
 //------------- WebUSB BOS Platform -------------//
 
 // Descriptor Length
@@ -149,6 +419,17 @@ TU_ATTR_WEAK bool tud_vendor_control_complete_cb(uint8_t rhport, tusb_control_re
   0xDF, 0x60, 0xDD, 0xD8, 0x89, 0x45, 0xC7, 0x4C, \
   0x9C, 0xD2, 0x65, 0x9D, 0x9E, 0x64, 0x8A, 0x9F
 
+//------------- WinUSB (CFG_TUD_WINUSB) -------------//
+
+// Length of generated descriptor set: compatible ID of device having only the vendor interface,
+// otherwise a function subset for each of the selected interfaces
+#define TUD_WINUSB_DESC_SET_LEN(_composite, _itf_count) \
+  ((_composite) ? (10 + 8 + (_itf_count)*(8 + 20)) : (10 + 20))
+
+// Microsoft OS 2.0 capability of the generated set, for BOS of application
+#define TUD_BOS_WINUSB_DESCRIPTOR(_composite, _itf_count) \
+  TUD_BOS_MS_OS_20_DESCRIPTOR(TUD_WINUSB_DESC_SET_LEN(_composite, _itf_count), CFG_TUD_WINUSB_VENDOR_CODE)
+
 //--------------------------------------------------------------------+
 // Configuration & Interface Descriptor Templates
 //--------------------------------------------------------------------+
@@ -189,6 +470,130 @@ TU_ATTR_WEAK bool tud_vendor_control_complete_cb(uint8_t rhport, tusb_control_re
   /* Endpoint In */\
   7, TUSB_DESC_ENDPOINT, _epin, TUSB_XFER_BULK, U16_TO_U8S_LE(_epsize), 0
 
+//------------- CDC-NCM -------------//
+
+// Length of template descriptor: 85 bytes
+#define TUD_CDC_NCM_DESC_LEN  (8+9+5+5+13+6+7+9+9+7+7)
+
+// CDC-NCM Descriptor Template
+// Interface number, description string index, MAC address string index, EP notification address and size,
+// EP data address (out, in) and size, max ethernet segment size.
+#define TUD_CDC_NCM_DESCRIPTOR(_itfnum, _desc_stridx, _mac_stridx, _ep_notif, _ep_notif_size, _epout, _epin, _epsize, _maxsegmentsize) \
+  /* Interface Associate */\
+  8, TUSB_DESC_INTERFACE_ASSOCIATION, _itfnum, 2, TUSB_CLASS_CDC, CDC_COMM_SUBCLASS_NETWORK_CONTROL_MODEL, 0, 0,\
+  /* CDC Control Interface */\
+  9, TUSB_DESC_INTERFACE, _itfnum, 0, 1, TUSB_CLASS_CDC, CDC_COMM_SUBCLASS_NETWORK_CONTROL_MODEL, 0, _desc_stridx,\
+  /* CDC Header */\
+  5, TUSB_DESC_CS_INTERFACE, CDC_FUNC_DESC_HEADER, U16_TO_U8S_LE(0x0110),\
+  /* CDC Union */\
+  5, TUSB_DESC_CS_INTERFACE, CDC_FUNC_DESC_UNION, _itfnum, (uint8_t)((_itfnum) + 1),\
+  /* CDC Ethernet Networking: MAC string, no statistics, max segment size, no multicast & power filter */\
+  13, TUSB_DESC_CS_INTERFACE, CDC_FUNC_DESC_ETHERNET_NETWORKING, _mac_stridx, 0, 0, 0, 0, U16_TO_U8S_LE(_maxsegmentsize), U16_TO_U8S_LE(0), 0,\
+  /* CDC NCM: version 1.0, no optional request */\
+  6, TUSB_DESC_CS_INTERFACE, CDC_FUNC_DESC_NCM, U16_TO_U8S_LE(0x0100), 0,\
+  /* Endpoint Notification */\
+  7, TUSB_DESC_ENDPOINT, _ep_notif, TUSB_XFER_INTERRUPT, U16_TO_U8S_LE(_ep_notif_size), 16,\
+  /* CDC Data Interface, default alternate has no endpoint */\
+  9, TUSB_DESC_INTERFACE, (uint8_t)((_itfnum)+1), 0, 0, TUSB_CLASS_CDC_DATA, 0, NCM_DATA_PROTOCOL_NETWORK_TRANSFER_BLOCK, 0,\
+  /* CDC Data Interface, alternate 1 to transfer data */\
+  9, TUSB_DESC_INTERFACE, (uint8_t)((_itfnum)+1), 1, 2, TUSB_CLASS_CDC_DATA, 0, NCM_DATA_PROTOCOL_NETWORK_TRANSFER_BLOCK, 0,\
+  /* Endpoint Out */\
+  7, TUSB_DESC_ENDPOINT, _epout, TUSB_XFER_BULK, U16_TO_U8S_LE(_epsize), 0,\
+  /* Endpoint In */\
+  7, TUSB_DESC_ENDPOINT, _epin, TUSB_XFER_BULK, U16_TO_U8S_LE(_epsize), 0
+
+//------------- RNDIS -------------//
+
+// Length of template descriptor: 66 bytes
+#define TUD_RNDIS_DESC_LEN  (8+9+5+5+4+5+7+9+7+7)
+
+// RNDIS Descriptor Template, bound by Windows to its built-in driver (wireless controller class)
+// Interface number, string index, EP notification address and size, EP data address (out, in) and size.
+#define TUD_RNDIS_DESCRIPTOR(_itfnum, _stridx, _ep_notif, _ep_notif_size, _epout, _epin, _epsize) \
+  /* Interface Associate */\
+  8, TUSB_DESC_INTERFACE_ASSOCIATION, _itfnum, 2, TUSB_CLASS_WIRELESS_CONTROLLER, 0x01, 0x03, 0,\
+  /* CDC Control Interface */\
+  9, TUSB_DESC_INTERFACE, _itfnum, 0, 1, TUSB_CLASS_WIRELESS_CONTROLLER, 0x01, 0x03, _stridx,\
+  /* CDC Header */\
+  5, TUSB_DESC_CS_INTERFACE, CDC_FUNC_DESC_HEADER, U16_TO_U8S_LE(0x0110),\
+  /* CDC Call */\
+  5, TUSB_DESC_CS_INTERFACE, CDC_FUNC_DESC_CALL_MANAGEMENT, 0, (uint8_t)((_itfnum) + 1),\
+  /* CDC ACM: no line request */\
+  4, TUSB_DESC_CS_INTERFACE, CDC_FUNC_DESC_ABSTRACT_CONTROL_MANAGEMENT, 0,\
+  /* CDC Union */\
+  5, TUSB_DESC_CS_INTERFACE, CDC_FUNC_DESC_UNION, _itfnum, (uint8_t)((_itfnum) + 1),\
+  /* Endpoint Notification */\
+  7, TUSB_DESC_ENDPOINT, _ep_notif, TUSB_XFER_INTERRUPT, U16_TO_U8S_LE(_ep_notif_size), 1,\
+  /* CDC Data Interface */\
+  9, TUSB_DESC_INTERFACE, (uint8_t)((_itfnum)+1), 0, 2, TUSB_CLASS_CDC_DATA, 0, 0, 0,\
+  /* Endpoint Out */\
+  7, TUSB_DESC_ENDPOINT, _epout, TUSB_XFER_BULK, U16_TO_U8S_LE(_epsize), 0,\
+  /* Endpoint In */\
+  7, TUSB_DESC_ENDPOINT, _epin, TUSB_XFER_BULK, U16_TO_U8S_LE(_epsize), 0
+
+//------------- BT Radio -------------//
+#define TUD_BT_APP_CLASS                    (TUSB_CLASS_WIRELESS_CONTROLLER)
+#define TUD_BT_APP_SUBCLASS                 0x01
+#define TUD_BT_PROTOCOL_PRIMARY_CONTROLLER  0x01
+#define TUD_BT_PROTOCOL_AMP_CONTROLLER      0x02
+
+// Length of template descriptor: 30 bytes
+#define TUD_BTH_DESC_LEN (9+7+7+7)
+
+// HCI interface, host sends HCI commands with interface 0 in wIndex hence it should be the first interface
+// Interface number, string index, event EP address & size & polling interval, ACL EP IN & OUT address, ACL EP size
+#define TUD_BTH_DESCRIPTOR(_itfnum, _stridx, _ep_evt, _ep_evt_size, _ep_evt_interval, _ep_in, _ep_out, _ep_size) \
+  /* Interface */\
+  9, TUSB_DESC_INTERFACE, _itfnum, 0, 3, TUD_BT_APP_CLASS, TUD_BT_APP_SUBCLASS, TUD_BT_PROTOCOL_PRIMARY_CONTROLLER, _stridx,\
+  /* Endpoint In for events */\
+  7, TUSB_DESC_ENDPOINT, _ep_evt, TUSB_XFER_INTERRUPT, U16_TO_U8S_LE(_ep_evt_size), _ep_evt_interval,\
+  /* Endpoint In for ACL data */\
+  7, TUSB_DESC_ENDPOINT, _ep_in, TUSB_XFER_BULK, U16_TO_U8S_LE(_ep_size), 1,\
+  /* Endpoint Out for ACL data */\
+  7, TUSB_DESC_ENDPOINT, _ep_out, TUSB_XFER_BULK, U16_TO_U8S_LE(_ep_size), 1
+
+// Length of voice interface with CFG_TUD_BTH_ISO_ALT_COUNT alternate settings beyond zero bandwidth one
+#define TUD_BTH_ISO_DESC_LEN(_alt_count) (9 + (9+7+7)*(_alt_count))
+
+// Voice interface alternate 0, which has no bandwidth hence no endpoint. Interface number is HCI one + 1
+#define TUD_BTH_ISO_ALT0_DESCRIPTOR(_itfnum) \
+  9, TUSB_DESC_INTERFACE, _itfnum, 0, 0, TUD_BT_APP_CLASS, TUD_BT_APP_SUBCLASS, TUD_BT_PROTOCOL_PRIMARY_CONTROLLER, 0
+
+// Voice interface alternate with SCO bandwidth, Bluetooth spec uses EP size 9, 17, 25, 33, 49, 63 for alternate 1 to 6
+// Interface number, alternate setting, ISO EP IN & OUT address, EP size
+#define TUD_BTH_ISO_ALT_DESCRIPTOR(_itfnum, _alt, _ep_in, _ep_out, _ep_size) \
+  /* Interface */\
+  9, TUSB_DESC_INTERFACE, _itfnum, _alt, 2, TUD_BT_APP_CLASS, TUD_BT_APP_SUBCLASS, TUD_BT_PROTOCOL_PRIMARY_CONTROLLER, 0,\
+  /* Isochronous endpoints */\
+  7, TUSB_DESC_ENDPOINT, _ep_in, TUSB_XFER_ISOCHRONOUS, U16_TO_U8S_LE(_ep_size), 1,\
+  7, TUSB_DESC_ENDPOINT, _ep_out, TUSB_XFER_ISOCHRONOUS, U16_TO_U8S_LE(_ep_size), 1
+
+//------------- Printer -------------//
+
+// Length of template descriptor: 23 bytes
+#define TUD_PRINTER_DESC_LEN  (9+7+7)
+
+// Bidirectional printer, host sends GET_DEVICE_ID with alternate setting (0) in low byte of wIndex
+// which usbd routes to interface 0, hence printer should be the first interface
+// Interface number, string index, EP Out & IN address, EP size
+#define TUD_PRINTER_DESCRIPTOR(_itfnum, _stridx, _epout, _epin, _epsize) \
+  /* Interface */\
+  9, TUSB_DESC_INTERFACE, _itfnum, 0, 2, TUSB_CLASS_PRINTER, PRINTER_SUBCLASS, PRINTER_PROTOCOL_BIDIRECTIONAL, _stridx,\
+  /* Endpoint Out */\
+  7, TUSB_DESC_ENDPOINT, _epout, TUSB_XFER_BULK, U16_TO_U8S_LE(_epsize), 0,\
+  /* Endpoint In */\
+  7, TUSB_DESC_ENDPOINT, _epin, TUSB_XFER_BULK, U16_TO_U8S_LE(_epsize), 0
+
+// Unidirectional printer, length is 16 bytes
+#define TUD_PRINTER_UNI_DESC_LEN  (9+7)
+
+// Interface number, string index, EP Out address, EP size
+#define TUD_PRINTER_UNI_DESCRIPTOR(_itfnum, _stridx, _epout, _epsize) \
+  /* Interface */\
+  9, TUSB_DESC_INTERFACE, _itfnum, 0, 1, TUSB_CLASS_PRINTER, PRINTER_SUBCLASS, PRINTER_PROTOCOL_UNIDIRECTIONAL, _stridx,\
+  /* Endpoint Out */\
+  7, TUSB_DESC_ENDPOINT, _epout, TUSB_XFER_BULK, U16_TO_U8S_LE(_epsize), 0
+
 //------------- MSC -------------//
 
 // Length of template descriptor: 23 bytes
@@ -203,11 +608,36 @@ TU_ATTR_WEAK bool tud_vendor_control_complete_cb(uint8_t rhport, tusb_control_re
   /* Endpoint In */\
   7, TUSB_DESC_ENDPOINT, _epin, TUSB_XFER_BULK, U16_TO_U8S_LE(_epsize), 0
 
+// Length of template descriptor: 53 bytes
+#define TUD_UAS_DESC_LEN    (9 + 4*(7 + 4))
+
+// USB Attached SCSI without bulk streams (high/full speed)
+// Interface number, string index, EP Command Out, Status In, Data In, Data Out address, EP size
+#define TUD_UAS_DESCRIPTOR(_itfnum, _stridx, _epcmd, _epstat, _epin, _epout, _epsize) \
+  /* Interface */\
+  9, TUSB_DESC_INTERFACE, _itfnum, 0, 4, TUSB_CLASS_MSC, MSC_SUBCLASS_SCSI, MSC_PROTOCOL_UAS, _stridx,\
+  /* Endpoint Command Out + Pipe Usage */\
+  7, TUSB_DESC_ENDPOINT, _epcmd, TUSB_XFER_BULK, U16_TO_U8S_LE(_epsize), 0,\
+  4, UAS_DESC_PIPE_USAGE, UAS_PIPE_COMMAND, 0,\
+  /* Endpoint Status In + Pipe Usage */\
+  7, TUSB_DESC_ENDPOINT, _epstat, TUSB_XFER_BULK, U16_TO_U8S_LE(_epsize), 0,\
+  4, UAS_DESC_PIPE_USAGE, UAS_PIPE_STATUS, 0,\
+  /* Endpoint Data In + Pipe Usage */\
+  7, TUSB_DESC_ENDPOINT, _epin, TUSB_XFER_BULK, U16_TO_U8S_LE(_epsize), 0,\
+  4, UAS_DESC_PIPE_USAGE, UAS_PIPE_DATA_IN, 0,\
+  /* Endpoint Data Out + Pipe Usage */\
+  7, TUSB_DESC_ENDPOINT, _epout, TUSB_XFER_BULK, U16_TO_U8S_LE(_epsize), 0,\
+  4, UAS_DESC_PIPE_USAGE, UAS_PIPE_DATA_OUT, 0
+
 //------------- HID -------------//
 
 // Length of template descriptor: 25 bytes
 #define TUD_HID_DESC_LEN    (9 + 9 + 7)
 
+// wMaxPacketSize of high speed high-bandwidth interrupt endpoint: _size bytes (up to 1024) sent
+// _mult times (1 to 3) per microframe, use with _ep_interval = 1 for 125 us polling
+#define TUD_HID_EP_SIZE_HIGH_BANDWIDTH(_size, _mult)  ( (_size) | (((_mult) - 1) << 11) )
+
 // HID Input only descriptor
 // Interface number, string index, protocol, report descriptor len, EP In address, size & polling interval
 #define TUD_HID_DESCRIPTOR(_itfnum, _stridx, _boot_protocol, _report_desc_len, _epin, _epsize, _ep_interval) \
@@ -267,6 +697,142 @@ TU_ATTR_WEAK bool tud_vendor_control_complete_cb(uint8_t rhport, tusb_control_re
   /* MS Endpoint (connected to embedded jack out) */\
   5, TUSB_DESC_CS_ENDPOINT, MIDI_CS_ENDPOINT_GENERAL, 1, 3
 
+//------------- Audio Class 2.0 -------------//
+
+// Length of template descriptors (125 and 118 bytes)
+#define TUD_AUDIO_SPEAKER_DESC_LEN (8 + 9 + 9 + 8 + 17 + 12 + 9 + 9 + 16 + 6 + 7 + 8 + 7)
+#define TUD_AUDIO_MIC_DESC_LEN     (8 + 9 + 9 + 8 + 17 + 12 + 9 + 9 + 16 + 6 + 7 + 8)
+
+// Length of class-specific AC descriptors of templates (header, clock source, terminals)
+#define TUD_AUDIO_AC_CS_LEN        (9 + 8 + 17 + 12)
+
+// Explicit feedback interval is 1 ms at both speeds (of first device port)
+#define TUD_AUDIO_FB_INTERVAL      (TUD_OPT_RHPORT_HIGH_SPEED(TUD_OPT_RHPORT) ? 4 : 1)
+
+// Entities of templates
+#define TUD_AUDIO_CLOCK_ID         1
+#define TUD_AUDIO_INPUT_TERM_ID    2
+#define TUD_AUDIO_OUTPUT_TERM_ID   3
+
+// Common part: Interface Association, Audio Control interface with header, programmable internal clock
+// source and terminals from _in_type to _out_type
+#define TUD_AUDIO_AC_DESCRIPTOR(_itfnum, _stridx, _category, _in_type, _out_type, _nchannels) \
+  /* Interface Association */\
+  8, TUSB_DESC_INTERFACE_ASSOCIATION, _itfnum, 2, TUSB_CLASS_AUDIO, AUDIO_SUBCLASS_UNDEFINED, AUDIO_PROTOCOL_V2, 0,\
+  /* Audio Control (AC) Interface */\
+  9, TUSB_DESC_INTERFACE, _itfnum, 0, 0, TUSB_CLASS_AUDIO, AUDIO_SUBCLASS_CONTROL, AUDIO_PROTOCOL_V2, _stridx,\
+  /* AC Header */\
+  9, TUSB_DESC_CS_INTERFACE, AUDIO_CS_INTERFACE_HEADER, U16_TO_U8S_LE(0x0200), _category, U16_TO_U8S_LE(TUD_AUDIO_AC_CS_LEN), 0,\
+  /* Clock Source: sample rate set by host, its validity read only */\
+  8, TUSB_DESC_CS_INTERFACE, AUDIO_CS_INTERFACE_CLOCK_SOURCE, TUD_AUDIO_CLOCK_ID, AUDIO_CLOCK_SOURCE_ATT_INT_PRO_CLK, (AUDIO_CTRL_RW | (AUDIO_CTRL_R << 2)), 0, 0,\
+  /* Input Terminal */\
+  17, TUSB_DESC_CS_INTERFACE, AUDIO_CS_INTERFACE_INPUT_TERMINAL, TUD_AUDIO_INPUT_TERM_ID, U16_TO_U8S_LE(_in_type), 0, TUD_AUDIO_CLOCK_ID, _nchannels, U32_TO_U8S_LE(0), 0, U16_TO_U8S_LE(0), 0,\
+  /* Output Terminal */\
+  12, TUSB_DESC_CS_INTERFACE, AUDIO_CS_INTERFACE_OUTPUT_TERMINAL, TUD_AUDIO_OUTPUT_TERM_ID, U16_TO_U8S_LE(_out_type), 0, TUD_AUDIO_INPUT_TERM_ID, TUD_AUDIO_CLOCK_ID, U16_TO_U8S_LE(0), 0
+
+// Common part: Audio Streaming interface with zero bandwidth alternate 0 and PCM alternate 1
+#define TUD_AUDIO_AS_DESCRIPTOR(_itfnum, _numep, _term_link, _nchannels, _subslot, _bits) \
+  /* Audio Streaming (AS) Interface, zero bandwidth */\
+  9, TUSB_DESC_INTERFACE, _itfnum, 0, 0, TUSB_CLASS_AUDIO, AUDIO_SUBCLASS_STREAMING, AUDIO_PROTOCOL_V2, 0,\
+  /* AS Interface, streaming */\
+  9, TUSB_DESC_INTERFACE, _itfnum, 1, _numep, TUSB_CLASS_AUDIO, AUDIO_SUBCLASS_STREAMING, AUDIO_PROTOCOL_V2, 0,\
+  /* AS General */\
+  16, TUSB_DESC_CS_INTERFACE, AUDIO_CS_AS_INTERFACE_AS_GENERAL, _term_link, 0, AUDIO_FORMAT_TYPE_I, U32_TO_U8S_LE(AUDIO_DATA_FORMAT_TYPE_I_PCM), _nchannels, U32_TO_U8S_LE(0), 0,\
+  /* Type I Format */\
+  6, TUSB_DESC_CS_INTERFACE, AUDIO_CS_AS_INTERFACE_FORMAT_TYPE, AUDIO_FORMAT_TYPE_I, _subslot, _bits
+
+// Speaker: host streams _nchannels of _bits (in _subslot bytes) to asynchronous isochronous
+// endpoint _epout. Explicit feedback on _epfb makes host follow device clock.
+#define TUD_AUDIO_SPEAKER_DESCRIPTOR(_itfnum, _stridx, _nchannels, _subslot, _bits, _epout, _epsize, _epfb) \
+  TUD_AUDIO_AC_DESCRIPTOR(_itfnum, _stridx, AUDIO_FUNC_DESKTOP_SPEAKER, AUDIO_TERM_TYPE_USB_STREAMING, AUDIO_TERM_TYPE_OUT_GENERIC_SPEAKER, _nchannels),\
+  TUD_AUDIO_AS_DESCRIPTOR((uint8_t)((_itfnum)+1), 2, TUD_AUDIO_INPUT_TERM_ID, _nchannels, _subslot, _bits),\
+  /* Endpoint Out: isochronous, asynchronous */\
+  7, TUSB_DESC_ENDPOINT, _epout, (TUSB_XFER_ISOCHRONOUS | 0x04), U16_TO_U8S_LE(_epsize), 1,\
+  /* CS Isochronous Endpoint */\
+  8, TUSB_DESC_CS_ENDPOINT, AUDIO_CS_EP_SUBTYPE_GENERAL, 0, 0, 0, U16_TO_U8S_LE(0),\
+  /* Endpoint In: isochronous, feedback */\
+  7, TUSB_DESC_ENDPOINT, _epfb, (TUSB_XFER_ISOCHRONOUS | 0x10), U16_TO_U8S_LE(4), TUD_AUDIO_FB_INTERVAL
+
+// Microphone: device streams _nchannels of _bits (in _subslot bytes) on asynchronous isochronous
+// endpoint _epin, host adapts to the number of frames per packet.
+#define TUD_AUDIO_MIC_DESCRIPTOR(_itfnum, _stridx, _nchannels, _subslot, _bits, _epin, _epsize) \
+  TUD_AUDIO_AC_DESCRIPTOR(_itfnum, _stridx, AUDIO_FUNC_MICROPHONE, AUDIO_TERM_TYPE_IN_GENERIC_MIC, AUDIO_TERM_TYPE_USB_STREAMING, _nchannels),\
+  TUD_AUDIO_AS_DESCRIPTOR((uint8_t)((_itfnum)+1), 1, TUD_AUDIO_OUTPUT_TERM_ID, _nchannels, _subslot, _bits),\
+  /* Endpoint In: isochronous, asynchronous */\
+  7, TUSB_DESC_ENDPOINT, _epin, (TUSB_XFER_ISOCHRONOUS | 0x04), U16_TO_U8S_LE(_epsize), 1,\
+  /* CS Isochronous Endpoint */\
+  8, TUSB_DESC_CS_ENDPOINT, AUDIO_CS_EP_SUBTYPE_GENERAL, 0, 0, 0, U16_TO_U8S_LE(0)
+
+//------------- Video Class -------------//
+
+// Length of template descriptors, _fmt_len is length of format block e.g TUD_VIDEO_FORMAT_MJPEG_LEN
+#define TUD_VIDEO_CAPTURE_ISO_DESC_LEN(_fmt_len)  (8 + 9 + TUD_VIDEO_VC_CS_LEN + 9 + 14 + (_fmt_len) + 6 + 9 + 7)
+#define TUD_VIDEO_CAPTURE_BULK_DESC_LEN(_fmt_len) (8 + 9 + TUD_VIDEO_VC_CS_LEN + 9 + 14 + (_fmt_len) + 6 + 7)
+
+// Length of format blocks: format with a single frame descriptor
+#define TUD_VIDEO_FORMAT_MJPEG_LEN  (11 + 30)
+#define TUD_VIDEO_FORMAT_YUY2_LEN   (27 + 30)
+
+// Length of class-specific VC descriptors of templates (header, camera and output terminal)
+#define TUD_VIDEO_VC_CS_LEN         (13 + 18 + 9)
+
+// Entities of templates
+#define TUD_VIDEO_CAMERA_TERM_ID    1
+#define TUD_VIDEO_OUTPUT_TERM_ID    2
+
+// Frame descriptor of _subtype, _fps frames per second, frame buffer of 16 bits per pixel
+#define TUD_VIDEO_FRAME_DESCRIPTOR(_subtype, _width, _height, _fps) \
+  30, TUSB_DESC_CS_INTERFACE, _subtype, 1, 0, U16_TO_U8S_LE(_width), U16_TO_U8S_LE(_height),\
+  U32_TO_U8S_LE((_width)*(_height)*16*(_fps)), U32_TO_U8S_LE((_width)*(_height)*16*(_fps)), U32_TO_U8S_LE((_width)*(_height)*2),\
+  U32_TO_U8S_LE(10000000/(_fps)), 1, U32_TO_U8S_LE(10000000/(_fps))
+
+// Motion JPEG, frames up to _width x _height x 2 bytes
+#define TUD_VIDEO_FORMAT_MJPEG_DESCRIPTOR(_width, _height, _fps) \
+  11, TUSB_DESC_CS_INTERFACE, VIDEO_CS_ITF_VS_FORMAT_MJPEG, 1, 1, 0, 1, 0, 0, 0, 0,\
+  TUD_VIDEO_FRAME_DESCRIPTOR(VIDEO_CS_ITF_VS_FRAME_MJPEG, _width, _height, _fps)
+
+// Uncompressed YUY2 (4:2:2, 16 bits per pixel)
+#define TUD_VIDEO_FORMAT_YUY2_DESCRIPTOR(_width, _height, _fps) \
+  27, TUSB_DESC_CS_INTERFACE, VIDEO_CS_ITF_VS_FORMAT_UNCOMPRESSED, 1, 1,\
+  'Y', 'U', 'Y', '2', 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71, 16, 1, 0, 0, 0, 0,\
+  TUD_VIDEO_FRAME_DESCRIPTOR(VIDEO_CS_ITF_VS_FRAME_UNCOMPRESSED, _width, _height, _fps)
+
+// Common part: Interface Association, Video Control interface with header, camera and output terminal,
+// then alternate 0 of Video Streaming interface with input header, format block and color matching
+#define TUD_VIDEO_VC_VS_DESCRIPTOR(_itfnum, _stridx, _epin, _numep, _fmt_len, ...) \
+  /* Interface Association */\
+  8, TUSB_DESC_INTERFACE_ASSOCIATION, _itfnum, 2, TUSB_CLASS_VIDEO, VIDEO_SUBCLASS_INTERFACE_COLLECTION, VIDEO_ITF_PROTOCOL_UNDEFINED, _stridx,\
+  /* Video Control (VC) Interface */\
+  9, TUSB_DESC_INTERFACE, _itfnum, 0, 0, TUSB_CLASS_VIDEO, VIDEO_SUBCLASS_CONTROL, VIDEO_ITF_PROTOCOL_UNDEFINED, _stridx,\
+  /* VC Header: UVC 1.1, 48 MHz clock, one streaming interface */\
+  13, TUSB_DESC_CS_INTERFACE, VIDEO_CS_ITF_VC_HEADER, U16_TO_U8S_LE(0x0110), U16_TO_U8S_LE(TUD_VIDEO_VC_CS_LEN), U32_TO_U8S_LE(48000000), 1, (uint8_t)((_itfnum)+1),\
+  /* Camera Terminal, no controls */\
+  18, TUSB_DESC_CS_INTERFACE, VIDEO_CS_ITF_VC_INPUT_TERMINAL, TUD_VIDEO_CAMERA_TERM_ID, U16_TO_U8S_LE(VIDEO_ITT_CAMERA), 0, 0, U16_TO_U8S_LE(0), U16_TO_U8S_LE(0), U16_TO_U8S_LE(0), 3, 0, 0, 0,\
+  /* Output Terminal */\
+  9, TUSB_DESC_CS_INTERFACE, VIDEO_CS_ITF_VC_OUTPUT_TERMINAL, TUD_VIDEO_OUTPUT_TERM_ID, U16_TO_U8S_LE(VIDEO_TT_STREAMING), 0, TUD_VIDEO_CAMERA_TERM_ID, 0,\
+  /* Video Streaming (VS) Interface */\
+  9, TUSB_DESC_INTERFACE, (uint8_t)((_itfnum)+1), 0, _numep, TUSB_CLASS_VIDEO, VIDEO_SUBCLASS_STREAMING, VIDEO_ITF_PROTOCOL_UNDEFINED, 0,\
+  /* VS Input Header */\
+  14, TUSB_DESC_CS_INTERFACE, VIDEO_CS_ITF_VS_INPUT_HEADER, 1, U16_TO_U8S_LE(14 + (_fmt_len) + 6), _epin, 0, TUD_VIDEO_OUTPUT_TERM_ID, 0, 0, 0, 1, 0,\
+  __VA_ARGS__,\
+  /* Color Matching: BT.709, sRGB */\
+  6, TUSB_DESC_CS_INTERFACE, VIDEO_CS_ITF_VS_COLORFORMAT, 1, 1, 4
+
+// Camera streaming format block (e.g TUD_VIDEO_FORMAT_MJPEG_DESCRIPTOR) on isochronous endpoint
+// _epin of alternate 1, alternate 0 is zero bandwidth
+#define TUD_VIDEO_CAPTURE_ISO_DESCRIPTOR(_itfnum, _stridx, _epin, _epsize, _fmt_len, ...) \
+  TUD_VIDEO_VC_VS_DESCRIPTOR(_itfnum, _stridx, _epin, 0, _fmt_len, __VA_ARGS__),\
+  /* VS Interface, streaming */\
+  9, TUSB_DESC_INTERFACE, (uint8_t)((_itfnum)+1), 1, 1, TUSB_CLASS_VIDEO, VIDEO_SUBCLASS_STREAMING, VIDEO_ITF_PROTOCOL_UNDEFINED, 0,\
+  /* Endpoint In: isochronous, asynchronous */\
+  7, TUSB_DESC_ENDPOINT, _epin, (TUSB_XFER_ISOCHRONOUS | 0x04), U16_TO_U8S_LE(_epsize), 1
+
+// Camera streaming format block on bulk endpoint _epin
+#define TUD_VIDEO_CAPTURE_BULK_DESCRIPTOR(_itfnum, _stridx, _epin, _epsize, _fmt_len, ...) \
+  TUD_VIDEO_VC_VS_DESCRIPTOR(_itfnum, _stridx, _epin, 1, _fmt_len, __VA_ARGS__),\
+  /* Endpoint In */\
+  7, TUSB_DESC_ENDPOINT, _epin, TUSB_XFER_BULK, U16_TO_U8S_LE(_epsize), 0
+
 //------------- TUD_USBTMC/USB488 -------------//
 #define TUD_USBTMC_APP_CLASS    (TUSB_CLASS_APPLICATION_SPECIFIC)
 #define TUD_USBTMC_APP_SUBCLASS 0x03u
@@ -310,6 +876,16 @@ TU_ATTR_WEAK bool tud_vendor_control_complete_cb(uint8_t rhport, tusb_control_re
   /* Endpoint In */\
   7, TUSB_DESC_ENDPOINT, _epin, TUSB_XFER_BULK, U16_TO_U8S_LE(_epsize), 0
 
+// Same as above with interrupt endpoints e.g for low latency command interface, length is TUD_VENDOR_DESC_LEN
+// Interface number, string index, EP Out & IN address, EP size, polling interval
+#define TUD_VENDOR_INT_DESCRIPTOR(_itfnum, _stridx, _epout, _epin, _epsize, _ep_interval) \
+  /* Interface */\
+  9, TUSB_DESC_INTERFACE, _itfnum, 0, 2, TUSB_CLASS_VENDOR_SPECIFIC, 0x00, 0x00, _stridx,\
+  /* Endpoint Out */\
+  7, TUSB_DESC_ENDPOINT, _epout, TUSB_XFER_INTERRUPT, U16_TO_U8S_LE(_epsize), _ep_interval,\
+  /* Endpoint In */\
+  7, TUSB_DESC_ENDPOINT, _epin, TUSB_XFER_INTERRUPT, U16_TO_U8S_LE(_epsize), _ep_interval
+
 //------------- DFU Runtime -------------//
 #define TUD_DFU_APP_CLASS    (TUSB_CLASS_APPLICATION_SPECIFIC)
 #define TUD_DFU_APP_SUBCLASS 0x01u
@@ -325,6 +901,128 @@ TU_ATTR_WEAK bool tud_vendor_control_complete_cb(uint8_t rhport, tusb_control_re
   /* Function */ \
   9, DFU_DESC_FUNCTIONAL, _attr, U16_TO_U8S_LE(_timeout), U16_TO_U8S_LE(_xfer_size), U16_TO_U8S_LE(0x0101)
 
+//------------- DFU -------------//
+
+// Length of template descriptor: 9 bytes per alternate setting + 9 bytes functional descriptor
+#define TUD_DFU_DESC_LEN(_alt_count) (9*(_alt_count) + 9)
+
+// DFU mode interface, one per alternate setting (e.g memory region) followed by one functional descriptor
+// Interface number, alternate setting, string index
+#define TUD_DFU_ALT_DESCRIPTOR(_itfnum, _alt, _stridx) \
+  9, TUSB_DESC_INTERFACE, _itfnum, _alt, 0, TUD_DFU_APP_CLASS, TUD_DFU_APP_SUBCLASS, DFU_PROTOCOL_DFU, _stridx
+
+// Attributes, detach timeout, transfer size
+#define TUD_DFU_FUNC_DESCRIPTOR(_attr, _timeout, _xfer_size) \
+  9, DFU_DESC_FUNCTIONAL, _attr, U16_TO_U8S_LE(_timeout), U16_TO_U8S_LE(_xfer_size), U16_TO_U8S_LE(0x0101)
+
+// Same as above with version 1.1a, which makes host tools (e.g dfu-util) use DfuSe protocol
+#define TUD_DFUSE_FUNC_DESCRIPTOR(_attr, _timeout, _xfer_size) \
+  9, DFU_DESC_FUNCTIONAL, _attr, U16_TO_U8S_LE(_timeout), U16_TO_U8S_LE(_xfer_size), U16_TO_U8S_LE(0x011A)
+
+// DFU mode descriptor with single alternate setting, length is TUD_DFU_DESC_LEN(1)
+// Interface number, string index, attributes, detach timeout, transfer size
+#define TUD_DFU_DESCRIPTOR(_itfnum, _stridx, _attr, _timeout, _xfer_size) \
+  TUD_DFU_ALT_DESCRIPTOR(_itfnum, 0, _stridx), TUD_DFU_FUNC_DESCRIPTOR(_attr, _timeout, _xfer_size)
+
+//--------------------------------------------------------------------+
+// Configuration Builder
+//
+// Interface and endpoint numbers are assigned in order of the function list of a configuration,
+// its descriptor length is computed and its map generated at compile time, e.g
+//
+//   #define CONFIG_FUNCTIONS(X)   X(CDC, cdc, 4, 8, 64)  X(MSC, msc, 5, 64)
+//
+//   TUD_CONFIG_ENUM(CONFIG, CONFIG_FUNCTIONS);
+//
+//   uint8_t const desc_configuration[] = { TUD_CONFIG_BUILD(CONFIG, CONFIG_FUNCTIONS, 0, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100) };
+//   tud_config_map_t const desc_configuration_map = TUD_CONFIG_MAP(CONFIG_FUNCTIONS);
+//
+// defines ITF_NUM_cdc = 0, ITF_NUM_msc = 2, EPNUM_cdc = 1 (notification, data is EPNUM_cdc + 1), EPNUM_msc = 3,
+// CONFIG_ITF_TOTAL and CONFIG_TOTAL_LEN. Arguments after the name are those of the class template
+// without interface and endpoint numbers:
+//   CDC    : string index, notification EP size, data EP size
+//   MSC    : string index, EP size
+//   HID    : string index, boot protocol, report descriptor length, EP size, polling interval
+//   VENDOR : string index, EP size
+//   MIDI   : string index, EP size
+// Function names must be unique across configurations, interface and endpoint numbers restart for each.
+//--------------------------------------------------------------------+
+
+// Per class: interface count, endpoint numbers used, descriptor length, driver, descriptor and map entries
+#define _TUD_FUNC_CDC_ITF     2
+#define _TUD_FUNC_CDC_EP      2
+#define _TUD_FUNC_CDC_LEN     TUD_CDC_DESC_LEN
+#define _TUD_FUNC_CDC_DRIVER  TUD_DRIVER_CDC
+#define _TUD_FUNC_CDC_DESC(_itf, _ep, _stridx, _ep_notif_size, _epsize) \
+  TUD_CDC_DESCRIPTOR(_itf, _stridx, 0x80 | (_ep), _ep_notif_size, (_ep) + 1, 0x80 | ((_ep) + 1), _epsize)
+#define _TUD_FUNC_CDC_MAP(_itf, _ep, _func) \
+  .itf2func[_itf] = _func, .itf2func[(_itf) + 1] = _func, .ep2func[_ep][TUSB_DIR_IN] = _func, \
+  .ep2func[(_ep) + 1][TUSB_DIR_OUT] = _func, .ep2func[(_ep) + 1][TUSB_DIR_IN] = _func,
+
+#define _TUD_FUNC_MSC_ITF     1
+#define _TUD_FUNC_MSC_EP      1
+#define _TUD_FUNC_MSC_LEN     TUD_MSC_DESC_LEN
+#define _TUD_FUNC_MSC_DRIVER  TUD_DRIVER_MSC
+#define _TUD_FUNC_MSC_DESC(_itf, _ep, _stridx, _epsize) \
+  TUD_MSC_DESCRIPTOR(_itf, _stridx, _ep, 0x80 | (_ep), _epsize)
+#define _TUD_FUNC_MSC_MAP(_itf, _ep, _func) \
+  .itf2func[_itf] = _func, .ep2func[_ep][TUSB_DIR_OUT] = _func, .ep2func[_ep][TUSB_DIR_IN] = _func,
+
+#define _TUD_FUNC_HID_ITF     1
+#define _TUD_FUNC_HID_EP      1
+#define _TUD_FUNC_HID_LEN     TUD_HID_DESC_LEN
+#define _TUD_FUNC_HID_DRIVER  TUD_DRIVER_HID
+#define _TUD_FUNC_HID_DESC(_itf, _ep, _stridx, _boot_protocol, _report_desc_len, _epsize, _ep_interval) \
+  TUD_HID_DESCRIPTOR(_itf, _stridx, _boot_protocol, _report_desc_len, 0x80 | (_ep), _epsize, _ep_interval)
+#define _TUD_FUNC_HID_MAP(_itf, _ep, _func) \
+  .itf2func[_itf] = _func, .ep2func[_ep][TUSB_DIR_IN] = _func,
+
+#define _TUD_FUNC_VENDOR_ITF     1
+#define _TUD_FUNC_VENDOR_EP      1
+#define _TUD_FUNC_VENDOR_LEN     TUD_VENDOR_DESC_LEN
+#define _TUD_FUNC_VENDOR_DRIVER  TUD_DRIVER_VENDOR
+#define _TUD_FUNC_VENDOR_DESC(_itf, _ep, _stridx, _epsize) \
+  TUD_VENDOR_DESCRIPTOR(_itf, _stridx, _ep, 0x80 | (_ep), _epsize)
+#define _TUD_FUNC_VENDOR_MAP    _TUD_FUNC_MSC_MAP
+
+#define _TUD_FUNC_MIDI_ITF     2
+#define _TUD_FUNC_MIDI_EP      1
+#define _TUD_FUNC_MIDI_LEN     TUD_MIDI_DESC_LEN
+#define _TUD_FUNC_MIDI_DRIVER  TUD_DRIVER_MIDI
+#define _TUD_FUNC_MIDI_DESC(_itf, _ep, _stridx, _epsize) \
+  TUD_MIDI_DESCRIPTOR(_itf, _stridx, _ep, 0x80 | (_ep), _epsize)
+#define _TUD_FUNC_MIDI_MAP(_itf, _ep, _func) \
+  .itf2func[_itf] = _func, .itf2func[(_itf) + 1] = _func, \
+  .ep2func[_ep][TUSB_DIR_OUT] = _func, .ep2func[_ep][TUSB_DIR_IN] = _func,
+
+// Expanded for each function of the list
+#define _TUD_CONFIG_ITF_ENUM(_class, _name, ...)   ITF_NUM_##_name, _ITF_NUM_##_name##_LAST = ITF_NUM_##_name + _TUD_FUNC_##_class##_ITF - 1,
+#define _TUD_CONFIG_EP_ENUM(_class, _name, ...)    EPNUM_##_name, _EPNUM_##_name##_LAST = EPNUM_##_name + _TUD_FUNC_##_class##_EP - 1,
+#define _TUD_CONFIG_FUNC_ENUM(_class, _name, ...)  _TUD_FUNC_NUM_##_name,
+#define _TUD_CONFIG_LEN(_class, _name, ...)        + _TUD_FUNC_##_class##_LEN
+#define _TUD_CONFIG_DESC(_class, _name, ...)       _TUD_FUNC_##_class##_DESC(ITF_NUM_##_name, EPNUM_##_name, __VA_ARGS__),
+#define _TUD_CONFIG_MAP(_class, _name, ...) \
+  _TUD_FUNC_##_class##_MAP(ITF_NUM_##_name, EPNUM_##_name, _TUD_FUNC_NUM_##_name) \
+  .func2drv[_TUD_FUNC_NUM_##_name - 1] = _TUD_FUNC_##_class##_DRIVER,
+
+// Interface and endpoint numbers of each function, interface count and total length of configuration _cfg
+#define TUD_CONFIG_ENUM(_cfg, _functions) \
+  enum { _functions(_TUD_CONFIG_ITF_ENUM) _cfg##_ITF_TOTAL }; \
+  enum { _cfg##_EP_RESERVED, _functions(_TUD_CONFIG_EP_ENUM) _cfg##_EP_TOTAL }; \
+  enum { _cfg##_FUNC_RESERVED, _functions(_TUD_CONFIG_FUNC_ENUM) _cfg##_FUNC_TOTAL }; \
+  enum { _cfg##_TOTAL_LEN = TUD_CONFIG_DESC_LEN _functions(_TUD_CONFIG_LEN) }; \
+  TU_VERIFY_STATIC(_cfg##_ITF_TOTAL <= 16, "too many interfaces"); \
+  TU_VERIFY_STATIC(_cfg##_EP_TOTAL <= 8, "too many endpoints")
+
+// Configuration descriptor: string index, attribute, power in mA
+#define TUD_CONFIG_BUILD(_cfg, _functions, _stridx, _attribute, _power_ma) \
+  TUD_CONFIG_DESCRIPTOR(_cfg##_ITF_TOTAL, _stridx, _cfg##_TOTAL_LEN, _attribute, _power_ma), \
+  _functions(_TUD_CONFIG_DESC)
+
+// Initializer of tud_config_map_t
+#define TUD_CONFIG_MAP(_functions) \
+  { _functions(_TUD_CONFIG_MAP) }
+
 
 #ifdef __cplusplus
  }
@@ -32,6 +32,15 @@
 #include "device/usbd_pvt.h"
 #include "dcd.h"
 
+// Transfer whole data stage directly from/to application buffer with one DCD call instead of
+// copying each packet via internal buffer. Application buffer must then meet DCD requirement
+// for DMA (CFG_TUSB_MEM_SECTION, CFG_TUSB_MEM_ALIGN) and DCD must support multiple-packet
+// transfer on control endpoint. Data stage fitting in one packet is still copied, since it is
+// commonly served from the request handler's local variable.
+#ifndef CFG_TUD_CONTROL_ZERO_COPY
+  #define CFG_TUD_CONTROL_ZERO_COPY  0
+#endif
+
 enum
 {
   EDPT_CTRL_OUT = 0x00,
@@ -49,9 +58,20 @@ typedef struct
   bool (*complete_cb) (uint8_t, tusb_control_request_t const *);
 } usbd_control_xfer_t;
 
-static usbd_control_xfer_t _ctrl_xfer;
+static usbd_control_xfer_t _ctrl_xfer[TUD_OPT_RHPORT_COUNT];
 
-CFG_TUSB_MEM_SECTION CFG_TUSB_MEM_ALIGN static uint8_t _usbd_ctrl_buf[CFG_TUD_ENDPOINT0_SIZE];
+CFG_TUSB_MEM_SECTION CFG_TUSB_MEM_ALIGN static uint8_t _usbd_ctrl_buf[TUD_OPT_RHPORT_COUNT][CFG_TUD_ENDPOINT0_SIZE];
+
+// Check if data stage is transferred packet by packet via internal buffer
+static inline bool _use_ctrl_buf(usbd_control_xfer_t const* p_ctrl)
+{
+#if CFG_TUD_CONTROL_ZERO_COPY
+  return p_ctrl->data_len <= CFG_TUD_ENDPOINT0_SIZE;
+#else
+  (void) p_ctrl;
+  return true;
+#endif
+}
 
 
 //--------------------------------------------------------------------+
@@ -66,40 +86,68 @@ static inline bool _status_stage_xact(uint8_t rhport, tusb_control_request_t con
 
 bool tud_control_status(uint8_t rhport, tusb_control_request_t const * request)
 {
-  _ctrl_xfer.request       = (*request);
-  _ctrl_xfer.buffer        = NULL;
-  _ctrl_xfer.total_xferred = 0;
-  _ctrl_xfer.data_len      = 0;
+  usbd_control_xfer_t* p_ctrl = &_ctrl_xfer[USBD_RHPORT_IDX(rhport)];
+
+  p_ctrl->request       = (*request);
+  p_ctrl->buffer        = NULL;
+  p_ctrl->total_xferred = 0;
+  p_ctrl->data_len      = 0;
 
   return _status_stage_xact(rhport, request);
 }
 
 // Transfer an transaction in Data Stage
-// Each transaction has up to Endpoint0's max packet size.
+// Each transaction has up to Endpoint0's max packet size, unless whole data stage is
+// transferred directly with application buffer.
 // This function can also transfer an zero-length packet
 static bool _data_stage_xact(uint8_t rhport)
 {
-  uint16_t const xact_len = tu_min16(_ctrl_xfer.data_len - _ctrl_xfer.total_xferred, CFG_TUD_ENDPOINT0_SIZE);
+  usbd_control_xfer_t* p_ctrl = &_ctrl_xfer[USBD_RHPORT_IDX(rhport)];
+
+  uint16_t xact_len = (uint16_t) (p_ctrl->data_len - p_ctrl->total_xferred);
+  uint8_t* xact_buf = p_ctrl->buffer;
 
-  uint8_t ep_addr = EDPT_CTRL_OUT;
+  uint8_t const ep_addr = (p_ctrl->request.bmRequestType_bit.direction == TUSB_DIR_IN) ? EDPT_CTRL_IN : EDPT_CTRL_OUT;
 
-  if ( _ctrl_xfer.request.bmRequestType_bit.direction == TUSB_DIR_IN )
+  if ( _use_ctrl_buf(p_ctrl) )
   {
-    ep_addr = EDPT_CTRL_IN;
-    if ( xact_len ) memcpy(_usbd_ctrl_buf, _ctrl_xfer.buffer, xact_len);
+    xact_len = tu_min16(xact_len, CFG_TUD_ENDPOINT0_SIZE);
+    xact_buf = _usbd_ctrl_buf[USBD_RHPORT_IDX(rhport)];
+
+    if ( (ep_addr == EDPT_CTRL_IN) && xact_len ) tu_memcpy(xact_buf, p_ctrl->buffer, xact_len);
   }
 
-  return dcd_edpt_xfer(rhport, ep_addr, xact_len ? _usbd_ctrl_buf : NULL, xact_len);
+  return dcd_edpt_xfer(rhport, ep_addr, xact_len ? xact_buf : NULL, xact_len);
+}
+
+// Data Stage is complete when all request's length are transferred or
+// a short packet is sent including zero-length packet.
+static bool _data_stage_complete(usbd_control_xfer_t const* p_ctrl, uint32_t xferred_bytes)
+{
+  if ( p_ctrl->request.wLength == p_ctrl->total_xferred ) return true;
+
+#if CFG_TUD_CONTROL_ZERO_COPY
+  // xferred_bytes covers multiple packets, ended early by a short packet from host
+  if ( (xferred_bytes == 0) || (p_ctrl->total_xferred < p_ctrl->data_len) ) return true;
+
+  // IN data shorter than requested is sent completely, but must be terminated by an
+  // zero-length packet if it ends with a full packet
+  return (p_ctrl->request.bmRequestType_bit.direction == TUSB_DIR_OUT) || (p_ctrl->data_len % CFG_TUD_ENDPOINT0_SIZE);
+#else
+  return xferred_bytes < CFG_TUD_ENDPOINT0_SIZE;
+#endif
 }
 
 bool tud_control_xfer(uint8_t rhport, tusb_control_request_t const * request, void* buffer, uint16_t len)
 {
-  _ctrl_xfer.request       = (*request);
-  _ctrl_xfer.buffer        = (uint8_t*) buffer;
-  _ctrl_xfer.total_xferred = 0;
-  _ctrl_xfer.data_len      = tu_min16(len, request->wLength);
+  usbd_control_xfer_t* p_ctrl = &_ctrl_xfer[USBD_RHPORT_IDX(rhport)];
 
-  if ( _ctrl_xfer.data_len )
+  p_ctrl->request       = (*request);
+  p_ctrl->buffer        = (uint8_t*) buffer;
+  p_ctrl->total_xferred = 0;
+  p_ctrl->data_len      = tu_min16(len, request->wLength);
+
+  if ( p_ctrl->data_len )
   {
     TU_ASSERT(buffer);
 
@@ -120,14 +168,13 @@ bool tud_control_xfer(uint8_t rhport, tusb_control_request_t const * request, vo
 
 void usbd_control_reset (uint8_t rhport)
 {
-  (void) rhport;
-  tu_varclr(&_ctrl_xfer);
+  tu_varclr(&_ctrl_xfer[USBD_RHPORT_IDX(rhport)]);
 }
 
 // TODO may find a better way
-void usbd_control_set_complete_callback( bool (*fp) (uint8_t, tusb_control_request_t const * ) )
+void usbd_control_set_complete_callback(uint8_t rhport, bool (*fp) (uint8_t, tusb_control_request_t const * ) )
 {
-  _ctrl_xfer.complete_cb = fp;
+  _ctrl_xfer[USBD_RHPORT_IDX(rhport)].complete_cb = fp;
 }
 
 // callback when a transaction complete on DATA stage of control endpoint
@@ -135,40 +182,40 @@ bool usbd_control_xfer_cb (uint8_t rhport, uint8_t ep_addr, xfer_result_t result
 {
   (void) result;
 
+  usbd_control_xfer_t* p_ctrl = &_ctrl_xfer[USBD_RHPORT_IDX(rhport)];
+
   // Endpoint Address is opposite to direction bit, this is Status Stage complete event
-  if ( tu_edpt_dir(ep_addr) != _ctrl_xfer.request.bmRequestType_bit.direction )
+  if ( tu_edpt_dir(ep_addr) != p_ctrl->request.bmRequestType_bit.direction )
   {
     TU_ASSERT(0 == xferred_bytes);
     return true;
   }
 
-  if ( _ctrl_xfer.request.bmRequestType_bit.direction == TUSB_DIR_OUT )
+  if ( _use_ctrl_buf(p_ctrl) && (p_ctrl->request.bmRequestType_bit.direction == TUSB_DIR_OUT) )
   {
-    TU_VERIFY(_ctrl_xfer.buffer);
-    memcpy(_ctrl_xfer.buffer, _usbd_ctrl_buf, xferred_bytes);
+    TU_VERIFY(p_ctrl->buffer);
+    tu_memcpy(p_ctrl->buffer, _usbd_ctrl_buf[USBD_RHPORT_IDX(rhport)], xferred_bytes);
   }
 
-  _ctrl_xfer.total_xferred += xferred_bytes;
-  _ctrl_xfer.buffer += xferred_bytes;
+  p_ctrl->total_xferred += xferred_bytes;
+  p_ctrl->buffer += xferred_bytes;
 
-  // Data Stage is complete when all request's length are transferred or
-  // a short packet is sent including zero-length packet.
-  if ( (_ctrl_xfer.request.wLength == _ctrl_xfer.total_xferred) || xferred_bytes < CFG_TUD_ENDPOINT0_SIZE )
+  if ( _data_stage_complete(p_ctrl, xferred_bytes) )
   {
     // DATA stage is complete
     bool is_ok = true;
 
     // invoke complete callback if set
     // callback can still stall control in status phase e.g out data does not make sense
-    if ( _ctrl_xfer.complete_cb )
+    if ( p_ctrl->complete_cb )
     {
-      is_ok = _ctrl_xfer.complete_cb(rhport, &_ctrl_xfer.request);
+      is_ok = p_ctrl->complete_cb(rhport, &p_ctrl->request);
     }
 
     if ( is_ok )
     {
       // Send status
-      TU_ASSERT( _status_stage_xact(rhport, &_ctrl_xfer.request) );
+      TU_ASSERT( _status_stage_xact(rhport, &p_ctrl->request) );
     }else
     {
       // Stall both IN and OUT control endpoint
@@ -33,18 +33,85 @@
  extern "C" {
 #endif
 
+// Index of per roothub port data, all data is at index 0 if only one port is device
+#define USBD_RHPORT_IDX(_rhport)   ( (TUD_OPT_RHPORT_COUNT > 1) ? (_rhport) : 0 )
+
+//--------------------------------------------------------------------+
+// Class Driver API
+//--------------------------------------------------------------------+
+typedef struct {
+  uint8_t class_code;
+
+  void (* init             ) (void);
+  void (* reset            ) (uint8_t rhport);
+  bool (* open             ) (uint8_t rhport, tusb_desc_interface_t const * desc_intf, uint16_t* p_length, uint8_t* p_inst);
+  bool (* control_request  ) (uint8_t rhport, tusb_control_request_t const * request);
+  bool (* control_complete ) (uint8_t rhport, tusb_control_request_t const * request);
+  bool (* xfer_cb          ) (uint8_t rhport, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes);
+  void (* sof              ) (uint8_t rhport);
+
+  // Optional, invoked in interrupt context when transfer completes e.g to re-arm endpoint
+  // with minimal latency. Return true if handled, false to defer to xfer_cb in tud_task.
+  // Must return false without touching the endpoint when deferring.
+  bool (* xfer_isr_cb      ) (uint8_t rhport, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes);
+
+  // Optional, usbd then answers GET_INTERFACE and SET_INTERFACE of the driver's interfaces itself.
+  // open() claims all alternate settings and opens endpoints of the default one. On SET_INTERFACE,
+  // endpoints of the current alternate are closed (transfers dropped without xfer_cb) and those of
+  // the new one opened, then set_alt gets the new interface descriptor with its length (class-specific
+  // and endpoint descriptors included) to start transfers. Return false to stall the request.
+  bool (* set_alt          ) (uint8_t rhport, tusb_desc_interface_t const * desc_itf, uint16_t desc_len);
+
+  // Optional with CFG_TUD_SPLIT_CORE, invoked in tud_task() after application core rang the doorbell
+  void (* doorbell         ) (uint8_t rhport);
+
+  // Optional with CFG_TUD_FAST_RESET, invoked once per instance when host selects again the configuration
+  // kept over bus reset (reset and open are skipped). Endpoints of default alternates are opened already,
+  // their transfers were aborted by reset without xfer_cb. Driver restarts them e.g arming OUT endpoint
+  void (* reopen           ) (uint8_t rhport, uint8_t inst);
+} usbd_class_driver_t;
+
+// Invoked once by tud_init() to get application class drivers. Returned array must stay
+// valid forever. Application drivers are matched against interface class code before
+// built-in ones, therefore can also replace a built-in driver of the same class.
+TU_ATTR_WEAK usbd_class_driver_t const* usbd_app_driver_get_cb(uint8_t* driver_count);
+
+#if TUSB_OPT_DUAL_ROLE
+// Dual-role port enters device role again after tud_init(): controller is initialized in device mode
+bool usbd_role_start(uint8_t rhport);
+
+// Dual-role port leaves device role: device is unmounted as if unplugged, pending events are dropped
+void usbd_role_stop(uint8_t rhport);
+#endif
+
 //--------------------------------------------------------------------+
 // USBD Endpoint API
 //--------------------------------------------------------------------+
 
 //bool usbd_edpt_open(uint8_t rhport, tusb_desc_endpoint_t const * p_endpoint_desc);
 
-// Submit a usb transfer
-bool usbd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint16_t total_bytes);
+// Submit a usb transfer. With CFG_TUD_EDPT_XFER_QUEUE, transfer on a busy endpoint is
+// queued and started as soon as the current one completes, or linked behind it by the DCD
+// if supported. Each queued transfer still gets its own xfer_cb. Return false if queue is full.
+bool usbd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint32_t total_bytes);
+
+// Submit segments as a single usb transfer, xfer_cb is invoked once with total bytes.
+// Segment list and buffers must stay valid until transfer completes. DCD chains segments
+// natively if possible, otherwise data is copied via a bounce buffer of
+// CFG_TUD_EDPT_XFER_SG_BUFSIZE. Endpoint must not be busy (transfer is never queued).
+bool usbd_edpt_xfer_sg(uint8_t rhport, uint8_t ep_addr, xfer_seg_t const * segs, uint8_t count);
+
+// End transfers of exact multiple of packet size on opened bulk/interrupt IN endpoint with a zero-length
+// packet, so that host completes its read right away. Controller appends it if supported (dcd_edpt_auto_zlp),
+// otherwise usbd sends it and reports completion after it. Disabled when endpoint is closed or bus is reset.
+void usbd_edpt_zlp(uint8_t rhport, tusb_desc_endpoint_t const * desc_ep);
 
 // Check if endpoint transferring is complete
 bool usbd_edpt_busy(uint8_t rhport, uint8_t ep_addr);
 
+// Capabilities of the controller, e.g to pick larger transfers and deeper queues per port
+void usbd_dcd_caps(uint8_t rhport, dcd_caps_t* caps);
+
 // Stall endpoint
 void usbd_edpt_stall(uint8_t rhport, uint8_t ep_addr);
 
@@ -54,6 +121,10 @@ void usbd_edpt_clear_stall(uint8_t rhport, uint8_t ep_addr);
 // Check if endpoint is stalled
 bool usbd_edpt_stalled(uint8_t rhport, uint8_t ep_addr);
 
+// Request (en = true) or release SOF, driver's sof() is only invoked while requested by at least one
+// driver and DCD unmasks SOF interrupt meanwhile. Requests are dropped by bus reset, i.e before reset().
+void usbd_sof_enable(uint8_t rhport, bool en);
+
 static inline
 bool usbd_edpt_ready(uint8_t rhport, uint8_t ep_addr)
 {
@@ -65,8 +136,46 @@ bool usbd_edpt_ready(uint8_t rhport, uint8_t ep_addr)
  *------------------------------------------------------------------*/
 
 bool usbd_open_edpt_pair(uint8_t rhport, uint8_t const* p_desc, uint8_t ep_count, uint8_t xfer_type, uint8_t* ep_out, uint8_t* ep_in);
+
+// Instance of class driver owning interface/endpoint, as reported by driver's open() for
+// current configuration. Return USBD_INST_INVALID if not opened.
+enum { USBD_INST_INVALID = 0xFFu };
+
+uint8_t usbd_itf_inst(uint8_t rhport, uint8_t itf_num);
+uint8_t usbd_edpt_inst(uint8_t rhport, uint8_t ep_addr);
+
 void usbd_defer_func( osal_task_func_t func, void* param, bool in_isr );
 
+#if CFG_TUD_SPLIT_CORE
+// Application core requests work from stack core, flag is only set there and only cleared by stack core.
+// Doorbell is not rung again while a request is pending.
+static inline void usbd_split_request(volatile bool* flag)
+{
+  TU_MEM_BARRIER(); // FIFO update is visible before the request
+  if ( !(*flag) )
+  {
+    (*flag) = true;
+    tud_split_doorbell_cb();
+  }
+}
+
+// Stack core takes a request in its doorbell(), cleared before the work so that a new one is not lost
+static inline bool usbd_split_take(volatile bool* flag)
+{
+  if ( !(*flag) ) return false;
+  (*flag) = false;
+  TU_MEM_BARRIER(); // FIFO is read after the request is taken
+  return true;
+}
+#endif
+
+#if CFG_TUD_EP_POOL_COUNT
+// Borrow a CFG_TUD_EP_POOL_BUFSIZE bytes transfer buffer from shared pool, NULL if all are in use.
+// Must not be called in ISR, buffer is returned with usbd_ep_buf_free() once its transfer is complete.
+uint8_t* usbd_ep_buf_alloc(void);
+void     usbd_ep_buf_free(uint8_t* buf);
+#endif
+
 
 #ifdef __cplusplus
  }
@@ -46,16 +46,44 @@
 // Periodic frame list must be 4K alignment
 CFG_TUSB_MEM_SECTION TU_ATTR_ALIGNED(4096) static ehci_data_t ehci_data;
 
+// Periodic bandwidth
+enum {
+  // USB 2.0 5.7.4: periodic transfers may use up to 80% of micro frame (high speed) and 90% of frame
+  EHCI_HS_UFRAME_BUDGET = 6000, // bytes, 80% of 7500
+  EHCI_FS_FRAME_BUDGET  = 1350, // full speed bytes, 90% of 1500
+
+  // approximate token/handshake/inter-packet overhead per transaction in bytes
+  EHCI_HS_XACT_OVERHEAD = 55,
+  EHCI_FS_XACT_OVERHEAD = 13,
+
+  // max payload of a split transaction in a micro frame (EHCI 4.12.3)
+  EHCI_SPLIT_PAYLOAD    = 188,
+};
+
 // EHCI portable
 uint32_t hcd_ehci_register_addr(uint8_t rhport);
 
+#if TUSB_OPT_DUAL_ROLE
+// Reset controller of dual-role port and put it in host mode, device role may have been using it
+void hcd_ehci_role_host(uint8_t rhport);
+#endif
+
 //--------------------------------------------------------------------+
 // PROTOTYPE
 //--------------------------------------------------------------------+
-static inline ehci_link_t* get_period_head(uint8_t rhport, uint8_t interval_ms)
+// interval_ms is power of 2 up to EHCI_PERIOD_FRAMES
+static inline ehci_link_t* get_period_head(uint8_t rhport, uint8_t interval_ms, uint8_t phase)
 {
   (void) rhport;
-  return (ehci_link_t*) &ehci_data.period_head_arr[ tu_log2( tu_min8(EHCI_FRAMELIST_SIZE, interval_ms) ) ];
+  return (ehci_link_t*) &ehci_data.period_head_arr[ interval_ms - 1 + (phase & (interval_ms-1)) ];
+}
+
+// next item is a dummy tree node i.e end of its interval list
+static inline bool is_period_head(uint32_t link_addr)
+{
+  uint32_t const addr = tu_align32(link_addr);
+  return ( addr >= (uint32_t) ehci_data.period_head_arr ) &&
+         ( addr <  (uint32_t) (ehci_data.period_head_arr + TU_ARRAY_SIZE(ehci_data.period_head_arr)) );
 }
 
 static inline ehci_qhd_t* qhd_control(uint8_t dev_addr)
@@ -77,23 +105,58 @@ static inline ehci_qtd_t* qtd_control(uint8_t dev_addr)
 
 static inline ehci_qhd_t* qhd_next (ehci_qhd_t const * p_qhd);
 static inline ehci_qhd_t* qhd_find_free (void);
+static inline void qhd_free (ehci_qhd_t* p_qhd);
 static inline ehci_qhd_t* qhd_get_from_addr (uint8_t dev_addr, uint8_t ep_addr);
+static void qhd_reclaim_removed (uint8_t rhport, bool async_advanced);
 
-// determine if a queue head has bus-related error
+// Removal state of qhd unlinked from schedule, HC may still hold it until then
+enum
+{
+  QHD_REMOVE_NONE = 0,
+  QHD_REMOVE_ASYNC,     // unlinked from async list after current doorbell (if any) was rung
+  QHD_REMOVE_DOORBELL,  // covered by the doorbell in progress, freed on async advance interrupt
+  QHD_REMOVE_PERIOD,    // unlinked from period list, freed once HC has crossed a frame boundary
+};
+
+// determine if a queue head has bus-related error. For split transaction, ping state bit is ERR handshake
+// from the hub (EHCI 4.12.1.2). Missed micro frame is not an error, HC retries the split in next frame
 static inline bool qhd_has_xact_error (ehci_qhd_t * p_qhd)
 {
-  return (p_qhd->qtd_overlay.buffer_err || p_qhd->qtd_overlay.babble_err || p_qhd->qtd_overlay.xact_err);
-  //p_qhd->qtd_overlay.non_hs_period_missed_uframe || p_qhd->qtd_overlay.pingstate_err TODO split transaction error
+  bool const split_err = (p_qhd->ep_speed != TUSB_SPEED_HIGH) && p_qhd->qtd_overlay.ping_err;
+  return (p_qhd->qtd_overlay.buffer_err || p_qhd->qtd_overlay.babble_err || p_qhd->qtd_overlay.xact_err || split_err);
 }
 
 static void qhd_init (ehci_qhd_t *p_qhd, uint8_t dev_addr, tusb_desc_endpoint_t const * ep_desc);
+static bool period_schedule (ehci_qhd_t *p_qhd, uint8_t interval);
+static void period_bw_update (ehci_qhd_t const *p_qhd, bool reserve);
+static void period_cost (uint8_t speed, uint8_t tt_think, uint16_t max_packet_size, uint8_t mult, uint16_t* hs_cost, uint16_t* fs_cost);
+static void period_bw_reserve (uint8_t tt, uint8_t phase, uint8_t period, uint8_t uframe_mask, uint16_t hs_cost, uint16_t fs_cost, bool reserve);
+static bool period_find_slot (uint8_t tt, uint8_t period, uint8_t smask0, uint8_t cmask0, uint8_t nstart, uint16_t hs_cost, uint16_t fs_cost,
+                              uint8_t* phase, uint8_t* smask, uint8_t* cmask);
+static void period_hs_interval (uint8_t interval, uint8_t* period, uint8_t* smask0, uint8_t* nstart);
+
+#if CFG_TUH_ISO_EP
+static ehci_iso_t* iso_get (uint8_t dev_addr, uint8_t ep_addr);
+static bool iso_open (uint8_t dev_addr, tusb_desc_endpoint_t const * ep_desc);
+static void iso_close (ehci_iso_t* iso);
+static void iso_xfer_complete_isr (void);
+#endif
 
 static inline ehci_qtd_t* qtd_find_free (void);
+static inline void qtd_free (ehci_qtd_t* p_qtd);
 static inline ehci_qtd_t* qtd_next (ehci_qtd_t const * p_qtd);
-static inline void qtd_insert_to_qhd (ehci_qhd_t *p_qhd, ehci_qtd_t *p_qtd_new);
+static inline void qtd_insert_to_qhd (ehci_qhd_t *p_qhd, ehci_qtd_t *p_first, ehci_qtd_t *p_last);
+static inline bool qtd_is_chained (ehci_qtd_t const * p_qtd);
+static inline uint32_t qtd_xferred_bytes (ehci_qtd_t const * p_qtd);
+static bool qtd_chain_retire_last_ioc (ehci_qhd_t *p_qhd);
+static inline void qhd_attach_qtd_list(ehci_qhd_t *p_qhd);
 static inline void qtd_remove_1st_from_qhd (ehci_qhd_t *p_qhd);
 static void qtd_init (ehci_qtd_t* p_qtd, void* buffer, uint16_t total_bytes);
 
+static inline uint16_t qhd_timer_idx (ehci_qhd_t const * p_qhd);
+static void qhd_timer_restart (ehci_qhd_t const * p_qhd);
+static void xfer_timeout_isr (uint8_t rhport);
+
 static inline void list_insert (ehci_link_t *current, ehci_link_t *new, uint8_t new_type);
 static inline ehci_link_t* list_next (ehci_link_t *p_link_pointer);
 
@@ -105,6 +168,16 @@ static bool ehci_init (uint8_t rhport);
 bool hcd_init(void)
 {
   tu_memclr(&ehci_data, sizeof(ehci_data_t));
+
+  // all pool entries are free
+  for(uint32_t i=0; i<HCD_MAX_ENDPOINT; i++) ehci_data.qhd_free[i] = (uint8_t) i;
+  for(uint32_t i=0; i<EHCI_MAX_QTD; i++)     ehci_data.qtd_free[i] = (uint8_t) i;
+  ehci_data.qhd_free_count = HCD_MAX_ENDPOINT;
+  ehci_data.qtd_free_count = EHCI_MAX_QTD;
+
+  ehci_data.qtd_halt.next.terminate      = 1;
+  ehci_data.qtd_halt.alternate.terminate = 1;
+
   return ehci_init(TUH_OPT_RHPORT);
 }
 
@@ -130,32 +203,35 @@ tusb_speed_t hcd_port_speed_get(uint8_t rhport)
   return (tusb_speed_t) ehci_data.regs->portsc_bm.nxp_port_speed; // NXP specific port speed
 }
 
+// Unlink qhds of device, they and their qtds are freed by qhd_reclaim_removed() once HC cannot reference them
 static void list_remove_qhd_by_addr(ehci_link_t* list_head, uint8_t dev_addr)
 {
-  for(ehci_link_t* prev = list_head;
-      !prev->terminate && (tu_align32(prev->address) != (uint32_t) list_head);
-      prev = list_next(prev) )
+  // period list ends at the next dummy head of the tree. Only qhds are linked there, iTD/siTD are in frame list
+  ehci_link_t* prev = list_head;
+
+  while ( !prev->terminate && (tu_align32(prev->address) != (uint32_t) list_head) && !is_period_head(prev->address) )
   {
-    // TODO check type for ISO iTD and siTD
     ehci_qhd_t* qhd = (ehci_qhd_t*) list_next(prev);
-    if ( qhd->dev_addr == dev_addr )
+    if ( qhd->dev_addr != dev_addr )
     {
-      // TODO deactive all TD, wait for QHD to inactive before removal
-      prev->address = qhd->next.address;
+      prev = list_next(prev);
+      continue;
+    }
 
+    // prev now links the one after, which is checked next
+    prev->address = qhd->next.address;
+
+    if ( qhd->int_smask )
+    {
+      // next link is kept for HC still walking it in current frame
+      period_bw_update(qhd, false);
+      ehci_data.qhd_unlink_frame[qhd - ehci_data.qhd_pool] = (uint16_t) hcd_frame_number(TUH_OPT_RHPORT);
+      qhd->removing = QHD_REMOVE_PERIOD;
+    }else
+    {
       // EHCI 4.8.2 link the removed qhd to async head (which always reachable by Host Controller)
       qhd->next.address = ((uint32_t) list_head) | (EHCI_QTYPE_QHD << 1);
-
-      if ( qhd->int_smask )
-      {
-        // period list queue element is guarantee to be free in the next frame (1 ms)
-        qhd->used = 0;
-      }else
-      {
-        // async list use async advance handshake
-        // mark as removing, will completely re-usable when async advance isr occurs
-        qhd->removing = 1;
-      }
+      qhd->removing = QHD_REMOVE_ASYNC;
     }
   }
 }
@@ -166,6 +242,9 @@ void hcd_device_close(uint8_t rhport, uint8_t dev_addr)
   // skip dev0
   if (dev_addr == 0) return;
 
+  // free list is shared with isr
+  hcd_int_disable(rhport);
+
   // Remove from async list
   list_remove_qhd_by_addr( (ehci_link_t*) qhd_async_head(rhport), dev_addr );
 
@@ -175,13 +254,29 @@ void hcd_device_close(uint8_t rhport, uint8_t dev_addr)
     list_remove_qhd_by_addr( (ehci_link_t*) &ehci_data.period_head_arr[i], dev_addr);
   }
 
-  // Async doorbell (EHCI 4.8.2 for operational details)
-  ehci_data.regs->command_bm.async_adv_doorbell = 1;
+  tu_memclr(ehci_data.ep2qhd[dev_addr-1], sizeof(ehci_data.ep2qhd[0]));
+  ehci_data.qhd_timeout[HCD_MAX_ENDPOINT + dev_addr] = 0; // control qhd is not freed
+
+#if CFG_TUH_ISO_EP
+  for(uint8_t i = 0; i < CFG_TUH_ISO_EP; i++)
+  {
+    if ( ehci_data.iso[i].dev_addr == dev_addr ) iso_close(&ehci_data.iso[i]);
+  }
+#endif
+
+  // rings async doorbell (EHCI 4.8.2) for removed async qhds
+  qhd_reclaim_removed(rhport, false);
+
+  hcd_int_enable(rhport);
 }
 
 // EHCI controller init
 static bool ehci_init(uint8_t rhport)
 {
+#if TUSB_OPT_DUAL_ROLE
+  hcd_ehci_role_host(rhport);
+#endif
+
   ehci_data.regs = (ehci_registers_t* ) hcd_ehci_register_addr(rhport);
 
   ehci_registers_t* regs = ehci_data.regs;
@@ -192,7 +287,8 @@ static bool ehci_init(uint8_t rhport)
   regs->status = EHCI_INT_MASK_ALL; // 2. clear all status
 
   regs->inten  = EHCI_INT_MASK_ERROR | EHCI_INT_MASK_PORT_CHANGE | EHCI_INT_MASK_ASYNC_ADVANCE |
-                 EHCI_INT_MASK_NXP_PERIODIC | EHCI_INT_MASK_NXP_ASYNC ;
+                 EHCI_INT_MASK_NXP_PERIODIC | EHCI_INT_MASK_NXP_ASYNC |
+                 EHCI_INT_MASK_FRAMELIST_ROLLOVER; // frame counter & transfer timeout
 
   //------------- Asynchronous List -------------//
   ehci_qhd_t * const async_head = qhd_async_head(rhport);
@@ -207,41 +303,33 @@ static bool ehci_init(uint8_t rhport)
   regs->async_list_addr = (uint32_t) async_head;
 
   //------------- Periodic List -------------//
-  // Build the polling interval tree with 1 ms, 2 ms, 4 ms and 8 ms (framesize) only
-  for(uint32_t i=0; i<4; i++)
+  // Build the polling interval tree: frame i --> head (N, i % N) --> ... --> head (2, i % 2) --> head (1, 0)
+  for(uint32_t i=0; i<TU_ARRAY_SIZE(ehci_data.period_head_arr); i++)
   {
     ehci_data.period_head_arr[i].int_smask    = 1; // queue head in period list must have smask non-zero
     ehci_data.period_head_arr[i].qtd_overlay.halted = 1; // dummy node, always inactive
   }
 
-  ehci_link_t * const framelist  = ehci_data.period_framelist;
-  ehci_link_t * const period_1ms = get_period_head(rhport, 1);
-  // all links --> period_head_arr[0] (1ms)
-  // 0, 2, 4, 6 etc --> period_head_arr[1] (2ms)
-  // 1, 5 --> period_head_arr[2] (4ms)
-  // 3 --> period_head_arr[3] (8ms)
-
-  // TODO EHCI_FRAMELIST_SIZE with other size than 8
-  for(uint32_t i=0; i<EHCI_FRAMELIST_SIZE; i++)
+  for(uint8_t interval=2; interval <= EHCI_PERIOD_FRAMES; interval *= 2)
   {
-    framelist[i].address = (uint32_t) period_1ms;
-    framelist[i].type    = EHCI_QTYPE_QHD;
+    for(uint8_t phase=0; phase < interval; phase++)
+    {
+      ehci_link_t * const head = get_period_head(rhport, interval, phase);
+      head->address = (uint32_t) get_period_head(rhport, interval/2, phase);
+      head->type    = EHCI_QTYPE_QHD;
+    }
   }
 
-  for(uint32_t i=0; i<EHCI_FRAMELIST_SIZE; i+=2)
-  {
-    list_insert(framelist + i, get_period_head(rhport, 2), EHCI_QTYPE_QHD);
-  }
+  ehci_link_t * const period_1ms = get_period_head(rhport, 1, 0);
+  period_1ms->terminate    = 1;
 
-  for(uint32_t i=1; i<EHCI_FRAMELIST_SIZE; i+=4)
+  ehci_link_t * const framelist  = ehci_data.period_framelist;
+  for(uint32_t i=0; i<EHCI_FRAMELIST_SIZE; i++)
   {
-    list_insert(framelist + i, get_period_head(rhport, 4), EHCI_QTYPE_QHD);
+    framelist[i].address = (uint32_t) get_period_head(rhport, EHCI_PERIOD_FRAMES, (uint8_t) i);
+    framelist[i].type    = EHCI_QTYPE_QHD;
   }
 
-  list_insert(framelist+3, get_period_head(rhport, 8), EHCI_QTYPE_QHD);
-
-  period_1ms->terminate    = 1;
-
   regs->periodic_list_base = (uint32_t) framelist;
 
   //------------- TT Control (NXP only) -------------//
@@ -303,6 +391,7 @@ bool hcd_edpt_xfer(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr, uint8_t *
 
     // attach TD
     qhd->qtd_overlay.next.address = (uint32_t) qtd;
+    qhd_timer_restart(qhd);
   }
 
   return true;
@@ -326,6 +415,7 @@ bool hcd_setup_send(uint8_t rhport, uint8_t dev_addr, uint8_t const setup_packet
 
   // attach TD
   qhd->qtd_overlay.next.address = (uint32_t) td;
+  qhd_timer_restart(qhd);
 
   return true;
 }
@@ -337,8 +427,15 @@ bool hcd_edpt_open(uint8_t rhport, uint8_t dev_addr, tusb_desc_endpoint_t const
 {
   (void) rhport;
 
-  // TODO not support ISO yet
-  TU_ASSERT (ep_desc->bmAttributes.xfer != TUSB_XFER_ISOCHRONOUS);
+  // isochronous endpoint uses iTD/siTD linked to frame list instead of queue head
+  if ( ep_desc->bmAttributes.xfer == TUSB_XFER_ISOCHRONOUS )
+  {
+#if CFG_TUH_ISO_EP
+    return iso_open(dev_addr, ep_desc);
+#else
+    return false;
+#endif
+  }
 
   //------------- Prepare Queue Head -------------//
   ehci_qhd_t * p_qhd;
@@ -346,6 +443,14 @@ bool hcd_edpt_open(uint8_t rhport, uint8_t dev_addr, tusb_desc_endpoint_t const
   if ( ep_desc->bEndpointAddress == 0 )
   {
     p_qhd = qhd_control(dev_addr);
+
+    // address reused right after previous device is closed, its qhd may still be cached by HC
+    hcd_int_disable(rhport);
+    if ( p_qhd->removing ) qhd_reclaim_removed(rhport, false);
+    bool const removing = (p_qhd->removing != QHD_REMOVE_NONE);
+    hcd_int_enable(rhport);
+
+    TU_VERIFY(!removing);
   }else
   {
     p_qhd = qhd_find_free();
@@ -353,10 +458,24 @@ bool hcd_edpt_open(uint8_t rhport, uint8_t dev_addr, tusb_desc_endpoint_t const
   TU_ASSERT(p_qhd);
 
   qhd_init(p_qhd, dev_addr, ep_desc);
+  ehci_data.qhd_timeout[qhd_timer_idx(p_qhd)] = 0;
+
+  if ( ep_desc->bmAttributes.xfer == TUSB_XFER_INTERRUPT && !period_schedule(p_qhd, ep_desc->bInterval) )
+  {
+    qhd_free(p_qhd);
+    return false;
+  }
 
   // control of dev0 is always present as async head
   if ( dev_addr == 0 ) return true;
 
+  if ( ep_desc->bEndpointAddress != 0 )
+  {
+    uint8_t const epnum = tu_edpt_number(ep_desc->bEndpointAddress);
+    uint8_t const dir   = tu_edpt_dir(ep_desc->bEndpointAddress);
+    ehci_data.ep2qhd[dev_addr-1][epnum-1][dir] = (uint8_t) (p_qhd - ehci_data.qhd_pool + 1);
+  }
+
   // Insert to list
   ehci_link_t * list_head;
 
@@ -368,11 +487,7 @@ bool hcd_edpt_open(uint8_t rhport, uint8_t dev_addr, tusb_desc_endpoint_t const
     break;
 
     case TUSB_XFER_INTERRUPT:
-      list_head = get_period_head(rhport, p_qhd->interval_ms);
-    break;
-
-    case TUSB_XFER_ISOCHRONOUS:
-      // TODO iso is not supported
+      list_head = get_period_head(rhport, p_qhd->interval_ms, ehci_data.period_phase[p_qhd - ehci_data.qhd_pool]);
     break;
 
     default: break;
@@ -384,36 +499,95 @@ bool hcd_edpt_open(uint8_t rhport, uint8_t dev_addr, tusb_desc_endpoint_t const
   return true;
 }
 
-bool hcd_pipe_queue_xfer(uint8_t dev_addr, uint8_t ep_addr, uint8_t buffer[], uint16_t total_bytes)
+// Release qtds of a chain not attached to qhd yet
+static void qtd_chain_release(ehci_qtd_t *p_first, ehci_qtd_t *p_last)
 {
-  //------------- set up QTD -------------//
-  ehci_qhd_t *p_qhd = qhd_get_from_addr(dev_addr, ep_addr);
-  ehci_qtd_t *p_qtd = qtd_find_free();
+  while ( p_first )
+  {
+    ehci_qtd_t* p_next = (p_first == p_last) ? NULL : qtd_next(p_first);
+    qtd_free(p_first);
+    p_first = p_next;
+  }
+}
+
+// Transfer is split into qtds of up to 5 pages each. All but the last one are a multiple of packet
+// size so that only the last one can end with a short packet. For IN, a short packet in the middle
+// makes HC jump to halt qtd (alternate next) instead of executing the rest of the chain.
+static bool pipe_queue_xfer(ehci_qhd_t *p_qhd, uint8_t buffer[], uint32_t total_bytes, bool int_on_complete, bool start)
+{
+  ehci_qtd_t* p_first = NULL;
+  ehci_qtd_t* p_last  = NULL;
+
+  // qtd pool and TD list are shared with isr
+  hcd_int_disable(TUH_OPT_RHPORT);
+
+  do
+  {
+    ehci_qtd_t* p_qtd = qtd_find_free();
+    if ( !p_qtd )
+    {
+      qtd_chain_release(p_first, p_last);
+      hcd_int_enable(TUH_OPT_RHPORT);
+    }
+    TU_ASSERT(p_qtd);
+
+    uint32_t xact_len = tu_min32(total_bytes, 5*4096 - (((uint32_t) buffer) & 0xfffu));
+    if ( xact_len < total_bytes ) xact_len -= xact_len % p_qhd->max_packet_size;
+
+    qtd_init(p_qtd, buffer, (uint16_t) xact_len);
+    p_qtd->pid = p_qhd->pid;
+
+    if ( p_last )
+    {
+      p_last->next.address = (uint32_t) p_qtd;
+
+      if ( p_qhd->pid == EHCI_PID_IN )
+      {
+        // alternate word no longer carries sw fields
+        ehci_data.qtd_chain_len[p_last - ehci_data.qtd_pool] = p_last->expected_bytes;
+        p_last->alternate.address = (uint32_t) &ehci_data.qtd_halt;
+      }
+    }else
+    {
+      p_first = p_qtd;
+    }
+    p_last = p_qtd;
 
-  TU_ASSERT(p_qtd);
+    buffer      += xact_len;
+    total_bytes -= xact_len;
+  } while ( total_bytes );
 
-  qtd_init(p_qtd, buffer, total_bytes);
-  p_qtd->pid = p_qhd->pid;
+  if ( int_on_complete ) p_last->int_on_complete = 1;
 
   //------------- insert TD to TD list -------------//
-  qtd_insert_to_qhd(p_qhd, p_qtd);
+  // timeout of a transfer counts once it heads the list
+  bool const is_idle = (p_qhd->p_qtd_list_head == NULL);
+  qtd_insert_to_qhd(p_qhd, p_first, p_last);
+  if ( is_idle ) qhd_timer_restart(p_qhd);
+
+  // attach head QTD to QHD start transferring. If a transfer is on going, the new QTD is chained
+  // already and picked up by HC, or re-attached by completion isr if its QTD was already fetched
+  if ( start ) qhd_attach_qtd_list(p_qhd);
+
+  hcd_int_enable(TUH_OPT_RHPORT);
 
   return true;
 }
 
-bool hcd_pipe_xfer(uint8_t dev_addr, uint8_t ep_addr, uint8_t buffer[], uint16_t total_bytes, bool int_on_complete)
+bool hcd_pipe_queue_xfer(uint8_t dev_addr, uint8_t ep_addr, uint8_t buffer[], uint32_t total_bytes)
 {
-  TU_ASSERT ( hcd_pipe_queue_xfer(dev_addr, ep_addr, buffer, total_bytes) );
-
   ehci_qhd_t *p_qhd = qhd_get_from_addr(dev_addr, ep_addr);
+  TU_ASSERT(p_qhd);
 
-  if ( int_on_complete )
-  { // the just added qtd is pointed by list_tail
-    p_qhd->p_qtd_list_tail->int_on_complete = 1;
-  }
-  p_qhd->qtd_overlay.next.address = (uint32_t) p_qhd->p_qtd_list_head; // attach head QTD to QHD start transferring
+  return pipe_queue_xfer(p_qhd, buffer, total_bytes, false, false);
+}
 
-  return true;
+bool hcd_pipe_xfer(uint8_t dev_addr, uint8_t ep_addr, uint8_t buffer[], uint32_t total_bytes, bool int_on_complete)
+{
+  ehci_qhd_t *p_qhd = qhd_get_from_addr(dev_addr, ep_addr);
+  TU_ASSERT(p_qhd);
+
+  return pipe_queue_xfer(p_qhd, buffer, total_bytes, int_on_complete, true);
 }
 
 bool hcd_edpt_busy(uint8_t dev_addr, uint8_t ep_addr)
@@ -433,29 +607,554 @@ bool hcd_edpt_clear_stall(uint8_t dev_addr, uint8_t ep_addr)
   ehci_qhd_t *p_qhd = qhd_get_from_addr(dev_addr, ep_addr);
   p_qhd->qtd_overlay.halted = 0;
   // TODO reset data toggle ?
+  if ( p_qhd->p_qtd_list_head ) qhd_timer_restart(p_qhd);
   return true;
 }
 
 //--------------------------------------------------------------------+
-// EHCI Interrupt Handler
+// Transfer timeout & abort
 //--------------------------------------------------------------------+
-
-// async_advance is handshake between usb stack & ehci controller.
-// This isr mean it is safe to modify previously removed queue head from async list.
-// In tinyusb, queue head is only removed when device is unplugged.
-static void async_advance_isr(uint8_t rhport)
+// Low bits come from FRINDEX, the rest from frame list rollovers
+uint32_t hcd_frame_number(uint8_t rhport)
 {
   (void) rhport;
+  uint32_t rollover, index;
+
+  // rollover isr may run in between
+  do
+  {
+    rollover = ehci_data.frame_rollover;
+    index    = (ehci_data.regs->frame_index >> 3) & (EHCI_FRAMELIST_SIZE-1);
+  } while ( rollover != ehci_data.frame_rollover );
+
+  return rollover + index;
+}
+
+bool hcd_edpt_timeout(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr, uint16_t timeout_ms)
+{
+  ehci_qhd_t* p_qhd = qhd_get_from_addr(dev_addr, ep_addr);
+  TU_VERIFY(p_qhd);
+
+  hcd_int_disable(rhport);
+  ehci_data.qhd_timeout[qhd_timer_idx(p_qhd)] = timeout_ms;
+  qhd_timer_restart(p_qhd);
+  hcd_int_enable(rhport);
+
+  return true;
+}
+
+// Stop or resume the schedule walking qhd so that its qtds can be removed, HC follows within a few
+// micro frames. Stopping periodic schedule also pauses interrupt/isochronous endpoints of other devices.
+static void qhd_schedule_enable(ehci_qhd_t const * p_qhd, bool enable)
+{
+  ehci_registers_t* regs = ehci_data.regs;
+  bool const is_period = (p_qhd->int_smask != 0);
+  uint32_t const cmd_bit = TU_BIT(is_period ? EHCI_USBCMD_POS_PERIOD_ENABLE : EHCI_USBCMD_POS_ASYNC_ENABLE);
+
+  if ( enable ) regs->command |= cmd_bit;
+  else          regs->command &= ~cmd_bit;
+
+  while ( !regs->status_bm.hc_halted &&
+          (is_period ? regs->status_bm.periodic_status : regs->status_bm.async_status) != enable ) {}
+}
+
+// Free qtds of head transfer (up to its ioc one) or all queued ones while schedule is stopped. Overlay
+// is pointed to the remaining qtds, data toggle and halted state are kept. Return bytes transferred.
+static uint32_t qhd_xfer_retire(ehci_qhd_t* p_qhd, bool all)
+{
+  uint32_t xferred = p_qhd->total_xferred_bytes;
+  bool is_ioc = false;
+
+  while ( p_qhd->p_qtd_list_head && (all || !is_ioc) )
+  {
+    ehci_qtd_t * const p_qtd = p_qhd->p_qtd_list_head;
+    is_ioc = (p_qtd->int_on_complete != 0);
+    if ( !p_qtd->active ) xferred += qtd_xferred_bytes(p_qtd);
+
+    qtd_free(p_qtd);
+    qtd_remove_1st_from_qhd(p_qhd);
+  }
+  p_qhd->total_xferred_bytes = 0;
+
+  p_qhd->qtd_overlay.active              = 0;
+  p_qhd->qtd_overlay.alternate.terminate = 1;
+  if ( p_qhd->p_qtd_list_head )
+  {
+    p_qhd->qtd_overlay.next.address = (uint32_t) p_qhd->p_qtd_list_head;
+  }else
+  {
+    p_qhd->qtd_overlay.next.terminate = 1;
+  }
+
+  return xferred;
+}
+
+bool hcd_edpt_abort(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr)
+{
+  ehci_qhd_t* p_qhd = qhd_get_from_addr(dev_addr, ep_addr);
+  TU_VERIFY(p_qhd);
+
+  hcd_int_disable(rhport);
+  qhd_schedule_enable(p_qhd, false);
+  (void) qhd_xfer_retire(p_qhd, true);
+  qhd_schedule_enable(p_qhd, true);
+  hcd_int_enable(rhport);
+
+  return true;
+}
+
+// Checked on every frame list rollover i.e resolution is EHCI_FRAMELIST_SIZE ms
+static void xfer_timeout_isr(uint8_t rhport)
+{
+  uint16_t const now = (uint16_t) hcd_frame_number(rhport);
+
+  for(uint32_t i = 0; i < TU_ARRAY_SIZE(ehci_data.qhd_timeout); i++)
+  {
+    if ( !ehci_data.qhd_timeout[i] ) continue;
+
+    ehci_qhd_t* p_qhd = (i < HCD_MAX_ENDPOINT) ? &ehci_data.qhd_pool[i] : qhd_control((uint8_t) (i - HCD_MAX_ENDPOINT));
+
+    // halted endpoint has reported its error already
+    if ( !p_qhd->used || p_qhd->removing || !p_qhd->p_qtd_list_head || p_qhd->qtd_overlay.halted ) continue;
+    if ( (int16_t) (now - ehci_data.qhd_deadline[i]) < 0 ) continue;
+
+    qhd_schedule_enable(p_qhd, false);
+    uint32_t const xferred = qhd_xfer_retire(p_qhd, false);
+    qhd_schedule_enable(p_qhd, true);
+
+    hcd_event_xfer_complete(p_qhd->dev_addr, tu_edpt_addr(p_qhd->ep_number, p_qhd->pid == EHCI_PID_IN ? 1 : 0), XFER_RESULT_TIMEOUT, xferred);
+
+    if ( p_qhd->p_qtd_list_head ) qhd_timer_restart(p_qhd);
+  }
+}
+
+//--------------------------------------------------------------------+
+// Isochronous
+//--------------------------------------------------------------------+
+#if CFG_TUH_ISO_EP
+enum {
+  EHCI_ISO_THRESHOLD = 2 // frames ahead of HC for first packet of a stream (isochronous scheduling threshold)
+};
+
+// frame number is 11 bit
+static inline uint16_t frame_add(uint16_t frame, uint16_t n)
+{
+  return (uint16_t) ((frame + n) & 0x7ff);
+}
+
+static inline uint16_t frame_diff(uint16_t later, uint16_t earlier)
+{
+  return (uint16_t) ((later - earlier) & 0x7ff);
+}
+
+static inline uint16_t frame_current(void)
+{
+  return (uint16_t) ((ehci_data.regs->frame_index >> 3) & 0x7ff);
+}
+
+// iso_get(0, 0) returns a free entry
+static ehci_iso_t* iso_get(uint8_t dev_addr, uint8_t ep_addr)
+{
+  for(uint8_t i=0; i<CFG_TUH_ISO_EP; i++)
+  {
+    ehci_iso_t* iso = &ehci_data.iso[i];
+    if ( iso->dev_addr == dev_addr && iso->ep_addr == ep_addr ) return iso;
+  }
+
+  return NULL;
+}
+
+static inline bool iso_is_serviced(ehci_iso_t const* iso, uint16_t frame)
+{
+  return ( ((uint16_t) (frame - iso->phase)) & (iso->period-1) ) == 0;
+}
+
+static inline ehci_link_t* iso_desc(ehci_iso_t* iso, uint32_t slot)
+{
+  return (iso->speed == TUSB_SPEED_HIGH) ? (ehci_link_t*) &iso->itd[slot] : (ehci_link_t*) &iso->sitd[slot];
+}
+
+// packets per serviced frame
+static inline uint8_t iso_frame_packets(ehci_iso_t const* iso)
+{
+  if ( iso->speed != TUSB_SPEED_HIGH ) return 1;
+
+  uint8_t count = 0;
+  for(uint8_t u=0; u<8; u++) count += (iso->smask & TU_BIT(u)) ? 1 : 0;
+  return count;
+}
+
+static void iso_bw_update(ehci_iso_t const* iso, bool reserve)
+{
+  uint16_t hs_cost, fs_cost;
+  period_cost(iso->speed, iso->tt_think, iso->max_packet_size, iso->mult, &hs_cost, &fs_cost);
+  period_bw_reserve(iso->tt_hub, iso->phase, iso->period, iso->smask | iso->cmask, hs_cost, fs_cost, reserve);
+}
+
+static bool iso_open(uint8_t dev_addr, tusb_desc_endpoint_t const * ep_desc)
+{
+  uint8_t const speed    = _usbh_devices[dev_addr].speed;
+  uint8_t const dir      = tu_edpt_dir(ep_desc->bEndpointAddress);
+  uint16_t const mps     = ep_desc->wMaxPacketSize.size;
+  uint8_t const interval = ep_desc->bInterval;
+
+  TU_ASSERT( 1 <= interval && interval <= 16 );
+  TU_VERIFY( !iso_get(dev_addr, ep_desc->bEndpointAddress) );
+
+  ehci_iso_t* iso = iso_get(0, 0);
+  TU_ASSERT(iso);
+
+  uint8_t period, smask0, nstart;
+  uint8_t cmask0 = 0;
+  uint8_t mult   = 1;
+  uint8_t tt_hub = 0, tt_port = 0, tt_think = 0;
+
+  if ( TUSB_SPEED_HIGH == speed )
+  {
+    mult = (uint8_t) (ep_desc->wMaxPacketSize.hs_period_mult + 1);
+    period_hs_interval(interval, &period, &smask0, &nstart);
+  }else
+  {
+    tt_hub   = usbh_tt_hub(dev_addr, &tt_port);
+    tt_think = tt_hub ? _usbh_devices[tt_hub].tt_think : 0;
+
+    // full speed period is 2^(bInterval-1) frames, split transactions carry up to 188 bytes per micro frame
+    uint8_t const nsplit = (uint8_t) tu_max16(1, (mps + EHCI_SPLIT_PAYLOAD - 1) / EHCI_SPLIT_PAYLOAD);
+
+    period = (uint8_t) tu_min32(1UL << (interval-1), EHCI_PERIOD_FRAMES);
+
+    if ( dir )
+    {
+      // EHCI 4.12.3.3: one start split, complete splits from 2 micro frames later within the frame
+      TU_ASSERT( nsplit <= 5 );
+      smask0 = 1;
+      cmask0 = (uint8_t) (((1u << (nsplit+1)) - 1) << 2);
+      nstart = (uint8_t) (6 - nsplit);
+    }else
+    {
+      // one start split per 188 bytes, no complete split
+      smask0 = (uint8_t) ((1u << nsplit) - 1);
+      nstart = (uint8_t) (9 - nsplit);
+    }
+  }
+
+  uint16_t hs_cost, fs_cost;
+  period_cost(speed, tt_think, mps, mult, &hs_cost, &fs_cost);
+
+  uint8_t phase, smask, cmask;
+  TU_VERIFY( period_find_slot(tt_hub, period, smask0, cmask0, nstart, hs_cost, fs_cost, &phase, &smask, &cmask) );
+
+  tu_memclr(iso, sizeof(ehci_iso_t));
+  iso->dev_addr        = dev_addr;
+  iso->ep_addr         = ep_desc->bEndpointAddress;
+  iso->speed           = speed;
+  iso->mult            = mult;
+  iso->max_packet_size = mps;
+  iso->period          = period;
+  iso->phase           = phase;
+  iso->smask           = smask;
+  iso->cmask           = cmask;
+  iso->tt_hub          = tt_hub;
+  iso->tt_think        = tt_think;
+
+  iso_bw_update(iso, true);
+
+  // link descriptors in front of interrupt tree of serviced frames, they stay inactive until used
+  for(uint32_t f = phase; f < EHCI_FRAMELIST_SIZE; f += period)
+  {
+    if ( TUSB_SPEED_HIGH != speed )
+    {
+      ehci_sitd_t* sitd = &iso->sitd[f];
+      sitd->dev_addr     = dev_addr;
+      sitd->ep_number    = tu_edpt_number(ep_desc->bEndpointAddress);
+      sitd->hub_addr     = tt_hub;
+      sitd->port_number  = tt_port;
+      sitd->direction    = dir;
+      sitd->int_smask    = smask;
+      sitd->fl_int_cmask = cmask;
+      sitd->back.terminate = 1;
+    }
+
+    list_insert(&ehci_data.period_framelist[f], iso_desc(iso, f), (TUSB_SPEED_HIGH == speed) ? EHCI_QTYPE_ITD : EHCI_QTYPE_SITD);
+  }
+
+  return true;
+}
+
+// Descriptors are reusable once HC leaves them i.e next frame, which is long before next open
+static void iso_close(ehci_iso_t* iso)
+{
+  for(uint32_t f = iso->phase; f < EHCI_FRAMELIST_SIZE; f += iso->period)
+  {
+    ehci_link_t* desc = iso_desc(iso, f);
+
+    for(ehci_link_t* prev = &ehci_data.period_framelist[f]; !prev->terminate; prev = list_next(prev))
+    {
+      if ( tu_align32(prev->address) == (uint32_t) desc )
+      {
+        prev->address = desc->address;
+        break;
+      }
+    }
+  }
+
+  iso_bw_update(iso, false);
+  iso->dev_addr = 0;
+  iso->ep_addr  = 0;
+}
+
+// Fill descriptors of serviced frames starting from frame, packets are back to back in buffer
+static void iso_fill(ehci_iso_t* iso, uint16_t frame, uint8_t* buffer, uint16_t const packet_len[], uint16_t count)
+{
+  uint8_t const dir = tu_edpt_dir(iso->ep_addr);
+  uint16_t i = 0;
+
+  while ( i < count )
+  {
+    uint32_t const slot = frame & (EHCI_FRAMELIST_SIZE-1);
+
+    if ( TUSB_SPEED_HIGH == iso->speed )
+    {
+      ehci_itd_t* itd = &iso->itd[slot];
+
+      // up to 8 packets of 3 KB spans 7 pages at most
+      uint32_t const page0 = tu_align4k((uint32_t) buffer);
+      for(uint8_t p=0; p<7; p++) itd->BufferPointer[p] = page0 + 4096*p;
+
+      itd->BufferPointer[0] |= iso->dev_addr | (tu_edpt_number(iso->ep_addr) << 8);
+      itd->BufferPointer[1] |= iso->max_packet_size | (dir << 11);
+      itd->BufferPointer[2] |= iso->mult;
+
+      tu_memclr(itd->xact, sizeof(itd->xact));
+      for(uint8_t u=0; u<8 && i < count; u++)
+      {
+        if ( !(iso->smask & TU_BIT(u)) ) continue;
+
+        uint32_t const addr = (uint32_t) buffer;
+        itd->xact[u].offset          = addr & 0xfff;
+        itd->xact[u].page_select     = (tu_align4k(addr) - page0) >> 12;
+        itd->xact[u].length          = packet_len[i];
+        itd->xact[u].int_on_complete = (i == count-1) ? 1 : 0;
+        itd->xact[u].active          = 1;
+
+        buffer += packet_len[i];
+        i++;
+      }
+    }else
+    {
+      ehci_sitd_t* sitd = &iso->sitd[slot];
+
+      uint16_t const len    = packet_len[i];
+      uint32_t const addr   = (uint32_t) buffer;
+      uint8_t  const tcount = (uint8_t) tu_max16(1, (len + EHCI_SPLIT_PAYLOAD - 1) / EHCI_SPLIT_PAYLOAD);
+
+      // OUT: transaction position (all or begin) and count of start splits
+      sitd->buffer[0] = addr;
+      sitd->buffer[1] = (tu_align4k(addr) + 4096) | (dir ? 0 : ( (((tcount > 1) ? 1u : 0u) << 3) | tcount ));
+
+      sitd->split_state     = 0;
+      sitd->missed_uframe   = 0;
+      sitd->xact_err        = 0;
+      sitd->babble_err      = 0;
+      sitd->buffer_err      = 0;
+      sitd->error           = 0;
+      sitd->cmask_progress  = 0;
+      sitd->total_bytes     = len;
+      sitd->page_select     = 0;
+      sitd->int_on_complete = (i == count-1) ? 1 : 0;
+      sitd->active          = 1;
+
+      buffer += len;
+      i++;
+    }
+
+    frame = frame_add(frame, iso->period);
+  }
+}
+
+// Report actual packet lengths of oldest transfer and retire it
+static void iso_xfer_complete(ehci_iso_t* iso)
+{
+  uint8_t const dir = tu_edpt_dir(iso->ep_addr);
+  uint16_t* packet_len = iso->xfer[0].packet_len;
+  uint16_t const count = iso->xfer[0].count;
+  uint16_t frame = iso->xfer[0].first_frame;
+
+  xfer_result_t result = XFER_RESULT_SUCCESS;
+  uint32_t total = 0;
+  uint16_t i = 0;
+
+  while ( i < count )
+  {
+    uint32_t const slot = frame & (EHCI_FRAMELIST_SIZE-1);
+
+    if ( TUSB_SPEED_HIGH == iso->speed )
+    {
+      ehci_itd_t* itd = &iso->itd[slot];
+
+      for(uint8_t u=0; u<8 && i < count; u++)
+      {
+        if ( !(iso->smask & TU_BIT(u)) ) continue;
+
+        // still active means HC missed it
+        bool const failed = itd->xact[u].active || itd->xact[u].error || itd->xact[u].babble_err || itd->xact[u].buffer_err;
+        itd->xact[u].active = 0;
+
+        if ( failed )
+        {
+          packet_len[i] = 0;
+          result = XFER_RESULT_FAILED;
+        }
+        else if ( dir )
+        {
+          packet_len[i] = itd->xact[u].length;
+        }
+
+        total += packet_len[i];
+        i++;
+      }
+    }else
+    {
+      ehci_sitd_t* sitd = &iso->sitd[slot];
+
+      bool const failed = sitd->active || sitd->xact_err || sitd->babble_err || sitd->buffer_err || sitd->error || sitd->missed_uframe;
+      sitd->active = 0;
+
+      if ( failed )
+      {
+        packet_len[i] = 0;
+        result = XFER_RESULT_FAILED;
+      }
+      else if ( dir )
+      {
+        packet_len[i] = (uint16_t) (packet_len[i] - sitd->total_bytes);
+      }
+
+      total += packet_len[i];
+      i++;
+    }
+
+    frame = frame_add(frame, iso->period);
+  }
+
+  iso->xfer[0] = iso->xfer[1];
+  iso->xfer_count--;
+
+  hcd_event_xfer_complete(iso->dev_addr, iso->ep_addr, result, total);
+}
+
+// Oldest transfer is done once HC executed or passed its last frame
+static void iso_xfer_complete_isr(void)
+{
+  uint16_t const current = frame_current();
+
+  for(uint8_t n=0; n<CFG_TUH_ISO_EP; n++)
+  {
+    ehci_iso_t* iso = &ehci_data.iso[n];
+
+    while ( iso->dev_addr && iso->xfer_count )
+    {
+      uint16_t const last = frame_add(iso->xfer[0].first_frame, (uint16_t) (iso->xfer[0].nframes-1));
+      uint32_t const slot = last & (EHCI_FRAMELIST_SIZE-1);
+
+      bool active = false;
+      if ( TUSB_SPEED_HIGH == iso->speed )
+      {
+        for(uint8_t u=0; u<8; u++) active = active || iso->itd[slot].xact[u].active;
+      }else
+      {
+        active = iso->sitd[slot].active;
+      }
+
+      uint16_t const passed = frame_diff(current, last);
+      if ( active && !(passed > 0 && passed < 1024) ) break;
+
+      iso_xfer_complete(iso);
+    }
+  }
+}
+#endif
+
+bool hcd_edpt_iso_xfer(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr, uint8_t * buffer, uint16_t packet_len[], uint16_t count)
+{
+#if CFG_TUH_ISO_EP
+  ehci_iso_t* iso = iso_get(dev_addr, ep_addr);
+  TU_ASSERT(iso && buffer && count);
+
+  for(uint16_t i=0; i<count; i++) TU_ASSERT( packet_len[i] <= iso->max_packet_size*iso->mult );
+
+  // a transfer starts at a new frame
+  uint16_t const per_frame = iso_frame_packets(iso);
+  uint16_t const nframes   = (uint16_t) (((count + per_frame - 1)/per_frame - 1)*iso->period + 1);
+
+  // descriptors and transfer queue are shared with isr
+  hcd_int_disable(rhport);
 
-  ehci_qhd_t* qhd_pool = ehci_data.qhd_pool;
-  for(uint32_t i = 0; i < HCD_MAX_ENDPOINT; i++)
+  bool ret = (iso->xfer_count < EHCI_ISO_XFER_QUEUE);
+  if ( ret )
   {
-    if ( qhd_pool[i].removing )
+    uint16_t const current = frame_current();
+
+    // continue the stream if still ahead of HC, otherwise restart after a gap
+    uint16_t const ahead = frame_diff(iso->next_frame, current);
+    uint16_t start = (ahead >= EHCI_ISO_THRESHOLD && ahead < 1024) ? iso->next_frame : frame_add(current, EHCI_ISO_THRESHOLD);
+    while ( !iso_is_serviced(iso, start) ) start = frame_add(start, 1);
+
+    // frame list entries are reused every EHCI_FRAMELIST_SIZE frames, must not overlap transfers in flight
+    uint16_t const base = iso->xfer_count ? iso->xfer[0].first_frame : current;
+    ret = frame_diff(frame_add(start, nframes-1), base) < EHCI_FRAMELIST_SIZE;
+
+    if ( ret )
     {
-      qhd_pool[i].removing = 0;
-      qhd_pool[i].used     = 0;
+      iso_fill(iso, start, buffer, packet_len, count);
+
+      iso->xfer[iso->xfer_count].buffer      = buffer;
+      iso->xfer[iso->xfer_count].packet_len  = packet_len;
+      iso->xfer[iso->xfer_count].count       = count;
+      iso->xfer[iso->xfer_count].first_frame = start;
+      iso->xfer[iso->xfer_count].nframes     = nframes;
+      iso->xfer_count++;
+
+      iso->next_frame = frame_add(start, nframes);
     }
   }
+
+  hcd_int_enable(rhport);
+
+  return ret;
+#else
+  (void) rhport; (void) dev_addr; (void) ep_addr; (void) buffer; (void) packet_len; (void) count;
+  return false;
+#endif
+}
+
+bool hcd_edpt_iso_close(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr)
+{
+#if CFG_TUH_ISO_EP
+  ehci_iso_t* iso = iso_get(dev_addr, ep_addr);
+  TU_VERIFY(dev_addr && iso);
+
+  hcd_int_disable(rhport);
+  iso_close(iso);
+  hcd_int_enable(rhport);
+
+  return true;
+#else
+  (void) rhport; (void) dev_addr; (void) ep_addr;
+  return false;
+#endif
+}
+
+//--------------------------------------------------------------------+
+// EHCI Interrupt Handler
+//--------------------------------------------------------------------+
+
+// async_advance is handshake between usb stack & ehci controller.
+// This isr mean it is safe to modify previously removed queue head from async list.
+// In tinyusb, queue head is only removed when device is unplugged.
+static void async_advance_isr(uint8_t rhport)
+{
+  qhd_reclaim_removed(rhport, true);
 }
 
 static void port_connect_status_change_isr(uint8_t hostid)
@@ -476,21 +1175,35 @@ static void qhd_xfer_complete_isr(ehci_qhd_t * p_qhd)
   // free all TDs from the head td to the first active TD
   while(p_qhd->p_qtd_list_head != NULL && !p_qhd->p_qtd_list_head->active)
   {
+    ehci_qtd_t * const p_qtd = p_qhd->p_qtd_list_head;
+
     // TD need to be freed and removed from qhd, before invoking callback
-    bool is_ioc = (p_qhd->p_qtd_list_head->int_on_complete != 0);
-    p_qhd->total_xferred_bytes += p_qhd->p_qtd_list_head->expected_bytes - p_qhd->p_qtd_list_head->total_bytes;
+    bool is_ioc = (p_qtd->int_on_complete != 0);
+    bool const is_short = qtd_is_chained(p_qtd) && (p_qtd->total_bytes != 0);
+    p_qhd->total_xferred_bytes += qtd_xferred_bytes(p_qtd);
 
-    p_qhd->p_qtd_list_head->used = 0; // free QTD
+    qtd_free(p_qtd);
     qtd_remove_1st_from_qhd(p_qhd);
 
+    if ( is_short )
+    {
+      // HC stopped at halt qtd: retire the rest of the transfer, the last qtd of chain carries ioc
+      is_ioc = (p_qhd->p_qtd_list_head != NULL) && qtd_chain_retire_last_ioc(p_qhd);
+    }
+
     if (is_ioc)
     {
       // end of request
       // call USBH callback
       hcd_event_xfer_complete(p_qhd->dev_addr, tu_edpt_addr(p_qhd->ep_number, p_qhd->pid == EHCI_PID_IN ? 1 : 0), XFER_RESULT_SUCCESS, p_qhd->total_xferred_bytes);
       p_qhd->total_xferred_bytes = 0;
+
+      if ( p_qhd->p_qtd_list_head ) qhd_timer_restart(p_qhd);
     }
   }
+
+  // QTDs queued after HC fetched the last one are not seen by HC yet
+  qhd_attach_qtd_list(p_qhd);
 }
 
 static void async_list_xfer_complete_isr(ehci_qhd_t * const async_head)
@@ -506,15 +1219,15 @@ static void async_list_xfer_complete_isr(ehci_qhd_t * const async_head)
   }while(p_qhd != async_head); // async list traversal, stop if loop around
 }
 
-static void period_list_xfer_complete_isr(uint8_t hostid, uint8_t interval_ms)
+// Walk the list of one tree node, it ends at the next dummy head
+static void period_list_xfer_complete_isr(uint8_t hostid, ehci_qhd_t const * period_head)
 {
+  (void) hostid;
   uint8_t max_loop = 0;
-  uint32_t const period_1ms_addr = (uint32_t) get_period_head(hostid, 1);
-  ehci_link_t next_item = * get_period_head(hostid, interval_ms);
+  ehci_link_t next_item = period_head->next;
 
   // TODO abstract max loop guard for period
-  while( !next_item.terminate &&
-      !(interval_ms > 1 && period_1ms_addr == tu_align32(next_item.address)) &&
+  while( !next_item.terminate && !is_period_head(next_item.address) &&
       max_loop < (HCD_MAX_ENDPOINT + EHCI_MAX_ITD + EHCI_MAX_SITD)*CFG_TUSB_HOST_DEVICE_MAX)
   {
     switch ( next_item.type )
@@ -541,10 +1254,10 @@ static void period_list_xfer_complete_isr(uint8_t hostid, uint8_t interval_ms)
   }
 }
 
+// Error bits of a qhd still active are errors HC has retried (up to 3 in a row), transfer only fails once halted
 static void qhd_xfer_error_isr(ehci_qhd_t * p_qhd)
 {
-  if ( (p_qhd->dev_addr != 0 && p_qhd->qtd_overlay.halted) || // addr0 cannot be protocol STALL
-        qhd_has_xact_error(p_qhd) )
+  if ( p_qhd->qtd_overlay.halted && (p_qhd->dev_addr != 0 || qhd_has_xact_error(p_qhd)) ) // addr0 cannot be protocol STALL
   {
     // current qhd has error in transaction
     xfer_result_t error_event;
@@ -552,13 +1265,18 @@ static void qhd_xfer_error_isr(ehci_qhd_t * p_qhd)
     // no error bits are set, endpoint is halted due to STALL
     error_event = qhd_has_xact_error(p_qhd) ? XFER_RESULT_FAILED : XFER_RESULT_STALLED;
 
-    p_qhd->total_xferred_bytes += p_qhd->p_qtd_list_head->expected_bytes - p_qhd->p_qtd_list_head->total_bytes;
+    ehci_qtd_t * const p_qtd = p_qhd->p_qtd_list_head;
+    bool const is_chained = qtd_is_chained(p_qtd);
+    p_qhd->total_xferred_bytes += qtd_xferred_bytes(p_qtd);
 
 //    if ( XFER_RESULT_FAILED == error_event )    TU_BREAKPOINT(); // TODO skip unplugged device
 
-    p_qhd->p_qtd_list_head->used = 0; // free QTD
+    qtd_free(p_qtd);
     qtd_remove_1st_from_qhd(p_qhd);
 
+    // rest of the failed transfer must not run once endpoint is cleared
+    if ( is_chained && p_qhd->p_qtd_list_head ) (void) qtd_chain_retire_last_ioc(p_qhd);
+
     if ( 0 == p_qhd->ep_number )
     {
       // control cannot be halted --> clear all qtd list
@@ -592,14 +1310,12 @@ static void xfer_error_isr(uint8_t hostid)
   }while(p_qhd != async_head); // async list traversal, stop if loop around
 
   //------------- TODO refractor period list -------------//
-  uint32_t const period_1ms_addr = (uint32_t) get_period_head(hostid, 1);
-  for (uint8_t interval_ms=1; interval_ms <= EHCI_FRAMELIST_SIZE; interval_ms *= 2)
+  for (uint32_t i=0; i < TU_ARRAY_SIZE(ehci_data.period_head_arr); i++)
   {
-    ehci_link_t next_item = * get_period_head(hostid, interval_ms);
+    ehci_link_t next_item = ehci_data.period_head_arr[i].next;
 
     // TODO abstract max loop guard for period
-    while( !next_item.terminate &&
-           !(interval_ms > 1 && period_1ms_addr == tu_align32(next_item.address)) )
+    while( !next_item.terminate && !is_period_head(next_item.address) )
     {
       switch ( next_item.type )
       {
@@ -649,6 +1365,10 @@ void hcd_isr(uint8_t rhport)
   if (int_status & EHCI_INT_MASK_ERROR)
   {
     xfer_error_isr(rhport);
+
+#if CFG_TUH_ISO_EP
+    iso_xfer_complete_isr();
+#endif
   }
 
   //------------- some QTD/SITD/ITD with IOC set is completed -------------//
@@ -659,10 +1379,23 @@ void hcd_isr(uint8_t rhport)
 
   if (int_status & EHCI_INT_MASK_NXP_PERIODIC)
   {
-    for (uint8_t i=1; i <= EHCI_FRAMELIST_SIZE; i *= 2)
+    for (uint32_t i=0; i < TU_ARRAY_SIZE(ehci_data.period_head_arr); i++)
     {
-      period_list_xfer_complete_isr( rhport, i );
+      period_list_xfer_complete_isr( rhport, &ehci_data.period_head_arr[i] );
     }
+
+#if CFG_TUH_ISO_EP
+    iso_xfer_complete_isr();
+#endif
+  }
+
+  if (int_status & EHCI_INT_MASK_FRAMELIST_ROLLOVER)
+  {
+    ehci_data.frame_rollover += EHCI_FRAMELIST_SIZE;
+    xfer_timeout_isr(rhport);
+
+    // removed interrupt qhds not reclaimed by allocation meanwhile
+    qhd_reclaim_removed(rhport, false);
   }
 
   //------------- There is some removed async previously -------------//
@@ -678,46 +1411,195 @@ void hcd_isr(uint8_t rhport)
 
 
 //------------- queue head helper -------------//
+// Called in thread context, free stack is pushed by isr
 static inline ehci_qhd_t* qhd_find_free (void)
 {
-  for (uint32_t i=0; i<HCD_MAX_ENDPOINT; i++)
+  ehci_qhd_t* p_qhd = NULL;
+
+  hcd_int_disable(TUH_OPT_RHPORT);
+
+  // removed qhds are reclaimed as soon as HC is done with them, instead of keeping spare ones
+  if ( !ehci_data.qhd_free_count ) qhd_reclaim_removed(TUH_OPT_RHPORT, false);
+
+  if ( ehci_data.qhd_free_count )
   {
-    if ( !ehci_data.qhd_pool[i].used ) return &ehci_data.qhd_pool[i];
+    p_qhd = &ehci_data.qhd_pool[ ehci_data.qhd_free[--ehci_data.qhd_free_count] ];
   }
+  hcd_int_enable(TUH_OPT_RHPORT);
 
-  return NULL;
+  return p_qhd;
 }
 
-static inline ehci_qhd_t* qhd_next(ehci_qhd_t const * p_qhd)
+// Control qhd is not from pool, only marked as free
+static inline void qhd_free(ehci_qhd_t* p_qhd)
 {
-  return (ehci_qhd_t*) tu_align32(p_qhd->next.address);
+  if ( !p_qhd->used ) return;
+  p_qhd->used = 0;
+
+  if ( p_qhd >= ehci_data.qhd_pool && p_qhd < ehci_data.qhd_pool + HCD_MAX_ENDPOINT )
+  {
+    ehci_data.qhd_free[ehci_data.qhd_free_count++] = (uint8_t) (p_qhd - ehci_data.qhd_pool);
+  }
 }
 
-static inline ehci_qhd_t* qhd_get_from_addr(uint8_t dev_addr, uint8_t ep_addr)
+// Free removed qhd along with qtds still queued on it
+static void qhd_reclaim(ehci_qhd_t* p_qhd)
 {
-  ehci_qhd_t* qhd_pool = ehci_data.qhd_pool;
+  while ( p_qhd->p_qtd_list_head )
+  {
+    qtd_free(p_qhd->p_qtd_list_head);
+    qtd_remove_1st_from_qhd(p_qhd);
+  }
+
+  p_qhd->removing = QHD_REMOVE_NONE;
+  qhd_free(p_qhd);
+}
 
-  for(uint32_t i=0; i<HCD_MAX_ENDPOINT; i++)
+// Free removed qhds that HC no longer references: async ones covered by the doorbell once it is
+// acknowledged (async_advanced), interrupt ones once HC is in a later frame (HC may hold the qhd
+// during the frame it is unlinked in, 2 frames apart guarantees a full frame boundary). Async qhds
+// removed meanwhile are covered by a new doorbell. A schedule not walked by HC has nothing to wait for.
+// Called in isr or with interrupt disabled
+static void qhd_reclaim_removed(uint8_t rhport, bool async_advanced)
+{
+  ehci_registers_t* regs = ehci_data.regs;
+  bool const async_idle  = regs->status_bm.hc_halted || !regs->status_bm.async_status;
+  bool const period_idle = regs->status_bm.hc_halted || !regs->status_bm.periodic_status;
+  uint16_t const now = (uint16_t) hcd_frame_number(rhport);
+
+  if ( async_advanced ) ehci_data.doorbell_busy = false;
+  bool ring = false;
+
+  // pool qhds, followed by control qhd of each address (dev0 is the async head, never removed)
+  for(uint32_t i = 0; i < HCD_MAX_ENDPOINT + CFG_TUSB_HOST_DEVICE_MAX; i++)
   {
-    if ( (qhd_pool[i].dev_addr == dev_addr) &&
-          ep_addr == tu_edpt_addr(qhd_pool[i].ep_number, qhd_pool[i].pid) )
+    ehci_qhd_t* p_qhd = (i < HCD_MAX_ENDPOINT) ? &ehci_data.qhd_pool[i] : qhd_control((uint8_t) (i - HCD_MAX_ENDPOINT + 1));
+
+    switch ( p_qhd->removing )
     {
-      return &qhd_pool[i];
+      case QHD_REMOVE_DOORBELL:
+        if ( async_advanced || async_idle ) qhd_reclaim(p_qhd);
+      break;
+
+      case QHD_REMOVE_ASYNC:
+        if ( async_idle )
+        {
+          qhd_reclaim(p_qhd);
+        }
+        else if ( !ehci_data.doorbell_busy )
+        {
+          p_qhd->removing = QHD_REMOVE_DOORBELL;
+          ring = true;
+        }
+      break;
+
+      case QHD_REMOVE_PERIOD:
+        if ( period_idle || (uint16_t) (now - ehci_data.qhd_unlink_frame[i]) >= 2 ) qhd_reclaim(p_qhd);
+      break;
+
+      default: break;
     }
   }
 
-  return NULL;
+  if ( ring )
+  {
+    ehci_data.doorbell_busy = true;
+    regs->command_bm.async_adv_doorbell = 1;
+  }
+}
+
+static inline ehci_qhd_t* qhd_next(ehci_qhd_t const * p_qhd)
+{
+  return (ehci_qhd_t*) tu_align32(p_qhd->next.address);
+}
+
+// timer of pool qhd is at its index, followed by control qhd of each address
+static inline uint16_t qhd_timer_idx(ehci_qhd_t const * p_qhd)
+{
+  if ( p_qhd >= ehci_data.qhd_pool && p_qhd < ehci_data.qhd_pool + HCD_MAX_ENDPOINT ) return (uint16_t) (p_qhd - ehci_data.qhd_pool);
+  return (uint16_t) (HCD_MAX_ENDPOINT + p_qhd->dev_addr);
+}
+
+// head transfer (re)starts its timeout
+static void qhd_timer_restart(ehci_qhd_t const * p_qhd)
+{
+  uint16_t const idx = qhd_timer_idx(p_qhd);
+  ehci_data.qhd_deadline[idx] = (uint16_t) (hcd_frame_number(TUH_OPT_RHPORT) + ehci_data.qhd_timeout[idx]);
+}
+
+static inline ehci_qhd_t* qhd_get_from_addr(uint8_t dev_addr, uint8_t ep_addr)
+{
+  uint8_t const epnum = tu_edpt_number(ep_addr);
+
+  if ( epnum == 0 ) return qhd_control(dev_addr);
+  if ( dev_addr == 0 || dev_addr > CFG_TUSB_HOST_DEVICE_MAX ) return NULL;
+
+  uint8_t const idx = ehci_data.ep2qhd[dev_addr-1][epnum-1][tu_edpt_dir(ep_addr)];
+  return idx ? &ehci_data.qhd_pool[idx-1] : NULL;
 }
 
 //------------- TD helper -------------//
+// Called with HCD interrupt disabled, free stack is pushed by isr
 static inline ehci_qtd_t* qtd_find_free(void)
 {
-  for (uint32_t i=0; i<HCD_MAX_XFER; i++)
+  if ( !ehci_data.qtd_free_count ) return NULL;
+
+  ehci_qtd_t* p_qtd = &ehci_data.qtd_pool[ ehci_data.qtd_free[--ehci_data.qtd_free_count] ];
+  p_qtd->used = 1; // reserved until qtd_init()
+
+  return p_qtd;
+}
+
+// IN qtd in the middle of a chain, its alternate next pointer is the halt qtd
+static inline bool qtd_is_chained(ehci_qtd_t const * p_qtd)
+{
+  return !p_qtd->alternate.terminate;
+}
+
+static inline uint32_t qtd_xferred_bytes(ehci_qtd_t const * p_qtd)
+{
+  uint16_t const expected = qtd_is_chained(p_qtd) ? ehci_data.qtd_chain_len[p_qtd - ehci_data.qtd_pool] : p_qtd->expected_bytes;
+  return expected - p_qtd->total_bytes;
+}
+
+// Free not executed qtds of a chain whose head is already removed, up to and including its last
+// one. Return its ioc bit.
+static bool qtd_chain_retire_last_ioc(ehci_qhd_t *p_qhd)
+{
+  bool is_last;
+  bool is_ioc;
+
+  do
+  {
+    ehci_qtd_t * const p_qtd = p_qhd->p_qtd_list_head;
+    is_last = !qtd_is_chained(p_qtd);
+    is_ioc  = (p_qtd->int_on_complete != 0);
+
+    qtd_free(p_qtd);
+    qtd_remove_1st_from_qhd(p_qhd);
+  } while ( !is_last && p_qhd->p_qtd_list_head );
+
+  return is_ioc;
+}
+
+// Control qtd is not from pool, only marked as free
+static inline void qtd_free(ehci_qtd_t* p_qtd)
+{
+  if ( qtd_is_chained(p_qtd) )
   {
-    if ( !ehci_data.qtd_pool[i].used ) return &ehci_data.qtd_pool[i];
+    // restore sw fields, used bit is cleared below
+    p_qtd->alternate.address   = 0;
+    p_qtd->alternate.terminate = 1;
+    p_qtd->used = 1;
   }
 
-  return NULL;
+  if ( !p_qtd->used ) return;
+  p_qtd->used = 0;
+
+  if ( p_qtd >= ehci_data.qtd_pool && p_qtd < ehci_data.qtd_pool + EHCI_MAX_QTD )
+  {
+    ehci_data.qtd_free[ehci_data.qtd_free_count++] = (uint8_t) (p_qtd - ehci_data.qtd_pool);
+  }
 }
 
 static inline ehci_qtd_t* qtd_next(ehci_qtd_t const * p_qtd )
@@ -736,18 +1618,213 @@ static inline void qtd_remove_1st_from_qhd(ehci_qhd_t *p_qhd)
   }
 }
 
-static inline void qtd_insert_to_qhd(ehci_qhd_t *p_qhd, ehci_qtd_t *p_qtd_new)
+// Point QHD overlay to head QTD if HC has stopped at end of list, which is never done while a
+// transfer is active or HC is moving to next QTD since it would make HC fetch a completed QTD
+static inline void qhd_attach_qtd_list(ehci_qhd_t *p_qhd)
+{
+  if ( p_qhd->p_qtd_list_head && !p_qhd->qtd_overlay.active && p_qhd->qtd_overlay.next.terminate )
+  {
+    p_qhd->qtd_overlay.next.address = (uint32_t) p_qhd->p_qtd_list_head;
+  }
+}
+
+static inline void qtd_insert_to_qhd(ehci_qhd_t *p_qhd, ehci_qtd_t *p_first, ehci_qtd_t *p_last)
 {
   if (p_qhd->p_qtd_list_head == NULL) // empty list
   {
-    p_qhd->p_qtd_list_head               = p_qhd->p_qtd_list_tail = p_qtd_new;
+    p_qhd->p_qtd_list_head               = p_first;
   }else
   {
-    p_qhd->p_qtd_list_tail->next.address = (uint32_t) p_qtd_new;
-    p_qhd->p_qtd_list_tail               = p_qtd_new;
+    p_qhd->p_qtd_list_tail->next.address = (uint32_t) p_first;
+  }
+  p_qhd->p_qtd_list_tail = p_last;
+}
+
+//------------- Periodic Schedule -------------//
+// Bus time charged to every micro frame of smask|cmask, and to full/low speed frame if split. Hub TT waits
+// its think time (full speed bit times) between transactions. Isochronous high bandwidth endpoint has mult
+// packets per micro frame.
+static void period_cost(uint8_t speed, uint8_t tt_think, uint16_t max_packet_size, uint8_t mult, uint16_t* hs_cost, uint16_t* fs_cost)
+{
+  uint16_t const payload = (uint16_t) (max_packet_size + max_packet_size/6); // worst case bit stuffing
+  uint16_t const think   = (uint16_t) ((tt_think + 7) / 8);
+
+  switch ( speed )
+  {
+    case TUSB_SPEED_FULL: *fs_cost = payload + EHCI_FS_XACT_OVERHEAD + think;       break;
+    case TUSB_SPEED_LOW : *fs_cost = 8*(payload + EHCI_FS_XACT_OVERHEAD) + think;   break; // low speed bit is 8x longer
+    default             : *fs_cost = 0;                                             break;
+  }
+
+  *hs_cost = (uint16_t) ( *fs_cost ? (tu_min16(payload, EHCI_SPLIT_PAYLOAD) + EHCI_HS_XACT_OVERHEAD)
+                                   : mult*(payload + EHCI_HS_XACT_OVERHEAD) );
+}
+
+// Highest micro frame load of all frames of this phase once endpoint is added, UINT16_MAX if full speed bus
+// of its transaction translator tt is over budget
+static uint16_t period_peak_load(uint8_t tt, uint8_t phase, uint8_t period, uint8_t uframe_mask, uint16_t hs_cost, uint16_t fs_cost)
+{
+  uint16_t peak = 0;
+
+  for(uint32_t f = phase; f < EHCI_PERIOD_FRAMES; f += period)
+  {
+    if ( fs_cost && (ehci_data.period_fs_bw[tt][f] + fs_cost > EHCI_FS_FRAME_BUDGET) ) return UINT16_MAX;
+
+    for(uint8_t u = 0; u < 8; u++)
+    {
+      if ( uframe_mask & TU_BIT(u) ) peak = tu_max16(peak, ehci_data.period_uframe_bw[f][u] + hs_cost);
+    }
+  }
+
+  return peak;
+}
+
+static void period_bw_reserve(uint8_t tt, uint8_t phase, uint8_t period, uint8_t uframe_mask, uint16_t hs_cost, uint16_t fs_cost, bool reserve)
+{
+  for(uint32_t f = phase; f < EHCI_PERIOD_FRAMES; f += period)
+  {
+    uint16_t* fs_bw = &ehci_data.period_fs_bw[tt][f];
+    *fs_bw = reserve ? (*fs_bw + fs_cost) : (*fs_bw - fs_cost);
+
+    for(uint8_t u = 0; u < 8; u++)
+    {
+      if ( uframe_mask & TU_BIT(u) )
+      {
+        uint16_t* bw = &ehci_data.period_uframe_bw[f][u];
+        *bw = reserve ? (*bw + hs_cost) : (*bw - hs_cost);
+      }
+    }
   }
 }
 
+// Find the phase (frame offset) and micro frames with the least load. Candidates are the base masks
+// shifted by 0 to nstart-1 micro frames. Return false if it does not fit in the periodic budget.
+static bool period_find_slot(uint8_t tt, uint8_t period, uint8_t smask0, uint8_t cmask0, uint8_t nstart, uint16_t hs_cost, uint16_t fs_cost,
+                             uint8_t* phase, uint8_t* smask, uint8_t* cmask)
+{
+  uint16_t best_load = UINT16_MAX;
+
+  for(uint8_t ph = 0; ph < period; ph++)
+  {
+    for(uint8_t start = 0; start < nstart; start++)
+    {
+      uint8_t const s = (uint8_t) (smask0 << start);
+      uint8_t const c = (uint8_t) (cmask0 << start);
+
+      uint16_t const load = period_peak_load(tt, ph, period, s | c, hs_cost, fs_cost);
+      if ( load < best_load )
+      {
+        best_load = load;
+        *phase    = ph;
+        *smask    = s;
+        *cmask    = c;
+      }
+    }
+  }
+
+  // not enough periodic bandwidth
+  return best_load <= EHCI_HS_UFRAME_BUDGET;
+}
+
+// Polling period in frames (power of 2, capped by tree) and base smask of high speed interrupt/isochronous
+// endpoint from its bInterval in 2^(bInterval-1) micro frames
+static void period_hs_interval(uint8_t interval, uint8_t* period, uint8_t* smask0, uint8_t* nstart)
+{
+  if ( interval < 4 ) // sub milisecond interval
+  {
+    uint8_t const uperiod = (uint8_t) (1 << (interval-1));
+
+    *period = 1;
+    *smask0 = 0;
+    for(uint8_t u = 0; u < 8; u += uperiod) *smask0 |= (uint8_t) TU_BIT(u);
+    *nstart = uperiod;
+  }else
+  {
+    *period = (uint8_t) tu_min32(1UL << (interval-4), EHCI_PERIOD_FRAMES);
+    *smask0 = 1;
+    *nstart = 8;
+  }
+}
+
+static void period_bw_update(ehci_qhd_t const *p_qhd, bool reserve)
+{
+  uint16_t hs_cost, fs_cost;
+  period_cost(p_qhd->ep_speed, ehci_data.period_think[p_qhd - ehci_data.qhd_pool], p_qhd->max_packet_size, 1, &hs_cost, &fs_cost);
+
+  period_bw_reserve(p_qhd->fl_hub_addr, ehci_data.period_phase[p_qhd - ehci_data.qhd_pool], p_qhd->interval_ms,
+                    p_qhd->int_smask | p_qhd->fl_int_cmask, hs_cost, fs_cost, reserve);
+}
+
+// Reservations are only changed in task context when endpoints are opened or closed
+void hcd_period_usage(uint8_t rhport, hcd_period_usage_t* usage, uint16_t load[], uint16_t count)
+{
+  (void) rhport;
+
+  usage->slots   = EHCI_PERIOD_FRAMES*8;
+  usage->slot_us = 125;
+  usage->budget  = EHCI_HS_UFRAME_BUDGET;
+  usage->peak    = 0;
+  usage->fs_peak = 0;
+
+  for(uint32_t f = 0; f < EHCI_PERIOD_FRAMES; f++)
+  {
+    // busiest transaction translator
+    for(uint32_t tt = 0; tt < TU_ARRAY_SIZE(ehci_data.period_fs_bw); tt++)
+    {
+      usage->fs_peak = tu_max16(usage->fs_peak, ehci_data.period_fs_bw[tt][f]);
+    }
+
+    for(uint8_t u = 0; u < 8; u++)
+    {
+      uint16_t const bw = ehci_data.period_uframe_bw[f][u];
+      usage->peak = tu_max16(usage->peak, bw);
+      if ( f*8 + u < count ) load[f*8 + u] = bw;
+    }
+  }
+}
+
+// Place an interrupt endpoint at the phase (frame offset) and micro frames with the least load,
+// then reserve its bandwidth. Interval longer than the tree is polled at EHCI_PERIOD_FRAMES.
+static bool period_schedule(ehci_qhd_t *p_qhd, uint8_t interval)
+{
+  uint8_t period; // frames, power of 2
+  uint8_t smask0;
+  uint8_t cmask0 = 0;
+  uint8_t nstart; // number of candidate start micro frames
+
+  if ( TUSB_SPEED_HIGH == p_qhd->ep_speed )
+  {
+    TU_ASSERT( 1 <= interval && interval <= 16 );
+    period_hs_interval(interval, &period, &smask0, &nstart);
+  }else
+  {
+    TU_ASSERT( 0 != interval );
+    period = (uint8_t) (1 << tu_log2( tu_min8(interval, EHCI_PERIOD_FRAMES) ));
+    smask0 = 1;
+    cmask0 = TU_BIN8(11100);
+    nstart = 4; // EHCI 4.12.2.1 case 1: complete split 2,3,4 uframes after start split, within frame
+  }
+
+  uint8_t const tt_hub   = p_qhd->fl_hub_addr;
+  uint8_t const tt_think = (tt_hub && TUSB_SPEED_HIGH != p_qhd->ep_speed) ? _usbh_devices[tt_hub].tt_think : 0;
+
+  uint16_t hs_cost, fs_cost;
+  period_cost(p_qhd->ep_speed, tt_think, p_qhd->max_packet_size, 1, &hs_cost, &fs_cost);
+
+  uint8_t phase, smask, cmask;
+  TU_VERIFY( period_find_slot(tt_hub, period, smask0, cmask0, nstart, hs_cost, fs_cost, &phase, &smask, &cmask) );
+
+  p_qhd->interval_ms  = period;
+  p_qhd->int_smask    = smask;
+  p_qhd->fl_int_cmask = cmask;
+  ehci_data.period_phase[p_qhd - ehci_data.qhd_pool] = phase;
+  ehci_data.period_think[p_qhd - ehci_data.qhd_pool] = tt_think;
+
+  period_bw_update(p_qhd, true);
+
+  return true;
+}
+
 static void qhd_init(ehci_qhd_t *p_qhd, uint8_t dev_addr, tusb_desc_endpoint_t const * ep_desc)
 {
   // address 0 is used as async head, which always on the list --> cannot be cleared (ehci halted otherwise)
@@ -757,7 +1834,6 @@ static void qhd_init(ehci_qhd_t *p_qhd, uint8_t dev_addr, tusb_desc_endpoint_t c
   }
 
   uint8_t const xfer_type = ep_desc->bmAttributes.xfer;
-  uint8_t const interval = ep_desc->bInterval;
 
   p_qhd->dev_addr           = dev_addr;
   p_qhd->fl_inactive_next_xact = 0;
@@ -770,42 +1846,22 @@ static void qhd_init(ehci_qhd_t *p_qhd, uint8_t dev_addr, tusb_desc_endpoint_t c
   p_qhd->nak_reload         = 0;
 
   // Bulk/Control -> smask = cmask = 0
+  // Interrupt -> smask, cmask & interval are set by period_schedule()
   // TODO Isochronous
-  if (TUSB_XFER_INTERRUPT == xfer_type)
-  {
-    if (TUSB_SPEED_HIGH == p_qhd->ep_speed)
-    {
-      TU_ASSERT( interval <= 16, );
-      if ( interval < 4) // sub milisecond interval
-      {
-        p_qhd->interval_ms = 0;
-        p_qhd->int_smask   = (interval == 1) ? TU_BIN8(11111111) :
-                             (interval == 2) ? TU_BIN8(10101010) : TU_BIN8(01000100);
-      }else
-      {
-        p_qhd->interval_ms = (uint8_t) tu_min16( 1 << (interval-4), 255 );
-        p_qhd->int_smask = TU_BIT(interval % 8);
-      }
-    }else
-    {
-      TU_ASSERT( 0 != interval, );
-      // Full/Low: 4.12.2.1 (EHCI) case 1 schedule start split at 1 us & complete split at 2,3,4 uframes
-      p_qhd->int_smask    = 0x01;
-      p_qhd->fl_int_cmask = TU_BIN8(11100);
-      p_qhd->interval_ms  = interval;
-    }
-  }else
+  p_qhd->int_smask = p_qhd->fl_int_cmask = 0;
+
+  // split transactions of full/low speed device go through the TT of nearest high speed hub
+  if ( p_qhd->ep_speed != TUSB_SPEED_HIGH )
   {
-    p_qhd->int_smask = p_qhd->fl_int_cmask = 0;
+    uint8_t tt_port;
+    p_qhd->fl_hub_addr   = usbh_tt_hub(dev_addr, &tt_port);
+    p_qhd->fl_hub_port   = tt_port;
   }
-
-  p_qhd->fl_hub_addr     = _usbh_devices[dev_addr].hub_addr;
-  p_qhd->fl_hub_port     = _usbh_devices[dev_addr].hub_port;
   p_qhd->mult            = 1; // TODO not use high bandwidth/park mode yet
 
   //------------- HCD Management Data -------------//
   p_qhd->used            = 1;
-  p_qhd->removing        = 0;
+  p_qhd->removing        = QHD_REMOVE_NONE;
   p_qhd->p_qtd_list_head = NULL;
   p_qhd->p_qtd_list_tail = NULL;
   p_qhd->pid = tu_edpt_dir(ep_desc->bEndpointAddress) ? EHCI_PID_IN : EHCI_PID_OUT; // PID for TD under this endpoint
@@ -54,17 +54,36 @@
 //--------------------------------------------------------------------+
 // EHCI CONFIGURATION & CONSTANTS
 //--------------------------------------------------------------------+
+#ifndef EHCI_CFG_FRAMELIST_SIZE_BITS
 #define	EHCI_CFG_FRAMELIST_SIZE_BITS			7			/// Framelist Size (NXP specific) (0:1024) - (1:512) - (2:256) - (3:128) - (4:64) - (5:32) - (6:16) - (7:8)
+#endif
 #define EHCI_FRAMELIST_SIZE  (1024 >> EHCI_CFG_FRAMELIST_SIZE_BITS)
 
+// Longest interrupt polling interval (ms) of the periodic tree, longer ones are polled at this rate.
+// The tree has one dummy qHD per interval & phase: 2*N-1 qHDs, N is this value capped by frame list size
+#ifndef CFG_TUH_EHCI_PERIOD_MAX_MS
+#define CFG_TUH_EHCI_PERIOD_MAX_MS  32
+#endif
+
+#define EHCI_PERIOD_FRAMES  ( (CFG_TUH_EHCI_PERIOD_MAX_MS < EHCI_FRAMELIST_SIZE) ? CFG_TUH_EHCI_PERIOD_MAX_MS : EHCI_FRAMELIST_SIZE )
+
+// Additional qTDs for transfers larger than one qTD (up to 20 KB), which are split into a chain
+#ifndef CFG_TUH_EHCI_QTD_EXTRA
+#define CFG_TUH_EHCI_QTD_EXTRA  8
+#endif
+
 // TODO merge OHCI with EHCI
 enum {
   EHCI_MAX_ITD  = 4,
-  EHCI_MAX_SITD = 16
+  EHCI_MAX_SITD = 16,
+  EHCI_MAX_QTD  = HCD_MAX_XFER + CFG_TUH_EHCI_QTD_EXTRA,
+
+  EHCI_ISO_XFER_QUEUE = 2 // transfers in flight per isochronous endpoint
 };
 
 //------------- Validation -------------//
 TU_VERIFY_STATIC(EHCI_CFG_FRAMELIST_SIZE_BITS <= 7, "incorrect value");
+TU_VERIFY_STATIC(EHCI_PERIOD_FRAMES <= 128 && (EHCI_PERIOD_FRAMES & (EHCI_PERIOD_FRAMES-1)) == 0, "must be power of 2 up to 128");
 
 //--------------------------------------------------------------------+
 // EHCI Data Structure
@@ -171,12 +190,11 @@ typedef struct TU_ATTR_ALIGNED(32)
 	/// thus there are 16 bytes padding free that we can make use of.
   //--------------------------------------------------------------------+
 	uint8_t used;
-	uint8_t removing; // removed from asyn list, waiting for async advance
+	uint8_t removing; // unlinked from schedule, waiting for HC to drop it (ehci.c QHD_REMOVE_*)
 	uint8_t pid;
-	uint8_t interval_ms; // polling interval in frames (or milisecond)
+	uint8_t interval_ms; // polling period in frames (power of 2, 1 for sub milisecond)
 
-	uint16_t total_xferred_bytes; // number of bytes xferred until a qtd with ioc bit set
-	uint8_t reserved2[2];
+	uint32_t total_xferred_bytes; // number of bytes xferred until a qtd with ioc bit set
 
 	ehci_qtd_t * volatile p_qtd_list_head;	// head of the scheduled TD list
 	ehci_qtd_t * volatile p_qtd_list_tail;	// tail of the scheduled TD list
@@ -427,13 +445,58 @@ typedef volatile struct
 //--------------------------------------------------------------------+
 // EHCI Data Organization
 //--------------------------------------------------------------------+
+#if CFG_TUH_ISO_EP
+// Isochronous endpoint: one descriptor per frame list entry of its phase, linked while it is open
+typedef struct
+{
+  union {
+    ehci_itd_t  itd [EHCI_FRAMELIST_SIZE]; // high speed
+    ehci_sitd_t sitd[EHCI_FRAMELIST_SIZE]; // full speed through TT
+  };
+
+  uint8_t  dev_addr; // 0 if free
+  uint8_t  ep_addr;
+  uint8_t  speed;
+  uint8_t  mult;     // high speed transactions per micro frame
+  uint16_t max_packet_size;
+  uint8_t  period;   // frames, power of 2 up to EHCI_PERIOD_FRAMES
+  uint8_t  phase;
+  uint8_t  smask;
+  uint8_t  cmask;
+  uint8_t  tt_hub;   // full speed: hub of transaction translator and its think time
+  uint8_t  tt_think;
+  uint16_t next_frame; // frame after the last queued packet
+
+  // transfers in flight, oldest first
+  struct {
+    uint8_t*  buffer;
+    uint16_t* packet_len;
+    uint16_t  count;
+    uint16_t  first_frame;
+    uint16_t  nframes;
+  } xfer[EHCI_ISO_XFER_QUEUE];
+  uint8_t xfer_count;
+}ehci_iso_t;
+#endif
+
 typedef struct
 {
   ehci_link_t period_framelist[EHCI_FRAMELIST_SIZE];
 
-  // for NXP ECHI, only implement 1 ms & 2 ms & 4 ms, 8 ms (framelist)
-  // [0] : 1ms, [1] : 2ms, [2] : 4ms, [3] : 8 ms
-  ehci_qhd_t period_head_arr[4];
+  // Interrupt tree: head of interval i (ms) and phase p is [i-1+p], linked to head of (i/2, p % (i/2))
+  // [0] : 1ms, [1..2] : 2ms, [3..6] : 4ms, [7..14] : 8ms etc ...
+  ehci_qhd_t period_head_arr[2*EHCI_PERIOD_FRAMES - 1];
+
+  // Reserved periodic bandwidth (bytes) per micro frame, and per frame of the full/low speed bus of each
+  // transaction translator: index is address of its hub, 0 for embedded TT of root port
+  uint16_t period_uframe_bw[EHCI_PERIOD_FRAMES][8];
+  uint16_t period_fs_bw[CFG_TUSB_HOST_DEVICE_MAX+1][EHCI_PERIOD_FRAMES];
+  uint8_t  period_phase[HCD_MAX_ENDPOINT]; // frame offset of interrupt qhd in pool
+  uint8_t  period_think[HCD_MAX_ENDPOINT]; // TT think time of interrupt qhd in pool, full speed bit times
+
+#if CFG_TUH_ISO_EP
+  ehci_iso_t iso[CFG_TUH_ISO_EP];
+#endif
 
   // Note control qhd of dev0 is used as head of async list
   struct {
@@ -442,11 +505,42 @@ typedef struct
   }control[CFG_TUSB_HOST_DEVICE_MAX+1];
 
   ehci_qhd_t qhd_pool[HCD_MAX_ENDPOINT];
-  ehci_qtd_t qtd_pool[HCD_MAX_XFER] TU_ATTR_ALIGNED(32);
+  ehci_qtd_t qtd_pool[EHCI_MAX_QTD] TU_ATTR_ALIGNED(32);
+
+  // Never active, alternate next of chained IN qtds: short packet stops HC here
+  ehci_qtd_t qtd_halt TU_ATTR_ALIGNED(32);
+
+  // Length of chained IN qtds, whose alternate word holds a link instead of sw fields
+  uint16_t qtd_chain_len[EHCI_MAX_QTD];
+
+  // Indices of free pool entries used as stacks, allocation and release are O(1)
+  uint8_t  qhd_free[HCD_MAX_ENDPOINT];
+  uint8_t  qtd_free[EHCI_MAX_QTD];
+  uint16_t qhd_free_count;
+  uint16_t qtd_free_count;
+
+  // qhd_pool index + 1 of opened non-control endpoints, 0 if not opened
+  uint8_t ep2qhd[CFG_TUSB_HOST_DEVICE_MAX][15][2];
+
+  // Transfer timeout (ms, 0 is none) and deadline of head transfer of qhd pool, followed by
+  // control qhd of each address
+  uint16_t qhd_timeout [HCD_MAX_ENDPOINT + CFG_TUSB_HOST_DEVICE_MAX+1];
+  uint16_t qhd_deadline[HCD_MAX_ENDPOINT + CFG_TUSB_HOST_DEVICE_MAX+1];
+
+  // Frames counted by frame list rollover interrupt
+  uint32_t frame_rollover;
+
+  // Frame number when interrupt qhd of pool is unlinked from period list
+  uint16_t qhd_unlink_frame[HCD_MAX_ENDPOINT];
+
+  // async advance doorbell is rung, its interrupt is awaited
+  bool doorbell_busy;
 
   ehci_registers_t* regs;
 }ehci_data_t;
 
+TU_VERIFY_STATIC( HCD_MAX_ENDPOINT < 256 && EHCI_MAX_QTD <= 256, "pool index must fit in uint8_t" );
+
 #ifdef __cplusplus
  }
 #endif
@@ -45,6 +45,9 @@ typedef enum
   HCD_EVENT_DEVICE_ATTACH,
   HCD_EVENT_DEVICE_REMOVE,
   HCD_EVENT_XFER_COMPLETE,
+
+  // Not an HCD event, just to wake up tuh_task
+  USBH_EVENT_WAKEUP,
 } hcd_eventid_t;
 
 typedef struct
@@ -62,6 +65,7 @@ typedef struct
 
     struct
     {
+      uint8_t dev_addr;
       uint8_t ep_addr;
       uint8_t result;
       uint32_t len;
@@ -71,14 +75,29 @@ typedef struct
 } hcd_event_t;
 
 #if TUSB_OPT_HOST_ENABLED
-// Max number of endpoints per device
+// Max number of endpoints of all devices
 enum {
-  HCD_MAX_ENDPOINT = CFG_TUSB_HOST_DEVICE_MAX*(CFG_TUH_HUB + CFG_TUH_HID_KEYBOARD + CFG_TUH_HID_MOUSE + CFG_TUSB_HOST_HID_GENERIC +
-                     CFG_TUH_MSC*2 + CFG_TUH_CDC*3),
+  HCD_MAX_ENDPOINT = CFG_TUSB_HOST_DEVICE_MAX*(CFG_TUH_HUB + CFG_TUH_HID_KEYBOARD + CFG_TUH_HID_MOUSE +
+                     CFG_TUH_MSC*2 + CFG_TUH_CDC*3) + (CFG_TUSB_HOST_HID_GENERIC ? CFG_TUH_HID_ITF_MAX : 0) +
+                     CFG_TUH_VENDOR*2 + CFG_TUH_NET*3 + CFG_TUH_MIDI*2,
 
-  HCD_MAX_XFER     = HCD_MAX_ENDPOINT*2,
+  // vendor pipes keep CFG_TUH_VENDOR_XFER_QUEUE transfers each, network and MIDI IN pipes their RX_BUFS
+  HCD_MAX_XFER     = HCD_MAX_ENDPOINT*2 + CFG_TUH_VENDOR*2*(CFG_TUH_VENDOR_XFER_QUEUE-1) +
+                     CFG_TUH_NET*(CFG_TUH_NET_RX_BUFS-1) + CFG_TUH_MIDI*(CFG_TUH_MIDI_RX_BUFS-1),
 };
 
+// Reserved bandwidth of periodic (interrupt and isochronous) endpoints in schedule slots, a slot is a
+// micro frame (EHCI, slot i is micro frame i%8 of frame i/8) or a frame (OHCI). Costs are bytes including
+// transaction overhead, worst case of each endpoint.
+typedef struct
+{
+  uint16_t slots;   // slots in periodic schedule
+  uint16_t slot_us; // 125 or 1000
+  uint16_t budget;  // bytes of a slot usable by periodic transfers
+  uint16_t peak;    // bytes of the most loaded slot
+  uint16_t fs_peak; // full/low speed bytes of the most loaded frame behind TT (EHCI), otherwise 0
+} hcd_period_usage_t;
+
 //#define HCD_MAX_ENDPOINT 16
 //#define HCD_MAX_XFER 16
 #endif
@@ -91,6 +110,11 @@ void hcd_isr(uint8_t hostid);
 void hcd_int_enable (uint8_t rhport);
 void hcd_int_disable(uint8_t rhport);
 
+#if TUSB_OPT_DUAL_ROLE
+// Whether ID pin of OTG connector is grounded (A-device), which requests host role
+bool hcd_otg_id_is_host(uint8_t rhport);
+#endif
+
 // PORT API
 /// return the current connect status of roothub port
 bool hcd_port_connect_status(uint8_t hostid);
@@ -100,6 +124,12 @@ tusb_speed_t hcd_port_speed_get(uint8_t hostid);
 // HCD closes all opened endpoints belong to this device
 void hcd_device_close(uint8_t rhport, uint8_t dev_addr);
 
+// Free running count of 1ms frames
+uint32_t hcd_frame_number(uint8_t rhport);
+
+// Fill periodic schedule usage, load of the first count slots is written to load[]
+void hcd_period_usage(uint8_t rhport, hcd_period_usage_t* usage, uint16_t load[], uint16_t count);
+
 //--------------------------------------------------------------------+
 // Event function
 //--------------------------------------------------------------------+
@@ -131,12 +161,28 @@ bool hcd_edpt_xfer(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr, uint8_t *
 // PIPE API
 //--------------------------------------------------------------------+
 // TODO control xfer should be used via usbh layer
-bool hcd_pipe_queue_xfer(uint8_t dev_addr, uint8_t ep_addr, uint8_t buffer[], uint16_t total_bytes); // only queue, not transferring yet
-bool hcd_pipe_xfer(uint8_t dev_addr, uint8_t ep_addr, uint8_t buffer[], uint16_t total_bytes, bool int_on_complete);
+bool hcd_pipe_queue_xfer(uint8_t dev_addr, uint8_t ep_addr, uint8_t buffer[], uint32_t total_bytes); // only queue, not transferring yet
+bool hcd_pipe_xfer(uint8_t dev_addr, uint8_t ep_addr, uint8_t buffer[], uint32_t total_bytes, bool int_on_complete);
 
-#if 0
-tusb_error_t hcd_pipe_cancel();
-#endif
+// Drop all pending transfers of endpoint without completion event, endpoint stays open and keeps
+// its data toggle
+bool hcd_edpt_abort(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr);
+
+// Fail a transfer with XFER_RESULT_TIMEOUT if not completed within timeout_ms (0 is never, default)
+// since it heads the endpoint queue. Resolution is a few frames.
+bool hcd_edpt_timeout(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr, uint16_t timeout_ms);
+
+//--------------------------------------------------------------------+
+// ISOCHRONOUS API
+//--------------------------------------------------------------------+
+// Queue count packets, one per service interval, packet i follows packet i-1 in buffer. packet_len[i]
+// is its length (OUT) or expected length (IN) and is updated with actual length on completion.
+// Transfer continues the stream of previous one if still scheduled ahead of HC.
+// Supported by EHCI only, OHCI returns false and does not open isochronous endpoints.
+bool hcd_edpt_iso_xfer(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr, uint8_t * buffer, uint16_t packet_len[], uint16_t count);
+
+// Unschedule isochronous endpoint and release its bandwidth, pending transfers are dropped
+bool hcd_edpt_iso_close(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr);
 
 #ifdef __cplusplus
  }
@@ -32,105 +32,275 @@
 // INCLUDE
 //--------------------------------------------------------------------+
 #include "hub.h"
+#include "usbh_hcd.h" // FIXME remove
 
 //--------------------------------------------------------------------+
 // MACRO CONSTANT TYPEDEF
 //--------------------------------------------------------------------+
+enum {
+  HUB_PORT_MAX  = 31,   // status change bitmap is 32-bit, bit0 is the hub itself
+  HUB_PORT_IDLE = 0xff
+};
+
 typedef struct
 {
   uint8_t itf_num;
   uint8_t ep_status;
-  uint8_t port_number;
-  uint8_t status_change; // data from status change interrupt endpoint
+  uint8_t port_count;
+  uint8_t port;          // hub (0) or port whose request is in progress, HUB_PORT_IDLE if none
+  uint8_t power_good;    // bPwrOn2PwrGood of hub descriptor, in 2ms unit
+  uint16_t tt_clear;     // wValue of pending Clear_TT_Buffer, 0 if none
+
+  uint32_t status_change; // data from status change interrupt endpoint
+  uint32_t port_pending;  // hub/ports with change not yet handled
+  uint32_t reset_pending; // connected ports waiting for address 0 to be free for reset
+  uint16_t change;        // change bits of current port not yet cleared
+  bool     status_queued;
+
+  hub_port_status_response_t port_status;
 }usbh_hub_t;
 
 CFG_TUSB_MEM_SECTION static usbh_hub_t hub_data[CFG_TUSB_HOST_DEVICE_MAX];
 TU_ATTR_ALIGNED(4) CFG_TUSB_MEM_SECTION static uint8_t hub_enum_buffer[sizeof(descriptor_hub_desc_t)];
 
-//OSAL_SEM_DEF(hub_enum_semaphore);
-//static osal_semaphore_handle_t hub_enum_sem_hdl;
+// Only one device can be at address 0, therefore ports of all hubs are reset one at a time:
+// from Set Port Reset until the device is addressed or enumeration fails.
+static struct
+{
+  uint8_t hub_addr; // 0 if address 0 is free
+  uint8_t hub_port;
+  uint8_t speed;
+  bool    enumerating; // reset is complete, attach event is sent to usbh
+} _hub_enum;
+
+static inline usbh_hub_t* get_hub(uint8_t dev_addr)
+{
+  return &hub_data[dev_addr-1];
+}
+
+static void hub_process(uint8_t hub_addr);
 
 //--------------------------------------------------------------------+
 // HUB
 //--------------------------------------------------------------------+
-bool hub_port_clear_feature_subtask(uint8_t hub_addr, uint8_t hub_port, uint8_t feature)
+static void hub_enum_release(void)
 {
-  TU_ASSERT(HUB_FEATURE_PORT_CONNECTION_CHANGE <= feature && feature <= HUB_FEATURE_PORT_RESET_CHANGE);
+  tu_varclr(&_hub_enum);
 
-  tusb_control_request_t request = {
-          .bmRequestType_bit = { .recipient = TUSB_REQ_RCPT_OTHER, .type = TUSB_REQ_TYPE_CLASS, .direction = TUSB_DIR_OUT },
-          .bRequest = HUB_REQUEST_CLEAR_FEATURE,
-          .wValue = feature,
-          .wIndex = hub_port,
-          .wLength = 0
+  // kick idle hubs with ports waiting for reset
+  for(uint8_t addr=1; addr <= CFG_TUSB_HOST_DEVICE_MAX; addr++)
+  {
+    usbh_hub_t* p_hub = get_hub(addr);
+    if ( p_hub->ep_status && p_hub->port == HUB_PORT_IDLE && p_hub->reset_pending ) hub_process(addr);
+  }
+}
+
+static void hub_send_event(uint8_t hub_addr, uint8_t hub_port, uint8_t event_id)
+{
+  hcd_event_t event =
+  {
+    .rhport   = _usbh_devices[hub_addr].rhport,
+    .event_id = event_id
   };
 
-  //------------- Clear Port Feature request -------------//
-  TU_ASSERT( usbh_control_xfer( hub_addr, &request, NULL ) );
+  event.attach.hub_addr = hub_addr;
+  event.attach.hub_port = hub_port;
 
-  //------------- Get Port Status to check if feature is cleared -------------//
-  request = (tusb_control_request_t ) {
-        .bmRequestType_bit = { .recipient = TUSB_REQ_RCPT_OTHER, .type = TUSB_REQ_TYPE_CLASS, .direction = TUSB_DIR_IN },
-        .bRequest = HUB_REQUEST_GET_STATUS,
-        .wValue = 0,
-        .wIndex = hub_port,
-        .wLength = 4
-  };
+  hcd_event_handler(&event, false);
+}
 
-  TU_ASSERT( usbh_control_xfer( hub_addr, &request, hub_enum_buffer ) );
+// All change bits of a port are acknowledged, act on its status
+static void hub_port_changed(uint8_t hub_addr, uint8_t port)
+{
+  usbh_hub_t* p_hub = get_hub(hub_addr);
+  hub_port_status_response_t const * p_status = &p_hub->port_status;
+  bool const is_owner = (_hub_enum.hub_addr == hub_addr) && (_hub_enum.hub_port == port);
 
-  //------------- Check if feature is cleared -------------//
-  hub_port_status_response_t * p_port_status;
-  p_port_status = (hub_port_status_response_t *) hub_enum_buffer;
+  if ( p_status->status_change.connect_status )
+  {
+    if ( p_status->status_current.connect_status )
+    {
+      p_hub->reset_pending |= TU_BIT(port);
+    }else
+    {
+      p_hub->reset_pending &= ~TU_BIT(port);
+      if ( is_owner && !_hub_enum.enumerating ) hub_enum_release();
 
-  TU_ASSERT( !tu_bit_test(p_port_status->status_change.value, feature-16)  );
+      hub_send_event(hub_addr, port, HCD_EVENT_DEVICE_REMOVE);
+      return;
+    }
+  }
 
-  return true;
+  // reset complete
+  if ( p_status->status_change.reset && is_owner && !_hub_enum.enumerating )
+  {
+    if ( p_status->status_current.connect_status && p_status->status_current.port_enable )
+    {
+      _hub_enum.speed       = (p_status->status_current.high_speed_device_attached) ? TUSB_SPEED_HIGH :
+                              (p_status->status_current.low_speed_device_attached ) ? TUSB_SPEED_LOW  : TUSB_SPEED_FULL;
+      _hub_enum.enumerating = true;
+
+      hub_send_event(hub_addr, port, HCD_EVENT_DEVICE_ATTACH);
+    }else
+    {
+      hub_enum_release();
+    }
+  }
 }
 
-bool hub_port_reset_subtask(uint8_t hub_addr, uint8_t hub_port)
+static void hub_clear_feature_complete(uint8_t dev_addr, tusb_control_request_t const * request, xfer_result_t result);
+
+// Acknowledge change bits of current port one by one
+static void hub_clear_next(uint8_t hub_addr)
 {
-  enum { RESET_DELAY = 200 }; // USB specs say only 50ms but many devices require much longer
+  usbh_hub_t* p_hub = get_hub(hub_addr);
+  uint8_t const port = p_hub->port;
 
-  //------------- Set Port Reset -------------//
-  tusb_control_request_t request = {
+  if ( p_hub->change )
+  {
+    uint8_t bit = 0;
+    while ( !tu_bit_test(p_hub->change, bit) ) bit++;
+    p_hub->change &= (uint16_t) ~TU_BIT(bit);
+
+    tusb_control_request_t const request = {
+            .bmRequestType_bit = { .recipient = port ? TUSB_REQ_RCPT_OTHER : TUSB_REQ_RCPT_DEVICE, .type = TUSB_REQ_TYPE_CLASS, .direction = TUSB_DIR_OUT },
+            .bRequest = HUB_REQUEST_CLEAR_FEATURE,
+            .wValue = port ? (HUB_FEATURE_PORT_CONNECTION_CHANGE + bit) : (HUB_FEATURE_HUB_LOCAL_POWER_CHANGE + bit),
+            .wIndex = port,
+            .wLength = 0
+    };
+
+    if ( tuh_control_xfer(hub_addr, &request, NULL, hub_clear_feature_complete) ) return;
+  }
+
+  if ( port ) hub_port_changed(hub_addr, port);
+
+  p_hub->port_pending &= ~TU_BIT(port);
+  hub_process(hub_addr);
+}
+
+static void hub_clear_feature_complete(uint8_t dev_addr, tusb_control_request_t const * request, xfer_result_t result)
+{
+  (void) request; (void) result;
+  hub_clear_next(dev_addr);
+}
+
+static void hub_get_status_complete(uint8_t dev_addr, tusb_control_request_t const * request, xfer_result_t result)
+{
+  (void) request;
+  usbh_hub_t* p_hub = get_hub(dev_addr);
+
+  // hub status (wIndex = 0) has only local power and over-current change
+  p_hub->change = (XFER_RESULT_SUCCESS == result) ? p_hub->port_status.status_change.value : 0;
+  if ( p_hub->port == 0 ) p_hub->change &= 0x03;
+
+  hub_clear_next(dev_addr);
+}
+
+static void hub_tt_clear_complete(uint8_t dev_addr, tusb_control_request_t const * request, xfer_result_t result)
+{
+  (void) result;
+  usbh_hub_t* p_hub = get_hub(dev_addr);
+
+  // both buffers of a control endpoint are cleared, IN then OUT
+  bool const is_control = (((request->wValue >> 11) & 0x03) == TUSB_XFER_CONTROL);
+  if ( is_control && (request->wValue & 0x8000) && !p_hub->tt_clear ) p_hub->tt_clear = request->wValue & 0x7fff;
+
+  hub_process(dev_addr);
+}
+
+static void hub_set_reset_complete(uint8_t dev_addr, tusb_control_request_t const * request, xfer_result_t result)
+{
+  (void) request;
+
+  // completion is reported by Reset Change on status endpoint
+  if ( XFER_RESULT_SUCCESS != result ) hub_enum_release();
+  hub_process(dev_addr);
+}
+
+// Handle the next pending change, then reset a port waiting for address 0, otherwise poll status endpoint again.
+// Invoked whenever hub's control pipe becomes idle, all requests are asynchronous.
+static void hub_process(uint8_t hub_addr)
+{
+  usbh_hub_t* p_hub = get_hub(hub_addr);
+  p_hub->port = HUB_PORT_IDLE;
+
+  // TT buffer of a failed transaction is busy until cleared, before anything else
+  if ( p_hub->tt_clear )
+  {
+    tusb_control_request_t const request = {
           .bmRequestType_bit = { .recipient = TUSB_REQ_RCPT_OTHER, .type = TUSB_REQ_TYPE_CLASS, .direction = TUSB_DIR_OUT },
-          .bRequest = HUB_REQUEST_SET_FEATURE,
-          .wValue = HUB_FEATURE_PORT_RESET,
-          .wIndex = hub_port,
+          .bRequest = HUB_REQUEST_CLEAR_TT_BUFFER,
+          .wValue = p_hub->tt_clear,
+          .wIndex = 1, // TT port, always 1 for single TT hub
           .wLength = 0
-  };
+    };
 
-  TU_ASSERT( usbh_control_xfer( hub_addr, &request, NULL ) );
+    p_hub->tt_clear = 0;
+    p_hub->port = 0;
+    if ( tuh_control_xfer(hub_addr, &request, NULL, hub_tt_clear_complete) ) return;
 
-  osal_task_delay(RESET_DELAY); // TODO Hub wait for Status Endpoint on Reset Change
+    p_hub->port = HUB_PORT_IDLE;
+  }
 
-  //------------- Get Port Status to check if port is enabled, powered and reset_change -------------//
-  request = (tusb_control_request_t ) {
-        .bmRequestType_bit = { .recipient = TUSB_REQ_RCPT_OTHER, .type = TUSB_REQ_TYPE_CLASS, .direction = TUSB_DIR_IN },
-        .bRequest = HUB_REQUEST_GET_STATUS,
-        .wValue = 0,
-        .wIndex = hub_port,
-        .wLength = 4
-  };
+  if ( p_hub->port_pending )
+  {
+    uint8_t port = 0;
+    while ( !tu_bit_test(p_hub->port_pending, port) ) port++;
+
+    tusb_control_request_t const request = {
+          .bmRequestType_bit = { .recipient = port ? TUSB_REQ_RCPT_OTHER : TUSB_REQ_RCPT_DEVICE, .type = TUSB_REQ_TYPE_CLASS, .direction = TUSB_DIR_IN },
+          .bRequest = HUB_REQUEST_GET_STATUS,
+          .wValue = 0,
+          .wIndex = port,
+          .wLength = 4
+    };
+
+    p_hub->port = port;
+    if ( tuh_control_xfer(hub_addr, &request, &p_hub->port_status, hub_get_status_complete) ) return;
 
-  TU_ASSERT( usbh_control_xfer( hub_addr, &request, hub_enum_buffer ) );
+    // control pipe is broken, drop all changes
+    p_hub->port         = HUB_PORT_IDLE;
+    p_hub->port_pending = 0;
+  }
 
-  hub_port_status_response_t * p_port_status;
-  p_port_status = (hub_port_status_response_t *) hub_enum_buffer;
+  if ( p_hub->reset_pending && _hub_enum.hub_addr == 0 )
+  {
+    uint8_t port = 1;
+    while ( !tu_bit_test(p_hub->reset_pending, port) ) port++;
+
+    tusb_control_request_t const request = {
+            .bmRequestType_bit = { .recipient = TUSB_REQ_RCPT_OTHER, .type = TUSB_REQ_TYPE_CLASS, .direction = TUSB_DIR_OUT },
+            .bRequest = HUB_REQUEST_SET_FEATURE,
+            .wValue = HUB_FEATURE_PORT_RESET,
+            .wIndex = port,
+            .wLength = 0
+    };
+
+    p_hub->reset_pending &= ~TU_BIT(port);
+    _hub_enum.hub_addr = hub_addr;
+    _hub_enum.hub_port = port;
+
+    p_hub->port = port;
+    if ( tuh_control_xfer(hub_addr, &request, NULL, hub_set_reset_complete) ) return;
+
+    p_hub->port = HUB_PORT_IDLE;
+    tu_varclr(&_hub_enum);
+  }
 
-  TU_ASSERT ( p_port_status->status_change.reset && p_port_status->status_current.connect_status &&
-              p_port_status->status_current.port_power && p_port_status->status_current.port_enable);
+  if ( !p_hub->status_queued ) p_hub->status_queued = hub_status_pipe_queue(hub_addr);
+}
 
-  return true;
+// Speed of the port whose reset has just completed
+tusb_speed_t hub_port_get_speed(uint8_t hub_addr, uint8_t hub_port)
+{
+  TU_VERIFY(_hub_enum.hub_addr == hub_addr && _hub_enum.hub_port == hub_port, TUSB_SPEED_FULL);
+  return (tusb_speed_t) _hub_enum.speed;
 }
 
-// can only get the speed RIGHT AFTER hub_port_reset_subtask call
-tusb_speed_t hub_port_get_speed(void)
+void hub_enum_complete(uint8_t hub_addr, uint8_t hub_port)
 {
-  hub_port_status_response_t * p_port_status = (hub_port_status_response_t *) hub_enum_buffer;
-  return (p_port_status->status_current.high_speed_device_attached) ? TUSB_SPEED_HIGH :
-         (p_port_status->status_current.low_speed_device_attached ) ? TUSB_SPEED_LOW  : TUSB_SPEED_FULL;
+  if ( _hub_enum.hub_addr == hub_addr && _hub_enum.hub_port == hub_port && _hub_enum.enumerating ) hub_enum_release();
 }
 
 //--------------------------------------------------------------------+
@@ -139,7 +309,7 @@ tusb_speed_t hub_port_get_speed(void)
 void hub_init(void)
 {
   tu_memclr(hub_data, CFG_TUSB_HOST_DEVICE_MAX*sizeof(usbh_hub_t));
-//  hub_enum_sem_hdl = osal_semaphore_create( OSAL_SEM_REF(hub_enum_semaphore) );
+  tu_varclr(&_hub_enum);
 }
 
 bool hub_open(uint8_t rhport, uint8_t dev_addr, tusb_desc_interface_t const *itf_desc, uint16_t *p_length)
@@ -156,95 +326,146 @@ bool hub_open(uint8_t rhport, uint8_t dev_addr, tusb_desc_interface_t const *itf
   
   TU_ASSERT(hcd_edpt_open(rhport, dev_addr, ep_desc));
 
-  hub_data[dev_addr-1].itf_num = itf_desc->bInterfaceNumber;
-  hub_data[dev_addr-1].ep_status = ep_desc->bEndpointAddress;
+  usbh_hub_t* p_hub = get_hub(dev_addr);
+
+  p_hub->itf_num   = itf_desc->bInterfaceNumber;
+  p_hub->ep_status = ep_desc->bEndpointAddress;
+  p_hub->port      = HUB_PORT_IDLE;
 
   (*p_length) = sizeof(tusb_desc_interface_t) + sizeof(tusb_desc_endpoint_t);
 
-  //------------- Get Hub Descriptor -------------//
-  tusb_control_request_t request = {
-          .bmRequestType_bit = { .recipient = TUSB_REQ_RCPT_DEVICE, .type = TUSB_REQ_TYPE_CLASS, .direction = TUSB_DIR_IN },
-          .bRequest = HUB_REQUEST_GET_DESCRIPTOR,
-          .wValue = 0,
-          .wIndex = 0,
-          .wLength = sizeof(descriptor_hub_desc_t)
-  };
+  return true;
+}
+
+static void hub_power_good(uint8_t dev_addr)
+{
+  //------------- Queue the initial Status endpoint transfer -------------//
+  hub_process(dev_addr);
+  usbh_driver_set_config_complete(dev_addr, get_hub(dev_addr)->itf_num);
+}
 
-  TU_ASSERT( usbh_control_xfer( dev_addr, &request, hub_enum_buffer ) );
+static void hub_set_power_complete(uint8_t dev_addr, tusb_control_request_t const * request, xfer_result_t result);
+
+//------------- Set Port_Power on all ports -------------//
+// TODO may only power port with attached
+static bool hub_set_port_power(uint8_t dev_addr, uint8_t port)
+{
+  usbh_hub_t* p_hub = get_hub(dev_addr);
 
-  // only care about this field in hub descriptor
-  hub_data[dev_addr-1].port_number = ((descriptor_hub_desc_t*) hub_enum_buffer)->bNbrPorts;
+  // wait for power to be good on all ports
+  if ( port > p_hub->port_count ) return usbh_delay(dev_addr, (uint16_t) (2*p_hub->power_good), hub_power_good);
 
-  //------------- Set Port_Power on all ports -------------//
-  // TODO may only power port with attached
-  request = (tusb_control_request_t ) {
+  tusb_control_request_t const request = {
           .bmRequestType_bit = { .recipient = TUSB_REQ_RCPT_OTHER, .type = TUSB_REQ_TYPE_CLASS, .direction = TUSB_DIR_OUT },
           .bRequest = HUB_REQUEST_SET_FEATURE,
           .wValue = HUB_FEATURE_PORT_POWER,
-          .wIndex = 0,
+          .wIndex = port,
           .wLength = 0
   };
 
-  for(uint8_t i=1; i <= hub_data[dev_addr-1].port_number; i++)
+  return tuh_control_xfer(dev_addr, &request, NULL, hub_set_power_complete);
+}
+
+static void hub_set_power_complete(uint8_t dev_addr, tusb_control_request_t const * request, xfer_result_t result)
+{
+  bool const is_ok = (XFER_RESULT_SUCCESS == result) && hub_set_port_power(dev_addr, (uint8_t) (request->wIndex + 1));
+
+  // hub is left unconfigured if any request fails
+  if ( !is_ok ) usbh_driver_set_config_complete(dev_addr, get_hub(dev_addr)->itf_num);
+}
+
+static void hub_get_desc_complete(uint8_t dev_addr, tusb_control_request_t const * request, xfer_result_t result)
+{
+  (void) request;
+  usbh_hub_t* p_hub = get_hub(dev_addr);
+  bool is_ok = (XFER_RESULT_SUCCESS == result);
+
+  if ( is_ok )
   {
-    request.wIndex = i;
-    TU_ASSERT( usbh_control_xfer( dev_addr, &request, NULL ) );
+    // only care about these fields in hub descriptor
+    descriptor_hub_desc_t const * p_desc = (descriptor_hub_desc_t const *) hub_enum_buffer;
+    p_hub->port_count = tu_min8(p_desc->bNbrPorts, HUB_PORT_MAX);
+    p_hub->power_good = p_desc->bPwrOn2PwrGood;
+
+    // TT think time in wHubCharacteristics D6..D5: 8, 16, 24 or 32 full speed bit times
+    _usbh_devices[dev_addr].tt_think = (uint8_t) (8*(((p_desc->wHubCharacteristics >> 5) & 0x03) + 1));
+
+    is_ok = hub_set_port_power(dev_addr, 1);
   }
 
-  //------------- Queue the initial Status endpoint transfer -------------//
-  TU_ASSERT( hcd_pipe_xfer(dev_addr, hub_data[dev_addr-1].ep_status, &hub_data[dev_addr-1].status_change, 1, true) );
+  if ( !is_ok ) usbh_driver_set_config_complete(dev_addr, p_hub->itf_num);
+}
 
-  return true;
+bool hub_set_config(uint8_t dev_addr, uint8_t itf_num)
+{
+  (void) itf_num;
+
+  //------------- Get Hub Descriptor -------------//
+  tusb_control_request_t const request = {
+          .bmRequestType_bit = { .recipient = TUSB_REQ_RCPT_DEVICE, .type = TUSB_REQ_TYPE_CLASS, .direction = TUSB_DIR_IN },
+          .bRequest = HUB_REQUEST_GET_DESCRIPTOR,
+          .wValue = 0,
+          .wIndex = 0,
+          .wLength = sizeof(descriptor_hub_desc_t)
+  };
+
+  return tuh_control_xfer(dev_addr, &request, hub_enum_buffer, hub_get_desc_complete);
 }
 
 // is the response of interrupt endpoint polling
-#include "usbh_hcd.h" // FIXME remove
-void hub_isr(uint8_t dev_addr, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes)
+void hub_xfer_cb(uint8_t dev_addr, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes)
 {
-  (void) xferred_bytes; // TODO can be more than 1 for hub with lots of ports
+  (void) xferred_bytes; // bitmap is zeroed before queued
   (void) ep_addr;
 
-  usbh_hub_t * p_hub = &hub_data[dev_addr-1];
+  usbh_hub_t * p_hub = get_hub(dev_addr);
+  p_hub->status_queued = false;
 
   if ( event == XFER_RESULT_SUCCESS )
   {
-    for (uint8_t port=1; port <= p_hub->port_number; port++)
-    {
-      // TODO HUB ignore bit0 hub_status_change
-      if ( tu_bit_test(p_hub->status_change, port) )
-      {
-        hcd_event_t event =
-        {
-          .rhport = _usbh_devices[dev_addr].rhport,
-          .event_id = HCD_EVENT_DEVICE_ATTACH
-        };
-
-        event.attach.hub_addr = dev_addr;
-        event.attach.hub_port = port;
-
-        hcd_event_handler(&event, true);
-        break; // handle one port at a time, next port if any will be handled in the next cycle
-      }
-    }
-    // NOTE: next status transfer is queued by usbh.c after handling this request
+    // all hub/ports changes reported by one interrupt are handled before polling again
+    p_hub->port_pending |= p_hub->status_change & ((TU_BIT(p_hub->port_count) << 1) - 1);
+
+    if ( p_hub->port == HUB_PORT_IDLE ) hub_process(dev_addr);
   }
   else
   {
     // TODO [HUB] check if hub is still plugged before polling status endpoint since failed usually mean hub unplugged
-//    TU_ASSERT ( hub_status_pipe_queue(dev_addr) );
   }
 }
 
 void hub_close(uint8_t dev_addr)
 {
-  tu_memclr(&hub_data[dev_addr-1], sizeof(usbh_hub_t));
-//  osal_semaphore_reset(hub_enum_sem_hdl);
+  tu_memclr(get_hub(dev_addr), sizeof(usbh_hub_t));
+
+  // release address 0 if one of its ports is being reset, its device is unplugged as well
+  if ( _hub_enum.hub_addr == dev_addr ) hub_enum_release();
 }
 
-bool hub_status_pipe_queue(uint8_t dev_addr)
+bool hub_tt_clear_buffer(uint8_t hub_addr, uint8_t dev_addr, uint8_t ep_addr)
 {
-  return hcd_pipe_xfer(dev_addr, hub_data[dev_addr-1].ep_status, &hub_data[dev_addr-1].status_change, 1, true);
+  usbh_hub_t* p_hub = get_hub(hub_addr);
+  TU_VERIFY(p_hub->ep_status && !p_hub->tt_clear);
+
+  // wValue: endpoint number, device address, endpoint type (control or bulk) and direction
+  uint8_t const epnum = tu_edpt_number(ep_addr);
+  uint8_t const type  = epnum ? TUSB_XFER_BULK : TUSB_XFER_CONTROL;
+  uint8_t const dir   = epnum ? tu_edpt_dir(ep_addr) : 1;
+
+  p_hub->tt_clear = (uint16_t) (epnum | (dev_addr << 4) | (type << 11) | (dir << 15));
+
+  if ( p_hub->port == HUB_PORT_IDLE ) hub_process(hub_addr);
+
+  return true;
 }
 
+bool hub_status_pipe_queue(uint8_t dev_addr)
+{
+  usbh_hub_t * p_hub = get_hub(dev_addr);
+  uint16_t const len = (uint16_t) ((p_hub->port_count + 8) / 8);
+
+  p_hub->status_change = 0;
+  return hcd_pipe_xfer(dev_addr, p_hub->ep_status, (uint8_t*) &p_hub->status_change, len, true);
+}
 
 #endif
@@ -29,7 +29,8 @@
  *  \details  Like most PC's OS, Hub support is completely hidden from Application. In fact, application cannot determine whether
  *            a device is mounted directly via roothub or via a hub's port. All Hub-related procedures are performed and managed
  *            by tinyusb stack. Unless you are trying to develop the stack itself, there are nothing else can be used by Application.
- *  \note     Due to my laziness, only 1-level of Hub is supported. In other way, the stack cannot mount a hub via another hub.
+ *  \note     Hubs can be chained, ports of all hubs are serviced asynchronously but only one port is reset at a time
+ *            since there can be only one device at address 0.
  *  @{
  */
 
@@ -172,17 +173,23 @@ typedef struct {
 
 TU_VERIFY_STATIC( sizeof(hub_port_status_response_t) == 4, "size is not correct");
 
-bool hub_port_reset_subtask(uint8_t hub_addr, uint8_t hub_port);
-bool hub_port_clear_feature_subtask(uint8_t hub_addr, uint8_t hub_port, uint8_t feature);
-tusb_speed_t hub_port_get_speed(void);
+// Hub driver resets a connected port and sends attach event once reset completes,
+// usbh must invoke hub_enum_complete() once the device has left address 0 (addressed or failed)
+tusb_speed_t hub_port_get_speed(uint8_t hub_addr, uint8_t hub_port);
+void hub_enum_complete(uint8_t hub_addr, uint8_t hub_port);
 bool hub_status_pipe_queue(uint8_t dev_addr);
 
+// Clear_TT_Buffer of a control/bulk endpoint whose split transaction failed (USB 2.0 11.17.5), sent once
+// control pipe of hub is idle. Only one request is kept per hub, return false if one is already pending
+bool hub_tt_clear_buffer(uint8_t hub_addr, uint8_t dev_addr, uint8_t ep_addr);
+
 //--------------------------------------------------------------------+
 // Internal Class Driver API
 //--------------------------------------------------------------------+
 void hub_init(void);
 bool hub_open(uint8_t rhport, uint8_t dev_addr, tusb_desc_interface_t const *itf_desc, uint16_t *p_length);
-void hub_isr(uint8_t dev_addr, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes);
+bool hub_set_config(uint8_t dev_addr, uint8_t itf_num);
+void hub_xfer_cb(uint8_t dev_addr, uint8_t ep_addr, xfer_result_t event, uint32_t xferred_bytes);
 void hub_close(uint8_t dev_addr);
 
 #ifdef __cplusplus
@@ -137,6 +137,13 @@ static ohci_ed_t * const p_ed_head[] =
 static void ed_list_insert(ohci_ed_t * p_pre, ohci_ed_t * p_ed);
 static void ed_list_remove_by_addr(ohci_ed_t * p_head, uint8_t dev_addr);
 
+static inline bool gtd_is_control(ohci_gtd_t const * const p_qtd);
+static ohci_gtd_t * gtd_alloc(void);
+static inline void gtd_free(ohci_gtd_t* p_gtd);
+
+static inline uint16_t ed_timer_idx(ohci_ed_t const * p_ed);
+static void ed_timer_restart(ohci_ed_t const * p_ed);
+
 //--------------------------------------------------------------------+
 // USBH-HCD API
 //--------------------------------------------------------------------+
@@ -145,6 +152,9 @@ bool hcd_init(void)
 {
   //------------- Data Structure init -------------//
   tu_memclr(&ohci_data, sizeof(ohci_data_t));
+  for(uint32_t i=0; i<OHCI_MAX_GTD; i++) ohci_data.gtd_free[i] = (uint8_t) i;
+  ohci_data.gtd_free_count = OHCI_MAX_GTD;
+
   for(uint8_t i=0; i<32; i++)
   { // assign all interrupt pointes to period head ed
     ohci_data.hcca.interrupt_table[i] = (uint32_t) &ohci_data.period_head_ed;
@@ -166,7 +176,7 @@ bool hcd_init(void)
   OHCI_REG->interrupt_disable = OHCI_REG->interrupt_enable; // disable all interrupts
   OHCI_REG->interrupt_status  = OHCI_REG->interrupt_status; // clear current set bits
   OHCI_REG->interrupt_enable  = OHCI_INT_WRITEBACK_DONEHEAD_MASK | OHCI_INT_RESUME_DETECTED_MASK |
-      OHCI_INT_UNRECOVERABLE_ERROR_MASK | /*OHCI_INT_FRAME_OVERFLOW_MASK |*/ OHCI_INT_RHPORT_STATUS_CHANGE_MASK |
+      OHCI_INT_UNRECOVERABLE_ERROR_MASK | OHCI_INT_FRAME_OVERFLOW_MASK | OHCI_INT_RHPORT_STATUS_CHANGE_MASK |
       OHCI_INT_MASTER_ENABLE_MASK;
 
   OHCI_REG->control |= OHCI_CONTROL_CONTROL_BULK_RATIO | OHCI_CONTROL_LIST_CONTROL_ENABLE_MASK |
@@ -206,15 +216,16 @@ tusb_speed_t hcd_port_speed_get(uint8_t hostid)
 // thus there is no need to make sure ED is not in HC's cahed as it will not for sure
 void hcd_device_close(uint8_t rhport, uint8_t dev_addr)
 {
-  // TODO OHCI
-  (void) rhport;
-
   // addr0 serves as static head --> only set skip bit
   if ( dev_addr == 0 )
   {
     ohci_data.control[0].ed.skip = 1;
+    ohci_data.control[0].ed.is_expiring = 0;
   }else
   {
+    // queued gTDs are returned to the free list, which is shared with the done queue isr
+    hcd_int_disable(rhport);
+
     // remove control
     ed_list_remove_by_addr( p_ed_head[TUSB_XFER_CONTROL], dev_addr);
 
@@ -225,6 +236,8 @@ void hcd_device_close(uint8_t rhport, uint8_t dev_addr)
     ed_list_remove_by_addr(p_ed_head[TUSB_XFER_INTERRUPT], dev_addr);
 
     // TODO remove ISO
+
+    hcd_int_enable(rhport);
   }
 }
 
@@ -261,6 +274,7 @@ static void ed_init(ohci_ed_t *p_ed, uint8_t dev_addr, uint16_t max_packet_size,
 
   p_ed->used              = 1;
   p_ed->is_interrupt_xfer = (xfer_type == TUSB_XFER_INTERRUPT ? 1 : 0);
+  p_ed->is_expiring       = 0;
 }
 
 static void gtd_init(ohci_gtd_t* p_td, void* data_ptr, uint16_t total_bytes)
@@ -293,6 +307,7 @@ bool hcd_setup_send(uint8_t rhport, uint8_t dev_addr, uint8_t const setup_packet
 
   //------------- Attach TDs list to Control Endpoint -------------//
   p_ed->td_head.address = (uint32_t) p_setup;
+  ed_timer_restart(p_ed);
 
   OHCI_REG->command_status_bit.control_list_filled = 1;
 
@@ -320,6 +335,7 @@ bool hcd_edpt_xfer(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr, uint8_t *
     p_data->delay_interrupt = OHCI_INT_ON_COMPLETE_YES;
 
     p_ed->td_head.address = (uint32_t) p_data;
+    ed_timer_restart(p_ed);
 
     OHCI_REG->command_status_bit.control_list_filled = 1;
   }
@@ -348,6 +364,11 @@ static inline ohci_ed_t * ed_from_addr(uint8_t dev_addr, uint8_t ep_addr)
   return NULL;
 }
 
+static inline uint8_t ed_get_index(ohci_ed_t const * const p_ed)
+{
+  return (uint8_t) (p_ed - ohci_data.ed_pool);
+}
+
 static inline ohci_ed_t * ed_find_free(void)
 {
   ohci_ed_t* ed_pool = ohci_data.ed_pool;
@@ -382,6 +403,24 @@ static void ed_list_remove_by_addr(ohci_ed_t * p_head, uint8_t dev_addr)
       // point the removed ED's next pointer to list head to make sure HC can always safely move away from this ED
       ed->next = (uint32_t) p_head;
       ed->used = 0;
+
+      // release queued gTDs and the dummy tail, control gTD is static
+      if ( ed->ep_number != 0 )
+      {
+        uint8_t const ed_idx = ed_get_index(ed);
+        ohci_gtd_t* const p_dummy = &ohci_data.gtd_pool[ ohci_data.ed_dummy[ed_idx] ];
+        ohci_gtd_t* p_gtd = (ohci_gtd_t*) tu_align16(ed->td_head.address);
+
+        while ( p_gtd != p_dummy )
+        {
+          ohci_gtd_t* const p_next = (ohci_gtd_t*) p_gtd->next;
+          gtd_free(p_gtd);
+          p_gtd = p_next;
+        }
+        gtd_free(p_dummy);
+
+        ohci_data.ed_xferred_bytes[ed_idx] = 0;
+      }
     }
 
     // check next valid since we could remove it
@@ -398,6 +437,7 @@ bool hcd_edpt_open(uint8_t rhport, uint8_t dev_addr, tusb_desc_endpoint_t const
 
   //------------- Prepare Queue Head -------------//
   ohci_ed_t * p_ed;
+  ohci_gtd_t * p_dummy = NULL;
 
   if ( ep_desc->bEndpointAddress == 0 )
   {
@@ -405,11 +445,27 @@ bool hcd_edpt_open(uint8_t rhport, uint8_t dev_addr, tusb_desc_endpoint_t const
   }else
   {
     p_ed = ed_find_free();
+    TU_ASSERT(p_ed);
+
+    // TailP points to an empty gTD, queuing fills it and appends a new one (OHCI 5.2.8.2)
+    hcd_int_disable(rhport);
+    p_dummy = gtd_alloc();
+    hcd_int_enable(rhport);
+    TU_ASSERT(p_dummy); // not enough gtd
   }
-  TU_ASSERT(p_ed);
 
   ed_init( p_ed, dev_addr, ep_desc->wMaxPacketSize.size, ep_desc->bEndpointAddress,
             ep_desc->bmAttributes.xfer, ep_desc->bInterval );
+  ohci_data.ed_timeout[ed_timer_idx(p_ed)] = 0;
+
+  if ( p_dummy )
+  {
+    ohci_data.ed_dummy[ed_get_index(p_ed)] = (uint8_t) (p_dummy - ohci_data.gtd_pool);
+    ohci_data.ed_xferred_bytes[ed_get_index(p_ed)] = 0;
+
+    p_ed->td_head.address = (uint32_t) p_dummy;
+    p_ed->td_tail         = (uint32_t) p_dummy;
+  }
 
   // control of dev0 is used as static async head
   if ( dev_addr == 0 )
@@ -423,60 +479,121 @@ bool hcd_edpt_open(uint8_t rhport, uint8_t dev_addr, tusb_desc_endpoint_t const
   return true;
 }
 
-static ohci_gtd_t * gtd_find_free(void)
+// caller must disable interrupt since free list is shared with done queue isr.
+static ohci_gtd_t * gtd_alloc(void)
 {
-  for(uint8_t i=0; i < HCD_MAX_XFER; i++)
-  {
-    if ( !ohci_data.gtd_pool[i].used ) return &ohci_data.gtd_pool[i];
-  }
-
-  return NULL;
+  if ( !ohci_data.gtd_free_count ) return NULL;
+  return &ohci_data.gtd_pool[ ohci_data.gtd_free[--ohci_data.gtd_free_count] ];
 }
 
-static void td_insert_to_ed(ohci_ed_t* p_ed, ohci_gtd_t * p_gtd)
+static inline void gtd_free(ohci_gtd_t* p_gtd)
 {
-  // tail is always NULL
-  if ( tu_align16(p_ed->td_head.address) == 0 )
-  { // TD queue is empty --> head = TD
-    p_ed->td_head.address |= (uint32_t) p_gtd;
-  }
-  else
-  { // TODO currently only support queue up to 2 TD each endpoint at a time
-    ((ohci_gtd_t*) tu_align16(p_ed->td_head.address))->next = (uint32_t) p_gtd;
-  }
+  if ( gtd_is_control(p_gtd) ) return; // control gTD is static
+
+  p_gtd->used = 0;
+  ohci_data.gtd_free[ohci_data.gtd_free_count++] = (uint8_t) (p_gtd - ohci_data.gtd_pool);
 }
 
-static bool pipe_queue_xfer(uint8_t dev_addr, uint8_t ep_addr, uint8_t buffer[], uint16_t total_bytes, bool int_on_complete)
+// A gTD spans at most 2 pages and expected_bytes is 13-bit, larger transfer is split into a chain of gTDs.
+// Each is a multiple of max packet size except the last, whose delay interrupt reports the whole transfer.
+// Chained gTDs have buffer rounding off, a short packet halts ED so that done queue can retire the rest.
+static bool pipe_queue_xfer(ohci_ed_t* p_ed, uint8_t buffer[], uint32_t total_bytes, bool int_on_complete)
 {
-  ohci_ed_t* const p_ed = ed_from_addr(dev_addr, ep_addr);
-
   // not support ISO yet
   TU_VERIFY ( !p_ed->is_iso );
 
-  ohci_gtd_t * const p_gtd = gtd_find_free();
-  TU_ASSERT(p_gtd); // not enough gtd
+  uint8_t const ed_idx = ed_get_index(p_ed);
+  ohci_gtd_t* const p_first = &ohci_data.gtd_pool[ ohci_data.ed_dummy[ed_idx] ];
+  ohci_gtd_t* p_gtd = p_first;
+
+  hcd_int_disable(TUH_OPT_RHPORT);
+
+  // timeout of a transfer counts once it heads the list
+  bool const is_idle = (tu_align16(p_ed->td_head.address) == (uint32_t) p_first);
+
+  // HC does not process TailP, fill the current dummy (and appended gTDs) then move TailP to a new dummy
+  while(1)
+  {
+    ohci_gtd_t* const p_dummy = gtd_alloc();
+    if ( !p_dummy )
+    { // not enough gtd, return the partial chain
+      p_gtd = (ohci_gtd_t*) p_first->next;
+      while ( p_gtd )
+      {
+        ohci_gtd_t* const p_next = (ohci_gtd_t*) p_gtd->next;
+        gtd_free(p_gtd);
+        p_gtd = p_next;
+      }
+      p_first->next = 0;
+
+      hcd_int_enable(TUH_OPT_RHPORT);
+      TU_ASSERT(p_dummy); // not enough gtd
+    }
+    gtd_init(p_dummy, NULL, 0);
+
+    uint32_t const max_bytes = 2*4096 - 1 - tu_offset4k((uint32_t) buffer);
+    bool const is_last = (total_bytes <= max_bytes);
+    uint32_t const xact_bytes = is_last ? total_bytes : (max_bytes - (max_bytes % p_ed->max_packet_size));
+
+    gtd_init(p_gtd, buffer, (uint16_t) xact_bytes);
+    p_gtd->index = ed_idx;
+    p_gtd->next  = (uint32_t) p_dummy;
+
+    buffer      += xact_bytes;
+    total_bytes -= xact_bytes;
+
+    if ( is_last )
+    {
+      if ( int_on_complete ) p_gtd->delay_interrupt = OHCI_INT_ON_COMPLETE_YES;
+
+      ohci_data.ed_dummy[ed_idx] = (uint8_t) (p_dummy - ohci_data.gtd_pool);
+
+      // halted ED has TailP = HeadP until its halt is cleared (see done_queue_isr)
+      if ( !p_ed->td_head.halted ) p_ed->td_tail = (uint32_t) p_dummy;
+      break;
+    }
 
-  gtd_init(p_gtd, buffer, total_bytes);
-  p_gtd->index = p_ed-ohci_data.ed_pool;
+    p_gtd->buffer_rounding = 0;
+    p_gtd = p_dummy;
+  }
 
-  if ( int_on_complete )  p_gtd->delay_interrupt = OHCI_INT_ON_COMPLETE_YES;
+  if ( is_idle ) ed_timer_restart(p_ed);
 
-  td_insert_to_ed(p_ed, p_gtd);
+  hcd_int_enable(TUH_OPT_RHPORT);
 
   return true;
 }
 
-bool hcd_pipe_queue_xfer(uint8_t dev_addr, uint8_t ep_addr, uint8_t buffer[], uint16_t total_bytes)
+bool hcd_pipe_queue_xfer(uint8_t dev_addr, uint8_t ep_addr, uint8_t buffer[], uint32_t total_bytes)
 {
-  return pipe_queue_xfer(dev_addr, ep_addr, buffer, total_bytes, false);
+  ohci_ed_t* const p_ed = ed_from_addr(dev_addr, ep_addr);
+  TU_ASSERT(p_ed);
+
+  return pipe_queue_xfer(p_ed, buffer, total_bytes, false);
 }
 
-bool  hcd_pipe_xfer(uint8_t dev_addr, uint8_t ep_addr, uint8_t buffer[], uint16_t total_bytes, bool int_on_complete)
+// Isochronous transfers are not supported by this driver, its endpoints are not opened either
+bool hcd_edpt_iso_xfer(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr, uint8_t * buffer, uint16_t packet_len[], uint16_t count)
+{
+  (void) rhport; (void) dev_addr; (void) ep_addr; (void) buffer; (void) packet_len; (void) count;
+  return false;
+}
+
+bool hcd_edpt_iso_close(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr)
+{
+  (void) rhport; (void) dev_addr; (void) ep_addr;
+  return false;
+}
+
+bool  hcd_pipe_xfer(uint8_t dev_addr, uint8_t ep_addr, uint8_t buffer[], uint32_t total_bytes, bool int_on_complete)
 {
   (void) int_on_complete;
-  TU_ASSERT( pipe_queue_xfer(dev_addr, ep_addr, buffer, total_bytes, true) );
 
-  tusb_xfer_type_t xfer_type = ed_get_xfer_type( ed_from_addr(dev_addr, ep_addr) );
+  ohci_ed_t* const p_ed = ed_from_addr(dev_addr, ep_addr);
+  TU_ASSERT(p_ed);
+  TU_ASSERT( pipe_queue_xfer(p_ed, buffer, total_bytes, true) );
+
+  tusb_xfer_type_t xfer_type = ed_get_xfer_type(p_ed);
 
   if (TUSB_XFER_BULK == xfer_type) OHCI_REG->command_status_bit.bulk_list_filled = 1;
 
@@ -500,16 +617,200 @@ bool hcd_edpt_clear_stall(uint8_t dev_addr, uint8_t ep_addr)
   ohci_ed_t * const p_ed = ed_from_addr(dev_addr, ep_addr);
 
   p_ed->is_stalled = 0;
-  p_ed->td_tail    &= 0x0Ful; // set tail pointer back to NULL
+  p_ed->td_tail    &= 0x0Ful; // set tail pointer back to NULL (control) or the dummy gTD
+
+  if ( p_ed->ep_number != 0 )
+  {
+    p_ed->td_tail |= (uint32_t) &ohci_data.gtd_pool[ ohci_data.ed_dummy[ed_get_index(p_ed)] ];
+  }
 
   p_ed->td_head.toggle = 0; // reset data toggle
   p_ed->td_head.halted = 0;
+  if ( hcd_edpt_busy(dev_addr, ep_addr) ) ed_timer_restart(p_ed);
 
   if ( TUSB_XFER_BULK == ed_get_xfer_type(p_ed) ) OHCI_REG->command_status_bit.bulk_list_filled = 1;
 
   return true;
 }
 
+//--------------------------------------------------------------------+
+// Transfer timeout & abort
+//--------------------------------------------------------------------+
+static inline uint32_t gtd_xferred_bytes(ohci_gtd_t const * const p_gtd);
+
+// FrameNumber is 16-bit, toggle of its MSB raises frame overflow interrupt which counts the upper bits
+uint32_t hcd_frame_number(uint8_t rhport)
+{
+  (void) rhport;
+  uint32_t overflow, frame;
+
+  do
+  {
+    overflow = ohci_data.frame_overflow;
+    frame    = OHCI_REG->frame_number & 0xFFFFul;
+  } while ( overflow != ohci_data.frame_overflow );
+
+  // overflow interrupt is not serviced yet
+  if ( (overflow ^ frame) & 0x8000ul ) overflow += 0x8000ul;
+
+  return overflow + (frame & 0x7FFFul);
+}
+
+// Interrupt EDs share one list which HC walks in every frame (interval is not honored), each costs
+// its max packet with worst case bit stuffing and ~13 bytes of token/handshake, 8x for low speed
+void hcd_period_usage(uint8_t rhport, hcd_period_usage_t* usage, uint16_t load[], uint16_t count)
+{
+  (void) rhport;
+
+  uint32_t bw = 0;
+  for(uint8_t i = 0; i < HCD_MAX_ENDPOINT; i++)
+  {
+    ohci_ed_t const* p_ed = &ohci_data.ed_pool[i];
+    if ( !(p_ed->used && p_ed->is_interrupt_xfer) ) continue;
+
+    uint32_t const cost = p_ed->max_packet_size + p_ed->max_packet_size/6 + 13;
+    bw += (p_ed->speed == TUSB_SPEED_LOW) ? 8*cost : cost;
+  }
+
+  usage->slots   = 1;
+  usage->slot_us = 1000;
+  usage->budget  = 1350; // 90% of frame, see periodic_start
+  usage->peak    = (uint16_t) tu_min32(bw, UINT16_MAX);
+  usage->fs_peak = 0;
+
+  if ( count ) load[0] = usage->peak;
+}
+
+// timer of pool ed is at its index, followed by control ed of each address
+static inline uint16_t ed_timer_idx(ohci_ed_t const * p_ed)
+{
+  if ( p_ed >= ohci_data.ed_pool && p_ed < ohci_data.ed_pool + HCD_MAX_ENDPOINT ) return (uint16_t) (p_ed - ohci_data.ed_pool);
+  return (uint16_t) (HCD_MAX_ENDPOINT + p_ed->dev_addr);
+}
+
+// head transfer (re)starts its timeout
+static void ed_timer_restart(ohci_ed_t const * p_ed)
+{
+  uint16_t const idx = ed_timer_idx(p_ed);
+  ohci_data.ed_deadline[idx] = (uint16_t) (hcd_frame_number(TUH_OPT_RHPORT) + ohci_data.ed_timeout[idx]);
+}
+
+// halted ED reports its error already, and has TailP = HeadP
+static inline bool ed_is_pending(ohci_ed_t const * p_ed)
+{
+  return !p_ed->td_head.halted && (tu_align16(p_ed->td_head.address) != tu_align16(p_ed->td_tail));
+}
+
+bool hcd_edpt_timeout(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr, uint16_t timeout_ms)
+{
+  ohci_ed_t const * const p_ed = ed_from_addr(dev_addr, ep_addr);
+  TU_VERIFY(p_ed);
+
+  hcd_int_disable(rhport);
+  ohci_data.ed_timeout[ed_timer_idx(p_ed)] = timeout_ms;
+  ed_timer_restart(p_ed);
+  hcd_int_enable(rhport);
+
+  // timeouts are checked on SOF
+  if ( timeout_ms ) OHCI_REG->interrupt_enable = OHCI_INT_SOF_MASK;
+
+  return true;
+}
+
+// Free gTDs of head transfer (up to its interrupt on complete one) or all queued ones of a skipped ED
+// that HC has left. HeadP is moved past them keeping toggle carry and halted bits. Return bytes transferred.
+static uint32_t ed_xfer_retire(ohci_ed_t* p_ed, bool all)
+{
+  ohci_gtd_t* const p_end = (p_ed->ep_number == 0) ? NULL : &ohci_data.gtd_pool[ ohci_data.ed_dummy[ed_get_index(p_ed)] ];
+  ohci_gtd_t* p_gtd = (ohci_gtd_t*) tu_align16(p_ed->td_head.address);
+  uint32_t xferred = 0;
+  bool ioc = false;
+
+  while ( p_gtd != p_end && (all || !ioc) )
+  {
+    ohci_gtd_t* const p_next = (ohci_gtd_t*) p_gtd->next;
+
+    ioc      = (p_gtd->delay_interrupt == OHCI_INT_ON_COMPLETE_YES);
+    xferred += gtd_xferred_bytes(p_gtd);
+
+    gtd_free(p_gtd);
+    p_gtd = p_next;
+  }
+
+  if ( p_ed->ep_number != 0 )
+  {
+    uint8_t const ed_idx = ed_get_index(p_ed);
+    xferred += ohci_data.ed_xferred_bytes[ed_idx];
+    ohci_data.ed_xferred_bytes[ed_idx] = 0;
+  }
+
+  p_ed->td_head.address = (p_ed->td_head.address & 0x0Ful) | ((uint32_t) p_gtd);
+
+  // halted ED stays marked as empty queue
+  if ( p_ed->td_head.halted ) p_ed->td_tail = (p_ed->td_tail & 0x0Ful) | ((uint32_t) p_gtd);
+
+  return xferred;
+}
+
+bool hcd_edpt_abort(uint8_t rhport, uint8_t dev_addr, uint8_t ep_addr)
+{
+  ohci_ed_t * const p_ed = ed_from_addr(dev_addr, ep_addr);
+  TU_VERIFY(p_ed);
+
+  // OHCI 5.2.7.1.2 ED may be cached by HC, skip it and wait for next frame before modifying
+  hcd_int_disable(rhport);
+  bool const keep_skip = p_ed->skip && !p_ed->is_expiring; // addr0 closed
+  p_ed->is_expiring = 0;
+  p_ed->skip = 1;
+  hcd_int_enable(rhport);
+
+  uint16_t const frame = ohci_data.hcca.frame_number;
+  while ( frame == ohci_data.hcca.frame_number ) {}
+
+  hcd_int_disable(rhport);
+  (void) ed_xfer_retire(p_ed, true);
+  p_ed->is_expiring = 0;
+  p_ed->skip = keep_skip ? 1 : 0;
+  hcd_int_enable(rhport);
+
+  return true;
+}
+
+// Timed out ED is skipped first, its transfer is retired on a later check once HC has left it
+static void xfer_timeout_isr(uint8_t hostid)
+{
+  uint16_t const now = (uint16_t) hcd_frame_number(hostid);
+
+  for(uint32_t i = 0; i < TU_ARRAY_SIZE(ohci_data.ed_timeout); i++)
+  {
+    if ( !ohci_data.ed_timeout[i] ) continue;
+
+    ohci_ed_t* const p_ed = (i < HCD_MAX_ENDPOINT) ? &ohci_data.ed_pool[i] : &ohci_data.control[i - HCD_MAX_ENDPOINT].ed;
+    if ( !p_ed->used ) continue;
+
+    if ( p_ed->is_expiring )
+    {
+      uint32_t const xferred = ed_xfer_retire(p_ed, false);
+      p_ed->is_expiring = 0;
+      p_ed->skip = 0;
+
+      if ( ed_is_pending(p_ed) )
+      {
+        ed_timer_restart(p_ed);
+        if ( TUSB_XFER_BULK == ed_get_xfer_type(p_ed) ) OHCI_REG->command_status_bit.bulk_list_filled = 1;
+        if ( 0 == p_ed->ep_number ) OHCI_REG->command_status_bit.control_list_filled = 1;
+      }
+
+      hcd_event_xfer_complete(p_ed->dev_addr, tu_edpt_addr(p_ed->ep_number, p_ed->pid == OHCI_PID_IN), XFER_RESULT_TIMEOUT, xferred);
+    }
+    else if ( ed_is_pending(p_ed) && (int16_t) (now - ohci_data.ed_deadline[i]) >= 0 )
+    {
+      p_ed->skip = 1;
+      p_ed->is_expiring = 1;
+    }
+  }
+}
+
 
 //--------------------------------------------------------------------+
 // OHCI Interrupt Handler
@@ -554,6 +855,38 @@ static inline uint32_t gtd_xfer_byte_left(uint32_t buffer_end, uint32_t current_
       tu_offset4k(buffer_end) - tu_offset4k(current_buffer) + 1;
 }
 
+static inline uint32_t gtd_xferred_bytes(ohci_gtd_t const * const p_gtd)
+{
+  // current buffer pointer is zeroed when all bytes are transferred
+  if ( p_gtd->current_buffer_pointer == NULL ) return p_gtd->expected_bytes;
+  return p_gtd->expected_bytes - gtd_xfer_byte_left((uint32_t) p_gtd->buffer_end, (uint32_t) p_gtd->current_buffer_pointer);
+}
+
+// HC halted ED after retiring a non-last gTD of a chain, remove the rest of the chain which
+// HeadP points to. Return true if the last gTD of the chain is interrupt on complete.
+static bool gtd_chain_retire(ohci_ed_t* p_ed)
+{
+  ohci_gtd_t* p_gtd = (ohci_gtd_t*) tu_align16(p_ed->td_head.address);
+  bool is_last;
+  bool ioc;
+
+  do
+  {
+    ohci_gtd_t* const p_next = (ohci_gtd_t*) p_gtd->next;
+
+    is_last = p_gtd->buffer_rounding;
+    ioc     = (p_gtd->delay_interrupt == OHCI_INT_ON_COMPLETE_YES);
+
+    gtd_free(p_gtd);
+    p_gtd = p_next;
+  } while ( !is_last );
+
+  // keep halted and toggle carry bits
+  p_ed->td_head.address = (p_ed->td_head.address & 0x0Ful) | ((uint32_t) p_gtd);
+
+  return ioc;
+}
+
 static void done_queue_isr(uint8_t hostid)
 {
   (void) hostid;
@@ -566,15 +899,42 @@ static void done_queue_isr(uint8_t hostid)
     // TODO check if td_head is iso td
     //------------- Non ISO transfer -------------//
     ohci_gtd_t * const p_qtd = (ohci_gtd_t *) td_head;
-    xfer_result_t const event = (p_qtd->condition_code == OHCI_CCODE_NO_ERROR) ? XFER_RESULT_SUCCESS :
-                                (p_qtd->condition_code == OHCI_CCODE_STALL) ? XFER_RESULT_STALLED : XFER_RESULT_FAILED;
+    ohci_ed_t * const p_ed   = gtd_get_ed(p_qtd);
+    td_head = (ohci_td_item_t*) td_head->next;
+
+    bool const is_chained  = !p_qtd->buffer_rounding;
+    uint8_t const ccode    = p_qtd->condition_code;
+    bool ioc               = (p_qtd->delay_interrupt == OHCI_INT_ON_COMPLETE_YES);
+    uint32_t xferred_bytes = gtd_xferred_bytes(p_qtd);
+
+    // short packet of a chained gTD completes its transfer
+    xfer_result_t const event = (ccode == OHCI_CCODE_NO_ERROR || (is_chained && ccode == OHCI_CCODE_DATA_UNDERRUN)) ? XFER_RESULT_SUCCESS :
+                                (ccode == OHCI_CCODE_STALL) ? XFER_RESULT_STALLED : XFER_RESULT_FAILED;
+
+    gtd_free(p_qtd);
 
-    p_qtd->used = 0; // free TD
-    if ( (p_qtd->delay_interrupt == OHCI_INT_ON_COMPLETE_YES) || (event != XFER_RESULT_SUCCESS) )
+    if ( is_chained && (ccode != OHCI_CCODE_NO_ERROR) )
     {
-      ohci_ed_t * const p_ed  = gtd_get_ed(p_qtd);
+      ioc = gtd_chain_retire(p_ed);
 
-      uint32_t const xferred_bytes = p_qtd->expected_bytes - gtd_xfer_byte_left((uint32_t) p_qtd->buffer_end, (uint32_t) p_qtd->current_buffer_pointer);
+      if ( event == XFER_RESULT_SUCCESS )
+      {
+        p_ed->td_head.halted = 0;
+        if ( TUSB_XFER_BULK == ed_get_xfer_type(p_ed) ) OHCI_REG->command_status_bit.bulk_list_filled = 1;
+      }
+    }
+
+    // batch all gTDs of an endpoint (chained or queued without interrupt) into one event
+    if ( !gtd_is_control(p_qtd) )
+    {
+      uint8_t const ed_idx = p_qtd->index;
+
+      xferred_bytes += ohci_data.ed_xferred_bytes[ed_idx];
+      ohci_data.ed_xferred_bytes[ed_idx] = (ioc || (event != XFER_RESULT_SUCCESS)) ? 0 : xferred_bytes;
+    }
+
+    if ( ioc || (event != XFER_RESULT_SUCCESS) )
+    {
 
       // NOTE Assuming the current list is BULK and there is no other EDs in the list has queued TDs.
       // When there is a error resulting this ED is halted, and this EP still has other queued TD
@@ -590,12 +950,18 @@ static void done_queue_isr(uint8_t hostid)
         if ( event == XFER_RESULT_STALLED ) p_ed->is_stalled = 1;
       }
 
+      // transfer completed before its timeout could be retired
+      if ( p_ed->is_expiring )
+      {
+        p_ed->is_expiring = 0;
+        p_ed->skip = 0;
+      }
+      if ( ed_is_pending(p_ed) ) ed_timer_restart(p_ed);
+
       hcd_event_xfer_complete(p_ed->dev_addr,
                               tu_edpt_addr(p_ed->ep_number, p_ed->pid == OHCI_PID_IN),
                               event, xferred_bytes);
     }
-
-    td_head = (ohci_td_item_t*) td_head->next;
   }
 }
 
@@ -634,12 +1000,29 @@ void hcd_isr(uint8_t hostid)
     OHCI_REG->rhport_status[0] = rhport_status; // acknowledge all interrupt
   }
 
+  if ( int_status & OHCI_INT_FRAME_OVERFLOW_MASK )
+  {
+    ohci_data.frame_overflow += 0x8000ul;
+  }
+
   //------------- Transfer Complete -------------//
   if ( int_status & OHCI_INT_WRITEBACK_DONEHEAD_MASK)
   {
     done_queue_isr(hostid);
   }
 
+  //------------- Transfer Timeout -------------//
+  if ( int_status & OHCI_INT_SOF_MASK )
+  {
+    // check every 8 frames
+    uint16_t const frame = (uint16_t) hcd_frame_number(hostid);
+    if ( (uint16_t) (frame - ohci_data.timer_frame) >= 8 )
+    {
+      ohci_data.timer_frame = frame;
+      xfer_timeout_isr(hostid);
+    }
+  }
+
   OHCI_REG->interrupt_status = int_status; // Acknowledge handled interrupt
 }
 //--------------------------------------------------------------------+
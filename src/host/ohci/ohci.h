@@ -45,11 +45,21 @@
 #define HOST_HCD_XFER_INTERRUPT // TODO interrupt is used widely, should always be enalbed
 #define OHCI_PERIODIC_LIST (defined HOST_HCD_XFER_INTERRUPT || defined HOST_HCD_XFER_ISOCHRONOUS)
 
+// Additional gTDs for transfers larger than one gTD (up to 8 KB), which are split into a chain
+#ifndef CFG_TUH_OHCI_GTD_EXTRA
+#define CFG_TUH_OHCI_GTD_EXTRA  4
+#endif
+
 // TODO merge OHCI with EHCI
 enum {
-  OHCI_MAX_ITD = 4
+  OHCI_MAX_ITD = 4,
+  OHCI_MAX_GTD = HCD_MAX_XFER + CFG_TUH_OHCI_GTD_EXTRA
 };
 
+//------------- Validation -------------//
+TU_VERIFY_STATIC(HCD_MAX_ENDPOINT <= 16, "gTD index is 4-bit");
+TU_VERIFY_STATIC(OHCI_MAX_GTD <= 256, "free list index is 8-bit");
+
 enum {
   OHCI_PID_SETUP = 0,
   OHCI_PID_OUT,
@@ -83,7 +93,7 @@ typedef struct TU_ATTR_ALIGNED(16)
 	uint32_t index                   : 4;  // endpoint index the td belongs to, or device address in case of control xfer
   uint32_t expected_bytes          : 13; // TODO available for hcd
 
-  uint32_t buffer_rounding         : 1;
+  uint32_t buffer_rounding         : 1;  // 0 only for non-last gTD of a chain: short packet halts ED
   uint32_t pid                     : 2;
   uint32_t delay_interrupt         : 3;
   volatile uint32_t data_toggle    : 2;
@@ -116,7 +126,8 @@ typedef struct TU_ATTR_ALIGNED(16)
 	uint32_t used              : 1;
 	uint32_t is_interrupt_xfer : 1;
 	uint32_t is_stalled        : 1;
-	uint32_t                   : 2;
+	uint32_t is_expiring       : 1; // timed out, skipped until HC has left it
+	uint32_t                   : 1;
 
 	// Word 1
 	uint32_t td_tail;
@@ -178,7 +189,22 @@ typedef struct TU_ATTR_ALIGNED(256)
 
   //  ochi_itd_t itd[OHCI_MAX_ITD]; // itd requires alignment of 32
   ohci_ed_t ed_pool[HCD_MAX_ENDPOINT];
-  ohci_gtd_t gtd_pool[HCD_MAX_XFER];
+  ohci_gtd_t gtd_pool[OHCI_MAX_GTD];
+
+  // not accessed by HC
+  uint8_t  gtd_free[OHCI_MAX_GTD];
+  uint16_t gtd_free_count;
+
+  uint8_t  ed_dummy[HCD_MAX_ENDPOINT];         // gTD index of each ED's empty tail (TailP)
+  uint32_t ed_xferred_bytes[HCD_MAX_ENDPOINT]; // accumulated until a gTD with interrupt on complete
+
+  // Transfer timeout (ms, 0 is none) and deadline of head transfer of ed pool, followed by
+  // control ed of each address
+  uint16_t ed_timeout [HCD_MAX_ENDPOINT + CFG_TUSB_HOST_DEVICE_MAX+1];
+  uint16_t ed_deadline[HCD_MAX_ENDPOINT + CFG_TUSB_HOST_DEVICE_MAX+1];
+  uint16_t timer_frame;    // frame of last timeout check
+
+  uint32_t frame_overflow; // upper bits of frame number, counted by frame overflow interrupt
 
 } ohci_data_t;
 
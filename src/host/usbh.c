@@ -32,6 +32,22 @@
 #define CFG_TUH_TASK_QUEUE_SZ   16
 #endif
 
+// Queue of completions of latency sensitive endpoints (usbh_edpt_prio), processed by tuh_task() before
+// the others so that e.g a keyboard is not held behind a burst of mass storage completions. 0 to disable
+#ifndef CFG_TUH_TASK_PRIO_QUEUE_SZ
+#define CFG_TUH_TASK_PRIO_QUEUE_SZ  0
+#endif
+
+// Time source of tuh_task_budget(), in unit of its max_time e.g a microsecond timer. Default to DWT
+// cycle counter on Cortex-M3 and up, time budget is ignored if it is 0
+#ifndef CFG_TUH_TASK_TIMESTAMP
+  #if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__) || defined(__ARM_ARCH_8M_MAIN__)
+    #define CFG_TUH_TASK_TIMESTAMP()  (*(volatile uint32_t const*) 0xE0001004UL)
+  #else
+    #define CFG_TUH_TASK_TIMESTAMP()  0
+  #endif
+#endif
+
 //--------------------------------------------------------------------+
 // INCLUDE
 //--------------------------------------------------------------------+
@@ -44,13 +60,32 @@
 //--------------------------------------------------------------------+
 static host_class_driver_t const usbh_class_drivers[] =
 {
+  // before CDC which would also claim RNDIS (ACM with vendor protocol)
+  #if CFG_TUH_NET
+    {
+      .class_code = TUSB_CLASS_CDC,
+      .init       = neth_init,
+      .open       = neth_open,
+      .close      = neth_close,
+      .xfer_cb    = neth_xfer_cb
+    },
+    {
+      .class_code = TUSB_CLASS_WIRELESS_CONTROLLER,
+      .init       = neth_init,
+      .open       = neth_open,
+      .close      = neth_close,
+      .xfer_cb    = neth_xfer_cb
+    },
+  #endif
+
   #if CFG_TUH_CDC
     {
       .class_code = TUSB_CLASS_CDC,
       .init       = cdch_init,
       .open       = cdch_open,
-      .isr        = cdch_isr,
-      .close      = cdch_close
+      .set_config = cdch_set_config,
+      .close      = cdch_close,
+      .xfer_cb    = cdch_xfer_cb
     },
   #endif
 
@@ -58,9 +93,11 @@ static host_class_driver_t const usbh_class_drivers[] =
     {
       .class_code = TUSB_CLASS_MSC,
       .init       = msch_init,
-      .open       = msch_open,
-      .isr        = msch_isr,
-      .close      = msch_close
+      .open        = msch_open,
+      .set_config  = msch_set_config,
+      .close       = msch_close,
+      .xfer_cb     = msch_xfer_cb,
+      .xfer_isr_cb = msch_xfer_isr_cb
     },
   #endif
 
@@ -69,8 +106,9 @@ static host_class_driver_t const usbh_class_drivers[] =
       .class_code = TUSB_CLASS_HID,
       .init       = hidh_init,
       .open       = hidh_open_subtask,
-      .isr        = hidh_isr,
-      .close      = hidh_close
+      .set_config = hidh_set_config,
+      .close      = hidh_close,
+      .xfer_cb    = hidh_xfer_cb
     },
   #endif
 
@@ -79,8 +117,32 @@ static host_class_driver_t const usbh_class_drivers[] =
       .class_code = TUSB_CLASS_HUB,
       .init       = hub_init,
       .open       = hub_open,
-      .isr        = hub_isr,
-      .close      = hub_close
+      .set_config = hub_set_config,
+      .close      = hub_close,
+      .xfer_cb    = hub_xfer_cb
+    },
+  #endif
+
+  // control interface with its streaming interfaces, MIDI streaming interface is left to MIDI driver
+  #if CFG_TUH_AUDIO
+    {
+      .class_code = TUSB_CLASS_AUDIO,
+      .init       = audioh_init,
+      .open       = audioh_open,
+      .set_config = audioh_set_config,
+      .close      = audioh_close,
+      .xfer_cb    = audioh_xfer_cb
+    },
+  #endif
+
+  #if CFG_TUH_MIDI
+    {
+      .class_code = TUSB_CLASS_AUDIO,
+      .init       = midih_init,
+      .open       = midih_open,
+      .set_config = midih_set_config,
+      .close      = midih_close,
+      .xfer_cb    = midih_xfer_cb
     },
   #endif
 
@@ -88,15 +150,41 @@ static host_class_driver_t const usbh_class_drivers[] =
     {
       .class_code = TUSB_CLASS_VENDOR_SPECIFIC,
       .init       = cush_init,
-      .open       = cush_open_subtask,
-      .isr        = cush_isr,
-      .close      = cush_close
+      .open       = cush_open,
+      .close      = cush_close,
+      .xfer_cb    = cush_xfer_cb
     }
   #endif
 };
 
 enum { USBH_CLASS_DRIVER_COUNT = TU_ARRAY_SIZE(usbh_class_drivers) };
 
+// ep2drv mapping of isochronous endpoint opened by application
+enum { USBH_ISO_APP = 0xfe };
+
+// enumeration stage of a device, named after the request in progress
+enum
+{
+  ENUM_IDLE = 0,
+
+  // address 0
+  ENUM_POWER_STABLE_DELAY,
+  ENUM_RESET_DELAY,
+  ENUM_RESET_RECOVERY_DELAY, // port reset by hub
+  ENUM_GET_DEVICE_DESC_8,
+  ENUM_RESET_AGAIN_DELAY,
+  ENUM_SET_ADDRESS,
+
+  // new address
+  ENUM_CONFIG_WAIT, // waiting for enum buffer
+  ENUM_GET_DEVICE_DESC,
+  ENUM_GET_CONFIG_DESC_9,
+  ENUM_GET_CONFIG_DESC,
+  ENUM_SET_CONFIG,
+  ENUM_GET_CONFIG_DESC_STREAM, // longer than enum buffer, after set config
+  ENUM_CONFIG_DRIVERS, // class requests of drivers
+};
+
 //--------------------------------------------------------------------+
 // INTERNAL OBJECT & FUNCTION DECLARATION
 //--------------------------------------------------------------------+
@@ -109,7 +197,54 @@ CFG_TUSB_MEM_SECTION usbh_device_t _usbh_devices[CFG_TUSB_HOST_DEVICE_MAX+1];
 OSAL_QUEUE_DEF(OPT_MODE_HOST, _usbh_qdef, CFG_TUH_TASK_QUEUE_SZ, hcd_event_t);
 static osal_queue_t _usbh_q;
 
+#if CFG_TUH_TASK_PRIO_QUEUE_SZ
+// written by isr, or by task with usb interrupt disabled. Read by tuh_task() only
+static hcd_event_t _usbh_prio_buf[CFG_TUH_TASK_PRIO_QUEUE_SZ];
+static tu_fifo_t   _usbh_prio_ff;
+#endif
+
 CFG_TUSB_MEM_SECTION TU_ATTR_ALIGNED(4) static uint8_t _usbh_ctrl_buf[CFG_TUSB_HOST_ENUM_BUFFER_SIZE];
+CFG_TUSB_MEM_SECTION TU_ATTR_ALIGNED(4) static uint8_t _usbh_dev0_buf[8]; // first 8 bytes of device descriptor
+
+// device being configured, which owns _usbh_ctrl_buf
+static uint8_t _enum_config_addr;
+static uint8_t _enum_config_number;
+static uint8_t const* _enum_desc_end; // see usbh_config_desc_end()
+
+// Configuration descriptor longer than enum buffer is received by one data stage split into chunks, each
+// one is parsed by tuh_task() before the next is started at the end of unparsed descriptors kept in buffer.
+// Chunks are a multiple of 128 bytes i.e even number of packets of any control endpoint size, so that
+// the next one starts with DATA1 as HCD does for every control transfer.
+enum { ENUM_STREAM_ALIGN = 128 };
+TU_VERIFY_STATIC(CFG_TUSB_HOST_ENUM_BUFFER_SIZE >= 2*ENUM_STREAM_ALIGN, "enum buffer too small");
+
+typedef struct
+{
+  uint16_t total_len; // 0 if not streaming
+  uint16_t received;
+  uint16_t chunk;     // length of data stage transfer in progress, 0 if none
+  uint16_t xferred;   // of last chunk
+  uint16_t win_len;   // unparsed bytes at start of buffer, chunk is received after them
+  uint16_t skip;      // bytes claimed by a driver but not yet received, dropped from next chunk
+} enum_stream_t;
+
+static enum_stream_t _enum_stream;
+
+#if CFG_TUH_ENUM_CACHE
+typedef struct
+{
+  uint16_t vendor_id;
+  uint16_t product_id;
+  uint16_t bcd_device;
+  uint8_t  config_num;
+  uint16_t total_len; // 0 if entry is free
+  uint8_t  desc[CFG_TUH_ENUM_CACHE_DESC_SIZE];
+} enum_cache_t;
+
+static enum_cache_t _enum_cache[CFG_TUH_ENUM_CACHE];
+static uint8_t _enum_cache_victim;    // round robin replacement
+static enum_cache_t* _enum_cache_hit; // entry of device being configured
+#endif
 
 //------------- Reporter Task Data -------------//
 
@@ -117,6 +252,10 @@ CFG_TUSB_MEM_SECTION TU_ATTR_ALIGNED(4) static uint8_t _usbh_ctrl_buf[CFG_TUSB_H
 static inline uint8_t get_new_address(void);
 static inline uint8_t get_configure_number_for_device(tusb_desc_device_t* dev_desc);
 static void mark_interface_endpoint(uint8_t ep2drv[8][2], uint8_t const* p_desc, uint16_t desc_len, uint8_t driver_id);
+static void enum_address0_done(void);
+static void enum_config_next(void);
+static bool enum_stream_data(uint8_t dev_addr, bool final);
+static uint32_t delay_process(uint32_t timeout_ms);
 
 //--------------------------------------------------------------------+
 // PUBLIC API (Parameter Verification is required)
@@ -138,6 +277,10 @@ bool usbh_init(void)
   _usbh_q = osal_queue_create( &_usbh_qdef );
   TU_ASSERT(_usbh_q != NULL);
 
+#if CFG_TUH_TASK_PRIO_QUEUE_SZ
+  tu_fifo_config(&_usbh_prio_ff, _usbh_prio_buf, CFG_TUH_TASK_PRIO_QUEUE_SZ, sizeof(hcd_event_t), false);
+#endif
+
   //------------- Semaphore, Mutex for Control Pipe -------------//
   for(uint8_t i=0; i<CFG_TUSB_HOST_DEVICE_MAX+1; i++) // including address zero
   {
@@ -163,39 +306,269 @@ bool usbh_init(void)
 }
 
 //------------- USBH control transfer -------------//
-bool usbh_control_xfer (uint8_t dev_addr, tusb_control_request_t* request, uint8_t* data)
+enum
+{
+  CONTROL_STAGE_IDLE = 0,
+  CONTROL_STAGE_SETUP,
+  CONTROL_STAGE_DATA,
+  CONTROL_STAGE_STATUS,
+  CONTROL_STAGE_COMPLETE,   // waiting for tuh_task() to invoke complete_cb
+  CONTROL_STAGE_DATA_CHUNK, // waiting for tuh_task() to parse a chunk of configuration descriptor
+};
+
+// Claim control pipe and send SETUP, the other stages are driven by hcd_event_xfer_complete()
+static bool control_xfer_start(uint8_t dev_addr, tusb_control_request_t const* request, void* buffer, tuh_control_complete_cb_t complete_cb)
 {
   usbh_device_t* dev = &_usbh_devices[dev_addr];
   const uint8_t rhport = dev->rhport;
 
-  TU_ASSERT(osal_mutex_lock(dev->control.mutex_hdl, OSAL_TIMEOUT_NORMAL));
+  hcd_int_disable(rhport);
+  bool const idle = (dev->control.stage == CONTROL_STAGE_IDLE);
+  if ( idle ) dev->control.stage = CONTROL_STAGE_SETUP;
+  hcd_int_enable(rhport);
+
+  TU_VERIFY(idle);
 
-  dev->control.request = *request;
+  dev->control.request     = *request;
+  dev->control.buffer      = (uint8_t*) buffer;
+  dev->control.complete_cb = complete_cb;
   dev->control.pipe_status = 0;
 
-  // Setup Stage
-  hcd_setup_send(rhport, dev_addr, (uint8_t*) &dev->control.request);
-  TU_VERIFY(osal_semaphore_wait(dev->control.sem_hdl, OSAL_TIMEOUT_NORMAL));
+  if ( !hcd_setup_send(rhport, dev_addr, (uint8_t*) &dev->control.request) )
+  {
+    dev->control.stage = CONTROL_STAGE_IDLE;
+    return false;
+  }
+
+  return true;
+}
+
+// Notify tuh_task() of a completed control transfer (or a data chunk to parse)
+static void control_xfer_event(usbh_device_t* dev, uint8_t dev_addr, xfer_result_t result, uint32_t len)
+{
+  hcd_event_t event =
+  {
+    .rhport   = dev->rhport,
+    .event_id = HCD_EVENT_XFER_COMPLETE
+  };
+
+  event.xfer_complete.dev_addr = dev_addr;
+  event.xfer_complete.ep_addr  = 0;
+  event.xfer_complete.result   = (uint8_t) result;
+  event.xfer_complete.len      = len;
+
+  hcd_event_handler(&event, true);
+}
+
+// Called by HCD isr when a stage of control transfer completes
+static void control_xfer_isr(uint8_t dev_addr, xfer_result_t result, uint32_t xferred_bytes)
+{
+  usbh_device_t* dev = &_usbh_devices[dev_addr];
+  tusb_control_request_t const* request = &dev->control.request;
+  const uint8_t rhport = dev->rhport;
+
+  // stray completion e.g of a blocking transfer abandoned on timeout
+  if ( dev->control.stage == CONTROL_STAGE_IDLE || dev->control.stage == CONTROL_STAGE_COMPLETE ||
+       dev->control.stage == CONTROL_STAGE_DATA_CHUNK ) return;
+
+  bool const stream = (dev_addr == _enum_config_addr) && _enum_stream.chunk;
+
+  if ( XFER_RESULT_SUCCESS == result )
+  {
+    if ( dev->control.stage == CONTROL_STAGE_SETUP && request->wLength )
+    {
+      // Data stage : first data toggle is always 1
+      dev->control.stage = CONTROL_STAGE_DATA;
+      hcd_edpt_xfer(rhport, dev_addr, tu_edpt_addr(0, request->bmRequestType_bit.direction), dev->control.buffer,
+                    stream ? _enum_stream.chunk : request->wLength);
+      return;
+    }
+
+    if ( dev->control.stage == CONTROL_STAGE_DATA && stream )
+    {
+      _enum_stream.xferred = (uint16_t) xferred_bytes;
+
+      // data stage goes on unless this is its last chunk or a short packet, next one is started by tuh_task()
+      if ( xferred_bytes == _enum_stream.chunk && _enum_stream.received + xferred_bytes < _enum_stream.total_len )
+      {
+        dev->control.stage = CONTROL_STAGE_DATA_CHUNK;
+        control_xfer_event(dev, dev_addr, result, xferred_bytes);
+        return;
+      }
+    }
+
+    if ( dev->control.stage == CONTROL_STAGE_SETUP || dev->control.stage == CONTROL_STAGE_DATA )
+    {
+      // Status : data toggle is always 1
+      dev->control.stage = CONTROL_STAGE_STATUS;
+      hcd_edpt_xfer(rhport, dev_addr, tu_edpt_addr(0, 1-request->bmRequestType_bit.direction), NULL, 0);
+      return;
+    }
+  }
+
+  // Status stage is done or a stage failed
+  dev->control.pipe_status = result;
 
-  // Data stage : first data toggle is always 1
-  if ( request->wLength )
+  if ( dev->control.complete_cb )
+  {
+    // callback is invoked in task context
+    dev->control.stage = CONTROL_STAGE_COMPLETE;
+    control_xfer_event(dev, dev_addr, result, 0);
+  }
+  else
   {
-    hcd_edpt_xfer(rhport, dev_addr, tu_edpt_addr(0, request->bmRequestType_bit.direction), data, request->wLength);
-    TU_VERIFY(osal_semaphore_wait(dev->control.sem_hdl, OSAL_TIMEOUT_NORMAL));
+    dev->control.stage = CONTROL_STAGE_IDLE;
+    osal_semaphore_post( dev->control.sem_hdl, true );
   }
+}
 
-  // Status : data toggle is always 1
-  hcd_edpt_xfer(rhport, dev_addr, tu_edpt_addr(0, 1-request->bmRequestType_bit.direction), NULL, 0);
-  TU_VERIFY(osal_semaphore_wait(dev->control.sem_hdl, OSAL_TIMEOUT_NORMAL));
+bool tuh_control_xfer(uint8_t dev_addr, tusb_control_request_t const * request, void* buffer, tuh_control_complete_cb_t complete_cb)
+{
+  TU_ASSERT(dev_addr <= CFG_TUSB_HOST_DEVICE_MAX && complete_cb);
+  return control_xfer_start(dev_addr, request, buffer, complete_cb);
+}
 
-  osal_mutex_unlock(dev->control.mutex_hdl);
+bool tuh_iso_edpt_open(uint8_t dev_addr, tusb_desc_endpoint_t const * ep_desc)
+{
+  TU_VERIFY( tuh_device_is_configured(dev_addr) );
+  TU_VERIFY( ep_desc->bmAttributes.xfer == TUSB_XFER_ISOCHRONOUS && tu_edpt_number(ep_desc->bEndpointAddress) < 8 );
+
+  usbh_device_t* dev = &_usbh_devices[dev_addr];
+  uint8_t* drv_id = &dev->ep2drv[tu_edpt_number(ep_desc->bEndpointAddress)][tu_edpt_dir(ep_desc->bEndpointAddress)];
+
+  // endpoint of a class driver
+  TU_VERIFY( *drv_id == 0xff );
+
+  TU_VERIFY( usbh_iso_edpt_open(dev_addr, ep_desc) );
+  *drv_id = USBH_ISO_APP;
+
+  return true;
+}
+
+bool tuh_iso_edpt_close(uint8_t dev_addr, uint8_t ep_addr)
+{
+  TU_VERIFY( dev_addr && dev_addr <= CFG_TUSB_HOST_DEVICE_MAX && tu_edpt_number(ep_addr) < 8 );
+
+  usbh_device_t* dev = &_usbh_devices[dev_addr];
+  uint8_t* drv_id = &dev->ep2drv[tu_edpt_number(ep_addr)][tu_edpt_dir(ep_addr)];
+  TU_VERIFY( *drv_id == USBH_ISO_APP );
+
+  *drv_id = 0xff;
+  return usbh_iso_edpt_close(dev_addr, ep_addr);
+}
+
+bool tuh_interface_set(uint8_t dev_addr, uint8_t itf_num, uint8_t alt, tuh_control_complete_cb_t complete_cb)
+{
+  tusb_control_request_t const request = {
+        .bmRequestType_bit = { .recipient = TUSB_REQ_RCPT_INTERFACE, .type = TUSB_REQ_TYPE_STANDARD, .direction = TUSB_DIR_OUT },
+        .bRequest = TUSB_REQ_SET_INTERFACE,
+        .wValue = alt,
+        .wIndex = itf_num,
+        .wLength = 0
+  };
+
+  return tuh_control_xfer(dev_addr, &request, NULL, complete_cb);
+}
+
+bool tuh_iso_xfer(uint8_t dev_addr, uint8_t ep_addr, void* buffer, uint16_t packet_len[], uint16_t count)
+{
+  TU_VERIFY( tuh_device_is_configured(dev_addr) && tu_edpt_number(ep_addr) < 8 );
+
+  usbh_device_t* dev = &_usbh_devices[dev_addr];
+  TU_VERIFY( dev->ep2drv[tu_edpt_number(ep_addr)][tu_edpt_dir(ep_addr)] == USBH_ISO_APP );
+
+  return hcd_edpt_iso_xfer(dev->rhport, dev_addr, ep_addr, (uint8_t*) buffer, packet_len, count);
+}
+
+bool tuh_edpt_set_timeout(uint8_t dev_addr, uint8_t ep_addr, uint16_t timeout_ms)
+{
+  TU_VERIFY( dev_addr <= CFG_TUSB_HOST_DEVICE_MAX );
+  return hcd_edpt_timeout(_usbh_devices[dev_addr].rhport, dev_addr, ep_addr, timeout_ms);
+}
 
-  if ( XFER_RESULT_STALLED == dev->control.pipe_status ) return false;
-  if ( XFER_RESULT_FAILED == dev->control.pipe_status ) return false;
+bool tuh_edpt_abort(uint8_t dev_addr, uint8_t ep_addr)
+{
+  // control pipe stages are tracked by usbh
+  TU_VERIFY( tuh_device_is_configured(dev_addr) && tu_edpt_number(ep_addr) != 0 );
+  return hcd_edpt_abort(_usbh_devices[dev_addr].rhport, dev_addr, ep_addr);
+}
+
+#if CFG_TUH_STATS
+bool tuh_stats_get(uint8_t dev_addr, uint8_t ep_addr, tuh_stats_t* stats)
+{
+  TU_VERIFY( dev_addr <= CFG_TUSB_HOST_DEVICE_MAX && tu_edpt_number(ep_addr) < 8 );
+
+  usbh_device_t const* dev = &_usbh_devices[dev_addr];
+  uint8_t const dir = tu_edpt_number(ep_addr) ? tu_edpt_dir(ep_addr) : 0;
+
+  // counters are updated in isr
+  hcd_int_disable(dev->rhport);
+  *stats = dev->stats[tu_edpt_number(ep_addr)][dir];
+  hcd_int_enable(dev->rhport);
 
   return true;
 }
 
+void tuh_stats_reset(uint8_t dev_addr)
+{
+  TU_VERIFY( dev_addr <= CFG_TUSB_HOST_DEVICE_MAX, );
+
+  usbh_device_t* dev = &_usbh_devices[dev_addr];
+
+  hcd_int_disable(dev->rhport);
+  tu_memclr(dev->stats, sizeof(dev->stats));
+  hcd_int_enable(dev->rhport);
+}
+
+static void stats_update(usbh_device_t* dev, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes)
+{
+  uint8_t const dir = tu_edpt_number(ep_addr) ? tu_edpt_dir(ep_addr) : 0;
+  tuh_stats_t* stats = &dev->stats[tu_edpt_number(ep_addr)][dir];
+
+  stats->xfer_count++;
+  stats->bytes += xferred_bytes;
+
+  switch ( result )
+  {
+    case XFER_RESULT_FAILED : stats->error_count++;   break;
+    case XFER_RESULT_STALLED: stats->stall_count++;   break;
+    case XFER_RESULT_TIMEOUT: stats->timeout_count++; break;
+    default: break;
+  }
+}
+#endif
+
+void tuh_period_usage_get(uint8_t rhport, tuh_period_usage_t* usage, uint16_t load[], uint16_t count)
+{
+  hcd_period_usage(rhport, usage, load, count);
+}
+
+bool usbh_control_xfer (uint8_t dev_addr, tusb_control_request_t* request, uint8_t* data)
+{
+  usbh_device_t* dev = &_usbh_devices[dev_addr];
+
+  TU_ASSERT(osal_mutex_lock(dev->control.mutex_hdl, OSAL_TIMEOUT_NORMAL));
+
+  bool is_ok = control_xfer_start(dev_addr, request, data, NULL);
+  if ( is_ok )
+  {
+    is_ok = osal_semaphore_wait(dev->control.sem_hdl, OSAL_TIMEOUT_NORMAL);
+
+    // abandon the transfer on timeout so that pipe can be reused
+    if ( !is_ok )
+    {
+      hcd_edpt_abort(dev->rhport, dev_addr, 0);
+      dev->control.stage = CONTROL_STAGE_IDLE;
+    }
+  }
+
+  osal_mutex_unlock(dev->control.mutex_hdl);
+
+  // stalled, failed or timed out by HCD
+  TU_VERIFY(is_ok);
+  return XFER_RESULT_SUCCESS == dev->control.pipe_status;
+}
+
 tusb_error_t usbh_pipe_control_open(uint8_t dev_addr, uint8_t max_packet_size)
 {
   osal_semaphore_reset( _usbh_devices[dev_addr].control.sem_hdl );
@@ -212,6 +585,7 @@ tusb_error_t usbh_pipe_control_open(uint8_t dev_addr, uint8_t max_packet_size)
   };
 
   hcd_edpt_open(_usbh_devices[dev_addr].rhport, dev_addr, &ep0_desc);
+  hcd_edpt_timeout(_usbh_devices[dev_addr].rhport, dev_addr, 0, CFG_TUH_CONTROL_TIMEOUT_MS);
 
   return TUSB_ERROR_NONE;
 }
@@ -224,25 +598,40 @@ void hcd_event_xfer_complete(uint8_t dev_addr, uint8_t ep_addr, xfer_result_t ev
 {
   usbh_device_t* dev = &_usbh_devices[ dev_addr ];
 
+#if CFG_TUH_STATS
+  stats_update(dev, ep_addr, event, xferred_bytes);
+#endif
+
   if (0 == tu_edpt_number(ep_addr))
   {
-    dev->control.pipe_status   = event;
-//    usbh_devices[ pipe_hdl.dev_addr ].control.xferred_bytes = xferred_bytes; not yet neccessary
-    osal_semaphore_post( dev->control.sem_hdl, true );
+    control_xfer_isr(dev_addr, event, xferred_bytes);
   }
   else
   {
     uint8_t drv_id = dev->ep2drv[tu_edpt_number(ep_addr)][tu_edpt_dir(ep_addr)];
-    TU_ASSERT(drv_id < USBH_CLASS_DRIVER_COUNT, );
 
-    if (usbh_class_drivers[drv_id].isr)
+    if ( drv_id != USBH_ISO_APP )
     {
-      usbh_class_drivers[drv_id].isr(dev_addr, ep_addr, event, xferred_bytes);
+      TU_ASSERT(drv_id < USBH_CLASS_DRIVER_COUNT, );
+
+      host_class_driver_t const * driver = &usbh_class_drivers[drv_id];
+
+      // fast path of driver, the rest is deferred to tuh_task()
+      if ( driver->xfer_isr_cb && driver->xfer_isr_cb(dev_addr, ep_addr, event, xferred_bytes) ) return;
     }
-    else
+
+    hcd_event_t event_xfer =
     {
-      TU_BREAKPOINT(); // something wrong, no one claims the isr's source
-    }
+      .rhport   = dev->rhport,
+      .event_id = HCD_EVENT_XFER_COMPLETE
+    };
+
+    event_xfer.xfer_complete.dev_addr = dev_addr;
+    event_xfer.xfer_complete.ep_addr  = ep_addr;
+    event_xfer.xfer_complete.result   = (uint8_t) event;
+    event_xfer.xfer_complete.len      = xferred_bytes;
+
+    hcd_event_handler(&event_xfer, true);
   }
 }
 
@@ -260,14 +649,75 @@ void hcd_event_device_attach(uint8_t rhport)
   hcd_event_handler(&event, true);
 }
 
+void usbh_edpt_prio(uint8_t dev_addr, uint8_t ep_addr, bool prio)
+{
+  uint16_t const mask = (uint16_t) TU_BIT(tu_edpt_number(ep_addr) + 8*tu_edpt_dir(ep_addr));
+  usbh_device_t* dev = &_usbh_devices[dev_addr];
+
+  if ( prio ) dev->ep_prio |= mask;
+  else        dev->ep_prio &= (uint16_t) ~mask;
+}
+
+bool usbh_iso_edpt_open(uint8_t dev_addr, tusb_desc_endpoint_t const * ep_desc)
+{
+  uint8_t const ep_addr = ep_desc->bEndpointAddress;
+  TU_VERIFY( ep_desc->bmAttributes.xfer == TUSB_XFER_ISOCHRONOUS && tu_edpt_number(ep_addr) < 8 );
+
+  usbh_device_t* dev = &_usbh_devices[dev_addr];
+  TU_VERIFY( hcd_edpt_open(dev->rhport, dev_addr, ep_desc) );
+  dev->ep_iso |= (uint16_t) TU_BIT(tu_edpt_number(ep_addr) + 8*tu_edpt_dir(ep_addr));
+
+  return true;
+}
+
+bool usbh_iso_edpt_close(uint8_t dev_addr, uint8_t ep_addr)
+{
+  usbh_device_t* dev = &_usbh_devices[dev_addr];
+  dev->ep_iso &= (uint16_t) ~TU_BIT(tu_edpt_number(ep_addr) + 8*tu_edpt_dir(ep_addr));
+
+  return hcd_edpt_iso_close(dev->rhport, dev_addr, ep_addr);
+}
+
+uint8_t const* usbh_config_desc_end(void)
+{
+  return _enum_desc_end;
+}
+
+#if CFG_TUH_TASK_PRIO_QUEUE_SZ
+static bool is_prio_event(hcd_event_t const* event)
+{
+  if ( event->event_id != HCD_EVENT_XFER_COMPLETE ) return false;
+
+  uint8_t const ep_addr = event->xfer_complete.ep_addr;
+  return tu_bit_test(_usbh_devices[event->xfer_complete.dev_addr].ep_prio, tu_edpt_number(ep_addr) + 8*tu_edpt_dir(ep_addr));
+}
+
+// Event goes to the other queue if this one is full, it should hold a completion of each prio endpoint
+static bool queue_prio_event(hcd_event_t const* event, bool in_isr)
+{
+  if ( !in_isr ) hcd_int_disable(event->rhport);
+  bool const success = tu_fifo_write(&_usbh_prio_ff, event);
+  if ( !in_isr ) hcd_int_enable(event->rhport);
+
+  TU_VERIFY(success);
+
+#if CFG_TUSB_OS != OPT_OS_NONE
+  // wake up tuh_task blocked on event queue, it may fail if task is already busy draining it
+  hcd_event_t const wakeup = { .rhport = event->rhport, .event_id = USBH_EVENT_WAKEUP };
+  osal_queue_send(_usbh_q, &wakeup, in_isr);
+#endif
+
+  return true;
+}
+#endif
+
 void hcd_event_handler(hcd_event_t const* event, bool in_isr)
 {
-  switch (event->event_id)
-  {
-    default:
-      osal_queue_send(_usbh_q, event, in_isr);
-    break;
-  }
+#if CFG_TUH_TASK_PRIO_QUEUE_SZ
+  if ( is_prio_event(event) && queue_prio_event(event, in_isr) ) return;
+#endif
+
+  osal_queue_send(_usbh_q, event, in_isr);
 }
 
 void hcd_event_device_remove(uint8_t hostid)
@@ -285,302 +735,627 @@ void hcd_event_device_remove(uint8_t hostid)
 }
 
 
+// Close class drivers and pipes of a device, abort its enumeration if in progress
+static void usbh_device_close(uint8_t dev_addr)
+{
+  usbh_device_t* dev = &_usbh_devices[dev_addr];
+
+  // Invoke callback before close driver, only if mounted i.e drivers are configured
+  if (tuh_umount_cb && dev->state == TUSB_DEVICE_STATE_CONFIGURED && dev->enum_stage == ENUM_IDLE) tuh_umount_cb(dev_addr);
+
+  // Close class driver
+  for (uint8_t drv_id = 0; drv_id < USBH_CLASS_DRIVER_COUNT; drv_id++) usbh_class_drivers[drv_id].close(dev_addr);
+
+  memset(dev->itf2drv, 0xff, sizeof(dev->itf2drv)); // invalid mapping
+  memset(dev->ep2drv , 0xff, sizeof(dev->ep2drv )); // invalid mapping
+  dev->ep_prio = 0;
+  dev->ep_iso  = 0;
+
+  hcd_device_close(dev->rhport, dev_addr);
+
+#if CFG_TUH_STATS
+  tu_memclr(dev->stats, sizeof(dev->stats));
+#endif
+
+  // drop pending control transfer, its callback is not invoked
+  dev->control.stage       = CONTROL_STAGE_IDLE;
+  dev->control.complete_cb = NULL;
+
+  dev->state      = TUSB_DEVICE_STATE_UNPLUG;
+  dev->enum_stage = ENUM_IDLE;
+  dev->delay_cb   = NULL;
+
+  if ( _enum_config_addr == dev_addr )
+  {
+    _enum_config_addr = 0;
+    tu_varclr(&_enum_stream);
+  }
+}
+
 // a device unplugged on hostid, hub_addr, hub_port
 // return true if found and unmounted device, false if cannot find
 static void usbh_device_unplugged(uint8_t rhport, uint8_t hub_addr, uint8_t hub_port)
 {
+  usbh_device_t* dev0 = &_usbh_devices[0];
+
+  // device being addressed
+  if ( dev0->enum_stage != ENUM_IDLE && dev0->rhport == rhport &&
+       (hub_addr == 0 || dev0->hub_addr == hub_addr) &&
+       (hub_port == 0 || dev0->hub_port == hub_port) )
+  {
+    enum_address0_done();
+  }
+
   //------------- find the all devices (star-network) under port that is unplugged -------------//
-  for (uint8_t dev_addr = 0; dev_addr <= CFG_TUSB_HOST_DEVICE_MAX; dev_addr ++)
+  for (uint8_t dev_addr = 1; dev_addr <= CFG_TUSB_HOST_DEVICE_MAX; dev_addr ++)
   {
     usbh_device_t* dev = &_usbh_devices[dev_addr];
 
-    // TODO Hub multiple level
     if (dev->rhport == rhport   &&
         (hub_addr == 0 || dev->hub_addr == hub_addr) && // hub_addr == 0 & hub_port == 0 means roothub
         (hub_port == 0 || dev->hub_port == hub_port) &&
         dev->state    != TUSB_DEVICE_STATE_UNPLUG)
     {
-      // Invoke callback before close driver
-      if (tuh_umount_cb) tuh_umount_cb(dev_addr);
+      usbh_device_close(dev_addr);
+
+      #if CFG_TUH_HUB
+      // devices behind an unplugged hub
+      if ( hub_addr != 0 ) usbh_device_unplugged(rhport, dev_addr, 0);
+      #endif
+    }
+  }
 
-      // Close class driver
-      for (uint8_t drv_id = 0; drv_id < USBH_CLASS_DRIVER_COUNT; drv_id++) usbh_class_drivers[drv_id].close(dev_addr);
+  // addressed device waiting for configuration may take over
+  enum_config_next();
+}
 
-      memset(dev->itf2drv, 0xff, sizeof(dev->itf2drv)); // invalid mapping
-      memset(dev->ep2drv , 0xff, sizeof(dev->ep2drv )); // invalid mapping
+#if TUSB_OPT_DUAL_ROLE
+bool usbh_role_start(void)
+{
+  TU_ASSERT(hcd_init());
+  hcd_int_enable(TUH_OPT_RHPORT);
 
-      hcd_device_close(rhport, dev_addr);
+  return true;
+}
 
-      dev->state = TUSB_DEVICE_STATE_UNPLUG;
-    }
-  }
+void usbh_role_stop(void)
+{
+  // same as roothub unplugged, endpoints are closed while controller is still in host mode
+  usbh_device_unplugged(TUH_OPT_RHPORT, 0, 0);
+  hcd_int_disable(TUH_OPT_RHPORT);
+
+  // events of the controller are stale
+  hcd_event_t event;
+  while ( osal_queue_receive(_usbh_q, &event, OSAL_TIMEOUT_NOTIMEOUT) ) {}
+#if CFG_TUH_TASK_PRIO_QUEUE_SZ
+  tu_fifo_clear(&_usbh_prio_ff);
+#endif
 }
+#endif
 
 //--------------------------------------------------------------------+
-// ENUMERATION TASK
+// ENUMERATION
+// Reset and Set Address are performed by one device at a time since only one can be at address 0.
+// Once addressed, a device is configured on its own control pipe, overlapping with the next
+// device's address stage. Configuration shares the enum buffer, thus is one device at a time as well.
 //--------------------------------------------------------------------+
-
-bool enum_task(hcd_event_t* event)
-{
-  enum {
+enum {
 #if 1
-    // FIXME ohci LPC1769 xpresso + debugging to have 1st control xfer to work, some kind of timing or ohci driver issue !!!
-    POWER_STABLE_DELAY = 100,
-    RESET_DELAY        = 500
+  // FIXME ohci LPC1769 xpresso + debugging to have 1st control xfer to work, some kind of timing or ohci driver issue !!!
+  POWER_STABLE_DELAY = 100,
+  RESET_DELAY        = 500,
 #else
-    POWER_STABLE_DELAY = 500,
-    RESET_DELAY        = 200, // USB specs say only 50ms but many devices require much longer
+  POWER_STABLE_DELAY = 500,
+  RESET_DELAY        = 200, // USB specs say only 50ms but many devices require much longer
 #endif
-  };
+  RESET_RECOVERY_DELAY = 10
+};
 
-  // for OSAL_NONE local variable won't retain value after blocking service sem_wait/queue_recv
-  static uint8_t configure_selected = 1; // TODO move
+static void enum_control_complete(uint8_t dev_addr, tusb_control_request_t const * request, xfer_result_t result);
 
+// Address 0 is free: close its pipe and let hub reset its next port
+static void enum_address0_done(void)
+{
   usbh_device_t* dev0 = &_usbh_devices[0];
-  tusb_control_request_t request;
 
-  dev0->rhport  = event->rhport; // TODO refractor integrate to device_pool
-  dev0->hub_addr = event->attach.hub_addr;
-  dev0->hub_port = event->attach.hub_port;
-  dev0->state    = TUSB_DEVICE_STATE_UNPLUG;
+  hcd_device_close(dev0->rhport, 0);
 
-  //------------- connected/disconnected directly with roothub -------------//
-  if ( dev0->hub_addr == 0)
-  {
-    if( hcd_port_connect_status(dev0->rhport) )
-    {
-      // connection event
-      osal_task_delay(POWER_STABLE_DELAY); // wait until device is stable. Increase this if the first 8 bytes is failed to get
+  dev0->control.stage       = CONTROL_STAGE_IDLE;
+  dev0->control.complete_cb = NULL;
+  dev0->enum_stage          = ENUM_IDLE;
+  dev0->delay_cb            = NULL;
 
-      // exit if device unplugged while delaying
-      if ( !hcd_port_connect_status(dev0->rhport) ) return true;
+  #if CFG_TUH_HUB
+  if ( dev0->hub_addr ) hub_enum_complete(dev0->hub_addr, dev0->hub_port);
+  #endif
+}
 
-      hcd_port_reset( dev0->rhport ); // port must be reset to have correct speed operation
-      osal_task_delay(RESET_DELAY);
+static bool enum_request(uint8_t dev_addr, uint8_t stage, tusb_control_request_t const * request, uint8_t* buffer)
+{
+  _usbh_devices[dev_addr].enum_stage = stage;
+  return tuh_control_xfer(dev_addr, request, buffer, enum_control_complete);
+}
 
-      dev0->speed = hcd_port_speed_get( dev0->rhport );
-    }
-    else
-    {
-      // disconnection event
-      usbh_device_unplugged(dev0->rhport, 0, 0);
-      return true; // restart task
-    }
-  }
-  #if CFG_TUH_HUB
-  //------------- connected/disconnected via hub -------------//
-  else
-  {
-    //------------- Get Port Status -------------//
-    request = (tusb_control_request_t ) {
-          .bmRequestType_bit = { .recipient = TUSB_REQ_RCPT_OTHER, .type = TUSB_REQ_TYPE_CLASS, .direction = TUSB_DIR_IN },
-          .bRequest = HUB_REQUEST_GET_STATUS,
-          .wValue = 0,
-          .wIndex = dev0->hub_port,
-          .wLength = 4
-    };
-    // TODO hub refractor
-    TU_VERIFY_HDLR( usbh_control_xfer( dev0->hub_addr, &request, _usbh_ctrl_buf ), hub_status_pipe_queue( dev0->hub_addr) );
-
-    // Acknowledge Port Connection Change
-    hub_port_clear_feature_subtask(dev0->hub_addr, dev0->hub_port, HUB_FEATURE_PORT_CONNECTION_CHANGE);
-
-    hub_port_status_response_t * p_port_status;
-    p_port_status = ((hub_port_status_response_t *) _usbh_ctrl_buf);
-
-    if ( ! p_port_status->status_change.connect_status )   return true; // only handle connection change
-
-    if ( ! p_port_status->status_current.connect_status )
-    {
-      // Disconnection event
-      usbh_device_unplugged(dev0->rhport, dev0->hub_addr, dev0->hub_port);
-
-      (void) hub_status_pipe_queue( dev0->hub_addr ); // done with hub, waiting for next data on status pipe
-      return true; // restart task
-    }
-    else
-    {
-      // Connection Event
-      TU_VERIFY_HDLR(hub_port_reset_subtask(dev0->hub_addr, dev0->hub_port),
-                     hub_status_pipe_queue( dev0->hub_addr) ); // TODO hub refractor
-
-      dev0->speed = hub_port_get_speed();
-
-      // Acknowledge Port Reset Change
-      hub_port_clear_feature_subtask(dev0->hub_addr, dev0->hub_port, HUB_FEATURE_PORT_RESET_CHANGE);
-    }
-  }
-  #endif
-
-  TU_ASSERT_ERR( usbh_pipe_control_open(0, 8) );
-
-  //------------- Get first 8 bytes of device descriptor to get Control Endpoint Size -------------//
-  request = (tusb_control_request_t ) {
+static bool enum_get_descriptor(uint8_t dev_addr, uint8_t stage, uint16_t desc_type_index, uint16_t len, uint8_t* buffer)
+{
+  tusb_control_request_t const request = {
         .bmRequestType_bit = { .recipient = TUSB_REQ_RCPT_DEVICE, .type = TUSB_REQ_TYPE_STANDARD, .direction = TUSB_DIR_IN },
         .bRequest = TUSB_REQ_GET_DESCRIPTOR,
-        .wValue = TUSB_DESC_DEVICE << 8,
+        .wValue = desc_type_index,
         .wIndex = 0,
-        .wLength = 8
+        .wLength = len
   };
-  bool is_ok = usbh_control_xfer(0, &request, _usbh_ctrl_buf);
 
-  //------------- Reset device again before Set Address -------------//
-  if (dev0->hub_addr == 0)
-  {
-    // connected directly to roothub
-    TU_ASSERT(is_ok); // TODO some slow device is observed to fail the very fist controller xfer, can try more times
-    hcd_port_reset( dev0->rhport ); // reset port after 8 byte descriptor
-    osal_task_delay(RESET_DELAY);
-  }
-  #if CFG_TUH_HUB
-  else
-  {
-    // connected via a hub
-    TU_VERIFY_HDLR(is_ok, hub_status_pipe_queue( dev0->hub_addr) ); // TODO hub refractor
+  return enum_request(dev_addr, stage, &request, buffer);
+}
 
-    if ( hub_port_reset_subtask(dev0->hub_addr, dev0->hub_port) )
-    {
-      // Acknowledge Port Reset Change if Reset Successful
-      hub_port_clear_feature_subtask(dev0->hub_addr, dev0->hub_port, HUB_FEATURE_PORT_RESET_CHANGE);
-    }
+static void enum_delay_complete(uint8_t dev_addr)
+{
+  enum_control_complete(dev_addr, NULL, XFER_RESULT_SUCCESS);
+}
 
-    (void) hub_status_pipe_queue( dev0->hub_addr ); // done with hub, waiting for next data on status pipe
-  }
-  #endif
+// Address 0 waits without blocking tuh_task(), stage is advanced once delay is elapsed
+static bool enum_delay(uint8_t stage, uint16_t ms)
+{
+  _usbh_devices[0].enum_stage = stage;
+  return usbh_delay(0, ms, enum_delay_complete);
+}
 
-  //------------- Set new address -------------//
+//------------- Get first 8 bytes of device descriptor to get Control Endpoint Size -------------//
+static bool enum_get_device_desc_8(void)
+{
+  TU_ASSERT( TUSB_ERROR_NONE == usbh_pipe_control_open(0, 8) );
+  return enum_get_descriptor(0, ENUM_GET_DEVICE_DESC_8, TUSB_DESC_DEVICE << 8, 8, _usbh_dev0_buf);
+}
+
+static bool enum_set_address(void)
+{
   uint8_t const new_addr = get_new_address();
   TU_ASSERT(new_addr <= CFG_TUSB_HOST_DEVICE_MAX); // TODO notify application we reach max devices
 
-  request = (tusb_control_request_t ) {
+  tusb_control_request_t const addr_request = {
         .bmRequestType_bit = { .recipient = TUSB_REQ_RCPT_DEVICE, .type = TUSB_REQ_TYPE_STANDARD, .direction = TUSB_DIR_OUT },
         .bRequest = TUSB_REQ_SET_ADDRESS,
         .wValue = new_addr,
         .wIndex = 0,
         .wLength = 0
   };
-  TU_ASSERT(usbh_control_xfer(0, &request, NULL));
-
-  //------------- update port info & close control pipe of addr0 -------------//
-  usbh_device_t* new_dev = &_usbh_devices[new_addr];
-  new_dev->rhport  = dev0->rhport;
-  new_dev->hub_addr = dev0->hub_addr;
-  new_dev->hub_port = dev0->hub_port;
-  new_dev->speed    = dev0->speed;
-
-  hcd_device_close(dev0->rhport, 0); // close device 0
-  dev0->state = TUSB_DEVICE_STATE_UNPLUG;
-
-  // open control pipe for new address
-  TU_ASSERT_ERR ( usbh_pipe_control_open(new_addr, ((tusb_desc_device_t*) _usbh_ctrl_buf)->bMaxPacketSize0 ) );
-
-  //------------- Get full device descriptor -------------//
-  request = (tusb_control_request_t ) {
-        .bmRequestType_bit = { .recipient = TUSB_REQ_RCPT_DEVICE, .type = TUSB_REQ_TYPE_STANDARD, .direction = TUSB_DIR_IN },
-        .bRequest = TUSB_REQ_GET_DESCRIPTOR,
-        .wValue = TUSB_DESC_DEVICE << 8,
-        .wIndex = 0,
-        .wLength = 18
-  };
-  TU_ASSERT(usbh_control_xfer(new_addr, &request, _usbh_ctrl_buf));
+  return enum_request(0, ENUM_SET_ADDRESS, &addr_request, NULL);
+}
 
-  // update device info  TODO alignment issue
-  new_dev->vendor_id       = ((tusb_desc_device_t*) _usbh_ctrl_buf)->idVendor;
-  new_dev->product_id      = ((tusb_desc_device_t*) _usbh_ctrl_buf)->idProduct;
-  new_dev->configure_count = ((tusb_desc_device_t*) _usbh_ctrl_buf)->bNumConfigurations;
+// Start configuring the next addressed device if enum buffer is free
+static void enum_config_next(void)
+{
+  if ( _enum_config_addr ) return;
 
-  configure_selected = get_configure_number_for_device((tusb_desc_device_t*) _usbh_ctrl_buf);
-  TU_ASSERT(configure_selected <= new_dev->configure_count); // TODO notify application when invalid configuration
+  for (uint8_t dev_addr = 1; dev_addr <= CFG_TUSB_HOST_DEVICE_MAX; dev_addr++)
+  {
+    usbh_device_t* dev = &_usbh_devices[dev_addr];
 
-  //------------- Get 9 bytes of configuration descriptor -------------//
-  request = (tusb_control_request_t ) {
-        .bmRequestType_bit = { .recipient = TUSB_REQ_RCPT_DEVICE, .type = TUSB_REQ_TYPE_STANDARD, .direction = TUSB_DIR_IN },
-        .bRequest = TUSB_REQ_GET_DESCRIPTOR,
-        .wValue = (TUSB_DESC_CONFIGURATION << 8) | (configure_selected - 1),
-        .wIndex = 0,
-        .wLength = 9
-  };
-  TU_ASSERT( usbh_control_xfer(new_addr, &request, _usbh_ctrl_buf));
+    if ( dev->state == TUSB_DEVICE_STATE_ADDRESSED && dev->enum_stage == ENUM_CONFIG_WAIT )
+    {
+      _enum_config_addr = dev_addr;
 
-  // TODO not enough buffer to hold configuration descriptor
-  TU_ASSERT( CFG_TUSB_HOST_ENUM_BUFFER_SIZE >= ((tusb_desc_configuration_t*)_usbh_ctrl_buf)->wTotalLength );
+      //------------- Get full device descriptor -------------//
+      if ( enum_get_descriptor(dev_addr, ENUM_GET_DEVICE_DESC, TUSB_DESC_DEVICE << 8, 18, _usbh_ctrl_buf) ) return;
 
-  //------------- Get full configuration descriptor -------------//
-  request.wLength = ((tusb_desc_configuration_t*)_usbh_ctrl_buf)->wTotalLength; // full length
-  TU_ASSERT( usbh_control_xfer( new_addr, &request, _usbh_ctrl_buf ) );
+      usbh_device_close(dev_addr);
+    }
+  }
+}
 
+// Full configuration descriptor is in enum buffer
+static bool enum_set_config(uint8_t dev_addr)
+{
   // update configuration info
-  new_dev->interface_count = ((tusb_desc_configuration_t*) _usbh_ctrl_buf)->bNumInterfaces;
+  _usbh_devices[dev_addr].interface_count = ((tusb_desc_configuration_t*) _usbh_ctrl_buf)->bNumInterfaces;
 
   //------------- Set Configure -------------//
-  request = (tusb_control_request_t ) {
+  tusb_control_request_t const request = {
         .bmRequestType_bit = { .recipient = TUSB_REQ_RCPT_DEVICE, .type = TUSB_REQ_TYPE_STANDARD, .direction = TUSB_DIR_OUT },
         .bRequest = TUSB_REQ_SET_CONFIGURATION,
-        .wValue = configure_selected,
+        .wValue = _enum_config_number,
         .wIndex = 0,
         .wLength = 0
   };
-  TU_ASSERT(usbh_control_xfer( new_addr, &request, NULL ));
+  return enum_request(dev_addr, ENUM_SET_CONFIG, &request, NULL);
+}
+
+#if CFG_TUH_ENUM_CACHE
+static enum_cache_t* enum_cache_find(tusb_desc_device_t const * desc_device, uint8_t config_num)
+{
+  for (uint8_t i = 0; i < CFG_TUH_ENUM_CACHE; i++)
+  {
+    enum_cache_t* entry = &_enum_cache[i];
+
+    if ( entry->total_len && entry->vendor_id == desc_device->idVendor && entry->product_id == desc_device->idProduct &&
+         entry->bcd_device == desc_device->bcdDevice && entry->config_num == config_num )
+    {
+      return entry;
+    }
+  }
+
+  return NULL;
+}
+
+// Full configuration descriptor is read, device descriptor info is already in dev
+static void enum_cache_store(usbh_device_t const * dev)
+{
+  uint16_t const total_len = ((tusb_desc_configuration_t*) _usbh_ctrl_buf)->wTotalLength;
+  if ( total_len > CFG_TUH_ENUM_CACHE_DESC_SIZE ) return;
 
-  new_dev->state = TUSB_DEVICE_STATE_CONFIGURED;
+  // stale entry of the same device is overwritten, otherwise replace in round robin
+  enum_cache_t* entry = _enum_cache_hit;
+  if ( !entry )
+  {
+    entry = &_enum_cache[_enum_cache_victim];
+    _enum_cache_victim = (uint8_t) ((_enum_cache_victim + 1) % CFG_TUH_ENUM_CACHE);
+  }
 
-  //------------- TODO Get String Descriptors -------------//
+  entry->vendor_id  = dev->vendor_id;
+  entry->product_id = dev->product_id;
+  entry->bcd_device = dev->bcd_device;
+  entry->config_num = _enum_config_number;
+  entry->total_len  = total_len;
+  memcpy(entry->desc, _usbh_ctrl_buf, total_len);
+}
+#endif
 
-  //------------- parse configuration & install drivers -------------//
-  uint8_t const* p_desc = _usbh_ctrl_buf + sizeof(tusb_desc_configuration_t);
+// Parse descriptors from p_desc up to desc_end & install drivers, return first unparsed descriptor or NULL
+// on error. Unless final, an interface is only opened once buffer can't hold more of the descriptor, so
+// that driver sees as much of its function as possible, incomplete descriptor is left as well
+static uint8_t const* enum_open_drivers(uint8_t dev_addr, uint8_t const* p_desc, uint8_t const* desc_end, bool final)
+{
+  usbh_device_t* new_dev = &_usbh_devices[dev_addr];
+  bool const full = (desc_end + ENUM_STREAM_ALIGN > _usbh_ctrl_buf + CFG_TUSB_HOST_ENUM_BUFFER_SIZE);
+
+  _enum_desc_end = desc_end;
 
   // parse each interfaces
-  while( p_desc < _usbh_ctrl_buf + ((tusb_desc_configuration_t*)_usbh_ctrl_buf)->wTotalLength )
+  while( p_desc < desc_end )
   {
+    uint16_t const avail = (uint16_t) (desc_end - p_desc);
+    if ( avail < 2 || tu_desc_len(p_desc) > avail ) break;
+    TU_ASSERT( tu_desc_len(p_desc) >= 2, NULL );
+
     // skip until we see interface descriptor
     if ( TUSB_DESC_INTERFACE != tu_desc_type(p_desc) )
     {
       p_desc = tu_desc_next(p_desc); // skip the descriptor, increase by the descriptor's length
     }else
     {
+      if ( !final && !(full && p_desc == _usbh_ctrl_buf) ) break;
+
       tusb_desc_interface_t* desc_itf = (tusb_desc_interface_t*) p_desc;
 
-      // Check if class is supported
+      // Interface number must not be used already TODO alternate interface
+      TU_ASSERT( desc_itf->bInterfaceNumber < TU_ARRAY_SIZE(new_dev->itf2drv), NULL );
+      if ( new_dev->itf2drv[desc_itf->bInterfaceNumber] != 0xff )
+      {
+        // with a streamed descriptor, rest of an interface received after its driver is opened
+        TU_ASSERT( _enum_stream.total_len, NULL );
+        p_desc = tu_desc_next(p_desc);
+        continue;
+      }
+
+      // Drivers of the class are tried in order, e.g CDC network before ACM
+      uint16_t itf_len = 0;
       uint8_t drv_id;
       for (drv_id = 0; drv_id < USBH_CLASS_DRIVER_COUNT; drv_id++)
       {
-        if ( usbh_class_drivers[drv_id].class_code == desc_itf->bInterfaceClass ) break;
+        if ( usbh_class_drivers[drv_id].class_code != desc_itf->bInterfaceClass ) continue;
+
+        itf_len = 0;
+        if ( usbh_class_drivers[drv_id].open(new_dev->rhport, dev_addr, desc_itf, &itf_len) )
+        {
+          new_dev->itf2drv[desc_itf->bInterfaceNumber] = drv_id;
+          mark_interface_endpoint(new_dev->ep2drv, p_desc, tu_min16(itf_len, avail), drv_id);
+          break;
+        }
       }
-      
-      if( drv_id >= USBH_CLASS_DRIVER_COUNT )
+
+      // driver may report length of an interface it does not open, otherwise only its descriptor is skipped
+      p_desc = (itf_len >= sizeof(tusb_desc_interface_t)) ? (p_desc + itf_len) : tu_desc_next(p_desc);
+
+      // rest of its descriptors is not received yet
+      if ( p_desc > desc_end )
       {
-        // skip unsupported class
-        p_desc = tu_desc_next(p_desc);
+        _enum_stream.skip = (uint16_t) (p_desc - desc_end);
+        p_desc = desc_end;
       }
-      else
+    }
+  }
+
+  return p_desc;
+}
+
+// Start receiving next chunk after unparsed descriptors
+static void enum_stream_next(uint8_t dev_addr)
+{
+  usbh_device_t* dev = &_usbh_devices[dev_addr];
+  uint16_t const remaining = (uint16_t) (_enum_stream.total_len - _enum_stream.received);
+  uint16_t const room = (uint16_t) (CFG_TUSB_HOST_ENUM_BUFFER_SIZE - _enum_stream.win_len);
+
+  _enum_stream.chunk = (remaining <= room) ? remaining : (uint16_t) (room & ~(ENUM_STREAM_ALIGN-1));
+
+  dev->control.stage = CONTROL_STAGE_DATA;
+  hcd_edpt_xfer(dev->rhport, dev_addr, tu_edpt_addr(0, TUSB_DIR_IN), _usbh_ctrl_buf + _enum_stream.win_len, _enum_stream.chunk);
+}
+
+// Parse a received chunk, keeping unparsed descriptors at start of buffer for the next one
+static bool enum_stream_data(uint8_t dev_addr, bool final)
+{
+  uint8_t* chunk = _usbh_ctrl_buf + _enum_stream.win_len;
+  uint16_t len = _enum_stream.xferred;
+
+  _enum_stream.received = (uint16_t) (_enum_stream.received + len);
+  _enum_stream.chunk = 0;
+
+  // remaining descriptors of an interface opened with previous chunk
+  uint16_t const drop = tu_min16(len, _enum_stream.skip);
+  _enum_stream.skip = (uint16_t) (_enum_stream.skip - drop);
+  len = (uint16_t) (len - drop);
+  memmove(chunk, chunk + drop, len);
+
+  uint8_t const* desc_end = chunk + len;
+  while (1)
+  {
+    uint8_t const* p_desc = enum_open_drivers(dev_addr, _usbh_ctrl_buf, desc_end, final);
+    TU_ASSERT(p_desc);
+
+    _enum_stream.win_len = (uint16_t) (desc_end - p_desc);
+    memmove(_usbh_ctrl_buf, p_desc, _enum_stream.win_len);
+    desc_end = _usbh_ctrl_buf + _enum_stream.win_len;
+
+    // parse again if an interface is now at start of full buffer
+    if ( final || p_desc == _usbh_ctrl_buf || _enum_stream.win_len + ENUM_STREAM_ALIGN <= CFG_TUSB_HOST_ENUM_BUFFER_SIZE ) break;
+  }
+
+  // no progress: a descriptor that can't fit with a chunk is dropped
+  if ( !final && _enum_stream.win_len + ENUM_STREAM_ALIGN > CFG_TUSB_HOST_ENUM_BUFFER_SIZE )
+  {
+    _enum_stream.skip    = (uint16_t) (tu_desc_len(_usbh_ctrl_buf) - _enum_stream.win_len);
+    _enum_stream.win_len = 0;
+  }
+
+  return true;
+}
+
+// Let drivers issue class requests of interfaces from itf_num on, one at a time. Device is mounted once all are done
+static void enum_config_drivers(uint8_t dev_addr, uint8_t itf_num)
+{
+  usbh_device_t* dev = &_usbh_devices[dev_addr];
+
+  for ( ; itf_num < TU_ARRAY_SIZE(dev->itf2drv); itf_num++)
+  {
+    uint8_t const drv_id = dev->itf2drv[itf_num];
+    if ( drv_id >= USBH_CLASS_DRIVER_COUNT || !usbh_class_drivers[drv_id].set_config ) continue;
+
+    // driver resumes enumeration with usbh_driver_set_config_complete()
+    if ( usbh_class_drivers[drv_id].set_config(dev_addr, itf_num) ) return;
+  }
+
+  dev->enum_stage   = ENUM_IDLE;
+  _enum_config_addr = 0;
+
+  if (tuh_mount_cb) tuh_mount_cb(dev_addr);
+
+  enum_config_next();
+}
+
+void usbh_driver_set_config_complete(uint8_t dev_addr, uint8_t itf_num)
+{
+  // skip if device is removed meanwhile
+  TU_VERIFY( _enum_config_addr == dev_addr && _usbh_devices[dev_addr].enum_stage == ENUM_CONFIG_DRIVERS, );
+  enum_config_drivers(dev_addr, (uint8_t) (itf_num + 1));
+}
+
+// Advance enumeration of dev_addr when request (NULL for delay) of its current stage succeeds
+static bool enum_stage_complete(uint8_t dev_addr, tusb_control_request_t const * request)
+{
+  usbh_device_t* dev = &_usbh_devices[dev_addr];
+
+  switch ( dev->enum_stage )
+  {
+    //------------- Address 0 -------------//
+    case ENUM_POWER_STABLE_DELAY:
+      // exit if device unplugged while delaying
+      TU_VERIFY( hcd_port_connect_status(dev->rhport) );
+
+      hcd_port_reset( dev->rhport ); // port must be reset to have correct speed operation
+      return enum_delay(ENUM_RESET_DELAY, RESET_DELAY);
+
+    case ENUM_RESET_DELAY:
+      dev->speed = hcd_port_speed_get( dev->rhport );
+      return enum_get_device_desc_8();
+
+    #if CFG_TUH_HUB
+    case ENUM_RESET_RECOVERY_DELAY:
+      dev->speed = hub_port_get_speed(dev->hub_addr, dev->hub_port);
+      return enum_get_device_desc_8();
+    #endif
+
+    case ENUM_GET_DEVICE_DESC_8:
+      //------------- Reset device again before Set Address -------------//
+      // not for device connected via a hub since hub's control pipe is driven asynchronously by hub driver
+      if (dev->hub_addr == 0)
       {
-        // Interface number must not be used already TODO alternate interface
-        TU_ASSERT( new_dev->itf2drv[desc_itf->bInterfaceNumber] == 0xff );
-        new_dev->itf2drv[desc_itf->bInterfaceNumber] = drv_id;
+        hcd_port_reset( dev->rhport ); // reset port after 8 byte descriptor
+        return enum_delay(ENUM_RESET_AGAIN_DELAY, RESET_DELAY);
+      }
 
-        if (desc_itf->bInterfaceClass == TUSB_CLASS_HUB && new_dev->hub_addr != 0)
-        {
-          // TODO Attach hub to Hub is not currently supported
-          // skip this interface
-          p_desc = tu_desc_next(p_desc);
-        }
-        else
-        {
-          uint16_t itf_len = 0;
+      return enum_set_address();
 
-          if ( usbh_class_drivers[drv_id].open(new_dev->rhport, new_addr, desc_itf, &itf_len) )
-          {
-            mark_interface_endpoint(new_dev->ep2drv, p_desc, itf_len, drv_id);
-          }
+    case ENUM_RESET_AGAIN_DELAY:
+      return enum_set_address();
 
-          TU_ASSERT( itf_len >= sizeof(tusb_desc_interface_t) );
-          p_desc += itf_len;
-        }
+    case ENUM_SET_ADDRESS:
+    {
+      //------------- update port info & close control pipe of addr0 -------------//
+      uint8_t const new_addr = (uint8_t) request->wValue;
+      usbh_device_t* new_dev = &_usbh_devices[new_addr];
+
+      new_dev->rhport   = dev->rhport;
+      new_dev->hub_addr = dev->hub_addr;
+      new_dev->hub_port = dev->hub_port;
+      new_dev->speed    = dev->speed;
+      new_dev->state    = TUSB_DEVICE_STATE_ADDRESSED;
+
+      enum_address0_done();
+
+      // open control pipe for new address
+      if ( TUSB_ERROR_NONE != usbh_pipe_control_open(new_addr, ((tusb_desc_device_t*) _usbh_dev0_buf)->bMaxPacketSize0) )
+      {
+        usbh_device_close(new_addr);
+        return true; // address 0 is already released
+      }
+
+      new_dev->enum_stage = ENUM_CONFIG_WAIT;
+      enum_config_next();
+      return true;
+    }
+
+    //------------- New address -------------//
+    case ENUM_GET_DEVICE_DESC:
+    {
+      tusb_desc_device_t const * desc_device = (tusb_desc_device_t const *) _usbh_ctrl_buf;
+
+      // update device info  TODO alignment issue
+      dev->vendor_id       = desc_device->idVendor;
+      dev->product_id      = desc_device->idProduct;
+      dev->configure_count = desc_device->bNumConfigurations;
+      dev->bcd_device      = desc_device->bcdDevice;
+
+      _enum_config_number = get_configure_number_for_device((tusb_desc_device_t*) _usbh_ctrl_buf);
+      TU_ASSERT(_enum_config_number <= dev->configure_count); // TODO notify application when invalid configuration
+
+      #if CFG_TUH_ENUM_CACHE
+      _enum_cache_hit = enum_cache_find(desc_device, _enum_config_number);
+      #endif
+
+      //------------- Get 9 bytes of configuration descriptor -------------//
+      return enum_get_descriptor(dev_addr, ENUM_GET_CONFIG_DESC_9, (TUSB_DESC_CONFIGURATION << 8) | (_enum_config_number - 1),
+                                 9, _usbh_ctrl_buf);
+    }
+
+    case ENUM_GET_CONFIG_DESC_9:
+    {
+      uint16_t const total_len = ((tusb_desc_configuration_t*)_usbh_ctrl_buf)->wTotalLength;
+      TU_ASSERT( total_len >= sizeof(tusb_desc_configuration_t) );
+
+      // parsed while received after set config, there is no way to read it partially
+      if ( total_len > CFG_TUSB_HOST_ENUM_BUFFER_SIZE )
+      {
+        tu_varclr(&_enum_stream);
+        _enum_stream.total_len = total_len;
+        return enum_set_config(dev_addr);
+      }
+
+      #if CFG_TUH_ENUM_CACHE
+      // cached descriptor is valid if it has the same header
+      if ( _enum_cache_hit && _enum_cache_hit->total_len == total_len &&
+           0 == memcmp(_enum_cache_hit->desc, _usbh_ctrl_buf, sizeof(tusb_desc_configuration_t)) )
+      {
+        memcpy(_usbh_ctrl_buf, _enum_cache_hit->desc, total_len);
+        return enum_set_config(dev_addr);
+      }
+      #endif
+
+      //------------- Get full configuration descriptor -------------//
+      return enum_get_descriptor(dev_addr, ENUM_GET_CONFIG_DESC, (TUSB_DESC_CONFIGURATION << 8) | (_enum_config_number - 1),
+                                 total_len, _usbh_ctrl_buf);
+    }
+
+    case ENUM_GET_CONFIG_DESC:
+      #if CFG_TUH_ENUM_CACHE
+      enum_cache_store(dev);
+      #endif
+
+      return enum_set_config(dev_addr);
+
+    case ENUM_SET_CONFIG:
+      dev->state = TUSB_DEVICE_STATE_CONFIGURED;
+
+      //------------- TODO Get String Descriptors -------------//
+
+      if ( _enum_stream.total_len )
+      {
+        _enum_stream.chunk = (uint16_t) (CFG_TUSB_HOST_ENUM_BUFFER_SIZE & ~(ENUM_STREAM_ALIGN-1));
+        return enum_get_descriptor(dev_addr, ENUM_GET_CONFIG_DESC_STREAM, (TUSB_DESC_CONFIGURATION << 8) | (_enum_config_number - 1),
+                                   _enum_stream.total_len, _usbh_ctrl_buf);
       }
+
+      TU_ASSERT( enum_open_drivers(dev_addr, _usbh_ctrl_buf, _usbh_ctrl_buf + ((tusb_desc_configuration_t*) _usbh_ctrl_buf)->wTotalLength, true) );
+
+      // enum buffer is kept by this device until drivers are configured, their buffers are shared as well
+      dev->enum_stage = ENUM_CONFIG_DRIVERS;
+      enum_config_drivers(dev_addr, 0);
+      return true;
+
+    case ENUM_GET_CONFIG_DESC_STREAM:
+      TU_ASSERT( enum_stream_data(dev_addr, true) );
+      tu_varclr(&_enum_stream);
+
+      dev->enum_stage = ENUM_CONFIG_DRIVERS;
+      enum_config_drivers(dev_addr, 0);
+      return true;
+
+    default: return false;
+  }
+}
+
+static void enum_control_complete(uint8_t dev_addr, tusb_control_request_t const * request, xfer_result_t result)
+{
+  if ( (XFER_RESULT_SUCCESS == result) && enum_stage_complete(dev_addr, request) ) return;
+
+  // TODO some slow device is observed to fail the very fist controller xfer, can try more times
+  if ( dev_addr == 0 )
+  {
+    enum_address0_done();
+  }else
+  {
+    usbh_device_close(dev_addr);
+    enum_config_next();
+  }
+}
+
+// Attach/Remove event from roothub or hub driver
+static bool enum_task(hcd_event_t* event)
+{
+  usbh_device_t* dev0 = &_usbh_devices[0];
+
+  //------------- connected/disconnected directly with roothub -------------//
+  if ( event->attach.hub_addr == 0)
+  {
+    if( !hcd_port_connect_status(event->rhport) )
+    {
+      // disconnection event
+      usbh_device_unplugged(event->rhport, 0, 0);
+      return true; // restart task
     }
   }
+  #if CFG_TUH_HUB
+  //------------- connected/disconnected via hub -------------//
+  else if ( event->event_id == HCD_EVENT_DEVICE_REMOVE )
+  {
+    // hub driver has acknowledged port status: port is disconnected or its reset is complete
+    usbh_device_unplugged(event->rhport, event->attach.hub_addr, event->attach.hub_port);
+    return true; // restart task
+  }
+  #endif
+
+  // hub driver resets one port at a time, roothub is re-attached only after being removed
+  TU_ASSERT(dev0->enum_stage == ENUM_IDLE);
 
-  if (tuh_mount_cb) tuh_mount_cb(new_addr);
+  dev0->rhport   = event->rhport; // TODO refractor integrate to device_pool
+  dev0->hub_addr = event->attach.hub_addr;
+  dev0->hub_port = event->attach.hub_port;
+  dev0->state    = TUSB_DEVICE_STATE_UNPLUG;
+
+  // connection event: wait until device is stable. Increase this if the first 8 bytes is failed to get
+  bool is_ok = (dev0->hub_addr == 0) ? enum_delay(ENUM_POWER_STABLE_DELAY, POWER_STABLE_DELAY) :
+                                       enum_delay(ENUM_RESET_RECOVERY_DELAY, RESET_RECOVERY_DELAY);
+  TU_VERIFY_HDLR( is_ok, enum_address0_done() );
 
   return true;
 }
@@ -605,26 +1380,178 @@ bool enum_task(hcd_event_t* event)
     @endcode
  */
 void tuh_task(void)
+{
+  tuh_task_ext(OSAL_TIMEOUT_WAIT_FOREVER);
+}
+
+static inline bool task_runnable(void)
 {
   // Skip if stack is not initialized
-  if ( !tusb_inited() ) return;
+  if ( !tusb_inited() ) return false;
 
-  // Loop until there is no more events in the queue
-  while (1)
+#if TUSB_OPT_DUAL_ROLE
+  // initialized once host role is selected
+  if ( !tusb_role_inited(OPT_MODE_HOST) ) return false;
+#endif
+
+  return true;
+}
+
+// Process one event, waiting at most wait_ms for it. Return false if none
+static bool task_process_event(uint32_t wait_ms)
+{
+  hcd_event_t event;
+
+#if CFG_TUH_TASK_PRIO_QUEUE_SZ
+  // latency sensitive endpoints first
+  if ( !tu_fifo_read(&_usbh_prio_ff, &event) )
+#endif
+  if ( !osal_queue_receive(_usbh_q, &event, wait_ms) ) return false;
+
+  switch (event.event_id)
   {
-    hcd_event_t event;
-    if ( !osal_queue_receive(_usbh_q, &event) ) return;
+    case HCD_EVENT_DEVICE_ATTACH:
+    case HCD_EVENT_DEVICE_REMOVE:
+      enum_task(&event);
+    break;
 
-    switch (event.event_id)
+    case HCD_EVENT_XFER_COMPLETE:
     {
-      case HCD_EVENT_DEVICE_ATTACH:
-      case HCD_EVENT_DEVICE_REMOVE:
-        enum_task(&event);
-      break;
+      uint8_t const dev_addr = event.xfer_complete.dev_addr;
+      uint8_t const ep_addr  = event.xfer_complete.ep_addr;
+
+    #if CFG_TUH_HUB
+      // failed split transaction leaves its TT buffer busy. Interrupt endpoints are cleared as bulk,
+      // hub finds no such buffer (periodic transactions do not use them)
+      if ( (XFER_RESULT_FAILED == event.xfer_complete.result) && (_usbh_devices[dev_addr].speed != TUSB_SPEED_HIGH) &&
+           !tu_bit_test(_usbh_devices[dev_addr].ep_iso, (uint8_t) (tu_edpt_number(ep_addr) + 8*tu_edpt_dir(ep_addr))) )
+      {
+        uint8_t tt_port;
+        uint8_t const tt_hub = usbh_tt_hub(dev_addr, &tt_port);
+        if ( tt_hub ) (void) hub_tt_clear_buffer(tt_hub, dev_addr, ep_addr);
+      }
+    #endif
+
+      if ( 0 == tu_edpt_number(ep_addr) )
+      {
+        usbh_device_t* dev = &_usbh_devices[dev_addr];
+
+        // configuration descriptor streamed to enumeration, data stage goes on
+        if ( dev->control.stage == CONTROL_STAGE_DATA_CHUNK )
+        {
+          if ( dev_addr == _enum_config_addr && enum_stream_data(dev_addr, false) )
+          {
+            enum_stream_next(dev_addr);
+          }else
+          {
+            usbh_device_close(dev_addr);
+            enum_config_next();
+          }
+          break;
+        }
+
+        // skip if device is removed meanwhile
+        if ( dev->control.stage != CONTROL_STAGE_COMPLETE ) break;
+
+        // release pipe before callback so that it can submit next request
+        tusb_control_request_t const request = dev->control.request;
+        tuh_control_complete_cb_t const complete_cb = dev->control.complete_cb;
+        dev->control.stage = CONTROL_STAGE_IDLE;
 
-      default: break;
+        complete_cb(dev_addr, &request, (xfer_result_t) event.xfer_complete.result);
+        break;
+      }
+
+      // mapping is invalidated if device is removed meanwhile
+      uint8_t const drv_id = _usbh_devices[dev_addr].ep2drv[tu_edpt_number(ep_addr)][tu_edpt_dir(ep_addr)];
+      if ( drv_id < USBH_CLASS_DRIVER_COUNT && usbh_class_drivers[drv_id].xfer_cb )
+      {
+        usbh_class_drivers[drv_id].xfer_cb(dev_addr, ep_addr, (xfer_result_t) event.xfer_complete.result, event.xfer_complete.len);
+      }
+      else if ( drv_id == USBH_ISO_APP && tuh_iso_xfer_cb )
+      {
+        tuh_iso_xfer_cb(dev_addr, ep_addr, (xfer_result_t) event.xfer_complete.result, event.xfer_complete.len);
+      }
     }
+    break;
+
+    default: break;
   }
+
+  return true;
+}
+
+void tuh_task_ext(uint32_t timeout_ms)
+{
+  if ( !task_runnable() ) return;
+
+  // Loop until there is no more events in the queue, only the first one is waited for
+  for ( uint32_t wait_ms = delay_process(timeout_ms); task_process_event(wait_ms); wait_ms = OSAL_TIMEOUT_NOTIMEOUT ) {}
+}
+
+bool tuh_task_budget(uint32_t max_events, uint32_t max_time)
+{
+  if ( !task_runnable() ) return false;
+
+  uint32_t const start = CFG_TUH_TASK_TIMESTAMP();
+  (void) delay_process(OSAL_TIMEOUT_NOTIMEOUT);
+
+  // at least one event is processed per call so that queue is always drained eventually
+  for ( uint32_t count = 0; (max_events == 0) || (count < max_events); count++ )
+  {
+    if ( count && max_time && (CFG_TUH_TASK_TIMESTAMP() - start) >= max_time ) return true;
+    if ( !task_process_event(OSAL_TIMEOUT_NOTIMEOUT) ) return false;
+  }
+
+  return true;
+}
+
+bool tuh_task_wakeup(bool in_isr)
+{
+  hcd_event_t const event = { .rhport = TUH_OPT_RHPORT, .event_id = USBH_EVENT_WAKEUP };
+  return osal_queue_send(_usbh_q, &event, in_isr);
+}
+
+//--------------------------------------------------------------------+
+// DELAY
+// Counted with frame number of HCD, elapsed delays are polled by tuh_task()
+//--------------------------------------------------------------------+
+bool usbh_delay(uint8_t dev_addr, uint16_t ms, usbh_delay_cb_t complete_cb)
+{
+  usbh_device_t* dev = &_usbh_devices[dev_addr];
+  TU_ASSERT(ms <= INT16_MAX && !dev->delay_cb);
+
+  // current frame is partially elapsed
+  dev->delay_deadline = (uint16_t) (hcd_frame_number(dev->rhport) + ms + 1);
+  dev->delay_cb       = complete_cb;
+
+  return true;
+}
+
+// Invoke callback of elapsed delays, return timeout_ms bounded by the earliest pending one
+static uint32_t delay_process(uint32_t timeout_ms)
+{
+  for (uint8_t dev_addr = 0; dev_addr <= CFG_TUSB_HOST_DEVICE_MAX; dev_addr++)
+  {
+    usbh_device_t* dev = &_usbh_devices[dev_addr];
+    if ( !dev->delay_cb ) continue;
+
+    int16_t const remain = (int16_t) (dev->delay_deadline - (uint16_t) hcd_frame_number(dev->rhport));
+    if ( remain > 0 )
+    {
+      timeout_ms = tu_min32(timeout_ms, (uint32_t) remain);
+    }else
+    {
+      // callback may start another delay
+      usbh_delay_cb_t const complete_cb = dev->delay_cb;
+      dev->delay_cb = NULL;
+      complete_cb(dev_addr);
+
+      if ( dev->delay_cb ) timeout_ms = OSAL_TIMEOUT_NOTIMEOUT;
+    }
+  }
+
+  return timeout_ms;
 }
 
 //--------------------------------------------------------------------+
@@ -56,8 +56,19 @@ typedef struct {
 
   void (* const init) (void);
   bool (* const open)(uint8_t rhport, uint8_t dev_addr, tusb_desc_interface_t const * itf_desc, uint16_t* outlen);
-  void (* const isr) (uint8_t dev_addr, uint8_t ep_addr, xfer_result_t result, uint32_t len);
+
+  // Optional, invoked once all interfaces are opened to issue class requests of interface itf_num with
+  // tuh_control_xfer(). Driver calls usbh_driver_set_config_complete() when done, return false if nothing is started
+  bool (* const set_config)(uint8_t dev_addr, uint8_t itf_num);
+
   void (* const close) (uint8_t);
+
+  // Invoked by tuh_task() when transfer completes
+  void (* const xfer_cb) (uint8_t dev_addr, uint8_t ep_addr, xfer_result_t result, uint32_t len);
+
+  // Optional, invoked in interrupt context when transfer completes. Return true if handled,
+  // false to defer to xfer_cb in tuh_task()
+  bool (* const xfer_isr_cb) (uint8_t dev_addr, uint8_t ep_addr, xfer_result_t result, uint32_t len);
 } host_class_driver_t;
 //--------------------------------------------------------------------+
 // INTERNAL OBJECT & FUNCTION DECLARATION
@@ -68,8 +79,75 @@ typedef struct {
 //--------------------------------------------------------------------+
 void tuh_task(void);
 
-// Interrupt handler, name alias to HCD
-#define tuh_isr   hcd_isr
+// Process all pending events, waiting at most timeout_ms for the first one (RTOS only). The wait is
+// shortened by pending enumeration delays, which never block so that OPT_OS_NONE mainloop keeps running
+void tuh_task_ext(uint32_t timeout_ms);
+
+// Process at most max_events events and for at most max_time (unit of CFG_TUH_TASK_TIMESTAMP()) without
+// waiting, 0 is unlimited. Elapsed delays and at least one pending event are processed. Return true if
+// budget is exhausted i.e events may remain, caller should then invoke it again soon.
+bool tuh_task_budget(uint32_t max_events, uint32_t max_time);
+
+// Wake up tuh_task_ext() waiting for events
+bool tuh_task_wakeup(bool in_isr);
+
+// Interrupt handler, name alias to HCD. Dual-role port dispatches only in host role
+#if TUSB_OPT_DUAL_ROLE
+#define tuh_isr(_rhport)   do { if ( tusb_role_get() == OPT_MODE_HOST ) hcd_isr(_rhport); osal_isr_yield(); } while(0)
+#else
+#define tuh_isr(_rhport)   do { hcd_isr(_rhport); osal_isr_yield(); } while(0)
+#endif
+
+// Invoked by tuh_task() when status stage of tuh_control_xfer() completes or any of its stage fails
+typedef void (*tuh_control_complete_cb_t)(uint8_t dev_addr, tusb_control_request_t const * request, xfer_result_t result);
+
+// Submit control transfer without blocking, stages are carried out from HCD interrupt.
+// buffer must stay valid until complete_cb is invoked. Return false if control pipe of device is busy.
+bool tuh_control_xfer(uint8_t dev_addr, tusb_control_request_t const * request, void* buffer, tuh_control_complete_cb_t complete_cb);
+
+// Open isochronous endpoint of an interface not claimed by any class driver e.g audio/video streaming,
+// once its alternate setting is selected. Bandwidth is reserved until tuh_iso_edpt_close() or unplug.
+bool tuh_iso_edpt_open(uint8_t dev_addr, tusb_desc_endpoint_t const * ep_desc);
+bool tuh_iso_edpt_close(uint8_t dev_addr, uint8_t ep_addr);
+
+// Select alternate setting of interface (SET_INTERFACE). Endpoints of the previous setting are not closed
+bool tuh_interface_set(uint8_t dev_addr, uint8_t itf_num, uint8_t alt, tuh_control_complete_cb_t complete_cb);
+
+// Queue count packets, one per service interval, back to back in buffer. packet_len[i] is length of
+// packet i (OUT) or its expected length (IN), updated with actual length when tuh_iso_xfer_cb() is invoked.
+// Consecutive transfers form a continuous stream, at most 2 can be queued per endpoint.
+bool tuh_iso_xfer(uint8_t dev_addr, uint8_t ep_addr, void* buffer, uint16_t packet_len[], uint16_t count);
+
+// Fail a transfer of endpoint with XFER_RESULT_TIMEOUT if not completed within timeout_ms (0 is never,
+// default) once it heads the endpoint queue. Control pipe uses CFG_TUH_CONTROL_TIMEOUT_MS.
+bool tuh_edpt_set_timeout(uint8_t dev_addr, uint8_t ep_addr, uint16_t timeout_ms);
+
+// Drop pending transfers of a non-control endpoint without invoking their callback
+bool tuh_edpt_abort(uint8_t dev_addr, uint8_t ep_addr);
+
+#if CFG_TUH_STATS
+// Counters of an endpoint since device is opened or tuh_stats_reset(). NAKs are retried by host controller
+// without software seeing them, a device NAKing too long shows up as timeout (see tuh_edpt_set_timeout())
+typedef struct
+{
+  uint32_t xfer_count;    // completed transfers, including failed ones
+  uint32_t error_count;   // XFER_RESULT_FAILED e.g CRC, babble or too many transaction errors
+  uint32_t stall_count;
+  uint32_t timeout_count;
+  uint64_t bytes;
+} tuh_stats_t;
+
+// Snapshot of endpoint counters. Control pipe is ep_addr 0 for both directions, each stage counts as a transfer
+bool tuh_stats_get(uint8_t dev_addr, uint8_t ep_addr, tuh_stats_t* stats);
+
+// Clear counters of all endpoints of device
+void tuh_stats_reset(uint8_t dev_addr);
+#endif
+
+// Bandwidth reserved in periodic schedule of rhport by interrupt and isochronous endpoints of all devices,
+// load of the first count slots is copied to load[] (may be NULL if count is 0)
+typedef hcd_period_usage_t tuh_period_usage_t;
+void tuh_period_usage_get(uint8_t rhport, tuh_period_usage_t* usage, uint16_t load[], uint16_t count);
 
 tusb_device_state_t tuh_device_get_state (uint8_t dev_addr);
 static inline bool tuh_device_is_configured(uint8_t dev_addr)
@@ -88,12 +166,49 @@ TU_ATTR_WEAK void tuh_mount_cb (uint8_t dev_addr);
 /** Callback invoked when device is unmounted (bus reset/unplugged) */
 TU_ATTR_WEAK void tuh_umount_cb(uint8_t dev_addr);
 
+// Invoked by tuh_task() when transfer of tuh_iso_xfer() completes, result is failed if any packet is lost
+TU_ATTR_WEAK void tuh_iso_xfer_cb(uint8_t dev_addr, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes);
+
 //--------------------------------------------------------------------+
 // CLASS-USBH & INTERNAL API
 //--------------------------------------------------------------------+
 bool usbh_init(void);
+
+#if TUSB_OPT_DUAL_ROLE
+// Dual-role port enters host role again after usbh_init(): controller is initialized in host mode
+bool usbh_role_start(void);
+
+// Dual-role port leaves host role: attached devices are closed as if unplugged, pending events are dropped
+void usbh_role_stop(void);
+#endif
+
+// Blocking control transfer for RTOS application, stack only uses tuh_control_xfer(). With OPT_OS_NONE
+// it spins in osal_semaphore_wait() and must not be called from tuh_task() callbacks
 bool usbh_control_xfer (uint8_t dev_addr, tusb_control_request_t* request, uint8_t* data);
 
+// Driver has finished set_config() of interface itf_num (successfully or not), next interface is configured
+void usbh_driver_set_config_complete(uint8_t dev_addr, uint8_t itf_num);
+
+// Mark endpoint as latency sensitive (e.g keyboard report), its completions are processed before those of
+// other endpoints with CFG_TUH_TASK_PRIO_QUEUE_SZ. Cleared when device is closed
+void usbh_edpt_prio(uint8_t dev_addr, uint8_t ep_addr, bool prio);
+
+// Open/close isochronous endpoint of a class driver e.g once alternate setting is selected, its transfers
+// are queued with hcd_edpt_iso_xfer(). Endpoints left open are closed with device
+bool usbh_iso_edpt_open(uint8_t dev_addr, tusb_desc_endpoint_t const * ep_desc);
+bool usbh_iso_edpt_close(uint8_t dev_addr, uint8_t ep_addr);
+
+// End of configuration descriptor, only valid in open() of class driver to bound parsing of descriptors
+// following its interface e.g alternate settings. A descriptor longer than enum buffer is parsed as it
+// is received: this is then the end of the part in buffer, which is as much as it can hold
+uint8_t const* usbh_config_desc_end(void);
+
+// Invoked by tuh_task() once delay of usbh_delay() is elapsed
+typedef void (*usbh_delay_cb_t)(uint8_t dev_addr);
+
+// Non-blocking delay of at least ms (up to 32767), one per device. Pending delay is dropped when device is closed
+bool usbh_delay(uint8_t dev_addr, uint16_t ms, usbh_delay_cb_t complete_cb);
+
 #ifdef __cplusplus
  }
 #endif
@@ -39,6 +39,7 @@
 //--------------------------------------------------------------------+
 #include "common/tusb_common.h"
 #include "osal/osal.h"
+#include "usbh.h"
 
 //--------------------------------------------------------------------+
 // USBH-HCD common data structure
@@ -49,10 +50,12 @@ typedef struct {
   uint8_t hub_addr;
   uint8_t hub_port;
   uint8_t speed;
+  uint8_t tt_think;   // high speed hub: think time of its transaction translator, in full speed bit times
 
   //------------- device descriptor -------------//
   uint16_t vendor_id;
   uint16_t product_id;
+  uint16_t bcd_device;
   uint8_t  configure_count; // bNumConfigurations alias
 
   //------------- configuration descriptor -------------//
@@ -60,12 +63,20 @@ typedef struct {
 
   //------------- device -------------//
   volatile uint8_t state;             // device state, value from enum tusbh_device_state_t
+  uint8_t enum_stage;                 // enumeration in progress, internal to usbh.c
+
+  //------------- delay -------------//
+  uint16_t delay_deadline;            // frame number
+  usbh_delay_cb_t delay_cb;           // NULL if no delay is pending
 
   //------------- control pipe -------------//
   struct {
     volatile uint8_t pipe_status;
 //    uint8_t xferred_bytes; TODO not yet necessary
+    volatile uint8_t stage;   // stage in progress, idle if control pipe is free
     tusb_control_request_t request;
+    uint8_t* buffer;
+    tuh_control_complete_cb_t complete_cb; // NULL for blocking usbh_control_xfer()
 
     osal_semaphore_def_t sem_def;
     osal_semaphore_t sem_hdl;  // used to synchronize with HCD when control xfer complete
@@ -76,10 +87,33 @@ typedef struct {
 
   uint8_t itf2drv[16];  // map interface number to driver (0xff is invalid)
   uint8_t ep2drv[8][2]; // map endpoint to driver ( 0xff is invalid )
+  uint16_t ep_prio;     // latency sensitive endpoints, bit epnum (OUT) and 8+epnum (IN)
+  uint16_t ep_iso;      // opened isochronous endpoints, same layout as ep_prio
+
+#if CFG_TUH_STATS
+  tuh_stats_t stats[8][2]; // updated in HCD isr
+#endif
 } usbh_device_t;
 
 extern usbh_device_t _usbh_devices[CFG_TUSB_HOST_DEVICE_MAX+1]; // including zero-address
 
+// Transaction translator of a full/low speed device: nearest high speed hub upstream and the port of that
+// hub the device is reached from. Return 0 if there is none i.e embedded TT of the root port, if any
+static inline uint8_t usbh_tt_hub(uint8_t dev_addr, uint8_t* hub_port)
+{
+  uint8_t addr = dev_addr;
+
+  for(uint8_t i = 0; i < CFG_TUSB_HOST_DEVICE_MAX; i++)
+  {
+    uint8_t const hub = _usbh_devices[addr].hub_addr;
+    if ( (hub == 0) || (_usbh_devices[hub].speed == TUSB_SPEED_HIGH) ) break;
+    addr = hub;
+  }
+
+  *hub_port = _usbh_devices[addr].hub_port;
+  return _usbh_devices[addr].hub_addr;
+}
+
 //--------------------------------------------------------------------+
 // callback from HCD ISR
 //--------------------------------------------------------------------+
@@ -53,6 +53,10 @@ typedef void (*osal_task_func_t)( void * );
   #include "osal_freertos.h"
 #elif CFG_TUSB_OS == OPT_OS_MYNEWT
   #include "osal_mynewt.h"
+#elif CFG_TUSB_OS == OPT_OS_ZEPHYR
+  #include "osal_zephyr.h"
+#elif CFG_TUSB_OS == OPT_OS_CMSIS_RTOS2
+  #include "osal_cmsis_rtos2.h"
 #else
   #error OS is not supported yet
 #endif
@@ -62,6 +66,9 @@ typedef void (*osal_task_func_t)( void * );
 //--------------------------------------------------------------------+
 static inline void osal_task_delay(uint32_t msec);
 
+// Invoked once at the end of a USB interrupt handler, switch to the task woken by the events it posted
+static inline void osal_isr_yield(void);
+
 //------------- Semaphore -------------//
 static inline osal_semaphore_t osal_semaphore_create(osal_semaphore_def_t* semdef);
 static inline bool osal_semaphore_post(osal_semaphore_t sem_hdl, bool in_isr);
@@ -76,7 +83,7 @@ static inline bool osal_mutex_unlock(osal_mutex_t mutex_hdl);
 
 //------------- Queue -------------//
 static inline osal_queue_t osal_queue_create(osal_queue_def_t* qdef);
-static inline bool osal_queue_receive(osal_queue_t const qhdl, void* data);
+static inline bool osal_queue_receive(osal_queue_t const qhdl, void* data, uint32_t msec); // msec is ignored by OS None
 static inline bool osal_queue_send(osal_queue_t const qhdl, void const * data, bool in_isr);
 
 #if 0  // TODO remove subtask related macros later
@@ -0,0 +1,149 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#ifndef _TUSB_OSAL_CMSIS_RTOS2_H_
+#define _TUSB_OSAL_CMSIS_RTOS2_H_
+
+#include "cmsis_os2.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+// Control blocks are allocated by the kernel (attributes without cb_mem), their size is specific
+// to each CMSIS-RTOS2 implementation. Objects are created once by tusb_init().
+
+//--------------------------------------------------------------------+
+// TASK API
+//--------------------------------------------------------------------+
+static inline uint32_t _osal_ms2tick(uint32_t msec)
+{
+  if ( msec == OSAL_TIMEOUT_WAIT_FOREVER ) return osWaitForever;
+  if ( msec == 0 ) return 0;
+
+  // round up so that a short timeout does not become a poll
+  return (uint32_t) ((((uint64_t) msec) * osKernelGetTickFreq() + 999) / 1000);
+}
+
+static inline void osal_task_delay(uint32_t msec)
+{
+  osDelay( _osal_ms2tick(msec) );
+}
+
+// context switch is handled by the kernel on interrupt exit
+static inline void osal_isr_yield(void)
+{
+}
+
+//--------------------------------------------------------------------+
+// Semaphore API
+//--------------------------------------------------------------------+
+typedef osSemaphoreAttr_t osal_semaphore_def_t;
+typedef osSemaphoreId_t   osal_semaphore_t;
+
+static inline osal_semaphore_t osal_semaphore_create(osal_semaphore_def_t* semdef)
+{
+  return osSemaphoreNew(1, 0, semdef);
+}
+
+static inline bool osal_semaphore_post(osal_semaphore_t sem_hdl, bool in_isr)
+{
+  (void) in_isr;
+  return osSemaphoreRelease(sem_hdl) == osOK;
+}
+
+static inline bool osal_semaphore_wait(osal_semaphore_t sem_hdl, uint32_t msec)
+{
+  return osSemaphoreAcquire(sem_hdl, _osal_ms2tick(msec)) == osOK;
+}
+
+static inline void osal_semaphore_reset(osal_semaphore_t sem_hdl)
+{
+  while ( osSemaphoreAcquire(sem_hdl, 0) == osOK ) {}
+}
+
+//--------------------------------------------------------------------+
+// MUTEX API (priority inheritance)
+//--------------------------------------------------------------------+
+typedef osMutexAttr_t osal_mutex_def_t;
+typedef osMutexId_t   osal_mutex_t;
+
+static inline osal_mutex_t osal_mutex_create(osal_mutex_def_t* mdef)
+{
+  mdef->attr_bits = osMutexPrioInherit;
+  return osMutexNew(mdef);
+}
+
+static inline bool osal_mutex_lock(osal_mutex_t mutex_hdl, uint32_t msec)
+{
+  return osMutexAcquire(mutex_hdl, _osal_ms2tick(msec)) == osOK;
+}
+
+static inline bool osal_mutex_unlock(osal_mutex_t mutex_hdl)
+{
+  return osMutexRelease(mutex_hdl) == osOK;
+}
+
+//--------------------------------------------------------------------+
+// QUEUE API
+// Events are copied by the USB ISR directly into the kernel message queue, which wakes the waiting task
+//--------------------------------------------------------------------+
+
+// role device/host is used by OS NONE for mutex (disable usb isr) only
+#define OSAL_QUEUE_DEF(_role, _name, _depth, _type) \
+  osal_queue_def_t _name = { .depth = _depth, .item_sz = sizeof(_type) };
+
+typedef struct
+{
+  uint16_t depth;
+  uint16_t item_sz;
+
+  osMessageQueueAttr_t attr;
+}osal_queue_def_t;
+
+typedef osMessageQueueId_t osal_queue_t;
+
+static inline osal_queue_t osal_queue_create(osal_queue_def_t* qdef)
+{
+  return osMessageQueueNew(qdef->depth, qdef->item_sz, &qdef->attr);
+}
+
+static inline bool osal_queue_receive(osal_queue_t const queue_hdl, void* data, uint32_t msec)
+{
+  return osMessageQueueGet(queue_hdl, data, NULL, _osal_ms2tick(msec)) == osOK;
+}
+
+// timeout must be 0 in ISR, an event is dropped if queue is full
+static inline bool osal_queue_send(osal_queue_t const queue_hdl, void const * data, bool in_isr)
+{
+  return osMessageQueuePut(queue_hdl, data, 0, in_isr ? 0 : osWaitForever) == osOK;
+}
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif /* _TUSB_OSAL_CMSIS_RTOS2_H_ */
@@ -45,6 +45,16 @@ static inline void osal_task_delay(uint32_t msec)
   vTaskDelay( pdMS_TO_TICKS(msec) );
 }
 
+// Set by *FromISR() calls of the running USB interrupt which woke a higher priority task (tusb.c)
+extern BaseType_t _osal_isr_woken;
+
+static inline void osal_isr_yield(void)
+{
+  BaseType_t const woken = _osal_isr_woken;
+  _osal_isr_woken = pdFALSE;
+  portYIELD_FROM_ISR(woken);
+}
+
 //--------------------------------------------------------------------+
 // Semaphore API
 //--------------------------------------------------------------------+
@@ -58,7 +68,13 @@ static inline osal_semaphore_t osal_semaphore_create(osal_semaphore_def_t* semde
 
 static inline bool osal_semaphore_post(osal_semaphore_t sem_hdl, bool in_isr)
 {
-  return in_isr ?  xSemaphoreGiveFromISR(sem_hdl, NULL) : xSemaphoreGive(sem_hdl);
+  if ( !in_isr ) return xSemaphoreGive(sem_hdl);
+
+  BaseType_t woken = pdFALSE;
+  bool const ret = xSemaphoreGiveFromISR(sem_hdl, &woken);
+  if ( woken ) _osal_isr_woken = pdTRUE;
+
+  return ret;
 }
 
 static inline bool osal_semaphore_wait (osal_semaphore_t sem_hdl, uint32_t msec)
@@ -97,6 +113,105 @@ static inline bool osal_mutex_unlock(osal_mutex_t mutex_hdl)
 // QUEUE API
 //--------------------------------------------------------------------+
 
+#if CFG_TUSB_OS_FREERTOS_NOTIFY
+
+// Events are kept in a lock-free FIFO, producers only wake the consumer task with a direct task notification.
+// Queue has a single consumer task (registered by its first receive) which owns the notification value of
+// that task. xTaskGetCurrentTaskHandle() requires INCLUDE_xTaskGetCurrentTaskHandle.
+#include "common/tusb_fifo.h"
+
+typedef struct
+{
+  uint8_t role; // device or host
+  tu_fifo_t ff;
+  TaskHandle_t volatile task;
+}osal_queue_def_t;
+
+typedef osal_queue_def_t* osal_queue_t;
+
+#define OSAL_QUEUE_DEF(_role, _name, _depth, _type) \
+  static uint8_t _name##_buf[_depth*sizeof(_type)]; \
+  osal_queue_def_t _name = {                        \
+    .role = _role,                                  \
+    .ff   = TU_FIFO_INIT(_name##_buf, _depth, _type, false) \
+  }
+
+static inline osal_queue_t osal_queue_create(osal_queue_def_t* qdef)
+{
+  tu_fifo_clear(&qdef->ff);
+  qdef->task = NULL;
+  return (osal_queue_t) qdef;
+}
+
+// Notification given after the FIFO was found empty is still pending, waiting then returns at once.
+// A stale one (its events already drained) ends a finite wait early
+static inline bool osal_queue_receive(osal_queue_t const qhdl, void* data, uint32_t msec)
+{
+  if ( !qhdl->task ) qhdl->task = xTaskGetCurrentTaskHandle();
+
+  if ( tu_fifo_read(&qhdl->ff, data) ) return true;
+  if ( msec == OSAL_TIMEOUT_NOTIMEOUT ) return false;
+
+  if ( msec == OSAL_TIMEOUT_WAIT_FOREVER )
+  {
+    do
+    {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    } while ( !tu_fifo_read(&qhdl->ff, data) );
+
+    return true;
+  }
+
+  ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(msec));
+  return tu_fifo_read(&qhdl->ff, data);
+}
+
+static inline bool osal_queue_send(osal_queue_t const qhdl, void const * data, bool in_isr)
+{
+  bool success;
+
+  if ( in_isr )
+  {
+    // With 2 device ports, isr of one port can preempt the other one
+  #if TUSB_OPT_DEVICE_ENABLED && TUD_OPT_RHPORT_COUNT > 1
+    if ( qhdl->role == OPT_MODE_DEVICE )
+    {
+      UBaseType_t const mask = taskENTER_CRITICAL_FROM_ISR();
+      success = tu_fifo_write(&qhdl->ff, data);
+      taskEXIT_CRITICAL_FROM_ISR(mask);
+    }else
+  #endif
+    {
+      success = tu_fifo_write(&qhdl->ff, data);
+    }
+  }else
+  {
+    // usb isr and other tasks are also producers
+    taskENTER_CRITICAL();
+    success = tu_fifo_write(&qhdl->ff, data);
+    taskEXIT_CRITICAL();
+  }
+
+  // events sent before consumer task is known are found by its first receive
+  TaskHandle_t const task = qhdl->task;
+  if ( success && task )
+  {
+    if ( in_isr )
+    {
+      BaseType_t woken = pdFALSE;
+      vTaskNotifyGiveFromISR(task, &woken);
+      if ( woken ) _osal_isr_woken = pdTRUE;
+    }else
+    {
+      xTaskNotifyGive(task);
+    }
+  }
+
+  return success;
+}
+
+#else
+
 // role device/host is used by OS NONE for mutex (disable usb isr) only
 #define OSAL_QUEUE_DEF(_role, _name, _depth, _type) \
   static _type _name##_##buf[_depth];\
@@ -118,16 +233,25 @@ static inline osal_queue_t osal_queue_create(osal_queue_def_t* qdef)
   return xQueueCreateStatic(qdef->depth, qdef->item_sz, (uint8_t*) qdef->buf, &qdef->sq);
 }
 
-static inline bool osal_queue_receive(osal_queue_t const queue_hdl, void* data)
+static inline bool osal_queue_receive(osal_queue_t const queue_hdl, void* data, uint32_t msec)
 {
-  return xQueueReceive(queue_hdl, data, portMAX_DELAY);
+  uint32_t const ticks = (msec == OSAL_TIMEOUT_WAIT_FOREVER) ? portMAX_DELAY : pdMS_TO_TICKS(msec);
+  return xQueueReceive(queue_hdl, data, ticks);
 }
 
 static inline bool osal_queue_send(osal_queue_t const queue_hdl, void const * data, bool in_isr)
 {
-  return in_isr ? xQueueSendToBackFromISR(queue_hdl, data, NULL) : xQueueSendToBack(queue_hdl, data, OSAL_TIMEOUT_WAIT_FOREVER);
+  if ( !in_isr ) return xQueueSendToBack(queue_hdl, data, OSAL_TIMEOUT_WAIT_FOREVER);
+
+  BaseType_t woken = pdFALSE;
+  bool const ret = xQueueSendToBackFromISR(queue_hdl, data, &woken);
+  if ( woken ) _osal_isr_woken = pdTRUE;
+
+  return ret;
 }
 
+#endif
+
 #ifdef __cplusplus
  }
 #endif
@@ -41,6 +41,11 @@ static inline void osal_task_delay(uint32_t msec)
   os_time_delay( os_time_ms_to_ticks32(msec) );
 }
 
+// context switch is handled by the OS on interrupt exit
+static inline void osal_isr_yield(void)
+{
+}
+
 //--------------------------------------------------------------------+
 // Semaphore API
 //--------------------------------------------------------------------+
@@ -95,6 +100,69 @@ static inline bool osal_mutex_unlock(osal_mutex_t mutex_hdl)
 // QUEUE API
 //--------------------------------------------------------------------+
 
+#if CFG_TUSB_OS_MYNEWT_EVQ
+
+// Events are kept in a FIFO, sending puts the single os_event of the queue onto the application eventq
+// (no-op while it is still queued). Its handler calls tud_task_ext() which drains the FIFO, hence
+// there is no usb task, and receiving never blocks.
+#include "common/tusb_fifo.h"
+
+// Eventq processing usb events, must be set before tusb_init(). Default eventq is used otherwise
+void tusb_mynewt_evq_set(struct os_eventq* evq);
+
+// tusb.c
+extern struct os_eventq* _osal_evq;
+void _osal_evq_cb(struct os_event* ev);
+
+typedef struct
+{
+  uint8_t role; // device or host
+  tu_fifo_t ff;
+  struct os_event ev;
+}osal_queue_def_t;
+
+typedef osal_queue_def_t* osal_queue_t;
+
+#define OSAL_QUEUE_DEF(_role, _name, _depth, _type) \
+  static uint8_t _name##_buf[_depth*sizeof(_type)]; \
+  osal_queue_def_t _name = {                        \
+    .role = _role,                                  \
+    .ff   = TU_FIFO_INIT(_name##_buf, _depth, _type, false) \
+  }
+
+static inline osal_queue_t osal_queue_create(osal_queue_def_t* qdef)
+{
+  tu_fifo_clear(&qdef->ff);
+  tu_memclr(&qdef->ev, sizeof(struct os_event));
+  qdef->ev.ev_cb  = _osal_evq_cb;
+  qdef->ev.ev_arg = qdef;
+
+  return (osal_queue_t) qdef;
+}
+
+static inline bool osal_queue_receive(osal_queue_t const qhdl, void* data, uint32_t msec)
+{
+  (void) msec;
+  return tu_fifo_read(&qhdl->ff, data);
+}
+
+static inline bool osal_queue_send(osal_queue_t const qhdl, void const * data, bool in_isr)
+{
+  (void) in_isr;
+
+  // usb isr and other tasks are producers
+  os_sr_t sr;
+  OS_ENTER_CRITICAL(sr);
+  bool const success = tu_fifo_write(&qhdl->ff, data);
+  OS_EXIT_CRITICAL(sr);
+
+  if ( success ) os_eventq_put(_osal_evq ? _osal_evq : os_eventq_dflt_get(), &qhdl->ev);
+
+  return success;
+}
+
+#else
+
 // role device/host is used by OS NONE for mutex (disable usb isr) only
 #define OSAL_QUEUE_DEF(_role, _name, _depth, _type) \
   static _type _name##_##buf[_depth];\
@@ -125,10 +193,19 @@ static inline osal_queue_t osal_queue_create(osal_queue_def_t* qdef)
   return (osal_queue_t) qdef;
 }
 
-static inline bool osal_queue_receive(osal_queue_t const qhdl, void* data)
+static inline bool osal_queue_receive(osal_queue_t const qhdl, void* data, uint32_t msec)
 {
   struct os_event* ev;
-  ev = os_eventq_get(&qhdl->evq);
+
+  if ( msec == OSAL_TIMEOUT_WAIT_FOREVER )
+  {
+    ev = os_eventq_get(&qhdl->evq);
+  }else
+  {
+    struct os_eventq* evq = &qhdl->evq;
+    ev = os_eventq_poll(&evq, 1, os_time_ms_to_ticks32(msec));
+    if ( !ev ) return false;
+  }
 
   memcpy(data, ev->ev_arg, qhdl->item_sz); // copy message
   os_memblock_put(&qhdl->mpool, ev->ev_arg); // put back mem block
@@ -161,6 +238,8 @@ static inline bool osal_queue_send(osal_queue_t const qhdl, void const * data, b
   return true;
 }
 
+#endif
+
 #ifdef __cplusplus
  }
 #endif
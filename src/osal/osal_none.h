@@ -31,16 +31,34 @@
  extern "C" {
 #endif
 
+// Optional millisecond tick provided by application e.g returning board_millis(). It bounds the waits below,
+// which are endless without it. Tick must come with a periodic interrupt (e.g SysTick) waking up the core
+TU_ATTR_WEAK uint32_t tusb_time_millis_cb(void);
+
+// Sleep until an interrupt or an event: entering an interrupt sets the event register, posting from ISR
+// also signals it for a waiter which checked the semaphore just before
+#if CFG_TUSB_OS_NONE_WFE && defined(__ARM_ARCH)
+  #define _osal_wait()     __asm volatile ("wfe")
+  #define _osal_signal()   __asm volatile ("sev")
+#else
+  #define _osal_wait()     do {} while (0)
+  #define _osal_signal()   do {} while (0)
+#endif
+
 //--------------------------------------------------------------------+
 // TASK API
 //--------------------------------------------------------------------+
 static inline void osal_task_delay(uint32_t msec)
 {
-  (void) msec;
-  // TODO only used by Host stack, will implement using SOF
+  if ( !tusb_time_millis_cb ) return;
 
-//  uint32_t start = tusb_hal_millis();
-//  while ( ( tusb_hal_millis() - start ) < msec ) {}
+  uint32_t const start = tusb_time_millis_cb();
+  while ( (tusb_time_millis_cb() - start) < msec ) { _osal_wait(); }
+}
+
+// no task to switch to
+static inline void osal_isr_yield(void)
+{
 }
 
 //--------------------------------------------------------------------+
@@ -61,17 +79,24 @@ static inline osal_semaphore_t osal_semaphore_create(osal_semaphore_def_t* semde
 
 static inline bool osal_semaphore_post(osal_semaphore_t sem_hdl, bool in_isr)
 {
-  (void) in_isr;
   sem_hdl->count++;
+  if (in_isr) _osal_signal();
   return true;
 }
 
-// TODO blocking for now
+// Timeout is enforced only with tusb_time_millis_cb()
 static inline bool osal_semaphore_wait (osal_semaphore_t sem_hdl, uint32_t msec)
 {
-  (void) msec;
+  bool const timed = (msec != OSAL_TIMEOUT_WAIT_FOREVER) && tusb_time_millis_cb;
+  uint32_t const start = timed ? tusb_time_millis_cb() : 0;
 
-  while (sem_hdl->count == 0) { }
+  while (sem_hdl->count == 0)
+  {
+    if ( msec == OSAL_TIMEOUT_NOTIMEOUT ) return false;
+    if ( timed && (tusb_time_millis_cb() - start) >= msec ) return false;
+
+    _osal_wait();
+  }
   sem_hdl->count--;
 
   return true;
@@ -134,21 +159,46 @@ typedef osal_queue_def_t* osal_queue_t;
   uint8_t _name##_buf[_depth*sizeof(_type)];        \
   osal_queue_def_t _name = {                        \
     .role = _role,                                  \
-    .ff = {                                         \
-      .buffer       = _name##_buf,                  \
-      .depth        = _depth,                       \
-      .item_size    = sizeof(_type),                \
-      .overwritable = false,                        \
-    }\
+    .ff   = TU_FIFO_INIT(_name##_buf, _depth, _type, false) \
   }
 
+#if defined(__ARM_ARCH_PROFILE) && (__ARM_ARCH_PROFILE == 'M')
+
+// Cortex-M: a few instructions writing the FIFO are guarded by PRIMASK, usb interrupt stays enabled
+// and is only held off for that long. Previous PRIMASK is restored, sending may nest.
+#define OSAL_Q_LOCK_PRIMASK  1
+
+static inline uint32_t _osal_critical_enter(void)
+{
+  uint32_t primask;
+  __asm volatile ("mrs %0, primask\n cpsid i" : "=r" (primask) : : "memory");
+  return primask;
+}
+
+static inline void _osal_critical_exit(uint32_t primask)
+{
+  __asm volatile ("msr primask, %0" : : "r" (primask) : "memory");
+}
+
+#else
+
+#define OSAL_Q_LOCK_PRIMASK  0
+
+#endif
+
 // lock queue by disable usb isr
 static inline void _osal_q_lock(osal_queue_t qhdl)
 {
   (void) qhdl;
 
 #if TUSB_OPT_DEVICE_ENABLED
-  if (qhdl->role == OPT_MODE_DEVICE) dcd_int_disable(TUD_OPT_RHPORT);
+  if (qhdl->role == OPT_MODE_DEVICE)
+  {
+    dcd_int_disable(TUD_OPT_RHPORT);
+  #if TUD_OPT_RHPORT_COUNT > 1
+    dcd_int_disable(1);
+  #endif
+  }
 #endif
 
 #if TUSB_OPT_HOST_ENABLED
@@ -162,7 +212,13 @@ static inline void _osal_q_unlock(osal_queue_t qhdl)
   (void) qhdl;
 
 #if TUSB_OPT_DEVICE_ENABLED
-  if (qhdl->role == OPT_MODE_DEVICE) dcd_int_enable(TUD_OPT_RHPORT);
+  if (qhdl->role == OPT_MODE_DEVICE)
+  {
+    dcd_int_enable(TUD_OPT_RHPORT);
+  #if TUD_OPT_RHPORT_COUNT > 1
+    dcd_int_enable(1);
+  #endif
+  }
 #endif
 
 #if TUSB_OPT_HOST_ENABLED
@@ -177,26 +233,44 @@ static inline osal_queue_t osal_queue_create(osal_queue_def_t* qdef)
 }
 
 // non blocking
-static inline bool osal_queue_receive(osal_queue_t const qhdl, void* data)
+// The task is the only consumer and tu_fifo is lock-free for single producer/consumer,
+// hence there is no need to disable usb isr when receiving.
+// There is nothing to block on without an OS, timeout is ignored.
+static inline bool osal_queue_receive(osal_queue_t const qhdl, void* data, uint32_t msec)
 {
-  _osal_q_lock(qhdl);
-  bool success = tu_fifo_read(&qhdl->ff, data);
-  _osal_q_unlock(qhdl);
-
-  return success;
+  (void) msec;
+  return tu_fifo_read(&qhdl->ff, data);
 }
 
 static inline bool osal_queue_send(osal_queue_t const qhdl, void const * data, bool in_isr)
 {
-  if (!in_isr) {
+  // usb isr is also a producer, sending from task context must therefore mask it.
+  // With 2 device ports, isr of one port can also preempt the other one.
+#if TUSB_OPT_DEVICE_ENABLED && TUD_OPT_RHPORT_COUNT > 1
+  bool const need_lock = !in_isr || (qhdl->role == OPT_MODE_DEVICE);
+#else
+  bool const need_lock = !in_isr;
+#endif
+
+#if OSAL_Q_LOCK_PRIMASK
+  uint32_t const primask = need_lock ? _osal_critical_enter() : 0;
+
+  bool success = tu_fifo_write(&qhdl->ff, data);
+
+  if (need_lock) {
+    _osal_critical_exit(primask);
+  }
+#else
+  if (need_lock) {
     _osal_q_lock(qhdl);
   }
 
   bool success = tu_fifo_write(&qhdl->ff, data);
 
-  if (!in_isr) {
+  if (need_lock) {
     _osal_q_unlock(qhdl);
   }
+#endif
 
   TU_ASSERT(success);
 
@@ -0,0 +1,145 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#ifndef _TUSB_OSAL_ZEPHYR_H_
+#define _TUSB_OSAL_ZEPHYR_H_
+
+#include <zephyr.h>
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+//--------------------------------------------------------------------+
+// TASK API
+//--------------------------------------------------------------------+
+static inline void osal_task_delay(uint32_t msec)
+{
+  k_msleep(msec);
+}
+
+// context switch is handled by the kernel on interrupt exit
+static inline void osal_isr_yield(void)
+{
+}
+
+static inline k_timeout_t _osal_ms2timeout(uint32_t msec)
+{
+  return (msec == OSAL_TIMEOUT_WAIT_FOREVER) ? K_FOREVER : K_MSEC(msec);
+}
+
+//--------------------------------------------------------------------+
+// Semaphore API
+//--------------------------------------------------------------------+
+typedef struct k_sem  osal_semaphore_def_t;
+typedef struct k_sem* osal_semaphore_t;
+
+static inline osal_semaphore_t osal_semaphore_create(osal_semaphore_def_t* semdef)
+{
+  return (k_sem_init(semdef, 0, 1) == 0) ? semdef : NULL;
+}
+
+static inline bool osal_semaphore_post(osal_semaphore_t sem_hdl, bool in_isr)
+{
+  (void) in_isr;
+  k_sem_give(sem_hdl);
+  return true;
+}
+
+static inline bool osal_semaphore_wait(osal_semaphore_t sem_hdl, uint32_t msec)
+{
+  return k_sem_take(sem_hdl, _osal_ms2timeout(msec)) == 0;
+}
+
+static inline void osal_semaphore_reset(osal_semaphore_t sem_hdl)
+{
+  k_sem_reset(sem_hdl);
+}
+
+//--------------------------------------------------------------------+
+// MUTEX API (priority inheritance)
+//--------------------------------------------------------------------+
+typedef struct k_mutex  osal_mutex_def_t;
+typedef struct k_mutex* osal_mutex_t;
+
+static inline osal_mutex_t osal_mutex_create(osal_mutex_def_t* mdef)
+{
+  return (k_mutex_init(mdef) == 0) ? mdef : NULL;
+}
+
+static inline bool osal_mutex_lock(osal_mutex_t mutex_hdl, uint32_t msec)
+{
+  return k_mutex_lock(mutex_hdl, _osal_ms2timeout(msec)) == 0;
+}
+
+static inline bool osal_mutex_unlock(osal_mutex_t mutex_hdl)
+{
+  return k_mutex_unlock(mutex_hdl) == 0;
+}
+
+//--------------------------------------------------------------------+
+// QUEUE API
+// Events are copied by the USB ISR directly into a k_msgq, k_msgq_put() wakes the waiting task
+//--------------------------------------------------------------------+
+
+// role device/host is used by OS NONE for mutex (disable usb isr) only
+#define OSAL_QUEUE_DEF(_role, _name, _depth, _type) \
+  static char TU_ATTR_ALIGNED(4) _name##_##buf[_depth*sizeof(_type)]; \
+  osal_queue_def_t _name = { .depth = _depth, .item_sz = sizeof(_type), .buf = _name##_##buf };
+
+typedef struct
+{
+  uint16_t depth;
+  uint16_t item_sz;
+  char*    buf;
+
+  struct k_msgq mq;
+}osal_queue_def_t;
+
+typedef struct k_msgq* osal_queue_t;
+
+static inline osal_queue_t osal_queue_create(osal_queue_def_t* qdef)
+{
+  k_msgq_init(&qdef->mq, qdef->buf, qdef->item_sz, qdef->depth);
+  return &qdef->mq;
+}
+
+static inline bool osal_queue_receive(osal_queue_t const queue_hdl, void* data, uint32_t msec)
+{
+  return k_msgq_get(queue_hdl, data, _osal_ms2timeout(msec)) == 0;
+}
+
+// ISR must not block, an event is dropped if queue is full
+static inline bool osal_queue_send(osal_queue_t const queue_hdl, void const * data, bool in_isr)
+{
+  return k_msgq_put(queue_hdl, (void*) data, in_isr ? K_NO_WAIT : K_FOREVER) == 0;
+}
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif /* _TUSB_OSAL_ZEPHYR_H_ */
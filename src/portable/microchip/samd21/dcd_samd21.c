@@ -31,9 +31,35 @@
 #include "device/dcd.h"
 #include "sam.h"
 
+// Bulk endpoints (bitmask of endpoint numbers) using both banks of the endpoint for their own
+// direction: controller receives/sends from one bank while completion of the other is processed.
+// The opposite direction of these endpoint numbers can not be used.
+#ifndef DCD_SAMD_DUAL_BANK_EP
+#  define DCD_SAMD_DUAL_BANK_EP 0u
+#endif
+
 /*------------------------------------------------------------------*/
 /* MACRO TYPEDEF CONSTANT ENUM
  *------------------------------------------------------------------*/
+TU_VERIFY_STATIC(((DCD_SAMD_DUAL_BANK_EP) & 1u) == 0, "Control endpoint can not be dual bank");
+
+// EPTYPE value giving the bank of that direction to the opposite one
+#define EPTYPE_DUAL_BANK  0x5
+
+typedef struct
+{
+  bool    enabled;
+  uint8_t dir;
+  uint8_t next_bank; // bank for the next submitted transfer
+  uint8_t done_bank; // bank of the oldest transfer in progress
+  uint8_t pending;   // transfers in progress, up to one per bank
+} dual_bank_t;
+
+static dual_bank_t _dual_bank[8];
+
+// IN endpoints (bitmask of endpoint numbers) whose transfers ending with a full packet are followed by ZLP
+static uint8_t _auto_zlp;
+
 static TU_ATTR_ALIGNED(4) UsbDeviceDescBank sram_registers[8][2];
 static TU_ATTR_ALIGNED(4) uint8_t _setup_packet[8];
 
@@ -50,6 +76,8 @@ static void bus_reset(void)
   ep->EPCFG.reg = USB_DEVICE_EPCFG_EPTYPE0(0x1) | USB_DEVICE_EPCFG_EPTYPE1(0x1);
   ep->EPINTENSET.reg = USB_DEVICE_EPINTENSET_TRCPT0 | USB_DEVICE_EPINTENSET_TRCPT1 | USB_DEVICE_EPINTENSET_RXSTP;
 
+  tu_varclr(&_dual_bank);
+
   // Prepare for setup packet
   dcd_edpt_xfer(0, 0, _setup_packet, sizeof(_setup_packet));
 }
@@ -81,7 +109,7 @@ void dcd_init (uint8_t rhport)
   while (USB->DEVICE.SYNCBUSY.bit.ENABLE == 1) {}
 
   USB->DEVICE.INTFLAG.reg |= USB->DEVICE.INTFLAG.reg; // clear pending
-  USB->DEVICE.INTENSET.reg = USB_DEVICE_INTENSET_SOF | USB_DEVICE_INTENSET_EORST;
+  USB->DEVICE.INTENSET.reg = USB_DEVICE_INTENSET_EORST; // SOF is enabled by dcd_sof_enable()
 }
 
 void dcd_int_enable(uint8_t rhport)
@@ -126,6 +154,38 @@ void dcd_remote_wakeup(uint8_t rhport)
   USB->DEVICE.CTRLB.bit.UPRSM = 1;
 }
 
+void dcd_get_caps(uint8_t rhport, dcd_caps_t* caps)
+{
+  (void) rhport;
+
+  // BYTE_COUNT and MULTI_PACKET_SIZE are 14-bit, bank is accessed by DMA
+  caps->max_xfer_bytes = TU_BIT(14) - 1;
+  caps->multi_packet   = 1;
+  caps->dma            = 1;
+  caps->double_buffer  = (DCD_SAMD_DUAL_BANK_EP != 0);
+  caps->iso            = 1;
+}
+
+uint32_t dcd_frame_number(uint8_t rhport)
+{
+  (void) rhport;
+  return USB->DEVICE.FNUM.bit.FNUM;
+}
+
+void dcd_sof_enable(uint8_t rhport, bool en)
+{
+  (void) rhport;
+
+  if ( en )
+  {
+    USB->DEVICE.INTFLAG.reg  = USB_DEVICE_INTFLAG_SOF; // stale one
+    USB->DEVICE.INTENSET.reg = USB_DEVICE_INTENSET_SOF;
+  }else
+  {
+    USB->DEVICE.INTENCLR.reg = USB_DEVICE_INTENCLR_SOF;
+  }
+}
+
 /*------------------------------------------------------------------*/
 /* DCD Endpoint port
  *------------------------------------------------------------------*/
@@ -138,21 +198,55 @@ bool dcd_edpt_open (uint8_t rhport, tusb_desc_endpoint_t const * desc_edpt)
   uint8_t const dir   = tu_edpt_dir(desc_edpt->bEndpointAddress);
 
   UsbDeviceDescBank* bank = &sram_registers[epnum][dir];
+  uint16_t const mps = desc_edpt->wMaxPacketSize.size;
+
+  // Bank size is the smallest of 8, 16 .. 512, 1023 that holds the packet: isochronous endpoint
+  // can have any size up to 1023 e.g 192 bytes for 48 KHz stereo audio.
   uint32_t size_value = 0;
-  while (size_value < 7) {
-    if (1 << (size_value + 3) == desc_edpt->wMaxPacketSize.size) {
-      break;
-    }
+  while ( (size_value < 7) && ((1u << (size_value + 3)) < mps) ) {
     size_value++;
   }
 
   // unsupported endpoint size
-  if ( size_value == 7 && desc_edpt->wMaxPacketSize.size != 1023 ) return false;
+  if ( mps > 1023 ) return false;
 
   bank->PCKSIZE.bit.SIZE = size_value;
+  if ( dir == TUSB_DIR_IN ) _auto_zlp &= (uint8_t) ~TU_BIT(epnum);
 
   UsbDeviceEndpoint* ep = &USB->DEVICE.DeviceEndpoint[epnum];
 
+  if ( (DCD_SAMD_DUAL_BANK_EP & (1u << epnum)) && (desc_edpt->bmAttributes.xfer == TUSB_XFER_BULK) )
+  {
+    // both banks hold packets of the endpoint direction
+    sram_registers[epnum][dir ^ 1u].PCKSIZE.bit.SIZE = size_value;
+
+    if ( dir == TUSB_DIR_OUT )
+    {
+      TU_ASSERT(ep->EPCFG.bit.EPTYPE1 == 0 || ep->EPCFG.bit.EPTYPE1 == EPTYPE_DUAL_BANK);
+      ep->EPCFG.reg = USB_DEVICE_EPCFG_EPTYPE0(TUSB_XFER_BULK + 1) | USB_DEVICE_EPCFG_EPTYPE1(EPTYPE_DUAL_BANK);
+
+      // banks full (NAK) until a transfer is submitted
+      ep->EPSTATUSSET.reg = USB_DEVICE_EPSTATUSSET_BK0RDY | USB_DEVICE_EPSTATUSSET_BK1RDY;
+    }else
+    {
+      TU_ASSERT(ep->EPCFG.bit.EPTYPE0 == 0 || ep->EPCFG.bit.EPTYPE0 == EPTYPE_DUAL_BANK);
+      ep->EPCFG.reg = USB_DEVICE_EPCFG_EPTYPE0(EPTYPE_DUAL_BANK) | USB_DEVICE_EPCFG_EPTYPE1(TUSB_XFER_BULK + 1);
+
+      ep->EPSTATUSCLR.reg = USB_DEVICE_EPSTATUSCLR_BK0RDY | USB_DEVICE_EPSTATUSCLR_BK1RDY;
+    }
+
+    ep->EPINTFLAG.reg = USB_DEVICE_EPINTFLAG_TRCPT0 | USB_DEVICE_EPINTFLAG_TRCPT1;
+    ep->EPINTENSET.reg = USB_DEVICE_EPINTENSET_TRCPT0 | USB_DEVICE_EPINTENSET_TRCPT1;
+
+    dual_bank_t* db = &_dual_bank[epnum];
+    db->enabled   = true;
+    db->dir       = dir;
+    db->next_bank = db->done_bank = ep->EPSTATUS.bit.CURBK;
+    db->pending   = 0;
+
+    return true;
+  }
+
   if ( dir == TUSB_DIR_OUT )
   {
     ep->EPCFG.bit.EPTYPE0 = desc_edpt->bmAttributes.xfer + 1;
@@ -166,16 +260,48 @@ bool dcd_edpt_open (uint8_t rhport, tusb_desc_endpoint_t const * desc_edpt)
   return true;
 }
 
-bool dcd_edpt_xfer (uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint16_t total_bytes)
+bool dcd_edpt_xfer (uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint32_t total_bytes)
 {
   (void) rhport;
 
   uint8_t const epnum = tu_edpt_number(ep_addr);
   uint8_t const dir   = tu_edpt_dir(ep_addr);
 
+  // BYTE_COUNT and MULTI_PACKET_SIZE are 14-bit
+  TU_ASSERT(total_bytes < TU_BIT(14));
+
   UsbDeviceDescBank* bank = &sram_registers[epnum][dir];
   UsbDeviceEndpoint* ep = &USB->DEVICE.DeviceEndpoint[epnum];
 
+  if ( _dual_bank[epnum].enabled )
+  {
+    dual_bank_t* db = &_dual_bank[epnum];
+    TU_ASSERT(db->pending < 2);
+
+    uint8_t const bank_num = db->next_bank;
+    bank = &sram_registers[epnum][bank_num];
+
+    db->next_bank ^= 1u;
+    db->pending++;
+
+    bank->ADDR.reg = (uint32_t) buffer;
+    if ( dir == TUSB_DIR_OUT )
+    {
+      bank->PCKSIZE.bit.MULTI_PACKET_SIZE = total_bytes;
+      bank->PCKSIZE.bit.BYTE_COUNT = 0;
+      ep->EPSTATUSCLR.reg = bank_num ? USB_DEVICE_EPSTATUSCLR_BK1RDY : USB_DEVICE_EPSTATUSCLR_BK0RDY;
+    } else
+    {
+      bank->PCKSIZE.bit.MULTI_PACKET_SIZE = 0;
+      bank->PCKSIZE.bit.BYTE_COUNT = total_bytes;
+      bank->PCKSIZE.bit.AUTO_ZLP = tu_bit_test(_auto_zlp, epnum);
+      ep->EPSTATUSSET.reg = bank_num ? USB_DEVICE_EPSTATUSSET_BK1RDY : USB_DEVICE_EPSTATUSSET_BK0RDY;
+    }
+    ep->EPINTFLAG.reg = bank_num ? USB_DEVICE_EPINTFLAG_TRFAIL1 : USB_DEVICE_EPINTFLAG_TRFAIL0;
+
+    return true;
+  }
+
   // A setup token can occur immediately after an OUT STATUS packet so make sure we have a valid
   // buffer for the control endpoint.
   if (epnum == 0 && dir == 0 && buffer == NULL) {
@@ -193,7 +319,7 @@ bool dcd_edpt_xfer (uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint16_t
   {
     bank->PCKSIZE.bit.MULTI_PACKET_SIZE = 0;
     bank->PCKSIZE.bit.BYTE_COUNT = total_bytes;
-    // bank->PCKSIZE.bit.AUTO_ZLP = 1;
+    bank->PCKSIZE.bit.AUTO_ZLP = tu_bit_test(_auto_zlp, epnum);
     ep->EPSTATUSSET.reg |= USB_DEVICE_EPSTATUSSET_BK1RDY;
     ep->EPINTFLAG.reg |= USB_DEVICE_EPINTFLAG_TRFAIL1;
   }
@@ -201,6 +327,22 @@ bool dcd_edpt_xfer (uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint16_t
   return true;
 }
 
+// Controller appends ZLP to IN transfer ending with a full packet
+bool dcd_edpt_auto_zlp(uint8_t rhport, uint8_t ep_addr)
+{
+  (void) rhport;
+  _auto_zlp |= (uint8_t) TU_BIT(tu_edpt_number(ep_addr));
+  return true;
+}
+
+// Dual bank endpoint takes a second transfer into its other bank
+bool dcd_edpt_xfer_append(uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint32_t total_bytes)
+{
+  dual_bank_t const* db = &_dual_bank[tu_edpt_number(ep_addr)];
+  TU_VERIFY(db->enabled && db->pending < 2);
+  return dcd_edpt_xfer(rhport, ep_addr, buffer, total_bytes);
+}
+
 void dcd_edpt_stall (uint8_t rhport, uint8_t ep_addr)
 {
   (void) rhport;
@@ -227,6 +369,23 @@ void dcd_edpt_clear_stall (uint8_t rhport, uint8_t ep_addr)
   } else {
     ep->EPSTATUSCLR.reg = USB_DEVICE_EPSTATUSCLR_STALLRQ0 | USB_DEVICE_EPSTATUSCLR_DTGLOUT;
   }
+
+  // stack drops transfers of a stalled endpoint, release both banks
+  dual_bank_t* db = &_dual_bank[epnum];
+  if ( db->enabled )
+  {
+    if ( db->dir == TUSB_DIR_OUT )
+    {
+      ep->EPSTATUSSET.reg = USB_DEVICE_EPSTATUSSET_BK0RDY | USB_DEVICE_EPSTATUSSET_BK1RDY;
+    }else
+    {
+      ep->EPSTATUSCLR.reg = USB_DEVICE_EPSTATUSCLR_BK0RDY | USB_DEVICE_EPSTATUSCLR_BK1RDY;
+    }
+    ep->EPINTFLAG.reg = USB_DEVICE_EPINTFLAG_TRCPT0 | USB_DEVICE_EPINTFLAG_TRCPT1;
+
+    db->next_bank = db->done_bank = ep->EPSTATUS.bit.CURBK;
+    db->pending   = 0;
+  }
 }
 
 /*------------------------------------------------------------------*/
@@ -243,6 +402,29 @@ static bool maybe_handle_setup_packet(void) {
   return false;
 }
 
+// Banks of a dual bank endpoint complete in the order they were submitted
+static void dual_bank_complete(uint8_t epnum)
+{
+  UsbDeviceEndpoint* ep = &USB->DEVICE.DeviceEndpoint[epnum];
+  dual_bank_t* db = &_dual_bank[epnum];
+
+  while ( db->pending )
+  {
+    uint8_t const flag = db->done_bank ? USB_DEVICE_EPINTFLAG_TRCPT1 : USB_DEVICE_EPINTFLAG_TRCPT0;
+    if ( !(ep->EPINTFLAG.reg & flag) ) break;
+    ep->EPINTFLAG.reg = flag;
+
+    uint16_t const total_transfer_size = sram_registers[epnum][db->done_bank].PCKSIZE.bit.BYTE_COUNT;
+
+    // update before notifying, stack may submit the next transfer right away
+    db->done_bank ^= 1u;
+    db->pending--;
+
+    uint8_t const ep_addr = epnum | (db->dir ? TUSB_DIR_IN_MASK : 0);
+    dcd_event_xfer_complete(0, ep_addr, total_transfer_size, XFER_RESULT_SUCCESS, true);
+  }
+}
+
 void maybe_transfer_complete(void) {
   uint32_t epints = USB->DEVICE.EPINTSMRY.reg;
 
@@ -255,6 +437,11 @@ void maybe_transfer_complete(void) {
       continue;
     }
 
+    if (_dual_bank[epnum].enabled) {
+      dual_bank_complete(epnum);
+      continue;
+    }
+
     UsbDeviceEndpoint* ep = &USB->DEVICE.DeviceEndpoint[epnum];
 
     uint32_t epintflag = ep->EPINTFLAG.reg;
@@ -291,7 +478,7 @@ void maybe_transfer_complete(void) {
   }
 }
 
-void USB_Handler(void)
+TU_ATTR_FAST_FUNC void USB_Handler(void)
 {
   uint32_t int_status = USB->DEVICE.INTFLAG.reg & USB->DEVICE.INTENSET.reg;
   USB->DEVICE.INTFLAG.reg = int_status; // clear interrupt
@@ -338,6 +525,8 @@ void USB_Handler(void)
 
   // Handle complete transfer
   maybe_transfer_complete();
+
+  dcd_event_isr_exit(0);
 }
 
 #endif
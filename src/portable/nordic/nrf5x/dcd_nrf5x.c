@@ -43,7 +43,15 @@
 
 // TODO remove later
 #include "device/usbd.h"
-#include "device/usbd_pvt.h" // to use defer function helper
+
+// HFXO (required by USBD) is started on VBUS detected and stopped on removal. While bus is suspended:
+// - 0: kept running, resume has no startup delay. Application may stop it in tud_suspend_cb() but must
+//      then start it again in time, which may be too late from tud_resume_cb() for some hosts.
+// - 1: stopped by driver on suspend (released with SoftDevice) and started again in resume interrupt and
+//      remote wakeup, its startup then overlaps the 20 ms resume signaling.
+#ifndef DCD_NRF5X_HFXO_SUSPEND_STOP
+#  define DCD_NRF5X_HFXO_SUSPEND_STOP  0
+#endif
 
 /*------------------------------------------------------------------*/
 /* MACRO TYPEDEF CONSTANT ENUM
@@ -53,69 +61,110 @@ enum
   // Max allowed by USB specs
   MAX_PACKET_SIZE   = 64,
 
+  // Isochronous endpoint 8, ISO buffer is split in half between IN and OUT (ISOSPLIT)
+  EP_ISO            = 8,
+  ISO_PACKET_MAX    = 512,
+
   // Mask of all END event (IN & OUT) for all endpoints. ENDEPIN0-7, ENDEPOUT0-7, ENDISOIN, ENDISOOUT
   EDPT_END_ALL_MASK = (0xff << USBD_INTEN_ENDEPIN0_Pos) | (0xff << USBD_INTEN_ENDEPOUT0_Pos) |
-                      USBD_INTENCLR_ENDISOIN_Msk | USBD_INTEN_ENDISOOUT_Msk
+                      USBD_INTENCLR_ENDISOIN_Msk | USBD_INTEN_ENDISOOUT_Msk,
+
+  // Pending DMA requests, each endpoint direction and EP0 status has at most one (power of 2)
+  DMA_QUEUE_SIZE    = 32
 };
 
 // Transfer descriptor
 typedef struct
 {
   uint8_t* buffer;
-  uint16_t total_len;
-  volatile uint16_t actual_len;
-  uint8_t  mps; // max packet size
+  uint32_t total_len;
+  volatile uint32_t actual_len;
+  uint16_t mps; // max packet size
+  uint8_t  xact_len; // current CBI IN transaction
 
   // nrf52840 will auto ACK OUT packet after DMA is done
   // indicate packet is already ACK
   volatile bool data_received;
 
+  // Isochronous transfer waits for next SOF to start its DMA
+  volatile bool iso_armed;
+
 } xfer_td_t;
 
 // Data for managing dcd
 static struct
 {
-  // All 8 endpoints including control IN & OUT (offset 1)
-  xfer_td_t xfer[8][2];
+  // All 8 endpoints including control IN & OUT (offset 1), and isochronous endpoint 8
+  xfer_td_t xfer[9][2];
 
-  // Only one DMA can run at a time
+  // Only one DMA can run at a time, others wait in queue (START task register) until it ends
   volatile bool dma_running;
+  volatile uint32_t* dma_queue[DMA_QUEUE_SIZE];
+  uint8_t dma_queue_rd;
+  uint8_t dma_queue_wr;
 }_dcd;
 
 /*------------------------------------------------------------------*/
 /* Control / Bulk / Interrupt (CBI) Transfer
  *------------------------------------------------------------------*/
 
-// helper to start DMA
+static void edpt_dma_end(void);
+static bool hfclk_running(void);
+static void hfclk_enable(void);
+static void hfclk_disable(void);
+
+// Trigger START task of DMA, called with dma_running set
+static void edpt_dma_trigger(volatile uint32_t* reg_startep)
+{
+  (*reg_startep) = 1;
+  __ISB(); __DSB();
+
+  // Control status stage only needs DMA to be idle, there is no ENDED event
+  if ( reg_startep == &NRF_USBD->TASKS_EP0STATUS ) edpt_dma_end();
+}
+
+// helper to start DMA, queued if another one is running
 static void edpt_dma_start(volatile uint32_t* reg_startep)
 {
-  // Only one dma can be active
+  // Both USBD ISR and application thread may start DMA
+  uint32_t const primask = __get_PRIMASK();
+  __disable_irq();
+
   if ( _dcd.dma_running )
   {
-    if (SCB->ICSR & SCB_ICSR_VECTACTIVE_Msk)
-    {
-      // If called within ISR, use usbd task to defer later
-      usbd_defer_func( (osal_task_func_t) edpt_dma_start, (void*) reg_startep, true );
-      return;
-    }
-    else
-    {
-      // Otherwise simply block wait
-      while ( _dcd.dma_running )  { }
-    }
+    // Started by edpt_dma_end() when the running one is complete
+    _dcd.dma_queue[_dcd.dma_queue_wr & (DMA_QUEUE_SIZE-1)] = reg_startep;
+    _dcd.dma_queue_wr++;
+    __set_PRIMASK(primask);
+    return;
   }
 
   _dcd.dma_running = true;
+  __set_PRIMASK(primask);
 
-  (*reg_startep) = 1;
-  __ISB(); __DSB();
+  edpt_dma_trigger(reg_startep);
 }
 
-// DMA is complete
+// DMA is complete, start next pending one if any
 static void edpt_dma_end(void)
 {
   TU_ASSERT(_dcd.dma_running, );
-  _dcd.dma_running = false;
+
+  uint32_t const primask = __get_PRIMASK();
+  __disable_irq();
+
+  if ( _dcd.dma_queue_rd == _dcd.dma_queue_wr )
+  {
+    _dcd.dma_running = false;
+    __set_PRIMASK(primask);
+    return;
+  }
+
+  volatile uint32_t* reg_startep = _dcd.dma_queue[_dcd.dma_queue_rd & (DMA_QUEUE_SIZE-1)];
+  _dcd.dma_queue_rd++;
+  __set_PRIMASK(primask);
+
+  edpt_dma_trigger(reg_startep);
 }
 
 // helper getting td
@@ -161,6 +210,46 @@ static void xact_out_dma(uint8_t epnum)
   xfer->actual_len += xact_len;
 }
 
+/*------------- Isochronous Transfer -------------*/
+
+// Called on SOF: data of ISO OUT received in the previous frame and ISO IN to send in the next one
+// are moved by DMA started here, once per frame. Transfer completes on ENDISOOUT/ENDISOIN.
+static void iso_sof(void)
+{
+  xfer_td_t* xfer = get_td(EP_ISO, TUSB_DIR_OUT);
+
+  if ( xfer->iso_armed )
+  {
+    uint32_t const size = NRF_USBD->SIZE.ISOOUT;
+
+    if ( size & (USBD_SIZE_ISOOUT_SIZE_Msk | USBD_SIZE_ISOOUT_ZERO_Msk) )
+    {
+      xfer->iso_armed = false;
+
+      NRF_USBD->ISOOUT.PTR    = (uint32_t) xfer->buffer;
+      NRF_USBD->ISOOUT.MAXCNT = tu_min32((size & USBD_SIZE_ISOOUT_SIZE_Msk) >> USBD_SIZE_ISOOUT_SIZE_Pos, xfer->total_len);
+      edpt_dma_start(&NRF_USBD->TASKS_STARTISOOUT);
+    }
+    else if ( xfer->total_len )
+    {
+      // Nothing received in last frame
+      xfer->iso_armed = false;
+      dcd_event_xfer_complete(0, EP_ISO, 0, XFER_RESULT_FAILED, true);
+    }
+  }
+
+  xfer = get_td(EP_ISO, TUSB_DIR_IN);
+
+  if ( xfer->iso_armed )
+  {
+    xfer->iso_armed = false;
+
+    NRF_USBD->ISOIN.PTR    = (uint32_t) xfer->buffer;
+    NRF_USBD->ISOIN.MAXCNT = xfer->total_len;
+    edpt_dma_start(&NRF_USBD->TASKS_STARTISOIN);
+  }
+}
+
 /*------------- CBI IN Transfer -------------*/
 
 // Prepare for a CBI transaction IN, call at the start
@@ -170,12 +259,13 @@ static void xact_in_prepare(uint8_t epnum)
   xfer_td_t* xfer = get_td(epnum, TUSB_DIR_IN);
 
   // Each transaction is up to Max Packet Size
-  uint8_t const xact_len = tu_min16(xfer->total_len - xfer->actual_len, xfer->mps);
+  uint8_t const xact_len = (uint8_t) tu_min32(xfer->total_len - xfer->actual_len, xfer->mps);
 
   NRF_USBD->EPIN[epnum].PTR    = (uint32_t) xfer->buffer;
   NRF_USBD->EPIN[epnum].MAXCNT = xact_len;
 
-  xfer->buffer += xact_len;
+  xfer->buffer  += xact_len;
+  xfer->xact_len = xact_len;
 
   edpt_dma_start(&NRF_USBD->TASKS_STARTEPIN[epnum]);
 }
@@ -226,6 +316,12 @@ void dcd_remote_wakeup(uint8_t rhport)
 {
   (void) rhport;
 
+#if DCD_NRF5X_HFXO_SUSPEND_STOP
+  // Resume signaling needs USBD clock
+  hfclk_enable();
+  while ( !hfclk_running() ) { }
+#endif
+
   // Bring controller out of low power mode
   NRF_USBD->LOWPOWER = 0;
 
@@ -237,6 +333,22 @@ void dcd_remote_wakeup(uint8_t rhport)
   // We may manually raise DCD_EVENT_RESUME event here
 }
 
+void dcd_get_caps(uint8_t rhport, dcd_caps_t* caps)
+{
+  (void) rhport;
+
+  // EasyDMA moves each packet, next one is started by isr
+  caps->max_xfer_bytes = UINT32_MAX;
+  caps->dma            = 1;
+  caps->iso            = 1;
+}
+
+uint32_t dcd_frame_number(uint8_t rhport)
+{
+  (void) rhport;
+  return NRF_USBD->FRAMECNTR;
+}
+
 //--------------------------------------------------------------------+
 // Endpoint API
 //--------------------------------------------------------------------+
@@ -247,9 +359,28 @@ bool dcd_edpt_open (uint8_t rhport, tusb_desc_endpoint_t const * desc_edpt)
   uint8_t const epnum = tu_edpt_number(desc_edpt->bEndpointAddress);
   uint8_t const dir   = tu_edpt_dir(desc_edpt->bEndpointAddress);
 
+  // Isochronous is only available on dedicated endpoint 8 (ISOIN/ISOOUT EasyDMA started by SOF)
+  TU_ASSERT((desc_edpt->bmAttributes.xfer == TUSB_XFER_ISOCHRONOUS) == (epnum == EP_ISO));
+
   _dcd.xfer[epnum][dir].mps = desc_edpt->wMaxPacketSize.size;
 
-  if ( dir == TUSB_DIR_OUT )
+  if ( epnum == EP_ISO )
+  {
+    TU_ASSERT(desc_edpt->wMaxPacketSize.size <= ISO_PACKET_MAX);
+
+    // Reply zero-length packet when there is no data for a frame
+    if ( dir == TUSB_DIR_IN ) NRF_USBD->ISOINCONFIG = USBD_ISOINCONFIG_RESPONSE_ZeroData << USBD_ISOINCONFIG_RESPONSE_Pos;
+
+    NRF_USBD->INTENSET = USBD_INTEN_SOF_Msk | ((dir == TUSB_DIR_OUT) ? USBD_INTEN_ENDISOOUT_Msk : USBD_INTEN_ENDISOIN_Msk);
+    if ( dir == TUSB_DIR_OUT )
+    {
+      NRF_USBD->EPOUTEN |= USBD_EPOUTEN_ISOOUT_Msk;
+    }else
+    {
+      NRF_USBD->EPINEN  |= USBD_EPINEN_ISOIN_Msk;
+    }
+  }
+  else if ( dir == TUSB_DIR_OUT )
   {
     NRF_USBD->INTENSET = TU_BIT(USBD_INTEN_ENDEPOUT0_Pos + epnum);
     NRF_USBD->EPOUTEN |= TU_BIT(epnum);
@@ -263,7 +394,7 @@ bool dcd_edpt_open (uint8_t rhport, tusb_desc_endpoint_t const * desc_edpt)
   return true;
 }
 
-bool dcd_edpt_xfer (uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint16_t total_bytes)
+bool dcd_edpt_xfer (uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint32_t total_bytes)
 {
   (void) rhport;
 
@@ -276,12 +407,17 @@ bool dcd_edpt_xfer (uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint16_t
   xfer->total_len  = total_bytes;
   xfer->actual_len = 0;
 
+  if ( epnum == EP_ISO )
+  {
+    // One packet per frame, its DMA is started by SOF
+    TU_ASSERT(total_bytes <= xfer->mps);
+    xfer->iso_armed = true;
+  }
   // Control endpoint with zero-length packet --> status stage
-  if ( epnum == 0 && total_bytes == 0 )
+  else if ( epnum == 0 && total_bytes == 0 )
   {
     // Status Phase also require Easy DMA has to be free as well !!!!
     edpt_dma_start(&NRF_USBD->TASKS_EP0STATUS);
-    edpt_dma_end();
 
     // The nRF doesn't interrupt on status transmit so we queue up a success response.
     dcd_event_xfer_complete(0, ep_addr, 0, XFER_RESULT_SUCCESS, false);
@@ -357,7 +493,7 @@ void bus_reset(void)
   _dcd.xfer[0][TUSB_DIR_OUT].mps = MAX_PACKET_SIZE;
 }
 
-void USBD_IRQHandler(void)
+TU_ATTR_FAST_FUNC void USBD_IRQHandler(void)
 {
   uint32_t const inten  = NRF_USBD->INTEN;
   uint32_t int_status = 0;
@@ -382,8 +518,65 @@ void USBD_IRQHandler(void)
     dcd_event_bus_signal(0, DCD_EVENT_BUS_RESET, true);
   }
 
+  // Free DMA first so that the next one (queued or prepared below) starts as early as possible
+  if ( int_status & EDPT_END_ALL_MASK )
+  {
+    // DMA complete move data from SRAM -> Endpoint
+    edpt_dma_end();
+  }
+
+  // EP0DATADONE is set with either Control Out on IN Data
+  // Since EPDATASTATUS cannot be used to determine whether it is control OUT or IN.
+  // We will use BMREQUESTTYPE in setup packet to determine the direction
+  uint32_t data_status = 0;
+  bool is_control_in  = false;
+  bool is_control_out = false;
+
+  if ( int_status & (USBD_INTEN_EPDATA_Msk | USBD_INTEN_EP0DATADONE_Msk) )
+  {
+    data_status = NRF_USBD->EPDATASTATUS;
+    NRF_USBD->EPDATASTATUS = data_status;
+    __ISB(); __DSB();
+
+    is_control_in  = (int_status & USBD_INTEN_EP0DATADONE_Msk) && (NRF_USBD->BMREQUESTTYPE & TUSB_DIR_IN_MASK);
+    is_control_out = (int_status & USBD_INTEN_EP0DATADONE_Msk) && !(NRF_USBD->BMREQUESTTYPE & TUSB_DIR_IN_MASK);
+  }
+
+  // CBI In: Endpoint -> Host (transaction complete), next packet DMA is started before other events
+  for(uint8_t epnum=0; epnum<8; epnum++)
+  {
+    if ( tu_bit_test(data_status, epnum ) || ( epnum == 0 && is_control_in) )
+    {
+      xfer_td_t* xfer = get_td(epnum, TUSB_DIR_IN);
+
+      xfer->actual_len += xfer->xact_len;
+
+      if ( xfer->actual_len < xfer->total_len )
+      {
+        // prepare next transaction
+        xact_in_prepare(epnum);
+      } else
+      {
+        // CBI IN complete
+        dcd_event_xfer_complete(0, epnum | TUSB_DIR_IN_MASK, xfer->actual_len, XFER_RESULT_SUCCESS, true);
+      }
+    }
+  }
+
+  // Isochronous: DMA of this frame's packet is complete
+  if ( int_status & USBD_INTEN_ENDISOIN_Msk )
+  {
+    dcd_event_xfer_complete(0, EP_ISO | TUSB_DIR_IN_MASK, NRF_USBD->ISOIN.AMOUNT, XFER_RESULT_SUCCESS, true);
+  }
+
+  if ( int_status & USBD_INTEN_ENDISOOUT_Msk )
+  {
+    dcd_event_xfer_complete(0, EP_ISO, NRF_USBD->ISOOUT.AMOUNT, XFER_RESULT_SUCCESS, true);
+  }
+
   if ( int_status & USBD_INTEN_SOF_Msk )
   {
+    iso_sof();
     dcd_event_bus_signal(0, DCD_EVENT_SOF, true);
   }
 
@@ -399,21 +592,22 @@ void USBD_IRQHandler(void)
       // Put controller into low power mode
       NRF_USBD->LOWPOWER = 1;
 
-      // Leave HFXO disable to application, since it may be used by other
+#if DCD_NRF5X_HFXO_SUSPEND_STOP
+      hfclk_disable();
+#endif
+      // Otherwise leave HFXO disable to application, since it may be used by other
     }
 
     if ( evt_cause & USBD_EVENTCAUSE_RESUME_Msk  )
     {
+#if DCD_NRF5X_HFXO_SUSPEND_STOP
+      // Start it right away rather than from tud_resume_cb() later in task
+      hfclk_enable();
+#endif
       dcd_event_bus_signal(0, DCD_EVENT_RESUME , true);
     }
   }
 
-  if ( int_status & EDPT_END_ALL_MASK )
-  {
-    // DMA complete move data from SRAM -> Endpoint
-    edpt_dma_end();
-  }
- 
   // Setup tokens are specific to the Control endpoint.
   if ( int_status & USBD_INTEN_EP0SETUP_Msk )
   {
@@ -493,59 +687,26 @@ void USBD_IRQHandler(void)
     // Ended event for CBI IN : nothing to do
   }
 
-  // Endpoint <-> Host
-  if ( int_status & (USBD_INTEN_EPDATA_Msk | USBD_INTEN_EP0DATADONE_Msk) )
+  // CBI OUT: Host -> Endpoint
+  for(uint8_t epnum=0; epnum<8; epnum++)
   {
-    uint32_t data_status = NRF_USBD->EPDATASTATUS;
-    NRF_USBD->EPDATASTATUS = data_status;
-    __ISB(); __DSB();
-
-    // EP0DATADONE is set with either Control Out on IN Data
-    // Since EPDATASTATUS cannot be used to determine whether it is control OUT or IN.
-    // We will use BMREQUESTTYPE in setup packet to determine the direction
-    bool const is_control_in = (int_status & USBD_INTEN_EP0DATADONE_Msk) && (NRF_USBD->BMREQUESTTYPE & TUSB_DIR_IN_MASK);
-    bool const is_control_out = (int_status & USBD_INTEN_EP0DATADONE_Msk) && !(NRF_USBD->BMREQUESTTYPE & TUSB_DIR_IN_MASK);
-
-    // CBI In: Endpoint -> Host (transaction complete)
-    for(uint8_t epnum=0; epnum<8; epnum++)
+    if ( tu_bit_test(data_status, 16+epnum ) || ( epnum == 0 && is_control_out) )
     {
-      if ( tu_bit_test(data_status, epnum ) || ( epnum == 0 && is_control_in) )
-      {
-        xfer_td_t* xfer = get_td(epnum, TUSB_DIR_IN);
-
-        xfer->actual_len += NRF_USBD->EPIN[epnum].MAXCNT;
-
-        if ( xfer->actual_len < xfer->total_len )
-        {
-          // prepare next transaction
-          xact_in_prepare(epnum);
-        } else
-        {
-          // CBI IN complete
-          dcd_event_xfer_complete(0, epnum | TUSB_DIR_IN_MASK, xfer->actual_len, XFER_RESULT_SUCCESS, true);
-        }
-      }
-    }
+      xfer_td_t* xfer = get_td(epnum, TUSB_DIR_OUT);
 
-    // CBI OUT: Host -> Endpoint
-    for(uint8_t epnum=0; epnum<8; epnum++)
-    {
-      if ( tu_bit_test(data_status, 16+epnum ) || ( epnum == 0 && is_control_out) )
+      if (xfer->actual_len < xfer->total_len)
       {
-        xfer_td_t* xfer = get_td(epnum, TUSB_DIR_OUT);
-
-        if (xfer->actual_len < xfer->total_len)
-        {
-          xact_out_dma(epnum);
-        }else
-        {
-          // Data overflow !!! Nah, nrf52840 will auto ACK OUT packet after DMA is done
-          // Mark this endpoint with data received
-          xfer->data_received = true;
-        }
+        xact_out_dma(epnum);
+      }else
+      {
+        // Data overflow !!! Nah, nrf52840 will auto ACK OUT packet after DMA is done
+        // Mark this endpoint with data received
+        xfer->data_received = true;
       }
     }
   }
+
+  dcd_event_isr_exit(0);
 }
 
 //--------------------------------------------------------------------+
@@ -37,6 +37,22 @@
 //--------------------------------------------------------------------+
 #define DCD_ENDPOINT_MAX 32
 
+// DMA descriptors shared by non-control endpoints, one per transfer. Transfers submitted while the
+// endpoint is busy are chained behind, so that DMA engine moves on without waiting for the isr.
+#ifndef DCD_DD_COUNT
+#define DCD_DD_COUNT     16
+#endif
+
+#define DD_NONE          0xFF
+
+TU_VERIFY_STATIC( DCD_DD_COUNT < DD_NONE, "dd is indexed by uint8_t");
+
+// Isochronous packet length array entry
+enum {
+  ISO_PACKET_LENGTH_MASK = TU_BIT(16)-1,
+  ISO_PACKET_VALID_MASK  = TU_BIT(16)
+};
+
 typedef struct TU_ATTR_ALIGNED(4)
 {
   //------------- Word 0 -------------//
@@ -67,18 +83,31 @@ typedef struct TU_ATTR_ALIGNED(4)
                                     // For iso : number of packets
 
   //------------- Word 4 -------------//
-  //	uint32_t iso_packet_size_addr;		// iso only, can be omitted for non-iso
+  uint32_t iso_packet_size_addr; // iso only, ignored for non-iso
 }dma_desc_t;
 
-TU_VERIFY_STATIC( sizeof(dma_desc_t) == 16, "size is not correct"); // TODO not support ISO for now
+TU_VERIFY_STATIC( sizeof(dma_desc_t) == 20, "size is not correct");
 
 typedef struct
 {
   // must be 128 byte aligned
   volatile dma_desc_t* udca[DCD_ENDPOINT_MAX];
 
-  // TODO DMA does not support control transfer (0-1 are not used, offset to reduce memory)
-  dma_desc_t dd[DCD_ENDPOINT_MAX];
+  // DMA does not support control transfer
+  dma_desc_t dd[DCD_DD_COUNT];
+
+  // Packet length array of iso descriptor, one packet per transfer
+  uint32_t iso_packet_size[DCD_DD_COUNT];
+
+  uint8_t dd_ep[DCD_DD_COUNT]; // endpoint owning the descriptor, DD_NONE if free
+
+  struct
+  {
+    uint8_t  dd_head; // oldest descriptor not yet completed, DD_NONE if endpoint is idle
+    uint8_t  dd_tail; // last descriptor of the chain
+    uint16_t max_packet_size : 11;
+    uint16_t isochronous     : 1;
+  } ep[DCD_ENDPOINT_MAX];
 
   struct
   {
@@ -164,6 +193,12 @@ static void bus_reset(void)
   LPC_USB->SysErrIntClr = 0xFFFFFFFF;
 
   tu_memclr(&_dcd, sizeof(dcd_data_t));
+
+  memset(_dcd.dd_ep, DD_NONE, sizeof(_dcd.dd_ep));
+  for(uint8_t ep_id = 0; ep_id < DCD_ENDPOINT_MAX; ep_id++)
+  {
+    _dcd.ep[ep_id].dd_head = _dcd.ep[ep_id].dd_tail = DD_NONE;
+  }
 }
 
 void dcd_init(uint8_t rhport)
@@ -179,7 +214,7 @@ void dcd_init(uint8_t rhport)
 
   LPC_USB->DevIntEn = (DEV_INT_DEVICE_STATUS_MASK | DEV_INT_ENDPOINT_FAST_MASK | DEV_INT_ENDPOINT_SLOW_MASK | DEV_INT_ERROR_MASK);
   LPC_USB->UDCAH = (uint32_t) _dcd.udca;
-  LPC_USB->DMAIntEn = (DMA_INT_END_OF_XFER_MASK /*| DMA_INT_NEW_DD_REQUEST_MASK*/ | DMA_INT_ERROR_MASK);
+  LPC_USB->DMAIntEn = (DMA_INT_END_OF_XFER_MASK | DMA_INT_NEW_DD_REQUEST_MASK | DMA_INT_ERROR_MASK);
 
   sie_write(SIE_CMDCODE_DEVICE_STATUS, 1, 1);    // connect
 
@@ -219,6 +254,32 @@ void dcd_remote_wakeup(uint8_t rhport)
   (void) rhport;
 }
 
+void dcd_get_caps(uint8_t rhport, dcd_caps_t* caps)
+{
+  (void) rhport;
+
+  // DMA descriptor buffer length is 16-bit, bulk & iso endpoints are double buffered by hardware
+  caps->max_xfer_bytes = UINT16_MAX;
+  caps->multi_packet   = 1;
+  caps->dma            = 1;
+  caps->double_buffer  = 1;
+  caps->iso            = 1;
+}
+
+uint32_t dcd_frame_number(uint8_t rhport)
+{
+  // 2 data bytes LSB first, isr must not issue SIE command in between
+  dcd_int_disable(rhport);
+  sie_cmd_code(SIE_CMDPHASE_COMMAND, SIE_CMDCODE_READ_FRAME_NUMBER);
+  sie_cmd_code(SIE_CMDPHASE_READ   , SIE_CMDCODE_READ_FRAME_NUMBER);
+  uint32_t frame = LPC_USB->CmdData & 0xffu;
+  sie_cmd_code(SIE_CMDPHASE_READ   , SIE_CMDCODE_READ_FRAME_NUMBER);
+  frame |= (LPC_USB->CmdData & 0xffu) << 8;
+  dcd_int_enable(rhport);
+
+  return frame & 0x7ffu;
+}
+
 //--------------------------------------------------------------------+
 // CONTROL HELPER
 //--------------------------------------------------------------------+
@@ -270,6 +331,79 @@ static uint8_t control_ep_read(void * buffer, uint8_t len)
   return len;
 }
 
+//--------------------------------------------------------------------+
+// DMA DESCRIPTOR HELPER
+//--------------------------------------------------------------------+
+static uint8_t dd_alloc(uint8_t ep_id)
+{
+  for(uint8_t i=0; i<DCD_DD_COUNT; i++)
+  {
+    if ( _dcd.dd_ep[i] == DD_NONE )
+    {
+      _dcd.dd_ep[i] = ep_id;
+      return i;
+    }
+  }
+  return DD_NONE;
+}
+
+static inline uint8_t dd_idx(uint32_t next)
+{
+  return (uint8_t) (((dma_desc_t*) next) - _dcd.dd);
+}
+
+// Stop DMA and release all descriptors of the endpoint
+static void dd_flush(uint8_t ep_id)
+{
+  LPC_USB->EpDMADis = TU_BIT(ep_id);
+  _dcd.udca[ep_id]  = NULL;
+
+  for(uint8_t i=0; i<DCD_DD_COUNT; i++)
+  {
+    if ( _dcd.dd_ep[i] == ep_id ) _dcd.dd_ep[i] = DD_NONE;
+  }
+  _dcd.ep[ep_id].dd_head = _dcd.ep[ep_id].dd_tail = DD_NONE;
+}
+
+// Point endpoint to descriptor and enable its DMA
+static void dd_start(uint8_t ep_id, dma_desc_t* dd)
+{
+  _dcd.udca[ep_id] = dd;
+
+  if ( ep_id % 2 )
+  {
+    LPC_USB->EpDMAEn = TU_BIT(ep_id);
+
+    // endpoint IN need to actively raise DMA request
+    LPC_USB->DMARSet = TU_BIT(ep_id);
+  }else
+  {
+    // Enable DMA
+    LPC_USB->EpDMAEn = TU_BIT(ep_id);
+  }
+}
+
+// DMA engine disables endpoint when it retires the last descriptor before a new one is linked,
+// restart it with the first descriptor that is not serviced yet
+static void dd_restart(uint8_t ep_id)
+{
+  if ( tu_bit_test(LPC_USB->EpDMASt, ep_id) ) return;
+
+  uint8_t idx = _dcd.ep[ep_id].dd_head;
+  while ( idx != DD_NONE )
+  {
+    dma_desc_t* dd = &_dcd.dd[idx];
+    if ( !dd->retired )
+    {
+      if ( dd->status == DD_STATUS_NOT_SERVICED ) dd_start(ep_id, dd);
+      return;
+    }
+
+    if ( (idx == _dcd.ep[ep_id].dd_tail) || !dd->next_valid ) return;
+    idx = dd_idx(dd->next);
+  }
+}
+
 //--------------------------------------------------------------------+
 // DCD Endpoint Port
 //--------------------------------------------------------------------+
@@ -303,13 +437,11 @@ bool dcd_edpt_open(uint8_t rhport, tusb_desc_endpoint_t const * p_endpoint_desc)
   //------------- Realize Endpoint with Max Packet Size -------------//
   set_ep_size(ep_id, p_endpoint_desc->wMaxPacketSize.size);
 
-  //------------- first DD prepare -------------//
-  dma_desc_t* const dd = &_dcd.dd[ep_id];
-  tu_memclr(dd, sizeof(dma_desc_t));
+  // descriptors left from previous configuration
+  dd_flush(ep_id);
 
-  dd->isochronous = (p_endpoint_desc->bmAttributes.xfer == TUSB_XFER_ISOCHRONOUS) ? 1 : 0;
-  dd->max_packet_size = p_endpoint_desc->wMaxPacketSize.size;
-  dd->retired = 1; // invalid at first
+  _dcd.ep[ep_id].isochronous     = (p_endpoint_desc->bmAttributes.xfer == TUSB_XFER_ISOCHRONOUS) ? 1 : 0;
+  _dcd.ep[ep_id].max_packet_size = p_endpoint_desc->wMaxPacketSize.size;
 
   sie_write(SIE_CMDCODE_ENDPOINT_SET_STATUS + ep_id, 1, 0);    // clear all endpoint status
 
@@ -335,6 +467,9 @@ void dcd_edpt_clear_stall(uint8_t rhport, uint8_t ep_addr)
   (void) rhport;
   uint8_t ep_id = ep_addr2idx(ep_addr);
 
+  // stack drops transfers of a stalled endpoint
+  if ( tu_edpt_number(ep_addr) ) dd_flush(ep_id);
+
   sie_write(SIE_CMDCODE_ENDPOINT_SET_STATUS+ep_id, 1, 0);
 }
 
@@ -367,8 +502,11 @@ static bool control_xact(uint8_t rhport, uint8_t dir, uint8_t * buffer, uint8_t
   return true;
 }
 
-bool dcd_edpt_xfer (uint8_t rhport, uint8_t ep_addr, uint8_t* buffer, uint16_t total_bytes)
+bool dcd_edpt_xfer (uint8_t rhport, uint8_t ep_addr, uint8_t* buffer, uint32_t total_bytes)
 {
+  // DMA descriptor buffer length is 16-bit
+  TU_ASSERT(total_bytes <= UINT16_MAX);
+
   // Control transfer is not DMA support, and must be done in slave mode
   if ( tu_edpt_number(ep_addr) == 0 )
   {
@@ -376,40 +514,63 @@ bool dcd_edpt_xfer (uint8_t rhport, uint8_t ep_addr, uint8_t* buffer, uint16_t t
   }
   else
   {
-    uint8_t ep_id = ep_addr2idx(ep_addr);
-    dma_desc_t* dd = &_dcd.dd[ep_id];
+    uint8_t const ep_id = ep_addr2idx(ep_addr);
+    bool const is_iso = _dcd.ep[ep_id].isochronous;
+
+    // Isochronous transfer is a single packet sent/received in a frame
+    if ( is_iso ) TU_ASSERT(total_bytes <= _dcd.ep[ep_id].max_packet_size);
 
-    // Prepare DMA descriptor
-    // Isochronous & max packet size must be preserved, Other fields of dd should be clear
-    uint16_t const ep_size = dd->max_packet_size;
-    uint8_t  is_iso = dd->isochronous;
+    uint8_t const idx = dd_alloc(ep_id);
+    TU_ASSERT(idx != DD_NONE);
 
+    dma_desc_t* dd = &_dcd.dd[idx];
     tu_memclr(dd, sizeof(dma_desc_t));
-    dd->isochronous = is_iso;
-    dd->max_packet_size = ep_size;
-    dd->buffer = (uint32_t) buffer;
-    dd->buflen = total_bytes;
+    dd->isochronous     = is_iso;
+    dd->max_packet_size = _dcd.ep[ep_id].max_packet_size;
+    dd->buffer          = (uint32_t) buffer;
 
-    _dcd.udca[ep_id] = dd;
+    if ( is_iso )
+    {
+      // buflen is number of packets, length is in packet length array: set for IN, written by DMA for OUT
+      _dcd.iso_packet_size[idx] = total_bytes;
+      dd->buflen                = 1;
+      dd->iso_packet_size_addr  = (uint32_t) &_dcd.iso_packet_size[idx];
+    }else
+    {
+      dd->buflen = (uint16_t) total_bytes;
+    }
 
-    if ( ep_id % 2 )
+    if ( _dcd.ep[ep_id].dd_head == DD_NONE )
     {
+      _dcd.ep[ep_id].dd_head = _dcd.ep[ep_id].dd_tail = idx;
+
       // Clear EP interrupt before Enable DMA
-      LPC_USB->EpIntEn &= ~TU_BIT(ep_id);
-      LPC_USB->EpDMAEn = TU_BIT(ep_id);
+      if ( ep_id % 2 ) LPC_USB->EpIntEn &= ~TU_BIT(ep_id);
 
-      // endpoint IN need to actively raise DMA request
-      LPC_USB->DMARSet = TU_BIT(ep_id);
+      dd_start(ep_id, dd);
     }else
     {
-      // Enable DMA
-      LPC_USB->EpDMAEn = TU_BIT(ep_id);
+      // chain behind the last descriptor, DMA engine fetches it when that one is retired
+      dma_desc_t* tail = &_dcd.dd[_dcd.ep[ep_id].dd_tail];
+      tail->next       = (uint32_t) dd;
+      tail->next_valid = 1;
+      _dcd.ep[ep_id].dd_tail = idx;
+
+      // last descriptor may be retired before the link was seen
+      dd_restart(ep_id);
     }
 
     return true;
   }
 }
 
+// Descriptor is chained to the one in progress
+bool dcd_edpt_xfer_append(uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint32_t total_bytes)
+{
+  TU_VERIFY(tu_edpt_number(ep_addr));
+  return dcd_edpt_xfer(rhport, ep_addr, buffer, total_bytes);
+}
+
 //--------------------------------------------------------------------+
 // ISR
 //--------------------------------------------------------------------+
@@ -484,18 +645,57 @@ static void bus_event_isr(uint8_t rhport)
   }
 }
 
-// Helper to complete a DMA descriptor for non-control transfer
+// Helper to complete the oldest DMA descriptor of non-control endpoint
 static void dd_complete_isr(uint8_t rhport, uint8_t ep_id)
 {
-  dma_desc_t* const dd = &_dcd.dd[ep_id];
+  uint8_t const idx = _dcd.ep[ep_id].dd_head;
+  dma_desc_t* const dd = &_dcd.dd[idx];
   uint8_t result = (dd->status == DD_STATUS_NORMAL || dd->status == DD_STATUS_DATA_UNDERUN) ? XFER_RESULT_SUCCESS : XFER_RESULT_FAILED;
   uint8_t const ep_addr = (ep_id / 2) | ((ep_id & 0x01) ? TUSB_DIR_IN_MASK : 0);
 
-  dcd_event_xfer_complete(rhport, ep_addr, dd->present_count, result, true);
+  // present_count is number of packets for iso
+  uint32_t xferred_bytes = dd->present_count;
+  if ( dd->isochronous )
+  {
+    uint32_t const packet = _dcd.iso_packet_size[idx];
+    bool const valid = (ep_id & 0x01) ? (dd->present_count != 0) : (packet & ISO_PACKET_VALID_MASK);
+    xferred_bytes = valid ? (packet & ISO_PACKET_LENGTH_MASK) : 0;
+  }
+
+  if ( idx == _dcd.ep[ep_id].dd_tail )
+  {
+    _dcd.ep[ep_id].dd_head = _dcd.ep[ep_id].dd_tail = DD_NONE;
+  }else
+  {
+    _dcd.ep[ep_id].dd_head = dd_idx(dd->next);
+  }
+  _dcd.dd_ep[idx] = DD_NONE;
+
+  dcd_event_xfer_complete(rhport, ep_addr, xferred_bytes, result, true);
+}
+
+// Complete retired descriptors of endpoint in order
+static void dd_retire_isr(uint8_t rhport, uint8_t ep_id)
+{
+  while ( _dcd.ep[ep_id].dd_head != DD_NONE )
+  {
+    uint8_t const idx = _dcd.ep[ep_id].dd_head;
+    if ( !_dcd.dd[idx].retired ) break;
+
+    // IN: data of the last descriptor is still on-going -> enable EpIntEn to know when it is complete.
+    // With more descriptors chained behind, data already sits in endpoint buffer and completes now.
+    if ( (ep_id & 0x01) && (idx == _dcd.ep[ep_id].dd_tail) )
+    {
+      LPC_USB->EpIntEn |= TU_BIT(ep_id);
+      break;
+    }
+
+    dd_complete_isr(rhport, ep_id);
+  }
 }
 
 // main USB IRQ handler
-void dcd_isr(uint8_t rhport)
+TU_ATTR_FAST_FUNC void dcd_isr(uint8_t rhport)
 {
   uint32_t const dev_int_status = LPC_USB->DevIntSt & LPC_USB->DevIntEn;
   LPC_USB->DevIntClr = dev_int_status;// Acknowledge handled interrupt
@@ -529,7 +729,11 @@ void dcd_isr(uint8_t rhport)
         // Clear Ep interrupt for next DMA
         LPC_USB->EpIntEn &= ~TU_BIT(ep_id);
 
-        dd_complete_isr(rhport, ep_id);
+        uint8_t const idx = _dcd.ep[ep_id].dd_head;
+        if ( (idx != DD_NONE) && _dcd.dd[idx].retired ) dd_complete_isr(rhport, ep_id);
+
+        // descriptors chained after the last EoT
+        dd_retire_isr(rhport, ep_id);
       }
     }
   }
@@ -545,18 +749,19 @@ void dcd_isr(uint8_t rhport)
 
     for ( uint8_t ep_id = 2; ep_id < DCD_ENDPOINT_MAX; ep_id++ )
     {
-      if ( tu_bit_test(eot, ep_id) )
-      {
-        if ( ep_id & 0x01 )
-        {
-          // IN enable EpInt for end of usb transfer
-          LPC_USB->EpIntEn |= TU_BIT(ep_id);
-        }else
-        {
-          // OUT
-          dd_complete_isr(rhport, ep_id);
-        }
-      }
+      if ( tu_bit_test(eot, ep_id) ) dd_retire_isr(rhport, ep_id);
+    }
+  }
+
+  // DMA engine found no valid descriptor e.g the last one retired before a new one was chained
+  if (dma_int_status & DMA_INT_NEW_DD_REQUEST_MASK)
+  {
+    uint32_t const nddr = LPC_USB->NDDRIntSt;
+    LPC_USB->NDDRIntClr = nddr;
+
+    for ( uint8_t ep_id = 2; ep_id < DCD_ENDPOINT_MAX; ep_id++ )
+    {
+      if ( tu_bit_test(nddr, ep_id) ) dd_restart(ep_id);
     }
   }
 
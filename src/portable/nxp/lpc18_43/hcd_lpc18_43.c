@@ -29,6 +29,7 @@
 #if TUSB_OPT_HOST_ENABLED && (CFG_TUSB_MCU == OPT_MCU_LPC18XX || CFG_TUSB_MCU == OPT_MCU_LPC43XX)
 
 #include "chip.h"
+#include "host/hcd.h"
 
 // LPC18xx and 43xx use EHCI driver
 
@@ -47,4 +48,35 @@ uint32_t hcd_ehci_register_addr(uint8_t rhport)
   return (uint32_t) (rhport ? &LPC_USB1->USBCMD_H : &LPC_USB0->USBCMD_H );
 }
 
+#if TUSB_OPT_DUAL_ROLE
+
+enum {
+  USBCMD_RESET    = TU_BIT(1),
+  USBMODE_HOST    = 3,
+  USBMODE_VBUS_PS = TU_BIT(5), ///< VBUS power select, drive VBUS
+  OTGSC_ID_PULLUP = TU_BIT(5),
+  OTGSC_ID        = TU_BIT(8), ///< 0 = A device, 1 = B Device
+};
+
+void hcd_ehci_role_host(uint8_t rhport)
+{
+  LPC_USBHS_T* const usb = rhport ? LPC_USB1 : LPC_USB0;
+
+  // reset clears device mode, USBMODE can only be written once after reset
+  usb->USBCMD_H |= USBCMD_RESET;
+  while ( usb->USBCMD_H & USBCMD_RESET ) {}
+
+  usb->USBMODE_H = USBMODE_HOST | USBMODE_VBUS_PS;
+}
+
+bool hcd_otg_id_is_host(uint8_t rhport)
+{
+  LPC_USBHS_T* const usb = rhport ? LPC_USB1 : LPC_USB0;
+
+  usb->OTGSC |= OTGSC_ID_PULLUP;
+  return !(usb->OTGSC & OTGSC_ID);
+}
+
+#endif
+
 #endif
@@ -75,6 +75,23 @@
 // Used to set DATABUFSTART which is 22-bit aligned
 // 2000 0000 to 203F FFFF
 #define SRAM_REGION   0x20000000
+#define SRAM_REGION_SIZE  (4u*1024*1024)
+
+// Per endpoint staging buffer (multiple of 64) for transfer buffers that are out of SRAM_REGION or
+// not 64-byte aligned. Set to 0 to save RAM when all class buffers are placed by CFG_TUSB_MEM_SECTION.
+#ifndef DCD_LPC_BOUNCE_SIZE
+#define DCD_LPC_BOUNCE_SIZE   64
+#endif
+
+TU_VERIFY_STATIC( (DCD_LPC_BOUNCE_SIZE % 64) == 0, "bounce buffer must be multiple of 64" );
+
+// Bulk endpoints (bitmask of endpoint numbers) using both command/status entries, so that controller
+// moves to the other buffer without waiting for the isr to re-arm
+#ifndef DCD_LPC_DOUBLE_BUFFER_EP
+#define DCD_LPC_DOUBLE_BUFFER_EP  0u
+#endif
+
+TU_VERIFY_STATIC( ((DCD_LPC_DOUBLE_BUFFER_EP) & 1u) == 0, "Control endpoint can not be double-buffered" );
 
 /* Although device controller are the same. Somehow only LPC134x can execute
  * DMA with 1023 bytes for Bulk/Control. Others (11u, 51u, 54xxx) can only work
@@ -88,6 +105,11 @@ enum {
   #endif
 };
 
+// Double buffer chunk must be multiple of 64 since offset of the second buffer is computed
+enum {
+  DBUF_NBYTES_MAX = DMA_NBYTES_MAX & ~0x3fu
+};
+
 enum {
   INT_SOF_MASK           = TU_BIT(30),
   INT_DEVICE_STATUS_MASK = TU_BIT(31)
@@ -123,23 +145,37 @@ TU_VERIFY_STATIC( sizeof(ep_cmd_sts_t) == 4, "size is not correct" );
 
 typedef struct
 {
-  uint16_t total_bytes;
-  uint16_t xferred_bytes;
+  uint32_t total_bytes;
+  uint32_t xferred_bytes;
 
   uint16_t nbytes;
+
+  uint8_t* bounce; // user buffer staged through bounce buffer, NULL if used directly
+
+  // double buffering
+  uint8_t  buf_idx;         // entry of the transaction in progress (next to complete)
+  uint8_t  armed;           // number of entries armed, 2 when both buffers are in use
+  bool     dbuf;            // transfer is split across both entries
+  uint16_t buf_offset;      // of the user buffer
+  uint32_t armed_bytes;     // bytes given to entries so far
+  uint16_t dbuf_nbytes[2];  // nbytes armed in each entry
 }xfer_dma_t;
 
 // NOTE data will be transferred as soon as dcd get request by dcd_pipe(_queue)_xfer using double buffering.
 // current_td is used to keep track of number of remaining & xferred bytes of the current request.
 typedef struct
 {
-  // 256 byte aligned, 2 for double buffer (not used)
+  // 256 byte aligned, 2 for double buffer
   // Each cmd_sts can only transfer up to DMA_NBYTES_MAX bytes each
   ep_cmd_sts_t ep[EP_COUNT][2];
 
   xfer_dma_t dma[EP_COUNT];
 
   TU_ATTR_ALIGNED(64) uint8_t setup_packet[8];
+
+#if DCD_LPC_BOUNCE_SIZE
+  TU_ATTR_ALIGNED(64) uint8_t bounce[EP_COUNT][DCD_LPC_BOUNCE_SIZE];
+#endif
 }dcd_data_t;
 
 //--------------------------------------------------------------------+
@@ -156,6 +192,13 @@ static inline uint16_t get_buf_offset(void const * buffer)
   return ( (addr >> 6) & 0xFFFFUL ) ;
 }
 
+// Buffer can be accessed by controller through DATABUFSTART
+static inline bool buf_in_region(void const * buffer)
+{
+  uint32_t addr = (uint32_t) buffer;
+  return ((addr & 0x3f) == 0) && ((addr - SRAM_REGION) < SRAM_REGION_SIZE);
+}
+
 static inline uint8_t ep_addr2id(uint8_t endpoint_addr)
 {
   return 2*(endpoint_addr & 0x0F) + ((endpoint_addr & TUSB_DIR_IN_MASK) ? 1 : 0);
@@ -211,6 +254,26 @@ void dcd_remote_wakeup(uint8_t rhport)
   (void) rhport;
 }
 
+void dcd_get_caps(uint8_t rhport, dcd_caps_t* caps)
+{
+  (void) rhport;
+
+  // each command/status entry moves up to DMA_NBYTES_MAX, isr re-arms for the rest
+  caps->max_xfer_bytes = UINT32_MAX;
+  caps->multi_packet   = (DMA_NBYTES_MAX > 64);
+  caps->dma            = 1;
+  caps->double_buffer  = (DCD_LPC_DOUBLE_BUFFER_EP != 0);
+  caps->iso            = 1;
+}
+
+uint32_t dcd_frame_number(uint8_t rhport)
+{
+  (void) rhport;
+
+  // INFO bit 10:0 is FRAME_NR
+  return DCD_REGS->INFO & 0x7ffu;
+}
+
 //--------------------------------------------------------------------+
 // DCD Endpoint Port
 //--------------------------------------------------------------------+
@@ -221,6 +284,9 @@ void dcd_edpt_stall(uint8_t rhport, uint8_t ep_addr)
   // TODO cannot able to STALL Control OUT endpoint !!!!! FIXME try some walk-around
   uint8_t const ep_id = ep_addr2id(ep_addr);
   _dcd.ep[ep_id][0].stall = 1;
+
+  // both buffers must be stalled
+  if ( tu_bit_test(DCD_REGS->EPBUFCFG, ep_id) ) _dcd.ep[ep_id][1].stall = 1;
 }
 
 void dcd_edpt_clear_stall(uint8_t rhport, uint8_t ep_addr)
@@ -232,15 +298,14 @@ void dcd_edpt_clear_stall(uint8_t rhport, uint8_t ep_addr)
   _dcd.ep[ep_id][0].stall        = 0;
   _dcd.ep[ep_id][0].toggle_reset = 1;
   _dcd.ep[ep_id][0].toggle_mode  = 0;
+
+  if ( tu_bit_test(DCD_REGS->EPBUFCFG, ep_id) ) _dcd.ep[ep_id][1].stall = 0;
 }
 
 bool dcd_edpt_open(uint8_t rhport, tusb_desc_endpoint_t const * p_endpoint_desc)
 {
   (void) rhport;
 
-  // TODO not support ISO yet
-  if (p_endpoint_desc->bmAttributes.xfer == TUSB_XFER_ISOCHRONOUS) return false;
-
   //------------- Prepare Queue Head -------------//
   uint8_t ep_id = ep_addr2id(p_endpoint_desc->bEndpointAddress);
 
@@ -250,32 +315,107 @@ bool dcd_edpt_open(uint8_t rhport, tusb_desc_endpoint_t const * p_endpoint_desc)
   tu_memclr(_dcd.ep[ep_id], 2*sizeof(ep_cmd_sts_t));
   _dcd.ep[ep_id][0].is_iso = (p_endpoint_desc->bmAttributes.xfer == TUSB_XFER_ISOCHRONOUS);
 
+  uint8_t const epnum = tu_edpt_number(p_endpoint_desc->bEndpointAddress);
+  if ( (DCD_LPC_DOUBLE_BUFFER_EP & TU_BIT(epnum)) && (p_endpoint_desc->bmAttributes.xfer == TUSB_XFER_BULK) )
+  {
+    DCD_REGS->EPBUFCFG |= TU_BIT(ep_id);
+  }else
+  {
+    DCD_REGS->EPBUFCFG &= ~TU_BIT(ep_id);
+  }
+  DCD_REGS->EPINUSE &= ~TU_BIT(ep_id);
+
   // Enable EP interrupt
   DCD_REGS->INTEN |= TU_BIT(ep_id);
 
   return true;
 }
 
-static void prepare_ep_xfer(uint8_t ep_id, uint16_t buf_offset, uint16_t total_bytes)
+static void prepare_ep_xfer(uint8_t ep_id, uint16_t buf_offset, uint32_t total_bytes)
 {
-  uint16_t const nbytes = tu_min16(total_bytes, DMA_NBYTES_MAX);
+  // Isochronous is one transaction per frame, which can always be up to 1023 bytes
+  uint16_t nbytes = (uint16_t) tu_min32(total_bytes, _dcd.ep[ep_id][0].is_iso ? 1023 : DMA_NBYTES_MAX);
+
+#if DCD_LPC_BOUNCE_SIZE
+  xfer_dma_t* xfer_dma = &_dcd.dma[ep_id];
+  if ( xfer_dma->bounce )
+  {
+    nbytes     = tu_min16(nbytes, DCD_LPC_BOUNCE_SIZE);
+    buf_offset = get_buf_offset(_dcd.bounce[ep_id]);
+
+    // IN data is copied before the transaction, OUT data after it completes
+    if ( ep_id & 0x01 ) memcpy(_dcd.bounce[ep_id], xfer_dma->bounce + xfer_dma->xferred_bytes, nbytes);
+  }
+#endif
 
   _dcd.dma[ep_id].nbytes = nbytes;
 
-  _dcd.ep[ep_id][0].buffer_offset = buf_offset;
-  _dcd.ep[ep_id][0].nbytes        = nbytes;
-  _dcd.ep[ep_id][0].active        = 1;
+  ep_cmd_sts_t* ep_cs = &_dcd.ep[ep_id][_dcd.dma[ep_id].buf_idx];
+  ep_cs->buffer_offset = buf_offset;
+  ep_cs->nbytes        = nbytes;
+  ep_cs->active        = 1;
 }
 
-bool dcd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t* buffer, uint16_t total_bytes)
+// Arm next chunk of a double-buffered transfer into entry buf
+static void prepare_dbuf_xfer(uint8_t ep_id, uint8_t buf)
+{
+  xfer_dma_t* xfer_dma = &_dcd.dma[ep_id];
+  uint16_t const nbytes = (uint16_t) tu_min32(xfer_dma->total_bytes - xfer_dma->armed_bytes, DBUF_NBYTES_MAX);
+
+  xfer_dma->dbuf_nbytes[buf] = nbytes;
+
+  ep_cmd_sts_t* ep_cs = &_dcd.ep[ep_id][buf];
+  ep_cs->buffer_offset = (uint16_t) (xfer_dma->buf_offset + (xfer_dma->armed_bytes >> 6));
+  ep_cs->nbytes        = nbytes;
+
+  xfer_dma->armed_bytes += nbytes;
+  xfer_dma->armed++;
+
+  ep_cs->active = 1;
+}
+
+bool dcd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t* buffer, uint32_t total_bytes)
 {
   (void) rhport;
 
   uint8_t const ep_id = ep_addr2id(ep_addr);
 
+  // Isochronous transfer is a single packet sent/received in next frame, there is no retry
+  if ( _dcd.ep[ep_id][0].is_iso ) TU_ASSERT(total_bytes <= 1023);
+
   tu_varclr(&_dcd.dma[ep_id]);
   _dcd.dma[ep_id].total_bytes = total_bytes;
 
+  if ( buffer && total_bytes && !buf_in_region(buffer) )
+  {
+#if DCD_LPC_BOUNCE_SIZE
+    // Isochronous packet can not be split
+    if ( _dcd.ep[ep_id][0].is_iso ) TU_ASSERT(total_bytes <= DCD_LPC_BOUNCE_SIZE);
+    _dcd.dma[ep_id].bounce = buffer;
+#else
+    TU_ASSERT(false);
+#endif
+  }
+
+  if ( tu_bit_test(DCD_REGS->EPBUFCFG, ep_id) )
+  {
+    // start with the entry controller will use next
+    _dcd.dma[ep_id].buf_idx = tu_bit_test(DCD_REGS->EPINUSE, ep_id) ? 1 : 0;
+
+    // bounce buffer is a single buffer, staged one chunk at a time
+    if ( !_dcd.dma[ep_id].bounce )
+    {
+      xfer_dma_t* xfer_dma = &_dcd.dma[ep_id];
+      xfer_dma->dbuf       = true;
+      xfer_dma->buf_offset = get_buf_offset(buffer);
+
+      prepare_dbuf_xfer(ep_id, xfer_dma->buf_idx);
+      if ( xfer_dma->armed_bytes < total_bytes ) prepare_dbuf_xfer(ep_id, xfer_dma->buf_idx ^ 1);
+
+      return true;
+    }
+  }
+
   prepare_ep_xfer(ep_id, get_buf_offset(buffer), total_bytes);
 
   return true;
@@ -305,21 +445,76 @@ static void bus_reset(void)
   DCD_REGS->INTEN        = INT_DEVICE_STATUS_MASK | TU_BIT(0) | TU_BIT(1); // enable device status & control endpoints
 }
 
+// Entries of a double-buffered endpoint complete alternately, one interrupt may cover both
+static void process_dbuf_isr(uint8_t ep_id)
+{
+  xfer_dma_t* xfer_dma = &_dcd.dma[ep_id];
+
+  while ( xfer_dma->armed )
+  {
+    uint8_t const buf = xfer_dma->buf_idx;
+    ep_cmd_sts_t * ep_cs = &_dcd.ep[ep_id][buf];
+    if ( ep_cs->active ) break;
+
+    xfer_dma->xferred_bytes += xfer_dma->dbuf_nbytes[buf] - ep_cs->nbytes;
+    xfer_dma->armed--;
+    xfer_dma->buf_idx ^= 1;
+
+    // short packet or all bytes done
+    if ( (ep_cs->nbytes != 0) || (xfer_dma->xferred_bytes == xfer_dma->total_bytes) )
+    {
+      if ( xfer_dma->armed )
+      {
+        // other entry is still armed after a short OUT packet, skip it so the next transfer starts clean
+        DCD_REGS->EPSKIP = TU_BIT(ep_id);
+        while ( DCD_REGS->EPSKIP & TU_BIT(ep_id) ) {}
+        DCD_REGS->INTSTAT = TU_BIT(ep_id);
+        xfer_dma->armed = 0;
+      }
+
+      xfer_dma->total_bytes = xfer_dma->xferred_bytes;
+
+      uint8_t const ep_addr = (ep_id / 2) | ((ep_id & 0x01) ? TUSB_DIR_IN_MASK : 0);
+      dcd_event_xfer_complete(0, ep_addr, xfer_dma->xferred_bytes, XFER_RESULT_SUCCESS, true);
+      return;
+    }
+
+    // refill the entry just completed while controller works on the other one
+    if ( xfer_dma->armed_bytes < xfer_dma->total_bytes ) prepare_dbuf_xfer(ep_id, buf);
+  }
+}
+
 static void process_xfer_isr(uint32_t int_status)
 {
   for(uint8_t ep_id = 0; ep_id < EP_COUNT; ep_id++ )
   {
     if ( tu_bit_test(int_status, ep_id) )
     {
-      ep_cmd_sts_t * ep_cs = &_dcd.ep[ep_id][0];
       xfer_dma_t* xfer_dma = &_dcd.dma[ep_id];
 
-      xfer_dma->xferred_bytes += xfer_dma->nbytes - ep_cs->nbytes;
+      if ( xfer_dma->dbuf )
+      {
+        process_dbuf_isr(ep_id);
+        continue;
+      }
+
+      ep_cmd_sts_t * ep_cs = &_dcd.ep[ep_id][xfer_dma->buf_idx];
 
-      if ( (ep_cs->nbytes == 0) && (xfer_dma->total_bytes > xfer_dma->xferred_bytes) )
+      uint16_t const xferred = xfer_dma->nbytes - ep_cs->nbytes;
+
+#if DCD_LPC_BOUNCE_SIZE
+      if ( xfer_dma->bounce && !(ep_id & 0x01) ) memcpy(xfer_dma->bounce + xfer_dma->xferred_bytes, _dcd.bounce[ep_id], xferred);
+#endif
+
+      xfer_dma->xferred_bytes += xferred;
+
+      // Isochronous transfer completes after its single transaction
+      if ( !ep_cs->is_iso && (ep_cs->nbytes == 0) && (xfer_dma->total_bytes > xfer_dma->xferred_bytes) )
       {
         // There is more data to transfer
         // buff_offset has been already increased by hw to correct value for next transfer
+        // Controller moves to the other entry when endpoint is double-buffered
+        if ( tu_bit_test(DCD_REGS->EPBUFCFG, ep_id) ) xfer_dma->buf_idx ^= 1;
         prepare_ep_xfer(ep_id, ep_cs->buffer_offset, xfer_dma->total_bytes - xfer_dma->xferred_bytes);
       }
       else
@@ -335,7 +530,7 @@ static void process_xfer_isr(uint32_t int_status)
   }
 }
 
-void DCD_IRQHandler(void)
+TU_ATTR_FAST_FUNC void DCD_IRQHandler(void)
 {
   uint32_t const cmd_stat = DCD_REGS->DEVCMDSTAT;
 
@@ -403,6 +598,8 @@ void DCD_IRQHandler(void)
 
   // Endpoint transfer complete interrupt
   process_xfer_isr(int_status);
+
+  dcd_event_isr_exit(0);
 }
 
 #endif
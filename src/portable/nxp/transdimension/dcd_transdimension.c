@@ -199,8 +199,11 @@ typedef struct
   uint32_t buffer[5]; ///< buffer1 has frame_n for TODO Isochronous
 
   //------------- DCD Area -------------//
-  uint16_t expected_bytes;
-  uint8_t reserved[2];
+  uint16_t expected_bytes : 15;
+  uint16_t in_use         : 1 ; ///< allocated from pool
+  uint16_t buffer_offset  : 12; ///< initial offset in page 0, controller updates it in buffer[0]
+  uint16_t xfer_last      : 1 ; ///< last qtd of a transfer
+  uint16_t                : 3 ;
 } dcd_qtd_t;
 
 TU_VERIFY_STATIC( sizeof(dcd_qtd_t) == 32, "size is not correct");
@@ -230,7 +233,9 @@ typedef struct
   /// Due to the fact QHD is 64 bytes aligned but occupies only 48 bytes
 	/// thus there are 16 bytes padding free that we can make use of.
   //--------------------------------------------------------------------+
-	uint8_t reserved[16];
+	uint8_t qtd_head; ///< oldest qtd not yet retired, QTD_NONE if endpoint is idle
+	uint8_t qtd_tail; ///< last qtd of the newest transfer
+	uint8_t reserved[14];
 }  dcd_qhd_t;
 
 TU_VERIFY_STATIC( sizeof(dcd_qhd_t) == 64, "size is not correct");
@@ -241,16 +246,34 @@ TU_VERIFY_STATIC( sizeof(dcd_qhd_t) == 64, "size is not correct");
 
 #define QHD_MAX          12
 #define QTD_NEXT_INVALID 0x01
+#define QTD_NONE         0xFF
+
+// Number of qtd shared by all endpoints, each covers 5 pages of 4KB i.e at least 16KB for
+// unaligned buffer. A transfer takes as many as it needs, and further transfers can be linked
+// behind it while the endpoint is running.
+#ifndef DCD_QTD_COUNT
+#define DCD_QTD_COUNT    (4*QHD_MAX)
+#endif
+
+TU_VERIFY_STATIC( DCD_QTD_COUNT < QTD_NONE, "qtd is indexed by uint8_t");
 
 typedef struct {
-  // Must be at 2K alignment
-  dcd_qhd_t qhd[QHD_MAX] TU_ATTR_ALIGNED(64);
-  dcd_qtd_t qtd[QHD_MAX] TU_ATTR_ALIGNED(32);
+  // Must be at 2K alignment, also for data of the second port
+  dcd_qhd_t qhd[QHD_MAX] TU_ATTR_ALIGNED(2048);
+  dcd_qtd_t qtd[DCD_QTD_COUNT] TU_ATTR_ALIGNED(32);
 }dcd_data_t;
 
-static dcd_data_t _dcd_data CFG_TUSB_MEM_SECTION TU_ATTR_ALIGNED(2048);
+// Each device port has its own queue heads and qtds, all data is at index 0 if only one port is device
+#define DCD_DATA_IDX(_rhport)   ( (TUD_OPT_RHPORT_COUNT > 1) ? (_rhport) : 0 )
+
+static dcd_data_t _dcd_data[TUD_OPT_RHPORT_COUNT] CFG_TUSB_MEM_SECTION TU_ATTR_ALIGNED(2048);
 static dcd_registers_t* DCD_REGS[] = DCD_REGS_BASE;
 
+static inline dcd_data_t* get_dcd_data(uint8_t rhport)
+{
+  return &_dcd_data[DCD_DATA_IDX(rhport)];
+}
+
 //--------------------------------------------------------------------+
 // CONTROLLER API
 //--------------------------------------------------------------------+
@@ -259,6 +282,7 @@ static dcd_registers_t* DCD_REGS[] = DCD_REGS_BASE;
 static void bus_reset(uint8_t rhport)
 {
   dcd_registers_t* dcd_reg = DCD_REGS[rhport];
+  dcd_data_t* const p_dcd = get_dcd_data(rhport);
 
   // The reset value for all endpoint types is the control endpoint. If one endpoint
   // direction is enabled and the paired endpoint of opposite direction is disabled, then the
@@ -286,19 +310,30 @@ static void bus_reset(uint8_t rhport)
   // read reset bit in portsc
 
   //------------- Queue Head & Queue TD -------------//
-  tu_memclr(&_dcd_data, sizeof(dcd_data_t));
+  tu_memclr(p_dcd, sizeof(dcd_data_t));
 
   //------------- Set up Control Endpoints (0 OUT, 1 IN) -------------//
-	_dcd_data.qhd[0].zero_length_termination = _dcd_data.qhd[1].zero_length_termination = 1;
-	_dcd_data.qhd[0].max_package_size = _dcd_data.qhd[1].max_package_size = CFG_TUD_ENDPOINT0_SIZE;
-	_dcd_data.qhd[0].qtd_overlay.next = _dcd_data.qhd[1].qtd_overlay.next = QTD_NEXT_INVALID;
+	p_dcd->qhd[0].zero_length_termination = p_dcd->qhd[1].zero_length_termination = 1;
+	p_dcd->qhd[0].max_package_size = p_dcd->qhd[1].max_package_size = CFG_TUD_ENDPOINT0_SIZE;
+	p_dcd->qhd[0].qtd_overlay.next = p_dcd->qhd[1].qtd_overlay.next = QTD_NEXT_INVALID;
 
-	_dcd_data.qhd[0].int_on_setup = 1; // OUT only
+	p_dcd->qhd[0].int_on_setup = 1; // OUT only
+
+  for(uint8_t i=0; i<QHD_MAX; i++)
+  {
+    p_dcd->qhd[i].qtd_head = p_dcd->qhd[i].qtd_tail = QTD_NONE;
+  }
 }
 
 void dcd_init(uint8_t rhport)
 {
-  tu_memclr(&_dcd_data, sizeof(dcd_data_t));
+  dcd_data_t* const p_dcd = get_dcd_data(rhport);
+
+  tu_memclr(p_dcd, sizeof(dcd_data_t));
+  for(uint8_t i=0; i<QHD_MAX; i++)
+  {
+    p_dcd->qhd[i].qtd_head = p_dcd->qhd[i].qtd_tail = QTD_NONE;
+  }
 
   dcd_registers_t* const dcd_reg = DCD_REGS[rhport];
 
@@ -313,7 +348,7 @@ void dcd_init(uint8_t rhport)
   // TODO Force fullspeed on non-highspeed port
   // dcd_reg->PORTSC1 = PORTSC1_FORCE_FULL_SPEED;
 
-  dcd_reg->ENDPTLISTADDR = (uint32_t) _dcd_data.qhd; // Endpoint List Address has to be 2K alignment
+  dcd_reg->ENDPTLISTADDR = (uint32_t) p_dcd->qhd; // Endpoint List Address has to be 2K alignment
   dcd_reg->USBSTS  = dcd_reg->USBSTS;
   dcd_reg->USBINTR = INTR_USB | INTR_ERROR | INTR_PORT_CHANGE | INTR_RESET | INTR_SUSPEND | INTR_SOF;
 
@@ -351,6 +386,22 @@ void dcd_remote_wakeup(uint8_t rhport)
   (void) rhport;
 }
 
+void dcd_get_caps(uint8_t rhport, dcd_caps_t* caps)
+{
+  // each qtd holds at least 16 KB, transfer may take its share of the pool
+  caps->max_xfer_bytes = (DCD_QTD_COUNT / QHD_MAX) * 4 * 4096UL;
+  caps->speed          = TUD_OPT_RHPORT_HIGH_SPEED(rhport) ? TUSB_SPEED_HIGH : TUSB_SPEED_FULL;
+  caps->multi_packet   = 1;
+  caps->dma            = 1;
+  caps->iso            = 1;
+}
+
+uint32_t dcd_frame_number(uint8_t rhport)
+{
+  // FRINDEX bit 2:0 is microframe (also counted at full speed)
+  return (DCD_REGS[rhport]->FRINDEX >> 3) & 0x7ffu;
+}
+
 //--------------------------------------------------------------------+
 // HELPER
 //--------------------------------------------------------------------+
@@ -360,17 +411,92 @@ static inline uint8_t ep_idx2bit(uint8_t ep_idx)
   return ep_idx/2 + ( (ep_idx%2) ? 16 : 0);
 }
 
-static void qtd_init(dcd_qtd_t* p_qtd, void * data_ptr, uint16_t total_bytes)
+// Data cache of i.MX RT must be cleaned before controller reads a buffer and invalidated after it
+// writes one. Queue heads and qtds are not maintained: _dcd_data must be in non-cacheable memory
+// via CFG_TUSB_MEM_SECTION, data buffers can be cacheable. Buffers of OUT transfers should be
+// 32-byte aligned (CFG_TUSB_MEM_ALIGN) so that no other data shares their cache lines.
+static TU_ATTR_FAST_FUNC void dma_cache_clean(void const * addr, uint32_t len)
+{
+#if defined(__DCACHE_PRESENT) && __DCACHE_PRESENT
+  if ( addr && len && (SCB->CCR & SCB_CCR_DC_Msk) )
+  {
+    uint32_t const start = tu_align32((uint32_t) addr);
+    SCB_CleanDCache_by_Addr((uint32_t *) start, (int32_t) ((uint32_t) addr + len - start));
+  }
+#else
+  (void) addr;
+  (void) len;
+#endif
+}
+
+static TU_ATTR_FAST_FUNC void dma_cache_invalidate(void const * addr, uint32_t len)
+{
+#if defined(__DCACHE_PRESENT) && __DCACHE_PRESENT
+  if ( addr && len && (SCB->CCR & SCB_CCR_DC_Msk) )
+  {
+    uint32_t const start = tu_align32((uint32_t) addr);
+    SCB_InvalidateDCache_by_Addr((uint32_t *) start, (int32_t) ((uint32_t) addr + len - start));
+  }
+#else
+  (void) addr;
+  (void) len;
+#endif
+}
+
+static inline uint8_t qtd_idx(dcd_data_t const* p_dcd, uint32_t next)
+{
+  return (uint8_t) (((dcd_qtd_t*) next) - p_dcd->qtd);
+}
+
+static TU_ATTR_FAST_FUNC uint8_t qtd_alloc(dcd_data_t* p_dcd)
+{
+  for(uint8_t i=0; i<DCD_QTD_COUNT; i++)
+  {
+    if ( !p_dcd->qtd[i].in_use )
+    {
+      p_dcd->qtd[i].in_use = 1;
+      return i;
+    }
+  }
+  return QTD_NONE;
+}
+
+// Free qtds from first up to and including last
+static TU_ATTR_FAST_FUNC void qtd_free(dcd_data_t* p_dcd, uint8_t first, uint8_t last)
+{
+  while ( first != QTD_NONE )
+  {
+    dcd_qtd_t* qtd = &p_dcd->qtd[first];
+    qtd->in_use = 0;
+
+    if ( (first == last) || (qtd->next & QTD_NEXT_INVALID) ) break;
+    first = qtd_idx(p_dcd, qtd->next);
+  }
+}
+
+// Drop all qtds of an endpoint, controller must not be processing them
+static void qtd_flush(dcd_data_t* p_dcd, uint8_t ep_idx)
+{
+  dcd_qhd_t * p_qhd = &p_dcd->qhd[ep_idx];
+
+  qtd_free(p_dcd, p_qhd->qtd_head, p_qhd->qtd_tail);
+  p_qhd->qtd_head = p_qhd->qtd_tail = QTD_NONE;
+  p_qhd->qtd_overlay.next = QTD_NEXT_INVALID;
+}
+
+static TU_ATTR_FAST_FUNC void qtd_init(dcd_qtd_t* p_qtd, void * data_ptr, uint16_t total_bytes)
 {
   tu_memclr(p_qtd, sizeof(dcd_qtd_t));
 
+  p_qtd->in_use      = 1;
   p_qtd->next        = QTD_NEXT_INVALID;
   p_qtd->active      = 1;
   p_qtd->total_bytes = p_qtd->expected_bytes = total_bytes;
 
   if (data_ptr != NULL)
   {
-    p_qtd->buffer[0]   = (uint32_t) data_ptr;
+    p_qtd->buffer[0]     = (uint32_t) data_ptr;
+    p_qtd->buffer_offset = ((uint32_t) data_ptr) & 0xFFF;
     for(uint8_t i=1; i<5; i++)
     {
       p_qtd->buffer[i] |= tu_align4k( p_qtd->buffer[i-1] ) + 4096;
@@ -394,6 +520,13 @@ void dcd_edpt_clear_stall(uint8_t rhport, uint8_t ep_addr)
   uint8_t const epnum  = tu_edpt_number(ep_addr);
   uint8_t const dir    = tu_edpt_dir(ep_addr);
 
+  dcd_data_t* const p_dcd = get_dcd_data(rhport);
+
+  // transfers queued before stall are dropped
+  DCD_REGS[rhport]->ENDPTFLUSH = TU_BIT( ep_idx2bit(2*epnum + dir) );
+  while (DCD_REGS[rhport]->ENDPTFLUSH) {}
+  qtd_flush(p_dcd, 2*epnum + dir);
+
   // data toggle also need to be reset
   DCD_REGS[rhport]->ENDPTCTRL[epnum] |= ENDPTCTRL_TOGGLE_RESET << ( dir ? 16 : 0 );
   DCD_REGS[rhport]->ENDPTCTRL[epnum] &= ~(ENDPTCTRL_STALL << ( dir  ? 16 : 0));
@@ -401,9 +534,7 @@ void dcd_edpt_clear_stall(uint8_t rhport, uint8_t ep_addr)
 
 bool dcd_edpt_open(uint8_t rhport, tusb_desc_endpoint_t const * p_endpoint_desc)
 {
-  // TODO not support ISO yet
-  TU_VERIFY ( p_endpoint_desc->bmAttributes.xfer != TUSB_XFER_ISOCHRONOUS);
-
+  uint8_t const xfer   = p_endpoint_desc->bmAttributes.xfer;
   uint8_t const epnum  = tu_edpt_number(p_endpoint_desc->bEndpointAddress);
   uint8_t const dir    = tu_edpt_dir(p_endpoint_desc->bEndpointAddress);
   uint8_t const ep_idx = 2*epnum + dir;
@@ -412,20 +543,135 @@ bool dcd_edpt_open(uint8_t rhport, tusb_desc_endpoint_t const * p_endpoint_desc)
   TU_ASSERT( epnum <= (rhport ? 3 : 5) );
 
   //------------- Prepare Queue Head -------------//
-  dcd_qhd_t * p_qhd = &_dcd_data.qhd[ep_idx];
+  dcd_data_t* const p_dcd = get_dcd_data(rhport);
+  dcd_qhd_t * p_qhd = &p_dcd->qhd[ep_idx];
+
+  // Reopened endpoint (alternate setting) drops its pending transfers
+  if ( p_qhd->qtd_head != QTD_NONE )
+  {
+    DCD_REGS[rhport]->ENDPTFLUSH = TU_BIT( ep_idx2bit(ep_idx) );
+    while (DCD_REGS[rhport]->ENDPTFLUSH) {}
+    qtd_flush(p_dcd, ep_idx);
+  }
+
   tu_memclr(p_qhd, sizeof(dcd_qhd_t));
+  p_qhd->qtd_head = p_qhd->qtd_tail = QTD_NONE;
 
   p_qhd->zero_length_termination = 1;
+
+  // wMaxPacketSize.size excludes the high-bandwidth multiplier. Controller only has MULT for ISO
+  // (must be 0 otherwise): high-bandwidth interrupt endpoint sends one packet per microframe.
   p_qhd->max_package_size        = p_endpoint_desc->wMaxPacketSize.size;
   p_qhd->qtd_overlay.next        = QTD_NEXT_INVALID;
 
-  // Enable EP Control
-  DCD_REGS[rhport]->ENDPTCTRL[epnum] |= ((p_endpoint_desc->bmAttributes.xfer << 2) | ENDPTCTRL_ENABLE | ENDPTCTRL_TOGGLE_RESET) << (dir ? 16 : 0);
+  // ISO: up to 3 packets per microframe, controller handles frame scheduling by itself
+  if ( xfer == TUSB_XFER_ISOCHRONOUS ) p_qhd->iso_mult = 1 + p_endpoint_desc->wMaxPacketSize.hs_period_mult;
+
+  // Enable EP Control, type is cleared first since bus reset leaves it as bulk
+  uint8_t const shift = (dir ? 16 : 0);
+  DCD_REGS[rhport]->ENDPTCTRL[epnum] &= ~(0x0CUL << shift);
+  DCD_REGS[rhport]->ENDPTCTRL[epnum] |= ((xfer << 2) | ENDPTCTRL_ENABLE | ENDPTCTRL_TOGGLE_RESET) << shift;
 
   return true;
 }
 
-bool dcd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint16_t total_bytes)
+// Append buffer to the qtd chain of a transfer (first is QTD_NONE for a new chain), split into
+// multiple qtds if needed. Except the last one, each qtd must hold a multiple of max packet size
+// so that packets are not split between qtds. Return false if running out of qtd.
+static TU_ATTR_FAST_FUNC bool qtd_append(dcd_data_t* p_dcd, uint8_t* first, uint8_t* last, uint16_t max_packet_size, uint8_t dir, uint8_t * buffer, uint32_t total_bytes)
+{
+  do
+  {
+    uint8_t const idx = qtd_alloc(p_dcd);
+    TU_VERIFY(idx != QTD_NONE);
+
+    uint32_t const max_bytes = 5*4096 - (((uint32_t) buffer) & 0xFFF);
+    uint16_t xact_bytes;
+
+    if ( total_bytes <= max_bytes )
+    {
+      xact_bytes = (uint16_t) total_bytes;
+    }else
+    {
+      xact_bytes = (uint16_t) (max_bytes - (max_bytes % max_packet_size));
+    }
+
+    dcd_qtd_t* qtd = &p_dcd->qtd[idx];
+    qtd_init(qtd, buffer, xact_bytes);
+
+    // IN: write back data for controller. OUT: no dirty line may be evicted over received data
+    dma_cache_clean(buffer, xact_bytes);
+
+    // Interrupt on every OUT qtd to detect short packet, IN only interrupts on the last one
+    qtd->int_on_complete = (dir == TUSB_DIR_OUT);
+
+    if ( *first == QTD_NONE )
+    {
+      *first = idx;
+    }else
+    {
+      p_dcd->qtd[*last].next = (uint32_t) qtd;
+    }
+    *last = idx;
+
+    if (buffer) buffer += xact_bytes;
+    total_bytes -= xact_bytes;
+  } while ( total_bytes );
+
+  return true;
+}
+
+// Link a prepared qtd chain behind the endpoint's pending transfers, and prime endpoint if it
+// is not already running. Follows UM 23.10.11.3 Executing a transfer descriptor.
+static TU_ATTR_FAST_FUNC void qtd_start(uint8_t rhport, uint8_t ep_idx, uint8_t first, uint8_t last)
+{
+  dcd_registers_t* const dcd_reg = DCD_REGS[rhport];
+  dcd_data_t* const p_dcd = get_dcd_data(rhport);
+  dcd_qhd_t * p_qhd = &p_dcd->qhd[ep_idx];
+  uint32_t const ep_bit = TU_BIT( ep_idx2bit(ep_idx) );
+
+  p_dcd->qtd[last].int_on_complete = 1;
+  p_dcd->qtd[last].xfer_last       = 1;
+
+  bool prime = true;
+
+  if ( p_qhd->qtd_head == QTD_NONE )
+  {
+    p_qhd->qtd_head = first;
+  }else
+  {
+    p_dcd->qtd[p_qhd->qtd_tail].next = (uint32_t) &p_dcd->qtd[first];
+
+    if ( dcd_reg->ENDPTPRIME & ep_bit )
+    {
+      prime = false; // controller has not fetched the list yet
+    }else
+    {
+      // Tripwire guards ENDPTSTAT read against the controller retiring the previous last qtd
+      bool active;
+      do
+      {
+        dcd_reg->USBCMD |= USBCMD_ADD_QTD_TRIPWIRE;
+        active = (dcd_reg->ENDPTSTAT & ep_bit) != 0;
+      } while ( !(dcd_reg->USBCMD & USBCMD_ADD_QTD_TRIPWIRE) );
+      dcd_reg->USBCMD &= ~USBCMD_ADD_QTD_TRIPWIRE;
+
+      prime = !active;
+    }
+  }
+
+  p_qhd->qtd_tail = last;
+
+  if ( prime )
+  {
+    p_qhd->qtd_overlay.next = (uint32_t) &p_dcd->qtd[first]; // link qtd to qhd
+
+    // start transfer
+    dcd_reg->ENDPTPRIME = ep_bit;
+  }
+}
+
+TU_ATTR_FAST_FUNC bool dcd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint32_t total_bytes)
 {
   uint8_t const epnum = tu_edpt_number(ep_addr);
   uint8_t const dir   = tu_edpt_dir(ep_addr);
@@ -438,16 +684,83 @@ bool dcd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint16_t t
     while(DCD_REGS[rhport]->ENDPTSETUPSTAT & TU_BIT(0)) {}
   }
 
-  dcd_qhd_t * p_qhd = &_dcd_data.qhd[ep_idx];
-  dcd_qtd_t * p_qtd = &_dcd_data.qtd[ep_idx];
+  dcd_data_t* const p_dcd = get_dcd_data(rhport);
+  dcd_qhd_t * p_qhd = &p_dcd->qhd[ep_idx];
+
+  // Control transfer is never queued, a new one replaces what is left from an aborted one
+  if ( (epnum == 0) && (p_qhd->qtd_head != QTD_NONE) )
+  {
+    DCD_REGS[rhport]->ENDPTFLUSH = TU_BIT( ep_idx2bit(ep_idx) );
+    while (DCD_REGS[rhport]->ENDPTFLUSH) {}
+    qtd_flush(p_dcd, ep_idx);
+  }
 
   //------------- Prepare qtd -------------//
-  qtd_init(p_qtd, buffer, total_bytes);
-  p_qtd->int_on_complete = true;
-  p_qhd->qtd_overlay.next = (uint32_t) p_qtd; // link qtd to qhd
+  uint8_t first = QTD_NONE;
+  uint8_t last  = QTD_NONE;
 
-  // start transfer
-  DCD_REGS[rhport]->ENDPTPRIME = TU_BIT( ep_idx2bit(ep_idx) ) ;
+  if ( p_qhd->iso_mult )
+  {
+    // ISO transfer is one (micro)frame worth of data in a single qtd. IN sends as many packets
+    // as needed (at least a zero-length one), OUT is retired at the end of its microframe.
+    TU_ASSERT( total_bytes <= p_qhd->iso_mult*p_qhd->max_package_size );
+  }
+
+  if ( !qtd_append(p_dcd, &first, &last, p_qhd->max_package_size, dir, buffer, total_bytes) )
+  {
+    qtd_free(p_dcd, first, last);
+    TU_ASSERT(false);
+  }
+
+  if ( p_qhd->iso_mult && (dir == TUSB_DIR_IN) )
+  {
+    uint32_t const count = (total_bytes + p_qhd->max_package_size - 1) / p_qhd->max_package_size;
+    p_dcd->qtd[first].iso_mult_override = count ? count : 1;
+  }
+
+  qtd_start(rhport, ep_idx, first, last);
+
+  return true;
+}
+
+// Transfer is linked to the controller list behind the ones in progress
+bool dcd_edpt_xfer_append(uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint32_t total_bytes)
+{
+  TU_VERIFY(tu_edpt_number(ep_addr));
+  return dcd_edpt_xfer(rhport, ep_addr, buffer, total_bytes);
+}
+
+bool dcd_edpt_xfer_sg(uint8_t rhport, uint8_t ep_addr, xfer_seg_t const * segs, uint8_t count)
+{
+  uint8_t const epnum = tu_edpt_number(ep_addr);
+  uint8_t const dir   = tu_edpt_dir(ep_addr);
+  uint8_t const ep_idx = 2*epnum + dir;
+
+  TU_VERIFY(epnum);
+
+  dcd_data_t* const p_dcd = get_dcd_data(rhport);
+  dcd_qhd_t * p_qhd = &p_dcd->qhd[ep_idx];
+  TU_VERIFY(!p_qhd->iso_mult);
+
+  // Each segment is mapped to its own qtds, this only works if every segment except the last
+  // one is a multiple of max packet size. Otherwise let usbd fall back to bounce buffer.
+  for(uint8_t i=0; i+1<count; i++)
+  {
+    TU_VERIFY( (segs[i].len % p_qhd->max_package_size) == 0 );
+  }
+
+  uint8_t first = QTD_NONE;
+  uint8_t last  = QTD_NONE;
+  for(uint8_t i=0; i<count; i++)
+  {
+    if ( !qtd_append(p_dcd, &first, &last, p_qhd->max_package_size, dir, segs[i].buffer, segs[i].len) )
+    {
+      qtd_free(p_dcd, first, last);
+      return false;
+    }
+  }
+
+  qtd_start(rhport, ep_idx, first, last);
 
   return true;
 }
@@ -455,9 +768,10 @@ bool dcd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint16_t t
 //--------------------------------------------------------------------+
 // ISR
 //--------------------------------------------------------------------+
-void dcd_isr(uint8_t rhport)
+TU_ATTR_FAST_FUNC void dcd_isr(uint8_t rhport)
 {
   dcd_registers_t* const dcd_reg = DCD_REGS[rhport];
+  dcd_data_t* const p_dcd = get_dcd_data(rhport);
 
   uint32_t const int_enable = dcd_reg->USBINTR;
   uint32_t const int_status = dcd_reg->USBSTS & int_enable;
@@ -505,7 +819,7 @@ void dcd_isr(uint8_t rhport)
       // 23.10.10.2 Operational model for setup transfers
       dcd_reg->ENDPTSETUPSTAT = dcd_reg->ENDPTSETUPSTAT;// acknowledge
 
-      dcd_event_setup_received(rhport, (uint8_t*) &_dcd_data.qhd[0].setup_request, true);
+      dcd_event_setup_received(rhport, (uint8_t*) &p_dcd->qhd[0].setup_request, true);
     }
 
     if ( edpt_complete )
@@ -515,13 +829,76 @@ void dcd_isr(uint8_t rhport)
         if ( tu_bit_test(edpt_complete, ep_idx2bit(ep_idx)) )
         {
           // 23.10.12.3 Failed QTD also get ENDPTCOMPLETE set
-          dcd_qtd_t * p_qtd = &_dcd_data.qtd[ep_idx];
-
-          uint8_t result = p_qtd->halted  ? XFER_RESULT_STALLED :
-              ( p_qtd->xact_err ||p_qtd->buffer_err ) ? XFER_RESULT_FAILED : XFER_RESULT_SUCCESS;
-
+          dcd_qhd_t * p_qhd = &p_dcd->qhd[ep_idx];
           uint8_t const ep_addr = (ep_idx/2) | ( (ep_idx & 0x01) ? TUSB_DIR_IN_MASK : 0 );
-          dcd_event_xfer_complete(rhport, ep_addr, p_qtd->expected_bytes - p_qtd->total_bytes, result, true); // only number of bytes in the IOC qtd
+
+          // Retire transfers in order. A transfer is complete when its last qtd is retired, or a
+          // qtd is retired with error or short packet (remaining bytes) before that.
+          while ( p_qhd->qtd_head != QTD_NONE )
+          {
+            uint8_t const first = p_qhd->qtd_head;
+            uint8_t idx = first;
+            uint32_t xferred_bytes = 0;
+            uint8_t  result = XFER_RESULT_SUCCESS;
+
+            while ( !p_dcd->qtd[idx].active )
+            {
+              dcd_qtd_t* qtd = &p_dcd->qtd[idx];
+              uint32_t const qtd_bytes = (uint32_t) (qtd->expected_bytes - qtd->total_bytes);
+              xferred_bytes += qtd_bytes;
+
+              // drop lines cpu may have fetched speculatively while controller wrote the buffer
+              if ( !(ep_idx & 0x01) && qtd->buffer[0] )
+              {
+                // page 0 address is taken from page 1 which controller does not touch
+                dma_cache_invalidate((void*) (tu_align4k(qtd->buffer[1]) - 4096 + qtd->buffer_offset), qtd_bytes);
+              }
+
+              if ( qtd->halted )
+              {
+                result = XFER_RESULT_STALLED;
+              }
+              else if ( qtd->xact_err || qtd->buffer_err )
+              {
+                result = XFER_RESULT_FAILED;
+              }
+
+              if ( (result != XFER_RESULT_SUCCESS) || qtd->total_bytes || qtd->xfer_last ) break;
+              idx = qtd_idx(p_dcd, qtd->next);
+            }
+
+            if ( p_dcd->qtd[idx].active ) break; // more qtds still pending
+
+            // skip the rest of a transfer terminated early
+            uint8_t last = idx;
+            while ( !p_dcd->qtd[last].xfer_last ) last = qtd_idx(p_dcd, p_dcd->qtd[last].next);
+
+            uint32_t const next = p_dcd->qtd[last].next;
+
+            if ( last != idx )
+            {
+              dcd_reg->ENDPTFLUSH = TU_BIT( ep_idx2bit(ep_idx) );
+              while (dcd_reg->ENDPTFLUSH) {}
+
+              // restart with the next queued transfer
+              if ( !(next & QTD_NEXT_INVALID) )
+              {
+                p_qhd->qtd_overlay.next = next;
+                dcd_reg->ENDPTPRIME = TU_BIT( ep_idx2bit(ep_idx) );
+              }
+            }
+
+            if ( next & QTD_NEXT_INVALID )
+            {
+              p_qhd->qtd_head = p_qhd->qtd_tail = QTD_NONE;
+            }else
+            {
+              p_qhd->qtd_head = qtd_idx(p_dcd, next);
+            }
+            qtd_free(p_dcd, first, last);
+
+            dcd_event_xfer_complete(rhport, ep_addr, xferred_bytes, result, true);
+          }
         }
       }
     }
@@ -36,11 +36,20 @@
 
 #define CXD56_EPNUM (7)
 
+// Requests per non-control endpoint. Transfers submitted while the endpoint is busy are queued
+// to the usbdev driver behind the ones in progress, each request uses the caller's buffer.
+#ifndef DCD_CXD56_REQ_COUNT
+#define DCD_CXD56_REQ_COUNT (2)
+#endif
+
+TU_VERIFY_STATIC(DCD_CXD56_REQ_COUNT <= 8, "request busy mask is 8-bit");
+
 struct usbdcd_driver_s
 {
   struct usbdevclass_driver_s usbdevclass_driver;
   FAR struct usbdev_ep_s *ep[CXD56_EPNUM];
-  FAR struct usbdev_req_s *req[CXD56_EPNUM];
+  FAR struct usbdev_req_s *req[CXD56_EPNUM][DCD_CXD56_REQ_COUNT];
+  volatile uint8_t req_busy[CXD56_EPNUM]; // bitmask of requests submitted and not completed
 };
 
 static struct usbdcd_driver_s usbdcd_driver;
@@ -68,7 +77,10 @@ static void usbdcd_ep0incomplete(FAR struct usbdev_ep_s *ep, FAR struct usbdev_r
 {
   (void) ep;
 
-  uint8_t ep_addr = (uint32_t)req->priv;
+  // priv holds endpoint address and request index
+  uint32_t const priv = (uint32_t)req->priv;
+  uint8_t ep_addr = (uint8_t) priv;
+  usbdcd_driver.req_busy[tu_edpt_number(ep_addr)] &= (uint8_t) ~TU_BIT(priv >> 8);
 
   if (req->result || req->xfrd != req->len)
   {
@@ -93,19 +105,19 @@ static int dcd_bind(FAR struct usbdevclass_driver_s *driver, FAR struct usbdev_s
   usbdev = dev;
   usbdcd_driver.ep[0] = dev->ep0;
 
-  usbdcd_driver.req[0] = EP_ALLOCREQ(usbdcd_driver.ep[0]);
-  if (usbdcd_driver.req[0] != NULL)
+  usbdcd_driver.req[0][0] = EP_ALLOCREQ(usbdcd_driver.ep[0]);
+  if (usbdcd_driver.req[0][0] != NULL)
   {
-    usbdcd_driver.req[0]->len = 64;
-    usbdcd_driver.req[0]->buf = EP_ALLOCBUFFER(usbdcd_driver.ep[0], 64);
-    if (!usbdcd_driver.req[0]->buf)
+    usbdcd_driver.req[0][0]->len = 64;
+    usbdcd_driver.req[0][0]->buf = EP_ALLOCBUFFER(usbdcd_driver.ep[0], 64);
+    if (!usbdcd_driver.req[0][0]->buf)
     {
-      EP_FREEREQ(usbdcd_driver.ep[0], usbdcd_driver.req[0]);
-      usbdcd_driver.req[0] = NULL;
+      EP_FREEREQ(usbdcd_driver.ep[0], usbdcd_driver.req[0][0]);
+      usbdcd_driver.req[0][0] = NULL;
     }
   }
 
-  usbdcd_driver.req[0]->callback = usbdcd_ep0incomplete;
+  usbdcd_driver.req[0][0]->callback = usbdcd_ep0incomplete;
 
   DEV_CONNECT(dev);
   return 0;
@@ -201,6 +213,18 @@ void dcd_remote_wakeup(uint8_t rhport)
   DEV_WAKEUP(usbdev);
 }
 
+void dcd_get_caps(uint8_t rhport, dcd_caps_t* caps)
+{
+  (void) rhport;
+
+  // usbdev request length is 16-bit
+  caps->max_xfer_bytes = UINT16_MAX;
+  caps->speed          = TUSB_SPEED_HIGH;
+  caps->multi_packet   = 1;
+  caps->dma            = 1;
+  caps->iso            = 1;
+}
+
 //--------------------------------------------------------------------+
 // Endpoint API
 //--------------------------------------------------------------------+
@@ -238,18 +262,19 @@ bool dcd_edpt_open(uint8_t rhport, tusb_desc_endpoint_t const *p_endpoint_desc)
     return false;
   }
 
-  usbdcd_driver.req[epnum] = NULL;
-  usbdcd_driver.req[epnum] = EP_ALLOCREQ(usbdcd_driver.ep[epnum]);
-  if (usbdcd_driver.req[epnum] != NULL)
-  {
-    usbdcd_driver.req[epnum]->len = p_endpoint_desc->wMaxPacketSize.size;
-  }
-  else
+  usbdcd_driver.req_busy[epnum] = 0;
+  for (uint8_t i = 0; i < DCD_CXD56_REQ_COUNT; i++)
   {
-    return false;
-  }
+    FAR struct usbdev_req_s *req = EP_ALLOCREQ(usbdcd_driver.ep[epnum]);
+    usbdcd_driver.req[epnum][i] = req;
+    if (req == NULL)
+    {
+      return false;
+    }
 
-  usbdcd_driver.req[epnum]->callback = usbdcd_ep0incomplete;
+    req->len = p_endpoint_desc->wMaxPacketSize.size;
+    req->callback = usbdcd_ep0incomplete;
+  }
 
   epdesc.len = p_endpoint_desc->bLength;
   epdesc.type = p_endpoint_desc->bDescriptorType;
@@ -267,7 +292,7 @@ bool dcd_edpt_open(uint8_t rhport, tusb_desc_endpoint_t const *p_endpoint_desc)
   return true;
 }
 
-bool dcd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t *buffer, uint16_t total_bytes)
+bool dcd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t *buffer, uint32_t total_bytes)
 {
   (void) rhport;
 
@@ -278,27 +303,54 @@ bool dcd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t *buffer, uint16_t to
     return false;
   }
 
-  usbdcd_driver.req[epnum]->len = total_bytes;
-  usbdcd_driver.req[epnum]->priv = (void *)((uint32_t)ep_addr);
-  usbdcd_driver.req[epnum]->flags = 0;
+  // usbdev request length is 16-bit
+  TU_ASSERT(total_bytes <= UINT16_MAX);
+
+  // first request not in flight, control endpoint has a single one
+  uint8_t idx = 0;
+  while ((idx < DCD_CXD56_REQ_COUNT) && (usbdcd_driver.req[epnum][idx] != NULL) &&
+         (usbdcd_driver.req_busy[epnum] & TU_BIT(idx)))
+  {
+    idx++;
+  }
+
+  TU_VERIFY(idx < DCD_CXD56_REQ_COUNT && usbdcd_driver.req[epnum][idx] != NULL);
+
+  FAR struct usbdev_req_s *req = usbdcd_driver.req[epnum][idx];
+
+  req->len = (uint16_t) total_bytes;
+  req->priv = (void *)((uint32_t)ep_addr | ((uint32_t)idx << 8));
+  req->flags = 0;
 
   if (total_bytes)
   {
-    usbdcd_driver.req[epnum]->buf = buffer;
+    // caller's buffer is used as request buffer, no copy
+    req->buf = buffer;
   }
   else
   {
     return true;
   }
 
-  if (EP_SUBMIT(usbdcd_driver.ep[epnum], usbdcd_driver.req[epnum]) < 0)
+  usbdcd_driver.req_busy[epnum] |= (uint8_t) TU_BIT(idx);
+
+  if (EP_SUBMIT(usbdcd_driver.ep[epnum], req) < 0)
   {
+    usbdcd_driver.req_busy[epnum] &= (uint8_t) ~TU_BIT(idx);
     return false;
   }
 
   return true;
 }
 
+// usbdev driver queues the request behind the ones in progress
+bool dcd_edpt_xfer_append(uint8_t rhport, uint8_t ep_addr, uint8_t *buffer, uint32_t total_bytes)
+{
+  TU_VERIFY(tu_edpt_number(ep_addr) && total_bytes);
+
+  return dcd_edpt_xfer(rhport, ep_addr, buffer, total_bytes);
+}
+
 void dcd_edpt_stall(uint8_t rhport, uint8_t ep_addr)
 {
   (void) rhport;
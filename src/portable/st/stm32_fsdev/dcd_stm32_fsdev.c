@@ -62,7 +62,7 @@
  *   - Does it work? No clue.
  * - All EP BTABLE buffers are created as max 64 bytes.
  *   - Smaller can be requested, but it has to be an even number.
- * - No isochronous endpoints
+ * - Isochronous endpoints always use both hardware buffers, one packet ahead
  * - Endpoint index is the ID of the endpoint
  *   - This means that priority is given to endpoints with lower ID numbers
  *   - Code is mixing up EP IX with EP ID. Everywhere.
@@ -70,7 +70,7 @@
  * - Packet buffer memory is copied in the interrupt.
  *   - This is better for performance, but means interrupts are disabled for longer
  *   - DMA may be the best choice, but it could also be pushed to the USBD task.
- * - No double-buffering
+ * - Double-buffering only for bulk endpoints listed in DCD_STM32_DOUBLE_BUFFER_EP
  * - No DMA
  * - No provision to control the D+ pull-up using GPIO on devices without an internal pull-up.
  * - Minimal error handling
@@ -80,7 +80,7 @@
  * - F3 models use three separate interrupts. I think we could only use the LP interrupt for
  *     everything?  However, the interrupts are configurable so the DisableInt and EnableInt
  *     below functions could be adjusting the wrong interrupts (if they had been reconfigured)
- * - LPM is not used correctly, or at all?
+ * - LPM (L1) is only supported on parts having LPMCSR register, with CFG_TUD_LPM
  *
  * USB documentation and Reference implementations
  * - STM32 Reference manuals
@@ -96,9 +96,9 @@
  * - Tiny (saves RAM, assumes a single USB peripheral)
  *
  * Notes:
- * - The buffer table is allocated as endpoints are opened. The allocation is only
- *   cleared when the device is reset. This may be bad if the USB device needs
- *   to be reconfigured.
+ * - Packet buffers are allocated first-fit as endpoints are opened. A reopened endpoint
+ *   (alternate setting) keeps or replaces its own buffer, all non-control buffers are
+ *   released on SET_CONFIGURATION and everything on bus reset.
  */
 
 #include "tusb_option.h"
@@ -143,6 +143,23 @@
 #  define DCD_STM32_BTABLE_LENGTH (PMA_LENGTH - DCD_STM32_BTABLE_BASE)
 #endif
 
+// Bitmask of endpoint numbers whose bulk endpoint uses both hardware packet buffers, so that the
+// next packet is moved over USB while the CPU copies the previous one. Double-buffering takes the
+// buffer of the other direction; only one direction of these endpoint numbers can be opened.
+// e.g (1u << 2) | (1u << 3) for OUT 0x02 and IN 0x83
+#ifndef DCD_STM32_DOUBLE_BUFFER_EP
+#  define DCD_STM32_DOUBLE_BUFFER_EP 0u
+#endif
+
+// Optional static packet memory layout: bytes reserved for endpoint address ep (1-7 and 0x81-0x87),
+// 0 for allocating its buffer when opened. Double-buffered and isochronous endpoints need two packets.
+// e.g ((ep) == 0x81 ? 128u : (ep) == 0x02 ? 128u : (ep) == 0x83 ? 8u : 0u)
+// Planned buffers are checked against packet memory at build time and placed after the buffer table
+// in endpoint order, the other ones are allocated from the remaining memory.
+#ifndef DCD_STM32_PMA_PLAN
+#  define DCD_STM32_PMA_PLAN(ep) 0u
+#endif
+
 /***************************************************
  * Checks, structs, defines, function definitions, etc.
  */
@@ -154,13 +171,39 @@ TU_VERIFY_STATIC(((DCD_STM32_BTABLE_BASE) + (DCD_STM32_BTABLE_LENGTH))<=(PMA_LEN
 
 TU_VERIFY_STATIC(((DCD_STM32_BTABLE_BASE) % 8) == 0, "BTABLE base must be aligned to 8 bytes");
 
+TU_VERIFY_STATIC(((DCD_STM32_DOUBLE_BUFFER_EP) & 1u) == 0, "Control endpoint can not be double-buffered");
+
+// Packet buffers follow the buffer table (8 bytes per endpoint: two TX and two RX words, each)
+#define PMA_BUF_START   ((DCD_STM32_BTABLE_BASE) + 8u*(MAX_EP_COUNT))
+#define PMA_BUF_END     ((DCD_STM32_BTABLE_BASE) + (DCD_STM32_BTABLE_LENGTH))
+
+// Planned buffer of endpoint address (16-bit aligned), and both of endpoint number n
+#define PMA_PLAN(ep)      ((((ep) & 0x7fu) == 0u || ((ep) & 0x7fu) >= (MAX_EP_COUNT)) ? 0u : \
+                           ((DCD_STM32_PMA_PLAN(ep)) + 1u) & ~1u)
+#define PMA_PLAN_EPNUM(n) (PMA_PLAN(n) + PMA_PLAN(0x80u | (n)))
+
+#define PMA_PLAN_TOTAL  (PMA_PLAN_EPNUM(1u) + PMA_PLAN_EPNUM(2u) + PMA_PLAN_EPNUM(3u) + PMA_PLAN_EPNUM(4u) + \
+                         PMA_PLAN_EPNUM(5u) + PMA_PLAN_EPNUM(6u) + PMA_PLAN_EPNUM(7u))
+
+// Buffers allocated when endpoints are opened follow the planned ones
+#define PMA_DYN_START   (PMA_BUF_START + PMA_PLAN_TOTAL)
+
+#if PMA_DYN_START + 2u*(CFG_TUD_ENDPOINT0_SIZE) > PMA_BUF_END
+  #error "Buffer table, EP0 and planned buffers (DCD_STM32_PMA_PLAN) do not fit packet memory"
+#endif
+
 // One of these for every EP IN & OUT, uses a bit of RAM....
 typedef struct
 {
   uint8_t * buffer;
-  uint16_t total_len;
-  uint16_t queued_len;
+  uint32_t total_len;
+  uint32_t queued_len;
   uint16_t max_packet_size;
+  bool     double_buffered;
+  bool     iso;
+  uint8_t  dbuf_pending; // IN packets written to packet memory but not yet sent
+  uint16_t pma_addr;
+  uint16_t pma_size;     // 0 if no packet buffer is allocated
 } xfer_ctl_t;
 
 static xfer_ctl_t xfer_status[MAX_EP_COUNT][2];
@@ -175,13 +218,19 @@ static TU_ATTR_ALIGNED(4) uint32_t _setup_packet[6];
 static uint8_t newDADDR; // Used to set the new device address during the CTR IRQ handler
 static uint8_t remoteWakeCountdown; // When wake is requested
 
-// EP Buffers assigned from end of memory location, to minimize their chance of crashing
-// into the stack.
-static uint16_t ep_buf_ptr;
+// LPMCSR and its L1 interrupt exist on L0, L4, G4 etc. (LMPEN is CMSIS spelling)
+#if CFG_TUD_LPM && defined(USB_LPMCSR_LMPEN)
+  #define DCD_STM32_LPM  1
+static bool _lpm_sleep; // in L1, woken up by WKUP interrupt
+#else
+  #define DCD_STM32_LPM  0
+#endif
+
 static void dcd_handle_bus_reset(void);
 static bool dcd_write_packet_memory(uint16_t dst, const void *__restrict src, size_t wNBytes);
 static bool dcd_read_packet_memory(void *__restrict dst, uint16_t src, size_t wNBytes);
 static void dcd_transmit_packet(xfer_ctl_t * xfer, uint16_t ep_ix);
+static void dcd_dbuf_fill(xfer_ctl_t * xfer, uint16_t ep_ix, uint8_t buf);
 static uint16_t dcd_ep_ctr_handler(void);
 
 
@@ -191,6 +240,25 @@ static inline void reg16_clear_bits(__IO uint16_t *reg, uint16_t mask) {
   *reg = (uint16_t)(*reg & ~mask);
 }
 
+// Double-buffered endpoints use the TX address/count words for buffer 0 and the RX ones for buffer 1.
+// The USB peripheral works on the buffer selected by the DTOG bit of the endpoint direction, while
+// SW_BUF (the DTOG bit of the other direction) belongs to the application. When both are equal
+// the endpoint NAKs, the STAT bits stay VALID.
+static inline __IO uint16_t* dbuf_address_ptr(uint32_t bEpNum, uint8_t buf)
+{
+  return buf ? pcd_ep_rx_address_ptr(USB, bEpNum) : pcd_ep_tx_address_ptr(USB, bEpNum);
+}
+
+static inline __IO uint16_t* dbuf_cnt_ptr(uint32_t bEpNum, uint8_t buf)
+{
+  return buf ? pcd_ep_rx_cnt_ptr(USB, bEpNum) : pcd_ep_tx_cnt_ptr(USB, bEpNum);
+}
+
+static inline bool dbuf_equal(uint16_t wEPVal)
+{
+  return ((wEPVal & USB_EP_DTOG_RX) == 0U) == ((wEPVal & USB_EP_DTOG_TX) == 0U);
+}
+
 void dcd_init (uint8_t rhport)
 {
   (void)rhport;
@@ -235,7 +303,15 @@ void dcd_init (uint8_t rhport)
   {
     pma[PMA_STRIDE*(DCD_STM32_BTABLE_BASE + i)] = 0u;
   }
-  USB->CNTR |= USB_CNTR_RESETM | USB_CNTR_SOFM | USB_CNTR_ESOFM | USB_CNTR_CTRM | USB_CNTR_SUSPM | USB_CNTR_WKUPM;
+  // SOF is enabled by dcd_sof_enable()
+  USB->CNTR |= USB_CNTR_RESETM | USB_CNTR_ESOFM | USB_CNTR_CTRM | USB_CNTR_SUSPM | USB_CNTR_WKUPM;
+
+#if DCD_STM32_LPM
+  // acknowledge LPM tokens, L1 request interrupt once the handshake is sent
+  USB->LPMCSR = USB_LPMCSR_LMPEN | USB_LPMCSR_LPMACK;
+  USB->CNTR  |= USB_CNTR_L1REQM;
+#endif
+
   dcd_handle_bus_reset();
 
   // And finally enable pull-up, which may trigger the RESET IRQ if the host is connected.
@@ -310,17 +386,68 @@ void dcd_set_config (uint8_t rhport, uint8_t config_num)
 {
   (void) rhport;
   (void) config_num;
-  // Nothing to do? Handled by stack.
+
+  // Endpoints of the new configuration are opened afterwards, release the ones of the old one
+  for(uint32_t i=1; i<MAX_EP_COUNT; i++)
+  {
+    pcd_set_ep_tx_status(USB, i, USB_EP_TX_DIS);
+    pcd_set_ep_rx_status(USB, i, USB_EP_RX_DIS);
+    for(uint32_t dir=0; dir<2; dir++)
+    {
+      xfer_ctl_ptr(i, dir)->pma_size = 0;
+      xfer_ctl_ptr(i, dir)->double_buffered = false;
+      xfer_ctl_ptr(i, dir)->iso = false;
+    }
+  }
 }
 
 void dcd_remote_wakeup(uint8_t rhport)
 {
   (void) rhport;
 
+#if DCD_STM32_LPM
+  // L1 resume signalling is timed by hardware (50 us), which also clears L1RESUME
+  if ( _lpm_sleep )
+  {
+    USB->CNTR |= (uint16_t) USB_CNTR_L1RESUME;
+    return;
+  }
+#endif
+
   USB->CNTR |= (uint16_t) USB_CNTR_RESUME;
   remoteWakeCountdown = 4u; // required to be 1 to 15 ms, ESOF should trigger every 1ms.
 }
 
+void dcd_get_caps(uint8_t rhport, dcd_caps_t* caps)
+{
+  (void) rhport;
+
+  // packets are copied to packet memory by cpu, one at a time
+  caps->max_xfer_bytes = UINT32_MAX;
+  caps->double_buffer  = (DCD_STM32_DOUBLE_BUFFER_EP != 0);
+  caps->iso            = 1;
+}
+
+uint32_t dcd_frame_number(uint8_t rhport)
+{
+  (void) rhport;
+  return USB->FNR & USB_FNR_FN;
+}
+
+void dcd_sof_enable(uint8_t rhport, bool en)
+{
+  (void) rhport;
+
+  if ( en )
+  {
+    reg16_clear_bits(&USB->ISTR, USB_ISTR_SOF); // stale one
+    USB->CNTR |= USB_CNTR_SOFM;
+  }else
+  {
+    reg16_clear_bits(&USB->CNTR, USB_CNTR_SOFM);
+  }
+}
+
 // I'm getting a weird warning about missing braces here that I don't
 // know how to fix.
 #if defined(__GNUC__) && (__GNUC__ >= 7)
@@ -356,7 +483,10 @@ static void dcd_handle_bus_reset(void)
     pcd_set_endpoint(USB,i,0u);
   }
 
-  ep_buf_ptr = DCD_STM32_BTABLE_BASE + 8*MAX_EP_COUNT; // 8 bytes per endpoint (two TX and two RX words, each)
+  tu_memclr(xfer_status, sizeof(xfer_status)); // also frees all packet buffers
+#if DCD_STM32_LPM
+  _lpm_sleep = false;
+#endif
   dcd_edpt_open (0, &ep0OUT_desc);
   dcd_edpt_open (0, &ep0IN_desc);
   newDADDR = 0u;
@@ -451,7 +581,7 @@ static uint16_t dcd_ep_ctr_handler(void)
           if (count != 0U)
           {
             dcd_read_packet_memory(xfer->buffer, *pcd_ep_rx_address_ptr(USB,EPindex), count);
-            xfer->queued_len = (uint16_t)(xfer->queued_len + count);
+            xfer->queued_len += count;
           }
 
           /* Process Control Data OUT status Packet*/
@@ -469,7 +599,66 @@ static uint16_t dcd_ep_ctr_handler(void)
     {
       /* process related endpoint register */
       wEPVal = pcd_get_endpoint(USB, EPindex);
-      if ((wEPVal & USB_EP_CTR_RX) != 0U) // OUT
+      if (((wEPVal & USB_EP_CTR_RX) != 0U) && xfer_ctl_ptr(EPindex,TUSB_DIR_OUT)->iso) // isochronous OUT
+      {
+        pcd_clear_rx_ep_ctr(USB, EPindex);
+
+        xfer_ctl_t * xfer = xfer_ctl_ptr(EPindex,TUSB_DIR_OUT);
+
+        // Hardware already receives the next packet into the other buffer
+        uint8_t const buf = (uint8_t) (((wEPVal & USB_EP_DTOG_RX) != 0U) ? 0u : 1u);
+        count = *dbuf_cnt_ptr(EPindex, buf) & 0x3ffU;
+
+        if (xfer->buffer != NULL) // packets without a queued transfer are dropped
+        {
+          count = tu_min32(count, xfer->total_len - xfer->queued_len);
+          if (count != 0U)
+          {
+            dcd_read_packet_memory(&(xfer->buffer[xfer->queued_len]), *dbuf_address_ptr(EPindex, buf), count);
+            xfer->queued_len += count;
+          }
+
+          if ((count < xfer->max_packet_size) || (xfer->queued_len == xfer->total_len))
+          {
+            // Ignore the host until the next transfer is queued
+            pcd_set_ep_rx_status(USB, EPindex, USB_EP_RX_DIS);
+            xfer->buffer = NULL;
+            dcd_event_xfer_complete(0, EPindex, xfer->queued_len, XFER_RESULT_SUCCESS, true);
+          }
+        }
+      }
+      else if (((wEPVal & USB_EP_CTR_RX) != 0U) && xfer_ctl_ptr(EPindex,TUSB_DIR_OUT)->double_buffered) // double-buffered OUT
+      {
+        pcd_clear_rx_ep_ctr(USB, EPindex);
+
+        xfer_ctl_t * xfer = xfer_ctl_ptr(EPindex,TUSB_DIR_OUT);
+
+        // DTOG_RX was toggled on reception, the packet is in the other buffer
+        uint8_t const buf = (uint8_t) (((wEPVal & USB_EP_DTOG_RX) != 0U) ? 0u : 1u);
+        uint32_t const remaining = xfer->total_len - xfer->queued_len;
+        count = *dbuf_cnt_ptr(EPindex, buf) & 0x3ffU;
+
+        // Release the free buffer before copying so that the host can send the next packet meanwhile.
+        // The last packet of a transfer keeps the endpoint NAKing until the next dcd_edpt_xfer().
+        bool const more = (count == xfer->max_packet_size) && (count < remaining);
+        if (more && dbuf_equal(wEPVal))
+        {
+          pcd_tx_dtog(USB, EPindex); // SW_BUF
+        }
+
+        count = tu_min32(count, remaining);
+        if (count != 0U)
+        {
+          dcd_read_packet_memory(&(xfer->buffer[xfer->queued_len]), *dbuf_address_ptr(EPindex, buf), count);
+          xfer->queued_len += count;
+        }
+
+        if (!more)
+        {
+          dcd_event_xfer_complete(0, EPindex, xfer->queued_len, XFER_RESULT_SUCCESS, true);
+        }
+      }
+      else if ((wEPVal & USB_EP_CTR_RX) != 0U) // OUT
       {
         /* clear int flag */
         pcd_clear_rx_ep_ctr(USB, EPindex);
@@ -486,7 +675,7 @@ static uint16_t dcd_ep_ctr_handler(void)
         }
 
         /*multi-packet on the NON control OUT endpoint */
-        xfer->queued_len = (uint16_t)(xfer->queued_len + count);
+        xfer->queued_len += count;
 
         if ((count < xfer->max_packet_size) || (xfer->queued_len == xfer->total_len))
         {
@@ -516,7 +705,33 @@ static uint16_t dcd_ep_ctr_handler(void)
 
         xfer_ctl_t * xfer = xfer_ctl_ptr(EPindex,TUSB_DIR_IN);
 
-        if (xfer->queued_len  != xfer->total_len) // data remaining in transfer?
+        if (xfer->iso)
+        {
+          // DTOG_TX was toggled, the buffer sent next is free
+          if (xfer->queued_len != xfer->total_len)
+          {
+            dcd_dbuf_fill(xfer, EPindex, (uint8_t) (((wEPVal & USB_EP_DTOG_TX) != 0U) ? 1u : 0u));
+          } else {
+            pcd_set_ep_tx_status(USB, EPindex, USB_EP_TX_DIS);
+            dcd_event_xfer_complete(0, (uint8_t)(0x80 + EPindex), xfer->total_len, XFER_RESULT_SUCCESS, true);
+          }
+        }
+        else if (xfer->double_buffered)
+        {
+          xfer->dbuf_pending--;
+          if (xfer->dbuf_pending)
+          {
+            // Hand the already written packet to the USB, then refill the buffer just sent
+            pcd_rx_dtog(USB, EPindex); // SW_BUF
+            if (xfer->queued_len != xfer->total_len)
+            {
+              dcd_dbuf_fill(xfer, EPindex, (uint8_t) (((wEPVal & USB_EP_DTOG_TX) != 0U) ? 0u : 1u));
+            }
+          } else {
+            dcd_event_xfer_complete(0, (uint8_t)(0x80 + EPindex), xfer->total_len, XFER_RESULT_SUCCESS, true);
+          }
+        }
+        else if (xfer->queued_len  != xfer->total_len) // data remaining in transfer?
         {
           dcd_transmit_packet(xfer, EPindex);
         } else {
@@ -528,12 +743,12 @@ static uint16_t dcd_ep_ctr_handler(void)
   return 0;
 }
 
-static void dcd_fs_irqHandler(void) {
+static TU_ATTR_FAST_FUNC void dcd_fs_irqHandler(void) {
 
   uint32_t int_status = USB->ISTR;
   //const uint32_t handled_ints = USB_ISTR_CTR | USB_ISTR_RESET | USB_ISTR_WKUP
   //    | USB_ISTR_SUSP | USB_ISTR_SOF | USB_ISTR_ESOF;
-  // unused IRQs: (USB_ISTR_PMAOVR | USB_ISTR_ERR | USB_ISTR_L1REQ )
+  // unused IRQs: (USB_ISTR_PMAOVR | USB_ISTR_ERR), USB_ISTR_L1REQ with DCD_STM32_LPM only
 
   // The ST driver loops here on the CTR bit, but that loop has been moved into the
   // dcd_ep_ctr_handler(), so less need to loop here. The other interrupts shouldn't
@@ -560,8 +775,33 @@ static void dcd_fs_irqHandler(void) {
     reg16_clear_bits(&USB->CNTR, USB_CNTR_LPMODE);
     reg16_clear_bits(&USB->CNTR, USB_CNTR_FSUSP);
     reg16_clear_bits(&USB->ISTR, USB_ISTR_WKUP);
-    dcd_event_bus_signal(0, DCD_EVENT_RESUME, true);
+
+#if DCD_STM32_LPM
+    if ( _lpm_sleep )
+    {
+      _lpm_sleep = false;
+      dcd_event_bus_signal(0, DCD_EVENT_LPM_RESUME, true);
+    }else
+#endif
+    {
+      dcd_event_bus_signal(0, DCD_EVENT_RESUME, true);
+    }
+  }
+
+#if DCD_STM32_LPM
+  if (int_status & USB_ISTR_L1REQ)
+  {
+    // LPM token is acked: enter L1 like suspend, BESL and bRemoteWake of the token are latched in LPMCSR
+    uint16_t const lpmcsr = USB->LPMCSR;
+
+    _lpm_sleep = true;
+    USB->CNTR |= USB_CNTR_FSUSP;
+    USB->CNTR |= USB_CNTR_LPMODE;
+    reg16_clear_bits(&USB->ISTR, USB_ISTR_L1REQ);
+
+    dcd_event_lpm_sleep(0, (uint8_t) ((lpmcsr & USB_LPMCSR_BESL) >> 4), (lpmcsr & USB_LPMCSR_REMWAKE) != 0, true);
   }
+#endif
 
   if (int_status & USB_ISTR_SUSP)
   {
@@ -577,7 +817,8 @@ static void dcd_fs_irqHandler(void) {
     dcd_event_bus_signal(0, DCD_EVENT_SUSPEND, true);
   }
 
-  if(int_status & USB_ISTR_SOF) {
+  // flag is set even if masked
+  if((int_status & USB_ISTR_SOF) && (USB->CNTR & USB_CNTR_SOFM)) {
     reg16_clear_bits(&USB->ISTR, USB_ISTR_SOF);
     dcd_event_bus_signal(0, DCD_EVENT_SOF, true);
   }
@@ -602,27 +843,101 @@ static void dcd_fs_irqHandler(void) {
 // The STM32F0 doesn't seem to like |= or &= to manipulate the EP#R registers,
 // so I'm using the #define from HAL here, instead.
 
+// Allocate packet buffer of an endpoint direction: planned one, otherwise first fit. A reopened
+// endpoint keeps its buffer if large enough. Returns 0 if packet memory is exhausted.
+static uint16_t pma_alloc(uint8_t epnum, uint8_t dir, uint16_t size)
+{
+  xfer_ctl_t * xfer = xfer_ctl_ptr(epnum, dir);
+  uint8_t const ep_addr = tu_edpt_addr(epnum, dir);
+
+  if (PMA_PLAN(ep_addr))
+  {
+    TU_VERIFY(size <= PMA_PLAN(ep_addr), 0);
+
+    // OUT n then IN n for each endpoint number before
+    uint32_t addr = PMA_BUF_START;
+    for(uint8_t n = 1; n < epnum; n++) addr += PMA_PLAN_EPNUM(n);
+    if (dir == TUSB_DIR_IN) addr += PMA_PLAN(epnum);
+
+    xfer->pma_addr = (uint16_t) addr;
+    xfer->pma_size = (uint16_t) PMA_PLAN(ep_addr);
+    return xfer->pma_addr;
+  }
+
+  if (xfer->pma_size >= size) return xfer->pma_addr;
+  xfer->pma_size = 0;
+
+  // Candidates are the start of packet memory and the end of each allocated buffer
+  uint16_t found = 0;
+  for(uint32_t c = 0; c <= 2*MAX_EP_COUNT; c++)
+  {
+    uint16_t addr;
+    if (c == 0)
+    {
+      addr = PMA_DYN_START;
+    }
+    else
+    {
+      xfer_ctl_t const * other = &xfer_status[0][0] + (c-1);
+      if (!other->pma_size) continue;
+      addr = (uint16_t) (other->pma_addr + other->pma_size);
+    }
+
+    if (addr < PMA_DYN_START || (uint32_t) addr + size > PMA_BUF_END) continue;
+    if (found && addr >= found) continue;
+
+    bool overlap = false;
+    for(uint32_t i = 0; i < 2*MAX_EP_COUNT; i++)
+    {
+      xfer_ctl_t const * other = &xfer_status[0][0] + i;
+      if (other->pma_size && (addr < other->pma_addr + other->pma_size) && (other->pma_addr < addr + size))
+      {
+        overlap = true;
+        break;
+      }
+    }
+    if (!overlap) found = addr;
+  }
+
+  if (found)
+  {
+    xfer->pma_addr = found;
+    xfer->pma_size = size;
+  }
+  return found;
+}
+
 bool dcd_edpt_open (uint8_t rhport, tusb_desc_endpoint_t const * p_endpoint_desc)
 {
   (void)rhport;
   uint8_t const epnum = tu_edpt_number(p_endpoint_desc->bEndpointAddress);
   uint8_t const dir   = tu_edpt_dir(p_endpoint_desc->bEndpointAddress);
   const uint16_t epMaxPktSize = p_endpoint_desc->wMaxPacketSize.size;
-  // Isochronous not supported (yet), and some other driver assumptions.
 
-  TU_ASSERT(p_endpoint_desc->bmAttributes.xfer != TUSB_XFER_ISOCHRONOUS);
   TU_ASSERT(epnum < MAX_EP_COUNT);
 
+  bool const iso = (p_endpoint_desc->bmAttributes.xfer == TUSB_XFER_ISOCHRONOUS);
+  bool const double_buffered = (DCD_STM32_DOUBLE_BUFFER_EP & (1u << epnum)) &&
+                               (p_endpoint_desc->bmAttributes.xfer == TUSB_XFER_BULK);
+
+  // Buffers are 16-bit aligned, OUT buffers above 62 bytes are counted in blocks of 32 bytes
+  uint16_t pkt_size = (uint16_t) ((epMaxPktSize + 1u) & ~1u);
+  if (dir == TUSB_DIR_OUT && pkt_size > 62u) pkt_size = (uint16_t) ((pkt_size + 31u) & ~31u);
+
+  // Double-buffered and isochronous endpoint numbers own both buffers of the EPnR
+  TU_ASSERT(!xfer_ctl_ptr(epnum, dir ^ 1u)->double_buffered && !xfer_ctl_ptr(epnum, dir ^ 1u)->iso);
+
+  uint16_t const pma_addr = pma_alloc(epnum, dir, (uint16_t) ((double_buffered || iso) ? 2*pkt_size : pkt_size));
+  TU_ASSERT(pma_addr);
+
   // Set type
   switch(p_endpoint_desc->bmAttributes.xfer) {
   case TUSB_XFER_CONTROL:
     pcd_set_eptype(USB, epnum, USB_EP_CONTROL);
     break;
-#if (0)
-  case TUSB_XFER_ISOCHRONOUS: // FIXME: Not yet supported
-    pcd_set_eptype(USB, epnum, USB_EP_ISOCHRONOUS); break;
+  case TUSB_XFER_ISOCHRONOUS:
+    pcd_set_eptype(USB, epnum, USB_EP_ISOCHRONOUS);
     break;
-#endif
 
   case TUSB_XFER_BULK:
     pcd_set_eptype(USB, epnum, USB_EP_BULK);
@@ -638,27 +953,73 @@ bool dcd_edpt_open (uint8_t rhport, tusb_desc_endpoint_t const * p_endpoint_desc
   }
 
   pcd_set_ep_address(USB, epnum, epnum);
-  // Be normal, for now, instead of only accepting zero-byte packets (on control endpoint)
-  // or being double-buffered (bulk endpoints)
-  pcd_clear_ep_kind(USB,0);
 
-  if(dir == TUSB_DIR_IN)
+  if(iso)
+  {
+    // Isochronous endpoints are double-buffered by hardware: the USB uses the buffer selected by
+    // DTOG of the endpoint direction, toggled after each transaction. Without handshake the endpoint
+    // is disabled while no transfer is queued.
+    pcd_clear_ep_kind(USB, epnum);
+    *dbuf_address_ptr(epnum, 0) = pma_addr;
+    *dbuf_address_ptr(epnum, 1) = (uint16_t) (pma_addr + pkt_size);
+    pcd_clear_rx_dtog(USB, epnum);
+    pcd_clear_tx_dtog(USB, epnum);
+
+    if(dir == TUSB_DIR_IN)
+    {
+      *dbuf_cnt_ptr(epnum, 0) = 0;
+      *dbuf_cnt_ptr(epnum, 1) = 0;
+      pcd_set_ep_tx_status(USB, epnum, USB_EP_TX_DIS);
+    }
+    else
+    {
+      pcd_set_ep_cnt_rx_reg(dbuf_cnt_ptr(epnum, 0), epMaxPktSize);
+      pcd_set_ep_cnt_rx_reg(dbuf_cnt_ptr(epnum, 1), epMaxPktSize);
+      pcd_set_ep_rx_status(USB, epnum, USB_EP_RX_DIS);
+    }
+  }
+  else if(double_buffered)
+  {
+    pcd_set_ep_kind(USB, epnum); // DBL_BUF for bulk endpoints
+    *dbuf_address_ptr(epnum, 0) = pma_addr;
+    *dbuf_address_ptr(epnum, 1) = (uint16_t) (pma_addr + pkt_size);
+
+    // DTOG == SW_BUF: NAK until a transfer is queued
+    pcd_clear_rx_dtog(USB, epnum);
+    pcd_clear_tx_dtog(USB, epnum);
+
+    if(dir == TUSB_DIR_IN)
+    {
+      pcd_set_ep_tx_status(USB, epnum, USB_EP_TX_VALID);
+    }
+    else
+    {
+      pcd_set_ep_cnt_rx_reg(dbuf_cnt_ptr(epnum, 0), epMaxPktSize);
+      pcd_set_ep_cnt_rx_reg(dbuf_cnt_ptr(epnum, 1), epMaxPktSize);
+      pcd_set_ep_rx_status(USB, epnum, USB_EP_RX_VALID);
+    }
+  }
+  else if(dir == TUSB_DIR_IN)
   {
-    *pcd_ep_tx_address_ptr(USB, epnum) = ep_buf_ptr;
+    pcd_clear_ep_kind(USB, epnum);
+    *pcd_ep_tx_address_ptr(USB, epnum) = pma_addr;
     pcd_set_ep_tx_cnt(USB, epnum, p_endpoint_desc->wMaxPacketSize.size);
     pcd_clear_tx_dtog(USB, epnum);
     pcd_set_ep_tx_status(USB,epnum,USB_EP_TX_NAK);
   }
   else
   {
-    *pcd_ep_rx_address_ptr(USB, epnum) = ep_buf_ptr;
+    // Be normal, instead of only accepting zero-byte packets (on control endpoint)
+    pcd_clear_ep_kind(USB, epnum);
+    *pcd_ep_rx_address_ptr(USB, epnum) = pma_addr;
     pcd_set_ep_rx_cnt(USB, epnum, p_endpoint_desc->wMaxPacketSize.size);
     pcd_clear_rx_dtog(USB, epnum);
     pcd_set_ep_rx_status(USB, epnum, USB_EP_RX_NAK);
   }
 
   xfer_ctl_ptr(epnum, dir)->max_packet_size = epMaxPktSize;
-  ep_buf_ptr = (uint16_t)(ep_buf_ptr + p_endpoint_desc->wMaxPacketSize.size); // increment buffer pointer
+  xfer_ctl_ptr(epnum, dir)->double_buffered = double_buffered;
+  xfer_ctl_ptr(epnum, dir)->iso = iso;
 
   return true;
 }
@@ -667,21 +1028,27 @@ bool dcd_edpt_open (uint8_t rhport, tusb_desc_endpoint_t const * p_endpoint_desc
 
 static void dcd_transmit_packet(xfer_ctl_t * xfer, uint16_t ep_ix)
 {
-  uint16_t len = (uint16_t)(xfer->total_len - xfer->queued_len);
-
-  if(len > xfer->max_packet_size) // max packet size for FS transfer
-  {
-    len = xfer->max_packet_size;
-  }
+  uint16_t len = (uint16_t) tu_min32(xfer->total_len - xfer->queued_len, xfer->max_packet_size); // max packet size for FS transfer
   uint16_t oldAddr = *pcd_ep_tx_address_ptr(USB,ep_ix);
   dcd_write_packet_memory(oldAddr, &(xfer->buffer[xfer->queued_len]), len);
-  xfer->queued_len = (uint16_t)(xfer->queued_len + len);
+  xfer->queued_len += len;
 
   pcd_set_ep_tx_cnt(USB,ep_ix,len);
   pcd_set_ep_tx_status(USB, ep_ix, USB_EP_TX_VALID);
 }
 
-bool dcd_edpt_xfer (uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint16_t total_bytes)
+// Write next packet into one buffer of a double-buffered IN endpoint, it is sent once SW_BUF is toggled
+static void dcd_dbuf_fill(xfer_ctl_t * xfer, uint16_t ep_ix, uint8_t buf)
+{
+  uint16_t len = (uint16_t) tu_min32(xfer->total_len - xfer->queued_len, xfer->max_packet_size);
+  dcd_write_packet_memory(*dbuf_address_ptr(ep_ix, buf), &(xfer->buffer[xfer->queued_len]), len);
+  xfer->queued_len += len;
+
+  *dbuf_cnt_ptr(ep_ix, buf) = len;
+  xfer->dbuf_pending++;
+}
+
+bool dcd_edpt_xfer (uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint32_t total_bytes)
 {
   (void) rhport;
 
@@ -702,7 +1069,20 @@ bool dcd_edpt_xfer (uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint16_t
     {
         xfer->buffer = (uint8_t*)_setup_packet;
     }
-    if(total_bytes > xfer->max_packet_size)
+    if(xfer->iso)
+    {
+      pcd_set_ep_rx_status(USB, epnum, USB_EP_RX_VALID);
+    }
+    else if(xfer->double_buffered)
+    {
+      // release one buffer to the USB, also re-enable after a cleared stall
+      if(dbuf_equal(pcd_get_endpoint(USB, epnum)))
+      {
+        pcd_tx_dtog(USB, epnum); // SW_BUF
+      }
+      pcd_set_ep_rx_status(USB, epnum, USB_EP_RX_VALID);
+    }
+    else if(total_bytes > xfer->max_packet_size)
     {
       pcd_set_ep_rx_cnt(USB,epnum,xfer->max_packet_size);
     } else {
@@ -710,6 +1090,26 @@ bool dcd_edpt_xfer (uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint16_t
     }
     pcd_set_ep_rx_status(USB, epnum, USB_EP_RX_VALID);
   }
+  else if (xfer->iso)
+  {
+    // Write the buffer the USB sends on the next IN token
+    dcd_dbuf_fill(xfer, epnum, (uint8_t) (((pcd_get_endpoint(USB, epnum) & USB_EP_DTOG_TX) != 0U) ? 1u : 0u));
+    pcd_set_ep_tx_status(USB, epnum, USB_EP_TX_VALID);
+  }
+  else if (xfer->double_buffered)
+  {
+    // Endpoint is idle (DTOG_TX == SW_BUF): fill the buffer sent next and, if needed, the other one
+    uint8_t const buf = (uint8_t) (((pcd_get_endpoint(USB, epnum) & USB_EP_DTOG_TX) != 0U) ? 1u : 0u);
+    xfer->dbuf_pending = 0;
+    dcd_dbuf_fill(xfer, epnum, buf);
+    if (xfer->queued_len != xfer->total_len)
+    {
+      dcd_dbuf_fill(xfer, epnum, (uint8_t) (buf ^ 1u));
+    }
+
+    pcd_rx_dtog(USB, epnum); // SW_BUF
+    pcd_set_ep_tx_status(USB, epnum, USB_EP_TX_VALID);
+  }
   else // IN
   {
     dcd_transmit_packet(xfer,epnum);
@@ -743,11 +1143,19 @@ void dcd_edpt_clear_stall (uint8_t rhport, uint8_t ep_addr)
 
     /* Reset to DATA0 if clearing stall condition. */
     pcd_clear_tx_dtog(USB,ep_addr);
+    if (xfer_ctl_ptr(ep_addr, TUSB_DIR_IN)->double_buffered)
+    {
+      pcd_clear_rx_dtog(USB,ep_addr); // SW_BUF
+    }
   }
   else
   { // OUT
     /* Reset to DATA0 if clearing stall condition. */
     pcd_clear_rx_dtog(USB,ep_addr);
+    if (xfer_ctl_ptr(ep_addr, TUSB_DIR_OUT)->double_buffered)
+    {
+      pcd_clear_tx_dtog(USB,ep_addr); // SW_BUF
+    }
 
     pcd_set_ep_rx_status(USB,ep_addr, USB_EP_RX_NAK);
   }
@@ -756,8 +1164,8 @@ void dcd_edpt_clear_stall (uint8_t rhport, uint8_t ep_addr)
 // Packet buffer access can only be 8- or 16-bit.
 /**
   * @brief Copy a buffer from user memory area to packet memory area (PMA).
-  *        This uses byte-access for user memory (so support non-aligned buffers)
-  *        and 16-bit access for packet memory.
+  *        This uses halfword-access for 16-bit aligned user memory, byte-access
+  *        otherwise (so support non-aligned buffers) and 16-bit access for packet memory.
   * @param   dst, byte address in PMA; must be 16-bit aligned
   * @param   src pointer to user memory area.
   * @param   wPMABufAddr address into PMA.
@@ -778,6 +1186,33 @@ static bool dcd_write_packet_memory(uint16_t dst, const void *__restrict src, si
   srcVal = src;
   pdwVal = &pma[PMA_STRIDE*(dst>>1)];
 
+  if (((uintptr_t) srcVal & 1U) == 0U)
+  {
+    // Aligned: one halfword per PMA word, unrolled. PMA_STRIDE is constant so this
+    // covers both the 1x16 (stride 2) and the 2x16 (stride 1) access schemes.
+    const uint16_t * src16 = (const uint16_t *) srcVal;
+
+    for (i = (uint32_t) wNBytes >> 1U; i >= 4U; i -= 4U)
+    {
+      pdwVal[0]            = src16[0];
+      pdwVal[PMA_STRIDE]   = src16[1];
+      pdwVal[2*PMA_STRIDE] = src16[2];
+      pdwVal[3*PMA_STRIDE] = src16[3];
+      pdwVal += 4*PMA_STRIDE;
+      src16  += 4;
+    }
+    for (; i != 0U; i--)
+    {
+      *pdwVal = *src16++;
+      pdwVal += PMA_STRIDE;
+    }
+    if (wNBytes & 1U)
+    {
+      *pdwVal = *((const uint8_t *) src16);
+    }
+    return true;
+  }
+
   for (i = n; i != 0; i--)
   {
     temp1 = (uint16_t) *srcVal;
@@ -792,7 +1227,8 @@ static bool dcd_write_packet_memory(uint16_t dst, const void *__restrict src, si
 
 /**
   * @brief Copy a buffer from user memory area to packet memory area (PMA).
-  *        Uses byte-access of system memory and 16-bit access of packet memory
+  *        Uses halfword-access of 16-bit aligned system memory, byte-access otherwise,
+  *        and 16-bit access of packet memory
   * @param   wNBytes no. of bytes to be copied.
   * @retval None
   */
@@ -808,12 +1244,36 @@ static bool dcd_read_packet_memory(void *__restrict dst, uint16_t src, size_t wN
   pdwVal = &pma[PMA_STRIDE*(src>>1)];
   uint8_t *dstVal = (uint8_t*)dst;
 
-  for (i = n; i != 0U; i--)
+  if (((uintptr_t) dstVal & 1U) == 0U)
   {
-    temp = *pdwVal;
-    pdwVal += PMA_STRIDE;
-    *dstVal++ = ((temp >> 0) & 0xFF);
-    *dstVal++ = ((temp >> 8) & 0xFF);
+    // Aligned: one halfword per PMA word, unrolled (see dcd_write_packet_memory)
+    uint16_t * dst16 = (uint16_t *) dstVal;
+
+    for (i = n; i >= 4U; i -= 4U)
+    {
+      dst16[0] = pdwVal[0];
+      dst16[1] = pdwVal[PMA_STRIDE];
+      dst16[2] = pdwVal[2*PMA_STRIDE];
+      dst16[3] = pdwVal[3*PMA_STRIDE];
+      pdwVal += 4*PMA_STRIDE;
+      dst16  += 4;
+    }
+    for (; i != 0U; i--)
+    {
+      *dst16++ = *pdwVal;
+      pdwVal += PMA_STRIDE;
+    }
+    dstVal = (uint8_t *) dst16;
+  }
+  else
+  {
+    for (i = n; i != 0U; i--)
+    {
+      temp = *pdwVal;
+      pdwVal += PMA_STRIDE;
+      *dstVal++ = ((temp >> 0) & 0xFF);
+      *dstVal++ = ((temp >> 8) & 0xFF);
+    }
   }
 
   if (wNBytes % 2)
@@ -831,20 +1291,24 @@ static bool dcd_read_packet_memory(void *__restrict dst, uint16_t src, size_t wN
 void USB_IRQHandler(void)
 {
   dcd_fs_irqHandler();
+  dcd_event_isr_exit(0);
 }
 
 #elif CFG_TUSB_MCU == OPT_MCU_STM32F1
 void USB_HP_IRQHandler(void)
 {
   dcd_fs_irqHandler();
+  dcd_event_isr_exit(0);
 }
 void USB_LP_IRQHandler(void)
 {
   dcd_fs_irqHandler();
+  dcd_event_isr_exit(0);
 }
 void USBWakeUp_IRQHandler(void)
 {
   dcd_fs_irqHandler();
+  dcd_event_isr_exit(0);
 }
 
 #elif (CFG_TUSB_MCU) == (OPT_MCU_STM32F3)
@@ -856,6 +1320,7 @@ void USBWakeUp_IRQHandler(void)
 void USB_HP_CAN_TX_IRQHandler(void)
 {
   dcd_fs_irqHandler();
+  dcd_event_isr_exit(0);
 }
 
 // USB low-priority interrupt (Channel 20): Triggered by all USB events
@@ -864,6 +1329,7 @@ void USB_HP_CAN_TX_IRQHandler(void)
 void USB_LP_CAN_RX0_IRQHandler(void)
 {
   dcd_fs_irqHandler();
+  dcd_event_isr_exit(0);
 }
 
 // USB wakeup interrupt (Channel 42): Triggered by the wakeup event from the USB
@@ -871,6 +1337,7 @@ void USB_LP_CAN_RX0_IRQHandler(void)
 void USBWakeUp_IRQHandler(void)
 {
   dcd_fs_irqHandler();
+  dcd_event_isr_exit(0);
 }
 
 #else
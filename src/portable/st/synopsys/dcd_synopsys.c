@@ -42,53 +42,153 @@
       (CFG_TUSB_MCU == OPT_MCU_STM32L4 && defined(STM32L4_SYNOPSYS)) \
     )
 
-// TODO Support OTG_HS
+// Port 0 is OTG_FS, port 1 is OTG_HS. OTG_HS runs at high speed with an external ULPI PHY when
+// CFG_TUSB_RHPORT1_MODE has OPT_MODE_HIGH_SPEED, otherwise at full speed with its embedded PHY.
 // EP_MAX       : Max number of bi-directional endpoints including EP0
 // EP_FIFO_SIZE : Size of dedicated USB SRAM
 #if CFG_TUSB_MCU == OPT_MCU_STM32F2
   #include "stm32f2xx.h"
-  #define EP_MAX          USB_OTG_FS_MAX_IN_ENDPOINTS
-  #define EP_FIFO_SIZE    USB_OTG_FS_TOTAL_FIFO_SIZE
+  #define EP_MAX_FS       USB_OTG_FS_MAX_IN_ENDPOINTS
+  #define EP_FIFO_SIZE_FS USB_OTG_FS_TOTAL_FIFO_SIZE
+  #define EP_MAX_HS       USB_OTG_HS_MAX_IN_ENDPOINTS
+  #define EP_FIFO_SIZE_HS USB_OTG_HS_TOTAL_FIFO_SIZE
 #elif CFG_TUSB_MCU == OPT_MCU_STM32F4
   #include "stm32f4xx.h"
-  #define EP_MAX          USB_OTG_FS_MAX_IN_ENDPOINTS
-  #define EP_FIFO_SIZE    USB_OTG_FS_TOTAL_FIFO_SIZE
+  #define EP_MAX_FS       USB_OTG_FS_MAX_IN_ENDPOINTS
+  #define EP_FIFO_SIZE_FS USB_OTG_FS_TOTAL_FIFO_SIZE
+  #define EP_MAX_HS       USB_OTG_HS_MAX_IN_ENDPOINTS
+  #define EP_FIFO_SIZE_HS USB_OTG_HS_TOTAL_FIFO_SIZE
 #elif CFG_TUSB_MCU == OPT_MCU_STM32H7
   #include "stm32h7xx.h"
-  #define EP_MAX          9
-  #define EP_FIFO_SIZE    4096
+  #define EP_MAX_FS       9
+  #define EP_FIFO_SIZE_FS 4096
+  #define EP_MAX_HS       9
+  #define EP_FIFO_SIZE_HS 4096
   // TODO The official name of the USB FS peripheral on H7 is "USB2_OTG_FS".
+  #if !defined(USB_OTG_HS_PERIPH_BASE) && defined(USB1_OTG_HS_PERIPH_BASE)
+    #define USB_OTG_HS_PERIPH_BASE  USB1_OTG_HS_PERIPH_BASE
+  #endif
 #elif CFG_TUSB_MCU == OPT_MCU_STM32F7
   #include "stm32f7xx.h"
-  #define EP_MAX          6
-  #define EP_FIFO_SIZE    1280
+  #define EP_MAX_FS       6
+  #define EP_FIFO_SIZE_FS 1280
+  #define EP_MAX_HS       9
+  #define EP_FIFO_SIZE_HS 4096
 #elif CFG_TUSB_MCU == OPT_MCU_STM32L4
   #include "stm32l4xx.h"
-  #define EP_MAX          6
-  #define EP_FIFO_SIZE    1280
+  #define EP_MAX_FS       6
+  #define EP_FIFO_SIZE_FS 1280
 #else
   #error "Unsupported MCUs"
 #endif
 
+#if TUD_OPT_RHPORT == 1
+  #ifndef EP_MAX_HS
+    #error "MCU has no OTG_HS"
+  #endif
+  #define EP_MAX          EP_MAX_HS
+  #define EP_FIFO_SIZE    EP_FIFO_SIZE_HS
+  #define OTG_PERIPH_BASE USB_OTG_HS_PERIPH_BASE
+  #define OTG_IRQn        OTG_HS_IRQn
+  #define OTG_IRQHandler  OTG_HS_IRQHandler
+  #define OTG_HS_ULPI     TUD_OPT_HIGH_SPEED
+#else
+  #define EP_MAX          EP_MAX_FS
+  #define EP_FIFO_SIZE    EP_FIFO_SIZE_FS
+  #define OTG_PERIPH_BASE USB_OTG_FS_PERIPH_BASE
+  #define OTG_IRQn        OTG_FS_IRQn
+  #define OTG_IRQHandler  OTG_FS_IRQHandler
+  #define OTG_HS_ULPI     0
+#endif
+
 #include "device/dcd.h"
 
+// Largest OUT packet in bytes, shared OUT FIFO is sized for it. Raise for isochronous OUT endpoint.
+#ifndef DCD_SYNOPSYS_OUT_PACKET_MAX
+#  define DCD_SYNOPSYS_OUT_PACKET_MAX   (TUD_OPT_HIGH_SPEED ? 512 : 64)
+#endif
+
+// Endpoints in use including EP0, each one has a DMA bounce buffer per direction.
+#ifndef DCD_SYNOPSYS_EP_MAX
+#  define DCD_SYNOPSYS_EP_MAX           ((TUD_OPT_RHPORT == 1 && EP_MAX > 6) ? 6 : EP_MAX)
+#endif
+
+// OTG_HS moves packets between its FIFOs and memory with internal DMA, one interrupt per transfer.
+// OTG_FS has no DMA and packets are copied by CPU in interrupt.
+#ifndef DCD_SYNOPSYS_DMA
+#  define DCD_SYNOPSYS_DMA              (TUD_OPT_RHPORT == 1)
+#endif
+
+// DMA only accesses word aligned memory and writes whole OUT packets. Unaligned buffers and the
+// last packet of OUT transfers not a multiple of packet size go through a per-endpoint buffer.
+#ifndef DCD_SYNOPSYS_DMA_BOUNCE_SIZE
+#  define DCD_SYNOPSYS_DMA_BOUNCE_SIZE  DCD_SYNOPSYS_OUT_PACKET_MAX
+#endif
+
+// OUT FIFO in 32-bit words, see bus_reset()
+#ifndef DCD_SYNOPSYS_RX_FIFO_SIZE
+#  define DCD_SYNOPSYS_RX_FIFO_SIZE     (16 + 2*((DCD_SYNOPSYS_OUT_PACKET_MAX+3)/4 + 2))
+#endif
+
+// Packets an IN FIFO holds for bulk endpoints, so the core sends the next one while the previous
+// is being written. Fewer are allocated when USB SRAM runs out. Interrupt endpoints hold one
+// packet, isochronous ones the packets of a (micro)frame.
+#ifndef DCD_SYNOPSYS_TX_FIFO_BULK_PACKETS
+#  define DCD_SYNOPSYS_TX_FIFO_BULK_PACKETS  2
+#endif
+
+// Optional static IN FIFO layout: words of FIFO of IN endpoint n (at least 16), 0 for sizing it when opened.
+// e.g ((n) == 1 ? 128 : (n) == 2 ? 16 : 0) for CDC data endpoint holding 4 packets and its notification.
+// Planned FIFOs are checked against USB SRAM at build time and placed after FIFO 0 in endpoint order,
+// an endpoint then keeps the same FIFO whatever alternate settings are opened before it.
+#ifndef DCD_SYNOPSYS_TX_FIFO_PLAN
+#  define DCD_SYNOPSYS_TX_FIFO_PLAN(n)  0
+#endif
+
+#define RX_FIFO_SIZE    DCD_SYNOPSYS_RX_FIFO_SIZE
+
+#define TX_FIFO_PLAN(n) (((n) >= DCD_SYNOPSYS_EP_MAX || DCD_SYNOPSYS_TX_FIFO_PLAN(n) == 0) ? 0 : \
+                         (DCD_SYNOPSYS_TX_FIFO_PLAN(n) < 16) ? 16 : DCD_SYNOPSYS_TX_FIFO_PLAN(n))
+
+#define TX_FIFO_PLAN_TOTAL  (TX_FIFO_PLAN(1) + TX_FIFO_PLAN(2) + TX_FIFO_PLAN(3) + TX_FIFO_PLAN(4) + \
+                             TX_FIFO_PLAN(5) + TX_FIFO_PLAN(6) + TX_FIFO_PLAN(7) + TX_FIFO_PLAN(8))
+
+#if RX_FIFO_SIZE + 16 + TX_FIFO_PLAN_TOTAL > EP_FIFO_SIZE/4
+  #error "OUT FIFO, FIFO 0 and planned IN FIFOs (DCD_SYNOPSYS_TX_FIFO_PLAN) do not fit USB SRAM"
+#endif
+
+TU_VERIFY_STATIC(DCD_SYNOPSYS_OUT_PACKET_MAX >= 64 && DCD_SYNOPSYS_OUT_PACKET_MAX <= 1024, "OUT packet max is 64-1024");
+TU_VERIFY_STATIC(RX_FIFO_SIZE + 16 < EP_FIFO_SIZE/4, "OUT FIFO does not fit USB SRAM");
+TU_VERIFY_STATIC(DCD_SYNOPSYS_TX_FIFO_BULK_PACKETS >= 1, "IN FIFO holds at least one packet");
+TU_VERIFY_STATIC(DCD_SYNOPSYS_EP_MAX >= 2 && DCD_SYNOPSYS_EP_MAX <= EP_MAX, "Endpoint count is 2-EP_MAX");
+TU_VERIFY_STATIC(!DCD_SYNOPSYS_DMA || TUD_OPT_RHPORT == 1, "Only OTG_HS has DMA");
+TU_VERIFY_STATIC(!DCD_SYNOPSYS_DMA || (DCD_SYNOPSYS_DMA_BOUNCE_SIZE >= 64 && DCD_SYNOPSYS_DMA_BOUNCE_SIZE % 4 == 0), "Bounce buffer is too small");
+
 /*------------------------------------------------------------------*/
 /* MACRO TYPEDEF CONSTANT ENUM
  *------------------------------------------------------------------*/
-#define DEVICE_BASE     (USB_OTG_DeviceTypeDef *) (USB_OTG_FS_PERIPH_BASE + USB_OTG_DEVICE_BASE)
-#define OUT_EP_BASE     (USB_OTG_OUTEndpointTypeDef *) (USB_OTG_FS_PERIPH_BASE + USB_OTG_OUT_ENDPOINT_BASE)
-#define IN_EP_BASE      (USB_OTG_INEndpointTypeDef *) (USB_OTG_FS_PERIPH_BASE + USB_OTG_IN_ENDPOINT_BASE)
-#define FIFO_BASE(_x)   ((volatile uint32_t *) (USB_OTG_FS_PERIPH_BASE + USB_OTG_FIFO_BASE + (_x) * USB_OTG_FIFO_SIZE))
-
-static TU_ATTR_ALIGNED(4) uint32_t _setup_packet[6];
+#define OTG_CORE        ((USB_OTG_GlobalTypeDef *) OTG_PERIPH_BASE)
+#define DEVICE_BASE     (USB_OTG_DeviceTypeDef *) (OTG_PERIPH_BASE + USB_OTG_DEVICE_BASE)
+#define OUT_EP_BASE     (USB_OTG_OUTEndpointTypeDef *) (OTG_PERIPH_BASE + USB_OTG_OUT_ENDPOINT_BASE)
+#define IN_EP_BASE      (USB_OTG_INEndpointTypeDef *) (OTG_PERIPH_BASE + USB_OTG_IN_ENDPOINT_BASE)
+#define FIFO_BASE(_x)   ((volatile uint32_t *) (OTG_PERIPH_BASE + USB_OTG_FIFO_BASE + (_x) * USB_OTG_FIFO_SIZE))
+
+// Setup packets are written by DMA, keep them in a cache line of their own
+static TU_ATTR_ALIGNED(32) uint32_t _setup_packet[8];
 static uint8_t _setup_offs; // We store up to 3 setup packets.
 
 typedef struct {
   uint8_t * buffer;
-  uint16_t total_len;
-  uint16_t queued_len;
+  uint32_t total_len;
+  uint32_t queued_len;
   uint16_t max_size;
+  uint8_t mult;             // isochronous IN: packets per (micro)frame
   bool short_packet;
+  bool iso;
+#if DCD_SYNOPSYS_DMA
+  bool bounce;              // current DMA part uses bounce buffer
+  uint32_t dma_len;         // bytes of current DMA part
+#endif
 } xfer_ctl_t;
 
 typedef volatile uint32_t * usb_fifo_t;
@@ -96,12 +196,188 @@ typedef volatile uint32_t * usb_fifo_t;
 xfer_ctl_t xfer_status[EP_MAX][2];
 #define XFER_CTL_BASE(_ep, _dir) &xfer_status[_ep][_dir]
 
+// IN FIFOs are allocated upward from end of FIFO 0 as endpoints are opened, and freed on bus reset.
+// An endpoint re-opened by SET_INTERFACE keeps its FIFO if large enough.
+static uint16_t _tx_fifo_top;               // first free word of USB SRAM
+static uint16_t _tx_fifo_words[EP_MAX];     // FIFO size of IN endpoints, index 0 unused
+
+// First word of planned FIFO of IN endpoint
+static uint16_t tx_fifo_plan_offset(uint8_t epnum)
+{
+  uint16_t offset = RX_FIFO_SIZE + 16;
+  for(uint8_t n = 1; n < epnum; n++) offset = (uint16_t) (offset + TX_FIFO_PLAN(n));
+  return offset;
+}
+
+// Link Power Management on cores having GLPMCFG (F446, F7, H7, L4 ...)
+#if CFG_TUD_LPM && defined(USB_OTG_GLPMCFG_LPMEN)
+  #define DCD_SYNOPSYS_LPM  1
+static bool _lpm_sleep; // in L1, left on resume (WKUINT)
+#else
+  #define DCD_SYNOPSYS_LPM  0
+#endif
+
+#if DCD_SYNOPSYS_DMA
+
+// Largest part of a transfer programmed at once, limited by PKTCNT and XFRSIZ fields
+#define DMA_PKTCNT_MAX  (USB_OTG_DOEPTSIZ_PKTCNT_Msk >> USB_OTG_DOEPTSIZ_PKTCNT_Pos)
+#define DMA_XFRSIZ_MAX  (USB_OTG_DOEPTSIZ_XFRSIZ_Msk >> USB_OTG_DOEPTSIZ_XFRSIZ_Pos)
+
+// Not in DTCM on H7 (no access from OTG_HS DMA) when placed by linker script
+static TU_ATTR_ALIGNED(32) uint32_t _dma_bounce[DCD_SYNOPSYS_EP_MAX][2][DCD_SYNOPSYS_DMA_BOUNCE_SIZE/4];
+
+// Data cache of F7/H7 must be cleaned before DMA reads memory and invalidated after it writes.
+// Buffers sharing a cache line with data written by CPU during an OUT transfer should be
+// 32-byte aligned (CFG_TUSB_MEM_ALIGN).
+static TU_ATTR_FAST_FUNC void dma_cache_clean(void const * addr, uint32_t len) {
+#if defined(__DCACHE_PRESENT) && __DCACHE_PRESENT
+  if(len && (SCB->CCR & SCB_CCR_DC_Msk)) {
+    uint32_t const start = tu_align32((uint32_t) addr);
+    SCB_CleanDCache_by_Addr((uint32_t *) start, (int32_t) ((uint32_t) addr + len - start));
+  }
+#else
+  (void) addr;
+  (void) len;
+#endif
+}
+
+static TU_ATTR_FAST_FUNC void dma_cache_invalidate(void const * addr, uint32_t len) {
+#if defined(__DCACHE_PRESENT) && __DCACHE_PRESENT
+  if(len && (SCB->CCR & SCB_CCR_DC_Msk)) {
+    uint32_t const start = tu_align32((uint32_t) addr);
+    SCB_InvalidateDCache_by_Addr((uint32_t *) start, (int32_t) ((uint32_t) addr + len - start));
+  }
+#else
+  (void) addr;
+  (void) len;
+#endif
+}
+
+// EP0 OUT receives up to 3 back-to-back setup packets into _setup_packet
+static void dma_setup_arm(void) {
+  USB_OTG_OUTEndpointTypeDef * out_ep = OUT_EP_BASE;
+  xfer_ctl_t * xfer = XFER_CTL_BASE(0, TUSB_DIR_OUT);
+
+  // No data transfer on EP0 OUT until dcd_edpt_xfer()
+  xfer->dma_len = 0;
+
+  dma_cache_clean(_setup_packet, sizeof(_setup_packet));
+  out_ep[0].DOEPDMA  = (uint32_t) _setup_packet;
+  out_ep[0].DOEPTSIZ = (3 << USB_OTG_DOEPTSIZ_STUPCNT_Pos) | (1 << USB_OTG_DOEPTSIZ_PKTCNT_Pos) | (3*8 << USB_OTG_DOEPTSIZ_XFRSIZ_Pos);
+  out_ep[0].DOEPCTL |= USB_OTG_DOEPCTL_EPENA | USB_OTG_DOEPCTL_USBAEP;
+}
+
+// Program next part of transfer: as many whole packets as fit into the registers straight from/to
+// buffer, or a packet through bounce buffer. Isochronous transfer is a single part.
+static void dma_xfer_start(uint8_t epnum, uint8_t dir, uint32_t iso_frame) {
+  USB_OTG_OUTEndpointTypeDef * out_ep = OUT_EP_BASE;
+  USB_OTG_INEndpointTypeDef * in_ep = IN_EP_BASE;
+
+  xfer_ctl_t * xfer = XFER_CTL_BASE(epnum, dir);
+  uint8_t * buf = xfer->buffer ? (xfer->buffer + xfer->queued_len) : NULL;
+  uint32_t const remaining = xfer->total_len - xfer->queued_len;
+
+  // EP0 has a single packet per transfer
+  uint32_t const max_packets = epnum ? tu_min32(DMA_PKTCNT_MAX, DMA_XFRSIZ_MAX / xfer->max_size) : 1;
+  uint32_t const max_len = max_packets * xfer->max_size;
+  bool const aligned = !(((uintptr_t) buf) & 3);
+
+  uint32_t len;
+  uint32_t num_packets;
+  uint8_t * dma_buf;
+
+  if(dir == TUSB_DIR_IN) {
+    xfer->bounce = !aligned;
+    len = tu_min32(remaining, xfer->bounce ? (uint32_t) (DCD_SYNOPSYS_DMA_BOUNCE_SIZE - DCD_SYNOPSYS_DMA_BOUNCE_SIZE % xfer->max_size) : max_len);
+    num_packets = len ? ((len + xfer->max_size - 1) / xfer->max_size) : 1;
+
+    dma_buf = xfer->bounce ? (uint8_t *) _dma_bounce[epnum][dir] : buf;
+    if(xfer->bounce) memcpy(dma_buf, buf, len);
+    dma_cache_clean(dma_buf, len);
+
+    in_ep[epnum].DIEPDMA  = (uint32_t) dma_buf;
+    in_ep[epnum].DIEPTSIZ = (num_packets << USB_OTG_DIEPTSIZ_PKTCNT_Pos) | (len << USB_OTG_DIEPTSIZ_XFRSIZ_Pos) | \
+        (xfer->iso ? (num_packets << USB_OTG_DIEPTSIZ_MULCNT_Pos) : 0);
+    in_ep[epnum].DIEPCTL |= USB_OTG_DIEPCTL_EPENA | USB_OTG_DIEPCTL_CNAK | iso_frame;
+  } else {
+    // OUT size is always whole packets, a short one ends the transfer
+    uint32_t const whole = tu_min32(remaining - remaining % xfer->max_size, max_len);
+    xfer->bounce = !aligned || !whole;
+    len = xfer->bounce ? xfer->max_size : whole;
+    num_packets = len / xfer->max_size;
+
+    dma_buf = xfer->bounce ? (uint8_t *) _dma_bounce[epnum][dir] : buf;
+    dma_cache_clean(dma_buf, len);
+
+    out_ep[epnum].DOEPDMA  = (uint32_t) dma_buf;
+    out_ep[epnum].DOEPTSIZ = (epnum ? 0 : (3 << USB_OTG_DOEPTSIZ_STUPCNT_Pos)) | \
+        (num_packets << USB_OTG_DOEPTSIZ_PKTCNT_Pos) | (len << USB_OTG_DOEPTSIZ_XFRSIZ_Pos);
+    out_ep[epnum].DOEPCTL |= USB_OTG_DOEPCTL_EPENA | USB_OTG_DOEPCTL_CNAK | iso_frame;
+  }
+
+  xfer->dma_len = len;
+}
+
+// Account for finished part, return true if whole transfer is complete
+static TU_ATTR_FAST_FUNC bool dma_xfer_done(uint8_t epnum, uint8_t dir) {
+  USB_OTG_OUTEndpointTypeDef * out_ep = OUT_EP_BASE;
+  xfer_ctl_t * xfer = XFER_CTL_BASE(epnum, dir);
+
+  if(dir == TUSB_DIR_IN) {
+    xfer->queued_len += xfer->dma_len;
+    return xfer->iso || (xfer->queued_len >= xfer->total_len);
+  }
+
+  uint32_t const left = (out_ep[epnum].DOEPTSIZ & USB_OTG_DOEPTSIZ_XFRSIZ_Msk) >> USB_OTG_DOEPTSIZ_XFRSIZ_Pos;
+  uint32_t const received = xfer->dma_len - tu_min32(left, xfer->dma_len);
+  uint32_t const len = tu_min32(received, xfer->total_len - xfer->queued_len);
+
+  if(xfer->bounce) {
+    dma_cache_invalidate(_dma_bounce[epnum][dir], received);
+    if(len) memcpy(xfer->buffer + xfer->queued_len, _dma_bounce[epnum][dir], len);
+  } else {
+    dma_cache_invalidate(xfer->buffer + xfer->queued_len, received);
+  }
+  xfer->queued_len += len;
+
+  return xfer->iso || (received < xfer->dma_len) || (xfer->queued_len >= xfer->total_len);
+}
+
+#else
+
+// Program as many OUT packets as remain (and fit the registers) to be received in one go. Packets
+// are read from FIFO one by one on RXFLVL, XFRC happens once at the end or on a short packet.
+// EP0 size register has room for a single packet.
+static void out_xfer_start(uint8_t epnum, uint32_t iso_frame) {
+  USB_OTG_OUTEndpointTypeDef * out_ep = OUT_EP_BASE;
+  xfer_ctl_t * xfer = XFER_CTL_BASE(epnum, TUSB_DIR_OUT);
+
+  uint32_t const remaining = xfer->total_len - xfer->queued_len;
+  uint32_t num_packets = 1;
+
+  if(epnum && !xfer->iso) {
+    uint32_t const max_packets = tu_min32(USB_OTG_DOEPTSIZ_PKTCNT_Msk >> USB_OTG_DOEPTSIZ_PKTCNT_Pos,
+                                          (USB_OTG_DOEPTSIZ_XFRSIZ_Msk >> USB_OTG_DOEPTSIZ_XFRSIZ_Pos) / xfer->max_size);
+    num_packets = tu_min32(tu_max32((remaining + xfer->max_size - 1) / xfer->max_size, 1), max_packets);
+  }
+
+  out_ep[epnum].DOEPTSIZ = (epnum ? 0 : (out_ep[0].DOEPTSIZ & USB_OTG_DOEPTSIZ_STUPCNT_Msk)) | \
+      (num_packets << USB_OTG_DOEPTSIZ_PKTCNT_Pos) | \
+      (((num_packets * xfer->max_size) << USB_OTG_DOEPTSIZ_XFRSIZ_Pos) & USB_OTG_DOEPTSIZ_XFRSIZ_Msk);
+  out_ep[epnum].DOEPCTL |= USB_OTG_DOEPCTL_EPENA | USB_OTG_DOEPCTL_CNAK | iso_frame;
+}
+
+#endif // DCD_SYNOPSYS_DMA
 
 // Setup the control endpoint 0.
 static void bus_reset(void) {
   USB_OTG_DeviceTypeDef * dev = DEVICE_BASE;
   USB_OTG_OUTEndpointTypeDef * out_ep = OUT_EP_BASE;
 
+#if DCD_SYNOPSYS_LPM
+  _lpm_sleep = false;
+#endif
+
   for(uint8_t n = 0; n < EP_MAX; n++) {
     out_ep[n].DOEPCTL |= USB_OTG_DOEPCTL_SNAK;
   }
@@ -134,30 +410,38 @@ static void bus_reset(void) {
   // - All EP OUT shared a unique OUT FIFO which uses
   //   * 10 locations in hardware for setup packets + setup control words (up to 3 setup packets).
   //   * 2 locations for OUT endpoint control words.
-  //   * 16 for largest packet size of 64 bytes. ( TODO Highspeed is 512 bytes)
+  //   * 16 for largest packet size of 64 bytes (DCD_SYNOPSYS_OUT_PACKET_MAX for isochronous).
   //   * 1 location for global NAK (not required/used here).
   //   * It is recommended to allocate 2 times the largest packet size, therefore
   //   Recommended value = 10 + 1 + 2 x (16+2) = 47 --> Let's make it 52
-  USB_OTG_FS->GRXFSIZ = 52;
+  OTG_CORE->GRXFSIZ = RX_FIFO_SIZE;
 
   // Control IN uses FIFO 0 with 64 bytes ( 16 32-bit word )
-  USB_OTG_FS->DIEPTXF0_HNPTXFSIZ = (16 << USB_OTG_TX0FD_Pos) | (USB_OTG_FS->GRXFSIZ & 0x0000ffffUL);
+  OTG_CORE->DIEPTXF0_HNPTXFSIZ = (16 << USB_OTG_TX0FD_Pos) | (OTG_CORE->GRXFSIZ & 0x0000ffffUL);
 
+  // Other IN FIFOs are allocated by dcd_edpt_open() after the planned ones
+  _tx_fifo_top = RX_FIFO_SIZE + 16 + TX_FIFO_PLAN_TOTAL;
+  for(uint8_t n = 0; n < EP_MAX; n++) _tx_fifo_words[n] = 0;
+
+#if DCD_SYNOPSYS_DMA
+  dma_setup_arm();
+#else
   out_ep[0].DOEPTSIZ |= (3 << USB_OTG_DOEPTSIZ_STUPCNT_Pos);
+#endif
 
-  USB_OTG_FS->GINTMSK |= USB_OTG_GINTMSK_OEPINT | USB_OTG_GINTMSK_IEPINT;
+  OTG_CORE->GINTMSK |= USB_OTG_GINTMSK_OEPINT | USB_OTG_GINTMSK_IEPINT;
 }
 
 static void end_of_reset(void) {
   USB_OTG_DeviceTypeDef * dev = DEVICE_BASE;
   USB_OTG_INEndpointTypeDef * in_ep = IN_EP_BASE;
-  // On current silicon on the Full Speed core, speed is fixed to Full Speed.
-  // However, keep for debugging and in case Low Speed is ever supported.
+  // Full speed core is fixed to Full Speed, OTG_HS may also enumerate at High Speed (0) or
+  // Full Speed with ULPI PHY (1). Keep Low Speed for debugging in case it is ever supported.
   uint32_t enum_spd = (dev->DSTS & USB_OTG_DSTS_ENUMSPD_Msk) >> USB_OTG_DSTS_ENUMSPD_Pos;
 
   // Maximum packet size for EP 0 is set for both directions by writing
   // DIEPCTL.
-  if(enum_spd == 0x03) {
+  if(enum_spd != 0x02) {
     // 64 bytes
     in_ep[0].DIEPCTL &= ~(0x03 << USB_OTG_DIEPCTL_MPSIZ_Pos);
     xfer_status[0][TUSB_DIR_OUT].max_size = 64;
@@ -171,6 +455,15 @@ static void end_of_reset(void) {
 }
 
 
+#if TUD_OPT_RHPORT == 1
+// Required after changing PHY selection
+static void core_reset(void) {
+  while((OTG_CORE->GRSTCTL & USB_OTG_GRSTCTL_AHBIDL) == 0);
+  OTG_CORE->GRSTCTL |= USB_OTG_GRSTCTL_CSRST;
+  while((OTG_CORE->GRSTCTL & USB_OTG_GRSTCTL_CSRST) != 0);
+}
+#endif
+
 /*------------------------------------------------------------------*/
 /* Controller API
  *------------------------------------------------------------------*/
@@ -178,40 +471,83 @@ void dcd_init (uint8_t rhport)
 {
   (void) rhport;
 
+#if TUD_OPT_RHPORT == 1
+  // OTG_HS: external ULPI PHY (embedded one stays powered down) or embedded full speed PHY.
+  // ULPI pins and clock are set up by board.
+#if OTG_HS_ULPI
+  OTG_CORE->GCCFG &= ~USB_OTG_GCCFG_PWRDWN;
+  OTG_CORE->GUSBCFG &= ~(USB_OTG_GUSBCFG_TSDPS | USB_OTG_GUSBCFG_ULPIFSLS | USB_OTG_GUSBCFG_PHYSEL | \
+                         USB_OTG_GUSBCFG_ULPIEVBUSD | USB_OTG_GUSBCFG_ULPIEVBUSI);
+#else
+  OTG_CORE->GUSBCFG |= USB_OTG_GUSBCFG_PHYSEL;
+#endif
+  core_reset();
+#endif
+
   // Programming model begins in the last section of the chapter on the USB
   // peripheral in each Reference Manual.
-  USB_OTG_FS->GAHBCFG |= USB_OTG_GAHBCFG_TXFELVL | USB_OTG_GAHBCFG_GINT;
+  OTG_CORE->GAHBCFG |= USB_OTG_GAHBCFG_TXFELVL | USB_OTG_GAHBCFG_GINT;
+
+#if DCD_SYNOPSYS_DMA
+  // Internal DMA with INCR4 bursts
+  OTG_CORE->GAHBCFG |= USB_OTG_GAHBCFG_DMAEN | (3 << USB_OTG_GAHBCFG_HBSTLEN_Pos);
+#endif
 
   // No HNP/SRP (no OTG support), program timeout later, turnaround
-  // programmed for 32+ MHz.
+  // programmed for 32+ MHz (9 for ULPI).
   // TODO: PHYSEL is read-only on some cores (STM32F407). Worth gating?
-  USB_OTG_FS->GUSBCFG |= (0x06 << USB_OTG_GUSBCFG_TRDT_Pos) | USB_OTG_GUSBCFG_PHYSEL;
+#if OTG_HS_ULPI
+  OTG_CORE->GUSBCFG = (OTG_CORE->GUSBCFG & ~USB_OTG_GUSBCFG_TRDT_Msk) | (0x09 << USB_OTG_GUSBCFG_TRDT_Pos);
+#else
+  OTG_CORE->GUSBCFG |= (0x06 << USB_OTG_GUSBCFG_TRDT_Pos) | USB_OTG_GUSBCFG_PHYSEL;
+#endif
 
   // Clear all used interrupts
-  USB_OTG_FS->GINTSTS |= USB_OTG_GINTSTS_OTGINT | USB_OTG_GINTSTS_MMIS | \
+  OTG_CORE->GINTSTS |= USB_OTG_GINTSTS_OTGINT | USB_OTG_GINTSTS_MMIS | \
     USB_OTG_GINTSTS_USBRST | USB_OTG_GINTSTS_ENUMDNE | \
     USB_OTG_GINTSTS_ESUSP | USB_OTG_GINTSTS_USBSUSP | USB_OTG_GINTSTS_SOF;
 
   // Required as part of core initialization. Disable OTGINT as we don't use
   // it right now. TODO: How should mode mismatch be handled? It will cause
   // the core to stop working/require reset.
-  USB_OTG_FS->GINTMSK |= /* USB_OTG_GINTMSK_OTGINT | */ USB_OTG_GINTMSK_MMISM;
+  OTG_CORE->GINTMSK |= /* USB_OTG_GINTMSK_OTGINT | */ USB_OTG_GINTMSK_MMISM;
 
   USB_OTG_DeviceTypeDef * dev = DEVICE_BASE;
 
   // If USB host misbehaves during status portion of control xfer
-  // (non zero-length packet), send STALL back and discard. Full speed.
+  // (non zero-length packet), send STALL back and discard. Full speed, or high speed with ULPI (0).
+#if OTG_HS_ULPI
+  dev->DCFG |=  USB_OTG_DCFG_NZLSOHSK;
+#else
   dev->DCFG |=  USB_OTG_DCFG_NZLSOHSK | (3 << USB_OTG_DCFG_DSPD_Pos);
+#endif
 
-  USB_OTG_FS->GINTMSK |= USB_OTG_GINTMSK_USBRST | USB_OTG_GINTMSK_ENUMDNEM | \
-    USB_OTG_GINTMSK_SOFM | USB_OTG_GINTMSK_RXFLVLM /* SB_OTG_GINTMSK_ESUSPM | \
+  // SOF is enabled by dcd_sof_enable()
+  OTG_CORE->GINTMSK |= USB_OTG_GINTMSK_USBRST | USB_OTG_GINTMSK_ENUMDNEM /* SB_OTG_GINTMSK_ESUSPM | \
     USB_OTG_GINTMSK_USBSUSPM */;
 
+  // RX FIFO is emptied by DMA
+#if !DCD_SYNOPSYS_DMA
+  OTG_CORE->GINTMSK |= USB_OTG_GINTMSK_RXFLVLM;
+#endif
+
+  // Isochronous transfer not done within its frame
+  OTG_CORE->GINTMSK |= USB_OTG_GINTMSK_IISOIXFRM | USB_OTG_GINTMSK_PXFRM_IISOOXFRM;
+
+#if DCD_SYNOPSYS_LPM
+  // Acknowledge LPM tokens (BESL), interrupt on L1 entry and on resume
+  OTG_CORE->GLPMCFG |= USB_OTG_GLPMCFG_LPMEN | USB_OTG_GLPMCFG_LPMACK | USB_OTG_GLPMCFG_ENBESL;
+  OTG_CORE->GINTMSK |= USB_OTG_GINTMSK_LPMINTM | USB_OTG_GINTMSK_WUIM;
+#endif
+
   // Enable VBUS hardware sensing, enable pullup, enable peripheral.
+  // ULPI PHY senses VBUS itself.
+#if !OTG_HS_ULPI
 #ifdef USB_OTG_GCCFG_VBDEN
-  USB_OTG_FS->GCCFG |= USB_OTG_GCCFG_VBDEN | USB_OTG_GCCFG_PWRDWN;
+  OTG_CORE->GCCFG |= USB_OTG_GCCFG_VBDEN | USB_OTG_GCCFG_PWRDWN;
 #else
-  USB_OTG_FS->GCCFG |= USB_OTG_GCCFG_VBUSBSEN | USB_OTG_GCCFG_PWRDWN;
+  OTG_CORE->GCCFG |= USB_OTG_GCCFG_VBUSBSEN | USB_OTG_GCCFG_PWRDWN;
+#endif
 #endif
 
   // Soft Connect -> Enable pullup on D+/D-.
@@ -222,13 +558,13 @@ void dcd_init (uint8_t rhport)
 void dcd_int_enable (uint8_t rhport)
 {
   (void) rhport;
-  NVIC_EnableIRQ(OTG_FS_IRQn);
+  NVIC_EnableIRQ(OTG_IRQn);
 }
 
 void dcd_int_disable (uint8_t rhport)
 {
   (void) rhport;
-  NVIC_DisableIRQ(OTG_FS_IRQn);
+  NVIC_DisableIRQ(OTG_IRQn);
 }
 
 void dcd_set_address (uint8_t rhport, uint8_t dev_addr)
@@ -250,9 +586,55 @@ void dcd_set_config (uint8_t rhport, uint8_t config_num)
   // Nothing to do
 }
 
+// Only from L1 sleep, suspend is not handled. Resume signalling is cleared by WKUINT.
 void dcd_remote_wakeup(uint8_t rhport)
 {
   (void) rhport;
+
+#if DCD_SYNOPSYS_LPM
+  USB_OTG_DeviceTypeDef * dev = DEVICE_BASE;
+  if ( _lpm_sleep && (OTG_CORE->GLPMCFG & USB_OTG_GLPMCFG_L1RSMOK) ) dev->DCTL |= USB_OTG_DCTL_RWUSIG;
+#endif
+}
+
+void dcd_get_caps(uint8_t rhport, dcd_caps_t* caps)
+{
+  (void) rhport;
+
+  // Without DMA a whole IN transfer must fit in PKTCNT (10-bit) packets
+  caps->max_xfer_bytes = DCD_SYNOPSYS_DMA ? UINT32_MAX : 1023UL * 64;
+  caps->speed          = TUD_OPT_HIGH_SPEED ? TUSB_SPEED_HIGH : TUSB_SPEED_FULL;
+  caps->multi_packet   = 1;
+  caps->dma            = DCD_SYNOPSYS_DMA;
+  caps->iso            = 1;
+}
+
+uint32_t dcd_frame_number(uint8_t rhport)
+{
+  (void) rhport;
+
+  USB_OTG_DeviceTypeDef * dev = DEVICE_BASE;
+  uint32_t const dsts = dev->DSTS;
+  uint32_t fnsof = (dsts & USB_OTG_DSTS_FNSOF_Msk) >> USB_OTG_DSTS_FNSOF_Pos;
+
+  // High Speed (0) reports microframe number
+  if ( ((dsts & USB_OTG_DSTS_ENUMSPD_Msk) >> USB_OTG_DSTS_ENUMSPD_Pos) == 0 ) fnsof >>= 3;
+
+  return fnsof & 0x7ffu;
+}
+
+void dcd_sof_enable(uint8_t rhport, bool en)
+{
+  (void) rhport;
+
+  if ( en )
+  {
+    OTG_CORE->GINTSTS  = USB_OTG_GINTSTS_SOF; // stale one
+    OTG_CORE->GINTMSK |= USB_OTG_GINTMSK_SOFM;
+  }else
+  {
+    OTG_CORE->GINTMSK &= ~USB_OTG_GINTMSK_SOFM;
+  }
 }
 
 /*------------------------------------------------------------------*/
@@ -269,14 +651,32 @@ bool dcd_edpt_open (uint8_t rhport, tusb_desc_endpoint_t const * desc_edpt)
   uint8_t const epnum = tu_edpt_number(desc_edpt->bEndpointAddress);
   uint8_t const dir   = tu_edpt_dir(desc_edpt->bEndpointAddress);
 
-  TU_ASSERT(desc_edpt->wMaxPacketSize.size <= 64);
-  TU_ASSERT(epnum < EP_MAX);
-
   xfer_ctl_t * xfer = XFER_CTL_BASE(epnum, dir);
   xfer->max_size = desc_edpt->wMaxPacketSize.size;
+  xfer->iso = (desc_edpt->bmAttributes.xfer == TUSB_XFER_ISOCHRONOUS);
+  xfer->mult = (uint8_t) (xfer->iso ? (1 + desc_edpt->wMaxPacketSize.hs_period_mult) : 1);
+
+#if TUD_OPT_HIGH_SPEED
+  // Bulk up to 512 bytes, interrupt and isochronous up to 1024 bytes (and 3 IN packets per microframe)
+  TU_ASSERT(xfer->max_size <= (desc_edpt->bmAttributes.xfer == TUSB_XFER_BULK ? 512 : 1024));
+  TU_ASSERT(xfer->mult <= (dir == TUSB_DIR_IN ? 3 : 1));
+#else
+  // Full speed only: 1 packet per frame, up to 1023 bytes for isochronous
+  TU_ASSERT(xfer->max_size <= (xfer->iso ? 1023 : 64));
+  TU_ASSERT(xfer->mult == 1);
+#endif
+  TU_ASSERT(epnum < DCD_SYNOPSYS_EP_MAX);
+
+#if DCD_SYNOPSYS_DMA
+  TU_ASSERT(xfer->max_size <= DCD_SYNOPSYS_DMA_BOUNCE_SIZE);
+#endif
 
   if(dir == TUSB_DIR_OUT)
   {
+    TU_ASSERT(xfer->max_size <= DCD_SYNOPSYS_OUT_PACKET_MAX);
+
+    // Endpoint may be re-opened with another type/size by SET_INTERFACE
+    out_ep[epnum].DOEPCTL &= ~(USB_OTG_DOEPCTL_EPTYP_Msk | USB_OTG_DOEPCTL_MPSIZ_Msk);
     out_ep[epnum].DOEPCTL |= (1 << USB_OTG_DOEPCTL_USBAEP_Pos) | \
       desc_edpt->bmAttributes.xfer << USB_OTG_DOEPCTL_EPTYP_Pos | \
       desc_edpt->wMaxPacketSize.size << USB_OTG_DOEPCTL_MPSIZ_Pos;
@@ -302,11 +702,46 @@ bool dcd_edpt_open (uint8_t rhport, tusb_desc_endpoint_t const * desc_edpt)
     // | ( Shared )  |
     // --------------- 0
     //
-    // Since OUT FIFO = GRXFSIZ, FIFO 0 = 16, for simplicity, we equally allocated for the rest of endpoints
-    // - Size  : (FIFO_SIZE/4 - GRXFSIZ - 16) / (EP_MAX-1)
-    // - Offset: GRXFSIZ + 16 + Size*(epnum-1)
+    // OUT FIFO = GRXFSIZ and FIFO 0 = 16 are set up on bus reset, followed by the FIFOs planned with
+    // DCD_SYNOPSYS_TX_FIFO_PLAN. FIFO of the other endpoints is sized by their descriptor when opened
+    // and placed right after the previous one.
+    // - Size  : max packet * packets held (DCD_SYNOPSYS_TX_FIFO_BULK_PACKETS for bulk)
+    // - Offset: top of allocated FIFOs
     // - IN EP 1 gets FIFO 1, IN EP "n" gets FIFO "n".
 
+    // Both TXFD and TXSA are in unit of 32-bit words.
+    uint16_t const packet_words = (uint16_t) ((xfer->max_size + 3) / 4);
+    uint16_t packets = (desc_edpt->bmAttributes.xfer == TUSB_XFER_BULK) ? DCD_SYNOPSYS_TX_FIFO_BULK_PACKETS : xfer->mult;
+    uint16_t fifo_size = (uint16_t) (packet_words * packets);
+    uint16_t fifo_offset;
+
+    if(TX_FIFO_PLAN(epnum)) {
+      // Planned FIFO must hold a packet, or the packets of a (micro)frame
+      TU_ASSERT(packet_words * xfer->mult <= TX_FIFO_PLAN(epnum));
+      fifo_size = (uint16_t) TX_FIFO_PLAN(epnum);
+      fifo_offset = tx_fifo_plan_offset(epnum);
+    } else if(fifo_size <= _tx_fifo_words[epnum]) {
+      // Re-opened endpoint fits in its current FIFO
+      fifo_size = _tx_fifo_words[epnum];
+      fifo_offset = (uint16_t) (OTG_CORE->DIEPTXF[epnum - 1] & 0x0000ffffUL);
+    } else {
+      // Bulk FIFO falls back to fewer packets, the one of a microframe for high bandwidth isochronous
+      // must fit as a whole
+      while(packets > xfer->mult && _tx_fifo_top + fifo_size > EP_FIFO_SIZE/4) {
+        packets--;
+        fifo_size = (uint16_t) (fifo_size - packet_words);
+      }
+
+      // TXFD minimum is 16 words
+      fifo_size = tu_max16(fifo_size, 16);
+      TU_ASSERT(_tx_fifo_top + fifo_size <= EP_FIFO_SIZE/4);
+
+      fifo_offset = _tx_fifo_top;
+      _tx_fifo_top = (uint16_t) (_tx_fifo_top + fifo_size);
+      _tx_fifo_words[epnum] = fifo_size;
+    }
+
+    in_ep[epnum].DIEPCTL &= ~(USB_OTG_DIEPCTL_TXFNUM_Msk | USB_OTG_DIEPCTL_EPTYP_Msk | USB_OTG_DIEPCTL_MPSIZ_Msk);
     in_ep[epnum].DIEPCTL |= (1 << USB_OTG_DIEPCTL_USBAEP_Pos) | \
       epnum << USB_OTG_DIEPCTL_TXFNUM_Pos | \
       desc_edpt->bmAttributes.xfer << USB_OTG_DIEPCTL_EPTYP_Pos | \
@@ -314,20 +749,14 @@ bool dcd_edpt_open (uint8_t rhport, tusb_desc_endpoint_t const * desc_edpt)
       desc_edpt->wMaxPacketSize.size << USB_OTG_DIEPCTL_MPSIZ_Pos;
     dev->DAINTMSK |= (1 << (USB_OTG_DAINTMSK_IEPM_Pos + epnum));
 
-    // Both TXFD and TXSA are in unit of 32-bit words.
-    // IN FIFO 0 was configured during enumeration, hence the "+ 16".
-    uint16_t const allocated_size = (USB_OTG_FS->GRXFSIZ & 0x0000ffff) + 16;
-    uint16_t const fifo_size = (EP_FIFO_SIZE/4 - allocated_size) / (EP_MAX-1);
-    uint32_t const fifo_offset = allocated_size + fifo_size*(epnum-1);
-
     // DIEPTXF starts at FIFO #1.
-    USB_OTG_FS->DIEPTXF[epnum - 1] = (fifo_size << USB_OTG_DIEPTXF_INEPTXFD_Pos) | fifo_offset;
+    OTG_CORE->DIEPTXF[epnum - 1] = (fifo_size << USB_OTG_DIEPTXF_INEPTXFD_Pos) | fifo_offset;
   }
 
   return true;
 }
 
-bool dcd_edpt_xfer (uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint16_t total_bytes)
+TU_ATTR_FAST_FUNC bool dcd_edpt_xfer (uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint32_t total_bytes)
 {
   (void) rhport;
   USB_OTG_DeviceTypeDef * dev = DEVICE_BASE;
@@ -343,28 +772,51 @@ bool dcd_edpt_xfer (uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint16_t
   xfer->queued_len = 0;
   xfer->short_packet = false;
 
-  uint16_t num_packets = (total_bytes / xfer->max_size);
-  uint8_t short_packet_size = total_bytes % xfer->max_size;
+  uint32_t num_packets = (total_bytes / xfer->max_size);
+  uint16_t short_packet_size = (uint16_t) (total_bytes % xfer->max_size);
 
   // Zero-size packet is special case.
   if(short_packet_size > 0 || (total_bytes == 0)) {
     num_packets++;
   }
 
+  // Isochronous transfer is the packet(s) of next (micro)frame: program its (even/odd) frame parity.
+  // Current frame number is odd -> next one is even.
+  uint32_t iso_frame = 0;
+  if(xfer->iso) {
+    TU_ASSERT(num_packets <= xfer->mult);
+    iso_frame = (dev->DSTS & (1 << USB_OTG_DSTS_FNSOF_Pos)) ? USB_OTG_DIEPCTL_SD0PID_SEVNFRM : USB_OTG_DIEPCTL_SODDFRM;
+  }
+
+#if DCD_SYNOPSYS_DMA
+  // Transfer is split into parts by dma_xfer_start(), each completing with one interrupt
+  TU_ASSERT(!xfer->iso || (((uintptr_t) buffer & 3) == 0) || (total_bytes <= DCD_SYNOPSYS_DMA_BOUNCE_SIZE));
+  (void) out_ep;
+  (void) in_ep;
+  dma_xfer_start(epnum, dir, iso_frame);
+#else
+  // A whole IN transfer is programmed at once, it must fit in PKTCNT and XFRSIZ fields.
+  // OUT transfer is scheduled in parts by out_xfer_start() and has no such limit.
+  if(dir == TUSB_DIR_IN) {
+    TU_ASSERT(num_packets <= (USB_OTG_DIEPTSIZ_PKTCNT_Msk >> USB_OTG_DIEPTSIZ_PKTCNT_Pos));
+    TU_ASSERT(total_bytes <= (USB_OTG_DIEPTSIZ_XFRSIZ_Msk >> USB_OTG_DIEPTSIZ_XFRSIZ_Pos));
+  }
+
   // IN and OUT endpoint xfers are interrupt-driven, we just schedule them
   // here.
   if(dir == TUSB_DIR_IN) {
     // A full IN transfer (multiple packets, possibly) triggers XFRC.
     in_ep[epnum].DIEPTSIZ = (num_packets << USB_OTG_DIEPTSIZ_PKTCNT_Pos) | \
-        ((total_bytes & USB_OTG_DIEPTSIZ_XFRSIZ_Msk) << USB_OTG_DIEPTSIZ_XFRSIZ_Pos);
-    in_ep[epnum].DIEPCTL |= USB_OTG_DIEPCTL_EPENA | USB_OTG_DIEPCTL_CNAK;
+        ((total_bytes & USB_OTG_DIEPTSIZ_XFRSIZ_Msk) << USB_OTG_DIEPTSIZ_XFRSIZ_Pos) | \
+        (xfer->iso ? (num_packets << USB_OTG_DIEPTSIZ_MULCNT_Pos) : 0);
+    in_ep[epnum].DIEPCTL |= USB_OTG_DIEPCTL_EPENA | USB_OTG_DIEPCTL_CNAK | iso_frame;
     dev->DIEPEMPMSK |= (1 << epnum);
   } else {
-    // Each complete packet for OUT xfers triggers XFRC.
-    out_ep[epnum].DOEPTSIZ |= (1 << USB_OTG_DOEPTSIZ_PKTCNT_Pos) | \
-        ((xfer->max_size & USB_OTG_DOEPTSIZ_XFRSIZ_Msk) << USB_OTG_DOEPTSIZ_XFRSIZ_Pos);
-    out_ep[epnum].DOEPCTL |= USB_OTG_DOEPCTL_EPENA | USB_OTG_DOEPCTL_CNAK;
+    // XFRC is triggered when the programmed packets are received or a short one ends them.
+    (void) out_ep;
+    out_xfer_start(epnum, iso_frame);
   }
+#endif
 
   return true;
 }
@@ -397,9 +849,9 @@ void dcd_edpt_stall (uint8_t rhport, uint8_t ep_addr)
     }
 
     // Flush the FIFO, and wait until we have confirmed it cleared.
-    USB_OTG_FS->GRSTCTL |= ((epnum - 1) << USB_OTG_GRSTCTL_TXFNUM_Pos);
-    USB_OTG_FS->GRSTCTL |= USB_OTG_GRSTCTL_TXFFLSH;
-    while((USB_OTG_FS->GRSTCTL & USB_OTG_GRSTCTL_TXFFLSH_Msk) != 0);
+    OTG_CORE->GRSTCTL |= ((epnum - 1) << USB_OTG_GRSTCTL_TXFNUM_Pos);
+    OTG_CORE->GRSTCTL |= USB_OTG_GRSTCTL_TXFFLSH;
+    while((OTG_CORE->GRSTCTL & USB_OTG_GRSTCTL_TXFFLSH_Msk) != 0);
   } else {
     // Only disable currently enabled non-control endpoint
     if ( (epnum == 0) || !(out_ep[epnum].DOEPCTL & USB_OTG_DOEPCTL_EPENA) ){
@@ -410,7 +862,7 @@ void dcd_edpt_stall (uint8_t rhport, uint8_t ep_addr)
       // anyway, and it can't be cleared by user code. If this while loop never
       // finishes, we have bigger problems than just the stack.
       dev->DCTL |= USB_OTG_DCTL_SGONAK;
-      while((USB_OTG_FS->GINTSTS & USB_OTG_GINTSTS_BOUTNAKEFF_Msk) == 0);
+      while((OTG_CORE->GINTSTS & USB_OTG_GINTSTS_BOUTNAKEFF_Msk) == 0);
 
       // Ditto here- disable the endpoint.
       out_ep[epnum].DOEPCTL |= (USB_OTG_DOEPCTL_STALL | USB_OTG_DOEPCTL_EPDIS);
@@ -457,22 +909,24 @@ void dcd_edpt_clear_stall (uint8_t rhport, uint8_t ep_addr)
 
 /*------------------------------------------------------------------*/
 
+#if !DCD_SYNOPSYS_DMA
+
 // TODO: Split into "receive on endpoint 0" and "receive generic"; endpoint 0's
 // DOEPTSIZ register is smaller than the others, and so is insufficient for
 // determining how much of an OUT transfer is actually remaining.
-static void receive_packet(xfer_ctl_t * xfer, /* USB_OTG_OUTEndpointTypeDef * out_ep, */ uint16_t xfer_size) {
+static TU_ATTR_FAST_FUNC void receive_packet(xfer_ctl_t * xfer, /* USB_OTG_OUTEndpointTypeDef * out_ep, */ uint16_t xfer_size) {
   usb_fifo_t rx_fifo = FIFO_BASE(0);
 
   // See above TODO
   // uint16_t remaining = (out_ep->DOEPTSIZ & USB_OTG_DOEPTSIZ_XFRSIZ_Msk) >> USB_OTG_DOEPTSIZ_XFRSIZ_Pos;
   // xfer->queued_len = xfer->total_len - remaining;
 
-  uint16_t remaining = xfer->total_len - xfer->queued_len;
+  uint32_t remaining = xfer->total_len - xfer->queued_len;
   uint16_t to_recv_size;
 
   if(remaining <= xfer->max_size) {
     // Avoid buffer overflow.
-    to_recv_size = (xfer_size > remaining) ? remaining : xfer_size;
+    to_recv_size = (xfer_size > remaining) ? (uint16_t) remaining : xfer_size;
   } else {
     // Room for full packet, choose recv_size based on what the microcontroller
     // claims.
@@ -485,9 +939,24 @@ static void receive_packet(xfer_ctl_t * xfer, /* USB_OTG_OUTEndpointTypeDef * ou
   // Do not assume xfer buffer is aligned.
   uint8_t * base = (xfer->buffer + xfer->queued_len);
 
-  // This for loop always runs at least once- skip if less than 4 bytes
-  // to collect.
-  if(to_recv_size >= 4) {
+  if(!(((uintptr_t) base) & 3)) {
+    // Aligned buffer: whole words straight from FIFO
+    uint32_t * dst = (uint32_t *) base;
+    uint16_t words = to_recv_size_aligned / 4;
+
+    for(; words >= 4; words -= 4) {
+      dst[0] = (* rx_fifo);
+      dst[1] = (* rx_fifo);
+      dst[2] = (* rx_fifo);
+      dst[3] = (* rx_fifo);
+      dst += 4;
+    }
+    while(words--) {
+      (* dst++) = (* rx_fifo);
+    }
+  } else if(to_recv_size >= 4) {
+    // This for loop always runs at least once- skip if less than 4 bytes
+    // to collect.
     for(uint16_t i = 0; i < to_recv_size_aligned; i += 4) {
       uint32_t tmp = (* rx_fifo);
       base[i] = tmp & 0x000000FF;
@@ -511,20 +980,22 @@ static void receive_packet(xfer_ctl_t * xfer, /* USB_OTG_OUTEndpointTypeDef * ou
     }
   }
 
-  xfer->queued_len += xfer_size;
+  // Discard what does not fit in buffer, FIFO must be emptied of the whole packet
+  for(uint16_t i = (uint16_t) ((to_recv_size + 3) / 4); i < (xfer_size + 3) / 4; i++) {
+    (void) (* rx_fifo);
+  }
+
+  xfer->queued_len += to_recv_size;
 
   // Per USB spec, a short OUT packet (including length 0) is always
   // indicative of the end of a transfer (at least for ctl, bulk, int).
   xfer->short_packet = (xfer_size < xfer->max_size);
 }
 
-static void transmit_packet(xfer_ctl_t * xfer, USB_OTG_INEndpointTypeDef * in_ep, uint8_t fifo_num) {
+// Write next packet of transfer to TX FIFO
+static TU_ATTR_FAST_FUNC void transmit_packet(xfer_ctl_t * xfer, uint8_t fifo_num, uint16_t to_xfer_size) {
   usb_fifo_t tx_fifo = FIFO_BASE(fifo_num);
 
-  uint16_t remaining = (in_ep->DIEPTSIZ & USB_OTG_DIEPTSIZ_XFRSIZ_Msk) >> USB_OTG_DIEPTSIZ_XFRSIZ_Pos;
-  xfer->queued_len = xfer->total_len - remaining;
-
-  uint16_t to_xfer_size = (remaining > xfer->max_size) ? xfer->max_size : remaining;
   uint8_t to_xfer_rem = to_xfer_size % 4;
   uint16_t to_xfer_size_aligned = to_xfer_size - to_xfer_rem;
 
@@ -532,9 +1003,24 @@ static void transmit_packet(xfer_ctl_t * xfer, USB_OTG_INEndpointTypeDef * in_ep
   // by copying to a temp var.
   uint8_t * base = (xfer->buffer + xfer->queued_len);
 
-  // This for loop always runs at least once- skip if less than 4 bytes
-  // to send off.
-  if(to_xfer_size >= 4) {
+  if(!(((uintptr_t) base) & 3)) {
+    // Aligned buffer: whole words straight to FIFO
+    uint32_t const * src = (uint32_t const *) base;
+    uint16_t words = to_xfer_size_aligned / 4;
+
+    for(; words >= 4; words -= 4) {
+      (* tx_fifo) = src[0];
+      (* tx_fifo) = src[1];
+      (* tx_fifo) = src[2];
+      (* tx_fifo) = src[3];
+      src += 4;
+    }
+    while(words--) {
+      (* tx_fifo) = (* src++);
+    }
+  } else if(to_xfer_size >= 4) {
+    // This for loop always runs at least once- skip if less than 4 bytes
+    // to send off.
     for(uint16_t i = 0; i < to_xfer_size_aligned; i += 4) {
       uint32_t tmp = base[i] | (base[i + 1] << 8) | \
         (base[i + 2] << 16) | (base[i + 3] << 24);
@@ -557,14 +1043,16 @@ static void transmit_packet(xfer_ctl_t * xfer, USB_OTG_INEndpointTypeDef * in_ep
 
     (* tx_fifo) = tmp;
   }
+
+  xfer->queued_len += to_xfer_size;
 }
 
-static void read_rx_fifo(USB_OTG_OUTEndpointTypeDef * out_ep) {
+static TU_ATTR_FAST_FUNC void read_rx_fifo(USB_OTG_OUTEndpointTypeDef * out_ep) {
   usb_fifo_t rx_fifo = FIFO_BASE(0);
 
   // Pop control word off FIFO (completed xfers will have 2 control words,
   // we only pop one ctl word each interrupt).
-  uint32_t ctl_word = USB_OTG_FS->GRXSTSP;
+  uint32_t ctl_word = OTG_CORE->GRXSTSP;
   uint8_t pktsts = (ctl_word & USB_OTG_GRXSTSP_PKTSTS_Msk) >> USB_OTG_GRXSTSP_PKTSTS_Pos;
   uint8_t epnum = (ctl_word &  USB_OTG_GRXSTSP_EPNUM_Msk) >>  USB_OTG_GRXSTSP_EPNUM_Pos;
   uint16_t bcnt = (ctl_word & USB_OTG_GRXSTSP_BCNT_Msk) >> USB_OTG_GRXSTSP_BCNT_Pos;
@@ -600,7 +1088,9 @@ static void read_rx_fifo(USB_OTG_OUTEndpointTypeDef * out_ep) {
   }
 }
 
-static void handle_epout_ints(USB_OTG_DeviceTypeDef * dev, USB_OTG_OUTEndpointTypeDef * out_ep) {
+#endif // !DCD_SYNOPSYS_DMA
+
+static TU_ATTR_FAST_FUNC void handle_epout_ints(USB_OTG_DeviceTypeDef * dev, USB_OTG_OUTEndpointTypeDef * out_ep) {
   // DAINT for a given EP clears when DOEPINTx is cleared.
   // OEPINT will be cleared when DAINT's out bits are cleared.
   for(uint8_t n = 0; n < EP_MAX; n++) {
@@ -610,35 +1100,49 @@ static void handle_epout_ints(USB_OTG_DeviceTypeDef * dev, USB_OTG_OUTEndpointTy
       // SETUP packet Setup Phase done.
       if(out_ep[n].DOEPINT & USB_OTG_DOEPINT_STUP) {
         out_ep[n].DOEPINT =  USB_OTG_DOEPINT_STUP;
+#if DCD_SYNOPSYS_DMA
+        // STUPCNT counts down from 3 for each back-to-back setup packet, only the last one is valid
+        uint8_t const setup_left = (uint8_t) ((out_ep[n].DOEPTSIZ & USB_OTG_DOEPTSIZ_STUPCNT_Msk) >> USB_OTG_DOEPTSIZ_STUPCNT_Pos);
+        _setup_offs = (uint8_t) ((setup_left < 3) ? (2 - setup_left) : 0);
+        dma_cache_invalidate(_setup_packet, sizeof(_setup_packet));
+#endif
         dcd_event_setup_received(0, (uint8_t*) &_setup_packet[2*_setup_offs], true);
         _setup_offs = 0;
+#if DCD_SYNOPSYS_DMA
+        dma_setup_arm();
+#endif
       }
 
-      // OUT XFER complete (single packet).
+      // OUT XFER complete (all programmed packets).
       if(out_ep[n].DOEPINT & USB_OTG_DOEPINT_XFRC) {
         out_ep[n].DOEPINT = USB_OTG_DOEPINT_XFRC;
 
-        // TODO: Because of endpoint 0's constrained size, we handle XFRC
-        // on a packet-basis. The core can internally handle multiple OUT
-        // packets; it would be more efficient to only trigger XFRC on a
-        // completed transfer for non-0 endpoints.
+#if DCD_SYNOPSYS_DMA
+        // Setup packet also ends EP0 OUT with XFRC when no data transfer is scheduled
+        if(n == 0 && xfer->dma_len == 0) continue;
 
-        // Transfer complete if short packet or total len is transferred
-        if(xfer->short_packet || (xfer->queued_len == xfer->total_len)) {
+        if(dma_xfer_done(n, TUSB_DIR_OUT)) {
+          if(n == 0) dma_setup_arm();
+          dcd_event_xfer_complete(0, n, xfer->queued_len, XFER_RESULT_SUCCESS, true);
+        } else {
+          dma_xfer_start(n, TUSB_DIR_OUT, 0);
+        }
+#else
+        // Transfer complete if short packet or total len is transferred, isochronous is one packet.
+        // Otherwise EP0 or a transfer too large for the size register goes on with the next part.
+        if(xfer->short_packet || xfer->iso || (xfer->queued_len == xfer->total_len)) {
           xfer->short_packet = false;
           dcd_event_xfer_complete(0, n, xfer->queued_len, XFER_RESULT_SUCCESS, true);
         } else {
-          // Schedule another packet to be received.
-          out_ep[n].DOEPTSIZ |= (1 << USB_OTG_DOEPTSIZ_PKTCNT_Pos) | \
-              ((xfer->max_size & USB_OTG_DOEPTSIZ_XFRSIZ_Msk) << USB_OTG_DOEPTSIZ_XFRSIZ_Pos);
-          out_ep[n].DOEPCTL |= USB_OTG_DOEPCTL_EPENA | USB_OTG_DOEPCTL_CNAK;
+          out_xfer_start(n, 0);
         }
+#endif
       }
     }
   }
 }
 
-static void handle_epin_ints(USB_OTG_DeviceTypeDef * dev, USB_OTG_INEndpointTypeDef * in_ep) {
+static TU_ATTR_FAST_FUNC void handle_epin_ints(USB_OTG_DeviceTypeDef * dev, USB_OTG_INEndpointTypeDef * in_ep) {
   // DAINT for a given EP clears when DIEPINTx is cleared.
   // IEPINT will be cleared when DAINT's out bits are cleared.
   for(uint8_t n = 0; n < EP_MAX; n++) {
@@ -648,29 +1152,89 @@ static void handle_epin_ints(USB_OTG_DeviceTypeDef * dev, USB_OTG_INEndpointType
       // IN XFER complete (entire xfer).
       if(in_ep[n].DIEPINT & USB_OTG_DIEPINT_XFRC) {
         in_ep[n].DIEPINT = USB_OTG_DIEPINT_XFRC;
+#if DCD_SYNOPSYS_DMA
+        if(dma_xfer_done(n, TUSB_DIR_IN)) {
+          dcd_event_xfer_complete(0, n | TUSB_DIR_IN_MASK, xfer->total_len, XFER_RESULT_SUCCESS, true);
+        } else {
+          dma_xfer_start(n, TUSB_DIR_IN, 0);
+        }
+#else
         dev->DIEPEMPMSK &= ~(1 << n); // Turn off TXFE b/c xfer inactive.
         dcd_event_xfer_complete(0, n | TUSB_DIR_IN_MASK, xfer->total_len, XFER_RESULT_SUCCESS, true);
+#endif
       }
 
-      // XFER FIFO empty
-      if(in_ep[n].DIEPINT & USB_OTG_DIEPINT_TXFE) {
-        in_ep[n].DIEPINT = USB_OTG_DIEPINT_TXFE;
-        transmit_packet(xfer, &in_ep[n], n);
+#if !DCD_SYNOPSYS_DMA
+      // XFER FIFO empty: write as many packets as there is room for, transfer is programmed as a whole
+      if((in_ep[n].DIEPINT & USB_OTG_DIEPINT_TXFE) && (dev->DIEPEMPMSK & (1 << n))) {
+        while(xfer->queued_len < xfer->total_len) {
+          uint16_t const len = (uint16_t) tu_min32(xfer->total_len - xfer->queued_len, xfer->max_size);
+          uint16_t const space = (uint16_t) ((in_ep[n].DTXFSTS & USB_OTG_DTXFSTS_INEPTFSAV_Msk) >> USB_OTG_DTXFSTS_INEPTFSAV_Pos);
+
+          if(space < (len + 3) / 4) break;
+          transmit_packet(xfer, n, len);
+        }
+
+        // Whole transfer is in FIFO
+        if(xfer->queued_len >= xfer->total_len) dev->DIEPEMPMSK &= ~(1 << n);
       }
+#endif
+    }
+  }
+}
+
+// Isochronous endpoints still enabled for the frame that just ended missed it (no IN token or
+// corrupted OUT packet). Disable them and complete the transfer as failed.
+static TU_ATTR_FAST_FUNC void handle_incomplete_iso(USB_OTG_DeviceTypeDef * dev, USB_OTG_OUTEndpointTypeDef * out_ep,
+                                  USB_OTG_INEndpointTypeDef * in_ep, uint8_t dir) {
+  uint32_t const parity = (dev->DSTS & (1 << USB_OTG_DSTS_FNSOF_Pos)) ? USB_OTG_DIEPCTL_EONUM_DPID : 0;
+
+  for(uint8_t n = 1; n < EP_MAX; n++) {
+    xfer_ctl_t * xfer = XFER_CTL_BASE(n, dir);
+    if(!xfer->iso) continue;
+
+    if(dir == TUSB_DIR_IN) {
+      uint32_t const ctl = in_ep[n].DIEPCTL;
+      if(!(ctl & USB_OTG_DIEPCTL_EPENA) || ((ctl & USB_OTG_DIEPCTL_EONUM_DPID) != parity)) continue;
+
+      in_ep[n].DIEPCTL |= (USB_OTG_DIEPCTL_SNAK | USB_OTG_DIEPCTL_EPDIS);
+      while((in_ep[n].DIEPINT & USB_OTG_DIEPINT_EPDISD_Msk) == 0);
+      in_ep[n].DIEPINT = USB_OTG_DIEPINT_EPDISD;
+
+      OTG_CORE->GRSTCTL = (n << USB_OTG_GRSTCTL_TXFNUM_Pos) | USB_OTG_GRSTCTL_TXFFLSH;
+      while((OTG_CORE->GRSTCTL & USB_OTG_GRSTCTL_TXFFLSH_Msk) != 0);
+
+      dev->DIEPEMPMSK &= ~(1 << n);
+      dcd_event_xfer_complete(0, n | TUSB_DIR_IN_MASK, 0, XFER_RESULT_FAILED, true);
+    } else {
+      uint32_t const ctl = out_ep[n].DOEPCTL;
+      if(!(ctl & USB_OTG_DOEPCTL_EPENA) || ((ctl & USB_OTG_DOEPCTL_EONUM_DPID) != parity)) continue;
+
+      // Same as dcd_edpt_stall(), global OUT NAK is required to disable an OUT endpoint.
+      dev->DCTL |= USB_OTG_DCTL_SGONAK;
+      while((OTG_CORE->GINTSTS & USB_OTG_GINTSTS_BOUTNAKEFF_Msk) == 0);
+
+      out_ep[n].DOEPCTL |= (USB_OTG_DOEPCTL_SNAK | USB_OTG_DOEPCTL_EPDIS);
+      while((out_ep[n].DOEPINT & USB_OTG_DOEPINT_EPDISD_Msk) == 0);
+      out_ep[n].DOEPINT = USB_OTG_DOEPINT_EPDISD;
+
+      dev->DCTL |= USB_OTG_DCTL_CGONAK;
+
+      dcd_event_xfer_complete(0, n, xfer->queued_len, XFER_RESULT_FAILED, true);
     }
   }
 }
 
-void OTG_FS_IRQHandler(void) {
+TU_ATTR_FAST_FUNC void OTG_IRQHandler(void) {
   USB_OTG_DeviceTypeDef * dev = DEVICE_BASE;
   USB_OTG_OUTEndpointTypeDef * out_ep = OUT_EP_BASE;
   USB_OTG_INEndpointTypeDef * in_ep = IN_EP_BASE;
 
-  uint32_t int_status = USB_OTG_FS->GINTSTS;
+  uint32_t int_status = OTG_CORE->GINTSTS;
 
   if(int_status & USB_OTG_GINTSTS_USBRST) {
     // USBRST is start of reset.
-    USB_OTG_FS->GINTSTS = USB_OTG_GINTSTS_USBRST;
+    OTG_CORE->GINTSTS = USB_OTG_GINTSTS_USBRST;
     bus_reset();
   }
 
@@ -678,19 +1242,45 @@ void OTG_FS_IRQHandler(void) {
     // ENUMDNE detects speed of the link. For full-speed, we
     // always expect the same value. This interrupt is considered
     // the end of reset.
-    USB_OTG_FS->GINTSTS = USB_OTG_GINTSTS_ENUMDNE;
+    OTG_CORE->GINTSTS = USB_OTG_GINTSTS_ENUMDNE;
     end_of_reset();
     dcd_event_bus_signal(0, DCD_EVENT_BUS_RESET, true);
   }
 
-  if(int_status & USB_OTG_GINTSTS_SOF) {
-    USB_OTG_FS->GINTSTS = USB_OTG_GINTSTS_SOF;
+  // status is set even if masked
+  if((int_status & USB_OTG_GINTSTS_SOF) && (OTG_CORE->GINTMSK & USB_OTG_GINTMSK_SOFM)) {
+    OTG_CORE->GINTSTS = USB_OTG_GINTSTS_SOF;
     dcd_event_bus_signal(0, DCD_EVENT_SOF, true);
   }
 
+#if DCD_SYNOPSYS_LPM
+  // LPM token acked, core is in L1 (SLPSTS) with BESL and bRemoteWake of the token in GLPMCFG
+  if(int_status & USB_OTG_GINTSTS_LPMINT) {
+    OTG_CORE->GINTSTS = USB_OTG_GINTSTS_LPMINT;
+
+    uint32_t const glpmcfg = OTG_CORE->GLPMCFG;
+    _lpm_sleep = true;
+    dcd_event_lpm_sleep(0, (uint8_t) ((glpmcfg & USB_OTG_GLPMCFG_BESL) >> USB_OTG_GLPMCFG_BESL_Pos),
+                        (glpmcfg & USB_OTG_GLPMCFG_REMWAKE) != 0, true);
+  }
+
+  // Resume by host or end of remote wakeup
+  if(int_status & USB_OTG_GINTSTS_WKUINT) {
+    OTG_CORE->GINTSTS = USB_OTG_GINTSTS_WKUINT;
+    dev->DCTL &= ~USB_OTG_DCTL_RWUSIG;
+
+    if ( _lpm_sleep ) {
+      _lpm_sleep = false;
+      dcd_event_bus_signal(0, DCD_EVENT_LPM_RESUME, true);
+    }
+  }
+#endif
+
+#if !DCD_SYNOPSYS_DMA
   if(int_status & USB_OTG_GINTSTS_RXFLVL) {
     read_rx_fifo(out_ep);
   }
+#endif
 
   // OUT endpoint interrupt handling.
   if(int_status & USB_OTG_GINTSTS_OEPINT) {
@@ -701,6 +1291,19 @@ void OTG_FS_IRQHandler(void) {
   if(int_status & USB_OTG_GINTSTS_IEPINT) {
     handle_epin_ints(dev, in_ep);
   }
+
+  // Incomplete isochronous IN/OUT at end of periodic frame.
+  if(int_status & USB_OTG_GINTSTS_IISOIXFR) {
+    OTG_CORE->GINTSTS = USB_OTG_GINTSTS_IISOIXFR;
+    handle_incomplete_iso(dev, out_ep, in_ep, TUSB_DIR_IN);
+  }
+
+  if(int_status & USB_OTG_GINTSTS_PXFR_INCOMPISOOUT) {
+    OTG_CORE->GINTSTS = USB_OTG_GINTSTS_PXFR_INCOMPISOOUT;
+    handle_incomplete_iso(dev, out_ep, in_ep, TUSB_DIR_OUT);
+  }
+
+  dcd_event_isr_exit(0);
 }
 
 #endif
@@ -74,15 +74,24 @@ uint8_t queue_log_offset;
 
 #define EP_SIZE 64
 
-uint16_t volatile rx_buffer_offset[16];
+// Packets a bulk IN endpoint sends in a row before the next endpoint with pending data gets the
+// IN fifo. Interrupt and control IN endpoints are served at the next packet boundary.
+#ifndef DCD_EPTRI_TX_BURST
+#define DCD_EPTRI_TX_BURST 8
+#endif
+
+uint32_t volatile rx_buffer_offset[16];
 uint8_t volatile * rx_buffer[16];
-uint16_t volatile rx_buffer_max[16];
+uint32_t volatile rx_buffer_max[16];
 
 volatile uint8_t tx_ep;
 volatile bool tx_active;
-volatile uint16_t tx_buffer_offset[16];
+volatile uint32_t tx_buffer_offset[16];
 uint8_t volatile * tx_buffer[16];
-volatile uint16_t tx_buffer_max[16];
+volatile uint32_t tx_buffer_max[16];
+volatile uint16_t tx_pending;   // IN endpoints with a buffer queued
+volatile uint16_t tx_priority;  // interrupt and control IN endpoints
+volatile uint8_t tx_burst;      // packets sent by tx_ep since it got the fifo
 volatile uint8_t reset_count;
 
 #if DEBUG
@@ -95,15 +104,33 @@ uint8_t setup_packet_bfr[10];
 // PIPE HELPER
 //--------------------------------------------------------------------+
 
+// Pick the endpoint for the next packet. There is a single IN fifo and a loaded packet waits
+// there until the host polls its endpoint, so a pending interrupt packet holds off the other
+// endpoints up to its polling interval. It is still served first since it is small and latency
+// sensitive, bulk endpoints share the remaining time round-robin every DCD_EPTRI_TX_BURST packets.
 static bool advance_tx_ep(void) {
-  // Move on to the next transmit buffer in a round-robin manner
-  uint8_t prev_tx_ep = tx_ep;
-  for (tx_ep = (tx_ep + 1) & 0xf; tx_ep != prev_tx_ep; tx_ep = ((tx_ep + 1) & 0xf)) {
-    if (tx_buffer[tx_ep])
+  uint16_t const pending = tx_pending;
+  if (!pending)
+    return false;
+
+  uint16_t candidates = pending & tx_priority;
+  if (!candidates) {
+    // Bulk endpoint keeps the fifo for its burst
+    if ((pending & (1 << tx_ep)) && (tx_burst < DCD_EPTRI_TX_BURST))
       return true;
+    candidates = pending;
+  }
+
+  // Round-robin starting after the current endpoint, which comes last
+  uint8_t ep = tx_ep;
+  do {
+    ep = (ep + 1) & 0xf;
+  } while (!(candidates & (1 << ep)));
+
+  if (ep != tx_ep) {
+    tx_ep = ep;
+    tx_burst = 0;
   }
-  if (!tx_buffer[tx_ep])
-    return false;
   return true;
 }
 
@@ -126,14 +153,22 @@ void queue_log_append(uint8_t ep_num, uint16_t sz) {
 #endif
 
 static void tx_more_data(void) {
-  // Send more data
-  uint8_t added_bytes;
-  for (added_bytes = 0; (added_bytes < EP_SIZE) && (tx_buffer_offset[tx_ep] < tx_buffer_max[tx_ep]); added_bytes++) {
+  // Send more data. Fifo is a byte wide CSR, keep the volatile state in locals while filling it.
+  uint8_t volatile * const buffer = tx_buffer[tx_ep];
+  uint32_t offset = tx_buffer_offset[tx_ep];
+  uint32_t const end = tu_min32(tx_buffer_max[tx_ep], offset + EP_SIZE);
+#if LOG_USB
+  uint8_t const added_bytes = (uint8_t) (end - offset);
+#endif
+
+  while (offset < end) {
 #if LOG_USB
-    usb_log[usb_log_offset].data[added_bytes] = tx_buffer[tx_ep][tx_buffer_offset[tx_ep]];
+    usb_log[usb_log_offset].data[added_bytes - (end - offset)] = buffer[offset];
 #endif
-    usb_in_data_write(tx_buffer[tx_ep][tx_buffer_offset[tx_ep]++]);
+    usb_in_data_write(buffer[offset++]);
   }
+  tx_buffer_offset[tx_ep] = offset;
+  tx_burst++;
 
 #if LOG_USB
   usb_log[usb_log_offset].ep_num = tu_edpt_addr(tx_ep, TUSB_DIR_IN);
@@ -170,7 +205,8 @@ static void process_tx(void) {
     last_tx_ep = tx_ep;
 #endif
     tx_buffer[tx_ep] = NULL;
-    uint16_t xferred_bytes = tx_buffer_max[tx_ep];
+    tx_pending &= ~(1 << tx_ep);
+    uint32_t xferred_bytes = tx_buffer_max[tx_ep];
     uint8_t xferred_ep = tx_ep;
 
     if (!advance_tx_ep())
@@ -182,6 +218,11 @@ static void process_tx(void) {
     if (!tx_active)
       return;
   }
+  // Give the fifo to another endpoint once the burst is used up
+  else if (!advance_tx_ep()) {
+    tx_active = false;
+    return;
+  }
 
   tx_more_data();
   return;
@@ -265,7 +306,7 @@ static void process_rx(void) {
 
     // Free up this buffer.
     rx_buffer[rx_ep] = NULL;
-    uint16_t len = rx_buffer_offset[rx_ep];
+    uint32_t len = rx_buffer_offset[rx_ep];
 
 #if DEBUG
     // Validate that all enabled endpoints have buffers,
@@ -323,6 +364,9 @@ static void dcd_reset(void)
   memset((void *)tx_buffer_offset, 0, sizeof(tx_buffer_offset));
   tx_ep = 0;
   tx_active = false;
+  tx_pending = 0;
+  tx_priority = 1 << 0;
+  tx_burst = 0;
 
   // Enable all event handlers and clear their contents
   usb_setup_ev_pending_write(0xff);
@@ -397,6 +441,14 @@ void dcd_remote_wakeup(uint8_t rhport)
   (void) rhport;
 }
 
+// Bytes are pushed to the fifo by cpu, one packet at a time
+void dcd_get_caps(uint8_t rhport, dcd_caps_t* caps)
+{
+  (void) rhport;
+
+  caps->max_xfer_bytes = UINT32_MAX;
+}
+
 //--------------------------------------------------------------------+
 // DCD Endpoint Port
 //--------------------------------------------------------------------+
@@ -419,6 +471,12 @@ bool dcd_edpt_open(uint8_t rhport, tusb_desc_endpoint_t const * p_endpoint_desc)
     tx_buffer_offset[ep_num] = 0;
     tx_buffer_max[ep_num] = 0;
     tx_buffer[ep_num] = NULL;
+    tx_pending &= ~(1 << ep_num);
+
+    if (p_endpoint_desc->bmAttributes.xfer == TUSB_XFER_BULK)
+      tx_priority &= ~(1 << ep_num);
+    else
+      tx_priority |= (1 << ep_num);
   }
 
   return true;
@@ -450,7 +508,7 @@ void dcd_edpt_clear_stall(uint8_t rhport, uint8_t ep_addr)
   // IN endpoints will get unstalled when more data is written.
 }
 
-bool dcd_edpt_xfer (uint8_t rhport, uint8_t ep_addr, uint8_t* buffer, uint16_t total_bytes)
+bool dcd_edpt_xfer (uint8_t rhport, uint8_t ep_addr, uint8_t* buffer, uint32_t total_bytes)
 {
   (void)rhport;
   uint8_t ep_num = tu_edpt_number(ep_addr);
@@ -484,6 +542,7 @@ bool dcd_edpt_xfer (uint8_t rhport, uint8_t ep_addr, uint8_t* buffer, uint16_t t
     tx_buffer_offset[ep_num] = 0;
     tx_buffer_max[ep_num] = total_bytes;
     tx_buffer[ep_num] = buffer;
+    tx_pending |= (1 << ep_num);
 
     // If the current buffer is NULL, then that means the tx logic is idle.
     // Update the tx_ep to point to our endpoint number and queue the data.
@@ -491,6 +550,7 @@ bool dcd_edpt_xfer (uint8_t rhport, uint8_t ep_addr, uint8_t* buffer, uint16_t t
     // finishes.
     if (!tx_active) {
       tx_ep = ep_num;
+      tx_burst = 0;
       tx_active = true;
       tx_more_data();
     }
@@ -613,7 +673,7 @@ static void handle_setup(void)
 
   usb_setup_ev_pending_write(1);
 }
-void hal_dcd_isr(uint8_t rhport)
+TU_ATTR_FAST_FUNC void hal_dcd_isr(uint8_t rhport)
 {
   (void)rhport;
   uint8_t next_ev;
@@ -633,6 +693,8 @@ void hal_dcd_isr(uint8_t rhport)
       break;
     }
   }
+
+  dcd_event_isr_exit(rhport);
 }
 
 #endif
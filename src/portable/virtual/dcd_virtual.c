@@ -0,0 +1,548 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#include "tusb_option.h"
+
+#if TUSB_OPT_DEVICE_ENABLED && CFG_TUSB_MCU == OPT_MCU_VIRTUAL
+
+#include "device/dcd.h"
+#include "device/usbd.h"
+#include "dcd_virtual.h"
+
+/*------------------------------------------------------------------*/
+/* MACRO TYPEDEF CONSTANT ENUM
+ *------------------------------------------------------------------*/
+enum
+{
+  EP_MAX = 16,
+
+  // 11-bit frame number
+  FRAME_MASK = 0x7ff
+};
+
+typedef struct
+{
+  uint8_t* buffer;
+  uint32_t total_len;
+  uint32_t actual_len;
+  uint16_t mps;
+
+  bool opened;
+  bool busy;
+  bool stalled;
+
+  dcd_virtual_ep_stats_t stats;
+} xfer_td_t;
+
+static struct
+{
+  xfer_td_t xfer[EP_MAX][2];
+
+  uint32_t event_count;
+  uint16_t frame;
+  uint8_t  addr;
+  uint8_t  addr_pending;
+  bool     remote_wakeup;
+} _dcd;
+
+static inline xfer_td_t* get_td(uint8_t ep_addr)
+{
+  return &_dcd.xfer[tu_edpt_number(ep_addr) % EP_MAX][tu_edpt_dir(ep_addr)];
+}
+
+static void post_bus_signal(uint8_t rhport, dcd_eventid_t eid)
+{
+  _dcd.event_count++;
+  dcd_event_bus_signal(rhport, eid, true);
+}
+
+static void xfer_complete(uint8_t rhport, uint8_t ep_addr, xfer_td_t* xfer)
+{
+  xfer->busy = false;
+  xfer->stats.xfer_count++;
+  xfer->stats.xfer_bytes += xfer->actual_len;
+
+  // address is applied after status stage of Set Address
+  if ( ep_addr == 0x80 && _dcd.addr_pending )
+  {
+    _dcd.addr = _dcd.addr_pending;
+    _dcd.addr_pending = 0;
+  }
+
+  _dcd.event_count++;
+  dcd_event_xfer_complete(rhport, ep_addr, xfer->actual_len, XFER_RESULT_SUCCESS, true);
+}
+
+// Return false (NAK or STALL) if host cannot access endpoint now
+static bool edpt_ready(xfer_td_t* xfer)
+{
+  if ( xfer->stalled )
+  {
+    xfer->stats.stall_count++;
+    return false;
+  }
+
+  if ( !xfer->busy )
+  {
+    xfer->stats.nak_count++;
+    return false;
+  }
+
+  return true;
+}
+
+static void ep0_open(void)
+{
+  for ( uint8_t dir = 0; dir < 2; dir++ )
+  {
+    xfer_td_t* xfer = &_dcd.xfer[0][dir];
+    xfer->opened  = true;
+    xfer->busy    = false;
+    xfer->stalled = false;
+    xfer->mps     = CFG_TUD_ENDPOINT0_SIZE;
+  }
+}
+
+/*------------------------------------------------------------------*/
+/* Controller API
+ *------------------------------------------------------------------*/
+void dcd_init (uint8_t rhport)
+{
+  (void) rhport;
+  tu_memclr(&_dcd, sizeof(_dcd));
+  ep0_open();
+}
+
+// Nothing to do, host side posts its events directly
+TU_ATTR_FAST_FUNC void dcd_isr (uint8_t rhport)
+{
+  (void) rhport;
+}
+
+// Host side runs in the thread of tud_task(), there is no interrupt to mask
+void dcd_int_enable (uint8_t rhport)
+{
+  (void) rhport;
+}
+
+void dcd_int_disable (uint8_t rhport)
+{
+  (void) rhport;
+}
+
+void dcd_set_address (uint8_t rhport, uint8_t dev_addr)
+{
+  _dcd.addr_pending = dev_addr;
+
+  // status stage
+  dcd_edpt_xfer(rhport, 0x80, NULL, 0);
+}
+
+void dcd_set_config (uint8_t rhport, uint8_t config_num)
+{
+  (void) rhport;
+  (void) config_num;
+}
+
+void dcd_remote_wakeup(uint8_t rhport)
+{
+  (void) rhport;
+  _dcd.remote_wakeup = true;
+}
+
+void dcd_get_caps(uint8_t rhport, dcd_caps_t* caps)
+{
+  (void) rhport;
+
+  caps->max_xfer_bytes = UINT16_MAX;
+  caps->speed          = (CFG_TUSB_RHPORT0_MODE & OPT_MODE_HIGH_SPEED) ? TUSB_SPEED_HIGH : TUSB_SPEED_FULL;
+  caps->multi_packet   = 1;
+}
+
+uint32_t dcd_frame_number(uint8_t rhport)
+{
+  (void) rhport;
+  return _dcd.frame;
+}
+
+/*------------------------------------------------------------------*/
+/* Endpoint API
+ *------------------------------------------------------------------*/
+
+// Isochronous is not supported
+bool dcd_edpt_open (uint8_t rhport, tusb_desc_endpoint_t const * p_endpoint_desc)
+{
+  (void) rhport;
+
+  TU_VERIFY(p_endpoint_desc->bmAttributes.xfer != TUSB_XFER_ISOCHRONOUS);
+  TU_ASSERT(tu_edpt_number(p_endpoint_desc->bEndpointAddress) < EP_MAX);
+
+  xfer_td_t* xfer = get_td(p_endpoint_desc->bEndpointAddress);
+  xfer->opened  = true;
+  xfer->busy    = false;
+  xfer->stalled = false;
+  xfer->mps     = p_endpoint_desc->wMaxPacketSize.size;
+
+  return true;
+}
+
+bool dcd_edpt_xfer (uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint32_t total_bytes)
+{
+  (void) rhport;
+
+  xfer_td_t* xfer = get_td(ep_addr);
+  TU_ASSERT(xfer->opened && !xfer->busy);
+
+  xfer->buffer     = buffer;
+  xfer->total_len  = total_bytes;
+  xfer->actual_len = 0;
+  xfer->busy       = true;
+
+  return true;
+}
+
+void dcd_edpt_close (uint8_t rhport, uint8_t ep_addr)
+{
+  (void) rhport;
+
+  xfer_td_t* xfer = get_td(ep_addr);
+  xfer->opened  = false;
+  xfer->busy    = false;
+  xfer->stalled = false;
+}
+
+void dcd_edpt_stall (uint8_t rhport, uint8_t ep_addr)
+{
+  (void) rhport;
+
+  // control endpoint is stalled in both directions
+  if ( tu_edpt_number(ep_addr) == 0 )
+  {
+    _dcd.xfer[0][TUSB_DIR_OUT].stalled = true;
+    _dcd.xfer[0][TUSB_DIR_IN ].stalled = true;
+  }else
+  {
+    get_td(ep_addr)->stalled = true;
+  }
+}
+
+void dcd_edpt_clear_stall (uint8_t rhport, uint8_t ep_addr)
+{
+  (void) rhport;
+  get_td(ep_addr)->stalled = false;
+}
+
+/*------------------------------------------------------------------*/
+/* Host side
+ *------------------------------------------------------------------*/
+void dcd_virtual_bus_reset(uint8_t rhport)
+{
+  for ( uint8_t epnum = 1; epnum < EP_MAX; epnum++ )
+  {
+    _dcd.xfer[epnum][TUSB_DIR_OUT].opened = false;
+    _dcd.xfer[epnum][TUSB_DIR_IN ].opened = false;
+  }
+  ep0_open();
+
+  _dcd.addr = _dcd.addr_pending = 0;
+  post_bus_signal(rhport, DCD_EVENT_BUS_RESET);
+}
+
+void dcd_virtual_sof(uint8_t rhport)
+{
+  _dcd.frame = (uint16_t) ((_dcd.frame + 1) & FRAME_MASK);
+  post_bus_signal(rhport, DCD_EVENT_SOF);
+}
+
+void dcd_virtual_suspend(uint8_t rhport)
+{
+  post_bus_signal(rhport, DCD_EVENT_SUSPEND);
+}
+
+void dcd_virtual_resume(uint8_t rhport)
+{
+  post_bus_signal(rhport, DCD_EVENT_RESUME);
+}
+
+void dcd_virtual_setup(uint8_t rhport, tusb_control_request_t const * request)
+{
+  // new setup aborts pending control transfers
+  ep0_open();
+
+  _dcd.event_count++;
+  dcd_event_setup_received(rhport, (uint8_t const*) request, true);
+}
+
+bool dcd_virtual_out(uint8_t rhport, uint8_t ep_addr, void const * data, uint32_t len, uint32_t* xferred)
+{
+  xfer_td_t* xfer = get_td(ep_addr);
+  TU_VERIFY(edpt_ready(xfer));
+
+  uint8_t const* src = (uint8_t const*) data;
+  uint32_t count = 0;
+
+  while (1)
+  {
+    uint16_t const pkt_len = (uint16_t) tu_min32(len - count, xfer->mps);
+
+    // packet larger than what is left in transfer is not acknowledged
+    if ( pkt_len > xfer->total_len - xfer->actual_len ) break;
+
+    memcpy(xfer->buffer + xfer->actual_len, src + count, pkt_len);
+    xfer->actual_len += pkt_len;
+    xfer->stats.packets++;
+    count += pkt_len;
+
+    if ( pkt_len < xfer->mps || xfer->actual_len == xfer->total_len )
+    {
+      xfer_complete(rhport, ep_addr, xfer);
+      break;
+    }
+
+    if ( count == len ) break;
+  }
+
+  (*xferred) = count;
+  return true;
+}
+
+bool dcd_virtual_in(uint8_t rhport, uint8_t ep_addr, void* data, uint32_t len, uint32_t* xferred)
+{
+  xfer_td_t* xfer = get_td(ep_addr);
+  TU_VERIFY(edpt_ready(xfer));
+
+  uint8_t* dst = (uint8_t*) data;
+  uint32_t count = 0;
+
+  while (1)
+  {
+    uint16_t const pkt_len = (uint16_t) tu_min32(xfer->total_len - xfer->actual_len, xfer->mps);
+
+    // host buffer too small for next packet
+    if ( pkt_len > len - count ) break;
+
+    memcpy(dst + count, xfer->buffer + xfer->actual_len, pkt_len);
+    xfer->actual_len += pkt_len;
+    xfer->stats.packets++;
+    count += pkt_len;
+
+    if ( pkt_len < xfer->mps || xfer->actual_len == xfer->total_len )
+    {
+      xfer_complete(rhport, ep_addr, xfer);
+      break;
+    }
+  }
+
+  (*xferred) = count;
+  return true;
+}
+
+bool dcd_virtual_edpt_stalled(uint8_t rhport, uint8_t ep_addr)
+{
+  (void) rhport;
+  return get_td(ep_addr)->stalled;
+}
+
+uint16_t dcd_virtual_edpt_size(uint8_t rhport, uint8_t ep_addr)
+{
+  (void) rhport;
+  return get_td(ep_addr)->mps;
+}
+
+uint8_t dcd_virtual_address(uint8_t rhport)
+{
+  (void) rhport;
+  return _dcd.addr;
+}
+
+bool dcd_virtual_remote_wakeup(uint8_t rhport)
+{
+  (void) rhport;
+
+  bool const ret = _dcd.remote_wakeup;
+  _dcd.remote_wakeup = false;
+  return ret;
+}
+
+void dcd_virtual_stats_get(uint8_t rhport, uint8_t ep_addr, dcd_virtual_ep_stats_t* stats)
+{
+  (void) rhport;
+  (*stats) = get_td(ep_addr)->stats;
+}
+
+uint32_t dcd_virtual_event_count(uint8_t rhport)
+{
+  (void) rhport;
+  return _dcd.event_count;
+}
+
+void dcd_virtual_stats_reset(uint8_t rhport)
+{
+  (void) rhport;
+
+  for ( uint8_t epnum = 0; epnum < EP_MAX; epnum++ )
+  {
+    tu_varclr(&_dcd.xfer[epnum][TUSB_DIR_OUT].stats);
+    tu_varclr(&_dcd.xfer[epnum][TUSB_DIR_IN ].stats);
+  }
+  _dcd.event_count = 0;
+}
+
+//--------------------------------------------------------------------+
+// Scripted transfers
+//--------------------------------------------------------------------+
+bool dcd_virtual_control_xfer(uint8_t rhport, tusb_control_request_t const * request, void* data, uint16_t* xferred)
+{
+  bool const dir_in = (request->bmRequestType_bit.direction == TUSB_DIR_IN);
+  uint16_t count = 0;
+
+  dcd_virtual_setup(rhport, request);
+  tud_task();
+
+  // data stage
+  if ( request->wLength )
+  {
+    count = (uint16_t) (dir_in ? dcd_virtual_read (rhport, 0x80, data, request->wLength) :
+                                 dcd_virtual_write(rhport, 0x00, data, request->wLength));
+    TU_VERIFY(!dcd_virtual_edpt_stalled(rhport, 0x00));
+  }
+
+  if ( xferred ) (*xferred) = count;
+
+  // status stage in opposite direction
+  uint32_t n;
+  bool const ret = dir_in && request->wLength ? dcd_virtual_out(rhport, 0x00, NULL, 0, &n) :
+                                                dcd_virtual_in (rhport, 0x80, NULL, 0, &n);
+  tud_task();
+
+  return ret;
+}
+
+uint32_t dcd_virtual_write(uint8_t rhport, uint8_t ep_addr, void const * data, uint32_t len)
+{
+  uint8_t const* src = (uint8_t const*) data;
+  uint32_t count = 0;
+
+  do
+  {
+    uint32_t n;
+
+    // device may arm its next transfer only once previous completion is processed
+    if ( !dcd_virtual_out(rhport, ep_addr, src + count, len - count, &n) )
+    {
+      tud_task();
+      if ( !dcd_virtual_out(rhport, ep_addr, src + count, len - count, &n) ) break;
+    }
+
+    count += n;
+    tud_task();
+
+    if ( len == 0 ) break;
+  } while ( count < len );
+
+  return count;
+}
+
+uint32_t dcd_virtual_read(uint8_t rhport, uint8_t ep_addr, void* data, uint32_t len)
+{
+  uint8_t* dst = (uint8_t*) data;
+  uint16_t const mps = dcd_virtual_edpt_size(rhport, ep_addr);
+  uint32_t count = 0;
+
+  while ( count < len )
+  {
+    uint32_t n;
+
+    if ( !dcd_virtual_in(rhport, ep_addr, dst + count, len - count, &n) )
+    {
+      tud_task();
+      if ( !dcd_virtual_in(rhport, ep_addr, dst + count, len - count, &n) ) break;
+    }
+
+    count += n;
+    tud_task();
+
+    // short packet ends transfer
+    if ( n % mps || n == 0 ) break;
+  }
+
+  return count;
+}
+
+bool dcd_virtual_enumerate(uint8_t rhport, uint8_t config_num, void* buf, uint16_t bufsize)
+{
+  static uint8_t desc[64];
+
+  dcd_virtual_bus_reset(rhport);
+  tud_task();
+
+  tusb_control_request_t request =
+  {
+    .bmRequestType = 0x80,
+    .bRequest      = TUSB_REQ_GET_DESCRIPTOR,
+    .wValue        = TUSB_DESC_DEVICE << 8,
+    .wIndex        = 0,
+    .wLength       = sizeof(tusb_desc_device_t)
+  };
+  TU_ASSERT( dcd_virtual_control_xfer(rhport, &request, desc, NULL) );
+
+  request = (tusb_control_request_t)
+  {
+    .bmRequestType = 0x00,
+    .bRequest      = TUSB_REQ_SET_ADDRESS,
+    .wValue        = 1,
+    .wIndex        = 0,
+    .wLength       = 0
+  };
+  TU_ASSERT( dcd_virtual_control_xfer(rhport, &request, NULL, NULL) );
+
+  if ( buf && bufsize )
+  {
+    request = (tusb_control_request_t)
+    {
+      .bmRequestType = 0x80,
+      .bRequest      = TUSB_REQ_GET_DESCRIPTOR,
+      .wValue        = (uint16_t) ((TUSB_DESC_CONFIGURATION << 8) | (config_num - 1)),
+      .wIndex        = 0,
+      .wLength       = bufsize
+    };
+    TU_ASSERT( dcd_virtual_control_xfer(rhport, &request, buf, NULL) );
+  }
+
+  request = (tusb_control_request_t)
+  {
+    .bmRequestType = 0x00,
+    .bRequest      = TUSB_REQ_SET_CONFIGURATION,
+    .wValue        = config_num,
+    .wIndex        = 0,
+    .wLength       = 0
+  };
+  TU_ASSERT( dcd_virtual_control_xfer(rhport, &request, NULL, NULL) );
+
+  return true;
+}
+
+#endif
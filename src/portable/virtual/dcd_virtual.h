@@ -0,0 +1,114 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#ifndef _TUSB_DCD_VIRTUAL_H_
+#define _TUSB_DCD_VIRTUAL_H_
+
+#include "common/tusb_common.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+// Software controller (CFG_TUSB_MCU = OPT_MCU_VIRTUAL) running the whole device stack natively, e.g in
+// unit tests. There is a single controller, rhport is passed through to the stack. The host side below is
+// called from the thread running tud_task(): events are posted as if from ISR and processed by the next
+// tud_task(), which the helpers at the end call in between transactions.
+
+// Counters per endpoint, kept by the controller
+typedef struct
+{
+  uint32_t xfer_count;   // transfers completed
+  uint32_t xfer_bytes;   // bytes of completed transfers
+  uint32_t packets;      // data packets moved, zero length included
+  uint32_t nak_count;    // host accesses while no transfer is armed
+  uint32_t stall_count;  // host accesses while stalled
+} dcd_virtual_ep_stats_t;
+
+//--------------------------------------------------------------------+
+// Host side: bus and transactions
+//--------------------------------------------------------------------+
+
+// Attach is a bus reset: endpoints other than control are closed, address is back to 0
+void dcd_virtual_bus_reset(uint8_t rhport);
+
+// Start of frame, 11-bit frame number is advanced
+void dcd_virtual_sof(uint8_t rhport);
+
+void dcd_virtual_suspend(uint8_t rhport);
+void dcd_virtual_resume(uint8_t rhport);
+
+// Setup packet to control endpoint, it clears a stall of control endpoint
+void dcd_virtual_setup(uint8_t rhport, tusb_control_request_t const * request);
+
+// Send up to len bytes to armed OUT transfer as packets of the endpoint size. Transfer completes once full or
+// with a short packet (len = 0 sends a zero length packet), data beyond it is left to the caller.
+// Return false if endpoint is stalled or has no transfer armed (NAK), otherwise xferred is bytes accepted
+bool dcd_virtual_out(uint8_t rhport, uint8_t ep_addr, void const * data, uint32_t len, uint32_t* xferred);
+
+// Take up to len bytes from armed IN transfer, stops at its end. Return false if stalled or NAK
+bool dcd_virtual_in(uint8_t rhport, uint8_t ep_addr, void* data, uint32_t len, uint32_t* xferred);
+
+bool     dcd_virtual_edpt_stalled(uint8_t rhport, uint8_t ep_addr);
+uint16_t dcd_virtual_edpt_size(uint8_t rhport, uint8_t ep_addr);
+
+// Address set by host, effective once its status stage completed
+uint8_t  dcd_virtual_address(uint8_t rhport);
+
+// Remote wakeup signaled by device since last call
+bool     dcd_virtual_remote_wakeup(uint8_t rhport);
+
+void     dcd_virtual_stats_get(uint8_t rhport, uint8_t ep_addr, dcd_virtual_ep_stats_t* stats);
+
+// Number of events posted to the stack (bus, setup and transfer complete)
+uint32_t dcd_virtual_event_count(uint8_t rhport);
+
+void     dcd_virtual_stats_reset(uint8_t rhport);
+
+//--------------------------------------------------------------------+
+// Host side: scripted transfers, tud_task() is run after each transaction
+//--------------------------------------------------------------------+
+
+// Setup, data stage of wLength into/from data and status stage. Return false if device stalled or does
+// not respond, xferred (optional) is length of data stage
+bool dcd_virtual_control_xfer(uint8_t rhport, tusb_control_request_t const * request, void* data, uint16_t* xferred);
+
+// Send len bytes to OUT endpoint, len = 0 sends a zero length packet.
+// Return bytes accepted before device stopped taking data
+uint32_t dcd_virtual_write(uint8_t rhport, uint8_t ep_addr, void const * data, uint32_t len);
+
+// Read IN endpoint until len bytes, a short packet or no more data. Return bytes read
+uint32_t dcd_virtual_read(uint8_t rhport, uint8_t ep_addr, void* data, uint32_t len);
+
+// Bus reset then standard enumeration: address, device and configuration descriptor
+// (up to bufsize into buf, optional) and configuration config_num
+bool dcd_virtual_enumerate(uint8_t rhport, uint8_t config_num, void* buf, uint16_t bufsize);
+
+#ifdef __cplusplus
+ }
+#endif
+
+#endif /* _TUSB_DCD_VIRTUAL_H_ */
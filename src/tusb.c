@@ -32,22 +32,83 @@
 
 static bool _initialized = false;
 
+#if CFG_TUSB_OS == OPT_OS_FREERTOS
+BaseType_t _osal_isr_woken = pdFALSE;
+#endif
+
+#if CFG_TUSB_TRACE
+TU_VERIFY_STATIC((CFG_TUSB_TRACE_BUFSIZE & (CFG_TUSB_TRACE_BUFSIZE-1)) == 0, "CFG_TUSB_TRACE_BUFSIZE must be power of 2");
+
+static tu_trace_entry_t _trace_buf[CFG_TUSB_TRACE_BUFSIZE];
+static volatile uint32_t _trace_count;
+
+// Slot is reserved atomically where supported (e.g LDREX/STREX), otherwise a record may
+// be lost when an ISR preempts writing of another one
+void tu_trace_record(uint8_t id, uint8_t rhport, uint8_t arg)
+{
+#if defined(__GCC_ATOMIC_INT_LOCK_FREE) && (__GCC_ATOMIC_INT_LOCK_FREE == 2)
+  uint32_t const idx = __atomic_fetch_add(&_trace_count, 1, __ATOMIC_RELAXED);
+#else
+  uint32_t const idx = _trace_count++;
+#endif
+
+  tu_trace_entry_t* entry = &_trace_buf[idx & (CFG_TUSB_TRACE_BUFSIZE-1)];
+  entry->timestamp = CFG_TUSB_TRACE_TIMESTAMP();
+  entry->id        = id;
+  entry->rhport    = rhport;
+  entry->arg       = arg;
+}
+
+tu_trace_entry_t const* tu_trace_buffer(uint32_t* count)
+{
+  (*count) = _trace_count;
+  return _trace_buf;
+}
+#endif
+
+#if CFG_TUSB_OS == OPT_OS_MYNEWT && CFG_TUSB_OS_MYNEWT_EVQ
+struct os_eventq* _osal_evq;
+
+void tusb_mynewt_evq_set(struct os_eventq* evq)
+{
+  _osal_evq = evq;
+}
+
+// queue event handler, drain events queued so far
+void _osal_evq_cb(struct os_event* ev)
+{
+  (void) ev;
+  tud_task_ext(OSAL_TIMEOUT_NOTIMEOUT);
+}
+#endif
+
 // TODO clean up
 #if TUSB_OPT_DEVICE_ENABLED
 #include "device/usbd_pvt.h"
 #endif
 
+#if TUSB_OPT_DUAL_ROLE
+static volatile uint8_t _role;  // stack owning the controller, its isr is dispatched
+static uint8_t _role_inited;    // stacks initialized so far
+#endif
+
 bool tusb_init(void)
 {
   // skip if already initialized
   if (_initialized) return true;
 
+#if TUSB_OPT_DUAL_ROLE
+  // stacks are initialized lazily by tusb_role_set()
+#else
+
 #if TUSB_OPT_HOST_ENABLED
   TU_ASSERT( usbh_init() ); // init host stack
 #endif
 
 #if TUSB_OPT_DEVICE_ENABLED
   TU_ASSERT ( tud_init() ); // init device stack
+#endif
+
 #endif
 
   _initialized = true;
@@ -60,6 +121,59 @@ bool tusb_inited(void)
   return _initialized;
 }
 
+#if TUSB_OPT_DUAL_ROLE
+
+bool tusb_role_set(uint8_t role)
+{
+  TU_VERIFY( _initialized && (role == OPT_MODE_NONE || role == OPT_MODE_DEVICE || role == OPT_MODE_HOST) );
+  if ( role == _role ) return true;
+
+  //------------- Leave current role -------------//
+  if ( _role == OPT_MODE_DEVICE ) usbd_role_stop(TUD_OPT_RHPORT);
+  if ( _role == OPT_MODE_HOST   ) usbh_role_stop();
+
+  // set before controller is initialized so that its first interrupt is dispatched
+  _role = role;
+
+  //------------- Enter new role, controller is reset -------------//
+  bool is_ok = true;
+
+  if ( role == OPT_MODE_DEVICE )
+  {
+    is_ok = (_role_inited & OPT_MODE_DEVICE) ? usbd_role_start(TUD_OPT_RHPORT) : tud_init();
+  }
+  else if ( role == OPT_MODE_HOST )
+  {
+    is_ok = (_role_inited & OPT_MODE_HOST) ? usbh_role_start() : usbh_init();
+  }
+
+  if ( !is_ok )
+  {
+    _role = OPT_MODE_NONE;
+    return false;
+  }
+
+  _role_inited |= role;
+  return true;
+}
+
+uint8_t tusb_role_get(void)
+{
+  return _role;
+}
+
+uint8_t tusb_role_id_pin(void)
+{
+  return hcd_otg_id_is_host(TUH_OPT_RHPORT) ? OPT_MODE_HOST : OPT_MODE_DEVICE;
+}
+
+bool tusb_role_inited(uint8_t role)
+{
+  return (_role_inited & role) != 0;
+}
+
+#endif
+
 /*------------------------------------------------------------------*/
 /* Debug
  *------------------------------------------------------------------*/
@@ -139,6 +253,111 @@ void tu_print_mem(void const *buf, uint8_t size, uint16_t count)
   tu_printf("\r\n");
 }
 
+#if CFG_TUSB_DEBUG_BINARY
+TU_VERIFY_STATIC((CFG_TUSB_DEBUG_BINARY_BUFSIZE & (CFG_TUSB_DEBUG_BINARY_BUFSIZE-1)) == 0, "CFG_TUSB_DEBUG_BINARY_BUFSIZE must be power of 2");
+
+// Written by any context, read by a single consumer. Oldest records are overwritten when full.
+static tu_log_entry_t _log_buf[CFG_TUSB_DEBUG_BINARY_BUFSIZE];
+static volatile uint32_t _log_wr;
+static uint32_t _log_rd;
+
+#define _log_barrier()   __asm volatile ("" ::: "memory")
+
+// Slot is reserved atomically where supported (e.g LDREX/STREX), otherwise a record may
+// be lost when an ISR preempts writing of another one
+static tu_log_entry_t* log_reserve(uint32_t* idx)
+{
+#if defined(__GCC_ATOMIC_INT_LOCK_FREE) && (__GCC_ATOMIC_INT_LOCK_FREE == 2)
+  (*idx) = __atomic_fetch_add(&_log_wr, 1, __ATOMIC_RELAXED);
+#else
+  (*idx) = _log_wr++;
+#endif
+
+  tu_log_entry_t* entry = &_log_buf[(*idx) & (CFG_TUSB_DEBUG_BINARY_BUFSIZE-1)];
+  entry->seq = 0;
+  _log_barrier();
+
+  return entry;
+}
+
+void tu_log_bin(char const* fmt, uint8_t argc, uintptr_t a0, uintptr_t a1, uintptr_t a2, uintptr_t a3)
+{
+  uint32_t idx;
+  tu_log_entry_t* entry = log_reserve(&idx);
+
+  entry->fmt     = fmt;
+  entry->argc    = argc;
+  entry->size    = 0;
+  entry->argv[0] = a0;
+  entry->argv[1] = a1;
+  entry->argv[2] = a2;
+  entry->argv[3] = a3;
+
+  _log_barrier();
+  entry->seq = idx + 1;
+}
+
+void tu_log_bin_mem(void const *buf, uint8_t size, uint16_t count)
+{
+  uint32_t idx;
+  tu_log_entry_t* entry = log_reserve(&idx);
+
+  // whole items only
+  uint32_t len = buf ? tu_min32((uint32_t) size*count, sizeof(entry->argv)) : 0;
+  if ( size ) len -= len % size;
+
+  entry->fmt  = NULL;
+  entry->argc = (uint8_t) len;
+  entry->size = size;
+  memcpy(entry->argv, buf, len);
+
+  _log_barrier();
+  entry->seq = idx + 1;
+}
+
+bool tu_log_bin_read(tu_log_entry_t* entry)
+{
+  while (1)
+  {
+    uint32_t const wr = _log_wr;
+
+    // skip records overwritten meanwhile
+    if ( wr - _log_rd > CFG_TUSB_DEBUG_BINARY_BUFSIZE ) _log_rd = wr - CFG_TUSB_DEBUG_BINARY_BUFSIZE;
+    if ( wr == _log_rd ) return false;
+
+    (*entry) = _log_buf[_log_rd & (CFG_TUSB_DEBUG_BINARY_BUFSIZE-1)];
+    _log_barrier();
+
+    // copy is valid if slot is not reused while copying
+    if ( _log_wr - _log_rd <= CFG_TUSB_DEBUG_BINARY_BUFSIZE )
+    {
+      if ( entry->seq != _log_rd + 1 ) return false; // still being written
+
+      _log_rd++;
+      return true;
+    }
+  }
+}
+
+bool tu_log_bin_print(void)
+{
+  tu_log_entry_t entry;
+  TU_VERIFY( tu_log_bin_read(&entry) );
+
+  if ( entry.fmt )
+  {
+    tu_printf(entry.fmt, entry.argv[0], entry.argv[1], entry.argv[2], entry.argv[3]);
+  }
+  else
+  {
+    uint8_t const size = entry.size ? entry.size : 1;
+    tu_print_mem(entry.argv, size, (uint16_t) (entry.argc / size));
+  }
+
+  return true;
+}
+#endif
+
 #endif
 
 #endif // host or device enabled
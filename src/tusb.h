@@ -58,6 +58,18 @@
     #include "class/vendor/vendor_host.h"
   #endif
 
+  #if CFG_TUH_NET
+    #include "class/net/net_host.h"
+  #endif
+
+  #if CFG_TUH_MIDI
+    #include "class/midi/midi_host.h"
+  #endif
+
+  #if CFG_TUH_AUDIO
+    #include "class/audio/audio_host.h"
+  #endif
+
 #endif
 
 //------------- DEVICE -------------//
@@ -76,10 +88,26 @@
     #include "class/msc/msc_device.h"
   #endif
 
+  #if CFG_TUD_UAS
+    #include "class/msc/uas_device.h"
+  #endif
+
+  #if CFG_TUD_MSC_UF2
+    #include "class/msc/msc_uf2.h"
+  #endif
+
+  #if CFG_TUD_AUDIO
+    #include "class/audio/audio_device.h"
+  #endif
+
   #if CFG_TUD_MIDI
     #include "class/midi/midi_device.h"
   #endif
 
+  #if CFG_TUD_VIDEO
+    #include "class/video/video_device.h"
+  #endif
+
   #if CFG_TUD_VENDOR
     #include "class/vendor/vendor_device.h"
   #endif
@@ -91,6 +119,26 @@
   #if CFG_TUD_DFU_RT
     #include "class/dfu/dfu_rt_device.h"
   #endif
+
+  #if CFG_TUD_DFU
+    #include "class/dfu/dfu_device.h"
+  #endif
+
+  #if CFG_TUD_NCM
+    #include "class/net/ncm_device.h"
+  #endif
+
+  #if CFG_TUD_RNDIS
+    #include "class/net/rndis_device.h"
+  #endif
+
+  #if CFG_TUD_BTH
+    #include "class/bth/bth_device.h"
+  #endif
+
+  #if CFG_TUD_PRINTER
+    #include "class/printer/printer_device.h"
+  #endif
 #endif
 
 
@@ -106,6 +154,21 @@ bool tusb_init(void);
 // Check if stack is initialized
 bool tusb_inited(void);
 
+#if TUSB_OPT_DUAL_ROLE
+// Role of dual-role port: OPT_MODE_DEVICE, OPT_MODE_HOST or OPT_MODE_NONE (after tusb_init). Stack of a role
+// is initialized on its first use. Leaving a role unmounts the device or all attached devices as if unplugged.
+// Must be called in the same context as tud_task() and tuh_task()
+bool    tusb_role_set(uint8_t role);
+uint8_t tusb_role_get(void);
+
+// Role requested by ID pin of OTG connector: host if grounded (A-device), device otherwise.
+// Application polls it e.g in mainloop and calls tusb_role_set() on change
+uint8_t tusb_role_id_pin(void);
+
+// Whether stack of role is initialized
+bool    tusb_role_inited(uint8_t role);
+#endif
+
 // TODO
 // bool tusb_teardown(void);
 
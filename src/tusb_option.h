@@ -74,6 +74,8 @@
 
 #define OPT_MCU_MIMXRT10XX        700 ///< NXP iMX RT10xx
 
+#define OPT_MCU_VIRTUAL           900 ///< Software controller running the stack natively (src/portable/virtual)
+
 /** @} */
 
 /** \defgroup group_supported_os Supported RTOS
@@ -82,6 +84,8 @@
 #define OPT_OS_NONE       1 ///< No RTOS
 #define OPT_OS_FREERTOS   2 ///< FreeRTOS
 #define OPT_OS_MYNEWT     3 ///< Mynewt OS
+#define OPT_OS_ZEPHYR     4 ///< Zephyr
+#define OPT_OS_CMSIS_RTOS2 5 ///< CMSIS-RTOS2 e.g RTX5
 /** @} */
 
 
@@ -106,6 +110,7 @@
 #define OPT_MODE_NONE         0x00 ///< Disabled
 #define OPT_MODE_DEVICE       0x01 ///< Device Mode
 #define OPT_MODE_HOST         0x02 ///< Host Mode
+#define OPT_MODE_DUAL_ROLE    (OPT_MODE_DEVICE | OPT_MODE_HOST) ///< Device or Host selected at runtime, see tusb_role_set()
 #define OPT_MODE_HIGH_SPEED   0x10 ///< High speed
 /** @} */
 
@@ -117,26 +122,50 @@
   #define CFG_TUSB_RHPORT1_MODE OPT_MODE_NONE
 #endif
 
-#if ((CFG_TUSB_RHPORT0_MODE & OPT_MODE_HOST) && (CFG_TUSB_RHPORT1_MODE & OPT_MODE_HOST)) || \
-    ((CFG_TUSB_RHPORT0_MODE & OPT_MODE_DEVICE) && (CFG_TUSB_RHPORT1_MODE & OPT_MODE_DEVICE))
-  #error "tinyusb does not support same modes on more than 1 roothub port"
+#if (CFG_TUSB_RHPORT0_MODE & OPT_MODE_HOST) && (CFG_TUSB_RHPORT1_MODE & OPT_MODE_HOST)
+  #error "tinyusb does not support host mode on more than 1 roothub port"
 #endif
 
 // Which roothub port is configured as host
 #define TUH_OPT_RHPORT          ( (CFG_TUSB_RHPORT0_MODE & OPT_MODE_HOST) ? 0 : ((CFG_TUSB_RHPORT1_MODE & OPT_MODE_HOST) ? 1 : -1) )
 #define TUSB_OPT_HOST_ENABLED   ( TUH_OPT_RHPORT >= 0 )
 
-// Which roothub port is configured as device
+// Which roothub port is configured as device, the first one if both are
 #define TUD_OPT_RHPORT          ( (CFG_TUSB_RHPORT0_MODE & OPT_MODE_DEVICE) ? 0 : ((CFG_TUSB_RHPORT1_MODE & OPT_MODE_DEVICE) ? 1 : -1) )
 
-#if TUD_OPT_RHPORT == 0
-#define TUD_OPT_HIGH_SPEED      ( CFG_TUSB_RHPORT0_MODE & OPT_MODE_HIGH_SPEED )
-#else
-#define TUD_OPT_HIGH_SPEED      ( CFG_TUSB_RHPORT1_MODE & OPT_MODE_HIGH_SPEED )
+// Both roothub ports can be device, each presents an independent device to its own host
+#define TUD_OPT_RHPORT_IS_DEVICE(_rhport) ( ((_rhport) == 0 ? CFG_TUSB_RHPORT0_MODE : CFG_TUSB_RHPORT1_MODE) & OPT_MODE_DEVICE )
+#define TUD_OPT_RHPORT_COUNT    ( ((CFG_TUSB_RHPORT0_MODE & OPT_MODE_DEVICE) ? 1 : 0) + ((CFG_TUSB_RHPORT1_MODE & OPT_MODE_DEVICE) ? 1 : 0) )
+
+// Speed of a device port. TUD_OPT_HIGH_SPEED is set if any device port is high speed, for buffer sizing
+#define TUD_OPT_RHPORT_HIGH_SPEED(_rhport) ( ((_rhport) == 0 ? CFG_TUSB_RHPORT0_MODE : CFG_TUSB_RHPORT1_MODE) & OPT_MODE_HIGH_SPEED )
+#define TUD_OPT_HIGH_SPEED      ( ((CFG_TUSB_RHPORT0_MODE & OPT_MODE_DEVICE) && TUD_OPT_RHPORT_HIGH_SPEED(0)) || \
+                                  ((CFG_TUSB_RHPORT1_MODE & OPT_MODE_DEVICE) && TUD_OPT_RHPORT_HIGH_SPEED(1)) )
+
+// DCD keeping its state per port, other ones drive a single controller
+#define TUD_OPT_DCD_MULTI_PORT  ( CFG_TUSB_MCU == OPT_MCU_LPC18XX || CFG_TUSB_MCU == OPT_MCU_LPC43XX || \
+                                  CFG_TUSB_MCU == OPT_MCU_MIMXRT10XX )
+
+#if TUD_OPT_RHPORT_COUNT > 1 && !TUD_OPT_DCD_MULTI_PORT
+  #error "device mode on both roothub ports is only supported by transdimension DCD (LPC18xx/43xx, i.MX RT)"
 #endif
 
 #define TUSB_OPT_DEVICE_ENABLED ( TUD_OPT_RHPORT >= 0 )
 
+// Host and device stacks share the controller of a dual-role (OTG) port, one at a time
+#define TUSB_OPT_DUAL_ROLE      ( TUSB_OPT_HOST_ENABLED && (TUH_OPT_RHPORT == TUD_OPT_RHPORT) )
+
+#if TUSB_OPT_DUAL_ROLE
+  #if TUD_OPT_RHPORT_COUNT > 1
+    #error "dual-role port must be the only device port"
+  #endif
+
+  // controller with both DCD and HCD
+  #if !(CFG_TUSB_MCU == OPT_MCU_LPC18XX || CFG_TUSB_MCU == OPT_MCU_LPC43XX)
+    #error "dual-role port is only supported by LPC18xx/43xx"
+  #endif
+#endif
+
 
 //--------------------------------------------------------------------+
 // COMMON OPTIONS
@@ -147,6 +176,32 @@
   #define CFG_TUSB_DEBUG 0
 #endif
 
+// Debug log is recorded in binary (format pointer and raw arguments) into a ring of
+// CFG_TUSB_DEBUG_BINARY_BUFSIZE (power of 2) records instead of printf, see tu_log_bin_print()
+#ifndef CFG_TUSB_DEBUG_BINARY
+  #define CFG_TUSB_DEBUG_BINARY 0
+#endif
+
+#ifndef CFG_TUSB_DEBUG_BINARY_BUFSIZE
+  #define CFG_TUSB_DEBUG_BINARY_BUFSIZE 64
+#endif
+
+// Release build: TU_ASSERT() neither logs nor halts, it only returns like TU_VERIFY(). Stack invariants
+// checked with TU_ASSUME() are not tested at all, compiler optimizes as if they hold
+#ifndef CFG_TUSB_ASSERT_RELEASE
+  #define CFG_TUSB_ASSERT_RELEASE 0
+#endif
+
+// Record timestamped trace points of device stack (ISR, event queue, class callbacks), see common/tusb_trace.h
+#ifndef CFG_TUSB_TRACE
+  #define CFG_TUSB_TRACE 0
+#endif
+
+// Number of records kept by default trace backend, power of 2
+#ifndef CFG_TUSB_TRACE_BUFSIZE
+  #define CFG_TUSB_TRACE_BUFSIZE 64
+#endif
+
 // place data in accessible RAM for usb controller
 #ifndef CFG_TUSB_MEM_SECTION
 #define CFG_TUSB_MEM_SECTION
@@ -156,10 +211,63 @@
 #define CFG_TUSB_MEM_ALIGN        TU_ATTR_ALIGNED(4)
 #endif
 
+// Class drivers (CDC, Vendor) split their memory so that each part can be placed on its own:
+// endpoint buffers accessed by usb controller DMA, FIFO storage (DMA-visible too with
+// CFG_TUD_FIFO_ZERO_COPY) and interface state only accessed by cpu. Default to CFG_TUSB_MEM_SECTION
+#ifndef CFG_TUSB_MEM_DMA_SECTION
+#define CFG_TUSB_MEM_DMA_SECTION    CFG_TUSB_MEM_SECTION
+#endif
+
+#ifndef CFG_TUSB_MEM_DMA_ALIGN
+#define CFG_TUSB_MEM_DMA_ALIGN      CFG_TUSB_MEM_ALIGN
+#endif
+
+#ifndef CFG_TUSB_MEM_FIFO_SECTION
+#define CFG_TUSB_MEM_FIFO_SECTION   CFG_TUSB_MEM_SECTION
+#endif
+
+#ifndef CFG_TUSB_MEM_STATE_SECTION
+#define CFG_TUSB_MEM_STATE_SECTION  CFG_TUSB_MEM_SECTION
+#endif
+
+// Place ISR and hot path code (dcd interrupt handlers, dcd_event_*, tud_task and FIFO data path) in fast
+// memory when executing from XIP or wait-stated flash, e.g __attribute__((section(".ramfunc"))) which is
+// copied to RAM/ITCM by linker scripts in hw/bsp. Default to normal code section
+#ifndef CFG_TUSB_MEM_FAST_FUNC
+#define CFG_TUSB_MEM_FAST_FUNC
+#endif
+
+// Copies of FIFO and class buffers of at least this many bytes are handed to tusb_memcpy_dma_cb()
+// when the application provides it (e.g memory-to-memory DMA channel). 0 to always copy with cpu
+#ifndef CFG_TUSB_MEMCPY_DMA_THRESHOLD
+#define CFG_TUSB_MEMCPY_DMA_THRESHOLD  0
+#endif
+
 #ifndef CFG_TUSB_OS
 #define CFG_TUSB_OS               OPT_OS_NONE
 #endif
 
+// FreeRTOS: deliver usbd/usbh events through a lock-free FIFO and direct task notification instead of a
+// FreeRTOS queue. tud_task()/tuh_task() must each be called by a single task
+#ifndef CFG_TUSB_OS_FREERTOS_NOTIFY
+#define CFG_TUSB_OS_FREERTOS_NOTIFY  0
+#endif
+
+// OS None: sleep with WFE while blocked in osal_semaphore_wait(), woken by interrupts and SEV of posting ISR (Arm only)
+#ifndef CFG_TUSB_OS_NONE_WFE
+#define CFG_TUSB_OS_NONE_WFE         1
+#endif
+
+// Mynewt: process usbd events within an application os_eventq (default one unless tusb_mynewt_evq_set())
+// instead of a task calling tud_task(). Host stack needs its own task for enumeration delays.
+#ifndef CFG_TUSB_OS_MYNEWT_EVQ
+#define CFG_TUSB_OS_MYNEWT_EVQ       0
+#endif
+
+#if CFG_TUSB_OS == OPT_OS_MYNEWT && CFG_TUSB_OS_MYNEWT_EVQ && TUSB_OPT_HOST_ENABLED
+  #error "CFG_TUSB_OS_MYNEWT_EVQ is only supported by device stack"
+#endif
+
 //--------------------------------------------------------------------
 // DEVICE OPTIONS
 //--------------------------------------------------------------------
@@ -168,6 +276,85 @@
   #define CFG_TUD_ENDPOINT0_SIZE   64
 #endif
 
+// Class drivers (CDC, Vendor) transmit straight from their TX FIFO buffer instead of
+// copying into an endpoint buffer. DCD must accept transfer buffers at any address.
+#ifndef CFG_TUD_FIFO_ZERO_COPY
+  #define CFG_TUD_FIFO_ZERO_COPY  0
+#endif
+
+// Class drivers (CDC, Vendor) receive with two OUT buffers: next transfer is armed into
+// the other buffer before received data is copied into RX FIFO.
+#ifndef CFG_TUD_EPOUT_DOUBLE_BUFFER
+  #define CFG_TUD_EPOUT_DOUBLE_BUFFER  0
+#endif
+
+// Number of transfer buffers in a pool shared by class drivers (CDC, Vendor), 0 to disable.
+// IN transfer buffer is then borrowed per transfer instead of reserved by every interface.
+// Pool is placed in CFG_TUSB_MEM_SECTION, each buffer is CFG_TUD_EP_POOL_BUFSIZE (multiple of 4) bytes.
+#ifndef CFG_TUD_EP_POOL_COUNT
+  #define CFG_TUD_EP_POOL_COUNT    0
+#endif
+
+#ifndef CFG_TUD_EP_POOL_BUFSIZE
+  #define CFG_TUD_EP_POOL_BUFSIZE  64
+#endif
+
+// String descriptors are served from application's tud_descriptor_string_arr[] table
+// (e.g declared with TUD_STRING_DESCRIPTOR_DEF) instead of tud_descriptor_string_cb().
+#ifndef CFG_TUD_DESC_STRING_TABLE
+  #define CFG_TUD_DESC_STRING_TABLE  0
+#endif
+
+// Descriptor callbacks may return TUD_DESC_PENDING and answer later with tud_descriptor_reply() (usbd.h)
+// e.g descriptors or serial number read from external flash. Host is NAKed meanwhile
+#ifndef CFG_TUD_DESC_ASYNC
+  #define CFG_TUD_DESC_ASYNC  0
+#endif
+
+// MS OS 2.0 descriptors are generated to bind vendor specific interfaces to WinUSB without INF on Windows,
+// bit n selects the n-th one of first configuration (up to 8). BOS is generated too unless application has
+// tud_descriptor_bos_cb(), which then needs TUD_BOS_WINUSB_DESCRIPTOR() (usbd.h). bcdUSB must be >= 0x0201
+#ifndef CFG_TUD_WINUSB
+  #define CFG_TUD_WINUSB  0
+#endif
+
+// Vendor request code of MS OS 2.0 descriptor set, must differ from vendor requests of application
+#ifndef CFG_TUD_WINUSB_VENDOR_CODE
+  #define CFG_TUD_WINUSB_VENDOR_CODE  0x20
+#endif
+
+// Keep per-endpoint transfer statistics readable with tud_stats_get(), see CFG_TUD_STATS_TIMESTAMP (usbd.c)
+#ifndef CFG_TUD_STATS
+  #define CFG_TUD_STATS  0
+#endif
+
+// Time enumeration milestones and handling of control requests, see tud_enum_profile_get() and
+// CFG_TUD_PROFILE_TIMESTAMP (usbd.c)
+#ifndef CFG_TUD_ENUM_PROFILE
+  #define CFG_TUD_ENUM_PROFILE  0
+#endif
+
+// Device stack (DCD, usbd, class drivers) runs on its own core of an asymmetric multicore mcu, FIFO API
+// of CDC and Vendor and tud_msc_async_io_done() are called from the application core. Their FIFOs are
+// single producer/consumer across cores (CFG_TUSB_MEM_FIFO_SECTION and CFG_TUSB_MEM_STATE_SECTION in RAM
+// shared by both cores), work for the stack core is signalled by tud_split_doorbell_cb() (usbd.h)
+#ifndef CFG_TUD_SPLIT_CORE
+  #define CFG_TUD_SPLIT_CORE  0
+#endif
+
+// Link Power Management: controller acknowledges LPM tokens and the link sleeps in L1, resumed within
+// tens of microseconds. Host only sends them to a device having TUD_BOS_USB20_EXT_DESCRIPTOR (usbd.h)
+#ifndef CFG_TUD_LPM
+  #define CFG_TUD_LPM  0
+#endif
+
+// Bus reset keeps class driver state (FIFOs included) and interface/endpoint mapping of the configuration
+// when all its drivers have reopen(). Host selecting it again then only reopens endpoints, otherwise
+// drivers are reset and opened as usual
+#ifndef CFG_TUD_FAST_RESET
+  #define CFG_TUD_FAST_RESET  0
+#endif
+
 #ifndef CFG_TUD_CDC
   #define CFG_TUD_CDC             0
 #endif
@@ -176,14 +363,30 @@
   #define CFG_TUD_MSC             0
 #endif
 
+#ifndef CFG_TUD_UAS
+  #define CFG_TUD_UAS             0
+#endif
+
+#ifndef CFG_TUD_MSC_UF2
+  #define CFG_TUD_MSC_UF2         0
+#endif
+
 #ifndef CFG_TUD_HID
   #define CFG_TUD_HID             0
 #endif
 
+#ifndef CFG_TUD_AUDIO
+  #define CFG_TUD_AUDIO           0
+#endif
+
 #ifndef CFG_TUD_MIDI
   #define CFG_TUD_MIDI            0
 #endif
 
+#ifndef CFG_TUD_VIDEO
+  #define CFG_TUD_VIDEO           0
+#endif
+
 #ifndef CFG_TUD_VENDOR
   #define CFG_TUD_VENDOR          0
 #endif
@@ -196,6 +399,26 @@
   #define CFG_TUD_DFU_RT          0
 #endif
 
+#ifndef CFG_TUD_DFU
+  #define CFG_TUD_DFU             0
+#endif
+
+#ifndef CFG_TUD_NCM
+  #define CFG_TUD_NCM             0
+#endif
+
+#ifndef CFG_TUD_RNDIS
+  #define CFG_TUD_RNDIS           0
+#endif
+
+#ifndef CFG_TUD_BTH
+  #define CFG_TUD_BTH             0
+#endif
+
+#ifndef CFG_TUD_PRINTER
+  #define CFG_TUD_PRINTER         0
+#endif
+
 
 //--------------------------------------------------------------------
 // HOST OPTIONS
@@ -214,10 +437,182 @@
   //------------- HID CLASS -------------//
   #define HOST_CLASS_HID   ( CFG_TUH_HID_KEYBOARD + CFG_TUH_HID_MOUSE + CFG_TUSB_HOST_HID_GENERIC )
 
+  // Generic HID interfaces across all devices
+  #ifndef CFG_TUH_HID_ITF_MAX
+    #define CFG_TUH_HID_ITF_MAX  CFG_TUSB_HOST_DEVICE_MAX
+  #endif
+
   #ifndef CFG_TUSB_HOST_ENUM_BUFFER_SIZE
     #define CFG_TUSB_HOST_ENUM_BUFFER_SIZE 256
   #endif
 
+  // Configuration descriptors of recently enumerated devices (keyed by VID/PID/bcdDevice), re-attach of
+  // a cached device skips reading its full configuration descriptor.
+  #ifndef CFG_TUH_ENUM_CACHE
+    #define CFG_TUH_ENUM_CACHE  0
+  #endif
+
+  // Longer configuration descriptor is not cached
+  #ifndef CFG_TUH_ENUM_CACHE_DESC_SIZE
+    #define CFG_TUH_ENUM_CACHE_DESC_SIZE  CFG_TUSB_HOST_ENUM_BUFFER_SIZE
+  #endif
+
+  // Each control stage fails with XFER_RESULT_TIMEOUT if device does not complete it in time (ms)
+  #ifndef CFG_TUH_CONTROL_TIMEOUT_MS
+    #define CFG_TUH_CONTROL_TIMEOUT_MS  5000
+  #endif
+
+  // Count transfers, bytes and errors of each endpoint, see tuh_stats_get()
+  #ifndef CFG_TUH_STATS
+    #define CFG_TUH_STATS  0
+  #endif
+
+  //------------- CDC CLASS -------------//
+  // CDC interfaces across all devices
+  #ifndef CFG_TUH_CDC_ITF_MAX
+    #define CFG_TUH_CDC_ITF_MAX  CFG_TUSB_HOST_DEVICE_MAX
+  #endif
+
+  // Driver owns data pipes with RX/TX FIFO, see tuh_cdc_n_read(). tuh_cdc_send()/tuh_cdc_receive() are not available
+  #ifndef CFG_TUH_CDC_STREAM
+    #define CFG_TUH_CDC_STREAM  0
+  #endif
+
+  #ifndef CFG_TUH_CDC_RX_BUFSIZE
+    #define CFG_TUH_CDC_RX_BUFSIZE  1024
+  #endif
+
+  #ifndef CFG_TUH_CDC_TX_BUFSIZE
+    #define CFG_TUH_CDC_TX_BUFSIZE  512
+  #endif
+
+  // Each of the two transfer buffers per direction, multiple of bulk endpoint size
+  #ifndef CFG_TUH_CDC_EP_BUFSIZE
+    #define CFG_TUH_CDC_EP_BUFSIZE  512
+  #endif
+
+  //------------- MSC CLASS -------------//
+  // Data bytes per command of a queued request, larger request is split. HCD needs enough TDs for this size
+  // (EHCI: up to 20 KB per qTD, OHCI: 8 KB per gTD), see CFG_TUH_EHCI_QTD_EXTRA and CFG_TUH_OHCI_GTD_EXTRA
+  #ifndef CFG_TUH_MSC_MAX_XFER_SIZE
+    #define CFG_TUH_MSC_MAX_XFER_SIZE  16384
+  #endif
+
+  // Logical units per device, e.g slots of card reader. Others reported by device are not used
+  #ifndef CFG_TUH_MSC_MAXLUN
+    #define CFG_TUH_MSC_MAXLUN  4
+  #endif
+
+  // Requests queued per device by tuh_msc_read_queue()/tuh_msc_write_queue(), must be power of 2
+  #ifndef CFG_TUH_MSC_QUEUE
+    #define CFG_TUH_MSC_QUEUE  4
+  #endif
+
+  //------------- VENDOR CLASS -------------//
+  // Vendor interfaces across all devices
+  #ifndef CFG_TUH_VENDOR
+    #define CFG_TUH_VENDOR  0
+  #endif
+
+  // Transfers can be submitted per vendor pipe
+  #ifndef CFG_TUH_VENDOR_XFER_QUEUE
+    #define CFG_TUH_VENDOR_XFER_QUEUE  2
+  #endif
+
+  //------------- NETWORK CLASS -------------//
+  // RNDIS, CDC-ECM and CDC-NCM interfaces across all devices
+  #ifndef CFG_TUH_NET
+    #define CFG_TUH_NET  0
+  #endif
+
+  // Bulk IN transfers kept armed per network interface, application may hold frames of all of them
+  #ifndef CFG_TUH_NET_RX_BUFS
+    #define CFG_TUH_NET_RX_BUFS  2
+  #endif
+
+  // Size of each, also NCM NTB input size and RNDIS max transfer size. Multiple of endpoint size
+  #ifndef CFG_TUH_NET_RX_BUFSIZE
+    #define CFG_TUH_NET_RX_BUFSIZE  2048
+  #endif
+
+  // Transmit buffer of a frame with its RNDIS or NCM header
+  #ifndef CFG_TUH_NET_TX_BUFSIZE
+    #define CFG_TUH_NET_TX_BUFSIZE  1600
+  #endif
+
+  //------------- MIDI CLASS -------------//
+  // MIDI streaming interfaces across all devices
+  #ifndef CFG_TUH_MIDI
+    #define CFG_TUH_MIDI  0
+  #endif
+
+  // Bulk IN transfers kept armed per MIDI interface so that the pipe keeps receiving while one is processed
+  #ifndef CFG_TUH_MIDI_RX_BUFS
+    #define CFG_TUH_MIDI_RX_BUFS  2
+  #endif
+
+  // Size of each transfer buffer, IN and OUT. Multiple of 64 (full speed bulk endpoint size)
+  #ifndef CFG_TUH_MIDI_EP_BUFSIZE
+    #define CFG_TUH_MIDI_EP_BUFSIZE  64
+  #endif
+
+  // Cables with their own RX FIFO of CFG_TUH_MIDI_RX_BUFSIZE, packets of higher cables are dropped.
+  // With 1, all cables share the same FIFO
+  #ifndef CFG_TUH_MIDI_CABLES
+    #define CFG_TUH_MIDI_CABLES  1
+  #endif
+
+  #ifndef CFG_TUH_MIDI_RX_BUFSIZE
+    #define CFG_TUH_MIDI_RX_BUFSIZE  256
+  #endif
+
+  #ifndef CFG_TUH_MIDI_TX_BUFSIZE
+    #define CFG_TUH_MIDI_TX_BUFSIZE  128
+  #endif
+
+  //------------- AUDIO CLASS -------------//
+  // Audio functions (control interface and its streaming interfaces) across all devices
+  #ifndef CFG_TUH_AUDIO
+    #define CFG_TUH_AUDIO  0
+  #endif
+
+  // Streaming interfaces per function and alternate settings recorded per streaming interface, others are ignored
+  #ifndef CFG_TUH_AUDIO_STREAM_MAX
+    #define CFG_TUH_AUDIO_STREAM_MAX  2
+  #endif
+
+  #ifndef CFG_TUH_AUDIO_ALT_MAX
+    #define CFG_TUH_AUDIO_ALT_MAX  4
+  #endif
+
+  // Discrete sampling rates recorded per alternate setting (UAC1 format descriptor), at least 2 for a range
+  #ifndef CFG_TUH_AUDIO_RATE_MAX
+    #define CFG_TUH_AUDIO_RATE_MAX  4
+  #endif
+
+  // Packets per isochronous transfer, two transfers are kept queued per streaming interface
+  #ifndef CFG_TUH_AUDIO_XFER_PACKETS
+    #define CFG_TUH_AUDIO_XFER_PACKETS  8
+  #endif
+
+  // Packet buffer size, alternate settings needing larger packets are not selected.
+  // Default fits 48 kHz stereo 16-bit at full speed with one extra sample
+  #ifndef CFG_TUH_AUDIO_EP_SZ
+    #define CFG_TUH_AUDIO_EP_SZ  196
+  #endif
+
+  // Sample FIFO between application and endpoint of each streaming interface
+  #ifndef CFG_TUH_AUDIO_FIFO_SIZE
+    #define CFG_TUH_AUDIO_FIFO_SIZE  1024
+  #endif
+
+  //------------- ISOCHRONOUS -------------//
+  // Isochronous endpoints across all devices, opened by application with tuh_iso_edpt_open() and by audio
+  // driver (one per started stream, two with feedback endpoint)
+  #ifndef CFG_TUH_ISO_EP
+    #define CFG_TUH_ISO_EP  0
+  #endif
+
   //------------- CLASS -------------//
 #endif // TUSB_OPT_HOST_ENABLED
 
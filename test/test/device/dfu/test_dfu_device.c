@@ -0,0 +1,333 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+
+#include "unity.h"
+
+// Files to test
+#include "tusb_fifo.h"
+#include "tusb.h"
+#include "usbd.h"
+TEST_FILE("usbd_control.c")
+TEST_FILE("dfu_device.c")
+
+// Mock File
+#include "mock_dcd.h"
+#include "mock_msc_device.h"
+#include "mock_uas_device.h"
+
+//--------------------------------------------------------------------+
+// MACRO TYPEDEF CONSTANT ENUM DECLARATION
+//--------------------------------------------------------------------+
+
+enum
+{
+  EDPT_CTRL_OUT = 0x00,
+  EDPT_CTRL_IN  = 0x80
+};
+
+uint8_t const rhport = 0;
+
+enum
+{
+  ITF_NUM_DFU,
+  ITF_NUM_TOTAL
+};
+
+enum
+{
+  BLOCK_SIZE = 128,
+  POLL_TIMEOUT = 5
+};
+
+#define CONFIG_TOTAL_LEN    (TUD_CONFIG_DESC_LEN + TUD_DFU_DESC_LEN(2))
+
+uint8_t const data_desc_configuration[] =
+{
+  // Interface count, string index, total length, attribute, power in mA
+  TUD_CONFIG_DESCRIPTOR(ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
+
+  // Interface number, alternate setting, string index
+  TUD_DFU_ALT_DESCRIPTOR(ITF_NUM_DFU, 0, 0),
+  TUD_DFU_ALT_DESCRIPTOR(ITF_NUM_DFU, 1, 0),
+
+  // Attributes, detach timeout, transfer size
+  TUD_DFU_FUNC_DESCRIPTOR(DFU_ATTR_CAN_DOWNLOAD | DFU_ATTR_MANIFESTATION_TOLERANT, 1000, BLOCK_SIZE),
+};
+
+tusb_control_request_t const request_set_configuration =
+{
+  .bmRequestType = 0x00,
+  .bRequest      = TUSB_REQ_SET_CONFIGURATION,
+  .wValue        = 1,
+  .wIndex        = 0,
+  .wLength       = 0
+};
+
+// blocks passed to application
+static uint16_t dnload_block[8];
+static uint8_t  dnload_count;
+static uint8_t  manifest_count;
+
+static uint8_t block_data[BLOCK_SIZE];
+
+void tud_dfu_download_cb(uint8_t alt, uint16_t block_num, uint8_t const* data, uint16_t length)
+{
+  TEST_ASSERT_EQUAL(0, alt);
+  TEST_ASSERT_EQUAL(BLOCK_SIZE, length);
+  TEST_ASSERT_EQUAL_MEMORY(block_data, data, length);
+
+  dnload_block[dnload_count++] = block_num;
+}
+
+void tud_dfu_manifest_cb(uint8_t alt)
+{
+  (void) alt;
+  manifest_count++;
+}
+
+uint32_t tud_dfu_get_timeout_cb(uint8_t alt, uint8_t state)
+{
+  (void) alt;
+  (void) state;
+  return POLL_TIMEOUT;
+}
+
+//--------------------------------------------------------------------+
+//
+//--------------------------------------------------------------------+
+uint8_t const * tud_descriptor_device_cb(void)
+{
+  return NULL;
+}
+
+uint8_t const * tud_descriptor_configuration_cb(uint8_t index)
+{
+  (void) index;
+  return data_desc_configuration;
+}
+
+uint16_t const* tud_descriptor_string_cb(uint8_t index)
+{
+  (void) index;
+  return NULL;
+}
+
+void setUp(void)
+{
+  dcd_int_disable_Ignore();
+  dcd_int_enable_Ignore();
+  mscd_init_Ignore();
+  mscd_reset_Ignore();
+  uasd_init_Ignore();
+  uasd_reset_Ignore();
+
+  if ( !tusb_inited() )
+  {
+    dcd_init_Expect(rhport);
+    tusb_init();
+  }
+
+  dcd_event_bus_signal(rhport, DCD_EVENT_BUS_RESET, false);
+  tud_task();
+
+  dnload_count   = 0;
+  manifest_count = 0;
+  for(uint16_t i=0; i<BLOCK_SIZE; i++) block_data[i] = (uint8_t) i;
+}
+
+void tearDown(void)
+{
+}
+
+//--------------------------------------------------------------------+
+// Helper
+//--------------------------------------------------------------------+
+static void expect_xfer(uint8_t ep_addr, uint16_t len)
+{
+  dcd_edpt_xfer_ExpectAndReturn(rhport, ep_addr, NULL, len, true);
+  dcd_edpt_xfer_IgnoreArg_buffer();
+}
+
+static void configure(void)
+{
+  dcd_event_setup_received(rhport, (uint8_t*) &request_set_configuration, false);
+  dcd_set_config_Expect(rhport, 1);
+  expect_xfer(EDPT_CTRL_IN, 0);
+  tud_task();
+}
+
+static void dnload(uint16_t block_num, uint16_t len)
+{
+  tusb_control_request_t const request =
+  {
+    .bmRequestType = 0x21,
+    .bRequest      = DFU_REQUEST_DNLOAD,
+    .wValue        = block_num,
+    .wIndex        = ITF_NUM_DFU,
+    .wLength       = len
+  };
+
+  dcd_event_setup_received(rhport, (uint8_t*) &request, false);
+
+  // data stage packet by packet
+  for(uint16_t i=0; i<len; i += CFG_TUD_ENDPOINT0_SIZE)
+  {
+    expect_xfer(EDPT_CTRL_OUT, CFG_TUD_ENDPOINT0_SIZE);
+    dcd_edpt_xfer_ReturnMemThruPtr_buffer(block_data + i, CFG_TUD_ENDPOINT0_SIZE);
+    dcd_event_xfer_complete(rhport, EDPT_CTRL_OUT, CFG_TUD_ENDPOINT0_SIZE, 0, false);
+  }
+
+  // status
+  expect_xfer(EDPT_CTRL_IN, 0);
+  tud_task();
+}
+
+static void get_status(uint8_t status, uint32_t timeout, uint8_t state)
+{
+  tusb_control_request_t const request =
+  {
+    .bmRequestType = 0xA1,
+    .bRequest      = DFU_REQUEST_GETSTATUS,
+    .wValue        = 0,
+    .wIndex        = ITF_NUM_DFU,
+    .wLength       = sizeof(dfu_status_response_t)
+  };
+
+  uint8_t const rsp[] = { status, U32_B4_U8(timeout), U32_B3_U8(timeout), U32_B2_U8(timeout), state, 0 };
+
+  dcd_event_setup_received(rhport, (uint8_t*) &request, false);
+
+  dcd_edpt_xfer_ExpectWithArrayAndReturn(rhport, EDPT_CTRL_IN, (uint8_t*) rsp, sizeof(rsp), sizeof(rsp), true);
+  dcd_event_xfer_complete(rhport, EDPT_CTRL_IN, sizeof(rsp), 0, false);
+
+  expect_xfer(EDPT_CTRL_OUT, 0);
+  tud_task();
+}
+
+static void class_request(uint8_t request_code)
+{
+  tusb_control_request_t const request =
+  {
+    .bmRequestType = 0x21,
+    .bRequest      = request_code,
+    .wValue        = 0,
+    .wIndex        = ITF_NUM_DFU,
+    .wLength       = 0
+  };
+
+  dcd_event_setup_received(rhport, (uint8_t*) &request, false);
+}
+
+static void finish(uint8_t status)
+{
+  TEST_ASSERT_TRUE(tud_dfu_finish_flashing(status, false));
+  tud_task();
+}
+
+//--------------------------------------------------------------------+
+//
+//--------------------------------------------------------------------+
+void test_dfu_dnload_pipelined(void)
+{
+  configure();
+
+  // block 0 is programmed, host can send next one right away
+  dnload(0, BLOCK_SIZE);
+  TEST_ASSERT_EQUAL(1, dnload_count);
+  get_status(DFU_STATUS_OK, 0, DFU_STATE_DFU_DNLOAD_IDLE);
+
+  // block 1 is buffered, host must wait since no buffer is free
+  dnload(1, BLOCK_SIZE);
+  TEST_ASSERT_EQUAL(1, dnload_count);
+  get_status(DFU_STATUS_OK, POLL_TIMEOUT, DFU_STATE_DFU_DNBUSY);
+
+  // block 0 done, block 1 is passed to application
+  finish(DFU_STATUS_OK);
+  TEST_ASSERT_EQUAL(2, dnload_count);
+  TEST_ASSERT_EQUAL(1, dnload_block[1]);
+  get_status(DFU_STATUS_OK, 0, DFU_STATE_DFU_DNLOAD_IDLE);
+
+  // end of download while block 1 is still programmed
+  class_request(DFU_REQUEST_DNLOAD);
+  expect_xfer(EDPT_CTRL_IN, 0);
+  tud_task();
+  get_status(DFU_STATUS_OK, POLL_TIMEOUT, DFU_STATE_DFU_MANIFEST);
+  TEST_ASSERT_EQUAL(0, manifest_count);
+
+  finish(DFU_STATUS_OK);
+  TEST_ASSERT_EQUAL(1, manifest_count);
+  get_status(DFU_STATUS_OK, POLL_TIMEOUT, DFU_STATE_DFU_MANIFEST);
+
+  // manifestation tolerant device returns to idle
+  finish(DFU_STATUS_OK);
+  get_status(DFU_STATUS_OK, 0, DFU_STATE_DFU_IDLE);
+}
+
+void test_dfu_program_error(void)
+{
+  configure();
+
+  dnload(0, BLOCK_SIZE);
+  get_status(DFU_STATUS_OK, 0, DFU_STATE_DFU_DNLOAD_IDLE);
+  dnload(1, BLOCK_SIZE);
+
+  // queued block 1 is dropped
+  finish(DFU_STATUS_ERR_PROG);
+  TEST_ASSERT_EQUAL(1, dnload_count);
+  get_status(DFU_STATUS_ERR_PROG, 0, DFU_STATE_DFU_ERROR);
+
+  // further download is refused until status is cleared
+  tusb_control_request_t const request =
+  {
+    .bmRequestType = 0x21,
+    .bRequest      = DFU_REQUEST_DNLOAD,
+    .wValue        = 2,
+    .wIndex        = ITF_NUM_DFU,
+    .wLength       = BLOCK_SIZE
+  };
+  dcd_event_setup_received(rhport, (uint8_t*) &request, false);
+  dcd_edpt_stall_Expect(rhport, EDPT_CTRL_OUT);
+  dcd_edpt_stall_Expect(rhport, EDPT_CTRL_IN);
+  tud_task();
+
+  class_request(DFU_REQUEST_CLRSTATUS);
+  expect_xfer(EDPT_CTRL_IN, 0);
+  tud_task();
+  get_status(DFU_STATUS_OK, 0, DFU_STATE_DFU_IDLE);
+}
+
+void test_dfu_zero_length_dnload_in_idle(void)
+{
+  configure();
+
+  class_request(DFU_REQUEST_DNLOAD);
+  dcd_edpt_stall_Expect(rhport, EDPT_CTRL_OUT);
+  dcd_edpt_stall_Expect(rhport, EDPT_CTRL_IN);
+  tud_task();
+
+  get_status(DFU_STATUS_ERR_STALLEDPKT, 0, DFU_STATE_DFU_ERROR);
+}
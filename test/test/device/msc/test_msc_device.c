@@ -33,9 +33,11 @@
 #include "usbd.h"
 TEST_FILE("usbd_control.c")
 TEST_FILE("msc_device.c")
+TEST_FILE("uas_device.c")
 
 // Mock File
 #include "mock_dcd.h"
+#include "mock_dfu_device.h"
 
 //--------------------------------------------------------------------+
 // MACRO TYPEDEF CONSTANT ENUM DECLARATION
@@ -193,6 +195,8 @@ void setUp(void)
 {
   dcd_int_disable_Ignore();
   dcd_int_enable_Ignore();
+  dfud_init_Ignore();
+  dfud_reset_Ignore();
 
   if ( !tusb_inited() )
   {
@@ -271,3 +275,49 @@ void test_msc(void)
 
   tud_task();
 }
+
+// Next CBW is armed together with CSW, its completion may be reported before the CSW one
+void test_msc_cbw_before_csw(void)
+{
+  msc_cbw_t cbw_tur[2] =
+  {
+    { .signature = MSC_CBW_SIGNATURE, .tag = 1, .cmd_len = 6, .command = { SCSI_CMD_TEST_UNIT_READY } },
+    { .signature = MSC_CBW_SIGNATURE, .tag = 2, .cmd_len = 6, .command = { SCSI_CMD_TEST_UNIT_READY } },
+  };
+
+  desc_configuration = data_desc_configuration;
+  uint8_t const* desc_ep = tu_desc_next(tu_desc_next(desc_configuration));
+
+  dcd_event_setup_received(rhport, (uint8_t*) &request_set_configuration, false);
+
+  dcd_set_config_Expect(rhport, 1);
+  dcd_edpt_open_ExpectAndReturn(rhport, (tusb_desc_endpoint_t const *) desc_ep, true);
+  dcd_edpt_open_ExpectAndReturn(rhport, (tusb_desc_endpoint_t const *) tu_desc_next(desc_ep), true);
+
+  dcd_edpt_xfer_ExpectAndReturn(rhport, EDPT_MSC_OUT, NULL, sizeof(msc_cbw_t), true);
+  dcd_edpt_xfer_IgnoreArg_buffer();
+  dcd_edpt_xfer_ReturnMemThruPtr_buffer( (uint8_t*) &cbw_tur[0], sizeof(msc_cbw_t));
+  dcd_event_xfer_complete(rhport, EDPT_MSC_OUT, sizeof(msc_cbw_t), 0, true);
+
+  // control status
+  dcd_edpt_xfer_ExpectAndReturn(rhport, EDPT_CTRL_IN, NULL, 0, true);
+
+  // no data: CSW of 1st command and next CBW at once
+  dcd_edpt_xfer_ExpectAndReturn(rhport, EDPT_MSC_IN, NULL, 13, true);
+  dcd_edpt_xfer_IgnoreArg_buffer();
+  dcd_edpt_xfer_ExpectAndReturn(rhport, EDPT_MSC_OUT, NULL, sizeof(msc_cbw_t), true);
+  dcd_edpt_xfer_IgnoreArg_buffer();
+  dcd_edpt_xfer_ReturnMemThruPtr_buffer( (uint8_t*) &cbw_tur[1], sizeof(msc_cbw_t));
+
+  // 2nd CBW is reported first
+  dcd_event_xfer_complete(rhport, EDPT_MSC_OUT, sizeof(msc_cbw_t), 0, true);
+  dcd_event_xfer_complete(rhport, EDPT_MSC_IN, 13, 0, true);
+
+  // 2nd command is processed once CSW completes
+  dcd_edpt_xfer_ExpectAndReturn(rhport, EDPT_MSC_IN, NULL, 13, true);
+  dcd_edpt_xfer_IgnoreArg_buffer();
+  dcd_edpt_xfer_ExpectAndReturn(rhport, EDPT_MSC_OUT, NULL, sizeof(msc_cbw_t), true);
+  dcd_edpt_xfer_IgnoreArg_buffer();
+
+  tud_task();
+}
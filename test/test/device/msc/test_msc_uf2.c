@@ -0,0 +1,230 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019, hathach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#include <string.h>
+#include "unity.h"
+
+// Files to test
+#include "msc_uf2.h"
+
+// Volume of project.yml defines: 16384 sectors, 2 FATs of 64 sectors, 4 root directory sectors
+enum
+{
+  ROOT_LBA    = 1 + 2*64,
+  DATA_LBA    = ROOT_LBA + 4,
+  FLASH_BASE  = 0x1000,
+  FLASH_SIZE  = 0x1000,
+  FAMILY_ID   = 0xADA52840,
+};
+
+static uint8_t sector[2][512];
+
+static uint32_t flash_write_count;
+static uint32_t flash_write_addr;
+static uint32_t flash_write_len;
+static int32_t  flash_write_ret;
+static uint32_t complete_count;
+static int32_t  async_nbytes;
+
+int32_t tud_msc_uf2_flash_write_cb(uint32_t addr, uint8_t const* data, uint32_t len)
+{
+  (void) data;
+
+  flash_write_count++;
+  flash_write_addr = addr;
+  flash_write_len  = len;
+  return flash_write_ret ? flash_write_ret : (int32_t) len;
+}
+
+void tud_msc_uf2_flash_read_cb(uint32_t addr, uint8_t* data, uint32_t len)
+{
+  memset(data, (uint8_t) (addr >> 8), len);
+}
+
+void tud_msc_uf2_complete_cb(uint32_t block_count)
+{
+  (void) block_count;
+  complete_count++;
+}
+
+bool tud_msc_async_io_done(uint8_t lun, int32_t nbytes, bool in_isr)
+{
+  (void) lun;
+  (void) in_isr;
+  async_nbytes = nbytes;
+  return true;
+}
+
+static uint32_t get_u32(uint8_t const* p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint16_t get_u16(uint8_t const* p)
+{
+  return (uint16_t) (p[0] | (p[1] << 8));
+}
+
+static void uf2_block(uint8_t* buf, uint32_t addr, uint32_t block_no, uint32_t num_blocks, uint32_t flags, uint32_t family)
+{
+  uint32_t const words[8] = { 0x0A324655, 0x9E5D5157, flags, addr, 256, block_no, num_blocks, family };
+
+  memset(buf, 0, 512);
+  for(uint8_t i=0; i<8; i++)
+  {
+    buf[4*i+0] = (uint8_t) words[i];
+    buf[4*i+1] = (uint8_t) (words[i] >> 8);
+    buf[4*i+2] = (uint8_t) (words[i] >> 16);
+    buf[4*i+3] = (uint8_t) (words[i] >> 24);
+  }
+  buf[508] = 0x30; buf[509] = 0x6F; buf[510] = 0xB1; buf[511] = 0x0A;
+}
+
+void setUp(void)
+{
+  flash_write_count = 0;
+  flash_write_ret   = 0;
+  complete_count    = 0;
+  async_nbytes      = 0;
+}
+
+void tearDown(void)
+{
+}
+
+void test_boot_sector(void)
+{
+  tud_msc_lba_t count;
+  uint16_t size;
+  tud_msc_uf2_capacity(&count, &size);
+  TEST_ASSERT_EQUAL(16384, count);
+  TEST_ASSERT_EQUAL(512, size);
+
+  TEST_ASSERT_EQUAL(512, tud_msc_uf2_read10(0, 0, sector[0], 512));
+  TEST_ASSERT_EQUAL(512, get_u16(&sector[0][11]));
+  TEST_ASSERT_EQUAL(64, get_u16(&sector[0][22]));
+  TEST_ASSERT_EQUAL_MEMORY("UF2BOOT    ", &sector[0][43], 11);
+  TEST_ASSERT_EQUAL_MEMORY("FAT16   ", &sector[0][54], 8);
+  TEST_ASSERT_EQUAL_HEX8(0x55, sector[0][510]);
+  TEST_ASSERT_EQUAL_HEX8(0xAA, sector[0][511]);
+}
+
+void test_directory_and_fat(void)
+{
+  // root directory: volume label, INFO_UF2.TXT at cluster 2, CURRENT.UF2 of 2 sectors per 256 bytes
+  TEST_ASSERT_EQUAL(512, tud_msc_uf2_read10(ROOT_LBA, 0, sector[0], 512));
+  TEST_ASSERT_EQUAL_HEX8(0x08, sector[0][11]);
+  TEST_ASSERT_EQUAL_MEMORY("INFO_UF2TXT", &sector[0][32], 11);
+  TEST_ASSERT_EQUAL(2, get_u16(&sector[0][32+26]));
+  TEST_ASSERT_EQUAL_MEMORY("CURRENT UF2", &sector[0][64], 11);
+  TEST_ASSERT_EQUAL(3, get_u16(&sector[0][64+26]));
+  TEST_ASSERT_EQUAL(2*FLASH_SIZE, get_u32(&sector[0][64+28]));
+
+  // both FATs: INFO_UF2.TXT is one cluster, CURRENT.UF2 is a chain of 16
+  for(uint32_t lba = 1; lba < ROOT_LBA; lba += 64)
+  {
+    TEST_ASSERT_EQUAL(512, tud_msc_uf2_read10(lba, 0, sector[0], 512));
+    TEST_ASSERT_EQUAL_HEX16(0xFFF8, get_u16(&sector[0][0]));
+    TEST_ASSERT_EQUAL_HEX16(0xFFFF, get_u16(&sector[0][2]));
+    TEST_ASSERT_EQUAL_HEX16(0xFFFF, get_u16(&sector[0][4]));
+    TEST_ASSERT_EQUAL_HEX16(4, get_u16(&sector[0][6]));
+    TEST_ASSERT_EQUAL_HEX16(0xFFFF, get_u16(&sector[0][2*18]));
+    TEST_ASSERT_EQUAL_HEX16(0, get_u16(&sector[0][2*19]));
+  }
+}
+
+void test_read_files(void)
+{
+  // offset continues from lba
+  TEST_ASSERT_EQUAL(1024, tud_msc_uf2_read10(DATA_LBA, 0, sector, 1024));
+  TEST_ASSERT_EQUAL_MEMORY("TinyUSB UF2", sector[0], 11);
+
+  // second block of CURRENT.UF2
+  uint8_t const* block = sector[1];
+  TEST_ASSERT_EQUAL_HEX32(0x0A324655, get_u32(block));
+  TEST_ASSERT_EQUAL_HEX32(0x2000, get_u32(block+8));
+  TEST_ASSERT_EQUAL_HEX32(FLASH_BASE, get_u32(block+12));
+  TEST_ASSERT_EQUAL(256, get_u32(block+16));
+  TEST_ASSERT_EQUAL(0, get_u32(block+20));
+  TEST_ASSERT_EQUAL(FLASH_SIZE/256, get_u32(block+24));
+  TEST_ASSERT_EQUAL_HEX32(FAMILY_ID, get_u32(block+28));
+  TEST_ASSERT_EQUAL_HEX8(0x10, block[32]);
+
+  TEST_ASSERT_EQUAL(512, tud_msc_uf2_read10(DATA_LBA, 3*512, sector[0], 512));
+  TEST_ASSERT_EQUAL_HEX32(FLASH_BASE + 2*256, get_u32(sector[0]+12));
+}
+
+void test_write_blocks(void)
+{
+  // other sectors e.g FAT update are ignored
+  memset(sector[0], 0xAA, 512);
+  uf2_block(sector[1], FLASH_BASE + 256, 1, 2, 0x2000, FAMILY_ID);
+  TEST_ASSERT_EQUAL(1024, tud_msc_uf2_write10(0, DATA_LBA + 40, 0, (uint8_t*) sector, 1024));
+  TEST_ASSERT_EQUAL(1, flash_write_count);
+  TEST_ASSERT_EQUAL_HEX32(FLASH_BASE + 256, flash_write_addr);
+  TEST_ASSERT_EQUAL(256, flash_write_len);
+  TEST_ASSERT_EQUAL(0, complete_count);
+
+  // same block again is not counted twice
+  TEST_ASSERT_EQUAL(1024, tud_msc_uf2_write10(0, DATA_LBA + 40, 0, (uint8_t*) sector, 1024));
+  TEST_ASSERT_EQUAL(0, complete_count);
+
+  // other family, outside of flash and not main flash are skipped
+  uf2_block(sector[0], FLASH_BASE, 0, 2, 0x2000, 0x12345678);
+  uf2_block(sector[1], FLASH_BASE + FLASH_SIZE, 0, 2, 0, 0);
+  TEST_ASSERT_EQUAL(1024, tud_msc_uf2_write10(0, DATA_LBA + 41, 0, (uint8_t*) sector, 1024));
+  uf2_block(sector[0], FLASH_BASE, 0, 2, 0x0001, 0);
+  TEST_ASSERT_EQUAL(512, tud_msc_uf2_write10(0, DATA_LBA + 41, 0, sector[0], 512));
+  TEST_ASSERT_EQUAL(2, flash_write_count);
+
+  // last block of file, without familyID
+  uf2_block(sector[0], FLASH_BASE, 0, 2, 0, 0);
+  TEST_ASSERT_EQUAL(512, tud_msc_uf2_write10(0, DATA_LBA + 42, 0, sector[0], 512));
+  TEST_ASSERT_EQUAL(3, flash_write_count);
+  TEST_ASSERT_EQUAL(1, complete_count);
+}
+
+void test_write_busy_async(void)
+{
+  uf2_block(sector[0], FLASH_BASE, 0, 3, 0, 0);
+  uf2_block(sector[1], FLASH_BASE + 256, 1, 3, 0, 0);
+
+  // first blocks are programmed, last one in background
+  TEST_ASSERT_EQUAL(1024, tud_msc_uf2_write10(0, DATA_LBA, 0, (uint8_t*) sector, 1024));
+
+  uf2_block(sector[0], FLASH_BASE + 512, 2, 3, 0, 0);
+  flash_write_ret = TUD_MSC_RET_ASYNC;
+  TEST_ASSERT_EQUAL(TUD_MSC_RET_ASYNC, tud_msc_uf2_write10(1, DATA_LBA + 2, 0, (uint8_t*) sector, 1024));
+  TEST_ASSERT_EQUAL(0, complete_count);
+
+  // no other write until done
+  TEST_ASSERT_EQUAL(0, tud_msc_uf2_write10(1, DATA_LBA + 3, 512, sector[1], 512));
+
+  TEST_ASSERT_TRUE(tud_msc_uf2_flash_write_done(true, false));
+  TEST_ASSERT_EQUAL(512, async_nbytes);
+  TEST_ASSERT_EQUAL(1, complete_count);
+  TEST_ASSERT_FALSE(tud_msc_uf2_flash_write_done(true, false));
+}
@@ -0,0 +1,311 @@
+/* 
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019, hathach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+
+#include "unity.h"
+
+// Files to test
+#include "tusb_fifo.h"
+#include "tusb.h"
+#include "usbd.h"
+TEST_FILE("usbd_control.c")
+TEST_FILE("msc_device.c")
+TEST_FILE("uas_device.c")
+
+// Mock File
+#include "mock_dcd.h"
+#include "mock_dfu_device.h"
+
+//--------------------------------------------------------------------+
+// MACRO TYPEDEF CONSTANT ENUM DECLARATION
+//--------------------------------------------------------------------+
+
+enum
+{
+  EDPT_CTRL_OUT  = 0x00,
+  EDPT_CTRL_IN   = 0x80,
+
+  EDPT_UAS_CMD   = 0x01,
+  EDPT_UAS_STAT  = 0x82,
+  EDPT_UAS_IN    = 0x83,
+  EDPT_UAS_OUT   = 0x04,
+};
+
+uint8_t const rhport = 0;
+
+enum
+{
+  ITF_NUM_UAS,
+  ITF_NUM_TOTAL
+};
+
+#define CONFIG_TOTAL_LEN    (TUD_CONFIG_DESC_LEN + TUD_UAS_DESC_LEN)
+
+uint8_t const data_desc_configuration[] =
+{
+  // Interface count, string index, total length, attribute, power in mA
+  TUD_CONFIG_DESCRIPTOR(ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
+
+  // Interface number, string index, EP Command, Status, Data In, Data Out address, EP size
+  TUD_UAS_DESCRIPTOR(ITF_NUM_UAS, 0, EDPT_UAS_CMD, EDPT_UAS_STAT, EDPT_UAS_IN, EDPT_UAS_OUT, 64),
+};
+
+tusb_control_request_t const request_set_configuration =
+{
+  .bmRequestType = 0x00,
+  .bRequest      = TUSB_REQ_SET_CONFIGURATION,
+  .wValue        = 1,
+  .wIndex        = 0,
+  .wLength       = 0
+};
+
+enum
+{
+  DISK_BLOCK_NUM  = 16,
+  DISK_BLOCK_SIZE = 512
+};
+
+uint8_t msc_disk[DISK_BLOCK_NUM][DISK_BLOCK_SIZE];
+
+// number of times read10 reports not ready before reading
+static uint8_t read_busy_count;
+
+void tud_msc_inquiry_cb(uint8_t lun, uint8_t vendor_id[8], uint8_t product_id[16], uint8_t product_rev[4])
+{
+  (void) lun;
+  (void) vendor_id;
+  (void) product_id;
+  (void) product_rev;
+}
+
+bool tud_msc_test_unit_ready_cb(uint8_t lun)
+{
+  (void) lun;
+  return true;
+}
+
+void tud_msc_capacity_cb(uint8_t lun, uint32_t* block_count, uint16_t* block_size)
+{
+  (void) lun;
+
+  *block_count = DISK_BLOCK_NUM;
+  *block_size  = DISK_BLOCK_SIZE;
+}
+
+int32_t tud_msc_read10_cb(uint8_t lun, uint32_t lba, uint32_t offset, void* buffer, uint32_t bufsize)
+{
+  (void) lun;
+
+  if ( read_busy_count )
+  {
+    read_busy_count--;
+    return 0;
+  }
+
+  memcpy(buffer, msc_disk[lba] + offset, bufsize);
+  return bufsize;
+}
+
+int32_t tud_msc_write10_cb(uint8_t lun, uint32_t lba, uint32_t offset, uint8_t* buffer, uint32_t bufsize)
+{
+  (void) lun;
+
+  memcpy(msc_disk[lba] + offset, buffer, bufsize);
+  return bufsize;
+}
+
+int32_t tud_msc_scsi_cb (uint8_t lun, uint8_t const scsi_cmd[16], void* buffer, uint16_t bufsize)
+{
+  (void) lun;
+  (void) scsi_cmd;
+  (void) buffer;
+  (void) bufsize;
+
+  return -1;
+}
+
+//--------------------------------------------------------------------+
+//
+//--------------------------------------------------------------------+
+uint8_t const * tud_descriptor_device_cb(void)
+{
+  return NULL;
+}
+
+uint8_t const * tud_descriptor_configuration_cb(uint8_t index)
+{
+  (void) index;
+  return data_desc_configuration;
+}
+
+uint16_t const* tud_descriptor_string_cb(uint8_t index)
+{
+  (void) index;
+  return NULL;
+}
+
+void setUp(void)
+{
+  dcd_int_disable_Ignore();
+  dcd_int_enable_Ignore();
+  dfud_init_Ignore();
+  dfud_reset_Ignore();
+
+  if ( !tusb_inited() )
+  {
+    dcd_init_Expect(rhport);
+    tusb_init();
+  }
+
+  dcd_event_bus_signal(rhport, DCD_EVENT_BUS_RESET, false);
+  tud_task();
+
+  read_busy_count = 0;
+}
+
+void tearDown(void)
+{
+}
+
+//--------------------------------------------------------------------+
+// Helper
+//--------------------------------------------------------------------+
+static uas_cmd_iu_t cmd_iu(uint16_t tag, uint8_t const* cdb, uint8_t cdb_len)
+{
+  uas_cmd_iu_t iu =
+  {
+    .iu_id = UAS_IU_COMMAND,
+    .tag   = tu_htons(tag)
+  };
+
+  memcpy(iu.cdb, cdb, cdb_len);
+
+  return iu;
+}
+
+static void expect_xfer(uint8_t ep_addr, uint16_t len)
+{
+  dcd_edpt_xfer_ExpectAndReturn(rhport, ep_addr, NULL, len, true);
+  dcd_edpt_xfer_IgnoreArg_buffer();
+}
+
+// Set configuration, command pipe receives first IU
+static void configure(uas_cmd_iu_t const* first_iu)
+{
+  uint8_t const* desc_ep = tu_desc_next(tu_desc_next(data_desc_configuration));
+
+  dcd_event_setup_received(rhport, (uint8_t*) &request_set_configuration, false);
+  dcd_set_config_Expect(rhport, 1);
+
+  // open endpoints, each is followed by pipe usage descriptor
+  for(uint8_t i=0; i<4; i++)
+  {
+    dcd_edpt_open_ExpectAndReturn(rhport, (tusb_desc_endpoint_t const *) desc_ep, true);
+    desc_ep = tu_desc_next(tu_desc_next(desc_ep));
+  }
+
+  expect_xfer(EDPT_UAS_CMD, sizeof(uas_cmd_iu_t));
+  dcd_edpt_xfer_ReturnMemThruPtr_buffer((uint8_t*) first_iu, sizeof(uas_cmd_iu_t));
+
+  // control status
+  expect_xfer(EDPT_CTRL_IN, 0);
+}
+
+//--------------------------------------------------------------------+
+//
+//--------------------------------------------------------------------+
+void test_uas_read10(void)
+{
+  scsi_read10_t const cmd_read10 =
+  {
+    .cmd_code    = SCSI_CMD_READ_10,
+    .lba         = tu_htonl(0),
+    .block_count = tu_htons(1)
+  };
+
+  uas_cmd_iu_t const iu = cmd_iu(1, (uint8_t const*) &cmd_read10, sizeof(cmd_read10));
+
+  configure(&iu);
+  dcd_event_xfer_complete(rhport, EDPT_UAS_CMD, sizeof(uas_cmd_iu_t), 0, false);
+
+  // Read Ready, next command is accepted meanwhile
+  expect_xfer(EDPT_UAS_STAT, sizeof(uas_ready_iu_t));
+  expect_xfer(EDPT_UAS_CMD, sizeof(uas_cmd_iu_t));
+  dcd_event_xfer_complete(rhport, EDPT_UAS_STAT, sizeof(uas_ready_iu_t), 0, false);
+
+  // Data
+  expect_xfer(EDPT_UAS_IN, DISK_BLOCK_SIZE);
+  dcd_event_xfer_complete(rhport, EDPT_UAS_IN, DISK_BLOCK_SIZE, 0, false);
+
+  // Sense IU with good status has no sense data
+  expect_xfer(EDPT_UAS_STAT, 16);
+  dcd_event_xfer_complete(rhport, EDPT_UAS_STAT, 16, 0, false);
+
+  tud_task();
+}
+
+void test_uas_out_of_order(void)
+{
+  scsi_read10_t const cmd_read10 =
+  {
+    .cmd_code    = SCSI_CMD_READ_10,
+    .lba         = tu_htonl(0),
+    .block_count = tu_htons(1)
+  };
+
+  scsi_test_unit_ready_t const cmd_tur = { .cmd_code = SCSI_CMD_TEST_UNIT_READY };
+
+  uas_cmd_iu_t const iu_read = cmd_iu(1, (uint8_t const*) &cmd_read10, sizeof(cmd_read10));
+  uas_cmd_iu_t const iu_tur  = cmd_iu(2, (uint8_t const*) &cmd_tur, sizeof(cmd_tur));
+
+  // storage is busy when READ and TEST UNIT READY are received
+  read_busy_count = 2;
+
+  configure(&iu_read);
+  dcd_event_xfer_complete(rhport, EDPT_UAS_CMD, sizeof(uas_cmd_iu_t), 0, false);
+
+  // READ is not ready and waits, second command is received
+  expect_xfer(EDPT_UAS_CMD, sizeof(uas_cmd_iu_t));
+  dcd_edpt_xfer_ReturnMemThruPtr_buffer((uint8_t*) &iu_tur, sizeof(uas_cmd_iu_t));
+  dcd_event_xfer_complete(rhport, EDPT_UAS_CMD, sizeof(uas_cmd_iu_t), 0, false);
+
+  // TEST UNIT READY is completed first
+  expect_xfer(EDPT_UAS_STAT, 16);
+  expect_xfer(EDPT_UAS_CMD, sizeof(uas_cmd_iu_t));
+  dcd_event_xfer_complete(rhport, EDPT_UAS_STAT, 16, 0, false);
+
+  // then READ once storage is ready
+  expect_xfer(EDPT_UAS_STAT, sizeof(uas_ready_iu_t));
+  dcd_event_xfer_complete(rhport, EDPT_UAS_STAT, sizeof(uas_ready_iu_t), 0, false);
+
+  expect_xfer(EDPT_UAS_IN, DISK_BLOCK_SIZE);
+  dcd_event_xfer_complete(rhport, EDPT_UAS_IN, DISK_BLOCK_SIZE, 0, false);
+
+  expect_xfer(EDPT_UAS_STAT, 16);
+  dcd_event_xfer_complete(rhport, EDPT_UAS_STAT, 16, 0, false);
+
+  tud_task();
+}
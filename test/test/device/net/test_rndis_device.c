@@ -0,0 +1,316 @@
+/* 
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019, Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// RNDIS device driver on the virtual controller: control messages and packet messages sent by a
+// host that does not follow the specification must not be parsed beyond the received data.
+
+#include <string.h>
+#include "unity.h"
+
+// Files to test
+#include "tusb_fifo.h"
+#include "tusb.h"
+#include "usbd.h"
+#include "usbd_pvt.h"
+#include "rndis_device.h"
+#include "dcd_virtual.h"
+TEST_FILE("usbd_control.c")
+
+//--------------------------------------------------------------------+
+// MACRO TYPEDEF CONSTANT ENUM DECLARATION
+//--------------------------------------------------------------------+
+
+enum
+{
+  ITF_NUM_RNDIS = 0,
+  ITF_NUM_RNDIS_DATA,
+  ITF_NUM_TOTAL
+};
+
+enum
+{
+  EPNUM_RNDIS_NOTIF = 0x81,
+  EPNUM_RNDIS_OUT   = 0x02,
+  EPNUM_RNDIS_IN    = 0x82,
+};
+
+#define CONFIG_TOTAL_LEN    (TUD_CONFIG_DESC_LEN + TUD_RNDIS_DESC_LEN)
+
+// offset of oid buffer from request_id of a SET message
+#define SET_BUFFER_OFFSET   (sizeof(rndis_msg_set_t) - offsetof(rndis_msg_set_t, request_id))
+
+// offset of payload from data_offset of a packet message
+#define PACKET_DATA_OFFSET  (sizeof(rndis_msg_packet_t) - offsetof(rndis_msg_packet_t, data_offset))
+
+uint8_t const rhport = 0;
+
+tusb_desc_device_t const data_desc_device =
+{
+    .bLength            = sizeof(tusb_desc_device_t),
+    .bDescriptorType    = TUSB_DESC_DEVICE,
+    .bcdUSB             = 0x0200,
+
+    // Use Interface Association Descriptor (IAD) for RNDIS
+    .bDeviceClass       = TUSB_CLASS_MISC,
+    .bDeviceSubClass    = MISC_SUBCLASS_COMMON,
+    .bDeviceProtocol    = MISC_PROTOCOL_IAD,
+
+    .bMaxPacketSize0    = CFG_TUD_ENDPOINT0_SIZE,
+
+    .idVendor           = 0xCafe,
+    .idProduct          = 0xCafe,
+    .bcdDevice          = 0x0100,
+
+    .iManufacturer      = 0x00,
+    .iProduct           = 0x00,
+    .iSerialNumber      = 0x00,
+
+    .bNumConfigurations = 0x01
+};
+
+uint8_t const data_desc_configuration[] =
+{
+  // Interface count, string index, total length, attribute, power in mA
+  TUD_CONFIG_DESCRIPTOR(ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN, 0, 100),
+
+  // Interface number, string index, EP notification address and size, EP data address (out, in) and size.
+  TUD_RNDIS_DESCRIPTOR(ITF_NUM_RNDIS, 0, EPNUM_RNDIS_NOTIF, 8, EPNUM_RNDIS_OUT, EPNUM_RNDIS_IN, 64),
+};
+
+uint8_t const tud_network_mac_address[6] = { 0x02, 0x02, 0x84, 0x6A, 0x96, 0x00 };
+
+static uint32_t _recv_count;
+static uint16_t _recv_size;
+static uint32_t _request_id;
+
+//--------------------------------------------------------------------+
+//
+//--------------------------------------------------------------------+
+uint8_t const * tud_descriptor_device_cb(void)
+{
+  return (uint8_t const *) &data_desc_device;
+}
+
+uint8_t const * tud_descriptor_configuration_cb(uint8_t index)
+{
+  (void) index;
+  return data_desc_configuration;
+}
+
+uint16_t const* tud_descriptor_string_cb(uint8_t index)
+{
+  (void) index;
+  return NULL;
+}
+
+bool tud_network_recv_cb(uint8_t const* src, uint16_t size)
+{
+  (void) src;
+  _recv_count++;
+  _recv_size = size;
+  tud_network_recv_renew();
+  return true;
+}
+
+uint16_t tud_network_xmit_cb(uint8_t* dst, void* ref, uint16_t arg)
+{
+  (void) ref;
+  memset(dst, 0, arg);
+  return arg;
+}
+
+// Send message with SEND_ENCAPSULATED_COMMAND, then fetch its response (if any) into resp
+static uint16_t rndis_command(void const* msg, uint16_t len, uint32_t* resp, uint16_t resp_size)
+{
+  tusb_control_request_t const cmd =
+  {
+    .bmRequestType = 0x21,
+    .bRequest      = CDC_REQUEST_SEND_ENCAPSULATED_COMMAND,
+    .wValue        = 0,
+    .wIndex        = ITF_NUM_RNDIS,
+    .wLength       = len
+  };
+  TEST_ASSERT_TRUE( dcd_virtual_control_xfer(rhport, &cmd, (void*) msg, NULL) );
+
+  // response available notification
+  uint32_t notif[2];
+  dcd_virtual_read(rhport, EPNUM_RNDIS_NOTIF, notif, sizeof(notif));
+
+  tusb_control_request_t const get =
+  {
+    .bmRequestType = 0xA1,
+    .bRequest      = CDC_REQUEST_GET_ENCAPSULATED_RESPONSE,
+    .wValue        = 0,
+    .wIndex        = ITF_NUM_RNDIS,
+    .wLength       = resp_size
+  };
+  uint16_t xferred = 0;
+  TEST_ASSERT_TRUE( dcd_virtual_control_xfer(rhport, &get, resp, &xferred) );
+
+  return xferred;
+}
+
+static void rndis_initialize(uint32_t max_xfer_size)
+{
+  rndis_msg_initialize_t const msg =
+  {
+    .type          = RNDIS_MSG_INITIALIZE,
+    .length        = sizeof(rndis_msg_initialize_t),
+    .request_id    = ++_request_id,
+    .major_version = 1,
+    .minor_version = 0,
+    .max_xfer_size = max_xfer_size
+  };
+
+  uint32_t resp[CFG_TUD_RNDIS_CTRL_BUFSIZE/4];
+  TEST_ASSERT_EQUAL(sizeof(rndis_msg_initialize_cmplt_t), rndis_command(&msg, sizeof(msg), resp, sizeof(resp)));
+
+  rndis_msg_initialize_cmplt_t const* cmplt = (rndis_msg_initialize_cmplt_t const*) resp;
+  TEST_ASSERT_EQUAL_HEX32(RNDIS_MSG_INITIALIZE_CMPLT, cmplt->type);
+  TEST_ASSERT_EQUAL_HEX32(RNDIS_STATUS_SUCCESS, cmplt->status);
+}
+
+// SET packet filter with its buffer at buffer_offset, return status of completion
+static uint32_t rndis_set_filter(uint32_t filter, uint32_t buffer_offset, uint32_t buffer_length)
+{
+  uint32_t msg[(sizeof(rndis_msg_set_t) + 4)/4];
+  rndis_msg_set_t* set = (rndis_msg_set_t*) msg;
+
+  memset(msg, 0, sizeof(msg));
+  set->type          = RNDIS_MSG_SET;
+  set->length        = sizeof(msg);
+  set->request_id    = ++_request_id;
+  set->oid           = RNDIS_OID_GEN_CURRENT_PACKET_FILTER;
+  set->buffer_length = buffer_length;
+  set->buffer_offset = buffer_offset;
+  memcpy(set->oid_buffer, &filter, 4);
+
+  uint32_t resp[CFG_TUD_RNDIS_CTRL_BUFSIZE/4];
+  TEST_ASSERT_EQUAL(sizeof(rndis_msg_set_cmplt_t), rndis_command(msg, sizeof(msg), resp, sizeof(resp)));
+
+  rndis_msg_set_cmplt_t const* cmplt = (rndis_msg_set_cmplt_t const*) resp;
+  TEST_ASSERT_EQUAL_HEX32(RNDIS_MSG_SET_CMPLT, cmplt->type);
+  TEST_ASSERT_EQUAL(set->request_id, cmplt->request_id);
+
+  return cmplt->status;
+}
+
+// Send one packet message of msg_len bytes with the given header fields
+static void rndis_send_packet(uint32_t msg_len, uint32_t data_offset, uint32_t data_length)
+{
+  uint32_t msg[64/4];
+  rndis_msg_packet_t* packet = (rndis_msg_packet_t*) msg;
+
+  TEST_ASSERT_TRUE(msg_len <= sizeof(msg));
+  memset(msg, 0xAA, sizeof(msg));
+  memset(packet, 0, sizeof(rndis_msg_packet_t));
+  packet->type        = RNDIS_MSG_PACKET;
+  packet->length      = msg_len;
+  packet->data_offset = data_offset;
+  packet->data_length = data_length;
+
+  TEST_ASSERT_EQUAL(msg_len, dcd_virtual_write(rhport, EPNUM_RNDIS_OUT, msg, msg_len));
+}
+
+void setUp(void)
+{
+  if ( !tusb_inited() ) tusb_init();
+
+  uint8_t desc[CONFIG_TOTAL_LEN];
+  TEST_ASSERT_TRUE( dcd_virtual_enumerate(rhport, 1, desc, sizeof(desc)) );
+
+  rndis_initialize(CFG_TUD_RNDIS_IN_BUFSIZE);
+  TEST_ASSERT_EQUAL_HEX32(RNDIS_STATUS_SUCCESS, rndis_set_filter(0x0F, SET_BUFFER_OFFSET, 4));
+  TEST_ASSERT_TRUE( tud_network_link_up() );
+
+  _recv_count = 0;
+  _recv_size  = 0;
+}
+
+void tearDown(void)
+{
+}
+
+//--------------------------------------------------------------------+
+// Packet message
+//--------------------------------------------------------------------+
+void test_packet_valid(void)
+{
+  rndis_send_packet(sizeof(rndis_msg_packet_t) + 16, PACKET_DATA_OFFSET, 16);
+
+  TEST_ASSERT_EQUAL(1, _recv_count);
+  TEST_ASSERT_EQUAL(16, _recv_size);
+}
+
+// payload would start past the message, a large data_length must not pass as the remaining
+// length wraps around
+void test_packet_data_offset_beyond_length(void)
+{
+  uint32_t const msg_len = sizeof(rndis_msg_packet_t) + 4;
+  rndis_send_packet(msg_len, msg_len - 4, 0xFFFFFFF0UL);
+
+  TEST_ASSERT_EQUAL(0, _recv_count);
+
+  // next transfer is still received
+  rndis_send_packet(sizeof(rndis_msg_packet_t) + 4, PACKET_DATA_OFFSET, 4);
+  TEST_ASSERT_EQUAL(1, _recv_count);
+  TEST_ASSERT_EQUAL(4, _recv_size);
+}
+
+void test_packet_data_length_beyond_length(void)
+{
+  rndis_send_packet(sizeof(rndis_msg_packet_t) + 4, PACKET_DATA_OFFSET, 8);
+
+  TEST_ASSERT_EQUAL(0, _recv_count);
+}
+
+//--------------------------------------------------------------------+
+// Control message
+//--------------------------------------------------------------------+
+void test_set_buffer_offset_beyond_length(void)
+{
+  uint32_t const cmd_len = sizeof(rndis_msg_set_t) + 4;
+
+  // buffer would start 4 bytes past the message
+  TEST_ASSERT_EQUAL_HEX32(RNDIS_STATUS_INVALID_DATA, rndis_set_filter(0, cmd_len - 4, 4));
+  TEST_ASSERT_TRUE( tud_network_link_up() );
+
+  TEST_ASSERT_EQUAL_HEX32(RNDIS_STATUS_INVALID_DATA, rndis_set_filter(0, SET_BUFFER_OFFSET, 8));
+  TEST_ASSERT_TRUE( tud_network_link_up() );
+
+  TEST_ASSERT_EQUAL_HEX32(RNDIS_STATUS_SUCCESS, rndis_set_filter(0, SET_BUFFER_OFFSET, 4));
+  TEST_ASSERT_FALSE( tud_network_link_up() );
+}
+
+// host max transfer size that cannot hold a frame is ignored
+void test_initialize_max_xfer_too_small(void)
+{
+  rndis_initialize(0);
+  TEST_ASSERT_EQUAL_HEX32(RNDIS_STATUS_SUCCESS, rndis_set_filter(0x0F, SET_BUFFER_OFFSET, 4));
+  TEST_ASSERT_TRUE( tud_network_can_xmit(1514) );
+
+  rndis_initialize(64);
+  TEST_ASSERT_EQUAL_HEX32(RNDIS_STATUS_SUCCESS, rndis_set_filter(0x0F, SET_BUFFER_OFFSET, 4));
+  TEST_ASSERT_TRUE( tud_network_can_xmit(1514) );
+}
@@ -28,11 +28,14 @@
 #include "tusb_fifo.h"
 #include "tusb.h"
 #include "usbd.h"
+#include "usbd_pvt.h"
 TEST_FILE("usbd_control.c")
 
 // Mock File
 #include "mock_dcd.h"
 #include "mock_msc_device.h"
+#include "mock_uas_device.h"
+#include "mock_dfu_device.h"
 
 //--------------------------------------------------------------------+
 // MACRO TYPEDEF CONSTANT ENUM DECLARATION
@@ -124,6 +127,8 @@ void setUp(void)
   if ( !tusb_inited() )
   {
     mscd_init_Expect();
+    uasd_init_Expect();
+    dfud_init_Expect();
     dcd_init_Expect(rhport);
     tusb_init();
   }
@@ -165,6 +170,45 @@ void test_usbd_get_device_descriptor_null(void)
   tud_task();
 }
 
+void test_usbd_get_device_descriptor_pending(void)
+{
+  desc_device = TUD_DESC_PENDING;
+  dcd_event_setup_received(rhport, (uint8_t*) &req_get_desc_device, false);
+
+  // no data stage until replied
+  tud_task();
+  TEST_ASSERT_TRUE( tud_descriptor_reply(rhport, &data_desc_device, false) );
+
+  // data
+  dcd_edpt_xfer_ExpectWithArrayAndReturn(rhport, 0x80, (uint8_t*)&data_desc_device, sizeof(tusb_desc_device_t), sizeof(tusb_desc_device_t), true);
+  dcd_event_xfer_complete(rhport, EDPT_CTRL_IN, sizeof(tusb_desc_device_t), 0, false);
+
+  // status
+  dcd_edpt_xfer_ExpectAndReturn(rhport, EDPT_CTRL_OUT, NULL, 0, true);
+
+  tud_task();
+
+  TEST_ASSERT_FALSE( tud_descriptor_reply(rhport, &data_desc_device, false) );
+}
+
+void test_usbd_get_device_descriptor_pending_dropped(void)
+{
+  desc_device = TUD_DESC_PENDING;
+  dcd_event_setup_received(rhport, (uint8_t*) &req_get_desc_device, false);
+  tud_task();
+
+  // host retries after its timeout
+  desc_device = NULL;
+  dcd_event_setup_received(rhport, (uint8_t*) &req_get_desc_device, false);
+
+  dcd_edpt_stall_Expect(rhport, EDPT_CTRL_OUT);
+  dcd_edpt_stall_Expect(rhport, EDPT_CTRL_IN);
+
+  tud_task();
+
+  TEST_ASSERT_FALSE( tud_descriptor_reply(rhport, &data_desc_device, false) );
+}
+
 //------------- Configuration -------------//
 
 void test_usbd_get_configuration_descriptor(void)
@@ -234,3 +278,481 @@ void test_usbd_control_in_zlp(void)
 
   tud_task();
 }
+
+void test_usbd_dcd_caps(void)
+{
+  dcd_caps_t dcd_caps = { 0 };
+  dcd_caps.max_xfer_bytes = 4096;
+  dcd_caps.dma            = 1;
+
+  dcd_get_caps_Expect(rhport, NULL);
+  dcd_get_caps_IgnoreArg_caps();
+  dcd_get_caps_ReturnThruPtr_caps(&dcd_caps);
+
+  dcd_caps_t caps;
+  usbd_dcd_caps(rhport, &caps);
+
+  TEST_ASSERT_EQUAL(4096, caps.max_xfer_bytes);
+  TEST_ASSERT_TRUE(caps.dma);
+  TEST_ASSERT_FALSE(caps.multi_packet);
+
+  // filled by usbd since mock dcd implements both
+  TEST_ASSERT_TRUE(caps.xfer_append);
+  TEST_ASSERT_TRUE(caps.xfer_sg);
+}
+
+void test_usbd_frame_number(void)
+{
+  dcd_frame_number_ExpectAndReturn(rhport, 0x123);
+  TEST_ASSERT_EQUAL_HEX32(0x123, tud_frame_number());
+}
+
+//--------------------------------------------------------------------+
+// Alternate setting switched by usbd for driver having set_alt
+//--------------------------------------------------------------------+
+enum
+{
+  EDPT_ALT_IN = 0x81,
+  ALT_ITF_LEN = 9 + 9 + 7 + 9 + 7
+};
+
+uint8_t const data_desc_alt_configuration[] =
+{
+  TUD_CONFIG_DESCRIPTOR(1, 0, TUD_CONFIG_DESC_LEN + ALT_ITF_LEN, 0, 100),
+
+  // zero bandwidth default alternate
+  9, TUSB_DESC_INTERFACE, 0, 0, 0, TUSB_CLASS_VENDOR_SPECIFIC, 0, 0, 0,
+
+  // alternate 1 and 2 use the same endpoint with a larger packet
+  9, TUSB_DESC_INTERFACE, 0, 1, 1, TUSB_CLASS_VENDOR_SPECIFIC, 0, 0, 0,
+  7, TUSB_DESC_ENDPOINT, EDPT_ALT_IN, TUSB_XFER_INTERRUPT, U16_TO_U8S_LE(16), 1,
+
+  9, TUSB_DESC_INTERFACE, 0, 2, 1, TUSB_CLASS_VENDOR_SPECIFIC, 0, 0, 0,
+  7, TUSB_DESC_ENDPOINT, EDPT_ALT_IN, TUSB_XFER_INTERRUPT, U16_TO_U8S_LE(64), 1,
+};
+
+static uint8_t const* alt_desc(uint8_t alt)
+{
+  uint8_t const* p_desc = data_desc_alt_configuration + TUD_CONFIG_DESC_LEN + 9;
+  for(uint8_t i = 1; i < alt; i++) p_desc += 9 + 7;
+  return p_desc;
+}
+
+uint8_t  alt_set_count;
+uint8_t  alt_current;
+uint16_t alt_len;
+
+static bool alt_open(uint8_t rhport, tusb_desc_interface_t const * desc_intf, uint16_t* p_length, uint8_t* p_inst)
+{
+  (void) rhport;
+  (void) desc_intf;
+  (void) p_inst;
+
+  // all alternates, default one has no endpoint
+  *p_length = ALT_ITF_LEN;
+  return true;
+}
+
+static bool alt_set_alt(uint8_t rhport, tusb_desc_interface_t const * desc_itf, uint16_t desc_len)
+{
+  (void) rhport;
+
+  alt_set_count++;
+  alt_current = desc_itf->bAlternateSetting;
+  alt_len     = desc_len;
+  return true;
+}
+
+uint8_t alt_class_request_count;
+
+static bool alt_control_request(uint8_t rhport, tusb_control_request_t const * request)
+{
+  TU_VERIFY(TUSB_REQ_TYPE_CLASS == request->bmRequestType_bit.type);
+
+  alt_class_request_count++;
+  return tud_control_status(rhport, request);
+}
+
+uint8_t alt_reopen_count;
+
+static void alt_reopen(uint8_t rhport, uint8_t inst)
+{
+  (void) rhport;
+  (void) inst;
+  alt_reopen_count++;
+}
+
+static usbd_class_driver_t const _alt_driver =
+{
+  .class_code      = TUSB_CLASS_VENDOR_SPECIFIC,
+  .open            = alt_open,
+  .control_request = alt_control_request,
+  .set_alt         = alt_set_alt,
+  .reopen          = alt_reopen,
+};
+
+usbd_class_driver_t const* usbd_app_driver_get_cb(uint8_t* driver_count)
+{
+  *driver_count = 1;
+  return &_alt_driver;
+}
+
+static void alt_request(uint8_t bRequest, uint8_t alt)
+{
+  tusb_control_request_t const request =
+  {
+    .bmRequestType = (bRequest == TUSB_REQ_GET_INTERFACE) ? 0x81 : 0x01,
+    .bRequest      = bRequest,
+    .wValue        = alt,
+    .wIndex        = 0,
+    .wLength       = (bRequest == TUSB_REQ_GET_INTERFACE) ? 1 : 0
+  };
+
+  dcd_event_setup_received(rhport, (uint8_t const*) &request, false);
+}
+
+static void alt_set_interface(uint8_t alt)
+{
+  alt_request(TUSB_REQ_SET_INTERFACE, alt);
+  dcd_edpt_xfer_ExpectAndReturn(rhport, EDPT_CTRL_IN, NULL, 0, true);
+  tud_task();
+}
+
+tusb_control_request_t const req_set_config =
+{
+  .bmRequestType = 0x00,
+  .bRequest      = TUSB_REQ_SET_CONFIGURATION,
+  .wValue        = 1,
+  .wIndex        = 0,
+  .wLength       = 0
+};
+
+void test_usbd_set_interface_alt(void)
+{
+  mscd_reset_Ignore();
+  uasd_reset_Ignore();
+  dfud_reset_Ignore();
+  dcd_event_bus_signal(rhport, DCD_EVENT_BUS_RESET, false);
+  tud_task();
+
+  desc_configuration = data_desc_alt_configuration;
+  alt_set_count = 0;
+
+  dcd_event_setup_received(rhport, (uint8_t const*) &req_set_config, false);
+  dcd_set_config_Expect(rhport, 1);
+  dcd_edpt_xfer_ExpectAndReturn(rhport, EDPT_CTRL_IN, NULL, 0, true);
+  tud_task();
+
+  // alternate 1: nothing to close
+  dcd_edpt_open_ExpectAndReturn(rhport, (tusb_desc_endpoint_t const*) (alt_desc(1) + 9), true);
+  alt_set_interface(1);
+
+  TEST_ASSERT_EQUAL(1, alt_set_count);
+  TEST_ASSERT_EQUAL(1, alt_current);
+  TEST_ASSERT_EQUAL(9 + 7, alt_len);
+
+  // alternate 2: endpoint of alternate 1 is closed before being opened again
+  dcd_edpt_close_Expect(rhport, EDPT_ALT_IN);
+  dcd_edpt_open_ExpectAndReturn(rhport, (tusb_desc_endpoint_t const*) (alt_desc(2) + 9), true);
+  alt_set_interface(2);
+
+  TEST_ASSERT_EQUAL(2, alt_set_count);
+  TEST_ASSERT_EQUAL(2, alt_current);
+
+  // current alternate is answered by usbd
+  uint8_t const expected = 2;
+  alt_request(TUSB_REQ_GET_INTERFACE, 0);
+  dcd_edpt_xfer_ExpectWithArrayAndReturn(rhport, EDPT_CTRL_IN, (uint8_t*) &expected, 1, 1, true);
+  dcd_event_xfer_complete(rhport, EDPT_CTRL_IN, 1, 0, false);
+  dcd_edpt_xfer_ExpectAndReturn(rhport, EDPT_CTRL_OUT, NULL, 0, true);
+  tud_task();
+
+  // unknown alternate is stalled, current one is kept
+  alt_request(TUSB_REQ_SET_INTERFACE, 3);
+  dcd_edpt_stall_Expect(rhport, EDPT_CTRL_OUT);
+  dcd_edpt_stall_Expect(rhport, EDPT_CTRL_IN);
+  tud_task();
+
+  TEST_ASSERT_EQUAL(2, alt_set_count);
+
+  // back to zero bandwidth
+  dcd_edpt_close_Expect(rhport, EDPT_ALT_IN);
+  alt_set_interface(0);
+
+  TEST_ASSERT_EQUAL(3, alt_set_count);
+  TEST_ASSERT_EQUAL(0, alt_current);
+  TEST_ASSERT_EQUAL(9, alt_len);
+}
+
+// Class request to device (e.g Bluetooth HCI command) goes to driver of interface in wIndex
+void test_usbd_class_request_to_device(void)
+{
+  mscd_reset_Ignore();
+  uasd_reset_Ignore();
+  dfud_reset_Ignore();
+  dcd_event_bus_signal(rhport, DCD_EVENT_BUS_RESET, false);
+  tud_task();
+
+  desc_configuration = data_desc_alt_configuration;
+  alt_class_request_count = 0;
+
+  dcd_event_setup_received(rhport, (uint8_t const*) &req_set_config, false);
+  dcd_set_config_Expect(rhport, 1);
+  dcd_edpt_xfer_ExpectAndReturn(rhport, EDPT_CTRL_IN, NULL, 0, true);
+  tud_task();
+
+  tusb_control_request_t request =
+  {
+    .bmRequestType = 0x20,
+    .bRequest      = 0,
+    .wValue        = 0,
+    .wIndex        = 0,
+    .wLength       = 0
+  };
+
+  dcd_event_setup_received(rhport, (uint8_t const*) &request, false);
+  dcd_edpt_xfer_ExpectAndReturn(rhport, EDPT_CTRL_IN, NULL, 0, true);
+  tud_task();
+
+  TEST_ASSERT_EQUAL(1, alt_class_request_count);
+
+  // interface not in configuration is stalled
+  request.wIndex = 1;
+  dcd_event_setup_received(rhport, (uint8_t const*) &request, false);
+  dcd_edpt_stall_Expect(rhport, EDPT_CTRL_OUT);
+  dcd_edpt_stall_Expect(rhport, EDPT_CTRL_IN);
+  tud_task();
+
+  TEST_ASSERT_EQUAL(1, alt_class_request_count);
+}
+
+//--------------------------------------------------------------------+
+// Link Power Management (L1)
+//--------------------------------------------------------------------+
+uint8_t lpm_sleep_count;
+uint8_t lpm_resume_count;
+uint8_t lpm_besl;
+bool    lpm_remote_wakeup;
+
+void tud_lpm_sleep_cb(uint8_t besl, bool remote_wakeup_en)
+{
+  lpm_sleep_count++;
+  lpm_besl          = besl;
+  lpm_remote_wakeup = remote_wakeup_en;
+}
+
+void tud_lpm_resume_cb(void)
+{
+  lpm_resume_count++;
+}
+
+void test_usbd_lpm_sleep_resume(void)
+{
+  // connected by its first setup
+  test_usbd_get_device_descriptor();
+
+  dcd_event_lpm_sleep(rhport, 4, true, false);
+  tud_task();
+
+  TEST_ASSERT_EQUAL(1, lpm_sleep_count);
+  TEST_ASSERT_EQUAL(4, lpm_besl);
+  TEST_ASSERT_TRUE(lpm_remote_wakeup);
+  TEST_ASSERT_TRUE(tud_lpm_sleeping());
+
+  // remote wakeup allowed by LPM token without SET_FEATURE
+  dcd_remote_wakeup_Expect(rhport);
+  TEST_ASSERT_TRUE(tud_remote_wakeup());
+
+  dcd_event_bus_signal(rhport, DCD_EVENT_LPM_RESUME, false);
+  tud_task();
+
+  TEST_ASSERT_EQUAL(1, lpm_resume_count);
+  TEST_ASSERT_FALSE(tud_lpm_sleeping());
+
+  // resume without sleep is ignored
+  dcd_event_bus_signal(rhport, DCD_EVENT_LPM_RESUME, false);
+  tud_task();
+  TEST_ASSERT_EQUAL(1, lpm_resume_count);
+
+  // not allowed once awake
+  TEST_ASSERT_FALSE(tud_remote_wakeup());
+}
+
+//--------------------------------------------------------------------+
+// Configuration kept over bus reset (CFG_TUD_FAST_RESET)
+//--------------------------------------------------------------------+
+void test_usbd_fast_reset_same_config(void)
+{
+  // configured by test_usbd_set_interface_alt(), all its drivers have reopen: none is reset
+  alt_reopen_count = 0;
+  dcd_event_bus_signal(rhport, DCD_EVENT_BUS_RESET, false);
+  tud_task();
+  dcd_event_bus_signal(rhport, DCD_EVENT_BUS_RESET, false);
+  tud_task();
+
+  TEST_ASSERT_FALSE(tud_mounted());
+
+  // default alternate has no endpoint to reopen
+  dcd_event_setup_received(rhport, (uint8_t const*) &req_set_config, false);
+  dcd_set_config_Expect(rhport, 1);
+  dcd_edpt_xfer_ExpectAndReturn(rhport, EDPT_CTRL_IN, NULL, 0, true);
+  tud_task();
+
+  TEST_ASSERT_TRUE(tud_mounted());
+  TEST_ASSERT_EQUAL(1, alt_reopen_count);
+
+  // mapping is restored
+  alt_set_count = 0;
+  dcd_edpt_open_ExpectAndReturn(rhport, (tusb_desc_endpoint_t const*) (alt_desc(1) + 9), true);
+  alt_set_interface(1);
+
+  TEST_ASSERT_EQUAL(1, alt_set_count);
+  TEST_ASSERT_EQUAL(1, alt_current);
+}
+
+void test_usbd_fast_reset_unplugged(void)
+{
+  dcd_event_bus_signal(rhport, DCD_EVENT_BUS_RESET, false);
+  tud_task();
+
+  // kept configuration is dropped, drivers are reset
+  mscd_reset_Expect(rhport);
+  uasd_reset_Expect(rhport);
+  dfud_reset_Expect(rhport);
+  dcd_event_bus_signal(rhport, DCD_EVENT_UNPLUGGED, false);
+  tud_task();
+
+  // configured again by parsing descriptor
+  alt_reopen_count = 0;
+  dcd_event_setup_received(rhport, (uint8_t const*) &req_set_config, false);
+  dcd_set_config_Expect(rhport, 1);
+  dcd_edpt_xfer_ExpectAndReturn(rhport, EDPT_CTRL_IN, NULL, 0, true);
+  tud_task();
+
+  TEST_ASSERT_TRUE(tud_mounted());
+  TEST_ASSERT_EQUAL(0, alt_reopen_count);
+}
+
+//--------------------------------------------------------------------+
+// Configuration built at compile time (TUD_CONFIG_MAP)
+//--------------------------------------------------------------------+
+#define MAP_FUNCTIONS(X)  X(MSC, msc, 0, 64)
+
+TUD_CONFIG_ENUM(MAP_CONFIG, MAP_FUNCTIONS);
+
+uint8_t const data_desc_map_configuration[] =
+{
+  TUD_CONFIG_BUILD(MAP_CONFIG, MAP_FUNCTIONS, 0, 0, 100)
+};
+
+tud_config_map_t const data_config_map = TUD_CONFIG_MAP(MAP_FUNCTIONS);
+
+tud_config_map_t const* config_map;
+
+tud_config_map_t const* tud_descriptor_configuration_map_cb(uint8_t index)
+{
+  (void) index;
+  return config_map;
+}
+
+void test_usbd_config_map(void)
+{
+  TEST_ASSERT_EQUAL(0, ITF_NUM_msc);
+  TEST_ASSERT_EQUAL(1, EPNUM_msc);
+  TEST_ASSERT_EQUAL(1, MAP_CONFIG_ITF_TOTAL);
+  TEST_ASSERT_EQUAL(sizeof(data_desc_map_configuration), MAP_CONFIG_TOTAL_LEN);
+
+  // start from unconfigured state
+  mscd_reset_Ignore();
+  uasd_reset_Ignore();
+  dfud_reset_Ignore();
+  dcd_event_bus_signal(rhport, DCD_EVENT_UNPLUGGED, false);
+  tud_task();
+  dcd_event_bus_signal(rhport, DCD_EVENT_BUS_RESET, false);
+  tud_task();
+
+  desc_configuration = data_desc_map_configuration;
+  config_map = &data_config_map;
+
+  dcd_event_setup_received(rhport, (uint8_t const*) &req_set_config, false);
+  dcd_set_config_Expect(rhport, 1);
+
+  // MSC driver is opened directly, UAS sharing its class is not tried
+  uint16_t itf_len = TUD_MSC_DESC_LEN;
+  mscd_open_ExpectAndReturn(rhport, (tusb_desc_interface_t const*) (data_desc_map_configuration + TUD_CONFIG_DESC_LEN), NULL, NULL, true);
+  mscd_open_IgnoreArg_p_length();
+  mscd_open_IgnoreArg_p_inst();
+  mscd_open_ReturnThruPtr_p_length(&itf_len);
+
+  dcd_edpt_xfer_ExpectAndReturn(rhport, EDPT_CTRL_IN, NULL, 0, true);
+  tud_task();
+
+  TEST_ASSERT_TRUE(tud_mounted());
+
+  // both directions of its endpoint are routed to it
+  mscd_xfer_cb_ExpectAndReturn(rhport, 0x80 | EPNUM_msc, XFER_RESULT_SUCCESS, 13, true);
+  dcd_event_xfer_complete(rhport, 0x80 | EPNUM_msc, 13, XFER_RESULT_SUCCESS, false);
+  tud_task();
+
+  mscd_xfer_cb_ExpectAndReturn(rhport, EPNUM_msc, XFER_RESULT_SUCCESS, 31, true);
+  dcd_event_xfer_complete(rhport, EPNUM_msc, 31, XFER_RESULT_SUCCESS, false);
+  tud_task();
+
+  config_map = NULL;
+}
+
+//--------------------------------------------------------------------+
+// SOF requests
+//--------------------------------------------------------------------+
+void test_usbd_sof_enable(void)
+{
+  // SOF interrupt follows first request and last release only
+  dcd_sof_enable_Expect(rhport, true);
+  usbd_sof_enable(rhport, true);
+  usbd_sof_enable(rhport, true);
+
+  usbd_sof_enable(rhport, false);
+  dcd_sof_enable_Expect(rhport, false);
+  usbd_sof_enable(rhport, false);
+
+  // unbalanced release is ignored
+  usbd_sof_enable(rhport, false);
+
+  // requests are dropped by bus reset
+  dcd_sof_enable_Expect(rhport, true);
+  usbd_sof_enable(rhport, true);
+
+  mscd_reset_Ignore();
+  uasd_reset_Ignore();
+  dfud_reset_Ignore();
+  dcd_sof_enable_Expect(rhport, false);
+  dcd_event_bus_signal(rhport, DCD_EVENT_BUS_RESET, false);
+  tud_task();
+}
+
+//--------------------------------------------------------------------+
+// Budgeted task
+//--------------------------------------------------------------------+
+static uint8_t deferred_count;
+
+static void deferred_func(void* param)
+{
+  (void) param;
+  deferred_count++;
+}
+
+void test_usbd_task_budget(void)
+{
+  deferred_count = 0;
+  for (uint8_t i = 0; i < 3; i++) usbd_defer_func(deferred_func, NULL, false);
+
+  // budget exhausted, more may remain
+  TEST_ASSERT_TRUE(tud_task_budget(2, 0));
+  TEST_ASSERT_EQUAL(2, deferred_count);
+
+  // queue is drained
+  TEST_ASSERT_FALSE(tud_task_budget(2, 0));
+  TEST_ASSERT_EQUAL(3, deferred_count);
+
+  TEST_ASSERT_FALSE(tud_task_budget(0, 0));
+}
@@ -0,0 +1,423 @@
+/* 
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019, Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// End to end tests of device stack and class drivers on the virtual controller, driven by its scripted host.
+// Throughput of each loopback is printed as one line
+//   VDCD_BENCH,<class>,<bytes>,<transfers>,<events>,ns,<per byte x100>
+// so that it can be grepped from the test log and compared across releases.
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "unity.h"
+
+// Files to test
+#include "tusb_fifo.h"
+#include "tusb.h"
+#include "usbd.h"
+#include "usbd_pvt.h"
+#include "cdc_device.h"
+#include "vendor_device.h"
+#include "dcd_virtual.h"
+TEST_FILE("usbd_control.c")
+
+//--------------------------------------------------------------------+
+// MACRO TYPEDEF CONSTANT ENUM DECLARATION
+//--------------------------------------------------------------------+
+
+#define BENCH_BYTES   (64*1024UL)
+
+enum
+{
+  ITF_NUM_CDC = 0,
+  ITF_NUM_CDC_DATA,
+  ITF_NUM_VENDOR,
+  ITF_NUM_TOTAL
+};
+
+enum
+{
+  EPNUM_CDC_NOTIF   = 0x81,
+  EPNUM_CDC_OUT     = 0x02,
+  EPNUM_CDC_IN      = 0x82,
+  EPNUM_VENDOR_OUT  = 0x03,
+  EPNUM_VENDOR_IN   = 0x83,
+};
+
+#define CONFIG_TOTAL_LEN    (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN + TUD_VENDOR_DESC_LEN)
+
+uint8_t const rhport = 0;
+
+tusb_desc_device_t const data_desc_device =
+{
+    .bLength            = sizeof(tusb_desc_device_t),
+    .bDescriptorType    = TUSB_DESC_DEVICE,
+    .bcdUSB             = 0x0210, // BOS for WinUSB
+
+    // Use Interface Association Descriptor (IAD) for CDC
+    .bDeviceClass       = TUSB_CLASS_MISC,
+    .bDeviceSubClass    = MISC_SUBCLASS_COMMON,
+    .bDeviceProtocol    = MISC_PROTOCOL_IAD,
+
+    .bMaxPacketSize0    = CFG_TUD_ENDPOINT0_SIZE,
+
+    .idVendor           = 0xCafe,
+    .idProduct          = 0xCafe,
+    .bcdDevice          = 0x0100,
+
+    .iManufacturer      = 0x00,
+    .iProduct           = 0x00,
+    .iSerialNumber      = 0x00,
+
+    .bNumConfigurations = 0x01
+};
+
+uint8_t const data_desc_configuration[] =
+{
+  // Interface count, string index, total length, attribute, power in mA
+  TUD_CONFIG_DESCRIPTOR(ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
+
+  // Interface number, string index, EP notification address and size, EP data address (out, in) and size.
+  TUD_CDC_DESCRIPTOR(ITF_NUM_CDC, 0, EPNUM_CDC_NOTIF, 8, EPNUM_CDC_OUT, EPNUM_CDC_IN, 64),
+
+  // Interface number, string index, EP Out & IN address, EP size
+  TUD_VENDOR_DESCRIPTOR(ITF_NUM_VENDOR, 0, EPNUM_VENDOR_OUT, EPNUM_VENDOR_IN, 64),
+};
+
+static uint8_t _out_data[BENCH_BYTES];
+static uint8_t _in_data[BENCH_BYTES];
+
+//--------------------------------------------------------------------+
+//
+//--------------------------------------------------------------------+
+uint8_t const * tud_descriptor_device_cb(void)
+{
+  return (uint8_t const *) &data_desc_device;
+}
+
+uint8_t const * tud_descriptor_configuration_cb(uint8_t index)
+{
+  (void) index;
+  return data_desc_configuration;
+}
+
+uint16_t const* tud_descriptor_string_cb(uint8_t index)
+{
+  (void) index;
+  return NULL;
+}
+
+static inline uint32_t bench_timer_get(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t) (ts.tv_sec*1000000000ULL + ts.tv_nsec);
+}
+
+static uint32_t xfer_count(uint8_t ep_out, uint8_t ep_in)
+{
+  dcd_virtual_ep_stats_t out_stats, in_stats;
+  dcd_virtual_stats_get(rhport, ep_out, &out_stats);
+  dcd_virtual_stats_get(rhport, ep_in , &in_stats);
+
+  return out_stats.xfer_count + in_stats.xfer_count;
+}
+
+static void bench_print(char const* name, uint32_t bytes, uint32_t xfers, uint32_t elapsed)
+{
+  printf("VDCD_BENCH,%s,%lu,%lu,%lu,ns,%lu\n", name, (unsigned long) bytes, (unsigned long) xfers,
+         (unsigned long) dcd_virtual_event_count(rhport), (unsigned long) (((uint64_t) elapsed * 100) / bytes));
+}
+
+static void fill_pattern(void)
+{
+  for(uint32_t i=0; i<BENCH_BYTES; i++) _out_data[i] = (uint8_t) (i*7 + (i >> 8));
+  memset(_in_data, 0, sizeof(_in_data));
+}
+
+void setUp(void)
+{
+  if ( !tusb_inited() ) tusb_init();
+
+  uint8_t desc[CONFIG_TOTAL_LEN];
+  TEST_ASSERT_TRUE( dcd_virtual_enumerate(rhport, 1, desc, sizeof(desc)) );
+  TEST_ASSERT_EQUAL_MEMORY(data_desc_configuration, desc, sizeof(desc));
+
+  dcd_virtual_stats_reset(rhport);
+}
+
+void tearDown(void)
+{
+}
+
+//--------------------------------------------------------------------+
+// Enumeration
+//--------------------------------------------------------------------+
+void test_enumerate(void)
+{
+  TEST_ASSERT_TRUE( tud_mounted() );
+  TEST_ASSERT_EQUAL(1, dcd_virtual_address(rhport));
+  TEST_ASSERT_TRUE( tud_vendor_n_mounted(0) );
+  TEST_ASSERT_EQUAL(64, dcd_virtual_edpt_size(rhport, EPNUM_CDC_IN));
+}
+
+void test_enum_profile(void)
+{
+  tud_enum_profile_t profile;
+  TEST_ASSERT_TRUE( tud_enum_profile_get(rhport, &profile) );
+  TEST_ASSERT_EQUAL_HEX8(TUD_ENUM_BUS_RESET | TUD_ENUM_FIRST_SETUP | TUD_ENUM_SET_ADDRESS | TUD_ENUM_SET_CONFIG,
+                         profile.reached);
+
+  // device and configuration descriptor of each enumeration
+  tud_req_profile_t req;
+  TEST_ASSERT_TRUE( tud_req_profile_get(rhport, TUSB_REQ_GET_DESCRIPTOR, &req) );
+  TEST_ASSERT_GREATER_OR_EQUAL(2, req.count);
+
+  tud_req_profile_reset(rhport);
+  TEST_ASSERT_TRUE( tud_req_profile_get(rhport, TUSB_REQ_GET_DESCRIPTOR, &req) );
+  TEST_ASSERT_EQUAL(0, req.count);
+}
+
+void test_get_device_descriptor(void)
+{
+  tusb_control_request_t const request =
+  {
+    .bmRequestType = 0x80,
+    .bRequest      = TUSB_REQ_GET_DESCRIPTOR,
+    .wValue        = (TUSB_DESC_DEVICE << 8),
+    .wIndex        = 0x0000,
+    .wLength       = 64
+  };
+
+  uint8_t desc[64];
+  uint16_t len;
+
+  TEST_ASSERT_TRUE( dcd_virtual_control_xfer(rhport, &request, desc, &len) );
+  TEST_ASSERT_EQUAL(sizeof(tusb_desc_device_t), len);
+  TEST_ASSERT_EQUAL_MEMORY(&data_desc_device, desc, len);
+}
+
+// no string descriptor, request is stalled and next setup clears the stall
+void test_get_string_descriptor_stall(void)
+{
+  tusb_control_request_t const request =
+  {
+    .bmRequestType = 0x80,
+    .bRequest      = TUSB_REQ_GET_DESCRIPTOR,
+    .wValue        = (TUSB_DESC_STRING << 8),
+    .wIndex        = 0x0000,
+    .wLength       = 64
+  };
+
+  uint8_t desc[64];
+
+  TEST_ASSERT_FALSE( dcd_virtual_control_xfer(rhport, &request, desc, NULL) );
+  TEST_ASSERT_TRUE( dcd_virtual_edpt_stalled(rhport, 0x80) );
+
+  test_get_device_descriptor();
+}
+
+//--------------------------------------------------------------------+
+// CDC
+//--------------------------------------------------------------------+
+static void cdc_echo(void)
+{
+  uint8_t buf[64];
+  uint32_t count = tud_cdc_n_read(0, buf, sizeof(buf));
+
+  if ( count )
+  {
+    TEST_ASSERT_EQUAL(count, tud_cdc_n_write(0, buf, count));
+    tud_cdc_n_write_flush(0);
+  }
+}
+
+void test_cdc_loopback(void)
+{
+  // DTR
+  tusb_control_request_t const request =
+  {
+    .bmRequestType = 0x21,
+    .bRequest      = CDC_REQUEST_SET_CONTROL_LINE_STATE,
+    .wValue        = 0x0001,
+    .wIndex        = ITF_NUM_CDC,
+    .wLength       = 0
+  };
+  TEST_ASSERT_TRUE( dcd_virtual_control_xfer(rhport, &request, NULL, NULL) );
+  TEST_ASSERT_TRUE( tud_cdc_n_connected(0) );
+
+  fill_pattern();
+  dcd_virtual_stats_reset(rhport);
+
+  uint32_t const start = bench_timer_get();
+
+  for(uint32_t i=0; i<BENCH_BYTES; i += 64)
+  {
+    TEST_ASSERT_EQUAL(64, dcd_virtual_write(rhport, EPNUM_CDC_OUT, _out_data+i, 64));
+    cdc_echo();
+
+    // full packet is followed by a zero length packet, host reads into a larger buffer
+    TEST_ASSERT_EQUAL(64, dcd_virtual_read(rhport, EPNUM_CDC_IN, _in_data+i, 128));
+  }
+
+  uint32_t const elapsed = bench_timer_get() - start;
+
+  TEST_ASSERT_EQUAL_MEMORY(_out_data, _in_data, BENCH_BYTES);
+  bench_print("cdc", BENCH_BYTES, xfer_count(EPNUM_CDC_OUT, EPNUM_CDC_IN), elapsed);
+}
+
+//--------------------------------------------------------------------+
+// Vendor
+//--------------------------------------------------------------------+
+
+// Generated BOS and MS OS 2.0 descriptor set bind vendor interface of composite device to WinUSB
+void test_vendor_winusb(void)
+{
+  uint8_t const uuid[] = { TUD_BOS_MS_OS_20_UUID };
+  uint8_t bos[64];
+  uint16_t len;
+
+  tusb_control_request_t request =
+  {
+    .bmRequestType = 0x80,
+    .bRequest      = TUSB_REQ_GET_DESCRIPTOR,
+    .wValue        = TUSB_DESC_BOS << 8,
+    .wIndex        = 0,
+    .wLength       = sizeof(bos)
+  };
+  TEST_ASSERT_TRUE( dcd_virtual_control_xfer(rhport, &request, bos, &len) );
+  TEST_ASSERT_EQUAL(TUD_BOS_DESC_LEN + TUD_BOS_MICROSOFT_OS_DESC_LEN, len);
+  TEST_ASSERT_EQUAL_MEMORY(uuid, bos + TUD_BOS_DESC_LEN + 4, 16);
+  TEST_ASSERT_EQUAL(TUD_WINUSB_DESC_SET_LEN(1, 1), tu_u16(bos[TUD_BOS_DESC_LEN+25], bos[TUD_BOS_DESC_LEN+24]));
+  TEST_ASSERT_EQUAL(CFG_TUD_WINUSB_VENDOR_CODE, bos[TUD_BOS_DESC_LEN+26]);
+
+  uint8_t set[64];
+  request = (tusb_control_request_t)
+  {
+    .bmRequestType = 0xC0,
+    .bRequest      = CFG_TUD_WINUSB_VENDOR_CODE,
+    .wValue        = 0,
+    .wIndex        = 7,
+    .wLength       = sizeof(set)
+  };
+  TEST_ASSERT_TRUE( dcd_virtual_control_xfer(rhport, &request, set, &len) );
+  TEST_ASSERT_EQUAL(TUD_WINUSB_DESC_SET_LEN(1, 1), len);
+  TEST_ASSERT_EQUAL(len, tu_u16(set[9], set[8]));
+
+  // configuration subset, function subset of vendor interface then its compatible ID
+  TEST_ASSERT_EQUAL(MS_OS_20_SUBSET_HEADER_CONFIGURATION, set[10+2]);
+  TEST_ASSERT_EQUAL(MS_OS_20_SUBSET_HEADER_FUNCTION, set[18+2]);
+  TEST_ASSERT_EQUAL(ITF_NUM_VENDOR, set[18+4]);
+  TEST_ASSERT_EQUAL(MS_OS_20_FEATURE_COMPATBLE_ID, set[26+2]);
+  TEST_ASSERT_EQUAL_MEMORY("WINUSB\0\0", set+26+4, 8);
+}
+static void vendor_echo(void)
+{
+  uint8_t buf[64];
+  uint32_t count = tud_vendor_n_read(0, buf, sizeof(buf));
+
+  if ( count ) TEST_ASSERT_EQUAL(count, tud_vendor_n_write(0, buf, count));
+}
+
+void test_vendor_loopback(void)
+{
+  fill_pattern();
+
+  uint32_t const start = bench_timer_get();
+
+  for(uint32_t i=0; i<BENCH_BYTES; i += 64)
+  {
+    TEST_ASSERT_EQUAL(64, dcd_virtual_write(rhport, EPNUM_VENDOR_OUT, _out_data+i, 64));
+    vendor_echo();
+    TEST_ASSERT_EQUAL(64, dcd_virtual_read(rhport, EPNUM_VENDOR_IN, _in_data+i, 64));
+  }
+
+  uint32_t const elapsed = bench_timer_get() - start;
+
+  TEST_ASSERT_EQUAL_MEMORY(_out_data, _in_data, BENCH_BYTES);
+  bench_print("vendor", BENCH_BYTES, xfer_count(EPNUM_VENDOR_OUT, EPNUM_VENDOR_IN), elapsed);
+}
+
+// Transfer of exact multiple of packet size is ended by a zero length packet
+void test_vendor_zlp(void)
+{
+  tusb_desc_endpoint_t const * desc_ep = (tusb_desc_endpoint_t const *) (data_desc_configuration + CONFIG_TOTAL_LEN - 7);
+  TEST_ASSERT_EQUAL_HEX8(EPNUM_VENDOR_IN, desc_ep->bEndpointAddress);
+  usbd_edpt_zlp(rhport, desc_ep);
+
+  fill_pattern();
+  TEST_ASSERT_EQUAL(64, tud_vendor_n_write(0, _out_data, 64));
+  TEST_ASSERT_EQUAL(64, dcd_virtual_read(rhport, EPNUM_VENDOR_IN, _in_data, 2*64));
+  TEST_ASSERT_EQUAL_MEMORY(_out_data, _in_data, 64);
+
+  dcd_virtual_ep_stats_t stats;
+  dcd_virtual_stats_get(rhport, EPNUM_VENDOR_IN, &stats);
+  TEST_ASSERT_EQUAL(2, stats.packets);
+  TEST_ASSERT_EQUAL(64, stats.xfer_bytes);
+}
+
+static uint32_t func_call_count;
+
+static void func_call(void* param)
+{
+  (void) param;
+  func_call_count++;
+}
+
+// Completion stored while queue is full is still processed ahead of next one of the endpoint
+void test_vendor_coalesce_queue_full(void)
+{
+  func_call_count = 0;
+  for(uint8_t i=0; i<CFG_TUD_TASK_QUEUE_SZ; i++) usbd_defer_func(func_call, NULL, true);
+
+  dcd_event_xfer_complete(rhport, EPNUM_VENDOR_OUT, 3, XFER_RESULT_SUCCESS, true);
+  tud_task();
+  TEST_ASSERT_EQUAL(CFG_TUD_TASK_QUEUE_SZ, func_call_count);
+
+  dcd_event_xfer_complete(rhport, EPNUM_VENDOR_OUT, 5, XFER_RESULT_SUCCESS, true);
+  tud_task();
+  TEST_ASSERT_EQUAL(3+5, tud_vendor_n_available(0));
+
+  tud_vendor_n_read(0, _in_data, 3+5);
+}
+
+// Stalled endpoint is not accessible until cleared by host
+void test_vendor_stall(void)
+{
+  usbd_edpt_stall(rhport, EPNUM_VENDOR_OUT);
+
+  uint32_t n;
+  TEST_ASSERT_FALSE( dcd_virtual_out(rhport, EPNUM_VENDOR_OUT, _out_data, 64, &n) );
+
+  tusb_control_request_t const request =
+  {
+    .bmRequestType = 0x02,
+    .bRequest      = TUSB_REQ_CLEAR_FEATURE,
+    .wValue        = TUSB_REQ_FEATURE_EDPT_HALT,
+    .wIndex        = EPNUM_VENDOR_OUT,
+    .wLength       = 0
+  };
+  TEST_ASSERT_TRUE( dcd_virtual_control_xfer(rhport, &request, NULL, NULL) );
+  TEST_ASSERT_FALSE( dcd_virtual_edpt_stalled(rhport, EPNUM_VENDOR_OUT) );
+}
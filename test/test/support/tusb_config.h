@@ -54,6 +54,9 @@
 // CFG_TUSB_DEBUG is defined by compiler in DEBUG build
 #define CFG_TUSB_DEBUG           0
 
+#define CFG_TUSB_FIFO_STATS      1
+#define CFG_TUSB_FIFO_MPSC       1
+
 /* USB DMA on some MCUs can only access a specific SRAM region with restriction on alignment.
  * Tinyusb use follows macros to declare transferring memory so that they can be put
  * into those specific section.
@@ -73,12 +76,29 @@
 // DEVICE CONFIGURATION
 //--------------------------------------------------------------------
 
+#ifndef CFG_TUD_TASK_QUEUE_SZ
 #define CFG_TUD_TASK_QUEUE_SZ    100
+#endif
 #define CFG_TUD_ENDOINT0_SIZE    64
+#define CFG_TUD_FAST_RESET       1
+#define CFG_TUD_DESC_ASYNC       1
+#define CFG_TUD_WINUSB           1
 
 //------------- CLASS -------------//
+// may be overridden per test (project.yml)
 //#define CFG_TUD_CDC              0
+#ifndef CFG_TUD_MSC
 #define CFG_TUD_MSC              1
+#endif
+
+#ifndef CFG_TUD_UAS
+#define CFG_TUD_UAS              1
+#endif
+
+#ifndef CFG_TUD_DFU
+#define CFG_TUD_DFU              1
+#endif
+
 //#define CFG_TUD_HID              0
 //#define CFG_TUD_MIDI             0
 //#define CFG_TUD_VENDOR           0
@@ -89,6 +109,11 @@
 #define CFG_TUD_CDC_RX_BUFSIZE   64
 #define CFG_TUD_CDC_TX_BUFSIZE   64
 
+//------------- Vendor -------------//
+
+#define CFG_TUD_VENDOR_RX_BUFSIZE  64
+#define CFG_TUD_VENDOR_TX_BUFSIZE  64
+
 //------------- MSC -------------//
 
 // Buffer size of Device Mass storage
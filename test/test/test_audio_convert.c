@@ -0,0 +1,149 @@
+/* 
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#include <string.h>
+#include "unity.h"
+#include "audio_convert.h"
+
+// odd counts exercise both word and sample loops
+#define COUNT 7
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+//--------------------------------------------------------------------+
+// Tests
+//--------------------------------------------------------------------+
+void test_s24(void)
+{
+  // one spare byte in front to test unaligned buffer
+  uint8_t usb[1 + 3*COUNT];
+  for(uint8_t i=0; i < sizeof(usb); i++) usb[i] = (uint8_t) (0x11*i + 0x80);
+
+  int32_t samples[COUNT];
+  tu_audio_unpack_s24(samples, usb+1, COUNT);
+
+  for(uint8_t i=0; i < COUNT; i++)
+  {
+    uint8_t const* p = usb + 1 + 3*i;
+    TEST_ASSERT_EQUAL_HEX32((p[2] << 24) | (p[1] << 16) | (p[0] << 8), (uint32_t) samples[i]);
+  }
+
+  uint8_t packed[1 + 3*COUNT] = { 0 };
+  tu_audio_pack_s24(packed+1, samples, COUNT);
+  TEST_ASSERT_EQUAL_MEMORY(usb+1, packed+1, 3*COUNT);
+}
+
+void test_s16_s32(void)
+{
+  int16_t const s16[COUNT] = { 0, 1, -1, INT16_MAX, INT16_MIN, 0x1234, -0x1234 };
+  int32_t s32[COUNT];
+
+  tu_audio_s16_to_s32(s32, s16, COUNT);
+  for(uint8_t i=0; i < COUNT; i++) TEST_ASSERT_EQUAL_INT32(s16[i] * 65536, s32[i]);
+
+  s32[0] = 0x0000FFFF; // truncated to 0
+  int16_t back[COUNT];
+  tu_audio_s32_to_s16(back, s32, COUNT);
+  TEST_ASSERT_EQUAL_INT16_ARRAY(s16, back, COUNT);
+}
+
+void test_interleave(void)
+{
+  int16_t frames[3*COUNT];
+  for(uint8_t i=0; i < 3*COUNT; i++) frames[i] = (int16_t) (i - 10);
+
+  for(uint8_t channels = 1; channels <= 3; channels++)
+  {
+    int16_t ch0[COUNT], ch1[COUNT], ch2[COUNT];
+    int16_t* const ch[] = { ch0, ch1, ch2 };
+    tu_audio_deinterleave_s16(ch, frames, channels, COUNT);
+
+    for(uint8_t i=0; i < COUNT; i++)
+    {
+      for(uint8_t c=0; c < channels; c++) TEST_ASSERT_EQUAL_INT16(frames[i*channels + c], ch[c][i]);
+    }
+
+    int16_t out[3*COUNT];
+    int16_t const* const cch[] = { ch0, ch1, ch2 };
+    tu_audio_interleave_s16(out, cch, channels, COUNT);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(frames, out, channels*COUNT);
+  }
+
+  int32_t frames32[2*COUNT];
+  for(uint8_t i=0; i < 2*COUNT; i++) frames32[i] = (int32_t) (i*0x1000000 - 0x7000000);
+
+  int32_t l32[COUNT], r32[COUNT];
+  int32_t* const ch32[] = { l32, r32 };
+  tu_audio_deinterleave_s32(ch32, frames32, 2, COUNT);
+  TEST_ASSERT_EQUAL_INT32(frames32[2], l32[1]);
+  TEST_ASSERT_EQUAL_INT32(frames32[13], r32[6]);
+
+  int32_t out32[2*COUNT];
+  int32_t const* const cch32[] = { l32, r32 };
+  tu_audio_interleave_s32(out32, cch32, 2, COUNT);
+  TEST_ASSERT_EQUAL_INT32_ARRAY(frames32, out32, 2*COUNT);
+}
+
+void test_gain(void)
+{
+  int16_t s16[COUNT] = { 0, 100, -100, 20000, -20000, INT16_MAX, INT16_MIN };
+
+  tu_audio_gain_s16(s16, COUNT, TU_AUDIO_GAIN_UNITY/2);
+  int16_t const half[COUNT] = { 0, 50, -50, 10000, -10000, 16383, -16384 };
+  TEST_ASSERT_EQUAL_INT16_ARRAY(half, s16, COUNT);
+
+  // 4x saturates
+  tu_audio_gain_s16(s16, COUNT, 4*TU_AUDIO_GAIN_UNITY);
+  int16_t const sat[COUNT] = { 0, 200, -200, INT16_MAX, INT16_MIN, INT16_MAX, INT16_MIN };
+  TEST_ASSERT_EQUAL_INT16_ARRAY(sat, s16, COUNT);
+
+  int32_t s32[3] = { 0x10000000, -0x10000000, INT32_MAX };
+  tu_audio_gain_s32(s32, 3, 3*TU_AUDIO_GAIN_UNITY);
+  TEST_ASSERT_EQUAL_INT32(0x30000000, s32[0]);
+  TEST_ASSERT_EQUAL_INT32(-0x30000000, s32[1]);
+  TEST_ASSERT_EQUAL_INT32(INT32_MAX, s32[2]);
+}
+
+void test_volume(void)
+{
+  TEST_ASSERT_EQUAL_INT32(TU_AUDIO_GAIN_UNITY, tu_audio_volume_to_gain(0));
+  TEST_ASSERT_EQUAL_INT32(0, tu_audio_volume_to_gain(INT16_MIN));
+
+  // -6.02 dB and +6.02 dB are half and double, -20 dB and +20 dB a tenth and 10 times (0.25% tolerance)
+  TEST_ASSERT_INT32_WITHIN(100, TU_AUDIO_GAIN_UNITY/2, tu_audio_volume_to_gain(-1541));
+  TEST_ASSERT_INT32_WITHIN(400, 2*TU_AUDIO_GAIN_UNITY, tu_audio_volume_to_gain(1541));
+  TEST_ASSERT_INT32_WITHIN(20, TU_AUDIO_GAIN_UNITY/10, tu_audio_volume_to_gain(-20*256));
+  TEST_ASSERT_INT32_WITHIN(2000, 10*TU_AUDIO_GAIN_UNITY, tu_audio_volume_to_gain(20*256));
+
+  TEST_ASSERT_EQUAL_INT32(INT32_MAX, tu_audio_volume_to_gain(INT16_MAX));
+  TEST_ASSERT_EQUAL_INT32(0, tu_audio_volume_to_gain(INT16_MIN+1));
+}
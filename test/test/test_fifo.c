@@ -24,15 +24,19 @@
  * This file is part of the TinyUSB stack.
  */
 
+#include <string.h>
 #include "unity.h"
 #include "tusb_fifo.h"
 
 #define FIFO_SIZE 10
+#define FIFO_POW2_SIZE 8
 TU_FIFO_DEF(ff, FIFO_SIZE, uint8_t, false);
+TU_FIFO_DEF(ff_pow2, FIFO_POW2_SIZE, uint16_t, false);
 
 void setUp(void)
 {
   tu_fifo_clear(&ff);
+  tu_fifo_clear(&ff_pow2);
 }
 
 void tearDown(void)
@@ -87,3 +91,321 @@ void test_full(void)
 
   TEST_ASSERT_TRUE(tu_fifo_full(&ff));
 }
+
+void test_read_n_write_n_wrap(void)
+{
+  uint8_t data[FIFO_SIZE];
+  for(uint8_t i=0; i < FIFO_SIZE; i++) data[i] = i;
+
+  // move read/write index to the middle of buffer
+  TEST_ASSERT_EQUAL(6, tu_fifo_write_n(&ff, data, 6));
+  uint8_t rd_buf[FIFO_SIZE];
+  TEST_ASSERT_EQUAL(6, tu_fifo_read_n(&ff, rd_buf, 6));
+
+  // write across the end of buffer, limited by the fifo depth
+  TEST_ASSERT_EQUAL(FIFO_SIZE, tu_fifo_write_n(&ff, data, FIFO_SIZE + 5));
+  TEST_ASSERT_TRUE(tu_fifo_full(&ff));
+
+  memset(rd_buf, 0, sizeof(rd_buf));
+  TEST_ASSERT_EQUAL(FIFO_SIZE, tu_fifo_read_n(&ff, rd_buf, FIFO_SIZE + 5));
+  TEST_ASSERT_EQUAL_MEMORY(data, rd_buf, FIFO_SIZE);
+  TEST_ASSERT_TRUE(tu_fifo_empty(&ff));
+}
+
+void test_write_n_overwritable(void)
+{
+  TU_FIFO_DEF(ff_ow, FIFO_SIZE, uint8_t, true);
+
+  uint8_t data[FIFO_SIZE + 4];
+  for(uint8_t i=0; i < sizeof(data); i++) data[i] = i;
+
+  tu_fifo_write_n(&ff_ow, data, 3);
+  tu_fifo_write_n(&ff_ow, data + 3, sizeof(data) - 3);
+  TEST_ASSERT_TRUE(tu_fifo_full(&ff_ow));
+
+  // only the last FIFO_SIZE items remain
+  uint8_t rd_buf[FIFO_SIZE];
+  TEST_ASSERT_EQUAL(FIFO_SIZE, tu_fifo_read_n(&ff_ow, rd_buf, FIFO_SIZE));
+  TEST_ASSERT_EQUAL_MEMORY(data + 4, rd_buf, FIFO_SIZE);
+
+  // chunk smaller than depth drops oldest items across the wrap, then discard
+  tu_fifo_write_n(&ff_ow, data, 7);
+  tu_fifo_write_n(&ff_ow, data + 7, 6);
+  TEST_ASSERT_EQUAL(FIFO_SIZE, tu_fifo_count(&ff_ow));
+
+  tu_fifo_advance_read_pointer(&ff_ow, 4);
+  TEST_ASSERT_EQUAL(FIFO_SIZE-4, tu_fifo_read_n(&ff_ow, rd_buf, FIFO_SIZE));
+  TEST_ASSERT_EQUAL_MEMORY(data + 3 + 4, rd_buf, FIFO_SIZE-4);
+}
+
+void test_count_index_wrap(void)
+{
+  uint8_t data[3] = { 1, 2, 3 };
+  uint8_t rd_buf[3];
+
+  // indices go around the buffer several times
+  for(uint8_t i=0; i < 3*FIFO_SIZE; i++)
+  {
+    TEST_ASSERT_EQUAL(3, tu_fifo_write_n(&ff, data, 3));
+    TEST_ASSERT_EQUAL(3, tu_fifo_count(&ff));
+    TEST_ASSERT_EQUAL(FIFO_SIZE-3, tu_fifo_remaining(&ff));
+
+    TEST_ASSERT_EQUAL(3, tu_fifo_read_n(&ff, rd_buf, 3));
+    TEST_ASSERT_EQUAL_MEMORY(data, rd_buf, 3);
+    TEST_ASSERT_TRUE(tu_fifo_empty(&ff));
+  }
+}
+
+void test_pow2_depth(void)
+{
+  TEST_ASSERT_EQUAL_HEX16(2*FIFO_POW2_SIZE-1, ff_pow2.idx_mask);
+  TEST_ASSERT_EQUAL_HEX16(0, ff.idx_mask);
+
+  uint16_t data[5] = { 100, 200, 300, 400, 500 };
+  uint16_t rd_buf[5];
+
+  for(uint8_t i=0; i < 3*FIFO_POW2_SIZE; i++)
+  {
+    TEST_ASSERT_EQUAL(5, tu_fifo_write_n(&ff_pow2, data, 5));
+    TEST_ASSERT_EQUAL(5, tu_fifo_count(&ff_pow2));
+
+    uint16_t peek;
+    TEST_ASSERT_TRUE(tu_fifo_peek_at(&ff_pow2, 4, &peek));
+    TEST_ASSERT_EQUAL(500, peek);
+
+    TEST_ASSERT_EQUAL(5, tu_fifo_read_n(&ff_pow2, rd_buf, 5));
+    TEST_ASSERT_EQUAL_MEMORY(data, rd_buf, sizeof(data));
+    TEST_ASSERT_TRUE(tu_fifo_empty(&ff_pow2));
+  }
+
+  // full state
+  for(uint8_t i=0; i < FIFO_POW2_SIZE; i++) tu_fifo_write(&ff_pow2, &data[0]);
+  TEST_ASSERT_TRUE(tu_fifo_full(&ff_pow2));
+  TEST_ASSERT_FALSE(tu_fifo_write(&ff_pow2, &data[0]));
+}
+
+void test_linear_info(void)
+{
+  uint8_t data[FIFO_SIZE];
+  for(uint8_t i=0; i < FIFO_SIZE; i++) data[i] = i;
+
+  void* ptr;
+  TEST_ASSERT_EQUAL(0, tu_fifo_get_linear_read_info(&ff, &ptr));
+  TEST_ASSERT_EQUAL(FIFO_SIZE, tu_fifo_get_linear_write_info(&ff, &ptr));
+  TEST_ASSERT_EQUAL_PTR(ff_buf, ptr);
+
+  // move pointers to the middle of buffer
+  tu_fifo_write_n(&ff, data, 7);
+  tu_fifo_advance_read_pointer(&ff, 7);
+  TEST_ASSERT_TRUE(tu_fifo_empty(&ff));
+
+  // write span stops at the end of buffer
+  TEST_ASSERT_EQUAL(FIFO_SIZE-7, tu_fifo_get_linear_write_info(&ff, &ptr));
+  TEST_ASSERT_EQUAL_PTR(ff_buf+7, ptr);
+  memcpy(ptr, data, FIFO_SIZE-7);
+  tu_fifo_advance_write_pointer(&ff, FIFO_SIZE-7);
+
+  // then continues from the buffer start up to the read pointer
+  TEST_ASSERT_EQUAL(7, tu_fifo_get_linear_write_info(&ff, &ptr));
+  TEST_ASSERT_EQUAL_PTR(ff_buf, ptr);
+  memcpy(ptr, data + FIFO_SIZE-7, 2);
+  tu_fifo_advance_write_pointer(&ff, 2);
+  TEST_ASSERT_EQUAL(FIFO_SIZE-5, tu_fifo_count(&ff));
+
+  // read span also stops at the end of buffer
+  TEST_ASSERT_EQUAL(FIFO_SIZE-7, tu_fifo_get_linear_read_info(&ff, &ptr));
+  TEST_ASSERT_EQUAL_PTR(ff_buf+7, ptr);
+  tu_fifo_advance_read_pointer(&ff, FIFO_SIZE-7);
+
+  TEST_ASSERT_EQUAL(2, tu_fifo_get_linear_read_info(&ff, &ptr));
+  TEST_ASSERT_EQUAL_MEMORY(data + FIFO_SIZE-7, ptr, 2);
+  tu_fifo_advance_read_pointer(&ff, 2);
+  TEST_ASSERT_TRUE(tu_fifo_empty(&ff));
+}
+
+void test_peek_n_find(void)
+{
+  uint8_t const line[] = "AT+NAME\r\nOK\r\n";
+  uint8_t rd_buf[sizeof(line)];
+
+  // place data across the end of buffer
+  tu_fifo_write_n(&ff, line, 6);
+  tu_fifo_read_n(&ff, rd_buf, 6);
+  tu_fifo_write_n(&ff, line, FIFO_SIZE);
+
+  TEST_ASSERT_EQUAL(FIFO_SIZE, tu_fifo_peek_n(&ff, rd_buf, sizeof(rd_buf)));
+  TEST_ASSERT_EQUAL_MEMORY(line, rd_buf, FIFO_SIZE);
+  TEST_ASSERT_EQUAL(FIFO_SIZE, tu_fifo_count(&ff));
+
+  tu_fifo_idx_t pos;
+  TEST_ASSERT_TRUE(tu_fifo_find(&ff, '\n', 0, &pos));
+  TEST_ASSERT_EQUAL(8, pos);
+
+  TEST_ASSERT_TRUE(tu_fifo_find(&ff, 'A', 0, &pos));
+  TEST_ASSERT_EQUAL(0, pos);
+
+  TEST_ASSERT_TRUE(tu_fifo_find(&ff, 'O', 3, &pos));
+  TEST_ASSERT_EQUAL(9, pos);
+
+  TEST_ASSERT_FALSE(tu_fifo_find(&ff, '\n', 9, &pos));
+  TEST_ASSERT_FALSE(tu_fifo_find(&ff, 'Z', 0, &pos));
+}
+
+void test_hw_fifo_register(void)
+{
+  uint32_t volatile reg32 = 0x44332211;
+  uint16_t volatile reg16;
+
+  // start near the end of buffer so that words straddle the wrap
+  uint8_t tmp[7];
+  tu_fifo_write_n(&ff, tmp, 7);
+  tu_fifo_read_n(&ff, tmp, 7);
+
+  TEST_ASSERT_EQUAL(6, tu_fifo_write_n_from_hw(&ff, &reg32, 4, 6));
+  TEST_ASSERT_EQUAL(6, tu_fifo_count(&ff));
+
+  uint8_t const expected[] = { 0x11, 0x22, 0x33, 0x44, 0x11, 0x22 };
+  TEST_ASSERT_EQUAL(6, tu_fifo_peek_n(&ff, tmp, sizeof(tmp)));
+  TEST_ASSERT_EQUAL_MEMORY(expected, tmp, 6);
+
+  // odd length: last partial half-word is zero padded
+  TEST_ASSERT_EQUAL(5, tu_fifo_read_n_to_hw(&ff, &reg16, 2, 5));
+  TEST_ASSERT_EQUAL_HEX16(0x0011, reg16);
+
+  TEST_ASSERT_EQUAL(1, tu_fifo_read_n_to_hw(&ff, &reg32, 4, 4));
+  TEST_ASSERT_EQUAL_HEX32(0x00000022, reg32);
+  TEST_ASSERT_TRUE(tu_fifo_empty(&ff));
+
+  // bytes that do not fit are read from register and dropped
+  TEST_ASSERT_EQUAL(FIFO_SIZE, tu_fifo_write_n_from_hw(&ff, &reg32, 4, FIFO_SIZE+3));
+  TEST_ASSERT_TRUE(tu_fifo_full(&ff));
+}
+
+void test_stats(void)
+{
+  uint8_t data[FIFO_SIZE+4] = { 0 };
+  tu_fifo_stats_t const* stats = tu_fifo_get_stats(&ff);
+
+  tu_fifo_clear_stats(&ff);
+
+  tu_fifo_write_n(&ff, data, 4);
+  tu_fifo_read_n(&ff, data, 2);
+  tu_fifo_write_n(&ff, data, 3);
+  TEST_ASSERT_EQUAL(5, stats->max_count);
+  TEST_ASSERT_EQUAL(0, stats->rejected);
+
+  // only 5 of 9 fit
+  TEST_ASSERT_EQUAL(5, tu_fifo_write_n(&ff, data, 9));
+  TEST_ASSERT_FALSE(tu_fifo_write(&ff, data));
+  TEST_ASSERT_EQUAL(FIFO_SIZE, stats->max_count);
+  TEST_ASSERT_EQUAL(5, stats->rejected);
+  TEST_ASSERT_EQUAL(0, stats->overwritten);
+
+  // overwritable fifo counts the dropped oldest items
+  TU_FIFO_DEF(ff_ow, FIFO_SIZE, uint8_t, true);
+  tu_fifo_write_n(&ff_ow, data, FIFO_SIZE-1);
+  tu_fifo_write_n(&ff_ow, data, 3);
+  tu_fifo_write_n(&ff_ow, data, sizeof(data));
+  TEST_ASSERT_EQUAL(FIFO_SIZE, ff_ow.stats.max_count);
+  TEST_ASSERT_EQUAL(2 + sizeof(data), ff_ow.stats.overwritten);
+  TEST_ASSERT_EQUAL(0, ff_ow.stats.rejected);
+
+  tu_fifo_clear_stats(&ff);
+  TEST_ASSERT_EQUAL(0, stats->max_count);
+}
+
+void test_msg_fifo(void)
+{
+  uint32_t buf[32/4];
+  tu_fifo_t ff_msg;
+  uint8_t data[16];
+  uint8_t out[16];
+  uint16_t len;
+
+  for(uint8_t i=0; i < sizeof(data); i++) data[i] = i;
+
+  TEST_ASSERT_FALSE(tu_fifo_msg_config(&ff_msg, buf, 30));
+  TEST_ASSERT_TRUE(tu_fifo_msg_config(&ff_msg, buf, sizeof(buf)));
+  TEST_ASSERT_NULL(tu_fifo_msg_peek(&ff_msg, &len));
+
+  // boundaries are kept: 4+8 and 4+4 bytes, zero length message is a record too
+  TEST_ASSERT_TRUE(tu_fifo_msg_write(&ff_msg, data, 5));
+  TEST_ASSERT_TRUE(tu_fifo_msg_write(&ff_msg, data + 5, 3));
+  TEST_ASSERT_TRUE(tu_fifo_msg_write(&ff_msg, data, 0));
+  TEST_ASSERT_EQUAL(24, tu_fifo_count(&ff_msg));
+
+  // 8 bytes left: a 5-byte message needs 12
+  TEST_ASSERT_FALSE(tu_fifo_msg_writable(&ff_msg, 5));
+  TEST_ASSERT_FALSE(tu_fifo_msg_write(&ff_msg, data, 5));
+
+  TEST_ASSERT_EQUAL(5, tu_fifo_msg_read(&ff_msg, out, sizeof(out)));
+  TEST_ASSERT_EQUAL_MEMORY(data, out, 5);
+
+  // in place and 4-byte aligned
+  uint8_t const* payload = (uint8_t const*) tu_fifo_msg_peek(&ff_msg, &len);
+  TEST_ASSERT_EQUAL(3, len);
+  TEST_ASSERT_EQUAL_PTR(((uint8_t*) buf) + 12 + 4, payload);
+  TEST_ASSERT_EQUAL_MEMORY(data + 5, payload, 3);
+  tu_fifo_msg_release(&ff_msg);
+
+  TEST_ASSERT_EQUAL(0, tu_fifo_msg_read(&ff_msg, out, sizeof(out)));
+  TEST_ASSERT_TRUE(tu_fifo_empty(&ff_msg));
+
+  // write pointer at 24: 12-byte message gets its 8 bytes tail skipped and starts at buffer
+  uint8_t* dst = (uint8_t*) tu_fifo_msg_reserve(&ff_msg, 8);
+  TEST_ASSERT_EQUAL_PTR(((uint8_t*) buf) + 4, dst);
+  memcpy(dst, data, 6);
+  tu_fifo_msg_commit(&ff_msg, 6);
+  TEST_ASSERT_EQUAL(8 + 12, tu_fifo_count(&ff_msg));
+
+  // padding is skipped by reader
+  TEST_ASSERT_EQUAL(6, tu_fifo_msg_read(&ff_msg, out, 4 + 2));
+  TEST_ASSERT_EQUAL_MEMORY(data, out, 6);
+  TEST_ASSERT_TRUE(tu_fifo_empty(&ff_msg));
+
+  // excess of a message larger than buffer is discarded
+  TEST_ASSERT_TRUE(tu_fifo_msg_write(&ff_msg, data, 16));
+  TEST_ASSERT_TRUE(tu_fifo_msg_write(&ff_msg, data, 1));
+  TEST_ASSERT_EQUAL(4, tu_fifo_msg_read(&ff_msg, out, 4));
+  TEST_ASSERT_EQUAL(1, tu_fifo_msg_read(&ff_msg, out, sizeof(out)));
+  TEST_ASSERT_TRUE(tu_fifo_empty(&ff_msg));
+}
+
+void test_write_n_mpsc(void)
+{
+  uint8_t buf[FIFO_SIZE];
+  tu_fifo_t ff_mp;
+  uint8_t data[FIFO_SIZE+2];
+  uint8_t out[FIFO_SIZE];
+
+  for(uint8_t i=0; i < sizeof(data); i++) data[i] = i;
+
+  tu_fifo_config(&ff_mp, buf, FIFO_SIZE, 1, false);
+  tu_fifo_config_mpsc(&ff_mp);
+
+  // wrap around and limit up to full
+  TEST_ASSERT_EQUAL(6, tu_fifo_write_n_mpsc(&ff_mp, data, 6));
+  TEST_ASSERT_EQUAL(6, tu_fifo_read_n(&ff_mp, out, 6));
+  TEST_ASSERT_EQUAL(FIFO_SIZE, tu_fifo_write_n_mpsc(&ff_mp, data, sizeof(data)));
+  TEST_ASSERT_EQUAL(0, tu_fifo_write_n_mpsc(&ff_mp, data, 1));
+  TEST_ASSERT_EQUAL(FIFO_SIZE, tu_fifo_read_n(&ff_mp, out, sizeof(out)));
+  TEST_ASSERT_EQUAL_MEMORY(data, out, FIFO_SIZE);
+  TEST_ASSERT_EQUAL(3, ff_mp.stats.rejected);
+
+  // items are not published while another writer is in progress, last one out publishes all
+  ff_mp.mpsc_state += 0x10000;
+  TEST_ASSERT_EQUAL(4, tu_fifo_write_n_mpsc(&ff_mp, data, 4));
+  TEST_ASSERT_TRUE(tu_fifo_empty(&ff_mp));
+  ff_mp.mpsc_state -= 0x10000;
+  TEST_ASSERT_EQUAL(FIFO_SIZE - 4, tu_fifo_write_n_mpsc(&ff_mp, data + 4, sizeof(data)));
+  TEST_ASSERT_TRUE(tu_fifo_full(&ff_mp));
+  TEST_ASSERT_EQUAL(2, tu_fifo_read_n(&ff_mp, out, 2));
+  TEST_ASSERT_EQUAL_MEMORY(data, out, 2);
+
+  // clear drops published items and keeps reserve index
+  tu_fifo_clear(&ff_mp);
+  TEST_ASSERT_TRUE(tu_fifo_empty(&ff_mp));
+  TEST_ASSERT_EQUAL(3, tu_fifo_write_n_mpsc(&ff_mp, data, 3));
+  TEST_ASSERT_EQUAL(3, tu_fifo_read_n(&ff_mp, out, sizeof(out)));
+  TEST_ASSERT_EQUAL_MEMORY(data, out, 3);
+}
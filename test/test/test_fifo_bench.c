@@ -0,0 +1,187 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+// Micro-benchmark of tu_fifo throughput. Each result is printed as one line
+//   FIFO_BENCH,<op>,<item size>,<depth>,<chunk>,<unit>,<per byte x100>
+// so that it can be grepped from the test log and compared across releases.
+//
+// On Cortex-M3/M4/M7 target the DWT cycle counter is used (unit = cyc), on host
+// the monotonic clock (unit = ns). Mutex mode follows CFG_TUSB_OS of the build.
+
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+#include "tusb_fifo.h"
+
+#define BENCH_BYTES   (64*1024UL)
+
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__)
+
+#define BENCH_UNIT  "cyc"
+
+#define DEMCR         (*((volatile uint32_t*) 0xE000EDFCUL))
+#define DWT_CTRL      (*((volatile uint32_t*) 0xE0001000UL))
+#define DWT_CYCCNT    (*((volatile uint32_t*) 0xE0001004UL))
+
+static void bench_timer_init(void)
+{
+  DEMCR     |= (1UL << 24); // TRCENA
+  DWT_CYCCNT = 0;
+  DWT_CTRL  |= 1UL;         // CYCCNTENA
+}
+
+static inline uint32_t bench_timer_get(void)
+{
+  return DWT_CYCCNT;
+}
+
+#else
+
+#include <time.h>
+
+#define BENCH_UNIT  "ns"
+
+static void bench_timer_init(void)
+{
+}
+
+static inline uint32_t bench_timer_get(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t) (ts.tv_sec*1000000000ULL + ts.tv_nsec);
+}
+
+#endif
+
+enum
+{
+  BENCH_WRITE_N,
+  BENCH_READ_N,
+  BENCH_PEEK_AT,
+};
+
+static char const* const _op_name[] = { "write_n", "read_n", "peek_at" };
+
+static uint8_t _ff_buf[4*512];
+static uint8_t _data[4*512];
+
+static void bench_run(uint8_t op, uint16_t item_size, tu_fifo_idx_t depth, tu_fifo_idx_t chunk)
+{
+  tu_fifo_t ff;
+  TEST_ASSERT_TRUE(tu_fifo_config(&ff, _ff_buf, depth, item_size, false));
+
+  uint32_t const loops = BENCH_BYTES / (chunk*item_size);
+  uint32_t elapsed = 0;
+
+  for(uint32_t i=0; i<loops; i++)
+  {
+    uint32_t start;
+
+    switch(op)
+    {
+      case BENCH_WRITE_N:
+        start = bench_timer_get();
+        TEST_ASSERT_EQUAL(chunk, tu_fifo_write_n(&ff, _data, chunk));
+        elapsed += bench_timer_get() - start;
+
+        tu_fifo_read_n(&ff, _data, chunk);
+      break;
+
+      case BENCH_READ_N:
+        tu_fifo_write_n(&ff, _data, chunk);
+
+        start = bench_timer_get();
+        TEST_ASSERT_EQUAL(chunk, tu_fifo_read_n(&ff, _data, chunk));
+        elapsed += bench_timer_get() - start;
+      break;
+
+      case BENCH_PEEK_AT:
+      default:
+        tu_fifo_write_n(&ff, _data, chunk);
+
+        start = bench_timer_get();
+        for(tu_fifo_idx_t p=0; p<chunk; p++) tu_fifo_peek_at(&ff, p, _data);
+        elapsed += bench_timer_get() - start;
+
+        tu_fifo_advance_read_pointer(&ff, chunk);
+      break;
+    }
+  }
+
+  TEST_ASSERT_TRUE(tu_fifo_empty(&ff));
+
+  uint32_t const total_bytes = loops*chunk*item_size;
+  printf("FIFO_BENCH,%s,%u,%u,%u,%s,%lu\n", _op_name[op], item_size, depth, chunk, BENCH_UNIT,
+         (unsigned long) (((uint64_t) elapsed * 100) / total_bytes));
+}
+
+static void bench_all_ops(uint16_t item_size, tu_fifo_idx_t depth)
+{
+  // chunk size not dividing depth so that transfers wrap around the buffer end
+  tu_fifo_idx_t const chunk = (tu_fifo_idx_t) (depth/2 + 3);
+
+  for(uint8_t op = BENCH_WRITE_N; op <= BENCH_PEEK_AT; op++)
+  {
+    bench_run(op, item_size, depth, chunk);
+  }
+}
+
+void setUp(void)
+{
+  bench_timer_init();
+}
+
+void tearDown(void)
+{
+}
+
+//--------------------------------------------------------------------+
+// Benchmarks
+//--------------------------------------------------------------------+
+void test_bench_item1(void)
+{
+  bench_all_ops(1, 64);
+  bench_all_ops(1, 100);
+  bench_all_ops(1, 512);
+  bench_all_ops(1, 500);
+}
+
+void test_bench_item2(void)
+{
+  bench_all_ops(2, 64);
+  bench_all_ops(2, 100);
+  bench_all_ops(2, 512);
+  bench_all_ops(2, 500);
+}
+
+void test_bench_item4(void)
+{
+  bench_all_ops(4, 64);
+  bench_all_ops(4, 100);
+  bench_all_ops(4, 512);
+  bench_all_ops(4, 500);
+}
@@ -0,0 +1,96 @@
+/* 
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019 Ha Thach (tinyusb.org)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * This file is part of the TinyUSB stack.
+ */
+
+#include "unity.h"
+#include "common/tusb_verify.h"
+
+// built with CFG_TUSB_ASSERT_RELEASE (project.yml)
+static int _eval_count;
+
+static bool eval(bool cond)
+{
+  _eval_count++;
+  return cond;
+}
+
+static bool assert_bool(bool cond)
+{
+  TU_ASSERT( eval(cond) );
+  return true;
+}
+
+static int assert_ret(bool cond)
+{
+  TU_ASSERT( eval(cond), -1 );
+  return 0;
+}
+
+static uint32_t assert_err(uint32_t err)
+{
+  TU_ASSERT_ERR( err );
+  return 0;
+}
+
+static bool assume_bool(uint8_t idx)
+{
+  TU_ASSUME( idx < 4 );
+  return true;
+}
+
+void setUp(void)
+{
+  _eval_count = 0;
+}
+
+void tearDown(void)
+{
+}
+
+void test_release_option(void)
+{
+  TEST_ASSERT_EQUAL(1, CFG_TUSB_ASSERT_RELEASE);
+}
+
+// release assert still returns and keeps side effect of its condition
+void test_assert_returns(void)
+{
+  TEST_ASSERT_TRUE ( assert_bool(true) );
+  TEST_ASSERT_FALSE( assert_bool(false) );
+  TEST_ASSERT_EQUAL( 0, assert_ret(true) );
+  TEST_ASSERT_EQUAL(-1, assert_ret(false) );
+  TEST_ASSERT_EQUAL( 4, _eval_count );
+}
+
+void test_assert_err_returns(void)
+{
+  TEST_ASSERT_EQUAL(0, assert_err(0));
+  TEST_ASSERT_EQUAL(5, assert_err(5));
+}
+
+void test_assume_holds(void)
+{
+  for(uint8_t i = 0; i < 4; i++) TEST_ASSERT_TRUE( assume_bool(i) );
+}
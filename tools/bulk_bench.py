@@ -0,0 +1,232 @@
+#!/usr/bin/env python3
+#
+# Host side of examples/device/bulk_bench: bulk throughput of the vendor interfaces
+# at a range of transfer sizes and queue depths, using libusb asynchronous transfers.
+#
+#   pip3 install libusb1
+#   python3 tools/bulk_bench.py
+#   python3 tools/bulk_bench.py --size 4 --sizes 512,4096,65536 --depths 1,2,4,8
+#
+# Each test moves the same amount of data so that boards and stack versions can be
+# compared on the same numbers. Source is IN of interface 0, sink is its OUT and
+# loopback is interface 1, whose data is checked. The last line sums up the best
+# result of each test as one CSV record.
+
+import argparse
+import os
+import struct
+import sys
+import time
+
+try:
+    import usb1
+except ImportError:
+    sys.exit("libusb1 module is required: pip3 install libusb1")
+
+MB = 1024 * 1024
+
+VID = 0xCAFE
+PRODUCT = "TinyUSB Bulk Bench"
+
+ITF_SOURCE_SINK = 0
+ITF_LOOPBACK = 1
+
+BENCH_REQUEST_INFO = 1
+BENCH_REQUEST_STATS = 2
+
+TIMEOUT_MS = 5000
+
+
+def find_device(context, serial):
+    for dev in context.getDeviceIterator(skip_on_error=True):
+        if dev.getVendorID() != VID:
+            continue
+        try:
+            handle = dev.open()
+        except usb1.USBError:
+            continue
+        if dev.getProduct() == PRODUCT and (serial is None or dev.getSerialNumber() == serial):
+            return dev, handle
+        handle.close()
+    return None, None
+
+
+def get_endpoints(dev, itf):
+    for setting in dev.iterSettings():
+        if setting.getNumber() != itf:
+            continue
+        ep_out = ep_in = None
+        for ep in setting:
+            if ep.getAddress() & 0x80:
+                ep_in = ep.getAddress()
+            else:
+                ep_out = ep.getAddress()
+        return ep_out, ep_in
+    raise IOError("interface {} not found, is it a bulk_bench device?".format(itf))
+
+
+def vendor_in(handle, request, value, length):
+    return handle.controlRead(usb1.TYPE_VENDOR | usb1.RECIPIENT_DEVICE, request, value, 0, length, TIMEOUT_MS)
+
+
+def get_info(handle):
+    data = vendor_in(handle, BENCH_REQUEST_INFO, 0, 12)
+    keys = ("version", "stream", "depth", "high_speed", "ep_size", "buf_size", "mcu")
+    return dict(zip(keys, struct.unpack("<BBBBHHI", data)))
+
+
+def get_stats(handle, reset=False):
+    data = vendor_in(handle, BENCH_REQUEST_STATS, 1 if reset else 0, 12)
+    return struct.unpack("<III", data)
+
+
+class Stream:
+    """Keeps depth transfers of size queued on an endpoint until total bytes are submitted"""
+
+    def __init__(self, handle, ep, size, depth, total, pattern=None):
+        self.ep = ep
+        self.size = size
+        self.total = total
+        self.submitted = 0
+        self.done = 0
+        self.inflight = 0
+        self.error = None
+        self.received = bytearray() if pattern is not None else None
+        self.transfers = []
+
+        for _ in range(depth):
+            t = handle.getTransfer()
+            if ep & 0x80:
+                t.setBulk(ep, size, self.callback, timeout=TIMEOUT_MS)
+            else:
+                t.setBulk(ep, pattern if pattern is not None else bytearray(size), self.callback, timeout=TIMEOUT_MS)
+            self.transfers.append(t)
+
+    def submit(self, t):
+        if self.submitted >= self.total or self.error is not None:
+            return
+        self.submitted += self.size
+        self.inflight += 1
+        t.submit()
+
+    def start(self):
+        for t in self.transfers:
+            self.submit(t)
+
+    def callback(self, t):
+        self.inflight -= 1
+        status = t.getStatus()
+        if status != usb1.TRANSFER_COMPLETED:
+            self.error = status
+            return
+
+        n = t.getActualLength()
+        self.done += n
+        if self.received is not None and self.ep & 0x80:
+            self.received += t.getBuffer()[:n]
+        self.submit(t)
+
+    def busy(self):
+        return self.inflight > 0
+
+
+def run(context, streams):
+    start = time.perf_counter()
+    for s in streams:
+        s.start()
+    while any(s.busy() for s in streams):
+        context.handleEventsTimeout(1)
+    elapsed = time.perf_counter() - start
+
+    for s in streams:
+        if s.error is not None:
+            raise IOError("endpoint 0x{:02x}: transfer status {}".format(s.ep, s.error))
+    return elapsed
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Bulk throughput benchmark, use with examples/device/bulk_bench")
+    parser.add_argument("--size", type=int, default=8, help="MB moved by each test (default 8)")
+    parser.add_argument("--sizes", default="512,4096,16384,65536",
+                        help="comma separated bytes per transfer, rounded to endpoint size (default 512,4096,16384,65536)")
+    parser.add_argument("--depths", default="1,2,4,8", help="comma separated transfers queued per endpoint (default 1,2,4,8)")
+    parser.add_argument("--tests", default="source,sink,loopback", help="comma separated tests (default all)")
+    parser.add_argument("--serial", help="serial number when several devices are attached")
+    args = parser.parse_args()
+
+    sizes = [int(s) for s in args.sizes.split(",")]
+    depths = [int(d) for d in args.depths.split(",")]
+    tests = args.tests.split(",")
+
+    with usb1.USBContext() as context:
+        dev, handle = find_device(context, args.serial)
+        if handle is None:
+            sys.exit("no '{}' device found".format(PRODUCT))
+
+        for itf in (ITF_SOURCE_SINK, ITF_LOOPBACK):
+            if handle.kernelDriverActive(itf):
+                handle.detachKernelDriver(itf)
+            handle.claimInterface(itf)
+
+        ss_out, ss_in = get_endpoints(dev, ITF_SOURCE_SINK)
+        lb_out, lb_in = get_endpoints(dev, ITF_LOOPBACK)
+
+        info = get_info(handle)
+        ep_size = info["ep_size"]
+        print("{} serial {}, bcdDevice {:04x}: mcu {}, {} speed, {} mode (depth {}), ep {}, buffer {}".format(
+            PRODUCT, dev.getSerialNumber(), dev.getbcdDevice(), info["mcu"],
+            "high" if info["high_speed"] else "full", "stream" if info["stream"] else "fifo",
+            info["depth"], ep_size, info["buf_size"]))
+
+        separator = "-" * 64
+        print(separator)
+        print("| {:10} | {:>8} | {:>6} | {:>9} | {:>16} |".format("Test", "Transfer", "Depth", "MB/s", "Device bytes"))
+        print(separator)
+
+        best = {}
+        for test in tests:
+            for size in sizes:
+                size = max(ep_size, size - size % ep_size)
+                total = max(1, (args.size * MB) // size) * size
+
+                for depth in depths:
+                    get_stats(handle, reset=True)
+
+                    if test == "source":
+                        streams = [Stream(handle, ss_in, size, depth, total)]
+                    elif test == "sink":
+                        streams = [Stream(handle, ss_out, size, depth, total)]
+                    elif test == "loopback":
+                        pattern = bytearray(os.urandom(size))
+                        streams = [Stream(handle, lb_out, size, depth, total, pattern),
+                                   Stream(handle, lb_in, size, depth, total, pattern)]
+                    else:
+                        sys.exit("unknown test {}".format(test))
+
+                    elapsed = run(context, streams)
+
+                    if test == "loopback":
+                        expected = bytes(pattern) * (total // size)
+                        if bytes(streams[1].received) != expected:
+                            raise IOError("loopback: data mismatch at transfer {}, depth {}".format(size, depth))
+
+                    mbps = streams[-1].done / MB / elapsed
+                    best[test] = max(best.get(test, 0), mbps)
+
+                    sink, source, loopback = get_stats(handle)
+                    device_bytes = {"source": source, "sink": sink, "loopback": loopback}[test]
+                    print("| {:10} | {:>8} | {:>6} | {:>9.2f} | {:>16} |".format(test, size, depth, mbps, device_bytes))
+            print(separator)
+
+        # one record per run: mcu, speed, mode, then best MB/s of each test
+        print("BULK_BENCH,{},{},{},{}".format(info["mcu"], "hs" if info["high_speed"] else "fs",
+                                              "stream" if info["stream"] else "fifo",
+                                              ",".join("{}={:.2f}".format(t, best[t]) for t in tests)))
+
+        for itf in (ITF_SOURCE_SINK, ITF_LOOPBACK):
+            handle.releaseInterface(itf)
+        handle.close()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,180 @@
+#!/usr/bin/env python3
+#
+# Host side of examples/device/msc_bench: dd-style sequential and random tests
+# against a raw block device, bypassing page cache.
+#
+#   sudo python3 tools/msc_bench.py /dev/sdX
+#   sudo python3 tools/msc_bench.py --write --report /dev/ttyACM0 /dev/sdX
+#
+# Write tests destroy content of the device and only run with --write. Use the
+# "Bench Null Disk" LUN to measure USB and stack alone, "Bench RAM Disk" to
+# include memcpy of the medium. With --report, the device's own statistics
+# (BENCH lines on its CDC port) are printed next to each test.
+
+import argparse
+import mmap
+import os
+import random
+import sys
+import threading
+import time
+
+KB = 1024
+MB = 1024 * 1024
+
+
+def open_device(path, write):
+    flags = os.O_RDWR if write else os.O_RDONLY
+    if hasattr(os, "O_DIRECT"):
+        flags |= os.O_DIRECT
+    if write and hasattr(os, "O_SYNC"):
+        flags |= os.O_SYNC
+
+    fd = os.open(path, flags)
+
+    # macOS has no O_DIRECT, disable caching with F_NOCACHE
+    if sys.platform == "darwin":
+        import fcntl
+        fcntl.fcntl(fd, 48, 1)
+
+    return fd
+
+
+def device_size(fd):
+    size = os.lseek(fd, 0, os.SEEK_END)
+    os.lseek(fd, 0, os.SEEK_SET)
+    return size
+
+
+def check_vendor(path):
+    # Linux only: refuse to write anything that is not a TinyUSB device
+    vendor_file = "/sys/block/{}/device/vendor".format(os.path.basename(path))
+    if not os.path.exists(vendor_file):
+        return True
+    with open(vendor_file) as f:
+        return f.read().strip() == "TinyUSB"
+
+
+class Report(threading.Thread):
+    """Collect BENCH lines sent by the device over CDC"""
+
+    def __init__(self, path):
+        super().__init__(daemon=True)
+        self.port = open(path, "rb", buffering=0)
+        self.lines = []
+        self.lock = threading.Lock()
+
+    def run(self):
+        buf = b""
+        while True:
+            data = self.port.read(64)
+            if not data:
+                continue
+            buf += data
+            while b"\n" in buf:
+                line, buf = buf.split(b"\n", 1)
+                line = line.strip().decode(errors="ignore")
+                if line.startswith("BENCH,") or line.startswith("CONFIG,"):
+                    with self.lock:
+                        self.lines.append(line)
+
+    def take(self):
+        with self.lock:
+            lines, self.lines = self.lines, []
+        return lines
+
+
+def run_test(fd, name, write, bs, count, offsets, report):
+    # mmap'ed buffer is page aligned as required by O_DIRECT
+    buf = mmap.mmap(-1, bs)
+    if write:
+        buf.write(os.urandom(bs))
+
+    latency = []
+    start = time.perf_counter()
+    for off in offsets:
+        t = time.perf_counter()
+        os.lseek(fd, off, os.SEEK_SET)
+        if write:
+            n = os.write(fd, buf)
+        else:
+            n = os.readv(fd, [buf])
+        latency.append(time.perf_counter() - t)
+        if n != bs:
+            raise IOError("{}: short transfer {} of {} at {}".format(name, n, bs, off))
+    elapsed = time.perf_counter() - start
+
+    total = bs * count
+    print("| {:10} | {:>7} | {:>6} | {:>9.2f} | {:>8.0f} | {:>9.3f} | {:>9.3f} |".format(
+        name, "{}K".format(bs // KB), count, total / MB / elapsed, count / elapsed,
+        1000 * sum(latency) / count, 1000 * max(latency)))
+
+    if report:
+        # device reports once a second, wait for the last interval
+        time.sleep(1.2)
+        for line in report.take():
+            print("|   device: {}".format(line))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="MSC throughput benchmark, use with examples/device/msc_bench")
+    parser.add_argument("device", help="raw block device e.g /dev/sdb or /dev/rdisk4")
+    parser.add_argument("--size", type=int, default=8, help="MB transferred by sequential tests (default 8)")
+    parser.add_argument("--bs", type=int, default=64, help="KB per sequential request (default 64)")
+    parser.add_argument("--rand-bs", type=int, default=4, help="KB per random request (default 4)")
+    parser.add_argument("--count", type=int, default=1000, help="number of random requests (default 1000)")
+    parser.add_argument("--seed", type=int, default=1, help="seed of random offsets, fixed for comparable runs")
+    parser.add_argument("--write", action="store_true", help="also run write tests, DESTROYS device content")
+    parser.add_argument("--force", action="store_true", help="write even if device vendor is not TinyUSB")
+    parser.add_argument("--report", metavar="TTY", help="CDC port of the device to print its statistics")
+    args = parser.parse_args()
+
+    if args.write and not args.force and not check_vendor(args.device):
+        sys.exit("{} is not a TinyUSB device, use --force to write anyway".format(args.device))
+
+    fd = open_device(args.device, args.write)
+    dev_size = device_size(fd)
+
+    report = None
+    if args.report:
+        report = Report(args.report)
+        report.start()
+
+    seq_bs = args.bs * KB
+    rand_bs = args.rand_bs * KB
+
+    if dev_size < max(seq_bs, rand_bs):
+        sys.exit("{} is smaller than request size".format(args.device))
+
+    # sequential tests wrap around small devices e.g RAM disk
+    seq_count = max(1, (args.size * MB) // seq_bs)
+    seq_offsets = [(i * seq_bs) % (dev_size - dev_size % seq_bs) for i in range(seq_count)]
+
+    rng = random.Random(args.seed)
+    rand_offsets = [rng.randrange(dev_size // rand_bs) * rand_bs for _ in range(args.count)]
+
+    print("{}: {} KB".format(args.device, dev_size // KB))
+    separator = "-" * 82
+    print(separator)
+    print("| {:10} | {:>7} | {:>6} | {:>9} | {:>8} | {:>9} | {:>9} |".format(
+        "Test", "Block", "Count", "MB/s", "IOPS", "Avg ms", "Max ms"))
+    print(separator)
+
+    if report:
+        time.sleep(1.2)
+        for line in report.take():
+            print("|   device: {}".format(line))
+
+    run_test(fd, "seq read", False, seq_bs, seq_count, seq_offsets, report)
+    if args.write:
+        run_test(fd, "seq write", True, seq_bs, seq_count, seq_offsets, report)
+    run_test(fd, "rand read", False, rand_bs, args.count, rand_offsets, report)
+    if args.write:
+        run_test(fd, "rand write", True, rand_bs, args.count, rand_offsets, report)
+
+    print(separator)
+    os.close(fd)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,218 @@
+#!/usr/bin/env python3
+#
+# RAM and flash used by each TinyUSB module of a firmware, from the linker map file.
+# Run by the size-report target of examples with the tusb_config.h of the example:
+#
+#   make BOARD=pca10056 size-report
+#   make BOARD=pca10056 SYMBOLS=1 size-report
+#   python3 tools/size_report.py --symbols _build/build-pca10056/pca10056-firmware.elf.map
+#
+# Examples are built with -ffunction-sections -fdata-sections and --gc-sections, hence the input
+# sections left in the map are exactly what is linked. Flash is code, read-only data and the load
+# image of initialized data, RAM is initialized data and bss. Event queue of usbd/usbh is shown on
+# its own line. --symbols lists the RAM variables of each module, e.g FIFO (_cdcd_ffbuf) and endpoint
+# (_cdcd_epbuf) buffers of CDC, other drivers keep their buffers in interface state (_midid_itf).
+#
+# Each module line is also printed as a SIZE_REPORT,<label>,<module>,<flash>,<ram> record so that
+# builds of several boards or configurations can be compared, e.g
+#
+#   for b in pca10056 feather_nrf52840_express stm32f407disco; do make BOARD=$b size-report; done | grep SIZE_REPORT
+
+from __future__ import print_function
+
+import argparse
+import os
+import re
+import sys
+
+# object file stem -> module, others use their stem e.g cdc_device, dcd_nrf5x
+MODULE_ALIAS = {
+    "usbd_control": "usbd",
+}
+
+# variables reported as a module of their own
+SYMBOL_MODULE = [
+    (re.compile(r"^_usb[dh]_qdef_buf$"), "event queue"),
+]
+
+OTHER = "application/bsp/libc"
+
+RE_ZERO_INIT = re.compile(r"^(\.(s?bss|tbss|noinit)|COMMON$)")
+
+# input section prefix of a variable with -fdata-sections
+RE_VARIABLE = re.compile(r"^\.(s?bss|s?data|rodata)(\.rel(\.ro)?(\.local)?)?\.")
+
+# sections not loaded on target
+NOT_ALLOC = re.compile(r"^\.(debug|comment|ARM\.attributes|stab|gnu\.attributes|note\.gnu\.build-id$)")
+
+RE_REGION = re.compile(r"^(\S+)\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)(?:\s+(\S+))?\s*$")
+RE_OUTPUT = re.compile(r"^(\S+)?\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)(?:\s+load address 0x([0-9a-fA-F]+))?\s*$")
+RE_INPUT  = re.compile(r"^ (\S+)?\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S.*?)\s*$")
+RE_OBJECT = re.compile(r"(?:^|/)obj/(src/.+)\.o$")
+
+
+class Region:
+    def __init__(self, origin, length, writable):
+        self.origin = origin
+        self.length = length
+        self.writable = writable
+
+    def contains(self, addr):
+        return self.origin <= addr < self.origin + self.length
+
+
+def parse_map(path):
+    """Return list of (output section, input section, object, size, is_flash, is_ram)"""
+    regions = []
+    items = []
+
+    with open(path) as f:
+        lines = f.read().splitlines()
+
+    # Memory Configuration: Name Origin Length Attributes
+    i = 0
+    while i < len(lines) and lines[i].strip() != "Memory Configuration":
+        i += 1
+    while i < len(lines) and lines[i].strip() != "Linker script and memory map":
+        m = RE_REGION.match(lines[i])
+        if m and m.group(1) != "*default*":
+            regions.append(Region(int(m.group(2), 16), int(m.group(3), 16), "w" in (m.group(4) or "")))
+        i += 1
+
+    def region_of(addr):
+        for r in regions:
+            if r.contains(addr):
+                return r
+        return None
+
+    def classify(out_name, vma, lma):
+        r_vma = region_of(vma)
+        r_lma = region_of(lma)
+        if regions and (r_vma or r_lma):
+            is_ram = r_vma is not None and r_vma.writable
+            is_flash = r_lma is not None and not r_lma.writable
+            return is_flash, is_ram
+
+        # no memory regions (default linker script): by section name
+        is_ram = re.match(r"^\.(bss|data|noinit|tbss|tdata)", out_name) is not None
+        is_flash = re.match(r"^\.(bss|noinit|tbss)", out_name) is None
+        return is_flash, is_ram
+
+    out_name = None
+    out_vma = out_lma = 0
+    skip = True
+    pending = None
+
+    for line in lines[i:]:
+        if line.startswith("Cross Reference Table"):
+            break
+        if not line.strip():
+            continue
+
+        # section name too long for its column, addresses follow on next line
+        if pending is not None:
+            line = pending + line
+            pending = None
+        elif re.match(r"^ ?\S+$", line) and not line.strip().startswith("*"):
+            pending = line
+            continue
+
+        if not line.startswith(" "):
+            m = RE_OUTPUT.match(line)
+            if m and m.group(1):
+                out_name = m.group(1)
+                out_vma = int(m.group(2), 16)
+                out_lma = int(m.group(4), 16) if m.group(4) else out_vma
+                skip = NOT_ALLOC.match(out_name) is not None
+                if not skip:
+                    flash, ram = classify(out_name, out_vma, out_lma)
+            continue
+
+        if skip or out_name is None:
+            continue
+
+        m = RE_INPUT.match(line)
+        if not m or not m.group(1) or m.group(1) == "*fill*":
+            continue
+
+        size = int(m.group(3), 16)
+        if size == 0:
+            continue
+
+        # zero initialized input is not loaded even if output section has a load address
+        zero = RE_ZERO_INIT.match(m.group(1)) is not None
+        items.append((out_name, m.group(1), m.group(4), size, flash and not zero, ram))
+
+    return items
+
+
+def module_of(obj, in_name):
+    m = RE_OBJECT.search(obj.replace("\\", "/"))
+    if not m:
+        return OTHER
+
+    symbol = in_name.split(".")[-1]
+    for pattern, module in SYMBOL_MODULE:
+        if pattern.match(symbol):
+            return module
+
+    stem = os.path.basename(m.group(1))
+    return MODULE_ALIAS.get(stem, stem)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="RAM and flash of TinyUSB modules from a GNU ld map file")
+    parser.add_argument("map", help="map file e.g _build/build-<board>/<board>-firmware.elf.map")
+    parser.add_argument("--symbols", action="store_true", help="list RAM variables of each module")
+    parser.add_argument("--label", default="", help="first field of SIZE_REPORT records e.g board name")
+    args = parser.parse_args()
+
+    items = parse_map(args.map)
+    if not items:
+        sys.exit("{}: no allocated input section found, is it a GNU ld map file?".format(args.map))
+
+    flash = {}
+    ram = {}
+    variables = {}
+    for out_name, in_name, obj, size, is_flash, is_ram in items:
+        module = module_of(obj, in_name)
+        flash[module] = flash.get(module, 0) + (size if is_flash else 0)
+        ram[module] = ram.get(module, 0) + (size if is_ram else 0)
+
+        if is_ram and module != OTHER:
+            # .bss.<name> with -fdata-sections, otherwise whole section of the object
+            name = RE_VARIABLE.sub("", in_name)
+            variables.setdefault(module, []).append((size, name))
+
+    modules = sorted((m for m in flash if m != OTHER), key=lambda m: -(flash[m] + ram[m]))
+    total_flash = sum(flash[m] for m in modules)
+    total_ram = sum(ram[m] for m in modules)
+
+    row = "| {:24} | {:>8} | {:>8} |"
+    separator = "-" * 50
+    print(args.map)
+    print(separator)
+    print(row.format("Module", "Flash", "RAM"))
+    print(separator)
+    for m in modules:
+        print(row.format(m, flash[m], ram[m]))
+    print(separator)
+    print(row.format("TinyUSB", total_flash, total_ram))
+    print(row.format(OTHER, flash.get(OTHER, 0), ram.get(OTHER, 0)))
+    print(separator)
+
+    if args.symbols:
+        for m in modules:
+            if m not in variables:
+                continue
+            print("{}:".format(m))
+            for size, name in sorted(variables[m], reverse=True):
+                print("  {:>8}  {}".format(size, name))
+        print(separator)
+
+    for m in modules + [OTHER]:
+        print("SIZE_REPORT,{},{},{},{}".format(args.label, m, flash.get(m, 0), ram.get(m, 0)))
+
+
+if __name__ == "__main__":
+    main()